@@ -94,6 +94,24 @@ ipcmem__parse_ident(const char *ident,
 				type_code = 'd';
 				unitsz = sizeof(int64_t);
 			}
+			else if (strcmp(pos, "arrow-columns") == 0)
+			{
+				/* layout of each column is described by 'columns' */
+				type_code = 'A';
+				unitsz = 0;
+			}
+			else if (strcmp(pos, "gstore-columns") == 0)
+			{
+				/* live device buffer of Gstore_Fdw; see 'columns' */
+				type_code = 'G';
+				unitsz = 0;
+			}
+			else if (strcmp(pos, "raw") == 0)
+			{
+				/* extra buffer or valid bitmap of gstore-columns */
+				type_code = 'B';
+				unitsz = 0;
+			}
 			else
 			{
 				PyErr_Format(PyExc_TypeError,
@@ -137,6 +155,18 @@ ipcmem__parse_ident(const char *ident,
 			/* just ignore the attributes */
 			mask |= 0x0040;
 		}
+		else if (strcmp(tok, "columns") == 0)
+		{
+			/* layout of arrow/gstore-columns; parsed by the caller */
+			mask |= 0x0080;
+		}
+		else if (strcmp(tok, "extra_size") == 0 ||
+				 strcmp(tok, "extra_handle") == 0 ||
+				 strcmp(tok, "valid_size") == 0 ||
+				 strcmp(tok, "valid_handle") == 0)
+		{
+			/* sub-buffers of gstore-columns; opened by the caller */
+		}
 		else
 		{
 			PyErr_Format(PyExc_ValueError, "unexpected token [%s]", tok);
@@ -165,7 +195,16 @@ ipcmem__parse_ident(const char *ident,
 		return false;
 	}
 
-	if (nitems % nattrs != 0)
+	if (type_code == 'A' || type_code == 'G')
+	{
+		if ((mask & 0x0080) == 0)
+		{
+			PyErr_Format(PyExc_ValueError,
+						 "identifier token has no layout of the columns");
+			return false;
+		}
+	}
+	else if (type_code != 'B' && nitems % nattrs != 0)
 	{
 		PyErr_Format(PyExc_ValueError,
 					 "nitems=%ld does not fit to nattrs=%d",
@@ -184,7 +223,9 @@ ipcmem__parse_ident(const char *ident,
 	if (p_nattrs)
 		*p_nattrs = nattrs;
 	if (p_nitems)
-		*p_nitems = nitems / nattrs;
+		*p_nitems = (type_code == 'A' ||
+					 type_code == 'G' ||
+					 type_code == 'B' ? nitems : nitems / nattrs);
 
 	return true;
 }
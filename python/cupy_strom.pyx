@@ -54,3 +54,154 @@ def ipc_import(str token):
 						cupy.cuda.memory.MemoryPointer(ipcMem, 0),
 						None,
 						'C')
+
+#
+# ipc_import_columns - returns a dict of columns exported by
+# pgstrom.arrow_fdw_export_columns(); each column has 'type', 'data',
+# 'mask' (validity bitmap, or None) and 'offsets' (variable-length only)
+# as cupy.ndarray that shares the device memory, thus, is available to
+# hand over to cuDF or other frameworks via __cuda_array_interface__
+# or DLPack without copy.
+#
+__arrow_column_dtypes = {
+	'bool'          : 'u1',
+	'int16'         : 'i2',
+	'int32'         : 'i4',
+	'int64'         : 'i8',
+	'float16'       : 'f2',
+	'float32'       : 'f4',
+	'float64'       : 'f8',
+	'date32'        : 'i4',
+	'date64'        : 'i8',
+	'time32[s]'     : 'i4',
+	'time32[ms]'    : 'i4',
+	'time64[us]'    : 'i8',
+	'time64[ns]'    : 'i8',
+	'timestamp[s]'  : 'i8',
+	'timestamp[ms]' : 'i8',
+	'timestamp[us]' : 'i8',
+	'timestamp[ns]' : 'i8',
+	'utf8'          : 'u1',
+	'binary'        : 'u1',
+}
+
+def ipc_import_columns(str token):
+	ipcMem = IpcMemory()
+	ipcMem.open(token)
+	if ipcMem.cupy_type_code != 'A':
+		raise ValueError("GPU memory identifier is not arrow-columns format")
+	nitems = ipcMem.cupy_nitems
+	attnums = None
+	layout = None
+	for tok in token.split(','):
+		key, _, value = tok.partition('=')
+		if key == 'attnums':
+			attnums = [int(x) for x in value.split(' ')]
+		elif key == 'columns':
+			layout = value.split(' ')
+	if attnums is None or layout is None or len(attnums) != len(layout):
+		raise ValueError("invalid GPU memory identifier")
+
+	def __device_array(size_t offset, size_t length, dtype):
+		return cupy.ndarray([length], numpy.dtype(dtype),
+							cupy.cuda.memory.MemoryPointer(ipcMem, offset),
+							None, 'C')
+	results = {}
+	for attnum, desc in zip(attnums, layout):
+		type_name, values_off, nullmap_off, extra_off, extra_len = desc.split(':')
+		values_off = int(values_off)
+		nullmap_off = int(nullmap_off)
+		extra_off = int(extra_off)
+		extra_len = int(extra_len)
+		dtype = __arrow_column_dtypes[type_name]
+		column = { 'type' : type_name, 'length' : nitems }
+		if type_name == 'bool':
+			column['data'] = __device_array(values_off, (nitems + 7) // 8, dtype)
+		elif extra_off >= 0:
+			column['offsets'] = __device_array(values_off, nitems + 1, 'i4')
+			column['data'] = __device_array(extra_off, extra_len, dtype)
+		else:
+			column['data'] = __device_array(values_off, nitems, dtype)
+		if nullmap_off >= 0:
+			column['mask'] = __device_array(nullmap_off, (nitems + 7) // 8, 'u1')
+		else:
+			column['mask'] = None
+		results[attnum] = column
+	return results
+
+#
+# ipc_import_gstore - returns a dict of columns exported by
+# gstore_fdw_export_columns(); it maps the live device buffer of Gstore_Fdw,
+# not a copy, so 'valid' (bitmap of the rows visible to the snapshot on
+# export) shall be applied. Fixed-length column has 'data' and 'mask'
+# (validity bitmap, or None); varlena column has 'offsets' (uint32 packed
+# by 8 bytes from the head of 'data', 0 means NULL) and 'data'.
+#
+__gstore_column_dtypes = {
+	'bool'          : '?',
+	'int16'         : 'i2',
+	'int32'         : 'i4',
+	'int64'         : 'i8',
+	'float32'       : 'f4',
+	'float64'       : 'f8',
+	'date'          : 'i4',
+	'time'          : 'i8',
+	'timestamp'     : 'i8',
+	'timestamptz'   : 'i8',
+}
+
+def ipc_import_gstore(str token):
+	mainMem = IpcMemory()
+	mainMem.open(token)
+	if mainMem.cupy_type_code != 'G':
+		raise ValueError("GPU memory identifier is not gstore-columns format")
+	nitems = mainMem.cupy_nitems
+	keys = {}
+	for tok in token.split(','):
+		key, _, value = tok.partition('=')
+		keys[key] = value
+	if 'attnums' not in keys or 'columns' not in keys or 'valid_handle' not in keys:
+		raise ValueError("invalid GPU memory identifier")
+	attnums = [int(x) for x in keys['attnums'].split(' ')]
+	layout = keys['columns'].split(' ')
+	if len(attnums) != len(layout):
+		raise ValueError("invalid GPU memory identifier")
+
+	def __open_raw(str handle, str bytesize):
+		ipcMem = IpcMemory()
+		ipcMem.open("device_id=%s,bytesize=%s,ipc_handle=%s,format=raw,nitems=%s"
+					% (keys['device_id'], bytesize, handle, bytesize))
+		return ipcMem
+	def __device_array(ipcMem, size_t offset, shape, dtype):
+		return cupy.ndarray(shape, numpy.dtype(dtype),
+							cupy.cuda.memory.MemoryPointer(ipcMem, offset),
+							None, 'C')
+	validMem = __open_raw(keys['valid_handle'], keys['valid_size'])
+	extraMem = None
+	if 'extra_handle' in keys:
+		extraMem = __open_raw(keys['extra_handle'], keys['extra_size'])
+
+	results = {}
+	for attnum, desc in zip(attnums, layout):
+		type_name, unitsz, values_off, nullmap_off = desc.split(':')
+		unitsz = int(unitsz)
+		values_off = int(values_off)
+		nullmap_off = int(nullmap_off)
+		column = { 'type' : type_name, 'length' : nitems }
+		if unitsz < 0:
+			if extraMem is None:
+				raise ValueError("gstore-columns has no extra buffer")
+			column['offsets'] = __device_array(mainMem, values_off, [nitems], 'u4')
+			column['data'] = __device_array(extraMem, 0, [extraMem.size], 'u1')
+		elif type_name in __gstore_column_dtypes:
+			column['data'] = __device_array(mainMem, values_off, [nitems],
+											__gstore_column_dtypes[type_name])
+		else:
+			column['data'] = __device_array(mainMem, values_off, [nitems, unitsz], 'u1')
+		if nullmap_off >= 0:
+			column['mask'] = __device_array(mainMem, nullmap_off, [(nitems + 7) // 8], 'u1')
+		else:
+			column['mask'] = None
+		results[attnum] = column
+	return { 'valid'   : __device_array(validMem, 0, [(nitems + 7) // 8], 'u1'),
+			 'columns' : results }
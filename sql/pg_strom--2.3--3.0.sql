@@ -37,6 +37,21 @@ CREATE FUNCTION public.gstore_fdw_compaction(regclass, bool = false)
   AS 'MODULE_PATHNAME','pgstrom_gstore_fdw_compaction'
   LANGUAGE C STRICT;
 
+CREATE FUNCTION public.gstore_fdw_aggview(regclass)
+  RETURNS SETOF record
+  AS 'MODULE_PATHNAME','pgstrom_gstore_fdw_aggview'
+  LANGUAGE C STRICT;
+
+CREATE FUNCTION public.gstore_fdw_export_columns(regclass)
+  RETURNS text
+  AS 'MODULE_PATHNAME','pgstrom_gstore_fdw_export_columns'
+  LANGUAGE C STRICT;
+
+CREATE FUNCTION public.gstore_fdw_put_columns(text)
+  RETURNS bool
+  AS 'MODULE_PATHNAME','pgstrom_gstore_fdw_put_columns'
+  LANGUAGE C STRICT;
+
 SELECT pgstrom.define_shell_type('gstore_fdw_sysattr',6116,'pgstrom');
 CREATE FUNCTION pgstrom.gstore_fdw_sysattr_in(cstring)
   RETURNS pgstrom.gstore_fdw_sysattr
@@ -54,7 +69,8 @@ CREATE TYPE pgstrom.gstore_fdw_sysattr
   ALIGNMENT = int4
 );
 
-CREATE FUNCTION pgstrom.gstore_fdw_replication_base(regclass,int)
+CREATE FUNCTION pgstrom.gstore_fdw_replication_base(regclass,int,
+													bigint = -1)
   RETURNS bytea
   AS 'MODULE_PATHNAME','pgstrom_gstore_fdw_replication_base'
   LANGUAGE C STRICT;
@@ -66,6 +82,576 @@ CREATE FUNCTION pgstrom.gstore_fdw_replication_redo(regclass, bigint,
   AS 'MODULE_PATHNAME','pgstrom_gstore_fdw_replication_redo'
   LANGUAGE C STRICT;
 
+--
+-- Approximate aggregations based on sketches
+--
+CREATE FUNCTION pgstrom.hll_hash(int2)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_hash'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_hash(int4)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_hash'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_hash(int8)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_hash'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_hash(date)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_hash'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_hash(text)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_hash'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_hash(bytea)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_hash'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_hash(uuid)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_hash'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_bucket(int8)
+  RETURNS int4
+  AS 'MODULE_PATHNAME','pgstrom_hll_bucket'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_rank(int8)
+  RETURNS int4
+  AS 'MODULE_PATHNAME','pgstrom_hll_rank'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.phll(int4,int4)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_partial_hll'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_count_accum(bytea,anyelement)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_hll_count_accum'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_merge_accum(bytea,int8)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_hll_merge_accum'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_combine(bytea,bytea)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_hll_combine'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.hll_count_final(bytea)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_hll_count_final'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE AGGREGATE pgstrom.hll_count(anyelement)
+(
+  sfunc = pgstrom.hll_count_accum,
+  stype = bytea,
+  finalfunc = pgstrom.hll_count_final,
+  combinefunc = pgstrom.hll_combine,
+  parallel = safe
+);
+
+CREATE AGGREGATE pgstrom.hll_merge(int8)
+(
+  sfunc = pgstrom.hll_merge_accum,
+  stype = bytea,
+  finalfunc = pgstrom.hll_count_final,
+  combinefunc = pgstrom.hll_combine,
+  parallel = safe
+);
+
+CREATE FUNCTION pgstrom.dds_bucket(float8)
+  RETURNS int4
+  AS 'MODULE_PATHNAME','pgstrom_dds_bucket'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.pdds(int4,int8,float8)
+  RETURNS float8[]
+  AS 'MODULE_PATHNAME','pgstrom_partial_dds'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.dds_accum(bytea,float8,float8)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_dds_accum'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.dds_merge_accum(bytea,float8[])
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_dds_merge_accum'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.dds_combine(bytea,bytea)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_dds_combine'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.dds_final(bytea)
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_dds_final'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE AGGREGATE pgstrom.approx_percentile(float8,float8)
+(
+  sfunc = pgstrom.dds_accum,
+  stype = bytea,
+  finalfunc = pgstrom.dds_final,
+  combinefunc = pgstrom.dds_combine,
+  parallel = safe
+);
+
+CREATE AGGREGATE pgstrom.dds_merge(float8[])
+(
+  sfunc = pgstrom.dds_merge_accum,
+  stype = bytea,
+  finalfunc = pgstrom.dds_final,
+  combinefunc = pgstrom.dds_combine,
+  parallel = safe
+);
+
+---
+--- Exact SUM/AVG of NUMERIC(p,s) by scaled integers
+---
+CREATE FUNCTION pgstrom.numeric_scaled_hi(numeric,int4)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_numeric_scaled_hi'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.numeric_scaled_lo(numeric,int4)
+  RETURNS int8
+  AS 'MODULE_PATHNAME','pgstrom_numeric_scaled_lo'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.psum_numeric(int8,int8,int4)
+  RETURNS numeric
+  AS 'MODULE_PATHNAME','pgstrom_partial_sum_numeric'
+  LANGUAGE C STRICT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.pavg_numeric(int8,int8,int8,int4)
+  RETURNS numeric[]
+  AS 'MODULE_PATHNAME','pgstrom_partial_avg_numeric'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.favg_accum(numeric[], numeric[])
+  RETURNS numeric[]
+  AS 'MODULE_PATHNAME','pgstrom_final_avg_numeric_exact_accum'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.favg_final(numeric[])
+  RETURNS numeric
+  AS 'MODULE_PATHNAME','pgstrom_final_avg_numeric_exact_final'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE pgstrom.favg(numeric[])
+(
+  sfunc = pgstrom.favg_accum,
+  stype = numeric[],
+  finalfunc = pgstrom.favg_final,
+  parallel = safe
+);
+
+---
+--- mode() on the histogram of values made by GpuPreAgg
+---
+CREATE FUNCTION pgstrom.mode_merge_accum(internal,anyelement,int8)
+  RETURNS internal
+  AS 'MODULE_PATHNAME','pgstrom_mode_merge_accum'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+CREATE FUNCTION pgstrom.mode_merge_final(internal,anyelement,int8)
+  RETURNS anyelement
+  AS 'MODULE_PATHNAME','pgstrom_mode_merge_final'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE AGGREGATE pgstrom.mode_merge(anyelement,int8)
+(
+  sfunc = pgstrom.mode_merge_accum,
+  stype = internal,
+  finalfunc = pgstrom.mode_merge_final,
+  finalfunc_extra,
+  parallel = safe
+);
+
+---
+--- Fixed-width time bucketing
+---
+CREATE FUNCTION pgstrom.time_bucket(interval,timestamp)
+  RETURNS timestamp
+  AS 'MODULE_PATHNAME','pgstrom_time_bucket_timestamp'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.time_bucket(interval,timestamptz)
+  RETURNS timestamptz
+  AS 'MODULE_PATHNAME','pgstrom_time_bucket_timestamptz'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+---
+--- Vector distance functions on float2/float4/float8 arrays
+---
+CREATE FUNCTION pgstrom.vector_l2_distance(float2[],float2[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_l2_distance'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_l2_distance(float4[],float4[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_l2_distance'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_l2_distance(float8[],float8[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_l2_distance'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_inner_product(float2[],float2[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_inner_product'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_inner_product(float4[],float4[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_inner_product'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_inner_product(float8[],float8[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_inner_product'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_negative_inner_product(float2[],float2[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_negative_inner_product'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_negative_inner_product(float4[],float4[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_negative_inner_product'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_negative_inner_product(float8[],float8[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_negative_inner_product'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_cosine_distance(float2[],float2[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_cosine_distance'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_cosine_distance(float4[],float4[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_cosine_distance'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+CREATE FUNCTION pgstrom.vector_cosine_distance(float8[],float8[])
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_vector_cosine_distance'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+CREATE OPERATOR pg_catalog.<-> (
+  PROCEDURE = pgstrom.vector_l2_distance,
+  LEFTARG = float2[],
+  RIGHTARG = float2[],
+  COMMUTATOR = <->
+);
+CREATE OPERATOR pg_catalog.<-> (
+  PROCEDURE = pgstrom.vector_l2_distance,
+  LEFTARG = float4[],
+  RIGHTARG = float4[],
+  COMMUTATOR = <->
+);
+CREATE OPERATOR pg_catalog.<-> (
+  PROCEDURE = pgstrom.vector_l2_distance,
+  LEFTARG = float8[],
+  RIGHTARG = float8[],
+  COMMUTATOR = <->
+);
+CREATE OPERATOR pg_catalog.<#> (
+  PROCEDURE = pgstrom.vector_negative_inner_product,
+  LEFTARG = float2[],
+  RIGHTARG = float2[],
+  COMMUTATOR = <#>
+);
+CREATE OPERATOR pg_catalog.<#> (
+  PROCEDURE = pgstrom.vector_negative_inner_product,
+  LEFTARG = float4[],
+  RIGHTARG = float4[],
+  COMMUTATOR = <#>
+);
+CREATE OPERATOR pg_catalog.<#> (
+  PROCEDURE = pgstrom.vector_negative_inner_product,
+  LEFTARG = float8[],
+  RIGHTARG = float8[],
+  COMMUTATOR = <#>
+);
+CREATE OPERATOR pg_catalog.<=> (
+  PROCEDURE = pgstrom.vector_cosine_distance,
+  LEFTARG = float2[],
+  RIGHTARG = float2[],
+  COMMUTATOR = <=>
+);
+CREATE OPERATOR pg_catalog.<=> (
+  PROCEDURE = pgstrom.vector_cosine_distance,
+  LEFTARG = float4[],
+  RIGHTARG = float4[],
+  COMMUTATOR = <=>
+);
+CREATE OPERATOR pg_catalog.<=> (
+  PROCEDURE = pgstrom.vector_cosine_distance,
+  LEFTARG = float8[],
+  RIGHTARG = float8[],
+  COMMUTATOR = <=>
+);
+
+CREATE FUNCTION pgstrom.vector_knn_join(text,    -- outer query
+                                        text,    -- inner query
+                                        int,     -- k
+                                        text = 'l2')
+  RETURNS TABLE (outer_id bigint, inner_id bigint, rank int, distance float8)
+  AS 'MODULE_PATHNAME','pgstrom_vector_knn_join'
+  LANGUAGE C STRICT VOLATILE;
+
+---
+--- Export of Arrow_Fdw columns to GPU buffer
+---
+CREATE FUNCTION
+pgstrom.arrow_fdw_export_columns(regclass, text[] = null, int = null)
+  RETURNS text
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_export_columns'
+  LANGUAGE C CALLED ON NULL INPUT;
+
+CREATE FUNCTION
+pgstrom.arrow_fdw_export_columns_pinned(regclass, text[] = null, int = null)
+  RETURNS text
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_export_columns_pinned'
+  LANGUAGE C CALLED ON NULL INPUT;
+
+---
+--- Server side export of query results to Apache Arrow file
+---
+CREATE FUNCTION
+pgstrom.arrow_fdw_export_query(text, text)
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_export_query'
+  LANGUAGE C STRICT;
+
+---
+--- Query results as Apache Arrow IPC stream
+---
+CREATE FUNCTION
+pgstrom.arrow_fdw_stream_query(text)
+  RETURNS SETOF bytea
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_stream_query'
+  LANGUAGE C STRICT;
+
+---
+--- GPU accelerated import of CSV files to Arrow_Fdw
+---
+CREATE FUNCTION
+pgstrom.arrow_fdw_import_csv(regclass, text, bool = false, text = ',')
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_import_csv'
+  LANGUAGE C STRICT;
+
+---
+--- Columnar cache of heap tables
+---
+CREATE FUNCTION pgstrom.ccache_invalidator()
+  RETURNS trigger
+  AS 'MODULE_PATHNAME','pgstrom_ccache_invalidator'
+  LANGUAGE C STRICT;
+
+CREATE FUNCTION pgstrom.__ccache_invalidate(regclass)
+  RETURNS int
+  AS 'MODULE_PATHNAME','pgstrom_ccache_invalidate'
+  LANGUAGE C STRICT;
+
+CREATE FUNCTION public.pgstrom_ccache_enabled(regclass)
+  RETURNS text
+  AS $$
+BEGIN
+  EXECUTE format('DROP TRIGGER IF EXISTS __pgstrom_ccache_row_inval ON %s;'
+                 'DROP TRIGGER IF EXISTS __pgstrom_ccache_stmt_inval ON %s;'
+                 'CREATE TRIGGER __pgstrom_ccache_row_inval '
+                 '  AFTER INSERT OR UPDATE OR DELETE ON %s '
+                 '  FOR EACH ROW EXECUTE PROCEDURE pgstrom.ccache_invalidator();'
+                 'CREATE TRIGGER __pgstrom_ccache_stmt_inval '
+                 '  AFTER TRUNCATE ON %s '
+                 '  FOR EACH STATEMENT EXECUTE PROCEDURE pgstrom.ccache_invalidator();'
+                 'ALTER TABLE %s ENABLE ALWAYS TRIGGER __pgstrom_ccache_row_inval;'
+                 'ALTER TABLE %s ENABLE ALWAYS TRIGGER __pgstrom_ccache_stmt_inval;',
+                 $1, $1, $1, $1, $1, $1);
+  PERFORM pgstrom.__ccache_invalidate($1);
+  RETURN 'enabled';
+END
+$$ LANGUAGE 'plpgsql';
+
+CREATE FUNCTION public.pgstrom_ccache_disabled(regclass)
+  RETURNS text
+  AS $$
+BEGIN
+  EXECUTE format('DROP TRIGGER IF EXISTS __pgstrom_ccache_row_inval ON %s;'
+                 'DROP TRIGGER IF EXISTS __pgstrom_ccache_stmt_inval ON %s;',
+                 $1, $1);
+  PERFORM pgstrom.__ccache_invalidate($1);
+  RETURN 'disabled';
+END
+$$ LANGUAGE 'plpgsql';
+
+CREATE FUNCTION public.pgstrom_ccache_prewarm(regclass)
+  RETURNS int
+  AS 'MODULE_PATHNAME','pgstrom_ccache_prewarm'
+  LANGUAGE C STRICT;
+
+CREATE TYPE pgstrom.__pgstrom_ccache_info AS (
+  database_id  oid,
+  table_id     regclass,
+  block_nr     int,
+  nitems       bigint,
+  length       bigint,
+  ctime        timestamptz,
+  atime        timestamptz
+);
+CREATE FUNCTION pgstrom.pgstrom_ccache_info()
+  RETURNS SETOF pgstrom.__pgstrom_ccache_info
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C VOLATILE;
+CREATE VIEW pgstrom.ccache_info AS
+  SELECT * FROM pgstrom.pgstrom_ccache_info();
+
+CREATE TYPE pgstrom.__pgstrom_ccache_builder_info AS (
+  builder_id   int,
+  state        text,
+  database_id  oid,
+  table_id     regclass,
+  block_nr     int
+);
+CREATE FUNCTION pgstrom.pgstrom_ccache_builder_info()
+  RETURNS SETOF pgstrom.__pgstrom_ccache_builder_info
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C VOLATILE;
+CREATE VIEW pgstrom.ccache_builder_info AS
+  SELECT * FROM pgstrom.pgstrom_ccache_builder_info();
+
+--
+-- Cumulative statistics of GPU devices
+--
+CREATE TYPE pgstrom.__pgstrom_stat_gpu_device AS (
+  device_nr        int,
+  num_contexts     int,
+  running_tasks    int,
+  processed_tasks  bigint,
+  oom_retries      bigint,
+  busy_time        float8,
+  h2d_bytes        bigint,
+  d2h_bytes        bigint,
+  gpudirect_bytes  bigint
+);
+CREATE FUNCTION pgstrom.pgstrom_stat_gpu_device()
+  RETURNS SETOF pgstrom.__pgstrom_stat_gpu_device
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C VOLATILE;
+CREATE VIEW pgstrom.pg_stat_gpu_device AS
+  SELECT * FROM pgstrom.pgstrom_stat_gpu_device();
+
+CREATE TYPE pgstrom.__pgstrom_stat_gpu_memory AS (
+  device_nr        int,
+  kind             text,
+  segment_size     bigint,
+  num_segments     bigint,
+  segment_usage    bigint,
+  chunk_usage      bigint,
+  fragmentation    float8,
+  num_allocs       bigint,
+  num_failures     bigint
+);
+CREATE FUNCTION pgstrom.pgstrom_stat_gpu_memory()
+  RETURNS SETOF pgstrom.__pgstrom_stat_gpu_memory
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C VOLATILE;
+CREATE VIEW pgstrom.pg_stat_gpu_memory AS
+  SELECT * FROM pgstrom.pgstrom_stat_gpu_memory();
+
+CREATE TYPE pgstrom.__pgstrom_stat_gpu_program_cache AS (
+  cache_size       bigint,
+  cache_usage      bigint,
+  num_entries      bigint,
+  hits             bigint,
+  misses           bigint,
+  evictions        bigint,
+  builds           bigint,
+  build_failures   bigint,
+  file_loads       bigint,
+  build_time       float8,
+  avg_build_time   float8
+);
+CREATE FUNCTION pgstrom.pgstrom_stat_gpu_program_cache()
+  RETURNS pgstrom.__pgstrom_stat_gpu_program_cache
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C VOLATILE;
+CREATE VIEW pgstrom.pg_stat_gpu_program_cache AS
+  SELECT * FROM pgstrom.pgstrom_stat_gpu_program_cache();
+
+--
+-- Sampled runtime statistics of GPU plan nodes
+--
+CREATE TYPE pgstrom.__pgstrom_gpu_query_samples AS (
+  dbid             oid,
+  userid           oid,
+  queryid          bigint,
+  node_name        text,
+  is_worker        bool,
+  chunks           bigint,
+  bytes_loaded     bigint,
+  fallbacks        bigint,
+  load_time        float8,
+  jit_wait_time    float8,
+  gpu_exec_time    float8,
+  fallback_time    float8,
+  sampled_at       timestamptz
+);
+CREATE FUNCTION pgstrom.pgstrom_gpu_query_samples()
+  RETURNS SETOF pgstrom.__pgstrom_gpu_query_samples
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C VOLATILE;
+CREATE VIEW pgstrom.gpu_query_stats AS
+  SELECT dbid, userid, queryid, node_name,
+         count(*) FILTER (WHERE NOT is_worker) calls,
+         count(*) samples,
+         sum(chunks) chunks,
+         sum(bytes_loaded) bytes_loaded,
+         sum(fallbacks) fallbacks,
+         sum(load_time) load_time,
+         sum(jit_wait_time) jit_wait_time,
+         sum(gpu_exec_time) gpu_exec_time,
+         sum(fallback_time) fallback_time,
+         max(sampled_at) last_sampled
+    FROM pgstrom.pgstrom_gpu_query_samples()
+   GROUP BY dbid, userid, queryid, node_name;
+
+CREATE FUNCTION pgstrom.gpu_query_stats_reset()
+  RETURNS void
+  AS 'MODULE_PATHNAME','pgstrom_gpu_query_stats_reset'
+  LANGUAGE C VOLATILE STRICT;
+
+--
+-- BRIN index supports
+--
+CREATE FUNCTION pgstrom.gpu_brin_summarize_new_values(regclass)
+  RETURNS int
+  AS 'MODULE_PATHNAME','pgstrom_gpu_brin_summarize_new_values'
+  LANGUAGE C STRICT;
+
+--
+-- B-tree index supports
+--
+CREATE FUNCTION pgstrom.gpu_btree_build(regclass)
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_gpu_btree_build'
+  LANGUAGE C STRICT;
+
+--
+-- GPU accelerated ANALYZE
+--
+CREATE FUNCTION pgstrom.gpu_analyze(regclass)
+  RETURNS void
+  AS 'MODULE_PATHNAME','pgstrom_gpu_analyze'
+  LANGUAGE C STRICT;
+
+--
+-- Functions/Languages to support PL/CUDA (renew at v3.0)
+--
+CREATE FUNCTION pgstrom.plcuda_function_validator(oid)
+  RETURNS void
+  AS 'MODULE_PATHNAME','pgstrom_plcuda_validator'
+  LANGUAGE C STRICT;
+
+CREATE FUNCTION pgstrom.plcuda_function_handler()
+  RETURNS language_handler
+  AS 'MODULE_PATHNAME','pgstrom_plcuda_handler'
+  LANGUAGE C STRICT;
+
+CREATE LANGUAGE plcuda
+  HANDLER pgstrom.plcuda_function_handler
+  VALIDATOR pgstrom.plcuda_function_validator;
+COMMENT ON LANGUAGE plcuda IS 'PL/CUDA procedural language';
+
 ---
 --- Deprecated functions
 ---
@@ -29,6 +29,12 @@ Datum pgstrom_final_avg_int8_final(PG_FUNCTION_ARGS);
 Datum pgstrom_final_avg_float8_accum(PG_FUNCTION_ARGS);
 Datum pgstrom_final_avg_float8_final(PG_FUNCTION_ARGS);
 Datum pgstrom_final_avg_numeric_final(PG_FUNCTION_ARGS);
+Datum pgstrom_numeric_scaled_hi(PG_FUNCTION_ARGS);
+Datum pgstrom_numeric_scaled_lo(PG_FUNCTION_ARGS);
+Datum pgstrom_partial_sum_numeric(PG_FUNCTION_ARGS);
+Datum pgstrom_partial_avg_numeric(PG_FUNCTION_ARGS);
+Datum pgstrom_final_avg_numeric_exact_accum(PG_FUNCTION_ARGS);
+Datum pgstrom_final_avg_numeric_exact_final(PG_FUNCTION_ARGS);
 Datum pgstrom_partial_min_any(PG_FUNCTION_ARGS);
 Datum pgstrom_partial_max_any(PG_FUNCTION_ARGS);
 Datum pgstrom_partial_sum_any(PG_FUNCTION_ARGS);
@@ -46,6 +52,22 @@ Datum pgstrom_float8_stddev_samp_numeric(PG_FUNCTION_ARGS);
 Datum pgstrom_float8_stddev_pop_numeric(PG_FUNCTION_ARGS);
 Datum pgstrom_float8_var_samp_numeric(PG_FUNCTION_ARGS);
 Datum pgstrom_float8_var_pop_numeric(PG_FUNCTION_ARGS);
+Datum pgstrom_hll_hash(PG_FUNCTION_ARGS);
+Datum pgstrom_hll_bucket(PG_FUNCTION_ARGS);
+Datum pgstrom_hll_rank(PG_FUNCTION_ARGS);
+Datum pgstrom_partial_hll(PG_FUNCTION_ARGS);
+Datum pgstrom_hll_count_accum(PG_FUNCTION_ARGS);
+Datum pgstrom_hll_merge_accum(PG_FUNCTION_ARGS);
+Datum pgstrom_hll_combine(PG_FUNCTION_ARGS);
+Datum pgstrom_hll_count_final(PG_FUNCTION_ARGS);
+Datum pgstrom_dds_bucket(PG_FUNCTION_ARGS);
+Datum pgstrom_partial_dds(PG_FUNCTION_ARGS);
+Datum pgstrom_dds_accum(PG_FUNCTION_ARGS);
+Datum pgstrom_dds_merge_accum(PG_FUNCTION_ARGS);
+Datum pgstrom_dds_combine(PG_FUNCTION_ARGS);
+Datum pgstrom_dds_final(PG_FUNCTION_ARGS);
+Datum pgstrom_mode_merge_accum(PG_FUNCTION_ARGS);
+Datum pgstrom_mode_merge_final(PG_FUNCTION_ARGS);
 
 /* utility to reference numeric[] */
 static inline Datum
@@ -203,6 +225,172 @@ pgstrom_final_avg_numeric_final(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_final_avg_numeric_final);
 
+/*
+ * Exact SUM/AVG of NUMERIC(p,s)
+ *
+ * GpuPreAgg accumulates X * 10^s as a pair of int8 partial sums; upper
+ * (signed) and lower (unsigned) 32bit parts of the scaled integer.
+ */
+static Datum
+numeric_power10(int32 scale)
+{
+	return DirectFunctionCall2(numeric_power,
+							   DirectFunctionCall1(int4_numeric,
+												   Int32GetDatum(10)),
+							   DirectFunctionCall1(int4_numeric,
+												   Int32GetDatum(scale)));
+}
+
+static int64
+numeric_to_scaled_integer(Datum value, int32 scale)
+{
+	value = DirectFunctionCall2(numeric_mul, value, numeric_power10(scale));
+
+	return DatumGetInt64(DirectFunctionCall1(numeric_int8, value));
+}
+
+static Datum
+numeric_from_scaled_parts(int64 hi, int64 lo, int32 scale)
+{
+	Datum		value;
+
+	value = DirectFunctionCall2(numeric_mul,
+								DirectFunctionCall1(int8_numeric,
+													Int64GetDatum(hi)),
+								DirectFunctionCall1(int8_numeric,
+													Int64GetDatum(1L << 32)));
+	value = DirectFunctionCall2(numeric_add,
+								value,
+								DirectFunctionCall1(int8_numeric,
+													Int64GetDatum(lo)));
+	value = DirectFunctionCall2(numeric_div, value, numeric_power10(scale));
+
+	return DirectFunctionCall2(numeric_round, value, Int32GetDatum(scale));
+}
+
+/*
+ * pgstrom.numeric_scaled_hi(numeric,int4)
+ */
+Datum
+pgstrom_numeric_scaled_hi(PG_FUNCTION_ARGS)
+{
+	int64		ival = numeric_to_scaled_integer(PG_GETARG_DATUM(0),
+												 PG_GETARG_INT32(1));
+	PG_RETURN_INT64(ival >> 32);
+}
+PG_FUNCTION_INFO_V1(pgstrom_numeric_scaled_hi);
+
+/*
+ * pgstrom.numeric_scaled_lo(numeric,int4)
+ */
+Datum
+pgstrom_numeric_scaled_lo(PG_FUNCTION_ARGS)
+{
+	int64		ival = numeric_to_scaled_integer(PG_GETARG_DATUM(0),
+												 PG_GETARG_INT32(1));
+	PG_RETURN_INT64(ival & 0xffffffffL);
+}
+PG_FUNCTION_INFO_V1(pgstrom_numeric_scaled_lo);
+
+/*
+ * pgstrom.psum_numeric(int8,int8,int4)
+ */
+Datum
+pgstrom_partial_sum_numeric(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_DATUM(numeric_from_scaled_parts(PG_GETARG_INT64(0),
+											  PG_GETARG_INT64(1),
+											  PG_GETARG_INT32(2)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_partial_sum_numeric);
+
+/*
+ * pgstrom.pavg_numeric(int8,int8,int8,int4)
+ */
+Datum
+pgstrom_partial_avg_numeric(PG_FUNCTION_ARGS)
+{
+	int64		nrows = (PG_ARGISNULL(0) ? 0 : PG_GETARG_INT64(0));
+	int64		hi = (PG_ARGISNULL(1) ? 0 : PG_GETARG_INT64(1));
+	int64		lo = (PG_ARGISNULL(2) ? 0 : PG_GETARG_INT64(2));
+	ArrayType  *result;
+	Datum		items[2];
+
+	if (PG_ARGISNULL(3))
+		elog(ERROR, "Bug? scale of pgstrom.pavg_numeric is NULL");
+	items[0] = DirectFunctionCall1(int8_numeric, Int64GetDatum(nrows));
+	items[1] = numeric_from_scaled_parts(hi, lo, PG_GETARG_INT32(3));
+	result = construct_array(items, 2, NUMERICOID, -1, false, 'i');
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+PG_FUNCTION_INFO_V1(pgstrom_partial_avg_numeric);
+
+Datum
+pgstrom_final_avg_numeric_exact_accum(PG_FUNCTION_ARGS)
+{
+	MemoryContext	aggcxt;
+	MemoryContext	oldcxt;
+	ArrayType	   *xarray;
+	ArrayType	   *yarray;
+	Datum		   *x, *y;
+	Datum			items[2];
+	int				nx, ny;
+
+	if (!AggCheckCallContext(fcinfo, &aggcxt))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+	}
+	yarray = PG_GETARG_ARRAYTYPE_P(1);
+	if (PG_ARGISNULL(0))
+	{
+		oldcxt = MemoryContextSwitchTo(aggcxt);
+		xarray = PG_GETARG_ARRAYTYPE_P_COPY(1);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	else
+	{
+		xarray = PG_GETARG_ARRAYTYPE_P(0);
+		deconstruct_array(xarray, NUMERICOID, -1, false, 'i',
+						  &x, NULL, &nx);
+		deconstruct_array(yarray, NUMERICOID, -1, false, 'i',
+						  &y, NULL, &ny);
+		if (nx != 2 || ny != 2)
+			elog(ERROR, "Bug? unexpected partial state of exact numeric avg");
+		items[0] = DirectFunctionCall2(numeric_add, x[0], y[0]);
+		items[1] = DirectFunctionCall2(numeric_add, x[1], y[1]);
+
+		oldcxt = MemoryContextSwitchTo(aggcxt);
+		xarray = construct_array(items, 2, NUMERICOID, -1, false, 'i');
+		MemoryContextSwitchTo(oldcxt);
+	}
+	PG_RETURN_POINTER(xarray);
+}
+PG_FUNCTION_INFO_V1(pgstrom_final_avg_numeric_exact_accum);
+
+Datum
+pgstrom_final_avg_numeric_exact_final(PG_FUNCTION_ARGS)
+{
+	ArrayType	   *xarray = PG_GETARG_ARRAYTYPE_P(0);
+	Datum		   *x;
+	int				nx;
+
+	deconstruct_array(xarray, NUMERICOID, -1, false, 'i',
+					  &x, NULL, &nx);
+	if (nx != 2)
+		elog(ERROR, "Bug? unexpected partial state of exact numeric avg");
+	/* no rows were accumulated */
+	if (DatumGetBool(DirectFunctionCall2(numeric_eq, x[0],
+							DirectFunctionCall1(int8_numeric,
+												Int64GetDatum(0)))))
+		PG_RETURN_NULL();
+	return DirectFunctionCall2(numeric_div, x[1], x[0]);
+}
+PG_FUNCTION_INFO_V1(pgstrom_final_avg_numeric_exact_final);
+
 /*
  * pgstrom.pmin(anyelement)
  */
@@ -429,3 +617,608 @@ pgstrom_float8_var_pop_numeric(PG_FUNCTION_ARGS)
 	PG_RETURN_NUMERIC(DirectFunctionCall1(float8_numeric, datum));
 }
 PG_FUNCTION_INFO_V1(pgstrom_float8_var_pop_numeric);
+
+/*
+ * Approximate aggregations based on sketches
+ *
+ * pgstrom.hll_count(anyelement) estimates number of distinct values using
+ * HyperLogLog with HLL_NUM_REGISTERS registers. GpuPreAgg groups the rows
+ * by the register index (hll_bucket) and takes the maximum rank of hash
+ * values (hll_rank) on the device, then pgstrom.hll_merge() merges them.
+ *
+ * pgstrom.approx_percentile(float8,float8) is based on DDSketch that counts
+ * values for each logarithmic bucket (dds_bucket), with relative accuracy
+ * of DDS_RELATIVE_ACCURACY. GpuPreAgg groups the rows by the bucket, then
+ * pgstrom.dds_merge() merges the counters.
+ *
+ * These functions must be consistent to the device code in cuda_utils.h.
+ */
+static uint32
+__hll_hash_datum(Oid type_oid, Oid collid, Datum datum)
+{
+	devtype_info   *dtype = pgstrom_devtype_lookup(type_oid);
+	TypeCacheEntry *tcache;
+
+	if (dtype && dtype->hash_func)
+	{
+		if (dtype->type_length == -1)
+			datum = PointerGetDatum(PG_DETOAST_DATUM_PACKED(datum));
+		return dtype->hash_func(dtype, datum);
+	}
+	/* elsewhere, use the hash function of the type for CPU only */
+	tcache = lookup_type_cache(type_oid, TYPECACHE_HASH_PROC_FINFO);
+	if (!OidIsValid(tcache->hash_proc_finfo.fn_oid))
+		elog(ERROR, "could not identify a hash function for type %s",
+			 format_type_be(type_oid));
+	return DatumGetUInt32(FunctionCall1Coll(&tcache->hash_proc_finfo,
+											collid, datum));
+}
+
+static inline int32
+__hll_bucket(uint32 hash)
+{
+	return (hash >> (32 - HLL_REGISTER_BITS));
+}
+
+static inline int32
+__hll_rank(uint32 hash)
+{
+	uint32		bits = (hash << HLL_REGISTER_BITS);
+
+	return (bits == 0 ? 32 - HLL_REGISTER_BITS : __builtin_clz(bits)) + 1;
+}
+
+Datum
+pgstrom_hll_hash(PG_FUNCTION_ARGS)
+{
+	Oid		type_oid = get_fn_expr_argtype(fcinfo->flinfo, 0);
+
+	PG_RETURN_INT64((int64)__hll_hash_datum(type_oid,
+											PG_GET_COLLATION(),
+											PG_GETARG_DATUM(0)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_hll_hash);
+
+Datum
+pgstrom_hll_bucket(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT32(__hll_bucket((uint32)PG_GETARG_INT64(0)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_hll_bucket);
+
+Datum
+pgstrom_hll_rank(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT32(__hll_rank((uint32)PG_GETARG_INT64(0)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_hll_rank);
+
+/*
+ * pgstrom.phll(int4,int4) - packs a pair of register index and rank
+ */
+Datum
+pgstrom_partial_hll(PG_FUNCTION_ARGS)
+{
+	int32	bucket = PG_GETARG_INT32(0);
+	int32	rank = PG_GETARG_INT32(1);
+
+	PG_RETURN_INT64(((int64)bucket << 8) | (int64)(rank & 0xff));
+}
+PG_FUNCTION_INFO_V1(pgstrom_partial_hll);
+
+static bytea *
+__hll_fetch_state(FunctionCallInfo fcinfo)
+{
+	MemoryContext	aggcxt;
+	bytea		   *state;
+
+	if (!AggCheckCallContext(fcinfo, &aggcxt))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+	if (!PG_ARGISNULL(0))
+		return (bytea *)PG_GETARG_POINTER(0);
+
+	state = MemoryContextAllocZero(aggcxt, VARHDRSZ + HLL_NUM_REGISTERS);
+	SET_VARSIZE(state, VARHDRSZ + HLL_NUM_REGISTERS);
+	return state;
+}
+
+static inline void
+__hll_update_state(bytea *state, int32 bucket, int32 rank)
+{
+	uint8	   *regs = (uint8 *)VARDATA(state);
+
+	if (bucket < 0 || bucket >= HLL_NUM_REGISTERS)
+		elog(ERROR, "HLL register index out of range: %d", bucket);
+	if (regs[bucket] < rank)
+		regs[bucket] = rank;
+}
+
+Datum
+pgstrom_hll_count_accum(PG_FUNCTION_ARGS)
+{
+	bytea	   *state;
+	uint32		hash;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+	state = __hll_fetch_state(fcinfo);
+	hash = __hll_hash_datum(get_fn_expr_argtype(fcinfo->flinfo, 1),
+							PG_GET_COLLATION(),
+							PG_GETARG_DATUM(1));
+	__hll_update_state(state, __hll_bucket(hash), __hll_rank(hash));
+
+	PG_RETURN_POINTER(state);
+}
+PG_FUNCTION_INFO_V1(pgstrom_hll_count_accum);
+
+Datum
+pgstrom_hll_merge_accum(PG_FUNCTION_ARGS)
+{
+	bytea	   *state;
+	int64		pvalue;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+	state = __hll_fetch_state(fcinfo);
+	pvalue = PG_GETARG_INT64(1);
+	__hll_update_state(state, (int32)(pvalue >> 8), (int32)(pvalue & 0xff));
+
+	PG_RETURN_POINTER(state);
+}
+PG_FUNCTION_INFO_V1(pgstrom_hll_merge_accum);
+
+Datum
+pgstrom_hll_combine(PG_FUNCTION_ARGS)
+{
+	bytea	   *state;
+	uint8	   *regs_x;
+	uint8	   *regs_y;
+	int			i;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+	state = __hll_fetch_state(fcinfo);
+	regs_x = (uint8 *)VARDATA(state);
+	regs_y = (uint8 *)VARDATA(PG_GETARG_BYTEA_P(1));
+	for (i=0; i < HLL_NUM_REGISTERS; i++)
+	{
+		if (regs_x[i] < regs_y[i])
+			regs_x[i] = regs_y[i];
+	}
+	PG_RETURN_POINTER(state);
+}
+PG_FUNCTION_INFO_V1(pgstrom_hll_combine);
+
+Datum
+pgstrom_hll_count_final(PG_FUNCTION_ARGS)
+{
+	const double m = (double)HLL_NUM_REGISTERS;
+	const double two_to_32 = 4294967296.0;
+	uint8	   *regs;
+	double		alpha = 0.7213 / (1.0 + 1.079 / m);
+	double		sum = 0.0;
+	double		estimate;
+	int			nzeros = 0;
+	int			i;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_INT64(0);
+	regs = (uint8 *)VARDATA(PG_GETARG_BYTEA_P(0));
+	for (i=0; i < HLL_NUM_REGISTERS; i++)
+	{
+		sum += ldexp(1.0, -(int)regs[i]);
+		if (regs[i] == 0)
+			nzeros++;
+	}
+	estimate = alpha * m * m / sum;
+	if (estimate <= 2.5 * m && nzeros > 0)
+		estimate = m * log(m / (double)nzeros);		/* small range correction */
+	else if (estimate > two_to_32 / 30.0)
+		estimate = -two_to_32 * log(1.0 - estimate / two_to_32);
+	PG_RETURN_INT64((int64)(estimate + 0.5));
+}
+PG_FUNCTION_INFO_V1(pgstrom_hll_count_final);
+
+/*
+ * DDSketch state; array of (key, count) sorted by the key
+ */
+typedef struct
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int32		nitems;
+	float8		fraction;
+	struct {
+		int64	key;
+		int64	count;
+	} items[FLEXIBLE_ARRAY_MEMBER];
+} ddsketch_state;
+
+#define DDSKETCH_STATE_NROOMS(state)					\
+	((VARSIZE(state) - offsetof(ddsketch_state, items)) / (2 * sizeof(int64)))
+
+static int32
+__dds_bucket(float8 fval)
+{
+	int32		key;
+
+	if (isnan(fval))
+		return DDS_KEY_NAN;
+	if (isinf(fval))
+		return (fval > 0.0 ? DDS_KEY_POS_INF : DDS_KEY_NEG_INF);
+	if (fval == 0.0)
+		return 0;
+	key = (int32)ceil(log(fabs(fval)) / DDS_LOG_GAMMA) + DDS_KEY_OFFSET;
+	return (fval < 0.0 ? -key : key);
+}
+
+static float8
+__dds_value(int64 key)
+{
+	double		gamma = exp(DDS_LOG_GAMMA);
+	double		fval;
+
+	if (key == DDS_KEY_NAN)
+		return get_float8_nan();
+	if (key == DDS_KEY_POS_INF)
+		return get_float8_infinity();
+	if (key == DDS_KEY_NEG_INF)
+		return -get_float8_infinity();
+	if (key == 0)
+		return 0.0;
+	/* middle of the bucket, in the sense of relative error */
+	fval = 2.0 * exp(DDS_LOG_GAMMA * (double)(Abs(key) - DDS_KEY_OFFSET))
+		/ (gamma + 1.0);
+	return (key < 0 ? -fval : fval);
+}
+
+static ddsketch_state *
+__dds_fetch_state(FunctionCallInfo fcinfo, float8 fraction)
+{
+	MemoryContext	aggcxt;
+	ddsketch_state *state;
+	Size			sz = offsetof(ddsketch_state, items[64]);
+
+	if (!AggCheckCallContext(fcinfo, &aggcxt))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+	if (!PG_ARGISNULL(0))
+		return (ddsketch_state *)PG_GETARG_POINTER(0);
+
+	if (fraction < 0.0 || fraction > 1.0 || isnan(fraction))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("percentile value %g is not between 0 and 1",
+						fraction)));
+	state = MemoryContextAllocZero(aggcxt, sz);
+	SET_VARSIZE(state, sz);
+	state->fraction = fraction;
+	return state;
+}
+
+/*
+ * __dds_update_state - it may return a new state; the former one shall be
+ * released by the caller (nodeAgg.c) if different.
+ */
+static ddsketch_state *
+__dds_update_state(FunctionCallInfo fcinfo, ddsketch_state *state,
+				   int64 key, int64 count)
+{
+	int		head = 0;
+	int		tail = state->nitems;
+
+	/* binary search */
+	while (head < tail)
+	{
+		int		curr = (head + tail) / 2;
+
+		if (state->items[curr].key == key)
+		{
+			state->items[curr].count += count;
+			return state;
+		}
+		else if (state->items[curr].key < key)
+			head = curr + 1;
+		else
+			tail = curr;
+	}
+	/* not found, insert a new item on the 'head' */
+	if (state->nitems >= DDSKETCH_STATE_NROOMS(state))
+	{
+		MemoryContext	aggcxt;
+		ddsketch_state *temp;
+		Size			sz;
+
+		if (!AggCheckCallContext(fcinfo, &aggcxt))
+			elog(ERROR, "aggregate function called in non-aggregate context");
+		sz = offsetof(ddsketch_state, items[2 * DDSKETCH_STATE_NROOMS(state)]);
+		temp = MemoryContextAlloc(aggcxt, sz);
+		memcpy(temp, state, VARSIZE(state));
+		SET_VARSIZE(temp, sz);
+		state = temp;
+	}
+	memmove(&state->items[head + 1],
+			&state->items[head],
+			sizeof(state->items[0]) * (state->nitems - head));
+	state->items[head].key = key;
+	state->items[head].count = count;
+	state->nitems++;
+
+	return state;
+}
+
+Datum
+pgstrom_dds_bucket(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT32(__dds_bucket(PG_GETARG_FLOAT8(0)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_dds_bucket);
+
+/*
+ * pgstrom.pdds(int4,int8,float8) - packs bucket, count and fraction
+ */
+Datum
+pgstrom_partial_dds(PG_FUNCTION_ARGS)
+{
+	ArrayType  *result;
+	Datum		items[3];
+
+	items[0] = Float8GetDatum((float8)PG_GETARG_INT32(0));	/* key */
+	items[1] = Float8GetDatum((float8)PG_GETARG_INT64(1));	/* nrows */
+	items[2] = PG_GETARG_DATUM(2);							/* fraction */
+	result = construct_array(items, 3, FLOAT8OID,
+							 sizeof(float8), FLOAT8PASSBYVAL, 'd');
+	PG_RETURN_ARRAYTYPE_P(result);
+}
+PG_FUNCTION_INFO_V1(pgstrom_partial_dds);
+
+Datum
+pgstrom_dds_accum(PG_FUNCTION_ARGS)
+{
+	ddsketch_state *state;
+
+	if (PG_ARGISNULL(1) || PG_ARGISNULL(2))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+	state = __dds_fetch_state(fcinfo, PG_GETARG_FLOAT8(2));
+	state = __dds_update_state(fcinfo, state,
+							   __dds_bucket(PG_GETARG_FLOAT8(1)), 1);
+	PG_RETURN_POINTER(state);
+}
+PG_FUNCTION_INFO_V1(pgstrom_dds_accum);
+
+Datum
+pgstrom_dds_merge_accum(PG_FUNCTION_ARGS)
+{
+	ddsketch_state *state;
+	ArrayType	   *parray;
+	float8		   *pvalues;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+	parray = PG_GETARG_ARRAYTYPE_P(1);
+	if (ARR_NDIM(parray) != 1 ||
+		ARR_DIMS(parray)[0] != 3 ||
+		ARR_HASNULL(parray) ||
+		ARR_ELEMTYPE(parray) != FLOAT8OID)
+		elog(ERROR, "Bug? pgstrom.pdds() returned unexpected array");
+	pvalues = (float8 *)ARR_DATA_PTR(parray);
+	if (pvalues[1] <= 0.0)
+	{
+		/* all the rows were filtered out */
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+	state = __dds_fetch_state(fcinfo, pvalues[2]);
+	state = __dds_update_state(fcinfo, state,
+							   (int64)pvalues[0],
+							   (int64)pvalues[1]);
+	PG_RETURN_POINTER(state);
+}
+PG_FUNCTION_INFO_V1(pgstrom_dds_merge_accum);
+
+Datum
+pgstrom_dds_combine(PG_FUNCTION_ARGS)
+{
+	ddsketch_state *state;
+	ddsketch_state *other;
+	int				i;
+
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+	}
+	other = (ddsketch_state *)PG_GETARG_BYTEA_P(1);
+	state = __dds_fetch_state(fcinfo, other->fraction);
+	for (i=0; i < other->nitems; i++)
+		state = __dds_update_state(fcinfo, state,
+								   other->items[i].key,
+								   other->items[i].count);
+	PG_RETURN_POINTER(state);
+}
+PG_FUNCTION_INFO_V1(pgstrom_dds_combine);
+
+Datum
+pgstrom_dds_final(PG_FUNCTION_ARGS)
+{
+	ddsketch_state *state;
+	double			total = 0.0;
+	double			rank;
+	double			count = 0.0;
+	int				i;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+	state = (ddsketch_state *)PG_GETARG_BYTEA_P(0);
+	for (i=0; i < state->nitems; i++)
+		total += (double)state->items[i].count;
+	if (total <= 0.0)
+		PG_RETURN_NULL();
+	rank = state->fraction * (total - 1.0);
+	for (i=0; i < state->nitems; i++)
+	{
+		count += (double)state->items[i].count;
+		if (count > rank)
+			break;
+	}
+	Assert(i < state->nitems);
+	PG_RETURN_FLOAT8(__dds_value(state->items[i].key));
+}
+PG_FUNCTION_INFO_V1(pgstrom_dds_final);
+
+/*
+ * mode() on the histogram of values
+ *
+ * GpuPreAgg adds the value X itself to the grouping-keys, so it produces
+ * a per-group histogram of the values; a pair of X and the number of its
+ * occurrence. The merge functions below count the pairs.
+ */
+typedef struct
+{
+	Oid			elemtype;
+	int16		typlen;
+	bool		typbyval;
+	int			nitems;
+	int			nrooms;
+	struct {
+		Datum	value;
+		int64	count;
+	}		   *items;
+} mode_merge_state;
+
+typedef struct
+{
+	SortSupportData	ssup;
+} modeMergeSortArg;
+
+static int
+__mode_merge_item_comp(const void *__a, const void *__b, void *__arg)
+{
+	const Datum	   *a = __a;
+	const Datum	   *b = __b;
+	modeMergeSortArg *arg = __arg;
+
+	return ApplySortComparator(*a, false, *b, false, &arg->ssup);
+}
+
+Datum
+pgstrom_mode_merge_accum(PG_FUNCTION_ARGS)
+{
+	mode_merge_state *state;
+	MemoryContext	aggcxt;
+	MemoryContext	oldcxt;
+	int64			nrows;
+
+	if (!AggCheckCallContext(fcinfo, &aggcxt))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+	state = (PG_ARGISNULL(0) ? NULL : (mode_merge_state *)PG_GETARG_POINTER(0));
+	nrows = (PG_ARGISNULL(2) ? 0 : PG_GETARG_INT64(2));
+	if (PG_ARGISNULL(1) || nrows <= 0)
+	{
+		/* NULLs are skipped, or all the rows were filtered out */
+		if (!state)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	oldcxt = MemoryContextSwitchTo(aggcxt);
+	if (!state)
+	{
+		state = palloc0(sizeof(mode_merge_state));
+		state->elemtype = get_fn_expr_argtype(fcinfo->flinfo, 1);
+		if (!OidIsValid(state->elemtype))
+			elog(ERROR, "could not determine input data type");
+		get_typlenbyval(state->elemtype,
+						&state->typlen,
+						&state->typbyval);
+		state->nrooms = 64;
+		state->items = palloc(sizeof(state->items[0]) * state->nrooms);
+	}
+	else if (state->nitems >= state->nrooms)
+	{
+		state->nrooms *= 2;
+		state->items = repalloc(state->items,
+								sizeof(state->items[0]) * state->nrooms);
+	}
+	state->items[state->nitems].value = datumCopy(PG_GETARG_DATUM(1),
+												  state->typbyval,
+												  state->typlen);
+	state->items[state->nitems].count = nrows;
+	state->nitems++;
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_RETURN_POINTER(state);
+}
+PG_FUNCTION_INFO_V1(pgstrom_mode_merge_accum);
+
+Datum
+pgstrom_mode_merge_final(PG_FUNCTION_ARGS)
+{
+	mode_merge_state *state;
+	modeMergeSortArg sortArg;
+	TypeCacheEntry *tcache;
+	Datum			mode_value;
+	int64			mode_count = 0;
+	int64			curr_count = 0;
+	int				i;
+
+	Assert(AggCheckCallContext(fcinfo, NULL));
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+	state = (mode_merge_state *)PG_GETARG_POINTER(0);
+	Assert(state->nitems > 0);
+
+	/*
+	 * Same value may appear multiple times if the partial results come
+	 * from the multiple GpuPreAgg tasks, so sort the items by the value,
+	 * then sum up the counters of the same values.
+	 * Like mode() itself, the smallest one wins on ties.
+	 */
+	tcache = lookup_type_cache(state->elemtype, TYPECACHE_LT_OPR);
+	if (!OidIsValid(tcache->lt_opr))
+		elog(ERROR, "could not identify an ordering operator for type %s",
+			 format_type_be(state->elemtype));
+	memset(&sortArg, 0, sizeof(modeMergeSortArg));
+	sortArg.ssup.ssup_cxt = CurrentMemoryContext;
+	sortArg.ssup.ssup_collation = PG_GET_COLLATION();
+	PrepareSortSupportFromOrderingOp(tcache->lt_opr, &sortArg.ssup);
+	qsort_arg(state->items, state->nitems, sizeof(state->items[0]),
+			  __mode_merge_item_comp, &sortArg);
+
+	mode_value = state->items[0].value;
+	for (i=0; i < state->nitems; i++)
+	{
+		if (i > 0 && __mode_merge_item_comp(&state->items[i-1].value,
+											&state->items[i].value,
+											&sortArg) != 0)
+			curr_count = 0;
+		curr_count += state->items[i].count;
+		if (curr_count > mode_count)
+		{
+			mode_value = state->items[i].value;
+			mode_count = curr_count;
+		}
+	}
+	PG_RETURN_DATUM(datumCopy(mode_value, state->typbyval, state->typlen));
+}
+PG_FUNCTION_INFO_V1(pgstrom_mode_merge_final);
@@ -15,6 +15,7 @@ typedef enum
 	ArrowMetadataVersion__V2 = 1,		/* not supported */
 	ArrowMetadataVersion__V3 = 2,		/* not supported */
 	ArrowMetadataVersion__V4 = 3,
+	ArrowMetadataVersion__V5 = 4,
 } ArrowMetadataVersion;
 
 /*
@@ -29,6 +30,23 @@ typedef enum
 	ArrowMessageHeader__SparseTensor	= 5,
 } ArrowMessageHeader;
 
+/*
+ * CompressionType : byte
+ */
+typedef enum
+{
+	ArrowCompressionType__LZ4_FRAME	= 0,
+	ArrowCompressionType__ZSTD		= 1,
+} ArrowCompressionType;
+
+/*
+ * BodyCompressionMethod : byte
+ */
+typedef enum
+{
+	ArrowBodyCompressionMethod__BUFFER	= 0,
+} ArrowBodyCompressionMethod;
+
 /*
  * Endianness : short
  */
@@ -175,6 +193,7 @@ typedef enum
 	ArrowNodeTag__Field,
 	ArrowNodeTag__FieldNode,
 	ArrowNodeTag__Buffer,
+	ArrowNodeTag__BodyCompression,
 	ArrowNodeTag__Schema,
 	ArrowNodeTag__RecordBatch,
 	ArrowNodeTag__DictionaryBatch,
@@ -426,6 +445,16 @@ typedef struct		ArrowSchema
 	int				_num_custom_metadata;
 } ArrowSchema;
 
+/*
+ * BodyCompression
+ */
+typedef struct		ArrowBodyCompression
+{
+	ArrowNode		node;
+	ArrowCompressionType codec;
+	ArrowBodyCompressionMethod method;
+} ArrowBodyCompression;
+
 /*
  * RecordBatch
  */
@@ -439,6 +468,8 @@ typedef struct		ArrowRecordBatch
 	/* vector of Buffer */
 	ArrowBuffer	    *buffers;
 	int				_num_buffers;
+	/* optional compression of the body */
+	ArrowBodyCompression *compression;
 } ArrowRecordBatch;
 
 /*
@@ -18,7 +18,14 @@
 #include "pg_strom.h"
 #include "arrow_defs.h"
 #include "arrow_ipc.h"
+#include "parquet_defs.h"
 #include "cuda_numeric.cu"
+#ifdef WITH_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
 
 /*
  * RecordBatchState
@@ -38,6 +45,32 @@ typedef struct RecordBatchFieldState
 	size_t		extra_length;
 	int			num_children;
 	struct RecordBatchFieldState *children;
+	/* min/max statistics, if any */
+	bool		stat_valid;
+	Datum		stat_min;
+	Datum		stat_max;
+	/*
+	 * dictionary-encoded column, if dict_unitsz > 0. In this case,
+	 * @values_offset/length points the dictionary index, and the dictionary
+	 * values are located at @dict_values_* and @dict_extra_* (offset from
+	 * the head of file, not RecordBatch).
+	 */
+	int			dict_unitsz;
+	int			dict_codec;			/* ArrowCompressionType, or -1 */
+	int64		dict_nitems;
+	off_t		dict_values_offset;
+	size_t		dict_values_length;
+	off_t		dict_extra_offset;
+	size_t		dict_extra_length;
+	/*
+	 * column chunk of Parquet file, if rb_parquet. In this case,
+	 * @values_offset/length points the entire column chunk (offset from
+	 * the head of file), to be decoded on the host side.
+	 */
+	int			pq_type;			/* ParquetType */
+	int			pq_type_length;
+	int			pq_codec;			/* ParquetCodec */
+	int			pq_max_deflevel;
 } RecordBatchFieldState;
 
 typedef struct RecordBatchState
@@ -49,6 +82,8 @@ typedef struct RecordBatchState
 	off_t		rb_offset;	/* offset from the head */
 	size_t		rb_length;	/* length of the entire RecordBatch */
 	int64		rb_nitems;	/* number of items */
+	int			rb_codec;	/* ArrowCompressionType, or -1 */
+	bool		rb_parquet;	/* true, if RowGroup of Parquet file */
 	/* per column information */
 	int			ncols;
 	RecordBatchFieldState columns[FLEXIBLE_ARRAY_MEMBER];
@@ -77,6 +112,8 @@ typedef struct
 	off_t		rb_offset;	/* offset from the head */
     size_t		rb_length;	/* length of the entire RecordBatch */
     int64		rb_nitems;	/* number of items */
+	int			rb_codec;	/* ArrowCompressionType, or -1 */
+	bool		rb_parquet;	/* true, if RowGroup of Parquet file */
 	int			ncols;
 	int			nfields;	/* length of fstate[] array */
 	RecordBatchFieldState fstate[FLEXIBLE_ARRAY_MEMBER];
@@ -140,9 +177,52 @@ typedef struct
 	MetadataCacheKey key;
 	uint32		hash;
 	bool		redo_log_written;
+	/* rows buffered by ExecForeignInsert, see arrowExecForeignInsert */
+	int			batch_size;
+	int			batch_nslots;
+	TupleTableSlot **batch_slots;
 	SQLtable	sql_table;
 } arrowWriteState;
 
+/*
+ * arrowStatsHint - qualifiers to skip RecordBatches by min/max statistics
+ */
+typedef struct
+{
+	AttrNumber	attnum;			/* referenced column */
+	int			strategy;		/* one of BT*StrategyNumber */
+	Datum		value;			/* constant value to be compared */
+	Oid			collid;			/* collation of the comparison */
+	FmgrInfo	cmp_func;		/* btree comparison function */
+	Oid			consttype;		/* for EXPLAIN */
+	/* the last dictionary checked, if dictionary-encoded column */
+	File		dict_fdesc;
+	off_t		dict_offset;
+	bool		dict_found;
+} arrowStatsHint;
+
+/*
+ * arrowPartitionValues - values of the virtual partition-key columns, parsed
+ * from the Hive-style path segments (key=value) of the file
+ */
+typedef struct
+{
+	Datum	   *values;
+	bool	   *isnull;
+} arrowPartitionValues;
+
+/*
+ * arrowScanUnit - a unit of work handed out by the rbatch_index counter;
+ * either a whole RecordBatch, or a range of rows in a large RecordBatch
+ * that is split to balance the load of parallel workers.
+ */
+typedef struct
+{
+	uint32		rb_index;		/* index of af_state->rbatches[] */
+	int64		row_start;		/* first row of the range */
+	int64		row_nitems;		/* number of rows, or -1 for whole batch */
+} arrowScanUnit;
+
 /*
  * ArrowFdwState
  */
@@ -152,10 +232,26 @@ struct ArrowFdwState
 	List	   *gpuDirectFileDescList;	/* list of GPUDirectFileDesc */
 	List	   *fdescList;				/* list of File (buffered i/o) */
 	Bitmapset  *referenced;
+	bool		writable;				/* true, if writable arrow table */
 	pg_atomic_uint32   *rbatch_index;
 	pg_atomic_uint32	__rbatch_index_local;	/* if single process exec */
 	pgstrom_data_store *curr_pds;	/* current focused buffer */
 	cl_ulong	curr_index;			/* current index to row on KDS */
+	List	   *stats_hint;			/* list of arrowStatsHint */
+	uint32		stats_nskipped;		/* # of skipped RecordBatches */
+	/* virtual partition-key columns, if 'partition_by' */
+	int			part_nkeys;
+	uint32		part_nskipped;		/* # of pruned files */
+	arrowPartitionValues *curr_partvals;
+	arrowPartitionValues **rb_partvals;	/* for each RecordBatch */
+	/* late materialization, if CPU scan with qualifiers */
+	Bitmapset  *late_refs;			/* columns referenced by late_quals */
+	ExprState  *late_quals;
+	bool	   *curr_rowmap;		/* rows that satisfy late_quals */
+	uint32		late_nskipped;		/* # of skipped RecordBatches */
+	/* units of work to scan */
+	uint32		num_units;
+	arrowScanUnit *units;
 	/* state of RecordBatches */
 	uint32		num_rbatches;
 	RecordBatchState *rbatches[FLEXIBLE_ARRAY_MEMBER];
@@ -165,6 +261,21 @@ struct ArrowFdwState
  * ArrowGpuBuffer (shared structure)
  */
 #define ARROW_GPUBUF_FORMAT__CUPY		1
+#define ARROW_GPUBUF_FORMAT__COLUMNS	2
+
+/*
+ * ArrowGpuBufferBatch - a record batch already loaded onto the GPU buffer.
+ * Apache Arrow files are only appended, so a record batch at the same file
+ * offset with the same number of rows can be reused on refresh.
+ */
+typedef struct
+{
+	dev_t		st_dev;
+	ino_t		st_ino;
+	size_t		rb_offset;
+	size_t		rb_nitems;
+	size_t		row_index;	/* position in the GPU buffer */
+} ArrowGpuBufferBatch;
 
 typedef struct 
 {
@@ -178,6 +289,9 @@ typedef struct
 	struct timespec timestamp;
 	size_t		nbytes;		/* size of device memory */
 	size_t		nrooms;
+	Oid			element_oid;
+	int			num_rbatches;	/* resident record batches; only CUPY */
+	ArrowGpuBufferBatch *rbatches;
 	/* below is used for hash */
 	Oid			frel_oid;
 	int			format;		/* one of ARROW_GPUBUF_FORMAT__* */
@@ -198,10 +312,15 @@ static shmem_startup_hook_type shmem_startup_next = NULL;
 static arrowMetadataState *arrow_metadata_state = NULL;
 static dlist_head		arrow_write_redo_list;
 static bool				arrow_fdw_enabled;				/* GUC */
+static bool				arrow_fdw_stats_hint_enabled;	/* GUC */
+static bool				arrow_fdw_late_materialization;	/* GUC */
+static bool				arrow_fdw_mmap_enabled;			/* GUC */
 static int				arrow_metadata_cache_size_kb;	/* GUC */
 static size_t			arrow_metadata_cache_size;
 static char			   *arrow_debug_row_numbers_hint;	/* GUC */
 static int				arrow_record_batch_size_kb;		/* GUC */
+static int				arrow_insert_batch_size;		/* GUC */
+static char			   *arrow_metadata_cache_dir;		/* GUC */
 static dlist_head		arrow_gpu_buffer_tracker_list;
 
 /* ---------- static functions ---------- */
@@ -209,16 +328,25 @@ static bool		arrowTypeIsEqual(ArrowField *a, ArrowField *b, int depth);
 static Oid		arrowTypeToPGTypeOid(ArrowField *field, int *typmod);
 static const char *arrowTypeToPGTypeName(ArrowField *field);
 static size_t	arrowFieldLength(ArrowField *field, int64 nitems);
-static bool		arrowSchemaCompatibilityCheck(TupleDesc tupdesc,
+static bool		arrowSchemaCompatibilityCheck(TupleDesc tupdesc, int part_nkeys,
 											  RecordBatchState *rb_state);
 static List	   *__arrowFdwExtractFilesList(List *options_list,
 										   int *p_parallel_nworkers,
 										   bool *p_writable);
 static List	   *arrowFdwExtractFilesList(List *options_list);
-static RecordBatchState *makeRecordBatchState(ArrowSchema *schema,
+static List	   *arrowFdwExtractPartitionKeys(List *options_list);
+static List	   *arrowFdwPrunePartitionFiles(TupleDesc tupdesc,
+											List *filesList,
+											List *partKeys,
+											List *quals,
+											List **p_partvals);
+static RecordBatchState *makeRecordBatchState(ArrowFileInfo *af_info,
 											  ArrowBlock *block,
 											  ArrowRecordBatch *rbatch);
 static List	   *arrowLookupOrBuildMetadataCache(File fdesc);
+static void		arrowPrefetchMetadataCache(List *filesList);
+static bool		__arrowRecordBatchIsCompressed(RecordBatchState *rb_state,
+											   Bitmapset *referenced);
 static void		pg_datum_arrow_ref(kern_data_store *kds,
 								   kern_colmeta *cmeta,
 								   size_t index,
@@ -235,8 +363,12 @@ Datum	pgstrom_arrow_fdw_handler(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_validator(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_precheck_schema(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS);
+Datum	pgstrom_arrow_fdw_export_query(PG_FUNCTION_ARGS);
+Datum	pgstrom_arrow_fdw_stream_query(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_export_cupy(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_export_cupy_pinned(PG_FUNCTION_ARGS);
+Datum	pgstrom_arrow_fdw_export_columns(PG_FUNCTION_ARGS);
+Datum	pgstrom_arrow_fdw_export_columns_pinned(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_unpin_gpu_buffer(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_put_gpu_buffer(PG_FUNCTION_ARGS);
 
@@ -276,6 +408,22 @@ baseRelIsArrowFdw(RelOptInfo *baserel)
 	return false;
 }
 
+/*
+ * baseRelHasArrowVirtualRefs
+ *
+ * It returns true, if the scan references virtual partition-key columns;
+ * they are not loaded onto the KDS, so only CPU scan can fetch them.
+ */
+bool
+baseRelHasArrowVirtualRefs(RelOptInfo *baserel)
+{
+	if (baseRelIsArrowFdw(baserel) &&
+		baserel->fdw_private != NULL &&
+		IsA(baserel->fdw_private, List))
+		return intVal(lsecond((List *)baserel->fdw_private)) != 0;
+	return false;
+}
+
 /*
  * RelationIsArrowFdw
  */
@@ -333,6 +481,8 @@ RecordBatchFieldLength(RecordBatchFieldState *fstate)
 		len += fstate->values_length;
 	if (fstate->extra_offset > 0)
 		len += fstate->extra_length;
+	if (fstate->dict_unitsz > 0)
+		len += fstate->dict_values_length + fstate->dict_extra_length;
 	len = BLCKALIGN(len);
 	for (j=0; j < fstate->num_children; j++)
 		len += RecordBatchFieldLength(&fstate->children[j]);
@@ -408,6 +558,7 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 {
 	ForeignTable   *ft = GetForeignTable(foreigntableid);
 	List		   *filesList;
+	List		   *partKeys;
 	Size			filesSizeTotal = 0;
 	Bitmapset	   *referenced = NULL;
 	BlockNumber		npages = 0;
@@ -415,6 +566,7 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 	ListCell	   *lc;
 	int				parallel_nworkers;
 	bool			writable;
+	bool			virtual_refs = false;
 	int				optimal_gpu = INT_MAX;
 	int				j, k;
 
@@ -430,6 +582,32 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 	filesList = __arrowFdwExtractFilesList(ft->options,
 										   &parallel_nworkers,
 										   &writable);
+	partKeys = arrowFdwExtractPartitionKeys(ft->options);
+	if (partKeys != NIL)
+	{
+		Relation	frel = table_open(foreigntableid, NoLock);
+		TupleDesc	tupdesc = RelationGetDescr(frel);
+		List	   *quals = NIL;
+
+		/* prune files by the partition keys */
+		foreach (lc, baserel->baserestrictinfo)
+			quals = lappend(quals, ((RestrictInfo *)lfirst(lc))->clause);
+		filesList = arrowFdwPrunePartitionFiles(tupdesc, filesList,
+												partKeys, quals, NULL);
+		/* virtual columns are not available on the device */
+		if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, referenced))
+			virtual_refs = true;
+		for (j = tupdesc->natts - list_length(partKeys);
+			 j < tupdesc->natts;
+			 j++)
+		{
+			k = j + 1 - FirstLowInvalidHeapAttributeNumber;
+			if (bms_is_member(k, referenced))
+				virtual_refs = true;
+		}
+		table_close(frel, NoLock);
+	}
+	arrowPrefetchMetadataCache(filesList);
 	foreach (lc, filesList)
 	{
 		char	   *fname = strVal(lfirst(lc));
@@ -489,7 +667,8 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 		optimal_gpu = -1;
 
 	baserel->rel_parallel_workers = parallel_nworkers;
-	baserel->fdw_private = makeInteger(optimal_gpu);
+	baserel->fdw_private = list_make2(makeInteger(optimal_gpu),
+									  makeInteger(virtual_refs));
 	baserel->pages = npages;
 	baserel->tuples = ntuples;
 	baserel->rows = ntuples *
@@ -516,7 +695,7 @@ GetOptimalGpuForArrowFdw(PlannerInfo *root, RelOptInfo *baserel)
 
 		ArrowGetForeignRelSize(root, baserel, rte->relid);
 	}
-	return intVal(baserel->fdw_private);
+	return intVal(linitial((List *)baserel->fdw_private));
 }
 
 static void
@@ -699,6 +878,8 @@ ArrowGetForeignPlan(PlannerInfo *root,
 
 typedef struct
 {
+	ArrowFileInfo  *af_info;
+	bool			compressed;
 	ArrowBuffer    *buffer_curr;
 	ArrowBuffer    *buffer_tail;
 	ArrowFieldNode *fnode_curr;
@@ -759,6 +940,143 @@ assignArrowTypeOptions(ArrowTypeOptions *attopts, const ArrowType *atype)
 	}
 }
 
+/*
+ * setupRecordBatchDictionary
+ *
+ * A dictionary-encoded field has only nullmap and dictionary index in the
+ * RecordBatch. Its values are located at the DictionaryBatch with the same
+ * identifier, so we also pick up the buffers of the DictionaryBatch.
+ */
+static void
+setupRecordBatchDictionary(setupRecordBatchContext *con,
+						   RecordBatchFieldState *fstate,
+						   ArrowField *field,
+						   int depth)
+{
+	ArrowDictionaryEncoding *dict = field->dictionary;
+	ArrowFileInfo  *af_info = con->af_info;
+	ArrowDictionaryBatch *dbatch = NULL;
+	ArrowBlock	   *block = NULL;
+	ArrowBuffer	   *buffer_curr;
+	off_t			dict_base;
+	bool			compressed;
+	int				i, nbuffers;
+
+	if (depth > 0)
+		elog(ERROR, "dictionary-encoded sub-field is not supported");
+	switch (dict->indexType.bitWidth)
+	{
+		case 8:
+		case 16:
+		case 32:
+		case 64:
+			fstate->dict_unitsz = dict->indexType.bitWidth / BITS_PER_BYTE;
+			break;
+		default:
+			elog(ERROR, "Not a supported dictionary index width: %d",
+				 dict->indexType.bitWidth);
+	}
+	switch (field->type.node.tag)
+	{
+		case ArrowNodeTag__Int:
+		case ArrowNodeTag__FloatingPoint:
+		case ArrowNodeTag__Decimal:
+		case ArrowNodeTag__Date:
+		case ArrowNodeTag__Time:
+		case ArrowNodeTag__Timestamp:
+		case ArrowNodeTag__Interval:
+		case ArrowNodeTag__FixedSizeBinary:
+			nbuffers = 2;
+			break;
+		case ArrowNodeTag__Utf8:
+		case ArrowNodeTag__Binary:
+			nbuffers = 3;
+			break;
+		default:
+			elog(ERROR, "arrow_fdw: dictionary of %s is not supported",
+				 arrowTypeName(field));
+	}
+
+	/* nullmap and dictionary index in the RecordBatch */
+	if (con->buffer_curr + 2 > con->buffer_tail)
+		elog(ERROR, "RecordBatch has less buffers than expected");
+	buffer_curr = con->buffer_curr++;
+	if (fstate->null_count > 0)
+	{
+		fstate->nullmap_offset = buffer_curr->offset;
+		fstate->nullmap_length = buffer_curr->length;
+		if (!con->compressed &&
+			fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+			elog(ERROR, "nullmap length is smaller than expected");
+		if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
+			(!con->compressed &&
+			 (fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0))
+			elog(ERROR, "nullmap is not aligned well");
+	}
+	buffer_curr = con->buffer_curr++;
+	fstate->values_offset = buffer_curr->offset;
+	fstate->values_length = buffer_curr->length;
+	if (!con->compressed &&
+		fstate->values_length < fstate->dict_unitsz * fstate->nitems)
+		elog(ERROR, "dictionary index is smaller than expected");
+	if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
+		(!con->compressed &&
+		 (fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0))
+		elog(ERROR, "dictionary index is not aligned well");
+
+	/* lookup the DictionaryBatch */
+	for (i=0; i < af_info->footer._num_dictionaries; i++)
+	{
+		ArrowDictionaryBatch *curr
+			= &af_info->dictionaries[i].body.dictionaryBatch;
+
+		if (curr->id != dict->id)
+			continue;
+		if (dbatch || curr->isDelta)
+			elog(ERROR, "arrow_fdw: delta or replacement of DictionaryBatch (id=%ld) is not supported",
+				 (long)dict->id);
+		dbatch = curr;
+		block = &af_info->footer.dictionaries[i];
+	}
+	if (!dbatch)
+		elog(ERROR, "arrow_fdw: DictionaryBatch (id=%ld) was not found",
+			 (long)dict->id);
+	if (dbatch->data._num_nodes != 1 ||
+		dbatch->data._num_buffers != nbuffers)
+		elog(ERROR, "arrow_fdw: DictionaryBatch (id=%ld) may have corruption",
+			 (long)dict->id);
+	if (dbatch->data.nodes[0].null_count > 0)
+		elog(ERROR, "arrow_fdw: DictionaryBatch with NULL is not supported");
+
+	/* dictionary values in the DictionaryBatch */
+	dict_base = block->offset + block->metaDataLength;
+	fstate->dict_nitems = dbatch->data.nodes[0].length;
+	fstate->dict_codec = (dbatch->data.compression
+						  ? dbatch->data.compression->codec : -1);
+	compressed = (fstate->dict_codec >= 0);
+	buffer_curr = &dbatch->data.buffers[1];
+	fstate->dict_values_offset = dict_base + buffer_curr->offset;
+	fstate->dict_values_length = buffer_curr->length;
+	if (!compressed &&
+		fstate->dict_values_length < arrowFieldLength(field,
+													  fstate->dict_nitems))
+		elog(ERROR, "dictionary values array is smaller than expected");
+	if ((fstate->dict_values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
+		(!compressed &&
+		 (fstate->dict_values_length & (MAXIMUM_ALIGNOF - 1)) != 0))
+		elog(ERROR, "dictionary values array is not aligned well");
+	if (nbuffers > 2)
+	{
+		buffer_curr = &dbatch->data.buffers[2];
+		fstate->dict_extra_offset = dict_base + buffer_curr->offset;
+		fstate->dict_extra_length = buffer_curr->length;
+		if ((fstate->dict_extra_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
+			(!compressed &&
+			 (fstate->dict_extra_length & (MAXIMUM_ALIGNOF - 1)) != 0))
+			elog(ERROR, "dictionary extra buffer is not aligned well");
+	}
+}
+
 static void
 setupRecordBatchField(setupRecordBatchContext *con,
 					  RecordBatchFieldState *fstate,
@@ -775,6 +1093,13 @@ setupRecordBatchField(setupRecordBatchContext *con,
 	fstate->nitems     = fnode->length;
 	fstate->null_count = fnode->null_count;
 
+	if (field->dictionary)
+	{
+		setupRecordBatchDictionary(con, fstate, field, depth);
+		assignArrowTypeOptions(&fstate->attopts, &field->type);
+		return;
+	}
+
 	switch (field->type.node.tag)
 	{
 		case ArrowNodeTag__Int:
@@ -794,19 +1119,23 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			{
 				fstate->nullmap_offset = buffer_curr->offset;
 				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-					(fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+					(!con->compressed &&
+					 (fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 					elog(ERROR, "nullmap is not aligned well");
 			}
 			buffer_curr = con->buffer_curr++;
 			fstate->values_offset = buffer_curr->offset;
 			fstate->values_length = buffer_curr->length;
-			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
+			if (!con->compressed &&
+				fstate->values_length < arrowFieldLength(field,fstate->nitems))
 				elog(ERROR, "values array is smaller than expected");
 			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-				(fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+				(!con->compressed &&
+				 (fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 				elog(ERROR, "values array is not aligned well");
 			break;
 
@@ -823,20 +1152,24 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			{
 				fstate->nullmap_offset = buffer_curr->offset;
 				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-					(fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+					(!con->compressed &&
+					 (fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 					elog(ERROR, "nullmap is not aligned well");
 			}
 			/* offset values */
 			buffer_curr = con->buffer_curr++;
 			fstate->values_offset = buffer_curr->offset;
 			fstate->values_length = buffer_curr->length;
-			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
+			if (!con->compressed &&
+				fstate->values_length < arrowFieldLength(field,fstate->nitems))
 				elog(ERROR, "offset array is smaller than expected");
 			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-				(fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+				(!con->compressed &&
+				 (fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 				elog(ERROR, "offset array is not aligned well");
 			/* setup array element */
 			fstate->children = palloc0(sizeof(RecordBatchFieldState));
@@ -857,27 +1190,32 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			{
 				fstate->nullmap_offset = buffer_curr->offset;
 				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-					(fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+					(!con->compressed &&
+					 (fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 					elog(ERROR, "nullmap is not aligned well");
 			}
 
 			buffer_curr = con->buffer_curr++;
 			fstate->values_offset = buffer_curr->offset;
 			fstate->values_length = buffer_curr->length;
-			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
+			if (!con->compressed &&
+				fstate->values_length < arrowFieldLength(field,fstate->nitems))
 				elog(ERROR, "offset array is smaller than expected");
 			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-				(fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+				(!con->compressed &&
+				 (fstate->values_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 				elog(ERROR, "offset array is not aligned well");
 
 			buffer_curr = con->buffer_curr++;
 			fstate->extra_offset = buffer_curr->offset;
 			fstate->extra_length = buffer_curr->length;
 			if ((fstate->extra_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-				(fstate->extra_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+				(!con->compressed &&
+				 (fstate->extra_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 				elog(ERROR, "extra buffer is not aligned well");
 			break;
 
@@ -892,10 +1230,12 @@ setupRecordBatchField(setupRecordBatchContext *con,
 			{
 				fstate->nullmap_offset = buffer_curr->offset;
 				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
 					elog(ERROR, "nullmap length is smaller than expected");
 				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0 ||
-					(fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0)
+					(!con->compressed &&
+					 (fstate->nullmap_length & (MAXIMUM_ALIGNOF - 1)) != 0))
 					elog(ERROR, "nullmap is not aligned well");
 			}
 
@@ -923,10 +1263,11 @@ setupRecordBatchField(setupRecordBatchContext *con,
 }
 
 static RecordBatchState *
-makeRecordBatchState(ArrowSchema *schema,
+makeRecordBatchState(ArrowFileInfo *af_info,
 					 ArrowBlock *block,
 					 ArrowRecordBatch *rbatch)
 {
+	ArrowSchema *schema = &af_info->footer.schema;
 	setupRecordBatchContext con;
 	RecordBatchState *result;
 	int			j, ncols = schema->_num_fields;
@@ -936,8 +1277,12 @@ makeRecordBatchState(ArrowSchema *schema,
 	result->rb_offset = block->offset + block->metaDataLength;
 	result->rb_length = block->bodyLength;
 	result->rb_nitems = rbatch->length;
+	result->rb_codec  = (rbatch->compression
+						 ? rbatch->compression->codec : -1);
 
 	memset(&con, 0, sizeof(setupRecordBatchContext));
+	con.af_info     = af_info;
+	con.compressed  = (rbatch->compression != NULL);
 	con.buffer_curr = rbatch->buffers;
 	con.buffer_tail = rbatch->buffers + rbatch->_num_buffers;
 	con.fnode_curr  = rbatch->nodes;
@@ -958,3798 +1303,8718 @@ makeRecordBatchState(ArrowSchema *schema,
 }
 
 /*
- * ExecInitArrowFdw
+ * __arrowFieldStatDatum - convert raw min/max value to PostgreSQL datum
  */
-ArrowFdwState *
-ExecInitArrowFdw(GpuContext *gcontext, Relation relation, Bitmapset *outer_refs)
+static bool
+__arrowFieldStatValueDatum(RecordBatchFieldState *fstate,
+						   int64 ival, double fval, Datum *p_datum)
 {
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
-	List		   *filesList = NIL;
-	List		   *fdescList = NIL;
-	List		   *gpuDirectFileDescList = NIL;
-	Bitmapset	   *referenced = NULL;
-	bool			whole_row_ref = false;
-	ArrowFdwState  *af_state;
-	List		   *rb_state_list = NIL;
-	ListCell	   *lc;
-	bool			writable;
-	int				i, num_rbatches;
-
-	Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE &&
-		   memcmp(GetFdwRoutineForRelation(relation, false),
-				  &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) == 0);
-	/* expand 'referenced' if it has whole-row reference */
-	if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, outer_refs))
-		whole_row_ref = true;
-	for (i=0; i < tupdesc->natts; i++)
-	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
-		int		k = attr->attnum - FirstLowInvalidHeapAttributeNumber;
-
-		if (attr->attisdropped)
-			continue;
-		if (whole_row_ref || bms_is_member(k, outer_refs))
-			referenced = bms_add_member(referenced, k);
-	}
-
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	foreach (lc, filesList)
+	switch (fstate->atttypid)
 	{
-		char	   *fname = strVal(lfirst(lc));
-		File		fdesc;
-		List	   *rb_cached = NIL;
-		ListCell   *cell;
-		GPUDirectFileDesc *dfile = NULL;
-
-		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
-		if (fdesc < 0)
-		{
-			if (writable && errno == ENOENT)
-				continue;
-			elog(ERROR, "failed to open '%s' on behalf of '%s'",
-				 fname, RelationGetRelationName(relation));
-		}
-		fdescList = lappend_int(fdescList, fdesc);
-
-		/*
-		 * Open file for GPUDirect I/O
-		 */
-		if (gcontext)
-		{
-			dfile = palloc0(sizeof(GPUDirectFileDesc));
-
-			gpuDirectFileDescOpen(dfile, fdesc);
-			if (!trackRawFileDesc(gcontext, dfile, __FILE__, __LINE__))
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			if (fstate->atttypid == INT2OID)
+				*p_datum = Int16GetDatum((int16)ival);
+			else if (fstate->atttypid == INT4OID)
+				*p_datum = Int32GetDatum((int32)ival);
+			else
+				*p_datum = Int64GetDatum(ival);
+			break;
+		case FLOAT4OID:
+			*p_datum = Float4GetDatum((float4)fval);
+			break;
+		case FLOAT8OID:
+			*p_datum = Float8GetDatum(fval);
+			break;
+		case DATEOID:
+			if (fstate->attopts.date.unit != ArrowDateUnit__Day)
+				return false;
+			*p_datum = DateADTGetDatum(ival - (POSTGRES_EPOCH_JDATE -
+											   UNIX_EPOCH_JDATE));
+			break;
+		case TIMEOID:
+			switch (fstate->attopts.time.unit)
 			{
-				gpuDirectFileDescClose(dfile);
-				elog(ERROR, "out of memory");
+				case ArrowTimeUnit__Second:
+					ival *= 1000000L;
+					break;
+				case ArrowTimeUnit__MilliSecond:
+					ival *= 1000L;
+					break;
+				case ArrowTimeUnit__MicroSecond:
+					break;
+				case ArrowTimeUnit__NanoSecond:
+					ival /= 1000L;
+					break;
+				default:
+					return false;
 			}
-			gpuDirectFileDescList = lappend(gpuDirectFileDescList, dfile);
-		}
-
-		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
-		/* check schema compatibility */
-		foreach (cell, rb_cached)
-		{
-			RecordBatchState   *rb_state = lfirst(cell);
-
-			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
-				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
-					 fname, RelationGetRelationName(relation));
-			/* GPUDirect I/O state, if any */
-			rb_state->dfile = dfile;
-		}
-		rb_state_list = list_concat(rb_state_list, rb_cached);
+			*p_datum = TimeADTGetDatum(ival);
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			switch (fstate->attopts.timestamp.unit)
+			{
+				case ArrowTimeUnit__Second:
+					ival *= 1000000L;
+					break;
+				case ArrowTimeUnit__MilliSecond:
+					ival *= 1000L;
+					break;
+				case ArrowTimeUnit__MicroSecond:
+					break;
+				case ArrowTimeUnit__NanoSecond:
+					ival /= 1000L;
+					break;
+				default:
+					return false;
+			}
+			ival -= (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * USECS_PER_DAY;
+			*p_datum = TimestampGetDatum(ival);
+			break;
+		default:
+			return false;
 	}
-	num_rbatches = list_length(rb_state_list);
-	af_state = palloc0(offsetof(ArrowFdwState, rbatches[num_rbatches]));
-	af_state->gcontext = gcontext;
-	af_state->gpuDirectFileDescList = gpuDirectFileDescList;
-	af_state->fdescList = fdescList;
-	af_state->referenced = referenced;
-	af_state->rbatch_index = &af_state->__rbatch_index_local;
-	i = 0;
-	foreach (lc, rb_state_list)
-		af_state->rbatches[i++] = (RecordBatchState *)lfirst(lc);
-	af_state->num_rbatches = num_rbatches;
+	return true;
+}
 
-	return af_state;
+static bool
+__arrowFieldStatDatum(RecordBatchFieldState *fstate, ArrowField *field,
+					  const char *token, bool is_min, Datum *p_datum)
+{
+	ArrowType  *t = &field->type;
+	int64		ival = 0;
+	double		fval = 0.0;
+	char	   *end;
+
+	errno = 0;
+	if (t->node.tag == ArrowNodeTag__FloatingPoint)
+		fval = strtod(token, &end);
+	else
+		ival = strtol(token, &end, 10);
+	if (*end != '\0' || errno != 0)
+		return false;
+	/*
+	 * max is NaN if the RecordBatch contains NaN, because NaN is larger
+	 * than any other values. min should never be NaN.
+	 */
+	if (is_min && t->node.tag == ArrowNodeTag__FloatingPoint && isnan(fval))
+		return false;
+	/* unsigned integers are mapped to signed ones */
+	if ((fstate->atttypid == INT2OID ||
+		 fstate->atttypid == INT4OID ||
+		 fstate->atttypid == INT8OID) &&
+		(t->node.tag != ArrowNodeTag__Int || !t->Int.is_signed))
+		return false;
+	return __arrowFieldStatValueDatum(fstate, ival, fval, p_datum);
 }
 
 /*
- * ArrowBeginForeignScan
+ * setupRecordBatchStats - load min/max statistics of the RecordBatch
  */
 static void
-ArrowBeginForeignScan(ForeignScanState *node, int eflags)
+setupRecordBatchStats(RecordBatchState *rb_state, ArrowSchema *schema)
 {
-	Relation		relation = node->ss.ss_currentRelation;
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ForeignScan	   *fscan = (ForeignScan *) node->ss.ps.plan;
-	ListCell	   *lc;
-	Bitmapset	   *referenced = NULL;
+	int			j;
 
-	foreach (lc, fscan->fdw_private)
+	Assert(rb_state->ncols == schema->_num_fields);
+	for (j=0; j < rb_state->ncols; j++)
 	{
-		int		j = lfirst_int(lc);
-
-		if (j >= 0 && j <= tupdesc->natts)
-			referenced = bms_add_member(referenced, j -
-										FirstLowInvalidHeapAttributeNumber);
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		ArrowField *field = &schema->fields[j];
+		char		min_buf[64];
+		char		max_buf[64];
+
+		if (arrowFieldStatValues(field, "min_values", rb_state->rb_index,
+								 min_buf, sizeof(min_buf)) &&
+			arrowFieldStatValues(field, "max_values", rb_state->rb_index,
+								 max_buf, sizeof(max_buf)) &&
+			__arrowFieldStatDatum(fstate, field, min_buf, true,
+								  &fstate->stat_min) &&
+			__arrowFieldStatDatum(fstate, field, max_buf, false,
+								  &fstate->stat_max))
+			fstate->stat_valid = true;
 	}
-	node->fdw_state = ExecInitArrowFdw(NULL, relation, referenced);
 }
 
-typedef struct
-{
-	off_t		rb_offset;
-	off_t		f_offset;
-	off_t		m_offset;
-	cl_int		io_index;
-	cl_int      depth;
-	strom_io_chunk ioc[FLEXIBLE_ARRAY_MEMBER];
-} arrowFdwSetupIOContext;
-
 /*
- * arrowFdwSetupIOvectorField
+ * makeRecordBatchStateParquet
+ *
+ * It maps RowGroups of Parquet file to RecordBatchState; each column chunk
+ * is decoded on the host side at the load time. Only flat schema is
+ * supported right now.
  */
-static inline void
-__setupIOvectorField(arrowFdwSetupIOContext *con,
-					 off_t chunk_offset,
-					 size_t chunk_length,
-					 cl_uint *p_cmeta_offset,
-					 cl_uint *p_cmeta_length)
+static bool
+__parquetFieldStatDatum(RecordBatchFieldState *fstate,
+						const char *value, int len, bool is_min,
+						Datum *p_datum)
 {
-	off_t		f_pos = con->rb_offset + chunk_offset;
+	int64		ival = 0;
+	double		fval = 0.0;
 
-	if (f_pos == con->f_offset &&
-		con->m_offset == MAXALIGN(con->m_offset))
+	switch (fstate->pq_type)
 	{
-		/* good, buffer is continuous */
-		*p_cmeta_offset = __kds_packed(con->m_offset);
-		*p_cmeta_length = __kds_packed(chunk_length);
-
-		con->m_offset += chunk_length;
-		con->f_offset += chunk_length;
+		case ParquetType__INT32:
+			if (len != sizeof(int32))
+				return false;
+			ival = *((int32 *)value);
+			break;
+		case ParquetType__INT64:
+			if (len != sizeof(int64))
+				return false;
+			ival = *((int64 *)value);
+			break;
+		case ParquetType__FLOAT:
+			if (len != sizeof(float))
+				return false;
+			fval = *((float *)value);
+			break;
+		case ParquetType__DOUBLE:
+			if (len != sizeof(double))
+				return false;
+			fval = *((double *)value);
+			break;
+		default:
+			return false;
 	}
-	else
+	if (fstate->atttypid == FLOAT4OID ||
+		fstate->atttypid == FLOAT8OID)
 	{
-		off_t		f_base = TYPEALIGN_DOWN(PAGE_SIZE, f_pos);
-		off_t		f_tail;
-		off_t		shift = f_pos - f_base;
-		strom_io_chunk *ioc;
+		if (isnan(fval))
+			return false;
+		/*
+		 * Parquet writers exclude NaN from min/max, but NaN is larger than
+		 * any other values in PostgreSQL. So, max is assumed to be NaN.
+		 */
+		if (!is_min)
+			fval = get_float8_nan();
+	}
+	return __arrowFieldStatValueDatum(fstate, ival, fval, p_datum);
+}
 
-		if (con->io_index < 0)
-			con->io_index = 0;	/* no previous i/o chunks */
-		else
+static List *
+makeRecordBatchStateParquet(File fdesc, struct stat *stat_buf)
+{
+	const char *fname = FilePathName(fdesc);
+	ParquetFileInfo pq_info;
+	List	   *results = NIL;
+	int			i, j, ncols;
+
+	readParquetFileDesc(FileGetRawDesc(fdesc), fname, &pq_info);
+	ncols = pq_info.schema[0].num_children;
+	if (ncols != pq_info.num_schema - 1)
+		elog(ERROR, "parquet: file '%s' has nested schema, not supported",
+			 fname);
+	for (i=0; i < pq_info.num_row_groups; i++)
+	{
+		ParquetRowGroup *rgroup = &pq_info.row_groups[i];
+		RecordBatchState *rb_state;
+
+		if (rgroup->num_columns != ncols || rgroup->num_rows < 0)
+			elog(ERROR, "parquet: RowGroup %d of '%s' is corrupted", i, fname);
+		rb_state = palloc0(offsetof(RecordBatchState, columns[ncols]));
+		rb_state->fdesc = fdesc;
+		memcpy(&rb_state->stat_buf, stat_buf, sizeof(struct stat));
+		rb_state->rb_index   = i;
+		rb_state->rb_nitems  = rgroup->num_rows;
+		rb_state->rb_codec   = -1;
+		rb_state->rb_parquet = true;
+		rb_state->ncols      = ncols;
+		for (j=0; j < ncols; j++)
 		{
-			ioc = &con->ioc[con->io_index++];
+			ParquetSchemaElement *elem = &pq_info.schema[j+1];
+			ParquetColumnChunk *cchunk = &rgroup->columns[j];
+			ParquetStatistics *stats = &cchunk->stats;
+			RecordBatchFieldState *fstate = &rb_state->columns[j];
+			int64		offset = cchunk->data_page_offset;
+
+			fstate->atttypid = parquetTypeToPGTypeOid(elem, &fstate->attopts);
+			if (!OidIsValid(fstate->atttypid))
+				elog(ERROR, "parquet: column '%s' of '%s' has unsupported data type",
+					 elem->name, fname);
+			fstate->atttypmod = -1;
+			if (cchunk->type != elem->type)
+				elog(ERROR, "parquet: column chunk of '%s' in '%s' has inconsistent type",
+					 elem->name, fname);
+			/* dictionary page is located prior to the data pages */
+			if (cchunk->dictionary_page_offset > 0 &&
+				cchunk->dictionary_page_offset < offset)
+				offset = cchunk->dictionary_page_offset;
+			if (offset < PARQUET_MAGIC_LEN ||
+				cchunk->total_compressed_size < 0 ||
+				offset + cchunk->total_compressed_size > stat_buf->st_size)
+				elog(ERROR, "parquet: column chunk of '%s' in '%s' is out of the file",
+					 elem->name, fname);
+			fstate->nitems = rgroup->num_rows;
+			fstate->null_count = Max(stats->null_count, 0);
+			fstate->values_offset = offset;
+			fstate->values_length = cchunk->total_compressed_size;
+			fstate->pq_type = elem->type;
+			fstate->pq_type_length = elem->type_length;
+			fstate->pq_codec = cchunk->codec;
+			fstate->pq_max_deflevel =
+				(elem->repetition_type == ParquetRepetition__OPTIONAL ? 1 : 0);
+			if (stats->min_value && stats->max_value &&
+				__parquetFieldStatDatum(fstate, stats->min_value,
+										stats->min_len, true,
+										&fstate->stat_min) &&
+				__parquetFieldStatDatum(fstate, stats->max_value,
+										stats->max_len, false,
+										&fstate->stat_max))
+				fstate->stat_valid = true;
+			rb_state->rb_length += fstate->values_length;
+		}
+		results = lappend(results, rb_state);
+	}
+	return results;
+}
 
-			f_tail = TYPEALIGN(PAGE_SIZE, con->f_offset);
-			ioc->nr_pages = f_tail / PAGE_SIZE - ioc->fchunk_id;
-			con->m_offset += (f_tail - con->f_offset); //safety margin;
+/*
+ * execInitArrowStatsHint
+ *
+ * It picks up simple comparison qualifiers (Var OP Const) on the columns
+ * with btree operator family, to skip RecordBatches by min/max statistics.
+ */
+static List *
+execInitArrowStatsHint(Relation relation, List *outer_quals)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	List	   *results = NIL;
+	ListCell   *lc;
+
+	foreach (lc, outer_quals)
+	{
+		OpExpr	   *op = lfirst(lc);
+		Node	   *arg1;
+		Node	   *arg2;
+		Var		   *var;
+		Const	   *con;
+		TypeCacheEntry *tcache;
+		int			strategy;
+		Oid			cmp_proc;
+		arrowStatsHint *hint;
+
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+			continue;
+		arg1 = linitial(op->args);
+		arg2 = lsecond(op->args);
+		if (IsA(arg1, RelabelType))
+			arg1 = (Node *)((RelabelType *)arg1)->arg;
+		if (IsA(arg2, RelabelType))
+			arg2 = (Node *)((RelabelType *)arg2)->arg;
+		if (IsA(arg1, Var) && IsA(arg2, Const))
+		{
+			var = (Var *)arg1;
+			con = (Const *)arg2;
+		}
+		else if (IsA(arg1, Const) && IsA(arg2, Var))
+		{
+			var = (Var *)arg2;
+			con = (Const *)arg1;
+		}
+		else
+			continue;
+		if (var->varlevelsup != 0 ||
+			var->varattno <= 0 ||
+			var->varattno > tupdesc->natts ||
+			con->constisnull)
+			continue;
+		/* see __arrowFieldStatDatum and __arrowCheckDictionaryHint */
+		switch (var->vartype)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+			case DATEOID:
+			case TIMEOID:
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+			case TEXTOID:
+			case BYTEAOID:
+				break;
+			default:
+				continue;
 		}
-		ioc = &con->ioc[con->io_index];
-		/* adjust position if con->m_offset is not aligned well */
-		if (con->m_offset + shift != MAXALIGN(con->m_offset + shift))
-			con->m_offset = MAXALIGN(con->m_offset + shift) - shift;
-		ioc->m_offset   = con->m_offset;
-		ioc->fchunk_id  = f_base / PAGE_SIZE;
 
-		*p_cmeta_offset = __kds_packed(con->m_offset + shift);
-		*p_cmeta_length = __kds_packed(chunk_length);
+		tcache = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+		if (!OidIsValid(tcache->btree_opf))
+			continue;
+		strategy = get_op_opfamily_strategy(op->opno, tcache->btree_opf);
+		if (strategy == InvalidStrategy)
+			continue;
+		/* varlena values can be checked by the dictionary only */
+		if ((var->vartype == TEXTOID ||
+			 var->vartype == BYTEAOID) &&
+			strategy != BTEqualStrategyNumber)
+			continue;
+		if ((Node *)var == arg2)
+		{
+			/* Const OP Var, so commute the strategy */
+			if (strategy == BTLessStrategyNumber)
+				strategy = BTGreaterStrategyNumber;
+			else if (strategy == BTLessEqualStrategyNumber)
+				strategy = BTGreaterEqualStrategyNumber;
+			else if (strategy == BTGreaterEqualStrategyNumber)
+				strategy = BTLessEqualStrategyNumber;
+			else if (strategy == BTGreaterStrategyNumber)
+				strategy = BTLessStrategyNumber;
+		}
+		cmp_proc = get_opfamily_proc(tcache->btree_opf,
+									 var->vartype,
+									 con->consttype,
+									 BTORDER_PROC);
+		if (!OidIsValid(cmp_proc))
+			continue;
 
-		con->m_offset  += shift + chunk_length;
-		con->f_offset   = f_pos + chunk_length;
+		hint = palloc0(sizeof(arrowStatsHint));
+		hint->attnum = var->varattno;
+		hint->strategy = strategy;
+		hint->value = con->constvalue;
+		hint->collid = op->inputcollid;
+		fmgr_info(cmp_proc, &hint->cmp_func);
+		hint->consttype = con->consttype;
+		hint->dict_fdesc = -1;
+		results = lappend(results, hint);
 	}
+	return results;
 }
 
-static void
-arrowFdwSetupIOvectorField(arrowFdwSetupIOContext *con,
-						   RecordBatchFieldState *fstate,
-						   kern_data_store *kds,
-						   kern_colmeta *cmeta)
+/*
+ * __arrowCheckDictionaryHint
+ *
+ * It checks whether the dictionary of the varlena column contains the value
+ * of equality qualifier. Because RecordBatches in a file usually share the
+ * same DictionaryBatch, the last result is kept in the hint.
+ */
+static bool
+__arrowCheckDictionaryHint(arrowStatsHint *hint,
+						   RecordBatchState *rb_state,
+						   RecordBatchFieldState *fstate)
 {
-	//int		index = cmeta - kds->colmeta;
+	int			fdesc = FileGetRawDesc(rb_state->fdesc);
+	cl_uint	   *offset;
+	char	   *extra;
+	int64		i;
+	bool		found = false;
+
+	if (hint->dict_fdesc == rb_state->fdesc &&
+		hint->dict_offset == fstate->dict_values_offset)
+		return hint->dict_found;
+	if ((fstate->atttypid != TEXTOID &&
+		 fstate->atttypid != BYTEAOID) ||
+		fstate->dict_codec >= 0 ||
+		fstate->dict_values_length < sizeof(cl_uint) * (fstate->dict_nitems + 1))
+		return true;
 
-	if (fstate->nullmap_length > 0)
-	{
-		Assert(fstate->null_count > 0);
-		__setupIOvectorField(con,
-							 fstate->nullmap_offset,
-							 fstate->nullmap_length,
-							 &cmeta->nullmap_offset,
-							 &cmeta->nullmap_length);
-		//elog(INFO, "D%d att[%d] nullmap=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->nullmap_offset, fstate->nullmap_length, con->m_offset, con->f_offset);
-	}
-	if (fstate->values_length > 0)
-	{
-		__setupIOvectorField(con,
-							 fstate->values_offset,
-							 fstate->values_length,
-							 &cmeta->values_offset,
-							 &cmeta->values_length);
-		//elog(INFO, "D%d att[%d] values=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->values_offset, fstate->values_length, con->m_offset, con->f_offset);
-	}
-	if (fstate->extra_length > 0)
+	offset = palloc(fstate->dict_values_length);
+	extra = palloc(fstate->dict_extra_length + 1);
+	if (pread(fdesc, offset,
+			  fstate->dict_values_length,
+			  fstate->dict_values_offset) != (ssize_t)fstate->dict_values_length ||
+		pread(fdesc, extra,
+			  fstate->dict_extra_length,
+			  fstate->dict_extra_offset) != (ssize_t)fstate->dict_extra_length)
+		elog(ERROR, "failed on pread('%s'): %m", FilePathName(rb_state->fdesc));
+
+	for (i=0; !found && i < fstate->dict_nitems; i++)
 	{
-		__setupIOvectorField(con,
-							 fstate->extra_offset,
-							 fstate->extra_length,
-							 &cmeta->extra_offset,
-							 &cmeta->extra_length);
-		//elog(INFO, "D%d att[%d] extra=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->extra_offset, fstate->extra_length, con->m_offset, con->f_offset);
+		cl_uint		len = offset[i+1] - offset[i];
+		struct varlena *vl;
+
+		if (offset[i] > offset[i+1] || offset[i+1] > fstate->dict_extra_length)
+			elog(ERROR, "corrupted arrow file? offset points out of extra buffer");
+		vl = palloc(VARHDRSZ + len);
+		SET_VARSIZE(vl, VARHDRSZ + len);
+		memcpy(VARDATA(vl), extra + offset[i], len);
+		if (DatumGetInt32(FunctionCall2Coll(&hint->cmp_func,
+											hint->collid,
+											PointerGetDatum(vl),
+											hint->value)) == 0)
+			found = true;
+		pfree(vl);
 	}
+	pfree(offset);
+	pfree(extra);
 
-	/* nested sub-fields if composite types */
-	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
-		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	hint->dict_fdesc = rb_state->fdesc;
+	hint->dict_offset = fstate->dict_values_offset;
+	hint->dict_found = found;
+
+	return found;
+}
+
+/*
+ * execCheckArrowStatsHint
+ *
+ * It returns false, if min/max statistics of the RecordBatch tells
+ * no rows can satisfy the qualifiers. In case of equality qualifier on
+ * dictionary-encoded columns, it also returns false if the dictionary
+ * does not contain the value.
+ */
+static bool
+execCheckArrowStatsHint(ArrowFdwState *af_state, RecordBatchState *rb_state)
+{
+	ListCell   *lc;
+
+	foreach (lc, af_state->stats_hint)
 	{
-		kern_colmeta *subattr;
-		int		j;
+		arrowStatsHint *hint = lfirst(lc);
+		RecordBatchFieldState *fstate;
+		int32		cmp_min;
+		int32		cmp_max;
 
-		Assert(fstate->num_children == cmeta->num_subattrs);
-		con->depth++;
-		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
-			 j < cmeta->num_subattrs;
-			 j++, subattr++)
+		if (hint->attnum > rb_state->ncols)
+			continue;
+		fstate = &rb_state->columns[hint->attnum - 1];
+		if (fstate->dict_unitsz > 0 &&
+			hint->strategy == BTEqualStrategyNumber &&
+			!__arrowCheckDictionaryHint(hint, rb_state, fstate))
+			return false;
+		if (!fstate->stat_valid)
+			continue;
+		cmp_min = DatumGetInt32(FunctionCall2Coll(&hint->cmp_func,
+												  hint->collid,
+												  fstate->stat_min,
+												  hint->value));
+		cmp_max = DatumGetInt32(FunctionCall2Coll(&hint->cmp_func,
+												  hint->collid,
+												  fstate->stat_max,
+												  hint->value));
+		switch (hint->strategy)
 		{
-			RecordBatchFieldState *child = &fstate->children[j];
-
-			arrowFdwSetupIOvectorField(con, child, kds, subattr);
+			case BTLessStrategyNumber:
+				if (cmp_min >= 0)
+					return false;
+				break;
+			case BTLessEqualStrategyNumber:
+				if (cmp_min > 0)
+					return false;
+				break;
+			case BTEqualStrategyNumber:
+				if (cmp_min > 0 || cmp_max < 0)
+					return false;
+				break;
+			case BTGreaterEqualStrategyNumber:
+				if (cmp_max < 0)
+					return false;
+				break;
+			case BTGreaterStrategyNumber:
+				if (cmp_max <= 0)
+					return false;
+				break;
+			default:
+				break;
 		}
-		con->depth--;
 	}
+	return true;
 }
 
 /*
- * arrowFdwSetupIOvector
+ * __arrowFieldUnitSize
+ *
+ * It returns the width of the values (or offsets) buffer per row, 0 if
+ * it is a bitmap, or -1 if the buffer cannot be sliced by row range.
  */
-static strom_io_vector *
-arrowFdwSetupIOvector(kern_data_store *kds,
-					  RecordBatchState *rb_state,
-					  Bitmapset *referenced)
+static int
+__arrowFieldUnitSize(RecordBatchFieldState *fstate)
 {
-	arrowFdwSetupIOContext *con;
-	strom_io_vector *iovec = NULL;
-	int			j, nr_chunks = 0;
+	size_t		unitsz;
 
-	Assert(kds->nr_colmeta >= kds->ncols);
-	con = alloca(offsetof(arrowFdwSetupIOContext,
-						  ioc[3 * kds->nr_colmeta]));
-	con->rb_offset = rb_state->rb_offset;
-	con->f_offset  = ~0UL;	/* invalid offset */
-	con->m_offset  = TYPEALIGN(PAGE_SIZE, KERN_DATA_STORE_HEAD_LENGTH(kds));
-	con->io_index  = -1;
-	for (j=0; j < kds->ncols; j++)
-	{
-		RecordBatchFieldState *fstate = &rb_state->columns[j];
-		kern_colmeta *cmeta = &kds->colmeta[j];
-		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+	if (fstate->dict_unitsz > 0)
+		return fstate->dict_unitsz;
+	if (fstate->atttypid == BOOLOID)
+		return 0;
+	if (fstate->nitems <= ARROWALIGN(1))
+		return -1;
+	/*
+	 * Buffers are padded to 64bytes boundary, and offsets have one extra
+	 * item, so the integer division gives us the exact width as long as
+	 * the buffer has enough number of rows.
+	 */
+	unitsz = fstate->values_length / fstate->nitems;
+	if (unitsz == 0 ||
+		fstate->values_length - unitsz * fstate->nitems >= ARROWALIGN(1) + unitsz)
+		return -1;
+	return unitsz;
+}
 
-		if (referenced && bms_is_member(attidx, referenced))
-			arrowFdwSetupIOvectorField(con, fstate, kds, cmeta);
+/*
+ * __arrowFieldIsSliceable
+ */
+static bool
+__arrowFieldIsSliceable(RecordBatchFieldState *fstate, int64 nitems)
+{
+	int		j;
+
+	if (fstate->nitems != nitems)
+		return false;
+	if (fstate->values_length > 0)
+	{
+		/* elements of array are not sliced, only the offsets are */
+		return (__arrowFieldUnitSize(fstate) >= 0);
 	}
-	if (con->io_index >= 0)
+	/* composite type; sub-fields are sliced by the same row range */
+	for (j=0; j < fstate->num_children; j++)
 	{
-		/* close the last I/O chunks */
-		strom_io_chunk *ioc = &con->ioc[con->io_index];
-
-		ioc->nr_pages = (TYPEALIGN(PAGE_SIZE, con->f_offset) / PAGE_SIZE -
-						 ioc->fchunk_id);
-		con->m_offset = ioc->m_offset + PAGE_SIZE * ioc->nr_pages;
-		nr_chunks = con->io_index + 1;
+		if (!__arrowFieldIsSliceable(&fstate->children[j], nitems))
+			return false;
 	}
-	kds->length = con->m_offset;
-
-	iovec = palloc0(offsetof(strom_io_vector, ioc[nr_chunks]));
-	iovec->nr_chunks = nr_chunks;
-	if (nr_chunks > 0)
-		memcpy(iovec->ioc, con->ioc, sizeof(strom_io_chunk) * nr_chunks);
-	return iovec;
+	return true;
 }
 
 /*
- * __dump_kds_and_iovec - just for debug
+ * __arrowSliceFieldBuffer
  */
 static inline void
-__dump_kds_and_iovec(kern_data_store *kds, strom_io_vector *iovec)
+__arrowSliceFieldBuffer(off_t *p_offset, size_t *p_length, int unitsz,
+						int64 row_start, int64 row_nitems)
 {
-#if 0
-	int		j;
+	size_t		skip;
+	size_t		length;
 
-	elog(INFO, "nchunks = %d", iovec->nr_chunks);
-	for (j=0; j < iovec->nr_chunks; j++)
+	if (unitsz == 0)
 	{
-		strom_io_chunk *ioc = &iovec->ioc[j];
-
-		elog(INFO, "io[%d] [ m_offset=%lu, f_read=%lu...%lu, nr_pages=%u}",
-			 j,
-			 ioc->m_offset,
-			 ioc->fchunk_id * PAGE_SIZE,
-			 (ioc->fchunk_id + ioc->nr_pages) * PAGE_SIZE,
-			 ioc->nr_pages);
+		/* bitmap; row_start is always aligned to 64 */
+		skip = row_start / BITS_PER_BYTE;
+		length = (row_nitems + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
 	}
-
-	elog(INFO, "kds {length=%zu nitems=%u typeid=%u typmod=%u table_oid=%u}",
-		 kds->length, kds->nitems,
-		 kds->tdtypeid, kds->tdtypmod, kds->table_oid);
-	for (j=0; j < kds->nr_colmeta; j++)
+	else
 	{
-		kern_colmeta *cmeta = &kds->colmeta[j];
-
-		elog(INFO, "%ccol[%d] nullmap=%lu,%lu values=%lu,%lu extra=%lu,%lu",
-			 j < kds->ncols ? ' ' : '*', j,
-			 __kds_unpack(cmeta->nullmap_offset),
-			 __kds_unpack(cmeta->nullmap_length),
-			 __kds_unpack(cmeta->values_offset),
-			 __kds_unpack(cmeta->values_length),
-			 __kds_unpack(cmeta->extra_offset),
-			 __kds_unpack(cmeta->extra_length));
-
+		/* one more item for the tail of offsets, if any */
+		skip = row_start * unitsz;
+		length = (row_nitems + 1) * unitsz;
 	}
-#endif
+	skip = Min(skip, *p_length);
+	*p_offset += skip;
+	*p_length = Min(length, *p_length - skip);
 }
 
 /*
- * arrowFdwLoadRecordBatch
+ * arrowFdwSetupScanUnits
+ *
+ * It splits large RecordBatches into row ranges, not to assign a giant
+ * RecordBatch to a particular worker in parallel scans. RecordBatches
+ * of Parquet files, compressed ones, and ones with fields whose buffers
+ * cannot be sliced are scanned as a whole.
  */
-static pgstrom_data_store *
-__arrowFdwLoadRecordBatch(RecordBatchState *rb_state,
-						  Relation relation,
-						  Bitmapset *referenced,
-						  GpuContext *gcontext,
-						  MemoryContext mcontext,
-						  int optimal_gpu)
+static void
+arrowFdwSetupScanUnits(ArrowFdwState *af_state, TupleDesc tupdesc)
 {
-	TupleDesc			tupdesc = RelationGetDescr(relation);
-	pgstrom_data_store *pds;
-	kern_data_store	   *kds;
-	strom_io_vector	   *iovec;
-	size_t				head_sz;
-	int					j;
-	CUresult			rc;
-
-	/* setup KDS and I/O-vector */
-	head_sz = KDS_calculateHeadSize(tupdesc);
-	kds = alloca(head_sz);
-	init_kernel_data_store(kds, tupdesc, 0, KDS_FORMAT_ARROW, 0);
-	kds->nitems = rb_state->rb_nitems;
-	kds->nrooms = rb_state->rb_nitems;
-	kds->table_oid = RelationGetRelid(relation);
-	Assert(head_sz == KERN_DATA_STORE_HEAD_LENGTH(kds));
-	for (j=0; j < kds->nr_colmeta; j++)
-		kds->colmeta[j].attopts = rb_state->columns[j].attopts;
-	iovec = arrowFdwSetupIOvector(kds, rb_state, referenced);
-	__dump_kds_and_iovec(kds, iovec);
+	size_t		chunk_size = pgstrom_chunk_size();
+	uint32		i, k, nunits = 0;
+	int64	   *unit_nrows;
 
-	/*
-	 * If SSD-to-GPU Direct SQL is available on the arrow file, setup a small
-	 * PDS on host-pinned memory, with strom_io_vector.
-	 */
-	if (gcontext &&
-		gcontext->cuda_dindex == optimal_gpu &&
-		iovec->nr_chunks > 0 &&
-		kds->length <= gpuMemAllocIOMapMaxLength() &&
-		rb_state->dfile != NULL)
+	unit_nrows = palloc0(sizeof(int64) * Max(af_state->num_rbatches, 1));
+	for (i=0; i < af_state->num_rbatches; i++)
 	{
-		size_t	iovec_sz = offsetof(strom_io_vector, ioc[iovec->nr_chunks]);
+		RecordBatchState *rb_state = af_state->rbatches[i];
+		int64		nsplits;
+		int			j;
 
-		rc = gpuMemAllocHost(gcontext, (void **)&pds,
-							 offsetof(pgstrom_data_store, kds) +
-							 head_sz + iovec_sz);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on gpuMemAllocHost: %s", errorText(rc));
+		nunits++;
+		if (rb_state->rb_length <= chunk_size ||
+			rb_state->rb_nitems < 2 * ARROWALIGN(1) ||
+			rb_state->rb_parquet ||
+			__arrowRecordBatchIsCompressed(rb_state, af_state->referenced))
+			continue;
+		for (j=0; j < tupdesc->natts && j < rb_state->ncols; j++)
+		{
+			int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
-		pds->gcontext = gcontext;
-		pg_atomic_init_u32(&pds->refcnt, 1);
-		pds->nblocks_uncached = 0;
-		memcpy(&pds->filedesc, rb_state->dfile, sizeof(GPUDirectFileDesc));
-		pds->iovec = (strom_io_vector *)((char *)&pds->kds + head_sz);
-		memcpy(&pds->kds, kds, head_sz);
-		memcpy(pds->iovec, iovec, iovec_sz);
+			if (bms_is_member(attidx, af_state->referenced) &&
+				!__arrowFieldIsSliceable(&rb_state->columns[j],
+										 rb_state->rb_nitems))
+				break;
+		}
+		if (j < tupdesc->natts && j < rb_state->ncols)
+			continue;
+
+		nsplits = (rb_state->rb_length + chunk_size - 1) / chunk_size;
+		unit_nrows[i] = ARROWALIGN((rb_state->rb_nitems +
+									nsplits - 1) / nsplits);
+		nsplits = (rb_state->rb_nitems +
+				   unit_nrows[i] - 1) / unit_nrows[i];
+		if (nsplits > 1)
+			nunits += nsplits - 1;
+		else
+			unit_nrows[i] = 0;
 	}
-	else
+
+	af_state->units = palloc0(sizeof(arrowScanUnit) * Max(nunits, 1));
+	for (i=0, k=0; i < af_state->num_rbatches; i++)
 	{
-		/* Elsewhere, load RecordBatch by filesystem */
-		int		fdesc = FileGetRawDesc(rb_state->fdesc);
+		RecordBatchState *rb_state = af_state->rbatches[i];
+		int64		row_start = 0;
 
-		if (gcontext)
+		if (unit_nrows[i] == 0)
 		{
-			rc = gpuMemAllocManaged(gcontext,
-									(CUdeviceptr *)&pds,
-									offsetof(pgstrom_data_store,
-											 kds) + kds->length,
-									CU_MEM_ATTACH_GLOBAL);
-			if (rc != CUDA_SUCCESS)
-				elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+			af_state->units[k].rb_index = i;
+			af_state->units[k].row_start = 0;
+			af_state->units[k].row_nitems = -1;
+			k++;
+			continue;
 		}
-		else
+		while (row_start < rb_state->rb_nitems)
 		{
-			pds = MemoryContextAllocHuge(mcontext,
-										 offsetof(pgstrom_data_store,
-												  kds) + kds->length);
+			af_state->units[k].rb_index = i;
+			af_state->units[k].row_start = row_start;
+			af_state->units[k].row_nitems =
+				Min(unit_nrows[i], rb_state->rb_nitems - row_start);
+			row_start += unit_nrows[i];
+			k++;
 		}
-		__PDS_fillup_arrow(pds, gcontext, kds, fdesc, iovec);
 	}
-	pfree(iovec);
-	return pds;
+	Assert(k == nunits);
+	af_state->num_units = nunits;
+	pfree(unit_nrows);
 }
 
-static pgstrom_data_store *
-arrowFdwLoadRecordBatch(ArrowFdwState *af_state,
-						Relation relation,
-						EState *estate,
-						GpuContext *gcontext,
-						int optimal_gpu)
+/*
+ * ExecInitArrowFdw
+ */
+ArrowFdwState *
+ExecInitArrowFdw(GpuContext *gcontext, Relation relation,
+				 List *outer_quals, Bitmapset *outer_refs)
 {
-	uint32		rb_index;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
+	List		   *filesList = NIL;
+	List		   *fdescList = NIL;
+	List		   *gpuDirectFileDescList = NIL;
+	List		   *partKeys;
+	List		   *partValuesList = NIL;
+	List		   *rb_partvals_list = NIL;
+	Bitmapset	   *referenced = NULL;
+	bool			whole_row_ref = false;
+	ArrowFdwState  *af_state;
+	List		   *rb_state_list = NIL;
+	ListCell	   *lc;
+	bool			writable;
+	int				nfiles_total;
+	int				fcount = 0;
+	int				i, num_rbatches;
 
-	/* fetch next RecordBatch */
-	rb_index = pg_atomic_fetch_add_u32(af_state->rbatch_index, 1);
-	if (rb_index >= af_state->num_rbatches)
-		return NULL;	/* no more RecordBatch to read */
+	Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE &&
+		   memcmp(GetFdwRoutineForRelation(relation, false),
+				  &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) == 0);
+	/* expand 'referenced' if it has whole-row reference */
+	if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, outer_refs))
+		whole_row_ref = true;
+	for (i=0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
+		int		k = attr->attnum - FirstLowInvalidHeapAttributeNumber;
 
-	return __arrowFdwLoadRecordBatch(af_state->rbatches[rb_index],
-									 relation,
-									 af_state->referenced,
-									 gcontext,
-									 estate->es_query_cxt,
-									 optimal_gpu);
-}
+		if (attr->attisdropped)
+			continue;
+		if (whole_row_ref || bms_is_member(k, outer_refs))
+			referenced = bms_add_member(referenced, k);
+	}
 
-/*
- * ExecScanChunkArrowFdw
- */
-pgstrom_data_store *
-ExecScanChunkArrowFdw(GpuTaskState *gts)
-{
-	pgstrom_data_store *pds;
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	nfiles_total = list_length(filesList);
+	partKeys = arrowFdwExtractPartitionKeys(ft->options);
+	if (partKeys != NIL)
+		filesList = arrowFdwPrunePartitionFiles(tupdesc, filesList,
+												partKeys, outer_quals,
+												&partValuesList);
+	arrowPrefetchMetadataCache(filesList);
+	foreach (lc, filesList)
+	{
+		char	   *fname = strVal(lfirst(lc));
+		File		fdesc;
+		List	   *rb_cached = NIL;
+		ListCell   *cell;
+		GPUDirectFileDesc *dfile = NULL;
 
-	InstrStartNode(&gts->outer_instrument);
-	pds = arrowFdwLoadRecordBatch(gts->af_state,
-								  gts->css.ss.ss_currentRelation,
-								  gts->css.ss.ps.state,
-								  gts->gcontext,
-								  gts->optimal_gpu);
-	InstrStopNode(&gts->outer_instrument,
-				  !pds ? 0.0 : (double)pds->kds.nitems);
-	return pds;
+		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
+		if (fdesc < 0)
+		{
+			if (writable && errno == ENOENT)
+				continue;
+			elog(ERROR, "failed to open '%s' on behalf of '%s'",
+				 fname, RelationGetRelationName(relation));
+		}
+		fdescList = lappend_int(fdescList, fdesc);
+
+		/*
+		 * Open file for GPUDirect I/O
+		 */
+		if (gcontext)
+		{
+			dfile = palloc0(sizeof(GPUDirectFileDesc));
+
+			gpuDirectFileDescOpen(dfile, fdesc);
+			if (!trackRawFileDesc(gcontext, dfile, __FILE__, __LINE__))
+			{
+				gpuDirectFileDescClose(dfile);
+				elog(ERROR, "out of memory");
+			}
+			gpuDirectFileDescList = lappend(gpuDirectFileDescList, dfile);
+		}
+
+		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
+		/* check schema compatibility */
+		foreach (cell, rb_cached)
+		{
+			RecordBatchState   *rb_state = lfirst(cell);
+
+			if (!arrowSchemaCompatibilityCheck(tupdesc, list_length(partKeys),
+											   rb_state))
+				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
+					 fname, RelationGetRelationName(relation));
+			/* GPUDirect I/O state, if any */
+			rb_state->dfile = dfile;
+			/* partition-key values, if any */
+			if (partValuesList != NIL)
+				rb_partvals_list = lappend(rb_partvals_list,
+										   list_nth(partValuesList, fcount));
+		}
+		rb_state_list = list_concat(rb_state_list, rb_cached);
+		fcount++;
+	}
+	num_rbatches = list_length(rb_state_list);
+	af_state = palloc0(offsetof(ArrowFdwState, rbatches[num_rbatches]));
+	af_state->gcontext = gcontext;
+	af_state->gpuDirectFileDescList = gpuDirectFileDescList;
+	af_state->fdescList = fdescList;
+	af_state->referenced = referenced;
+	af_state->writable = writable;
+	af_state->rbatch_index = &af_state->__rbatch_index_local;
+	i = 0;
+	foreach (lc, rb_state_list)
+		af_state->rbatches[i++] = (RecordBatchState *)lfirst(lc);
+	af_state->num_rbatches = num_rbatches;
+	if (partKeys != NIL)
+	{
+		af_state->part_nkeys = list_length(partKeys);
+		af_state->part_nskipped = nfiles_total - list_length(filesList);
+		af_state->rb_partvals = palloc0(sizeof(arrowPartitionValues *) *
+										(num_rbatches + 1));
+		i = 0;
+		foreach (lc, rb_partvals_list)
+			af_state->rb_partvals[i++] = lfirst(lc);
+	}
+	if (arrow_fdw_stats_hint_enabled)
+		af_state->stats_hint = execInitArrowStatsHint(relation, outer_quals);
+	arrowFdwSetupScanUnits(af_state, tupdesc);
+
+	return af_state;
 }
 
 /*
- * ArrowIterateForeignScan
+ * ArrowBeginForeignScan
  */
-static TupleTableSlot *
-ArrowIterateForeignScan(ForeignScanState *node)
+static void
+ArrowBeginForeignScan(ForeignScanState *node, int eflags)
 {
-	ArrowFdwState  *af_state = node->fdw_state;
 	Relation		relation = node->ss.ss_currentRelation;
-	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
-	pgstrom_data_store *pds;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	ForeignScan	   *fscan = (ForeignScan *) node->ss.ps.plan;
+	ArrowFdwState  *af_state;
+	ListCell	   *lc;
+	Bitmapset	   *referenced = NULL;
 
-	while ((pds = af_state->curr_pds) == NULL ||
-		   af_state->curr_index >= pds->kds.nitems)
+	foreach (lc, fscan->fdw_private)
 	{
-		EState	   *estate = node->ss.ps.state;
+		int		j = lfirst_int(lc);
 
-		/* unload the previous RecordBatch, if any */
-		if (pds)
-			PDS_release(pds);
-		af_state->curr_index = 0;
-		af_state->curr_pds = arrowFdwLoadRecordBatch(af_state,
-													 relation,
-													 estate,
-													 NULL, -1);
-		if (!af_state->curr_pds)
-			return NULL;
+		if (j >= 0 && j <= tupdesc->natts)
+			referenced = bms_add_member(referenced, j -
+										FirstLowInvalidHeapAttributeNumber);
 	}
-	Assert(pds && af_state->curr_index < pds->kds.nitems);
-	if (KDS_fetch_tuple_arrow(slot, &pds->kds, af_state->curr_index++))
-		return slot;
-	return NULL;
-}
-
-/*
- * ArrowReScanForeignScan
- */
-void
-ExecReScanArrowFdw(ArrowFdwState *af_state)
-{
-	/* rewind the current scan state */
-	pg_atomic_write_u32(af_state->rbatch_index, 0);
-	if (af_state->curr_pds)
-		PDS_release(af_state->curr_pds);
-	af_state->curr_pds = NULL;
-	af_state->curr_index = 0;
+	af_state = ExecInitArrowFdw(NULL, relation,
+								fscan->scan.plan.qual,
+								referenced);
+	/*
+	 * Late materialization - if scan qualifiers reference only a part of
+	 * the referenced columns, we load the columns for qualifiers first,
+	 * then load the remaining columns only when any rows are survived.
+	 */
+	if (arrow_fdw_late_materialization &&
+		fscan->scan.plan.qual != NIL &&
+		!contain_volatile_functions((Node *)fscan->scan.plan.qual))
+	{
+		Bitmapset  *late_refs = NULL;
+		int			k;
+
+		pull_varattnos((Node *)fscan->scan.plan.qual,
+					   fscan->scan.scanrelid, &late_refs);
+		k = bms_next_member(late_refs, -1);
+		if (k > -FirstLowInvalidHeapAttributeNumber &&
+			bms_is_subset(late_refs, af_state->referenced) &&
+			!bms_equal(late_refs, af_state->referenced))
+		{
+			af_state->late_refs = late_refs;
+			af_state->late_quals = ExecInitQual(fscan->scan.plan.qual,
+												&node->ss.ps);
+		}
+	}
+	node->fdw_state = af_state;
 }
 
-static void
-ArrowReScanForeignScan(ForeignScanState *node)
+typedef struct
 {
-	ExecReScanArrowFdw((ArrowFdwState *)node->fdw_state);
-}
+	off_t		rb_offset;
+	off_t		f_offset;
+	off_t		m_offset;
+	cl_int		io_index;
+	cl_int      depth;
+	bool		mmap_layout;	/* i/o chunks shall begin at page boundary */
+	bool		mmap_failed;	/* buffers are not aligned for mmap */
+	strom_io_chunk ioc[FLEXIBLE_ARRAY_MEMBER];
+} arrowFdwSetupIOContext;
 
 /*
- * ArrowEndForeignScan
+ * arrowFdwSetupIOvectorField
  */
-void
-ExecEndArrowFdw(ArrowFdwState *af_state)
-{
-	ListCell   *lc;
-
-	foreach (lc, af_state->fdescList)
-		FileClose((File)lfirst_int(lc));
-	foreach (lc, af_state->gpuDirectFileDescList)
-	{
-		GPUDirectFileDesc *dfile = lfirst(lc);
-
-		untrackRawFileDesc(af_state->gcontext, dfile);
-		gpuDirectFileDescClose(dfile);
-	}
-}
-
-static void
-ArrowEndForeignScan(ForeignScanState *node)
-{
-	ExecEndArrowFdw((ArrowFdwState *)node->fdw_state);
-}
-
-/*
- * ArrowExplainForeignScan 
- */
-void
-ExplainArrowFdw(ArrowFdwState *af_state, Relation frel, ExplainState *es)
+static inline void
+__setupIOvectorField(arrowFdwSetupIOContext *con,
+					 off_t chunk_offset,
+					 size_t chunk_length,
+					 cl_uint *p_cmeta_offset,
+					 cl_uint *p_cmeta_length)
 {
-	TupleDesc	tupdesc = RelationGetDescr(frel);
-	ListCell   *lc;
-	int			fcount = 0;
-	char		label[80];
-	size_t	   *chunk_sz = alloca(sizeof(size_t) * tupdesc->natts);
-	int			i, j, k;
-	StringInfoData	buf;
+	off_t		f_pos = con->rb_offset + chunk_offset;
 
-	/* shows referenced columns */
-	initStringInfo(&buf);
-	for (k = bms_next_member(af_state->referenced, -1);
-		 k >= 0;
-		 k = bms_next_member(af_state->referenced, k))
+	if (f_pos == con->f_offset &&
+		con->m_offset == MAXALIGN(con->m_offset))
 	{
-		j = k + FirstLowInvalidHeapAttributeNumber - 1;
+		/* good, buffer is continuous */
+		*p_cmeta_offset = __kds_packed(con->m_offset);
+		*p_cmeta_length = __kds_packed(chunk_length);
 
-		if (j >= 0)
-		{
-			Form_pg_attribute	attr = tupleDescAttr(tupdesc, j);
-			const char		   *attName = NameStr(attr->attname);
-			if (buf.len > 0)
-				appendStringInfoString(&buf, ", ");
-			appendStringInfoString(&buf, quote_identifier(attName));
-		}
+		con->m_offset += chunk_length;
+		con->f_offset += chunk_length;
 	}
-	ExplainPropertyText("referenced", buf.data, es);
-
-	/* shows files on behalf of the foreign table */
-	foreach (lc, af_state->fdescList)
+	else
 	{
-		File		fdesc = (File)lfirst_int(lc);
-		const char *fname = FilePathName(fdesc);
-		int			rbcount = 0;
-		char	   *pos = label;
-		struct stat	st_buf;
+		off_t		f_base = TYPEALIGN_DOWN(PAGE_SIZE, f_pos);
+		off_t		f_tail;
+		off_t		shift = f_pos - f_base;
+		strom_io_chunk *ioc;
 
-		pos += snprintf(label, sizeof(label), "files%d", fcount++);
-		if (fstat(FileGetRawDesc(fdesc), &st_buf) != 0)
-			memset(&st_buf, 0, sizeof(struct stat));
-		if (es->format == EXPLAIN_FORMAT_TEXT)
-		{
-			resetStringInfo(&buf);
-			if (st_buf.st_size == 0)
-				appendStringInfoString(&buf, fname);
-			else
-				appendStringInfo(&buf, "%s (size: %s)",
-								 fname,
-								 format_bytesz(st_buf.st_size));
-			ExplainPropertyText(label, buf.data, es);
-		}
+		if (con->io_index < 0)
+			con->io_index = 0;	/* no previous i/o chunks */
 		else
 		{
-			ExplainPropertyText(label, fname, es);
+			ioc = &con->ioc[con->io_index++];
 
-			if (st_buf.st_size > 0)
-			{
-				sprintf(pos, "-size");
-				ExplainPropertyText(label, format_bytesz(st_buf.st_size), es);
-			}
+			f_tail = TYPEALIGN(PAGE_SIZE, con->f_offset);
+			ioc->nr_pages = f_tail / PAGE_SIZE - ioc->fchunk_id;
+			con->m_offset += (f_tail - con->f_offset); //safety margin;
 		}
-		if (!es->verbose)
-			continue;
-
-		/* below only verbose mode */
-		memset(chunk_sz, 0, sizeof(size_t) * tupdesc->natts);
-		for (i=0; i < af_state->num_rbatches; i++)
+		ioc = &con->ioc[con->io_index];
+		if (con->mmap_layout)
 		{
-			RecordBatchState *rb_state = af_state->rbatches[i];
-
-			if (rb_state->fdesc != fdesc)
-				continue;
-
-			for (k = bms_next_member(af_state->referenced, -1);
-				 k >= 0;
-				 k = bms_next_member(af_state->referenced, k))
-			{
-				j = k + FirstLowInvalidHeapAttributeNumber - 1;
-				if (j < 0 || j >= tupdesc->natts)
-					continue;
-				chunk_sz[j] += RecordBatchFieldLength(&rb_state->columns[j]);
-			}
-			rbcount++;
+			/* file pages shall be mapped on the page boundary */
+			con->m_offset = TYPEALIGN(PAGE_SIZE, con->m_offset);
+			if (shift != MAXALIGN(shift))
+				con->mmap_failed = true;
 		}
+		/* adjust position if con->m_offset is not aligned well */
+		else if (con->m_offset + shift != MAXALIGN(con->m_offset + shift))
+			con->m_offset = MAXALIGN(con->m_offset + shift) - shift;
+		ioc->m_offset   = con->m_offset;
+		ioc->fchunk_id  = f_base / PAGE_SIZE;
 
-		if (rbcount >= 0)
-		{
-			for (k = bms_next_member(af_state->referenced, -1);
-                 k >= 0;
-                 k = bms_next_member(af_state->referenced, k))
-            {
-				Form_pg_attribute attr;
+		*p_cmeta_offset = __kds_packed(con->m_offset + shift);
+		*p_cmeta_length = __kds_packed(chunk_length);
 
-				j = k + FirstLowInvalidHeapAttributeNumber - 1;
-				if (j < 0 || j >= tupdesc->natts)
-					continue;
-				attr = tupleDescAttr(tupdesc, j);
-				snprintf(label, sizeof(label),
-						 "  %s", NameStr(attr->attname));
-				ExplainPropertyText(label, format_bytesz(chunk_sz[j]), es);
-			}
-		}
+		con->m_offset  += shift + chunk_length;
+		con->f_offset   = f_pos + chunk_length;
 	}
 }
 
 static void
-ArrowExplainForeignScan(ForeignScanState *node, ExplainState *es)
+arrowFdwSetupIOvectorField(arrowFdwSetupIOContext *con,
+						   RecordBatchFieldState *fstate,
+						   kern_data_store *kds,
+						   kern_colmeta *cmeta,
+						   int64 row_start,
+						   int64 row_nitems)
 {
-	Relation	frel = node->ss.ss_currentRelation;
+	//int		index = cmeta - kds->colmeta;
+	off_t		offset;
+	size_t		length;
 
-	ExplainArrowFdw((ArrowFdwState *)node->fdw_state, frel, es);
+	if (fstate->nullmap_length > 0)
+	{
+		Assert(fstate->null_count > 0);
+		offset = fstate->nullmap_offset;
+		length = fstate->nullmap_length;
+		if (row_nitems >= 0)
+			__arrowSliceFieldBuffer(&offset, &length, 0,
+									row_start, row_nitems);
+		__setupIOvectorField(con,
+							 offset,
+							 length,
+							 &cmeta->nullmap_offset,
+							 &cmeta->nullmap_length);
+		//elog(INFO, "D%d att[%d] nullmap=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->nullmap_offset, fstate->nullmap_length, con->m_offset, con->f_offset);
+	}
+	if (fstate->dict_unitsz > 0)
+	{
+		/* dictionary index in the RecordBatch */
+		cmeta->dict_unitsz = fstate->dict_unitsz;
+		offset = fstate->values_offset;
+		length = fstate->values_length;
+		if (row_nitems >= 0)
+			__arrowSliceFieldBuffer(&offset, &length, fstate->dict_unitsz,
+									row_start, row_nitems);
+		__setupIOvectorField(con,
+							 offset,
+							 length,
+							 &cmeta->dict_index_offset,
+							 &cmeta->dict_index_length);
+		/* dictionary values in the DictionaryBatch */
+		__setupIOvectorField(con,
+							 fstate->dict_values_offset - con->rb_offset,
+							 fstate->dict_values_length,
+							 &cmeta->values_offset,
+							 &cmeta->values_length);
+		if (fstate->dict_extra_length > 0)
+			__setupIOvectorField(con,
+								 fstate->dict_extra_offset - con->rb_offset,
+								 fstate->dict_extra_length,
+								 &cmeta->extra_offset,
+								 &cmeta->extra_length);
+		return;
+	}
+	if (fstate->values_length > 0)
+	{
+		offset = fstate->values_offset;
+		length = fstate->values_length;
+		if (row_nitems >= 0)
+			__arrowSliceFieldBuffer(&offset, &length,
+									__arrowFieldUnitSize(fstate),
+									row_start, row_nitems);
+		__setupIOvectorField(con,
+							 offset,
+							 length,
+							 &cmeta->values_offset,
+							 &cmeta->values_length);
+		//elog(INFO, "D%d att[%d] values=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->values_offset, fstate->values_length, con->m_offset, con->f_offset);
+	}
+	if (fstate->extra_length > 0)
+	{
+		/* offsets are absolute, so variable-length body is not sliced */
+		__setupIOvectorField(con,
+							 fstate->extra_offset,
+							 fstate->extra_length,
+							 &cmeta->extra_offset,
+							 &cmeta->extra_length);
+		//elog(INFO, "D%d att[%d] extra=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->extra_offset, fstate->extra_length, con->m_offset, con->f_offset);
+	}
+
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
+		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		kern_colmeta *subattr;
+		int		j;
+
+		/* elements of array are referenced by the offsets; not sliced */
+		if (cmeta->atttypkind == TYPE_KIND__ARRAY)
+			row_nitems = -1;
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		con->depth++;
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			RecordBatchFieldState *child = &fstate->children[j];
+
+			arrowFdwSetupIOvectorField(con, child, kds, subattr,
+									   row_start, row_nitems);
+		}
+		con->depth--;
+	}
 }
 
 /*
- * readArrowFile
+ * arrowFdwSetupIOvector
+ *
+ * If @mmap_layout, every i/o chunk begins at the page boundary of KDS, to
+ * map the file pages on the KDS directly. It returns NULL if any buffers
+ * are not aligned for the layout.
  */
-static bool
-readArrowFile(const char *pathname, ArrowFileInfo *af_info, bool missing_ok)
+static strom_io_vector *
+arrowFdwSetupIOvector(kern_data_store *kds,
+					  RecordBatchState *rb_state,
+					  Bitmapset *referenced,
+					  int64 row_start,
+					  int64 row_nitems,
+					  bool mmap_layout)
 {
-    File	filp = PathNameOpenFile(pathname, O_RDONLY | PG_BINARY);
+	arrowFdwSetupIOContext *con;
+	strom_io_vector *iovec = NULL;
+	int			j, nr_chunks = 0;
 
-	if (filp < 0)
+	Assert(kds->nr_colmeta >= kds->ncols);
+	con = alloca(offsetof(arrowFdwSetupIOContext,
+						  ioc[4 * kds->nr_colmeta]));
+	con->rb_offset = rb_state->rb_offset;
+	con->f_offset  = ~0UL;	/* invalid offset */
+	con->m_offset  = TYPEALIGN(PAGE_SIZE, KERN_DATA_STORE_HEAD_LENGTH(kds));
+	con->io_index  = -1;
+	con->mmap_layout = mmap_layout;
+	con->mmap_failed = false;
+	/* virtual partition-key columns, if any, have no buffer */
+	for (j=0; j < kds->ncols && j < rb_state->ncols; j++)
 	{
-		if (missing_ok && errno == ENOENT)
-			return false;
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": %m", pathname)));
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		kern_colmeta *cmeta = &kds->colmeta[j];
+		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (referenced && bms_is_member(attidx, referenced))
+			arrowFdwSetupIOvectorField(con, fstate, kds, cmeta,
+									   row_start, row_nitems);
 	}
-	readArrowFileDesc(FileGetRawDesc(filp), af_info);
-	FileClose(filp);
-	return true;
+	if (con->io_index >= 0)
+	{
+		/* close the last I/O chunks */
+		strom_io_chunk *ioc = &con->ioc[con->io_index];
+
+		ioc->nr_pages = (TYPEALIGN(PAGE_SIZE, con->f_offset) / PAGE_SIZE -
+						 ioc->fchunk_id);
+		con->m_offset = ioc->m_offset + PAGE_SIZE * ioc->nr_pages;
+		nr_chunks = con->io_index + 1;
+	}
+	if (con->mmap_failed)
+		return NULL;
+	kds->length = con->m_offset;
+
+	iovec = palloc0(offsetof(strom_io_vector, ioc[nr_chunks]));
+	iovec->nr_chunks = nr_chunks;
+	if (nr_chunks > 0)
+		memcpy(iovec->ioc, con->ioc, sizeof(strom_io_chunk) * nr_chunks);
+	return iovec;
 }
 
 /*
- * RecordBatchAcquireSampleRows - random sampling
+ * __dump_kds_and_iovec - just for debug
  */
-static int
-RecordBatchAcquireSampleRows(Relation relation,
-							 RecordBatchState *rb_state,
-							 HeapTuple *rows,
-							 int nsamples)
+static inline void
+__dump_kds_and_iovec(kern_data_store *kds, strom_io_vector *iovec)
 {
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	pgstrom_data_store *pds;
-	Bitmapset	   *referenced = NULL;
-	Datum		   *values;
-	bool		   *isnull;
-	int				count;
-	int				i, j, nwords;
+#if 0
+	int		j;
 
-	/* ANALYZE needs to fetch all the attributes */
-	nwords = (tupdesc->natts - FirstLowInvalidHeapAttributeNumber +
-			  BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
-	referenced = alloca(offsetof(Bitmapset, words[nwords]));
-	referenced->nwords = nwords;
-	memset(referenced->words, -1, sizeof(bitmapword) * nwords);
-	
-	pds = __arrowFdwLoadRecordBatch(rb_state,
-									relation,
-									referenced,
-									NULL,
-									CurrentMemoryContext,
-									-1);
-	values = alloca(sizeof(Datum) * tupdesc->natts);
-	isnull = alloca(sizeof(bool)  * tupdesc->natts);
-	for (count = 0; count < nsamples; count++)
+	elog(INFO, "nchunks = %d", iovec->nr_chunks);
+	for (j=0; j < iovec->nr_chunks; j++)
 	{
-		/* fetch a row randomly */
-		i = (double)pds->kds.nitems * (((double) random()) /
-									   ((double)MAX_RANDOM_VALUE + 1));
-		Assert(i < pds->kds.nitems);
+		strom_io_chunk *ioc = &iovec->ioc[j];
 
-		for (j=0; j < pds->kds.ncols; j++)
-		{
-			kern_colmeta   *cmeta = &pds->kds.colmeta[j];
-			
-			pg_datum_arrow_ref(&pds->kds,
-							   cmeta,
-							   i,
-							   values + j,
-							   isnull + j);
-		}
-		rows[count] = heap_form_tuple(tupdesc, values, isnull);
+		elog(INFO, "io[%d] [ m_offset=%lu, f_read=%lu...%lu, nr_pages=%u}",
+			 j,
+			 ioc->m_offset,
+			 ioc->fchunk_id * PAGE_SIZE,
+			 (ioc->fchunk_id + ioc->nr_pages) * PAGE_SIZE,
+			 ioc->nr_pages);
 	}
-	PDS_release(pds);
 
-	return count;
+	elog(INFO, "kds {length=%zu nitems=%u typeid=%u typmod=%u table_oid=%u}",
+		 kds->length, kds->nitems,
+		 kds->tdtypeid, kds->tdtypmod, kds->table_oid);
+	for (j=0; j < kds->nr_colmeta; j++)
+	{
+		kern_colmeta *cmeta = &kds->colmeta[j];
+
+		elog(INFO, "%ccol[%d] nullmap=%lu,%lu values=%lu,%lu extra=%lu,%lu",
+			 j < kds->ncols ? ' ' : '*', j,
+			 __kds_unpack(cmeta->nullmap_offset),
+			 __kds_unpack(cmeta->nullmap_length),
+			 __kds_unpack(cmeta->values_offset),
+			 __kds_unpack(cmeta->values_length),
+			 __kds_unpack(cmeta->extra_offset),
+			 __kds_unpack(cmeta->extra_length));
+
+	}
+#endif
 }
 
 /*
- * ArrowAcquireSampleRows
+ * arrowFdwDecompressBuffer
  */
-static int
-ArrowAcquireSampleRows(Relation relation,
-					   int elevel,
-					   HeapTuple *rows,
-					   int nrooms,
-					   double *p_totalrows,
-					   double *p_totaldeadrows)
+static void
+arrowFdwDecompressBuffer(int codec, const char *fname,
+						 char *dest, size_t dest_len,
+						 const char *src, size_t src_len)
 {
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
-	List		   *filesList = NIL;
-	List		   *fdescList = NIL;
-	List		   *rb_state_list = NIL;
-	ListCell	   *lc;
-	bool			writable;
-	int64			total_nrows = 0;
-	int64			count_nrows = 0;
-	int				nsamples_min = nrooms / 100;
-	int				nitems = 0;
-
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	foreach (lc, filesList)
+	switch (codec)
 	{
-		char	   *fname = strVal(lfirst(lc));
-		File		fdesc;
-		List	   *rb_cached;
-		ListCell   *cell;
+		case ArrowCompressionType__LZ4_FRAME:
+#ifdef WITH_LZ4
+			{
+				LZ4F_dctx  *dctx;
+				size_t		rv, d_sz, s_sz;
+				size_t		d_pos = 0;
+				size_t		s_pos = 0;
+
+				rv = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+				if (LZ4F_isError(rv))
+					elog(ERROR, "failed on LZ4F_createDecompressionContext: %s",
+						 LZ4F_getErrorName(rv));
+				do {
+					d_sz = dest_len - d_pos;
+					s_sz = src_len - s_pos;
+					rv = LZ4F_decompress(dctx,
+										 dest + d_pos, &d_sz,
+										 src + s_pos, &s_sz, NULL);
+					if (LZ4F_isError(rv))
+					{
+						LZ4F_freeDecompressionContext(dctx);
+						elog(ERROR, "failed on LZ4F_decompress('%s'): %s",
+							 fname, LZ4F_getErrorName(rv));
+					}
+					d_pos += d_sz;
+					s_pos += s_sz;
+				} while (rv != 0 && s_pos < src_len && (d_sz > 0 || s_sz > 0));
+				LZ4F_freeDecompressionContext(dctx);
+				if (d_pos != dest_len)
+					elog(ERROR, "arrow_fdw: LZ4_FRAME buffer of '%s' has unexpected length (%zu of %zu)",
+						 fname, d_pos, dest_len);
+			}
+#else
+			elog(ERROR, "arrow_fdw: LZ4_FRAME compression is not supported in this build");
+#endif
+			break;
+		case ArrowCompressionType__ZSTD:
+#ifdef WITH_ZSTD
+			{
+				size_t		rv = ZSTD_decompress(dest, dest_len, src, src_len);
+
+				if (ZSTD_isError(rv))
+					elog(ERROR, "failed on ZSTD_decompress('%s'): %s",
+						 fname, ZSTD_getErrorName(rv));
+				if (rv != dest_len)
+					elog(ERROR, "arrow_fdw: ZSTD buffer of '%s' has unexpected length (%zu of %zu)",
+						 fname, rv, dest_len);
+			}
+#else
+			elog(ERROR, "arrow_fdw: ZSTD compression is not supported in this build");
+#endif
+			break;
+		default:
+			elog(ERROR, "arrow_fdw: unknown compression type (%d)", codec);
+	}
+}
 
-		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
-        if (fdesc < 0)
-		{
-			if (writable && errno == ENOENT)
-				continue;
-			elog(ERROR, "failed to open file '%s' on behalf of '%s'",
-				 fname, RelationGetRelationName(relation));
-		}
-		fdescList = lappend_int(fdescList, fdesc);
-		
-		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
-		foreach (cell, rb_cached)
-		{
-			RecordBatchState *rb_state = lfirst(cell);
+/*
+ * arrowFdwSetupDecompressField
+ *
+ * Buffers in the compressed body are not available for the direct loading,
+ * because each buffer consists of 64bit uncompressed length and compressed
+ * data (or raw data if the length is -1). So, we collect the buffers to be
+ * decompressed on the host side.
+ */
+typedef struct
+{
+	off_t		f_pos;			/* offset of the buffer from the file head */
+	size_t		f_len;			/* length of the buffer on the file */
+	int			codec;			/* ArrowCompressionType, or -1 */
+	size_t		m_len;			/* length of the decompressed buffer */
+	cl_uint	   *p_cmeta_offset;
+	cl_uint	   *p_cmeta_length;
+} arrowFdwDecompressChunk;
 
-			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
-				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
-					 fname, RelationGetRelationName(relation));
-			if (rb_state->rb_nitems == 0)
-				continue;	/* not reasonable to sample, skipped */
-			total_nrows += rb_state->rb_nitems;
+typedef struct
+{
+	File		fdesc;
+	off_t		rb_offset;
+	int			rb_codec;
+	int			nchunks;
+	arrowFdwDecompressChunk chunks[FLEXIBLE_ARRAY_MEMBER];
+} arrowFdwDecompressContext;
 
-			rb_state_list = lappend(rb_state_list, rb_state);
+static void
+__setupDecompressField(arrowFdwDecompressContext *con,
+					   off_t f_pos, size_t f_len, int codec,
+					   cl_uint *p_cmeta_offset,
+					   cl_uint *p_cmeta_length)
+{
+	arrowFdwDecompressChunk *chunk = &con->chunks[con->nchunks++];
+
+	chunk->f_pos = f_pos;
+	chunk->f_len = f_len;
+	chunk->codec = codec;
+	chunk->p_cmeta_offset = p_cmeta_offset;
+	chunk->p_cmeta_length = p_cmeta_length;
+	if (codec < 0 || f_len == 0)
+		chunk->m_len = f_len;
+	else
+	{
+		int64		m_len;
+
+		if (f_len < sizeof(int64))
+			elog(ERROR, "compressed buffer of '%s' is too short",
+				 FilePathName(con->fdesc));
+		if (pread(FileGetRawDesc(con->fdesc),
+				  &m_len, sizeof(int64), f_pos) != sizeof(int64))
+			elog(ERROR, "failed on pread('%s'): %m",
+				 FilePathName(con->fdesc));
+		if (m_len < 0)
+		{
+			/* not compressed actually */
+			chunk->codec = -1;
+			chunk->m_len = f_len - sizeof(int64);
 		}
+		else
+			chunk->m_len = m_len;
+		chunk->f_pos += sizeof(int64);
+		chunk->f_len -= sizeof(int64);
 	}
-	nrooms = Min(nrooms, total_nrows);
+}
 
-	/* fetch samples for each record-batch */
-	foreach (lc, rb_state_list)
-	{
-		RecordBatchState *rb_state = lfirst(lc);
-		int			nsamples;
+static void
+arrowFdwSetupDecompressField(arrowFdwDecompressContext *con,
+							 RecordBatchFieldState *fstate,
+							 kern_data_store *kds,
+							 kern_colmeta *cmeta)
+{
+	off_t		rb_offset = con->rb_offset;
 
-		count_nrows += rb_state->rb_nitems;
-		nsamples = (double)nrooms * ((double)count_nrows /
-									 (double)total_nrows) - nitems;
-		if (nitems + nsamples > nrooms)
-			nsamples = nrooms - nitems;
-		if (nsamples > nsamples_min)
-			nitems += RecordBatchAcquireSampleRows(relation,
-												   rb_state,
-												   rows + nitems,
-												   nsamples);
+	if (fstate->nullmap_length > 0)
+		__setupDecompressField(con,
+							   rb_offset + fstate->nullmap_offset,
+							   fstate->nullmap_length,
+							   con->rb_codec,
+							   &cmeta->nullmap_offset,
+							   &cmeta->nullmap_length);
+	if (fstate->dict_unitsz > 0)
+	{
+		cmeta->dict_unitsz = fstate->dict_unitsz;
+		__setupDecompressField(con,
+							   rb_offset + fstate->values_offset,
+							   fstate->values_length,
+							   con->rb_codec,
+							   &cmeta->dict_index_offset,
+							   &cmeta->dict_index_length);
+		__setupDecompressField(con,
+							   fstate->dict_values_offset,
+							   fstate->dict_values_length,
+							   fstate->dict_codec,
+							   &cmeta->values_offset,
+							   &cmeta->values_length);
+		if (fstate->dict_extra_length > 0)
+			__setupDecompressField(con,
+								   fstate->dict_extra_offset,
+								   fstate->dict_extra_length,
+								   fstate->dict_codec,
+								   &cmeta->extra_offset,
+								   &cmeta->extra_length);
+		return;
 	}
-	foreach (lc, fdescList)
-		FileClose((File)lfirst_int(lc));
+	if (fstate->values_length > 0)
+		__setupDecompressField(con,
+							   rb_offset + fstate->values_offset,
+							   fstate->values_length,
+							   con->rb_codec,
+							   &cmeta->values_offset,
+							   &cmeta->values_length);
+	if (fstate->extra_length > 0)
+		__setupDecompressField(con,
+							   rb_offset + fstate->extra_offset,
+							   fstate->extra_length,
+							   con->rb_codec,
+							   &cmeta->extra_offset,
+							   &cmeta->extra_length);
 
-	*p_totalrows = total_nrows;
-	*p_totaldeadrows = 0.0;
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
+		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		kern_colmeta *subattr;
+		int		j;
 
-	return nitems;
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			arrowFdwSetupDecompressField(con, &fstate->children[j],
+										 kds, subattr);
+		}
+	}
 }
 
 /*
- * ArrowAnalyzeForeignTable
+ * __arrowFdwLoadCompressedRecordBatch
  */
 static bool
-ArrowAnalyzeForeignTable(Relation frel,
-						 AcquireSampleRowsFunc *p_sample_rows_func,
-						 BlockNumber *p_totalpages)
+__arrowRecordBatchIsCompressed(RecordBatchState *rb_state,
+							   Bitmapset *referenced)
 {
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
-	List		   *filesList = arrowFdwExtractFilesList(ft->options);
-	ListCell	   *lc;
-	Size			totalpages = 0;
+	int		j;
 
-	foreach (lc, filesList)
+	if (rb_state->rb_codec >= 0)
+		return true;
+	for (j=0; j < rb_state->ncols; j++)
 	{
-		const char *fname = strVal(lfirst(lc));
-		struct stat	statbuf;
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
-		if (stat(fname, &statbuf) != 0)
-		{
-			elog(NOTICE, "failed on stat('%s') on behalf of '%s', skipped",
-				 fname, get_rel_name(ft->relid));
-			continue;
-		}
-		totalpages += (statbuf.st_size + BLCKSZ - 1) / BLCKSZ;
+		if (fstate->dict_unitsz > 0 &&
+			fstate->dict_codec >= 0 &&
+			referenced && bms_is_member(attidx, referenced))
+			return true;
 	}
-
-	if (totalpages > MaxBlockNumber)
-		totalpages = MaxBlockNumber;
-
-	*p_sample_rows_func = ArrowAcquireSampleRows;
-	*p_totalpages = totalpages;
-
-	return true;
+	return false;
 }
 
-/*
- * ArrowImportForeignSchema
- */
-static List *
-ArrowImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
+static pgstrom_data_store *
+__arrowFdwLoadCompressedRecordBatch(RecordBatchState *rb_state,
+									kern_data_store *kds,
+									Bitmapset *referenced,
+									GpuContext *gcontext,
+									MemoryContext mcontext)
 {
-	ArrowSchema	schema;
-	List	   *filesList;
-	ListCell   *lc;
+	arrowFdwDecompressContext *con;
+	pgstrom_data_store *pds;
+	size_t		head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds);
+	size_t		m_offset;
+	char	   *temp = NULL;
+	size_t		temp_sz = 0;
 	int			j;
-	StringInfoData	cmd;
+	CUresult	rc;
 
-	/* sanity checks */
-	switch (stmt->list_type)
+	con = alloca(offsetof(arrowFdwDecompressContext,
+						  chunks[4 * kds->nr_colmeta]));
+	con->fdesc     = rb_state->fdesc;
+	con->rb_offset = rb_state->rb_offset;
+	con->rb_codec  = rb_state->rb_codec;
+	con->nchunks   = 0;
+	for (j=0; j < kds->ncols && j < rb_state->ncols; j++)
 	{
-		case FDW_IMPORT_SCHEMA_ALL:
-			break;
-		case FDW_IMPORT_SCHEMA_LIMIT_TO:
-			elog(ERROR, "arrow_fdw does not support LIMIT TO clause");
-		case FDW_IMPORT_SCHEMA_EXCEPT:
-			elog(ERROR, "arrow_fdw does not support EXCEPT clause");
-		default:
-			elog(ERROR, "arrow_fdw: Bug? unknown list-type");
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (referenced && bms_is_member(attidx, referenced))
+			arrowFdwSetupDecompressField(con, &rb_state->columns[j],
+										 kds, &kds->colmeta[j]);
 	}
-	filesList = arrowFdwExtractFilesList(stmt->options);
-	if (filesList == NIL)
-		ereport(ERROR,
-				(errmsg("No valid apache arrow files are specified"),
-				 errhint("Use 'file' or 'dir' option to specify apache arrow files on behalf of the foreign table")));
+	/* assign location of the decompressed buffers */
+	m_offset = MAXALIGN(head_sz);
+	for (j=0; j < con->nchunks; j++)
+	{
+		arrowFdwDecompressChunk *chunk = &con->chunks[j];
 
-	/* read the schema */
-	memset(&schema, 0, sizeof(ArrowSchema));
-	foreach (lc, filesList)
+		if (chunk->m_len == 0)
+			continue;
+		*chunk->p_cmeta_offset = __kds_packed(m_offset);
+		*chunk->p_cmeta_length = __kds_packed(MAXALIGN(chunk->m_len));
+		m_offset += MAXALIGN(chunk->m_len);
+	}
+	kds->length = m_offset;
+
+	if (gcontext)
 	{
-		const char   *fname = strVal(lfirst(lc));
-		ArrowFileInfo af_info;
+		rc = gpuMemAllocManaged(gcontext,
+								(CUdeviceptr *)&pds,
+								offsetof(pgstrom_data_store,
+										 kds) + kds->length,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	}
+	else
+	{
+		pds = MemoryContextAllocHuge(mcontext,
+									 offsetof(pgstrom_data_store,
+											  kds) + kds->length);
+	}
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pds->gcontext = gcontext;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	pds->nblocks_uncached = 0;
+	pds->filedesc.rawfd = -1;
+	pds->iovec = NULL;
+	memcpy(&pds->kds, kds, head_sz);
+
+	/* read and decompress the buffers */
+	for (j=0; j < con->nchunks; j++)
+	{
+		arrowFdwDecompressChunk *chunk = &con->chunks[j];
+		char	   *dest;
+		char	   *src;
 
-		readArrowFile(fname, &af_info, false);
-		if (lc == list_head(filesList))
-		{
-			copyArrowNode(&schema.node, &af_info.footer.schema.node);
-		}
+		if (chunk->m_len == 0)
+			continue;
+		dest = (char *)&pds->kds + __kds_unpack(*chunk->p_cmeta_offset);
+		if (chunk->codec < 0)
+			src = dest;
 		else
 		{
-			/* compatibility checks */
-			ArrowSchema	   *stemp = &af_info.footer.schema;
-
-			if (schema.endianness != stemp->endianness ||
-				schema._num_fields != stemp->_num_fields)
-				elog(ERROR, "file '%s' has incompatible schema definition",
-					 fname);
-			for (j=0; j < schema._num_fields; j++)
+			if (!temp || temp_sz < chunk->f_len)
 			{
-				if (arrowTypeIsEqual(&schema.fields[j],
-									 &stemp->fields[j], 0))
-					elog(ERROR, "file '%s' has incompatible schema definition",
-						 fname);
+				if (temp)
+					pfree(temp);
+				temp_sz = chunk->f_len;
+				temp = MemoryContextAllocHuge(CurrentMemoryContext, temp_sz);
 			}
+			src = temp;
 		}
+		if (pread(FileGetRawDesc(con->fdesc), src,
+				  chunk->f_len, chunk->f_pos) != (ssize_t)chunk->f_len)
+			elog(ERROR, "failed on pread('%s'): %m",
+				 FilePathName(con->fdesc));
+		if (chunk->codec >= 0)
+			arrowFdwDecompressBuffer(chunk->codec,
+									 FilePathName(con->fdesc),
+									 dest, chunk->m_len,
+									 src, chunk->f_len);
+		if (chunk->m_len < MAXALIGN(chunk->m_len))
+			memset(dest + chunk->m_len, 0,
+				   MAXALIGN(chunk->m_len) - chunk->m_len);
 	}
+	if (temp)
+		pfree(temp);
+	return pds;
+}
 
-	/* makes a command to define foreign table */
-	initStringInfo(&cmd);
-	appendStringInfo(&cmd, "CREATE FOREIGN TABLE %s (\n",
-					 quote_identifier(stmt->remote_schema));
-	for (j=0; j < schema._num_fields; j++)
+/*
+ * __arrowFdwLoadParquetRowGroup
+ *
+ * Column chunks of Parquet file consist of pages with their own encoding
+ * and compression, so they are not available for the direct loading.
+ * We decode the referenced column chunks on the host side, then layout
+ * the decoded buffers as if it is an uncompressed RecordBatch.
+ */
+static pgstrom_data_store *
+__arrowFdwLoadParquetRowGroup(RecordBatchState *rb_state,
+							  kern_data_store *kds,
+							  Bitmapset *referenced,
+							  GpuContext *gcontext,
+							  MemoryContext mcontext)
+{
+	ParquetDecodeBuffer *buffers;
+	pgstrom_data_store *pds;
+	size_t		head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds);
+	size_t		m_offset;
+	char	   *chunk = NULL;
+	size_t		chunk_sz = 0;
+	int			j;
+	CUresult	rc;
+
+	buffers = palloc0(sizeof(ParquetDecodeBuffer) * Max(kds->ncols, 1));
+	m_offset = MAXALIGN(head_sz);
+	for (j=0; j < kds->ncols && j < rb_state->ncols; j++)
 	{
-		ArrowField *field = &schema.fields[j];
-		const char *type_name = arrowTypeToPGTypeName(field);
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		kern_colmeta   *cmeta = &kds->colmeta[j];
+		ParquetDecodeBuffer *pqbuf = &buffers[j];
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
-		if (j > 0)
-			appendStringInfo(&cmd, ",\n");
-		if (!field->name || field->_name_len == 0)
+		if (!referenced || !bms_is_member(attidx, referenced))
+			continue;
+		if (!chunk || chunk_sz < fstate->values_length)
 		{
-			elog(NOTICE, "field %d has no name, so \"__col%02d\" is used",
-				 j+1, j+1);
-			appendStringInfo(&cmd, "  __col%02d  %s", j+1, type_name);
+			if (chunk)
+				pfree(chunk);
+			chunk_sz = Max(fstate->values_length, BLCKSZ);
+			chunk = MemoryContextAllocHuge(CurrentMemoryContext, chunk_sz);
+		}
+		if (pread(FileGetRawDesc(rb_state->fdesc), chunk,
+				  fstate->values_length,
+				  fstate->values_offset) != (ssize_t)fstate->values_length)
+			elog(ERROR, "failed on pread('%s'): %m",
+				 FilePathName(rb_state->fdesc));
+		parquetDecodeColumnChunk(FilePathName(rb_state->fdesc),
+								 chunk, fstate->values_length,
+								 fstate->atttypid,
+								 fstate->pq_type,
+								 fstate->pq_type_length,
+								 fstate->pq_codec,
+								 fstate->pq_max_deflevel,
+								 rb_state->rb_nitems,
+								 pqbuf);
+		/* assign location of the decoded buffers */
+		if (pqbuf->nullmap)
+		{
+			cmeta->nullmap_offset = __kds_packed(m_offset);
+			cmeta->nullmap_length = __kds_packed(MAXALIGN(pqbuf->nullmap_len));
+			m_offset += MAXALIGN(pqbuf->nullmap_len);
+		}
+		cmeta->values_offset = __kds_packed(m_offset);
+		cmeta->values_length = __kds_packed(MAXALIGN(pqbuf->values_len));
+		m_offset += MAXALIGN(pqbuf->values_len);
+		if (pqbuf->extra)
+		{
+			cmeta->extra_offset = __kds_packed(m_offset);
+			cmeta->extra_length = __kds_packed(MAXALIGN(pqbuf->extra_len));
+			m_offset += MAXALIGN(pqbuf->extra_len);
 		}
-		else
-			appendStringInfo(&cmd, "  %s %s",
-							 quote_identifier(field->name), type_name);
 	}
-	appendStringInfo(&cmd,
-					 "\n"
-					 ") SERVER %s\n"
-					 "  OPTIONS (", stmt->server_name);
-	foreach (lc, stmt->options)
-	{
-		DefElem	   *defel = lfirst(lc);
+	if (chunk)
+		pfree(chunk);
+	kds->length = m_offset;
 
-		if (lc != list_head(stmt->options))
-			appendStringInfo(&cmd, ",\n           ");
-		appendStringInfo(&cmd, "%s '%s'",
-						 defel->defname,
-						 strVal(defel->arg));
+	if (gcontext)
+	{
+		rc = gpuMemAllocManaged(gcontext,
+								(CUdeviceptr *)&pds,
+								offsetof(pgstrom_data_store,
+										 kds) + kds->length,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	}
+	else
+	{
+		pds = MemoryContextAllocHuge(mcontext,
+									 offsetof(pgstrom_data_store,
+											  kds) + kds->length);
 	}
-	appendStringInfo(&cmd, ")");
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pds->gcontext = gcontext;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	pds->nblocks_uncached = 0;
+	pds->filedesc.rawfd = -1;
+	pds->iovec = NULL;
+	memcpy(&pds->kds, kds, head_sz);
+
+	/* copy the decoded buffers */
+	for (j=0; j < kds->ncols && j < rb_state->ncols; j++)
+	{
+		kern_colmeta   *cmeta = &kds->colmeta[j];
+		ParquetDecodeBuffer *pqbuf = &buffers[j];
+		char	   *base = (char *)&pds->kds;
 
-	return list_make1(cmd.data);
-}
+		if (!pqbuf->values)
+			continue;
+		if (pqbuf->nullmap)
+		{
+			memset(base + __kds_unpack(cmeta->nullmap_offset), 0,
+				   __kds_unpack(cmeta->nullmap_length));
+			memcpy(base + __kds_unpack(cmeta->nullmap_offset),
+				   pqbuf->nullmap, pqbuf->nullmap_len);
+			pfree(pqbuf->nullmap);
+		}
+		memset(base + __kds_unpack(cmeta->values_offset), 0,
+			   __kds_unpack(cmeta->values_length));
+		memcpy(base + __kds_unpack(cmeta->values_offset),
+			   pqbuf->values, pqbuf->values_len);
+		pfree(pqbuf->values);
+		if (pqbuf->extra)
+		{
+			memset(base + __kds_unpack(cmeta->extra_offset), 0,
+				   __kds_unpack(cmeta->extra_length));
+			memcpy(base + __kds_unpack(cmeta->extra_offset),
+				   pqbuf->extra, pqbuf->extra_len);
+			pfree(pqbuf->extra);
+		}
+	}
+	pfree(buffers);
 
-/*
- * ArrowIsForeignScanParallelSafe
- */
-static bool
-ArrowIsForeignScanParallelSafe(PlannerInfo *root,
-							   RelOptInfo *rel,
-							   RangeTblEntry *rte)
-{
-	return true;
+	return pds;
 }
 
 /*
- * ArrowEstimateDSMForeignScan 
+ * __arrowFdwRemoteFieldRanges
  */
-Size
-ExecEstimateDSMArrowFdw(ArrowFdwState *af_state)
+static int
+__arrowFdwRemoteFieldRanges(RecordBatchFieldState *fstate,
+							off_t rb_offset,
+							int64 row_start,
+							int64 row_nitems,
+							off_t *offsets,
+							size_t *lengths,
+							int k)
 {
-	return MAXALIGN(sizeof(pg_atomic_uint32));
-}
+	off_t		offset;
+	size_t		length;
+	int			j;
 
-static Size
-ArrowEstimateDSMForeignScan(ForeignScanState *node,
-							ParallelContext *pcxt)
-{
-	return ExecEstimateDSMArrowFdw((ArrowFdwState *)node->fdw_state);
+	if (fstate->nullmap_length > 0)
+	{
+		offset = fstate->nullmap_offset;
+		length = fstate->nullmap_length;
+		if (row_nitems >= 0)
+			__arrowSliceFieldBuffer(&offset, &length, 0,
+									row_start, row_nitems);
+		offsets[k] = rb_offset + offset;
+		lengths[k++] = length;
+	}
+	if (fstate->values_length > 0)
+	{
+		offset = fstate->values_offset;
+		length = fstate->values_length;
+		if (row_nitems >= 0)
+			__arrowSliceFieldBuffer(&offset, &length,
+									__arrowFieldUnitSize(fstate),
+									row_start, row_nitems);
+		offsets[k] = rb_offset + offset;
+		lengths[k++] = length;
+		/* elements of array are referenced by the offsets; not sliced */
+		row_nitems = -1;
+	}
+	if (fstate->extra_length > 0)
+	{
+		offsets[k] = rb_offset + fstate->extra_offset;
+		lengths[k++] = fstate->extra_length;
+	}
+	/* DictionaryBatches are already downloaded on arrowS3ResolveCacheFile */
+	for (j=0; j < fstate->num_children; j++)
+	{
+		k = __arrowFdwRemoteFieldRanges(&fstate->children[j],
+										rb_offset,
+										row_start,
+										row_nitems,
+										offsets,
+										lengths, k);
+	}
+	return k;
 }
 
 /*
- * ArrowInitializeDSMForeignScan
+ * __arrowFdwFetchRemoteRecordBatch
+ *
+ * It downloads the buffers of the referenced columns onto the local cache
+ * file, if the RecordBatch is on the object storage.
  */
-void
-ExecInitDSMArrowFdw(ArrowFdwState *af_state, pg_atomic_uint32 *rbatch_index)
-{
-	pg_atomic_init_u32(rbatch_index, 0);
-	af_state->rbatch_index = rbatch_index;
-}
-
 static void
-ArrowInitializeDSMForeignScan(ForeignScanState *node,
-							  ParallelContext *pcxt,
-							  void *coordinate)
-{
-	ExecInitDSMArrowFdw((ArrowFdwState *)node->fdw_state,
-						(pg_atomic_uint32 *) coordinate);
-}
-
-/*
- * ArrowReInitializeDSMForeignScan
- */
-void
-ExecReInitDSMArrowFdw(ArrowFdwState *af_state)
+__arrowFdwFetchRemoteRecordBatch(RecordBatchState *rb_state,
+								 Bitmapset *referenced,
+								 int64 row_start,
+								 int64 row_nitems)
 {
-	pg_atomic_write_u32(af_state->rbatch_index, 0);
-}
+	int			nfields = RecordBatchFieldCount(rb_state);
+	off_t	   *offsets = alloca(sizeof(off_t) * 3 * nfields);
+	size_t	   *lengths = alloca(sizeof(size_t) * 3 * nfields);
+	int			j, k = 0;
 
+	for (j=0; j < rb_state->ncols; j++)
+	{
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
-static void
-ArrowReInitializeDSMForeignScan(ForeignScanState *node,
-								ParallelContext *pcxt,
-								void *coordinate)
-{
-	ExecReInitDSMArrowFdw((ArrowFdwState *)node->fdw_state);
+		if (referenced && bms_is_member(attidx, referenced))
+			k = __arrowFdwRemoteFieldRanges(&rb_state->columns[j],
+											rb_state->rb_offset,
+											row_start,
+											row_nitems,
+											offsets,
+											lengths, k);
+	}
+	if (k > 0)
+		arrowS3FetchCacheRanges(FilePathName(rb_state->fdesc),
+								k, offsets, lengths);
 }
 
 /*
- * ArrowInitializeWorkerForeignScan
+ * arrowMmapChunk - tracks the virtual address range of the RecordBatch
+ * mapped by __arrowFdwMmapRecordBatch, to unmap it on error also.
  */
-void
-ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
-					   pg_atomic_uint32 *rbatch_index)
+typedef struct arrowMmapChunk
 {
-	af_state->rbatch_index = rbatch_index;
-}
+	MemoryContextCallback cb;
+	void	   *mmap_base;
+	size_t		mmap_length;
+} arrowMmapChunk;
 
 static void
-ArrowInitializeWorkerForeignScan(ForeignScanState *node,
-								 shm_toc *toc,
-								 void *coordinate)
+__arrowFdwUnmapChunk(void *arg)
 {
-	ExecInitWorkerArrowFdw((ArrowFdwState *)node->fdw_state,
-						   (pg_atomic_uint32 *) coordinate);
+	arrowMmapChunk *mchunk = arg;
+
+	if (mchunk->mmap_base)
+	{
+		if (munmap(mchunk->mmap_base, mchunk->mmap_length) != 0)
+			elog(WARNING, "failed on munmap: %m");
+		mchunk->mmap_base = NULL;
+	}
 }
 
 /*
- * ArrowShutdownForeignScan
+ * arrowFdwUnmapRecordBatch - called by PDS_release
  */
 void
-ExecShutdownArrowFdw(ArrowFdwState *af_state)
-{
-	/* nothing to do */
-}
-
-static void
-ArrowShutdownForeignScan(ForeignScanState *node)
+arrowFdwUnmapRecordBatch(pgstrom_data_store *pds)
 {
-	ExecShutdownArrowFdw((ArrowFdwState *)node->fdw_state);
+	/*
+	 * PDS itself shall be gone with the mapping. @mmap_chunk is kept until
+	 * reset of the memory context, because its callback is still registered.
+	 */
+	__arrowFdwUnmapChunk(pds->mmap_chunk);
 }
 
 /*
- * ArrowPlanForeignModify
+ * __arrowFdwMmapRecordBatch
+ *
+ * It maps the file pages of the referenced column buffers onto KDS directly,
+ * for CPU-only scan. PDS and KDS header are put on the anonymous pages in
+ * front of the mapped buffers, and the gap between the buffers are never
+ * touched, so we don't need to copy the buffers nor to consume memory.
  */
-static List *
-ArrowPlanForeignModify(PlannerInfo *root,
-					   ModifyTable *plan,
-					   Index resultRelation,
-					   int subplan_index)
+static pgstrom_data_store *
+__arrowFdwMmapRecordBatch(RecordBatchState *rb_state,
+						  kern_data_store *kds,
+						  strom_io_vector *iovec,
+						  MemoryContext mcontext)
 {
-	RangeTblEntry  *rte = planner_rt_fetch(resultRelation, root);
-	ForeignTable   *ft = GetForeignTable(rte->relid);
-	List		   *filesList	__attribute__((unused));
-	bool			writable;
+	size_t		head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds);
+	size_t		pds_offset = TYPEALIGN(PAGE_SIZE, offsetof(pgstrom_data_store,
+														   kds));
+	size_t		mmap_length = pds_offset + kds->length;
+	int			fdesc = FileGetRawDesc(rb_state->fdesc);
+	arrowMmapChunk *mchunk;
+	pgstrom_data_store *pds;
+	char	   *base;
+	int			j;
 
-	if (plan->operation != CMD_INSERT)
-		elog(ERROR, "not a supported operation on arrow_fdw foreign tables");
+	mchunk = MemoryContextAllocZero(mcontext, sizeof(arrowMmapChunk));
+	base = mmap(NULL, mmap_length,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS,
+				-1, 0);
+	if (base == MAP_FAILED)
+	{
+		pfree(mchunk);
+		return NULL;
+	}
+	mchunk->mmap_base = base;
+	mchunk->mmap_length = mmap_length;
+	mchunk->cb.func = __arrowFdwUnmapChunk;
+	mchunk->cb.arg = mchunk;
+	MemoryContextRegisterResetCallback(mcontext, &mchunk->cb);
 
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	if (!writable)
-		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
-			 get_rel_name(rte->relid));
-	Assert(list_length(filesList) == 1);
+	for (j=0; j < iovec->nr_chunks; j++)
+	{
+		strom_io_chunk *ioc = &iovec->ioc[j];
+		char	   *dest = base + pds_offset + ioc->m_offset;
+		size_t		len = (size_t)ioc->nr_pages * PAGE_SIZE;
+
+		Assert(ioc->m_offset == TYPEALIGN(PAGE_SIZE, ioc->m_offset));
+		if (mmap(dest, len,
+				 PROT_READ,
+				 MAP_PRIVATE | MAP_FIXED,
+				 fdesc, (off_t)ioc->fchunk_id * PAGE_SIZE) == MAP_FAILED)
+		{
+			elog(DEBUG2, "failed on mmap('%s'): %m",
+				 FilePathName(rb_state->fdesc));
+			__arrowFdwUnmapChunk(mchunk);
+			return NULL;
+		}
+		/* hint for the readahead; only referenced columns are touched */
+		if (madvise(dest, len, MADV_SEQUENTIAL) != 0 ||
+			madvise(dest, len, MADV_WILLNEED) != 0)
+			elog(DEBUG2, "failed on madvise: %m");
+	}
+	pds = (pgstrom_data_store *)(base + pds_offset -
+								 offsetof(pgstrom_data_store, kds));
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	pds->filedesc.rawfd = -1;
+	pds->mmap_chunk = mchunk;
+	memcpy(&pds->kds, kds, head_sz);
 
-	return NIL;
+	return pds;
 }
 
 /*
- * ArrowBeginForeignModify
+ * arrowFdwLoadRecordBatch
  */
-static void
-ArrowBeginForeignModify(ModifyTableState *mtstate,
-						ResultRelInfo *rrinfo,
-						List *fdw_private,
-						int subplan_index,
-						int eflags)
+static pgstrom_data_store *
+__arrowFdwLoadRecordBatch(RecordBatchState *rb_state,
+						  int64 row_start,
+						  int64 row_nitems,
+						  Relation relation,
+						  Bitmapset *referenced,
+						  GpuContext *gcontext,
+						  MemoryContext mcontext,
+						  int optimal_gpu)
 {
-	Relation		frel = rrinfo->ri_RelationDesc;
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
-	List		   *filesList = arrowFdwExtractFilesList(ft->options);
-	const char	   *fname;
-	File			filp;
-	bool			redo_log_written = false;
-
-	Assert(list_length(filesList) == 1);
-	fname = strVal(linitial(filesList));
-
-	LockRelation(frel, ShareRowExclusiveLock);
+	TupleDesc			tupdesc = RelationGetDescr(relation);
+	pgstrom_data_store *pds;
+	kern_data_store	   *kds;
+	strom_io_vector	   *iovec;
+	size_t				head_sz;
+	int					j;
+	CUresult			rc;
 
-	filp = PathNameOpenFile(fname, O_RDWR | PG_BINARY);
-	if (filp < 0)
-	{
-		if (errno != ENOENT)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not open file \"%s\": %m", fname)));
+	/* setup KDS and I/O-vector */
+	head_sz = KDS_calculateHeadSize(tupdesc);
+	kds = alloca(head_sz);
+	init_kernel_data_store(kds, tupdesc, 0, KDS_FORMAT_ARROW, 0);
+	if (row_nitems < 0)
+	{
+		kds->nitems = rb_state->rb_nitems;
+		kds->nrooms = rb_state->rb_nitems;
+	}
+	else
+	{
+		/* a range of rows in the RecordBatch; see arrowFdwSetupScanUnits */
+		Assert(!rb_state->rb_parquet &&
+			   !__arrowRecordBatchIsCompressed(rb_state, referenced));
+		kds->nitems = row_nitems;
+		kds->nrooms = row_nitems;
+	}
+	kds->table_oid = RelationGetRelid(relation);
+	Assert(head_sz == KERN_DATA_STORE_HEAD_LENGTH(kds));
+	for (j=0; j < kds->nr_colmeta && j < rb_state->ncols; j++)
+		kds->colmeta[j].attopts = rb_state->columns[j].attopts;
+	/* download the buffers from the object storage, if not cached yet */
+	if (arrowS3IsCacheFile(FilePathName(rb_state->fdesc)))
+		__arrowFdwFetchRemoteRecordBatch(rb_state, referenced,
+										 row_start, row_nitems);
+	/* RowGroup of Parquet file shall be decoded on the host side */
+	if (rb_state->rb_parquet)
+		return __arrowFdwLoadParquetRowGroup(rb_state, kds,
+											 referenced,
+											 gcontext,
+											 mcontext);
+	/* compressed RecordBatch shall be decompressed on the host side */
+	if (__arrowRecordBatchIsCompressed(rb_state, referenced))
+		return __arrowFdwLoadCompressedRecordBatch(rb_state, kds,
+												   referenced,
+												   gcontext,
+												   mcontext);
+	/*
+	 * CPU-only scan references the column buffers mapped on the file,
+	 * if they are aligned well.
+	 */
+	if (!gcontext && arrow_fdw_mmap_enabled)
+	{
+		iovec = arrowFdwSetupIOvector(kds, rb_state, referenced,
+									  row_start, row_nitems, true);
+		if (iovec)
+		{
+			if (iovec->nr_chunks > 0)
+				pds = __arrowFdwMmapRecordBatch(rb_state, kds, iovec,
+												mcontext);
+			else
+				pds = NULL;
+			pfree(iovec);
+			if (pds)
+				return pds;
+		}
+	}
+	iovec = arrowFdwSetupIOvector(kds, rb_state, referenced,
+								  row_start, row_nitems, false);
+	__dump_kds_and_iovec(kds, iovec);
 
-		filp = PathNameOpenFile(fname, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
-		if (filp < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not open file \"%s\": %m", fname)));
-		PG_TRY();
+	/*
+	 * If SSD-to-GPU Direct SQL is available on the arrow file, setup a small
+	 * PDS on host-pinned memory, with strom_io_vector.
+	 */
+	if (gcontext &&
+		gcontext->cuda_dindex == optimal_gpu &&
+		iovec->nr_chunks > 0 &&
+		kds->length <= gpuMemAllocIOMapMaxLength() &&
+		rb_state->dfile != NULL)
+	{
+		size_t	iovec_sz = offsetof(strom_io_vector, ioc[iovec->nr_chunks]);
+
+		rc = gpuMemAllocHost(gcontext, (void **)&pds,
+							 offsetof(pgstrom_data_store, kds) +
+							 head_sz + iovec_sz);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocHost: %s", errorText(rc));
+
+		memset(pds, 0, offsetof(pgstrom_data_store, kds));
+		pds->gcontext = gcontext;
+		pg_atomic_init_u32(&pds->refcnt, 1);
+		pds->nblocks_uncached = 0;
+		memcpy(&pds->filedesc, rb_state->dfile, sizeof(GPUDirectFileDesc));
+		pds->iovec = (strom_io_vector *)((char *)&pds->kds + head_sz);
+		memcpy(&pds->kds, kds, head_sz);
+		memcpy(pds->iovec, iovec, iovec_sz);
+	}
+	else
+	{
+		/* Elsewhere, load RecordBatch by filesystem */
+		int		fdesc = FileGetRawDesc(rb_state->fdesc);
+
+		if (gcontext)
 		{
-			createArrowWriteRedoLog(filp, true);
-			redo_log_written = true;
+			rc = gpuMemAllocManaged(gcontext,
+									(CUdeviceptr *)&pds,
+									offsetof(pgstrom_data_store,
+											 kds) + kds->length,
+									CU_MEM_ATTACH_GLOBAL);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
 		}
-		PG_CATCH();
+		else
 		{
-			unlink(fname);
-			PG_RE_THROW();
+			pds = MemoryContextAllocHuge(mcontext,
+										 offsetof(pgstrom_data_store,
+												  kds) + kds->length);
 		}
-		PG_END_TRY();
+		__PDS_fillup_arrow(pds, gcontext, kds, fdesc, iovec);
 	}
-	rrinfo->ri_FdwState = createArrowWriteState(frel, filp,
-												redo_log_written);
+	pfree(iovec);
+	return pds;
 }
 
 /*
- * ArrowExecForeignInsert
+ * arrowFdwNextRecordBatch
+ *
+ * It fetches the next unit of RecordBatch (or a range of rows in a large
+ * RecordBatch), but skipped by min/max stats, if possible
  */
-static TupleTableSlot *
-ArrowExecForeignInsert(EState *estate,
-					   ResultRelInfo *rrinfo,
-					   TupleTableSlot *slot,
-					   TupleTableSlot *planSlot)
+static RecordBatchState *
+arrowFdwNextRecordBatch(ArrowFdwState *af_state,
+						int64 *p_row_start,
+						int64 *p_row_nitems)
 {
-	Relation		frel = rrinfo->ri_RelationDesc;
-	TupleDesc		tupdesc = RelationGetDescr(frel);
-	arrowWriteState *aw_state = rrinfo->ri_FdwState;
-	SQLtable	   *table = &aw_state->sql_table;
-	MemoryContext	oldcxt;
-	size_t			usage = 0;
-	int				j;
+	RecordBatchState *rb_state;
+	arrowScanUnit *unit;
+	uint32		unit_index;
 
-	slot_getallattrs(slot);
-	oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
-	for (j=0; j < tupdesc->natts; j++)
+	for (;;)
 	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
-		SQLfield   *column = &table->columns[j];
-		Datum		datum = slot->tts_values[j];
-		bool		isnull = slot->tts_isnull[j];
+		unit_index = pg_atomic_fetch_add_u32(af_state->rbatch_index, 1);
+		if (unit_index >= af_state->num_units)
+			return NULL;	/* no more RecordBatch to read */
+		unit = &af_state->units[unit_index];
+		rb_state = af_state->rbatches[unit->rb_index];
+		if (execCheckArrowStatsHint(af_state, rb_state))
+			break;
+		/* count the skipped RecordBatch only once */
+		if (unit->row_start == 0)
+			af_state->stats_nskipped++;
+	}
+	if (af_state->rb_partvals)
+		af_state->curr_partvals = af_state->rb_partvals[unit->rb_index];
+	*p_row_start = unit->row_start;
+	*p_row_nitems = unit->row_nitems;
+	return rb_state;
+}
 
-		if (isnull)
+static pgstrom_data_store *
+arrowFdwLoadRecordBatch(ArrowFdwState *af_state,
+						Relation relation,
+						EState *estate,
+						GpuContext *gcontext,
+						int optimal_gpu)
+{
+	RecordBatchState *rb_state;
+	int64		row_start;
+	int64		row_nitems;
+
+	rb_state = arrowFdwNextRecordBatch(af_state, &row_start, &row_nitems);
+	if (!rb_state)
+		return NULL;
+	return __arrowFdwLoadRecordBatch(rb_state,
+									 row_start,
+									 row_nitems,
+									 relation,
+									 af_state->referenced,
+									 gcontext,
+									 estate->es_query_cxt,
+									 optimal_gpu);
+}
+
+/*
+ * arrowFdwFillupPartitionValues
+ */
+static inline void
+arrowFdwFillupPartitionValues(ArrowFdwState *af_state, TupleTableSlot *slot)
+{
+	arrowPartitionValues *pv = af_state->curr_partvals;
+
+	if (pv)
+	{
+		int		j, k = slot->tts_tupleDescriptor->natts - af_state->part_nkeys;
+
+		for (j=0; j < af_state->part_nkeys; j++)
 		{
-			usage += sql_field_put_value(column, NULL, 0);
+			slot->tts_values[k+j] = pv->values[j];
+			slot->tts_isnull[k+j] = pv->isnull[j];
 		}
-		else if (attr->attbyval)
+	}
+}
+
+/*
+ * arrowFdwLoadRecordBatchLate
+ *
+ * It loads only the columns referenced by the scan qualifiers at first,
+ * and evaluates the qualifiers for each row. The remaining columns are
+ * loaded only if any rows are survived, and @curr_rowmap tells the rows
+ * to be fetched.
+ */
+static pgstrom_data_store *
+arrowFdwLoadRecordBatchLate(ArrowFdwState *af_state, ForeignScanState *node)
+{
+	Relation		relation = node->ss.ss_currentRelation;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	ExprContext	   *econtext = node->ss.ps.ps_ExprContext;
+	MemoryContext	mcontext = node->ss.ps.state->es_query_cxt;
+	RecordBatchState *rb_state;
+	pgstrom_data_store *pds;
+	bool		   *rowmap;
+	size_t			i, nmatched;
+	int64			row_start;
+	int64			row_nitems;
+
+	while ((rb_state = arrowFdwNextRecordBatch(af_state,
+											   &row_start,
+											   &row_nitems)) != NULL)
+	{
+		pds = __arrowFdwLoadRecordBatch(rb_state,
+										row_start,
+										row_nitems,
+										relation,
+										af_state->late_refs,
+										NULL,
+										mcontext,
+										-1);
+		rowmap = MemoryContextAlloc(mcontext, sizeof(bool) *
+									Max(pds->kds.nitems, 1));
+		nmatched = 0;
+		for (i=0; i < pds->kds.nitems; i++)
 		{
-			Assert(column->sql_type.pgsql.typbyval);
-			usage += sql_field_put_value(column, (char *)&datum, attr->attlen);
+			KDS_fetch_tuple_arrow(slot, &pds->kds, i);
+			arrowFdwFillupPartitionValues(af_state, slot);
+			ResetExprContext(econtext);
+			econtext->ecxt_scantuple = slot;
+			rowmap[i] = ExecQual(af_state->late_quals, econtext);
+			if (rowmap[i])
+				nmatched++;
 		}
-		else if (attr->attlen == -1)
-		{
-			int		vl_len = VARSIZE_ANY_EXHDR(datum);
-			char   *vl_ptr = VARDATA_ANY(datum);
+		ExecClearTuple(slot);
+		PDS_release(pds);
 
-			Assert(column->sql_type.pgsql.typlen == -1);
-			usage += sql_field_put_value(column, vl_ptr, vl_len);
-		}
-		else
+		if (nmatched > 0)
 		{
-			elog(ERROR, "Bug? unsupported type format");
+			af_state->curr_rowmap = rowmap;
+			return __arrowFdwLoadRecordBatch(rb_state,
+											 row_start,
+											 row_nitems,
+											 relation,
+											 af_state->referenced,
+											 NULL,
+											 mcontext,
+											 -1);
 		}
+		pfree(rowmap);
+		af_state->late_nskipped++;
 	}
-	table->nitems++;
-	MemoryContextSwitchTo(oldcxt);
+	return NULL;
+}
 
-	/*
-	 * If usage exceeds the threshold of record-batch size, make a redo-log
-	 * on demand, and write out the buffer.
-	 */
-	if (usage > table->segment_sz)
-		writeOutArrowRecordBatch(aw_state, false);
+/*
+ * ExecScanChunkArrowFdw
+ */
+pgstrom_data_store *
+ExecScanChunkArrowFdw(GpuTaskState *gts)
+{
+	pgstrom_data_store *pds;
 
-	return slot;
+	InstrStartNode(&gts->outer_instrument);
+	pds = arrowFdwLoadRecordBatch(gts->af_state,
+								  gts->css.ss.ss_currentRelation,
+								  gts->css.ss.ps.state,
+								  gts->gcontext,
+								  gts->optimal_gpu);
+	InstrStopNode(&gts->outer_instrument,
+				  !pds ? 0.0 : (double)pds->kds.nitems);
+	return pds;
 }
 
 /*
- * ArrowEndForeignModify
+ * ArrowIterateForeignScan
  */
-static void
-ArrowEndForeignModify(EState *estate,
-					  ResultRelInfo *rrinfo)
+static TupleTableSlot *
+ArrowIterateForeignScan(ForeignScanState *node)
 {
-	arrowWriteState *aw_state = rrinfo->ri_FdwState;
+	ArrowFdwState  *af_state = node->fdw_state;
+	Relation		relation = node->ss.ss_currentRelation;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	pgstrom_data_store *pds;
 
-	writeOutArrowRecordBatch(aw_state, true);
+	for (;;)
+	{
+		while ((pds = af_state->curr_pds) == NULL ||
+			   af_state->curr_index >= pds->kds.nitems)
+		{
+			EState	   *estate = node->ss.ps.state;
+
+			/* unload the previous RecordBatch, if any */
+			if (pds)
+				PDS_release(pds);
+			if (af_state->curr_rowmap)
+				pfree(af_state->curr_rowmap);
+			af_state->curr_rowmap = NULL;
+			af_state->curr_index = 0;
+			if (af_state->late_quals)
+				af_state->curr_pds = arrowFdwLoadRecordBatchLate(af_state,
+																 node);
+			else
+				af_state->curr_pds = arrowFdwLoadRecordBatch(af_state,
+															 relation,
+															 estate,
+															 NULL, -1);
+			if (!af_state->curr_pds)
+				return NULL;
+		}
+		/* skip rows which never satisfy the scan qualifiers */
+		if (!af_state->curr_rowmap ||
+			af_state->curr_rowmap[af_state->curr_index])
+			break;
+		af_state->curr_index++;
+	}
+	Assert(pds && af_state->curr_index < pds->kds.nitems);
+	if (KDS_fetch_tuple_arrow(slot, &pds->kds, af_state->curr_index++))
+	{
+		/* fill up virtual partition-key columns */
+		arrowFdwFillupPartitionValues(af_state, slot);
+		return slot;
+	}
+	return NULL;
 }
 
 /*
- * ArrowExplainForeignModify
+ * ArrowReScanForeignScan
  */
+void
+ExecReScanArrowFdw(ArrowFdwState *af_state)
+{
+	/* rewind the current scan state */
+	pg_atomic_write_u32(af_state->rbatch_index, 0);
+	if (af_state->curr_pds)
+		PDS_release(af_state->curr_pds);
+	af_state->curr_pds = NULL;
+	if (af_state->curr_rowmap)
+		pfree(af_state->curr_rowmap);
+	af_state->curr_rowmap = NULL;
+	af_state->curr_index = 0;
+}
+
 static void
-ArrowExplainForeignModify(ModifyTableState *mtstate,
-						  ResultRelInfo *rinfo,
-						  List *fdw_private,
-						  int subplan_index,
-						  struct ExplainState *es)
+ArrowReScanForeignScan(ForeignScanState *node)
 {
-	/* print something */
+	ExecReScanArrowFdw((ArrowFdwState *)node->fdw_state);
 }
 
 /*
- * handler of Arrow_Fdw
+ * ArrowEndForeignScan
  */
-Datum
-pgstrom_arrow_fdw_handler(PG_FUNCTION_ARGS)
+void
+ExecEndArrowFdw(ArrowFdwState *af_state)
 {
-	PG_RETURN_POINTER(&pgstrom_arrow_fdw_routine);
+	ListCell   *lc;
+
+	foreach (lc, af_state->fdescList)
+		FileClose((File)lfirst_int(lc));
+	foreach (lc, af_state->gpuDirectFileDescList)
+	{
+		GPUDirectFileDesc *dfile = lfirst(lc);
+
+		untrackRawFileDesc(af_state->gcontext, dfile);
+		gpuDirectFileDescClose(dfile);
+	}
+}
+
+static void
+ArrowEndForeignScan(ForeignScanState *node)
+{
+	ExecEndArrowFdw((ArrowFdwState *)node->fdw_state);
 }
-PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_handler);
 
 /*
- * arrowTypeIsEqual
+ * ExecArrowFdwDataVersion
+ *
+ * It appends the identifier of the current contents of the files to be
+ * scanned. Apache Arrow files are replaced or appended by external tools,
+ * so device/inode, size and modification time of the file (which are also
+ * keys of the metadata cache) tells us whether the contents are unchanged.
+ * Writable arrow table returns false, because visibility of the rows appended
+ * by INSERT is determined by the MVCC logs, not the file itself.
  */
-static bool
-arrowTypeIsEqual(ArrowField *a, ArrowField *b, int depth)
+bool
+ExecArrowFdwDataVersion(ArrowFdwState *af_state, StringInfo buf)
 {
-	int		j;
+	ListCell   *lc;
 
-	if (a->type.node.tag != b->type.node.tag)
+	if (af_state->writable)
 		return false;
-	switch (a->type.node.tag)
+	foreach (lc, af_state->fdescList)
 	{
-		case ArrowNodeTag__Int:
-			if (a->type.Int.bitWidth != b->type.Int.bitWidth)
-				return false;
-			break;
-		case ArrowNodeTag__FloatingPoint:
-			{
-				ArrowPrecision	p1 = a->type.FloatingPoint.precision;
-				ArrowPrecision	p2 = b->type.FloatingPoint.precision;
-
-				if (p1 != p2)
-					return false;
-			}
-			break;
-		case ArrowNodeTag__Utf8:
-		case ArrowNodeTag__Binary:
-		case ArrowNodeTag__Bool:
-			break;
+		File		fdesc = (File)lfirst_int(lc);
+		struct stat	st_buf;
 
-		case ArrowNodeTag__Decimal:
-			if (a->type.Decimal.precision != b->type.Decimal.precision ||
-				a->type.Decimal.scale != b->type.Decimal.scale)
-				return false;
-			break;
+		if (fstat(FileGetRawDesc(fdesc), &st_buf) != 0)
+			return false;
+		appendStringInfo(buf, "[%lu:%lu:%ld:%ld.%09ld:%ld.%09ld]",
+						 (unsigned long)st_buf.st_dev,
+						 (unsigned long)st_buf.st_ino,
+						 (long)st_buf.st_size,
+						 (long)st_buf.st_mtim.tv_sec,
+						 (long)st_buf.st_mtim.tv_nsec,
+						 (long)st_buf.st_ctim.tv_sec,
+						 (long)st_buf.st_ctim.tv_nsec);
+	}
+	return true;
+}
 
-		case ArrowNodeTag__Date:
-			if (a->type.Date.unit != b->type.Date.unit)
-				return false;
-			break;
+/*
+ * ArrowExplainForeignScan 
+ */
+void
+ExplainArrowFdw(ArrowFdwState *af_state, Relation frel, ExplainState *es)
+{
+	TupleDesc	tupdesc = RelationGetDescr(frel);
+	ListCell   *lc;
+	int			fcount = 0;
+	char		label[80];
+	size_t	   *chunk_sz = alloca(sizeof(size_t) * tupdesc->natts);
+	int			i, j, k;
+	StringInfoData	buf;
 
-		case ArrowNodeTag__Time:
-			if (a->type.Time.unit != b->type.Time.unit)
-				return false;
-			break;
+	/* shows referenced columns */
+	initStringInfo(&buf);
+	for (k = bms_next_member(af_state->referenced, -1);
+		 k >= 0;
+		 k = bms_next_member(af_state->referenced, k))
+	{
+		j = k + FirstLowInvalidHeapAttributeNumber - 1;
 
-		case ArrowNodeTag__Timestamp:
-			if (a->type.Timestamp.unit != b->type.Timestamp.unit ||
-				a->type.Timestamp.timezone != NULL ||
-				b->type.Timestamp.timezone != NULL)
-				return false;
-			break;
+		if (j >= 0)
+		{
+			Form_pg_attribute	attr = tupleDescAttr(tupdesc, j);
+			const char		   *attName = NameStr(attr->attname);
+			if (buf.len > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfoString(&buf, quote_identifier(attName));
+		}
+	}
+	ExplainPropertyText("referenced", buf.data, es);
 
-		case ArrowNodeTag__Interval:
-			if (a->type.Interval.unit != b->type.Interval.unit)
-				return false;
-			break;
+	/* shows min/max statistics hint, if any */
+	if (af_state->stats_hint != NIL)
+	{
+		resetStringInfo(&buf);
+		foreach (lc, af_state->stats_hint)
+		{
+			arrowStatsHint *hint = lfirst(lc);
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, hint->attnum - 1);
+			const char *opname;
+			Oid			typoutput;
+			bool		typisvarlena;
 
-		case ArrowNodeTag__Struct:
-			if (depth > 0)
-				elog(ERROR, "arrow: nested composite types are not supported");
-			if (a->_num_children != b->_num_children)
-				return false;
-			for (j=0; j < a->_num_children; j++)
+			switch (hint->strategy)
 			{
-				if (!arrowTypeIsEqual(&a->children[j],
-									  &b->children[j],
-									  depth + 1))
-					return false;
+				case BTLessStrategyNumber:			opname = "<";  break;
+				case BTLessEqualStrategyNumber:		opname = "<="; break;
+				case BTEqualStrategyNumber:			opname = "=";  break;
+				case BTGreaterEqualStrategyNumber:	opname = ">="; break;
+				case BTGreaterStrategyNumber:		opname = ">";  break;
+				default:							opname = "?";  break;
 			}
-			break;
+			getTypeOutputInfo(hint->consttype, &typoutput, &typisvarlena);
+			if (buf.len > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfo(&buf, "(%s %s %s)",
+							 quote_identifier(NameStr(attr->attname)),
+							 opname,
+							 quote_literal_cstr(OidOutputFunctionCall(typoutput,
+																	  hint->value)));
+		}
+		ExplainPropertyText("Stats-Hint", buf.data, es);
+		if (es->analyze)
+			ExplainPropertyInteger("Stats-Skipped", NULL,
+								   af_state->stats_nskipped, es);
+	}
 
-		case ArrowNodeTag__List:
-			if (depth > 0)
-				elog(ERROR, "arrow_fdw: nested array types are not supported");
-			if (a->_num_children != 1 || b->_num_children != 1)
-				elog(ERROR, "Bug? List of arrow type is corrupted.");
-			if (!arrowTypeIsEqual(&a->children[0],
-								  &b->children[0],
-								  depth + 1))
-				return false;
-			break;
+	/* shows columns loaded prior to the late materialization, if any */
+	if (af_state->late_quals)
+	{
+		resetStringInfo(&buf);
+		for (k = bms_next_member(af_state->late_refs, -1);
+			 k >= 0;
+			 k = bms_next_member(af_state->late_refs, k))
+		{
+			Form_pg_attribute attr;
 
-		default:
-			elog(ERROR, "'%s' of arrow type is not supported",
-				 a->type.node.tagName);
+			j = k + FirstLowInvalidHeapAttributeNumber - 1;
+			attr = tupleDescAttr(tupdesc, j);
+			if (buf.len > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfoString(&buf, quote_identifier(NameStr(attr->attname)));
+		}
+		ExplainPropertyText("Late-Materialization", buf.data, es);
+		if (es->analyze)
+			ExplainPropertyInteger("Late-Skipped", NULL,
+								   af_state->late_nskipped, es);
 	}
-	return true;
-}
 
-static Oid
-arrowTypeToPGTypeOid(ArrowField *field, int *typmod)
-{
-	ArrowType  *t = &field->type;
+	/* shows number of files pruned by the partition keys */
+	if (af_state->part_nkeys > 0)
+		ExplainPropertyInteger("Partition-Pruned", NULL,
+							   af_state->part_nskipped, es);
 
-	*typmod = -1;
-	switch (t->node.tag)
+	/* shows files on behalf of the foreign table */
+	foreach (lc, af_state->fdescList)
 	{
-		case ArrowNodeTag__Int:
-			switch (t->Int.bitWidth)
+		File		fdesc = (File)lfirst_int(lc);
+		const char *fname = FilePathName(fdesc);
+		int			rbcount = 0;
+		char	   *pos = label;
+		struct stat	st_buf;
+
+		pos += snprintf(label, sizeof(label), "files%d", fcount++);
+		if (fstat(FileGetRawDesc(fdesc), &st_buf) != 0)
+			memset(&st_buf, 0, sizeof(struct stat));
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			resetStringInfo(&buf);
+			if (st_buf.st_size == 0)
+				appendStringInfoString(&buf, fname);
+			else
+				appendStringInfo(&buf, "%s (size: %s)",
+								 fname,
+								 format_bytesz(st_buf.st_size));
+			ExplainPropertyText(label, buf.data, es);
+		}
+		else
+		{
+			ExplainPropertyText(label, fname, es);
+
+			if (st_buf.st_size > 0)
 			{
-				case 16:
-					return INT2OID;
-				case 32:
-					return INT4OID;
-				case 64:
-					return INT8OID;
-				default:
-					elog(ERROR, "Arrow.%s is not supported",
-						 arrowTypeName(field));
-					break;
+				sprintf(pos, "-size");
+				ExplainPropertyText(label, format_bytesz(st_buf.st_size), es);
 			}
-			break;
-		case ArrowNodeTag__FloatingPoint:
-			switch (t->FloatingPoint.precision)
+		}
+		if (!es->verbose)
+			continue;
+
+		/* below only verbose mode */
+		memset(chunk_sz, 0, sizeof(size_t) * tupdesc->natts);
+		for (i=0; i < af_state->num_rbatches; i++)
+		{
+			RecordBatchState *rb_state = af_state->rbatches[i];
+
+			if (rb_state->fdesc != fdesc)
+				continue;
+
+			for (k = bms_next_member(af_state->referenced, -1);
+				 k >= 0;
+				 k = bms_next_member(af_state->referenced, k))
 			{
-				case ArrowPrecision__Half:
-					return FLOAT2OID;
-				case ArrowPrecision__Single:
-					return FLOAT4OID;
-				case ArrowPrecision__Double:
-					return FLOAT8OID;
-				default:
-					elog(ERROR, "Arrow.%s is not supported",
-						 arrowTypeName(field));
+				j = k + FirstLowInvalidHeapAttributeNumber - 1;
+				if (j < 0 || j >= rb_state->ncols)
+					continue;
+				chunk_sz[j] += RecordBatchFieldLength(&rb_state->columns[j]);
 			}
-			break;
-		case ArrowNodeTag__Utf8:
-			return TEXTOID;
-		case ArrowNodeTag__Binary:
-			return BYTEAOID;
-		case ArrowNodeTag__Bool:
-			return BOOLOID;
-		case ArrowNodeTag__Decimal:
-			return NUMERICOID;
-		case ArrowNodeTag__Date:
-			return DATEOID;
-		case ArrowNodeTag__Time:
-			return TIMEOID;
-		case ArrowNodeTag__Timestamp:
-			if (t->Timestamp.timezone)
-				return TIMESTAMPTZOID;
-			return TIMESTAMPOID;
-		case ArrowNodeTag__Interval:
-			return INTERVALOID;
-		case ArrowNodeTag__List:
-			if (field->_num_children != 1)
-				elog(ERROR, "arrow_fdw: corrupted List type definition");
-			else
-			{
-				ArrowField *child = &field->children[0];
-				Oid		type_oid;
-				Oid		elem_oid;
-				int		elem_mod;
+			rbcount++;
+		}
 
-				elem_oid = arrowTypeToPGTypeOid(child, &elem_mod);
-				type_oid = get_array_type(elem_oid);
-				if (!OidIsValid(type_oid))
-					elog(ERROR, "array of arrow::%s type is not defined",
-						 arrowTypeName(field));
-				return type_oid;
-			}
-			break;
+		if (rbcount >= 0)
+		{
+			for (k = bms_next_member(af_state->referenced, -1);
+                 k >= 0;
+                 k = bms_next_member(af_state->referenced, k))
+            {
+				Form_pg_attribute attr;
 
-		case ArrowNodeTag__Struct:
-			{
-				Relation	rel;
-				ScanKeyData	skey[2];
-				SysScanDesc	sscan;
-				HeapTuple	tup;
-				Oid			type_oid = InvalidOid;
+				j = k + FirstLowInvalidHeapAttributeNumber - 1;
+				if (j < 0 || j >= tupdesc->natts)
+					continue;
+				attr = tupleDescAttr(tupdesc, j);
+				snprintf(label, sizeof(label),
+						 "  %s", NameStr(attr->attname));
+				ExplainPropertyText(label, format_bytesz(chunk_sz[j]), es);
+			}
+		}
+	}
+}
 
-				/*
-				 * lookup composite type definition from pg_class
-				 * At least, nattrs == _num_children
-				 */
-				rel = table_open(RelationRelationId, AccessShareLock);
-				ScanKeyInit(&skey[0],
-							Anum_pg_class_relkind,
-							BTEqualStrategyNumber, F_CHAREQ,
-							CharGetDatum(RELKIND_COMPOSITE_TYPE));
-				ScanKeyInit(&skey[1],
-							Anum_pg_class_relnatts,
-							BTEqualStrategyNumber, F_INT2EQ,
-							Int16GetDatum(field->_num_children));
-
-				sscan = systable_beginscan(rel, InvalidOid, false,
-										   NULL, 2, skey);
-				while (!OidIsValid(type_oid) &&
-					   HeapTupleIsValid(tup = systable_getnext(sscan)))
-				{
-					Form_pg_class relForm = (Form_pg_class) GETSTRUCT(tup);
-					TupleDesc	tupdesc;
-					int			j;
-					bool		compatible = true;
-
-					if (pg_namespace_aclcheck(relForm->relnamespace,
-											  GetUserId(),
-											  ACL_USAGE) != ACLCHECK_OK)
-						continue;
-
-					if (pg_type_aclcheck(relForm->reltype,
-										 GetUserId(),
-										 ACL_USAGE) != ACLCHECK_OK)
-						continue;
-
-					tupdesc = lookup_rowtype_tupdesc(relForm->reltype, -1);
-					Assert(tupdesc->natts == field->_num_children);
-					for (j=0; compatible && j < tupdesc->natts; j++)
-					{
-						Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
-						ArrowField  *child = &field->children[j];
-						Oid			typoid;
-						int			typmod;
-
-						typoid = arrowTypeToPGTypeOid(child, &typmod);
-						if (typoid != attr->atttypid)
-							compatible = false;
-					}
-					ReleaseTupleDesc(tupdesc);
-
-					if (compatible)
-						type_oid = relForm->reltype;
-				}
-				systable_endscan(sscan);
-				table_close(rel, AccessShareLock);
+static void
+ArrowExplainForeignScan(ForeignScanState *node, ExplainState *es)
+{
+	Relation	frel = node->ss.ss_currentRelation;
 
-				if (!OidIsValid(type_oid))
-					elog(ERROR, "arrow::%s is not supported",
-						 arrowTypeName(field));
-				return type_oid;
-			}
-			break;
-		case ArrowNodeTag__FixedSizeBinary:
-			if (t->FixedSizeBinary.byteWidth < 1 ||
-				t->FixedSizeBinary.byteWidth > BLCKSZ)
-				elog(ERROR, "arrow_fdw: %s with byteWidth=%d is not supported",
-					 t->node.tagName,
-					 t->FixedSizeBinary.byteWidth);
-			*typmod = t->FixedSizeBinary.byteWidth;
-			return BPCHAROID;
-		default:
-			elog(ERROR, "arrow_fdw: type '%s' is not supported",
-				 field->type.node.tagName);
-	}
-	return InvalidOid;
+	ExplainArrowFdw((ArrowFdwState *)node->fdw_state, frel, es);
 }
 
-static const char *
-arrowTypeToPGTypeName(ArrowField *field)
+/*
+ * readArrowFile
+ */
+static bool
+readArrowFile(const char *pathname, ArrowFileInfo *af_info, bool missing_ok)
 {
-	Oid			typoid;
-	int			typmod;
-	HeapTuple	tup;
-	Form_pg_type type;
-	char	   *schema;
-	char	   *result;
-
-	typoid = arrowTypeToPGTypeOid(field, &typmod);
-	if (!OidIsValid(typoid))
-		return NULL;
-	tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typoid));
-	if (!HeapTupleIsValid(tup))
-		elog(ERROR, "cache lookup failed for type %u", typoid);
-	type = (Form_pg_type) GETSTRUCT(tup);
-	schema = get_namespace_name(type->typnamespace);
-	if (typmod < 0)
-		result = psprintf("%s.%s",
-						  quote_identifier(schema),
-						  quote_identifier(NameStr(type->typname)));
-	else
-		result = psprintf("%s.%s(%d)",
-						  quote_identifier(schema),
-						  quote_identifier(NameStr(type->typname)),
-						  typmod);
-	ReleaseSysCache(tup);
+    File	filp = PathNameOpenFile(pathname, O_RDONLY | PG_BINARY);
 
-	return result;
+	if (filp < 0)
+	{
+		if (missing_ok && errno == ENOENT)
+			return false;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", pathname)));
+	}
+	readArrowFileDesc(FileGetRawDesc(filp), af_info);
+	FileClose(filp);
+	return true;
 }
 
 /*
- * arrowTypeIsConvertible
+ * readParquetFile - returns false if not a Parquet file
  */
 static bool
-arrowTypeIsConvertible(Oid type_oid, int typemod)
+readParquetFile(const char *pathname, ParquetFileInfo *pq_info, bool missing_ok)
 {
-	HeapTuple		tup;
-	Form_pg_type	typeForm;
-	bool			retval = false;
+	File	filp = PathNameOpenFile(pathname, O_RDONLY | PG_BINARY);
+	bool	retval = false;
 
-	switch (type_oid)
+	if (filp < 0)
 	{
-		case INT2OID:		/* Int16 */
-		case INT4OID:		/* Int32 */
-		case INT8OID:		/* Int64 */
-		case FLOAT2OID:		/* FP16 */
-		case FLOAT4OID:		/* FP32 */
-		case FLOAT8OID:		/* FP64 */
-		case TEXTOID:		/* Utf8 */
-		case BYTEAOID:		/* Binary */
-		case BOOLOID:		/* Bool */
-		case NUMERICOID:	/* Decimal */
-		case DATEOID:		/* Date */
-		case TIMEOID:		/* Time */
-		case TIMESTAMPOID:	/* Timestamp */
-		case TIMESTAMPTZOID:/* TimestampTz */
-		case INTERVALOID:	/* Interval */
-		case BPCHAROID:		/* FixedSizeBinary */
-			return true;
-		default:
-			tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(type_oid));
-			if (!HeapTupleIsValid(tup))
-				elog(ERROR, "cache lookup failed for type %u", type_oid);
-			typeForm = (Form_pg_type) GETSTRUCT(tup);
-
-			if (typeForm->typlen == -1 && OidIsValid(typeForm->typelem))
-			{
-				retval = arrowTypeIsConvertible(typeForm->typelem, typemod);
-			}
-			else if (typeForm->typtype == TYPTYPE_COMPOSITE)
-			{
-				Relation	rel;
-				TupleDesc	tupdesc;
-				int			j;
-
-				rel = relation_open(typeForm->typrelid, AccessShareLock);
-				tupdesc = RelationGetDescr(rel);
-				for (j=0; j < tupdesc->natts; j++)
-				{
-					Form_pg_attribute	attr = tupleDescAttr(tupdesc, j);
-
-					if (!arrowTypeIsConvertible(attr->atttypid,
-												attr->atttypmod))
-						break;
-				}
-				if (j >= tupdesc->natts)
-					retval = true;
-				relation_close(rel, AccessShareLock);
-			}
-			ReleaseSysCache(tup);
+		if (missing_ok && errno == ENOENT)
+			return false;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", pathname)));
+	}
+	if (isParquetFileDesc(FileGetRawDesc(filp)))
+	{
+		readParquetFileDesc(FileGetRawDesc(filp), pstrdup(pathname), pq_info);
+		retval = true;
 	}
+	FileClose(filp);
 	return retval;
 }
 
 /*
- * arrowFieldLength
+ * RecordBatchAcquireSampleRows - random sampling
  */
-static size_t
-arrowFieldLength(ArrowField *field, int64 nitems)
+static int
+RecordBatchAcquireSampleRows(Relation relation,
+							 RecordBatchState *rb_state,
+							 arrowPartitionValues *pv,
+							 HeapTuple *rows,
+							 int nsamples)
 {
-	ArrowType  *type = &field->type;
-	size_t		length = 0;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	pgstrom_data_store *pds;
+	Bitmapset	   *referenced = NULL;
+	Datum		   *values;
+	bool		   *isnull;
+	int				count;
+	int				i, j, nwords;
 
-	switch (type->node.tag)
+	/* ANALYZE needs to fetch all the attributes */
+	nwords = (tupdesc->natts - FirstLowInvalidHeapAttributeNumber +
+			  BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
+	referenced = alloca(offsetof(Bitmapset, words[nwords]));
+	referenced->nwords = nwords;
+	memset(referenced->words, -1, sizeof(bitmapword) * nwords);
+	
+	pds = __arrowFdwLoadRecordBatch(rb_state,
+									0, -1,
+									relation,
+									referenced,
+									NULL,
+									CurrentMemoryContext,
+									-1);
+	values = alloca(sizeof(Datum) * tupdesc->natts);
+	isnull = alloca(sizeof(bool)  * tupdesc->natts);
+	for (count = 0; count < nsamples; count++)
 	{
-		case ArrowNodeTag__Int:
-			switch (type->Int.bitWidth)
-			{
-				case sizeof(cl_short) * BITS_PER_BYTE:
-					length = sizeof(cl_short) * nitems;
-					break;
-				case sizeof(cl_int) * BITS_PER_BYTE:
-					length = sizeof(cl_int) * nitems;
-					break;
-				case sizeof(cl_long) * BITS_PER_BYTE:
-					length = sizeof(cl_long) * nitems;
-					break;
-				default:
-					elog(ERROR, "Not a supported Int width: %d",
-						 type->Int.bitWidth);
-			}
-			break;
-		case ArrowNodeTag__FloatingPoint:
-			switch (type->FloatingPoint.precision)
-			{
-				case ArrowPrecision__Half:
-					length = sizeof(cl_short) * nitems;
-					break;
-				case ArrowPrecision__Single:
-					length = sizeof(cl_float) * nitems;
-					break;
-				case ArrowPrecision__Double:
-					length = sizeof(cl_double) * nitems;
-					break;
-				default:
-					elog(ERROR, "Not a supported FloatingPoint precision");
-			}
-			break;
-		case ArrowNodeTag__Utf8:
-		case ArrowNodeTag__Binary:
-		case ArrowNodeTag__List:
-			length = sizeof(cl_uint) * (nitems + 1);
-			break;
-		case ArrowNodeTag__Bool:
-			length = BITMAPLEN(nitems);
-			break;
-		case ArrowNodeTag__Decimal:
-			length = sizeof(int128) * nitems;
-			break;
-		case ArrowNodeTag__Date:
-			switch (type->Date.unit)
-			{
-				case ArrowDateUnit__Day:
-					length = sizeof(cl_int) * nitems;
-					break;
-				case ArrowDateUnit__MilliSecond:
-					length = sizeof(cl_long) * nitems;
-					break;
-				default:
-					elog(ERROR, "Not a supported Date unit");
-			}
-			break;
-		case ArrowNodeTag__Time:
-			switch (type->Time.unit)
-			{
-				case ArrowTimeUnit__Second:
-				case ArrowTimeUnit__MilliSecond:
-					length = sizeof(cl_int) * nitems;
-					break;
-				case ArrowTimeUnit__MicroSecond:
-				case ArrowTimeUnit__NanoSecond:
-					length = sizeof(cl_long) * nitems;
-					break;
-				default:
-					elog(ERROR, "Not a supported Time unit");
-			}
-			break;
-		case ArrowNodeTag__Timestamp:
-			length = sizeof(cl_long) * nitems;
-			break;
-		case ArrowNodeTag__Interval:
-			switch (type->Interval.unit)
-			{
-				case ArrowIntervalUnit__Year_Month:
-					length = sizeof(cl_uint) * nitems;
-					break;
-				case ArrowIntervalUnit__Day_Time:
-					length = sizeof(cl_long) * nitems;
-					break;
-				default:
-					elog(ERROR, "Not a supported Interval unit");
-			}
-			break;
-		case ArrowNodeTag__Struct:	//to be supported later
-			length = 0;		/* only nullmap */
-			break;
-		case ArrowNodeTag__FixedSizeBinary:
-			length = (size_t)type->FixedSizeBinary.byteWidth * nitems;
-			break;
-		default:
-			elog(ERROR, "Arrow Type '%s' is not supported now",
-				 type->node.tagName);
-			break;
+		/* fetch a row randomly */
+		i = (double)pds->kds.nitems * (((double) random()) /
+									   ((double)MAX_RANDOM_VALUE + 1));
+		Assert(i < pds->kds.nitems);
+
+		for (j=0; j < pds->kds.ncols; j++)
+		{
+			kern_colmeta   *cmeta = &pds->kds.colmeta[j];
+			
+			pg_datum_arrow_ref(&pds->kds,
+							   cmeta,
+							   i,
+							   values + j,
+							   isnull + j);
+		}
+		/* virtual partition-key columns */
+		for (j = rb_state->ncols; pv && j < tupdesc->natts; j++)
+		{
+			values[j] = pv->values[j - rb_state->ncols];
+			isnull[j] = pv->isnull[j - rb_state->ncols];
+		}
+		rows[count] = heap_form_tuple(tupdesc, values, isnull);
 	}
-	return length;
+	PDS_release(pds);
+
+	return count;
 }
 
 /*
- * arrowSchemaCompatibilityCheck
+ * ArrowAcquireSampleRows
  */
-static bool
-__arrowSchemaCompatibilityCheck(TupleDesc tupdesc,
-								RecordBatchFieldState *rb_fstate)
+static int
+ArrowAcquireSampleRows(Relation relation,
+					   int elevel,
+					   HeapTuple *rows,
+					   int nrooms,
+					   double *p_totalrows,
+					   double *p_totaldeadrows)
 {
-	int		j;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
+	List		   *filesList = NIL;
+	List		   *fdescList = NIL;
+	List		   *rb_state_list = NIL;
+	List		   *partKeys;
+	List		   *partValuesList = NIL;
+	List		   *rb_partvals_list = NIL;
+	ListCell	   *lc, *cell;
+	bool			writable;
+	int64			total_nrows = 0;
+	int64			count_nrows = 0;
+	int				nsamples_min = nrooms / 100;
+	int				nitems = 0;
+	int				fcount = 0;
 
-	for (j=0; j < tupdesc->natts; j++)
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	partKeys = arrowFdwExtractPartitionKeys(ft->options);
+	if (partKeys != NIL)
+		filesList = arrowFdwPrunePartitionFiles(tupdesc, filesList,
+												partKeys, NIL,
+												&partValuesList);
+	foreach (lc, filesList)
 	{
-		RecordBatchFieldState *fstate = &rb_fstate[j];
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		char	   *fname = strVal(lfirst(lc));
+		File		fdesc;
+		List	   *rb_cached;
+		ListCell   *cell;
 
-		if (!fstate->children)
+		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
+        if (fdesc < 0)
 		{
-			/* shortcur, it should be a scalar built-in type */
-			Assert(fstate->num_children == 0);
-			if (attr->atttypid != fstate->atttypid)
-				return false;
+			if (writable && errno == ENOENT)
+				continue;
+			elog(ERROR, "failed to open file '%s' on behalf of '%s'",
+				 fname, RelationGetRelationName(relation));
 		}
-		else
+		fdescList = lappend_int(fdescList, fdesc);
+		
+		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
+		foreach (cell, rb_cached)
 		{
-			Form_pg_type	typ;
-			HeapTuple		tup;
-			bool			type_is_ok = true;
-
-			tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(attr->atttypid));
-			if (!HeapTupleIsValid(tup))
-				elog(ERROR, "cache lookup failed for type %u", attr->atttypid);
-			typ = (Form_pg_type) GETSTRUCT(tup);
-			if (typ->typlen == -1 && OidIsValid(typ->typelem) &&
-				fstate->num_children == 1)
-			{
-				/* Arrow::List */
-				RecordBatchFieldState *cstate = &fstate->children[0];
+			RecordBatchState *rb_state = lfirst(cell);
 
-				if (attr->atttypid != cstate->atttypid)
-					type_is_ok = false;
-				else
-				{
-					/*
-					 * overwrite typoid / typmod because a same arrow file
-					 * can be reused, and it may be on behalf of different
-					 * user defined data type.
-					 */
-					fstate->atttypid = attr->atttypid;
-					fstate->atttypmod = attr->atttypmod;
-				}
-			}
-			else if (typ->typlen == -1 && OidIsValid(typ->typrelid))
-			{
-				/* Arrow::Struct */
-				TupleDesc	sdesc = lookup_rowtype_tupdesc(attr->atttypid,
-														   attr->atttypmod);
-				if (sdesc->natts == fstate->num_children &&
-					__arrowSchemaCompatibilityCheck(sdesc, fstate->children))
-				{
-					/* see comment above */
-					fstate->atttypid = attr->atttypid;
-					fstate->atttypmod = attr->atttypmod;
-				}
-				else
-				{
-					type_is_ok = false;
-				}
-				DecrTupleDescRefCount(sdesc);
+			if (!arrowSchemaCompatibilityCheck(tupdesc, list_length(partKeys),
+											   rb_state))
+				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
+					 fname, RelationGetRelationName(relation));
+			if (rb_state->rb_nitems == 0)
+				continue;	/* not reasonable to sample, skipped */
+			total_nrows += rb_state->rb_nitems;
 
-			}
-			else
-			{
-				/* unknown */
-				type_is_ok = false;
-			}
-			ReleaseSysCache(tup);
-			if (!type_is_ok)
-				return false;
+			rb_state_list = lappend(rb_state_list, rb_state);
+			rb_partvals_list = lappend(rb_partvals_list,
+									   partValuesList != NIL
+									   ? list_nth(partValuesList, fcount)
+									   : NULL);
 		}
+		fcount++;
 	}
-	return true;
+	nrooms = Min(nrooms, total_nrows);
+
+	/* fetch samples for each record-batch */
+	forboth (lc, rb_state_list, cell, rb_partvals_list)
+	{
+		RecordBatchState *rb_state = lfirst(lc);
+		int			nsamples;
+
+		count_nrows += rb_state->rb_nitems;
+		nsamples = (double)nrooms * ((double)count_nrows /
+									 (double)total_nrows) - nitems;
+		if (nitems + nsamples > nrooms)
+			nsamples = nrooms - nitems;
+		if (nsamples > nsamples_min)
+			nitems += RecordBatchAcquireSampleRows(relation,
+												   rb_state,
+												   lfirst(cell),
+												   rows + nitems,
+												   nsamples);
+	}
+	foreach (lc, fdescList)
+		FileClose((File)lfirst_int(lc));
+
+	*p_totalrows = total_nrows;
+	*p_totaldeadrows = 0.0;
+
+	return nitems;
 }
 
+/*
+ * ArrowAnalyzeForeignTable
+ */
 static bool
-arrowSchemaCompatibilityCheck(TupleDesc tupdesc, RecordBatchState *rb_state)
+ArrowAnalyzeForeignTable(Relation frel,
+						 AcquireSampleRowsFunc *p_sample_rows_func,
+						 BlockNumber *p_totalpages)
 {
-	if (tupdesc->natts != rb_state->ncols)
-		return false;
-	return __arrowSchemaCompatibilityCheck(tupdesc, rb_state->columns);
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
+	List		   *filesList = arrowFdwExtractFilesList(ft->options);
+	ListCell	   *lc;
+	Size			totalpages = 0;
+
+	foreach (lc, filesList)
+	{
+		const char *fname = strVal(lfirst(lc));
+		struct stat	statbuf;
+
+		if (stat(fname, &statbuf) != 0)
+		{
+			elog(NOTICE, "failed on stat('%s') on behalf of '%s', skipped",
+				 fname, get_rel_name(ft->relid));
+			continue;
+		}
+		totalpages += (statbuf.st_size + BLCKSZ - 1) / BLCKSZ;
+	}
+
+	if (totalpages > MaxBlockNumber)
+		totalpages = MaxBlockNumber;
+
+	*p_sample_rows_func = ArrowAcquireSampleRows;
+	*p_totalpages = totalpages;
+
+	return true;
 }
 
 /*
- * pg_XXX_arrow_ref
+ * arrowFdwGpuAnalyze
+ *
+ * It feeds all the values of the supported columns to gpu_analyze.c, for
+ * each record-batch. Only the column in processing is loaded at once.
  */
-static Datum
-pg_varlena_arrow_ref(kern_data_store *kds,
-					 kern_colmeta *cmeta, size_t index)
+double
+arrowFdwGpuAnalyze(Relation frel)
 {
-	cl_uint	   *offset = (cl_uint *)
-		((char *)kds + __kds_unpack(cmeta->values_offset));
-	char	   *extra = (char *)kds + __kds_unpack(cmeta->extra_offset);
-	size_t		extra_len = __kds_unpack(cmeta->extra_length);
-	cl_uint		len = offset[index+1] - offset[index];
-	struct varlena *res;
+	TupleDesc		tupdesc = RelationGetDescr(frel);
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
+	List		   *filesList;
+	List		   *fdescList = NIL;
+	List		   *rb_state_list = NIL;
+	List		   *rb_partvals_list = NIL;
+	List		   *partKeys;
+	List		   *partValuesList = NIL;
+	ListCell	   *lc, *cell;
+	bool			writable;
+	int64			total_nrows = 0;
+	int				fcount = 0;
+	int				j;
 
-	if (offset[index] > offset[index + 1] || offset[index+1] > extra_len)
-		elog(ERROR, "corrupted arrow file? offset points out of extra buffer");
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	partKeys = arrowFdwExtractPartitionKeys(ft->options);
+	if (partKeys != NIL)
+		filesList = arrowFdwPrunePartitionFiles(tupdesc, filesList,
+												partKeys, NIL,
+												&partValuesList);
+	foreach (lc, filesList)
+	{
+		char	   *fname = strVal(lfirst(lc));
+		File		fdesc;
+		List	   *rb_cached;
 
-	res = palloc(VARHDRSZ + len);
-	SET_VARSIZE(res, VARHDRSZ + len);
-	memcpy(VARDATA(res), extra + offset[index], len);
+		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
+		if (fdesc < 0)
+		{
+			if (writable && errno == ENOENT)
+				continue;
+			elog(ERROR, "failed to open file '%s' on behalf of '%s'",
+				 fname, RelationGetRelationName(frel));
+		}
+		fdescList = lappend_int(fdescList, fdesc);
 
-	return PointerGetDatum(res);
-}
+		rb_cached = arrowLookupOrBuildMetadataCache(fdesc);
+		foreach (cell, rb_cached)
+		{
+			RecordBatchState *rb_state = lfirst(cell);
 
-static Datum
-pg_bpchar_arrow_ref(kern_data_store *kds,
-					kern_colmeta *cmeta, size_t index)
-{
-	cl_char	   *values = ((char *)kds + __kds_unpack(cmeta->values_offset));
-	cl_int		unitsz = cmeta->atttypmod - VARHDRSZ;
-	struct varlena *res;
+			if (!arrowSchemaCompatibilityCheck(tupdesc, list_length(partKeys),
+											   rb_state))
+				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
+					 fname, RelationGetRelationName(frel));
+			if (rb_state->rb_nitems == 0)
+				continue;
+			total_nrows += rb_state->rb_nitems;
 
-	if (unitsz <= 0)
-		elog(ERROR, "CHAR(%d) is not expected", unitsz);
-	res = palloc(VARHDRSZ + unitsz);
-	memcpy((char *)res + VARHDRSZ, values + unitsz * index, unitsz);
-	SET_VARSIZE(res, VARHDRSZ + unitsz);
+			rb_state_list = lappend(rb_state_list, rb_state);
+			rb_partvals_list = lappend(rb_partvals_list,
+									   partValuesList != NIL
+									   ? list_nth(partValuesList, fcount)
+									   : NULL);
+		}
+		fcount++;
+	}
 
-	return PointerGetDatum(res);
-}
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		gpuAnalyzeState *gas;
 
-static Datum
-pg_bool_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
-{
-	char   *bitmap = (char *)kds + __kds_unpack(cmeta->values_offset);
+		if (!gpuAnalyzeSupportedColumn(tupleDescAttr(tupdesc, j)))
+			continue;
+		gas = gpuAnalyzeBeginColumn(frel, j+1, (double)total_nrows, -1);
+		forboth (lc, rb_state_list, cell, rb_partvals_list)
+		{
+			RecordBatchState *rb_state = lfirst(lc);
+			arrowPartitionValues *pv = lfirst(cell);
+			pgstrom_data_store *pds;
+			Bitmapset  *referenced;
+			Datum		datum;
+			bool		isnull;
+			size_t		i;
+
+			if (j >= rb_state->ncols)
+			{
+				/* virtual partition-key column */
+				datum = pv->values[j - rb_state->ncols];
+				isnull = pv->isnull[j - rb_state->ncols];
+				for (i=0; i < rb_state->rb_nitems; i++)
+					gpuAnalyzePutDatum(gas, datum, isnull);
+				continue;
+			}
+			referenced = bms_make_singleton(j + 1 - FirstLowInvalidHeapAttributeNumber);
+			pds = __arrowFdwLoadRecordBatch(rb_state,
+											0, -1,
+											frel,
+											referenced,
+											NULL,
+											CurrentMemoryContext,
+											-1);
+			for (i=0; i < pds->kds.nitems; i++)
+			{
+				pg_datum_arrow_ref(&pds->kds,
+								   &pds->kds.colmeta[j],
+								   i,
+								   &datum,
+								   &isnull);
+				gpuAnalyzePutDatum(gas, datum, isnull);
+			}
+			PDS_release(pds);
+			bms_free(referenced);
+		}
+		gpuAnalyzeEndColumn(gas);
+	}
+	foreach (lc, fdescList)
+		FileClose((File)lfirst_int(lc));
 
-	return BoolGetDatum(att_isnull(index, bitmap));
+	return (double)total_nrows;
 }
 
-static Datum
-pg_int2_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
+/*
+ * ArrowImportForeignSchema
+ */
+static void
+__appendImportForeignSchemaOptions(StringInfo cmd,
+								   ImportForeignSchemaStmt *stmt)
 {
-	cl_short   *values = (cl_short *)
-		((char *)kds + __kds_unpack(cmeta->values_offset));
-	return values[index];
-}
+	ListCell   *lc;
 
-static Datum
-pg_int4_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
-{
-	cl_int	   *values = (cl_int *)
-		((char *)kds + __kds_unpack(cmeta->values_offset));
-	return values[index];
-}
+	appendStringInfo(cmd,
+					 "\n"
+					 ") SERVER %s\n"
+					 "  OPTIONS (", stmt->server_name);
+	foreach (lc, stmt->options)
+	{
+		DefElem	   *defel = lfirst(lc);
 
-static Datum
-pg_int8_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
-{
-	cl_long	   *values = (cl_long *)
-		((char *)kds + __kds_unpack(cmeta->values_offset));
-	return values[index];
+		if (lc != list_head(stmt->options))
+			appendStringInfo(cmd, ",\n           ");
+		appendStringInfo(cmd, "%s '%s'",
+						 defel->defname,
+						 strVal(defel->arg));
+	}
+	appendStringInfo(cmd, ")");
 }
 
-static Datum
-pg_numeric_arrow_ref(kern_data_store *kds,
-					 kern_colmeta *cmeta, size_t index)
+static List *
+__parquetImportForeignSchema(ImportForeignSchemaStmt *stmt,
+							 List *filesList, ParquetFileInfo *pq_info)
 {
-	char	   *result = palloc0(sizeof(struct NumericData));
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
-	int			dscale = cmeta->attopts.decimal.scale;
-	Int128_t	decimal;
-
-	decimal.ival = ((int128 *)base)[index];
+	ParquetSchemaElement *schema = pq_info->schema;
+	int			nfields = pq_info->num_schema;
+	ListCell   *lc;
+	int			j;
+	StringInfoData	cmd;
 
-	while (dscale > 0 && decimal.ival % 10 == 0)
+	if (schema[0].num_children != nfields - 1)
+		elog(ERROR, "parquet: file '%s' has nested schema, not supported",
+			 pq_info->filename);
+	/* compatibility checks */
+	foreach (lc, filesList)
 	{
-		decimal.ival /= 10;
-		dscale--;
-	}
-	pg_numeric_to_varlena(result, dscale, decimal);
+		const char	   *fname = strVal(lfirst(lc));
+		ParquetFileInfo	pq_temp;
 
-	return PointerGetDatum(result);
-}
+		if (lc == list_head(filesList))
+			continue;
+		if (!readParquetFile(fname, &pq_temp, false) ||
+			pq_temp.num_schema != nfields)
+			elog(ERROR, "file '%s' has incompatible schema definition",
+				 fname);
+		for (j=1; j < nfields; j++)
+		{
+			ArrowTypeOptions attopts1;
+			ArrowTypeOptions attopts2;
 
-static Datum
-pg_date_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
-{
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
-	DateADT		dt;
+			if (parquetTypeToPGTypeOid(&schema[j], &attopts1) !=
+				parquetTypeToPGTypeOid(&pq_temp.schema[j], &attopts2) ||
+				memcmp(&attopts1, &attopts2, sizeof(ArrowTypeOptions)) != 0)
+				elog(ERROR, "file '%s' has incompatible schema definition",
+					 fname);
+		}
+	}
 
-	switch (cmeta->attopts.date.unit)
+	/* makes a command to define foreign table */
+	initStringInfo(&cmd);
+	appendStringInfo(&cmd, "CREATE FOREIGN TABLE %s (\n",
+					 quote_identifier(stmt->remote_schema));
+	for (j=1; j < nfields; j++)
 	{
-		case ArrowDateUnit__Day:
-			dt = ((cl_uint *)base)[index];
-			break;
-		case ArrowDateUnit__MilliSecond:
-			dt = ((cl_ulong *)base)[index] / 1000;
-			break;
-		default:
-			elog(ERROR, "Bug? unexpected unit of Date type");
+		ParquetSchemaElement *elem = &schema[j];
+		ArrowTypeOptions attopts;
+		Oid			type_oid;
+
+		type_oid = parquetTypeToPGTypeOid(elem, &attopts);
+		if (!OidIsValid(type_oid))
+			elog(ERROR, "parquet: column '%s' of '%s' has unsupported data type",
+				 elem->name, pq_info->filename);
+		if (j > 1)
+			appendStringInfo(&cmd, ",\n");
+		if (!elem->name || elem->name[0] == '\0')
+		{
+			elog(NOTICE, "field %d has no name, so \"__col%02d\" is used",
+				 j, j);
+			appendStringInfo(&cmd, "  __col%02d  %s", j,
+							 format_type_be_qualified(type_oid));
+		}
+		else
+			appendStringInfo(&cmd, "  %s %s",
+							 quote_identifier(elem->name),
+							 format_type_be_qualified(type_oid));
 	}
-	/* convert UNIX epoch to PostgreSQL epoch */
-	dt -= (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE);
-	return DateADTGetDatum(dt);
+	__appendImportForeignSchemaOptions(&cmd, stmt);
+
+	return list_make1(cmd.data);
 }
 
-static Datum
-pg_time_arrow_ref(kern_data_store *kds,
-				  kern_colmeta *cmeta, size_t index)
+static List *
+ArrowImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 {
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
-	TimeADT		tm;
+	ArrowSchema	schema;
+	ParquetFileInfo pq_info;
+	List	   *filesList;
+	ListCell   *lc;
+	int			j;
+	StringInfoData	cmd;
 
-	switch (cmeta->attopts.time.unit)
+	/* sanity checks */
+	switch (stmt->list_type)
 	{
-		case ArrowTimeUnit__Second:
-			tm = ((cl_long)((cl_int *)base)[index]) * 1000000L;
-			break;
-		case ArrowTimeUnit__MilliSecond:
-			tm = ((cl_long)((cl_int *)base)[index]) * 1000L;
-			break;
-		case ArrowTimeUnit__MicroSecond:
-			tm = ((cl_long *)base)[index];
-			break;
-		case ArrowTimeUnit__NanoSecond:
-			tm = ((cl_ulong *)base)[index] / 1000L;
+		case FDW_IMPORT_SCHEMA_ALL:
 			break;
+		case FDW_IMPORT_SCHEMA_LIMIT_TO:
+			elog(ERROR, "arrow_fdw does not support LIMIT TO clause");
+		case FDW_IMPORT_SCHEMA_EXCEPT:
+			elog(ERROR, "arrow_fdw does not support EXCEPT clause");
 		default:
-			elog(ERROR, "Bug? unexpected unit of Time type");
+			elog(ERROR, "arrow_fdw: Bug? unknown list-type");
 	}
-	return TimeADTGetDatum(tm);
-}
+	filesList = arrowFdwExtractFilesList(stmt->options);
+	if (filesList == NIL)
+		ereport(ERROR,
+				(errmsg("No valid apache arrow files are specified"),
+				 errhint("Use 'file' or 'dir' option to specify apache arrow files on behalf of the foreign table")));
 
-static Datum
-pg_timestamp_arrow_ref(kern_data_store *kds,
-					   kern_colmeta *cmeta, size_t index)
-{
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
-	Timestamp	ts;
+	/* Parquet files? */
+	if (readParquetFile(strVal(linitial(filesList)), &pq_info, false))
+		return __parquetImportForeignSchema(stmt, filesList, &pq_info);
 
-	switch (cmeta->attopts.timestamp.unit)
+	/* read the schema */
+	memset(&schema, 0, sizeof(ArrowSchema));
+	foreach (lc, filesList)
 	{
-		case ArrowTimeUnit__Second:
-			ts = ((cl_ulong *)base)[index] * 1000000UL;
-			break;
-		case ArrowTimeUnit__MilliSecond:
-			ts = ((cl_ulong *)base)[index] * 1000UL;
-			break;
-		case ArrowTimeUnit__MicroSecond:
-			ts = ((cl_ulong *)base)[index];
-			break;
-		case ArrowTimeUnit__NanoSecond:
-			ts = ((cl_ulong *)base)[index] / 1000UL;
-			break;
-		default:
-			elog(ERROR, "Bug? unexpected unit of Timestamp type");
-	}
-	/* convert UNIX epoch to PostgreSQL epoch */
-	ts -= (POSTGRES_EPOCH_JDATE -
-		   UNIX_EPOCH_JDATE) * USECS_PER_DAY;
-	return TimestampGetDatum(ts);
-}
+		const char   *fname = strVal(lfirst(lc));
+		ArrowFileInfo af_info;
 
-static Datum
-pg_interval_arrow_ref(kern_data_store *kds,
-					  kern_colmeta *cmeta, size_t index)
-{
-	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
-	Interval   *iv = palloc0(sizeof(Interval));
-
-	switch (cmeta->attopts.interval.unit)
-	{
-		case ArrowIntervalUnit__Year_Month:
-			/* 32bit: number of months */
-			iv->month = ((cl_uint *)base)[index];
-			break;
-		case ArrowIntervalUnit__Day_Time:
-			/* 32bit+32bit: number of days and milliseconds */
-			iv->day = (int32)(((cl_uint *)base)[2 * index]);
-			iv->time = (TimeOffset)(((cl_uint *)base)[2 * index + 1]) * 1000;
-			break;
-		default:
-			elog(ERROR, "Bug? unexpected unit of Interval type");
-	}
-	return PointerGetDatum(iv);
-}
-
-static Datum
-pg_array_arrow_ref(kern_data_store *kds,
-				   kern_colmeta *smeta,
-				   cl_uint start, cl_uint end)
-{
-	ArrayType  *res;
-	size_t		sz;
-	cl_uint		i, nitems = end - start;
-	cl_uint	   *offset;
-	bits8	   *nullmap = NULL;
-	char	   *base;
-	size_t		usage;
-
-	/* allocation of the result buffer */
-	if (smeta->nullmap_offset != 0)
-		sz = ARR_OVERHEAD_WITHNULLS(1, nitems);
-	else
-		sz = ARR_OVERHEAD_NONULLS(1);
-
-	if (smeta->attlen > 0)
-	{
-		sz += TYPEALIGN(smeta->attalign,
-						smeta->attlen) * nitems;
-	}
-	else if (smeta->attlen == -1)
-	{
-		if (smeta->values_offset == 0)
-			elog(ERROR, "Bug? corrupted kernel column metadata");
-		offset = (cl_uint *)((char *)kds + __kds_unpack(smeta->values_offset));
-		sz += (MAXALIGN(VARHDRSZ * nitems) +		/* space for varlena */
-			   MAXALIGN(sizeof(cl_uint) * nitems) +	/* space for alignment */
-			   offset[end] - offset[start]);
-	}
-	else
-		elog(ERROR, "Bug? corrupted kernel column metadata");
-
-	res = palloc0(sz);
-	res->ndim = 1;
-	if (smeta->nullmap_offset != 0)
-	{
-		res->dataoffset = ARR_OVERHEAD_WITHNULLS(1, nitems);
-		nullmap = ARR_NULLBITMAP(res);
-	}
-	res->elemtype = smeta->atttypid;
-	ARR_DIMS(res)[0] = nitems;
-	ARR_LBOUND(res)[0] = 1;
-
-	base = ARR_DATA_PTR(res);
-	usage = 0;
-	for (i=0; i < nitems; i++)
-	{
-		Datum	datum;
-		bool	isnull;
-
-		pg_datum_arrow_ref(kds, smeta, start+i, &datum, &isnull);
-		if (isnull)
+		readArrowFile(fname, &af_info, false);
+		if (lc == list_head(filesList))
 		{
-			if (!nullmap)
-				elog(ERROR, "Bug? element item should not be NULL");
+			copyArrowNode(&schema.node, &af_info.footer.schema.node);
 		}
-		else if (smeta->attlen > 0)
+		else
 		{
-			if (nullmap)
-				nullmap[i>>3] |= (1<<(i&7));
-			usage = TYPEALIGN(smeta->attalign, usage);
-			memcpy(base + usage, &datum, smeta->attlen);
-			usage += smeta->attlen;
+			/* compatibility checks */
+			ArrowSchema	   *stemp = &af_info.footer.schema;
+
+			if (schema.endianness != stemp->endianness ||
+				schema._num_fields != stemp->_num_fields)
+				elog(ERROR, "file '%s' has incompatible schema definition",
+					 fname);
+			for (j=0; j < schema._num_fields; j++)
+			{
+				if (arrowTypeIsEqual(&schema.fields[j],
+									 &stemp->fields[j], 0))
+					elog(ERROR, "file '%s' has incompatible schema definition",
+						 fname);
+			}
 		}
-		else if (smeta->attlen == -1)
-		{
-			cl_int		vl_len = VARSIZE(datum);
+	}
 
-			if (nullmap)
-				nullmap[i>>3] |= (1<<(i&7));
-			usage = TYPEALIGN(smeta->attalign, usage);
-			memcpy(base + usage, DatumGetPointer(datum), vl_len);
-			usage += vl_len;
+	/* makes a command to define foreign table */
+	initStringInfo(&cmd);
+	appendStringInfo(&cmd, "CREATE FOREIGN TABLE %s (\n",
+					 quote_identifier(stmt->remote_schema));
+	for (j=0; j < schema._num_fields; j++)
+	{
+		ArrowField *field = &schema.fields[j];
+		const char *type_name = arrowTypeToPGTypeName(field);
 
-			pfree(DatumGetPointer(datum));
+		if (j > 0)
+			appendStringInfo(&cmd, ",\n");
+		if (!field->name || field->_name_len == 0)
+		{
+			elog(NOTICE, "field %d has no name, so \"__col%02d\" is used",
+				 j+1, j+1);
+			appendStringInfo(&cmd, "  __col%02d  %s", j+1, type_name);
 		}
 		else
-			elog(ERROR, "Bug? corrupted kernel column metadata");
+			appendStringInfo(&cmd, "  %s %s",
+							 quote_identifier(field->name), type_name);
 	}
-	SET_VARSIZE(res, (base + usage) - (char *)res);
+	__appendImportForeignSchemaOptions(&cmd, stmt);
 
-	return PointerGetDatum(res);
+	return list_make1(cmd.data);
 }
 
 /*
- * pg_datum_arrow_ref
+ * ArrowIsForeignScanParallelSafe
  */
-static void
-pg_datum_arrow_ref(kern_data_store *kds,
-				   kern_colmeta *cmeta,
-				   size_t index,
-				   Datum *p_datum,
-				   bool *p_isnull)
+static bool
+ArrowIsForeignScanParallelSafe(PlannerInfo *root,
+							   RelOptInfo *rel,
+							   RangeTblEntry *rte)
 {
-	Datum		datum = 0;
-	bool		isnull = true;
+	return true;
+}
 
-	if (cmeta->nullmap_offset != 0)
-	{
-		size_t	nullmap_offset = __kds_unpack(cmeta->nullmap_offset);
-		uint8  *nullmap = (uint8 *)kds + nullmap_offset;
+/*
+ * ArrowEstimateDSMForeignScan 
+ */
+Size
+ExecEstimateDSMArrowFdw(ArrowFdwState *af_state)
+{
+	return MAXALIGN(sizeof(pg_atomic_uint32));
+}
 
-		if (att_isnull(index, nullmap))
-			goto out;
-	}
+static Size
+ArrowEstimateDSMForeignScan(ForeignScanState *node,
+							ParallelContext *pcxt)
+{
+	return ExecEstimateDSMArrowFdw((ArrowFdwState *)node->fdw_state);
+}
 
-	if (cmeta->atttypkind == TYPE_KIND__ARRAY)
-	{
-		kern_colmeta   *smeta;
-		cl_uint		   *offset;
+/*
+ * ArrowInitializeDSMForeignScan
+ */
+void
+ExecInitDSMArrowFdw(ArrowFdwState *af_state, pg_atomic_uint32 *rbatch_index)
+{
+	pg_atomic_init_u32(rbatch_index, 0);
+	af_state->rbatch_index = rbatch_index;
+}
 
-		if (cmeta->num_subattrs != 1 ||
-			cmeta->idx_subattrs < kds->ncols ||
-			cmeta->idx_subattrs >= kds->nr_colmeta)
-			elog(ERROR, "Bug? corrupted kernel column metadata");
-		smeta = &kds->colmeta[cmeta->idx_subattrs];
-		if (cmeta->values_offset == 0)
-			goto out;		/* not loaded? always NULL */
-		offset = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
-		datum = pg_array_arrow_ref(kds, smeta,
-								   offset[index],
-								   offset[index+1]);
-		isnull = false;
-	}
-	else if (cmeta->atttypkind == TYPE_KIND__COMPOSITE)
-	{
-		TupleDesc	tupdesc = lookup_rowtype_tupdesc(cmeta->atttypid, -1);
-		Datum	   *sub_values = alloca(sizeof(Datum) * tupdesc->natts);
-		bool	   *sub_isnull = alloca(sizeof(bool)  * tupdesc->natts);
-		HeapTuple	htup;
-		int			j;
+static void
+ArrowInitializeDSMForeignScan(ForeignScanState *node,
+							  ParallelContext *pcxt,
+							  void *coordinate)
+{
+	ExecInitDSMArrowFdw((ArrowFdwState *)node->fdw_state,
+						(pg_atomic_uint32 *) coordinate);
+}
 
-		if (tupdesc->natts != cmeta->num_subattrs)
-			elog(ERROR, "Struct definition is conrrupted?");
-		if (cmeta->idx_subattrs < kds->ncols ||
-			cmeta->idx_subattrs + cmeta->num_subattrs > kds->nr_colmeta)
-			elog(ERROR, "Bug? strange kernel column metadata");
+/*
+ * ArrowReInitializeDSMForeignScan
+ */
+void
+ExecReInitDSMArrowFdw(ArrowFdwState *af_state)
+{
+	pg_atomic_write_u32(af_state->rbatch_index, 0);
+}
 
-		for (j=0; j < tupdesc->natts; j++)
-		{
-			kern_colmeta *sub_meta = &kds->colmeta[cmeta->idx_subattrs + j];
 
-			pg_datum_arrow_ref(kds, sub_meta, index,
-							   sub_values + j,
-							   sub_isnull + j);
-		}
-		htup = heap_form_tuple(tupdesc, sub_values, sub_isnull);
+static void
+ArrowReInitializeDSMForeignScan(ForeignScanState *node,
+								ParallelContext *pcxt,
+								void *coordinate)
+{
+	ExecReInitDSMArrowFdw((ArrowFdwState *)node->fdw_state);
+}
 
-		ReleaseTupleDesc(tupdesc);
+/*
+ * ArrowInitializeWorkerForeignScan
+ */
+void
+ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
+					   pg_atomic_uint32 *rbatch_index)
+{
+	af_state->rbatch_index = rbatch_index;
+}
 
-		datum = PointerGetDatum(htup->t_data);
-		isnull = false;
-	}
-	else if (cmeta->values_offset == 0)
-	{
-		/* not loaded, always null */
-		goto out;
-	}
-	else
-	{
-		Assert(cmeta->atttypkind == TYPE_KIND__BASE);
-		switch (cmeta->atttypid)
-		{
-			case INT2OID:
-			case FLOAT2OID:
-				datum = pg_int2_arrow_ref(kds, cmeta, index);
-				break;
-			case INT4OID:
-			case FLOAT4OID:
-				datum = pg_int4_arrow_ref(kds, cmeta, index);
-				break;
-			case INT8OID:
-			case FLOAT8OID:
-				datum = pg_int8_arrow_ref(kds, cmeta, index);
-				break;
-			case TEXTOID:
-			case BYTEAOID:
-				datum = pg_varlena_arrow_ref(kds, cmeta, index);
-				break;
-			case BPCHAROID:
-				datum = pg_bpchar_arrow_ref(kds, cmeta, index);
-				break;
-			case BOOLOID:
-				datum = pg_bool_arrow_ref(kds, cmeta, index);
-				break;
-			case NUMERICOID:
-				datum = pg_numeric_arrow_ref(kds, cmeta, index);
-				break;
-			case DATEOID:
-				datum = pg_date_arrow_ref(kds, cmeta, index);
-				break;
-			case TIMEOID:
-				datum = pg_time_arrow_ref(kds, cmeta, index);
-				break;
-			case TIMESTAMPOID:
-			case TIMESTAMPTZOID:
-				datum = pg_timestamp_arrow_ref(kds, cmeta, index);
-				break;
-			case INTERVALOID:
-				datum = pg_interval_arrow_ref(kds, cmeta, index);
-				break;
-			default:
-				elog(ERROR, "Bug? unexpected datum type: %u",
-					 cmeta->atttypid);
-				break;
-		}
-		isnull = false;
-	}
-out:
-	*p_datum  = datum;
-	*p_isnull = isnull;
+static void
+ArrowInitializeWorkerForeignScan(ForeignScanState *node,
+								 shm_toc *toc,
+								 void *coordinate)
+{
+	ExecInitWorkerArrowFdw((ArrowFdwState *)node->fdw_state,
+						   (pg_atomic_uint32 *) coordinate);
 }
 
 /*
- * KDS_fetch_tuple_arrow
+ * ArrowShutdownForeignScan
  */
-bool
-KDS_fetch_tuple_arrow(TupleTableSlot *slot,
-					  kern_data_store *kds,
-					  size_t index)
+void
+ExecShutdownArrowFdw(ArrowFdwState *af_state)
 {
-	Datum  *values = slot->tts_values;
-	bool   *isnull = slot->tts_isnull;
-	int		j;
-
-	if (index >= kds->nitems)
-		return false;
-	ExecStoreAllNullTuple(slot);
-	for (j=0; j < kds->ncols; j++)
-	{
-		kern_colmeta   *cmeta = &kds->colmeta[j];
+	/* nothing to do */
+}
 
-		pg_datum_arrow_ref(kds, cmeta,
-						   index,
-						   values + j,
-						   isnull + j);
-	}
-	return true;
+static void
+ArrowShutdownForeignScan(ForeignScanState *node)
+{
+	ExecShutdownArrowFdw((ArrowFdwState *)node->fdw_state);
 }
 
 /*
- * arrowFdwExtractFilesList
+ * ArrowPlanForeignModify
  */
 static List *
-__arrowFdwExtractFilesList(List *options_list,
-						   int *p_parallel_nworkers,
-						   bool *p_writable)
+ArrowPlanForeignModify(PlannerInfo *root,
+					   ModifyTable *plan,
+					   Index resultRelation,
+					   int subplan_index)
 {
-	ListCell   *lc;
-	List	   *filesList = NIL;
-	char	   *dir_path = NULL;
-	char	   *dir_suffix = NULL;
-	int			parallel_nworkers = -1;
-	bool		writable = false;	/* default: read-only */
-
-	foreach (lc, options_list)
-	{
-		DefElem	   *defel = lfirst(lc);
-
-		Assert(IsA(defel->arg, String));
-		if (strcmp(defel->defname, "file") == 0)
-		{
-			char   *temp = strVal(defel->arg);
-			filesList = lappend(filesList, makeString(pstrdup(temp)));
-		}
-		else if (strcmp(defel->defname, "files") == 0)
-		{
-			char   *temp = pstrdup(strVal(defel->arg));
-			char   *saveptr;
-			char   *tok, *pos;
-
-			while ((tok = strtok_r(temp, ",", &saveptr)) != NULL)
-			{
-				while (isspace(*tok))
-					tok++;
-				pos = tok + strlen(tok) - 1;
-				while (pos >= tok && isspace(*pos))
-					*pos-- = '\0';
+	RangeTblEntry  *rte = planner_rt_fetch(resultRelation, root);
+	ForeignTable   *ft = GetForeignTable(rte->relid);
+	List		   *filesList	__attribute__((unused));
+	bool			writable;
 
-				filesList = lappend(filesList, makeString(pstrdup(tok)));
+	if (plan->operation != CMD_INSERT)
+		elog(ERROR, "not a supported operation on arrow_fdw foreign tables");
 
-				temp = NULL;
-			}
-		}
-		else if (strcmp(defel->defname, "dir") == 0)
-		{
-			dir_path = strVal(defel->arg);
-		}
-		else if (strcmp(defel->defname, "suffix") == 0)
-		{
-			dir_suffix = strVal(defel->arg);
-		}
-		else if (strcmp(defel->defname, "parallel_workers") == 0)
-		{
-			if (parallel_nworkers >= 0)
-				elog(ERROR, "'parallel_workers' appeared twice");
-			parallel_nworkers = pg_atoi(strVal(defel->arg), sizeof(int), '\0');
-		}
-		else if (strcmp(defel->defname, "writable") == 0)
-		{
-			writable = defGetBoolean(defel);
-		}
-		else
-			elog(ERROR, "arrow: unknown option (%s)", defel->defname);
-	}
-	if (dir_suffix && !dir_path)
-		elog(ERROR, "arrow: cannot use 'suffix' option without 'dir'");
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	if (!writable)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
+			 get_rel_name(rte->relid));
+	Assert(list_length(filesList) == 1);
 
-	if (writable)
-	{
-		if (dir_path)
-			elog(ERROR, "arrow: 'dir_path' and 'writable' options are exclusive");
-		if (list_length(filesList) == 0)
-			elog(ERROR, "arrow: 'writable' needs a backend file specified by 'file' option");
-		if (list_length(filesList) > 1)
-			elog(ERROR, "arrow: 'writable' cannot use multiple backend files");
-	}
+	return NIL;
+}
 
-	if (dir_path)
-	{
-		struct dirent *dentry;
-		DIR	   *dir;
-		char   *temp;
+/*
+ * __arrowOpenWriteState
+ */
+static arrowWriteState *
+__arrowOpenWriteState(Relation frel)
+{
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
+	List		   *filesList = arrowFdwExtractFilesList(ft->options);
+	const char	   *fname;
+	File			filp;
+	bool			redo_log_written = false;
 
-		dir = AllocateDir(dir_path);
-		while ((dentry = ReadDir(dir, dir_path)) != NULL)
-		{
-			if (strcmp(dentry->d_name, ".") == 0 ||
-				strcmp(dentry->d_name, "..") == 0)
-				continue;
-			if (dir_suffix)
-			{
-				int		dlen = strlen(dentry->d_name);
-				int		slen = strlen(dir_suffix);
-				int		diff;
+	Assert(list_length(filesList) == 1);
+	fname = strVal(linitial(filesList));
 
-				if (dlen < 2 + slen)
-					continue;
-				diff = dlen - slen;
-				if (dentry->d_name[diff-1] != '.' ||
-					strcmp(dentry->d_name + diff, dir_suffix) != 0)
-					continue;
-			}
-			temp = psprintf("%s/%s", dir_path, dentry->d_name);
-			filesList = lappend(filesList, makeString(temp));
-		}
-		FreeDir(dir);
-	}
+	LockRelation(frel, ShareRowExclusiveLock);
 
-	if (filesList == NIL)
-		elog(ERROR, "no files are configured on behalf of the arrow_fdw foreign table");
-	foreach (lc, filesList)
+	filp = PathNameOpenFile(fname, O_RDWR | PG_BINARY);
+	if (filp < 0)
 	{
-		const char *fname = strVal((Value *)lfirst(lc));
+		if (errno != ENOENT)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", fname)));
 
-		if (!writable)
+		filp = PathNameOpenFile(fname, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+		if (filp < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", fname)));
+		PG_TRY();
 		{
-			if (access(fname, R_OK) != 0)
-				elog(ERROR, "unable to read '%s': %m", fname);
+			createArrowWriteRedoLog(filp, true);
+			redo_log_written = true;
 		}
-		else
+		PG_CATCH();
 		{
-			if (access(fname, R_OK | W_OK) != 0)
-			{
-				if (errno != ENOENT)
-					elog(ERROR, "unable to read/write '%s': %m", fname);
-				else
-				{
-					char   *temp = pstrdup(fname);
-					char   *dname = dirname(temp);
-
-					if (access(dname, R_OK | W_OK | X_OK) != 0)
-						elog(ERROR, "unable to create '%s': %m", fname);
-					pfree(temp);
-				}
-			}
+			unlink(fname);
+			PG_RE_THROW();
 		}
+		PG_END_TRY();
 	}
-	/* other properties */
-	if (p_parallel_nworkers)
-		*p_parallel_nworkers = parallel_nworkers;
-	if (p_writable)
-		*p_writable = writable;
-
-	return filesList;
+	return createArrowWriteState(frel, filp, redo_log_written);
 }
 
-static List *
-arrowFdwExtractFilesList(List *options_list)
+/*
+ * __arrowInsertBatchSize
+ *
+ * Number of rows to be appended on the write buffer at once. Batch
+ * insertion cannot handle RETURNING, WITH CHECK or AFTER ROW trigger.
+ */
+static int
+__arrowInsertBatchSize(ResultRelInfo *rrinfo)
 {
-	return __arrowFdwExtractFilesList(options_list, NULL, NULL);
+	if (rrinfo->ri_projectReturning != NULL ||
+		rrinfo->ri_WithCheckOptions != NIL ||
+		(rrinfo->ri_TrigDesc &&
+		 rrinfo->ri_TrigDesc->trig_insert_after_row))
+		return 1;
+	return arrow_insert_batch_size;
 }
 
-
 /*
- * validator of Arrow_Fdw
+ * __arrowBeginForeignInsert
  */
-Datum
-pgstrom_arrow_fdw_validator(PG_FUNCTION_ARGS)
+static void
+__arrowBeginForeignInsert(ResultRelInfo *rrinfo)
 {
-	List	   *options_list = untransformRelOptions(PG_GETARG_DATUM(0));
-	Oid			catalog = PG_GETARG_OID(1);
-
-	if (catalog == ForeignTableRelationId)
-	{
-		List	   *filesList;
-		ListCell   *lc;
-
-		filesList = arrowFdwExtractFilesList(options_list);
-		foreach (lc, filesList)
-		{
-			ArrowFileInfo	af_info;
-			const char	   *fname = strVal(lfirst(lc));
-
-			readArrowFile(fname, &af_info, true);
-		}
-	}
-	else if (options_list != NIL)
-	{
-		const char	   *label;
-		char			temp[80];
+	arrowWriteState *aw_state;
 
-		switch (catalog)
-		{
-			case ForeignDataWrapperRelationId:
-				label = "FOREIGN DATA WRAPPER";
-				break;
-			case ForeignServerRelationId:
-				label = "SERVER";
-				break;
-			case UserMappingRelationId:
-				label = "USER MAPPING";
-				break;
-			case AttributeRelationId:
-				label = "attribute of FOREIGN TABLE";
-				break;
-			default:
-				snprintf(temp, sizeof(temp),
-						 "[unexpected object catalog=%u]", catalog);
-				label = temp;
-				break;
-		}
-		elog(ERROR, "Arrow_Fdw does not support any options for %s", label);
-	}
-	PG_RETURN_VOID();
+	aw_state = __arrowOpenWriteState(rrinfo->ri_RelationDesc);
+	aw_state->batch_size = __arrowInsertBatchSize(rrinfo);
+	aw_state->batch_nslots = 0;
+	if (aw_state->batch_size > 1)
+		aw_state->batch_slots = palloc0(sizeof(TupleTableSlot *) *
+										aw_state->batch_size);
+	rrinfo->ri_FdwState = aw_state;
 }
-PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_validator);
 
 /*
- * pgstrom_arrow_fdw_precheck_schema
+ * ArrowBeginForeignModify
  */
 static void
-arrow_fdw_precheck_schema(Relation rel)
+ArrowBeginForeignModify(ModifyTableState *mtstate,
+						ResultRelInfo *rrinfo,
+						List *fdw_private,
+						int subplan_index,
+						int eflags)
 {
-	TupleDesc		tupdesc = RelationGetDescr(rel);
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(rel));
-	List		   *filesList;
-	ListCell	   *lc;
-	bool			writable;
-	int				j;
+	__arrowBeginForeignInsert(rrinfo);
+}
 
-	/* check schema definition is supported by Apache Arrow */
-	for (j=0; j < tupdesc->natts; j++)
-	{
-		Form_pg_attribute	attr = tupleDescAttr(tupdesc, j);
+/*
+ * __arrowExecForeignInsert
+ *
+ * It appends the tuples to the write buffer column by column, so each
+ * SQLfield buffer is filled up in bulk, then writes out the buffer as
+ * a record batch once its usage exceeds the threshold.
+ */
+static void
+__arrowExecForeignInsert(ResultRelInfo *rrinfo,
+						 TupleTableSlot **slots, int nslots)
+{
+	Relation		frel = rrinfo->ri_RelationDesc;
+	TupleDesc		tupdesc = RelationGetDescr(frel);
+	arrowWriteState *aw_state = rrinfo->ri_FdwState;
+	SQLtable	   *table = &aw_state->sql_table;
+	MemoryContext	oldcxt;
+	size_t			usage = 0;
+	int				i, j;
 
-		if (!arrowTypeIsConvertible(attr->atttypid,
-									attr->atttypmod))
-			elog(ERROR, "column %s of foreign table %s has %s type that is not convertible any supported Apache Arrow types",
-				 NameStr(attr->attname),
-				 RelationGetRelationName(rel),
-				 format_type_be(attr->atttypid));
-	}
+	for (i=0; i < nslots; i++)
+		slot_getallattrs(slots[i]);
 
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	foreach (lc, filesList)
+	oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
+	for (j=0; j < tupdesc->natts; j++)
 	{
-		const char *fname = strVal(lfirst(lc));
-		File		filp;
-		List	   *rb_cached = NIL;
-		ListCell   *cell;
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		SQLfield   *column = &table->columns[j];
+		size_t		column_usage = 0;
 
-		filp = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
-		if (filp < 0)
-		{
-			if (writable && errno == ENOENT)
-				continue;
-			elog(ERROR, "failed to open '%s' on behalf of '%s': %m",
-				 fname, RelationGetRelationName(rel));
-		}
-		/* check schema compatibility */
-		rb_cached = arrowLookupOrBuildMetadataCache(filp);
-		foreach (cell, rb_cached)
+		for (i=0; i < nslots; i++)
 		{
-			RecordBatchState *rb_state = lfirst(cell);
+			Datum		datum = slots[i]->tts_values[j];
+			bool		isnull = slots[i]->tts_isnull[j];
 
-			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
-				elog(ERROR, "arrow file '%s' on behalf of the foreign table '%s' has incompatible schema definition",
-					 fname, RelationGetRelationName(rel));
+			if (isnull)
+			{
+				column_usage = sql_field_put_value(column, NULL, 0);
+			}
+			else if (attr->attbyval)
+			{
+				Assert(column->sql_type.pgsql.typbyval);
+				column_usage = sql_field_put_value(column, (char *)&datum,
+												   attr->attlen);
+			}
+			else if (attr->attlen == -1)
+			{
+				int		vl_len = VARSIZE_ANY_EXHDR(datum);
+				char   *vl_ptr = VARDATA_ANY(datum);
+
+				Assert(column->sql_type.pgsql.typlen == -1);
+				column_usage = sql_field_put_value(column, vl_ptr, vl_len);
+			}
+			else
+			{
+				elog(ERROR, "Bug? unsupported type format");
+			}
 		}
-		list_free(rb_cached);
+		usage += column_usage;
 	}
+	table->nitems += nslots;
+	MemoryContextSwitchTo(oldcxt);
+
+	/*
+	 * If usage exceeds the threshold of record-batch size, make a redo-log
+	 * on demand, and write out the buffer.
+	 */
+	if (usage > table->segment_sz)
+		writeOutArrowRecordBatch(aw_state, false);
 }
 
-Datum
-pgstrom_arrow_fdw_precheck_schema(PG_FUNCTION_ARGS)
+/*
+ * __arrowFlushForeignInsert - write out the buffered rows, if any
+ */
+static void
+__arrowFlushForeignInsert(ResultRelInfo *rrinfo)
 {
-	EventTriggerData   *trigdata;
-	
-	if (!CALLED_AS_EVENT_TRIGGER(fcinfo))
-		elog(ERROR, "%s: must be called as EventTrigger",
-			 __FUNCTION__);
-	trigdata = (EventTriggerData *) fcinfo->context;
-	if (strcmp(trigdata->event, "ddl_command_end") != 0)
-		elog(ERROR, "%s: must be called on ddl_command_end event",
-			 __FUNCTION__);
-	if (strcmp(trigdata->tag, "CREATE FOREIGN TABLE") == 0)
-	{
-		CreateStmt	   *stmt = (CreateStmt *)trigdata->parsetree;
-		Relation		rel;
-
-		rel = relation_openrv_extended(stmt->relation, AccessShareLock, true);
-		if (!rel)
-			PG_RETURN_NULL();
-		if (rel->rd_rel->relkind == RELKIND_FOREIGN_TABLE &&
-			GetFdwRoutineForRelation(rel, false) == &pgstrom_arrow_fdw_routine)
-		{
-			arrow_fdw_precheck_schema(rel);
-		}
-		relation_close(rel, AccessShareLock);
-	}
-	else if (strcmp(trigdata->tag, "ALTER FOREIGN TABLE") == 0 &&
-			 IsA(trigdata->parsetree, AlterTableStmt))
-	{
-		AlterTableStmt *stmt = (AlterTableStmt *)trigdata->parsetree;
-		Relation		rel;
-		ListCell	   *lc;
-		bool			has_schema_change = false;
-
-		rel = relation_openrv_extended(stmt->relation, AccessShareLock, true);
-		if (!rel)
-			PG_RETURN_NULL();
-		if (rel->rd_rel->relkind == RELKIND_FOREIGN_TABLE &&
-			GetFdwRoutineForRelation(rel, false) == &pgstrom_arrow_fdw_routine)
-		{
-			foreach (lc, stmt->cmds)
-			{
-				AlterTableCmd  *cmd = lfirst(lc);
+	arrowWriteState *aw_state = rrinfo->ri_FdwState;
+	int			i;
 
-				if (cmd->subtype == AT_AddColumn ||
-					cmd->subtype == AT_DropColumn ||
-					cmd->subtype == AT_AlterColumnType)
-				{
-					has_schema_change = true;
-					break;
-				}
-			}
-			if (has_schema_change)
-				arrow_fdw_precheck_schema(rel);
-		}
-		relation_close(rel, AccessShareLock);
-	}
-	PG_RETURN_NULL();
+	if (aw_state->batch_nslots == 0)
+		return;
+	__arrowExecForeignInsert(rrinfo,
+							 aw_state->batch_slots,
+							 aw_state->batch_nslots);
+	for (i=0; i < aw_state->batch_nslots; i++)
+		ExecClearTuple(aw_state->batch_slots[i]);
+	aw_state->batch_nslots = 0;
 }
-PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_precheck_schema);
 
 /*
- * arrowInvalidateMetadataCache
+ * ArrowExecForeignInsert
  *
- * NOTE: caller must have lock_slots[] with EXCLUSIVE mode
+ * Rows are buffered on the local slots up to arrow_fdw.insert_batch_size,
+ * then appended at once, because PostgreSQL v13 or older (and COPY FROM)
+ * have no batch insertion API.
  */
-static uint64
-arrowInvalidateMetadataCache(arrowMetadataCache *mcache, bool detach_lru)
+static TupleTableSlot *
+ArrowExecForeignInsert(EState *estate,
+					   ResultRelInfo *rrinfo,
+					   TupleTableSlot *slot,
+					   TupleTableSlot *planSlot)
 {
-	arrowMetadataCache *mtemp;
-	dlist_node	   *dnode;
-	uint64			released = 0;
+	arrowWriteState *aw_state = rrinfo->ri_FdwState;
+	TupleDesc		tupdesc = RelationGetDescr(rrinfo->ri_RelationDesc);
+	TupleTableSlot *bslot;
+	MemoryContext	oldcxt;
 
-	while (!dlist_is_empty(&mcache->siblings))
+	if (aw_state->batch_size <= 1)
 	{
-		dnode = dlist_pop_head_node(&mcache->siblings);
-		mtemp = dlist_container(arrowMetadataCache, chain, dnode);
-		Assert(dlist_is_empty(&mtemp->siblings) &&
-			   !mtemp->lru_chain.prev && !mtemp->lru_chain.next);
-		dlist_delete(&mtemp->chain);
-		released += MAXALIGN(offsetof(arrowMetadataCache,
-									  fstate[mtemp->nfields]));
-		pfree(mtemp);
+		__arrowExecForeignInsert(rrinfo, &slot, 1);
+		return slot;
 	}
-	released += MAXALIGN(offsetof(arrowMetadataCache,
-								  fstate[mcache->nfields]));
-	if (detach_lru)
+	bslot = aw_state->batch_slots[aw_state->batch_nslots];
+	if (!bslot)
 	{
-		SpinLockAcquire(&arrow_metadata_state->lru_lock);
-		dlist_delete(&mcache->lru_chain);
-		SpinLockRelease(&arrow_metadata_state->lru_lock);
+		oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
+		bslot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+		aw_state->batch_slots[aw_state->batch_nslots] = bslot;
+		MemoryContextSwitchTo(oldcxt);
 	}
-	dlist_delete(&mcache->chain);
-	pfree(mcache);
+	ExecCopySlot(bslot, slot);
+	if (++aw_state->batch_nslots >= aw_state->batch_size)
+		__arrowFlushForeignInsert(rrinfo);
 
-	return pg_atomic_sub_fetch_u64(&arrow_metadata_state->consumed,
-								   released);
+	return slot;
 }
 
 /*
- * copyMetadataFieldCache - copy for nested structure
+ * __arrowEndForeignInsert
  */
-static int
-copyMetadataFieldCache(RecordBatchFieldState *dest_curr,
-					   RecordBatchFieldState *dest_tail,
-					   int nattrs,
-					   RecordBatchFieldState *columns)
+static void
+__arrowEndForeignInsert(ResultRelInfo *rrinfo)
 {
-	RecordBatchFieldState *dest_next = dest_curr + nattrs;
-	int		j, k, nslots = nattrs;
-
-	if (dest_next > dest_tail)
-		return -1;
+	arrowWriteState *aw_state = rrinfo->ri_FdwState;
+	int			i;
 
-	for (j=0; j < nattrs; j++)
+	__arrowFlushForeignInsert(rrinfo);
+	writeOutArrowRecordBatch(aw_state, true);
+	for (i=0; i < aw_state->batch_size && aw_state->batch_slots; i++)
 	{
-		dest_curr[j] = columns[j];
-		if (dest_curr[j].num_children == 0)
-			Assert(dest_curr[j].children == NULL);
-		else
-		{
-			dest_curr[j].children = dest_next;
-			k = copyMetadataFieldCache(dest_next,
-									   dest_tail,
-									   columns[j].num_children,
-									   columns[j].children);
-			if (k < 0)
-				return -1;
-			dest_next += k;
-			nslots += k;
-		}
+		if (aw_state->batch_slots[i])
+			ExecDropSingleTupleTableSlot(aw_state->batch_slots[i]);
 	}
-	return nslots;
 }
 
+#if PG_VERSION_NUM >= 140000
 /*
- * makeRecordBatchStateFromCache
- *   - setup RecordBatchState from arrowMetadataCache
+ * ArrowExecForeignBatchInsert
  */
-static RecordBatchState *
-makeRecordBatchStateFromCache(arrowMetadataCache *mcache, File fdesc)
+static TupleTableSlot **
+ArrowExecForeignBatchInsert(EState *estate,
+							ResultRelInfo *rrinfo,
+							TupleTableSlot **slots,
+							TupleTableSlot **planSlots,
+							int *numSlots)
 {
-	RecordBatchState   *rbstate;
+	__arrowExecForeignInsert(rrinfo, slots, *numSlots);
 
-	rbstate = palloc0(offsetof(RecordBatchState,
-							   columns[mcache->nfields]));
-	rbstate->fdesc = fdesc;
-	memcpy(&rbstate->stat_buf, &mcache->stat_buf, sizeof(struct stat));
-	rbstate->rb_index  = mcache->rb_index;
-	rbstate->rb_offset = mcache->rb_offset;
-	rbstate->rb_length = mcache->rb_length;
-	rbstate->rb_nitems = mcache->rb_nitems;
-	rbstate->ncols = mcache->ncols;
-	copyMetadataFieldCache(rbstate->columns,
-						   rbstate->columns + mcache->nfields,
-						   mcache->ncols,
-						   mcache->fstate);
-	return rbstate;
+	return slots;
 }
 
 /*
- * arrowReclaimMetadataCache
+ * ArrowGetForeignModifyBatchSize
  */
-static void
-arrowReclaimMetadataCache(void)
+static int
+ArrowGetForeignModifyBatchSize(ResultRelInfo *rrinfo)
 {
-	arrowMetadataCache *mcache;
-	LWLock	   *lock = NULL;
-	dlist_node *dnode;
-	uint32		lru_hash;
-	uint32		lru_index;
-	uint64		consumed;
-
-	consumed = pg_atomic_read_u64(&arrow_metadata_state->consumed);
-	if (consumed <= arrow_metadata_cache_size)
-		return;
-
-	SpinLockAcquire(&arrow_metadata_state->lru_lock);
-	if (dlist_is_empty(&arrow_metadata_state->lru_list))
-	{
-		SpinLockRelease(&arrow_metadata_state->lru_lock);
-		return;
-	}
-	dnode = dlist_tail_node(&arrow_metadata_state->lru_list);
-	mcache = dlist_container(arrowMetadataCache, lru_chain, dnode);
-	lru_hash = mcache->hash;
-	SpinLockRelease(&arrow_metadata_state->lru_lock);
-
-	do {
-		lru_index = lru_hash % ARROW_METADATA_HASH_NSLOTS;
-		lock = &arrow_metadata_state->lock_slots[lru_index];
+	return __arrowInsertBatchSize(rrinfo);
+}
+#endif
 
-		LWLockAcquire(lock, LW_EXCLUSIVE);
-		SpinLockAcquire(&arrow_metadata_state->lru_lock);
-		if (dlist_is_empty(&arrow_metadata_state->lru_list))
-		{
-			SpinLockRelease(&arrow_metadata_state->lru_lock);
-			LWLockRelease(lock);
-			break;
-		}
-		dnode = dlist_tail_node(&arrow_metadata_state->lru_list);
-		mcache = dlist_container(arrowMetadataCache, lru_chain, dnode);
-		if (mcache->hash == lru_hash)
-		{
-			dlist_delete(&mcache->lru_chain);
-			memset(&mcache->lru_chain, 0, sizeof(dlist_node));
-			SpinLockRelease(&arrow_metadata_state->lru_lock);
-			consumed = arrowInvalidateMetadataCache(mcache, false);
-		}
-		else
-		{
-			/* LRU-tail was referenced by someone, try again */
-			lru_hash = mcache->hash;
-            SpinLockRelease(&arrow_metadata_state->lru_lock);
-		}
-		LWLockRelease(lock);
-	} while (consumed > arrow_metadata_cache_size);
+/*
+ * ArrowEndForeignModify
+ */
+static void
+ArrowEndForeignModify(EState *estate,
+					  ResultRelInfo *rrinfo)
+{
+	__arrowEndForeignInsert(rrinfo);
 }
 
 /*
- * __arrowBuildMetadataCache
+ * ArrowBeginForeignInsert
  *
- * NOTE: caller must have exclusive lock on arrow_metadata_state->lock_slots[]
+ * It is called on COPY FROM or tuple-routing to partition leaf.
  */
-static arrowMetadataCache *
-__arrowBuildMetadataCache(List *rb_state_list, uint32 hash)
+static void
+ArrowBeginForeignInsert(ModifyTableState *mtstate,
+						ResultRelInfo *rrinfo)
 {
-	arrowMetadataCache *mcache = NULL;
-	arrowMetadataCache *mtemp;
-	dlist_node *dnode;
-	Size		sz, consumed = 0;
-	int			nfields;
-	ListCell   *lc;
-
-	foreach (lc, rb_state_list)
-	{
-		RecordBatchState *rbstate = lfirst(lc);
-
-		if (!mcache)
-			nfields = RecordBatchFieldCount(rbstate);
-		else
-			Assert(nfields == RecordBatchFieldCount(rbstate));
-
-		sz = offsetof(arrowMetadataCache, fstate[nfields]);
-		mtemp = MemoryContextAllocZero(TopSharedMemoryContext, sz);
-		if (!mtemp)
-		{
-			/* !!out of memory!! */
-			if (mcache)
-			{
-				while (!dlist_is_empty(&mcache->siblings))
-				{
-					dnode = dlist_pop_head_node(&mcache->siblings);
-					mtemp = dlist_container(arrowMetadataCache,
-											chain, dnode);
-					pfree(mtemp);
-				}
-				pfree(mcache);
-			}
-			return NULL;
-		}
-
-		dlist_init(&mtemp->siblings);
-		memcpy(&mtemp->stat_buf, &rbstate->stat_buf, sizeof(struct stat));
-		mtemp->hash      = hash;
-		mtemp->rb_index  = rbstate->rb_index;
-        mtemp->rb_offset = rbstate->rb_offset;
-        mtemp->rb_length = rbstate->rb_length;
-        mtemp->rb_nitems = rbstate->rb_nitems;
-        mtemp->ncols     = rbstate->ncols;
-		mtemp->nfields   =
-			copyMetadataFieldCache(mtemp->fstate,
-								   mtemp->fstate + nfields,
-								   rbstate->ncols,
-								   rbstate->columns);
-		Assert(mtemp->nfields == nfields);
-
-		if (!mcache)
-			mcache = mtemp;
-		else
-			dlist_push_tail(&mcache->siblings, &mtemp->chain);
-		consumed += MAXALIGN(sz);
-	}
-	pg_atomic_add_fetch_u64(&arrow_metadata_state->consumed, consumed);
+	Relation		frel = rrinfo->ri_RelationDesc;
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(frel));
+	bool			writable;
 
-	return mcache;
+	__arrowFdwExtractFilesList(ft->options, NULL, &writable);
+	if (!writable)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
+			 RelationGetRelationName(frel));
+	__arrowBeginForeignInsert(rrinfo);
 }
 
+/*
+ * ArrowEndForeignInsert
+ */
+static void
+ArrowEndForeignInsert(EState *estate,
+					  ResultRelInfo *rrinfo)
+{
+	__arrowEndForeignInsert(rrinfo);
+}
 
 /*
- * checkArrowRecordBatchIsVisible
- *
- * NOTE: It must be called under shared lock on lock_slots[]
+ * ArrowExplainForeignModify
  */
-static bool
-checkArrowRecordBatchIsVisible(RecordBatchState *rbstate,
-							   dlist_head *mvcc_slot)
+static void
+ArrowExplainForeignModify(ModifyTableState *mtstate,
+						  ResultRelInfo *rinfo,
+						  List *fdw_private,
+						  int subplan_index,
+						  struct ExplainState *es)
 {
-	dlist_iter		iter;
+	/* print something */
+}
 
-	dlist_foreach(iter, mvcc_slot)
-	{
-		arrowWriteMVCCLog  *mvcc = dlist_container(arrowWriteMVCCLog,
-												   chain, iter.cur);
-		if (mvcc->key.st_dev == rbstate->stat_buf.st_dev &&
-			mvcc->key.st_ino == rbstate->stat_buf.st_ino &&
-			mvcc->record_batch == rbstate->rb_index)
-		{
-			if (TransactionIdIsCurrentTransactionId(mvcc->xid))
-				return true;
-			else
-				return false;
-		}
-	}
-	return true;
+/*
+ * handler of Arrow_Fdw
+ */
+Datum
+pgstrom_arrow_fdw_handler(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(&pgstrom_arrow_fdw_routine);
 }
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_handler);
 
 /*
- * arrowLookupOrBuildMetadataCache
+ * arrowTypeIsEqual
  */
-List *
-arrowLookupOrBuildMetadataCache(File fdesc)
+static bool
+arrowTypeIsEqual(ArrowField *a, ArrowField *b, int depth)
 {
-	MetadataCacheKey key;
-	struct stat	stat_buf;
-	uint32		index;
-	LWLock	   *lock;
-	dlist_head *hash_slot;
-	dlist_head *mvcc_slot;
-	dlist_iter	iter1, iter2;
-	bool		has_exclusive = false;
-	List	   *results = NIL;
+	int		j;
 
-	if (fstat(FileGetRawDesc(fdesc), &stat_buf) != 0)
-		elog(ERROR, "failed on fstat('%s'): %m", FilePathName(fdesc));
+	if (a->type.node.tag != b->type.node.tag)
+		return false;
+	switch (a->type.node.tag)
+	{
+		case ArrowNodeTag__Int:
+			if (a->type.Int.bitWidth != b->type.Int.bitWidth)
+				return false;
+			break;
+		case ArrowNodeTag__FloatingPoint:
+			{
+				ArrowPrecision	p1 = a->type.FloatingPoint.precision;
+				ArrowPrecision	p2 = b->type.FloatingPoint.precision;
 
-	memset(&key, 0, sizeof(key));
-	key.st_dev	= stat_buf.st_dev;
-	key.st_ino	= stat_buf.st_ino;
-	key.hash = hash_any((unsigned char *)&key,
-						offsetof(MetadataCacheKey, hash));
-	index = key.hash % ARROW_METADATA_HASH_NSLOTS;
-	lock = &arrow_metadata_state->lock_slots[index];
-	hash_slot = &arrow_metadata_state->hash_slots[index];
-	mvcc_slot = &arrow_metadata_state->mvcc_slots[index];
+				if (p1 != p2)
+					return false;
+			}
+			break;
+		case ArrowNodeTag__Utf8:
+		case ArrowNodeTag__Binary:
+		case ArrowNodeTag__Bool:
+			break;
 
-	LWLockAcquire(lock, LW_SHARED);
-retry:
-	dlist_foreach(iter1, hash_slot)
-	{
-		arrowMetadataCache *mcache
-			= dlist_container(arrowMetadataCache, chain, iter1.cur);
-		if (mcache->stat_buf.st_dev == stat_buf.st_dev &&
-			mcache->stat_buf.st_ino == stat_buf.st_ino)
-		{
-			RecordBatchState *rbstate;
-			
-			Assert(mcache->hash == key.hash);
-			if (timespec_comp(&mcache->stat_buf.st_mtim,
-							  &stat_buf.st_mtim) < 0 ||
-				timespec_comp(&mcache->stat_buf.st_ctim,
-							  &stat_buf.st_ctim) < 0)
+		case ArrowNodeTag__Decimal:
+			if (a->type.Decimal.precision != b->type.Decimal.precision ||
+				a->type.Decimal.scale != b->type.Decimal.scale)
+				return false;
+			break;
+
+		case ArrowNodeTag__Date:
+			if (a->type.Date.unit != b->type.Date.unit)
+				return false;
+			break;
+
+		case ArrowNodeTag__Time:
+			if (a->type.Time.unit != b->type.Time.unit)
+				return false;
+			break;
+
+		case ArrowNodeTag__Timestamp:
+			if (a->type.Timestamp.unit != b->type.Timestamp.unit ||
+				a->type.Timestamp.timezone != NULL ||
+				b->type.Timestamp.timezone != NULL)
+				return false;
+			break;
+
+		case ArrowNodeTag__Interval:
+			if (a->type.Interval.unit != b->type.Interval.unit)
+				return false;
+			break;
+
+		case ArrowNodeTag__Struct:
+			if (depth > 0)
+				elog(ERROR, "arrow: nested composite types are not supported");
+			if (a->_num_children != b->_num_children)
+				return false;
+			for (j=0; j < a->_num_children; j++)
 			{
-				char	buf1[80], buf2[80], buf3[80], buf4[80];
-				char   *tail;
+				if (!arrowTypeIsEqual(&a->children[j],
+									  &b->children[j],
+									  depth + 1))
+					return false;
+			}
+			break;
 
-				if (!has_exclusive)
-				{
-					LWLockRelease(lock);
-					LWLockAcquire(lock, LW_EXCLUSIVE);
-					has_exclusive = true;
-					goto retry;
-				}
-				ctime_r(&mcache->stat_buf.st_mtime, buf1);
-				ctime_r(&mcache->stat_buf.st_ctime, buf2);
-				ctime_r(&stat_buf.st_mtime, buf3);
-				ctime_r(&stat_buf.st_ctime, buf4);
-				for (tail=buf1+strlen(buf1)-1; isspace(*tail); *tail--='\0');
-				for (tail=buf2+strlen(buf2)-1; isspace(*tail); *tail--='\0');
-				for (tail=buf3+strlen(buf3)-1; isspace(*tail); *tail--='\0');
-				for (tail=buf4+strlen(buf4)-1; isspace(*tail); *tail--='\0');
-				elog(DEBUG2, "arrow_fdw: metadata cache for '%s' (m:%s, c:%s) is older than the latest file (m:%s, c:%s), so invalidated",
-					 FilePathName(fdesc), buf1, buf2, buf3, buf4);
-				arrowInvalidateMetadataCache(mcache, true);
-				break;
+		case ArrowNodeTag__List:
+			if (depth > 0)
+				elog(ERROR, "arrow_fdw: nested array types are not supported");
+			if (a->_num_children != 1 || b->_num_children != 1)
+				elog(ERROR, "Bug? List of arrow type is corrupted.");
+			if (!arrowTypeIsEqual(&a->children[0],
+								  &b->children[0],
+								  depth + 1))
+				return false;
+			break;
+
+		default:
+			elog(ERROR, "'%s' of arrow type is not supported",
+				 a->type.node.tagName);
+	}
+	return true;
+}
+
+static Oid
+arrowTypeToPGTypeOid(ArrowField *field, int *typmod)
+{
+	ArrowType  *t = &field->type;
+
+	*typmod = -1;
+	switch (t->node.tag)
+	{
+		case ArrowNodeTag__Int:
+			switch (t->Int.bitWidth)
+			{
+				case 16:
+					return INT2OID;
+				case 32:
+					return INT4OID;
+				case 64:
+					return INT8OID;
+				default:
+					elog(ERROR, "Arrow.%s is not supported",
+						 arrowTypeName(field));
+					break;
 			}
-			/*
-			 * Ok, arrow file metadata cache found and still valid
-			 */
-			rbstate = makeRecordBatchStateFromCache(mcache, fdesc);
-			if (checkArrowRecordBatchIsVisible(rbstate, mvcc_slot))
-				results = list_make1(rbstate);
-			dlist_foreach (iter2, &mcache->siblings)
+			break;
+		case ArrowNodeTag__FloatingPoint:
+			switch (t->FloatingPoint.precision)
 			{
-				arrowMetadataCache *__mcache
-					= dlist_container(arrowMetadataCache, chain, iter2.cur);
-				rbstate = makeRecordBatchStateFromCache(__mcache, fdesc);
-				if (checkArrowRecordBatchIsVisible(rbstate, mvcc_slot))
-					results = lappend(results, rbstate);
+				case ArrowPrecision__Half:
+					return FLOAT2OID;
+				case ArrowPrecision__Single:
+					return FLOAT4OID;
+				case ArrowPrecision__Double:
+					return FLOAT8OID;
+				default:
+					elog(ERROR, "Arrow.%s is not supported",
+						 arrowTypeName(field));
 			}
-			SpinLockAcquire(&arrow_metadata_state->lru_lock);
-			dlist_move_head(&arrow_metadata_state->lru_list,
-							&mcache->lru_chain);
-			SpinLockRelease(&arrow_metadata_state->lru_lock);
-			LWLockRelease(lock);
+			break;
+		case ArrowNodeTag__Utf8:
+			return TEXTOID;
+		case ArrowNodeTag__Binary:
+			return BYTEAOID;
+		case ArrowNodeTag__Bool:
+			return BOOLOID;
+		case ArrowNodeTag__Decimal:
+			return NUMERICOID;
+		case ArrowNodeTag__Date:
+			return DATEOID;
+		case ArrowNodeTag__Time:
+			return TIMEOID;
+		case ArrowNodeTag__Timestamp:
+			if (t->Timestamp.timezone)
+				return TIMESTAMPTZOID;
+			return TIMESTAMPOID;
+		case ArrowNodeTag__Interval:
+			return INTERVALOID;
+		case ArrowNodeTag__List:
+			if (field->_num_children != 1)
+				elog(ERROR, "arrow_fdw: corrupted List type definition");
+			else
+			{
+				ArrowField *child = &field->children[0];
+				Oid		type_oid;
+				Oid		elem_oid;
+				int		elem_mod;
 
-			return results;
-		}
-	}
+				elem_oid = arrowTypeToPGTypeOid(child, &elem_mod);
+				type_oid = get_array_type(elem_oid);
+				if (!OidIsValid(type_oid))
+					elog(ERROR, "array of arrow::%s type is not defined",
+						 arrowTypeName(field));
+				return type_oid;
+			}
+			break;
+
+		case ArrowNodeTag__Struct:
+			{
+				Relation	rel;
+				ScanKeyData	skey[2];
+				SysScanDesc	sscan;
+				HeapTuple	tup;
+				Oid			type_oid = InvalidOid;
+
+				/*
+				 * lookup composite type definition from pg_class
+				 * At least, nattrs == _num_children
+				 */
+				rel = table_open(RelationRelationId, AccessShareLock);
+				ScanKeyInit(&skey[0],
+							Anum_pg_class_relkind,
+							BTEqualStrategyNumber, F_CHAREQ,
+							CharGetDatum(RELKIND_COMPOSITE_TYPE));
+				ScanKeyInit(&skey[1],
+							Anum_pg_class_relnatts,
+							BTEqualStrategyNumber, F_INT2EQ,
+							Int16GetDatum(field->_num_children));
+
+				sscan = systable_beginscan(rel, InvalidOid, false,
+										   NULL, 2, skey);
+				while (!OidIsValid(type_oid) &&
+					   HeapTupleIsValid(tup = systable_getnext(sscan)))
+				{
+					Form_pg_class relForm = (Form_pg_class) GETSTRUCT(tup);
+					TupleDesc	tupdesc;
+					int			j;
+					bool		compatible = true;
+
+					if (pg_namespace_aclcheck(relForm->relnamespace,
+											  GetUserId(),
+											  ACL_USAGE) != ACLCHECK_OK)
+						continue;
+
+					if (pg_type_aclcheck(relForm->reltype,
+										 GetUserId(),
+										 ACL_USAGE) != ACLCHECK_OK)
+						continue;
+
+					tupdesc = lookup_rowtype_tupdesc(relForm->reltype, -1);
+					Assert(tupdesc->natts == field->_num_children);
+					for (j=0; compatible && j < tupdesc->natts; j++)
+					{
+						Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+						ArrowField  *child = &field->children[j];
+						Oid			typoid;
+						int			typmod;
+
+						typoid = arrowTypeToPGTypeOid(child, &typmod);
+						if (typoid != attr->atttypid)
+							compatible = false;
+					}
+					ReleaseTupleDesc(tupdesc);
+
+					if (compatible)
+						type_oid = relForm->reltype;
+				}
+				systable_endscan(sscan);
+				table_close(rel, AccessShareLock);
+
+				if (!OidIsValid(type_oid))
+					elog(ERROR, "arrow::%s is not supported",
+						 arrowTypeName(field));
+				return type_oid;
+			}
+			break;
+		case ArrowNodeTag__FixedSizeBinary:
+			if (t->FixedSizeBinary.byteWidth < 1 ||
+				t->FixedSizeBinary.byteWidth > BLCKSZ)
+				elog(ERROR, "arrow_fdw: %s with byteWidth=%d is not supported",
+					 t->node.tagName,
+					 t->FixedSizeBinary.byteWidth);
+			*typmod = t->FixedSizeBinary.byteWidth;
+			return BPCHAROID;
+		default:
+			elog(ERROR, "arrow_fdw: type '%s' is not supported",
+				 field->type.node.tagName);
+	}
+	return InvalidOid;
+}
+
+static const char *
+arrowTypeToPGTypeName(ArrowField *field)
+{
+	Oid			typoid;
+	int			typmod;
+	HeapTuple	tup;
+	Form_pg_type type;
+	char	   *schema;
+	char	   *result;
+
+	typoid = arrowTypeToPGTypeOid(field, &typmod);
+	if (!OidIsValid(typoid))
+		return NULL;
+	tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typoid));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for type %u", typoid);
+	type = (Form_pg_type) GETSTRUCT(tup);
+	schema = get_namespace_name(type->typnamespace);
+	if (typmod < 0)
+		result = psprintf("%s.%s",
+						  quote_identifier(schema),
+						  quote_identifier(NameStr(type->typname)));
+	else
+		result = psprintf("%s.%s(%d)",
+						  quote_identifier(schema),
+						  quote_identifier(NameStr(type->typname)),
+						  typmod);
+	ReleaseSysCache(tup);
+
+	return result;
+}
+
+/*
+ * arrowTypeIsConvertible
+ */
+static bool
+arrowTypeIsConvertible(Oid type_oid, int typemod)
+{
+	HeapTuple		tup;
+	Form_pg_type	typeForm;
+	bool			retval = false;
+
+	switch (type_oid)
+	{
+		case INT2OID:		/* Int16 */
+		case INT4OID:		/* Int32 */
+		case INT8OID:		/* Int64 */
+		case FLOAT2OID:		/* FP16 */
+		case FLOAT4OID:		/* FP32 */
+		case FLOAT8OID:		/* FP64 */
+		case TEXTOID:		/* Utf8 */
+		case BYTEAOID:		/* Binary */
+		case BOOLOID:		/* Bool */
+		case NUMERICOID:	/* Decimal */
+		case DATEOID:		/* Date */
+		case TIMEOID:		/* Time */
+		case TIMESTAMPOID:	/* Timestamp */
+		case TIMESTAMPTZOID:/* TimestampTz */
+		case INTERVALOID:	/* Interval */
+		case BPCHAROID:		/* FixedSizeBinary */
+			return true;
+		default:
+			tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(type_oid));
+			if (!HeapTupleIsValid(tup))
+				elog(ERROR, "cache lookup failed for type %u", type_oid);
+			typeForm = (Form_pg_type) GETSTRUCT(tup);
+
+			if (typeForm->typlen == -1 && OidIsValid(typeForm->typelem))
+			{
+				retval = arrowTypeIsConvertible(typeForm->typelem, typemod);
+			}
+			else if (typeForm->typtype == TYPTYPE_COMPOSITE)
+			{
+				Relation	rel;
+				TupleDesc	tupdesc;
+				int			j;
+
+				rel = relation_open(typeForm->typrelid, AccessShareLock);
+				tupdesc = RelationGetDescr(rel);
+				for (j=0; j < tupdesc->natts; j++)
+				{
+					Form_pg_attribute	attr = tupleDescAttr(tupdesc, j);
+
+					if (!arrowTypeIsConvertible(attr->atttypid,
+												attr->atttypmod))
+						break;
+				}
+				if (j >= tupdesc->natts)
+					retval = true;
+				relation_close(rel, AccessShareLock);
+			}
+			ReleaseSysCache(tup);
+	}
+	return retval;
+}
+
+/*
+ * arrowFieldLength
+ */
+static size_t
+arrowFieldLength(ArrowField *field, int64 nitems)
+{
+	ArrowType  *type = &field->type;
+	size_t		length = 0;
+
+	switch (type->node.tag)
+	{
+		case ArrowNodeTag__Int:
+			switch (type->Int.bitWidth)
+			{
+				case sizeof(cl_short) * BITS_PER_BYTE:
+					length = sizeof(cl_short) * nitems;
+					break;
+				case sizeof(cl_int) * BITS_PER_BYTE:
+					length = sizeof(cl_int) * nitems;
+					break;
+				case sizeof(cl_long) * BITS_PER_BYTE:
+					length = sizeof(cl_long) * nitems;
+					break;
+				default:
+					elog(ERROR, "Not a supported Int width: %d",
+						 type->Int.bitWidth);
+			}
+			break;
+		case ArrowNodeTag__FloatingPoint:
+			switch (type->FloatingPoint.precision)
+			{
+				case ArrowPrecision__Half:
+					length = sizeof(cl_short) * nitems;
+					break;
+				case ArrowPrecision__Single:
+					length = sizeof(cl_float) * nitems;
+					break;
+				case ArrowPrecision__Double:
+					length = sizeof(cl_double) * nitems;
+					break;
+				default:
+					elog(ERROR, "Not a supported FloatingPoint precision");
+			}
+			break;
+		case ArrowNodeTag__Utf8:
+		case ArrowNodeTag__Binary:
+		case ArrowNodeTag__List:
+			length = sizeof(cl_uint) * (nitems + 1);
+			break;
+		case ArrowNodeTag__Bool:
+			length = BITMAPLEN(nitems);
+			break;
+		case ArrowNodeTag__Decimal:
+			length = sizeof(int128) * nitems;
+			break;
+		case ArrowNodeTag__Date:
+			switch (type->Date.unit)
+			{
+				case ArrowDateUnit__Day:
+					length = sizeof(cl_int) * nitems;
+					break;
+				case ArrowDateUnit__MilliSecond:
+					length = sizeof(cl_long) * nitems;
+					break;
+				default:
+					elog(ERROR, "Not a supported Date unit");
+			}
+			break;
+		case ArrowNodeTag__Time:
+			switch (type->Time.unit)
+			{
+				case ArrowTimeUnit__Second:
+				case ArrowTimeUnit__MilliSecond:
+					length = sizeof(cl_int) * nitems;
+					break;
+				case ArrowTimeUnit__MicroSecond:
+				case ArrowTimeUnit__NanoSecond:
+					length = sizeof(cl_long) * nitems;
+					break;
+				default:
+					elog(ERROR, "Not a supported Time unit");
+			}
+			break;
+		case ArrowNodeTag__Timestamp:
+			length = sizeof(cl_long) * nitems;
+			break;
+		case ArrowNodeTag__Interval:
+			switch (type->Interval.unit)
+			{
+				case ArrowIntervalUnit__Year_Month:
+					length = sizeof(cl_uint) * nitems;
+					break;
+				case ArrowIntervalUnit__Day_Time:
+					length = sizeof(cl_long) * nitems;
+					break;
+				default:
+					elog(ERROR, "Not a supported Interval unit");
+			}
+			break;
+		case ArrowNodeTag__Struct:	//to be supported later
+			length = 0;		/* only nullmap */
+			break;
+		case ArrowNodeTag__FixedSizeBinary:
+			length = (size_t)type->FixedSizeBinary.byteWidth * nitems;
+			break;
+		default:
+			elog(ERROR, "Arrow Type '%s' is not supported now",
+				 type->node.tagName);
+			break;
+	}
+	return length;
+}
+
+/*
+ * arrowSchemaCompatibilityCheck
+ */
+static bool
+__arrowSchemaCompatibilityCheck(TupleDesc tupdesc, int natts,
+								RecordBatchFieldState *rb_fstate)
+{
+	int		j;
+
+	for (j=0; j < natts; j++)
+	{
+		RecordBatchFieldState *fstate = &rb_fstate[j];
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+
+		if (!fstate->children)
+		{
+			/* shortcur, it should be a scalar built-in type */
+			Assert(fstate->num_children == 0);
+			if (attr->atttypid != fstate->atttypid)
+				return false;
+		}
+		else
+		{
+			Form_pg_type	typ;
+			HeapTuple		tup;
+			bool			type_is_ok = true;
+
+			tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(attr->atttypid));
+			if (!HeapTupleIsValid(tup))
+				elog(ERROR, "cache lookup failed for type %u", attr->atttypid);
+			typ = (Form_pg_type) GETSTRUCT(tup);
+			if (typ->typlen == -1 && OidIsValid(typ->typelem) &&
+				fstate->num_children == 1)
+			{
+				/* Arrow::List */
+				RecordBatchFieldState *cstate = &fstate->children[0];
+
+				if (attr->atttypid != cstate->atttypid)
+					type_is_ok = false;
+				else
+				{
+					/*
+					 * overwrite typoid / typmod because a same arrow file
+					 * can be reused, and it may be on behalf of different
+					 * user defined data type.
+					 */
+					fstate->atttypid = attr->atttypid;
+					fstate->atttypmod = attr->atttypmod;
+				}
+			}
+			else if (typ->typlen == -1 && OidIsValid(typ->typrelid))
+			{
+				/* Arrow::Struct */
+				TupleDesc	sdesc = lookup_rowtype_tupdesc(attr->atttypid,
+														   attr->atttypmod);
+				if (sdesc->natts == fstate->num_children &&
+					__arrowSchemaCompatibilityCheck(sdesc, sdesc->natts,
+													fstate->children))
+				{
+					/* see comment above */
+					fstate->atttypid = attr->atttypid;
+					fstate->atttypmod = attr->atttypmod;
+				}
+				else
+				{
+					type_is_ok = false;
+				}
+				DecrTupleDescRefCount(sdesc);
+
+			}
+			else
+			{
+				/* unknown */
+				type_is_ok = false;
+			}
+			ReleaseSysCache(tup);
+			if (!type_is_ok)
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool
+arrowSchemaCompatibilityCheck(TupleDesc tupdesc, int part_nkeys,
+							  RecordBatchState *rb_state)
+{
+	/* virtual partition-key columns are at the tail */
+	if (tupdesc->natts != rb_state->ncols + part_nkeys)
+		return false;
+	return __arrowSchemaCompatibilityCheck(tupdesc, rb_state->ncols,
+										   rb_state->columns);
+}
+
+/*
+ * arrowFdwLoadCacheFile
+ *
+ * It loads an arrow file that contains exactly one RecordBatch, built by the
+ * columnar cache builder, onto a PDS of KDS_FORMAT_ARROW. It returns NULL, if
+ * the file is already removed or its schema is not compatible to the relation.
+ */
+pgstrom_data_store *
+arrowFdwLoadCacheFile(const char *pathname,
+					  Relation relation,
+					  Bitmapset *referenced,
+					  GpuContext *gcontext)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	ArrowFileInfo af_info;
+	RecordBatchState *rb_state;
+	pgstrom_data_store *pds = NULL;
+	File		fdesc;
+
+	fdesc = PathNameOpenFile(pathname, O_RDONLY | PG_BINARY);
+	if (fdesc < 0)
+	{
+		if (errno == ENOENT)
+			return NULL;	/* concurrently invalidated */
+		elog(ERROR, "failed on open('%s'): %m", pathname);
+	}
+	PG_TRY();
+	{
+		readArrowFileDesc(FileGetRawDesc(fdesc), &af_info);
+		if (af_info.footer._num_recordBatches == 1)
+		{
+			rb_state = makeRecordBatchState(&af_info,
+											&af_info.footer.recordBatches[0],
+											&af_info.recordBatches[0].body.recordBatch);
+			rb_state->fdesc = fdesc;
+			if (fstat(FileGetRawDesc(fdesc), &rb_state->stat_buf) != 0)
+				elog(ERROR, "failed on fstat('%s'): %m", pathname);
+			if (arrowSchemaCompatibilityCheck(tupdesc, 0, rb_state))
+				pds = __arrowFdwLoadRecordBatch(rb_state,
+												0, -1,
+												relation,
+												referenced,
+												gcontext,
+												CurrentMemoryContext,
+												-1);
+		}
+	}
+	PG_CATCH();
+	{
+		FileClose(fdesc);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	FileClose(fdesc);
+
+	return pds;
+}
+
+/*
+ * pg_XXX_arrow_ref
+ */
+static Datum
+pg_varlena_arrow_ref(kern_data_store *kds,
+					 kern_colmeta *cmeta, size_t index)
+{
+	cl_uint	   *offset = (cl_uint *)
+		((char *)kds + __kds_unpack(cmeta->values_offset));
+	char	   *extra = (char *)kds + __kds_unpack(cmeta->extra_offset);
+	size_t		extra_len = __kds_unpack(cmeta->extra_length);
+	cl_uint		len = offset[index+1] - offset[index];
+	struct varlena *res;
+
+	if (offset[index] > offset[index + 1] || offset[index+1] > extra_len)
+		elog(ERROR, "corrupted arrow file? offset points out of extra buffer");
+
+	res = palloc(VARHDRSZ + len);
+	SET_VARSIZE(res, VARHDRSZ + len);
+	memcpy(VARDATA(res), extra + offset[index], len);
+
+	return PointerGetDatum(res);
+}
+
+static Datum
+pg_bpchar_arrow_ref(kern_data_store *kds,
+					kern_colmeta *cmeta, size_t index)
+{
+	cl_char	   *values = ((char *)kds + __kds_unpack(cmeta->values_offset));
+	cl_int		unitsz = cmeta->atttypmod - VARHDRSZ;
+	struct varlena *res;
+
+	if (unitsz <= 0)
+		elog(ERROR, "CHAR(%d) is not expected", unitsz);
+	res = palloc(VARHDRSZ + unitsz);
+	memcpy((char *)res + VARHDRSZ, values + unitsz * index, unitsz);
+	SET_VARSIZE(res, VARHDRSZ + unitsz);
+
+	return PointerGetDatum(res);
+}
+
+static Datum
+pg_bool_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	char   *bitmap = (char *)kds + __kds_unpack(cmeta->values_offset);
+
+	return BoolGetDatum(att_isnull(index, bitmap));
+}
+
+static Datum
+pg_int2_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	cl_short   *values = (cl_short *)
+		((char *)kds + __kds_unpack(cmeta->values_offset));
+	return values[index];
+}
+
+static Datum
+pg_int4_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	cl_int	   *values = (cl_int *)
+		((char *)kds + __kds_unpack(cmeta->values_offset));
+	return values[index];
+}
+
+static Datum
+pg_int8_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	cl_long	   *values = (cl_long *)
+		((char *)kds + __kds_unpack(cmeta->values_offset));
+	return values[index];
+}
+
+static Datum
+pg_numeric_arrow_ref(kern_data_store *kds,
+					 kern_colmeta *cmeta, size_t index)
+{
+	char	   *result = palloc0(sizeof(struct NumericData));
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	int			dscale = cmeta->attopts.decimal.scale;
+	Int128_t	decimal;
+
+	decimal.ival = ((int128 *)base)[index];
+
+	while (dscale > 0 && decimal.ival % 10 == 0)
+	{
+		decimal.ival /= 10;
+		dscale--;
+	}
+	pg_numeric_to_varlena(result, dscale, decimal);
+
+	return PointerGetDatum(result);
+}
+
+static Datum
+pg_date_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	DateADT		dt;
+
+	switch (cmeta->attopts.date.unit)
+	{
+		case ArrowDateUnit__Day:
+			dt = ((cl_uint *)base)[index];
+			break;
+		case ArrowDateUnit__MilliSecond:
+			dt = ((cl_ulong *)base)[index] / 1000;
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected unit of Date type");
+	}
+	/* convert UNIX epoch to PostgreSQL epoch */
+	dt -= (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE);
+	return DateADTGetDatum(dt);
+}
+
+static Datum
+pg_time_arrow_ref(kern_data_store *kds,
+				  kern_colmeta *cmeta, size_t index)
+{
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	TimeADT		tm;
+
+	switch (cmeta->attopts.time.unit)
+	{
+		case ArrowTimeUnit__Second:
+			tm = ((cl_long)((cl_int *)base)[index]) * 1000000L;
+			break;
+		case ArrowTimeUnit__MilliSecond:
+			tm = ((cl_long)((cl_int *)base)[index]) * 1000L;
+			break;
+		case ArrowTimeUnit__MicroSecond:
+			tm = ((cl_long *)base)[index];
+			break;
+		case ArrowTimeUnit__NanoSecond:
+			tm = ((cl_ulong *)base)[index] / 1000L;
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected unit of Time type");
+	}
+	return TimeADTGetDatum(tm);
+}
+
+static Datum
+pg_timestamp_arrow_ref(kern_data_store *kds,
+					   kern_colmeta *cmeta, size_t index)
+{
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	Timestamp	ts;
+
+	switch (cmeta->attopts.timestamp.unit)
+	{
+		case ArrowTimeUnit__Second:
+			ts = ((cl_ulong *)base)[index] * 1000000UL;
+			break;
+		case ArrowTimeUnit__MilliSecond:
+			ts = ((cl_ulong *)base)[index] * 1000UL;
+			break;
+		case ArrowTimeUnit__MicroSecond:
+			ts = ((cl_ulong *)base)[index];
+			break;
+		case ArrowTimeUnit__NanoSecond:
+			ts = ((cl_ulong *)base)[index] / 1000UL;
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected unit of Timestamp type");
+	}
+	/* convert UNIX epoch to PostgreSQL epoch */
+	ts -= (POSTGRES_EPOCH_JDATE -
+		   UNIX_EPOCH_JDATE) * USECS_PER_DAY;
+	return TimestampGetDatum(ts);
+}
+
+static Datum
+pg_interval_arrow_ref(kern_data_store *kds,
+					  kern_colmeta *cmeta, size_t index)
+{
+	char	   *base = (char *)kds + __kds_unpack(cmeta->values_offset);
+	Interval   *iv = palloc0(sizeof(Interval));
+
+	switch (cmeta->attopts.interval.unit)
+	{
+		case ArrowIntervalUnit__Year_Month:
+			/* 32bit: number of months */
+			iv->month = ((cl_uint *)base)[index];
+			break;
+		case ArrowIntervalUnit__Day_Time:
+			/* 32bit+32bit: number of days and milliseconds */
+			iv->day = (int32)(((cl_uint *)base)[2 * index]);
+			iv->time = (TimeOffset)(((cl_uint *)base)[2 * index + 1]) * 1000;
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected unit of Interval type");
+	}
+	return PointerGetDatum(iv);
+}
+
+static Datum
+pg_array_arrow_ref(kern_data_store *kds,
+				   kern_colmeta *smeta,
+				   cl_uint start, cl_uint end)
+{
+	ArrayType  *res;
+	size_t		sz;
+	cl_uint		i, nitems = end - start;
+	cl_uint	   *offset;
+	bits8	   *nullmap = NULL;
+	char	   *base;
+	size_t		usage;
+
+	/* allocation of the result buffer */
+	if (smeta->nullmap_offset != 0)
+		sz = ARR_OVERHEAD_WITHNULLS(1, nitems);
+	else
+		sz = ARR_OVERHEAD_NONULLS(1);
+
+	if (smeta->attlen > 0)
+	{
+		sz += TYPEALIGN(smeta->attalign,
+						smeta->attlen) * nitems;
+	}
+	else if (smeta->attlen == -1)
+	{
+		if (smeta->values_offset == 0)
+			elog(ERROR, "Bug? corrupted kernel column metadata");
+		offset = (cl_uint *)((char *)kds + __kds_unpack(smeta->values_offset));
+		sz += (MAXALIGN(VARHDRSZ * nitems) +		/* space for varlena */
+			   MAXALIGN(sizeof(cl_uint) * nitems) +	/* space for alignment */
+			   offset[end] - offset[start]);
+	}
+	else
+		elog(ERROR, "Bug? corrupted kernel column metadata");
+
+	res = palloc0(sz);
+	res->ndim = 1;
+	if (smeta->nullmap_offset != 0)
+	{
+		res->dataoffset = ARR_OVERHEAD_WITHNULLS(1, nitems);
+		nullmap = ARR_NULLBITMAP(res);
+	}
+	res->elemtype = smeta->atttypid;
+	ARR_DIMS(res)[0] = nitems;
+	ARR_LBOUND(res)[0] = 1;
+
+	base = ARR_DATA_PTR(res);
+	usage = 0;
+	for (i=0; i < nitems; i++)
+	{
+		Datum	datum;
+		bool	isnull;
+
+		pg_datum_arrow_ref(kds, smeta, start+i, &datum, &isnull);
+		if (isnull)
+		{
+			if (!nullmap)
+				elog(ERROR, "Bug? element item should not be NULL");
+		}
+		else if (smeta->attlen > 0)
+		{
+			if (nullmap)
+				nullmap[i>>3] |= (1<<(i&7));
+			usage = TYPEALIGN(smeta->attalign, usage);
+			memcpy(base + usage, &datum, smeta->attlen);
+			usage += smeta->attlen;
+		}
+		else if (smeta->attlen == -1)
+		{
+			cl_int		vl_len = VARSIZE(datum);
+
+			if (nullmap)
+				nullmap[i>>3] |= (1<<(i&7));
+			usage = TYPEALIGN(smeta->attalign, usage);
+			memcpy(base + usage, DatumGetPointer(datum), vl_len);
+			usage += vl_len;
+
+			pfree(DatumGetPointer(datum));
+		}
+		else
+			elog(ERROR, "Bug? corrupted kernel column metadata");
+	}
+	SET_VARSIZE(res, (base + usage) - (char *)res);
+
+	return PointerGetDatum(res);
+}
+
+/*
+ * pg_datum_arrow_ref
+ */
+static void
+pg_datum_arrow_ref(kern_data_store *kds,
+				   kern_colmeta *cmeta,
+				   size_t index,
+				   Datum *p_datum,
+				   bool *p_isnull)
+{
+	Datum		datum = 0;
+	bool		isnull = true;
+
+	if (cmeta->nullmap_offset != 0)
+	{
+		size_t	nullmap_offset = __kds_unpack(cmeta->nullmap_offset);
+		uint8  *nullmap = (uint8 *)kds + nullmap_offset;
+
+		if (att_isnull(index, nullmap))
+			goto out;
+	}
+
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY)
+	{
+		kern_colmeta   *smeta;
+		cl_uint		   *offset;
+
+		if (cmeta->num_subattrs != 1 ||
+			cmeta->idx_subattrs < kds->ncols ||
+			cmeta->idx_subattrs >= kds->nr_colmeta)
+			elog(ERROR, "Bug? corrupted kernel column metadata");
+		smeta = &kds->colmeta[cmeta->idx_subattrs];
+		if (cmeta->values_offset == 0)
+			goto out;		/* not loaded? always NULL */
+		offset = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
+		datum = pg_array_arrow_ref(kds, smeta,
+								   offset[index],
+								   offset[index+1]);
+		isnull = false;
+	}
+	else if (cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		TupleDesc	tupdesc = lookup_rowtype_tupdesc(cmeta->atttypid, -1);
+		Datum	   *sub_values = alloca(sizeof(Datum) * tupdesc->natts);
+		bool	   *sub_isnull = alloca(sizeof(bool)  * tupdesc->natts);
+		HeapTuple	htup;
+		int			j;
+
+		if (tupdesc->natts != cmeta->num_subattrs)
+			elog(ERROR, "Struct definition is conrrupted?");
+		if (cmeta->idx_subattrs < kds->ncols ||
+			cmeta->idx_subattrs + cmeta->num_subattrs > kds->nr_colmeta)
+			elog(ERROR, "Bug? strange kernel column metadata");
+
+		for (j=0; j < tupdesc->natts; j++)
+		{
+			kern_colmeta *sub_meta = &kds->colmeta[cmeta->idx_subattrs + j];
+
+			pg_datum_arrow_ref(kds, sub_meta, index,
+							   sub_values + j,
+							   sub_isnull + j);
+		}
+		htup = heap_form_tuple(tupdesc, sub_values, sub_isnull);
+
+		ReleaseTupleDesc(tupdesc);
+
+		datum = PointerGetDatum(htup->t_data);
+		isnull = false;
+	}
+	else if (cmeta->values_offset == 0)
+	{
+		/* not loaded, always null */
+		goto out;
+	}
+	else
+	{
+		Assert(cmeta->atttypkind == TYPE_KIND__BASE);
+		index = kern_fetch_dictionary_index_arrow(cmeta, (char *)kds, index);
+		switch (cmeta->atttypid)
+		{
+			case INT2OID:
+			case FLOAT2OID:
+				datum = pg_int2_arrow_ref(kds, cmeta, index);
+				break;
+			case INT4OID:
+			case FLOAT4OID:
+				datum = pg_int4_arrow_ref(kds, cmeta, index);
+				break;
+			case INT8OID:
+			case FLOAT8OID:
+				datum = pg_int8_arrow_ref(kds, cmeta, index);
+				break;
+			case TEXTOID:
+			case BYTEAOID:
+				datum = pg_varlena_arrow_ref(kds, cmeta, index);
+				break;
+			case BPCHAROID:
+				datum = pg_bpchar_arrow_ref(kds, cmeta, index);
+				break;
+			case BOOLOID:
+				datum = pg_bool_arrow_ref(kds, cmeta, index);
+				break;
+			case NUMERICOID:
+				datum = pg_numeric_arrow_ref(kds, cmeta, index);
+				break;
+			case DATEOID:
+				datum = pg_date_arrow_ref(kds, cmeta, index);
+				break;
+			case TIMEOID:
+				datum = pg_time_arrow_ref(kds, cmeta, index);
+				break;
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+				datum = pg_timestamp_arrow_ref(kds, cmeta, index);
+				break;
+			case INTERVALOID:
+				datum = pg_interval_arrow_ref(kds, cmeta, index);
+				break;
+			default:
+				elog(ERROR, "Bug? unexpected datum type: %u",
+					 cmeta->atttypid);
+				break;
+		}
+		isnull = false;
+	}
+out:
+	*p_datum  = datum;
+	*p_isnull = isnull;
+}
+
+/*
+ * KDS_fetch_tuple_arrow
+ */
+bool
+KDS_fetch_tuple_arrow(TupleTableSlot *slot,
+					  kern_data_store *kds,
+					  size_t index)
+{
+	Datum  *values = slot->tts_values;
+	bool   *isnull = slot->tts_isnull;
+	int		j;
+
+	if (index >= kds->nitems)
+		return false;
+	ExecStoreAllNullTuple(slot);
+	for (j=0; j < kds->ncols; j++)
+	{
+		kern_colmeta   *cmeta = &kds->colmeta[j];
+
+		pg_datum_arrow_ref(kds, cmeta,
+						   index,
+						   values + j,
+						   isnull + j);
+	}
+	return true;
+}
+
+/*
+ * __arrowFdwScanDirectory
+ *
+ * It appends files in the directory; if partition keys are supplied, it
+ * walks down the Hive-style sub-directories (key=value) for each key.
+ */
+static List *
+__arrowFdwScanDirectory(List *filesList,
+						const char *dir_path,
+						const char *dir_suffix,
+						List *partKeys, int depth)
+{
+	struct dirent *dentry;
+	DIR	   *dir;
+	char   *temp;
+
+	dir = AllocateDir(dir_path);
+	while ((dentry = ReadDir(dir, dir_path)) != NULL)
+	{
+		if (strcmp(dentry->d_name, ".") == 0 ||
+			strcmp(dentry->d_name, "..") == 0)
+			continue;
+		if (depth < list_length(partKeys))
+		{
+			const char *key = strVal(list_nth(partKeys, depth));
+			int			klen = strlen(key);
+
+			/* only sub-directories named as 'key=value' */
+			if (strncmp(dentry->d_name, key, klen) != 0 ||
+				dentry->d_name[klen] != '=')
+				continue;
+			temp = psprintf("%s/%s", dir_path, dentry->d_name);
+			filesList = __arrowFdwScanDirectory(filesList, temp, dir_suffix,
+												partKeys, depth + 1);
+			continue;
+		}
+		if (dir_suffix)
+		{
+			int		dlen = strlen(dentry->d_name);
+			int		slen = strlen(dir_suffix);
+			int		diff;
+
+			if (dlen < 2 + slen)
+				continue;
+			diff = dlen - slen;
+			if (dentry->d_name[diff-1] != '.' ||
+				strcmp(dentry->d_name + diff, dir_suffix) != 0)
+				continue;
+		}
+		temp = psprintf("%s/%s", dir_path, dentry->d_name);
+		filesList = lappend(filesList, makeString(temp));
+	}
+	FreeDir(dir);
+
+	return filesList;
+}
+
+/*
+ * arrowFdwExtractFilesList
+ */
+static List *
+__arrowFdwExtractFilesList(List *options_list,
+						   int *p_parallel_nworkers,
+						   bool *p_writable)
+{
+	ListCell   *lc;
+	List	   *filesList = NIL;
+	char	   *dir_path = NULL;
+	char	   *dir_suffix = NULL;
+	int			parallel_nworkers = -1;
+	bool		writable = false;	/* default: read-only */
+	List	   *partKeys = arrowFdwExtractPartitionKeys(options_list);
+
+	foreach (lc, options_list)
+	{
+		DefElem	   *defel = lfirst(lc);
+
+		Assert(IsA(defel->arg, String));
+		if (strcmp(defel->defname, "file") == 0)
+		{
+			char   *temp = strVal(defel->arg);
+			filesList = lappend(filesList, makeString(pstrdup(temp)));
+		}
+		else if (strcmp(defel->defname, "files") == 0)
+		{
+			char   *temp = pstrdup(strVal(defel->arg));
+			char   *saveptr;
+			char   *tok, *pos;
+
+			while ((tok = strtok_r(temp, ",", &saveptr)) != NULL)
+			{
+				while (isspace(*tok))
+					tok++;
+				pos = tok + strlen(tok) - 1;
+				while (pos >= tok && isspace(*pos))
+					*pos-- = '\0';
+
+				filesList = lappend(filesList, makeString(pstrdup(tok)));
+
+				temp = NULL;
+			}
+		}
+		else if (strcmp(defel->defname, "dir") == 0)
+		{
+			dir_path = strVal(defel->arg);
+		}
+		else if (strcmp(defel->defname, "suffix") == 0)
+		{
+			dir_suffix = strVal(defel->arg);
+		}
+		else if (strcmp(defel->defname, "parallel_workers") == 0)
+		{
+			if (parallel_nworkers >= 0)
+				elog(ERROR, "'parallel_workers' appeared twice");
+			parallel_nworkers = pg_atoi(strVal(defel->arg), sizeof(int), '\0');
+		}
+		else if (strcmp(defel->defname, "writable") == 0)
+		{
+			writable = defGetBoolean(defel);
+		}
+		else if (strcmp(defel->defname, "partition_by") == 0)
+		{
+			/* see arrowFdwExtractPartitionKeys */
+		}
+		else
+			elog(ERROR, "arrow: unknown option (%s)", defel->defname);
+	}
+	if (dir_suffix && !dir_path)
+		elog(ERROR, "arrow: cannot use 'suffix' option without 'dir'");
+	if (partKeys != NIL && (!dir_path || filesList != NIL))
+		elog(ERROR, "arrow: 'partition_by' option needs 'dir' option, but not 'file' or 'files'");
+
+	if (writable)
+	{
+		if (dir_path)
+			elog(ERROR, "arrow: 'dir_path' and 'writable' options are exclusive");
+		if (list_length(filesList) == 0)
+			elog(ERROR, "arrow: 'writable' needs a backend file specified by 'file' option");
+		if (list_length(filesList) > 1)
+			elog(ERROR, "arrow: 'writable' cannot use multiple backend files");
+	}
+
+	/* remote files on the object storage are read via the local cache */
+	foreach (lc, filesList)
+	{
+		char	   *fname = strVal(lfirst(lc));
+
+		if (strncmp(fname, "s3://", 5) == 0)
+		{
+			if (writable)
+				elog(ERROR, "arrow: 'writable' cannot use the remote file '%s'",
+					 fname);
+			lfirst(lc) = makeString(arrowS3ResolveCacheFile(fname));
+		}
+	}
+	if (dir_path && strncmp(dir_path, "s3://", 5) == 0)
+		elog(ERROR, "arrow: 'dir' option does not support the remote directory '%s'",
+			 dir_path);
+
+	if (dir_path)
+		filesList = __arrowFdwScanDirectory(filesList, dir_path, dir_suffix,
+											partKeys, 0);
+
+	if (filesList == NIL)
+		elog(ERROR, "no files are configured on behalf of the arrow_fdw foreign table");
+	foreach (lc, filesList)
+	{
+		const char *fname = strVal((Value *)lfirst(lc));
+
+		if (!writable)
+		{
+			if (access(fname, R_OK) != 0)
+				elog(ERROR, "unable to read '%s': %m", fname);
+		}
+		else
+		{
+			if (access(fname, R_OK | W_OK) != 0)
+			{
+				if (errno != ENOENT)
+					elog(ERROR, "unable to read/write '%s': %m", fname);
+				else
+				{
+					char   *temp = pstrdup(fname);
+					char   *dname = dirname(temp);
+
+					if (access(dname, R_OK | W_OK | X_OK) != 0)
+						elog(ERROR, "unable to create '%s': %m", fname);
+					pfree(temp);
+				}
+			}
+		}
+	}
+	/* other properties */
+	if (p_parallel_nworkers)
+		*p_parallel_nworkers = parallel_nworkers;
+	if (p_writable)
+		*p_writable = writable;
+
+	return filesList;
+}
+
+static List *
+arrowFdwExtractFilesList(List *options_list)
+{
+	return __arrowFdwExtractFilesList(options_list, NULL, NULL);
+}
+
+/*
+ * arrowFdwExtractPartitionKeys
+ *
+ * It returns the list of partition keys by 'partition_by' option. These keys
+ * are virtual columns at the tail of the foreign table, and their values come
+ * from the Hive-style path segments (key=value) of the files.
+ */
+static List *
+arrowFdwExtractPartitionKeys(List *options_list)
+{
+	List	   *partKeys = NIL;
+	ListCell   *lc;
+
+	foreach (lc, options_list)
+	{
+		DefElem	   *defel = lfirst(lc);
+		char	   *temp, *tok, *saveptr;
+
+		if (strcmp(defel->defname, "partition_by") != 0)
+			continue;
+		if (partKeys != NIL)
+			elog(ERROR, "'partition_by' appeared twice");
+		temp = pstrdup(strVal(defel->arg));
+		for (tok = strtok_r(temp, ",", &saveptr);
+			 tok != NULL;
+			 tok = strtok_r(NULL, ",", &saveptr))
+		{
+			tok = __trim(tok);
+			if (*tok == '\0' || strchr(tok, '=') || strchr(tok, '/'))
+				elog(ERROR, "arrow: invalid partition key '%s'", tok);
+			partKeys = lappend(partKeys, makeString(tok));
+		}
+		if (partKeys == NIL)
+			elog(ERROR, "arrow: 'partition_by' has no partition keys");
+	}
+	return partKeys;
+}
+
+/*
+ * __arrowFdwPartitionValueDecode - decode '%XX' escape of Hive
+ */
+static char *
+__arrowFdwPartitionValueDecode(const char *str, int len)
+{
+	char	   *result = palloc(len + 1);
+	char	   *pos = result;
+	int			i;
+
+	for (i=0; i < len; i++)
+	{
+		if (str[i] == '%' && i + 2 < len &&
+			isxdigit(str[i+1]) && isxdigit(str[i+2]))
+		{
+			char	hex[3] = { str[i+1], str[i+2], '\0' };
+
+			*pos++ = (char)strtol(hex, NULL, 16);
+			i += 2;
+		}
+		else
+			*pos++ = str[i];
+	}
+	*pos = '\0';
+	return result;
+}
+
+/*
+ * arrowFdwPartitionValues - parse the partition-key values from the path
+ */
+static arrowPartitionValues *
+arrowFdwPartitionValues(TupleDesc tupdesc, const char *fname, List *partKeys)
+{
+	int			nkeys = list_length(partKeys);
+	arrowPartitionValues *pv;
+	ListCell   *lc;
+	int			j = 0;
+
+	pv = palloc0(sizeof(arrowPartitionValues));
+	pv->values = palloc0(sizeof(Datum) * nkeys);
+	pv->isnull = palloc0(sizeof(bool) * nkeys);
+	foreach (lc, partKeys)
+	{
+		const char *key = strVal(lfirst(lc));
+		int			klen = strlen(key);
+		int			anum = tupdesc->natts - nkeys + j;
+		Form_pg_attribute attr;
+		const char *seg = NULL;
+		const char *pos;
+		char	   *value;
+		Oid			typinput;
+		Oid			typioparam;
+
+		if (anum < 0)
+			elog(ERROR, "arrow: foreign table has fewer columns than partition keys");
+		attr = tupleDescAttr(tupdesc, anum);
+		if (strcmp(NameStr(attr->attname), key) != 0)
+			elog(ERROR, "arrow: column '%s' must be partition key '%s'",
+				 NameStr(attr->attname), key);
+		/* lookup the last '/key=' segment */
+		for (pos = fname; (pos = strchr(pos, '/')) != NULL; pos++)
+		{
+			if (strncmp(pos + 1, key, klen) == 0 && pos[klen+1] == '=')
+				seg = pos + klen + 2;
+		}
+		if (!seg)
+			elog(ERROR, "arrow: file '%s' has no partition key '%s'",
+				 fname, key);
+		pos = strchr(seg, '/');
+		value = __arrowFdwPartitionValueDecode(seg, pos ? pos - seg : strlen(seg));
+		if (strcmp(value, "__HIVE_DEFAULT_PARTITION__") == 0)
+			pv->isnull[j] = true;
+		else
+		{
+			getTypeInputInfo(attr->atttypid, &typinput, &typioparam);
+			pv->values[j] = OidInputFunctionCall(typinput, value,
+												 typioparam,
+												 attr->atttypmod);
+		}
+		j++;
+	}
+	return pv;
+}
+
+/*
+ * __arrowFdwPartitionValueMatch - evaluate a qualifier on the partition-key
+ * value. It returns false only if the qualifier is obviously false.
+ */
+static bool
+__arrowFdwPartitionValueMatch(Expr *expr, TupleDesc tupdesc, int nkeys,
+							  arrowPartitionValues *pv)
+{
+	List	   *args;
+	Node	   *arg1;
+	Node	   *arg2;
+	Var		   *var;
+	Const	   *con;
+	int			anum;
+
+	if (IsA(expr, OpExpr))
+		args = ((OpExpr *)expr)->args;
+	else if (IsA(expr, ScalarArrayOpExpr))
+		args = ((ScalarArrayOpExpr *)expr)->args;
+	else
+		return true;
+	if (list_length(args) != 2)
+		return true;
+	arg1 = linitial(args);
+	arg2 = lsecond(args);
+	if (IsA(arg1, RelabelType))
+		arg1 = (Node *)((RelabelType *)arg1)->arg;
+	if (IsA(arg2, RelabelType))
+		arg2 = (Node *)((RelabelType *)arg2)->arg;
+	if (IsA(arg1, Var) && IsA(arg2, Const))
+	{
+		var = (Var *)arg1;
+		con = (Const *)arg2;
+	}
+	else if (IsA(arg1, Const) && IsA(arg2, Var) && IsA(expr, OpExpr))
+	{
+		var = (Var *)arg2;
+		con = (Const *)arg1;
+	}
+	else
+		return true;
+	anum = var->varattno - (tupdesc->natts - nkeys) - 1;
+	if (var->varlevelsup != 0 || anum < 0 || anum >= nkeys)
+		return true;
+
+	if (IsA(expr, OpExpr))
+	{
+		OpExpr	   *op = (OpExpr *)expr;
+		Datum		value = pv->values[anum];
+
+		set_opfuncid(op);
+		if (!func_strict(op->opfuncid))
+			return true;
+		if (pv->isnull[anum] || con->constisnull)
+			return false;
+		if ((Node *)var == arg1)
+			return DatumGetBool(OidFunctionCall2Coll(op->opfuncid,
+													 op->inputcollid,
+													 value,
+													 con->constvalue));
+		return DatumGetBool(OidFunctionCall2Coll(op->opfuncid,
+												 op->inputcollid,
+												 con->constvalue,
+												 value));
+	}
+	else
+	{
+		ScalarArrayOpExpr *sa_op = (ScalarArrayOpExpr *)expr;
+		ArrayType  *arr;
+		Datum	   *elem_values;
+		bool	   *elem_isnull;
+		int			i, nelems;
+		int16		typlen;
+		bool		typbyval;
+		char		typalign;
+
+		set_sa_opfuncid(sa_op);
+		if (!func_strict(sa_op->opfuncid))
+			return true;
+		if (pv->isnull[anum] || con->constisnull)
+			return false;
+		arr = DatumGetArrayTypeP(con->constvalue);
+		get_typlenbyvalalign(ARR_ELEMTYPE(arr), &typlen, &typbyval, &typalign);
+		deconstruct_array(arr, ARR_ELEMTYPE(arr),
+						  typlen, typbyval, typalign,
+						  &elem_values, &elem_isnull, &nelems);
+		for (i=0; i < nelems; i++)
+		{
+			bool	rv = (!elem_isnull[i] &&
+						  DatumGetBool(OidFunctionCall2Coll(sa_op->opfuncid,
+															sa_op->inputcollid,
+															pv->values[anum],
+															elem_values[i])));
+			if (sa_op->useOr && rv)
+				return true;
+			if (!sa_op->useOr && !rv)
+				return false;
+		}
+		return !sa_op->useOr;
+	}
+}
+
+/*
+ * arrowFdwPrunePartitionFiles
+ *
+ * It removes files whose partition-key values obviously conflict with the
+ * qualifiers, prior to the metadata and I/O cost.
+ */
+static List *
+arrowFdwPrunePartitionFiles(TupleDesc tupdesc,
+							List *filesList,
+							List *partKeys,
+							List *quals,
+							List **p_partvals)
+{
+	List	   *results = NIL;
+	List	   *partvals = NIL;
+	int			nkeys = list_length(partKeys);
+	ListCell   *lc, *cell;
+
+	if (tupdesc->natts <= nkeys)
+		elog(ERROR, "arrow: foreign table has fewer columns than partition keys");
+	foreach (lc, filesList)
+	{
+		const char *fname = strVal(lfirst(lc));
+		arrowPartitionValues *pv;
+
+		pv = arrowFdwPartitionValues(tupdesc, fname, partKeys);
+		foreach (cell, quals)
+		{
+			if (!__arrowFdwPartitionValueMatch(lfirst(cell), tupdesc, nkeys, pv))
+				break;
+		}
+		if (cell != NULL)
+		{
+			pfree(pv->values);
+			pfree(pv->isnull);
+			pfree(pv);
+			continue;
+		}
+		results = lappend(results, lfirst(lc));
+		partvals = lappend(partvals, pv);
+	}
+	if (p_partvals)
+		*p_partvals = partvals;
+	return results;
+}
+
+
+/*
+ * validator of Arrow_Fdw
+ */
+Datum
+pgstrom_arrow_fdw_validator(PG_FUNCTION_ARGS)
+{
+	List	   *options_list = untransformRelOptions(PG_GETARG_DATUM(0));
+	Oid			catalog = PG_GETARG_OID(1);
+
+	if (catalog == ForeignTableRelationId)
+	{
+		List	   *filesList;
+		ListCell   *lc;
+
+		filesList = arrowFdwExtractFilesList(options_list);
+		foreach (lc, filesList)
+		{
+			ArrowFileInfo	af_info;
+			ParquetFileInfo	pq_info;
+			const char	   *fname = strVal(lfirst(lc));
+
+			if (!readParquetFile(fname, &pq_info, true))
+				readArrowFile(fname, &af_info, true);
+		}
+	}
+	else if (options_list != NIL)
+	{
+		const char	   *label;
+		char			temp[80];
+
+		switch (catalog)
+		{
+			case ForeignDataWrapperRelationId:
+				label = "FOREIGN DATA WRAPPER";
+				break;
+			case ForeignServerRelationId:
+				label = "SERVER";
+				break;
+			case UserMappingRelationId:
+				label = "USER MAPPING";
+				break;
+			case AttributeRelationId:
+				label = "attribute of FOREIGN TABLE";
+				break;
+			default:
+				snprintf(temp, sizeof(temp),
+						 "[unexpected object catalog=%u]", catalog);
+				label = temp;
+				break;
+		}
+		elog(ERROR, "Arrow_Fdw does not support any options for %s", label);
+	}
+	PG_RETURN_VOID();
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_validator);
+
+/*
+ * pgstrom_arrow_fdw_precheck_schema
+ */
+static void
+arrow_fdw_precheck_schema(Relation rel)
+{
+	TupleDesc		tupdesc = RelationGetDescr(rel);
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(rel));
+	List		   *filesList;
+	List		   *partKeys;
+	ListCell	   *lc;
+	bool			writable;
+	int				j;
+
+	/* virtual partition-key columns must be at the tail */
+	partKeys = arrowFdwExtractPartitionKeys(ft->options);
+	j = tupdesc->natts - list_length(partKeys);
+	foreach (lc, partKeys)
+	{
+		Form_pg_attribute	attr;
+
+		if (j < 0)
+			elog(ERROR, "foreign table '%s' has fewer columns than partition keys",
+				 RelationGetRelationName(rel));
+		attr = tupleDescAttr(tupdesc, j++);
+		if (strcmp(NameStr(attr->attname), strVal(lfirst(lc))) != 0)
+			elog(ERROR, "column %s of foreign table %s must be partition key '%s'",
+				 NameStr(attr->attname),
+				 RelationGetRelationName(rel),
+				 strVal(lfirst(lc)));
+	}
+
+	/* check schema definition is supported by Apache Arrow */
+	for (j=0; j < tupdesc->natts - list_length(partKeys); j++)
+	{
+		Form_pg_attribute	attr = tupleDescAttr(tupdesc, j);
+
+		if (!arrowTypeIsConvertible(attr->atttypid,
+									attr->atttypmod))
+			elog(ERROR, "column %s of foreign table %s has %s type that is not convertible any supported Apache Arrow types",
+				 NameStr(attr->attname),
+				 RelationGetRelationName(rel),
+				 format_type_be(attr->atttypid));
+	}
+
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	foreach (lc, filesList)
+	{
+		const char *fname = strVal(lfirst(lc));
+		File		filp;
+		List	   *rb_cached = NIL;
+		ListCell   *cell;
+
+		filp = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
+		if (filp < 0)
+		{
+			if (writable && errno == ENOENT)
+				continue;
+			elog(ERROR, "failed to open '%s' on behalf of '%s': %m",
+				 fname, RelationGetRelationName(rel));
+		}
+		/* check schema compatibility */
+		rb_cached = arrowLookupOrBuildMetadataCache(filp);
+		foreach (cell, rb_cached)
+		{
+			RecordBatchState *rb_state = lfirst(cell);
+
+			if (!arrowSchemaCompatibilityCheck(tupdesc, list_length(partKeys),
+											   rb_state))
+				elog(ERROR, "arrow file '%s' on behalf of the foreign table '%s' has incompatible schema definition",
+					 fname, RelationGetRelationName(rel));
+		}
+		list_free(rb_cached);
+	}
+}
+
+Datum
+pgstrom_arrow_fdw_precheck_schema(PG_FUNCTION_ARGS)
+{
+	EventTriggerData   *trigdata;
+	
+	if (!CALLED_AS_EVENT_TRIGGER(fcinfo))
+		elog(ERROR, "%s: must be called as EventTrigger",
+			 __FUNCTION__);
+	trigdata = (EventTriggerData *) fcinfo->context;
+	if (strcmp(trigdata->event, "ddl_command_end") != 0)
+		elog(ERROR, "%s: must be called on ddl_command_end event",
+			 __FUNCTION__);
+	if (strcmp(trigdata->tag, "CREATE FOREIGN TABLE") == 0)
+	{
+		CreateStmt	   *stmt = (CreateStmt *)trigdata->parsetree;
+		Relation		rel;
+
+		rel = relation_openrv_extended(stmt->relation, AccessShareLock, true);
+		if (!rel)
+			PG_RETURN_NULL();
+		if (rel->rd_rel->relkind == RELKIND_FOREIGN_TABLE &&
+			GetFdwRoutineForRelation(rel, false) == &pgstrom_arrow_fdw_routine)
+		{
+			arrow_fdw_precheck_schema(rel);
+		}
+		relation_close(rel, AccessShareLock);
+	}
+	else if (strcmp(trigdata->tag, "ALTER FOREIGN TABLE") == 0 &&
+			 IsA(trigdata->parsetree, AlterTableStmt))
+	{
+		AlterTableStmt *stmt = (AlterTableStmt *)trigdata->parsetree;
+		Relation		rel;
+		ListCell	   *lc;
+		bool			has_schema_change = false;
+
+		rel = relation_openrv_extended(stmt->relation, AccessShareLock, true);
+		if (!rel)
+			PG_RETURN_NULL();
+		if (rel->rd_rel->relkind == RELKIND_FOREIGN_TABLE &&
+			GetFdwRoutineForRelation(rel, false) == &pgstrom_arrow_fdw_routine)
+		{
+			foreach (lc, stmt->cmds)
+			{
+				AlterTableCmd  *cmd = lfirst(lc);
+
+				if (cmd->subtype == AT_AddColumn ||
+					cmd->subtype == AT_DropColumn ||
+					cmd->subtype == AT_AlterColumnType)
+				{
+					has_schema_change = true;
+					break;
+				}
+			}
+			if (has_schema_change)
+				arrow_fdw_precheck_schema(rel);
+		}
+		relation_close(rel, AccessShareLock);
+	}
+	PG_RETURN_NULL();
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_precheck_schema);
+
+/*
+ * arrowInvalidateMetadataCache
+ *
+ * NOTE: caller must have lock_slots[] with EXCLUSIVE mode
+ */
+static uint64
+arrowInvalidateMetadataCache(arrowMetadataCache *mcache, bool detach_lru)
+{
+	arrowMetadataCache *mtemp;
+	dlist_node	   *dnode;
+	uint64			released = 0;
+
+	while (!dlist_is_empty(&mcache->siblings))
+	{
+		dnode = dlist_pop_head_node(&mcache->siblings);
+		mtemp = dlist_container(arrowMetadataCache, chain, dnode);
+		Assert(dlist_is_empty(&mtemp->siblings) &&
+			   !mtemp->lru_chain.prev && !mtemp->lru_chain.next);
+		dlist_delete(&mtemp->chain);
+		released += MAXALIGN(offsetof(arrowMetadataCache,
+									  fstate[mtemp->nfields]));
+		pfree(mtemp);
+	}
+	released += MAXALIGN(offsetof(arrowMetadataCache,
+								  fstate[mcache->nfields]));
+	if (detach_lru)
+	{
+		SpinLockAcquire(&arrow_metadata_state->lru_lock);
+		dlist_delete(&mcache->lru_chain);
+		SpinLockRelease(&arrow_metadata_state->lru_lock);
+	}
+	dlist_delete(&mcache->chain);
+	pfree(mcache);
+
+	return pg_atomic_sub_fetch_u64(&arrow_metadata_state->consumed,
+								   released);
+}
+
+/*
+ * copyMetadataFieldCache - copy for nested structure
+ */
+static int
+copyMetadataFieldCache(RecordBatchFieldState *dest_curr,
+					   RecordBatchFieldState *dest_tail,
+					   int nattrs,
+					   RecordBatchFieldState *columns)
+{
+	RecordBatchFieldState *dest_next = dest_curr + nattrs;
+	int		j, k, nslots = nattrs;
+
+	if (dest_next > dest_tail)
+		return -1;
+
+	for (j=0; j < nattrs; j++)
+	{
+		dest_curr[j] = columns[j];
+		if (dest_curr[j].num_children == 0)
+			Assert(dest_curr[j].children == NULL);
+		else
+		{
+			dest_curr[j].children = dest_next;
+			k = copyMetadataFieldCache(dest_next,
+									   dest_tail,
+									   columns[j].num_children,
+									   columns[j].children);
+			if (k < 0)
+				return -1;
+			dest_next += k;
+			nslots += k;
+		}
+	}
+	return nslots;
+}
+
+/*
+ * makeRecordBatchStateFromCache
+ *   - setup RecordBatchState from arrowMetadataCache
+ */
+static RecordBatchState *
+makeRecordBatchStateFromCache(arrowMetadataCache *mcache, File fdesc)
+{
+	RecordBatchState   *rbstate;
+
+	rbstate = palloc0(offsetof(RecordBatchState,
+							   columns[mcache->nfields]));
+	rbstate->fdesc = fdesc;
+	memcpy(&rbstate->stat_buf, &mcache->stat_buf, sizeof(struct stat));
+	rbstate->rb_index  = mcache->rb_index;
+	rbstate->rb_offset = mcache->rb_offset;
+	rbstate->rb_length = mcache->rb_length;
+	rbstate->rb_nitems = mcache->rb_nitems;
+	rbstate->rb_codec  = mcache->rb_codec;
+	rbstate->rb_parquet = mcache->rb_parquet;
+	rbstate->ncols = mcache->ncols;
+	copyMetadataFieldCache(rbstate->columns,
+						   rbstate->columns + mcache->nfields,
+						   mcache->ncols,
+						   mcache->fstate);
+	return rbstate;
+}
+
+/*
+ * arrowReclaimMetadataCache
+ */
+static void
+arrowReclaimMetadataCache(void)
+{
+	arrowMetadataCache *mcache;
+	LWLock	   *lock = NULL;
+	dlist_node *dnode;
+	uint32		lru_hash;
+	uint32		lru_index;
+	uint64		consumed;
+
+	consumed = pg_atomic_read_u64(&arrow_metadata_state->consumed);
+	if (consumed <= arrow_metadata_cache_size)
+		return;
+
+	SpinLockAcquire(&arrow_metadata_state->lru_lock);
+	if (dlist_is_empty(&arrow_metadata_state->lru_list))
+	{
+		SpinLockRelease(&arrow_metadata_state->lru_lock);
+		return;
+	}
+	dnode = dlist_tail_node(&arrow_metadata_state->lru_list);
+	mcache = dlist_container(arrowMetadataCache, lru_chain, dnode);
+	lru_hash = mcache->hash;
+	SpinLockRelease(&arrow_metadata_state->lru_lock);
+
+	do {
+		lru_index = lru_hash % ARROW_METADATA_HASH_NSLOTS;
+		lock = &arrow_metadata_state->lock_slots[lru_index];
+
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		SpinLockAcquire(&arrow_metadata_state->lru_lock);
+		if (dlist_is_empty(&arrow_metadata_state->lru_list))
+		{
+			SpinLockRelease(&arrow_metadata_state->lru_lock);
+			LWLockRelease(lock);
+			break;
+		}
+		dnode = dlist_tail_node(&arrow_metadata_state->lru_list);
+		mcache = dlist_container(arrowMetadataCache, lru_chain, dnode);
+		if (mcache->hash == lru_hash)
+		{
+			dlist_delete(&mcache->lru_chain);
+			memset(&mcache->lru_chain, 0, sizeof(dlist_node));
+			SpinLockRelease(&arrow_metadata_state->lru_lock);
+			consumed = arrowInvalidateMetadataCache(mcache, false);
+		}
+		else
+		{
+			/* LRU-tail was referenced by someone, try again */
+			lru_hash = mcache->hash;
+            SpinLockRelease(&arrow_metadata_state->lru_lock);
+		}
+		LWLockRelease(lock);
+	} while (consumed > arrow_metadata_cache_size);
+}
+
+/*
+ * __arrowBuildMetadataCache
+ *
+ * NOTE: caller must have exclusive lock on arrow_metadata_state->lock_slots[]
+ */
+static arrowMetadataCache *
+__arrowBuildMetadataCache(List *rb_state_list, uint32 hash)
+{
+	arrowMetadataCache *mcache = NULL;
+	arrowMetadataCache *mtemp;
+	dlist_node *dnode;
+	Size		sz, consumed = 0;
+	int			nfields;
+	ListCell   *lc;
+
+	foreach (lc, rb_state_list)
+	{
+		RecordBatchState *rbstate = lfirst(lc);
+
+		if (!mcache)
+			nfields = RecordBatchFieldCount(rbstate);
+		else
+			Assert(nfields == RecordBatchFieldCount(rbstate));
+
+		sz = offsetof(arrowMetadataCache, fstate[nfields]);
+		mtemp = MemoryContextAllocZero(TopSharedMemoryContext, sz);
+		if (!mtemp)
+		{
+			/* !!out of memory!! */
+			if (mcache)
+			{
+				while (!dlist_is_empty(&mcache->siblings))
+				{
+					dnode = dlist_pop_head_node(&mcache->siblings);
+					mtemp = dlist_container(arrowMetadataCache,
+											chain, dnode);
+					pfree(mtemp);
+				}
+				pfree(mcache);
+			}
+			return NULL;
+		}
+
+		dlist_init(&mtemp->siblings);
+		memcpy(&mtemp->stat_buf, &rbstate->stat_buf, sizeof(struct stat));
+		mtemp->hash      = hash;
+		mtemp->rb_index  = rbstate->rb_index;
+        mtemp->rb_offset = rbstate->rb_offset;
+        mtemp->rb_length = rbstate->rb_length;
+        mtemp->rb_nitems = rbstate->rb_nitems;
+		mtemp->rb_codec  = rbstate->rb_codec;
+		mtemp->rb_parquet = rbstate->rb_parquet;
+        mtemp->ncols     = rbstate->ncols;
+		mtemp->nfields   =
+			copyMetadataFieldCache(mtemp->fstate,
+								   mtemp->fstate + nfields,
+								   rbstate->ncols,
+								   rbstate->columns);
+		Assert(mtemp->nfields == nfields);
+
+		if (!mcache)
+			mcache = mtemp;
+		else
+			dlist_push_tail(&mcache->siblings, &mtemp->chain);
+		consumed += MAXALIGN(sz);
+	}
+	pg_atomic_add_fetch_u64(&arrow_metadata_state->consumed, consumed);
+
+	return mcache;
+}
+
+
+/*
+ * checkArrowRecordBatchIsVisible
+ *
+ * NOTE: It must be called under shared lock on lock_slots[]
+ */
+static bool
+checkArrowRecordBatchIsVisible(RecordBatchState *rbstate,
+							   dlist_head *mvcc_slot)
+{
+	dlist_iter		iter;
+
+	dlist_foreach(iter, mvcc_slot)
+	{
+		arrowWriteMVCCLog  *mvcc = dlist_container(arrowWriteMVCCLog,
+												   chain, iter.cur);
+		if (mvcc->key.st_dev == rbstate->stat_buf.st_dev &&
+			mvcc->key.st_ino == rbstate->stat_buf.st_ino &&
+			mvcc->record_batch == rbstate->rb_index)
+		{
+			if (TransactionIdIsCurrentTransactionId(mvcc->xid))
+				return true;
+			else
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Routines for on-disk metadata catalog
+ *
+ * Once Arrow_Fdw parsed the footer and RecordBatch messages of an arrow
+ * file, it saves the result on the 'arrow_fdw.metadata_cache_dir', keyed
+ * by the device and inode number, and validated by the file size, mtime
+ * and ctime. It allows to skip re-reading the arrow files after restart
+ * of the server, or after eviction from the shared metadata cache.
+ *
+ * Each entry has the same layout as arrowMetadataCache, except for the
+ * children pointers that are saved as an index of the fstate[] array.
+ */
+#define ARROW_METADATA_FILE_MAGIC		0x41524d43		/* 'ARMC' */
+
+typedef struct
+{
+	uint32		magic;
+	uint32		nitems;		/* number of RecordBatches */
+	pg_crc32	crc;		/* checksum of the data[] */
+	uint32		fstate_sz;	/* sizeof(RecordBatchFieldState) */
+	off_t		st_size;
+	struct timespec st_mtim;
+	struct timespec st_ctim;
+	size_t		length;		/* length of the data[] */
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} arrowMetadataFileHead;
+
+static void
+arrowMetadataFileName(char *fname, struct stat *stat_buf)
+{
+	snprintf(fname, MAXPGPATH, "%s/%lu-%lu.meta",
+			 arrow_metadata_cache_dir,
+			 (unsigned long)stat_buf->st_dev,
+			 (unsigned long)stat_buf->st_ino);
+}
+
+static bool
+arrowLoadMetadataFile(File fdesc, struct stat *stat_buf,
+					  List **p_rb_state_list)
+{
+	arrowMetadataFileHead *fhead = NULL;
+	struct stat	fstat_buf;
+	char		fname[MAXPGPATH];
+	char	   *pos, *end;
+	pg_crc32	crc;
+	ssize_t		nbytes;
+	uint32		count;
+	int			fdesc_meta;
+	List	   *rb_state_list = NIL;
+
+	if (!arrow_metadata_cache_dir)
+		return false;
+	arrowMetadataFileName(fname, stat_buf);
+	fdesc_meta = open(fname, O_RDONLY | PG_BINARY);
+	if (fdesc_meta < 0)
+		return false;
+	if (fstat(fdesc_meta, &fstat_buf) != 0 ||
+		fstat_buf.st_size < offsetof(arrowMetadataFileHead, data))
+		goto bailout;
+	fhead = palloc(fstat_buf.st_size);
+	nbytes = __readFileSignal(fdesc_meta, fhead, fstat_buf.st_size, false);
+	if (nbytes != fstat_buf.st_size ||
+		fhead->magic != ARROW_METADATA_FILE_MAGIC ||
+		fhead->fstate_sz != sizeof(RecordBatchFieldState) ||
+		offsetof(arrowMetadataFileHead, data) +
+		fhead->length != fstat_buf.st_size)
+		goto bailout;
+	/* ensure the catalog entry is built from the current arrow file */
+	if (fhead->st_size != stat_buf->st_size ||
+		timespec_comp(&fhead->st_mtim, &stat_buf->st_mtim) != 0 ||
+		timespec_comp(&fhead->st_ctim, &stat_buf->st_ctim) != 0)
+	{
+		elog(DEBUG2, "arrow_fdw: metadata catalog '%s' is older than '%s'",
+			 fname, FilePathName(fdesc));
+		goto bailout;
+	}
+	INIT_LEGACY_CRC32(crc);
+	COMP_LEGACY_CRC32(crc, fhead->data, fhead->length);
+	FIN_LEGACY_CRC32(crc);
+	if (crc != fhead->crc)
+		goto bailout;
+
+	pos = fhead->data;
+	end = fhead->data + fhead->length;
+	for (count=0; count < fhead->nitems; count++)
+	{
+		arrowMetadataCache *mtemp = (arrowMetadataCache *)pos;
+		size_t		sz;
+		int			k;
+
+		if (pos + offsetof(arrowMetadataCache, fstate) > end)
+			goto bailout;
+		sz = MAXALIGN(offsetof(arrowMetadataCache,
+							   fstate[mtemp->nfields]));
+		if (mtemp->ncols < 0 ||
+			mtemp->nfields < mtemp->ncols || pos + sz > end)
+			goto bailout;
+		/* restore the children pointers */
+		for (k=0; k < mtemp->nfields; k++)
+		{
+			RecordBatchFieldState *fstate = &mtemp->fstate[k];
+			uintptr_t	index = (uintptr_t)fstate->children;
+
+			if (fstate->num_children == 0)
+				fstate->children = NULL;
+			else if (index <= k ||
+					 index + fstate->num_children > mtemp->nfields)
+				goto bailout;
+			else
+				fstate->children = mtemp->fstate + index;
+		}
+		memcpy(&mtemp->stat_buf, stat_buf, sizeof(struct stat));
+		rb_state_list = lappend(rb_state_list,
+								makeRecordBatchStateFromCache(mtemp, fdesc));
+		pos += sz;
+	}
+	if (pos != end)
+		goto bailout;
+	close(fdesc_meta);
+	pfree(fhead);
+
+	elog(DEBUG2, "arrow_fdw: metadata of '%s' was loaded from '%s'",
+		 FilePathName(fdesc), fname);
+	*p_rb_state_list = rb_state_list;
+	return true;
+
+bailout:
+	close(fdesc_meta);
+	if (fhead)
+		pfree(fhead);
+	list_free_deep(rb_state_list);
+	return false;
+}
+
+static void
+arrowSaveMetadataFile(File fdesc, struct stat *stat_buf,
+					  List *rb_state_list)
+{
+	arrowMetadataFileHead fhead;
+	StringInfoData buf;
+	char		fname[MAXPGPATH];
+	char		tname[MAXPGPATH];
+	int			fdesc_meta;
+	ListCell   *lc;
+
+	if (!arrow_metadata_cache_dir)
+		return;
+	initStringInfo(&buf);
+	foreach (lc, rb_state_list)
+	{
+		RecordBatchState *rbstate = lfirst(lc);
+		arrowMetadataCache *mtemp;
+		int			nfields = RecordBatchFieldCount(rbstate);
+		size_t		sz = MAXALIGN(offsetof(arrowMetadataCache,
+										   fstate[nfields]));
+		int			k;
+
+		enlargeStringInfo(&buf, sz);
+		mtemp = (arrowMetadataCache *)(buf.data + buf.len);
+		memset(mtemp, 0, sz);
+		mtemp->rb_index  = rbstate->rb_index;
+		mtemp->rb_offset = rbstate->rb_offset;
+		mtemp->rb_length = rbstate->rb_length;
+		mtemp->rb_nitems = rbstate->rb_nitems;
+		mtemp->rb_codec  = rbstate->rb_codec;
+		mtemp->rb_parquet = rbstate->rb_parquet;
+		mtemp->ncols     = rbstate->ncols;
+		mtemp->nfields   =
+			copyMetadataFieldCache(mtemp->fstate,
+								   mtemp->fstate + nfields,
+								   rbstate->ncols,
+								   rbstate->columns);
+		Assert(mtemp->nfields == nfields);
+		for (k=0; k < nfields; k++)
+		{
+			RecordBatchFieldState *fstate = &mtemp->fstate[k];
+
+			/*
+			 * OID of the user defined types (incl. composite types for
+			 * Struct) may not be stable; e.g, DROP and CREATE EXTENSION.
+			 * So, we don't save the metadata of this kind of files.
+			 */
+			if (fstate->atttypid >= FirstNormalObjectId)
+			{
+				pfree(buf.data);
+				return;
+			}
+			if (fstate->children)
+				fstate->children = (RecordBatchFieldState *)
+					(uintptr_t)(fstate->children - mtemp->fstate);
+		}
+		buf.len += sz;
+	}
+
+	memset(&fhead, 0, offsetof(arrowMetadataFileHead, data));
+	fhead.magic   = ARROW_METADATA_FILE_MAGIC;
+	fhead.nitems  = list_length(rb_state_list);
+	fhead.fstate_sz = sizeof(RecordBatchFieldState);
+	fhead.st_size = stat_buf->st_size;
+	fhead.st_mtim = stat_buf->st_mtim;
+	fhead.st_ctim = stat_buf->st_ctim;
+	fhead.length  = buf.len;
+	INIT_LEGACY_CRC32(fhead.crc);
+	COMP_LEGACY_CRC32(fhead.crc, buf.data, buf.len);
+	FIN_LEGACY_CRC32(fhead.crc);
+
+	arrowMetadataFileName(fname, stat_buf);
+	snprintf(tname, sizeof(tname), "%s.%d.tmp", fname, MyProcPid);
+	fdesc_meta = open(tname, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY, 0600);
+	if (fdesc_meta < 0 && errno == ENOENT)
+	{
+		if (mkdir(arrow_metadata_cache_dir, S_IRWXU) != 0 && errno != EEXIST)
+			elog(LOG, "failed on mkdir('%s'): %m", arrow_metadata_cache_dir);
+		fdesc_meta = open(tname, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY, 0600);
+	}
+	if (fdesc_meta < 0)
+	{
+		elog(LOG, "failed on open('%s'): %m", tname);
+		pfree(buf.data);
+		return;
+	}
+	if (__writeFileSignal(fdesc_meta, &fhead,
+						  offsetof(arrowMetadataFileHead, data),
+						  false) != offsetof(arrowMetadataFileHead, data) ||
+		__writeFileSignal(fdesc_meta, buf.data, buf.len,
+						  false) != buf.len)
+	{
+		elog(LOG, "failed on write('%s'): %m", tname);
+		close(fdesc_meta);
+		unlink(tname);
+		pfree(buf.data);
+		return;
+	}
+	close(fdesc_meta);
+	pfree(buf.data);
+	/* rename(2) is atomic, so concurrent readers never see broken file */
+	if (rename(tname, fname) != 0)
+	{
+		elog(LOG, "failed on rename('%s','%s'): %m", tname, fname);
+		unlink(tname);
+	}
+	elog(DEBUG2, "arrow_fdw: metadata of '%s' was saved to '%s'",
+		 FilePathName(fdesc), fname);
+}
+
+/*
+ * arrowPrefetchMetadataCache
+ *
+ * readArrowFileDesc() reads the footer of arrow files by synchronous page
+ * faults, one by one. It is a significant bottleneck on the first scan of
+ * a directory with thousands of arrow files, so we kick asynchronous reads
+ * of the footers prior to the metadata cache build. Then, the kernel can
+ * load these pages concurrently.
+ */
+#define ARROW_FOOTER_PREFETCH_SIZE		(256UL << 10)	/* 256kB */
+
+static void
+arrowPrefetchMetadataCache(List *filesList)
+{
+	ListCell   *lc;
+
+	if (list_length(filesList) < 2)
+		return;
+	foreach (lc, filesList)
+	{
+		const char *fname = strVal(lfirst(lc));
+		struct stat	stat_buf;
+		MetadataCacheKey key;
+		uint32		index;
+		LWLock	   *lock;
+		dlist_iter	iter;
+		bool		found = false;
+		int			fdesc;
+
+		if (stat(fname, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode))
+			continue;
+		memset(&key, 0, sizeof(key));
+		key.st_dev	= stat_buf.st_dev;
+		key.st_ino	= stat_buf.st_ino;
+		key.hash = hash_any((unsigned char *)&key,
+							offsetof(MetadataCacheKey, hash));
+		index = key.hash % ARROW_METADATA_HASH_NSLOTS;
+		lock = &arrow_metadata_state->lock_slots[index];
+
+		LWLockAcquire(lock, LW_SHARED);
+		dlist_foreach(iter, &arrow_metadata_state->hash_slots[index])
+		{
+			arrowMetadataCache *mcache
+				= dlist_container(arrowMetadataCache, chain, iter.cur);
+			if (mcache->stat_buf.st_dev == stat_buf.st_dev &&
+				mcache->stat_buf.st_ino == stat_buf.st_ino &&
+				timespec_comp(&mcache->stat_buf.st_mtim,
+							  &stat_buf.st_mtim) >= 0 &&
+				timespec_comp(&mcache->stat_buf.st_ctim,
+							  &stat_buf.st_ctim) >= 0)
+			{
+				found = true;
+				break;
+			}
+		}
+		LWLockRelease(lock);
+		if (found)
+			continue;
+
+		fdesc = open(fname, O_RDONLY | PG_BINARY);
+		if (fdesc < 0)
+			continue;
+		(void) posix_fadvise(fdesc,
+							 Max(stat_buf.st_size -
+								 (off_t)ARROW_FOOTER_PREFETCH_SIZE, 0),
+							 ARROW_FOOTER_PREFETCH_SIZE,
+							 POSIX_FADV_WILLNEED);
+		close(fdesc);
+	}
+}
+
+/*
+ * arrowLookupOrBuildMetadataCache
+ */
+List *
+arrowLookupOrBuildMetadataCache(File fdesc)
+{
+	MetadataCacheKey key;
+	struct stat	stat_buf;
+	uint32		index;
+	LWLock	   *lock;
+	dlist_head *hash_slot;
+	dlist_head *mvcc_slot;
+	dlist_iter	iter1, iter2;
+	bool		has_exclusive = false;
+	List	   *results = NIL;
+
+	if (fstat(FileGetRawDesc(fdesc), &stat_buf) != 0)
+		elog(ERROR, "failed on fstat('%s'): %m", FilePathName(fdesc));
+
+	memset(&key, 0, sizeof(key));
+	key.st_dev	= stat_buf.st_dev;
+	key.st_ino	= stat_buf.st_ino;
+	key.hash = hash_any((unsigned char *)&key,
+						offsetof(MetadataCacheKey, hash));
+	index = key.hash % ARROW_METADATA_HASH_NSLOTS;
+	lock = &arrow_metadata_state->lock_slots[index];
+	hash_slot = &arrow_metadata_state->hash_slots[index];
+	mvcc_slot = &arrow_metadata_state->mvcc_slots[index];
+
+	LWLockAcquire(lock, LW_SHARED);
+retry:
+	dlist_foreach(iter1, hash_slot)
+	{
+		arrowMetadataCache *mcache
+			= dlist_container(arrowMetadataCache, chain, iter1.cur);
+		if (mcache->stat_buf.st_dev == stat_buf.st_dev &&
+			mcache->stat_buf.st_ino == stat_buf.st_ino)
+		{
+			RecordBatchState *rbstate;
+			
+			Assert(mcache->hash == key.hash);
+			if (timespec_comp(&mcache->stat_buf.st_mtim,
+							  &stat_buf.st_mtim) < 0 ||
+				timespec_comp(&mcache->stat_buf.st_ctim,
+							  &stat_buf.st_ctim) < 0)
+			{
+				char	buf1[80], buf2[80], buf3[80], buf4[80];
+				char   *tail;
+
+				if (!has_exclusive)
+				{
+					LWLockRelease(lock);
+					LWLockAcquire(lock, LW_EXCLUSIVE);
+					has_exclusive = true;
+					goto retry;
+				}
+				ctime_r(&mcache->stat_buf.st_mtime, buf1);
+				ctime_r(&mcache->stat_buf.st_ctime, buf2);
+				ctime_r(&stat_buf.st_mtime, buf3);
+				ctime_r(&stat_buf.st_ctime, buf4);
+				for (tail=buf1+strlen(buf1)-1; isspace(*tail); *tail--='\0');
+				for (tail=buf2+strlen(buf2)-1; isspace(*tail); *tail--='\0');
+				for (tail=buf3+strlen(buf3)-1; isspace(*tail); *tail--='\0');
+				for (tail=buf4+strlen(buf4)-1; isspace(*tail); *tail--='\0');
+				elog(DEBUG2, "arrow_fdw: metadata cache for '%s' (m:%s, c:%s) is older than the latest file (m:%s, c:%s), so invalidated",
+					 FilePathName(fdesc), buf1, buf2, buf3, buf4);
+				arrowInvalidateMetadataCache(mcache, true);
+				break;
+			}
+			/*
+			 * Ok, arrow file metadata cache found and still valid
+			 */
+			rbstate = makeRecordBatchStateFromCache(mcache, fdesc);
+			if (checkArrowRecordBatchIsVisible(rbstate, mvcc_slot))
+				results = list_make1(rbstate);
+			dlist_foreach (iter2, &mcache->siblings)
+			{
+				arrowMetadataCache *__mcache
+					= dlist_container(arrowMetadataCache, chain, iter2.cur);
+				rbstate = makeRecordBatchStateFromCache(__mcache, fdesc);
+				if (checkArrowRecordBatchIsVisible(rbstate, mvcc_slot))
+					results = lappend(results, rbstate);
+			}
+			SpinLockAcquire(&arrow_metadata_state->lru_lock);
+			dlist_move_head(&arrow_metadata_state->lru_list,
+							&mcache->lru_chain);
+			SpinLockRelease(&arrow_metadata_state->lru_lock);
+			LWLockRelease(lock);
+
+			return results;
+		}
+	}
+
+	/*
+	 * Hmm... no valid metadata cache was not found, so build a new entry
+	 * under the exclusive lock on the arrow file.
+	 */
+	if (!has_exclusive)
+	{
+		LWLockRelease(lock);
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		has_exclusive = true;
+		goto retry;
+	}
+	else
+	{
+		ArrowFileInfo	af_info;
+		arrowMetadataCache *mcache;
+		List		   *rb_state_any = NIL;
+		ListCell	   *lc;
+
+		/* try to load the metadata from the on-disk catalog first */
+		if (!arrowLoadMetadataFile(fdesc, &stat_buf, &rb_state_any))
+		{
+			if (isParquetFileDesc(FileGetRawDesc(fdesc)))
+				rb_state_any = makeRecordBatchStateParquet(fdesc, &stat_buf);
+			else
+			{
+				readArrowFileDesc(FileGetRawDesc(fdesc), &af_info);
+				if (af_info.recordBatches == NULL)
+					elog(DEBUG2, "arrow file '%s' contains no RecordBatch",
+						 FilePathName(fdesc));
+				for (index = 0;
+					 index < af_info.footer._num_recordBatches;
+					 index++)
+				{
+					RecordBatchState *rb_state;
+					ArrowBlock       *block
+						= &af_info.footer.recordBatches[index];
+					ArrowRecordBatch *rbatch
+						= &af_info.recordBatches[index].body.recordBatch;
+
+					rb_state = makeRecordBatchState(&af_info, block, rbatch);
+					rb_state->fdesc = fdesc;
+					memcpy(&rb_state->stat_buf, &stat_buf,
+						   sizeof(struct stat));
+					rb_state->rb_index = index;
+					setupRecordBatchStats(rb_state, &af_info.footer.schema);
+
+					rb_state_any = lappend(rb_state_any, rb_state);
+				}
+			}
+			arrowSaveMetadataFile(fdesc, &stat_buf, rb_state_any);
+		}
+		foreach (lc, rb_state_any)
+		{
+			RecordBatchState *rb_state = lfirst(lc);
+
+			if (checkArrowRecordBatchIsVisible(rb_state, mvcc_slot))
+				results = lappend(results, rb_state);
+		}
+		/* try to build a metadata cache for further references */
+		mcache = __arrowBuildMetadataCache(rb_state_any, key.hash);
+		if (mcache)
+		{
+			dlist_push_head(hash_slot, &mcache->chain);
+			SpinLockAcquire(&arrow_metadata_state->lru_lock);
+            dlist_push_head(&arrow_metadata_state->lru_list,
+							&mcache->lru_chain);
+			SpinLockRelease(&arrow_metadata_state->lru_lock);
+		}
+	}
+	LWLockRelease(lock);
+	/*
+	 * reclaim unreferenced metadata cache entries based on LRU, if shared-
+	 * memory consumption exceeds the configured threshold.
+	 */
+	arrowReclaimMetadataCache();
+
+	return results;
+}
+
+/*
+ * setupArrowSQLbufferSchema
+ */
+static void
+__setupArrowSQLbufferField(SQLtable *table,
+						   SQLfield *column,
+						   const char *attname,
+						   Oid atttypid,
+						   int atttypmod)
+{
+	HeapTuple		tup;
+	Form_pg_type	typ;
+	const char	   *typnamespace;
+	const char	   *timezone = show_timezone();
+
+	tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(atttypid));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for type: %u", atttypid);
+	typ = (Form_pg_type) GETSTRUCT(tup);
+	typnamespace = get_namespace_name(typ->typnamespace);
+
+	table->numFieldNodes++;
+    table->numBuffers +=
+		assignArrowTypePgSQL(column,
+							 attname,
+							 atttypid,
+							 atttypmod,
+							 NameStr(typ->typname),
+							 typnamespace,
+							 typ->typlen,
+							 typ->typbyval,
+							 typ->typtype,
+							 typ->typalign,
+							 typ->typrelid,
+							 typ->typelem,
+							 timezone,
+							 NULL);
+	if (OidIsValid(typ->typelem))
+	{
+		/* array type */
+		char		elem_name[NAMEDATALEN+10];
+
+		snprintf(elem_name, sizeof(elem_name), "_%s[]", attname);
+		column->element = palloc0(sizeof(SQLfield));
+		__setupArrowSQLbufferField(table,
+								   column->element,
+								   elem_name,
+								   typ->typelem,
+								   -1);
+	}
+	else if (OidIsValid(typ->typrelid))
+	{
+		/* composite type */
+		TupleDesc	tupdesc = lookup_rowtype_tupdesc(atttypid, atttypmod);
+		int			j;
+
+		column->nfields = tupdesc->natts;
+		column->subfields = palloc0(sizeof(SQLfield) * tupdesc->natts);
+		for (j=0; j < tupdesc->natts; j++)
+		{
+			Form_pg_attribute sattr = tupleDescAttr(tupdesc, j);
+			__setupArrowSQLbufferField(table,
+									   &column->subfields[j],
+									   NameStr(sattr->attname),
+									   sattr->atttypid,
+									   sattr->atttypmod);
+		}
+		ReleaseTupleDesc(tupdesc);
+	}
+	else if (typ->typtype == 'e')
+	{
+		elog(ERROR, "Enum type is not supported right now");
+	}
+	ReleaseSysCache(tup);
+}
+
+void
+setupArrowSQLbufferSchema(SQLtable *table, TupleDesc tupdesc)
+{
+	int		j;
+
+	table->nfields = tupdesc->natts;
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		SQLfield   *column = &table->columns[j];
+
+		__setupArrowSQLbufferField(table,
+								   column,
+								   NameStr(attr->attname),
+								   attr->atttypid,
+								   attr->atttypmod);
+		/* min/max statistics are collected on fixed-length values */
+		column->stat_enabled = sql_field_stat_supported(column);
+	}
+	table->segment_sz = (size_t)arrow_record_batch_size_kb << 10;
+}
+
+static void
+setupArrowSQLbufferBatches(SQLtable *table)
+{
+	ArrowFileInfo af_info;
+	struct stat	stat_buf;
+	MetadataCacheKey key;
+	uint32		index;
+	int			i, nitems;
+	loff_t		pos = 0;
+
+	if (fstat(table->fdesc, &stat_buf) != 0)
+		elog(ERROR, "failed on fstat('%s'): %m", table->filename);
+	memset(&key, 0, sizeof(key));
+	key.st_dev = stat_buf.st_dev;
+	key.st_ino = stat_buf.st_ino;
+	key.hash = hash_any((unsigned char *)&key,
+						offsetof(MetadataCacheKey, hash));
+	index = key.hash % ARROW_METADATA_HASH_NSLOTS;
+
+	LWLockAcquire(&arrow_metadata_state->lock_slots[index], LW_SHARED);
+	readArrowFileDesc(table->fdesc, &af_info);
+	LWLockRelease(&arrow_metadata_state->lock_slots[index]);
+
+	/* we cannot append values to dictionary-encoded columns */
+	for (i=0; i < af_info.footer.schema._num_fields; i++)
+	{
+		if (af_info.footer.schema.fields[i].dictionary)
+			elog(ERROR, "arrow_fdw: unable to write on '%s' that has dictionary-encoded column",
+				 table->filename);
+	}
+
+	/* restore DictionaryBatches already in the file */
+	nitems = af_info.footer._num_dictionaries;
+	table->numDictionaries = nitems;
+	if (nitems > 0)
+	{
+		table->dictionaries = palloc(sizeof(ArrowBlock) * nitems);
+		memcpy(table->dictionaries,
+			   af_info.footer.dictionaries,
+			   sizeof(ArrowBlock) * nitems);
+		for (i=0; i < nitems; i++)
+		{
+			ArrowBlock *block = &table->dictionaries[i];
+
+			pos = Max(pos, ARROWALIGN(block->offset +
+									  block->metaDataLength +
+									  block->bodyLength));
+		}
+	}
+	else
+		table->dictionaries = NULL;
+
+	/* restore RecordBatches already in the file */
+	nitems = af_info.footer._num_recordBatches;
+	table->numRecordBatches = nitems;
+	if (nitems > 0)
+	{
+		table->recordBatches = palloc(sizeof(ArrowBlock) * nitems);
+		memcpy(table->recordBatches,
+			   af_info.footer.recordBatches,
+			   sizeof(ArrowBlock) * nitems);
+		for (i=0; i < nitems; i++)
+		{
+			ArrowBlock *block = &table->recordBatches[i];
+
+			pos = Max(pos, ARROWALIGN(block->offset +
+									  block->metaDataLength +
+									  block->bodyLength));
+		}
+	}
+	else
+		table->recordBatches = NULL;
+
+	/* restore min/max statistics of the RecordBatches */
+	if (af_info.footer.schema._num_fields == table->nfields)
+	{
+		for (i=0; i < table->nfields; i++)
+			restoreArrowFieldStat(&table->columns[i],
+								  &af_info.footer.schema.fields[i],
+								  nitems);
+	}
+
+	if (lseek(table->fdesc, pos, SEEK_SET) < 0)
+		elog(ERROR, "failed on lseek('%s',%lu): %m",
+			 table->filename, pos);
+}
+
+/*
+ * createArrowWriteState
+ */
+static arrowWriteState *
+createArrowWriteState(Relation frel, File file, bool redo_log_written)
+{
+	TupleDesc		tupdesc = RelationGetDescr(frel);
+	arrowWriteState *aw_state;
+	SQLtable	   *table;
+	struct stat		stat_buf;
+	MetadataCacheKey key;
+
+	if (fstat(FileGetRawDesc(file), &stat_buf) != 0)
+		elog(ERROR, "failed on fstat('%s'): %m", FilePathName(file));
+	memset(&key, 0, sizeof(key));
+	key.st_dev = stat_buf.st_dev;
+	key.st_ino = stat_buf.st_ino;
+	key.hash = hash_any((unsigned char *)&key,
+						offsetof(MetadataCacheKey, hash));
+	aw_state = palloc0(offsetof(arrowWriteState,
+								sql_table.columns[tupdesc->natts]));
+	aw_state->memcxt = CurrentMemoryContext;
+	aw_state->file = file;
+	aw_state->key = key;
+	aw_state->hash = key.hash;
+	aw_state->redo_log_written = redo_log_written;
+	table = &aw_state->sql_table;
+	table->filename = FilePathName(file);
+	table->fdesc = FileGetRawDesc(file);
+	setupArrowSQLbufferSchema(table, tupdesc);
+	if (!redo_log_written)
+		setupArrowSQLbufferBatches(table);
+
+	return aw_state;
+}
+
+/*
+ * createArrowWriteRedoLog
+ */
+static void
+createArrowWriteRedoLog(File filp, bool is_newfile)
+{
+	arrowWriteRedoLog *redo;
+	int				fdesc = FileGetRawDesc(filp);
+	const char	   *fname = FilePathName(filp);
+	TransactionId	curr_xid = GetCurrentTransactionId();
+	CommandId		curr_cid = GetCurrentCommandId(true);
+	dlist_iter		iter;
+	MetadataCacheKey key;
+	struct stat		stat_buf;
+	size_t			main_sz;
+
+	if (fstat(fdesc, &stat_buf) != 0)
+		elog(ERROR, "failed on fstat(2): %m");
+
+	dlist_foreach(iter, &arrow_write_redo_list)
+	{
+		redo = dlist_container(arrowWriteRedoLog, chain, iter.cur);
+
+		if (redo->key.st_dev == stat_buf.st_dev &&
+			redo->key.st_ino == stat_buf.st_ino &&
+			redo->xid    == curr_xid &&
+			redo->cid    <= curr_cid)
+		{
+			/* nothing to do */
+			return;
+		}
+	}
+
+	memset(&key, 0, sizeof(MetadataCacheKey));
+	key.st_dev = stat_buf.st_dev;
+	key.st_ino = stat_buf.st_ino;
+	key.hash = hash_any((unsigned char *)&key,
+						offsetof(MetadataCacheKey, hash));
+	if (is_newfile)
+	{
+		main_sz = MAXALIGN(offsetof(arrowWriteRedoLog, footer_backup));
+		redo = MemoryContextAllocZero(CacheMemoryContext,
+									  main_sz + strlen(fname) + 1);
+		redo->key = key;
+		redo->xid = curr_xid;
+		redo->cid = curr_cid;
+		redo->pathname = (char *)redo + main_sz;
+		strcpy(redo->pathname, fname);
+		redo->is_truncate = false;
+	}
+	else
+	{
+		ssize_t			nbytes;
+		off_t			offset;
+		char			temp[100];
+
+		/* make backup image of the Footer section */
+		nbytes = sizeof(int32) + 6;		/* = strlen("ARROW1") */
+		offset = lseek(fdesc, -nbytes, SEEK_END);
+		if (offset < 0)
+			elog(ERROR, "failed on lseek(2): %m");
+		if (__readFile(fdesc, temp, nbytes) != nbytes)
+			elog(ERROR, "failed on read(2): %m");
+		offset -= *((int32 *)temp);
+
+		nbytes = stat_buf.st_size - offset;
+		if (nbytes <= 0)
+			elog(ERROR, "strange apache arrow format");
+		main_sz = MAXALIGN(offsetof(arrowWriteRedoLog,
+									footer_backup[nbytes]));
+		redo = MemoryContextAllocZero(CacheMemoryContext,
+									  main_sz + strlen(fname) + 1);
+		redo->key = key;
+		redo->xid = curr_xid;
+		redo->cid = curr_cid;
+		redo->pathname = (char *)redo + main_sz;
+		strcpy(redo->pathname, fname);
+		PG_TRY();
+		{
+			if (lseek(fdesc, -nbytes, SEEK_END) < 0)
+				elog(ERROR, "failed on lseek(2): %m");
+			if (__readFile(fdesc, redo->footer_backup, nbytes) != nbytes)
+				elog(ERROR, "failed on read(2): %m");
+			if (lseek(fdesc, -nbytes, SEEK_END) < 0)
+				elog(ERROR, "failed on lseek(2): %m");
+			redo->footer_offset = offset;
+			redo->footer_length = nbytes;
+		}
+		PG_CATCH();
+		{
+			pfree(redo);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+	}
+	elog(DEBUG2, "arrow: redo-log on '%s' (st_dev=%u/st_ino=%u) xid=%u cid=%u offset=%lu length=%zu",
+		 redo->pathname, (uint32)redo->key.st_dev, (uint32)redo->key.st_ino,
+		 (uint32)redo->xid, (uint32)redo->cid,
+		 (uint64)redo->footer_offset,
+		 (uint64)redo->footer_length);
+
+	dlist_push_head(&arrow_write_redo_list, &redo->chain);
+}
+
+/*
+ * writeOutArrowRecordBatch
+ */
+static void
+writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
+{
+	SQLtable   *table = &aw_state->sql_table;
+	int			index = aw_state->hash % ARROW_METADATA_HASH_NSLOTS;
+	struct stat	stat_buf;
+	ssize_t		nbytes;
+	arrowWriteMVCCLog *mvcc = NULL;
+
+	if (table->nitems > 0)
+	{
+		mvcc = MemoryContextAllocZero(TopSharedMemoryContext,
+									  sizeof(arrowWriteMVCCLog));
+		mvcc->key = aw_state->key;
+		mvcc->xid = GetCurrentTransactionId();
+		mvcc->cid = GetCurrentCommandId(true);
+	}
+
+	PG_TRY();
+	{
+		LWLockAcquire(&arrow_metadata_state->lock_slots[index],
+					  LW_EXCLUSIVE);
+		/* get the latest state of the file */
+		if (fstat(table->fdesc, &stat_buf) != 0)
+			elog(ERROR, "failed on fstat('%s'): %m", table->filename);
+		/* make a REDO log entry */
+		if (!aw_state->redo_log_written)
+		{
+			createArrowWriteRedoLog(aw_state->file, false);
+			aw_state->redo_log_written = true;
+		}
+		/* write out an empty arrow file */
+		if (stat_buf.st_size == 0)
+		{
+			Assert(lseek(table->fdesc, 0, SEEK_END) == 0);
+			nbytes = __writeFile(table->fdesc, "ARROW1\0\0", 8);
+			if (nbytes != 8)
+				elog(ERROR, "failed on __writeFile('%s'): %m",
+					 table->filename);
+			writeArrowSchema(table);
+		}
+		if (table->nitems > 0)
+		{
+			mvcc->record_batch = writeArrowRecordBatch(table);
+			dlist_push_tail(&arrow_metadata_state->mvcc_slots[index],
+							&mvcc->chain);
+			elog(DEBUG2,
+				 "arrow-write: '%s' (st_dev=%u, st_ino=%u), xid=%u, cid=%u, record_batch=%u",
+				 FilePathName(aw_state->file),
+				 (uint32)mvcc->key.st_dev, (uint32)mvcc->key.st_ino,
+				 (uint32)mvcc->xid, (uint32)mvcc->cid, mvcc->record_batch);
+		}
+		if (with_footer)
+			writeArrowFooter(table);
+		LWLockRelease(&arrow_metadata_state->lock_slots[index]);
+	}
+	PG_CATCH();
+	{
+		if (mvcc)
+			pfree(mvcc);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+/*
+ * TRUNCATE support
+ */
+static void
+__arrowExecTruncateRelation(Relation frel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(frel);
+	Oid			frel_oid = RelationGetRelid(frel);
+	ForeignTable *ft = GetForeignTable(frel_oid);
+	arrowWriteRedoLog *redo;
+	struct stat	stat_buf;
+	MetadataCacheKey key;
+	List	   *filesList;
+	SQLtable   *table;
+	const char *path_name;
+	const char *dir_name;
+	const char *file_name;
+	size_t		main_sz;
+	int			fdesc = -1;
+	int			nbytes;
+	char		backup_path[MAXPGPATH];
+	bool		writable;
+
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	if (!writable)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
+			 RelationGetRelationName(frel));
+	Assert(list_length(filesList) == 1);
+	path_name = strVal(linitial(filesList));
+	if (stat(path_name, &stat_buf) != 0)
+		elog(ERROR, "failed on stat('%s'): %m", path_name);
+	memset(&key, 0, sizeof(key));
+	key.st_dev = stat_buf.st_dev;
+	key.st_ino = stat_buf.st_ino;
+	key.hash = hash_any((unsigned char *)&key,
+						offsetof(MetadataCacheKey, hash));
+	/* build SQLtable to write out schema */
+	table = palloc0(offsetof(SQLtable, columns[tupdesc->natts]));
+	setupArrowSQLbufferSchema(table, tupdesc);
+
+	/* create REDO log entry */
+	main_sz = MAXALIGN(offsetof(arrowWriteRedoLog, footer_backup));
+	redo = MemoryContextAllocZero(CacheMemoryContext,
+								  main_sz + strlen(path_name) + 1);
+	redo->key    = key;
+	redo->xid    = GetCurrentTransactionId();
+	redo->cid    = GetCurrentCommandId(true);
+	redo->pathname = (char *)redo + main_sz;
+	strcpy(redo->pathname, path_name);
+	redo->is_truncate = true;
+
+	PG_TRY();
+	{
+		/*
+		 * move the current arrow file to the backup
+		 */
+		dir_name = dirname(pstrdup(path_name));
+		file_name = basename(pstrdup(path_name));
+		for (;;)
+		{
+			redo->suffix = random();
+			snprintf(backup_path, sizeof(backup_path),
+					 "%s/%s.%u.backup",
+					 dir_name, file_name, redo->suffix);
+			if (stat(backup_path, &stat_buf) != 0)
+			{
+				if (errno == ENOENT)
+					break;
+				elog(ERROR, "failed on stat('%s'): %m", backup_path);
+			}
+		}
+		if (rename(path_name, backup_path) != 0)
+			elog(ERROR, "failed on rename('%s','%s'): %m",
+				 path_name, backup_path);
+
+		/*
+		 * create an empty arrow file
+		 */
+		PG_TRY();
+		{
+			fdesc = open(path_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fdesc < 0)
+				elog(ERROR, "failed on open('%s'): %m", path_name);
+			table->filename = path_name;
+			table->fdesc = fdesc;
+			nbytes = __writeFile(fdesc, "ARROW1\0\0", 8);
+			if (nbytes != 8)
+				elog(ERROR, "failed on __writeFile('%s'): %m", path_name);
+			writeArrowSchema(table);
+			writeArrowFooter(table);
+		}
+		PG_CATCH();
+		{
+			if (fdesc >= 0)
+				close(fdesc);
+			if (rename(backup_path, path_name) != 0)
+				elog(WARNING, "failed on rename('%s', '%s'): %m",
+					 backup_path, path_name);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+		close(fdesc);
+	}
+	PG_CATCH();
+	{
+		pfree(redo);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	/* save the REDO log entry */
+	dlist_push_head(&arrow_write_redo_list, &redo->chain);
+}
+
+/*
+ * pgstrom_arrow_fdw_truncate
+ */
+Datum
+pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS)
+{
+	Oid			frel_oid = PG_GETARG_OID(0);
+	Relation	frel;
+	FdwRoutine *routine;
+
+	frel = table_open(frel_oid, AccessExclusiveLock);
+	if (frel->rd_rel->relkind != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not arrow_fdw foreign table",
+						RelationGetRelationName(frel))));
+	routine = GetFdwRoutineForRelation(frel, false);
+	if (memcmp(routine, &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not arrow_fdw foreign table",
+						RelationGetRelationName(frel))));
+	__arrowExecTruncateRelation(frel);
+
+	table_close(frel, NoLock);
+
+	PG_RETURN_VOID();
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_truncate);
+
+/*
+ * Server side export of query results
+ *
+ * The executor sends the result tuples to arrowExportDestReceiver, which
+ * appends them to the SQLtable buffer and writes out a record batch
+ * whenever the buffer usage exceeds arrow_fdw.record_batch_size.
+ * If 'tupstore' is given, the record batch is written to the in-memory
+ * file, then moved to the tuplestore as a bytea datum.
+ */
+typedef struct
+{
+	DestReceiver	pub;
+	SQLtable	   *table;
+	MemoryContext	memcxt;
+	uint64			nitems;
+	Tuplestorestate *tupstore;
+	TupleDesc		tupdesc;
+} arrowExportDestReceiver;
+
+static void
+arrowExportFlushStream(arrowExportDestReceiver *dest)
+{
+	int			fdesc = dest->table->fdesc;
+	off_t		length;
+	bytea	   *chunk;
+	Datum		value;
+	bool		isnull = false;
+
+	length = lseek(fdesc, 0, SEEK_CUR);
+	if (length < 0)
+		elog(ERROR, "failed on lseek: %m");
+	if (length == 0)
+		return;
+	if (length > MaxAllocSize - VARHDRSZ)
+		elog(ERROR, "arrow_fdw: too large record batch (%zu bytes)",
+			 (size_t)length);
+	chunk = palloc(VARHDRSZ + length);
+	if (pread(fdesc, VARDATA(chunk), length, 0) != length)
+		elog(ERROR, "failed on pread: %m");
+	SET_VARSIZE(chunk, VARHDRSZ + length);
+	value = PointerGetDatum(chunk);
+	tuplestore_putvalues(dest->tupstore, dest->tupdesc, &value, &isnull);
+	pfree(chunk);
+
+	/* rewind the in-memory file for the next message */
+	if (ftruncate(fdesc, 0) != 0 || lseek(fdesc, 0, SEEK_SET) != 0)
+		elog(ERROR, "failed on ftruncate: %m");
+}
+
+static bool
+arrowExportReceiveSlot(TupleTableSlot *slot, DestReceiver *self)
+{
+	arrowExportDestReceiver *dest = (arrowExportDestReceiver *)self;
+	SQLtable	   *table = dest->table;
+	TupleDesc		tupdesc = slot->tts_tupleDescriptor;
+	MemoryContext	oldcxt;
+	size_t			usage = 0;
+	int				j;
+
+	slot_getallattrs(slot);
+	oldcxt = MemoryContextSwitchTo(dest->memcxt);
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		SQLfield   *column = &table->columns[j];
+		Datum		datum = slot->tts_values[j];
+
+		if (slot->tts_isnull[j])
+			usage += sql_field_put_value(column, NULL, 0);
+		else if (attr->attbyval)
+			usage += sql_field_put_value(column, (char *)&datum,
+										 attr->attlen);
+		else if (attr->attlen == -1)
+			usage += sql_field_put_value(column,
+										 VARDATA_ANY(datum),
+										 VARSIZE_ANY_EXHDR(datum));
+		else
+			elog(ERROR, "Bug? unsupported type format");
+	}
+	table->nitems++;
+	dest->nitems++;
+	if (usage > table->segment_sz)
+	{
+		writeArrowRecordBatch(table);
+		if (dest->tupstore)
+			arrowExportFlushStream(dest);
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	return true;
+}
+
+static void
+arrowExportStartup(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+	/* nothing to do */
+}
+
+static void
+arrowExportShutdown(DestReceiver *self)
+{
+	/* nothing to do */
+}
+
+static void
+arrowExportDestroy(DestReceiver *self)
+{
+	/* nothing to do */
+}
+
+/*
+ * __arrowExportPlanQuery - parse, analyze and plan the export query
+ */
+static PlannedStmt *
+__arrowExportPlanQuery(const char *query_string)
+{
+	List	   *raw_parsetree_list;
+	List	   *rewritten;
+	Query	   *query;
+	PlannedStmt *plan;
+
+	raw_parsetree_list = pg_parse_query(query_string);
+	if (list_length(raw_parsetree_list) != 1)
+		elog(ERROR, "arrow_fdw: export query must be a single SQL command");
+	rewritten = pg_analyze_and_rewrite(linitial_node(RawStmt,
+													 raw_parsetree_list),
+									   query_string, NULL, 0, NULL);
+	if (list_length(rewritten) != 1)
+		elog(ERROR, "arrow_fdw: export query must be a single SELECT command");
+	query = linitial_node(Query, rewritten);
+	if (query->commandType != CMD_SELECT ||
+		query->utilityStmt != NULL ||
+		query->rowMarks != NIL)
+		elog(ERROR, "arrow_fdw: export query must be a read-only SELECT command");
+#if PG_VERSION_NUM < 130000
+	plan = pg_plan_query(query, CURSOR_OPT_PARALLEL_OK, NULL);
+#else
+	plan = pg_plan_query(query, query_string, CURSOR_OPT_PARALLEL_OK, NULL);
+#endif
+	return plan;
+}
+
+/*
+ * __arrowExportSetupDest - setup SQLtable buffer and DestReceiver
+ */
+static void
+__arrowExportSetupDest(arrowExportDestReceiver *dest,
+					   PlannedStmt *plan, const char *filename)
+{
+	TupleDesc	tupdesc = ExecCleanTypeFromTL(plan->planTree->targetlist);
+	SQLtable   *table;
+	MemoryContext memcxt;
+
+	memcxt = AllocSetContextCreate(CurrentMemoryContext,
+								   "arrow export buffer",
+								   ALLOCSET_DEFAULT_SIZES);
+	table = MemoryContextAllocZero(memcxt, offsetof(SQLtable,
+													columns[tupdesc->natts]));
+	table->filename = filename;
+	table->fdesc = -1;
+	setupArrowSQLbufferSchema(table, tupdesc);
+
+	memset(dest, 0, sizeof(arrowExportDestReceiver));
+	dest->pub.receiveSlot = arrowExportReceiveSlot;
+	dest->pub.rStartup = arrowExportStartup;
+	dest->pub.rShutdown = arrowExportShutdown;
+	dest->pub.rDestroy = arrowExportDestroy;
+	dest->pub.mydest = DestNone;
+	dest->table = table;
+	dest->memcxt = memcxt;
+}
+
+/*
+ * __arrowExportRunQuery - run the query, and flush the remaining rows
+ */
+static void
+__arrowExportRunQuery(arrowExportDestReceiver *dest,
+					  PlannedStmt *plan, const char *query_string)
+{
+	QueryDesc  *queryDesc;
+
+	PushCopiedSnapshot(GetActiveSnapshot());
+	UpdateActiveSnapshotCommandId();
+	queryDesc = CreateQueryDesc(plan,
+								query_string,
+								GetActiveSnapshot(),
+								InvalidSnapshot,
+								&dest->pub,
+								NULL,
+								NULL,
+								0);
+	ExecutorStart(queryDesc, 0);
+	ExecutorRun(queryDesc, ForwardScanDirection, 0L, true);
+	ExecutorFinish(queryDesc);
+	ExecutorEnd(queryDesc);
+	FreeQueryDesc(queryDesc);
+	PopActiveSnapshot();
+
+	if (dest->table->nitems > 0)
+	{
+		MemoryContext	oldcxt = MemoryContextSwitchTo(dest->memcxt);
+
+		writeArrowRecordBatch(dest->table);
+		if (dest->tupstore)
+			arrowExportFlushStream(dest);
+		MemoryContextSwitchTo(oldcxt);
+	}
+}
+
+/*
+ * pgstrom_arrow_fdw_export_query
+ *
+ * It runs the supplied SELECT query, then writes out the results to a new
+ * Apache Arrow file on the server filesystem. Unlike pg2arrow, the results
+ * are never sent over the network. The query can be run using parallel
+ * workers, if planner chooses.
+ */
+Datum
+pgstrom_arrow_fdw_export_query(PG_FUNCTION_ARGS)
+{
+	char	   *query_string = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char	   *filename = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	PlannedStmt *plan;
+	SQLtable   *table;
+	arrowExportDestReceiver dest;
+	volatile int fdesc = -1;
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to export query results to a server file")));
+	if (!is_absolute_path(filename))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_NAME),
+				 errmsg("relative path not allowed for export to a server file")));
+
+	plan = __arrowExportPlanQuery(query_string);
+	__arrowExportSetupDest(&dest, plan, filename);
+	table = dest.table;
+
+	fdesc = open(filename, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fdesc < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", filename)));
+	PG_TRY();
+	{
+		table->fdesc = fdesc;
+		if (__writeFile(fdesc, "ARROW1\0\0", 8) != 8)
+			elog(ERROR, "failed on __writeFile('%s'): %m", filename);
+		writeArrowSchema(table);
+		__arrowExportRunQuery(&dest, plan, query_string);
+		writeArrowFooter(table);
+		if (pg_fsync(fdesc) != 0)
+			elog(ERROR, "failed on pg_fsync('%s'): %m", filename);
+	}
+	PG_CATCH();
+	{
+		close(fdesc);
+		if (unlink(filename) != 0)
+			elog(WARNING, "failed on unlink('%s'): %m", filename);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	close(fdesc);
+	MemoryContextDelete(dest.memcxt);
+
+	PG_RETURN_INT64(dest.nitems);
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_export_query);
+
+/*
+ * pgstrom_arrow_fdw_stream_query
+ *
+ * It runs the supplied SELECT query, then returns the results as a series
+ * of bytea; concatenation of them is an Apache Arrow IPC stream (Schema
+ * message, RecordBatch messages and EOS marker), so clients can load it
+ * with the Arrow libraries as is, without transposition of rows.
+ */
+Datum
+pgstrom_arrow_fdw_stream_query(PG_FUNCTION_ARGS)
+{
+	char	   *query_string = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	PlannedStmt *plan;
+	SQLtable   *table;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcxt;
+	arrowExportDestReceiver dest;
+	volatile int fdesc = -1;
+	static const uint32 eos_marker[2] = { 0xffffffffU, 0x00000000U };
+
+	if (!rsinfo || !IsA(rsinfo, ReturnSetInfo) ||
+		(rsinfo->allowedModes & SFRM_Materialize) == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+
+	/* tuplestore to be returned lives in the per-query memory context */
+	oldcxt = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTemplateTupleDesc(1);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "stream", BYTEAOID, -1, 0);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	MemoryContextSwitchTo(oldcxt);
+
+	plan = __arrowExportPlanQuery(query_string);
+	__arrowExportSetupDest(&dest, plan, "arrow-stream");
+	dest.tupstore = tupstore;
+	dest.tupdesc = tupdesc;
+	table = dest.table;
+
+	/* the messages are built on the in-memory file */
+	fdesc = memfd_create("arrow-stream", MFD_CLOEXEC);
+	if (fdesc < 0)
+		elog(ERROR, "failed on memfd_create: %m");
+	PG_TRY();
+	{
+		table->fdesc = fdesc;
+		writeArrowSchema(table);
+		arrowExportFlushStream(&dest);
+		__arrowExportRunQuery(&dest, plan, query_string);
+		if (__writeFile(fdesc, eos_marker, sizeof(eos_marker)) != sizeof(eos_marker))
+			elog(ERROR, "failed on __writeFile: %m");
+		arrowExportFlushStream(&dest);
+	}
+	PG_CATCH();
+	{
+		close(fdesc);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	close(fdesc);
+	MemoryContextDelete(dest.memcxt);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	return (Datum) 0;
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_stream_query);
+
+/*
+ * GPU accelerated import of CSV files
+ *
+ * pgstrom.arrow_fdw_import_csv() loads a CSV file on the server filesystem
+ * into the writable arrow_fdw foreign table. The file is read by chunks
+ * split at the line boundary onto the managed memory, then the GPU kernels
+ * find the line offsets, tokenize the lines and convert the tokens to the
+ * binary form of the column types. CPU only appends the binary values to
+ * the SQLfield buffers, without parsing of the text.
+ * The GPU kernels handle the usual text forms of the data types only; the
+ * other tokens (e.g, ' 123', 'Infinity' or '1.5e400') are marked as
+ * fallback, then converted by the input function of the type on CPU.
+ * Like COPY FROM with CSV format, an empty unquoted token is NULL, and
+ * two double-quotes in the quoted token are an escaped double-quote.
+ * Newline characters in the quoted token are not supported, because the
+ * lines are split prior to the tokenization.
+ */
+#define ARROW_CSV_FIELD__NULL		0x01
+#define ARROW_CSV_FIELD__ESCAPED	0x02	/* has escaped double-quotes */
+#define ARROW_CSV_FIELD__NONASCII	0x04	/* has non-ASCII characters */
+#define ARROW_CSV_FIELD__FALLBACK	0x08	/* needs input function on CPU */
+#define ARROW_CSV_UNITSZ			4096	/* bytes per thread on line split */
+
+typedef struct
+{
+	GpuContext *gcontext;
+	CUfunction	kern_count_lines;
+	CUfunction	kern_setup_rows;
+	CUfunction	kern_parse_rows;
+	int			ncols;			/* number of non-dropped columns */
+	cl_uint		bufsz;			/* size of the read buffer */
+	CUdeviceptr	m_buffer;		/* read buffer (+1 byte for newline) */
+	CUdeviceptr	m_nlines;		/* # of lines per ARROW_CSV_UNITSZ */
+	CUdeviceptr	m_error_row;	/* first row with malformed structure */
+	cl_uint		nrooms;			/* capacity of the buffers below */
+	CUdeviceptr	m_row_offsets;	/* offsets of the lines */
+	CUdeviceptr	m_values;		/* binary values, or token positions */
+	CUdeviceptr	m_status;		/* ARROW_CSV_FIELD__* flags */
+} arrowCsvImportState;
+
+/*
+ * __arrowCsvImportKernelSource
+ */
+static char *
+__arrowCsvImportKernelSource(TupleDesc tupdesc, int ncols)
+{
+	StringInfoData buf;
+	int			j, k;
+
+	initStringInfo(&buf);
+	appendStringInfo(
+		&buf,
+		"#define CSV_NCOLS             %d\n"
+		"#define CSV_UNITSZ            %d\n"
+		"#define CSV_POSTGRES_EPOCH    %d\n"
+		"#define CSV_FIELD__NULL       0x%02x\n"
+		"#define CSV_FIELD__ESCAPED    0x%02x\n"
+		"#define CSV_FIELD__NONASCII   0x%02x\n"
+		"#define CSV_FIELD__FALLBACK   0x%02x\n\n",
+		ncols,
+		ARROW_CSV_UNITSZ,
+		POSTGRES_EPOCH_JDATE,
+		ARROW_CSV_FIELD__NULL,
+		ARROW_CSV_FIELD__ESCAPED,
+		ARROW_CSV_FIELD__NONASCII,
+		ARROW_CSV_FIELD__FALLBACK);
+	appendStringInfoString(
+		&buf,
+		"/*\n"
+		" * __csv_parse_digits - fixed number of decimal digits\n"
+		" */\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_digits(const char *s, cl_uint n, cl_int *p_value)\n"
+		"{\n"
+		"  cl_int   value = 0;\n"
+		"  cl_uint  i;\n\n"
+		"  for (i=0; i < n; i++)\n"
+		"  {\n"
+		"    if (s[i] < '0' || s[i] > '9')\n"
+		"      return false;\n"
+		"    value = 10 * value + (s[i] - '0');\n"
+		"  }\n"
+		"  *p_value = value;\n"
+		"  return true;\n"
+		"}\n\n"
+		"/*\n"
+		" * __csv_parse_int - integer without white-spaces; up to 18 digits\n"
+		" */\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_int(const char *s, cl_uint len,\n"
+		"                cl_long lower, cl_long upper, cl_long *p_value)\n"
+		"{\n"
+		"  cl_bool  negative = false;\n"
+		"  cl_long  value = 0;\n"
+		"  cl_uint  i = 0;\n\n"
+		"  if (i < len && (s[i] == '-' || s[i] == '+'))\n"
+		"    negative = (s[i++] == '-');\n"
+		"  if (i == len || len - i > 18)\n"
+		"    return false;\n"
+		"  for (; i < len; i++)\n"
+		"  {\n"
+		"    if (s[i] < '0' || s[i] > '9')\n"
+		"      return false;\n"
+		"    value = 10 * value + (s[i] - '0');\n"
+		"  }\n"
+		"  if (negative)\n"
+		"    value = -value;\n"
+		"  if (value < lower || value > upper)\n"
+		"    return false;\n"
+		"  *p_value = value;\n"
+		"  return true;\n"
+		"}\n\n"
+		"/*\n"
+		" * __csv_parse_decimal - decimal number to mantissa and exponent\n"
+		" */\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_decimal(const char *s, cl_uint len, cl_bool *p_negative,\n"
+		"                    cl_ulong *p_mantissa, cl_int *p_exponent)\n"
+		"{\n"
+		"  cl_bool  negative = false;\n"
+		"  cl_bool  has_dot = false;\n"
+		"  cl_bool  has_digits = false;\n"
+		"  cl_ulong mantissa = 0;\n"
+		"  cl_int   ndigits = 0;\n"
+		"  cl_int   exponent = 0;\n"
+		"  cl_uint  i = 0;\n\n"
+		"  if (i < len && (s[i] == '-' || s[i] == '+'))\n"
+		"    negative = (s[i++] == '-');\n"
+		"  for (; i < len; i++)\n"
+		"  {\n"
+		"    if (s[i] >= '0' && s[i] <= '9')\n"
+		"    {\n"
+		"      has_digits = true;\n"
+		"      if (mantissa == 0 && s[i] == '0')\n"
+		"      {\n"
+		"        if (has_dot)\n"
+		"          exponent--;\n"
+		"        continue;\n"
+		"      }\n"
+		"      if (++ndigits > 19)\n"
+		"        return false;\n"
+		"      mantissa = 10 * mantissa + (s[i] - '0');\n"
+		"      if (has_dot)\n"
+		"        exponent--;\n"
+		"    }\n"
+		"    else if (s[i] == '.' && !has_dot)\n"
+		"      has_dot = true;\n"
+		"    else\n"
+		"      break;\n"
+		"  }\n"
+		"  if (!has_digits)\n"
+		"    return false;\n"
+		"  if (i < len && (s[i] == 'e' || s[i] == 'E'))\n"
+		"  {\n"
+		"    cl_bool  exp_negative = false;\n"
+		"    cl_int   exp_value;\n\n"
+		"    if (++i < len && (s[i] == '-' || s[i] == '+'))\n"
+		"      exp_negative = (s[i++] == '-');\n"
+		"    if (i == len || len - i > 4 ||\n"
+		"        !__csv_parse_digits(s + i, len - i, &exp_value))\n"
+		"      return false;\n"
+		"    exponent += (exp_negative ? -exp_value : exp_value);\n"
+		"    i = len;\n"
+		"  }\n"
+		"  if (i != len)\n"
+		"    return false;\n"
+		"  *p_negative = negative;\n"
+		"  *p_mantissa = mantissa;\n"
+		"  *p_exponent = (mantissa == 0 ? 0 : exponent);\n"
+		"  return true;\n"
+		"}\n\n"
+		"/*\n"
+		" * __csv_parse_float4 / __csv_parse_float8\n"
+		" *\n"
+		" * Both of the mantissa and the power of 10 are exactly representable,\n"
+		" * so a single multiplication or division is correctly rounded. Other\n"
+		" * values are converted by the input function on CPU.\n"
+		" */\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_float4(const char *s, cl_uint len, cl_float *p_value)\n"
+		"{\n"
+		"  cl_bool  negative;\n"
+		"  cl_ulong mantissa;\n"
+		"  cl_int   exponent;\n"
+		"  cl_float value;\n"
+		"  cl_float scale = 1.0;\n"
+		"  cl_int   k;\n\n"
+		"  if (!__csv_parse_decimal(s, len, &negative, &mantissa, &exponent) ||\n"
+		"      mantissa > (1UL << 24) || exponent < -10 || exponent > 10)\n"
+		"    return false;\n"
+		"  for (k = (exponent < 0 ? -exponent : exponent); k > 0; k--)\n"
+		"    scale *= 10.0;\n"
+		"  value = (cl_float)mantissa;\n"
+		"  value = (exponent < 0 ? value / scale : value * scale);\n"
+		"  *p_value = (negative ? -value : value);\n"
+		"  return true;\n"
+		"}\n\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_float8(const char *s, cl_uint len, cl_double *p_value)\n"
+		"{\n"
+		"  cl_bool  negative;\n"
+		"  cl_ulong mantissa;\n"
+		"  cl_int   exponent;\n"
+		"  cl_double value;\n"
+		"  cl_double scale = 1.0;\n"
+		"  cl_int   k;\n\n"
+		"  if (!__csv_parse_decimal(s, len, &negative, &mantissa, &exponent) ||\n"
+		"      mantissa > (1UL << 53) || exponent < -22 || exponent > 22)\n"
+		"    return false;\n"
+		"  for (k = (exponent < 0 ? -exponent : exponent); k > 0; k--)\n"
+		"    scale *= 10.0;\n"
+		"  value = (cl_double)mantissa;\n"
+		"  value = (exponent < 0 ? value / scale : value * scale);\n"
+		"  *p_value = (negative ? -value : value);\n"
+		"  return true;\n"
+		"}\n\n"
+		"/*\n"
+		" * __csv_parse_bool - t/f, true/false, y/n, yes/no, on/off and 1/0\n"
+		" */\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_match_word(const char *s, cl_uint len, const char *word)\n"
+		"{\n"
+		"  cl_uint  i;\n\n"
+		"  for (i=0; i < len; i++)\n"
+		"  {\n"
+		"    char    c = s[i];\n\n"
+		"    if (c >= 'A' && c <= 'Z')\n"
+		"      c += ('a' - 'A');\n"
+		"    if (word[i] == '\\0' || c != word[i])\n"
+		"      return false;\n"
+		"  }\n"
+		"  return (word[len] == '\\0');\n"
+		"}\n\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_bool(const char *s, cl_uint len, cl_bool *p_value)\n"
+		"{\n"
+		"  if (len > 5)\n"
+		"    return false;\n"
+		"  if (__csv_match_word(s, len, \"t\") ||\n"
+		"      __csv_match_word(s, len, \"true\") ||\n"
+		"      __csv_match_word(s, len, \"y\") ||\n"
+		"      __csv_match_word(s, len, \"yes\") ||\n"
+		"      __csv_match_word(s, len, \"on\") ||\n"
+		"      __csv_match_word(s, len, \"1\"))\n"
+		"    *p_value = true;\n"
+		"  else if (__csv_match_word(s, len, \"f\") ||\n"
+		"           __csv_match_word(s, len, \"false\") ||\n"
+		"           __csv_match_word(s, len, \"n\") ||\n"
+		"           __csv_match_word(s, len, \"no\") ||\n"
+		"           __csv_match_word(s, len, \"off\") ||\n"
+		"           __csv_match_word(s, len, \"0\"))\n"
+		"    *p_value = false;\n"
+		"  else\n"
+		"    return false;\n"
+		"  return true;\n"
+		"}\n\n"
+		"/*\n"
+		" * __csv_parse_date - ISO 8601 form (YYYY-MM-DD) only\n"
+		" */\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_date(const char *s, cl_uint len, cl_int *p_value)\n"
+		"{\n"
+		"  cl_int   y, m, d;\n"
+		"  cl_int   mdays;\n\n"
+		"  if (len < 10 ||\n"
+		"      !__csv_parse_digits(s, 4, &y) || s[4] != '-' ||\n"
+		"      !__csv_parse_digits(s + 5, 2, &m) || s[7] != '-' ||\n"
+		"      !__csv_parse_digits(s + 8, 2, &d))\n"
+		"    return false;\n"
+		"  if (y < 1 || m < 1 || m > 12 || d < 1)\n"
+		"    return false;\n"
+		"  if (m == 2)\n"
+		"    mdays = ((y % 4 == 0 && (y % 100 != 0 || y % 400 == 0)) ? 29 : 28);\n"
+		"  else if (m == 4 || m == 6 || m == 9 || m == 11)\n"
+		"    mdays = 30;\n"
+		"  else\n"
+		"    mdays = 31;\n"
+		"  if (d > mdays)\n"
+		"    return false;\n"
+		"  /* see date2j() */\n"
+		"  if (m > 2)\n"
+		"  {\n"
+		"    m += 1;\n"
+		"    y += 4800;\n"
+		"  }\n"
+		"  else\n"
+		"  {\n"
+		"    m += 13;\n"
+		"    y += 4799;\n"
+		"  }\n"
+		"  *p_value = (y * 365 - 32167 + y / 4 - y / 100 + y / 400 +\n"
+		"              7834 * m / 256 + d) - CSV_POSTGRES_EPOCH;\n"
+		"  return true;\n"
+		"}\n\n"
+		"/*\n"
+		" * __csv_parse_timestamp - YYYY-MM-DD[ T]HH:MM:SS[.ffffff]\n"
+		" */\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"__csv_parse_timestamp(const char *s, cl_uint len, cl_long *p_value)\n"
+		"{\n"
+		"  cl_int   date, hh, mm, ss;\n"
+		"  cl_int   usec = 0;\n"
+		"  cl_uint  i;\n\n"
+		"  if (len < 19 || !__csv_parse_date(s, 10, &date) ||\n"
+		"      (s[10] != ' ' && s[10] != 'T') ||\n"
+		"      !__csv_parse_digits(s + 11, 2, &hh) || s[13] != ':' ||\n"
+		"      !__csv_parse_digits(s + 14, 2, &mm) || s[16] != ':' ||\n"
+		"      !__csv_parse_digits(s + 17, 2, &ss))\n"
+		"    return false;\n"
+		"  if (hh > 23 || mm > 59 || ss > 59)\n"
+		"    return false;\n"
+		"  if (len > 19)\n"
+		"  {\n"
+		"    if (s[19] != '.' || len == 20 || len > 26 ||\n"
+		"        !__csv_parse_digits(s + 20, len - 20, &usec))\n"
+		"      return false;\n"
+		"    for (i = len; i < 26; i++)\n"
+		"      usec *= 10;\n"
+		"  }\n"
+		"  *p_value = (((cl_long)date * 86400L +\n"
+		"               (cl_long)(hh * 3600 + mm * 60 + ss)) * 1000000L + usec);\n"
+		"  return true;\n"
+		"}\n\n");
+
+	/* per column conversion */
+	appendStringInfoString(
+		&buf,
+		"STATIC_FUNCTION(void)\n"
+		"__csv_convert_field(cl_uint colidx, const char *tok, cl_uint toklen,\n"
+		"                    cl_ulong token, cl_char *p_flags, cl_ulong *p_value)\n"
+		"{\n"
+		"  union {\n"
+		"    cl_long   ival;\n"
+		"    cl_int    date;\n"
+		"    cl_bool   bval;\n"
+		"    cl_float  fval;\n"
+		"    cl_double dval;\n"
+		"    cl_ulong  bits;\n"
+		"  } u;\n\n"
+		"  u.bits = 0;\n"
+		"  if ((*p_flags & CSV_FIELD__ESCAPED) == 0)\n"
+		"  {\n"
+		"    switch (colidx)\n"
+		"    {\n");
+	for (j=0, k=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		const char *conv;
+
+		if (attr->attisdropped)
+			continue;
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+				conv = "__csv_parse_int(tok, toklen, SHRT_MIN, SHRT_MAX, &u.ival)";
+				break;
+			case INT4OID:
+				conv = "__csv_parse_int(tok, toklen, INT_MIN, INT_MAX, &u.ival)";
+				break;
+			case INT8OID:
+				conv = "__csv_parse_int(tok, toklen, LONG_MIN, LONG_MAX, &u.ival)";
+				break;
+			case FLOAT4OID:
+				conv = "__csv_parse_float4(tok, toklen, &u.fval)";
+				break;
+			case FLOAT8OID:
+				conv = "__csv_parse_float8(tok, toklen, &u.dval)";
+				break;
+			case BOOLOID:
+				conv = "__csv_parse_bool(tok, toklen, &u.bval)";
+				break;
+			case DATEOID:
+				conv = "(toklen == 10 && __csv_parse_date(tok, toklen, &u.date))";
+				break;
+			case TIMESTAMPOID:
+				conv = "__csv_parse_timestamp(tok, toklen, &u.ival)";
+				break;
+			default:
+				/* text, varchar; CPU copies the token as is */
+				conv = NULL;
+				break;
+		}
+		if (conv)
+			appendStringInfo(
+				&buf,
+				"    case %d:  /* %s */\n"
+				"      if (%s)\n"
+				"      {\n"
+				"        *p_value = u.bits;\n"
+				"        return;\n"
+				"      }\n"
+				"      break;\n",
+				k, NameStr(attr->attname), conv);
+		else
+			appendStringInfo(
+				&buf,
+				"    case %d:  /* %s */\n"
+				"      *p_value = token;\n"
+				"      return;\n",
+				k, NameStr(attr->attname));
+		k++;
+	}
+	Assert(k == ncols);
+	appendStringInfoString(
+		&buf,
+		"    default:\n"
+		"      break;\n"
+		"    }\n"
+		"  }\n"
+		"  *p_flags |= CSV_FIELD__FALLBACK;\n"
+		"  *p_value = token;\n"
+		"}\n\n");
+
+	/* kernel functions */
+	appendStringInfoString(
+		&buf,
+		"/*\n"
+		" * kern_csv_count_lines - number of lines per CSV_UNITSZ bytes\n"
+		" */\n"
+		"KERNEL_FUNCTION(void)\n"
+		"kern_csv_count_lines(const char *buffer, cl_uint length,\n"
+		"                     cl_uint *nlines)\n"
+		"{\n"
+		"  cl_uint  index;\n\n"
+		"  for (index = get_global_id();\n"
+		"       (size_t)index * CSV_UNITSZ < length;\n"
+		"       index += get_global_size())\n"
+		"  {\n"
+		"    size_t   start = (size_t)index * CSV_UNITSZ;\n"
+		"    size_t   end = Min(start + CSV_UNITSZ, length);\n"
+		"    cl_uint  count = 0;\n\n"
+		"    while (start < end)\n"
+		"    {\n"
+		"      if (buffer[start++] == '\\n')\n"
+		"        count++;\n"
+		"    }\n"
+		"    nlines[index] = count;\n"
+		"  }\n"
+		"}\n\n"
+		"/*\n"
+		" * kern_csv_setup_rows - offsets of the lines; row_base[] is the\n"
+		" * exclusive prefix sum of the number of lines per CSV_UNITSZ.\n"
+		" */\n"
+		"KERNEL_FUNCTION(void)\n"
+		"kern_csv_setup_rows(const char *buffer, cl_uint length,\n"
+		"                    const cl_uint *row_base, cl_uint *row_offsets)\n"
+		"{\n"
+		"  cl_uint  index;\n\n"
+		"  for (index = get_global_id();\n"
+		"       (size_t)index * CSV_UNITSZ < length;\n"
+		"       index += get_global_size())\n"
+		"  {\n"
+		"    size_t   start = (size_t)index * CSV_UNITSZ;\n"
+		"    size_t   end = Min(start + CSV_UNITSZ, length);\n"
+		"    cl_uint  row = row_base[index];\n\n"
+		"    while (start < end)\n"
+		"    {\n"
+		"      if (buffer[start++] == '\\n')\n"
+		"        row_offsets[++row] = start;\n"
+		"    }\n"
+		"  }\n"
+		"}\n\n"
+		"/*\n"
+		" * kern_csv_parse_rows - tokenize the lines and convert the tokens;\n"
+		" * the row with malformed structure is reported by error_row.\n"
+		" */\n"
+		"KERNEL_FUNCTION(void)\n"
+		"kern_csv_parse_rows(const char *buffer,\n"
+		"                    const cl_uint *row_offsets,\n"
+		"                    cl_uint nrows,\n"
+		"                    cl_char delimiter,\n"
+		"                    cl_ulong *values,\n"
+		"                    cl_char *status,\n"
+		"                    cl_uint *error_row)\n"
+		"{\n"
+		"  cl_uint  row;\n\n"
+		"  for (row = get_global_id();\n"
+		"       row < nrows;\n"
+		"       row += get_global_size())\n"
+		"  {\n"
+		"    const char *pos = buffer + row_offsets[row];\n"
+		"    const char *end = buffer + row_offsets[row+1] - 1;\n"
+		"    cl_ulong   *vals = values + (size_t)CSV_NCOLS * row;\n"
+		"    cl_char    *stat = status + (size_t)CSV_NCOLS * row;\n"
+		"    cl_bool     malformed = false;\n"
+		"    cl_uint     j;\n\n"
+		"    if (pos < end && end[-1] == '\\r')\n"
+		"      end--;\n"
+		"    for (j=0; j < CSV_NCOLS && !malformed; j++)\n"
+		"    {\n"
+		"      const char *tok;\n"
+		"      cl_uint     toklen;\n"
+		"      cl_char     flags = 0;\n\n"
+		"      if (j > 0)\n"
+		"      {\n"
+		"        if (pos >= end || *pos != delimiter)\n"
+		"        {\n"
+		"          malformed = true;\n"
+		"          break;\n"
+		"        }\n"
+		"        pos++;\n"
+		"      }\n"
+		"      if (pos < end && *pos == '\"')\n"
+		"      {\n"
+		"        tok = ++pos;\n"
+		"        for (;;)\n"
+		"        {\n"
+		"          if (pos >= end)\n"
+		"          {\n"
+		"            malformed = true;\n"
+		"            break;\n"
+		"          }\n"
+		"          if (*pos == '\"')\n"
+		"          {\n"
+		"            if (pos + 1 < end && pos[1] == '\"')\n"
+		"            {\n"
+		"              flags |= CSV_FIELD__ESCAPED;\n"
+		"              pos += 2;\n"
+		"              continue;\n"
+		"            }\n"
+		"            break;\n"
+		"          }\n"
+		"          if ((*pos & 0x80) != 0 || *pos == '\\0')\n"
+		"            flags |= CSV_FIELD__NONASCII;\n"
+		"          pos++;\n"
+		"        }\n"
+		"        toklen = pos - tok;\n"
+		"        pos++;   /* closing quote */\n"
+		"      }\n"
+		"      else\n"
+		"      {\n"
+		"        tok = pos;\n"
+		"        while (pos < end && *pos != delimiter)\n"
+		"        {\n"
+		"          if ((*pos & 0x80) != 0 || *pos == '\\0')\n"
+		"            flags |= CSV_FIELD__NONASCII;\n"
+		"          pos++;\n"
+		"        }\n"
+		"        toklen = pos - tok;\n"
+		"        if (toklen == 0)\n"
+		"          flags |= CSV_FIELD__NULL;\n"
+		"      }\n"
+		"      if ((flags & CSV_FIELD__NULL) == 0)\n"
+		"        __csv_convert_field(j, tok, toklen,\n"
+		"                            ((cl_ulong)(tok - buffer) << 32) | toklen,\n"
+		"                            &flags, &vals[j]);\n"
+		"      stat[j] = flags;\n"
+		"    }\n"
+		"    if (malformed || pos != end)\n"
+		"      atomicMin(error_row, row);\n"
+		"  }\n"
+		"}\n");
+	return buf.data;
+}
+
+/*
+ * __arrowCsvImportLaunch
+ */
+static void
+__arrowCsvImportLaunch(arrowCsvImportState *cstate,
+					   CUfunction kern_function,
+					   cl_uint nitems, void **kern_args)
+{
+	int			grid_sz;
+	int			block_sz;
+	CUresult	rc;
+
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_function,
+							 cstate->gcontext->cuda_device,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Max(Min(grid_sz, (nitems + block_sz - 1) / block_sz), 1);
+	rc = cuLaunchKernel(kern_function,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+}
+
+/*
+ * __arrowCsvImportExpand - expand the per-row buffers on demand
+ */
+static void
+__arrowCsvImportExpand(arrowCsvImportState *cstate, cl_uint nrows)
+{
+	GpuContext *gcontext = cstate->gcontext;
+	cl_uint		nrooms;
+	CUresult	rc;
+
+	if (nrows <= cstate->nrooms)
+		return;
+	nrooms = Max(nrows, 2 * cstate->nrooms);
+	if (cstate->m_row_offsets)
+		gpuMemFree(gcontext, cstate->m_row_offsets);
+	cstate->m_row_offsets = 0UL;
+	if (cstate->m_values)
+		gpuMemFree(gcontext, cstate->m_values);
+	cstate->m_values = 0UL;
+	if (cstate->m_status)
+		gpuMemFree(gcontext, cstate->m_status);
+	cstate->m_status = 0UL;
+	cstate->nrooms = 0;
+
+	rc = gpuMemAllocManaged(gcontext, &cstate->m_row_offsets,
+							sizeof(cl_uint) * ((size_t)nrooms + 1),
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	rc = gpuMemAllocManaged(gcontext, &cstate->m_values,
+							sizeof(cl_ulong) * cstate->ncols * (size_t)nrooms,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	rc = gpuMemAllocManaged(gcontext, &cstate->m_status,
+							sizeof(cl_char) * cstate->ncols * (size_t)nrooms,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	cstate->nrooms = nrooms;
+}
 
-	/*
-	 * Hmm... no valid metadata cache was not found, so build a new entry
-	 * under the exclusive lock on the arrow file.
-	 */
-	if (!has_exclusive)
+/*
+ * __arrowCsvImportChunk
+ *
+ * It parses the lines in the buffer[0...length-1] on GPU, then appends
+ * the values to the SQLfield buffers. Returns number of the rows.
+ */
+static cl_uint
+__arrowCsvImportChunk(arrowCsvImportState *cstate,
+					  arrowWriteState *aw_state,
+					  TupleDesc tupdesc,
+					  FmgrInfo *fn_input,
+					  Oid *fn_ioparams,
+					  CUdeviceptr m_buffer,
+					  cl_uint length,
+					  char delimiter,
+					  uint64 lineno)
+{
+	SQLtable   *table = &aw_state->sql_table;
+	const char *buffer = (const char *)m_buffer;
+	cl_uint	   *nlines = (cl_uint *)cstate->m_nlines;
+	cl_uint	   *error_row = (cl_uint *)cstate->m_error_row;
+	cl_uint		nunits = (length + ARROW_CSV_UNITSZ - 1) / ARROW_CSV_UNITSZ;
+	cl_uint		nrows = 0;
+	cl_uint		i, row;
+	cl_ulong   *values;
+	cl_char	   *status;
+	StringInfoData tokbuf;
+	MemoryContext oldcxt;
+	void	   *kern_args[7];
+
+	/* count number of lines per unit, then make the prefix sum */
+	kern_args[0] = &m_buffer;
+	kern_args[1] = &length;
+	kern_args[2] = &cstate->m_nlines;
+	__arrowCsvImportLaunch(cstate, cstate->kern_count_lines,
+						   nunits, kern_args);
+	for (i=0; i < nunits; i++)
 	{
-		LWLockRelease(lock);
-		LWLockAcquire(lock, LW_EXCLUSIVE);
-		has_exclusive = true;
-		goto retry;
+		cl_uint		count = nlines[i];
+
+		nlines[i] = nrows;
+		nrows += count;
 	}
-	else
+	if (nrows == 0)
+		return 0;
+	__arrowCsvImportExpand(cstate, nrows);
+
+	/* offsets of the lines */
+	((cl_uint *)cstate->m_row_offsets)[0] = 0;
+	kern_args[0] = &m_buffer;
+	kern_args[1] = &length;
+	kern_args[2] = &cstate->m_nlines;
+	kern_args[3] = &cstate->m_row_offsets;
+	__arrowCsvImportLaunch(cstate, cstate->kern_setup_rows,
+						   nunits, kern_args);
+
+	/* tokenize and convert */
+	*error_row = UINT_MAX;
+	kern_args[0] = &m_buffer;
+	kern_args[1] = &cstate->m_row_offsets;
+	kern_args[2] = &nrows;
+	kern_args[3] = &delimiter;
+	kern_args[4] = &cstate->m_values;
+	kern_args[5] = &cstate->m_status;
+	kern_args[6] = &cstate->m_error_row;
+	__arrowCsvImportLaunch(cstate, cstate->kern_parse_rows,
+						   nrows, kern_args);
+	if (*error_row != UINT_MAX)
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("arrow_fdw: malformed CSV line %lu",
+						lineno + *error_row + 1),
+				 errdetail("number of the columns mismatch, or unterminated quoted field (newline in the quoted field is not supported)")));
+
+	/* append the values to the SQLfield buffers */
+	values = (cl_ulong *)cstate->m_values;
+	status = (cl_char *)cstate->m_status;
+	initStringInfo(&tokbuf);
+	oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
+	for (row=0; row < nrows; row++)
 	{
-		ArrowFileInfo	af_info;
-		arrowMetadataCache *mcache;
-		List		   *rb_state_any = NIL;
+		size_t		usage = 0;
+		int			j, k;
 
-		readArrowFileDesc(FileGetRawDesc(fdesc), &af_info);
-		if (af_info.dictionaries != NULL)
-			elog(ERROR, "DictionaryBatch is not supported");
-		Assert(af_info.footer._num_dictionaries == 0);
-
-		if (af_info.recordBatches == NULL)
-			elog(DEBUG2, "arrow file '%s' contains no RecordBatch",
-				 FilePathName(fdesc));
-		for (index = 0; index < af_info.footer._num_recordBatches; index++)
-		{
-			RecordBatchState *rb_state;
-			ArrowBlock       *block
-				= &af_info.footer.recordBatches[index];
-			ArrowRecordBatch *rbatch
-				= &af_info.recordBatches[index].body.recordBatch;
-
-			rb_state = makeRecordBatchState(&af_info.footer.schema,
-											block, rbatch);
-			rb_state->fdesc = fdesc;
-			memcpy(&rb_state->stat_buf, &stat_buf, sizeof(struct stat));
-			rb_state->rb_index = index;
+		CHECK_FOR_INTERRUPTS();
 
-			if (checkArrowRecordBatchIsVisible(rb_state, mvcc_slot))
-				results = lappend(results, rb_state);
-			rb_state_any = lappend(rb_state_any, rb_state);
+		for (j=0, k=0; j < tupdesc->natts; j++)
+		{
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+			SQLfield   *column = &table->columns[j];
+			cl_ulong	value;
+			cl_char		flags;
+			char	   *tok;
+			cl_uint		toklen;
+
+			if (attr->attisdropped)
+			{
+				usage += sql_field_put_value(column, NULL, 0);
+				continue;
+			}
+			value = values[(size_t)cstate->ncols * row + k];
+			flags = status[(size_t)cstate->ncols * row + k];
+			k++;
+			if ((flags & ARROW_CSV_FIELD__NULL) != 0)
+			{
+				usage += sql_field_put_value(column, NULL, 0);
+				continue;
+			}
+			if (attr->attbyval && (flags & ARROW_CSV_FIELD__FALLBACK) == 0)
+			{
+				/* converted on GPU */
+				usage += sql_field_put_value(column, (char *)&value,
+											 attr->attlen);
+				continue;
+			}
+			tok = (char *)buffer + (value >> 32);
+			toklen = (value & 0xffffffffU);
+			if ((flags & ARROW_CSV_FIELD__NONASCII) != 0)
+				pg_verifymbstr(tok, toklen, false);
+			resetStringInfo(&tokbuf);
+			if ((flags & ARROW_CSV_FIELD__ESCAPED) != 0)
+			{
+				for (i=0; i < toklen; i++)
+				{
+					appendStringInfoChar(&tokbuf, tok[i]);
+					if (tok[i] == '"')
+						i++;
+				}
+			}
+			else
+				appendBinaryStringInfo(&tokbuf, tok, toklen);
+
+			if (attr->attbyval)
+			{
+				Datum	datum = InputFunctionCall(&fn_input[j],
+												  tokbuf.data,
+												  fn_ioparams[j],
+												  attr->atttypmod);
+				usage += sql_field_put_value(column, (char *)&datum,
+											 attr->attlen);
+			}
+			else
+			{
+				int		len = tokbuf.len;
+
+				/* see varchar_input() */
+				if (attr->atttypid == VARCHAROID &&
+					attr->atttypmod >= (int32) VARHDRSZ &&
+					len > attr->atttypmod - VARHDRSZ)
+				{
+					int		maxlen = attr->atttypmod - VARHDRSZ;
+					int		mbmaxlen = pg_mbcharcliplen(tokbuf.data,
+														len, maxlen);
+					for (i=mbmaxlen; i < len; i++)
+					{
+						if (tokbuf.data[i] != ' ')
+							ereport(ERROR,
+									(errcode(ERRCODE_STRING_DATA_RIGHT_TRUNCATION),
+									 errmsg("value too long for type character varying(%d)",
+											maxlen)));
+					}
+					len = mbmaxlen;
+				}
+				usage += sql_field_put_value(column, tokbuf.data, len);
+			}
 		}
-		/* try to build a metadata cache for further references */
-		mcache = __arrowBuildMetadataCache(rb_state_any, key.hash);
-		if (mcache)
+		table->nitems++;
+		/* write out the buffer, like __arrowExecForeignInsert */
+		if (usage > table->segment_sz)
 		{
-			dlist_push_head(hash_slot, &mcache->chain);
-			SpinLockAcquire(&arrow_metadata_state->lru_lock);
-            dlist_push_head(&arrow_metadata_state->lru_list,
-							&mcache->lru_chain);
-			SpinLockRelease(&arrow_metadata_state->lru_lock);
+			MemoryContextSwitchTo(oldcxt);
+			writeOutArrowRecordBatch(aw_state, false);
+			MemoryContextSwitchTo(aw_state->memcxt);
 		}
 	}
-	LWLockRelease(lock);
-	/*
-	 * reclaim unreferenced metadata cache entries based on LRU, if shared-
-	 * memory consumption exceeds the configured threshold.
-	 */
-	arrowReclaimMetadataCache();
+	MemoryContextSwitchTo(oldcxt);
+	pfree(tokbuf.data);
 
-	return results;
+	return nrows;
 }
 
 /*
- * setupArrowSQLbufferSchema
+ * __arrowCsvImportFile
  */
-static void
-__setupArrowSQLbufferField(SQLtable *table,
-						   SQLfield *column,
-						   const char *attname,
-						   Oid atttypid,
-						   int atttypmod)
+static uint64
+__arrowCsvImportFile(arrowCsvImportState *cstate,
+					 arrowWriteState *aw_state,
+					 TupleDesc tupdesc,
+					 int fdesc, const char *filename,
+					 bool header, char delimiter)
 {
-	HeapTuple		tup;
-	Form_pg_type	typ;
-	const char	   *typnamespace;
-	const char	   *timezone = show_timezone();
-
-	tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(atttypid));
-	if (!HeapTupleIsValid(tup))
-		elog(ERROR, "cache lookup failed for type: %u", atttypid);
-	typ = (Form_pg_type) GETSTRUCT(tup);
-	typnamespace = get_namespace_name(typ->typnamespace);
+	char	   *buffer = (char *)cstate->m_buffer;
+	FmgrInfo   *fn_input = palloc0(sizeof(FmgrInfo) * tupdesc->natts);
+	Oid		   *fn_ioparams = palloc0(sizeof(Oid) * tupdesc->natts);
+	size_t		nbytes = 0;
+	uint64		lineno = 0;
+	uint64		nitems = 0;
+	bool		eof = false;
+	int			j;
 
-	table->numFieldNodes++;
-    table->numBuffers +=
-		assignArrowTypePgSQL(column,
-							 attname,
-							 atttypid,
-							 atttypmod,
-							 NameStr(typ->typname),
-							 typnamespace,
-							 typ->typlen,
-							 typ->typbyval,
-							 typ->typtype,
-							 typ->typalign,
-							 typ->typrelid,
-							 typ->typelem,
-							 timezone,
-							 NULL);
-	if (OidIsValid(typ->typelem))
+	for (j=0; j < tupdesc->natts; j++)
 	{
-		/* array type */
-		char		elem_name[NAMEDATALEN+10];
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		Oid			fn_oid;
 
-		snprintf(elem_name, sizeof(elem_name), "_%s[]", attname);
-		column->element = palloc0(sizeof(SQLfield));
-		__setupArrowSQLbufferField(table,
-								   column->element,
-								   elem_name,
-								   typ->typelem,
-								   -1);
+		if (attr->attisdropped || !attr->attbyval)
+			continue;
+		getTypeInputInfo(attr->atttypid, &fn_oid, &fn_ioparams[j]);
+		fmgr_info(fn_oid, &fn_input[j]);
 	}
-	else if (OidIsValid(typ->typrelid))
+
+	while (!eof || nbytes > 0)
 	{
-		/* composite type */
-		TupleDesc	tupdesc = lookup_rowtype_tupdesc(atttypid, atttypmod);
-		int			j;
+		char	   *pos;
+		size_t		length;
+		size_t		skip = 0;
 
-		column->nfields = tupdesc->natts;
-		column->subfields = palloc0(sizeof(SQLfield) * tupdesc->natts);
-		for (j=0; j < tupdesc->natts; j++)
+		CHECK_FOR_INTERRUPTS();
+
+		/* fill up the buffer */
+		while (!eof && nbytes < cstate->bufsz)
 		{
-			Form_pg_attribute sattr = tupleDescAttr(tupdesc, j);
-			__setupArrowSQLbufferField(table,
-									   &column->subfields[j],
-									   NameStr(sattr->attname),
-									   sattr->atttypid,
-									   sattr->atttypmod);
+			ssize_t		rv = read(fdesc, buffer + nbytes,
+								  cstate->bufsz - nbytes);
+			if (rv < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read file \"%s\": %m", filename)));
+			}
+			if (rv == 0)
+				eof = true;
+			nbytes += rv;
 		}
-		ReleaseTupleDesc(tupdesc);
-	}
-	else if (typ->typtype == 'e')
-	{
-		elog(ERROR, "Enum type is not supported right now");
+		if (nbytes == 0)
+			break;
+		/* chunk shall be split at the line boundary */
+		if (eof)
+		{
+			if (buffer[nbytes-1] != '\n')
+				buffer[nbytes++] = '\n';	/* bufsz + 1 bytes */
+			length = nbytes;
+		}
+		else
+		{
+			pos = memrchr(buffer, '\n', nbytes);
+			if (!pos)
+				ereport(ERROR,
+						(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+						 errmsg("arrow_fdw: too long CSV line %lu in \"%s\"",
+								lineno + 1, filename)));
+			length = (pos - buffer) + 1;
+		}
+		/* skip the header line */
+		if (header)
+		{
+			pos = memchr(buffer, '\n', length);
+			Assert(pos != NULL);
+			skip = (pos - buffer) + 1;
+			lineno++;
+			header = false;
+		}
+		if (skip < length)
+		{
+			cl_uint		nrows;
+
+			nrows = __arrowCsvImportChunk(cstate,
+										  aw_state,
+										  tupdesc,
+										  fn_input,
+										  fn_ioparams,
+										  cstate->m_buffer + skip,
+										  length - skip,
+										  delimiter,
+										  lineno);
+			lineno += nrows;
+			nitems += nrows;
+		}
+		/* move the remaining partial line */
+		nbytes -= length;
+		if (nbytes > 0)
+			memmove(buffer, buffer + length, nbytes);
 	}
-	ReleaseSysCache(tup);
+	pfree(fn_input);
+	pfree(fn_ioparams);
+
+	return nitems;
 }
 
+/*
+ * __arrowCsvImportCleanup
+ */
 static void
-setupArrowSQLbufferSchema(SQLtable *table, TupleDesc tupdesc)
+__arrowCsvImportCleanup(arrowCsvImportState *cstate)
 {
-	int		j;
+	GpuContext *gcontext = cstate->gcontext;
 
-	table->nfields = tupdesc->natts;
-	for (j=0; j < tupdesc->natts; j++)
-	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
-		__setupArrowSQLbufferField(table,
-								   &table->columns[j],
-								   NameStr(attr->attname),
-								   attr->atttypid,
-								   attr->atttypmod);
-	}
-	table->segment_sz = (size_t)arrow_record_batch_size_kb << 10;
+	if (!gcontext)
+		return;
+	if (cstate->m_status)
+		gpuMemFree(gcontext, cstate->m_status);
+	if (cstate->m_values)
+		gpuMemFree(gcontext, cstate->m_values);
+	if (cstate->m_row_offsets)
+		gpuMemFree(gcontext, cstate->m_row_offsets);
+	if (cstate->m_error_row)
+		gpuMemFree(gcontext, cstate->m_error_row);
+	if (cstate->m_nlines)
+		gpuMemFree(gcontext, cstate->m_nlines);
+	if (cstate->m_buffer)
+		gpuMemFree(gcontext, cstate->m_buffer);
+	PutGpuContext(gcontext);
+	cstate->gcontext = NULL;
 }
 
-static void
-setupArrowSQLbufferBatches(SQLtable *table)
+/*
+ * pgstrom_arrow_fdw_import_csv
+ *
+ * It loads the CSV file on the server filesystem to the writable arrow_fdw
+ * foreign table, using GPU for tokenization and type conversion.
+ */
+Datum
+pgstrom_arrow_fdw_import_csv(PG_FUNCTION_ARGS)
 {
-	ArrowFileInfo af_info;
-	struct stat	stat_buf;
-	MetadataCacheKey key;
-	uint32		index;
-	int			i, nitems;
-	loff_t		pos = 0;
+	Oid			frel_oid = PG_GETARG_OID(0);
+	char	   *filename = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	bool		header = PG_GETARG_BOOL(2);
+	char	   *delimiter = text_to_cstring(PG_GETARG_TEXT_PP(3));
+	Relation	frel;
+	TupleDesc	tupdesc;
+	ForeignTable *ft;
+	FdwRoutine *routine;
+	bool		writable;
+	arrowWriteState *aw_state;
+	arrowCsvImportState cstate;
+	volatile ProgramId program_id = INVALID_PROGRAM_ID;
+	volatile int fdesc = -1;
+	uint64		nitems = 0;
+	int			j;
 
-	if (fstat(table->fdesc, &stat_buf) != 0)
-		elog(ERROR, "failed on fstat('%s'): %m", table->filename);
-	memset(&key, 0, sizeof(key));
-	key.st_dev = stat_buf.st_dev;
-	key.st_ino = stat_buf.st_ino;
-	key.hash = hash_any((unsigned char *)&key,
-						offsetof(MetadataCacheKey, hash));
-	index = key.hash % ARROW_METADATA_HASH_NSLOTS;
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to import a server file")));
+	if (!is_absolute_path(filename))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_NAME),
+				 errmsg("relative path not allowed for import of a server file")));
+	if (strlen(delimiter) != 1 ||
+		delimiter[0] == '"' || delimiter[0] == '\r' || delimiter[0] == '\n' ||
+		IS_HIGHBIT_SET(delimiter[0]))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("CSV delimiter must be a single one-byte character, except for double-quote and newline")));
 
-	LWLockAcquire(&arrow_metadata_state->lock_slots[index], LW_SHARED);
-	readArrowFileDesc(table->fdesc, &af_info);
-	LWLockRelease(&arrow_metadata_state->lock_slots[index]);
+	frel = table_open(frel_oid, RowExclusiveLock);
+	if (frel->rd_rel->relkind != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not arrow_fdw foreign table",
+						RelationGetRelationName(frel))));
+	routine = GetFdwRoutineForRelation(frel, false);
+	if (memcmp(routine, &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not arrow_fdw foreign table",
+						RelationGetRelationName(frel))));
+	ft = GetForeignTable(RelationGetRelid(frel));
+	__arrowFdwExtractFilesList(ft->options, NULL, &writable);
+	if (!writable)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
+			 RelationGetRelationName(frel));
+	strom_foreign_table_aclcheck(frel_oid, GetUserId(), ACL_INSERT);
 
-	/* restore DictionaryBatches already in the file */
-	nitems = af_info.footer._num_dictionaries;
-	table->numDictionaries = nitems;
-	if (nitems > 0)
+	tupdesc = RelationGetDescr(frel);
+	memset(&cstate, 0, sizeof(arrowCsvImportState));
+	for (j=0; j < tupdesc->natts; j++)
 	{
-		table->dictionaries = palloc(sizeof(ArrowBlock) * nitems);
-		memcpy(table->dictionaries,
-			   af_info.footer.dictionaries,
-			   sizeof(ArrowBlock) * nitems);
-		for (i=0; i < nitems; i++)
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+
+		if (attr->attisdropped)
+			continue;
+		switch (attr->atttypid)
 		{
-			ArrowBlock *block = &table->dictionaries[i];
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+			case BOOLOID:
+			case DATEOID:
+			case TIMESTAMPOID:
+			case TEXTOID:
+			case VARCHAROID:
+				break;
+			default:
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("arrow_fdw: CSV import to column \"%s\" of %s is not supported",
+								NameStr(attr->attname),
+								format_type_be(attr->atttypid))));
+		}
+		cstate.ncols++;
+	}
+	if (cstate.ncols == 0)
+		elog(ERROR, "arrow_fdw: foreign table \"%s\" has no columns",
+			 RelationGetRelationName(frel));
+
+	fdesc = open(filename, O_RDONLY);
+	if (fdesc < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", filename)));
+	aw_state = __arrowOpenWriteState(frel);
+	PG_TRY();
+	{
+		GpuContext *gcontext;
+		CUmodule	cuda_module;
+		CUresult	rc;
+		cl_uint		nunits;
+
+		gcontext = AllocGpuContext(-1, true, false);
+		cstate.gcontext = gcontext;
+		program_id = pgstrom_create_cuda_program(gcontext,
+												 0,
+												 0,
+												 __arrowCsvImportKernelSource(tupdesc, cstate.ncols),
+												 "",
+												 true,
+												 false);
+		cuda_module = GpuContextLookupModule(gcontext, program_id);
+		rc = cuModuleGetFunction(&cstate.kern_count_lines,
+								 cuda_module,
+								 "kern_csv_count_lines");
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+		rc = cuModuleGetFunction(&cstate.kern_setup_rows,
+								 cuda_module,
+								 "kern_csv_setup_rows");
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+		rc = cuModuleGetFunction(&cstate.kern_parse_rows,
+								 cuda_module,
+								 "kern_csv_parse_rows");
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
+		/* read buffer and per-unit buffer */
+		cstate.bufsz = pgstrom_chunk_size();
+		nunits = (cstate.bufsz + 1 + ARROW_CSV_UNITSZ) / ARROW_CSV_UNITSZ;
+		rc = gpuMemAllocManaged(gcontext, &cstate.m_buffer,
+								cstate.bufsz + 1,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+		rc = gpuMemAllocManaged(gcontext, &cstate.m_nlines,
+								sizeof(cl_uint) * nunits,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+		rc = gpuMemAllocManaged(gcontext, &cstate.m_error_row,
+								sizeof(cl_uint),
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
 
-			pos = Max(pos, ARROWALIGN(block->offset +
-									  block->metaDataLength +
-									  block->bodyLength));
-		}
-	}
-	else
-		table->dictionaries = NULL;
+		nitems = __arrowCsvImportFile(&cstate, aw_state, tupdesc,
+									  fdesc, filename,
+									  header, delimiter[0]);
+		writeOutArrowRecordBatch(aw_state, true);
 
-	/* restore RecordBatches already in the file */
-	nitems = af_info.footer._num_recordBatches;
-	table->numRecordBatches = nitems;
-	if (nitems > 0)
+		pgstrom_put_cuda_program(gcontext, program_id);
+		__arrowCsvImportCleanup(&cstate);
+	}
+	PG_CATCH();
 	{
-		table->recordBatches = palloc(sizeof(ArrowBlock) * nitems);
-		memcpy(table->recordBatches,
-			   af_info.footer.recordBatches,
-			   sizeof(ArrowBlock) * nitems);
-		for (i=0; i < nitems; i++)
-		{
-			ArrowBlock *block = &table->recordBatches[i];
-
-			pos = Max(pos, ARROWALIGN(block->offset +
-									  block->metaDataLength +
-									  block->bodyLength));
-		}
+		if (cstate.gcontext && program_id != INVALID_PROGRAM_ID)
+			pgstrom_put_cuda_program(cstate.gcontext, program_id);
+		__arrowCsvImportCleanup(&cstate);
+		close(fdesc);
+		PG_RE_THROW();
 	}
-	else
-		table->recordBatches = NULL;
+	PG_END_TRY();
+	close(fdesc);
 
-	if (lseek(table->fdesc, pos, SEEK_SET) < 0)
-		elog(ERROR, "failed on lseek('%s',%lu): %m",
-			 table->filename, pos);
+	table_close(frel, NoLock);
+
+	PG_RETURN_INT64(nitems);
 }
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_import_csv);
 
-/*
- * createArrowWriteState
- */
-static arrowWriteState *
-createArrowWriteState(Relation frel, File file, bool redo_log_written)
+static void
+__applyArrowTruncateRedoLog(arrowWriteRedoLog *redo, bool is_commit)
 {
-	TupleDesc		tupdesc = RelationGetDescr(frel);
-	arrowWriteState *aw_state;
-	SQLtable	   *table;
-	struct stat		stat_buf;
-	MetadataCacheKey key;
-
-	if (fstat(FileGetRawDesc(file), &stat_buf) != 0)
-		elog(ERROR, "failed on fstat('%s'): %m", FilePathName(file));
-	memset(&key, 0, sizeof(key));
-	key.st_dev = stat_buf.st_dev;
-	key.st_ino = stat_buf.st_ino;
-	key.hash = hash_any((unsigned char *)&key,
-						offsetof(MetadataCacheKey, hash));
-	aw_state = palloc0(offsetof(arrowWriteState,
-								sql_table.columns[tupdesc->natts]));
-	aw_state->memcxt = CurrentMemoryContext;
-	aw_state->file = file;
-	aw_state->key = key;
-	aw_state->hash = key.hash;
-	aw_state->redo_log_written = redo_log_written;
-	table = &aw_state->sql_table;
-	table->filename = FilePathName(file);
-	table->fdesc = FileGetRawDesc(file);
-	setupArrowSQLbufferSchema(table, tupdesc);
-	if (!redo_log_written)
-		setupArrowSQLbufferBatches(table);
+	char		backup[MAXPGPATH];
 
-	return aw_state;
+	snprintf(backup, MAXPGPATH, "%s.%u.backup",
+			 redo->pathname, redo->suffix);
+	if (is_commit)
+	{
+		elog(DEBUG2, "arrow-redo: unlink [%s]", backup);
+		if (unlink(backup) != 0)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("could not remove truncated file \"%s\": %m",
+							backup),
+					 errhint("remove the \"%s\" manually", backup)));
+	}
+	else
+	{
+		elog(DEBUG2, "arrow-redo: rename [%s]->[%s]", backup, redo->pathname);
+		if (rename(backup, redo->pathname) != 0)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("could not restore backup file \"%s\": %m",
+							backup),
+					 errhint("please restore \"%s\" to \"%s\" manually",
+							 backup, redo->pathname)));
+	}
 }
 
-/*
- * createArrowWriteRedoLog
- */
 static void
-createArrowWriteRedoLog(File filp, bool is_newfile)
+__applyArrowInsertRedoLog(arrowWriteRedoLog *redo, bool is_commit)
 {
-	arrowWriteRedoLog *redo;
-	int				fdesc = FileGetRawDesc(filp);
-	const char	   *fname = FilePathName(filp);
-	TransactionId	curr_xid = GetCurrentTransactionId();
-	CommandId		curr_cid = GetCurrentCommandId(true);
-	dlist_iter		iter;
-	MetadataCacheKey key;
-	struct stat		stat_buf;
-	size_t			main_sz;
-
-	if (fstat(fdesc, &stat_buf) != 0)
-		elog(ERROR, "failed on fstat(2): %m");
+	int		fdesc;
+	
+	if (is_commit)
+		return;
 
-	dlist_foreach(iter, &arrow_write_redo_list)
+	/* special case, if it was an empty file */
+	if (redo->footer_offset == 0 &&
+		redo->footer_length == 0)
 	{
-		redo = dlist_container(arrowWriteRedoLog, chain, iter.cur);
-
-		if (redo->key.st_dev == stat_buf.st_dev &&
-			redo->key.st_ino == stat_buf.st_ino &&
-			redo->xid    == curr_xid &&
-			redo->cid    <= curr_cid)
-		{
-			/* nothing to do */
-			return;
-		}
+		if (unlink(redo->pathname) != 0)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("failed on truncate('%s'): %m", redo->pathname),
+					 errdetail("could not apply REDO image, therefore, garbages are still remained")));
+		return;
 	}
 
-	memset(&key, 0, sizeof(MetadataCacheKey));
-	key.st_dev = stat_buf.st_dev;
-	key.st_ino = stat_buf.st_ino;
-	key.hash = hash_any((unsigned char *)&key,
-						offsetof(MetadataCacheKey, hash));
-	if (is_newfile)
+	fdesc = open(redo->pathname, O_RDWR);
+	if (fdesc < 0)
 	{
-		main_sz = MAXALIGN(offsetof(arrowWriteRedoLog, footer_backup));
-		redo = MemoryContextAllocZero(CacheMemoryContext,
-									  main_sz + strlen(fname) + 1);
-		redo->key = key;
-		redo->xid = curr_xid;
-		redo->cid = curr_cid;
-		redo->pathname = (char *)redo + main_sz;
-		strcpy(redo->pathname, fname);
-		redo->is_truncate = false;
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("failed on open('%s'): %m", redo->pathname),
+				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
 	}
-	else
+	else if (lseek(fdesc, redo->footer_offset, SEEK_SET) < 0)
 	{
-		ssize_t			nbytes;
-		off_t			offset;
-		char			temp[100];
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("failed on lseek('%s'): %m", redo->pathname),
+				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
+	}
+	else if (__writeFile(fdesc,
+						 redo->footer_backup,
+						 redo->footer_length) != redo->footer_length)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("failed on write('%s'): %m", redo->pathname),
+				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
+	}
+	else if (ftruncate(fdesc, (redo->footer_offset +
+							   redo->footer_length)) != 0)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("failed on ftruncate('%s'): %m", redo->pathname),
+				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
+	}
+	close(fdesc);
 
-		/* make backup image of the Footer section */
-		nbytes = sizeof(int32) + 6;		/* = strlen("ARROW1") */
-		offset = lseek(fdesc, -nbytes, SEEK_END);
-		if (offset < 0)
-			elog(ERROR, "failed on lseek(2): %m");
-		if (__readFile(fdesc, temp, nbytes) != nbytes)
-			elog(ERROR, "failed on read(2): %m");
-		offset -= *((int32 *)temp);
+	elog(DEBUG2, "arrow_fdw: REDO log applied (xid=%u, cid=%u, file=[%s], offset=%zu, length=%zu)", redo->xid, redo->cid, redo->pathname, redo->footer_offset, redo->footer_length);
+}
 
-		nbytes = stat_buf.st_size - offset;
-		if (nbytes <= 0)
-			elog(ERROR, "strange apache arrow format");
-		main_sz = MAXALIGN(offsetof(arrowWriteRedoLog,
-									footer_backup[nbytes]));
-		redo = MemoryContextAllocZero(CacheMemoryContext,
-									  main_sz + strlen(fname) + 1);
-		redo->key = key;
-		redo->xid = curr_xid;
-		redo->cid = curr_cid;
-		redo->pathname = (char *)redo + main_sz;
-		strcpy(redo->pathname, fname);
-		PG_TRY();
+static void
+__cleanupArrowWriteMVCCLog(TransactionId curr_xid, dlist_head *mvcc_slot)
+{
+	dlist_mutable_iter iter;
+
+	dlist_foreach_modify(iter, mvcc_slot)
+	{
+		arrowWriteMVCCLog *mvcc = dlist_container(arrowWriteMVCCLog,
+												  chain, iter.cur);
+		if (mvcc->xid == curr_xid)
 		{
-			if (lseek(fdesc, -nbytes, SEEK_END) < 0)
-				elog(ERROR, "failed on lseek(2): %m");
-			if (__readFile(fdesc, redo->footer_backup, nbytes) != nbytes)
-				elog(ERROR, "failed on read(2): %m");
-			if (lseek(fdesc, -nbytes, SEEK_END) < 0)
-				elog(ERROR, "failed on lseek(2): %m");
-			redo->footer_offset = offset;
-			redo->footer_length = nbytes;
+			dlist_delete(&mvcc->chain);
+			elog(DEBUG2, "arrow: release mvcc-log (st_dev=%u, st_ino=%u), xid=%u, cid=%u, record_batch=%u",
+				 (uint32)mvcc->key.st_dev, (uint32)mvcc->key.st_ino,
+				 (uint32)mvcc->xid, (uint32)mvcc->cid, mvcc->record_batch);
+			pfree(mvcc);
 		}
-		PG_CATCH();
+	}
+}
+
+/*
+ * __arrowFdwXactCallback
+ */
+static void
+__arrowFdwXactCallback(TransactionId curr_xid, bool is_commit)
+{
+	arrowWriteRedoLog  *redo;
+	dlist_mutable_iter	iter;
+	CommandId			curr_cid = InvalidCommandId;
+	uint32				index;
+	bool				locked[ARROW_METADATA_HASH_NSLOTS];
+	LWLock			   *locks[ARROW_METADATA_HASH_NSLOTS];
+	uint32				lcount = 0;
+
+	if (curr_xid == InvalidTransactionId ||
+		dlist_is_empty(&arrow_write_redo_list))
+		return;
+
+	memset(locked, 0, sizeof(locked));
+	dlist_foreach_modify(iter, &arrow_write_redo_list)
+	{
+		redo = dlist_container(arrowWriteRedoLog, chain, iter.cur);
+		if (redo->xid != curr_xid)
+			continue;
+		if (curr_cid != InvalidCommandId &&
+			curr_cid < redo->cid)
+			elog(WARNING, "Bug? Order of REDO log is not be correct. ABORT transaction might generate wrong image restored.");
+
+		index = redo->key.hash % ARROW_METADATA_HASH_NSLOTS;
+		if (!locked[index])
 		{
-			pfree(redo);
-			PG_RE_THROW();
+			LWLock	   *lock = &arrow_metadata_state->lock_slots[index];
+			dlist_head *slot = &arrow_metadata_state->mvcc_slots[index];
+
+			LWLockAcquire(lock, LW_EXCLUSIVE);
+			__cleanupArrowWriteMVCCLog(curr_xid, slot);
+			locked[index] = true;
+			locks[lcount++] = lock;
 		}
-		PG_END_TRY();
+		if (redo->is_truncate)
+			__applyArrowTruncateRedoLog(redo, is_commit);
+		else
+			__applyArrowInsertRedoLog(redo, is_commit);
+
+		dlist_delete(&redo->chain);
+		pfree(redo);
 	}
-	elog(DEBUG2, "arrow: redo-log on '%s' (st_dev=%u/st_ino=%u) xid=%u cid=%u offset=%lu length=%zu",
-		 redo->pathname, (uint32)redo->key.st_dev, (uint32)redo->key.st_ino,
-		 (uint32)redo->xid, (uint32)redo->cid,
-		 (uint64)redo->footer_offset,
-		 (uint64)redo->footer_length);
 
-	dlist_push_head(&arrow_write_redo_list, &redo->chain);
+	for (index=0; index < lcount; index++)
+		LWLockRelease(locks[index]);
 }
 
 /*
- * writeOutArrowRecordBatch
+ * arrowFdwXactCallback
  */
 static void
-writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
+arrowFdwXactCallback(XactEvent event, void *arg)
 {
-	SQLtable   *table = &aw_state->sql_table;
-	int			index = aw_state->hash % ARROW_METADATA_HASH_NSLOTS;
-	struct stat	stat_buf;
-	ssize_t		nbytes;
-	arrowWriteMVCCLog *mvcc = NULL;
-
-	if (table->nitems > 0)
-	{
-		mvcc = MemoryContextAllocZero(TopSharedMemoryContext,
-									  sizeof(arrowWriteMVCCLog));
-		mvcc->key = aw_state->key;
-		mvcc->xid = GetCurrentTransactionId();
-		mvcc->cid = GetCurrentCommandId(true);
-	}
+	TransactionId	curr_xid = GetCurrentTransactionIdIfAny();
 
-	PG_TRY();
-	{
-		LWLockAcquire(&arrow_metadata_state->lock_slots[index],
-					  LW_EXCLUSIVE);
-		/* get the latest state of the file */
-		if (fstat(table->fdesc, &stat_buf) != 0)
-			elog(ERROR, "failed on fstat('%s'): %m", table->filename);
-		/* make a REDO log entry */
-		if (!aw_state->redo_log_written)
-		{
-			createArrowWriteRedoLog(aw_state->file, false);
-			aw_state->redo_log_written = true;
-		}
-		/* write out an empty arrow file */
-		if (stat_buf.st_size == 0)
-		{
-			Assert(lseek(table->fdesc, 0, SEEK_END) == 0);
-			nbytes = __writeFile(table->fdesc, "ARROW1\0\0", 8);
-			if (nbytes != 8)
-				elog(ERROR, "failed on __writeFile('%s'): %m",
-					 table->filename);
-			writeArrowSchema(table);
-		}
-		if (table->nitems > 0)
-		{
-			mvcc->record_batch = writeArrowRecordBatch(table);
-			dlist_push_tail(&arrow_metadata_state->mvcc_slots[index],
-							&mvcc->chain);
-			elog(DEBUG2,
-				 "arrow-write: '%s' (st_dev=%u, st_ino=%u), xid=%u, cid=%u, record_batch=%u",
-				 FilePathName(aw_state->file),
-				 (uint32)mvcc->key.st_dev, (uint32)mvcc->key.st_ino,
-				 (uint32)mvcc->xid, (uint32)mvcc->cid, mvcc->record_batch);
-		}
-		if (with_footer)
-			writeArrowFooter(table);
-		LWLockRelease(&arrow_metadata_state->lock_slots[index]);
-	}
-	PG_CATCH();
-	{
-		if (mvcc)
-			pfree(mvcc);
-		PG_RE_THROW();
-	}
-	PG_END_TRY();
+	if (event == XACT_EVENT_COMMIT)
+		__arrowFdwXactCallback(curr_xid, true);
+	else if (event == XACT_EVENT_ABORT)
+		__arrowFdwXactCallback(curr_xid, false);
 }
 
 /*
- * TRUNCATE support
+ * arrowFdwSubXactCallback
  */
 static void
-__arrowExecTruncateRelation(Relation frel)
+arrowFdwSubXactCallback(SubXactEvent event, SubTransactionId mySubid,
+						SubTransactionId parentSubid, void *arg)
 {
-	TupleDesc	tupdesc = RelationGetDescr(frel);
-	Oid			frel_oid = RelationGetRelid(frel);
-	ForeignTable *ft = GetForeignTable(frel_oid);
-	arrowWriteRedoLog *redo;
-	struct stat	stat_buf;
-	MetadataCacheKey key;
-	List	   *filesList;
-	SQLtable   *table;
-	const char *path_name;
-	const char *dir_name;
-	const char *file_name;
-	size_t		main_sz;
-	int			fdesc = -1;
-	int			nbytes;
-	char		backup_path[MAXPGPATH];
-	bool		writable;
+	TransactionId	curr_xid = GetCurrentTransactionIdIfAny();
 
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	if (!writable)
-		elog(ERROR, "arrow_fdw: foreign table \"%s\" is not writable",
-			 RelationGetRelationName(frel));
-	Assert(list_length(filesList) == 1);
-	path_name = strVal(linitial(filesList));
-	if (stat(path_name, &stat_buf) != 0)
-		elog(ERROR, "failed on stat('%s'): %m", path_name);
-	memset(&key, 0, sizeof(key));
-	key.st_dev = stat_buf.st_dev;
-	key.st_ino = stat_buf.st_ino;
-	key.hash = hash_any((unsigned char *)&key,
-						offsetof(MetadataCacheKey, hash));
-	/* build SQLtable to write out schema */
-	table = palloc0(offsetof(SQLtable, columns[tupdesc->natts]));
-	setupArrowSQLbufferSchema(table, tupdesc);
+	if (event == SUBXACT_EVENT_COMMIT_SUB)
+		__arrowFdwXactCallback(curr_xid, true);
+	else if (event == SUBXACT_EVENT_ABORT_SUB)
+		__arrowFdwXactCallback(curr_xid, false);
+}
 
-	/* create REDO log entry */
-	main_sz = MAXALIGN(offsetof(arrowWriteRedoLog, footer_backup));
-	redo = MemoryContextAllocZero(CacheMemoryContext,
-								  main_sz + strlen(path_name) + 1);
-	redo->key    = key;
-	redo->xid    = GetCurrentTransactionId();
-	redo->cid    = GetCurrentCommandId(true);
-	redo->pathname = (char *)redo + main_sz;
-	strcpy(redo->pathname, path_name);
-	redo->is_truncate = true;
+/*
+ * putArrowGpuBuffer
+ *
+ * NOTE: caller must have exclusive lock on gpubuf_locks[]
+ */
+static void
+putArrowGpuBuffer(ArrowGpuBuffer *gpubuf)
+{
+	CUresult	rc;
+	uint32 count;
 
-	PG_TRY();
+	if ((count = pg_atomic_sub_fetch_u32(&gpubuf->refcnt, 1)) == 0)
 	{
-		/*
-		 * move the current arrow file to the backup
-		 */
-		dir_name = dirname(pstrdup(path_name));
-		file_name = basename(pstrdup(path_name));
-		for (;;)
-		{
-			redo->suffix = random();
-			snprintf(backup_path, sizeof(backup_path),
-					 "%s/%s.%u.backup",
-					 dir_name, file_name, redo->suffix);
-			if (stat(backup_path, &stat_buf) != 0)
-			{
-				if (errno == ENOENT)
-					break;
-				elog(ERROR, "failed on stat('%s'): %m", backup_path);
-			}
-		}
-		if (rename(path_name, backup_path) != 0)
-			elog(ERROR, "failed on rename('%s','%s'): %m",
-				 path_name, backup_path);
-
-		/*
-		 * create an empty arrow file
-		 */
-		PG_TRY();
-		{
-			fdesc = open(path_name, O_RDWR | O_CREAT | O_EXCL, 0600);
-			if (fdesc < 0)
-				elog(ERROR, "failed on open('%s'): %m", path_name);
-			table->filename = path_name;
-			table->fdesc = fdesc;
-			nbytes = __writeFile(fdesc, "ARROW1\0\0", 8);
-			if (nbytes != 8)
-				elog(ERROR, "failed on __writeFile('%s'): %m", path_name);
-			writeArrowSchema(table);
-			writeArrowFooter(table);
-		}
-		PG_CATCH();
-		{
-			if (fdesc >= 0)
-				close(fdesc);
-			if (rename(backup_path, path_name) != 0)
-				elog(WARNING, "failed on rename('%s', '%s'): %m",
-					 backup_path, path_name);
-			PG_RE_THROW();
-		}
-		PG_END_TRY();
-		close(fdesc);
+		rc = gpuMemFreePreserved(gpubuf->cuda_dindex,
+								 gpubuf->ipc_mhandle);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFreePreserved: %s", errorText(rc));
+		dlist_delete(&gpubuf->chain);
+		if (gpubuf->rbatches)
+			pfree(gpubuf->rbatches);
+		pfree(gpubuf);
 	}
-	PG_CATCH();
+}
+
+/*
+ * putAllArrowGpuBuffer - callback function when session is closed
+ */
+static void
+putAllArrowGpuBuffer(int code, Datum arg)
+{
+	/*
+	 * In case of urgent termination, we shall not touch existing GPU
+	 * buffer any more. It shall be destructed due to process termination
+	 * of GPU memory keeper.
+	 */
+	if (code != 0)
+		return;
+	
+	while (!dlist_is_empty(&arrow_gpu_buffer_tracker_list))
 	{
-		pfree(redo);
-		PG_RE_THROW();
+		ArrowGpuBufferTracker *tracker;
+		dlist_node *dnode;
+		uint32		index;
+		LWLock	   *lock;
+
+		dnode = dlist_pop_head_node(&arrow_gpu_buffer_tracker_list);
+		tracker = dlist_container(ArrowGpuBufferTracker, chain, dnode);
+		index = tracker->gpubuf->hash % ARROW_GPUBUF_HASH_NSLOTS;
+		lock = &arrow_metadata_state->gpubuf_locks[index];
+
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		putArrowGpuBuffer(tracker->gpubuf);
+		LWLockRelease(lock);
+
+		elog(DEBUG2, "arrow GPU buffer [%s] was released", tracker->ident);
+		
+		pfree(tracker);
 	}
-	PG_END_TRY();
-	/* save the REDO log entry */
-	dlist_push_head(&arrow_write_redo_list, &redo->chain);
 }
 
 /*
- * pgstrom_arrow_fdw_truncate
+ * BuildArrowGpuBufferCupy
  */
-Datum
-pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS)
+/*
+ * __lookupArrowGpuBufferBatch - lookup a record batch resident on the
+ * GPU buffer to be refreshed
+ */
+static ArrowGpuBufferBatch *
+__lookupArrowGpuBufferBatch(ArrowGpuBuffer *gpubuf_old,
+							RecordBatchState *rb_state)
 {
-	Oid			frel_oid = PG_GETARG_OID(0);
-	Relation	frel;
-	FdwRoutine *routine;
-
-	frel = table_open(frel_oid, AccessExclusiveLock);
-	if (frel->rd_rel->relkind != RELKIND_FOREIGN_TABLE)
-		ereport(ERROR,
-				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
-				 errmsg("\"%s\" is not arrow_fdw foreign table",
-						RelationGetRelationName(frel))));
-	routine = GetFdwRoutineForRelation(frel, false);
-	if (memcmp(routine, &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) != 0)
-		ereport(ERROR,
-				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
-				 errmsg("\"%s\" is not arrow_fdw foreign table",
-						RelationGetRelationName(frel))));
-	__arrowExecTruncateRelation(frel);
+	int			i;
 
-	table_close(frel, NoLock);
+	if (!gpubuf_old)
+		return NULL;
+	for (i=0; i < gpubuf_old->num_rbatches; i++)
+	{
+		ArrowGpuBufferBatch *rbatch = &gpubuf_old->rbatches[i];
 
-	PG_RETURN_VOID();
+		if (rbatch->st_dev    == rb_state->stat_buf.st_dev &&
+			rbatch->st_ino    == rb_state->stat_buf.st_ino &&
+			rbatch->rb_offset == rb_state->rb_offset &&
+			rbatch->rb_nitems == rb_state->rb_nitems)
+			return rbatch;
+	}
+	return NULL;
 }
-PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_truncate);
 
-static void
-__applyArrowTruncateRedoLog(arrowWriteRedoLog *redo, bool is_commit)
+/*
+ * BuildArrowGpuBufferCupy
+ *
+ * If gpubuf_old is supplied, record batches already loaded onto the older
+ * GPU buffer are copied from the device memory, and only the record batches
+ * appended later are read from the files.
+ */
+static ArrowGpuBuffer *
+BuildArrowGpuBufferCupy(Relation frel,
+						List *attNums,
+						List *rb_state_list,
+						struct timespec timestamp,
+						int cuda_dindex,
+						Oid element_oid,
+						size_t nrooms,
+						bool pinned,
+						ArrowGpuBuffer *gpubuf_old)
 {
-	char		backup[MAXPGPATH];
+	GpuContext *gcontext = NULL;
+	ArrowGpuBuffer *gpubuf = NULL;
+	int			min_dindex = (cuda_dindex >= 0 ? cuda_dindex : 0);
+	int			max_dindex = (cuda_dindex >= 0 ? cuda_dindex : numDevAttrs-1);
+	int			nattrs = list_length(attNums);
+	const char *np_typename;
+	size_t		unitsz;
+	size_t		nbytes;
+	char	   *mmap_ptr = NULL;
+	size_t		mmap_len = 0UL;
+	CUdeviceptr	gmem_ptr = 0UL;
+	CUdeviceptr	gmem_old = 0UL;
+	CUipcMemHandle ipc_mhandle;
+	ListCell   *lc;
+	int			index;
+	CUresult	rc = CUDA_ERROR_NO_DEVICE;
 
-	snprintf(backup, MAXPGPATH, "%s.%u.backup",
-			 redo->pathname, redo->suffix);
-	if (is_commit)
-	{
-		elog(DEBUG2, "arrow-redo: unlink [%s]", backup);
-		if (unlink(backup) != 0)
-			ereport(WARNING,
-					(errcode_for_file_access(),
-					 errmsg("could not remove truncated file \"%s\": %m",
-							backup),
-					 errhint("remove the \"%s\" manually", backup)));
-	}
-	else
+	/* refresh shall be built on the same device */
+	if (gpubuf_old)
+		min_dindex = max_dindex = gpubuf_old->cuda_dindex;
+	/* get type name */
+	switch (element_oid)
 	{
-		elog(DEBUG2, "arrow-redo: rename [%s]->[%s]", backup, redo->pathname);
-		if (rename(backup, redo->pathname) != 0)
-			ereport(WARNING,
-					(errcode_for_file_access(),
-					 errmsg("could not restore backup file \"%s\": %m",
-							backup),
-					 errhint("please restore \"%s\" to \"%s\" manually",
-							 backup, redo->pathname)));
+		case INT2OID:
+			unitsz = sizeof(uint16);
+			np_typename = "int16";
+			break;
+		case FLOAT2OID:
+			unitsz = sizeof(uint16);
+			np_typename = "float16";
+			break;
+		case INT4OID:
+			unitsz = sizeof(uint32);
+			np_typename = "int32";
+			break;
+		case FLOAT4OID:
+			unitsz = sizeof(uint32);
+			np_typename = "float32";
+			break;
+		case INT8OID:
+			unitsz = sizeof(uint64);
+			np_typename = "int64";
+			break;
+		case FLOAT8OID:
+			unitsz = sizeof(uint64);
+			np_typename = "float64";
+			break;
+		default:
+			elog(ERROR, "not a supported data type: %s",
+				 format_type_be(element_oid));
 	}
-}
-
-static void
-__applyArrowInsertRedoLog(arrowWriteRedoLog *redo, bool is_commit)
-{
-	int		fdesc;
 	
-	if (is_commit)
-		return;
-
-	/* special case, if it was an empty file */
-	if (redo->footer_offset == 0 &&
-		redo->footer_length == 0)
+	/*
+	 * Allocation of the preserved device memory
+	 */
+	nbytes = unitsz * nattrs * nrooms;
+	for (cuda_dindex =  min_dindex; cuda_dindex <= max_dindex; cuda_dindex++)
 	{
-		if (unlink(redo->pathname) != 0)
-			ereport(WARNING,
-					(errcode_for_file_access(),
-					 errmsg("failed on truncate('%s'): %m", redo->pathname),
-					 errdetail("could not apply REDO image, therefore, garbages are still remained")));
-		return;
+		rc = gpuMemAllocPreserved(cuda_dindex,
+								  &ipc_mhandle,
+								  nbytes);
+		if (rc == CUDA_SUCCESS)
+			break;
 	}
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocPreserved: %s", errorText(rc));
 
-	fdesc = open(redo->pathname, O_RDWR);
-	if (fdesc < 0)
-	{
-		ereport(WARNING,
-				(errcode_for_file_access(),
-				 errmsg("failed on open('%s'): %m", redo->pathname),
-				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
-	}
-	else if (lseek(fdesc, redo->footer_offset, SEEK_SET) < 0)
-	{
-		ereport(WARNING,
-				(errcode_for_file_access(),
-				 errmsg("failed on lseek('%s'): %m", redo->pathname),
-				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
-	}
-	else if (__writeFile(fdesc,
-						 redo->footer_backup,
-						 redo->footer_length) != redo->footer_length)
-	{
-		ereport(WARNING,
-				(errcode_for_file_access(),
-				 errmsg("failed on write('%s'): %m", redo->pathname),
-				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
-	}
-	else if (ftruncate(fdesc, (redo->footer_offset +
-							   redo->footer_length)) != 0)
+	PG_TRY();
 	{
-		ereport(WARNING,
-				(errcode_for_file_access(),
-				 errmsg("failed on ftruncate('%s'): %m", redo->pathname),
-				 errdetail("could not apply REDO image, therefore, arrow file might be corrupted")));
-	}
-	close(fdesc);
+		StringInfoData ident;
+		File		curr_filp = -1;
+		size_t		row_index = 0;
+		int			j = 0;
+
+		/*
+		 * Build identifier string
+		 */
+		initStringInfo(&ident);
+		appendStringInfo(&ident,
+						 "device_id=%d,bytesize=%zu,ipc_handle=",
+						 devAttrs[cuda_dindex].DEV_ID,
+						 nbytes);
+		enlargeStringInfo(&ident, 2 * sizeof(CUipcMemHandle));
+		hex_encode((const char *)&ipc_mhandle,
+				   sizeof(CUipcMemHandle),
+				   ident.data + ident.len);
+		ident.len += 2 * sizeof(CUipcMemHandle);
+		appendStringInfo(&ident,",format=cupy-%s,nitems=%zu,table_oid=%u",
+						 np_typename,
+						 nattrs * nrooms,
+						 RelationGetRelid(frel));
+		appendStringInfoString(&ident, ",attnums=");
+		foreach (lc, attNums)
+		{
+			if (lc != list_head(attNums))
+				appendStringInfoChar(&ident,' ');
+			appendStringInfo(&ident, "%d", lfirst_int(lc));
+		}
+
+		/*
+		 * setup ArrowGpuBuffer
+		 */
+		gpubuf = MemoryContextAllocZero(TopSharedMemoryContext,
+										MAXALIGN(offsetof(ArrowGpuBuffer,
+														  attnums[nattrs])) +
+										MAXALIGN(ident.len + 1));
+		pg_atomic_init_u32(&gpubuf->refcnt, pinned ? 2 : 1);
+		gpubuf->pinned = pinned;
+		gpubuf->cuda_dindex = cuda_dindex;
+		memcpy(&gpubuf->ipc_mhandle, &ipc_mhandle, sizeof(CUipcMemHandle));
+		gpubuf->timestamp = timestamp;
+		gpubuf->nbytes = nbytes;
+		gpubuf->nrooms = nrooms;
+		gpubuf->element_oid = element_oid;
+		gpubuf->rbatches = MemoryContextAlloc(TopSharedMemoryContext,
+											  sizeof(ArrowGpuBufferBatch) *
+											  list_length(rb_state_list));
+		gpubuf->frel_oid = RelationGetRelid(frel);
+		gpubuf->format = ARROW_GPUBUF_FORMAT__CUPY;
+		gpubuf->nattrs = nattrs;
+		foreach (lc, attNums)
+			gpubuf->attnums[j++] = lfirst_int(lc);
+		gpubuf->hash = hash_any((unsigned char *)&gpubuf->frel_oid,
+								offsetof(ArrowGpuBuffer, attnums[nattrs]) -
+								offsetof(ArrowGpuBuffer, frel_oid));
+		gpubuf->ident = (char *)&gpubuf->attnums[nattrs];
+		strcpy(gpubuf->ident, ident.data);
+
+		/*
+		 * Open GPU device memory, and load the array from apache arrow files
+		 */
+		gcontext = AllocGpuContext(cuda_dindex, true, false);
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &gmem_ptr,
+								 gpubuf->ipc_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+		if (gpubuf_old)
+		{
+			rc = gpuIpcOpenMemHandle(gcontext,
+									 &gmem_old,
+									 gpubuf_old->ipc_mhandle,
+									 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+		}
+		foreach (lc, rb_state_list)
+		{
+			RecordBatchState *rb_state = lfirst(lc);
+			ArrowGpuBufferBatch *rbatch;
+
+			rbatch = &gpubuf->rbatches[gpubuf->num_rbatches++];
+			rbatch->st_dev    = rb_state->stat_buf.st_dev;
+			rbatch->st_ino    = rb_state->stat_buf.st_ino;
+			rbatch->rb_offset = rb_state->rb_offset;
+			rbatch->rb_nitems = rb_state->rb_nitems;
+			rbatch->row_index = row_index;
+
+			/*
+			 * copy the record batch already resident on the older buffer
+			 */
+			if (gmem_old)
+			{
+				ArrowGpuBufferBatch *rb_old
+					= __lookupArrowGpuBufferBatch(gpubuf_old, rb_state);
 
-	elog(DEBUG2, "arrow_fdw: REDO log applied (xid=%u, cid=%u, file=[%s], offset=%zu, length=%zu)", redo->xid, redo->cid, redo->pathname, redo->footer_offset, redo->footer_length);
-}
+				if (rb_old)
+				{
+					for (j=0; j < gpubuf->nattrs; j++)
+					{
+						rc = cuMemcpyDtoD(gmem_ptr + unitsz * (row_index +
+															   j * gpubuf->nrooms),
+										  gmem_old + unitsz * (rb_old->row_index +
+															   j * gpubuf_old->nrooms),
+										  unitsz * rb_state->rb_nitems);
+						if (rc != CUDA_SUCCESS)
+							elog(ERROR, "failed on cuMemcpyDtoD: %s", errorText(rc));
+					}
+					row_index += rb_state->rb_nitems;
+					continue;
+				}
+			}
 
-static void
-__cleanupArrowWriteMVCCLog(TransactionId curr_xid, dlist_head *mvcc_slot)
-{
-	dlist_mutable_iter iter;
+			if (rb_state->fdesc != curr_filp)
+			{
+				if (mmap_ptr)
+				{
+					if (munmap(mmap_ptr, mmap_len) != 0)
+						elog(ERROR, "failed on munmap: %m");
+					mmap_ptr = NULL;
+				}
+				mmap_len = (rb_state->stat_buf.st_size +
+							PAGE_SIZE - 1) & ~PAGE_MASK;
+				mmap_ptr = mmap(NULL, mmap_len,
+								PROT_READ, MAP_SHARED,
+								FileGetRawDesc(rb_state->fdesc), 0);
+				if (mmap_ptr == MAP_FAILED)
+				{
+					mmap_ptr = NULL;
+					elog(ERROR, "failed on mmap: %m");
+				}
+				curr_filp = rb_state->fdesc;
+			}
+			/*
+			 * copy array to device memory
+			 */
+			for (j=0; j < gpubuf->nattrs; j++)
+			{
+				RecordBatchFieldState *column;
+				int			attnum = gpubuf->attnums[j];
+				size_t		hoffset = rb_state->rb_offset;
+				size_t		doffset;
+				size_t		length;
+				size_t		padding = 0;
 
-	dlist_foreach_modify(iter, mvcc_slot)
-	{
-		arrowWriteMVCCLog *mvcc = dlist_container(arrowWriteMVCCLog,
-												  chain, iter.cur);
-		if (mvcc->xid == curr_xid)
+				if (attnum <= 0 || attnum > rb_state->ncols)
+					elog(ERROR, "arrow_fdw: virtual partition-key column is not supported to export");
+				column = &rb_state->columns[attnum-1];
+				if (rb_state->rb_parquet)
+					elog(ERROR, "arrow_fdw: Parquet file is not supported to export");
+				if (column->dict_unitsz > 0)
+					elog(ERROR, "arrow_fdw: dictionary-encoded column is not supported to export");
+				hoffset += column->values_offset;
+				
+				doffset = unitsz * (row_index + j * gpubuf->nrooms);
+				length = unitsz * Min(rb_state->rb_nitems, column->nitems);
+				if (length > column->values_length)
+					length = column->values_length;
+				if (length < unitsz * rb_state->rb_nitems)
+					padding = unitsz * rb_state->rb_nitems - length;
+				rc = cuMemcpyHtoD(gmem_ptr + doffset,
+								  mmap_ptr + hoffset,
+								  length);
+				if (rc != CUDA_SUCCESS)
+					elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+				if (padding > 0)
+				{
+					rc = cuMemsetD8(gmem_ptr + doffset + length, 0, padding);
+					if (rc != CUDA_SUCCESS)
+						elog(ERROR, "failed on cuMemsetD8: %s", errorText(rc));
+				}
+			}
+			row_index += rb_state->rb_nitems;
+		}
+		if (mmap_ptr)
 		{
-			dlist_delete(&mvcc->chain);
-			elog(DEBUG2, "arrow: release mvcc-log (st_dev=%u, st_ino=%u), xid=%u, cid=%u, record_batch=%u",
-				 (uint32)mvcc->key.st_dev, (uint32)mvcc->key.st_ino,
-				 (uint32)mvcc->xid, (uint32)mvcc->cid, mvcc->record_batch);
-			pfree(mvcc);
+			if (munmap(mmap_ptr, mmap_len) != 0)
+				elog(ERROR, "failed on munmap: %m");
+		}
+		if (gmem_old)
+		{
+			rc = gpuIpcCloseMemHandle(gcontext, gmem_old);
+			if (rc != CUDA_SUCCESS)
+				elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
+					 errorText(rc));
 		}
+		rc = gpuIpcCloseMemHandle(gcontext, gmem_ptr);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
+				 errorText(rc));
+		PutGpuContext(gcontext);
 	}
-}
-
-/*
- * __arrowFdwXactCallback
- */
-static void
-__arrowFdwXactCallback(TransactionId curr_xid, bool is_commit)
-{
-	arrowWriteRedoLog  *redo;
-	dlist_mutable_iter	iter;
-	CommandId			curr_cid = InvalidCommandId;
-	uint32				index;
-	bool				locked[ARROW_METADATA_HASH_NSLOTS];
-	LWLock			   *locks[ARROW_METADATA_HASH_NSLOTS];
-	uint32				lcount = 0;
-
-	if (curr_xid == InvalidTransactionId ||
-		dlist_is_empty(&arrow_write_redo_list))
-		return;
-
-	memset(locked, 0, sizeof(locked));
-	dlist_foreach_modify(iter, &arrow_write_redo_list)
+	PG_CATCH();
 	{
-		redo = dlist_container(arrowWriteRedoLog, chain, iter.cur);
-		if (redo->xid != curr_xid)
-			continue;
-		if (curr_cid != InvalidCommandId &&
-			curr_cid < redo->cid)
-			elog(WARNING, "Bug? Order of REDO log is not be correct. ABORT transaction might generate wrong image restored.");
-
-		index = redo->key.hash % ARROW_METADATA_HASH_NSLOTS;
-		if (!locked[index])
+		if (mmap_ptr)
 		{
-			LWLock	   *lock = &arrow_metadata_state->lock_slots[index];
-			dlist_head *slot = &arrow_metadata_state->mvcc_slots[index];
-
-			LWLockAcquire(lock, LW_EXCLUSIVE);
-			__cleanupArrowWriteMVCCLog(curr_xid, slot);
-			locked[index] = true;
-			locks[lcount++] = lock;
+			if (munmap(mmap_ptr, mmap_len) != 0)
+				elog(WARNING, "failed on munmap: %m");
 		}
-		if (redo->is_truncate)
-			__applyArrowTruncateRedoLog(redo, is_commit);
-		else
-			__applyArrowInsertRedoLog(redo, is_commit);
-
-		dlist_delete(&redo->chain);
-		pfree(redo);
+		if (gcontext)
+			PutGpuContext(gcontext);
+		if (gpubuf)
+		{
+			if (gpubuf->rbatches)
+				pfree(gpubuf->rbatches);
+			pfree(gpubuf);
+		}
+		rc = gpuMemFreePreserved(cuda_dindex, ipc_mhandle);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFreePreserved: %s",
+				 errorText(rc));
+		PG_RE_THROW();
 	}
+	PG_END_TRY();
 
-	for (index=0; index < lcount; index++)
-		LWLockRelease(locks[index]);
-}
-
-/*
- * arrowFdwXactCallback
- */
-static void
-arrowFdwXactCallback(XactEvent event, void *arg)
-{
-	TransactionId	curr_xid = GetCurrentTransactionIdIfAny();
-
-	if (event == XACT_EVENT_COMMIT)
-		__arrowFdwXactCallback(curr_xid, true);
-	else if (event == XACT_EVENT_ABORT)
-		__arrowFdwXactCallback(curr_xid, false);
-}
-
-/*
- * arrowFdwSubXactCallback
- */
-static void
-arrowFdwSubXactCallback(SubXactEvent event, SubTransactionId mySubid,
-						SubTransactionId parentSubid, void *arg)
-{
-	TransactionId	curr_xid = GetCurrentTransactionIdIfAny();
-
-	if (event == SUBXACT_EVENT_COMMIT_SUB)
-		__arrowFdwXactCallback(curr_xid, true);
-	else if (event == SUBXACT_EVENT_ABORT_SUB)
-		__arrowFdwXactCallback(curr_xid, false);
+	index = gpubuf->hash % ARROW_GPUBUF_HASH_NSLOTS;
+	dlist_push_tail(&arrow_metadata_state->gpubuf_slots[index],
+					&gpubuf->chain);
+	return gpubuf;
 }
 
 /*
- * putArrowGpuBuffer
+ * BuildArrowGpuBufferColumns
  *
- * NOTE: caller must have exclusive lock on gpubuf_locks[]
+ * It loads the raw Arrow representation of the columns onto the device
+ * memory without type conversion; each column has its own values, validity
+ * bitmap (if any nulls), and int32 offsets + extra buffer (if variable
+ * length), aligned to 64 bytes. The values and extra buffer are copied from
+ * the record batches as is, and only the bitmaps and offsets are rebuilt
+ * to concatenate record batches.
  */
-static void
-putArrowGpuBuffer(ArrowGpuBuffer *gpubuf)
-{
-	CUresult	rc;
-	uint32 count;
+#define ARROW_GPUBUF_ALIGN(x)		TYPEALIGN(64,(x))
 
-	if ((count = pg_atomic_sub_fetch_u32(&gpubuf->refcnt, 1)) == 0)
-	{
-		rc = gpuMemFreePreserved(gpubuf->cuda_dindex,
-								 gpubuf->ipc_mhandle);
-		if (rc != CUDA_SUCCESS)
-			elog(WARNING, "failed on gpuMemFreePreserved: %s", errorText(rc));
-		dlist_delete(&gpubuf->chain);
-		pfree(gpubuf);
-	}
-}
+typedef struct
+{
+	const char *type_name;		/* Arrow type to be exported */
+	int			unitsz;			/* >0: fixed-length, 0: bool, -1: varlena */
+	bool		has_nullmap;
+	size_t		values_offset;	/* offset from the head of device memory */
+	size_t		nullmap_offset;
+	size_t		extra_offset;
+	size_t		extra_length;
+} ArrowGpuBufferColumn;
 
-/*
- * putAllArrowGpuBuffer - callback function when session is closed
- */
-static void
-putAllArrowGpuBuffer(int code, Datum arg)
+static const char *
+__arrowGpuBufferColumnType(RecordBatchFieldState *fstate, int *p_unitsz)
 {
-	/*
-	 * In case of urgent termination, we shall not touch existing GPU
-	 * buffer any more. It shall be destructed due to process termination
-	 * of GPU memory keeper.
-	 */
-	if (code != 0)
-		return;
-	
-	while (!dlist_is_empty(&arrow_gpu_buffer_tracker_list))
+	if (fstate->dict_unitsz > 0)
+		elog(ERROR, "arrow_fdw: dictionary-encoded column is not supported to export");
+	switch (fstate->atttypid)
 	{
-		ArrowGpuBufferTracker *tracker;
-		dlist_node *dnode;
-		uint32		index;
-		LWLock	   *lock;
-
-		dnode = dlist_pop_head_node(&arrow_gpu_buffer_tracker_list);
-		tracker = dlist_container(ArrowGpuBufferTracker, chain, dnode);
-		index = tracker->gpubuf->hash % ARROW_GPUBUF_HASH_NSLOTS;
-		lock = &arrow_metadata_state->gpubuf_locks[index];
-
-		LWLockAcquire(lock, LW_EXCLUSIVE);
-		putArrowGpuBuffer(tracker->gpubuf);
-		LWLockRelease(lock);
-
-		elog(DEBUG2, "arrow GPU buffer [%s] was released", tracker->ident);
-		
-		pfree(tracker);
+		case BOOLOID:
+			*p_unitsz = 0;
+			return "bool";
+		case INT2OID:
+			*p_unitsz = sizeof(int16);
+			return "int16";
+		case INT4OID:
+			*p_unitsz = sizeof(int32);
+			return "int32";
+		case INT8OID:
+			*p_unitsz = sizeof(int64);
+			return "int64";
+		case FLOAT2OID:
+			*p_unitsz = sizeof(uint16);
+			return "float16";
+		case FLOAT4OID:
+			*p_unitsz = sizeof(float4);
+			return "float32";
+		case FLOAT8OID:
+			*p_unitsz = sizeof(float8);
+			return "float64";
+		case DATEOID:
+			if (fstate->attopts.date.unit == ArrowDateUnit__Day)
+			{
+				*p_unitsz = sizeof(int32);
+				return "date32";
+			}
+			*p_unitsz = sizeof(int64);
+			return "date64";
+		case TIMEOID:
+			switch (fstate->attopts.time.unit)
+			{
+				case ArrowTimeUnit__Second:
+					*p_unitsz = sizeof(int32);
+					return "time32[s]";
+				case ArrowTimeUnit__MilliSecond:
+					*p_unitsz = sizeof(int32);
+					return "time32[ms]";
+				case ArrowTimeUnit__MicroSecond:
+					*p_unitsz = sizeof(int64);
+					return "time64[us]";
+				case ArrowTimeUnit__NanoSecond:
+					*p_unitsz = sizeof(int64);
+					return "time64[ns]";
+				default:
+					break;
+			}
+			break;
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			*p_unitsz = sizeof(int64);
+			switch (fstate->attopts.timestamp.unit)
+			{
+				case ArrowTimeUnit__Second:
+					return "timestamp[s]";
+				case ArrowTimeUnit__MilliSecond:
+					return "timestamp[ms]";
+				case ArrowTimeUnit__MicroSecond:
+					return "timestamp[us]";
+				case ArrowTimeUnit__NanoSecond:
+					return "timestamp[ns]";
+				default:
+					break;
+			}
+			break;
+		case TEXTOID:
+			*p_unitsz = -1;
+			return "utf8";
+		case BYTEAOID:
+			*p_unitsz = -1;
+			return "binary";
+		default:
+			break;
 	}
+	elog(ERROR, "arrow_fdw: %s is not supported to export",
+		 format_type_be(fstate->atttypid));
 }
 
 /*
- * BuildArrowGpuBufferCupy
+ * __appendArrowBitmap - append bit-packed values at the bit position
  */
+static void
+__appendArrowBitmap(uint8 *dst, size_t dst_pos,
+					const uint8 *src, size_t src_len, size_t nbits)
+{
+	size_t		i;
+
+	for (i=0; i < nbits; i++, dst_pos++)
+	{
+		/* an absent bitmap means all valid */
+		if (!src || (i >> 3) >= src_len || (src[i >> 3] & (1 << (i & 7))) != 0)
+			dst[dst_pos >> 3] |=  (1 << (dst_pos & 7));
+		else
+			dst[dst_pos >> 3] &= ~(1 << (dst_pos & 7));
+	}
+}
+
 static ArrowGpuBuffer *
-BuildArrowGpuBufferCupy(Relation frel,
-						List *attNums,
-						List *rb_state_list,
-						struct timespec timestamp,
-						int cuda_dindex,
-						Oid element_oid,
-						size_t nrooms,
-						bool pinned)
+BuildArrowGpuBufferColumns(Relation frel,
+						   List *attNums,
+						   List *rb_state_list,
+						   struct timespec timestamp,
+						   int cuda_dindex,
+						   size_t nrooms,
+						   bool pinned)
 {
 	GpuContext *gcontext = NULL;
 	ArrowGpuBuffer *gpubuf = NULL;
 	int			min_dindex = (cuda_dindex >= 0 ? cuda_dindex : 0);
 	int			max_dindex = (cuda_dindex >= 0 ? cuda_dindex : numDevAttrs-1);
 	int			nattrs = list_length(attNums);
-	const char *np_typename;
-	size_t		unitsz;
-	size_t		nbytes;
+	RecordBatchState *rb_first = linitial(rb_state_list);
+	ArrowGpuBufferColumn *columns;
+	size_t		nbytes = 0;
 	char	   *mmap_ptr = NULL;
 	size_t		mmap_len = 0UL;
 	CUdeviceptr	gmem_ptr = 0UL;
 	CUipcMemHandle ipc_mhandle;
-	ListCell   *lc;
-	int			index;
+	ListCell   *lc, *cell;
+	int			j, index;
 	CUresult	rc = CUDA_ERROR_NO_DEVICE;
 
-	/* get type name */
-	switch (element_oid)
+	/*
+	 * Layout of the columns on the device memory
+	 */
+	columns = palloc0(sizeof(ArrowGpuBufferColumn) * nattrs);
+	j = 0;
+	foreach (lc, attNums)
 	{
-		case INT2OID:
-			unitsz = sizeof(uint16);
-			np_typename = "int16";
-			break;
-		case FLOAT2OID:
-			unitsz = sizeof(uint16);
-			np_typename = "float16";
-			break;
-		case INT4OID:
-			unitsz = sizeof(uint32);
-			np_typename = "int32";
-			break;
-		case FLOAT4OID:
-			unitsz = sizeof(uint32);
-			np_typename = "float32";
-			break;
-		case INT8OID:
-			unitsz = sizeof(uint64);
-			np_typename = "int64";
-			break;
-		case FLOAT8OID:
-			unitsz = sizeof(uint64);
-			np_typename = "float64";
-			break;
-		default:
-			elog(ERROR, "not a supported data type: %s",
-				 format_type_be(element_oid));
+		ArrowGpuBufferColumn *col = &columns[j++];
+		int			attnum = lfirst_int(lc);
+
+		if (attnum <= 0 || attnum > rb_first->ncols)
+			elog(ERROR, "arrow_fdw: virtual partition-key column is not supported to export");
+		col->type_name = __arrowGpuBufferColumnType(&rb_first->columns[attnum-1],
+													&col->unitsz);
+		foreach (cell, rb_state_list)
+		{
+			RecordBatchState *rb_state = lfirst(cell);
+			RecordBatchFieldState *fstate = &rb_state->columns[attnum-1];
+
+			if (rb_state->rb_codec >= 0)
+				elog(ERROR, "arrow_fdw: compressed record batch is not supported to export");
+			if (fstate->null_count > 0)
+				col->has_nullmap = true;
+			if (col->unitsz < 0)
+				col->extra_length += fstate->extra_length;
+		}
+		col->values_offset = nbytes;
+		if (col->unitsz > 0)
+			nbytes += ARROW_GPUBUF_ALIGN(col->unitsz * nrooms);
+		else if (col->unitsz == 0)
+			nbytes += ARROW_GPUBUF_ALIGN(BITMAPLEN(nrooms));
+		else
+			nbytes += ARROW_GPUBUF_ALIGN(sizeof(uint32) * (nrooms + 1));
+		if (col->has_nullmap)
+		{
+			col->nullmap_offset = nbytes;
+			nbytes += ARROW_GPUBUF_ALIGN(BITMAPLEN(nrooms));
+		}
+		if (col->unitsz < 0)
+		{
+			if (col->extra_length >= (size_t)UINT_MAX)
+				elog(ERROR, "arrow_fdw: variable-length column is too large to export");
+			col->extra_offset = nbytes;
+			nbytes += ARROW_GPUBUF_ALIGN(col->extra_length);
+		}
 	}
-	
+
 	/*
 	 * Allocation of the preserved device memory
 	 */
-	nbytes = unitsz * nattrs * nrooms;
 	for (cuda_dindex =  min_dindex; cuda_dindex <= max_dindex; cuda_dindex++)
 	{
 		rc = gpuMemAllocPreserved(cuda_dindex,
@@ -4765,8 +10030,6 @@ BuildArrowGpuBufferCupy(Relation frel,
 	{
 		StringInfoData ident;
 		File		curr_filp = -1;
-		size_t		row_index = 0;
-		int			j = 0;
 
 		/*
 		 * Build identifier string
@@ -4781,9 +10044,8 @@ BuildArrowGpuBufferCupy(Relation frel,
 				   sizeof(CUipcMemHandle),
 				   ident.data + ident.len);
 		ident.len += 2 * sizeof(CUipcMemHandle);
-		appendStringInfo(&ident,",format=cupy-%s,nitems=%zu,table_oid=%u",
-						 np_typename,
-						 nattrs * nrooms,
+		appendStringInfo(&ident,",format=arrow-columns,nitems=%zu,table_oid=%u",
+						 nrooms,
 						 RelationGetRelid(frel));
 		appendStringInfoString(&ident, ",attnums=");
 		foreach (lc, attNums)
@@ -4792,6 +10054,20 @@ BuildArrowGpuBufferCupy(Relation frel,
 				appendStringInfoChar(&ident,' ');
 			appendStringInfo(&ident, "%d", lfirst_int(lc));
 		}
+		/* type:values:nullmap:extra:extra_length; -1 means no buffer */
+		appendStringInfoString(&ident, ",columns=");
+		for (j=0; j < nattrs; j++)
+		{
+			ArrowGpuBufferColumn *col = &columns[j];
+
+			appendStringInfo(&ident, "%s%s:%zu:%ld:%ld:%zu",
+							 j > 0 ? " " : "",
+							 col->type_name,
+							 col->values_offset,
+							 col->has_nullmap ? (long)col->nullmap_offset : -1L,
+							 col->unitsz < 0 ? (long)col->extra_offset : -1L,
+							 col->extra_length);
+		}
 
 		/*
 		 * setup ArrowGpuBuffer
@@ -4808,8 +10084,9 @@ BuildArrowGpuBufferCupy(Relation frel,
 		gpubuf->nbytes = nbytes;
 		gpubuf->nrooms = nrooms;
 		gpubuf->frel_oid = RelationGetRelid(frel);
-		gpubuf->format = ARROW_GPUBUF_FORMAT__CUPY;
+		gpubuf->format = ARROW_GPUBUF_FORMAT__COLUMNS;
 		gpubuf->nattrs = nattrs;
+		j = 0;
 		foreach (lc, attNums)
 			gpubuf->attnums[j++] = lfirst_int(lc);
 		gpubuf->hash = hash_any((unsigned char *)&gpubuf->frel_oid,
@@ -4819,7 +10096,7 @@ BuildArrowGpuBufferCupy(Relation frel,
 		strcpy(gpubuf->ident, ident.data);
 
 		/*
-		 * Open GPU device memory, and load the array from apache arrow files
+		 * Open GPU device memory, and load the columns from apache arrow files
 		 */
 		gcontext = AllocGpuContext(cuda_dindex, true, false);
 		rc = gpuIpcOpenMemHandle(gcontext,
@@ -4828,70 +10105,140 @@ BuildArrowGpuBufferCupy(Relation frel,
 								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
 		if (rc != CUDA_SUCCESS)
 			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
-		foreach (lc, rb_state_list)
+		for (j=0; j < nattrs; j++)
 		{
-			RecordBatchState *rb_state = lfirst(lc);
-
-			if (rb_state->fdesc != curr_filp)
+			ArrowGpuBufferColumn *col = &columns[j];
+			int			attnum = gpubuf->attnums[j];
+			uint8	   *h_bitmap = NULL;
+			uint8	   *h_nullmap = NULL;
+			uint32	   *h_offsets = NULL;
+			size_t		row_index = 0;
+			size_t		extra_base = 0;
+
+			if (col->unitsz == 0)
+				h_bitmap = MemoryContextAllocExtended(CurrentMemoryContext,
+													  BITMAPLEN(nrooms),
+													  MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+			else if (col->unitsz < 0)
+				h_offsets = MemoryContextAllocExtended(CurrentMemoryContext,
+													   sizeof(uint32) * (nrooms + 1),
+													   MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+			if (col->has_nullmap)
+				h_nullmap = MemoryContextAllocExtended(CurrentMemoryContext,
+													   BITMAPLEN(nrooms),
+													   MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+			curr_filp = -1;
+			foreach (lc, rb_state_list)
 			{
-				if (mmap_ptr)
+				RecordBatchState *rb_state = lfirst(lc);
+				RecordBatchFieldState *fstate = &rb_state->columns[attnum-1];
+				char	   *base;
+				size_t		nitems = Min(rb_state->rb_nitems, fstate->nitems);
+
+				if (rb_state->rb_parquet)
+					elog(ERROR, "arrow_fdw: Parquet file is not supported to export");
+				if (rb_state->fdesc != curr_filp)
 				{
-					if (munmap(mmap_ptr, mmap_len) != 0)
-						elog(ERROR, "failed on munmap: %m");
-					mmap_ptr = NULL;
+					if (mmap_ptr)
+					{
+						if (munmap(mmap_ptr, mmap_len) != 0)
+							elog(ERROR, "failed on munmap: %m");
+						mmap_ptr = NULL;
+					}
+					mmap_len = (rb_state->stat_buf.st_size +
+								PAGE_SIZE - 1) & ~PAGE_MASK;
+					mmap_ptr = mmap(NULL, mmap_len,
+									PROT_READ, MAP_SHARED,
+									FileGetRawDesc(rb_state->fdesc), 0);
+					if (mmap_ptr == MAP_FAILED)
+					{
+						mmap_ptr = NULL;
+						elog(ERROR, "failed on mmap: %m");
+					}
+					curr_filp = rb_state->fdesc;
 				}
-				mmap_len = (rb_state->stat_buf.st_size +
-							PAGE_SIZE - 1) & ~PAGE_MASK;
-				mmap_ptr = mmap(NULL, mmap_len,
-								PROT_READ, MAP_SHARED,
-								FileGetRawDesc(rb_state->fdesc), 0);
-				if (mmap_ptr == MAP_FAILED)
+				base = mmap_ptr + rb_state->rb_offset;
+
+				if (col->unitsz > 0)
 				{
-					mmap_ptr = NULL;
-					elog(ERROR, "failed on mmap: %m");
+					size_t	length = Min(col->unitsz * nitems,
+										 fstate->values_length);
+
+					rc = cuMemcpyHtoD(gmem_ptr + col->values_offset +
+									  col->unitsz * row_index,
+									  base + fstate->values_offset,
+									  length);
+					if (rc != CUDA_SUCCESS)
+						elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
 				}
-				curr_filp = rb_state->fdesc;
+				else if (col->unitsz == 0)
+				{
+					__appendArrowBitmap(h_bitmap, row_index,
+										(uint8 *)(base + fstate->values_offset),
+										fstate->values_length, nitems);
+				}
+				else
+				{
+					uint32	   *offsets = (uint32 *)(base + fstate->values_offset);
+					size_t		k;
+
+					if (fstate->values_length < sizeof(uint32) * (nitems + 1))
+						elog(ERROR, "arrow_fdw: corrupted offset of variable-length values");
+					for (k=0; k <= nitems; k++)
+						h_offsets[row_index + k] = extra_base + offsets[k];
+					if (fstate->extra_length > 0)
+					{
+						rc = cuMemcpyHtoD(gmem_ptr + col->extra_offset + extra_base,
+										  base + fstate->extra_offset,
+										  fstate->extra_length);
+						if (rc != CUDA_SUCCESS)
+							elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+					}
+					extra_base += fstate->extra_length;
+				}
+				if (h_nullmap)
+				{
+					__appendArrowBitmap(h_nullmap, row_index,
+										fstate->null_count > 0
+										? (uint8 *)(base + fstate->nullmap_offset)
+										: NULL,
+										fstate->nullmap_length, nitems);
+				}
+				row_index += nitems;
 			}
-			/*
-			 * copy array to device memory
-			 */
-			for (j=0; j < gpubuf->nattrs; j++)
+			/* rows not loaded (if any) are zero-cleared; nulls */
+			if (h_bitmap)
 			{
-				RecordBatchFieldState *column;
-				int			attnum = gpubuf->attnums[j];
-				size_t		hoffset = rb_state->rb_offset;
-				size_t		doffset;
-				size_t		length;
-				size_t		padding = 0;
-
-				Assert(attnum > 0 && attnum <= rb_state->ncols);
-				column = &rb_state->columns[attnum-1];
-				hoffset += column->values_offset;
-				
-				doffset = unitsz * (row_index + j * gpubuf->nrooms);
-				length = unitsz * Min(rb_state->rb_nitems, column->nitems);
-				if (length > column->values_length)
-					length = column->values_length;
-				if (length < unitsz * rb_state->rb_nitems)
-					padding = unitsz * rb_state->rb_nitems - length;
-				rc = cuMemcpyHtoD(gmem_ptr + doffset,
-								  mmap_ptr + hoffset,
-								  length);
+				rc = cuMemcpyHtoD(gmem_ptr + col->values_offset,
+								  h_bitmap, BITMAPLEN(nrooms));
 				if (rc != CUDA_SUCCESS)
 					elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
-				if (padding > 0)
-				{
-					rc = cuMemsetD8(gmem_ptr + doffset + length, 0, padding);
-					if (rc != CUDA_SUCCESS)
-						elog(ERROR, "failed on cuMemsetD8: %s", errorText(rc));
-				}
+				pfree(h_bitmap);
+			}
+			if (h_offsets)
+			{
+				while (row_index < nrooms)
+					h_offsets[++row_index] = extra_base;
+				rc = cuMemcpyHtoD(gmem_ptr + col->values_offset,
+								  h_offsets, sizeof(uint32) * (nrooms + 1));
+				if (rc != CUDA_SUCCESS)
+					elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+				pfree(h_offsets);
+			}
+			if (h_nullmap)
+			{
+				rc = cuMemcpyHtoD(gmem_ptr + col->nullmap_offset,
+								  h_nullmap, BITMAPLEN(nrooms));
+				if (rc != CUDA_SUCCESS)
+					elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+				pfree(h_nullmap);
 			}
-			row_index += rb_state->rb_nitems;
 		}
 		if (mmap_ptr)
 		{
 			if (munmap(mmap_ptr, mmap_len) != 0)
 				elog(ERROR, "failed on munmap: %m");
+			mmap_ptr = NULL;
 		}
 		rc = gpuIpcCloseMemHandle(gcontext, gmem_ptr);
 		if (rc != CUDA_SUCCESS)
@@ -4917,6 +10264,7 @@ BuildArrowGpuBufferCupy(Relation frel,
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
+	pfree(columns);
 
 	index = gpubuf->hash % ARROW_GPUBUF_HASH_NSLOTS;
 	dlist_push_tail(&arrow_metadata_state->gpubuf_slots[index],
@@ -4925,8 +10273,8 @@ BuildArrowGpuBufferCupy(Relation frel,
 }
 
 static text *
-lookupOrBuildArrowGpuBufferCupy(Relation frel, List *attNums,
-								Oid element_oid, int cuda_dindex, bool pinned)
+lookupOrBuildArrowGpuBuffer(Relation frel, List *attNums, int format,
+							Oid element_oid, int cuda_dindex, bool pinned)
 {
 	Oid				frel_oid = RelationGetRelid(frel);
 	ForeignTable   *ft = GetForeignTable(frel_oid);
@@ -4942,6 +10290,7 @@ lookupOrBuildArrowGpuBufferCupy(Relation frel, List *attNums,
 	bool			has_exclusive = false;
 	dlist_mutable_iter iter;
 	ArrowGpuBuffer *gpubuf, *_key;
+	ArrowGpuBuffer *gpubuf_old;
 	text		   *result = NULL;
 
 	/*
@@ -4984,7 +10333,7 @@ lookupOrBuildArrowGpuBufferCupy(Relation frel, List *attNums,
 	memset(_key, 0, offsetof(ArrowGpuBuffer, attnums[nattrs]));
 
 	_key->frel_oid = frel_oid;
-	_key->format = ARROW_GPUBUF_FORMAT__CUPY;
+	_key->format = format;
 	_key->nattrs = nattrs;
 	j = 0;
 	foreach (lc, attNums)
@@ -4997,6 +10346,7 @@ lookupOrBuildArrowGpuBufferCupy(Relation frel, List *attNums,
 	lock = &arrow_metadata_state->gpubuf_locks[index];
 	LWLockAcquire(lock, LW_SHARED);
 retry:
+	gpubuf_old = NULL;
 	dlist_foreach_modify(iter, &arrow_metadata_state->gpubuf_slots[index])
 	{
 		gpubuf = dlist_container(ArrowGpuBuffer, chain, iter.cur);
@@ -5037,6 +10387,24 @@ retry:
 			}
 			goto found;
 		}
+
+		/*
+		 * The older GPU buffer of the same columns; record batches already
+		 * loaded can be reused on refresh, instead of reload from the files.
+		 */
+		if (gpubuf->hash == _key->hash &&
+			gpubuf->frel_oid == _key->frel_oid &&
+			gpubuf->format == _key->format &&
+			gpubuf->nattrs == _key->nattrs &&
+            memcmp(gpubuf->attnums, _key->attnums,
+				   sizeof(AttrNumber) * _key->nattrs) == 0 &&
+			(cuda_dindex < 0 || gpubuf->cuda_dindex == cuda_dindex) &&
+			gpubuf->num_rbatches > 0 &&
+			gpubuf->element_oid == element_oid &&
+			timespec_comp(&gpubuf->timestamp, &timestamp) < 0 &&
+			(!gpubuf_old || timespec_comp(&gpubuf->timestamp,
+										  &gpubuf_old->timestamp) > 0))
+			gpubuf_old = gpubuf;
 	}
 	/* Not found, so create a new Gpu memory buffer */
 	if (!has_exclusive)
@@ -5046,14 +10414,36 @@ retry:
 		has_exclusive = true;
 		goto retry;
 	}
-	gpubuf = BuildArrowGpuBufferCupy(frel,
-									 attNums,
-									 rb_state_list,
-									 timestamp,
-									 cuda_dindex,
-									 element_oid,
-									 nrooms,
-									 pinned);
+	if (format == ARROW_GPUBUF_FORMAT__COLUMNS)
+		gpubuf = BuildArrowGpuBufferColumns(frel,
+											attNums,
+											rb_state_list,
+											timestamp,
+											cuda_dindex,
+											nrooms,
+											pinned);
+	else
+	{
+		gpubuf = BuildArrowGpuBufferCupy(frel,
+										 attNums,
+										 rb_state_list,
+										 timestamp,
+										 cuda_dindex,
+										 element_oid,
+										 nrooms,
+										 pinned,
+										 gpubuf_old);
+		/*
+		 * The refreshed GPU buffer inherits the pin of the older one;
+		 * it is no longer visible to the lookup, and released once all
+		 * the sessions that hold its identifier put it.
+		 */
+		if (gpubuf_old && gpubuf_old->pinned && pinned)
+		{
+			gpubuf_old->pinned = false;
+			putArrowGpuBuffer(gpubuf_old);
+		}
+	}
 	Assert(gpubuf->hash == _key->hash);
 found:
 	/* makes ArrowGpuBufferTracker */
@@ -5100,12 +10490,16 @@ found:
  * pgstrom.arrow_fdw_export_cupy[_pinned](regclass, -- oid of relation
  *                               text[],   -- name of attributes
  *                               int)      -- GPU device-id
+ *
+ * pgstrom.arrow_fdw_export_columns[_pinned] takes the same arguments, but
+ * exports the columns in the raw Arrow representation for each.
  */
 static Datum
-__pgstrom_arrow_fdw_export_cupy(Oid frel_oid,
-								ArrayType *attNames,
-								int device_id,
-								bool pinned)
+__pgstrom_arrow_fdw_export_gpubuf(Oid frel_oid,
+								  ArrayType *attNames,
+								  int device_id,
+								  int format,
+								  bool pinned)
 {
 	int32			cuda_dindex = -1;
 	List		   *attNums = NIL;
@@ -5117,8 +10511,8 @@ __pgstrom_arrow_fdw_export_cupy(Oid frel_oid,
 	text		   *result;
 
 	/* sanity checks */
-	if (ARR_NDIM(attNames) != 1 ||
-		ARR_ELEMTYPE(attNames) != TEXTOID)
+	if (attNames && (ARR_NDIM(attNames) != 1 ||
+					 ARR_ELEMTYPE(attNames) != TEXTOID))
 		elog(ERROR, "column names must be 1-dimensional text array");
 	if (device_id >= 0)
 	{
@@ -5163,7 +10557,8 @@ __pgstrom_arrow_fdw_export_cupy(Oid frel_oid,
 				continue;
 			if (!OidIsValid(element_oid))
 				element_oid = attr->atttypid;
-			else if (element_oid != attr->atttypid)
+			else if (element_oid != attr->atttypid &&
+					 format == ARROW_GPUBUF_FORMAT__CUPY)
 				elog(ERROR, "multiple data types are mixtured in use");
 			attNums = lappend_int(attNums, attr->attnum);
 		}
@@ -5197,7 +10592,8 @@ __pgstrom_arrow_fdw_export_cupy(Oid frel_oid,
 			{
 				if (!OidIsValid(element_oid))
 					element_oid = attr->atttypid;
-				else if (element_oid != attr->atttypid)
+				else if (element_oid != attr->atttypid &&
+						 format == ARROW_GPUBUF_FORMAT__CUPY)
 					elog(ERROR, "multiple data types are mixtured in use");
 				attNums = lappend_int(attNums, attr->attnum);
 			}
@@ -5208,10 +10604,11 @@ __pgstrom_arrow_fdw_export_cupy(Oid frel_oid,
 	}
 	if (attNums == NIL)
 		elog(ERROR, "no valid attributes are specified");
-	result = lookupOrBuildArrowGpuBufferCupy(frel, attNums,
-											 element_oid,
-											 cuda_dindex,
-											 pinned);
+	result = lookupOrBuildArrowGpuBuffer(frel, attNums,
+										 format,
+										 element_oid,
+										 cuda_dindex,
+										 pinned);
 	table_close(frel, AccessShareLock);
 
 	PG_RETURN_TEXT_P(result);
@@ -5232,10 +10629,11 @@ pgstrom_arrow_fdw_export_cupy(PG_FUNCTION_ARGS)
 	if (!PG_ARGISNULL(2))
 		device_id = PG_GETARG_INT32(2);
 
-	PG_RETURN_TEXT_P(__pgstrom_arrow_fdw_export_cupy(frel_oid,
-													 attNames,
-													 device_id,
-													 false));
+	PG_RETURN_TEXT_P(__pgstrom_arrow_fdw_export_gpubuf(frel_oid,
+													   attNames,
+													   device_id,
+													   ARROW_GPUBUF_FORMAT__CUPY,
+													   false));
 }
 PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_export_cupy);
 
@@ -5254,13 +10652,90 @@ pgstrom_arrow_fdw_export_cupy_pinned(PG_FUNCTION_ARGS)
 	if (!PG_ARGISNULL(2))
 		device_id = PG_GETARG_INT32(2);
 
-	PG_RETURN_TEXT_P(__pgstrom_arrow_fdw_export_cupy(frel_oid,
-													 attNames,
-													 device_id,
-													 true));
+	PG_RETURN_TEXT_P(__pgstrom_arrow_fdw_export_gpubuf(frel_oid,
+													   attNames,
+													   device_id,
+													   ARROW_GPUBUF_FORMAT__CUPY,
+													   true));
 }
 PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_export_cupy_pinned);
 
+Datum
+pgstrom_arrow_fdw_export_columns(PG_FUNCTION_ARGS)
+{
+	Oid			frel_oid = InvalidOid;
+	ArrayType  *attNames = NULL;
+	int32		device_id = -1;
+
+	if (PG_ARGISNULL(0))
+		elog(ERROR, "no relation oid was specified");
+	frel_oid = PG_GETARG_OID(0);
+	if (!PG_ARGISNULL(1))
+		attNames = PG_GETARG_ARRAYTYPE_P(1);
+	if (!PG_ARGISNULL(2))
+		device_id = PG_GETARG_INT32(2);
+
+	PG_RETURN_TEXT_P(__pgstrom_arrow_fdw_export_gpubuf(frel_oid,
+													   attNames,
+													   device_id,
+													   ARROW_GPUBUF_FORMAT__COLUMNS,
+													   false));
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_export_columns);
+
+Datum
+pgstrom_arrow_fdw_export_columns_pinned(PG_FUNCTION_ARGS)
+{
+	Oid			frel_oid = InvalidOid;
+	ArrayType  *attNames = NULL;
+	int32		device_id = -1;
+
+	if (PG_ARGISNULL(0))
+		elog(ERROR, "no relation oid was specified");
+	frel_oid = PG_GETARG_OID(0);
+	if (!PG_ARGISNULL(1))
+		attNames = PG_GETARG_ARRAYTYPE_P(1);
+	if (!PG_ARGISNULL(2))
+		device_id = PG_GETARG_INT32(2);
+
+	PG_RETURN_TEXT_P(__pgstrom_arrow_fdw_export_gpubuf(frel_oid,
+													   attNames,
+													   device_id,
+													   ARROW_GPUBUF_FORMAT__COLUMNS,
+													   true));
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_export_columns_pinned);
+
+/*
+ * arrowFdwExportGpuBufferColumns
+ *
+ * It exports all the columns of the Arrow_Fdw foreign table in the same
+ * format of pgstrom.arrow_fdw_export_columns(), for PL/CUDA functions.
+ * The pinned GPU buffer of the same columns is reused, if any.
+ */
+char *
+arrowFdwExportGpuBufferColumns(Oid frel_oid)
+{
+	Datum		datum;
+
+	datum = __pgstrom_arrow_fdw_export_gpubuf(frel_oid,
+											  NULL,
+											  -1,
+											  ARROW_GPUBUF_FORMAT__COLUMNS,
+											  false);
+	return TextDatumGetCString(datum);
+}
+
+/*
+ * arrowFdwPutGpuBuffer
+ */
+void
+arrowFdwPutGpuBuffer(const char *ident)
+{
+	DirectFunctionCall1(pgstrom_arrow_fdw_put_gpu_buffer,
+						CStringGetTextDatum(ident));
+}
+
 /*
  * unloadArrowGpuBuffer
  */
@@ -5339,6 +10814,8 @@ pgstrom_arrow_fdw_unpin_gpu_buffer(PG_FUNCTION_ARGS)
 				strcmp(pos, "cupy-float32") == 0 ||
 				strcmp(pos, "cupy-float64") == 0)
 				format = ARROW_GPUBUF_FORMAT__CUPY;
+			else if (strcmp(pos, "arrow-columns") == 0)
+				format = ARROW_GPUBUF_FORMAT__COLUMNS;
 			else
 				elog(ERROR, "unknown GPU buffer identifier format [%s]", pos);
 		}
@@ -5358,7 +10835,8 @@ pgstrom_arrow_fdw_unpin_gpu_buffer(PG_FUNCTION_ARGS)
 		else if (strcmp(tok, "device_id")  != 0 &&
 				 strcmp(tok, "bytesize")   != 0 &&
 				 strcmp(tok, "ipc_handle") != 0 &&
-				 strcmp(tok, "nitems")     != 0)
+				 strcmp(tok, "nitems")     != 0 &&
+				 strcmp(tok, "columns")    != 0)
 			elog(ERROR, "invalid GPU buffer identifier token [%s]", ident);
 	}
 
@@ -5478,7 +10956,13 @@ pgstrom_init_arrow_fdw(void)
 	r->PlanForeignModify			= ArrowPlanForeignModify;
 	r->BeginForeignModify			= ArrowBeginForeignModify;
 	r->ExecForeignInsert			= ArrowExecForeignInsert;
+#if PG_VERSION_NUM >= 140000
+	r->ExecForeignBatchInsert		= ArrowExecForeignBatchInsert;
+	r->GetForeignModifyBatchSize	= ArrowGetForeignModifyBatchSize;
+#endif
 	r->EndForeignModify				= ArrowEndForeignModify;
+	r->BeginForeignInsert			= ArrowBeginForeignInsert;
+	r->EndForeignInsert				= ArrowEndForeignInsert;
 	r->ExplainForeignModify			= ArrowExplainForeignModify;
 
 	/*
@@ -5493,6 +10977,42 @@ pgstrom_init_arrow_fdw(void)
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
 
+	/*
+	 * Turn on/off min/max statistics hint
+	 */
+	DefineCustomBoolVariable("arrow_fdw.stats_hint_enabled",
+							 "Enables min/max statistics hint to skip RecordBatches",
+							 NULL,
+							 &arrow_fdw_stats_hint_enabled,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Turn on/off late materialization on CPU scan
+	 */
+	DefineCustomBoolVariable("arrow_fdw.late_materialization",
+							 "Enables to load columns referenced by qualifiers first, to skip RecordBatches without matched rows",
+							 NULL,
+							 &arrow_fdw_late_materialization,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Turn on/off memory-mapped column buffers on CPU scan
+	 */
+	DefineCustomBoolVariable("arrow_fdw.mmap_enabled",
+							 "Enables to map column buffers on the file directly, instead of the copy, on CPU scan",
+							 NULL,
+							 &arrow_fdw_mmap_enabled,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/*
 	 * Configurations for arrow_fdw metadata cache
 	 */
@@ -5508,6 +11028,20 @@ pgstrom_init_arrow_fdw(void)
 							NULL, NULL, NULL);
 	arrow_metadata_cache_size = (size_t)arrow_metadata_cache_size_kb << 10;
 
+	/*
+	 * directory of the on-disk metadata catalog
+	 */
+	DefineCustomStringVariable("arrow_fdw.metadata_cache_dir",
+							   "directory to save metadata of arrow files",
+							   NULL,
+							   &arrow_metadata_cache_dir,
+							   NULL,
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE | GUC_SUPERUSER_ONLY,
+							   NULL, NULL, NULL);
+	if (arrow_metadata_cache_dir && *arrow_metadata_cache_dir == '\0')
+		arrow_metadata_cache_dir = NULL;
+
 	/*
 	 * Debug option to hint number of rows
 	 */
@@ -5534,6 +11068,20 @@ pgstrom_init_arrow_fdw(void)
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
 
+	/*
+	 * Number of rows per batch insertion
+	 */
+	DefineCustomIntVariable("arrow_fdw.insert_batch_size",
+							"number of rows per batch insertion",
+							NULL,
+							&arrow_insert_batch_size,
+							1000,			/* default: 1000 rows */
+							1,				/* min: 1 row */
+							65536,			/* max: 64K rows */
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
 	/* shared memory size */
 	RequestAddinShmemSpace(MAXALIGN(sizeof(arrowMetadataState)));
 	shmem_startup_next = shmem_startup_hook;
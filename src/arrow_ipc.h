@@ -33,6 +33,7 @@ typedef struct SQLbuffer		SQLbuffer;
 typedef struct SQLtable			SQLtable;
 typedef struct SQLfield			SQLfield;
 typedef struct SQLdictionary	SQLdictionary;
+typedef struct SQLstat			SQLstat;
 typedef union  SQLtype			SQLtype;
 typedef struct SQLtype__pgsql	SQLtype__pgsql;
 typedef struct SQLtype__mysql	SQLtype__mysql;
@@ -67,6 +68,19 @@ union SQLtype
 	SQLtype__mysql	mysql;
 };
 
+/*
+ * SQLstat - min/max statistics of a field per record batch
+ */
+struct SQLstat
+{
+	bool		is_valid;		/* false, if no values or all nulls/NaNs */
+	bool		has_nan;		/* true, if FloatingPoint values have NaN */
+	union {
+		int64	i;				/* Int, Date, Time, Timestamp */
+		double	f;				/* FloatingPoint */
+	} min, max;
+};
+
 struct SQLfield
 {
 	char	   *field_name;		/* name of the column, element or sub-field */
@@ -90,6 +104,11 @@ struct SQLfield
 	/* custom metadata(optional) */
 	ArrowKeyValue *customMetadata;
 	int			numCustomMetadata;
+	/* min/max statistics per record batch (optional) */
+	bool		stat_enabled;
+	int			stat_nitems;	/* # of valid stat_values[] entries */
+	int			stat_nrooms;
+	SQLstat	   *stat_values;
 };
 static inline size_t
 sql_field_put_value(SQLfield *column, const char *addr, int sz)
@@ -97,6 +116,23 @@ sql_field_put_value(SQLfield *column, const char *addr, int sz)
 	return (column->__curr_usage__ = column->put_value(column, addr, sz));
 }
 
+/* min/max statistics are collected on fixed-length values */
+static inline bool
+sql_field_stat_supported(SQLfield *column)
+{
+	switch (column->arrow_type.node.tag)
+	{
+		case ArrowNodeTag__Int:
+		case ArrowNodeTag__FloatingPoint:
+		case ArrowNodeTag__Date:
+		case ArrowNodeTag__Time:
+		case ArrowNodeTag__Timestamp:
+			return true;
+		default:
+			return false;
+	}
+}
+
 struct SQLtable
 {
 	const char *filename;		/* output filename */
@@ -144,6 +180,10 @@ extern void		writeArrowDictionaryBatches(SQLtable *table);
 extern int		writeArrowRecordBatch(SQLtable *table);
 extern ssize_t	writeArrowFooter(SQLtable *table);
 extern size_t	estimateArrowBufferLength(SQLfield *column, size_t nitems);
+extern bool		arrowFieldStatValues(ArrowField *field, const char *key,
+									 int rb_index, char *buf, size_t bufsz);
+extern void		restoreArrowFieldStat(SQLfield *column,
+									  ArrowField *field, int nitems);
 
 /* arrow_nodes.c */
 extern void		__initArrowNode(ArrowNode *node, ArrowNodeTag tag);
@@ -152,6 +192,8 @@ extern void		__initArrowNode(ArrowNode *node, ArrowNodeTag tag);
 extern char	   *dumpArrowNode(ArrowNode *node);
 extern void		copyArrowNode(ArrowNode *dest, const ArrowNode *src);
 extern void		readArrowFileDesc(int fdesc, ArrowFileInfo *af_info);
+extern size_t	readArrowFooterTail(const char *tail, size_t tail_sz,
+									ArrowFooter *footer);
 extern char	   *arrowTypeName(ArrowField *field);
 
 /* arrow_pgsql.c */
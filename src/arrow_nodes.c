@@ -324,6 +324,18 @@ __dumpArrowBuffer(SQLbuffer *buf, ArrowNode *node)
 		((ArrowBuffer *)node)->length);
 }
 
+static void
+__dumpArrowBodyCompression(SQLbuffer *buf, ArrowNode *node)
+{
+	ArrowBodyCompression *c = (ArrowBodyCompression *)node;
+
+	sql_buffer_printf(
+		buf, "{BodyCompression: codec=%s, method=%s}",
+		c->codec == ArrowCompressionType__LZ4_FRAME ? "LZ4_FRAME" :
+		c->codec == ArrowCompressionType__ZSTD ? "ZSTD" : "???",
+		c->method == ArrowBodyCompressionMethod__BUFFER ? "BUFFER" : "???");
+}
+
 static void
 __dumpArrowSchema(SQLbuffer *buf, ArrowNode *node)
 {
@@ -370,7 +382,13 @@ __dumpArrowRecordBatch(SQLbuffer *buf, ArrowNode *node)
 			sql_buffer_printf(buf, ", ");
 		__dumpArrowNode(buf, (ArrowNode *)&r->buffers[i]);
 	}
-	sql_buffer_printf(buf,"]}");
+	sql_buffer_printf(buf,"]");
+	if (r->compression)
+	{
+		sql_buffer_printf(buf, ", compression=");
+		__dumpArrowNode(buf, (ArrowNode *)r->compression);
+	}
+	sql_buffer_printf(buf,"}");
 }
 
 static void
@@ -396,7 +414,8 @@ __dumpArrowMessage(SQLbuffer *buf, ArrowNode *node)
 		m->version == ArrowMetadataVersion__V1 ? "V1" :
 		m->version == ArrowMetadataVersion__V2 ? "V2" :
 		m->version == ArrowMetadataVersion__V3 ? "V3" :
-		m->version == ArrowMetadataVersion__V4 ? "V4" : "???");
+		m->version == ArrowMetadataVersion__V4 ? "V4" :
+		m->version == ArrowMetadataVersion__V5 ? "V5" : "???");
 	__dumpArrowNode(buf, (ArrowNode *)&m->body);
 	sql_buffer_printf(buf, ", bodyLength=%lu}", m->bodyLength);
 }
@@ -422,7 +441,8 @@ __dumpArrowFooter(SQLbuffer *buf, ArrowNode *node)
 		f->version == ArrowMetadataVersion__V1 ? "V1" :
 		f->version == ArrowMetadataVersion__V2 ? "V2" :
 		f->version == ArrowMetadataVersion__V3 ? "V3" :
-		f->version == ArrowMetadataVersion__V4 ? "V4" : "???");
+		f->version == ArrowMetadataVersion__V4 ? "V4" :
+		f->version == ArrowMetadataVersion__V5 ? "V5" : "???");
 	__dumpArrowNode(buf, (ArrowNode *)&f->schema);
 	sql_buffer_printf(buf, ", dictionaries=[");
 	for (i=0; i < f->_num_dictionaries; i++)
@@ -635,6 +655,15 @@ __copyArrowBuffer(ArrowBuffer *dest, const ArrowBuffer *src)
 	COPY_SCALAR(length);
 }
 
+static void
+__copyArrowBodyCompression(ArrowBodyCompression *dest,
+						   const ArrowBodyCompression *src)
+{
+	__copyArrowNode(&dest->node, &src->node);
+	COPY_SCALAR(codec);
+	COPY_SCALAR(method);
+}
+
 static void
 __copyArrowKeyValue(ArrowKeyValue *dest, const ArrowKeyValue *src)
 {
@@ -695,6 +724,13 @@ __copyArrowRecordBatch(ArrowRecordBatch *dest, const ArrowRecordBatch *src)
 	COPY_SCALAR(length);
 	COPY_VECTOR(nodes, ArrowFieldNode);
 	COPY_VECTOR(buffers, ArrowBuffer);
+	if (!src->compression)
+		dest->compression = NULL;
+	else
+	{
+		dest->compression = palloc0(sizeof(ArrowBodyCompression));
+		__copyArrowBodyCompression(dest->compression, src->compression);
+	}
 }
 
 static void
@@ -941,6 +977,7 @@ __initArrowNode(ArrowNode *node, ArrowNodeTag tag)
 		CASE_ARROW_NODE(Field);
 		CASE_ARROW_NODE(FieldNode);
 		CASE_ARROW_NODE(Buffer);
+		CASE_ARROW_NODE(BodyCompression);
 		CASE_ARROW_NODE(Schema);
 		CASE_ARROW_NODE(RecordBatch);
 		CASE_ARROW_NODE(DictionaryBatch);
@@ -1499,6 +1536,23 @@ readArrowBuffer(ArrowBuffer *node, const char *pos)
 
 }
 
+static void
+readArrowBodyCompression(ArrowBodyCompression *node, const char *pos)
+{
+	FBTable		t = fetchFBTable((int32 *)pos);
+
+	memset(node, 0, sizeof(ArrowBodyCompression));
+	INIT_ARROW_NODE(node, BodyCompression);
+	node->codec		= fetchChar(&t, 0);
+	node->method	= fetchChar(&t, 1);
+
+	if (node->codec != ArrowCompressionType__LZ4_FRAME &&
+		node->codec != ArrowCompressionType__ZSTD)
+		Elog("unknown CompressionType: %d", node->codec);
+	if (node->method != ArrowBodyCompressionMethod__BUFFER)
+		Elog("unknown BodyCompressionMethod: %d", node->method);
+}
+
 static void
 readArrowRecordBatch(ArrowRecordBatch *rbatch, const char *pos)
 {
@@ -1528,6 +1582,14 @@ readArrowRecordBatch(ArrowRecordBatch *rbatch, const char *pos)
 			next += readArrowBuffer(&rbatch->buffers[i], next);
 	}
 	rbatch->_num_buffers = nitems;
+
+	/* compression: BodyCompression (optional) */
+	next = fetchOffset(&t, 3);
+	if (next)
+	{
+		rbatch->compression = palloc0(sizeof(ArrowBodyCompression));
+		readArrowBodyCompression(rbatch->compression, next);
+	}
 }
 
 static void
@@ -1558,7 +1620,8 @@ readArrowMessage(ArrowMessage *message, const char *pos)
 	next				= fetchOffset(&t, 2);
 	message->bodyLength	= fetchLong(&t, 3);
 
-	if (message->version != ArrowMetadataVersion__V4)
+	if (message->version != ArrowMetadataVersion__V4 &&
+		message->version != ArrowMetadataVersion__V5)
 		Elog("metadata version %d is not supported", message->version);
 
 	switch (mtype)
@@ -1757,3 +1820,36 @@ readArrowFileDesc(int fdesc, ArrowFileInfo *af_info)
 	}
 	__munmap(mmap_head, mmap_sz);
 }
+
+/*
+ * readArrowFooterTail - read the Footer chunk from the tail portion of
+ * the apache arrow file, if the file is not mapped entirely (e.g, remote
+ * files on the object storage). It returns 0 on success, or the length
+ * of the tail portion required to read the Footer chunk.
+ */
+size_t
+readArrowFooterTail(const char *tail, size_t tail_sz, ArrowFooter *footer)
+{
+	const char	   *pos;
+	int32			offset;
+	size_t			required;
+
+	required = ARROW_FILE_TAIL_SIGNATURE_SZ + sizeof(int32);
+	if (tail_sz < required)
+		return required;
+	pos = tail + tail_sz - ARROW_FILE_TAIL_SIGNATURE_SZ;
+	if (memcmp(pos,
+			   ARROW_FILE_TAIL_SIGNATURE,
+			   ARROW_FILE_TAIL_SIGNATURE_SZ) != 0)
+		Elog("Signature mismatch on Apache Arrow file");
+	pos -= sizeof(int32);
+	offset = *((int32 *)pos);
+	required += offset;
+	if (offset < 0 || tail_sz < required)
+		return required;
+	pos -= offset;
+	offset = *((int32 *)pos);
+	memset(footer, 0, sizeof(ArrowFooter));
+	readArrowFooter(footer, pos + offset);
+	return 0;
+}
@@ -0,0 +1,880 @@
+/*
+ * arrow_s3.c
+ *
+ * Routines to read Apache Arrow files on the S3 compatible object storage
+ * on behalf of Arrow_Fdw. A remote file is cached on the local directory as
+ * a sparse file of the same size, and only the ranges to be read (footer,
+ * metadata and buffers of the referenced columns) are downloaded by ranged
+ * GET requests in parallel. Once downloaded, Arrow_Fdw reads the cache file
+ * like any other local file, including SSD-to-GPU Direct SQL.
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+#include "arrow_defs.h"
+#include "arrow_ipc.h"
+#include <sys/file.h>
+#ifdef WITH_LIBCURL
+#include <curl/curl.h>
+#endif
+
+#define ARROW_S3_URL_PREFIX			"s3://"
+#define ARROW_S3_URL_PREFIX_SZ		(sizeof(ARROW_S3_URL_PREFIX) - 1)
+#define ARROW_S3_CACHE_BLOCKSZ		(1UL << 20)		/* 1MB */
+#define ARROW_S3_FETCH_MAX_BLOCKS	8				/* 8MB per request */
+#define ARROW_S3_CACHE_MAP_MAGIC	0x33535047		/* 'GPS3' */
+#define ARROW_S3_CACHE_MAP_SUFFIX	".s3map"
+
+/*
+ * arrowS3Object - a remote object and its local cache file
+ */
+typedef struct
+{
+	char	   *bucket;
+	char	   *key;
+	char	   *cache_path;		/* sparse file of the object */
+	char	   *map_path;		/* bitmap of the downloaded blocks */
+} arrowS3Object;
+
+/*
+ * arrowS3CacheMap - on-disk format of the map file
+ */
+typedef struct
+{
+	uint32		magic;
+	uint32		blocksz;
+	uint64		object_sz;
+	char		etag[128];
+	uint8		bitmap[FLEXIBLE_ARRAY_MEMBER];
+} arrowS3CacheMap;
+
+#define ARROW_S3_CACHE_NBLOCKS(object_sz)								\
+	(((object_sz) + ARROW_S3_CACHE_BLOCKSZ - 1) / ARROW_S3_CACHE_BLOCKSZ)
+#define ARROW_S3_CACHE_BITMAP_LENGTH(object_sz)							\
+	((ARROW_S3_CACHE_NBLOCKS(object_sz) + BITS_PER_BYTE - 1) / BITS_PER_BYTE)
+#define ARROW_S3_CACHE_MAP_LENGTH(object_sz)							\
+	(offsetof(arrowS3CacheMap, bitmap) +								\
+	 ARROW_S3_CACHE_BITMAP_LENGTH(object_sz))
+
+/*
+ * arrowS3Resolved - remote files already resolved in this transaction
+ */
+typedef struct
+{
+	char	   *url;
+	char	   *cache_path;
+	LocalTransactionId lxid;
+} arrowS3Resolved;
+
+/* static variables */
+static char	   *arrow_s3_cache_dir = NULL;		/* GUC */
+static char	   *arrow_s3_endpoint = NULL;		/* GUC */
+static char	   *arrow_s3_region = NULL;			/* GUC */
+static int		arrow_s3_max_requests;			/* GUC */
+static List	   *arrow_s3_resolved_list = NIL;
+
+/*
+ * __arrowS3SetupObject
+ */
+static void
+__arrowS3SetupObject(arrowS3Object *s3obj, const char *bucket, const char *key)
+{
+	s3obj->bucket = pstrdup(bucket);
+	s3obj->key = pstrdup(key);
+	s3obj->cache_path = psprintf("%s/%s/%s",
+								 arrow_s3_cache_dir, bucket, key);
+	s3obj->map_path = psprintf("%s%s", s3obj->cache_path,
+							   ARROW_S3_CACHE_MAP_SUFFIX);
+}
+
+/*
+ * __arrowS3ParseURL - parse the 's3://bucket/key' form
+ */
+static void
+__arrowS3ParseURL(arrowS3Object *s3obj, const char *url)
+{
+	char	   *bucket = pstrdup(url + ARROW_S3_URL_PREFIX_SZ);
+	char	   *key = strchr(bucket, '/');
+	char	   *pos;
+
+	Assert(strncmp(url, ARROW_S3_URL_PREFIX, ARROW_S3_URL_PREFIX_SZ) == 0);
+	if (!key || key == bucket || key[1] == '\0')
+		elog(ERROR, "arrow_fdw: invalid URL '%s'", url);
+	*key++ = '\0';
+	if (strcmp(bucket, ".") == 0 || strcmp(bucket, "..") == 0)
+		elog(ERROR, "arrow_fdw: invalid URL '%s'", url);
+	/* key shall not escape from the cache directory */
+	for (pos = key; ; pos++)
+	{
+		if (pos[0] == '.' && pos[1] == '.' &&
+			(pos[2] == '/' || pos[2] == '\0'))
+			elog(ERROR, "arrow_fdw: invalid URL '%s'", url);
+		pos = strchr(pos, '/');
+		if (!pos)
+			break;
+	}
+	__arrowS3SetupObject(s3obj, bucket, key);
+	pfree(bucket);
+}
+
+/*
+ * arrowS3IsCacheFile
+ */
+bool
+arrowS3IsCacheFile(const char *fname)
+{
+	size_t		len;
+
+	if (!arrow_s3_cache_dir)
+		return false;
+	len = strlen(arrow_s3_cache_dir);
+	return (strncmp(fname, arrow_s3_cache_dir, len) == 0 &&
+			fname[len] == '/');
+}
+
+/*
+ * __arrowS3ParseCachePath - reverse of __arrowS3SetupObject
+ */
+static void
+__arrowS3ParseCachePath(arrowS3Object *s3obj, const char *fname)
+{
+	char	   *bucket;
+	char	   *key;
+
+	Assert(arrowS3IsCacheFile(fname));
+	bucket = pstrdup(fname + strlen(arrow_s3_cache_dir) + 1);
+	key = strchr(bucket, '/');
+	if (!key)
+		elog(ERROR, "arrow_fdw: '%s' is not a cache file of object storage",
+			 fname);
+	*key++ = '\0';
+	__arrowS3SetupObject(s3obj, bucket, key);
+	pfree(bucket);
+}
+
+/*
+ * __arrowS3ReadCacheMap
+ */
+static arrowS3CacheMap *
+__arrowS3ReadCacheMap(File fdesc_map)
+{
+	arrowS3CacheMap *map;
+	struct stat	stat_buf;
+
+	if (fstat(FileGetRawDesc(fdesc_map), &stat_buf) != 0)
+		elog(ERROR, "failed on fstat('%s'): %m", FilePathName(fdesc_map));
+	if (stat_buf.st_size < offsetof(arrowS3CacheMap, bitmap))
+		return NULL;
+	map = palloc(stat_buf.st_size);
+	if (pread(FileGetRawDesc(fdesc_map), map,
+			  stat_buf.st_size, 0) != stat_buf.st_size)
+		elog(ERROR, "failed on pread('%s'): %m", FilePathName(fdesc_map));
+	if (map->magic != ARROW_S3_CACHE_MAP_MAGIC ||
+		map->blocksz != ARROW_S3_CACHE_BLOCKSZ ||
+		stat_buf.st_size != ARROW_S3_CACHE_MAP_LENGTH(map->object_sz))
+	{
+		pfree(map);
+		return NULL;
+	}
+	return map;
+}
+
+/*
+ * __arrowS3WriteCacheMap
+ */
+static void
+__arrowS3WriteCacheMap(File fdesc_map, arrowS3CacheMap *map)
+{
+	size_t		length = ARROW_S3_CACHE_MAP_LENGTH(map->object_sz);
+
+	if (pwrite(FileGetRawDesc(fdesc_map), map, length, 0) != length ||
+		ftruncate(FileGetRawDesc(fdesc_map), length) != 0)
+		elog(ERROR, "failed on pwrite('%s'): %m", FilePathName(fdesc_map));
+}
+
+#ifdef WITH_LIBCURL
+/*
+ * arrowS3Request - state of a ranged GET request
+ */
+typedef struct
+{
+	CURL	   *curl;
+	struct curl_slist *headers;
+	int			fdesc;		/* raw file descriptor of the cache file */
+	off_t		f_pos;		/* next position to write */
+	off_t		f_end;
+	int			errcode;	/* errno on pwrite */
+	char		errbuf[CURL_ERROR_SIZE];
+} arrowS3Request;
+
+static bool		arrow_s3_curl_initialized = false;
+
+/*
+ * __arrowS3EscapeKey - percent-encoding of the object key, except for '/'
+ */
+static void
+__arrowS3EscapeKey(StringInfo buf, const char *key)
+{
+	const char *pos;
+
+	for (pos = key; *pos != '\0'; pos++)
+	{
+		int		c = (unsigned char)*pos;
+
+		if (isalnum(c) || c == '-' || c == '_' ||
+			c == '.' || c == '~' || c == '/')
+			appendStringInfoChar(buf, c);
+		else
+			appendStringInfo(buf, "%%%02X", c);
+	}
+}
+
+/*
+ * __arrowS3CreateHandle
+ */
+static CURL *
+__arrowS3CreateHandle(arrowS3Object *s3obj, struct curl_slist **p_headers)
+{
+	const char *access_key = getenv("AWS_ACCESS_KEY_ID");
+	const char *secret_key = getenv("AWS_SECRET_ACCESS_KEY");
+	const char *session_token = getenv("AWS_SESSION_TOKEN");
+	struct curl_slist *headers = NULL;
+	StringInfoData buf;
+	CURL	   *curl;
+
+	if (!arrow_s3_curl_initialized)
+	{
+		if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
+			elog(ERROR, "failed on curl_global_init");
+		arrow_s3_curl_initialized = true;
+	}
+	curl = curl_easy_init();
+	if (!curl)
+		elog(ERROR, "failed on curl_easy_init");
+
+	initStringInfo(&buf);
+	if (arrow_s3_endpoint && *arrow_s3_endpoint != '\0')
+	{
+		/* path-style request to the S3 compatible storage */
+		appendStringInfo(&buf, "%s/%s/", arrow_s3_endpoint, s3obj->bucket);
+	}
+	else
+	{
+		/* virtual-hosted style request to the AWS S3 */
+		appendStringInfo(&buf, "https://%s.s3.%s.amazonaws.com/",
+						 s3obj->bucket, arrow_s3_region);
+	}
+	__arrowS3EscapeKey(&buf, s3obj->key);
+	curl_easy_setopt(curl, CURLOPT_URL, buf.data);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+	/* credentials, if any; elsewhere, anonymous access */
+	if (access_key && secret_key)
+	{
+#if LIBCURL_VERSION_NUM >= 0x074b00
+		resetStringInfo(&buf);
+		appendStringInfo(&buf, "aws:amz:%s:s3", arrow_s3_region);
+		curl_easy_setopt(curl, CURLOPT_AWS_SIGV4, buf.data);
+		resetStringInfo(&buf);
+		appendStringInfo(&buf, "%s:%s", access_key, secret_key);
+		curl_easy_setopt(curl, CURLOPT_USERPWD, buf.data);
+		if (session_token)
+		{
+			resetStringInfo(&buf);
+			appendStringInfo(&buf, "x-amz-security-token: %s", session_token);
+			headers = curl_slist_append(headers, buf.data);
+		}
+#else
+		curl_easy_cleanup(curl);
+		elog(ERROR, "arrow_fdw: libcurl is too old to sign requests to the object storage (7.75.0 or later is required)");
+#endif
+	}
+	if (headers)
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	*p_headers = headers;
+	pfree(buf.data);
+
+	return curl;
+}
+
+/*
+ * __arrowS3HeaderCallback - pick up ETag of the object
+ */
+static size_t
+__arrowS3HeaderCallback(char *ptr, size_t size, size_t nitems, void *userdata)
+{
+	char	   *etag = userdata;
+	size_t		len = size * nitems;
+
+	if (len > 5 && strncasecmp(ptr, "ETag:", 5) == 0)
+	{
+		const char *head = ptr + 5;
+		const char *tail = ptr + len;
+
+		while (head < tail && isspace((unsigned char)*head))
+			head++;
+		while (tail > head && isspace((unsigned char)tail[-1]))
+			tail--;
+		len = Min(tail - head, 127);
+		memcpy(etag, head, len);
+		etag[len] = '\0';
+		len = size * nitems;
+	}
+	return len;
+}
+
+/*
+ * __arrowS3HeadObject
+ */
+static void
+__arrowS3HeadObject(arrowS3Object *s3obj, uint64 *p_object_sz, char *etag)
+{
+	struct curl_slist *headers;
+	CURL	   *curl;
+	CURLcode	rc;
+	curl_off_t	object_sz = -1;
+	char		errbuf[CURL_ERROR_SIZE];
+
+	curl = __arrowS3CreateHandle(s3obj, &headers);
+	errbuf[0] = '\0';
+	etag[0] = '\0';
+	curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, __arrowS3HeaderCallback);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, etag);
+	rc = curl_easy_perform(curl);
+	if (rc == CURLE_OK)
+		curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &object_sz);
+	curl_slist_free_all(headers);
+	curl_easy_cleanup(curl);
+
+	if (rc != CURLE_OK)
+		elog(ERROR, "arrow_fdw: failed on HEAD s3://%s/%s: %s",
+			 s3obj->bucket, s3obj->key,
+			 errbuf[0] != '\0' ? errbuf : curl_easy_strerror(rc));
+	if (object_sz < 0)
+		elog(ERROR, "arrow_fdw: unknown length of s3://%s/%s",
+			 s3obj->bucket, s3obj->key);
+	*p_object_sz = object_sz;
+}
+
+/*
+ * __arrowS3WriteCallback - write out the response body to the cache file
+ */
+static size_t
+__arrowS3WriteCallback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	arrowS3Request *req = userdata;
+	size_t		len = size * nmemb;
+	size_t		remain = len;
+	ssize_t		nbytes;
+
+	/* never raise an error in the callback of libcurl */
+	if (req->f_pos + len > req->f_end)
+		return 0;
+	while (remain > 0)
+	{
+		nbytes = pwrite(req->fdesc, ptr, remain, req->f_pos);
+		if (nbytes <= 0)
+		{
+			if (nbytes < 0 && errno == EINTR)
+				continue;
+			req->errcode = (nbytes < 0 ? errno : EIO);
+			return 0;
+		}
+		ptr += nbytes;
+		remain -= nbytes;
+		req->f_pos += nbytes;
+	}
+	return len;
+}
+
+static void
+__arrowS3ReleaseRequest(CURLM *multi, arrowS3Request *req)
+{
+	if (req->curl)
+	{
+		curl_multi_remove_handle(multi, req->curl);
+		curl_easy_cleanup(req->curl);
+		req->curl = NULL;
+	}
+	if (req->headers)
+	{
+		curl_slist_free_all(req->headers);
+		req->headers = NULL;
+	}
+}
+
+/*
+ * __arrowS3FetchRuns
+ *
+ * It downloads the ranges of the object onto the cache file, by
+ * arrow_fdw.s3_max_requests concurrent requests at most.
+ */
+static void
+__arrowS3FetchRuns(arrowS3Object *s3obj, File fdesc,
+				   int nruns, off_t *run_pos, size_t *run_len)
+{
+	arrowS3Request *reqs = palloc0(sizeof(arrowS3Request) * nruns);
+	CURLM	   *multi;
+	int			i, next = 0;
+	int			nrunning = 0;
+	int			ndone = 0;
+
+	multi = curl_multi_init();
+	if (!multi)
+		elog(ERROR, "failed on curl_multi_init");
+	PG_TRY();
+	{
+		while (ndone < nruns)
+		{
+			CURLMsg	   *msg;
+			int			nqueued;
+			int			nactive;
+			CURLMcode	mrc;
+
+			while (next < nruns && nrunning < arrow_s3_max_requests)
+			{
+				arrowS3Request *req = &reqs[next];
+				char		range[80];
+
+				req->curl = __arrowS3CreateHandle(s3obj, &req->headers);
+				req->fdesc = FileGetRawDesc(fdesc);
+				req->f_pos = run_pos[next];
+				req->f_end = run_pos[next] + run_len[next];
+				snprintf(range, sizeof(range), "%lu-%lu",
+						 (unsigned long)req->f_pos,
+						 (unsigned long)(req->f_end - 1));
+				curl_easy_setopt(req->curl, CURLOPT_RANGE, range);
+				curl_easy_setopt(req->curl, CURLOPT_ERRORBUFFER, req->errbuf);
+				curl_easy_setopt(req->curl, CURLOPT_WRITEFUNCTION,
+								 __arrowS3WriteCallback);
+				curl_easy_setopt(req->curl, CURLOPT_WRITEDATA, req);
+				curl_easy_setopt(req->curl, CURLOPT_PRIVATE, req);
+				curl_multi_add_handle(multi, req->curl);
+				next++;
+				nrunning++;
+			}
+			mrc = curl_multi_perform(multi, &nactive);
+			if (mrc != CURLM_OK)
+				elog(ERROR, "failed on curl_multi_perform: %s",
+					 curl_multi_strerror(mrc));
+			while ((msg = curl_multi_info_read(multi, &nqueued)) != NULL)
+			{
+				arrowS3Request *req;
+
+				if (msg->msg != CURLMSG_DONE)
+					continue;
+				curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &req);
+				if (req->errcode != 0)
+				{
+					errno = req->errcode;
+					elog(ERROR, "failed on pwrite('%s'): %m",
+						 FilePathName(fdesc));
+				}
+				if (msg->data.result != CURLE_OK)
+					elog(ERROR, "arrow_fdw: failed on GET s3://%s/%s: %s",
+						 s3obj->bucket, s3obj->key,
+						 req->errbuf[0] != '\0'
+						 ? req->errbuf
+						 : curl_easy_strerror(msg->data.result));
+				if (req->f_pos != req->f_end)
+					elog(ERROR, "arrow_fdw: s3://%s/%s was truncated",
+						 s3obj->bucket, s3obj->key);
+				__arrowS3ReleaseRequest(multi, req);
+				nrunning--;
+				ndone++;
+			}
+			if (ndone < nruns)
+			{
+				CHECK_FOR_INTERRUPTS();
+				mrc = curl_multi_wait(multi, NULL, 0, 100, NULL);
+				if (mrc != CURLM_OK)
+					elog(ERROR, "failed on curl_multi_wait: %s",
+						 curl_multi_strerror(mrc));
+			}
+		}
+	}
+	PG_CATCH();
+	{
+		for (i=0; i < nruns; i++)
+			__arrowS3ReleaseRequest(multi, &reqs[i]);
+		curl_multi_cleanup(multi);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	curl_multi_cleanup(multi);
+	pfree(reqs);
+}
+#endif	/* WITH_LIBCURL */
+
+/*
+ * __arrowS3FetchCacheRanges
+ */
+static void
+__arrowS3FetchCacheRanges(arrowS3Object *s3obj, int nranges,
+						  const off_t *offsets, const size_t *lengths)
+{
+#ifdef WITH_LIBCURL
+	arrowS3CacheMap *map;
+	File		fdesc_map;
+	File		fdesc;
+	uint8	   *wanted;
+	off_t	   *run_pos;
+	size_t	   *run_len;
+	uint64		nblocks;
+	uint64		blkno;
+	char		etag[128];
+	int			i, nruns = 0;
+
+	fdesc_map = PathNameOpenFile(s3obj->map_path, O_RDWR | PG_BINARY);
+	if (fdesc_map < 0)
+		elog(ERROR, "failed on open('%s'): %m", s3obj->map_path);
+	if (flock(FileGetRawDesc(fdesc_map), LOCK_SH) != 0)
+		elog(ERROR, "failed on flock('%s'): %m", s3obj->map_path);
+	map = __arrowS3ReadCacheMap(fdesc_map);
+	flock(FileGetRawDesc(fdesc_map), LOCK_UN);
+	if (!map)
+		elog(ERROR, "arrow_fdw: cache map '%s' is corrupted", s3obj->map_path);
+
+	/* blocks to be downloaded */
+	memcpy(etag, map->etag, sizeof(etag));
+	nblocks = ARROW_S3_CACHE_NBLOCKS(map->object_sz);
+	wanted = palloc0(ARROW_S3_CACHE_BITMAP_LENGTH(map->object_sz));
+	for (i=0; i < nranges; i++)
+	{
+		uint64		head = offsets[i];
+		uint64		tail = Min(offsets[i] + lengths[i], map->object_sz);
+
+		if (head >= tail)
+			continue;
+		for (blkno = head / ARROW_S3_CACHE_BLOCKSZ;
+			 blkno <= (tail - 1) / ARROW_S3_CACHE_BLOCKSZ;
+			 blkno++)
+		{
+			if ((map->bitmap[blkno / BITS_PER_BYTE] &
+				 (1 << (blkno % BITS_PER_BYTE))) == 0)
+				wanted[blkno / BITS_PER_BYTE] |= (1 << (blkno % BITS_PER_BYTE));
+		}
+	}
+	/* consecutive blocks are merged to a request, up to the limit */
+	run_pos = palloc(sizeof(off_t) * nblocks);
+	run_len = palloc(sizeof(size_t) * nblocks);
+	for (blkno=0; blkno < nblocks; blkno++)
+	{
+		uint64		count = 0;
+
+		while (blkno + count < nblocks &&
+			   count < ARROW_S3_FETCH_MAX_BLOCKS &&
+			   (wanted[(blkno + count) / BITS_PER_BYTE] &
+				(1 << ((blkno + count) % BITS_PER_BYTE))) != 0)
+			count++;
+		if (count > 0)
+		{
+			run_pos[nruns] = blkno * ARROW_S3_CACHE_BLOCKSZ;
+			run_len[nruns] = Min(count * ARROW_S3_CACHE_BLOCKSZ,
+								 map->object_sz - run_pos[nruns]);
+			nruns++;
+			blkno += count - 1;
+		}
+	}
+
+	if (nruns > 0)
+	{
+		fdesc = PathNameOpenFile(s3obj->cache_path, O_WRONLY | PG_BINARY);
+		if (fdesc < 0)
+			elog(ERROR, "failed on open('%s'): %m", s3obj->cache_path);
+		__arrowS3FetchRuns(s3obj, fdesc, nruns, run_pos, run_len);
+		FileClose(fdesc);
+
+		/*
+		 * Concurrent backends may download the same blocks, but it is
+		 * harmless because the contents are identical.
+		 */
+		pfree(map);
+		if (flock(FileGetRawDesc(fdesc_map), LOCK_EX) != 0)
+			elog(ERROR, "failed on flock('%s'): %m", s3obj->map_path);
+		map = __arrowS3ReadCacheMap(fdesc_map);
+		if (map && strcmp(map->etag, etag) == 0 &&
+			ARROW_S3_CACHE_NBLOCKS(map->object_sz) == nblocks)
+		{
+			for (i=0; i < ARROW_S3_CACHE_BITMAP_LENGTH(map->object_sz); i++)
+				map->bitmap[i] |= wanted[i];
+			__arrowS3WriteCacheMap(fdesc_map, map);
+		}
+		flock(FileGetRawDesc(fdesc_map), LOCK_UN);
+	}
+	FileClose(fdesc_map);
+	if (map)
+		pfree(map);
+	pfree(wanted);
+	pfree(run_pos);
+	pfree(run_len);
+#else
+	elog(ERROR, "arrow_fdw: PG-Strom was built without libcurl, so unable to read files on the object storage");
+#endif
+}
+
+/*
+ * arrowS3FetchCacheRanges
+ *
+ * It ensures the ranges of the cache file are already downloaded.
+ */
+void
+arrowS3FetchCacheRanges(const char *fname, int nranges,
+						const off_t *offsets, const size_t *lengths)
+{
+	arrowS3Object s3obj;
+
+	__arrowS3ParseCachePath(&s3obj, fname);
+	__arrowS3FetchCacheRanges(&s3obj, nranges, offsets, lengths);
+}
+
+/*
+ * __arrowS3SetupCacheFile
+ *
+ * It creates the sparse cache file and the map file. If the remote object
+ * was updated since the last download, the cached blocks are invalidated.
+ */
+static void
+__arrowS3SetupCacheFile(arrowS3Object *s3obj, uint64 object_sz,
+						const char *etag)
+{
+	arrowS3CacheMap *map;
+	File		fdesc_map;
+	File		fdesc;
+	char	   *dname;
+
+	dname = pstrdup(s3obj->cache_path);
+	get_parent_directory(dname);
+	if (pg_mkdir_p(dname, S_IRWXU) != 0 && errno != EEXIST)
+		elog(ERROR, "failed on mkdir('%s'): %m", dname);
+	pfree(dname);
+
+	fdesc_map = PathNameOpenFile(s3obj->map_path,
+								 O_RDWR | O_CREAT | PG_BINARY);
+	if (fdesc_map < 0)
+		elog(ERROR, "failed on open('%s'): %m", s3obj->map_path);
+	if (flock(FileGetRawDesc(fdesc_map), LOCK_EX) != 0)
+		elog(ERROR, "failed on flock('%s'): %m", s3obj->map_path);
+	map = __arrowS3ReadCacheMap(fdesc_map);
+	if (!map ||
+		map->object_sz != object_sz ||
+		strcmp(map->etag, etag) != 0)
+	{
+		/*
+		 * Other sessions may still map the old cache file, so we create
+		 * a new file (inode) rather than truncation.
+		 */
+		if (unlink(s3obj->cache_path) != 0 && errno != ENOENT)
+			elog(ERROR, "failed on unlink('%s'): %m", s3obj->cache_path);
+		fdesc = PathNameOpenFile(s3obj->cache_path,
+								 O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+		if (fdesc < 0)
+			elog(ERROR, "failed on open('%s'): %m", s3obj->cache_path);
+		if (ftruncate(FileGetRawDesc(fdesc), object_sz) != 0)
+			elog(ERROR, "failed on ftruncate('%s'): %m", s3obj->cache_path);
+		FileClose(fdesc);
+
+		if (map)
+			pfree(map);
+		map = palloc0(ARROW_S3_CACHE_MAP_LENGTH(object_sz));
+		map->magic = ARROW_S3_CACHE_MAP_MAGIC;
+		map->blocksz = ARROW_S3_CACHE_BLOCKSZ;
+		map->object_sz = object_sz;
+		strncpy(map->etag, etag, sizeof(map->etag) - 1);
+		__arrowS3WriteCacheMap(fdesc_map, map);
+	}
+	flock(FileGetRawDesc(fdesc_map), LOCK_UN);
+	FileClose(fdesc_map);
+	pfree(map);
+}
+
+/*
+ * arrowS3ResolveCacheFile
+ *
+ * It returns the path of the local cache file for the 's3://bucket/key'
+ * form of URL, with the footer and the metadata of DictionaryBatches and
+ * RecordBatches already downloaded; so readArrowFileDesc() works on the
+ * cache file. Buffers of the RecordBatches are downloaded on demand by
+ * arrowS3FetchCacheRanges().
+ */
+char *
+arrowS3ResolveCacheFile(const char *url)
+{
+	arrowS3Object s3obj;
+	arrowS3Resolved *entry;
+	MemoryContext oldcxt;
+	ArrowFooter	footer;
+	ListCell   *lc;
+	File		fdesc;
+	char	   *buf;
+	char		etag[128];
+	uint64		object_sz;
+	size_t		tail_sz;
+	size_t		required;
+	off_t	   *offsets;
+	size_t	   *lengths;
+	off_t		__offsets[2];
+	size_t		__lengths[2];
+	int			i, k;
+
+	if (!arrow_s3_cache_dir)
+		elog(ERROR, "arrow_fdw: arrow_fdw.s3_cache_dir must be configured to read '%s'", url);
+	foreach (lc, arrow_s3_resolved_list)
+	{
+		entry = lfirst(lc);
+		if (strcmp(entry->url, url) == 0 &&
+			entry->lxid == MyProc->lxid)
+			return pstrdup(entry->cache_path);
+	}
+	__arrowS3ParseURL(&s3obj, url);
+#ifdef WITH_LIBCURL
+	__arrowS3HeadObject(&s3obj, &object_sz, etag);
+#else
+	elog(ERROR, "arrow_fdw: PG-Strom was built without libcurl, so unable to read '%s'", url);
+#endif
+	__arrowS3SetupCacheFile(&s3obj, object_sz, etag);
+
+	/* fetch the signature and the footer */
+	tail_sz = Min(object_sz, ARROW_S3_CACHE_BLOCKSZ);
+	fdesc = PathNameOpenFile(s3obj.cache_path, O_RDONLY | PG_BINARY);
+	if (fdesc < 0)
+		elog(ERROR, "failed on open('%s'): %m", s3obj.cache_path);
+	for (;;)
+	{
+		__offsets[0] = 0;
+		__lengths[0] = Min(object_sz, ARROW_S3_CACHE_BLOCKSZ);
+		__offsets[1] = object_sz - tail_sz;
+		__lengths[1] = tail_sz;
+		__arrowS3FetchCacheRanges(&s3obj, 2, __offsets, __lengths);
+
+		buf = palloc(Max(tail_sz, 8));
+		if (pread(FileGetRawDesc(fdesc), buf, 8, 0) != 8 ||
+			memcmp(buf, "ARROW1\0\0", 8) != 0)
+			elog(ERROR, "arrow_fdw: '%s' is not an Apache Arrow file", url);
+		if (pread(FileGetRawDesc(fdesc), buf, tail_sz,
+				  object_sz - tail_sz) != tail_sz)
+			elog(ERROR, "failed on pread('%s'): %m", s3obj.cache_path);
+		required = readArrowFooterTail(buf, tail_sz, &footer);
+		pfree(buf);
+		if (required == 0)
+			break;
+		if (required > object_sz)
+			elog(ERROR, "arrow_fdw: '%s' is not an Apache Arrow file", url);
+		tail_sz = required;
+	}
+	FileClose(fdesc);
+
+	/*
+	 * fetch the metadata of RecordBatches, and the entire DictionaryBatches
+	 * because dictionaries are usually small and shared by RecordBatches.
+	 */
+	k = footer._num_dictionaries + footer._num_recordBatches;
+	offsets = palloc(sizeof(off_t) * Max(k, 1));
+	lengths = palloc(sizeof(size_t) * Max(k, 1));
+	for (i=0, k=0; i < footer._num_dictionaries; i++, k++)
+	{
+		ArrowBlock *b = &footer.dictionaries[i];
+
+		offsets[k] = b->offset;
+		lengths[k] = b->metaDataLength + b->bodyLength;
+	}
+	for (i=0; i < footer._num_recordBatches; i++, k++)
+	{
+		ArrowBlock *b = &footer.recordBatches[i];
+
+		offsets[k] = b->offset;
+		lengths[k] = b->metaDataLength;
+	}
+	__arrowS3FetchCacheRanges(&s3obj, k, offsets, lengths);
+	pfree(offsets);
+	pfree(lengths);
+
+	/* remember the resolved URL in this transaction */
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	foreach (lc, arrow_s3_resolved_list)
+	{
+		entry = lfirst(lc);
+		if (strcmp(entry->url, url) == 0)
+			break;
+	}
+	if (!lc)
+	{
+		entry = palloc0(sizeof(arrowS3Resolved));
+		entry->url = pstrdup(url);
+		entry->cache_path = pstrdup(s3obj.cache_path);
+		arrow_s3_resolved_list = lappend(arrow_s3_resolved_list, entry);
+	}
+	entry->lxid = MyProc->lxid;
+	MemoryContextSwitchTo(oldcxt);
+
+	return s3obj.cache_path;
+}
+
+/*
+ * pgstrom_init_arrow_s3
+ */
+void
+pgstrom_init_arrow_s3(void)
+{
+	/*
+	 * Local directory to cache the files on the object storage
+	 */
+	DefineCustomStringVariable("arrow_fdw.s3_cache_dir",
+							   "directory to cache arrow files on the object storage",
+							   NULL,
+							   &arrow_s3_cache_dir,
+							   NULL,
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE | GUC_SUPERUSER_ONLY,
+							   NULL, NULL, NULL);
+	if (arrow_s3_cache_dir && *arrow_s3_cache_dir == '\0')
+		arrow_s3_cache_dir = NULL;
+
+	/*
+	 * Endpoint of S3 compatible storage; AWS S3, if NULL
+	 */
+	DefineCustomStringVariable("arrow_fdw.s3_endpoint",
+							   "endpoint URL of the S3 compatible object storage",
+							   NULL,
+							   &arrow_s3_endpoint,
+							   NULL,
+							   PGC_SUSET,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	DefineCustomStringVariable("arrow_fdw.s3_region",
+							   "region of the object storage",
+							   NULL,
+							   &arrow_s3_region,
+							   "us-east-1",
+							   PGC_SUSET,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+
+	/*
+	 * Number of concurrent ranged GET requests
+	 */
+	DefineCustomIntVariable("arrow_fdw.s3_max_requests",
+							"max number of concurrent requests to the object storage",
+							NULL,
+							&arrow_s3_max_requests,
+							16,
+							1,
+							256,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+}
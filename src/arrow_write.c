@@ -8,6 +8,7 @@
  */
 #include "postgres.h"
 #include <assert.h>
+#include <math.h>
 #include "arrow_ipc.h"
 
 typedef struct
@@ -905,6 +906,188 @@ setupArrowDictionaryEncoding(ArrowDictionaryEncoding *dict,
 	dict->isOrdered = false;
 }
 
+/*
+ * setupArrowFieldStat - makes custom metadata of min/max statistics
+ *
+ * Per record batch min/max values are saved as "min_values" and "max_values"
+ * custom metadata of the Field; a comma separated list of the raw values in
+ * Arrow representation. Empty item means no statistics for the record batch.
+ */
+static char *
+__setupArrowFieldStatValues(SQLfield *column, bool is_max)
+{
+	size_t		len = 0;
+	size_t		sz = 256;
+	char	   *buf = palloc(sz);
+	int			i;
+
+	buf[0] = '\0';
+	for (i=0; i < column->stat_nitems; i++)
+	{
+		SQLstat	   *stat = &column->stat_values[i];
+		char		temp[64];
+		int			n = 0;
+
+		if (stat->is_valid)
+		{
+			/*
+			 * NaN is larger than any other values in PostgreSQL, so max is
+			 * NaN if the record batch has any.
+			 */
+			if (column->arrow_type.node.tag == ArrowNodeTag__FloatingPoint)
+			{
+				if (is_max && stat->has_nan)
+					n = snprintf(temp, sizeof(temp), "NaN");
+				else
+					n = snprintf(temp, sizeof(temp), "%.17g",
+								 is_max ? stat->max.f : stat->min.f);
+			}
+			else
+				n = snprintf(temp, sizeof(temp), "%ld",
+							 (long)(is_max ? stat->max.i : stat->min.i));
+		}
+		while (len + n + 2 > sz)
+		{
+			sz *= 2;
+			buf = repalloc(buf, sz);
+		}
+		if (i > 0)
+			buf[len++] = ',';
+		memcpy(buf + len, temp, n);
+		len += n;
+		buf[len] = '\0';
+	}
+	return buf;
+}
+
+static void
+setupArrowFieldStat(ArrowField *field, SQLfield *column)
+{
+	ArrowKeyValue *kv;
+	int			i, j;
+
+	kv = palloc0(sizeof(ArrowKeyValue) * (column->numCustomMetadata + 2));
+	for (i=0, j=0; i < column->numCustomMetadata; i++)
+	{
+		ArrowKeyValue *curr = &column->customMetadata[i];
+
+		/* statistics in the past are already merged to stat_values */
+		if (strcmp(curr->key, "min_values") == 0 ||
+			strcmp(curr->key, "max_values") == 0)
+			continue;
+		kv[j++] = *curr;
+	}
+	initArrowNode(&kv[j], KeyValue);
+	kv[j].key = "min_values";
+	kv[j]._key_len = strlen(kv[j].key);
+	kv[j].value = __setupArrowFieldStatValues(column, false);
+	kv[j]._value_len = strlen(kv[j].value);
+	j++;
+	initArrowNode(&kv[j], KeyValue);
+	kv[j].key = "max_values";
+	kv[j]._key_len = strlen(kv[j].key);
+	kv[j].value = __setupArrowFieldStatValues(column, true);
+	kv[j]._value_len = strlen(kv[j].value);
+	j++;
+
+	field->_num_custom_metadata = j;
+	field->custom_metadata = kv;
+}
+
+/*
+ * arrowFieldStatValues - fetch a token of min/max statistics
+ *
+ * "min_values" and "max_values" custom metadata of the Field have comma
+ * separated values for each RecordBatch. An empty token means the
+ * RecordBatch has no statistics.
+ */
+bool
+arrowFieldStatValues(ArrowField *field, const char *key,
+					 int rb_index, char *buf, size_t bufsz)
+{
+	const char *pos = NULL;
+	const char *tail;
+	int			i;
+
+	for (i=0; i < field->_num_custom_metadata; i++)
+	{
+		ArrowKeyValue *kv = &field->custom_metadata[i];
+
+		if (strcmp(kv->key, key) == 0)
+		{
+			pos = kv->value;
+			break;
+		}
+	}
+	if (!pos)
+		return false;
+	for (i=0; i < rb_index; i++)
+	{
+		pos = strchr(pos, ',');
+		if (!pos)
+			return false;
+		pos++;
+	}
+	tail = strchr(pos, ',');
+	if (!tail)
+		tail = pos + strlen(pos);
+	if (tail == pos || tail - pos >= bufsz)
+		return false;
+	memcpy(buf, pos, tail - pos);
+	buf[tail - pos] = '\0';
+	return true;
+}
+
+/*
+ * restoreArrowFieldStat - restore min/max statistics already in the file
+ */
+void
+restoreArrowFieldStat(SQLfield *column, ArrowField *field, int nitems)
+{
+	int			i;
+
+	if (!column->stat_enabled || nitems == 0)
+		return;
+	column->stat_values = palloc0(sizeof(SQLstat) * (nitems + 32));
+	column->stat_nrooms = nitems + 32;
+	column->stat_nitems = nitems;
+	for (i=0; i < nitems; i++)
+	{
+		SQLstat	   *stat = &column->stat_values[i];
+		char		min_buf[64];
+		char		max_buf[64];
+		char	   *min_end;
+		char	   *max_end;
+
+		if (!arrowFieldStatValues(field, "min_values", i,
+								  min_buf, sizeof(min_buf)) ||
+			!arrowFieldStatValues(field, "max_values", i,
+								  max_buf, sizeof(max_buf)))
+			continue;
+		errno = 0;
+		if (column->arrow_type.node.tag == ArrowNodeTag__FloatingPoint)
+		{
+			stat->min.f = strtod(min_buf, &min_end);
+			stat->max.f = strtod(max_buf, &max_end);
+		}
+		else
+		{
+			stat->min.i = strtol(min_buf, &min_end, 10);
+			stat->max.i = strtol(max_buf, &max_end, 10);
+		}
+		if (*min_end != '\0' || *max_end != '\0' || errno != 0)
+			continue;
+		if (column->arrow_type.node.tag == ArrowNodeTag__FloatingPoint)
+		{
+			if (isnan(stat->min.f))
+				continue;
+			if (isnan(stat->max.f))
+				stat->has_nan = true;
+		}
+		stat->is_valid = true;
+	}
+}
+
 static void
 setupArrowField(ArrowField *field, SQLfield *column)
 {
@@ -939,6 +1122,9 @@ setupArrowField(ArrowField *field, SQLfield *column)
 	/* custom metadata, if any */
 	field->_num_custom_metadata = column->numCustomMetadata;
 	field->custom_metadata = column->customMetadata;
+	/* min/max statistics, if any */
+	if (column->stat_enabled && column->stat_nitems > 0)
+		setupArrowFieldStat(field, column);
 }
 
 ssize_t
@@ -1361,6 +1547,120 @@ writeArrowBuffer(int fdesc, SQLfield *column)
 	}
 }
 
+/*
+ * sql_field_update_stat - collect min/max values of the current record batch
+ *
+ * NaN of FloatingPoint is not a part of min/max, but marked by has_nan.
+ */
+#define __UPDATE_FIELD_STAT(TYPE,FIELD,IS_NAN)					\
+	do {														\
+		for (k=0; k < column->nitems; k++)						\
+		{														\
+			TYPE	__val;										\
+																\
+			if (nullmap && (nullmap[k>>3] & (1<<(k&7))) == 0)	\
+				continue;										\
+			__val = ((TYPE *)column->values.data)[k];			\
+			if (IS_NAN)											\
+			{													\
+				stat->has_nan = true;							\
+				continue;										\
+			}													\
+			if (!stat->is_valid)								\
+			{													\
+				stat->min.FIELD = __val;						\
+				stat->max.FIELD = __val;						\
+				stat->is_valid = true;							\
+			}													\
+			else if (__val < stat->min.FIELD)					\
+				stat->min.FIELD = __val;						\
+			else if (__val > stat->max.FIELD)					\
+				stat->max.FIELD = __val;						\
+		}														\
+	} while(0)
+
+static void
+sql_field_update_stat(SQLfield *column, int rb_index)
+{
+	ArrowType  *t = &column->arrow_type;
+	uint8	   *nullmap = NULL;
+	SQLstat	   *stat;
+	long		k;
+
+	if (rb_index >= column->stat_nrooms)
+	{
+		int		nrooms = Max(2 * column->stat_nrooms, rb_index + 32);
+
+		if (!column->stat_values)
+			column->stat_values = palloc(sizeof(SQLstat) * nrooms);
+		else
+			column->stat_values = repalloc(column->stat_values,
+										   sizeof(SQLstat) * nrooms);
+		column->stat_nrooms = nrooms;
+	}
+	/* record batches without statistics, if any */
+	while (column->stat_nitems <= rb_index)
+		memset(&column->stat_values[column->stat_nitems++], 0,
+			   sizeof(SQLstat));
+	stat = &column->stat_values[rb_index];
+
+	if (column->nullcount > 0)
+		nullmap = (uint8 *)column->nullmap.data;
+	switch (t->node.tag)
+	{
+		case ArrowNodeTag__Int:
+			if (t->Int.bitWidth == 8)
+			{
+				if (t->Int.is_signed)
+					__UPDATE_FIELD_STAT(int8, i, false);
+				else
+					__UPDATE_FIELD_STAT(uint8, i, false);
+			}
+			else if (t->Int.bitWidth == 16)
+			{
+				if (t->Int.is_signed)
+					__UPDATE_FIELD_STAT(int16, i, false);
+				else
+					__UPDATE_FIELD_STAT(uint16, i, false);
+			}
+			else if (t->Int.bitWidth == 32)
+			{
+				if (t->Int.is_signed)
+					__UPDATE_FIELD_STAT(int32, i, false);
+				else
+					__UPDATE_FIELD_STAT(uint32, i, false);
+			}
+			else if (t->Int.bitWidth == 64 && t->Int.is_signed)
+				__UPDATE_FIELD_STAT(int64, i, false);
+			break;
+		case ArrowNodeTag__FloatingPoint:
+			if (t->FloatingPoint.precision == ArrowPrecision__Single)
+				__UPDATE_FIELD_STAT(float, f, isnan(__val));
+			else if (t->FloatingPoint.precision == ArrowPrecision__Double)
+				__UPDATE_FIELD_STAT(double, f, isnan(__val));
+			break;
+		case ArrowNodeTag__Date:
+			if (t->Date.unit == ArrowDateUnit__Day)
+				__UPDATE_FIELD_STAT(int32, i, false);
+			else
+				__UPDATE_FIELD_STAT(int64, i, false);
+			break;
+		case ArrowNodeTag__Time:
+			if (t->Time.bitWidth == 32)
+				__UPDATE_FIELD_STAT(int32, i, false);
+			else
+				__UPDATE_FIELD_STAT(int64, i, false);
+			break;
+		case ArrowNodeTag__Timestamp:
+			__UPDATE_FIELD_STAT(int64, i, false);
+			break;
+		default:
+			/* not supported */
+			break;
+	}
+}
+#undef __UPDATE_FIELD_STAT
+
 static void
 sql_field_clear(SQLfield *column)
 {
@@ -1458,6 +1758,12 @@ writeArrowRecordBatch(SQLtable *table)
 	block->metaDataLength = metaLength;
 	block->bodyLength = bodyLength;
 
+	/* update min/max statistics, if any */
+	for (j=0; j < table->nfields; j++)
+	{
+		if (table->columns[j].stat_enabled)
+			sql_field_update_stat(&table->columns[j], index);
+	}
 	/* make the local buffer empty again */
 	for (j=0; j < table->nfields; j++)
 		sql_field_clear(&table->columns[j]);
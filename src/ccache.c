@@ -0,0 +1,1682 @@
+/*
+ * ccache.c
+ *
+ * In-memory columnar cache of heap tables, built by background workers
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+#include "arrow_ipc.h"
+
+/*
+ * ccacheChunk - a chunk of columnar cache; that is an Apache Arrow file
+ * with a single RecordBatch, built from CCACHE_CHUNK_NBLOCKS heap blocks.
+ */
+typedef struct
+{
+	dlist_node	chain;			/* link to the hash slot or free list.
+								 * zero, if invalidated during the build */
+	uint32		hash;			/* hash value of the chunk */
+	Oid			database_oid;
+	Oid			table_oid;
+	Oid			relfilenode;
+	BlockNumber	block_nr;		/* head block number of the chunk */
+	uint32		generation;		/* unique identifier of the cache file */
+	int			nattrs;			/* number of attributes on build */
+	size_t		length;			/* length of the cache file */
+	int64		nitems;			/* number of rows in the chunk */
+	TimestampTz	ctime;			/* time of the build */
+	TimestampTz	atime;			/* time of the last access */
+} ccacheChunk;
+
+#define CCACHE_CTIME_NOT_BUILD		(0)
+#define CCACHE_CTIME_IN_PROGRESS	(DT_NOEND)
+#define CCACHE_CTIME_IS_READY(ctime)			\
+	((ctime) != CCACHE_CTIME_NOT_BUILD &&		\
+	 (ctime) != CCACHE_CTIME_IN_PROGRESS)
+
+/*
+ * ccacheBuilder - status of the columnar cache builder
+ */
+#define CCBUILDER_STATE__SHUTDOWN	0
+#define CCBUILDER_STATE__STARTUP	1
+#define CCBUILDER_STATE__LOADING	2
+#define CCBUILDER_STATE__SLEEP		3
+
+typedef struct
+{
+	pid_t		pid;
+	int			state;			/* one of CCBUILDER_STATE__* */
+	Oid			database_oid;
+	Oid			table_oid;
+	BlockNumber	block_nr;
+	Latch	   *latch;
+} ccacheBuilder;
+
+/*
+ * ccacheState - shared state of the columnar cache
+ */
+typedef struct
+{
+	LWLock		lock;			/* protection of the chunks */
+	size_t		total_usage;	/* total length of the ready chunks */
+	uint32		generation;		/* generator of the cache file identifier */
+	dlist_head	free_list;		/* list of free ccacheChunk */
+	slock_t		builders_lock;	/* protection of the builders[] */
+	ccacheBuilder builders[FLEXIBLE_ARRAY_MEMBER];
+} ccacheState;
+
+/*
+ * ccacheScanState - per-scan state of the columnar cache
+ */
+struct ccacheScanState
+{
+	Oid			database_oid;
+	Oid			table_oid;
+	Oid			relfilenode;
+	int			nattrs;
+};
+typedef struct ccacheScanState	ccacheScanState;
+
+/* static variables */
+static shmem_startup_hook_type shmem_startup_next = NULL;
+static char		   *ccache_base_dir;			/* GUC */
+static char		   *ccache_databases;			/* GUC */
+static int			ccache_num_builders;		/* GUC */
+static bool			ccache_log_output;			/* GUC */
+static int			ccache_total_size_kb;		/* GUC */
+static char		   *ccache_base_path = NULL;
+static ccacheState *ccache_state = NULL;		/* shmem */
+static dlist_head  *ccache_hash_slots = NULL;	/* shmem */
+static ccacheChunk *ccache_chunks = NULL;		/* shmem */
+static int			ccache_num_slots;
+static int			ccache_num_chunks;
+static Oid			ccache_invalidator_func_oid = InvalidOid;
+static char		   *ccache_page_buffer = NULL;
+static int			ccache_builder_id = -1;
+static volatile bool ccache_builder_got_sigterm = false;
+static volatile bool ccache_builder_got_sighup = false;
+
+#define CCACHE_LOG		(ccache_log_output ? LOG : DEBUG2)
+#define ccache_total_size	((size_t)ccache_total_size_kb << 10)
+
+void	ccacheBuilderMain(Datum arg);
+Datum	pgstrom_ccache_invalidator(PG_FUNCTION_ARGS);
+Datum	pgstrom_ccache_invalidate(PG_FUNCTION_ARGS);
+Datum	pgstrom_ccache_prewarm(PG_FUNCTION_ARGS);
+Datum	pgstrom_ccache_info(PG_FUNCTION_ARGS);
+Datum	pgstrom_ccache_builder_info(PG_FUNCTION_ARGS);
+
+/*
+ * ccache_compute_hash
+ */
+static inline uint32
+ccache_compute_hash(Oid database_oid, Oid table_oid, BlockNumber block_nr)
+{
+	struct {
+		Oid			database_oid;
+		Oid			table_oid;
+		BlockNumber	block_nr;
+	} key;
+
+	key.database_oid = database_oid;
+	key.table_oid    = table_oid;
+	key.block_nr     = block_nr;
+
+	return hash_any((unsigned char *)&key, sizeof(key));
+}
+
+/*
+ * ccache_chunk_filename
+ */
+static inline void
+ccache_chunk_filename(char *fname, const ccacheChunk *cc_chunk)
+{
+	snprintf(fname, MAXPGPATH, "%s/CC%u_%u_%u_%u.%u.arrow",
+			 ccache_base_path,
+			 cc_chunk->database_oid,
+			 cc_chunk->table_oid,
+			 cc_chunk->relfilenode,
+			 cc_chunk->block_nr,
+			 cc_chunk->generation);
+}
+
+/*
+ * ccache_lookup_chunk_nolock
+ */
+static ccacheChunk *
+ccache_lookup_chunk_nolock(Oid database_oid, Oid table_oid,
+						   BlockNumber block_nr)
+{
+	uint32		hash = ccache_compute_hash(database_oid,
+										   table_oid,
+										   block_nr);
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &ccache_hash_slots[hash % ccache_num_slots])
+	{
+		ccacheChunk *cc_temp = dlist_container(ccacheChunk, chain, iter.cur);
+
+		if (cc_temp->hash == hash &&
+			cc_temp->database_oid == database_oid &&
+			cc_temp->table_oid == table_oid &&
+			cc_temp->block_nr == block_nr)
+			return cc_temp;
+	}
+	return NULL;
+}
+
+/*
+ * ccache_detach_chunk_nolock
+ *
+ * It detaches the chunk from the hash slot. A ready chunk is moved to the
+ * free list, and its copy is appended to the @victims to remove the cache
+ * file out of the lock. A chunk under the build has zero chain, then the
+ * builder discards the result.
+ */
+static List *
+ccache_detach_chunk_nolock(ccacheChunk *cc_chunk, List *victims)
+{
+	dlist_delete(&cc_chunk->chain);
+	memset(&cc_chunk->chain, 0, sizeof(dlist_node));
+	if (CCACHE_CTIME_IS_READY(cc_chunk->ctime))
+	{
+		ccacheChunk *cc_copy = palloc(sizeof(ccacheChunk));
+
+		memcpy(cc_copy, cc_chunk, sizeof(ccacheChunk));
+		victims = lappend(victims, cc_copy);
+
+		Assert(ccache_state->total_usage >= cc_chunk->length);
+		ccache_state->total_usage -= cc_chunk->length;
+		cc_chunk->ctime = CCACHE_CTIME_NOT_BUILD;
+		dlist_push_head(&ccache_state->free_list, &cc_chunk->chain);
+	}
+	return victims;
+}
+
+/*
+ * ccache_remove_victims - remove cache files of the detached chunks
+ */
+static int
+ccache_remove_victims(List *victims)
+{
+	ListCell   *lc;
+	char		fname[MAXPGPATH];
+	int			count = 0;
+
+	foreach (lc, victims)
+	{
+		ccacheChunk *cc_chunk = lfirst(lc);
+
+		ccache_chunk_filename(fname, cc_chunk);
+		if (unlink(fname) != 0 && errno != ENOENT)
+			elog(WARNING, "failed on unlink('%s'): %m", fname);
+		elog(CCACHE_LOG, "ccache: table %u, block %u invalidation",
+			 cc_chunk->table_oid, cc_chunk->block_nr);
+		count++;
+	}
+	list_free_deep(victims);
+
+	return count;
+}
+
+/*
+ * ccache_invalidate_chunks
+ *
+ * It invalidates the chunk that contains @block_nr, or all the chunks of
+ * the table if @block_nr is InvalidBlockNumber.
+ */
+static int
+ccache_invalidate_chunks(Oid database_oid, Oid table_oid,
+						 BlockNumber block_nr)
+{
+	List	   *victims = NIL;
+	int			i;
+
+	if (!ccache_state)
+		return 0;
+	LWLockAcquire(&ccache_state->lock, LW_EXCLUSIVE);
+	if (block_nr != InvalidBlockNumber)
+	{
+		ccacheChunk *cc_chunk;
+
+		block_nr -= (block_nr % CCACHE_CHUNK_NBLOCKS);
+		cc_chunk = ccache_lookup_chunk_nolock(database_oid,
+											  table_oid,
+											  block_nr);
+		if (cc_chunk)
+			victims = ccache_detach_chunk_nolock(cc_chunk, victims);
+	}
+	else
+	{
+		for (i=0; i < ccache_num_slots; i++)
+		{
+			dlist_mutable_iter iter;
+
+			dlist_foreach_modify(iter, &ccache_hash_slots[i])
+			{
+				ccacheChunk *cc_temp = dlist_container(ccacheChunk,
+													   chain, iter.cur);
+				if (cc_temp->database_oid == database_oid &&
+					cc_temp->table_oid == table_oid)
+					victims = ccache_detach_chunk_nolock(cc_temp, victims);
+			}
+		}
+	}
+	LWLockRelease(&ccache_state->lock);
+
+	return ccache_remove_victims(victims);
+}
+
+/*
+ * ccache_purge_chunks
+ *
+ * It invalidates the chunks of the database which are already stale; the
+ * table is not a source of the columnar cache any more, or its storage or
+ * definition was changed after the build.
+ */
+static void
+ccache_purge_chunks(Oid database_oid, List *relids)
+{
+	List	   *victims = NIL;
+	int			i;
+
+	LWLockAcquire(&ccache_state->lock, LW_EXCLUSIVE);
+	for (i=0; i < ccache_num_slots; i++)
+	{
+		dlist_mutable_iter iter;
+
+		dlist_foreach_modify(iter, &ccache_hash_slots[i])
+		{
+			ccacheChunk *cc_temp = dlist_container(ccacheChunk,
+												   chain, iter.cur);
+			if (cc_temp->database_oid == database_oid &&
+				CCACHE_CTIME_IS_READY(cc_temp->ctime) &&
+				!list_member_oid(relids, cc_temp->table_oid))
+				victims = ccache_detach_chunk_nolock(cc_temp, victims);
+		}
+	}
+	LWLockRelease(&ccache_state->lock);
+
+	ccache_remove_victims(victims);
+}
+
+static void
+ccache_purge_relation_chunks(Relation relation)
+{
+	Oid			table_oid = RelationGetRelid(relation);
+	Oid			relfilenode = relation->rd_node.relNode;
+	int			nattrs = RelationGetNumberOfAttributes(relation);
+	List	   *victims = NIL;
+	int			i;
+
+	LWLockAcquire(&ccache_state->lock, LW_EXCLUSIVE);
+	for (i=0; i < ccache_num_slots; i++)
+	{
+		dlist_mutable_iter iter;
+
+		dlist_foreach_modify(iter, &ccache_hash_slots[i])
+		{
+			ccacheChunk *cc_temp = dlist_container(ccacheChunk,
+												   chain, iter.cur);
+			if (cc_temp->database_oid == MyDatabaseId &&
+				cc_temp->table_oid == table_oid &&
+				CCACHE_CTIME_IS_READY(cc_temp->ctime) &&
+				(cc_temp->relfilenode != relfilenode ||
+				 cc_temp->nattrs != nattrs))
+				victims = ccache_detach_chunk_nolock(cc_temp, victims);
+		}
+	}
+	LWLockRelease(&ccache_state->lock);
+
+	ccache_remove_victims(victims);
+}
+
+/*
+ * ccache_invalidator_oid - returns OID of invalidator trigger function
+ */
+static Oid
+ccache_invalidator_oid(bool missing_ok)
+{
+	Oid			pgstrom_namespace_oid;
+	oidvector	proc_args;
+	Form_pg_proc proc_form;
+	HeapTuple	tup;
+	PGFunction	invalidator_fn;
+	Oid			invalidator_oid;
+	Datum		datum;
+	bool		isnull;
+	char	   *probin;
+	char	   *prosrc;
+
+	if (OidIsValid(ccache_invalidator_func_oid))
+		return ccache_invalidator_func_oid;
+
+	pgstrom_namespace_oid = get_namespace_oid("pgstrom", missing_ok);
+	if (!OidIsValid(pgstrom_namespace_oid))
+		return InvalidOid;
+
+	SET_VARSIZE(&proc_args, offsetof(oidvector, values));
+	proc_args.ndim = 1;
+	proc_args.dataoffset = 0;
+	proc_args.elemtype = OIDOID;
+	proc_args.dim1 = 0;
+	proc_args.lbound1 = 1;
+
+	tup = SearchSysCache3(PROCNAMEARGSNSP,
+						  CStringGetDatum("ccache_invalidator"),
+						  PointerGetDatum(&proc_args),
+						  ObjectIdGetDatum(pgstrom_namespace_oid));
+	if (!HeapTupleIsValid(tup))
+	{
+		if (!missing_ok)
+			elog(ERROR, "cache lookup failed for function pgstrom.ccache_invalidator");
+		return InvalidOid;
+	}
+	invalidator_oid = PgProcTupleGetOid(tup);
+	proc_form = (Form_pg_proc) GETSTRUCT(tup);
+
+	if (proc_form->prolang != ClanguageId)
+		elog(ERROR, "pgstrom.ccache_invalidator is not C function");
+
+	datum = SysCacheGetAttr(PROCOID, tup, Anum_pg_proc_prosrc, &isnull);
+	if (isnull)
+		elog(ERROR, "null prosrc for pgstrom.ccache_invalidator function");
+	prosrc = TextDatumGetCString(datum);
+
+	datum = SysCacheGetAttr(PROCOID, tup, Anum_pg_proc_probin, &isnull);
+	if (isnull)
+		elog(ERROR, "null probin for pgstrom.ccache_invalidator function");
+	probin = TextDatumGetCString(datum);
+	ReleaseSysCache(tup);
+
+	invalidator_fn = load_external_function(probin, prosrc,
+											!missing_ok, NULL);
+	if (invalidator_fn != pgstrom_ccache_invalidator)
+		return InvalidOid;
+
+	ccache_invalidator_func_oid = invalidator_oid;
+	return ccache_invalidator_func_oid;
+}
+
+/*
+ * ccache_callback_on_procoid - catcache callback on PROCOID
+ */
+static void
+ccache_callback_on_procoid(Datum arg, int cacheid, uint32 hashvalue)
+{
+	Assert(cacheid == PROCOID);
+	if (OidIsValid(ccache_invalidator_func_oid))
+	{
+		Datum	fnoid = ObjectIdGetDatum(ccache_invalidator_func_oid);
+		uint32	inval_hash = GetSysCacheHashValue(PROCOID, fnoid, 0, 0, 0);
+
+		if (inval_hash == hashvalue)
+			ccache_invalidator_func_oid = InvalidOid;
+	}
+}
+
+/*
+ * RelationCanUseColumnarCache
+ *
+ * The source table of columnar cache must be a regular heap table that has
+ * the invalidator triggers on any write, and all the columns must have the
+ * data type which is restored from the Arrow file as is.
+ */
+static bool
+RelationCanUseColumnarCache(Relation relation)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	TriggerDesc *trigdesc = relation->trigdesc;
+	Oid			invalidator_oid;
+	bool		has_row_insert = false;
+	bool		has_row_update = false;
+	bool		has_row_delete = false;
+	bool		has_stmt_truncate = false;
+	int			i;
+
+	if (!ccache_state || !ccache_base_path)
+		return false;
+	if (RelationGetForm(relation)->relkind != RELKIND_RELATION)
+		return false;
+#if PG_VERSION_NUM >= 120000
+	if (RelationGetForm(relation)->relam != HEAP_TABLE_AM_OID)
+		return false;
+#endif
+	if (!trigdesc ||
+		!trigdesc->trig_insert_after_row ||
+		!trigdesc->trig_update_after_row ||
+		!trigdesc->trig_delete_after_row ||
+		!trigdesc->trig_truncate_after_statement)
+		return false;
+
+	for (i=0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
+
+		if (attr->attisdropped)
+			return false;
+		switch (attr->atttypid)
+		{
+			case BOOLOID:
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT2OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+			case DATEOID:
+			case TIMEOID:
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+			case TEXTOID:
+				break;
+			default:
+				return false;
+		}
+	}
+
+	invalidator_oid = ccache_invalidator_oid(true);
+	if (!OidIsValid(invalidator_oid))
+		return false;
+	for (i=0; i < trigdesc->numtriggers; i++)
+	{
+		Trigger	   *trigger = &trigdesc->triggers[i];
+
+		if (trigger->tgfoid != invalidator_oid)
+			continue;
+		if (trigger->tgenabled != TRIGGER_FIRES_ALWAYS)
+			continue;
+		if (TRIGGER_FOR_AFTER(trigger->tgtype))
+		{
+			if (TRIGGER_FOR_ROW(trigger->tgtype))
+			{
+				if (TRIGGER_FOR_INSERT(trigger->tgtype))
+					has_row_insert = true;
+				if (TRIGGER_FOR_UPDATE(trigger->tgtype))
+					has_row_update = true;
+				if (TRIGGER_FOR_DELETE(trigger->tgtype))
+					has_row_delete = true;
+			}
+			else
+			{
+				if (TRIGGER_FOR_TRUNCATE(trigger->tgtype))
+					has_stmt_truncate = true;
+			}
+		}
+	}
+	return (has_row_insert &&
+			has_row_update &&
+			has_row_delete &&
+			has_stmt_truncate);
+}
+
+/*
+ * ccache_update_builder_state
+ */
+static void
+ccache_update_builder_state(int state, Oid table_oid, BlockNumber block_nr)
+{
+	ccacheBuilder *builder;
+
+	if (ccache_builder_id < 0)
+		return;
+	builder = &ccache_state->builders[ccache_builder_id];
+	SpinLockAcquire(&ccache_state->builders_lock);
+	builder->state = state;
+	builder->table_oid = table_oid;
+	builder->block_nr = block_nr;
+	SpinLockRelease(&ccache_state->builders_lock);
+}
+
+/*
+ * ccache_write_chunk
+ *
+ * It reads the heap blocks of the chunk, then writes out the rows as an
+ * Arrow file with a single RecordBatch. It returns false if any blocks are
+ * not all-visible, because the chunk must be visible to any snapshots.
+ */
+static bool
+ccache_write_chunk(Relation relation, ccacheChunk *cc_chunk,
+				   BufferAccessStrategy strategy,
+				   const char *fname)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	int			natts = tupdesc->natts;
+	SQLtable   *table;
+	MemoryContext build_cxt;
+	MemoryContext tuple_cxt;
+	MemoryContext oldcxt;
+	Datum	   *values;
+	bool	   *isnull;
+	BlockNumber	block_nr;
+	struct stat	stat_buf;
+	int			fdesc;
+	bool		retval = false;
+
+	build_cxt = AllocSetContextCreate(CurrentMemoryContext,
+									  "ccache build context",
+									  ALLOCSET_DEFAULT_SIZES);
+	tuple_cxt = AllocSetContextCreate(build_cxt,
+									  "ccache tuple context",
+									  ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(build_cxt);
+
+	table = palloc0(offsetof(SQLtable, columns[natts]));
+	setupArrowSQLbufferSchema(table, tupdesc);
+	values = palloc(sizeof(Datum) * natts);
+	isnull = palloc(sizeof(bool) * natts);
+
+	for (block_nr = cc_chunk->block_nr;
+		 block_nr < cc_chunk->block_nr + CCACHE_CHUNK_NBLOCKS;
+		 block_nr++)
+	{
+		Buffer		buffer;
+		Page		page;
+		OffsetNumber lineoff;
+		OffsetNumber maxoff;
+		bool		all_visible;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buffer = ReadBufferExtended(relation, MAIN_FORKNUM, block_nr,
+									RBM_NORMAL, strategy);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buffer);
+		all_visible = PageIsAllVisible(page);
+		if (all_visible)
+			memcpy(ccache_page_buffer, page, BLCKSZ);
+		UnlockReleaseBuffer(buffer);
+		if (!all_visible)
+			goto out;
+
+		/* all the tuples on the page are visible to everybody */
+		page = (Page) ccache_page_buffer;
+		maxoff = PageGetMaxOffsetNumber(page);
+		for (lineoff = FirstOffsetNumber;
+			 lineoff <= maxoff;
+			 lineoff = OffsetNumberNext(lineoff))
+		{
+			ItemId		lpp = PageGetItemId(page, lineoff);
+			HeapTupleData tuple;
+			int			j;
+
+			if (!ItemIdIsNormal(lpp))
+				continue;
+			tuple.t_len  = ItemIdGetLength(lpp);
+			tuple.t_data = (HeapTupleHeader) PageGetItem(page, lpp);
+			tuple.t_tableOid = RelationGetRelid(relation);
+			ItemPointerSet(&tuple.t_self, block_nr, lineoff);
+
+			MemoryContextSwitchTo(tuple_cxt);
+			heap_deform_tuple(&tuple, tupdesc, values, isnull);
+			for (j=0; j < natts; j++)
+			{
+				Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+
+				if (!isnull[j] && attr->attlen == -1)
+					values[j] = PointerGetDatum(PG_DETOAST_DATUM_PACKED(values[j]));
+			}
+			MemoryContextSwitchTo(build_cxt);
+
+			for (j=0; j < natts; j++)
+			{
+				Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+				SQLfield   *column = &table->columns[j];
+				Datum		datum = values[j];
+
+				if (isnull[j])
+					sql_field_put_value(column, NULL, 0);
+				else if (attr->attbyval)
+					sql_field_put_value(column, (char *)&datum,
+										attr->attlen);
+				else
+					sql_field_put_value(column,
+										VARDATA_ANY(datum),
+										VARSIZE_ANY_EXHDR(datum));
+			}
+			table->nitems++;
+			MemoryContextReset(tuple_cxt);
+		}
+	}
+
+	/* write out the chunk as an Arrow file */
+	fdesc = OpenTransientFile(fname, O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fdesc < 0)
+		elog(ERROR, "failed on open('%s'): %m", fname);
+	table->filename = fname;
+	table->fdesc = fdesc;
+	if (__writeFile(fdesc, "ARROW1\0\0", 8) != 8)
+		elog(ERROR, "failed on __writeFile('%s'): %m", fname);
+	writeArrowSchema(table);
+	writeArrowRecordBatch(table);
+	writeArrowFooter(table);
+	if (fstat(fdesc, &stat_buf) != 0)
+		elog(ERROR, "failed on fstat('%s'): %m", fname);
+	CloseTransientFile(fdesc);
+
+	cc_chunk->length = stat_buf.st_size;
+	cc_chunk->nitems = table->nitems;
+	retval = true;
+out:
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(build_cxt);
+
+	return retval;
+}
+
+/*
+ * ccache_build_one_chunk
+ *
+ * It builds the chunk that begins from the @block_nr, if not built yet.
+ * It returns true if the chunk gets newly ready.
+ */
+static bool
+ccache_build_one_chunk(Relation relation, BlockNumber block_nr,
+					   BufferAccessStrategy strategy,
+					   Buffer *p_vmbuffer)
+{
+	Oid			table_oid = RelationGetRelid(relation);
+	ccacheChunk *cc_chunk;
+	BlockNumber	i;
+	bool		built;
+	char		fname[MAXPGPATH];
+
+	Assert((block_nr % CCACHE_CHUNK_NBLOCKS) == 0);
+	/* quick check whether the chunk is already built */
+	LWLockAcquire(&ccache_state->lock, LW_SHARED);
+	cc_chunk = ccache_lookup_chunk_nolock(MyDatabaseId, table_oid, block_nr);
+	LWLockRelease(&ccache_state->lock);
+	if (cc_chunk)
+		return false;
+
+	/* all the blocks must be all-visible */
+	for (i=0; i < CCACHE_CHUNK_NBLOCKS; i++)
+	{
+		if (!VM_ALL_VISIBLE(relation, block_nr + i, p_vmbuffer))
+			return false;
+	}
+
+	/*
+	 * Registers the chunk as in-progress prior to the read of heap blocks,
+	 * so concurrent invalidation during the build detaches the chunk.
+	 */
+	LWLockAcquire(&ccache_state->lock, LW_EXCLUSIVE);
+	if (ccache_state->total_usage >= ccache_total_size ||
+		dlist_is_empty(&ccache_state->free_list) ||
+		ccache_lookup_chunk_nolock(MyDatabaseId, table_oid, block_nr))
+	{
+		LWLockRelease(&ccache_state->lock);
+		return false;
+	}
+	cc_chunk = dlist_container(ccacheChunk, chain,
+							   dlist_pop_head_node(&ccache_state->free_list));
+	memset(cc_chunk, 0, sizeof(ccacheChunk));
+	cc_chunk->hash = ccache_compute_hash(MyDatabaseId, table_oid, block_nr);
+	cc_chunk->database_oid = MyDatabaseId;
+	cc_chunk->table_oid = table_oid;
+	cc_chunk->relfilenode = relation->rd_node.relNode;
+	cc_chunk->block_nr = block_nr;
+	cc_chunk->generation = ++ccache_state->generation;
+	cc_chunk->nattrs = RelationGetNumberOfAttributes(relation);
+	cc_chunk->ctime = CCACHE_CTIME_IN_PROGRESS;
+	dlist_push_tail(&ccache_hash_slots[cc_chunk->hash % ccache_num_slots],
+					&cc_chunk->chain);
+	LWLockRelease(&ccache_state->lock);
+
+	ccache_chunk_filename(fname, cc_chunk);
+	ccache_update_builder_state(CCBUILDER_STATE__LOADING,
+								table_oid, block_nr);
+	PG_TRY();
+	{
+		built = ccache_write_chunk(relation, cc_chunk, strategy, fname);
+	}
+	PG_CATCH();
+	{
+		LWLockAcquire(&ccache_state->lock, LW_EXCLUSIVE);
+		if (cc_chunk->chain.prev && cc_chunk->chain.next)
+			dlist_delete(&cc_chunk->chain);
+		cc_chunk->ctime = CCACHE_CTIME_NOT_BUILD;
+		dlist_push_head(&ccache_state->free_list, &cc_chunk->chain);
+		LWLockRelease(&ccache_state->lock);
+		unlink(fname);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	LWLockAcquire(&ccache_state->lock, LW_EXCLUSIVE);
+	if (built && cc_chunk->chain.prev && cc_chunk->chain.next)
+	{
+		cc_chunk->ctime = GetCurrentTimestamp();
+		cc_chunk->atime = cc_chunk->ctime;
+		ccache_state->total_usage += cc_chunk->length;
+	}
+	else
+	{
+		/* not all-visible, or invalidated during the build */
+		if (cc_chunk->chain.prev && cc_chunk->chain.next)
+			dlist_delete(&cc_chunk->chain);
+		cc_chunk->ctime = CCACHE_CTIME_NOT_BUILD;
+		dlist_push_head(&ccache_state->free_list, &cc_chunk->chain);
+		if (built)
+			unlink(fname);
+		built = false;
+	}
+	LWLockRelease(&ccache_state->lock);
+
+	if (built)
+		elog(CCACHE_LOG, "ccache: relation %s, block %u build (nitems=%ld, length=%zu)",
+			 RelationGetRelationName(relation), block_nr,
+			 cc_chunk->nitems, cc_chunk->length);
+	return built;
+}
+
+/*
+ * ccache_build_relation_chunks
+ *
+ * It builds the columnar cache of the relation up to @max_nchunks chunks,
+ * or until consumption reaches to pg_strom.ccache_total_size.
+ */
+static int
+ccache_build_relation_chunks(Relation relation, int max_nchunks)
+{
+	BufferAccessStrategy strategy = GetAccessStrategy(BAS_BULKREAD);
+	Buffer		vmbuffer = InvalidBuffer;
+	BlockNumber	nblocks = RelationGetNumberOfBlocks(relation);
+	BlockNumber	block_nr;
+	int			count = 0;
+
+	if (!ccache_page_buffer)
+		ccache_page_buffer = MemoryContextAlloc(TopMemoryContext, BLCKSZ);
+	PG_TRY();
+	{
+		for (block_nr = 0;
+			 block_nr + CCACHE_CHUNK_NBLOCKS <= nblocks;
+			 block_nr += CCACHE_CHUNK_NBLOCKS)
+		{
+			if (max_nchunks > 0 && count >= max_nchunks)
+				break;
+			if (ccache_state->total_usage >= ccache_total_size)
+				break;
+			if (ccache_build_one_chunk(relation, block_nr,
+									   strategy, &vmbuffer))
+				count++;
+		}
+	}
+	PG_CATCH();
+	{
+		if (vmbuffer != InvalidBuffer)
+			ReleaseBuffer(vmbuffer);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	if (vmbuffer != InvalidBuffer)
+		ReleaseBuffer(vmbuffer);
+	FreeAccessStrategy(strategy);
+
+	return count;
+}
+
+/*
+ * pgstrom_ccache_scan_is_available
+ *
+ * Columnar cache is available if source table is configured, and the scan
+ * references no system columns; they are not kept in the cache.
+ */
+bool
+pgstrom_ccache_scan_is_available(GpuTaskState *gts)
+{
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	int			k;
+
+	if (!relation || gts->af_state || gts->gs_state)
+		return false;
+	if (!RelationCanUseColumnarCache(relation))
+		return false;
+	for (k = bms_next_member(gts->outer_refs, -1);
+		 k >= 0;
+		 k = bms_next_member(gts->outer_refs, k))
+	{
+		if (k + FirstLowInvalidHeapAttributeNumber < 0)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * pgstrom_ccache_begin_scan
+ */
+void
+pgstrom_ccache_begin_scan(GpuTaskState *gts)
+{
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	EState	   *estate = gts->css.ss.ps.state;
+	ccacheScanState *cc_sstate;
+
+	if (!pgstrom_ccache_scan_is_available(gts) ||
+		!IsMVCCSnapshot(estate->es_snapshot))
+		return;
+
+	cc_sstate = MemoryContextAllocZero(estate->es_query_cxt,
+									   sizeof(ccacheScanState));
+	cc_sstate->database_oid = MyDatabaseId;
+	cc_sstate->table_oid = RelationGetRelid(relation);
+	cc_sstate->relfilenode = relation->rd_node.relNode;
+	cc_sstate->nattrs = RelationGetNumberOfAttributes(relation);
+
+	gts->ccache_sstate = cc_sstate;
+}
+
+/*
+ * pgstrom_ccache_end_scan
+ */
+void
+pgstrom_ccache_end_scan(GpuTaskState *gts)
+{
+	if (gts->ccache_sstate)
+		pfree(gts->ccache_sstate);
+	gts->ccache_sstate = NULL;
+}
+
+/*
+ * pgstrom_ccache_is_ready
+ */
+bool
+pgstrom_ccache_is_ready(GpuTaskState *gts, BlockNumber block_nr)
+{
+	ccacheScanState *cc_sstate = gts->ccache_sstate;
+	ccacheChunk *cc_chunk;
+	bool		retval = false;
+
+	Assert((block_nr % CCACHE_CHUNK_NBLOCKS) == 0);
+	LWLockAcquire(&ccache_state->lock, LW_SHARED);
+	cc_chunk = ccache_lookup_chunk_nolock(cc_sstate->database_oid,
+										  cc_sstate->table_oid,
+										  block_nr);
+	if (cc_chunk &&
+		CCACHE_CTIME_IS_READY(cc_chunk->ctime) &&
+		cc_chunk->relfilenode == cc_sstate->relfilenode &&
+		cc_chunk->nattrs == cc_sstate->nattrs)
+		retval = true;
+	LWLockRelease(&ccache_state->lock);
+
+	return retval;
+}
+
+/*
+ * pgstrom_ccache_load_chunk
+ *
+ * It loads the chunk that begins from @block_nr onto a PDS of
+ * KDS_FORMAT_ARROW. It returns NULL if the chunk was concurrently
+ * invalidated; caller shall read the heap blocks instead.
+ */
+pgstrom_data_store *
+pgstrom_ccache_load_chunk(GpuTaskState *gts, BlockNumber block_nr)
+{
+	ccacheScanState *cc_sstate = gts->ccache_sstate;
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	ccacheChunk *cc_chunk;
+	ccacheChunk	cc_temp;
+	pgstrom_data_store *pds;
+	char		fname[MAXPGPATH];
+
+	LWLockAcquire(&ccache_state->lock, LW_EXCLUSIVE);
+	cc_chunk = ccache_lookup_chunk_nolock(cc_sstate->database_oid,
+										  cc_sstate->table_oid,
+										  block_nr);
+	if (!cc_chunk ||
+		!CCACHE_CTIME_IS_READY(cc_chunk->ctime) ||
+		cc_chunk->relfilenode != cc_sstate->relfilenode ||
+		cc_chunk->nattrs != cc_sstate->nattrs)
+	{
+		LWLockRelease(&ccache_state->lock);
+		return NULL;
+	}
+	cc_chunk->atime = GetCurrentTimestamp();
+	memcpy(&cc_temp, cc_chunk, sizeof(ccacheChunk));
+	LWLockRelease(&ccache_state->lock);
+
+	/*
+	 * MEMO: Cache file has unique generation in the filename, so a file
+	 * removed by the concurrent invalidation is never replaced by another
+	 * one. In this case, arrowFdwLoadCacheFile() returns NULL.
+	 */
+	ccache_chunk_filename(fname, &cc_temp);
+	pds = arrowFdwLoadCacheFile(fname, relation,
+								gts->outer_refs,
+								gts->gcontext);
+	if (pds)
+		gts->ccache_count++;
+	return pds;
+}
+
+/*
+ * pgstrom_ccache_invalidator
+ */
+typedef struct
+{
+	Oid			table_oid;
+	BlockNumber	block_nr;
+} ccacheInvalidatorCache;
+
+static void
+__ccache_invalidator_row(FmgrInfo *flinfo, Relation rel, HeapTuple tuple)
+{
+	ccacheInvalidatorCache *cache = flinfo->fn_extra;
+	BlockNumber	block_nr;
+
+	if (!tuple)
+		return;
+	block_nr = ItemPointerGetBlockNumber(&tuple->t_self);
+	block_nr -= (block_nr % CCACHE_CHUNK_NBLOCKS);
+	if (!cache)
+	{
+		cache = MemoryContextAlloc(flinfo->fn_mcxt,
+								   sizeof(ccacheInvalidatorCache));
+		flinfo->fn_extra = cache;
+	}
+	else if (cache->table_oid == RelationGetRelid(rel) &&
+			 cache->block_nr == block_nr)
+		return;		/* already invalidated */
+
+	ccache_invalidate_chunks(MyDatabaseId, RelationGetRelid(rel), block_nr);
+	cache->table_oid = RelationGetRelid(rel);
+	cache->block_nr = block_nr;
+}
+
+Datum
+pgstrom_ccache_invalidator(PG_FUNCTION_ARGS)
+{
+	TriggerData	   *trigdata = (TriggerData *) fcinfo->context;
+	Relation		rel;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "%s: must be called as trigger", __FUNCTION__);
+	if (!TRIGGER_FIRED_AFTER(trigdata->tg_event))
+		elog(ERROR, "%s: must be configured as AFTER trigger", __FUNCTION__);
+	rel = trigdata->tg_relation;
+	if (TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
+	{
+		if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event) ||
+			TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
+		{
+			__ccache_invalidator_row(fcinfo->flinfo, rel,
+									 trigdata->tg_trigtuple);
+		}
+		else if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+		{
+			/* both of the chunks with older and newer version */
+			__ccache_invalidator_row(fcinfo->flinfo, rel,
+									 trigdata->tg_trigtuple);
+			__ccache_invalidator_row(fcinfo->flinfo, rel,
+									 trigdata->tg_newtuple);
+		}
+		else
+			elog(ERROR, "%s: triggered by unknown event", __FUNCTION__);
+	}
+	else
+	{
+		if (!TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
+			elog(ERROR, "%s: triggered by unknown event", __FUNCTION__);
+		ccache_invalidate_chunks(MyDatabaseId, RelationGetRelid(rel),
+								 InvalidBlockNumber);
+	}
+	PG_RETURN_POINTER(NULL);
+}
+PG_FUNCTION_INFO_V1(pgstrom_ccache_invalidator);
+
+/*
+ * pgstrom_ccache_invalidate - invalidates all the chunks of the table
+ */
+Datum
+pgstrom_ccache_invalidate(PG_FUNCTION_ARGS)
+{
+	Oid		table_oid = PG_GETARG_OID(0);
+
+	PG_RETURN_INT32(ccache_invalidate_chunks(MyDatabaseId, table_oid,
+											 InvalidBlockNumber));
+}
+PG_FUNCTION_INFO_V1(pgstrom_ccache_invalidate);
+
+/*
+ * pgstrom_ccache_prewarm
+ */
+Datum
+pgstrom_ccache_prewarm(PG_FUNCTION_ARGS)
+{
+	Oid			table_oid = PG_GETARG_OID(0);
+	Relation	relation;
+	int			count;
+
+	if (!ccache_state || !ccache_base_path)
+		elog(ERROR, "columnar cache is not available");
+	if (pg_class_aclcheck(table_oid, GetUserId(),
+						  ACL_SELECT) != ACLCHECK_OK)
+		aclcheck_error(ACLCHECK_NO_PRIV,
+					   OBJECT_TABLE,
+					   get_rel_name(table_oid));
+	relation = table_open(table_oid, AccessShareLock);
+	if (!RelationCanUseColumnarCache(relation))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("\"%s\" is not configured as source of columnar cache",
+						RelationGetRelationName(relation)),
+				 errhint("try pgstrom_ccache_enabled('%s') first",
+						 RelationGetRelationName(relation))));
+	ccache_purge_relation_chunks(relation);
+	count = ccache_build_relation_chunks(relation, -1);
+	table_close(relation, AccessShareLock);
+
+	PG_RETURN_INT32(count);
+}
+PG_FUNCTION_INFO_V1(pgstrom_ccache_prewarm);
+
+/*
+ * pgstrom_ccache_info
+ */
+Datum
+pgstrom_ccache_info(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	ccacheChunk	   *cc_chunk;
+	List		   *cc_chunks_list;
+	HeapTuple		tuple;
+	bool			isnull[7];
+	Datum			values[7];
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc		tupdesc;
+		MemoryContext	oldcxt;
+		int				i;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+
+		tupdesc = CreateTemplateTupleDesc(7);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "database_id",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "table_id",
+						   REGCLASSOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 3, "block_nr",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "nitems",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "length",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "ctime",
+						   TIMESTAMPTZOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 7, "atime",
+						   TIMESTAMPTZOID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+
+		/* collect current cache state */
+		cc_chunks_list = NIL;
+		if (ccache_state)
+		{
+			LWLockAcquire(&ccache_state->lock, LW_SHARED);
+			for (i=0; i < ccache_num_slots; i++)
+			{
+				dlist_iter	iter;
+
+				dlist_foreach(iter, &ccache_hash_slots[i])
+				{
+					ccacheChunk *cc_temp = dlist_container(ccacheChunk,
+														   chain, iter.cur);
+					if (!CCACHE_CTIME_IS_READY(cc_temp->ctime))
+						continue;
+					cc_chunk = palloc(sizeof(ccacheChunk));
+					memcpy(cc_chunk, cc_temp, sizeof(ccacheChunk));
+					cc_chunks_list = lappend(cc_chunks_list, cc_chunk);
+				}
+			}
+			LWLockRelease(&ccache_state->lock);
+		}
+		fncxt->user_fctx = cc_chunks_list;
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	cc_chunks_list = fncxt->user_fctx;
+
+	if (cc_chunks_list == NIL)
+		SRF_RETURN_DONE(fncxt);
+	cc_chunk = linitial(cc_chunks_list);
+	fncxt->user_fctx = list_delete_first(cc_chunks_list);
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = ObjectIdGetDatum(cc_chunk->database_oid);
+	values[1] = ObjectIdGetDatum(cc_chunk->table_oid);
+	values[2] = Int32GetDatum(cc_chunk->block_nr);
+	values[3] = Int64GetDatum(cc_chunk->nitems);
+	values[4] = Int64GetDatum(cc_chunk->length);
+	values[5] = TimestampTzGetDatum(cc_chunk->ctime);
+	values[6] = TimestampTzGetDatum(cc_chunk->atime);
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_ccache_info);
+
+/*
+ * pgstrom_ccache_builder_info
+ */
+Datum
+pgstrom_ccache_builder_info(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	ccacheBuilder  *builders;
+	ccacheBuilder  *builder;
+	HeapTuple		tuple;
+	bool			isnull[5];
+	Datum			values[5];
+	const char	   *state;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc		tupdesc;
+		MemoryContext	oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+
+		tupdesc = CreateTemplateTupleDesc(5);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "builder_id",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "state",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 3, "database_id",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "table_id",
+						   REGCLASSOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "block_nr",
+						   INT4OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+
+		builders = palloc0(sizeof(ccacheBuilder) * ccache_num_builders);
+		if (ccache_state)
+		{
+			SpinLockAcquire(&ccache_state->builders_lock);
+			memcpy(builders, ccache_state->builders,
+				   sizeof(ccacheBuilder) * ccache_num_builders);
+			SpinLockRelease(&ccache_state->builders_lock);
+		}
+		fncxt->user_fctx = builders;
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	builders = fncxt->user_fctx;
+
+	if (fncxt->call_cntr >= ccache_num_builders)
+		SRF_RETURN_DONE(fncxt);
+	builder = &builders[fncxt->call_cntr];
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int32GetDatum(fncxt->call_cntr);
+	switch (builder->state)
+	{
+		case CCBUILDER_STATE__STARTUP:
+			state = "startup";
+			break;
+		case CCBUILDER_STATE__LOADING:
+			state = "loading";
+			break;
+		case CCBUILDER_STATE__SLEEP:
+			state = "sleep";
+			break;
+		default:
+			state = "shutdown";
+			break;
+	}
+	values[1] = CStringGetTextDatum(state);
+	if (OidIsValid(builder->database_oid))
+		values[2] = ObjectIdGetDatum(builder->database_oid);
+	else
+		isnull[2] = true;
+	if (builder->state == CCBUILDER_STATE__LOADING)
+	{
+		values[3] = ObjectIdGetDatum(builder->table_oid);
+		values[4] = Int32GetDatum(builder->block_nr);
+	}
+	else
+	{
+		isnull[3] = true;
+		isnull[4] = true;
+	}
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_ccache_builder_info);
+
+/*
+ * ccacheBuilderSigTerm / ccacheBuilderSigHup
+ */
+static void
+ccacheBuilderSigTerm(SIGNAL_ARGS)
+{
+	int		saved_errno = errno;
+
+	ccache_builder_got_sigterm = true;
+
+	pg_memory_barrier();
+
+	SetLatch(MyLatch);
+
+	errno = saved_errno;
+}
+
+static void
+ccacheBuilderSigHup(SIGNAL_ARGS)
+{
+	int		saved_errno = errno;
+
+	ccache_builder_got_sighup = true;
+
+	pg_memory_barrier();
+
+	SetLatch(MyLatch);
+
+	errno = saved_errno;
+}
+
+/*
+ * ccacheBuilderOnExit
+ */
+static void
+ccacheBuilderOnExit(int code, Datum arg)
+{
+	ccacheBuilder *builder = &ccache_state->builders[DatumGetInt32(arg)];
+
+	SpinLockAcquire(&ccache_state->builders_lock);
+	builder->pid = 0;
+	builder->state = CCBUILDER_STATE__SHUTDOWN;
+	builder->database_oid = InvalidOid;
+	builder->table_oid = InvalidOid;
+	builder->block_nr = InvalidBlockNumber;
+	builder->latch = NULL;
+	SpinLockRelease(&ccache_state->builders_lock);
+}
+
+/*
+ * ccache_builder_database_name
+ *
+ * Builders are associated to the pg_strom.ccache_databases in rotation.
+ */
+static char *
+ccache_builder_database_name(int builder_id)
+{
+	char	   *temp = pstrdup(ccache_databases);
+	List	   *dbnames;
+	char	   *dbname = NULL;
+
+	if (!SplitIdentifierString(temp, ',', &dbnames))
+		elog(ERROR, "invalid list syntax in \"pg_strom.ccache_databases\"");
+	if (dbnames != NIL)
+		dbname = pstrdup(list_nth(dbnames, builder_id % list_length(dbnames)));
+	list_free(dbnames);
+	pfree(temp);
+
+	return dbname;
+}
+
+/*
+ * ccache_builder_wait - sleep until timeout, or any signals
+ */
+static void
+ccache_builder_wait(long timeout)
+{
+	int		ev;
+
+	ev = WaitLatch(MyLatch,
+				   WL_LATCH_SET |
+				   WL_TIMEOUT |
+				   WL_POSTMASTER_DEATH,
+				   timeout,
+				   PG_WAIT_EXTENSION);
+	ResetLatch(MyLatch);
+	if (ev & WL_POSTMASTER_DEATH)
+		elog(FATAL, "unexpected postmaster dead");
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * ccache_builder_source_relations
+ *
+ * It returns the list of relations that have the invalidator trigger.
+ */
+static List *
+ccache_builder_source_relations(void)
+{
+	Oid			invalidator_oid = ccache_invalidator_oid(true);
+	List	   *relids = NIL;
+	Relation	srel;
+	SysScanDesc	sscan;
+	HeapTuple	tuple;
+
+	if (!OidIsValid(invalidator_oid))
+		return NIL;
+
+	srel = table_open(TriggerRelationId, AccessShareLock);
+	sscan = systable_beginscan(srel, InvalidOid, false, NULL, 0, NULL);
+	while ((tuple = systable_getnext(sscan)) != NULL)
+	{
+		Form_pg_trigger	trig = (Form_pg_trigger) GETSTRUCT(tuple);
+
+		if (trig->tgfoid == invalidator_oid)
+			relids = list_append_unique_oid(relids, trig->tgrelid);
+	}
+	systable_endscan(sscan);
+	table_close(srel, AccessShareLock);
+
+	return relids;
+}
+
+/*
+ * ccache_builder_load_one_chunk
+ *
+ * It picks up the source relations in round-robin, then builds one chunk.
+ */
+static bool
+ccache_builder_load_one_chunk(void)
+{
+	static int	rr_index = -1;
+	List	   *relids;
+	int			i, nrels;
+	bool		built = false;
+
+	relids = ccache_builder_source_relations();
+	ccache_purge_chunks(MyDatabaseId, relids);
+	nrels = list_length(relids);
+	if (rr_index < 0)
+		rr_index = ccache_builder_id;
+	for (i=0; !built && i < nrels; i++)
+	{
+		Oid			relid = list_nth_oid(relids, rr_index++ % nrels);
+		Relation	relation;
+
+		relation = try_relation_open(relid, AccessShareLock);
+		if (!relation)
+			continue;
+		if (RelationCanUseColumnarCache(relation))
+		{
+			ccache_purge_relation_chunks(relation);
+			built = (ccache_build_relation_chunks(relation, 1) > 0);
+		}
+		relation_close(relation, AccessShareLock);
+	}
+	list_free(relids);
+
+	return built;
+}
+
+/*
+ * ccacheBuilderMain
+ */
+void
+ccacheBuilderMain(Datum arg)
+{
+	int			builder_id = DatumGetInt32(arg);
+	ccacheBuilder *builder = &ccache_state->builders[builder_id];
+	char	   *database_name;
+
+	pqsignal(SIGTERM, ccacheBuilderSigTerm);
+	pqsignal(SIGHUP, ccacheBuilderSigHup);
+	BackgroundWorkerUnblockSignals();
+
+	ccache_builder_id = builder_id;
+	SpinLockAcquire(&ccache_state->builders_lock);
+	builder->pid = MyProcPid;
+	builder->state = CCBUILDER_STATE__STARTUP;
+	builder->database_oid = InvalidOid;
+	builder->latch = MyLatch;
+	SpinLockRelease(&ccache_state->builders_lock);
+	on_shmem_exit(ccacheBuilderOnExit, Int32GetDatum(builder_id));
+
+	/* wait for the database assignment */
+	for (;;)
+	{
+		if (ccache_builder_got_sigterm)
+			return;
+		if (ccache_builder_got_sighup)
+		{
+			ccache_builder_got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+		database_name = ccache_builder_database_name(builder_id);
+		if (database_name)
+			break;
+		ccache_builder_wait(10000L);
+	}
+	BackgroundWorkerInitializeConnection(database_name, NULL, 0);
+	SpinLockAcquire(&ccache_state->builders_lock);
+	builder->database_oid = MyDatabaseId;
+	SpinLockRelease(&ccache_state->builders_lock);
+	elog(LOG, "PG-Strom ccache-builder%d (pid: %u) started on database \"%s\"",
+		 builder_id, MyProcPid, database_name);
+
+	/*
+	 * Event Loop
+	 */
+	while (!ccache_builder_got_sigterm)
+	{
+		bool		built;
+
+		if (ccache_builder_got_sighup)
+		{
+			char   *temp;
+
+			ccache_builder_got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+			temp = ccache_builder_database_name(builder_id);
+			if (!temp || strcmp(temp, database_name) != 0)
+			{
+				elog(LOG, "PG-Strom ccache-builder%d restart for the database reassignment",
+					 builder_id);
+				proc_exit(1);
+			}
+			pfree(temp);
+		}
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		built = ccache_builder_load_one_chunk();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		if (built)
+			CHECK_FOR_INTERRUPTS();
+		else
+		{
+			ccache_update_builder_state(CCBUILDER_STATE__SLEEP,
+										InvalidOid, InvalidBlockNumber);
+			ccache_builder_wait(5000L);
+		}
+	}
+}
+
+/*
+ * pgstrom_startup_ccache
+ */
+static void
+pgstrom_startup_ccache(void)
+{
+	size_t		required;
+	bool		found;
+	int			i;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	required = (MAXALIGN(offsetof(ccacheState,
+								  builders[ccache_num_builders])) +
+				MAXALIGN(sizeof(dlist_head) * ccache_num_slots) +
+				MAXALIGN(sizeof(ccacheChunk) * ccache_num_chunks));
+	ccache_state = ShmemInitStruct("ccache_state", required, &found);
+	ccache_hash_slots = (dlist_head *)
+		((char *)ccache_state +
+		 MAXALIGN(offsetof(ccacheState, builders[ccache_num_builders])));
+	ccache_chunks = (ccacheChunk *)
+		((char *)ccache_hash_slots +
+		 MAXALIGN(sizeof(dlist_head) * ccache_num_slots));
+	if (found)
+		return;
+
+	memset(ccache_state, 0, required);
+	LWLockInitialize(&ccache_state->lock, -1);
+	dlist_init(&ccache_state->free_list);
+	SpinLockInit(&ccache_state->builders_lock);
+	for (i=0; i < ccache_num_builders; i++)
+		ccache_state->builders[i].block_nr = InvalidBlockNumber;
+	for (i=0; i < ccache_num_slots; i++)
+		dlist_init(&ccache_hash_slots[i]);
+	for (i=0; i < ccache_num_chunks; i++)
+		dlist_push_tail(&ccache_state->free_list, &ccache_chunks[i].chain);
+}
+
+/*
+ * pgstrom_init_ccache
+ */
+void
+pgstrom_init_ccache(void)
+{
+	char			pathname[MAXPGPATH];
+	DIR			   *dir;
+	struct dirent  *dent;
+	struct statfs	statbuf;
+	long			pages_num;
+	long			pages_sz;
+	size_t			default_size;
+	int				i;
+
+	DefineCustomStringVariable("pg_strom.ccache_base_dir",
+							   "directory name used by in-memory columnar cache",
+							   NULL,
+							   &ccache_base_dir,
+							   "/dev/shm",
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	DefineCustomStringVariable("pg_strom.ccache_databases",
+							   "databases where columnar cache builders connect to",
+							   NULL,
+							   &ccache_databases,
+							   "",
+							   PGC_SIGHUP,
+							   GUC_LIST_INPUT | GUC_LIST_QUOTE,
+							   NULL, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.ccache_num_builders",
+							"number of columnar cache builders",
+							NULL,
+							&ccache_num_builders,
+							2,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	DefineCustomBoolVariable("pg_strom.ccache_log_output",
+							 "turn on/off log output by columnar cache",
+							 NULL,
+							 &ccache_log_output,
+							 false,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * default size of the columnar cache is the smaller one of 75% of the
+	 * volume where pg_strom.ccache_base_dir is, or 66% of physical memory.
+	 */
+	if (statfs(ccache_base_dir, &statbuf) != 0)
+		default_size = 0;
+	else
+		default_size = ((size_t)statbuf.f_blocks *
+						(size_t)statbuf.f_bsize * 3) / 4;
+	pages_num = sysconf(_SC_PHYS_PAGES);
+	pages_sz = sysconf(_SC_PAGESIZE);
+	if (pages_num > 0 && pages_sz > 0)
+		default_size = Min(default_size,
+						   ((size_t)pages_num * (size_t)pages_sz * 2) / 3);
+	default_size = Min(default_size >> 10, (size_t)INT_MAX);
+	DefineCustomIntVariable("pg_strom.ccache_total_size",
+							"total size of in-memory columnar cache",
+							NULL,
+							&ccache_total_size_kb,
+							(int)default_size,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	/*
+	 * Setup the cache directory; files by the previous run are removed
+	 */
+	snprintf(pathname, sizeof(pathname), "%s/.pg_strom.ccache.%u",
+			 ccache_base_dir, PostPortNumber);
+	if (mkdir(pathname, 0700) != 0 && errno != EEXIST)
+	{
+		elog(WARNING, "failed on mkdir('%s'): %m, columnar cache is disabled",
+			 pathname);
+		return;
+	}
+	dir = AllocateDir(pathname);
+	while ((dent = ReadDir(dir, pathname)) != NULL)
+	{
+		char	fname[MAXPGPATH];
+
+		if (strncmp(dent->d_name, "CC", 2) != 0)
+			continue;
+		snprintf(fname, sizeof(fname), "%s/%s", pathname, dent->d_name);
+		if (unlink(fname) != 0)
+			elog(WARNING, "failed on unlink('%s'): %m", fname);
+	}
+	FreeDir(dir);
+	ccache_base_path = MemoryContextStrdup(TopMemoryContext, pathname);
+
+	/* number of the chunks and hash slots */
+	ccache_num_chunks = Max(ccache_total_size / CCACHE_CHUNK_SIZE * 4, 1000);
+	ccache_num_slots = ccache_num_chunks / 4;
+
+	/* request for the static shared memory */
+	RequestAddinShmemSpace(MAXALIGN(offsetof(ccacheState,
+											 builders[ccache_num_builders])) +
+						   MAXALIGN(sizeof(dlist_head) * ccache_num_slots) +
+						   MAXALIGN(sizeof(ccacheChunk) * ccache_num_chunks));
+	shmem_startup_next = shmem_startup_hook;
+	shmem_startup_hook = pgstrom_startup_ccache;
+
+	/* register columnar cache builders */
+	for (i=0; i < ccache_num_builders; i++)
+	{
+		BackgroundWorker worker;
+
+		memset(&worker, 0, sizeof(BackgroundWorker));
+		snprintf(worker.bgw_name, sizeof(worker.bgw_name),
+				 "PG-Strom ccache-builder%d", i);
+		worker.bgw_flags = (BGWORKER_SHMEM_ACCESS |
+							BGWORKER_BACKEND_DATABASE_CONNECTION);
+		worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+		worker.bgw_restart_time = 1;
+
+		snprintf(worker.bgw_library_name,
+				 BGW_MAXLEN, "pg_strom");
+		snprintf(worker.bgw_function_name,
+				 BGW_MAXLEN, "ccacheBuilderMain");
+		worker.bgw_main_arg = Int32GetDatum(i);
+		RegisterBackgroundWorker(&worker);
+	}
+
+	/* callback to reset the cached invalidator OID */
+	CacheRegisterSyscacheCallback(PROCOID, ccache_callback_on_procoid, 0);
+}
@@ -20,6 +20,7 @@
 #include "cuda_postgis.h"
 
 static MemoryContext	devinfo_memcxt;
+static int		pgstrom_gpu_decompress_bufsz;	/* GUC */
 static dlist_head	devtype_info_slot[128];
 static dlist_head	devfunc_info_slot[1024];
 static dlist_head	devcast_info_slot[48];
@@ -857,6 +858,268 @@ vlbuf_estimate_textcat(codegen_context *context,
 	return maxlen;
 }
 
+/*
+ * devfunc_textregex_result_sz
+ *
+ * Device code supports only a limited subset of the regular expression,
+ * see GenericRegexMatch() in cuda_textlib.cu. So, it checks whether the
+ * pattern is a constant and consists of the supported syntax.
+ */
+static bool
+__regex_is_escaped(const char *p, int pos)
+{
+	int		nslash = 0;
+
+	while (pos > 0 && p[pos-1] == '\\')
+	{
+		nslash++;
+		pos--;
+	}
+	return (nslash & 1) != 0;
+}
+
+static bool
+__regex_is_device_supported(const char *p, int plen, bool allow_nongreedy)
+{
+	int		natoms = 0;
+	int		c, d;
+
+	if (plen > 0 && *p == '^')
+	{
+		p++;
+		plen--;
+	}
+	if (plen > 0 && p[plen-1] == '$' && !__regex_is_escaped(p, plen-1))
+		plen--;
+	if (plen >= 4 && strncmp(p, "(?:", 3) == 0 &&
+		p[plen-1] == ')' && !__regex_is_escaped(p, plen-1))
+	{
+		p += 3;
+		plen -= 4;
+	}
+
+	while (plen > 0)
+	{
+		c = (unsigned char)*p;
+		if (c == '.')
+		{
+			p++;
+			plen--;
+		}
+		else if (c == '\\')
+		{
+			if (plen < 2)
+				return false;
+			c = (unsigned char)p[1];
+			if (c >= 0x80 ||
+				(c >= '0' && c <= '9') ||
+				(c >= 'a' && c <= 'z') ||
+				(c >= 'A' && c <= 'Z'))
+				return false;
+			p += 2;
+			plen -= 2;
+		}
+		else if (c == '[')
+		{
+			bool	has_items = false;
+
+			p++;
+			plen--;
+			if (plen > 0 && *p == '^')
+			{
+				p++;
+				plen--;
+			}
+			for (;;)
+			{
+				if (plen <= 0)
+					return false;
+				c = (unsigned char)*p;
+				if (c == ']' && has_items)
+					break;
+				if (c >= 0x80 || c == '\\' ||
+					(c == '[' && plen > 1 && (p[1] == ':' ||
+											  p[1] == '.' ||
+											  p[1] == '=')))
+					return false;
+				has_items = true;
+				if (plen > 2 && p[1] == '-' && p[2] != ']')
+				{
+					d = (unsigned char)p[2];
+					if (d >= 0x80 || d == '\\' || d == '[' || d < c)
+						return false;
+					p += 3;
+					plen -= 3;
+				}
+				else
+				{
+					p++;
+					plen--;
+				}
+			}
+			p++;
+			plen--;
+		}
+		else if (strchr("(){}*+?|^$", c) != NULL)
+			return false;
+		else
+		{
+			d = pg_mblen(p);
+			if (d < 1 || d > 4 || d > plen)
+				return false;
+			p += d;
+			plen -= d;
+		}
+		natoms++;
+
+		/* quantifier, if any */
+		if (plen > 0 && (*p == '*' || *p == '?' || *p == '+'))
+		{
+			if (*p == '+')
+				natoms++;
+			p++;
+			plen--;
+			if (plen > 0 && *p == '?')
+			{
+				/* non-greedy quantifier changes the matched substring */
+				if (!allow_nongreedy)
+					return false;
+				p++;
+				plen--;
+			}
+			if (plen > 0 && (*p == '*' || *p == '+' ||
+							 *p == '?' || *p == '{'))
+				return false;
+		}
+		else if (plen > 0 && *p == '{')
+			return false;
+		/* see REGEX_MAX_ATOMS */
+		if (natoms > 63)
+			return false;
+	}
+	return true;
+}
+
+static int
+devfunc_textregex_result_sz(codegen_context *context,
+							devfunc_info *dfunc,
+							Expr **args, int *vl_width)
+{
+	Const	   *con = (Const *)args[1];
+
+	if (!IsA(con, Const))
+		__ELog("regular expression must be a constant");
+	if (!con->constisnull)
+	{
+		text   *pattern = DatumGetTextPP(con->constvalue);
+
+		if (!__regex_is_device_supported(VARDATA_ANY(pattern),
+										 VARSIZE_ANY_EXHDR(pattern),
+										 true))
+			__ELog("regular expression is not supported on device: %s",
+				   text_to_cstring(pattern));
+	}
+	return sizeof(cl_bool);
+}
+
+/*
+ * vlbuf_estimate_regexp_replace
+ *
+ * regexp_replace() on the device requires a constant pattern with the same
+ * restrictions as textregexeq but greedy quantifiers only, a constant
+ * replacement without back-references, and only 'g' flag if any.
+ */
+static int
+vlbuf_estimate_regexp_replace(codegen_context *context,
+							  devfunc_info *dfunc,
+							  Expr **args, int *vl_width)
+{
+	Const	   *con;
+	bool		is_global = false;
+	int			rlen = 0;
+	int			maxlen;
+
+	con = (Const *)args[1];
+	if (!IsA(con, Const))
+		__ELog("regular expression must be a constant");
+	if (!con->constisnull)
+	{
+		text   *pattern = DatumGetTextPP(con->constvalue);
+
+		if (!__regex_is_device_supported(VARDATA_ANY(pattern),
+										 VARSIZE_ANY_EXHDR(pattern),
+										 false))
+			__ELog("regular expression is not supported on device: %s",
+				   text_to_cstring(pattern));
+	}
+
+	con = (Const *)args[2];
+	if (!IsA(con, Const))
+		__ELog("replacement string of regexp_replace must be a constant");
+	if (!con->constisnull)
+	{
+		text   *replace = DatumGetTextPP(con->constvalue);
+
+		rlen = VARSIZE_ANY_EXHDR(replace);
+		if (memchr(VARDATA_ANY(replace), '\\', rlen) != NULL)
+			__ELog("back-reference of regexp_replace is not supported: %s",
+				   text_to_cstring(replace));
+	}
+
+	if (list_length(dfunc->func_args) > 3)
+	{
+		con = (Const *)args[3];
+		if (!IsA(con, Const))
+			__ELog("flags of regexp_replace must be a constant");
+		if (!con->constisnull)
+		{
+			char   *flags = TextDatumGetCString(con->constvalue);
+			char   *pos;
+
+			for (pos = flags; *pos != '\0'; pos++)
+			{
+				if (*pos != 'g')
+					__ELog("regexp_replace flag '%c' is not supported", *pos);
+				is_global = true;
+			}
+		}
+	}
+
+	if (vl_width[0] < 0)
+		__ELog("unable to estimate result size of regexp_replace");
+	/* every character may be replaced, if global */
+	if (is_global)
+		maxlen = vl_width[0] + (vl_width[0] + 1) * rlen;
+	else
+		maxlen = vl_width[0] + rlen;
+	/* it consumes varlena buffer on run-time */
+	context->varlena_bufsz += MAXALIGN(maxlen + VARHDRSZ);
+
+	return maxlen;
+}
+
+/*
+ * vlbuf_estimate_textcase
+ *
+ * upper/lower on the device converts only ASCII characters, so it is
+ * available only if LC_CTYPE of the collation is C-locale.
+ */
+static int
+vlbuf_estimate_textcase(codegen_context *context,
+						devfunc_info *dfunc,
+						Expr **args, int *vl_width)
+{
+	if (OidIsValid(dfunc->func_collid) &&
+		!lc_ctype_is_c(dfunc->func_collid))
+		__ELog("%s is not supported on the collation", dfunc->func_sqlname);
+	if (vl_width[0] < 0)
+		__ELog("unable to estimate result size of %s", dfunc->func_sqlname);
+	/* it consumes varlena buffer on run-time */
+	context->varlena_bufsz += MAXALIGN(vl_width[0] + VARHDRSZ);
+
+	return vl_width[0];
+}
+
 static int
 vlbuf_estimate_substring(codegen_context *context,
 						 devfunc_info *dfunc,
@@ -890,6 +1153,18 @@ vlbuf_estimate_jsonb(codegen_context *context,
 	return TOAST_TUPLE_THRESHOLD;
 }
 
+static int
+vlbuf_estimate_jsonb_path(codegen_context *context,
+						  devfunc_info *dfunc,
+						  Expr **args, int *vl_width)
+{
+	/* path elements must be text[]; same as variadic text argument */
+	if (exprType((Node *)args[1]) != TEXTARRAYOID)
+		__ELog("jsonb path must be text[], but %s",
+			   format_type_be(exprType((Node *)args[1])));
+	return vlbuf_estimate_jsonb(context, dfunc, args, vl_width);
+}
+
 static int
 vlbuf_estimate__st_makepoint(codegen_context *context,
 							 devfunc_info *dfunc,
@@ -1409,6 +1684,22 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	{ NULL, "float8 sin(float8)",     5, "m/f:sin" },
 	{ NULL, "float8 tan(float8)",     5, "m/f:tan" },
 
+	/*
+	 * Array functions
+	 * ------------------------- */
+	{ NULL, "int4 array_ndims(array)",       1, "m/f:array_ndims" },
+	{ NULL, "int4 array_length(array,int4)", 1, "m/f:array_length" },
+	{ NULL, "int4 cardinality(array)",       1, "m/f:cardinality" },
+	/* vector distance functions on float2/float4/float8 arrays */
+	{ PGSTROM, "float8 vector_l2_distance(array,array)",
+	  100, "m/f:vector_l2_distance" },
+	{ PGSTROM, "float8 vector_inner_product(array,array)",
+	  100, "m/f:vector_inner_product" },
+	{ PGSTROM, "float8 vector_negative_inner_product(array,array)",
+	  100, "m/f:vector_negative_inner_product" },
+	{ PGSTROM, "float8 vector_cosine_distance(array,array)",
+	  100, "m/f:vector_cosine_distance" },
+
 	/*
 	 * Numeric functions
 	 * ------------------------- */
@@ -1651,6 +1942,16 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	  100, "t/f:extract_timetz"},
 	{ NULL, "float8 date_part(text,time)",
 	  100, "t/f:extract_time"},
+	/* date_trunc() */
+	{ NULL, "timestamp date_trunc(text,timestamp)",
+	  50, "t/f:timestamp_trunc"},
+	{ NULL, "timestamptz date_trunc(text,timestamptz)",
+	  50, "t/f:timestamptz_trunc"},
+	/* time_bucket() */
+	{ PGSTROM, "timestamp time_bucket(interval,timestamp)",
+	  5, "t/f:time_bucket_timestamp"},
+	{ PGSTROM, "timestamptz time_bucket(interval,timestamptz)",
+	  5, "t/f:time_bucket_timestamptz"},
 
 	/* other time and data functions */
 	{ NULL, "timestamptz now()", 1, "t/f:now" },
@@ -1710,6 +2011,15 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	{ NULL, "bool bpchariclike(text,text)",   9999, "Ls/f:bpchariclike" },
 	{ NULL, "bool texticnlike(text,text)",    9999, "Ls/f:texticnlike" },
 	{ NULL, "bool bpcharicnlike(bpchar,text)",9999, "Ls/f:bpcharicnlike" },
+	/* regular expression operators (a limited subset only) */
+	{ NULL, "bool textregexeq(text,text)",
+	  9999, "Cs/f:textregexeq",
+	  devfunc_textregex_result_sz
+	},
+	{ NULL, "bool textregexne(text,text)",
+	  9999, "Cs/f:textregexne",
+	  devfunc_textregex_result_sz
+	},
 	/* string operations */
 	{ NULL, "int4 length(text)", 2, "s/f:textlen" },
 	{ NULL, "text textcat(text,text)",
@@ -1744,6 +2054,36 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	  10, "Cs/f:text_substring_nolen",
 	  vlbuf_estimate_substring
 	},
+	{ NULL, "text lower(text)",
+	  10, "LCs/f:text_lower",
+	  vlbuf_estimate_textcase
+	},
+	{ NULL, "text upper(text)",
+	  10, "LCs/f:text_upper",
+	  vlbuf_estimate_textcase
+	},
+	{ NULL, "text regexp_replace(text,text,text)",
+	  9999, "Cs/f:regexp_replace",
+	  vlbuf_estimate_regexp_replace
+	},
+	{ NULL, "text regexp_replace(text,text,text,text)",
+	  9999, "Cs/f:regexp_replace_flags",
+	  vlbuf_estimate_regexp_replace
+	},
+	/* sketch functions for approximate aggregations */
+	{ PGSTROM, "int8 hll_hash(int2)",      5, "f:hll_hash" },
+	{ PGSTROM, "int8 hll_hash(int4)",      5, "f:hll_hash" },
+	{ PGSTROM, "int8 hll_hash(int8)",      5, "f:hll_hash" },
+	{ PGSTROM, "int8 hll_hash(date)",      5, "t/f:hll_hash" },
+	{ PGSTROM, "int8 hll_hash(text)",     10, "f:hll_hash" },
+	{ PGSTROM, "int8 hll_hash(bytea)",    10, "f:hll_hash" },
+	{ PGSTROM, "int8 hll_hash(uuid)",      5, "m/f:hll_hash" },
+	{ PGSTROM, "int4 hll_bucket(int8)",    1, "f:hll_bucket" },
+	{ PGSTROM, "int4 hll_rank(int8)",      1, "f:hll_rank" },
+	{ PGSTROM, "int4 dds_bucket(float8)",  5, "f:dds_bucket" },
+	/* scaled integer of NUMERIC(p,s) for exact aggregations */
+	{ PGSTROM, "int8 numeric_scaled_hi(numeric,int4)", 8, "f:numeric_scaled_hi" },
+	{ PGSTROM, "int8 numeric_scaled_lo(numeric,int4)", 8, "f:numeric_scaled_lo" },
 	/* jsonb operators */
 	{ NULL, "jsonb jsonb_object_field(jsonb,text)",
 	  1000, "jC/f:jsonb_object_field",
@@ -1764,6 +2104,22 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	{ NULL, "bool jsonb_exists(jsonb,text)",
 	  100, "j/f:jsonb_exists"
 	},
+	{ NULL, "jsonb jsonb_extract_path(jsonb,array)",
+	  1500, "jC/f:jsonb_extract_path",
+	  vlbuf_estimate_jsonb_path
+	},
+	{ NULL, "jsonb jsonb_extract_path_op(jsonb,array)",
+	  1500, "jC/f:jsonb_extract_path",
+	  vlbuf_estimate_jsonb_path
+	},
+	{ NULL, "text jsonb_extract_path_text(jsonb,array)",
+	  1500, "jC/f:jsonb_extract_path_text",
+	  vlbuf_estimate_jsonb_path
+	},
+	{ NULL, "text jsonb_extract_path_text_op(jsonb,array)",
+	  1500, "jC/f:jsonb_extract_path_text",
+	  vlbuf_estimate_jsonb_path
+	},
 	/*
 	 * int4range operators
 	 */
@@ -2945,8 +3301,26 @@ codegen_varnode_expression(codegen_context *context, Var *var)
 	if (dtype->type_length >= 0)
 		width = dtype->type_length;
 	else
+	{
 		width = type_maximum_size(var->vartype,
 								  var->vartypmod) - VARHDRSZ;
+		/*
+		 * Inline compressed varlena datum (pglz/lz4) is expanded on the
+		 * vlbuf by the device code, so reserve a room for the decompression
+		 * once per expression. A datum larger than the room still runs on
+		 * the CPU fallback.
+		 */
+		if (!context->decompress_bufsz_reserved &&
+			pgstrom_gpu_decompress_bufsz > 0)
+		{
+			int		sz = pgstrom_gpu_decompress_bufsz;
+
+			if (width >= 0)
+				sz = Min(sz, width + VARHDRSZ);
+			context->varlena_bufsz += MAXALIGN(sz);
+			context->decompress_bufsz_reserved = true;
+		}
+	}
 	return width;
 }
 
@@ -3438,6 +3812,52 @@ codegen_casewhen_expression(codegen_context *context,
 	return maxlen;
 }
 
+/*
+ * codegen_scalar_array_lookup_available
+ *
+ * 'x = ANY(array)' of integer types can use the binary search on the sorted
+ * array, if the array is a constant larger than the threshold or a parameter
+ * (its length is unknown at the planning time).
+ */
+#define SCALAR_ARRAY_LOOKUP_THRESHOLD		32
+
+static bool
+codegen_scalar_array_lookup_available(ScalarArrayOpExpr *opexpr,
+									  devtype_info *dtype_s,
+									  devtype_info *dtype_e)
+{
+	Node	   *node_a = lsecond(opexpr->args);
+	TypeCacheEntry *tcache;
+
+	if (!opexpr->useOr || dtype_s != dtype_e)
+		return false;
+	if (dtype_e->type_oid != INT2OID &&
+		dtype_e->type_oid != INT4OID &&
+		dtype_e->type_oid != INT8OID &&
+		dtype_e->type_oid != DATEOID)
+		return false;
+	tcache = lookup_type_cache(dtype_e->type_oid, TYPECACHE_EQ_OPR);
+	if (tcache->eq_opr != opexpr->opno)
+		return false;
+
+	if (IsA(node_a, Const))
+	{
+		Const	   *con = (Const *)node_a;
+		ArrayType  *array;
+
+		if (con->constisnull)
+			return false;
+		array = DatumGetArrayTypeP(con->constvalue);
+		return (ArrayGetNItems(ARR_NDIM(array),
+							   ARR_DIMS(array)) >= SCALAR_ARRAY_LOOKUP_THRESHOLD);
+	}
+	else if (IsA(node_a, Param))
+	{
+		return (((Param *)node_a)->paramkind == PARAM_EXTERN);
+	}
+	return false;
+}
+
 static int
 codegen_scalar_array_op_expression(codegen_context *context,
 								   ScalarArrayOpExpr *opexpr)
@@ -3500,6 +3920,33 @@ codegen_scalar_array_op_expression(codegen_context *context,
 	PG_END_TRY();
 	ReleaseSysCache(fn_tup);
 
+	/*
+	 * Large IN-list or array parameter is looked up by binary search on the
+	 * sorted copy on the kern_parambuf, instead of the per-row loop.
+	 * The ScalarArrayOpExpr itself is saved on the used_params, then
+	 * construct_kern_parambuf() builds the kern_array_lookup from the array.
+	 * Its scalar argument is replaced by a dummy, not to reference any
+	 * columns from the used_params.
+	 */
+	if (codegen_scalar_array_lookup_available(opexpr, dtype_s, dtype_e))
+	{
+		ScalarArrayOpExpr *alookup = copyObject(opexpr);
+		int		index;
+
+		linitial(alookup->args) = makeNullConst(exprType(node_s),
+												exprTypmod(node_s),
+												exprCollation(node_s));
+		context->used_params = lappend(context->used_params, alookup);
+		index = list_length(context->used_params) - 1;
+		__appendStringInfo(&context->str, "PG_SCALAR_ARRAY_LOOKUP(kcxt, ");
+		codegen_expression_walker(context, node_s, NULL);
+		__appendStringInfo(&context->str, ", %d)", index);
+		/* tentatively, we assume log2(N) is 8 in average */
+		context->devcost += 8 * dfunc->func_devcost;
+
+		return sizeof(cl_bool);
+	}
+
 	__appendStringInfo(&context->str,
 					   "PG_SCALAR_ARRAY_OP(kcxt, pgfn_%s, ",
 					   dfunc->func_devname);
@@ -3520,11 +3967,224 @@ codegen_scalar_array_op_expression(codegen_context *context,
 	return sizeof(cl_bool);
 }
 
+/*
+ * codegen_fieldselect_expression
+ *
+ * A sub-field of composite type; only Arrow::Struct can be fetched on the
+ * device, elsewhere it will be evaluated by CPU fallback.
+ */
+static int
+codegen_fieldselect_expression(codegen_context *context,
+							   FieldSelect *fselect)
+{
+	Oid				comp_oid = exprType((Node *)fselect->arg);
+	devtype_info   *dtype_c;
+	devtype_info   *dtype_f;
+	int				width;
+
+	dtype_c = pgstrom_devtype_lookup_and_track(comp_oid, context);
+	if (!dtype_c || dtype_c->comp_nfields == 0)
+		__ELog("type %s is not device supported composite type",
+			   format_type_be(comp_oid));
+	if (fselect->fieldnum < 1 ||
+		fselect->fieldnum > dtype_c->comp_nfields)
+		__ELog("field number %d is out of range in type %s",
+			   fselect->fieldnum, format_type_be(comp_oid));
+	dtype_f = pgstrom_devtype_lookup_and_track(fselect->resulttype, context);
+	if (!dtype_f)
+		__ELog("type %s is not device supported",
+			   format_type_be(fselect->resulttype));
+	if (dtype_c->comp_subtypes[fselect->fieldnum - 1] != dtype_f)
+		__ELog("field %d of type %s is not %s",
+			   fselect->fieldnum,
+			   format_type_be(comp_oid),
+			   format_type_be(fselect->resulttype));
+
+	__appendStringInfo(&context->str,
+					   "pg_composite_fieldselect<pg_%s_t>(kcxt, ",
+					   dtype_f->type_name);
+	codegen_expression_walker(context, (Node *)fselect->arg, NULL);
+	__appendStringInfo(&context->str, ", %d)", fselect->fieldnum - 1);
+
+	if (dtype_f->type_length >= 0)
+		width = dtype_f->type_length;
+	else
+		width = type_maximum_size(fselect->resulttype,
+								  fselect->resulttypmod) - VARHDRSZ;
+	return width;
+}
+
+/*
+ * codegen_funcop_expression
+ *
+ * FuncExpr, OpExpr and DistinctExpr; device function invocation
+ */
+static int
+codegen_funcop_expression(codegen_context *context, Node *node)
+{
+	devfunc_info   *dfunc;
+	List		   *args;
+	int				width;
+
+	if (IsA(node, FuncExpr))
+	{
+		FuncExpr   *func = (FuncExpr *) node;
+
+		dfunc = pgstrom_devfunc_lookup(func->funcid,
+									   func->funcresulttype,
+									   func->args,
+									   func->inputcollid);
+		if (!dfunc)
+			__ELog("function %s is not device supported",
+				   format_procedure(func->funcid));
+		args = func->args;
+	}
+	else
+	{
+		OpExpr	   *op = (OpExpr *) node;
+		Oid			func_oid = get_opcode(op->opno);
+
+		Assert(IsA(node, OpExpr) || IsA(node, DistinctExpr));
+		dfunc = pgstrom_devfunc_lookup(func_oid,
+									   op->opresulttype,
+									   op->args,
+									   op->inputcollid);
+		if (!dfunc)
+			__ELog("function %s is not device supported",
+				   format_procedure(func_oid));
+		args = op->args;
+	}
+	pgstrom_devfunc_track(context, dfunc);
+	width = codegen_function_expression(context, dfunc, args);
+	context->devcost += dfunc->func_devcost;
+
+	return width;
+}
+
+/*
+ * codegen_expression_is_row_invariant
+ *
+ * It checks whether the expression references neither columns nor
+ * per-execution parameters; so, its result is identical for all the rows
+ * in a particular scan.
+ */
+static bool
+__codegen_row_invariant_walker(Node *node, void *__context)
+{
+	if (!node)
+		return false;
+	if (IsA(node, Var) || IsA(node, CaseTestExpr))
+		return true;
+	if (IsA(node, Param))
+		return (((Param *) node)->paramkind != PARAM_EXTERN);
+	return expression_tree_walker(node, __codegen_row_invariant_walker,
+								  __context);
+}
+
+static bool
+codegen_expression_is_row_invariant(Node *node)
+{
+	return (!__codegen_row_invariant_walker(node, NULL) &&
+			!contain_volatile_functions(node));
+}
+
+/*
+ * codegen_hoisted_expression
+ *
+ * Row-invariant expression, like 'now() - $1', is evaluated once on the
+ * host side by construct_kern_parambuf(), then delivered to the device as
+ * a KPARAM_%u, instead of the calculation for each row.
+ */
+static int
+codegen_hoisted_expression(codegen_context *context, Node *node)
+{
+	Oid				type_oid = exprType(node);
+	devtype_info   *dtype;
+	ListCell	   *lc;
+	int				index = 0;
+	int				width;
+
+	dtype = pgstrom_devtype_lookup_and_track(type_oid, context);
+	if (!dtype)
+		__ELog("type %s is not device supported",
+			   format_type_be(type_oid));
+	foreach (lc, context->used_params)
+	{
+		if (equal(node, lfirst(lc)))
+			goto found;
+		index++;
+	}
+	context->used_params = lappend(context->used_params,
+								   copyObject(node));
+	index = list_length(context->used_params) - 1;
+found:
+	__appendStringInfo(&context->str, "KPARAM_%u", index);
+	context->param_refs = bms_add_member(context->param_refs, index);
+
+	if (dtype->type_length > 0)
+		width = dtype->type_length;
+	else if (dtype->type_length == -1)
+		width = type_maximum_size(type_oid, exprTypmod(node)) - VARHDRSZ;
+	else
+		elog(ERROR, "unexpected type length: %d", dtype->type_length);
+
+	return width;
+}
+
+/*
+ * codegen_cse_expression
+ *
+ * If the expression is one of the common subexpressions in the function
+ * being generated, its result is kept on a temporary variable at the first
+ * evaluation, then reused. It is evaluated lazily, because the first
+ * occurrence may be on the branch which is not taken, like CASE WHEN.
+ */
+static int
+codegen_cse_expression(codegen_context *context, Node *node)
+{
+	devtype_info   *dtype;
+	ListCell	   *lc1, *lc2;
+	int				temp_nr;
+	int				width;
+
+	forboth (lc1, context->cse_exprs,
+			 lc2, context->cse_temps)
+	{
+		if (equal(node, lfirst(lc1)))
+			goto found;
+	}
+	return codegen_funcop_expression(context, node);
+
+found:
+	dtype = pgstrom_devtype_lookup_and_track(exprType(node), context);
+	if (!dtype)
+		__ELog("type %s is not device supported",
+			   format_type_be(exprType(node)));
+	temp_nr = lfirst_int(lc2);
+	if (temp_nr == 0)
+	{
+		temp_nr = ++context->decl_count;
+		lfirst_int(lc2) = temp_nr;
+		__appendStringInfo(
+			&context->decl_temp,
+			"  pg_%s_t __cse%d __attribute__((unused));\n"
+			"  cl_bool __cse_done%d __attribute__((unused)) = false;\n",
+			dtype->type_name, temp_nr, temp_nr);
+	}
+	__appendStringInfo(
+		&context->str,
+		"(__cse_done%d ? __cse%d : (__cse_done%d = true, __cse%d = ",
+		temp_nr, temp_nr, temp_nr, temp_nr);
+	width = codegen_funcop_expression(context, node);
+	__appendStringInfo(&context->str, "))");
+
+	return width;
+}
+
 static void
 codegen_expression_walker(codegen_context *context,
 						  Node *node, int *p_width)
 {
-	devfunc_info   *dfunc;
 	int				width = 0;
 	Node		   *__codegen_saved_node;
 
@@ -3549,43 +4209,12 @@ codegen_expression_walker(codegen_context *context,
 			break;
 
 		case T_FuncExpr:
-			{
-				FuncExpr   *func = (FuncExpr *) node;
-
-				dfunc = pgstrom_devfunc_lookup(func->funcid,
-											   func->funcresulttype,
-											   func->args,
-											   func->inputcollid);
-				if (!dfunc)
-					__ELog("function %s is not device supported",
-						   format_procedure(func->funcid));
-				pgstrom_devfunc_track(context, dfunc);
-				width = codegen_function_expression(context,
-													dfunc,
-													func->args);
-				context->devcost += dfunc->func_devcost;
-			}
-			break;
-
 		case T_OpExpr:
 		case T_DistinctExpr:
-			{
-				OpExpr	   *op = (OpExpr *) node;
-				Oid			func_oid = get_opcode(op->opno);
-
-				dfunc = pgstrom_devfunc_lookup(func_oid,
-											   op->opresulttype,
-											   op->args,
-											   op->inputcollid);
-				if (!dfunc)
-					__ELog("function %s is not device supported",
-						   format_procedure(func_oid));
-				pgstrom_devfunc_track(context, dfunc);
-				width = codegen_function_expression(context,
-													dfunc,
-													op->args);
-				context->devcost += dfunc->func_devcost;
-			}
+			if (codegen_expression_is_row_invariant(node))
+				width = codegen_hoisted_expression(context, node);
+			else
+				width = codegen_cse_expression(context, node);
 			break;
 
 		case T_NullTest:
@@ -3632,6 +4261,11 @@ codegen_expression_walker(codegen_context *context,
 			width = codegen_scalar_array_op_expression(context,
 												(ScalarArrayOpExpr *) node);
 			break;
+
+		case T_FieldSelect:
+			width = codegen_fieldselect_expression(context,
+												   (FieldSelect *) node);
+			break;
 		default:
 			__ELog("Bug? unsupported expression: %s", nodeToString(node));
 			break;
@@ -3684,6 +4318,65 @@ pgstrom_codegen_expression(Node *expr, codegen_context *context)
 	return context->str.data;
 }
 
+/*
+ * pgstrom_codegen_cse_setup
+ *
+ * It picks up the common subexpressions that appear twice or more in the
+ * supplied expressions, to be evaluated only once in the device function
+ * being generated. Caller must clear them by NIL once the function is
+ * generated, because temporary variables are declared on decl_temp.
+ */
+typedef struct
+{
+	List	   *seen;
+	List	   *cse;
+} codegen_cse_context;
+
+static bool
+__codegen_cse_collect_walker(Node *node, codegen_cse_context *con)
+{
+	if (!node)
+		return false;
+	if ((IsA(node, FuncExpr) ||
+		 IsA(node, OpExpr) ||
+		 IsA(node, DistinctExpr)) &&
+		__codegen_row_invariant_walker(node, NULL) &&
+		!contain_volatile_functions(node))
+	{
+		if (list_member(con->seen, node))
+		{
+			if (!list_member(con->cse, node))
+				con->cse = lappend(con->cse, node);
+			/* no need to walk down the sub-expressions again */
+			return false;
+		}
+		con->seen = lappend(con->seen, node);
+	}
+	return expression_tree_walker(node, __codegen_cse_collect_walker, con);
+}
+
+void
+pgstrom_codegen_cse_setup(codegen_context *context, List *exprs_list)
+{
+	codegen_cse_context con;
+	ListCell   *lc;
+
+	list_free(context->cse_exprs);
+	list_free(context->cse_temps);
+	context->cse_exprs = NIL;
+	context->cse_temps = NIL;
+
+	memset(&con, 0, sizeof(codegen_cse_context));
+	(void) __codegen_cse_collect_walker((Node *)exprs_list, &con);
+	foreach (lc, con.cse)
+	{
+		context->cse_exprs = lappend(context->cse_exprs, lfirst(lc));
+		context->cse_temps = lappend_int(context->cse_temps, 0);
+	}
+	list_free(con.seen);
+	list_free(con.cse);
+}
+
 /*
  * pgstrom_codegen_param_declarations
  */
@@ -3729,6 +4422,22 @@ pgstrom_codegen_param_declarations(StringInfo buf, codegen_context *context)
 				"  pg_%s_t KPARAM_%u = pg_%s_param(kcxt,%d);\n",
 				dtype->type_name, index, dtype->type_name, index);
 		}
+		else if (IsA(node, FuncExpr) ||
+				 IsA(node, OpExpr) ||
+				 IsA(node, DistinctExpr))
+		{
+			/* row-invariant expression, evaluated on the host */
+			Oid		type_oid = exprType(node);
+
+			dtype = pgstrom_devtype_lookup(type_oid);
+			if (!dtype)
+				__ELog("failed to lookup device type: %u", type_oid);
+
+			appendStringInfo(
+				buf,
+				"  pg_%s_t KPARAM_%u = pg_%s_param(kcxt,%d);\n",
+				dtype->type_name, index, dtype->type_name, index);
+		}
 		else
 			elog(ERROR, "Bug? unexpected node: %s", nodeToString(node));
 	lnext:
@@ -4051,6 +4760,17 @@ pgstrom_init_codegen(void)
 	for (i=0; i < lengthof(devcast_info_slot); i++)
 		dlist_init(&devcast_info_slot[i]);
 
+	DefineCustomIntVariable("pg_strom.gpu_decompress_bufsz",
+							"Buffer size to decompress inline compressed varlena on GPU",
+							NULL,
+							&pgstrom_gpu_decompress_bufsz,
+							1024,
+							0,
+							KERN_CONTEXT_VARLENA_BUFSZ_LIMIT / 2,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
 	devinfo_memcxt = AllocSetContextCreate(CacheMemoryContext,
 										   "device type/func info cache",
 										   ALLOCSET_DEFAULT_SIZES);
@@ -331,15 +331,17 @@ pg_varlena_datum_extract(kern_context *kcxt, T &arg,
 		return false;
 	if (arg.length < 0)
 	{
-		if (VARATT_IS_COMPRESSED(arg.value) ||
-			VARATT_IS_EXTERNAL(arg.value))
+		char   *vl = arg.value;
+
+		if (VARATT_IS_COMPRESSED(vl) || VARATT_IS_EXTERNAL(vl))
         {
-			STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
-							   "compressed or external varlena on device");
-			return false;
+			/* inline compressed datum is expanded on the vlbuf */
+			vl = (char *)kern_decompress_varlena(kcxt, (varlena *)vl);
+			if (!vl)
+				return false;
         }
-		*s = VARDATA_ANY(arg.value);
-		*len = VARSIZE_ANY_EXHDR(arg.value);
+		*s = VARDATA_ANY(vl);
+		*len = VARSIZE_ANY_EXHDR(vl);
 	}
 	else
 	{
@@ -395,9 +397,10 @@ pg_varlena_datum_extract(kern_context *kcxt, T &arg,
 		if (VARATT_IS_COMPRESSED(datum.value) ||                \
 			VARATT_IS_EXTERNAL(datum.value))					\
 		{														\
-			STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,	\
-							   "compressed or external varlena on device");	\
-			return 0;											\
+			datum.value = (char *)								\
+				kern_decompress_varlena(kcxt, (varlena *)datum.value); \
+			if (!datum.value)									\
+				return 0;										\
 		}														\
 		return pg_hash_any((cl_uchar *)VARDATA_ANY(datum.value), \
 						   VARSIZE_ANY_EXHDR(datum.value));		\
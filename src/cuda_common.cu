@@ -890,21 +890,112 @@ pglz_decompress(const char *source, cl_int slen,
 	return rawsize;
 }
 
+/*
+ * lz4_decompress - decoder of the LZ4 block format, equivalent to
+ * LZ4_decompress_safe() that is used by PG14 or later.
+ */
+DEVICE_FUNCTION(cl_int)
+lz4_decompress(const char *source, cl_int slen,
+			   char *dest, cl_int rawsize)
+{
+	const cl_uchar *sp = (const cl_uchar *) source;
+	const cl_uchar *srcend = sp + slen;
+	cl_uchar	   *dp = (cl_uchar *) dest;
+	cl_uchar	   *destend = dp + rawsize;
+
+	while (sp < srcend)
+	{
+		cl_uchar	token = *sp++;
+		cl_uint		len;
+		cl_uint		off;
+
+		/* literal length, extended by 255-bytes */
+		len = (token >> 4);
+		if (len == 15)
+		{
+			cl_uchar	c;
+
+			do {
+				if (sp >= srcend)
+					return -1;
+				c = *sp++;
+				len += c;
+			} while (c == 255);
+		}
+		if (sp + len > srcend || dp + len > destend)
+			return -1;
+		memcpy(dp, sp, len);
+		sp += len;
+		dp += len;
+		/* the last sequence has no match part */
+		if (sp >= srcend)
+			break;
+
+		/* match offset (little endian) and length */
+		if (sp + 2 > srcend)
+			return -1;
+		off = ((cl_uint)sp[0] | ((cl_uint)sp[1] << 8));
+		sp += 2;
+		if (off == 0 || off > (cl_uint)(dp - (cl_uchar *)dest))
+			return -1;
+		len = (token & 0x0f);
+		if (len == 15)
+		{
+			cl_uchar	c;
+
+			do {
+				if (sp >= srcend)
+					return -1;
+				c = *sp++;
+				len += c;
+			} while (c == 255);
+		}
+		len += 4;	/* MINMATCH */
+		if (dp + len > destend)
+			return -1;
+		/* areas may overlap, so copy byte by byte like pglz */
+		while (len--)
+		{
+			*dp = dp[-(cl_int)off];
+			dp++;
+		}
+	}
+	if (dp != destend)
+		return -1;
+	return rawsize;
+}
+
 DEVICE_FUNCTION(cl_bool)
 toast_decompress_datum(char *buffer, cl_uint buflen,
 					   const varlena *datum)
 {
 	cl_int		rawsize;
+	cl_int		status;
 
 	assert(VARATT_IS_COMPRESSED(datum));
 	rawsize = TOAST_COMPRESS_RAWSIZE(datum);
 	if (rawsize + VARHDRSZ > buflen)
 		return false;
 	SET_VARSIZE(buffer, rawsize + VARHDRSZ);
-	if (pglz_decompress(TOAST_COMPRESS_RAWDATA(datum),
-						VARSIZE(datum) - TOAST_COMPRESS_HDRSZ,
-						buffer + VARHDRSZ,
-						rawsize) < 0)
+	switch (TOAST_COMPRESS_METHOD(datum))
+	{
+		case TOAST_COMPRESS_METHOD_PGLZ:
+			status = pglz_decompress(TOAST_COMPRESS_RAWDATA(datum),
+									 VARSIZE(datum) - TOAST_COMPRESS_HDRSZ,
+									 buffer + VARHDRSZ,
+									 rawsize);
+			break;
+		case TOAST_COMPRESS_METHOD_LZ4:
+			status = lz4_decompress(TOAST_COMPRESS_RAWDATA(datum),
+									VARSIZE(datum) - TOAST_COMPRESS_HDRSZ,
+									buffer + VARHDRSZ,
+									rawsize);
+			break;
+		default:
+			/* unknown compression method */
+			return false;
+	}
+	if (status < 0)
 	{
 		printf("GPU kernel: compressed varlena datum is corrupted\n");
 		return false;
@@ -912,6 +1003,31 @@ toast_decompress_datum(char *buffer, cl_uint buflen,
 	return true;
 }
 
+/*
+ * kern_decompress_varlena - decompress an inline compressed varlena datum
+ * onto the per-thread varlena buffer. If no room to expand the datum, or
+ * external (toasted) datum, it returns NULL with CPU fallback request.
+ */
+DEVICE_FUNCTION(varlena *)
+kern_decompress_varlena(kern_context *kcxt, varlena *datum)
+{
+	cl_char	   *vlpos_saved = kcxt->vlpos;
+	char	   *buffer;
+	cl_uint		buflen;
+
+	if (VARATT_IS_COMPRESSED(datum))
+	{
+		buflen = TOAST_COMPRESS_RAWSIZE(datum) + VARHDRSZ;
+		buffer = (char *)kern_context_alloc(kcxt, buflen);
+		if (buffer && toast_decompress_datum(buffer, buflen, datum))
+			return (varlena *)buffer;
+		kcxt->vlpos = vlpos_saved;
+	}
+	STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
+					   "compressed or external varlena on device");
+	return NULL;
+}
+
 /*
  * kern_get_datum_xxx
  *
@@ -1056,6 +1172,118 @@ xmin_is_visible:
 	return true;
 }
 
+/*
+ * kern_check_visibility_heap
+ *
+ * It checks MVCC visibility of the tuple on the heap block that was loaded
+ * by SSD-to-GPU Direct SQL without visibility checks by CPU, according to
+ * the hint bits of the tuple and the snapshot of the scan. Device code has
+ * no access to the commit log and MultiXact, so the tuple is handled by CPU
+ * fallback if hint bits are not set yet.
+ */
+STATIC_FUNCTION(cl_bool)
+__xid_is_current_xact(xidvector *xvec, TransactionId xid)
+{
+	for (int i=0; i < xvec->dim1; i++)
+	{
+		if (xid == xvec->values[i])
+			return true;
+	}
+	return false;
+}
+
+STATIC_FUNCTION(cl_bool)
+__xid_in_kern_snapshot(kern_snapshot *snap, TransactionId xid)
+{
+	if (TransactionIdPrecedes(xid, snap->xmin))
+		return false;
+	if (TransactionIdFollowsOrEquals(xid, snap->xmax))
+		return true;
+	for (int i=0; i < snap->xcnt; i++)
+	{
+		if (xid == snap->xip[i])
+			return true;
+	}
+	return false;
+}
+
+DEVICE_FUNCTION(cl_bool)
+kern_check_visibility_heap(kern_context *kcxt,
+						   PageHeaderData *pg_page,
+						   HeapTupleHeaderData *htup)
+{
+	kern_parambuf  *kparams = kcxt->kparams;
+	xidvector	   *xvec;
+	kern_snapshot  *snap;
+	cl_ushort		infomask = htup->t_infomask;
+	TransactionId	xmin = htup->t_choice.t_heap.t_xmin;
+	TransactionId	xmax = htup->t_choice.t_heap.t_xmax;
+	cl_uint			cid = htup->t_choice.t_heap.t_field3.t_cid;
+
+	/* already checked by CPU, or all-visible block */
+	if ((pg_page->pd_flags & PD_ALL_VISIBLE) != 0)
+		return true;
+	xvec = (xidvector *)kparam_get_value(kparams, kparams->xactIdVector);
+	snap = (kern_snapshot *)kparam_get_value(kparams, kparams->xactSnapshot);
+	if (!xvec || !snap || (infomask & HEAP_MOVED) != 0)
+		goto fallback;
+
+	/* check xmin */
+	if ((infomask & HEAP_XMIN_FROZEN) == HEAP_XMIN_FROZEN ||
+		(xmin != InvalidTransactionId && !TransactionIdIsNormal(xmin)))
+	{
+		/* frozen tuple */
+	}
+	else if ((infomask & HEAP_XMIN_INVALID) != 0)
+		return false;
+	else if (__xid_is_current_xact(xvec, xmin))
+	{
+		if ((infomask & HEAP_COMBOCID) != 0)
+			goto fallback;
+		if (cid >= snap->curcid)
+			return false;	/* inserted after scan started */
+		if ((infomask & HEAP_XMAX_INVALID) != 0 ||
+			HEAP_XMAX_IS_LOCKED_ONLY(infomask))
+			return true;
+		if ((infomask & HEAP_XMAX_IS_MULTI) != 0)
+			goto fallback;
+		if (!__xid_is_current_xact(xvec, xmax))
+			return true;	/* deleting subtransaction must have aborted */
+		/* no combo-cid, so cmax is equivalent to cmin */
+		return false;
+	}
+	else if (__xid_in_kern_snapshot(snap, xmin))
+		return false;
+	else if ((infomask & HEAP_XMIN_COMMITTED) == 0)
+		goto fallback;		/* needs to check the commit log */
+
+	/* by here, the inserting transaction has committed */
+	if ((infomask & HEAP_XMAX_INVALID) != 0 ||
+		HEAP_XMAX_IS_LOCKED_ONLY(infomask))
+		return true;
+	if ((infomask & HEAP_XMAX_IS_MULTI) != 0)
+		goto fallback;
+	if ((infomask & HEAP_XMAX_COMMITTED) == 0)
+	{
+		if (__xid_is_current_xact(xvec, xmax))
+		{
+			if ((infomask & HEAP_COMBOCID) != 0)
+				goto fallback;
+			return (cid >= snap->curcid);	/* deleted after scan started */
+		}
+		if (__xid_in_kern_snapshot(snap, xmax))
+			return true;
+		goto fallback;		/* needs to check the commit log */
+	}
+	/* xmax transaction committed */
+	return __xid_in_kern_snapshot(snap, xmax);
+
+fallback:
+	STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VISIBILITY_UNKNOWN,
+					   "tuple visibility is not decidable on device");
+	return false;
+}
+
 /*
  * Routines to reference values on KDS_FORMAT_ARROW for base types.
  * Usually, these routines are referenced via pg_datum_ref_arrow().
@@ -1417,9 +1645,10 @@ pg_comp_hash(kern_context *kcxt, pg_bpchar_t datum)
 	if (VARATT_IS_COMPRESSED(datum.value) ||
 		VARATT_IS_EXTERNAL(datum.value))
 	{
-		STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
-						   "varlena datum is compressed or external");
-		return 0;
+		datum.value = (char *)kern_decompress_varlena(kcxt, (varlena *)
+													  datum.value);
+		if (!datum.value)
+			return 0;
 	}
 	len = bpchar_truelen(VARDATA_ANY(datum.value),
 						 VARSIZE_ANY_EXHDR(datum.value));
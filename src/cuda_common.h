@@ -371,6 +371,7 @@ __Fetch(const T *ptr)
 #define ERRCODE_STROM_DATA_CORRUPTION		MAKE_SQLSTATE('H','D','B','0','7')
 #define ERRCODE_STROM_VARLENA_UNSUPPORTED	MAKE_SQLSTATE('H','D','B','0','8')
 #define ERRCODE_STROM_RECURSION_TOO_DEEP	MAKE_SQLSTATE('H','D','B','0','9')
+#define ERRCODE_STROM_VISIBILITY_UNKNOWN	MAKE_SQLSTATE('H','D','B','1','0')
 
 #define KERN_ERRORBUF_FILENAME_LEN		24
 #define KERN_ERRORBUF_FUNCNAME_LEN		64
@@ -624,6 +625,25 @@ typedef struct {
 #define HEAP_COMBOCID			0x0020	/* t_cid is a combo cid */
 #define HEAP_XMAX_EXCL_LOCK		0x0040	/* xmax is exclusive locker */
 #define HEAP_XMAX_LOCK_ONLY		0x0080	/* xmax, if valid, is only a locker */
+#define HEAP_XMAX_SHR_LOCK		(HEAP_XMAX_EXCL_LOCK | HEAP_XMAX_KEYSHR_LOCK)
+#define HEAP_LOCK_MASK			(HEAP_XMAX_SHR_LOCK | HEAP_XMAX_EXCL_LOCK | \
+								 HEAP_XMAX_KEYSHR_LOCK)
+#define HEAP_XMIN_COMMITTED		0x0100	/* t_xmin committed */
+#define HEAP_XMIN_INVALID		0x0200	/* t_xmin invalid/aborted */
+#define HEAP_XMIN_FROZEN		(HEAP_XMIN_COMMITTED|HEAP_XMIN_INVALID)
+#define HEAP_XMAX_COMMITTED		0x0400	/* t_xmax committed */
+#define HEAP_XMAX_INVALID		0x0800	/* t_xmax invalid/aborted */
+#define HEAP_XMAX_IS_MULTI		0x1000	/* t_xmax is a MultiXactId */
+#define HEAP_UPDATED			0x2000	/* this is UPDATEd version of row */
+#define HEAP_MOVED_OFF			0x4000	/* moved to another place by pre-9.0
+										 * VACUUM FULL */
+#define HEAP_MOVED_IN			0x8000	/* moved from another place by pre-9.0
+										 * VACUUM FULL */
+#define HEAP_MOVED				(HEAP_MOVED_OFF | HEAP_MOVED_IN)
+
+#define HEAP_XMAX_IS_LOCKED_ONLY(infomask)							\
+	(((infomask) & HEAP_XMAX_LOCK_ONLY) ||							\
+	 ((infomask) & (HEAP_XMAX_IS_MULTI | HEAP_LOCK_MASK)) == HEAP_XMAX_EXCL_LOCK)
 
 /*
  * information stored in t_infomask2:
@@ -678,7 +698,24 @@ typedef struct IndexAttributeBitMapData
 typedef cl_uint		TransactionId;
 #define InvalidTransactionId		((TransactionId) 0)
 #define FrozenTransactionId			((TransactionId) 2)
+#define FirstNormalTransactionId	((TransactionId) 3)
+#define TransactionIdIsNormal(xid)	((xid) >= FirstNormalTransactionId)
 #define InvalidCommandId			(~0U)
+
+STATIC_INLINE(cl_bool)
+TransactionIdPrecedes(TransactionId id1, TransactionId id2)
+{
+	/* see TransactionIdPrecedes() at access/transam/transam.c */
+	if (!TransactionIdIsNormal(id1) || !TransactionIdIsNormal(id2))
+		return (id1 < id2);
+	return ((cl_int)(id1 - id2) < 0);
+}
+
+STATIC_INLINE(cl_bool)
+TransactionIdFollowsOrEquals(TransactionId id1, TransactionId id2)
+{
+	return !TransactionIdPrecedes(id1, id2);
+}
 #else
 #include "access/htup_details.h"
 #endif	/* __CUDACC__ */
@@ -694,6 +731,23 @@ typedef struct
 	TransactionId values[FLEXIBLE_ARRAY_MEMBER];
 } xidvector;
 
+/*
+ * kern_snapshot - MVCC snapshot of the scan, to check visibility of the
+ * tuples on the blocks that are loaded by SSD-to-GPU Direct SQL without
+ * visibility checks by CPU. @xip[] contains both of top-level and sub-
+ * transaction ids in-progress, so it is never built if snapshot is
+ * sub-overflowed.
+ */
+typedef struct
+{
+	cl_int		vl_len_;
+	TransactionId xmin;			/* all XID < xmin are visible to me */
+	TransactionId xmax;			/* all XID >= xmax are invisible to me */
+	cl_uint		curcid;			/* in my xact, CID < curcid are visible */
+	cl_uint		xcnt;			/* number of xip[] */
+	TransactionId xip[FLEXIBLE_ARRAY_MEMBER];
+} kern_snapshot;
+
 #ifdef __CUDACC__
 /* definitions at storage/itemid.h */
 typedef struct ItemIdData
@@ -844,6 +898,15 @@ typedef struct {
 	cl_uint			values_length;
 	cl_uint			extra_offset;
 	cl_uint			extra_length;
+	/*
+	 * (only arrow format, if dictionary-encoded)
+	 * @values and @extra point the values in the DictionaryBatch, and
+	 * @dict_index points the array of dictionary indexes of the RecordBatch.
+	 * @dict_unitsz is width of the dictionary index, or 0 if not encoded.
+	 */
+	cl_uint			dict_unitsz;
+	cl_uint			dict_index_offset;
+	cl_uint			dict_index_length;
 } kern_colmeta;
 
 /*
@@ -1150,6 +1213,32 @@ KDS_BLOCK_REF_HTUP(kern_data_store *kds,
 }
 
 /* access functions for apache arrow format */
+STATIC_INLINE(cl_uint)
+kern_fetch_dictionary_index_arrow(kern_colmeta *cmeta,
+								  char *base,
+								  cl_uint index)
+{
+	char	   *dict_index;
+
+	if (cmeta->dict_unitsz == 0)
+		return index;	/* not a dictionary-encoded column */
+	Assert(cmeta->dict_index_offset > 0 &&
+		   cmeta->dict_unitsz * (index+1) <=
+		   __kds_unpack(cmeta->dict_index_length));
+	dict_index = base + __kds_unpack(cmeta->dict_index_offset);
+	switch (cmeta->dict_unitsz)
+	{
+		case sizeof(cl_uchar):
+			return ((cl_uchar *)dict_index)[index];
+		case sizeof(cl_ushort):
+			return ((cl_ushort *)dict_index)[index];
+		case sizeof(cl_uint):
+			return ((cl_uint *)dict_index)[index];
+		default:
+			return ((cl_ulong *)dict_index)[index];
+	}
+}
+
 STATIC_INLINE(void *)
 kern_fetch_simple_datum_arrow(kern_colmeta *cmeta,
 							  char *base,
@@ -1165,6 +1254,7 @@ kern_fetch_simple_datum_arrow(kern_colmeta *cmeta,
 		if (att_isnull(index, nullmap))
 			return NULL;
 	}
+	index = kern_fetch_dictionary_index_arrow(cmeta, base, index);
 	Assert(cmeta->values_offset > 0);
 	Assert(cmeta->extra_offset == 0);
 	Assert(cmeta->extra_length == 0);
@@ -1189,6 +1279,7 @@ kern_fetch_varlena_datum_arrow(kern_colmeta *cmeta,
 		if (att_isnull(index, nullmap))
 			return NULL;
 	}
+	index = kern_fetch_dictionary_index_arrow(cmeta, base, index);
 	Assert(cmeta->values_offset > 0 &&
 		   cmeta->extra_offset > 0 &&
 		   sizeof(cl_uint) * (index+1) <= __kds_unpack(cmeta->values_length));
@@ -1215,6 +1306,7 @@ typedef struct kern_parambuf
 	 */
 	cl_long		xactStartTimestamp;	/* timestamp when transaction start */
 	cl_uint		xactIdVector;		/* offset to xidvector */
+	cl_uint		xactSnapshot;		/* offset to kern_snapshot, if any */
 
 	/* variable length parameters / constants */
 	cl_uint		length;		/* total length of parambuf */
@@ -1239,6 +1331,22 @@ pointer_on_kparams(void *ptr, kern_parambuf *kparams)
 					   (char *)ptr <  (char *)kparams + kparams->length);
 }
 
+/*
+ * kern_array_lookup
+ *
+ * Sorted and unique copy of the integer array of ScalarArrayOpExpr, like
+ * 'x IN (...)' or 'x = ANY($1)'; host code builds it on the kern_parambuf
+ * instead of the original array, then PG_SCALAR_ARRAY_LOOKUP looks up the
+ * scalar value by binary search.
+ */
+typedef struct
+{
+	cl_uint		nitems;		/* number of non-null elements */
+	cl_bool		has_null;	/* true, if array contains NULL elements */
+	cl_char		__padding__[3];
+	cl_long		values[FLEXIBLE_ARRAY_MEMBER];
+} kern_array_lookup;
+
 /*
  * PostgreSQL varlena related definitions
  *
@@ -1340,8 +1448,19 @@ typedef struct toast_compress_header
 } toast_compress_header;
 
 #define TOAST_COMPRESS_HDRSZ		((cl_int)sizeof(toast_compress_header))
+/*
+ * PG14 or later uses the upper 2 bits of rawsize to store the compression
+ * method; pglz (0) or lz4 (1). Older versions always put zero here because
+ * the raw size never exceeds 1GB.
+ */
+#define TOAST_COMPRESS_EXTSIZE_MASK	0x3FFFFFFFU
+#define TOAST_COMPRESS_METHOD_PGLZ	0
+#define TOAST_COMPRESS_METHOD_LZ4	1
 #define TOAST_COMPRESS_RAWSIZE(ptr)				\
-	(((toast_compress_header *) (ptr))->rawsize)
+	(__Fetch(&((toast_compress_header *) (ptr))->rawsize) &	\
+	 TOAST_COMPRESS_EXTSIZE_MASK)
+#define TOAST_COMPRESS_METHOD(ptr)				\
+	((cl_uint)__Fetch(&((toast_compress_header *) (ptr))->rawsize) >> 30)
 #define TOAST_COMPRESS_RAWDATA(ptr)				\
 	(((char *) (ptr)) + TOAST_COMPRESS_HDRSZ)
 #define TOAST_COMPRESS_SET_RAWSIZE(ptr, len)	\
@@ -1376,7 +1495,8 @@ typedef struct toast_compress_header
 	(((varattrib_1b_e *) (PTR))->va_tag)
 
 #define VARRAWSIZE_4B_C(PTR)	\
-	__Fetch(&((varattrib_4b *) (PTR))->va_compressed.va_rawsize)
+	(__Fetch(&((varattrib_4b *) (PTR))->va_compressed.va_rawsize) & \
+	 TOAST_COMPRESS_EXTSIZE_MASK)
 
 #define VARSIZE_ANY_EXHDR(PTR) \
 	(VARATT_IS_1B_E(PTR) ? VARSIZE_EXTERNAL(PTR)-VARHDRSZ_EXTERNAL : \
@@ -1504,6 +1624,26 @@ DEVICE_FUNCTION(cl_uint)
 pg_hash_any(const cl_uchar *k, cl_int keylen);
 #endif /* __CUDACC__ */
 
+/*
+ * Parameters of the sketches for approximate aggregations; both of host and
+ * device code must have identical definitions.
+ *
+ * HLL_REGISTER_BITS - number of registers of HyperLogLog (2^N).
+ *                     It makes standard error 1.04/sqrt(2^N).
+ * DDS_RELATIVE_ACCURACY - relative accuracy of the DDSketch buckets.
+ * DDS_KEY_OFFSET    - offset of the bucket index to keep sign of the key
+ *                     as sign of the value.
+ */
+#define HLL_REGISTER_BITS		14
+#define HLL_NUM_REGISTERS		(1U << HLL_REGISTER_BITS)
+#define DDS_RELATIVE_ACCURACY	0.01
+#define DDS_LOG_GAMMA									\
+	log((1.0 + DDS_RELATIVE_ACCURACY) / (1.0 - DDS_RELATIVE_ACCURACY))
+#define DDS_KEY_OFFSET			(1 << 17)
+#define DDS_KEY_NAN				INT_MAX
+#define DDS_KEY_POS_INF			(INT_MAX - 1)
+#define DDS_KEY_NEG_INF			(-INT_MAX + 1)
+
 /*
  * Macro to extract a heap-tuple
  *
@@ -1517,9 +1657,49 @@ pg_hash_any(const cl_uchar *k, cl_int keylen);
  *     :
  * EXTRACT_HEAP_TUPLE_END()
  *
+ * EXTRACT_HEAP_TUPLE_BEGIN_AT(kds, htup, addr, colidx)
+ *  -> addr shall point the device pointer of the field at colidx, or NULL.
+ *     It uses attcacheoff of the fixed-width prefix to skip walking on
+ *     the preceding fields, if tuple has no NULLs.
+ *
  * EXTRACT_HEAP_READ_XXXX()
  *  -> load raw values to dclass[]/values[], and update extras[]
  */
+#ifdef __CUDACC__
+STATIC_INLINE(char *)
+__extract_heap_tuple_seek(kern_colmeta *colmeta,
+						  HeapTupleHeaderData *htup,
+						  cl_uchar *nullmap,
+						  cl_uint colidx,
+						  cl_uint ncols)
+{
+	char	   *pos = (char *)htup + htup->t_hoff;
+	cl_uint		i;
+
+	if (!nullmap && colidx < ncols && colmeta[colidx].attcacheoff >= 0)
+		return (char *)htup + colmeta[colidx].attcacheoff;
+	for (i=0; i < colidx && i < ncols; i++)
+	{
+		kern_colmeta   *cmeta = &colmeta[i];
+
+		if (nullmap && att_isnull(i, nullmap))
+			continue;
+		if (cmeta->attlen > 0)
+		{
+			pos = (char *)TYPEALIGN(cmeta->attalign, pos);
+			pos += cmeta->attlen;
+		}
+		else
+		{
+			if (!VARATT_NOT_PAD_BYTE(pos))
+				pos = (char *)TYPEALIGN(cmeta->attalign, pos);
+			pos += VARSIZE_ANY(pos);
+		}
+	}
+	return pos;
+}
+#endif	/* __CUDACC__ */
+
 #define EXTRACT_HEAP_TUPLE_BEGIN(ADDR,kds,htup)							\
 	do {																\
 		kern_colmeta   *__cmeta;										\
@@ -1551,8 +1731,35 @@ pg_hash_any(const cl_uchar *k, cl_int keylen);
 		else															\
 			(ADDR) = NULL
 
+#define EXTRACT_HEAP_TUPLE_BEGIN_AT(ADDR,kds,htup,COLIDX)				\
+	do {																\
+		kern_colmeta   *__cmeta;										\
+		cl_uint			__colidx = (COLIDX);							\
+		cl_uint			__ncols;										\
+		cl_uchar	   *__nullmap = NULL;								\
+		char		   *__pos;											\
+																		\
+		if (!(htup))													\
+			__ncols = 0;	/* to be considered as NULL */				\
+		else															\
+		{																\
+			if (((htup)->t_infomask & HEAP_HASNULL) != 0)				\
+				__nullmap = (htup)->t_bits;								\
+			__ncols = Min((kds)->ncols,									\
+						  (htup)->t_infomask2 & HEAP_NATTS_MASK);		\
+			__pos = __extract_heap_tuple_seek((kds)->colmeta,			\
+											  (htup),					\
+											  __nullmap,				\
+											  __colidx,					\
+											  __ncols);					\
+		}																\
+		__EXTRACT_HEAP_TUPLE_FETCH(ADDR,kds)
+
 #define EXTRACT_HEAP_TUPLE_NEXT(ADDR,kds)								\
 		__colidx++;														\
+		__EXTRACT_HEAP_TUPLE_FETCH(ADDR,kds)
+
+#define __EXTRACT_HEAP_TUPLE_FETCH(ADDR,kds)							\
 		if (__colidx < __ncols &&										\
 			(!__nullmap || !att_isnull(__colidx, __nullmap)))			\
 		{																\
@@ -1690,9 +1897,14 @@ toast_raw_datum_size(kern_context *kcxt, varlena *attr);
 DEVICE_FUNCTION(cl_int)
 pglz_decompress(const char *source, cl_int slen,
 				char *dest, cl_int rawsize);
+DEVICE_FUNCTION(cl_int)
+lz4_decompress(const char *source, cl_int slen,
+			   char *dest, cl_int rawsize);
 DEVICE_FUNCTION(cl_bool)
 toast_decompress_datum(char *buffer, cl_uint buflen,
 					   const varlena *datum);
+DEVICE_FUNCTION(varlena *)
+kern_decompress_varlena(kern_context *kcxt, varlena *datum);
 /*
  * device functions to reference a particular datum in a tuple
  */
@@ -1711,6 +1923,10 @@ kern_check_visibility_column(kern_context *kcxt,
 							 kern_data_store *kds,
 							 cl_uint rowidx,
 							 struct GstoreFdwSysattr *p_sysattr);
+DEVICE_FUNCTION(cl_bool)
+kern_check_visibility_heap(kern_context *kcxt,
+						   PageHeaderData *pg_page,
+						   HeapTupleHeaderData *htup);
 /*
  * device functions to form/deform HeapTuple
  */
@@ -0,0 +1,607 @@
+/*
+ * cuda_gpubench.h
+ *
+ * CUDA device code of the micro-benchmark for device functions and
+ * the data-store formats; used by utils/gpubench only.
+ * --
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef CUDA_GPUBENCH_H
+#define CUDA_GPUBENCH_H
+#ifdef __CUDACC__
+/*
+ * Synthetic relation of the benchmark:
+ *
+ *   CREATE TABLE gpubench (a int8 not null, b float8, c text);
+ *
+ * 'b' is NULL for every 10th rows, and length of 'c' cycles 8..23 bytes.
+ */
+#define GPUBENCH_NCOLS			3
+#define GPUBENCH_TEXT_LEN(row)	(8 + ((row) & 15))
+#define GPUBENCH_TEXT_MAXLEN	24
+/* total length of 'c' in a cycle of 16 rows; 16*8 + (0+1+...+15) */
+#define GPUBENCH_TEXT_CYCLE_LEN	248
+
+STATIC_INLINE(cl_long)
+gpubench_value_a(cl_uint row)
+{
+	return (cl_long)((row * 2654435761U) % 100000U);
+}
+
+STATIC_INLINE(cl_bool)
+gpubench_value_b(cl_uint row, cl_double *p_value)
+{
+	if (row % 10 == 9)
+		return false;
+	*p_value = (cl_double)row * 0.5;
+	return true;
+}
+
+STATIC_INLINE(cl_uint)
+gpubench_value_c(cl_uint row, char *buf)
+{
+	cl_uint		i, len = GPUBENCH_TEXT_LEN(row);
+
+	for (i=0; i < len; i++)
+		buf[i] = 'a' + ((row * 31 + i * 7) % 26);
+	return len;
+}
+
+/* offset of 'c' on the Arrow's contiguous buffer */
+STATIC_INLINE(cl_uint)
+gpubench_offset_c(cl_uint row)
+{
+	cl_uint		r = (row & 15);
+
+	return ((row >> 4) * GPUBENCH_TEXT_CYCLE_LEN +
+			r * 8 + (r * (r - 1)) / 2);
+}
+
+/* length of the heap-tuple, including the header and alignment */
+#define GPUBENCH_HTUP_HOFF								\
+	MAXALIGN(offsetof(HeapTupleHeaderData, t_bits) +	\
+			 BITMAPLEN(GPUBENCH_NCOLS))
+#define GPUBENCH_HTUP_LENGTH							\
+	MAXALIGN(GPUBENCH_HTUP_HOFF + 2 * sizeof(cl_long) +	\
+			 VARHDRSZ + GPUBENCH_TEXT_MAXLEN)
+/* fixed-length slot of the row- and column-format */
+#define GPUBENCH_ROW_UNITSZ								\
+	MAXALIGN(offsetof(kern_tupitem, htup) + GPUBENCH_HTUP_LENGTH)
+#define GPUBENCH_EXTRA_UNITSZ							\
+	MAXALIGN(VARHDRSZ + GPUBENCH_TEXT_MAXLEN)
+/* number of rows per block of the block-format */
+#define GPUBENCH_NROWS_PER_BLOCK						\
+	((BLCKSZ - SizeOfPageHeaderData) /					\
+	 (GPUBENCH_HTUP_LENGTH + sizeof(ItemIdData)))
+
+/*
+ * gpubench_form_htup - forms a heap-tuple of the synthetic relation
+ */
+STATIC_INLINE(cl_uint)
+gpubench_form_htup(HeapTupleHeaderData *htup, cl_uint row,
+				   BlockNumber block_nr, cl_ushort item_id)
+{
+	cl_long		a = gpubench_value_a(row);
+	cl_double	b;
+	cl_bool		b_isnull = !gpubench_value_b(row, &b);
+	char	   *pos;
+	cl_uint		len;
+
+	memset(htup, 0, GPUBENCH_HTUP_HOFF);
+	htup->t_choice.t_heap.t_xmin = FrozenTransactionId;
+	htup->t_choice.t_heap.t_xmax = InvalidTransactionId;
+	htup->t_ctid.ip_blkid.bi_hi = (block_nr >> 16);
+	htup->t_ctid.ip_blkid.bi_lo = (block_nr & 0xffff);
+	htup->t_ctid.ip_posid = item_id;
+	htup->t_infomask2 = GPUBENCH_NCOLS;
+	htup->t_infomask = (HEAP_XMIN_FROZEN |
+						HEAP_XMAX_INVALID |
+						HEAP_HASVARWIDTH);
+	htup->t_hoff = GPUBENCH_HTUP_HOFF;
+	if (b_isnull)
+	{
+		htup->t_infomask |= HEAP_HASNULL;
+		htup->t_bits[0] = 0x05;		/* 'b' is null */
+	}
+	pos = (char *)htup + htup->t_hoff;
+	memcpy(pos, &a, sizeof(cl_long));
+	pos += sizeof(cl_long);
+	if (!b_isnull)
+	{
+		memcpy(pos, &b, sizeof(cl_double));
+		pos += sizeof(cl_double);
+	}
+	len = gpubench_value_c(row, pos + VARHDRSZ);
+	SET_VARSIZE(pos, VARHDRSZ + len);
+	pos += VARHDRSZ + len;
+
+	return (pos - (char *)htup);
+}
+
+/*
+ * gpubench_setup_colmeta
+ */
+STATIC_INLINE(void)
+__gpubench_setup_colmeta(kern_colmeta *cmeta, cl_short attnum,
+						 cl_bool attbyval, cl_char attalign,
+						 cl_short attlen, cl_short attcacheoff,
+						 cl_uint atttypid, const char *attname)
+{
+	memset(cmeta, 0, sizeof(kern_colmeta));
+	cmeta->attbyval    = attbyval;
+	cmeta->attalign    = attalign;
+	cmeta->attlen      = attlen;
+	cmeta->attnum      = attnum;
+	cmeta->attcacheoff = attcacheoff;
+	cmeta->atttypid    = atttypid;
+	cmeta->atttypmod   = -1;
+	cmeta->atttypkind  = TYPE_KIND__BASE;
+	cmeta->attname.data[0] = attname[0];
+}
+
+/*
+ * gpubench_setup_header - initializes the header portion of the KDS, and
+ * returns the total length of the KDS (and kern_data_extra, if COLUMN).
+ */
+STATIC_INLINE(size_t)
+gpubench_setup_header(kern_data_store *kds, size_t *p_extra_len,
+					  cl_char format, cl_uint nrows)
+{
+	union {
+		kern_data_store	kds;
+		char		__dummy__[sizeof(kern_data_store) +
+							  sizeof(kern_colmeta) * GPUBENCH_NCOLS];
+	} temp;
+	size_t		head_sz = STROMALIGN(offsetof(kern_data_store,
+											  colmeta[GPUBENCH_NCOLS]));
+	size_t		length = head_sz;
+	size_t		extra_len = 0;
+	cl_uint		nrooms = nrows;
+	kern_colmeta *cmeta;
+
+	if (!kds)
+		kds = &temp.kds;	/* only estimation */
+	memset(kds, 0, head_sz);
+	cmeta = kds->colmeta;
+	__gpubench_setup_colmeta(&cmeta[0], 1, true, sizeof(cl_long),
+							 sizeof(cl_long),
+							 GPUBENCH_HTUP_HOFF,
+							 PG_INT8OID, "a");
+	__gpubench_setup_colmeta(&cmeta[1], 2, true, sizeof(cl_double),
+							 sizeof(cl_double),
+							 GPUBENCH_HTUP_HOFF + sizeof(cl_long),
+							 PG_FLOAT8OID, "b");
+	__gpubench_setup_colmeta(&cmeta[2], 3, false, sizeof(cl_int),
+							 -1,
+							 GPUBENCH_HTUP_HOFF + 2 * sizeof(cl_long),
+							 PG_TEXTOID, "c");
+	switch (format)
+	{
+		case KDS_FORMAT_ROW:
+			length += (STROMALIGN(sizeof(cl_uint) * nrows) +
+					   GPUBENCH_ROW_UNITSZ * nrows);
+			kds->usage = __kds_packed(GPUBENCH_ROW_UNITSZ * nrows);
+			break;
+
+		case KDS_FORMAT_BLOCK:
+			nrooms = (nrows + GPUBENCH_NROWS_PER_BLOCK - 1)
+				/ GPUBENCH_NROWS_PER_BLOCK;
+			length += (STROMALIGN(sizeof(BlockNumber) * nrooms) +
+					   BLCKSZ * nrooms);
+			kds->nrows_per_block = GPUBENCH_NROWS_PER_BLOCK;
+			break;
+
+		case KDS_FORMAT_ARROW:
+			/* a: values */
+			cmeta[0].values_offset = __kds_packed(length);
+			cmeta[0].values_length =
+				__kds_packed(STROMALIGN(sizeof(cl_long) * nrows));
+			length += STROMALIGN(sizeof(cl_long) * nrows);
+			/* b: nullmap + values */
+			cmeta[1].nullmap_offset = __kds_packed(length);
+			cmeta[1].nullmap_length =
+				__kds_packed(STROMALIGN(BITMAPLEN(nrows)));
+			length += STROMALIGN(BITMAPLEN(nrows));
+			cmeta[1].values_offset = __kds_packed(length);
+			cmeta[1].values_length =
+				__kds_packed(STROMALIGN(sizeof(cl_double) * nrows));
+			length += STROMALIGN(sizeof(cl_double) * nrows);
+			/* c: offset + extra */
+			cmeta[2].values_offset = __kds_packed(length);
+			cmeta[2].values_length =
+				__kds_packed(STROMALIGN(sizeof(cl_uint) * (nrows + 1)));
+			length += STROMALIGN(sizeof(cl_uint) * (nrows + 1));
+			cmeta[2].extra_offset = __kds_packed(length);
+			cmeta[2].extra_length =
+				__kds_packed(STROMALIGN(gpubench_offset_c(nrows)));
+			length += STROMALIGN(gpubench_offset_c(nrows));
+			break;
+
+		case KDS_FORMAT_COLUMN:
+			/* a: values */
+			cmeta[0].values_offset = __kds_packed(length);
+			cmeta[0].values_length =
+				__kds_packed(STROMALIGN(sizeof(cl_long) * nrows));
+			length += STROMALIGN(sizeof(cl_long) * nrows);
+			/* b: nullmap + values */
+			cmeta[1].nullmap_offset = __kds_packed(length);
+			cmeta[1].nullmap_length =
+				__kds_packed(STROMALIGN(sizeof(cl_uint) *
+										((nrows + 31) / 32)));
+			length += STROMALIGN(sizeof(cl_uint) * ((nrows + 31) / 32));
+			cmeta[1].values_offset = __kds_packed(length);
+			cmeta[1].values_length =
+				__kds_packed(STROMALIGN(sizeof(cl_double) * nrows));
+			length += STROMALIGN(sizeof(cl_double) * nrows);
+			/* c: packed offset to the kern_data_extra */
+			cmeta[2].values_offset = __kds_packed(length);
+			cmeta[2].values_length =
+				__kds_packed(STROMALIGN(sizeof(cl_uint) * nrows));
+			length += STROMALIGN(sizeof(cl_uint) * nrows);
+			extra_len = (MAXALIGN(offsetof(kern_data_extra, data)) +
+						 GPUBENCH_EXTRA_UNITSZ * nrows);
+			break;
+
+		default:
+			return 0;
+	}
+	kds->length      = length;
+	kds->nitems      = nrooms;
+	kds->nrooms      = nrooms;
+	kds->ncols       = GPUBENCH_NCOLS;
+	kds->format      = format;
+	kds->has_varlena = true;
+	kds->tdtypeid    = 0;
+	kds->tdtypmod    = -1;
+	kds->nr_colmeta  = GPUBENCH_NCOLS;
+	if (p_extra_len)
+		*p_extra_len = extra_len;
+	return length;
+}
+
+/*
+ * gpubench_setup_row - fills up a row of the synthetic relation
+ */
+STATIC_INLINE(void)
+gpubench_setup_row(kern_data_store *kds, kern_data_extra *extra,
+				   cl_uint nrows, cl_uint row)
+{
+	kern_colmeta *cmeta = kds->colmeta;
+	char	   *base = (char *)kds;
+	cl_double	b;
+
+	switch (kds->format)
+	{
+		case KDS_FORMAT_ROW:
+			{
+				size_t		head_sz = (KERN_DATA_STORE_HEAD_LENGTH(kds) +
+									   STROMALIGN(sizeof(cl_uint) * nrows));
+				size_t		offset = head_sz + GPUBENCH_ROW_UNITSZ * row;
+				kern_tupitem *tupitem = (kern_tupitem *)(base + offset);
+
+				tupitem->t_len = gpubench_form_htup(&tupitem->htup, row,
+													0, row + 1);
+				tupitem->rowid = row;
+				KERN_DATA_STORE_ROWINDEX(kds)[row] = __kds_packed(offset);
+			}
+			break;
+
+		case KDS_FORMAT_BLOCK:
+			{
+				cl_uint		block_id = row / GPUBENCH_NROWS_PER_BLOCK;
+				cl_uint		item_id = row % GPUBENCH_NROWS_PER_BLOCK;
+				cl_uint		nitems;
+				PageHeaderData *page;
+				ItemIdData *lpp;
+				cl_uint		offset;
+
+				page = KERN_DATA_STORE_BLOCK_PGPAGE(kds, block_id);
+				if (item_id == 0)
+				{
+					nitems = Min(nrows - row, GPUBENCH_NROWS_PER_BLOCK);
+					memset(page, 0, SizeOfPageHeaderData);
+					page->pd_flags   = PD_ALL_VISIBLE;
+					page->pd_lower   = (SizeOfPageHeaderData +
+										sizeof(ItemIdData) * nitems);
+					page->pd_upper   = BLCKSZ - GPUBENCH_HTUP_LENGTH * nitems;
+					page->pd_special = BLCKSZ;
+					page->pd_pagesize_version = BLCKSZ;
+					KERN_DATA_STORE_BLOCK_BLCKNR(kds, block_id) = block_id;
+				}
+				offset = BLCKSZ - GPUBENCH_HTUP_LENGTH * (item_id + 1);
+				lpp = &page->pd_linp[item_id];
+				lpp->lp_off   = offset;
+				lpp->lp_flags = LP_NORMAL;
+				lpp->lp_len   = gpubench_form_htup((HeapTupleHeaderData *)
+												   ((char *)page + offset),
+												   row, block_id,
+												   item_id + 1);
+			}
+			break;
+
+		case KDS_FORMAT_ARROW:
+			{
+				cl_long	   *a_values = (cl_long *)
+					(base + __kds_unpack(cmeta[0].values_offset));
+				cl_uint	   *b_nullmap = (cl_uint *)
+					(base + __kds_unpack(cmeta[1].nullmap_offset));
+				cl_double  *b_values = (cl_double *)
+					(base + __kds_unpack(cmeta[1].values_offset));
+				cl_uint	   *c_offset = (cl_uint *)
+					(base + __kds_unpack(cmeta[2].values_offset));
+				char	   *c_extra =
+					(base + __kds_unpack(cmeta[2].extra_offset));
+
+				a_values[row] = gpubench_value_a(row);
+				if (gpubench_value_b(row, &b))
+				{
+					b_values[row] = b;
+					/* same bit order as Arrow's validity bitmap */
+					atomicOr(&b_nullmap[row >> 5], 1U << (row & 0x1f));
+				}
+				else
+					b_values[row] = 0.0;
+				c_offset[row] = gpubench_offset_c(row);
+				if (row == nrows - 1)
+					c_offset[nrows] = gpubench_offset_c(nrows);
+				gpubench_value_c(row, c_extra + c_offset[row]);
+			}
+			break;
+
+		case KDS_FORMAT_COLUMN:
+			{
+				cl_long	   *a_values = (cl_long *)
+					(base + __kds_unpack(cmeta[0].values_offset));
+				cl_uint	   *b_nullmap = (cl_uint *)
+					(base + __kds_unpack(cmeta[1].nullmap_offset));
+				cl_double  *b_values = (cl_double *)
+					(base + __kds_unpack(cmeta[1].values_offset));
+				cl_uint	   *c_values = (cl_uint *)
+					(base + __kds_unpack(cmeta[2].values_offset));
+				size_t		offset = (MAXALIGN(offsetof(kern_data_extra,
+														data)) +
+									  GPUBENCH_EXTRA_UNITSZ * row);
+				char	   *vl_pos = (char *)extra + offset;
+				cl_uint		len;
+
+				a_values[row] = gpubench_value_a(row);
+				if (gpubench_value_b(row, &b))
+				{
+					b_values[row] = b;
+					atomicOr(&b_nullmap[row >> 5], 1U << (row & 0x1f));
+				}
+				else
+					b_values[row] = 0.0;
+				len = gpubench_value_c(row, vl_pos + VARHDRSZ);
+				SET_VARSIZE(vl_pos, VARHDRSZ + len);
+				c_values[row] = __kds_packed(offset);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * gpubench_fetch_row - fetches the values of the synthetic relation
+ *
+ * It returns false if @index is out of range, or not a valid item of
+ * the KDS_FORMAT_BLOCK.
+ */
+STATIC_INLINE(cl_bool)
+gpubench_fetch_row(kern_context *kcxt,
+				   kern_data_store *kds,
+				   kern_data_extra *extra,
+				   cl_char format,
+				   cl_uint index,
+				   pg_int8_t &a, pg_float8_t &b, pg_text_t &c)
+{
+	HeapTupleHeaderData *htup = NULL;
+
+	switch (format)
+	{
+		case KDS_FORMAT_ROW:
+			if (index >= kds->nitems)
+				return false;
+			htup = &KERN_DATA_STORE_TUPITEM(kds, index)->htup;
+			break;
+
+		case KDS_FORMAT_BLOCK:
+			{
+				cl_uint		block_id = index / kds->nrows_per_block;
+				cl_uint		item_id = index % kds->nrows_per_block;
+				PageHeaderData *page;
+				ItemIdData *lpp;
+
+				if (block_id >= kds->nitems)
+					return false;
+				page = KERN_DATA_STORE_BLOCK_PGPAGE(kds, block_id);
+				if (item_id >= PageGetMaxOffsetNumber(page))
+					return false;
+				lpp = PageGetItemId(page, item_id + 1);
+				if (!ItemIdIsNormal(lpp))
+					return false;
+				htup = PageGetItem(page, lpp);
+			}
+			break;
+
+		case KDS_FORMAT_ARROW:
+			if (index >= kds->nitems)
+				return false;
+			pg_datum_ref_arrow(kcxt, a, kds, 0, index);
+			pg_datum_ref_arrow(kcxt, b, kds, 1, index);
+			pg_datum_ref_arrow(kcxt, c, kds, 2, index);
+			return true;
+
+		case KDS_FORMAT_COLUMN:
+			if (index >= kds->nitems)
+				return false;
+			pg_datum_ref(kcxt, a, kern_get_datum_column(kds, extra, 0, index));
+			pg_datum_ref(kcxt, b, kern_get_datum_column(kds, extra, 1, index));
+			pg_datum_ref(kcxt, c, kern_get_datum_column(kds, extra, 2, index));
+			return true;
+
+		default:
+			return false;
+	}
+	pg_datum_ref(kcxt, a, kern_get_datum_tuple(kds->colmeta, htup, 0));
+	pg_datum_ref(kcxt, b, kern_get_datum_tuple(kds->colmeta, htup, 1));
+	pg_datum_ref(kcxt, c, kern_get_datum_tuple(kds->colmeta, htup, 2));
+	return true;
+}
+
+/*
+ * Device function families to be benchmarked. Each returns a value to be
+ * accumulated, to prevent the compiler from removing the evaluation.
+ */
+STATIC_INLINE(cl_ulong)
+gpubench_eval_fetch(kern_context *kcxt,
+					pg_int8_t &a, pg_float8_t &b, pg_text_t &c)
+{
+	return ((a.isnull ? 0 : 1) +
+			(b.isnull ? 0 : 1) +
+			(c.isnull ? 0 : 1));
+}
+
+STATIC_INLINE(cl_ulong)
+gpubench_eval_primitive(kern_context *kcxt,
+						pg_int8_t &a, pg_float8_t &b, pg_text_t &c)
+{
+	pg_int8_t	x, k;
+	pg_float8_t	y;
+	pg_int4_t	cmp;
+	cl_ulong	count = 0;
+
+	k.isnull = false;
+	k.value  = 50000;
+	x = pgfn_int8pl(kcxt, a, a);
+	cmp = pgfn_type_compare(kcxt, x, k);
+	if (!cmp.isnull && cmp.value > 0)
+		count++;
+	y = pgfn_float8mul(kcxt, b, b);
+	if (!y.isnull && y.value > 1000.0)
+		count++;
+	return count;
+}
+
+STATIC_INLINE(cl_ulong)
+gpubench_eval_numeric(kern_context *kcxt,
+					  pg_int8_t &a, pg_float8_t &b, pg_text_t &c)
+{
+	pg_numeric_t	x, y, z;
+	pg_bool_t		rv;
+
+	x = pgfn_int8_numeric(kcxt, a);
+	y = pgfn_float8_numeric(kcxt, b);
+	z = pgfn_numeric_add(kcxt, x, y);
+	rv = pgfn_numeric_gt(kcxt, z, x);
+	return (!rv.isnull && rv.value ? 1 : 0);
+}
+
+STATIC_INLINE(cl_ulong)
+gpubench_eval_textlib(kern_context *kcxt,
+					  pg_int8_t &a, pg_float8_t &b, pg_text_t &c)
+{
+	pg_text_t	pattern;
+	pg_int4_t	len;
+	pg_bool_t	rv;
+	cl_ulong	count = 0;
+
+	pattern.isnull = false;
+	pattern.value  = (char *)"%ab%";
+	pattern.length = 4;
+	len = pgfn_textlen(kcxt, c);
+	if (!len.isnull)
+		count += len.value;
+	rv = pgfn_textlike(kcxt, c, pattern);
+	if (!rv.isnull && rv.value)
+		count++;
+	return count;
+}
+
+#endif	/* __CUDACC__ */
+
+#ifdef __CUDACC_RTC__
+/*
+ * GPU kernel entrypoint - valid only NVRTC
+ */
+KERNEL_FUNCTION(void)
+kern_gpubench_setup_header(kern_data_store *kds,
+						   cl_ulong *p_length,
+						   cl_char format, cl_uint nrows)
+{
+	size_t		extra_len;
+
+	if (get_global_id() == 0)
+	{
+		p_length[0] = gpubench_setup_header(kds, &extra_len,
+											format, nrows);
+		p_length[1] = extra_len;
+	}
+}
+
+KERNEL_FUNCTION(void)
+kern_gpubench_setup_body(kern_data_store *kds,
+						 kern_data_extra *extra,
+						 cl_uint nrows)
+{
+	cl_uint		row;
+
+	for (row = get_global_id(); row < nrows; row += get_global_size())
+		gpubench_setup_row(kds, extra, nrows, row);
+}
+
+#define GPUBENCH_KERNEL_TEMPLATE(FAMILY,FORMAT,FORMAT_CODE)			\
+	KERNEL_FUNCTION(void)											\
+	kern_gpubench_##FAMILY##_##FORMAT(kern_parambuf *kparams,		\
+									  kern_data_store *kds,			\
+									  kern_data_extra *extra,		\
+									  cl_uint nitems,				\
+									  cl_ulong *p_result,			\
+									  kern_errorbuf *kerror)		\
+	{																\
+		DECL_KERNEL_CONTEXT(u);										\
+		pg_int8_t	a;												\
+		pg_float8_t	b;												\
+		pg_text_t	c;												\
+		cl_ulong	sum = 0;										\
+		cl_uint		index;											\
+																	\
+		INIT_KERNEL_CONTEXT(&u.kcxt, kparams);						\
+		for (index = get_global_id();								\
+			 index < nitems;										\
+			 index += get_global_size())							\
+		{															\
+			if (gpubench_fetch_row(&u.kcxt, kds, extra,				\
+								   FORMAT_CODE, index, a, b, c))	\
+				sum += gpubench_eval_##FAMILY(&u.kcxt, a, b, c);	\
+			u.kcxt.vlpos = u.kcxt.vlbuf;							\
+		}															\
+		atomicAdd(p_result, sum);									\
+		kern_writeback_error_status(kerror, &u.kcxt);				\
+	}
+
+#define GPUBENCH_KERNEL_FAMILY_TEMPLATE(FAMILY)						\
+	GPUBENCH_KERNEL_TEMPLATE(FAMILY, row,    KDS_FORMAT_ROW)		\
+	GPUBENCH_KERNEL_TEMPLATE(FAMILY, block,  KDS_FORMAT_BLOCK)		\
+	GPUBENCH_KERNEL_TEMPLATE(FAMILY, arrow,  KDS_FORMAT_ARROW)		\
+	GPUBENCH_KERNEL_TEMPLATE(FAMILY, column, KDS_FORMAT_COLUMN)
+
+GPUBENCH_KERNEL_FAMILY_TEMPLATE(fetch)
+GPUBENCH_KERNEL_FAMILY_TEMPLATE(primitive)
+GPUBENCH_KERNEL_FAMILY_TEMPLATE(numeric)
+GPUBENCH_KERNEL_FAMILY_TEMPLATE(textlib)
+
+#endif	/* __CUDACC_RTC__ */
+#endif	/* CUDA_GPUBENCH_H */
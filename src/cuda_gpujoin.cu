@@ -27,6 +27,7 @@ static __shared__ cl_int	base_depth;
 static __shared__ cl_uint	src_read_pos;
 static __shared__ cl_uint	dst_base_index;
 static __shared__ size_t	dst_base_usage;
+static __shared__ cl_uint	fused_slot_index;
 extern __shared__ cl_uint	wip_count[0];	/* [GPUJOIN_MAX_DEPTH+1] items */
 extern __shared__ cl_uint	read_pos[0];	/* [GPUJOIN_MAX_DEPTH+1] items */
 extern __shared__ cl_uint	write_pos[0];	/* [GPUJOIN_MAX_DEPTH+1] items */
@@ -174,6 +175,7 @@ gpujoin_rewind_stack(kern_gpujoin *kgjoin, cl_int depth,
 STATIC_FUNCTION(cl_int)
 gpujoin_load_source(kern_context *kcxt,
 					kern_gpujoin *kgjoin,
+					kern_multirels *kmrels,
 					kern_data_store *kds_src,
 					kern_data_extra *kds_extra,
 					cl_uint *wr_stack,
@@ -249,10 +251,11 @@ gpujoin_load_source(kern_context *kcxt,
 
 					htup = PageGetItem(pg_page, lpp);
 
-					visible = gpujoin_quals_eval(kcxt,
-												 kds_src,
-												 &t_self,
-												 htup);
+					if (kern_check_visibility_heap(kcxt, pg_page, htup))
+						visible = gpujoin_quals_eval(kcxt,
+													 kds_src,
+													 &t_self,
+													 htup);
 				}
 			}
 		}
@@ -302,7 +305,31 @@ gpujoin_load_source(kern_context *kcxt,
 	else
 	{
 		STROM_ELOG(kcxt, "unsupported KDS format");
-	}	
+	}
+
+	/*
+	 * Runtime join filter: if the first depth is hash-join and has bloom
+	 * filter of the inner keys, outer rows that obviously have no matched
+	 * inner rows are dropped prior to the hash table probe.
+	 */
+	if (visible && KERN_MULTIRELS_BLOOM_FILTER(kmrels, 1) != NULL)
+	{
+		cl_uint		hash_value;
+		cl_bool		is_null_keys;
+
+		hash_value = gpujoin_hash_value(kcxt,
+										kds_src,
+										kds_extra,
+										kmrels,
+										1,
+										&t_offset,
+										&is_null_keys);
+		if (is_null_keys ||
+			!gpujoin_bloom_filter_test(kmrels, 1, hash_value))
+			visible = false;
+		/* rewind the varlena buffer */
+		kcxt->vlpos = kcxt->vlbuf;
+	}
 	/* error checks */
 	if (__syncthreads_count(kcxt->errcode) > 0)
 		return -1;
@@ -394,6 +421,7 @@ gpujoin_load_outer(kern_context *kcxt,
 	kern_tupitem   *tupitem;
 	cl_uint			t_offset;
 	cl_uint			row_index;
+	cl_uint			row_end = Min(kds_in->nitems, kgjoin->outer_row_end);
 	cl_uint			wr_index;
 	cl_uint			count;
 
@@ -406,7 +434,7 @@ gpujoin_load_outer(kern_context *kcxt,
 	row_index = src_read_pos + get_local_id();
 
 	/* pickup inner rows, if unreferenced */
-	if (row_index < kds_in->nitems && !ojmap[row_index])
+	if (row_index < row_end && !ojmap[row_index])
 	{
 		tupitem = KERN_DATA_STORE_TUPITEM(kds_in, row_index);
 		t_offset = __kds_packed((char *)&tupitem->htup -
@@ -432,8 +460,8 @@ gpujoin_load_outer(kern_context *kcxt,
 		__syncthreads();
 	}
 
-	/* end of the inner relation? */
-	if (src_read_pos >= kds_in->nitems)
+	/* end of the inner relation (or the range assigned to this task)? */
+	if (src_read_pos >= row_end)
 	{
 		/* don't rewind the stack any more */
 		if (get_local_id() == 0)
@@ -460,6 +488,25 @@ gpujoin_load_outer(kern_context *kcxt,
 	return outer_depth;
 }
 
+/*
+ * gpujoin_physical_stack
+ *
+ * It rearranges the combination on the pseudo-stack to the planned depth
+ * order, if this kernel runs the inner relations in an alternative order.
+ */
+STATIC_INLINE(cl_uint *)
+gpujoin_physical_stack(kern_gpujoin *kgjoin, cl_uint *rd_stack, cl_uint *buf)
+{
+	cl_int		i;
+
+	if (!kgjoin->depth_reordered)
+		return rd_stack;
+	buf[0] = rd_stack[0];
+	for (i=1; i <= kgjoin->num_rels; i++)
+		buf[KERN_GPUJOIN_PHYSICAL_DEPTH(kgjoin, i)] = rd_stack[i];
+	return buf;
+}
+
 /*
  * gpujoin_projection_row
  */
@@ -483,6 +530,7 @@ gpujoin_projection_row(kern_context *kcxt,
 	cl_uint		required;
 	cl_char	   *tup_dclass;
 	Datum	   *tup_values;
+	cl_uint	   *tup_stack = NULL;
 	cl_int		needs_suspend = 0;
 
 	/* sanity checks */
@@ -492,11 +540,18 @@ gpujoin_projection_row(kern_context *kcxt,
 	if (read_pos[nrels] >= write_pos[nrels])
 		return gpujoin_rewind_stack(kgjoin, nrels, l_state, matched);
 
-	/* Allocation of tup_dclass/values */
+	/* Allocation of tup_dclass/values (and stack, if reordered) */
 	tup_dclass = (cl_char *)
 		kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
 	tup_values = (Datum *)
 		kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
+	if (kgjoin->depth_reordered)
+	{
+		tup_stack = (cl_uint *)
+			kern_context_alloc(kcxt, sizeof(cl_uint) * (nrels + 1));
+		if (!tup_stack)
+			STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY, "out of memory");
+	}
 	if (!tup_dclass || !tup_values)
 		STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY, "out of memory");
 	if (__syncthreads_count(kcxt->errcode) > 0)
@@ -517,7 +572,7 @@ gpujoin_projection_row(kern_context *kcxt,
 						   kds_src,
 						   kds_extra,
 						   kmrels,
-						   rd_stack,
+						   gpujoin_physical_stack(kgjoin, rd_stack, tup_stack),
 						   kds_dst,
 						   tup_dclass,
 						   tup_values,
@@ -608,6 +663,196 @@ gpupreagg_projection_slot(kern_context *kcxt_gpreagg,
 						  Datum   *src_values,
 						  cl_char *dst_dclass,
 						  Datum   *dst_values);
+DEVICE_FUNCTION(void)
+gpupreagg_nogroup_calc(cl_int attnum,
+					   cl_char *p_accum_dclass,
+					   Datum   *p_accum_datum,
+					   cl_char  newval_dclass,
+					   Datum    newval_datum);
+
+/*
+ * gpujoin_projection_nogroup
+ *
+ * A fused variation of gpujoin_projection_slot for the combined GpuJoin +
+ * GpuPreAgg without grouping keys. The joined rows are projected into the
+ * registers, then reduced within the thread-block on the shared memory.
+ * Only one partial aggregation row per thread-block is written to the
+ * kds_dst, so the subsequent reduction kernel has little job to do.
+ */
+STATIC_FUNCTION(cl_int)
+gpujoin_projection_nogroup(kern_context *kcxt,
+						   kern_parambuf *kparams_gpreagg,
+						   kern_gpujoin *kgjoin,
+						   kern_multirels *kmrels,
+						   kern_data_store *kds_src,
+						   kern_data_extra *kds_extra,
+						   kern_data_store *kds_dst,
+						   cl_uint *rd_stack,
+						   cl_uint *l_state,
+						   cl_bool *matched)
+{
+	kern_parambuf *kparams_saved = kcxt->kparams;
+	varlena	   *kparam_0 = (varlena *)kparam_get_value(kparams_gpreagg, 0);
+	cl_char	   *attr_is_preagg = (cl_char *)VARDATA(kparam_0);
+	cl_uint		nrels = kgjoin->num_rels;
+	cl_uint		read_index;
+	cl_uint		nvalids;
+	cl_uint		i, j, dist, buddy;
+	cl_char	   *tup_dclass = NULL;
+	Datum	   *tup_values = NULL;
+	cl_uint	   *tup_extras = NULL;
+	cl_uint	   *tup_stack = NULL;
+	cl_char	   *row_dclass = NULL;
+	Datum	   *row_values = NULL;
+	__shared__ cl_char	l_dclass[MAXTHREADS_PER_BLOCK];
+	__shared__ Datum	l_values[MAXTHREADS_PER_BLOCK];
+	__shared__ cl_bool	slot_is_new;
+
+	/* sanity checks */
+	assert(rd_stack != NULL);
+	assert(kds_dst->format == KDS_FORMAT_SLOT);
+
+	/* Any more result rows to be reduced? */
+	if (read_pos[nrels] >= write_pos[nrels])
+		return gpujoin_rewind_stack(kgjoin, nrels, l_state, matched);
+
+	/* Allocation of tup_dclass/values/extra and the projection row */
+	tup_dclass = (cl_char *)
+		kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
+	tup_values = (Datum *)
+		kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
+	tup_extras = (cl_uint *)
+		kern_context_alloc(kcxt, sizeof(cl_uint) * kds_dst->ncols);
+	row_dclass = (cl_char *)
+		kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
+	row_values = (Datum *)
+		kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
+	if (kgjoin->depth_reordered)
+	{
+		tup_stack = (cl_uint *)
+			kern_context_alloc(kcxt, sizeof(cl_uint) * (nrels + 1));
+		if (!tup_stack)
+			STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY, "out of memory");
+	}
+	if (!tup_dclass || !tup_values || !tup_extras ||
+		!row_dclass || !row_values)
+		STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY, "out of memory");
+	if (__syncthreads_count(kcxt->errcode) > 0)
+		return -1;		/* bailout GpuJoin */
+
+	/* pick up combinations from the pseudo-stack */
+	nvalids = Min(write_pos[nrels] - read_pos[nrels],
+				  get_local_size());
+	read_index = read_pos[nrels] + get_local_id();
+	__syncthreads();
+
+	/* step.1 - projection by GpuJoin, then by GpuPreAgg */
+	if (read_index < write_pos[nrels])
+	{
+		rd_stack += read_index * (nrels + 1);
+
+		gpujoin_projection(kcxt,
+						   kds_src,
+						   kds_extra,
+						   kmrels,
+						   gpujoin_physical_stack(kgjoin,
+												  rd_stack,
+												  tup_stack),
+						   kds_dst,
+						   tup_dclass,
+						   tup_values,
+						   tup_extras);
+		kcxt->kparams = kparams_gpreagg;
+		gpupreagg_projection_slot(kcxt,
+								  tup_dclass,
+								  tup_values,
+								  row_dclass,
+								  row_values);
+		kcxt->kparams = kparams_saved;
+	}
+	if (__syncthreads_count(kcxt->errcode) > 0)
+		return -1;	/* bailout */
+
+	/* step.2 - assign a slot of kds_dst for this thread-block */
+	if (get_local_id() == 0)
+	{
+		slot_is_new = false;
+		if (fused_slot_index == UINT_MAX)
+		{
+			i = atomicAdd(&kds_dst->nitems, 1);
+			if (KERN_DATA_STORE_SLOT_LENGTH(kds_dst, i + 1) > kds_dst->length)
+				STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY,
+							  "no slot for the fused reduction");
+			else
+			{
+				/* grouping keys and junks, if any, come from the first row */
+				memcpy(KERN_DATA_STORE_DCLASS(kds_dst, i), row_dclass,
+					   sizeof(cl_char) * kds_dst->ncols);
+				memcpy(KERN_DATA_STORE_VALUES(kds_dst, i), row_values,
+					   sizeof(Datum) * kds_dst->ncols);
+				fused_slot_index = i;
+				slot_is_new = true;
+			}
+		}
+	}
+	if (__syncthreads_count(kcxt->errcode) > 0)
+		return -1;	/* bailout */
+
+	/* step.3 - reduction on the shared memory, then merge to the slot */
+	for (j=0; j < kds_dst->ncols; j++)
+	{
+		if (!attr_is_preagg[j])
+			continue;
+		if (get_local_id() < nvalids)
+		{
+			l_dclass[get_local_id()] = row_dclass[j];
+			l_values[get_local_id()] = row_values[j];
+		}
+		__syncthreads();
+
+		for (dist=2, buddy=1; dist < 2 * nvalids; buddy=dist, dist *= 2)
+		{
+			i = get_local_id();
+			if ((i & (dist - 1)) == 0 && i + buddy < nvalids)
+			{
+				gpupreagg_nogroup_calc(j,
+									   &l_dclass[i],
+									   &l_values[i],
+									   l_dclass[i + buddy],
+									   l_values[i + buddy]);
+			}
+			__syncthreads();
+		}
+
+		if (get_local_id() == 0)
+		{
+			cl_char	   *dst_dclass
+				= KERN_DATA_STORE_DCLASS(kds_dst, fused_slot_index);
+			Datum	   *dst_values
+				= KERN_DATA_STORE_VALUES(kds_dst, fused_slot_index);
+
+			if (slot_is_new)
+			{
+				dst_dclass[j] = l_dclass[0];
+				dst_values[j] = l_values[0];
+			}
+			else
+			{
+				gpupreagg_nogroup_calc(j,
+									   &dst_dclass[j],
+									   &dst_values[j],
+									   l_dclass[0],
+									   l_values[0]);
+			}
+		}
+		__syncthreads();
+	}
+
+	/* step.4 - make advance the read position */
+	if (get_local_id() == 0)
+		read_pos[nrels] += nvalids;
+	return nrels + 1;
+}
 
 /*
  * gpujoin_projection_slot
@@ -635,12 +880,26 @@ gpujoin_projection_slot(kern_context *kcxt,
 	cl_char	   *tup_dclass = NULL;
 	Datum	   *tup_values = NULL;
 	cl_uint	   *tup_extras = NULL;
+	cl_uint	   *tup_stack = NULL;
 	cl_uint		extra_sz = 0;
 	cl_int		needs_suspend = 0;
 
 	/* sanity checks */
 	assert(rd_stack != NULL);
 
+	/* fused reduction, if GpuPreAgg has no grouping keys */
+	if (kgjoin->fused_nogroup)
+		return gpujoin_projection_nogroup(kcxt,
+										  kparams_gpreagg,
+										  kgjoin,
+										  kmrels,
+										  kds_src,
+										  kds_extra,
+										  kds_dst,
+										  rd_stack,
+										  l_state,
+										  matched);
+
 	/* Any more result rows to be written? */
 	if (read_pos[nrels] >= write_pos[nrels])
 		return gpujoin_rewind_stack(kgjoin, nrels, l_state, matched);
@@ -652,6 +911,13 @@ gpujoin_projection_slot(kern_context *kcxt,
 		kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
 	tup_extras = (cl_uint *)
 		kern_context_alloc(kcxt, sizeof(cl_uint) * kds_dst->ncols);
+	if (kgjoin->depth_reordered)
+	{
+		tup_stack = (cl_uint *)
+			kern_context_alloc(kcxt, sizeof(cl_uint) * (nrels + 1));
+		if (!tup_stack)
+			STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY, "out of memory");
+	}
 	if (!tup_dclass || !tup_values || !tup_extras)
 		STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY, "out of memory");
 	if (__syncthreads_count(kcxt->errcode) > 0)
@@ -672,7 +938,9 @@ gpujoin_projection_slot(kern_context *kcxt,
 									  kds_src,
 									  kds_extra,
 									  kmrels,
-									  rd_stack,
+									  gpujoin_physical_stack(kgjoin,
+															 rd_stack,
+															 tup_stack),
 									  kds_dst,
 									  tup_dclass,
 									  tup_values,
@@ -937,8 +1205,12 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 					  cl_uint *l_state,
 					  cl_bool *matched)
 {
-	kern_data_store	   *kds_hash = KERN_MULTIRELS_INNER_KDS(kmrels, depth);
-	cl_bool			   *oj_map = KERN_MULTIRELS_OUTER_JOIN_MAP(kmrels, depth);
+	cl_int				pdepth = KERN_GPUJOIN_PHYSICAL_DEPTH(kgjoin, depth);
+	kern_data_store	   *kds_hash = KERN_MULTIRELS_INNER_KDS(kmrels, pdepth);
+	cl_bool			   *oj_map = KERN_MULTIRELS_OUTER_JOIN_MAP(kmrels, pdepth);
+	cl_uint			   *buckets = KERN_MULTIRELS_HASH_BUCKET(kmrels, pdepth);
+	cl_uint				nbuckets = kmrels->chunks[pdepth-1].bucket_nbuckets;
+	cl_uint				bucket_entry = UINT_MAX;
 	kern_hashitem	   *khitem = NULL;
 	cl_int				max_depth = kgjoin->num_rels;
 	cl_uint				t_offset = UINT_MAX;
@@ -947,6 +1219,7 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 	cl_uint				wr_index;
 	cl_uint				count;
 	cl_bool				result;
+	cl_bool				early_out = false;
 
 	assert(kds_hash->format == KDS_FORMAT_HASH);
 	assert(depth >= 1 && depth <= max_depth);
@@ -997,12 +1270,18 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 											kds_src,
 											kds_extra,
 											kmrels,
-											depth,
+											pdepth,
 											rd_stack,
 											&is_null_keys);
 			/* MEMO: NULL-keys will never match to inner-join */
 			if (!is_null_keys)
-				khitem = KERN_HASH_FIRST_ITEM(kds_hash, hash_value);
+			{
+				if (buckets)
+					bucket_entry = ((hash_value % nbuckets) *
+									GPUJOIN_HASH_BUCKET_NITEMS);
+				else
+					khitem = KERN_HASH_FIRST_ITEM(kds_hash, hash_value);
+			}
 			/* rewind the varlena buffer */
 			kcxt->vlpos = kcxt->vlbuf;
 		}
@@ -1015,6 +1294,14 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 			l_state[depth] = UINT_MAX;
 		}
 	}
+	else if (l_state[depth] != UINT_MAX && buckets)
+	{
+		/* walks on the next entry of the hash-bucket */
+		bucket_entry = l_state[depth] - 1;
+		hash_value = *gpujoin_hash_bucket_hash(buckets, bucket_entry);
+		bucket_entry = ((bucket_entry + 1) %
+						(nbuckets * GPUJOIN_HASH_BUCKET_NITEMS));
+	}
 	else if (l_state[depth] != UINT_MAX)
 	{
 		/* walks on the hash-slot chain */
@@ -1027,8 +1314,14 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 		khitem = KERN_HASH_NEXT_ITEM(kds_hash, khitem);
 	}
 
-	while (khitem && khitem->hash != hash_value)
-		khitem = KERN_HASH_NEXT_ITEM(kds_hash, khitem);
+	if (bucket_entry != UINT_MAX)
+		khitem = gpujoin_hash_bucket_lookup(kds_hash, buckets, nbuckets,
+											hash_value, &bucket_entry);
+	else
+	{
+		while (khitem && khitem->hash != hash_value)
+			khitem = KERN_HASH_NEXT_ITEM(kds_hash, khitem);
+	}
 
 	if (khitem)
 	{
@@ -1040,7 +1333,7 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 									kds_src,
 									kds_extra,
 									kmrels,
-									depth,
+									pdepth,
 									rd_stack,
 									&khitem->t.htup,
 									&joinquals_matched);
@@ -1056,19 +1349,36 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 		}
 		t_offset = __kds_packed((char *)&khitem->t.htup -
 								(char *)kds_hash);
+		/*
+		 * SEMI/ANTI JOIN needs to know only whether the outer row has any
+		 * matched inner row, so we break the hash-chain walk at the first
+		 * match. ANTI JOIN never emits the matched combination.
+		 */
+		if (KERN_MULTIRELS_ANTI_JOIN(kmrels, pdepth))
+			result = false;
+		if (joinquals_matched &&
+			(KERN_MULTIRELS_SEMI_JOIN(kmrels, pdepth) ||
+			 KERN_MULTIRELS_ANTI_JOIN(kmrels, pdepth)))
+			early_out = true;
 	}
-	else if (KERN_MULTIRELS_LEFT_OUTER_JOIN(kmrels, depth) &&
+	else if ((KERN_MULTIRELS_LEFT_OUTER_JOIN(kmrels, pdepth) ||
+			  KERN_MULTIRELS_ANTI_JOIN(kmrels, pdepth)) &&
 			 l_state[depth] != UINT_MAX &&
 			 !matched[depth])
 	{
-		/* No matched outer rows, but LEFT/FULL OUTER */
+		/* No matched outer rows, but LEFT/FULL OUTER or ANTI */
 		result = true;
 	}
 	else
 		result = false;
 
-	/* save the current hash item */
-	l_state[depth] = t_offset;
+	/* save the current hash item (or entry of the hash-bucket) */
+	if (early_out || !khitem)
+		l_state[depth] = UINT_MAX;
+	else if (buckets)
+		l_state[depth] = bucket_entry + 1;
+	else
+		l_state[depth] = t_offset;
 	wr_index = write_pos[depth];
 	wr_index += pgstromStairlikeBinaryCount(result, &count);
 	if (get_local_id() == 0)
@@ -1106,6 +1416,199 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 	return depth+1;
 }
 
+/*
+ * gpujoin_exec_mergejoin
+ *
+ * Inner rows are sorted by the join keys on the preloading, so each thread
+ * looks up the partition of the inner rows which may match to its outer row
+ * by the merge-path search, then walks on the sorted index as long as the
+ * join keys are equal. It needs neither hash-table nor sorted outer rows.
+ */
+STATIC_FUNCTION(cl_int)
+gpujoin_exec_mergejoin(kern_context *kcxt,
+					   kern_gpujoin *kgjoin,
+					   kern_multirels *kmrels,
+					   kern_data_store *kds_src,
+					   kern_data_extra *kds_extra,
+					   cl_int depth,
+					   cl_uint *rd_stack,
+					   cl_uint *wr_stack,
+					   cl_uint *l_state,
+					   cl_bool *matched)
+{
+	cl_int				pdepth = KERN_GPUJOIN_PHYSICAL_DEPTH(kgjoin, depth);
+	kern_data_store	   *kds_in = KERN_MULTIRELS_INNER_KDS(kmrels, pdepth);
+	cl_bool			   *oj_map = KERN_MULTIRELS_OUTER_JOIN_MAP(kmrels, pdepth);
+	cl_uint			   *sorted = KERN_MULTIRELS_MERGE_INDEX(kmrels, pdepth);
+	kern_tupitem	   *tupitem = NULL;
+	cl_int				max_depth = kgjoin->num_rels;
+	cl_uint				t_offset = 0;
+	cl_uint				curr_pos = UINT_MAX;
+	cl_uint				rd_index;
+	cl_uint				wr_index;
+	cl_uint				count;
+	cl_bool				is_null_keys = false;
+	cl_bool				result;
+
+	assert(kds_in->format == KDS_FORMAT_ROW && sorted != NULL);
+	assert(depth >= 1 && depth <= max_depth);
+
+	if (__syncthreads_count(l_state[depth] != UINT_MAX) == 0)
+	{
+		/*
+		 * OK, all the threads reached to the end of the key range
+		 * Move to the next outer window.
+		 */
+		if (get_local_id() == 0)
+			read_pos[depth-1] += get_local_size();
+		l_state[depth] = 0;
+		matched[depth] = false;
+		return depth;
+	}
+	else if (read_pos[depth-1] >= write_pos[depth-1])
+	{
+		/* see the comment in gpujoin_exec_hashjoin */
+		assert(wip_count[depth] == 0);
+		if (write_pos[depth] + get_local_size() <= GPUJOIN_PSEUDO_STACK_NROOMS)
+		{
+			cl_int	__depth = gpujoin_rewind_stack(kgjoin, depth-1,
+												   l_state, matched);
+			if (__depth >= base_depth)
+				return __depth;
+		}
+		/* elsewhere, dive into the deeper depth or projection */
+		return depth + 1;
+	}
+	rd_index = read_pos[depth-1] + get_local_id();
+	rd_stack += (rd_index * depth);
+
+	if (l_state[depth] == 0)
+	{
+		/* merge-path search: the first inner row not less than the outer */
+		if (rd_index < write_pos[depth-1])
+		{
+			cl_uint		lower = 0;
+			cl_uint		upper = kds_in->nitems;
+			cl_uint		mid;
+			cl_int		comp;
+
+			while (lower < upper)
+			{
+				mid = lower + (upper - lower) / 2;
+				tupitem = KERN_DATA_STORE_TUPITEM(kds_in, sorted[mid]);
+				comp = gpujoin_merge_keycomp(kcxt,
+											 kds_src,
+											 kds_extra,
+											 kmrels,
+											 pdepth,
+											 rd_stack,
+											 &tupitem->htup,
+											 &is_null_keys);
+				/* MEMO: NULL-keys will never match to inner-join */
+				if (is_null_keys)
+					break;
+				if (comp > 0)
+					lower = mid + 1;
+				else
+					upper = mid;
+				/* rewind the varlena buffer */
+				kcxt->vlpos = kcxt->vlbuf;
+			}
+			tupitem = NULL;
+			if (!is_null_keys)
+				curr_pos = lower;
+		}
+		else
+		{
+			/*
+			 * MEMO: We must ensure the threads without outer tuple don't
+			 * generate any LEFT OUTER results.
+			 */
+			l_state[depth] = UINT_MAX;
+		}
+	}
+	else if (l_state[depth] != UINT_MAX)
+	{
+		/* walks on the next entry of the sorted index */
+		curr_pos = l_state[depth] - 1;
+	}
+
+	if (curr_pos < kds_in->nitems)
+	{
+		tupitem = KERN_DATA_STORE_TUPITEM(kds_in, sorted[curr_pos]);
+		if (gpujoin_merge_keycomp(kcxt,
+								  kds_src,
+								  kds_extra,
+								  kmrels,
+								  pdepth,
+								  rd_stack,
+								  &tupitem->htup,
+								  &is_null_keys) != 0 || is_null_keys)
+			tupitem = NULL;
+		kcxt->vlpos = kcxt->vlbuf;
+	}
+
+	if (tupitem)
+	{
+		cl_bool		joinquals_matched;
+
+		result = gpujoin_join_quals(kcxt,
+									kds_src,
+									kds_extra,
+									kmrels,
+									pdepth,
+									rd_stack,
+									&tupitem->htup,
+									&joinquals_matched);
+		assert(result == joinquals_matched);
+		if (joinquals_matched)
+		{
+			/* No LEFT/FULL JOIN are needed */
+			matched[depth] = true;
+			/* No RIGHT/FULL JOIN are needed */
+			if (oj_map && !oj_map[sorted[curr_pos]])
+				oj_map[sorted[curr_pos]] = true;
+		}
+		t_offset = __kds_packed((char *)&tupitem->htup -
+								(char *)kds_in);
+	}
+	else if (KERN_MULTIRELS_LEFT_OUTER_JOIN(kmrels, pdepth) &&
+			 l_state[depth] != UINT_MAX &&
+			 !matched[depth])
+	{
+		/* No matched outer rows, but LEFT/FULL OUTER */
+		result = true;
+	}
+	else
+		result = false;
+
+	/* save the next position on the sorted index */
+	l_state[depth] = (!tupitem ? UINT_MAX : curr_pos + 2);
+	wr_index = write_pos[depth];
+	wr_index += pgstromStairlikeBinaryCount(result, &count);
+	if (get_local_id() == 0)
+	{
+		write_pos[depth] += count;
+		stat_nitems[depth] += count;
+	}
+	wr_stack += wr_index * (depth + 1);
+	if (result)
+	{
+		memcpy(wr_stack, rd_stack, sizeof(cl_uint) * depth);
+		wr_stack[depth] = (!tupitem ? 0U : t_offset);
+	}
+	/* count number of threads still in-progress */
+	count = __syncthreads_count(tupitem != NULL);
+	if (get_local_id() == 0)
+		wip_count[depth] = count;
+	/* see the comment in gpujoin_exec_hashjoin */
+	wr_index = write_pos[depth];
+	__syncthreads();
+	if (wr_index + get_local_size() <= GPUJOIN_PSEUDO_STACK_NROOMS)
+		return depth;
+	return depth+1;
+}
+
 /*
  * GiST index specific structures and labels
  */
@@ -1222,6 +1725,85 @@ gpujoin_prep_gistindex(kern_multirels *kmrels, int depth)
 	}
 }
 
+/*
+ * gpujoin_build_hash_table
+ *
+ * It builds the hash-table of the inner rows that are preloaded without
+ * hash values. Each thread calculates the hash value of a row, then links
+ * it to the hash-slot, and adds it to the hash-bucket index and sets bits
+ * of the bloom-filter, if any.
+ * Rows with all-null keys never match, so they are not linked unless the
+ * depth is RIGHT/FULL OUTER JOIN.
+ */
+KERNEL_FUNCTION(void)
+gpujoin_build_hash_table(kern_multirels *kmrels,
+						 cl_int depth,
+						 kern_parambuf *kparams,
+						 kern_errorbuf *kerror)
+{
+	kern_data_store *kds_hash = KERN_MULTIRELS_INNER_KDS(kmrels, depth);
+	cl_uint	   *row_index = KERN_DATA_STORE_ROWINDEX(kds_hash);
+	cl_uint	   *hash_slot = KERN_DATA_STORE_HASHSLOT(kds_hash);
+	cl_uint	   *bloom = KERN_MULTIRELS_BLOOM_FILTER(kmrels, depth);
+	cl_uint		nblocks = kmrels->chunks[depth-1].bloom_nblocks;
+	cl_uint	   *buckets = KERN_MULTIRELS_HASH_BUCKET(kmrels, depth);
+	cl_uint		nbuckets = kmrels->chunks[depth-1].bucket_nbuckets;
+	cl_bool		right_outer = KERN_MULTIRELS_RIGHT_OUTER_JOIN(kmrels, depth);
+	cl_uint		index;
+	DECL_KERNEL_CONTEXT(u);
+
+	assert(kds_hash->format == KDS_FORMAT_HASH);
+	assert(depth >= 1 && depth <= kmrels->nrels);
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	for (index = get_global_id();
+		 index < kds_hash->nitems;
+		 index += get_global_size())
+	{
+		kern_tupitem   *tupitem = (kern_tupitem *)
+			((char *)kds_hash + __kds_unpack(row_index[index]));
+		kern_hashitem  *khitem = (kern_hashitem *)
+			((char *)tupitem - offsetof(kern_hashitem, t));
+		cl_char		   *vlpos_saved = u.kcxt.vlpos;
+		cl_bool			is_null_keys;
+		cl_uint			hash, self, i;
+
+		hash = gpujoin_inner_hash_value(&u.kcxt, kmrels, depth,
+										&tupitem->htup,
+										&is_null_keys);
+		u.kcxt.vlpos = vlpos_saved;
+		khitem->hash = hash;
+		khitem->next = 0;
+		if (is_null_keys && !right_outer)
+			continue;
+
+		self = __kds_packed((char *)khitem - (char *)kds_hash);
+		khitem->next = atomicExch(&hash_slot[hash % kds_hash->nslots], self);
+		if (buckets)
+		{
+			cl_uint		nentries = nbuckets * GPUJOIN_HASH_BUCKET_NITEMS;
+			cl_uint		entry = (hash % nbuckets) * GPUJOIN_HASH_BUCKET_NITEMS;
+
+			while (atomicCAS(gpujoin_hash_bucket_offset(buckets, entry),
+							 0, self) != 0)
+				entry = (entry + 1) % nentries;
+			*gpujoin_hash_bucket_hash(buckets, entry) = hash;
+		}
+		if (bloom)
+		{
+			cl_uint	   *block;
+			cl_uint		mask[GPUJOIN_BLOOM_BLOCK_NWORDS];
+
+			block = gpujoin_bloom_filter_block(bloom, nblocks, hash, mask);
+			for (i=0; i < GPUJOIN_BLOOM_BLOCK_NWORDS; i++)
+			{
+				if ((block[i] & mask[i]) != mask[i])
+					atomicOr(&block[i], mask[i]);
+			}
+		}
+	}
+	kern_writeback_error_status(kerror, &u.kcxt);
+}
+
 /*
  * gpujoin_gist_getnext
  */
@@ -1665,6 +2247,7 @@ gpujoin_main(kern_context *kcxt,
 		memset(gist_pos, 0, sizeof(cl_uint) * (max_depth+1) * MAXWARPS_PER_BLOCK);
 		scan_done = false;
 		base_depth = 0;
+		fused_slot_index = UINT_MAX;
 	}
 	/* resume the per-depth context, if any */
 	if (kgjoin->resume_context)
@@ -1683,6 +2266,7 @@ gpujoin_main(kern_context *kcxt,
 			/* LOAD FROM KDS_SRC (ROW/BLOCK/ARROW) */
 			depth = gpujoin_load_source(kcxt,
 										kgjoin,
+										kmrels,
 										kds_src,
 										kds_extra,
 										PSTACK_DEPTH(depth),
@@ -1719,6 +2303,20 @@ gpujoin_main(kern_context *kcxt,
 												matched);
 			}
 		}
+		else if (kmrels->chunks[depth-1].merge_offset != 0)
+		{
+			/* MERGE-JOIN */
+			depth = gpujoin_exec_mergejoin(kcxt,
+										   kgjoin,
+										   kmrels,
+										   kds_src,
+										   kds_extra,
+										   depth,
+										   PSTACK_DEPTH(depth-1),
+										   PSTACK_DEPTH(depth),
+										   l_state,
+										   matched);
+		}
 		else if (kmrels->chunks[depth-1].is_nestloop)
 		{
 			/* NEST-LOOP */
@@ -1856,6 +2454,7 @@ gpujoin_right_outer(kern_context *kcxt,
 		memset(gist_pos, 0, sizeof(cl_uint) * (max_depth+1) * MAXWARPS_PER_BLOCK);
 		scan_done = false;
 		base_depth = outer_depth;
+		fused_slot_index = UINT_MAX;
 	}
 	/* resume the per-depth context, if any */
 	if (kgjoin->resume_context)
@@ -1910,6 +2509,20 @@ gpujoin_right_outer(kern_context *kcxt,
 												matched);
 			}
 		}
+		else if (kmrels->chunks[depth-1].merge_offset != 0)
+		{
+			/* MERGE-JOIN */
+			depth = gpujoin_exec_mergejoin(kcxt,
+										   kgjoin,
+										   kmrels,
+										   NULL,
+										   NULL,
+										   depth,
+										   PSTACK_DEPTH(depth-1),
+										   PSTACK_DEPTH(depth),
+										   l_state,
+										   matched);
+		}
 		else if (kmrels->chunks[depth-1].is_nestloop)
 		{
 			/* NEST-LOOP */
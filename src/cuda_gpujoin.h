@@ -33,10 +33,20 @@ typedef struct
 		cl_ulong	chunk_offset;	/* offset to KDS or Hash */
 		cl_ulong	ojmap_offset;	/* offset to outer-join map, if any */
 		cl_ulong	gist_offset;	/* offset to GiST-index pages, if any */
+		cl_ulong	bloom_offset;	/* offset to bloom-filter, if any */
+		cl_ulong	bucket_offset;	/* offset to hash-bucket index, if any */
+		cl_ulong	merge_offset;	/* offset to sorted index, if merge-join */
+		cl_ulong	column_offset;	/* offset to inner columns, if any */
+		cl_uint		bloom_nblocks;	/* number of bloom-filter blocks */
+		cl_uint		bucket_nbuckets; /* number of hash-buckets */
 		cl_bool		is_nestloop;	/* true, if NestLoop. */
 		cl_bool		left_outer;		/* true, if JOIN_LEFT or JOIN_FULL */
 		cl_bool		right_outer;	/* true, if JOIN_RIGHT or JOIN_FULL */
-		cl_char		__padding__[5];
+		cl_bool		semi_join;		/* true, if JOIN_SEMI */
+		cl_bool		anti_join;		/* true, if JOIN_ANTI */
+		cl_bool		device_hash_build; /* true, if hash-table is not built
+										* on the host side yet */
+		cl_char		__padding__[2];
 	} chunks[FLEXIBLE_ARRAY_MEMBER];
 } kern_multirels;
 
@@ -57,12 +67,173 @@ typedef struct
 	  ? NULL															\
 	  : (char *)(kmrels) + (kmrels)->chunks[(depth)-1].gist_offset))
 
+#define KERN_MULTIRELS_BLOOM_FILTER(kmrels, depth)						\
+	((cl_uint *)														\
+	 ((kmrels)->chunks[(depth)-1].bloom_offset == 0						\
+	  ? NULL															\
+	  : (char *)(kmrels) + (kmrels)->chunks[(depth)-1].bloom_offset))
+
+#define KERN_MULTIRELS_HASH_BUCKET(kmrels, depth)						\
+	((cl_uint *)														\
+	 ((kmrels)->chunks[(depth)-1].bucket_offset == 0					\
+	  ? NULL															\
+	  : (char *)(kmrels) + (kmrels)->chunks[(depth)-1].bucket_offset))
+
+#define KERN_MULTIRELS_MERGE_INDEX(kmrels, depth)						\
+	((cl_uint *)														\
+	 ((kmrels)->chunks[(depth)-1].merge_offset == 0						\
+	  ? NULL															\
+	  : (char *)(kmrels) + (kmrels)->chunks[(depth)-1].merge_offset))
+
+#define KERN_MULTIRELS_INNER_COLUMNS(kmrels, depth)					\
+	((kern_inner_columns *)												\
+	 ((kmrels)->chunks[(depth)-1].column_offset == 0					\
+	  ? NULL															\
+	  : (char *)(kmrels) + (kmrels)->chunks[(depth)-1].column_offset))
+
 #define KERN_MULTIRELS_LEFT_OUTER_JOIN(kmrels, depth)	\
 	((kmrels)->chunks[(depth)-1].left_outer)
 
 #define KERN_MULTIRELS_RIGHT_OUTER_JOIN(kmrels, depth)	\
 	((kmrels)->chunks[(depth)-1].right_outer)
 
+#define KERN_MULTIRELS_SEMI_JOIN(kmrels, depth)		\
+	((kmrels)->chunks[(depth)-1].semi_join)
+
+#define KERN_MULTIRELS_ANTI_JOIN(kmrels, depth)		\
+	((kmrels)->chunks[(depth)-1].anti_join)
+
+/*
+ * Columnar copy of the inner attributes
+ *
+ * GpuNestLoop and GiST-join evaluate the join quals for each pair of outer
+ * and inner rows, so the fixed-length inner attributes referenced by the
+ * quals are deformed once on the host, and kept in the columnar format
+ * indexed by the rowid of kern_tupitem. Rows in the inner KDS are still
+ * used for projection. values_offset == 0 means the column is not loaded.
+ */
+typedef struct
+{
+	cl_uint			nrooms;
+	cl_uint			ncols;
+	struct {
+		cl_int		attlen;
+		cl_uint		__padding__;
+		cl_ulong	values_offset;	/* offset from the head */
+		cl_ulong	nullmap_offset;	/* offset from the head, 1 = not null */
+	} colattrs[FLEXIBLE_ARRAY_MEMBER];
+} kern_inner_columns;
+
+/*
+ * Blocked bloom-filter of the hash-join keys
+ *
+ * Bloom-filter consists of 256bits blocks; a hash value chooses one block,
+ * then sets/tests one bit for each 32bit word in the block. So, a probe
+ * touches only one cache line.
+ */
+#define GPUJOIN_BLOOM_BLOCK_NWORDS		8
+#define GPUJOIN_BLOOM_BLOCK_SIZE		\
+	(sizeof(cl_uint) * GPUJOIN_BLOOM_BLOCK_NWORDS)
+
+STATIC_INLINE(cl_uint *)
+gpujoin_bloom_filter_block(cl_uint *bloom, cl_uint nblocks, cl_uint hash,
+						   cl_uint *mask)
+{
+	const cl_uint	salts[GPUJOIN_BLOOM_BLOCK_NWORDS] = {
+		0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+		0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+	};
+	cl_uint		blkno = (cl_uint)(((cl_ulong)hash *
+								   (cl_ulong)nblocks) >> 32);
+	cl_uint		i;
+
+	for (i=0; i < GPUJOIN_BLOOM_BLOCK_NWORDS; i++)
+		mask[i] = (1U << ((hash * salts[i]) >> 27));
+	return bloom + blkno * GPUJOIN_BLOOM_BLOCK_NWORDS;
+}
+
+STATIC_INLINE(cl_bool)
+gpujoin_bloom_filter_test(kern_multirels *kmrels, cl_int depth, cl_uint hash)
+{
+	cl_uint	   *bloom = KERN_MULTIRELS_BLOOM_FILTER(kmrels, depth);
+	cl_uint	   *block;
+	cl_uint		mask[GPUJOIN_BLOOM_BLOCK_NWORDS];
+	cl_uint		i;
+
+	if (!bloom)
+		return true;
+	block = gpujoin_bloom_filter_block(bloom,
+									   kmrels->chunks[depth-1].bloom_nblocks,
+									   hash, mask);
+	for (i=0; i < GPUJOIN_BLOOM_BLOCK_NWORDS; i++)
+	{
+		if ((block[i] & mask[i]) == 0)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Bucketized index of the hash-table
+ *
+ * Each 128 bytes bucket packs the hash values of 16 entries, followed by
+ * the offsets of the kern_hashitem; 0 means an empty entry. Entries are
+ * inserted to the first empty one from the head of the bucket chosen by
+ * the hash value (linear probing over the bucket boundary), so a probe
+ * usually touches only one cache line, and dereferences the kern_hashitem
+ * only if hash value is identical.
+ * It is built in addition to the hash-slot chain, which is still used by
+ * the CPU fallback and the GiST-index lookup.
+ */
+#define GPUJOIN_HASH_BUCKET_NITEMS		16
+#define GPUJOIN_HASH_BUCKET_SIZE		\
+	(2 * sizeof(cl_uint) * GPUJOIN_HASH_BUCKET_NITEMS)
+/* 75% load factor at most; at least one entry is always empty */
+#define GPUJOIN_HASH_BUCKET_NBUCKETS(nrooms)	((nrooms) / 12 + 1)
+
+STATIC_INLINE(cl_uint *)
+gpujoin_hash_bucket_hash(cl_uint *buckets, cl_uint entry)
+{
+	return (buckets +
+			2 * GPUJOIN_HASH_BUCKET_NITEMS * (entry / GPUJOIN_HASH_BUCKET_NITEMS) +
+			(entry % GPUJOIN_HASH_BUCKET_NITEMS));
+}
+
+STATIC_INLINE(cl_uint *)
+gpujoin_hash_bucket_offset(cl_uint *buckets, cl_uint entry)
+{
+	return gpujoin_hash_bucket_hash(buckets, entry) + GPUJOIN_HASH_BUCKET_NITEMS;
+}
+
+/*
+ * gpujoin_hash_bucket_lookup
+ *
+ * It walks on the entries from *p_entry, and returns the kern_hashitem
+ * with identical hash value, or NULL if it reached an empty entry.
+ * *p_entry points the entry of the returned item.
+ */
+STATIC_INLINE(kern_hashitem *)
+gpujoin_hash_bucket_lookup(kern_data_store *kds_hash,
+						   cl_uint *buckets, cl_uint nbuckets,
+						   cl_uint hash, cl_uint *p_entry)
+{
+	cl_uint		nentries = nbuckets * GPUJOIN_HASH_BUCKET_NITEMS;
+	cl_uint		entry = *p_entry;
+	cl_uint		offset;
+
+	for (;;)
+	{
+		offset = *gpujoin_hash_bucket_offset(buckets, entry);
+		if (offset == 0)
+			return NULL;
+		if (*gpujoin_hash_bucket_hash(buckets, entry) == hash)
+			break;
+		entry = (entry + 1) % nentries;
+	}
+	*p_entry = entry;
+	return (kern_hashitem *)((char *)kds_hash + __kds_unpack(offset));
+}
+
 /*
  * kern_gpujoin - control object of GpuJoin
  *
@@ -111,6 +282,14 @@ struct kern_gpujoin
 	cl_uint			suspend_count;		/* number of suspended blocks */
 	cl_bool			resume_context;		/* resume context from suspend */
 	cl_uint			src_read_pos;		/* position to read from kds_src */
+	/* range of the inner rows to be emitted by RIGHT/FULL OUTER JOIN */
+	cl_uint			outer_row_base;		/* in: first inner row to read */
+	cl_uint			outer_row_end;		/* in: end of the inner rows */
+	/* runtime join order */
+	cl_bool			depth_reordered;	/* true, if stat[].depth is valid */
+	/* fused GpuPreAgg reduction */
+	cl_bool			fused_nogroup;		/* in: true, if projection_slot reduces
+										 * rows for GpuPreAgg w/o group keys */
 	/* debug counters */
 	cl_ulong		debug_counter0;
 	cl_ulong		debug_counter1;
@@ -120,6 +299,7 @@ struct kern_gpujoin
 	cl_uint			source_nitems;		/* out: # of source rows */
 	cl_uint			outer_nitems;		/* out: # of filtered source rows */
 	struct {
+		cl_uint		depth;		/* in: physical depth to run at this step */
 		cl_uint		nitems;
 		cl_uint		nitems2;
 	}				stat[FLEXIBLE_ARRAY_MEMBER];	/* out: stat per depth */
@@ -129,6 +309,15 @@ struct kern_gpujoin
 };
 typedef struct kern_gpujoin		kern_gpujoin;
 
+/*
+ * KERN_GPUJOIN_PHYSICAL_DEPTH - the inner relation (depth of the planned
+ * order; that is index of kmrels->chunks[] and the generated code) to be
+ * joined at the @depth of the pseudo-stack.
+ */
+#define KERN_GPUJOIN_PHYSICAL_DEPTH(kgjoin, depth)				\
+	((kgjoin)->depth_reordered									\
+	 ? (cl_int)(kgjoin)->stat[(depth)-1].depth : (cl_int)(depth))
+
 #ifndef __CUDACC__
 /*
  * gpujoin_reset_kernel_task - reset kern_gpujoin status prior to resume
@@ -202,6 +391,37 @@ typedef struct gpujoinSuspendContext	gpujoinSuspendContext;
 	(!(htup) ? NULL : kern_get_datum_tuple((colmeta),(htup),(colidx)))
 
 #ifdef __CUDACC__
+/*
+ * gpujoin_inner_datum - reference to the inner attribute at the current
+ * depth; columnar copy is preferable if any, instead of the heap tuple.
+ */
+STATIC_INLINE(void *)
+gpujoin_inner_datum(kern_multirels *kmrels, cl_int depth,
+					kern_data_store *kds_in,
+					HeapTupleHeaderData *i_htup, cl_uint colidx)
+{
+	kern_inner_columns *icols = KERN_MULTIRELS_INNER_COLUMNS(kmrels, depth);
+
+	if (!i_htup)
+		return NULL;
+	if (icols && colidx < icols->ncols &&
+		icols->colattrs[colidx].values_offset != 0)
+	{
+		kern_tupitem *titem = (kern_tupitem *)
+			((char *)i_htup - offsetof(kern_tupitem, htup));
+		cl_uint		rowid = titem->rowid;
+		cl_uint	   *nullmap = (cl_uint *)
+			((char *)icols + icols->colattrs[colidx].nullmap_offset);
+
+		assert(rowid < icols->nrooms);
+		if ((nullmap[rowid >> 5] & (1U << (rowid & 0x1f))) == 0)
+			return NULL;
+		return ((char *)icols + icols->colattrs[colidx].values_offset +
+				(size_t)icols->colattrs[colidx].attlen * (size_t)rowid);
+	}
+	return kern_get_datum_tuple(kds_in->colmeta, i_htup, colidx);
+}
+
 /*
  * gpujoin_quals_eval(_arrow)
  */
@@ -253,6 +473,36 @@ gpujoin_hash_value(kern_context *kcxt,
 				   cl_uint *x_buffer,
 				   cl_bool *is_null_keys);
 
+/*
+ * gpujoin_inner_hash_value
+ *
+ * Calculation of hash value of the inner row, to build the hash-table
+ * on the device side.
+ */
+DEVICE_FUNCTION(cl_uint)
+gpujoin_inner_hash_value(kern_context *kcxt,
+						 kern_multirels *kmrels,
+						 cl_int depth,
+						 HeapTupleHeaderData *i_htup,
+						 cl_bool *is_null_keys);
+
+/*
+ * gpujoin_merge_keycomp
+ *
+ * Comparison of the join keys between the outer row and the inner row,
+ * if this depth uses merge-join logic. NULL inner keys are larger than
+ * any other values, as the sorted index of the inner rows is built.
+ */
+DEVICE_FUNCTION(cl_int)
+gpujoin_merge_keycomp(kern_context *kcxt,
+					  kern_data_store *kds,
+					  kern_data_extra *extra,
+					  kern_multirels *kmrels,
+					  cl_int depth,
+					  cl_uint *x_buffer,
+					  HeapTupleHeaderData *i_htup,
+					  cl_bool *is_null_keys);
+
 /*
  * gpujoin_gist_load_keys
  *
@@ -390,6 +640,29 @@ kern_gpujoin_right_outer(kern_gpujoin *kgjoin,
 	kern_writeback_error_status(&kgjoin->kerror, &u.kcxt);
 }
 
+/*
+ * kern_gpujoin_merge_outer_join_map
+ *
+ * It merges the outer-join-map of the peer device (or the one colocated on
+ * the host) to the local one, for the range of inner rows to be emitted.
+ * It only sets true, so concurrent updates by others are never lost.
+ */
+KERNEL_FUNCTION(void)
+kern_gpujoin_merge_outer_join_map(cl_bool *ojmap_dst,
+								  const cl_bool *ojmap_src,
+								  cl_uint nitems)
+{
+	cl_uint		index;
+
+	for (index = get_global_id();
+		 index < nitems;
+		 index += get_global_size())
+	{
+		if (ojmap_src[index])
+			ojmap_dst[index] = true;
+	}
+}
+
 #ifndef GPUPREAGG_COMBINED_JOIN
 DEVICE_FUNCTION(void)
 gpupreagg_projection_slot(kern_context *kcxt_gpreagg,
@@ -401,6 +674,17 @@ gpupreagg_projection_slot(kern_context *kcxt_gpreagg,
 	/* should never be called */
 	assert(false);
 }
+
+DEVICE_FUNCTION(void)
+gpupreagg_nogroup_calc(cl_int attnum,
+					   cl_char *p_accum_dclass,
+					   Datum   *p_accum_datum,
+					   cl_char  newval_dclass,
+					   Datum    newval_datum)
+{
+	/* should never be called */
+	assert(false);
+}
 #endif	/* !GPUPREAGG_COMBINED_JOIN */
 #endif	/* __CUDACC_RTC__ */
 #endif	/* CUDA_GPUJOIN_H */
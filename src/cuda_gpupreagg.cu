@@ -23,30 +23,38 @@
 /*
  * gpupreagg_final_data_move
  *
- * It moves the value from source buffer to destination buffer. If it needs
- * to allocate variable-length buffer, it expands extra area of the final
- * buffer and returns allocated area.
+ * It moves the value from source buffer to a new row of the destination
+ * buffer. If it needs to allocate variable-length buffer, it expands extra
+ * area of the final buffer and returns allocated area.
+ * The new row and the extra area are allocated at once, so it consumes
+ * nothing and returns -1, if the final buffer has no space any more.
  */
 STATIC_FUNCTION(cl_int)
 gpupreagg_final_data_move(kern_context *kcxt,
 						  kern_data_store *kds_src, cl_uint rowidx_src,
-						  kern_data_store *kds_dst, cl_uint rowidx_dst)
+						  kern_data_store *kds_dst, cl_uint *p_rowidx_dst)
 {
 	Datum	   *src_values = KERN_DATA_STORE_VALUES(kds_src, rowidx_src);
-	Datum	   *dst_values = KERN_DATA_STORE_VALUES(kds_dst, rowidx_dst);
 	cl_char	   *src_dclass = KERN_DATA_STORE_DCLASS(kds_src, rowidx_src);
-	cl_char	   *dst_dclass = KERN_DATA_STORE_DCLASS(kds_dst, rowidx_dst);
+	Datum	   *dst_values;
+	cl_char	   *dst_dclass;
 	cl_uint		i, ncols = kds_src->ncols;
 	cl_int		alloc_size = 0;
 	char	   *curr = NULL;
 	int			len;
+	union {
+		struct {
+			cl_uint	nitems;
+			cl_uint	usage;
+		} i;
+		cl_ulong	v64;
+	} oldval, curval, newval;
 
 	/* Paranoire checks? */
 	assert(kds_src->format == KDS_FORMAT_SLOT &&
 		   kds_dst->format == KDS_FORMAT_SLOT);
 	assert(kds_src->ncols == kds_dst->ncols);
 	assert(rowidx_src < kds_src->nitems);
-	assert(rowidx_dst < kds_dst->nitems);
 
 	/* size for allocation */
 	for (i=0; i < ncols; i++)
@@ -89,34 +97,31 @@ gpupreagg_final_data_move(kern_context *kcxt,
 			alloc_size += MAXALIGN(len);
 		}
 	}
-	/* allocate extra buffer by atomic operation */
-	if (alloc_size > 0)
-	{
-		size_t		usage_prev;
-		size_t		usage_slot;
-
-		usage_slot = KERN_DATA_STORE_SLOT_LENGTH(kds_dst, rowidx_dst + 1);
-		usage_prev = __kds_unpack(atomicAdd(&kds_dst->usage,
-											__kds_packed(alloc_size)));
-		if (usage_slot + usage_prev + alloc_size >= kds_dst->length)
+	/* allocate a new row and extra buffer by atomic operation */
+	curval.i.nitems = kds_dst->nitems;
+	curval.i.usage  = kds_dst->usage;
+	do {
+		newval = oldval = curval;
+		newval.i.nitems += 1;
+		newval.i.usage  += __kds_packed(alloc_size);
+		if (newval.i.nitems > kds_dst->nrooms ||
+			KERN_DATA_STORE_SLOT_LENGTH(kds_dst, newval.i.nitems) +
+			__kds_unpack(newval.i.usage) >= kds_dst->length)
 		{
 			STROM_EREPORT(kcxt, ERRCODE_STROM_DATASTORE_NOSPACE,
 						  "kds_final has no more space");
-			/*
-			 * NOTE: Uninitialized dst_values[] for NULL values will lead
-			 * a problem around atomic operation, because we designed 
-			 * reduction operation that assumes values are correctly
-			 * initialized even if it is NULL.
-			 */
-			for (i=0; i < ncols; i++)
-			{
-				dst_dclass[i] = DATUM_CLASS__NULL;
-				dst_values[i] = src_values[i];
-			}
 			return -1;
 		}
-		curr = ((char *)kds_dst + kds_dst->length - (usage_prev + alloc_size));
-	}
+	} while ((curval.v64 = atomicCAS((cl_ulong *)&kds_dst->nitems,
+									 oldval.v64,
+									 newval.v64)) != oldval.v64);
+	*p_rowidx_dst = oldval.i.nitems;
+	dst_values = KERN_DATA_STORE_VALUES(kds_dst, oldval.i.nitems);
+	dst_dclass = KERN_DATA_STORE_DCLASS(kds_dst, oldval.i.nitems);
+	if (alloc_size > 0)
+		curr = ((char *)kds_dst + kds_dst->length -
+				__kds_unpack(newval.i.usage));
+
 	/* move the data */
 	for (i=0; i < ncols; i++)
 	{
@@ -532,7 +537,11 @@ gpupreagg_setup_block(kern_context *kcxt,
 				{
 					curr_lpp = PageGetItemId(pg_page, line_no + 1);
 					if (ItemIdIsNormal(curr_lpp))
+					{
 						htup = PageGetItem(pg_page, curr_lpp);
+						if (!kern_check_visibility_heap(kcxt, pg_page, htup))
+							htup = NULL;
+					}
 				}
 			}
 			else
@@ -1217,7 +1226,9 @@ gpupreagg_final_reduction(kern_context *kcxt,
 	pagg_hashslot	old_slot;
 	pagg_hashslot	new_slot;
 	pagg_hashslot	cur_slot;
+	cl_char		   *row_inval_map;
 
+	row_inval_map = KERN_GPUPREAGG_ROW_INVALIDATION_MAP(kgpreagg);
 	new_slot.s.hash	 = hash_value;
 	new_slot.s.index = (cl_uint)(0xfffffffeU);	/* LOCK */
 	old_slot.s.hash  = 0;
@@ -1241,6 +1252,8 @@ retry_fnext:
 							   old_slot.value, new_slot.value);
 	if (cur_slot.value == old_slot.value)
 	{
+		cl_int		len;
+
 		atomicAdd(&f_hash->hash_usage, 1);
 
 		/*
@@ -1252,33 +1265,36 @@ retry_fnext:
 		 * can store at least 'nrooms' items. So, right now, we don't
 		 * allow to expand extra area across nrooms boundary.
 		 */
-		new_slot.s.index = atomicAdd(&kds_final->nitems, 1);
-		if (new_slot.s.index < kds_final->nrooms)
+		len = gpupreagg_final_data_move(kcxt,
+										kds_slot,
+										slot_index,
+										kds_final,
+										&new_slot.s.index);
+		if (len < 0)
 		{
-			cl_int	len = gpupreagg_final_data_move(kcxt,
-													kds_slot,
-													slot_index,
-													kds_final,
-													new_slot.s.index);
-			if (len < 0)
-				new_slot.s.index = (cl_uint)(0xffffffffU);	/* EMPTY */
-			else
-				allocated += len;
+			/*
+			 * kds_final has no space any more, so we release the hash-slot
+			 * as if nobody took it. This row is not merged, thus, it shall
+			 * be retried on the next final buffer once the host side spills
+			 * out the current one.
+			 */
+			new_slot.s.hash  = 0;
+			new_slot.s.index = (cl_uint)(0xffffffffU);	/* EMPTY */
+			atomicSub(&f_hash->hash_usage, 1);
 		}
 		else
 		{
-			new_slot.s.index = (cl_uint)(0xffffffffU);
-			STROM_EREPORT(kcxt, ERRCODE_STROM_DATASTORE_NOSPACE,
-						  "kds_final has no more space");
+			allocated += len;
+			row_inval_map[slot_index] = true;
+			/* this thread performs as owner of this slot */
+			is_owner = true;
 		}
 		__threadfence();
 		/* UNLOCK */
 		old_slot.value = atomicExch(&f_hash->hash_slot[index].value,
 									new_slot.value);
-		assert(old_slot.s.hash == new_slot.s.hash &&
+		assert(old_slot.s.hash == hash_value &&
 			   old_slot.s.index == (cl_uint)(0xfffffffeU));
-		/* this thread performs as owner of this slot */
-		is_owner = true;
 	}
 	else if (cur_slot.s.hash != hash_value)
 	{
@@ -1342,6 +1358,13 @@ retry_fnext:
 			KERN_DATA_STORE_VALUES(kds_final, cur_slot.s.index),
 			KERN_DATA_STORE_DCLASS(kds_slot, slot_index),
 			KERN_DATA_STORE_VALUES(kds_slot, slot_index));
+		/*
+		 * Mark this row is invalid because its values are already
+		 * accumulated to the final buffer. Rows not marked are merged
+		 * again after spill-out of the final buffer, or processed by
+		 * the CPU fallback routine.
+		 */
+		row_inval_map[slot_index] = true;
 	}
 
 	/*
@@ -1357,6 +1380,158 @@ retry_fnext:
 	return !meet_locked;
 }
 
+/*
+ * gpupreagg_warp_local_calc
+ *
+ * It pre-aggregates the values of threads in a warp that update the same
+ * local slot (@peer_key), prior to the atomic operations on the shared
+ * memory, because atomic operations on the same address are serialized.
+ * It makes a significant difference when a few grouping-keys hold most of
+ * rows. Threads with UINT_MAX of @peer_key do not participate.
+ * Only the first thread of the peers returns true with the combined value.
+ */
+STATIC_FUNCTION(cl_bool)
+gpupreagg_warp_local_calc(cl_int attnum,
+						  cl_uint peer_key,
+						  cl_char *p_dclass,
+						  Datum *p_datum)
+{
+	cl_uint		mask = __activemask();
+	cl_uint		lane_id = (get_local_id() & (warpSize - 1));
+	cl_uint		peers;
+	cl_uint		rank;
+	cl_uint		dist;
+
+#if __CUDA_ARCH__ >= 700
+	peers = __match_any_sync(mask, peer_key);
+#else
+	{
+		cl_uint		remain = mask;
+		cl_uint		curr_key;
+		cl_uint		bitmap;
+
+		do {
+			curr_key = __shfl_sync(mask, peer_key, __ffs(remain) - 1);
+			bitmap = __ballot_sync(mask, peer_key == curr_key);
+			if (peer_key == curr_key)
+				peers = bitmap;
+			remain &= ~bitmap;
+		} while (remain != 0);
+	}
+#endif
+	/* quick bailout if no duplicated keys in this warp */
+	if (__all_sync(mask, __popc(peers) == 1 || peer_key == UINT_MAX))
+		return (peer_key != UINT_MAX);
+
+	rank = __popc(peers & ((1U << lane_id) - 1));
+	for (dist=1; dist < warpSize; dist *= 2)
+	{
+		cl_uint		buddy = __fns(peers, lane_id, dist + 1);
+		cl_int		buddy_dclass;
+		Datum		buddy_datum;
+
+		if (buddy >= warpSize)
+			buddy = lane_id;
+		buddy_dclass = __shfl_sync(mask, (cl_int)*p_dclass, buddy);
+		buddy_datum  = __shfl_sync(mask, *p_datum, buddy);
+		if (peer_key != UINT_MAX &&
+			buddy != lane_id &&
+			(rank & (2 * dist - 1)) == 0)
+		{
+			gpupreagg_nogroup_calc(attnum,
+								   p_dclass,
+								   p_datum,
+								   (cl_char)buddy_dclass,
+								   buddy_datum);
+		}
+	}
+	return (peer_key != UINT_MAX && rank == 0);
+}
+
+/*
+ * gpupreagg_groupby_direct_reduction
+ *
+ * It merges every row on the kds_slot to the final buffer without local
+ * reduction on the shared memory. Host code chooses this mode when most of
+ * rows have individual grouping-keys, thus local reduction makes no sense.
+ */
+STATIC_FUNCTION(void)
+gpupreagg_groupby_direct_reduction(kern_context *kcxt,
+								   kern_gpupreagg *kgpreagg,
+								   kern_data_store *kds_slot,
+								   kern_data_store *kds_final,
+								   kern_global_hashslot *f_hash)
+{
+	cl_uint			kds_index;
+	cl_uint			hash_value;
+	cl_uint			nvalids;
+	cl_bool			reduction_done;
+	cl_bool			lock_wait;
+	cl_char		   *row_inval_map;
+	__shared__ cl_uint base;
+
+	row_inval_map = KERN_GPUPREAGG_ROW_INVALIDATION_MAP(kgpreagg);
+	for (;;)
+	{
+		/* fetch next items from the kds_slot */
+		if (get_local_id() == 0)
+			base = atomicAdd(&kgpreagg->read_slot_pos, get_local_size());
+		__syncthreads();
+		if (base >= kds_slot->nitems)
+			break;
+		nvalids = Min(kds_slot->nitems - base, get_local_size());
+
+		kds_index = base + get_local_id();
+		/* rows already merged are skipped on the retry after spill-out */
+		if (kds_index < kds_slot->nitems && !row_inval_map[kds_index])
+		{
+			hash_value = gpupreagg_hashvalue(kcxt,
+								KERN_DATA_STORE_DCLASS(kds_slot, kds_index),
+								KERN_DATA_STORE_VALUES(kds_slot, kds_index));
+			reduction_done = false;
+		}
+		else
+			reduction_done = true;
+		/* error checks */
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			return;
+
+		do {
+			/* see the comment in gpupreagg_groupby_reduction */
+			if (!gpupreagg_expand_final_hash(kcxt, f_hash, nvalids))
+			{
+				lock_wait = true;
+				/* quick bailout on error */
+				if (__syncthreads_count(kcxt->errcode) > 0)
+					return;
+				continue;
+			}
+			if (reduction_done)
+				lock_wait = false;
+			else if (gpupreagg_final_reduction(kcxt,
+											   kgpreagg,
+											   kds_slot,
+											   kds_index,
+											   hash_value,
+											   kds_final,
+											   f_hash))
+			{
+				reduction_done = true;
+				lock_wait = false;
+			}
+			else
+				lock_wait = true;
+			__syncthreads();
+			/* release shared lock of the final hash-slot */
+			if (get_local_id() == 0)
+				atomicSub(&f_hash->lock, 2);
+			/* quick bailout on error */
+			if (__syncthreads_count(kcxt->errcode) > 0)
+				return;
+		} while (__syncthreads_count(lock_wait) > 0);
+	}
+}
+
 /*
  * gpupreagg_group_reduction
  */
@@ -1375,9 +1550,13 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 	cl_uint			buf_index;
 	cl_uint			hash_index;
 	cl_uint			hash_value;
+	cl_uint			peer_key;
+	cl_char			new_dclass;
+	Datum			new_datum;
 	cl_bool			is_leader;
 	cl_bool			is_last_reduction = false;
 	cl_bool			l_hashslot_cleanup = true;
+	cl_bool			row_is_valid;
 	cl_char		   *row_inval_map;
 #define GROUPBY_LOCAL_HASHSIZE	2400
 #define GROUPBY_LOCAL_BUFSIZE	1800
@@ -1403,6 +1582,16 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 	if (get_global_id() == 0)
 		kgpreagg->setup_slot_done = true;
 
+	if (!kgpreagg->local_reduction)
+	{
+		gpupreagg_groupby_direct_reduction(kcxt,
+										   kgpreagg,
+										   kds_slot,
+										   kds_final,
+										   f_hash);
+		return;
+	}
+
 	do {
 		cl_bool	   *slot_dclass = NULL;
 		Datum	   *slot_values = NULL;
@@ -1436,7 +1625,13 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 		 * Lookup local hash-slot, or create a new one if not exists
 		 */
 		kds_index = base + get_local_id();
-		if (kds_index < kds_slot->nitems)
+		/*
+		 * Rows already merged to the final buffer are skipped, if this
+		 * reduction is retried after spill-out of the final buffer.
+		 */
+		row_is_valid = (kds_index < kds_slot->nitems &&
+						!row_inval_map[kds_index]);
+		if (row_is_valid)
 		{
 			slot_dclass = KERN_DATA_STORE_DCLASS(kds_slot, kds_index);
 			slot_values = KERN_DATA_STORE_VALUES(kds_slot, kds_index);
@@ -1448,7 +1643,7 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 		if (__syncthreads_count(kcxt->errcode) > 0)
 			return;
 
-		if (kds_index < kds_slot->nitems)
+		if (row_is_valid)
 		{
 			pagg_hashslot	old_slot;
 			pagg_hashslot	new_slot;
@@ -1548,15 +1743,31 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 			}
 			__syncthreads();
 
-			/* reduction by atomic operation */
+			/*
+			 * reduction by atomic operation, after the warp-level
+			 * pre-aggregation of the threads on the same slot
+			 */
 			if (kds_index < kds_slot->nitems && slot_values != dest_values)
 			{
 				assert(buf_index < GROUPBY_LOCAL_BUFSIZE);
+				peer_key  = buf_index;
+				new_dclass = slot_dclass[j];
+				new_datum  = slot_values[j];
+			}
+			else
+			{
+				peer_key  = UINT_MAX;
+				new_dclass = DATUM_CLASS__NULL;
+				new_datum  = 0;
+			}
+			if (gpupreagg_warp_local_calc(j, peer_key,
+										  &new_dclass, &new_datum))
+			{
 				gpupreagg_local_calc(j,
 									 &l_dclass[buf_index],
 									 &l_values[buf_index],
-									 slot_dclass[j],
-									 slot_values[j]);
+									 new_dclass,
+									 new_datum);
 			}
 			__syncthreads();
 
@@ -1589,6 +1800,8 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 			cl_uint		loop;
 			cl_uint		nvalids;
 
+			if (get_local_id() == 0)
+				atomicAdd(&kgpreagg->local_groups, l_nitems);
 			nloops = (l_nitems + get_local_size() - 1) / get_local_size();
 			for (loop=0; loop < nloops; loop++)
 			{
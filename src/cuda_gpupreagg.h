@@ -28,6 +28,8 @@ struct kern_gpupreagg
 	cl_uint			block_sz;			/* block-size of setup/join kernel */
 	cl_uint			row_inval_map_size;	/* length of row-invalidation-map */
 	cl_bool			setup_slot_done;	/* setup stage is done, if true */
+	cl_bool			local_reduction;	/* local reduction prior to the final
+										 * one, if true */
 	/* -- suspend/resume (KDS_FORMAT_BLOCK) */
 	cl_bool			resume_context;		/* resume kernel, if true */
 	cl_uint			suspend_count;		/* number of suspended blocks */
@@ -37,6 +39,7 @@ struct kern_gpupreagg
 	cl_uint			nitems_filtered;	/* out: # of removed rows by quals */
 	cl_uint			num_conflicts;		/* only used in kernel space */
 	cl_uint			num_groups;			/* out: # of new groups */
+	cl_uint			local_groups;		/* out: # of groups by local reduction */
 	cl_uint			extra_usage;		/* out: size of new allocation */
 	cl_uint			ghash_conflicts;	/* out: # of ghash conflicts */
 	cl_uint			fhash_conflicts;	/* out: # of fhash conflicts */
@@ -18,6 +18,235 @@
 #include "cuda_common.h"
 #include "cuda_gpuscan.h"
 
+/*
+ * gpuscan_setup_recheck
+ *
+ * It clears CpuReCheck error raised on evaluation of the qualifiers, if
+ * the row can be rechecked by CPU individually, not by the entire chunk.
+ */
+STATIC_INLINE(cl_bool)
+gpuscan_setup_recheck(kern_context *kcxt, kern_gpuscan *kgpuscan)
+{
+	if (kgpuscan->nrooms_recheck > 0 &&
+		(kcxt->errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0 &&
+		kgpuscan->nitems_recheck < kgpuscan->nrooms_recheck)
+	{
+		kcxt->errcode = ERRCODE_STROM_SUCCESS;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * gpuscan_store_recheck
+ *
+ * It saves the row to be rechecked by CPU. If no room, the entire chunk
+ * shall be rechecked by CPU.
+ */
+STATIC_INLINE(void)
+gpuscan_store_recheck(kern_context *kcxt, kern_gpuscan *kgpuscan,
+					  cl_uint row_index, cl_uint line_no)
+{
+	gpuscanRecheckItem *ritem;
+	cl_uint		index = atomicAdd(&kgpuscan->nitems_recheck, 1);
+
+	if (index < kgpuscan->nrooms_recheck)
+	{
+		ritem = KERN_GPUSCAN_RECHECK_ITEMS(kgpuscan) + index;
+		ritem->row_index = row_index;
+		ritem->line_no = line_no;
+	}
+	else
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
+						   "too many rows to be rechecked by CPU");
+	}
+}
+
+/*
+ * gpuscan_lookback_next_tile
+ *
+ * It assigns the next tile to the CUDA block. Tiles are handed out in order,
+ * so the prior tiles are always owned by the running blocks, and the
+ * look-back below never waits for a block not scheduled yet.
+ */
+STATIC_INLINE(cl_uint)
+gpuscan_lookback_next_tile(kern_gpuscan *kgpuscan)
+{
+	__shared__ cl_uint	tile_id;
+
+	if (get_local_id() == 0)
+		tile_id = atomicAdd(&kgpuscan->lookback_next, 1);
+	__syncthreads();
+	return tile_id;
+}
+
+/*
+ * gpuscan_lookback_alloc
+ *
+ * It allocates @nitems slots and @usage (packed) extra buffer for the tile
+ * using the decoupled look-back. If @kds_dst is NULL, it allocates @nitems
+ * entries of the gpuscanResultIndex that has rooms for all the rows. It must be called by all the threads in
+ * the first warp; the lane-0 sets the base position on @p_nitems_base and
+ * @p_usage_base. It returns one of GPUSCAN_LOOKBACK__PREFIX (allocated),
+ * GPUSCAN_LOOKBACK__SUSPEND (no space left) or GPUSCAN_LOOKBACK__INVALID
+ * (other block failed).
+ */
+STATIC_FUNCTION(cl_uint)
+gpuscan_lookback_alloc(kern_gpuscan *kgpuscan,
+					   kern_data_store *kds_dst,
+					   cl_uint tile_id,
+					   cl_uint nitems,
+					   cl_uint usage,
+					   cl_uint *p_nitems_base,
+					   cl_uint *p_usage_base)
+{
+	gpuscanLookbackTile *tiles = KERN_GPUSCAN_LOOKBACK_TILES(kgpuscan);
+	gpuscanLookbackTile *tile = tiles + tile_id;
+	cl_uint		lane_id = (get_local_id() & (warpSize - 1));
+	cl_uint		base = kgpuscan->lookback_base;
+	cl_uint		excl_nitems = 0;
+	cl_uint		excl_usage = 0;
+	cl_uint		status = GPUSCAN_LOOKBACK__PREFIX;
+	cl_long		curr;
+
+	assert(get_local_id() < warpSize &&
+		   tile_id < kgpuscan->nrooms_lookback);
+	/* publish the aggregate first, to unblock the successors */
+	if (lane_id == 0 && tile_id > base)
+	{
+		tile->agg_nitems = nitems;
+		tile->agg_usage  = usage;
+		__threadfence();
+		*((volatile cl_uint *)&tile->status) = GPUSCAN_LOOKBACK__AGGREGATE;
+	}
+
+	/* look back the prior tiles; one tile per lane */
+	curr = (cl_long)tile_id - 1;
+	while (curr >= (cl_long)base)
+	{
+		cl_long		index = curr - lane_id;
+		cl_uint		__status = GPUSCAN_LOOKBACK__PREFIX;
+		cl_uint		__nitems = 0;
+		cl_uint		__usage = 0;
+		cl_uint		mask;
+		cl_uint		first;
+		cl_int		k;
+
+		if (index >= (cl_long)base)
+		{
+			__status = *((volatile cl_uint *)&tiles[index].status);
+			__threadfence();
+			if (__status == GPUSCAN_LOOKBACK__AGGREGATE)
+			{
+				__nitems = *((volatile cl_uint *)&tiles[index].agg_nitems);
+				__usage  = *((volatile cl_uint *)&tiles[index].agg_usage);
+			}
+			else if (__status == GPUSCAN_LOOKBACK__PREFIX)
+			{
+				__nitems = *((volatile cl_uint *)&tiles[index].incl_nitems);
+				__usage  = *((volatile cl_uint *)&tiles[index].incl_usage);
+			}
+		}
+		/* the nearest tile which terminates the look-back, if any */
+		mask = __ballot_sync(__activemask(),
+							 __status == GPUSCAN_LOOKBACK__PREFIX ||
+							 __status == GPUSCAN_LOOKBACK__SUSPEND);
+		first = (mask != 0 ? __ffs(mask) - 1 : warpSize);
+		/* retry, if any tiles before the terminator are not published yet */
+		mask = __ballot_sync(__activemask(),
+							 __status == GPUSCAN_LOOKBACK__INVALID &&
+							 lane_id <= first);
+		if (mask != 0)
+		{
+			if (__shfl_sync(__activemask(),
+							*((volatile cl_uint *)&kgpuscan->lookback_abort),
+							0) != 0)
+				return GPUSCAN_LOOKBACK__INVALID;
+			continue;
+		}
+		if (first < warpSize &&
+			__shfl_sync(__activemask(), __status, first) == GPUSCAN_LOOKBACK__SUSPEND)
+		{
+			status = GPUSCAN_LOOKBACK__SUSPEND;
+			break;
+		}
+		/* sum up the tiles until the terminator */
+		if (lane_id > first)
+		{
+			__nitems = 0;
+			__usage = 0;
+		}
+		for (k=1; k < warpSize; k <<= 1)
+		{
+			__nitems += __shfl_xor_sync(__activemask(), __nitems, k);
+			__usage  += __shfl_xor_sync(__activemask(), __usage, k);
+		}
+		excl_nitems += __nitems;
+		excl_usage  += __usage;
+		if (first < warpSize)
+			break;
+		curr -= warpSize;
+	}
+
+	/* check space of the destination buffer */
+	if (status == GPUSCAN_LOOKBACK__PREFIX && kds_dst &&
+		KERN_DATA_STORE_SLOT_LENGTH(kds_dst, excl_nitems + nitems) +
+		__kds_unpack(excl_usage + usage) > kds_dst->length)
+		status = GPUSCAN_LOOKBACK__SUSPEND;
+
+	if (lane_id == 0)
+	{
+		if (status == GPUSCAN_LOOKBACK__PREFIX)
+		{
+			tile->incl_nitems = excl_nitems + nitems;
+			tile->incl_usage  = excl_usage + usage;
+		}
+		else
+		{
+			atomicAdd(&kgpuscan->suspend_count, 1);
+			atomicMin(&kgpuscan->lookback_suspend, tile_id);
+		}
+		__threadfence();
+		*((volatile cl_uint *)&tile->status) = status;
+		*p_nitems_base = excl_nitems;
+		*p_usage_base  = excl_usage;
+	}
+	return status;
+}
+
+/*
+ * gpuscan_lookback_update_dst
+ *
+ * It sets up nitems/usage of the destination buffer (or nitems of the
+ * gpuscanResultIndex, if selection vector mode) by the last tile allocated
+ * by this block, at the end of the kernel.
+ */
+STATIC_INLINE(void)
+gpuscan_lookback_update_dst(kern_context *kcxt,
+							kern_gpuscan *kgpuscan,
+							kern_data_store *kds_dst,
+							cl_long last_tile_id)
+{
+	gpuscanLookbackTile *tile;
+
+	/* unblock the successors, if this block exits by error */
+	if (kcxt->errcode != ERRCODE_STROM_SUCCESS)
+		*((volatile cl_uint *)&kgpuscan->lookback_abort) = 1;
+	if (get_local_id() == 0 && last_tile_id >= 0)
+	{
+		tile = KERN_GPUSCAN_LOOKBACK_TILES(kgpuscan) + last_tile_id;
+		if (!kds_dst)
+			atomicMax(&KERN_GPUSCAN_RESULT_INDEX(kgpuscan)->nitems,
+					  tile->incl_nitems);
+		else
+		{
+			atomicMax(&kds_dst->nitems, tile->incl_nitems);
+			atomicMax(&kds_dst->usage,  tile->incl_usage);
+		}
+	}
+}
+
 /*
  * gpuscan_main_row - GpuScan logic for KDS_FORMAT_ROW
  */
@@ -28,38 +257,31 @@ gpuscan_main_row(kern_context *kcxt,
 				 kern_data_store *kds_dst,
 				 bool has_device_projection)
 {
-	gpuscanSuspendContext *my_suspend
-		= KERN_GPUSCAN_SUSPEND_CONTEXT(kgpuscan, get_group_id());
 	gpuscanResultIndex *gs_results	__attribute__((unused))
 		= KERN_GPUSCAN_RESULT_INDEX(kgpuscan);
-	cl_uint		part_index = 0;
+	cl_uint		tile_id;
+	cl_long		last_tile_id = -1;
 	cl_uint		src_index;
 	cl_uint		src_base;
 	cl_uint		total_nitems_in = 0;	/* stat */
 	cl_uint		total_nitems_out = 0;	/* stat */
 	cl_uint		total_extra_size = 0;	/* stat */
 	__shared__ cl_uint	dst_nitems_base;
-	__shared__ cl_ulong	dst_usage_base;
+	__shared__ cl_uint	dst_usage_base;
 
 	assert(kds_src->format == KDS_FORMAT_ROW);
 	assert(kds_dst->format == KDS_FORMAT_SLOT);
 	/* quick bailout if any error happen on the prior kernel */
 	if (__syncthreads_count(kgpuscan->kerror.errcode) != 0)
 		return;
-	/* resume kernel from the point where suspended, if any */
-	if (kgpuscan->resume_context)
-	{
-		assert(my_suspend != NULL);
-		part_index = my_suspend->part_index;
-	}
 
-	for (src_base = get_global_base() + part_index * get_global_size();
-		 src_base < kds_src->nitems;
-		 src_base += get_global_size(), part_index++)
+	for (;;)
 	{
 		kern_tupitem   *tupitem = NULL;
 		cl_bool			rc = false;
+		cl_bool			recheck = false;
 		cl_uint			nvalids;
+		cl_uint			nrecheck;
 		cl_uint			required = 0;
 		cl_uint			nitems_offset;
 		cl_uint			usage_offset = 0;
@@ -68,6 +290,10 @@ gpuscan_main_row(kern_context *kcxt,
 		cl_char		   *tup_dclass = NULL;
 		Datum		   *tup_values = NULL;
 
+		tile_id = gpuscan_lookback_next_tile(kgpuscan);
+		src_base = tile_id * get_local_size();
+		if (src_base >= kds_src->nitems)
+			break;
 		/* rewind the varlena buffer */
 		kcxt->vlpos = kcxt->vlbuf;
 		/* Evalidation of the rows by WHERE-clause */
@@ -78,104 +304,95 @@ gpuscan_main_row(kern_context *kcxt,
 			rc = gpuscan_quals_eval(kcxt, kds_src,
 									&tupitem->htup.t_ctid,
 									&tupitem->htup);
+			if (gpuscan_setup_recheck(kcxt, kgpuscan))
+			{
+				recheck = true;
+				rc = false;
+			}
 		}
 		/* bailout if any error */
 		if (__syncthreads_count(kcxt->errcode) > 0)
 			break;
 		/* how many rows servived WHERE-clause evaluation? */
 		nitems_offset = pgstromStairlikeBinaryCount(rc, &nvalids);
-		if (nvalids > 0)
+		/* extract the source tuple to the private slot, if any */
+		if (rc)
 		{
-			/* extract the source tuple to the private slot, if any */
-			if (rc)
-			{
-				kcxt->vlpos = kcxt->vlbuf;	/* rewind */
-				tup_dclass = (cl_char *)
-					kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
-				tup_values = (Datum *)
-					kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
+			kcxt->vlpos = kcxt->vlbuf;	/* rewind */
+			tup_dclass = (cl_char *)
+				kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
+			tup_values = (Datum *)
+				kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
 
-				if (!tup_dclass || !tup_values)
-				{
-					STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
-									   "out of memory");
-				}
-				else
-				{
-					gpuscan_projection_tuple(kcxt,
-											 kds_src,
-											 &tupitem->htup,
-											 &tupitem->htup.t_ctid,
-											 tup_dclass,
-											 tup_values);
-					required = kds_slot_compute_extra(kcxt,
-													  kds_dst,
-													  tup_dclass,
-													  tup_values);
-				}
-			}
-			/* bailout if any error */
-			if (__syncthreads_count(kcxt->errcode) > 0)
-				break;;
-			/* allocation of the destination buffer */
-			usage_offset = pgstromStairlikeSum(__kds_packed(required),
-											   &usage_length);
-			if (get_local_id() == 0)
+			if (!tup_dclass || !tup_values)
 			{
-				union {
-					struct {
-						cl_uint	nitems;
-						cl_uint	usage;
-					} i;
-					cl_ulong	v64;
-				} oldval, curval, newval;
-
-				curval.i.nitems	= kds_dst->nitems;
-				curval.i.usage	= kds_dst->usage;
-				do {
-					newval = oldval = curval;
-					newval.i.nitems += nvalids;
-					newval.i.usage  += usage_length;
-
-					if (KERN_DATA_STORE_SLOT_LENGTH(kds_dst, newval.i.nitems) +
-						__kds_unpack(newval.i.usage) > kds_dst->length)
-					{
-						atomicAdd(&kgpuscan->suspend_count, 1);
-						suspend_kernel = 1;
-						break;
-					}
-				} while ((curval.v64 = atomicCAS((cl_ulong *)&kds_dst->nitems,
-												 oldval.v64,
-												 newval.v64)) != oldval.v64);
-				dst_nitems_base = oldval.i.nitems;
-				dst_usage_base  = oldval.i.usage;
+				STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
+								   "out of memory");
 			}
-			if (__syncthreads_count(suspend_kernel) > 0)
-				break;
-			/* store the result tuple on the destination buffer */
-			if (rc)
+			else
 			{
-				cl_uint	dst_index = dst_nitems_base + nitems_offset;
-				char   *dst_extra = ((char *)kds_dst + kds_dst->length -
-									 __kds_unpack(dst_usage_base +
-												  usage_offset) - required);
-				kds_slot_store_values(kcxt,
-									  kds_dst,
-									  dst_index,
-									  dst_extra,
-									  tup_dclass,
-									  tup_values);
+				gpuscan_projection_tuple(kcxt,
+										 kds_src,
+										 &tupitem->htup,
+										 &tupitem->htup.t_ctid,
+										 tup_dclass,
+										 tup_values);
+				required = kds_slot_compute_extra(kcxt,
+												  kds_dst,
+												  tup_dclass,
+												  tup_values);
 			}
 		}
+		/* bailout if any error */
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			break;
+		/* allocation of the destination buffer */
+		if (nvalids > 0)
+			usage_offset = pgstromStairlikeSum(__kds_packed(required),
+											   &usage_length);
+		if (get_local_id() < warpSize)
+		{
+			if (gpuscan_lookback_alloc(kgpuscan,
+									   kds_dst,
+									   tile_id,
+									   nvalids,
+									   usage_length,
+									   &dst_nitems_base,
+									   &dst_usage_base)
+				!= GPUSCAN_LOOKBACK__PREFIX)
+				suspend_kernel = 1;
+		}
+		if (__syncthreads_count(suspend_kernel) > 0)
+			break;
+		last_tile_id = tile_id;
+		/* store the result tuple on the destination buffer */
+		if (rc)
+		{
+			cl_uint	dst_index = dst_nitems_base + nitems_offset;
+			char   *dst_extra = ((char *)kds_dst + kds_dst->length -
+								 __kds_unpack(dst_usage_base +
+											  usage_offset) - required);
+			kds_slot_store_values(kcxt,
+								  kds_dst,
+								  dst_index,
+								  dst_extra,
+								  tup_dclass,
+								  tup_values);
+		}
+		/* save the rows to be rechecked by CPU */
+		if (recheck)
+			gpuscan_store_recheck(kcxt, kgpuscan, src_index, 0);
+		nrecheck = __syncthreads_count(recheck);
 		/* update statistics */
 		if (get_local_id() == 0)
 		{
 			total_nitems_in  += Min(kds_src->nitems - src_base,
-									get_local_size());
+									get_local_size()) - nrecheck;
 			total_nitems_out += nvalids;
 			total_extra_size += __kds_unpack(usage_length);
 		}
 	}
+	gpuscan_lookback_update_dst(kcxt, kgpuscan, kds_dst, last_tile_id);
 	/* write back statistics */
 	if (get_local_id() == 0)
 	{
@@ -183,12 +400,6 @@ gpuscan_main_row(kern_context *kcxt,
 		atomicAdd(&kgpuscan->nitems_out, total_nitems_out);
 		atomicAdd(&kgpuscan->extra_size, total_extra_size);
 	}
-	/* suspend the current position (even if normal exit) */
-	if (my_suspend && get_local_id() == 0)
-	{
-		my_suspend->part_index = part_index;
-		my_suspend->line_index = 0;
-	}
 }
 
 /*
@@ -264,6 +475,7 @@ gpuscan_main_block(kern_context *kcxt,
 			cl_uint		usage_length = 0;
 			cl_uint		suspend_kernel = 0;
 			cl_bool		rc = false;
+			cl_bool		recheck = false;
 			cl_char	   *tup_dclass = NULL;
 			Datum	   *tup_values = NULL;
 
@@ -284,7 +496,11 @@ gpuscan_main_block(kern_context *kcxt,
 				{
 					ItemIdData *lpp = PageGetItemId(pg_page, line_no+1);
 					if (ItemIdIsNormal(lpp))
+					{
 						htup = PageGetItem(pg_page, lpp);
+						if (!kern_check_visibility_heap(kcxt, pg_page, htup))
+							htup = NULL;
+					}
 					t_len = ItemIdGetLength(lpp);
 				}
 			}
@@ -296,6 +512,11 @@ gpuscan_main_block(kern_context *kcxt,
 										kds_src,
 										&t_self,
 										htup);
+				if (gpuscan_setup_recheck(kcxt, kgpuscan))
+				{
+					recheck = true;
+					rc = false;
+				}
 			}
 			/* bailout if any error */
 			if (__syncthreads_count(kcxt->errcode) > 0)
@@ -385,8 +606,11 @@ gpuscan_main_block(kern_context *kcxt,
 										  tup_values);
 				}
 			}
+			/* save the rows to be rechecked by CPU */
+			if (recheck)
+				gpuscan_store_recheck(kcxt, kgpuscan, part_id, line_no);
 			/* update statistics */
-			nitems_real = __syncthreads_count(htup != NULL);
+			nitems_real = __syncthreads_count(htup != NULL && !recheck);
 			if (get_local_id() == 0)
 			{
 				total_nitems_in		+= nitems_real;
@@ -424,6 +648,10 @@ out_nostat:
 
 /*
  * gpuscan_main_arrow - GpuScan logic for KDS_FORMAT_ARROW
+ *
+ * If @kds_dst is NULL, it writes back only the index of rows survived on
+ * the gpuscanResultIndex (selection vector), then CPU fetches the values
+ * from the source buffer.
  */
 DEVICE_FUNCTION(void)
 gpuscan_main_arrow(kern_context *kcxt,
@@ -432,9 +660,9 @@ gpuscan_main_arrow(kern_context *kcxt,
 				   kern_data_store *kds_dst,
 				   bool has_device_projection)
 {
-	gpuscanSuspendContext *my_suspend
-		= KERN_GPUSCAN_SUSPEND_CONTEXT(kgpuscan, get_group_id());
-	cl_uint		part_index = 0;
+	gpuscanResultIndex *gs_results = KERN_GPUSCAN_RESULT_INDEX(kgpuscan);
+	cl_uint		tile_id;
+	cl_long		last_tile_id = -1;
 	cl_uint		src_base;
 	cl_uint		src_index;
 	cl_uint		total_nitems_in = 0;	/* stat */
@@ -444,24 +672,18 @@ gpuscan_main_arrow(kern_context *kcxt,
 	__shared__ cl_uint	dst_usage_base;
 
 	assert(kds_src->format == KDS_FORMAT_ARROW);
-	assert(kds_dst->format == KDS_FORMAT_SLOT);
+	assert(!kds_dst || kds_dst->format == KDS_FORMAT_SLOT);
 	/* quick bailout if any error happen on the prior kernel */
 	if (__syncthreads_count(kgpuscan->kerror.errcode) != 0)
 		return;
-	/* resume kernel from the point where suspended, if any */
-	if (kgpuscan->resume_context)
-	{
-		assert(my_suspend != NULL);
-		part_index = my_suspend->part_index;
-	}
 
-	for (src_base = get_global_base() + part_index * get_global_size();
-		 src_base < kds_src->nitems;
-		 src_base += get_global_size(), part_index++)
+	for (;;)
 	{
 		kern_tupitem   *tupitem		__attribute__((unused));
 		cl_bool			rc;
+		cl_bool			recheck = false;
 		cl_uint			nvalids;
+		cl_uint			nrecheck;
 		cl_uint			required = 0;
 		cl_uint			nitems_offset;
 		cl_uint			usage_offset = 0;
@@ -470,13 +692,24 @@ gpuscan_main_arrow(kern_context *kcxt,
 		cl_char		   *tup_dclass = NULL;
 		Datum		   *tup_values = NULL;
 
+		tile_id = gpuscan_lookback_next_tile(kgpuscan);
+		src_base = tile_id * get_local_size();
+		if (src_base >= kds_src->nitems)
+			break;
 		/* rewind the varlena buffer */
 		kcxt->vlpos = kcxt->vlbuf;
 
 		/* Evalidation of the rows by WHERE-clause */
 		src_index = src_base + get_local_id();
 		if (src_index < kds_src->nitems)
+		{
 			rc = gpuscan_quals_eval_arrow(kcxt, kds_src, src_index);
+			if (gpuscan_setup_recheck(kcxt, kgpuscan))
+			{
+				recheck = true;
+				rc = false;
+			}
+		}
 		else
 			rc = false;
 		/* bailout if any error */
@@ -485,99 +718,87 @@ gpuscan_main_arrow(kern_context *kcxt,
 
 		/* how many rows servived WHERE-clause evaluation? */
 		nitems_offset = pgstromStairlikeBinaryCount(rc, &nvalids);
-		if (nvalids > 0)
+		if (rc && kds_dst)
 		{
-			if (rc)
-			{
-				kcxt->vlpos = kcxt->vlbuf;	/* rewind */
-				tup_dclass = (cl_char *)
-					kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
-				tup_values = (Datum *)
-					kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
+			kcxt->vlpos = kcxt->vlbuf;	/* rewind */
+			tup_dclass = (cl_char *)
+				kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
+			tup_values = (Datum *)
+				kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
 
-				if (!tup_dclass || !tup_values)
-				{
-					STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY,
-								  "out of memory");
-				}
-				else
-				{
-					gpuscan_projection_arrow(kcxt,
-											 kds_src,
-											 src_index,
-											 tup_dclass,
-											 tup_values);
-					required = kds_slot_compute_extra(kcxt,
-													  kds_dst,
-													  tup_dclass,
-													  tup_values);
-				}
-			}
-			/* bailout if any error */
-			if (__syncthreads_count(kcxt->errcode) > 0)
-				break;
-			/* allocation of the destination buffer */
-			usage_offset = pgstromStairlikeSum(__kds_packed(required),
-											   &usage_length);
-			if (get_local_id() == 0)
+			if (!tup_dclass || !tup_values)
 			{
-				union {
-					struct {
-						cl_uint	nitems;
-						cl_uint	usage;
-					} i;
-					cl_ulong	v64;
-				} oldval, curval, newval;
-
-				curval.i.nitems = kds_dst->nitems;
-				curval.i.usage  = kds_dst->usage;
-				do {
-					newval = oldval = curval;
-					newval.i.nitems += nvalids;
-					newval.i.usage  += usage_length;
-
-					if (KERN_DATA_STORE_SLOT_LENGTH(kds_dst, newval.i.nitems) +
-						__kds_unpack(newval.i.usage) > kds_dst->length)
-					{
-						atomicAdd(&kgpuscan->suspend_count, 1);
-						suspend_kernel = 1;
-						break;
-					}
-				} while ((curval.v64 = atomicCAS((cl_ulong *)&kds_dst->nitems,
-												 oldval.v64,
-												 newval.v64)) != oldval.v64);
-				dst_nitems_base = oldval.i.nitems;
-				dst_usage_base  = oldval.i.usage;
+				STROM_EREPORT(kcxt, ERRCODE_OUT_OF_MEMORY,
+							  "out of memory");
 			}
-			if (__syncthreads_count(suspend_kernel) > 0)
-				break;
-			/* store the result virtual-tuple on the destination buffer */
-			if (rc)
+			else
 			{
-				cl_uint		dst_index = dst_nitems_base + nitems_offset;
-				char	   *dst_extra = ((char *)kds_dst + kds_dst->length -
-										 __kds_unpack(dst_usage_base +
-													  usage_offset) - required);
-				kds_slot_store_values(kcxt,
-									  kds_dst,
-									  dst_index,
-									  dst_extra,
-									  tup_dclass,
-									  tup_values);
+				gpuscan_projection_arrow(kcxt,
+										 kds_src,
+										 src_index,
+										 tup_dclass,
+										 tup_values);
+				required = kds_slot_compute_extra(kcxt,
+												  kds_dst,
+												  tup_dclass,
+												  tup_values);
 			}
-			/* bailout if any error */
-			if (__syncthreads_count(kcxt->errcode) > 0)
-				break;
 		}
+		/* bailout if any error */
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			break;
+		/* allocation of the destination buffer */
+		if (nvalids > 0)
+			usage_offset = pgstromStairlikeSum(__kds_packed(required),
+											   &usage_length);
+		if (get_local_id() < warpSize)
+		{
+			if (gpuscan_lookback_alloc(kgpuscan,
+									   kds_dst,
+									   tile_id,
+									   nvalids,
+									   usage_length,
+									   &dst_nitems_base,
+									   &dst_usage_base)
+				!= GPUSCAN_LOOKBACK__PREFIX)
+				suspend_kernel = 1;
+		}
+		if (__syncthreads_count(suspend_kernel) > 0)
+			break;
+		last_tile_id = tile_id;
+		/* store the result virtual-tuple on the destination buffer */
+		if (rc && !kds_dst)
+			gs_results->results[dst_nitems_base + nitems_offset] = src_index;
+		else if (rc)
+		{
+			cl_uint		dst_index = dst_nitems_base + nitems_offset;
+			char	   *dst_extra = ((char *)kds_dst + kds_dst->length -
+									 __kds_unpack(dst_usage_base +
+												  usage_offset) - required);
+			kds_slot_store_values(kcxt,
+								  kds_dst,
+								  dst_index,
+								  dst_extra,
+								  tup_dclass,
+								  tup_values);
+		}
+		/* bailout if any error */
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			break;
+		/* save the rows to be rechecked by CPU */
+		if (recheck)
+			gpuscan_store_recheck(kcxt, kgpuscan, src_index, 0);
+		nrecheck = __syncthreads_count(recheck);
 		/* write back statistics */
 		if (get_local_id() == 0)
 		{
 			total_nitems_in += Min(kds_src->nitems - src_base,
-								   get_local_size());
+								   get_local_size()) - nrecheck;
 			total_nitems_out += nvalids;
 			total_extra_size += __kds_unpack(usage_length);
 		}
 	}
+	gpuscan_lookback_update_dst(kcxt, kgpuscan, kds_dst, last_tile_id);
 	/* write back statistics */
 	if (get_local_id() == 0)
 	{
@@ -585,12 +806,6 @@ gpuscan_main_arrow(kern_context *kcxt,
 		atomicAdd(&kgpuscan->nitems_out, total_nitems_out);
 		atomicAdd(&kgpuscan->extra_size, total_extra_size);
 	}
-	/* suspend the current position (even if normal exit) */
-	if (my_suspend && get_local_id() == 0)
-	{
-		my_suspend->part_index = part_index;
-		my_suspend->line_index = 0;
-	}
 }
 
 /*
@@ -32,8 +32,19 @@ struct kern_gpuscan {
 	cl_uint			suspend_sz;			/* size of suspend context buffer */
 	cl_uint			suspend_count;		/* # of suspended workgroups */
 	cl_bool			resume_context;		/* true, if kernel should resume */
+	/* rows to be rechecked by CPU */
+	cl_uint			nrooms_recheck;		/* capacity of the recheck items */
+	cl_uint			nitems_recheck;		/* # of rows to be rechecked */
+	/* decoupled look-back (only KDS_FORMAT_ROW/ARROW) */
+	cl_uint			nrooms_lookback;	/* capacity of the look-back tiles */
+	cl_uint			lookback_base;		/* first tile of this invocation */
+	cl_uint			lookback_next;		/* next tile to be processed */
+	cl_uint			lookback_suspend;	/* first tile suspended */
+	cl_uint			lookback_abort;		/* non-zero, if any block failed */
 	kern_parambuf	kparams;
 	/* <-- gpuscanSuspendContext --> */
+	/* <-- gpuscanLookbackTile (if nrooms_lookback > 0) --> */
+	/* <-- gpuscanRecheckItem (if nrooms_recheck > 0) --> */
 	/* <-- gpuscanResultIndex (if KDS_FORMAT_ROW with no projection) -->*/
 };
 typedef struct kern_gpuscan		kern_gpuscan;
@@ -44,12 +55,66 @@ typedef struct
 	cl_uint		line_index;
 } gpuscanSuspendContext;
 
+/*
+ * gpuscanLookbackTile - status of a tile (rows processed by a CUDA block at
+ * once) for the decoupled look-back. A tile publishes its own number of rows
+ * and extra usage first (AGGREGATE), then the inclusive prefix of them once
+ * all the prior tiles are resolved (PREFIX). The successor tiles sum up these
+ * values backward to get the position on the destination buffer, so the
+ * result rows are dense and ordered by the tile, without a shared counter.
+ * If destination buffer has no space, the tile is marked as SUSPEND, then
+ * all the later tiles follow it.
+ */
+#define GPUSCAN_LOOKBACK__INVALID		0
+#define GPUSCAN_LOOKBACK__AGGREGATE		1
+#define GPUSCAN_LOOKBACK__PREFIX		2
+#define GPUSCAN_LOOKBACK__SUSPEND		3
+typedef struct
+{
+	cl_uint		status;			/* one of GPUSCAN_LOOKBACK__* */
+	cl_uint		agg_nitems;		/* # of rows in this tile */
+	cl_uint		agg_usage;		/* extra usage of this tile (packed) */
+	cl_uint		incl_nitems;	/* # of rows in tiles[base ... this] */
+	cl_uint		incl_usage;		/* extra usage of tiles[base ... this] */
+} gpuscanLookbackTile;
+
+/*
+ * gpuscanRecheckItem - a row that raised CpuReCheck error on the device.
+ * These rows are rechecked by CPU, instead of the entire chunk.
+ */
+typedef struct
+{
+	cl_uint		row_index;		/* row-index, or block-index if BLOCK */
+	cl_uint		line_no;		/* line-number, only KDS_FORMAT_BLOCK */
+} gpuscanRecheckItem;
+
 typedef struct
 {
 	cl_uint		nitems;
 	cl_uint		results[FLEXIBLE_ARRAY_MEMBER];
 } gpuscanResultIndex;
 
+/*
+ * kern_gpuscan_qstat - runtime reordering of the device qualifiers
+ *
+ * It is delivered as a bytea parameter of the kern_parambuf. During the
+ * sampling phase, GPU kernel evaluates all the qualifiers on every row and
+ * counts number of rows passed for each of them. Then, host code chooses
+ * the order of evaluation by the measured selectivity and estimated cost,
+ * and turns off the sampling for the later chunks.
+ */
+#define GPUSCAN_QSTAT_MAX_QUALS		16
+typedef struct
+{
+	cl_int		vl_len_;		/* varlena header */
+	cl_uint		nquals;			/* number of the qualifiers */
+	cl_bool		sampling;		/* true, if sampling phase */
+	cl_uchar	order[GPUSCAN_QSTAT_MAX_QUALS];	/* order of evaluation */
+	cl_int		cost[GPUSCAN_QSTAT_MAX_QUALS];	/* estimated device cost */
+	cl_uint		nevals;			/* # of rows evaluated (sampling only) */
+	cl_uint		npassed[GPUSCAN_QSTAT_MAX_QUALS]; /* # of rows passed */
+} kern_gpuscan_qstat;
+
 #define KERN_GPUSCAN_PARAMBUF(kgpuscan)			\
 	(&((kern_gpuscan *)(kgpuscan))->kparams)
 #define KERN_GPUSCAN_PARAMBUF_LENGTH(kgpuscan)	\
@@ -60,11 +125,23 @@ typedef struct
 	 : ((gpuscanSuspendContext *)				\
 		((char *)KERN_GPUSCAN_PARAMBUF(kgpuscan) + \
 		 KERN_GPUSCAN_PARAMBUF_LENGTH(kgpuscan))) + (group_id))
-#define KERN_GPUSCAN_RESULT_INDEX(kgpuscan)		\
-	((gpuscanResultIndex *)						\
+#define KERN_GPUSCAN_LOOKBACK_TILES(kgpuscan)	\
+	((gpuscanLookbackTile *)					\
 	 ((char *)KERN_GPUSCAN_PARAMBUF(kgpuscan) +	\
 	  KERN_GPUSCAN_PARAMBUF_LENGTH(kgpuscan) +	\
 	  STROMALIGN((kgpuscan)->suspend_sz)))
+#define KERN_GPUSCAN_LOOKBACK_LENGTH(kgpuscan)	\
+	STROMALIGN(sizeof(gpuscanLookbackTile) * (kgpuscan)->nrooms_lookback)
+#define KERN_GPUSCAN_RECHECK_ITEMS(kgpuscan)	\
+	((gpuscanRecheckItem *)						\
+	 ((char *)KERN_GPUSCAN_LOOKBACK_TILES(kgpuscan) + \
+	  KERN_GPUSCAN_LOOKBACK_LENGTH(kgpuscan)))
+#define KERN_GPUSCAN_RECHECK_LENGTH(kgpuscan)	\
+	STROMALIGN(sizeof(gpuscanRecheckItem) * (kgpuscan)->nrooms_recheck)
+#define KERN_GPUSCAN_RESULT_INDEX(kgpuscan)		\
+	((gpuscanResultIndex *)						\
+	 ((char *)KERN_GPUSCAN_RECHECK_ITEMS(kgpuscan) + \
+	  KERN_GPUSCAN_RECHECK_LENGTH(kgpuscan)))
 #define KERN_GPUSCAN_DMASEND_LENGTH(kgpuscan)	\
 	(offsetof(kern_gpuscan, kparams) +			\
 	 KERN_GPUSCAN_PARAMBUF_LENGTH(kgpuscan))
@@ -88,6 +165,25 @@ gpuscan_quals_eval_column(kern_context *kcxt,
 						  kern_data_extra *extra,
 						  cl_uint src_index);
 
+/*
+ * gpuscan_qstat_count - warp-aggregated increment of the qualifier's stat
+ */
+DEVICE_INLINE(void)
+gpuscan_qstat_count(kern_gpuscan_qstat *qstat, cl_int qindex, cl_bool passed)
+{
+	cl_uint		mask = __activemask();
+	cl_uint		count = __popc(__ballot_sync(mask, passed));
+	cl_uint		leader = __ffs(mask) - 1;
+
+	if ((get_local_id() & (warpSize - 1)) == leader)
+	{
+		if (qindex == 0)
+			atomicAdd(&qstat->nevals, __popc(mask));
+		if (count > 0)
+			atomicAdd(&qstat->npassed[qstat->order[qindex]], count);
+	}
+}
+
 DEVICE_FUNCTION(void)
 gpuscan_projection_tuple(kern_context *kcxt,
 						 kern_data_store *kds_src,
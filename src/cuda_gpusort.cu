@@ -18,19 +18,18 @@
 #include "cuda_common.h"
 #include "cuda_gpusort.h"
 /*
- * gpusort_setup_column
+ * __gpusort_setup_common - build the initial result index
  */
-DEVICE_FUNCTION(void)
-gpusort_setup_column(kern_context *kcxt,
-					 kern_gpusort *kgpusort,
-					 kern_data_store *kds_src)
+STATIC_FUNCTION(void)
+__gpusort_setup_common(kern_context *kcxt,
+					   kern_gpusort *kgpusort,
+					   kern_data_store *kds_src)
 {
 	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(kgpusort);
 	cl_uint			globalSz = get_global_size();
 	cl_uint			loop, nloops;
 	__shared__ cl_uint pos;
 
-	assert(kds_src->format == KDS_FORMAT_COLUMN);
 	nloops = (kds_src->nitems + globalSz - 1) / globalSz;
 	for (loop=0; loop < nloops; loop++)
 	{
@@ -56,6 +55,30 @@ gpusort_setup_column(kern_context *kcxt,
 	}
 }
 
+/*
+ * gpusort_setup_column
+ */
+DEVICE_FUNCTION(void)
+gpusort_setup_column(kern_context *kcxt,
+					 kern_gpusort *kgpusort,
+					 kern_data_store *kds_src)
+{
+	assert(kds_src->format == KDS_FORMAT_COLUMN);
+	__gpusort_setup_common(kcxt, kgpusort, kds_src);
+}
+
+/*
+ * gpusort_setup_row
+ */
+DEVICE_FUNCTION(void)
+gpusort_setup_row(kern_context *kcxt,
+				  kern_gpusort *kgpusort,
+				  kern_data_store *kds_src)
+{
+	assert(kds_src->format == KDS_FORMAT_ROW);
+	__gpusort_setup_common(kcxt, kgpusort, kds_src);
+}
+
 DEVICE_FUNCTION(void)
 gpusort_bitonic_local(kern_context *kcxt,
 					  kern_gpusort *kgpusort,
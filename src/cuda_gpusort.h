@@ -45,6 +45,15 @@ typedef struct {
 #define BITONIC_MAX_LOCAL_SHIFT		12
 #define BITONIC_MAX_LOCAL_SZ		(1<<BITONIC_MAX_LOCAL_SHIFT)
 
+#ifndef __CUDACC__
+/*
+ * gpusortLaunchBitonicSorting - enqueue the sorting kernels (gpusort.c)
+ */
+extern void gpusortLaunchBitonicSorting(CUmodule cuda_module,
+										kern_gpusort *kgpusort,
+										kern_data_store *kds_src);
+#endif	/* !__CUDACC__ */
+
 #ifdef __CUDACC__
 /*
  * gpusort_quals_eval - evaluation of device qualifier
@@ -61,6 +70,16 @@ gpusort_keycomp(kern_context *kcxt,
 				kern_data_store *kds_src,
 				cl_uint x_index,
 				cl_uint y_index);
+/*
+ * gpusort_keydiff - index of the first sorting key which is not equal
+ * between the two rows, or number of the keys if all equal. It is only
+ * generated for the consumers of the sorted rows, like GpuWindowAgg.
+ */
+DEVICE_FUNCTION(cl_int)
+gpusort_keydiff(kern_context *kcxt,
+				kern_data_store *kds_src,
+				cl_uint x_index,
+				cl_uint y_index);
 /*
  * GpuSort main logic;
  */
@@ -69,6 +88,10 @@ gpusort_setup_column(kern_context *kcxt,
 					 kern_gpusort *kgpusort,
 					 kern_data_store *kds_src);
 DEVICE_FUNCTION(void)
+gpusort_setup_row(kern_context *kcxt,
+				  kern_gpusort *kgpusort,
+				  kern_data_store *kds_src);
+DEVICE_FUNCTION(void)
 gpusort_bitonic_local(kern_context *kcxt,
 					  kern_gpusort *kgpusort,
 					  kern_data_store *kds_src);
@@ -96,6 +119,17 @@ kern_gpusort_setup_column(kern_gpusort *kgpusort,
 	kern_writeback_error_status(&kgpusort->kerror, &u.kcxt);
 }
 
+KERNEL_FUNCTION(void)
+kern_gpusort_setup_row(kern_gpusort *kgpusort,
+					   kern_data_store *kds_src)
+{
+	DECL_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, &kgpusort->kparams);
+	gpusort_setup_row(&u.kcxt, kgpusort, kds_src);
+	kern_writeback_error_status(&kgpusort->kerror, &u.kcxt);
+}
+
 KERNEL_FUNCTION_MAXTHREADS(void)
 kern_gpusort_bitonic_local(kern_gpusort *kgpusort,
 						   kern_data_store *kds_src)
@@ -0,0 +1,274 @@
+/*
+ * cuda_gpuwinagg.cu
+ *
+ * CUDA device code for GpuWindowAgg logic
+ * --
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "cuda_common.h"
+#include "cuda_gpusort.h"
+#include "cuda_gpuwinagg.h"
+
+/*
+ * gpuwinagg_setup
+ *
+ * It checks the boundary of partitions and peer groups between the
+ * neighbor rows, then initializes the first bank of the per-row buffers.
+ */
+DEVICE_FUNCTION(void)
+gpuwinagg_setup(kern_context *kcxt,
+				kern_gpusort *kgpusort,
+				kern_gpuwinagg *kgwinagg,
+				kern_data_store *kds_src)
+{
+	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(kgpusort);
+	cl_uint	   *part_head = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_head[0]);
+	cl_uint	   *part_tail = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_tail[0]);
+	cl_uint	   *peer_head = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_head[0]);
+	cl_uint	   *peer_tail = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_tail[0]);
+	cl_uint	   *peer_count = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_count[0]);
+	cl_uint		nitems = kgwinagg->nitems;
+	cl_uint		pos;
+	cl_uint		i;
+
+	/* quick bailout if any error happen in the sorting kernels */
+	if (kgpusort->kerror.errcode != 0)
+		return;
+	assert(kresults->nitems == nitems);
+	for (pos = get_global_id(); pos < nitems; pos += get_global_size())
+	{
+		cl_uint		row_index = kresults->results[pos];
+		cl_int		diff_prev = 0;
+		cl_int		diff_next = 0;
+
+		if (pos > 0)
+			diff_prev = gpusort_keydiff(kcxt, kds_src,
+										kresults->results[pos - 1],
+										row_index);
+		if (pos + 1 < nitems)
+			diff_next = gpusort_keydiff(kcxt, kds_src,
+										row_index,
+										kresults->results[pos + 1]);
+		if (pos == 0 || diff_prev < kgwinagg->part_nkeys)
+			part_head[pos] = pos;
+		else
+			part_head[pos] = 0;
+		if (pos == 0 || diff_prev < kgwinagg->peer_nkeys)
+		{
+			peer_head[pos] = pos;
+			peer_count[pos] = 1;
+		}
+		else
+		{
+			peer_head[pos] = 0;
+			peer_count[pos] = 0;
+		}
+		if (pos + 1 == nitems || diff_next < kgwinagg->part_nkeys)
+			part_tail[pos] = pos;
+		else
+			part_tail[pos] = UINT_MAX;
+		if (pos + 1 == nitems || diff_next < kgwinagg->peer_nkeys)
+			peer_tail[pos] = pos;
+		else
+			peer_tail[pos] = UINT_MAX;
+
+		/* arguments of the aggregate functions */
+		for (i=0; i < kgwinagg->nfuncs; i++)
+		{
+			kern_gpuwinagg_func *kfunc = &kgwinagg->funcs[i];
+			cl_long		ival = 0;
+			cl_double	fval = 0.0;
+			cl_bool		notnull;
+
+			if (!GPUWINAGG_FUNC_IS_AGGREGATE(kfunc->func_kind))
+				continue;
+			notnull = gpuwinagg_fetch_value(kcxt, kds_src, row_index, i,
+											&ival, &fval);
+			((cl_uint *)KERN_GPUWINAGG_BUFFER(kgwinagg,
+											  kfunc->c_raw))[pos]
+				= (notnull ? 1 : 0);
+			((cl_uint *)KERN_GPUWINAGG_BUFFER(kgwinagg,
+											  kfunc->c_scan[0]))[pos]
+				= (notnull ? 1 : 0);
+			if (kfunc->func_kind == GPUWINAGG_FUNC__SUM_FLOAT)
+			{
+				((cl_double *)KERN_GPUWINAGG_BUFFER(kgwinagg,
+													kfunc->v_raw))[pos]
+					= (notnull ? fval : 0.0);
+				((cl_double *)KERN_GPUWINAGG_BUFFER(kgwinagg,
+													kfunc->v_scan[0]))[pos]
+					= (notnull ? fval : 0.0);
+			}
+			else
+			{
+				((cl_long *)KERN_GPUWINAGG_BUFFER(kgwinagg,
+												  kfunc->v_raw))[pos]
+					= (notnull ? ival : 0);
+				((cl_long *)KERN_GPUWINAGG_BUFFER(kgwinagg,
+												  kfunc->v_scan[0]))[pos]
+					= (notnull ? ival : 0);
+			}
+		}
+	}
+}
+
+/*
+ * gpuwinagg_bounds_step
+ *
+ * A step of the Hillis-Steele scan by the distance @dist; it reads the
+ * @bank, then writes out the other bank. Head of the partition and of the
+ * peer group are prefix-max, the tails are suffix-min, and number of the
+ * peer groups is prefix-sum.
+ */
+DEVICE_FUNCTION(void)
+gpuwinagg_bounds_step(kern_gpuwinagg *kgwinagg,
+					  cl_uint dist,
+					  cl_int bank)
+{
+	const cl_uint *s_part_head = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_head[bank]);
+	const cl_uint *s_part_tail = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_tail[bank]);
+	const cl_uint *s_peer_head = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_head[bank]);
+	const cl_uint *s_peer_tail = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_tail[bank]);
+	const cl_uint *s_peer_count = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_count[bank]);
+	cl_uint	   *d_part_head = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_head[1 - bank]);
+	cl_uint	   *d_part_tail = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_tail[1 - bank]);
+	cl_uint	   *d_peer_head = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_head[1 - bank]);
+	cl_uint	   *d_peer_tail = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_tail[1 - bank]);
+	cl_uint	   *d_peer_count = (cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_count[1 - bank]);
+	cl_uint		nitems = kgwinagg->nitems;
+	cl_uint		pos;
+
+	/* quick bailout if any error happen in the prior kernel */
+	if (kgwinagg->kerror.errcode != 0)
+		return;
+	for (pos = get_global_id(); pos < nitems; pos += get_global_size())
+	{
+		if (pos >= dist)
+		{
+			d_part_head[pos] = Max(s_part_head[pos], s_part_head[pos - dist]);
+			d_peer_head[pos] = Max(s_peer_head[pos], s_peer_head[pos - dist]);
+			d_peer_count[pos] = s_peer_count[pos] + s_peer_count[pos - dist];
+		}
+		else
+		{
+			d_part_head[pos] = s_part_head[pos];
+			d_peer_head[pos] = s_peer_head[pos];
+			d_peer_count[pos] = s_peer_count[pos];
+		}
+
+		if (pos + dist < nitems)
+		{
+			d_part_tail[pos] = Min(s_part_tail[pos], s_part_tail[pos + dist]);
+			d_peer_tail[pos] = Min(s_peer_tail[pos], s_peer_tail[pos + dist]);
+		}
+		else
+		{
+			d_part_tail[pos] = s_part_tail[pos];
+			d_peer_tail[pos] = s_peer_tail[pos];
+		}
+	}
+}
+
+/*
+ * gpuwinagg_values_step
+ *
+ * A step of the segmented prefix-sum on the arguments of the aggregate
+ * functions. The partition boundary is already fixed on @bounds_bank.
+ */
+DEVICE_FUNCTION(void)
+gpuwinagg_values_step(kern_gpuwinagg *kgwinagg,
+					  cl_uint dist,
+					  cl_int bank,
+					  cl_int bounds_bank)
+{
+	const cl_uint *part_head = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_head[bounds_bank]);
+	cl_uint		nitems = kgwinagg->nitems;
+	cl_uint		pos;
+	cl_uint		i;
+
+	/* quick bailout if any error happen in the prior kernel */
+	if (kgwinagg->kerror.errcode != 0)
+		return;
+	for (pos = get_global_id(); pos < nitems; pos += get_global_size())
+	{
+		cl_bool		merge = (pos >= dist && pos - dist >= part_head[pos]);
+
+		for (i=0; i < kgwinagg->nfuncs; i++)
+		{
+			kern_gpuwinagg_func *kfunc = &kgwinagg->funcs[i];
+			const cl_uint *s_count;
+			cl_uint	   *d_count;
+
+			if (!GPUWINAGG_FUNC_IS_AGGREGATE(kfunc->func_kind))
+				continue;
+			s_count = (const cl_uint *)
+				KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->c_scan[bank]);
+			d_count = (cl_uint *)
+				KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->c_scan[1 - bank]);
+			d_count[pos] = s_count[pos] + (merge ? s_count[pos - dist] : 0);
+
+			if (kfunc->func_kind == GPUWINAGG_FUNC__SUM_FLOAT)
+			{
+				const cl_double *s_value = (const cl_double *)
+					KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->v_scan[bank]);
+				cl_double  *d_value = (cl_double *)
+					KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->v_scan[1 - bank]);
+
+				d_value[pos] = s_value[pos] + (merge ? s_value[pos - dist] : 0.0);
+			}
+			else if (kfunc->func_kind == GPUWINAGG_FUNC__SUM_INT)
+			{
+				const cl_long *s_value = (const cl_long *)
+					KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->v_scan[bank]);
+				cl_long	   *d_value = (cl_long *)
+					KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->v_scan[1 - bank]);
+
+				d_value[pos] = s_value[pos] + (merge ? s_value[pos - dist] : 0);
+			}
+		}
+	}
+}
+
+/*
+ * gpuwinagg_final
+ */
+DEVICE_FUNCTION(void)
+gpuwinagg_final(kern_gpuwinagg *kgwinagg,
+				cl_int bounds_bank,
+				cl_int values_bank)
+{
+	cl_uint		nitems = kgwinagg->nitems;
+	cl_uint		pos;
+
+	/* quick bailout if any error happen in the prior kernel */
+	if (kgwinagg->kerror.errcode != 0)
+		return;
+	for (pos = get_global_id(); pos < nitems; pos += get_global_size())
+		gpuwinagg_final_row(kgwinagg, pos, bounds_bank, values_bank);
+}
@@ -0,0 +1,304 @@
+/*
+ * cuda_gpuwinagg.h
+ *
+ * CUDA device code for GpuWindowAgg logic
+ * --
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef CUDA_GPUWINAGG_H
+#define CUDA_GPUWINAGG_H
+/*
+ * Window functions supported by GpuWindowAgg
+ */
+#define GPUWINAGG_FUNC__ROW_NUMBER		1	/* row_number() */
+#define GPUWINAGG_FUNC__RANK			2	/* rank() */
+#define GPUWINAGG_FUNC__DENSE_RANK		3	/* dense_rank() */
+#define GPUWINAGG_FUNC__SHIFT			4	/* lag(X)/lead(X); it returns
+											 * position of the source row */
+#define GPUWINAGG_FUNC__COUNT_ROWS		5	/* count(*) */
+#define GPUWINAGG_FUNC__COUNT			6	/* count(X) */
+#define GPUWINAGG_FUNC__SUM_INT			7	/* sum(int2), sum(int4) */
+#define GPUWINAGG_FUNC__SUM_FLOAT		8	/* sum(float4), sum(float8) */
+
+#define GPUWINAGG_FUNC_IS_AGGREGATE(func_kind)		\
+	((func_kind) == GPUWINAGG_FUNC__COUNT ||		\
+	 (func_kind) == GPUWINAGG_FUNC__SUM_INT ||		\
+	 (func_kind) == GPUWINAGG_FUNC__SUM_FLOAT)
+
+/*
+ * Boundary of the window frame
+ */
+#define GPUWINAGG_FRAME__UNBOUNDED		0	/* head/tail of the partition */
+#define GPUWINAGG_FRAME__ROWS			1	/* current row + offset */
+#define GPUWINAGG_FRAME__PEERS			2	/* head/tail of the peer group */
+
+/*
+ * kern_gpuwinagg_func - properties of a window function
+ *
+ * All the per-row buffers are indexed by the position on the sorted rows,
+ * and the scanned buffers have two banks for the ping-pong updates.
+ */
+typedef struct {
+	cl_int		func_kind;		/* one of GPUWINAGG_FUNC__* */
+	cl_int		start_kind;		/* one of GPUWINAGG_FRAME__* */
+	cl_int		end_kind;		/* one of GPUWINAGG_FRAME__* */
+	cl_int		start_offset;	/* offset of the frame start, or offset of
+								 * the source row of FUNC__SHIFT */
+	cl_int		end_offset;		/* offset of the frame end */
+	cl_int		__padding__;
+	/* offset of the per-row buffers from the head of kern_gpuwinagg */
+	cl_ulong	v_raw;			/* cl_long/cl_double [nitems] */
+	cl_ulong	v_scan[2];		/* cl_long/cl_double [nitems] */
+	cl_ulong	c_raw;			/* cl_uint [nitems]; number of non-null */
+	cl_ulong	c_scan[2];		/* cl_uint [nitems] */
+	cl_ulong	r_values;		/* cl_long/cl_double [nitems]; results */
+	cl_ulong	r_isnull;		/* cl_char [nitems]; results */
+} kern_gpuwinagg_func;
+
+/*
+ * kern_gpuwinagg - control object of GpuWindowAgg
+ *
+ * It references the rows sorted by the partition keys and the ordering
+ * keys on the gpusortResultIndex of kern_gpusort. Both of the head and
+ * the tail of the partition and of the peer group are computed for each
+ * row by the prefix-max/min scan, then segmented prefix-sum by the
+ * partitions makes the aggregation on the window frame.
+ */
+typedef struct {
+	kern_errorbuf	kerror;
+	cl_uint		nitems;			/* number of rows */
+	cl_int		part_nkeys;		/* number of the partition keys */
+	cl_int		peer_nkeys;		/* number of the partition + ordering keys */
+	cl_uint		nfuncs;			/* number of the window functions */
+	cl_ulong	length;			/* length of the whole buffer */
+	/* offset of the per-row buffers (cl_uint [nitems]) */
+	cl_ulong	part_head[2];
+	cl_ulong	part_tail[2];
+	cl_ulong	peer_head[2];
+	cl_ulong	peer_tail[2];
+	cl_ulong	peer_count[2];	/* number of peer groups by the row */
+	kern_gpuwinagg_func funcs[FLEXIBLE_ARRAY_MEMBER];
+} kern_gpuwinagg;
+
+#define KERN_GPUWINAGG_BUFFER(kgwinagg, offset)				\
+	((void *)((char *)(kgwinagg) + (offset)))
+
+/*
+ * gpuwinagg_final_row
+ *
+ * It computes the result of the window functions on the @pos'th row of
+ * the sorted rows. It is shared by the device kernel and CPU fallback.
+ */
+STATIC_INLINE(void)
+gpuwinagg_final_row(kern_gpuwinagg *kgwinagg, cl_uint pos,
+					cl_int bounds_bank, cl_int values_bank)
+{
+	const cl_uint  *part_head = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_head[bounds_bank]);
+	const cl_uint  *part_tail = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_tail[bounds_bank]);
+	const cl_uint  *peer_head = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_head[bounds_bank]);
+	const cl_uint  *peer_tail = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_tail[bounds_bank]);
+	const cl_uint  *peer_count = (const cl_uint *)
+		KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_count[bounds_bank]);
+	cl_long			p_head = part_head[pos];
+	cl_long			p_tail = part_tail[pos];
+	cl_uint			i;
+
+	for (i=0; i < kgwinagg->nfuncs; i++)
+	{
+		kern_gpuwinagg_func *kfunc = &kgwinagg->funcs[i];
+		cl_long	   *r_lvalues = (cl_long *)
+			KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->r_values);
+		cl_double  *r_fvalues = (cl_double *)
+			KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->r_values);
+		cl_char	   *r_isnull = (cl_char *)
+			KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->r_isnull);
+		cl_long		f_start;
+		cl_long		f_end;
+		cl_long		src;
+
+		r_isnull[pos] = false;
+		switch (kfunc->func_kind)
+		{
+			case GPUWINAGG_FUNC__ROW_NUMBER:
+				r_lvalues[pos] = (cl_long)pos - p_head + 1;
+				continue;
+			case GPUWINAGG_FUNC__RANK:
+				r_lvalues[pos] = (cl_long)peer_head[pos] - p_head + 1;
+				continue;
+			case GPUWINAGG_FUNC__DENSE_RANK:
+				r_lvalues[pos] = ((cl_long)peer_count[pos] -
+								  (cl_long)peer_count[p_head] + 1);
+				continue;
+			case GPUWINAGG_FUNC__SHIFT:
+				src = (cl_long)pos + (cl_long)kfunc->start_offset;
+				if (src >= p_head && src <= p_tail)
+					r_lvalues[pos] = src;
+				else
+					r_isnull[pos] = true;
+				continue;
+			default:
+				break;
+		}
+		/* Elsewhere, aggregate function on the window frame */
+		if (kfunc->start_kind == GPUWINAGG_FRAME__UNBOUNDED)
+			f_start = p_head;
+		else if (kfunc->start_kind == GPUWINAGG_FRAME__PEERS)
+			f_start = peer_head[pos];
+		else
+			f_start = Max((cl_long)pos + kfunc->start_offset, p_head);
+		if (kfunc->end_kind == GPUWINAGG_FRAME__UNBOUNDED)
+			f_end = p_tail;
+		else if (kfunc->end_kind == GPUWINAGG_FRAME__PEERS)
+			f_end = peer_tail[pos];
+		else
+			f_end = Min((cl_long)pos + kfunc->end_offset, p_tail);
+
+		if (kfunc->func_kind == GPUWINAGG_FUNC__COUNT_ROWS)
+		{
+			r_lvalues[pos] = (f_start <= f_end ? f_end - f_start + 1 : 0);
+		}
+		else if (f_start > f_end)
+		{
+			/* empty frame */
+			if (kfunc->func_kind == GPUWINAGG_FUNC__COUNT)
+				r_lvalues[pos] = 0;
+			else
+				r_isnull[pos] = true;
+		}
+		else
+		{
+			const cl_uint *c_scan = (const cl_uint *)
+				KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->c_scan[values_bank]);
+			cl_long		count = c_scan[f_end];
+
+			if (f_start > p_head)
+				count -= c_scan[f_start - 1];
+			if (kfunc->func_kind == GPUWINAGG_FUNC__COUNT)
+				r_lvalues[pos] = count;
+			else if (count == 0)
+				r_isnull[pos] = true;
+			else if (kfunc->func_kind == GPUWINAGG_FUNC__SUM_INT)
+			{
+				const cl_long *v_scan = (const cl_long *)
+					KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->v_scan[values_bank]);
+				cl_long		sum = v_scan[f_end];
+
+				if (f_start > p_head)
+					sum -= v_scan[f_start - 1];
+				r_lvalues[pos] = sum;
+			}
+			else if (f_start == p_head)
+			{
+				const cl_double *v_scan = (const cl_double *)
+					KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->v_scan[values_bank]);
+				r_fvalues[pos] = v_scan[f_end];
+			}
+			else
+			{
+				/*
+				 * Subtraction of the prefix-sum of floating-point values
+				 * loses precision, so sliding frame sums up the values
+				 * inside of the frame. Planner ensures the frame is
+				 * bounded by the offsets in this case.
+				 */
+				const cl_double *v_raw = (const cl_double *)
+					KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->v_raw);
+				cl_double	sum = 0.0;
+				cl_long		k;
+
+				for (k = f_start; k <= f_end; k++)
+					sum += v_raw[k];
+				r_fvalues[pos] = sum;
+			}
+		}
+	}
+}
+
+#ifdef __CUDACC__
+/*
+ * gpuwinagg_fetch_value - fetch the argument of the aggregate function
+ * on the @row_index of @kds_src. It returns false if it is NULL.
+ */
+DEVICE_FUNCTION(cl_bool)
+gpuwinagg_fetch_value(kern_context *kcxt,
+					  kern_data_store *kds_src,
+					  cl_uint row_index,
+					  cl_int fnum,
+					  cl_long *p_ival,
+					  cl_double *p_fval);
+/*
+ * GpuWindowAgg main logic
+ */
+DEVICE_FUNCTION(void)
+gpuwinagg_setup(kern_context *kcxt,
+				kern_gpusort *kgpusort,
+				kern_gpuwinagg *kgwinagg,
+				kern_data_store *kds_src);
+DEVICE_FUNCTION(void)
+gpuwinagg_bounds_step(kern_gpuwinagg *kgwinagg,
+					  cl_uint dist,
+					  cl_int bank);
+DEVICE_FUNCTION(void)
+gpuwinagg_values_step(kern_gpuwinagg *kgwinagg,
+					  cl_uint dist,
+					  cl_int bank,
+					  cl_int bounds_bank);
+DEVICE_FUNCTION(void)
+gpuwinagg_final(kern_gpuwinagg *kgwinagg,
+				cl_int bounds_bank,
+				cl_int values_bank);
+#endif	/* __CUDACC__ */
+
+#ifdef	__CUDACC_RTC__
+KERNEL_FUNCTION(void)
+kern_gpuwinagg_setup(kern_gpusort *kgpusort,
+					 kern_gpuwinagg *kgwinagg,
+					 kern_data_store *kds_src)
+{
+	DECL_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, &kgpusort->kparams);
+	gpuwinagg_setup(&u.kcxt, kgpusort, kgwinagg, kds_src);
+	kern_writeback_error_status(&kgwinagg->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuwinagg_bounds_step(kern_gpuwinagg *kgwinagg,
+						   cl_uint dist,
+						   cl_int bank)
+{
+	gpuwinagg_bounds_step(kgwinagg, dist, bank);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuwinagg_values_step(kern_gpuwinagg *kgwinagg,
+						   cl_uint dist,
+						   cl_int bank,
+						   cl_int bounds_bank)
+{
+	gpuwinagg_values_step(kgwinagg, dist, bank, bounds_bank);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuwinagg_final(kern_gpuwinagg *kgwinagg,
+					 cl_int bounds_bank,
+					 cl_int values_bank)
+{
+	gpuwinagg_final(kgwinagg, bounds_bank, values_bank);
+}
+#endif	/* __CUDACC_RTC__ */
+#endif	/* CUDA_GPUWINAGG_H */
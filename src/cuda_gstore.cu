@@ -417,14 +417,88 @@ skip:
 	kern_writeback_error_status(&redo->kerror, &kcxt);
 }
 
+/*
+ * __gpustore_dict_lookup
+ *
+ * It looks up the slot of dictionary that has the identical varlena value
+ * with the one at 'old_offset'. If 'p_is_owner' is given, the value shall
+ * be inserted unless found, and '*p_is_owner' informs whether the caller
+ * has inserted it, thus, is responsible to copy the value.
+ */
+STATIC_FUNCTION(cl_uint)
+__gpustore_dict_lookup(kern_gpustore_dictionary *dict,
+					   kern_data_extra *old_extra,
+					   cl_uint old_offset,
+					   cl_bool *p_is_owner)
+{
+	const cl_uchar *vl_data = (const cl_uchar *)
+		((char *)old_extra + __kds_unpack(old_offset));
+	cl_uint		vl_size = VARSIZE_ANY(vl_data);
+	cl_uint		hash = 0x811c9dc5U;		/* FNV-1a */
+	cl_uint		index;
+
+	for (cl_uint i=0; i < vl_size; i++)
+		hash = (hash ^ vl_data[i]) * 0x01000193U;
+
+	for (index = hash % dict->nslots; ; index = (index + 1) % dict->nslots)
+	{
+		kern_gpustore_dict_slot *slot = &dict->slots[index];
+		const cl_uchar *curr;
+		cl_uint		curr_offset = slot->old_offset;
+
+		if (curr_offset == 0)
+		{
+			if (!p_is_owner)
+				return UINT_MAX;	/* not found */
+			curr_offset = atomicCAS(&slot->old_offset, 0, old_offset);
+			if (curr_offset == 0)
+			{
+				*p_is_owner = true;
+				return index;
+			}
+		}
+		if (curr_offset == old_offset)
+			break;
+		curr = (const cl_uchar *)((char *)old_extra + __kds_unpack(curr_offset));
+		if (VARSIZE_ANY(curr) == vl_size)
+		{
+			cl_uint		i;
+
+			for (i=0; i < vl_size && curr[i] == vl_data[i]; i++);
+			if (i == vl_size)
+				break;
+		}
+	}
+	if (p_is_owner)
+		*p_is_owner = false;
+	return index;
+}
+
+#define GSTORE_DICT_COLUMN(dict,j)									\
+	((dict) != NULL && ((dict)->columns[(j)>>5] & (1U << ((j) & 0x1f))) != 0)
+
+/*
+ * kern_gpustore_compaction
+ *
+ * It copies the live varlena values to the new extra buffer. If 'new_values'
+ * is not NULL, the new offsets are written to 'new_values' (nrooms entries
+ * per varlena column) instead of the main buffer, so concurrent readers can
+ * keep reading the old extra buffer until kern_gpustore_compaction_switch.
+ * If 'dict' is given, the identical values of the dictionary-compressed
+ * columns are copied only once, then kern_gpustore_compaction_dict assigns
+ * the offsets of these columns.
+ */
 KERNEL_FUNCTION(void)
 kern_gpustore_compaction(kern_data_store *kds,
 						 kern_data_extra *old_extra,
-						 kern_data_extra *new_extra)
+						 kern_data_extra *new_extra,
+						 cl_uint *new_values,
+						 kern_gpustore_dictionary *dict)
 {
 	__shared__ cl_uint required;
 	__shared__ cl_ulong extra_base;
 	cl_uint		nloops;
+	cl_uint		vindex;
 
 	nloops = (kds->nitems + get_global_size() - 1) / get_global_size();
 	for (int loop=0; loop < nloops; loop++)
@@ -432,14 +506,18 @@ kern_gpustore_compaction(kern_data_store *kds,
 		cl_uint		rowid = get_global_id() + loop * get_global_size();
 		GstoreFdwSysattr *sysattr = kds_get_column_sysattr(kds, rowid);
 
+		vindex = 0;
 		for (int j=0; j < kds->ncols-1; j++)
 		{
 			kern_colmeta *cmeta = &kds->colmeta[j];
 			cl_bool		isnull = false;
 			cl_uint	   *values;
+			cl_uint	   *dest_values;
 			char	   *orig = NULL;
 			char	   *dest;
 			cl_uint		sz, l_off = 0;
+			cl_uint		dindex = UINT_MAX;
+			cl_bool		is_owner = true;
 
 			if (cmeta->attbyval || cmeta->attlen != -1)
 				continue;			/* not varlena */
@@ -456,7 +534,12 @@ kern_gpustore_compaction(kern_data_store *kds,
 					isnull = true;
 			}
 			values = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
-			
+			if (!new_values)
+				dest_values = values;
+			else
+				dest_values = new_values + (size_t)kds->nrooms * vindex;
+			vindex++;
+
 			/* copy the varlena to new extra buffer */
 			if (get_local_id() == 0)
 				required = 0;
@@ -467,7 +550,12 @@ kern_gpustore_compaction(kern_data_store *kds,
 				sz = VARSIZE_ANY(orig);
 				assert(orig > (char *)old_extra &&
 					   orig + sz <= (char *)old_extra + old_extra->length);
-				l_off = atomicAdd(&required, MAXALIGN(sz));
+				if (GSTORE_DICT_COLUMN(dict, j))
+					dindex = __gpustore_dict_lookup(dict, old_extra,
+													values[rowid],
+													&is_owner);
+				if (is_owner)
+					l_off = atomicAdd(&required, MAXALIGN(sz));
 			}
 			__syncthreads();
 			if (get_local_id() == 0)
@@ -477,12 +565,19 @@ kern_gpustore_compaction(kern_data_store *kds,
 			if (isnull)
 			{
 				if (rowid < kds->nitems)
-					values[rowid] = 0;
+					dest_values[rowid] = 0;
+			}
+			else if (!is_owner)
+			{
+				/* kern_gpustore_compaction_dict assigns the offset */
 			}
 			else if (dest + sz <= (char *)new_extra + new_extra->length)
 			{
 				memcpy(dest, orig, sz);
-				values[rowid] = __kds_packed((char *)dest - (char *)new_extra);
+				if (dindex == UINT_MAX)
+					dest_values[rowid] = __kds_packed((char *)dest - (char *)new_extra);
+				else
+					dict->slots[dindex].new_offset = __kds_packed((char *)dest - (char *)new_extra);
 			}
 			else
 			{
@@ -491,3 +586,378 @@ kern_gpustore_compaction(kern_data_store *kds,
 		}
 	}
 }
+
+/*
+ * kern_gpustore_compaction_dict
+ *
+ * It assigns the offsets of the de-duplicated values in the new extra buffer
+ * to the rows of the dictionary-compressed columns.
+ */
+KERNEL_FUNCTION(void)
+kern_gpustore_compaction_dict(kern_data_store *kds,
+							  kern_data_extra *old_extra,
+							  cl_uint *new_values,
+							  kern_gpustore_dictionary *dict)
+{
+	cl_uint		vindex = 0;
+
+	for (int j=0; j < kds->ncols-1; j++)
+	{
+		kern_colmeta *cmeta = &kds->colmeta[j];
+		cl_uint	   *nullmap = NULL;
+		cl_uint	   *values;
+		cl_uint	   *dest_values;
+
+		if (cmeta->attbyval || cmeta->attlen != -1)
+			continue;			/* not varlena */
+		values = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
+		if (!new_values)
+			dest_values = values;
+		else
+			dest_values = new_values + (size_t)kds->nrooms * vindex;
+		vindex++;
+		if (!GSTORE_DICT_COLUMN(dict, j))
+			continue;
+		if (cmeta->nullmap_offset != 0)
+			nullmap = (cl_uint *)((char *)kds + __kds_unpack(cmeta->nullmap_offset));
+
+		for (cl_uint rowid = get_global_id();
+			 rowid < kds->nitems;
+			 rowid += get_global_size())
+		{
+			GstoreFdwSysattr *sysattr = kds_get_column_sysattr(kds, rowid);
+			cl_uint		dindex;
+
+			if (sysattr->xmin == InvalidTransactionId)
+				continue;		/* rows already removed */
+			if (nullmap && (nullmap[rowid>>5] & (1U << (rowid & 0x1f))) == 0)
+				continue;		/* NULL */
+			dindex = __gpustore_dict_lookup(dict, old_extra,
+											values[rowid], NULL);
+			assert(dindex < dict->nslots);
+			if (dindex < dict->nslots)
+				dest_values[rowid] = dict->slots[dindex].new_offset;
+		}
+	}
+}
+
+/*
+ * kern_gpustore_compaction_switch
+ *
+ * It writes back the offsets built by kern_gpustore_compaction to the main
+ * buffer. Caller must block readers, then switch the extra buffer.
+ */
+KERNEL_FUNCTION(void)
+kern_gpustore_compaction_switch(kern_data_store *kds,
+								cl_uint *new_values)
+{
+	cl_uint		vindex = 0;
+
+	for (int j=0; j < kds->ncols-1; j++)
+	{
+		kern_colmeta *cmeta = &kds->colmeta[j];
+		cl_uint	   *values;
+		cl_uint	   *src_values;
+
+		if (cmeta->attbyval || cmeta->attlen != -1)
+			continue;			/* not varlena */
+		values = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
+		src_values = new_values + (size_t)kds->nrooms * vindex;
+		for (cl_uint rowid = get_global_id();
+			 rowid < kds->nitems;
+			 rowid += get_global_size())
+		{
+			values[rowid] = src_values[rowid];
+		}
+		vindex++;
+	}
+}
+
+/*
+ * __gpustore_aggview_datum
+ *
+ * It fetches a value of the grouping key or the aggregate target. Keys are
+ * compared as is; integer and floating-point inputs of the aggregate
+ * functions are extended to int64 or float8.
+ */
+STATIC_FUNCTION(cl_ulong)
+__gpustore_aggview_datum(kern_data_store *kds,
+						 kern_data_extra *extra,
+						 kern_gpustore_aggview_attr *attr,
+						 cl_uint rowid,
+						 cl_bool *p_isnull)
+{
+	Datum		datum;
+
+	if (attr->colidx < 0)
+	{
+		*p_isnull = false;		/* count(*) */
+		return 0;
+	}
+	datum = kern_datum_get_column(kds, extra, attr->colidx, rowid, p_isnull);
+	if (*p_isnull || attr->aggfunc == 0 || attr->aggfunc == GSTORE_AGGFUNC__COUNT)
+		return (cl_ulong)datum;
+	if (attr->attfp)
+	{
+		cl_double	fval;
+
+		if (attr->attlen == sizeof(cl_float))
+			fval = (cl_double)__int_as_float((cl_uint)(datum & 0xffffffffU));
+		else
+			fval = __longlong_as_double((cl_ulong)datum);
+		return __double_as_longlong(fval);
+	}
+	switch (attr->attlen)
+	{
+		case sizeof(cl_char):
+			return (cl_ulong)((cl_long)((cl_char)datum));
+		case sizeof(cl_short):
+			return (cl_ulong)((cl_long)((cl_short)datum));
+		case sizeof(cl_int):
+			return (cl_ulong)((cl_long)((cl_int)datum));
+		default:
+			return (cl_ulong)datum;
+	}
+}
+
+/*
+ * __gpustore_aggview_lookup
+ *
+ * It looks up the group of the supplied keys. If 'create' is true, a new
+ * group shall be inserted unless found. NULL means out of the groups.
+ */
+STATIC_FUNCTION(kern_gpustore_aggview_group *)
+__gpustore_aggview_lookup(kern_gpustore_aggview *aggview,
+						  cl_ulong *keys, cl_uint key_nulls,
+						  cl_bool create)
+{
+	cl_uint	   *slots = KERN_GPUSTORE_AGGVIEW_SLOTS(aggview);
+	kern_gpustore_aggview_group *groups = KERN_GPUSTORE_AGGVIEW_GROUPS(aggview);
+	kern_gpustore_aggview_group *group;
+	cl_uint		hash = 0x811c9dc5U ^ key_nulls;		/* FNV-1a */
+	cl_uint		gindex_new = UINT_MAX;
+	cl_uint		gindex;
+	cl_uint		head;
+	cl_uint		index;
+	int			i, k;
+
+	for (k=0; k < aggview->nkeys; k++)
+	{
+		hash = (hash ^ (cl_uint)(keys[k] & 0xffffffffU)) * 0x01000193U;
+		hash = (hash ^ (cl_uint)(keys[k] >> 32)) * 0x01000193U;
+	}
+	index = hash % aggview->nslots;
+	head = ((volatile cl_uint *)slots)[index];
+	for (;;)
+	{
+		for (gindex = head; gindex != UINT_MAX; gindex = group->next)
+		{
+			group = &groups[gindex];
+			if (group->hash != hash || group->key_nulls != key_nulls)
+				continue;
+			for (k=0; k < aggview->nkeys; k++)
+			{
+				if (group->keys[k] != keys[k])
+					break;
+			}
+			if (k == aggview->nkeys)
+				return group;
+		}
+		if (!create)
+			return NULL;
+
+		/* allocation of a new group */
+		if (gindex_new == UINT_MAX)
+		{
+			gindex_new = atomicAdd(&aggview->nitems, 1);
+			if (gindex_new >= aggview->nrooms)
+			{
+				atomicExch(&aggview->overflow, 1);
+				atomicExch(&aggview->needs_rebuild, 1);
+				return NULL;
+			}
+			group = &groups[gindex_new];
+			group->hash = hash;
+			group->nrows = 0;
+			group->key_nulls = key_nulls;
+			for (k=0; k < aggview->nkeys; k++)
+				group->keys[k] = keys[k];
+			for (i=0; i < aggview->ntargets; i++)
+			{
+				kern_gpustore_aggview_attr *attr = &aggview->targets[i];
+
+				group->counts[i] = 0;
+				if (attr->aggfunc == GSTORE_AGGFUNC__MIN)
+					group->values[i] = (attr->attfp
+										? __double_as_longlong(DBL_INFINITY)
+										: (cl_ulong)LONG_MAX);
+				else if (attr->aggfunc == GSTORE_AGGFUNC__MAX)
+					group->values[i] = (attr->attfp
+										? __double_as_longlong(-DBL_INFINITY)
+										: (cl_ulong)LONG_MIN);
+				else
+					group->values[i] = 0;
+			}
+		}
+		group = &groups[gindex_new];
+		group->next = head;
+		__threadfence();
+		index = hash % aggview->nslots;
+		gindex = atomicCAS(&slots[index], head, gindex_new);
+		if (gindex == head)
+			return group;
+		/* someone inserted a group concurrently, so check again */
+		head = gindex;
+	}
+}
+
+/*
+ * __gpustore_aggview_update
+ *
+ * It accumulates (sign > 0) or removes (sign < 0) the row to/from the group.
+ * MIN/MAX cannot be reverted; unless the removed value is larger (smaller)
+ * than the current MIN (MAX), the view needs to be rebuilt.
+ */
+STATIC_FUNCTION(void)
+__gpustore_aggview_update(kern_data_store *kds,
+						  kern_data_extra *extra,
+						  kern_gpustore_aggview *aggview,
+						  cl_uint rowid, cl_int sign)
+{
+	kern_gpustore_aggview_group *group;
+	cl_ulong	keys[GSTORE_AGGVIEW_MAX_KEYS];
+	cl_uint		key_nulls = 0;
+	cl_ulong	value;
+	cl_bool		isnull;
+	int			i, k;
+
+	for (k=0; k < aggview->nkeys; k++)
+	{
+		keys[k] = __gpustore_aggview_datum(kds, extra,
+										   &aggview->keys[k],
+										   rowid, &isnull);
+		if (isnull)
+			key_nulls |= (1U << k);
+	}
+	group = __gpustore_aggview_lookup(aggview, keys, key_nulls, sign > 0);
+	if (!group)
+	{
+		/* overflow, or the group to be removed is missing */
+		atomicExch(&aggview->needs_rebuild, 1);
+		return;
+	}
+	atomicAdd((cl_ulong *)&group->nrows, (cl_ulong)((cl_long)sign));
+
+	for (i=0; i < aggview->ntargets; i++)
+	{
+		kern_gpustore_aggview_attr *attr = &aggview->targets[i];
+
+		if (attr->aggfunc == GSTORE_AGGFUNC__NROWS)
+			continue;
+		value = __gpustore_aggview_datum(kds, extra, attr, rowid, &isnull);
+		if (isnull)
+			continue;
+		atomicAdd((cl_ulong *)&group->counts[i], (cl_ulong)((cl_long)sign));
+		switch (attr->aggfunc)
+		{
+			case GSTORE_AGGFUNC__SUM:
+				if (attr->attfp)
+					atomicAdd((cl_double *)&group->values[i],
+							  (cl_double)sign * __longlong_as_double(value));
+				else
+					atomicAdd(&group->values[i],
+							  (cl_ulong)((cl_long)sign * (cl_long)value));
+				break;
+			case GSTORE_AGGFUNC__MIN:
+				if (sign > 0)
+				{
+					if (!attr->attfp)
+						atomicMin((cl_long *)&group->values[i], (cl_long)value);
+					else
+					{
+						cl_ulong	curval = group->values[i];
+						cl_ulong	oldval;
+
+						do {
+							oldval = curval;
+							if (__longlong_as_double(oldval) <= __longlong_as_double(value))
+								break;
+						} while ((curval = atomicCAS(&group->values[i],
+													 oldval, value)) != oldval);
+					}
+				}
+				else if (attr->attfp
+						 ? !(__longlong_as_double(value) >
+							 __longlong_as_double(group->values[i]))
+						 : !((cl_long)value > (cl_long)group->values[i]))
+					atomicExch(&aggview->needs_rebuild, 1);
+				break;
+			case GSTORE_AGGFUNC__MAX:
+				if (sign > 0)
+				{
+					if (!attr->attfp)
+						atomicMax((cl_long *)&group->values[i], (cl_long)value);
+					else
+					{
+						cl_ulong	curval = group->values[i];
+						cl_ulong	oldval;
+
+						do {
+							oldval = curval;
+							if (__longlong_as_double(oldval) >= __longlong_as_double(value))
+								break;
+						} while ((curval = atomicCAS(&group->values[i],
+													 oldval, value)) != oldval);
+					}
+				}
+				else if (attr->attfp
+						 ? !(__longlong_as_double(value) <
+							 __longlong_as_double(group->values[i]))
+						 : !((cl_long)value < (cl_long)group->values[i]))
+					atomicExch(&aggview->needs_rebuild, 1);
+				break;
+			default:
+				/* GSTORE_AGGFUNC__COUNT */
+				break;
+		}
+	}
+}
+
+/*
+ * kern_gpustore_aggview_update
+ *
+ * It adds (sign > 0) or removes (sign < 0) the committed rows listed on
+ * 'rowids' to/from the aggregate view. The maintainer removes the rows to
+ * be modified by the redo logs prior to the apply, then adds them again
+ * after the apply, so the view follows the visibility changes exactly,
+ * even if a part of logs are already reflected on the initial load.
+ * If 'rowids' is NULL, all the committed rows are accumulated to rebuild
+ * the view.
+ */
+KERNEL_FUNCTION(void)
+kern_gpustore_aggview_update(kern_data_store *kds,
+							 kern_data_extra *extra,
+							 kern_gpustore_aggview *aggview,
+							 cl_uint *rowids,
+							 cl_uint nitems,
+							 cl_int sign)
+{
+	/* bailout if the aggregate view is already invalid */
+	if (aggview->needs_rebuild)
+		return;
+
+	for (cl_uint index = get_global_id();
+		 index < nitems;
+		 index += get_global_size())
+	{
+		GstoreFdwSysattr *sysattr;
+		cl_uint		rowid = (rowids ? rowids[index] : index);
+
+		if (rowid >= kds->nitems)
+			continue;
+		sysattr = kds_get_column_sysattr(kds, rowid);
+		if (sysattr->xmin != FrozenTransactionId)
+			continue;		/* not committed */
+		__gpustore_aggview_update(kds, extra, aggview, rowid, sign);
+	}
+}
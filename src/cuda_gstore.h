@@ -232,4 +232,91 @@ typedef struct
 	cl_uint			log_index[FLEXIBLE_ARRAY_MEMBER];
 } kern_gpustore_redolog;
 
+/*
+ * kern_gpustore_dictionary
+ *
+ * Hash table to de-duplicate varlena values of the dictionary-compressed
+ * columns on compaction. A slot keeps offset of the first value in the old
+ * extra buffer (zero, if empty), and its offset in the new extra buffer.
+ */
+#define GSTORE_DICT_MAX_COLUMNS		1600	/* = MaxHeapAttributeNumber */
+
+typedef struct
+{
+	cl_uint			old_offset;
+	cl_uint			new_offset;
+} kern_gpustore_dict_slot;
+
+typedef struct
+{
+	cl_uint			nslots;
+	cl_uint			columns[(GSTORE_DICT_MAX_COLUMNS + 31) / 32];
+	kern_gpustore_dict_slot slots[FLEXIBLE_ARRAY_MEMBER];
+} kern_gpustore_dictionary;
+
+/*
+ * kern_gpustore_aggview
+ *
+ * Aggregate view (COUNT/SUM/MIN/MAX grouped by the fixed-length keys) kept
+ * on the device memory, and maintained by the rows modified by redo logs.
+ * The header is followed by the hash slots (nslots), then the groups
+ * (nrooms). Only the header and the groups are copied to the host snapshot.
+ */
+#define GSTORE_AGGVIEW_MAX_KEYS		8
+#define GSTORE_AGGVIEW_MAX_TARGETS	16
+#define GSTORE_AGGVIEW_MAX_GROUPS	1000000
+
+#define GSTORE_AGGFUNC__NROWS		1	/* count(*) */
+#define GSTORE_AGGFUNC__COUNT		2	/* count(X) */
+#define GSTORE_AGGFUNC__SUM			3
+#define GSTORE_AGGFUNC__MIN			4
+#define GSTORE_AGGFUNC__MAX			5
+
+typedef struct
+{
+	cl_short		colidx;		/* column index or -1 for count(*) */
+	cl_short		attlen;		/* 1, 2, 4 or 8 */
+	cl_bool			attfp;		/* true, if float4 or float8 */
+	cl_char			aggfunc;	/* one of GSTORE_AGGFUNC__*, or 0 for keys */
+	cl_short		__padding__;
+	cl_uint			atttypid;	/* used by host code only */
+} kern_gpustore_aggview_attr;
+
+typedef struct
+{
+	cl_uint			next;		/* next group on the hash chain */
+	cl_uint			hash;
+	cl_long			nrows;		/* number of rows in this group */
+	cl_uint			key_nulls;	/* bitmap of NULL keys */
+	cl_uint			__padding__;
+	cl_ulong		keys[GSTORE_AGGVIEW_MAX_KEYS];
+	cl_long			counts[GSTORE_AGGVIEW_MAX_TARGETS];	/* non-NULL inputs */
+	cl_ulong		values[GSTORE_AGGVIEW_MAX_TARGETS];	/* int64 or float8 */
+} kern_gpustore_aggview_group;
+
+typedef struct
+{
+	cl_uint			nkeys;
+	cl_uint			ntargets;
+	cl_uint			nslots;
+	cl_uint			nrooms;
+	cl_uint			nitems;
+	cl_uint			needs_rebuild;	/* MIN/MAX may be stale, or overflow */
+	cl_uint			overflow;		/* more groups than nrooms */
+	cl_uint			is_valid;		/* used by host code only */
+	kern_gpustore_aggview_attr keys[GSTORE_AGGVIEW_MAX_KEYS];
+	kern_gpustore_aggview_attr targets[GSTORE_AGGVIEW_MAX_TARGETS];
+} kern_gpustore_aggview;
+
+#define KERN_GPUSTORE_AGGVIEW_SLOTS(aggview)						\
+	((cl_uint *)((char *)(aggview) + MAXALIGN(sizeof(kern_gpustore_aggview))))
+#define KERN_GPUSTORE_AGGVIEW_GROUPS(aggview)						\
+	((kern_gpustore_aggview_group *)								\
+	 ((char *)KERN_GPUSTORE_AGGVIEW_SLOTS(aggview) +				\
+	  MAXALIGN(sizeof(cl_uint) * (aggview)->nslots)))
+#define KERN_GPUSTORE_AGGVIEW_LENGTH(nslots,nrooms)					\
+	(MAXALIGN(sizeof(kern_gpustore_aggview)) +						\
+	 MAXALIGN(sizeof(cl_uint) * (nslots)) +							\
+	 sizeof(kern_gpustore_aggview_group) * (size_t)(nrooms))
+
 #endif /* CUDA_GSTORE_H */
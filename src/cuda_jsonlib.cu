@@ -823,6 +823,164 @@ pgfn_jsonb_exists(kern_context *kcxt,
 	return result;
 }
 
+/*
+ * __lookupJsonbPath
+ *
+ * It walks down the nested containers along the path elements (text[]) at
+ * once, then returns the container, index and base pointer of the item
+ * pointed by the last path element. It follows the semantics of
+ * get_jsonb_path_all() at the host side; a path element that does not
+ * match returns NULL.
+ */
+STATIC_FUNCTION(cl_bool)
+__parseJsonbPathIndex(const char *str, cl_int len, cl_int *p_index)
+{
+	const char *end = str + len;
+	cl_long		lindex = 0;
+	cl_bool		negative = false;
+	cl_bool		has_digit = false;
+
+	/* same as strtol(); leading white spaces and sign */
+	while (str < end && (*str == ' '  || *str == '\t' || *str == '\n' ||
+						 *str == '\v' || *str == '\f' || *str == '\r'))
+		str++;
+	if (str < end && (*str == '+' || *str == '-'))
+		negative = (*str++ == '-');
+	while (str < end && *str >= '0' && *str <= '9')
+	{
+		lindex = 10 * lindex + (*str++ - '0');
+		if (lindex > (cl_long)INT_MAX + 1)
+			return false;		/* out of range */
+		has_digit = true;
+	}
+	if (!has_digit || str != end)
+		return false;
+	if (negative)
+		lindex = -lindex;
+	if (lindex > INT_MAX || lindex < INT_MIN)
+		return false;
+	*p_index = (cl_int)lindex;
+	return true;
+}
+
+STATIC_FUNCTION(cl_bool)
+__lookupJsonbPath(kern_context *kcxt,
+				  pg_jsonb_t arg1, pg_array_t arg2,
+				  JsonbContainer **p_jc, cl_int *p_index, char **p_base)
+{
+	JsonbContainer *jc;
+	char	   *jdata;
+	cl_int		jlen;
+	char	   *base;
+	char	   *nullmap;
+	char	   *pos;
+	cl_int		i, ndim, nitems;
+	cl_int		index;
+
+	if (!pg_varlena_datum_extract(kcxt, arg1, &jdata, &jlen) || arg2.isnull)
+		return false;
+	if (arg2.length >= 0)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "jsonb path by Arrow::List is not supported");
+		return false;
+	}
+	ndim = ARR_NDIM(arg2.value);
+	for (i=0, nitems = (ndim > 0 ? 1 : 0); i < ndim; i++)
+		nitems *= __Fetch(ARR_DIMS(arg2.value) + i);
+	if (nitems == 0)
+	{
+		/* empty path returns the jsonb itself; let the CPU handle it */
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "empty jsonb path is not supported");
+		return false;
+	}
+	nullmap = ARR_NULLBITMAP(arg2.value);
+	pos = ARR_DATA_PTR(arg2.value);
+	jc = (JsonbContainer *)jdata;
+	for (i=0; i < nitems; i++)
+	{
+		cl_uint		jheader = __Fetch(&jc->header);
+		cl_uint		count = JsonContainerSize(jheader);
+		char	   *key;
+		cl_int		keylen;
+		JEntry		entry;
+
+		if (nullmap && (nullmap[i>>3] & (1<<(i & 7))) == 0)
+			return false;
+		key = VARDATA_ANY(pos);
+		keylen = VARSIZE_ANY_EXHDR(pos);
+		pos += INTALIGN(VARSIZE_ANY(pos));
+
+		if (JsonContainerIsObject(jheader))
+		{
+			base = (char *)(jc->children + 2 * count);
+			index = findJsonbIndexFromObject(jc, key, keylen);
+			if (index < 0 || index >= count)
+				return false;
+			index += count;	/* index now points one of values, not keys */
+		}
+		else if (JsonContainerIsArray(jheader) &&
+				 !JsonContainerIsScalar(jheader))
+		{
+			base = (char *)(jc->children + count);
+			if (!__parseJsonbPathIndex(key, keylen, &index))
+				return false;
+			if (index < 0)
+				index += count;	/* index from the tail, if negative */
+			if (index < 0 || index >= count)
+				return false;
+		}
+		else
+			return false;	/* scalar, no more path to walk down */
+
+		if (i == nitems - 1)
+		{
+			*p_jc = jc;
+			*p_index = index;
+			*p_base = base;
+			return true;
+		}
+		entry = __Fetch(&jc->children[index]);
+		if (!JBE_ISCONTAINER(entry))
+			return false;
+		jc = (JsonbContainer *)(base + INTALIGN(getJsonbOffset(jc, index)));
+	}
+	return false;
+}
+
+DEVICE_FUNCTION(pg_jsonb_t)
+pgfn_jsonb_extract_path(kern_context *kcxt,
+						pg_jsonb_t arg1, pg_array_t arg2)
+{
+	pg_jsonb_t	result;
+	JsonbContainer *jc;
+	cl_int		index;
+	char	   *base;
+
+	if (!__lookupJsonbPath(kcxt, arg1, arg2, &jc, &index, &base))
+		result.isnull = true;
+	else
+		result = extractJsonbItemFromContainer(kcxt, jc, index, base);
+	return result;
+}
+
+DEVICE_FUNCTION(pg_text_t)
+pgfn_jsonb_extract_path_text(kern_context *kcxt,
+							 pg_jsonb_t arg1, pg_array_t arg2)
+{
+	pg_text_t	result;
+	JsonbContainer *jc;
+	cl_int		index;
+	char	   *base;
+
+	if (!__lookupJsonbPath(kcxt, arg1, arg2, &jc, &index, &base))
+		result.isnull = true;
+	else
+		result = extractTextItemFromContainer(kcxt, jc, index, base);
+	return result;
+}
+
 /*
  * Special shortcut for CoerceViaIO; fetch jsonb element as numeric values
  */
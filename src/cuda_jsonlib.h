@@ -45,6 +45,12 @@ pgfn_jsonb_array_element_text(kern_context *kcxt,
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_jsonb_exists(kern_context *kcxt,
 				  pg_jsonb_t arg1, pg_text_t arg2);
+DEVICE_FUNCTION(pg_jsonb_t)
+pgfn_jsonb_extract_path(kern_context *kcxt,
+						pg_jsonb_t arg1, pg_array_t arg2);
+DEVICE_FUNCTION(pg_text_t)
+pgfn_jsonb_extract_path_text(kern_context *kcxt,
+							 pg_jsonb_t arg1, pg_array_t arg2);
 /* special shortcut for CoerceViaIO; fetch jsonb element as numeric values */
 DEVICE_FUNCTION(pg_numeric_t)
 pgfn_jsonb_object_field_as_numeric(kern_context *kcxt,
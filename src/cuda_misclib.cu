@@ -642,10 +642,14 @@ pg_inet_param(kern_context *kcxt, cl_uint param_id)
 	return pg_inet_datum_ref(kcxt,paddr);
 }
 
+/*
+ * pg_comp_hash - compatible to hashinet(); family, bits and the address
+ * part according to the family
+ */
 DEVICE_FUNCTION(cl_uint)
 pg_comp_hash(kern_context *kcxt, pg_inet_t datum)
 {
-	if (!datum.isnull)
+	if (datum.isnull)
 		return 0;
 	if (datum.value.family == PGSQL_AF_INET)
 		return pg_hash_any((cl_uchar *)&datum.value,
@@ -2012,3 +2016,330 @@ pgfn_tan(kern_context *kcxt, pg_float8_t arg1)
 	}
 	return result;
 }
+
+/*
+ * Array functions
+ *
+ * NOTE: Arrow::List is always an one-dimensional array, and @length is
+ * number of the elements. Elsewhere, @value points a PostgreSQL array.
+ */
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_array_ndims(kern_context *kcxt, pg_array_t arg1)
+{
+	pg_int4_t	result;
+
+	result.isnull = arg1.isnull;
+	if (!arg1.isnull)
+	{
+		if (arg1.length >= 0)
+			result.value = 1;
+		else if (ARR_NDIM(arg1.value) <= 0)
+			result.isnull = true;
+		else
+			result.value = ARR_NDIM(arg1.value);
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_array_length(kern_context *kcxt, pg_array_t arg1, pg_int4_t arg2)
+{
+	pg_int4_t	result;
+
+	result.isnull = (arg1.isnull | arg2.isnull);
+	if (!result.isnull)
+	{
+		if (arg1.length >= 0)
+		{
+			if (arg2.value != 1)
+				result.isnull = true;
+			else
+				result.value = arg1.length;
+		}
+		else if (ARR_NDIM(arg1.value) <= 0 ||
+				 arg2.value < 1 ||
+				 arg2.value > ARR_NDIM(arg1.value))
+			result.isnull = true;
+		else
+			result.value = __Fetch(ARR_DIMS(arg1.value) + arg2.value - 1);
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_cardinality(kern_context *kcxt, pg_array_t arg1)
+{
+	pg_int4_t	result;
+
+	result.isnull = arg1.isnull;
+	if (!arg1.isnull)
+	{
+		if (arg1.length >= 0)
+			result.value = arg1.length;
+		else
+			result.value = ArrayGetNItems(kcxt,
+										  ARR_NDIM(arg1.value),
+										  ARR_DIMS(arg1.value));
+	}
+	return result;
+}
+
+/*
+ * Vector distance functions
+ *
+ * One-dimensional arrays of float2/float4/float8 are considered as vectors,
+ * on both of PostgreSQL array and Arrow::List. Computation is done in
+ * float8, regardless of the element type.
+ */
+typedef struct
+{
+	char	   *base;
+	cl_uint		nitems;
+	cl_uint		start;		/* only Arrow::List */
+	cl_uint		elemtype;
+	kern_colmeta *smeta;	/* only Arrow::List */
+} vectorDatum;
+
+STATIC_FUNCTION(cl_bool)
+__vector_datum_setup(kern_context *kcxt, vectorDatum *vec, pg_array_t *arg)
+{
+	if (arg->length < 0)
+	{
+		/* PG Array */
+		char	   *array = arg->value;
+
+		if (ARR_NDIM(array) > 1)
+		{
+			STROM_EREPORT(kcxt, ERRCODE_DATA_EXCEPTION,
+						  "vector must be one-dimensional array");
+			return false;
+		}
+		if (ARR_HASNULL(array))
+		{
+			STROM_EREPORT(kcxt, ERRCODE_NULL_VALUE_NOT_ALLOWED,
+						  "vector must not contain nulls");
+			return false;
+		}
+		vec->base = ARR_DATA_PTR(array);
+		vec->nitems = (ARR_NDIM(array) == 0 ? 0 : __Fetch(ARR_DIMS(array)));
+		vec->start = 0;
+		vec->elemtype = ARR_ELEMTYPE(array);
+		vec->smeta = NULL;
+	}
+	else
+	{
+		/* Arrow::List */
+		vec->base = arg->value;
+		vec->nitems = arg->length;
+		vec->start = arg->start;
+		vec->elemtype = arg->smeta->atttypid;
+		vec->smeta = arg->smeta;
+	}
+	if (vec->elemtype != PG_FLOAT2OID &&
+		vec->elemtype != PG_FLOAT4OID &&
+		vec->elemtype != PG_FLOAT8OID)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_WRONG_OBJECT_TYPE,
+					  "unsupported vector element type");
+		return false;
+	}
+	return true;
+}
+
+STATIC_INLINE(cl_bool)
+__vector_datum_fetch(kern_context *kcxt, vectorDatum *vec,
+					 cl_uint index, cl_double *p_value)
+{
+	if (!vec->smeta)
+	{
+		/* PG Array; no nulls, and elements are packed */
+		switch (vec->elemtype)
+		{
+			case PG_FLOAT2OID:
+				*p_value = (cl_float)__Fetch((cl_half *)vec->base + index);
+				break;
+			case PG_FLOAT4OID:
+				*p_value = __Fetch((cl_float *)vec->base + index);
+				break;
+			default:
+				*p_value = __Fetch((cl_double *)vec->base + index);
+				break;
+		}
+	}
+	else
+	{
+		/* Arrow::List */
+		cl_bool		isnull;
+
+		switch (vec->elemtype)
+		{
+			case PG_FLOAT2OID:
+				{
+					pg_float2_t	temp;
+
+					pg_datum_fetch_arrow(kcxt, temp, vec->smeta, vec->base,
+										 vec->start + index);
+					isnull = temp.isnull;
+					*p_value = (cl_float)temp.value;
+				}
+				break;
+			case PG_FLOAT4OID:
+				{
+					pg_float4_t	temp;
+
+					pg_datum_fetch_arrow(kcxt, temp, vec->smeta, vec->base,
+										 vec->start + index);
+					isnull = temp.isnull;
+					*p_value = temp.value;
+				}
+				break;
+			default:
+				{
+					pg_float8_t	temp;
+
+					pg_datum_fetch_arrow(kcxt, temp, vec->smeta, vec->base,
+										 vec->start + index);
+					isnull = temp.isnull;
+					*p_value = temp.value;
+				}
+				break;
+		}
+		if (isnull)
+		{
+			STROM_EREPORT(kcxt, ERRCODE_NULL_VALUE_NOT_ALLOWED,
+						  "vector must not contain nulls");
+			return false;
+		}
+	}
+	return true;
+}
+
+STATIC_FUNCTION(cl_bool)
+__vector_distance_common(kern_context *kcxt,
+						 pg_array_t *arg1, pg_array_t *arg2,
+						 cl_double *p_dot,
+						 cl_double *p_norm1,
+						 cl_double *p_norm2,
+						 cl_double *p_l2)
+{
+	vectorDatum	a, b;
+	cl_double	dot = 0.0;
+	cl_double	norm1 = 0.0;
+	cl_double	norm2 = 0.0;
+	cl_double	l2 = 0.0;
+	cl_uint		i;
+
+	if (!__vector_datum_setup(kcxt, &a, arg1) ||
+		!__vector_datum_setup(kcxt, &b, arg2))
+		return false;
+	if (a.nitems != b.nitems)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATA_EXCEPTION,
+					  "different vector dimensions");
+		return false;
+	}
+	for (i=0; i < a.nitems; i++)
+	{
+		cl_double	x, y, diff;
+
+		if (!__vector_datum_fetch(kcxt, &a, i, &x) ||
+			!__vector_datum_fetch(kcxt, &b, i, &y))
+			return false;
+		diff = x - y;
+		dot   += x * y;
+		norm1 += x * x;
+		norm2 += y * y;
+		l2    += diff * diff;
+	}
+	*p_dot = dot;
+	*p_norm1 = norm1;
+	*p_norm2 = norm2;
+	*p_l2 = l2;
+	return true;
+}
+
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_l2_distance(kern_context *kcxt, pg_array_t arg1, pg_array_t arg2)
+{
+	pg_float8_t	result;
+	cl_double	dot, norm1, norm2, l2;
+
+	result.isnull = (arg1.isnull | arg2.isnull);
+	if (!result.isnull)
+	{
+		if (!__vector_distance_common(kcxt, &arg1, &arg2,
+									  &dot, &norm1, &norm2, &l2))
+			result.isnull = true;
+		else
+			result.value = sqrt(l2);
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_inner_product(kern_context *kcxt,
+						  pg_array_t arg1, pg_array_t arg2)
+{
+	pg_float8_t	result;
+	cl_double	dot, norm1, norm2, l2;
+
+	result.isnull = (arg1.isnull | arg2.isnull);
+	if (!result.isnull)
+	{
+		if (!__vector_distance_common(kcxt, &arg1, &arg2,
+									  &dot, &norm1, &norm2, &l2))
+			result.isnull = true;
+		else
+			result.value = dot;
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_negative_inner_product(kern_context *kcxt,
+								   pg_array_t arg1, pg_array_t arg2)
+{
+	pg_float8_t	result;
+	cl_double	dot, norm1, norm2, l2;
+
+	result.isnull = (arg1.isnull | arg2.isnull);
+	if (!result.isnull)
+	{
+		if (!__vector_distance_common(kcxt, &arg1, &arg2,
+									  &dot, &norm1, &norm2, &l2))
+			result.isnull = true;
+		else
+			result.value = -dot;
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_cosine_distance(kern_context *kcxt,
+							pg_array_t arg1, pg_array_t arg2)
+{
+	pg_float8_t	result;
+	cl_double	dot, norm1, norm2, l2;
+	cl_double	similarity;
+
+	result.isnull = (arg1.isnull | arg2.isnull);
+	if (!result.isnull)
+	{
+		if (!__vector_distance_common(kcxt, &arg1, &arg2,
+									  &dot, &norm1, &norm2, &l2))
+			result.isnull = true;
+		else if (norm1 == 0.0 || norm2 == 0.0)
+			result.value = DBL_NAN;
+		else
+		{
+			similarity = dot / sqrt(norm1 * norm2);
+			/* keep in range, against the rounding error */
+			if (similarity > 1.0)
+				similarity = 1.0;
+			else if (similarity < -1.0)
+				similarity = -1.0;
+			result.value = 1.0 - similarity;
+		}
+	}
+	return result;
+}
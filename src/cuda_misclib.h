@@ -324,5 +324,31 @@ pgfn_sin(kern_context *kcxt, pg_float8_t arg1);
 DEVICE_FUNCTION(pg_float8_t)
 pgfn_tan(kern_context *kcxt, pg_float8_t arg1);
 
+/*
+ * Array functions
+ */
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_array_ndims(kern_context *kcxt, pg_array_t arg1);
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_array_length(kern_context *kcxt, pg_array_t arg1, pg_int4_t arg2);
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_cardinality(kern_context *kcxt, pg_array_t arg1);
+
+/*
+ * Vector distance functions
+ */
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_l2_distance(kern_context *kcxt,
+						pg_array_t arg1, pg_array_t arg2);
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_inner_product(kern_context *kcxt,
+						  pg_array_t arg1, pg_array_t arg2);
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_negative_inner_product(kern_context *kcxt,
+								   pg_array_t arg1, pg_array_t arg2);
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_vector_cosine_distance(kern_context *kcxt,
+							pg_array_t arg1, pg_array_t arg2);
+
 #endif	/* __CUDACC__ */
 #endif	/* CUDA_MISCLIB_H */
@@ -646,6 +646,51 @@ pgfn_numeric_int8(kern_context *kcxt, pg_numeric_t arg)
 	return result;
 }
 
+/*
+ * numeric_scaled_hi / numeric_scaled_lo
+ *
+ * X * 10^scale as a 64bit integer, then split into the upper (signed) and
+ * the lower (unsigned) 32bit parts. GpuPreAgg sums up both of them using
+ * int8 atomic operations for exact SUM/AVG of NUMERIC(p,s), p <= 18.
+ */
+STATIC_FUNCTION(cl_long)
+numeric_to_scaled_integer(kern_context *kcxt, pg_numeric_t arg,
+						  cl_int scale, cl_bool *p_isnull)
+{
+	arg.weight -= scale;
+	return numeric_to_integer(kcxt, arg, LONG_MAX, p_isnull);
+}
+
+DEVICE_FUNCTION(pg_int8_t)
+pgfn_numeric_scaled_hi(kern_context *kcxt,
+					   pg_numeric_t arg, pg_int4_t scale)
+{
+	pg_int8_t	result;
+
+	result.isnull = (arg.isnull | scale.isnull);
+	if (!result.isnull)
+	{
+		result.value = numeric_to_scaled_integer(kcxt, arg, scale.value,
+												 &result.isnull) >> 32;
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_int8_t)
+pgfn_numeric_scaled_lo(kern_context *kcxt,
+					   pg_numeric_t arg, pg_int4_t scale)
+{
+	pg_int8_t	result;
+
+	result.isnull = (arg.isnull | scale.isnull);
+	if (!result.isnull)
+	{
+		result.value = numeric_to_scaled_integer(kcxt, arg, scale.value,
+												 &result.isnull) & 0xffffffffL;
+	}
+	return result;
+}
+
 DEVICE_FUNCTION(pg_float2_t)
 pgfn_numeric_float2(kern_context *kcxt, pg_numeric_t arg)
 {
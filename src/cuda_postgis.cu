@@ -890,6 +890,50 @@ __geom_overlaps_bbox2d(const geom_bbox_2d *bbox1,
 	return false;
 }
 
+/*
+ * __geometry_bbox2d_prefilter
+ *
+ * Cheap bounding-box check prior to the exact geometry algorithm, for the
+ * predicates that never become true if geom1 and geom2 are apart more than
+ * the 'distance'. It returns false only if both bounding-boxes are known
+ * and obviously disjoint.
+ * Bounding-box is built on the fly if geometry has no cached one (like a
+ * point), then rounded outward as PostGIS doing for the cached one.
+ */
+STATIC_FUNCTION(cl_bool)
+__geometry_bbox2d_prefilter(kern_context *kcxt,
+							const pg_geometry_t *geom1,
+							const pg_geometry_t *geom2,
+							cl_double distance)
+{
+	geom_bbox_2d	bbox1;
+	geom_bbox_2d	bbox2;
+
+	if (!__geometry_get_bbox2d(kcxt, geom1, &bbox1) ||
+		!__geometry_get_bbox2d(kcxt, geom2, &bbox2) ||
+		__geom_bbox_2d_is_empty(&bbox1) ||
+		__geom_bbox_2d_is_empty(&bbox2))
+		return true;	/* unknown, so exact check is needed */
+	if (!geom1->bbox)
+	{
+		bbox1.xmin = nextafterf(bbox1.xmin, -FLT_MAX);
+		bbox1.xmax = nextafterf(bbox1.xmax,  FLT_MAX);
+		bbox1.ymin = nextafterf(bbox1.ymin, -FLT_MAX);
+		bbox1.ymax = nextafterf(bbox1.ymax,  FLT_MAX);
+	}
+	if (!geom2->bbox)
+	{
+		bbox2.xmin = nextafterf(bbox2.xmin, -FLT_MAX);
+		bbox2.xmax = nextafterf(bbox2.xmax,  FLT_MAX);
+		bbox2.ymin = nextafterf(bbox2.ymin, -FLT_MAX);
+		bbox2.ymax = nextafterf(bbox2.ymax,  FLT_MAX);
+	}
+	return ((cl_double)bbox1.xmin - distance <= (cl_double)bbox2.xmax &&
+			(cl_double)bbox1.xmax + distance >= (cl_double)bbox2.xmin &&
+			(cl_double)bbox1.ymin - distance <= (cl_double)bbox2.ymax &&
+			(cl_double)bbox1.ymax + distance >= (cl_double)bbox2.ymin);
+}
+
 /* see, gserialized_overlaps_2d() */
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_geometry_overlaps(kern_context *kcxt,
@@ -3049,6 +3093,12 @@ pgfn_st_dwithin(kern_context *kcxt,
 						  "Tolerance cannot be less than zero");
 			result.isnull = true;
 		}
+		else if (!__geometry_bbox2d_prefilter(kcxt, &geom1, &geom2,
+											  arg3.value))
+		{
+			/* bounding-boxes are apart more than the tolerance */
+			result.value = false;
+		}
 		else
 		{
 			memset(&dl, 0, sizeof(DISTPTS));
@@ -5788,6 +5838,13 @@ pgfn_st_contains(kern_context *kcxt,
 	if (geometry_is_empty(&geom1) || geometry_is_empty(&geom2))
 		return result;
 
+	/*
+	 * shortcut-0: if bounding boxes are disjoint obviously, geom1
+	 * never contains geom2, regardless of the geometry types.
+	 */
+	if (!__geometry_bbox2d_prefilter(kcxt, &geom1, &geom2, 0.0))
+		return result;
+
 	/*
 	 * shortcut-1: if geom1 is a polygon and geom2 is a point type,
 	 * call the fast point-in-polygon function.
@@ -5853,19 +5910,8 @@ pgfn_st_crosses(kern_context *kcxt,
 	 * shortcut: if bounding boxes are disjoint obviously,
 	 * we can return FALSE immediately.
 	 */
-	if (geom1.bbox && geom2.bbox)
-	{
-		geom_bbox_2d	bbox1, bbox2;
-
-		memcpy(&bbox1, &geom1.bbox->d2, sizeof(geom_bbox_2d));
-		memcpy(&bbox2, &geom2.bbox->d2, sizeof(geom_bbox_2d));
-
-		if (bbox1.xmax < bbox2.xmin ||
-			bbox1.xmin > bbox2.xmax ||
-			bbox1.ymax < bbox2.ymin ||
-			bbox1.ymin > bbox2.ymax)
-			return result;
-	}
+	if (!__geometry_bbox2d_prefilter(kcxt, &geom1, &geom2, 0.0))
+		return result;
 
 #if 0
 	/*
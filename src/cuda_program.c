@@ -15,12 +15,36 @@
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  * GNU General Public License for more details.
  */
+#include <elf.h>
 #include "pg_strom.h"
 #include "mb/pg_wchar.h"
 #include "access/xact.h"
 #include "pgtime.h"
 #include "utils/pg_locale.h"
 
+/*
+ * program_tuning_slot
+ *
+ * Launch parameter of a particular kernel function on a particular device;
+ * candidates of the block size are tried on the first chunks, then the one
+ * with the best throughput is chosen for the later invocations.
+ */
+#define PGCACHE_TUNING_NSLOTS		8	/* # of kernel functions per program */
+#define PGCACHE_TUNING_NCANDS		3	/* # of block size candidates */
+#define PGCACHE_TUNING_NTRIALS		2	/* # of chunks per candidate */
+#define PGCACHE_TUNING_WARPSZ		32	/* unit of the block size */
+
+typedef struct
+{
+	char			func_name[48];	/* name of the kernel function */
+	cl_int			cuda_dindex;	/* device index */
+	cl_int			best_block_sz;	/* 0, if tuning is in-progress */
+	cl_int			block_sz[PGCACHE_TUNING_NCANDS];
+	cl_uint			ntrials[PGCACHE_TUNING_NCANDS];
+	uint64			nitems[PGCACHE_TUNING_NCANDS];
+	uint64			usec[PGCACHE_TUNING_NCANDS];
+} program_tuning_slot;
+
 typedef struct
 {
 	cl_int			magic;
@@ -43,10 +67,13 @@ typedef struct
 	size_t			kern_srclen;
 	cl_uint			varlena_bufsz;
 	pg_crc32		ptx_crc;
-	char		   *ptx_image;		/* may be CUDA_PROGRAM_BUILD_FAILURE */
+	char		   *ptx_image;		/* PTX or relocatable cubin; may be
+									 * CUDA_PROGRAM_BUILD_FAILURE */
 	size_t			ptx_length;
 	char		   *error_msg;
 	int				error_code;
+	/* launch parameters tuned at runtime (protected by the lock) */
+	program_tuning_slot tuning[PGCACHE_TUNING_NSLOTS];
 	char			data[FLEXIBLE_ARRAY_MEMBER];
 } program_cache_entry;
 
@@ -74,9 +101,39 @@ typedef struct
 	dlist_head	build_list;		/* build pending list */
 	dlist_head	addr_list;
 	dlist_head	free_list[PGCACHE_CHUNKSZ_MAX_BIT + 1];
+	/* cumulative statistics (protected by the lock) */
+	uint64		num_hits;		/* # of lookups found in the cache */
+	uint64		num_misses;		/* # of lookups not found in the cache */
+	uint64		num_evictions;	/* # of entries reclaimed by LRU */
+	uint64		num_builds;		/* # of NVRTC builds */
+	uint64		num_failures;	/* # of NVRTC build failures */
+	uint64		num_file_loads;	/* # of loads from the on-disk cache */
+	uint64		build_time;		/* total time of the builds in usec */
 	char		base[FLEXIBLE_ARRAY_MEMBER];
 } program_cache_head;
 
+/*
+ * program_cache_file_head
+ *
+ * File format of the on-disk program cache; PTX image built by NVRTC is
+ * saved with its source and build parameters, to reuse it after restart.
+ */
+#define PGCACHE_FILE_MAGIC			0x50474358		/* 'PGCX' */
+
+typedef struct
+{
+	cl_uint		magic;
+	cl_int		nvrtc_version;
+	cl_int		target_cc;
+	cl_uint		extra_flags;
+	cl_uint		varlena_bufsz;
+	pg_crc32	ptx_crc;
+	size_t		kern_deflen;
+	size_t		kern_srclen;
+	size_t		ptx_length;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} program_cache_file_head;
+
 typedef struct
 {
 	pg_atomic_uint32	num_active_builders;
@@ -90,6 +147,9 @@ static int		program_cache_size_kb;
 static int		num_program_builders;
 static bool		pgstrom_debug_jit_compile_options;
 static int		pgstrom_extra_kernel_stack_size;
+static bool		pgstrom_enable_kernel_autotuning;
+static bool		pgstrom_enable_prebuild_cuda_program;
+static char	   *program_cache_dir;
 
 /* ---- static variables ---- */
 static shmem_startup_hook_type shmem_startup_next;
@@ -195,6 +255,7 @@ reclaim_cuda_program_entry_nolock(int mclass)
 		memset(&entry->lru_chain, 0, sizeof(dlist_node));
 
 		put_cuda_program_entry_nolock(entry);
+		pgcache_head->num_evictions++;
 	}
 	return true;
 }
@@ -232,6 +293,7 @@ create_cuda_program_entry_nolock(size_t variable_length)
 	Assert(entry->magic == PGCACHE_CHUNK_MAGIC &&
 		   entry->mclass == mclass);
 	memset(&entry->free_chain, 0, sizeof(dlist_node));
+	memset(entry->tuning, 0, sizeof(entry->tuning));
 
 	return entry;
 }
@@ -413,6 +475,10 @@ construct_flat_cuda_source(cl_uint extra_flags,
 	if ((extra_flags & DEVKERNEL_NEEDS_GPUSORT) != 0)
 		ofs += snprintf(source + ofs, len - ofs,
 						"#include \"cuda_gpusort.h\"\n");
+	/* GpuWindowAgg */
+	if ((extra_flags & DEVKERNEL_NEEDS_GPUWINAGG) != 0)
+		ofs += snprintf(source + ofs, len - ofs,
+						"#include \"cuda_gpuwinagg.h\"\n");
 	/* Generated from SQL */
 	ofs += snprintf(source + ofs, len - ofs, "\n%s\n", kern_source);
 
@@ -428,6 +494,7 @@ link_cuda_libraries(char *ptx_image,
 					cl_uint extra_flags)
 {
 	CUlinkState		lstate;
+	CUjitInputType	input_type = CU_JIT_INPUT_PTX;
 	CUresult		rc;
 	CUjit_option	jit_options[16];
 	void		   *jit_option_values[16];
@@ -514,12 +581,18 @@ link_cuda_libraries(char *ptx_image,
 			{ "cuda_gpujoin",   DEVKERNEL_NEEDS_GPUJOIN },
 			{ "cuda_gpupreagg", DEVKERNEL_NEEDS_GPUPREAGG },
 			{ "cuda_gpusort",   DEVKERNEL_NEEDS_GPUSORT },
+			{ "cuda_gpuwinagg", DEVKERNEL_NEEDS_GPUWINAGG },
 			{ NULL, 0 },
 		};
 		cl_int		i;
 
-		/* add the base PTX image */
-		rc = cuLinkAddData(lstate, CU_JIT_INPUT_PTX,
+		/*
+		 * add the base image; it is a relocatable cubin if NVRTC could
+		 * build the program for the device, so no PTX JIT is needed here.
+		 */
+		if (ptx_length >= SELFMAG && memcmp(ptx_image, ELFMAG, SELFMAG) == 0)
+			input_type = CU_JIT_INPUT_CUBIN;
+		rc = cuLinkAddData(lstate, input_type,
 						   ptx_image, ptx_length,
 						   "pg-strom", 0, NULL, NULL);
 		if (rc != CUDA_SUCCESS)
@@ -668,7 +741,7 @@ pgstrom_cuda_source_file(ProgramId program_id)
 }
 
 /*
- * pgstrom_cuda_binary_file - write out a CUDA PTX binary to temporary file
+ * pgstrom_cuda_binary_file - write out a CUDA PTX/cubin binary to temporary file
  */
 const char *
 pgstrom_cuda_binary_file(ProgramId program_id)
@@ -692,13 +765,342 @@ pgstrom_cuda_binary_file(ProgramId program_id)
 	get_cuda_program_entry_nolock(entry);
 	SpinLockRelease(&pgcache_head->lock);
 
-	writeout_temporary_file(tempfilepath, "ptx",
+	writeout_temporary_file(tempfilepath,
+							(entry->ptx_length >= SELFMAG &&
+							 memcmp(entry->ptx_image, ELFMAG, SELFMAG) == 0
+							 ? "cubin" : "ptx"),
 							entry->ptx_image, entry->ptx_length);
 	put_cuda_program_entry(entry);
 
 	return pstrdup(tempfilepath);
 }
 
+/*
+ * get_nvrtc_version
+ */
+static int
+get_nvrtc_version(void)
+{
+	static int	nvrtc_version = -1;
+
+	if (nvrtc_version < 0)
+	{
+		int		major, minor;
+
+		if (nvrtcVersion(&major, &minor) != NVRTC_SUCCESS)
+			nvrtc_version = 0;	/* force baseline if NVRTC version is unknown */
+		else
+			nvrtc_version = major * 1000 + minor * 10;
+	}
+	return nvrtc_version;
+}
+
+/*
+ * Routines for on-disk program cache
+ *
+ * PTX images are saved on the 'pg_strom.program_cache_dir' once NVRTC
+ * built them, keyed by the source hash, NVRTC version and compute
+ * capability of the target device. It allows to skip run-time compile
+ * after restart of the server, and to share the cache with replicas.
+ *
+ * NOTE: these routines may be called in the GPU worker thread, so they
+ * must not use elog() and ereport().
+ */
+static void
+program_cache_file_name(char *fname, pg_crc32 crc, int target_cc,
+						int nvrtc_version, cl_uint varlena_bufsz)
+{
+	snprintf(fname, MAXPGPATH, "%s/%08x-cc%d-nvrtc%d-%u.ptx",
+			 program_cache_dir, crc, target_cc,
+			 nvrtc_version, varlena_bufsz);
+}
+
+static program_cache_file_head *
+read_program_cache_file(const char *fname)
+{
+	program_cache_file_head *fhead = NULL;
+	struct stat	stat_buf;
+	ssize_t		nbytes;
+	int			fdesc;
+
+	fdesc = open(fname, O_RDONLY);
+	if (fdesc < 0)
+		return NULL;
+	if (fstat(fdesc, &stat_buf) != 0 ||
+		stat_buf.st_size < offsetof(program_cache_file_head, data))
+		goto bailout;
+	fhead = malloc(stat_buf.st_size + 1);
+	if (!fhead)
+		goto bailout;
+	nbytes = __readFileSignal(fdesc, fhead, stat_buf.st_size, false);
+	if (nbytes != stat_buf.st_size ||
+		fhead->magic != PGCACHE_FILE_MAGIC ||
+		offsetof(program_cache_file_head, data) +
+		fhead->kern_deflen + 1 +
+		fhead->kern_srclen + 1 +
+		fhead->ptx_length != stat_buf.st_size)
+	{
+		free(fhead);
+		fhead = NULL;
+	}
+bailout:
+	close(fdesc);
+	return fhead;
+}
+
+static bool
+load_program_cache_file(program_cache_entry *src_entry,
+						int nvrtc_version,
+						char **p_ptx_image, size_t *p_ptx_length)
+{
+	program_cache_file_head *fhead;
+	char		fname[MAXPGPATH];
+	char	   *pos;
+	pg_crc32	ptx_crc;
+
+	if (!program_cache_dir)
+		return false;
+	program_cache_file_name(fname, src_entry->crc,
+							src_entry->target_cc,
+							nvrtc_version,
+							src_entry->varlena_bufsz);
+	fhead = read_program_cache_file(fname);
+	if (!fhead)
+		return false;
+	/* ensure the cache file is built from the identical source */
+	pos = fhead->data;
+	if (fhead->nvrtc_version != nvrtc_version ||
+		fhead->target_cc != src_entry->target_cc ||
+		fhead->extra_flags != src_entry->extra_flags ||
+		fhead->varlena_bufsz != src_entry->varlena_bufsz ||
+		fhead->kern_deflen != src_entry->kern_deflen ||
+		fhead->kern_srclen != src_entry->kern_srclen ||
+		memcmp(pos, src_entry->kern_define, src_entry->kern_deflen) != 0 ||
+		memcmp(pos + fhead->kern_deflen + 1,
+			   src_entry->kern_source, src_entry->kern_srclen) != 0)
+		goto mismatch;
+	pos += fhead->kern_deflen + 1 + fhead->kern_srclen + 1;
+
+	INIT_LEGACY_CRC32(ptx_crc);
+	COMP_LEGACY_CRC32(ptx_crc, pos, fhead->ptx_length);
+	FIN_LEGACY_CRC32(ptx_crc);
+	if (ptx_crc != fhead->ptx_crc)
+		goto mismatch;
+
+	*p_ptx_image = malloc(fhead->ptx_length);
+	if (!*p_ptx_image)
+		goto mismatch;
+	memcpy(*p_ptx_image, pos, fhead->ptx_length);
+	*p_ptx_length = fhead->ptx_length;
+	free(fhead);
+	return true;
+
+mismatch:
+	free(fhead);
+	return false;
+}
+
+static void
+save_program_cache_file(program_cache_entry *src_entry,
+						int nvrtc_version,
+						const char *ptx_image, size_t ptx_length)
+{
+	program_cache_file_head fhead;
+	char		fname[MAXPGPATH];
+	char		tname[MAXPGPATH];
+	int			fdesc;
+
+	if (!program_cache_dir)
+		return;
+	program_cache_file_name(fname, src_entry->crc,
+							src_entry->target_cc,
+							nvrtc_version,
+							src_entry->varlena_bufsz);
+	snprintf(tname, sizeof(tname), "%s.%d.tmp", fname, MyProcPid);
+	fdesc = open(tname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fdesc < 0)
+	{
+		wnotice("failed on open('%s'): %m", tname);
+		return;
+	}
+	memset(&fhead, 0, sizeof(program_cache_file_head));
+	fhead.magic			= PGCACHE_FILE_MAGIC;
+	fhead.nvrtc_version	= nvrtc_version;
+	fhead.target_cc		= src_entry->target_cc;
+	fhead.extra_flags	= src_entry->extra_flags;
+	fhead.varlena_bufsz	= src_entry->varlena_bufsz;
+	fhead.kern_deflen	= src_entry->kern_deflen;
+	fhead.kern_srclen	= src_entry->kern_srclen;
+	fhead.ptx_length	= ptx_length;
+	INIT_LEGACY_CRC32(fhead.ptx_crc);
+	COMP_LEGACY_CRC32(fhead.ptx_crc, ptx_image, ptx_length);
+	FIN_LEGACY_CRC32(fhead.ptx_crc);
+
+	if (__writeFileSignal(fdesc, &fhead,
+						  offsetof(program_cache_file_head, data),
+						  false) != offsetof(program_cache_file_head, data) ||
+		__writeFileSignal(fdesc, src_entry->kern_define,
+						  src_entry->kern_deflen + 1,
+						  false) != src_entry->kern_deflen + 1 ||
+		__writeFileSignal(fdesc, src_entry->kern_source,
+						  src_entry->kern_srclen + 1,
+						  false) != src_entry->kern_srclen + 1 ||
+		__writeFileSignal(fdesc, ptx_image, ptx_length,
+						  false) != ptx_length)
+	{
+		wnotice("failed on write('%s'): %m", tname);
+		close(fdesc);
+		unlink(tname);
+		return;
+	}
+	close(fdesc);
+	/* rename(2) is atomic, so concurrent builders never see broken file */
+	if (rename(tname, fname) != 0)
+	{
+		wnotice("failed on rename('%s','%s'): %m", tname, fname);
+		unlink(tname);
+	}
+}
+
+/*
+ * warmup_program_cache
+ *
+ * It loads the on-disk program cache onto the shared program cache, on
+ * startup of the program builder. Up to half of the 'program_cache_size'
+ * is consumed, to keep room for the programs newly built.
+ */
+static void
+warmup_program_cache(void)
+{
+	DIR		   *dir;
+	struct dirent *dent;
+	size_t		limit = ((size_t)program_cache_size_kb << 10) / 2;
+	size_t		usage = 0;
+	int			nvrtc_version = get_nvrtc_version();
+	int			count = 0;
+
+	if (mkdir(program_cache_dir, S_IRWXU) != 0 && errno != EEXIST)
+	{
+		elog(LOG, "failed on mkdir('%s'): %m", program_cache_dir);
+		return;
+	}
+	dir = AllocateDir(program_cache_dir);
+	if (!dir)
+	{
+		elog(LOG, "failed on AllocateDir('%s'): %m", program_cache_dir);
+		return;
+	}
+	while ((dent = ReadDir(dir, program_cache_dir)) != NULL &&
+		   usage < limit)
+	{
+		program_cache_file_head *fhead;
+		program_cache_entry *entry;
+		char		fname[MAXPGPATH];
+		char	   *kern_define;
+		char	   *kern_source;
+		char	   *ptx_image;
+		size_t		len = strlen(dent->d_name);
+		size_t		length;
+		size_t		offset = 0;
+		pg_crc32	crc;
+		dlist_iter	iter;
+		int			hindex;
+
+		if (len < 4 || strcmp(dent->d_name + len - 4, ".ptx") != 0)
+			continue;
+		snprintf(fname, sizeof(fname), "%s/%s",
+				 program_cache_dir, dent->d_name);
+		fhead = read_program_cache_file(fname);
+		if (!fhead)
+			continue;
+		if (fhead->nvrtc_version != nvrtc_version)
+		{
+			free(fhead);
+			continue;
+		}
+		kern_define = fhead->data;
+		kern_source = kern_define + fhead->kern_deflen + 1;
+		ptx_image   = kern_source + fhead->kern_srclen + 1;
+
+		INIT_LEGACY_CRC32(crc);
+		COMP_LEGACY_CRC32(crc, &fhead->target_cc, sizeof(cl_int));
+		COMP_LEGACY_CRC32(crc, &fhead->extra_flags, sizeof(int32));
+		COMP_LEGACY_CRC32(crc, kern_source, fhead->kern_srclen);
+		COMP_LEGACY_CRC32(crc, kern_define, fhead->kern_deflen);
+		FIN_LEGACY_CRC32(crc);
+		hindex = crc % PGCACHE_HASH_SIZE;
+
+		length = (MAXALIGN(fhead->kern_deflen + 1) +
+				  MAXALIGN(fhead->kern_srclen + 1) +
+				  MAXALIGN(fhead->ptx_length + 1) +
+				  PGCACHE_MIN_ERRORMSG_BUFSIZE);
+		SpinLockAcquire(&pgcache_head->lock);
+		/* skip it, if equivalent entry is already cached */
+		dlist_foreach (iter, &pgcache_head->hash_slots[hindex])
+		{
+			entry = dlist_container(program_cache_entry,
+									hash_chain, iter.cur);
+			if (entry->crc == crc &&
+				entry->target_cc == fhead->target_cc &&
+				entry->extra_flags == fhead->extra_flags &&
+				entry->varlena_bufsz == fhead->varlena_bufsz &&
+				strcmp(entry->kern_source, kern_source) == 0 &&
+				strcmp(entry->kern_define, kern_define) == 0)
+				goto skip;
+		}
+		entry = create_cuda_program_entry_nolock(length);
+		if (!entry)
+		{
+			SpinLockRelease(&pgcache_head->lock);
+			free(fhead);
+			break;
+		}
+		do {
+			entry->program_id = ++pgcache_head->last_program_id;
+		} while (lookup_cuda_program_entry_nolock(entry->program_id) != NULL);
+		entry->crc				= crc;
+		entry->target_cc		= fhead->target_cc;
+		entry->extra_flags		= fhead->extra_flags;
+		entry->kern_deflen		= fhead->kern_deflen;
+		entry->kern_define		= entry->data + offset;
+		memcpy(entry->kern_define, kern_define, fhead->kern_deflen + 1);
+		offset += MAXALIGN(fhead->kern_deflen + 1);
+		entry->kern_srclen		= fhead->kern_srclen;
+		entry->kern_source		= entry->data + offset;
+		memcpy(entry->kern_source, kern_source, fhead->kern_srclen + 1);
+		offset += MAXALIGN(fhead->kern_srclen + 1);
+		entry->varlena_bufsz	= fhead->varlena_bufsz;
+		entry->ptx_image		= entry->data + offset;
+		entry->ptx_length		= fhead->ptx_length;
+		entry->ptx_crc			= fhead->ptx_crc;
+		memcpy(entry->ptx_image, ptx_image, fhead->ptx_length);
+		offset += MAXALIGN(fhead->ptx_length + 1);
+		entry->error_msg		= entry->data + offset;
+		snprintf(entry->error_msg, length - offset,
+				 "build success:\nloaded from '%s'\n", fname);
+
+		dlist_push_head(&pgcache_head->pgid_slots[entry->program_id %
+												  PGCACHE_HASH_SIZE],
+						&entry->pgid_chain);
+		dlist_push_head(&pgcache_head->hash_slots[hindex],
+						&entry->hash_chain);
+		dlist_push_tail(&pgcache_head->lru_list,
+						&entry->lru_chain);
+		memset(&entry->build_chain, 0, sizeof(dlist_node));
+		entry->refcnt = 1;		/* entry itself */
+		usage += (1UL << entry->mclass);
+		count++;
+	skip:
+		SpinLockRelease(&pgcache_head->lock);
+		free(fhead);
+	}
+	FreeDir(dir);
+
+	if (count > 0)
+		elog(LOG, "PG-Strom: %d programs were loaded from '%s' (%zuKB)",
+			 count, program_cache_dir, usage >> 10);
+}
+
 /*
  * build_cuda_program - an interface to run synchronous build process
  */
@@ -720,8 +1122,12 @@ build_cuda_program(program_cache_entry *src_entry)
 	int				hindex;
 	size_t			offset;
 	size_t			length;
+	bool			from_file = false;
+	instr_time		tv_start;
+	instr_time		tv_end;
 
 	Assert(!src_entry->build_chain.prev && !src_entry->build_chain.next);
+	INSTR_TIME_SET_CURRENT(tv_start);
 
 	/* Make a nvrtcProgram object */
 	source = construct_flat_cuda_source(src_entry->extra_flags,
@@ -733,19 +1139,23 @@ build_cuda_program(program_cache_entry *src_entry)
 
 	STROM_TRY();
 	{
-		static int	nvrtc_version = -1;
+		int		nvrtc_version = get_nvrtc_version();
 		int		target_cc = src_entry->target_cc;
+		bool	build_cubin;
 		char	gpu_arch_option[256];
 
-		if (nvrtc_version < 0)
+		/* try to load the PTX image from the on-disk program cache */
+		if (load_program_cache_file(src_entry, nvrtc_version,
+									&ptx_image, &ptx_length))
 		{
-			int		major, minor;
-
-			if (nvrtcVersion(&major, &minor) != NVRTC_SUCCESS)
-				nvrtc_version = 0;	/* force baseline if NVRTC version is unknown */
-			else
-				nvrtc_version = major * 1000 + minor * 10;
+			build_log = strdup("loaded from the program cache");
+			if (!build_log)
+				werror("out of memory");
+			log_length = strlen(build_log);
+			from_file = true;
+			goto setup_bin_entry;
 		}
+
 		if (nvrtc_version >= 11010)
 			target_cc = Min(80, target_cc);
 		else if (nvrtc_version >= 10010)
@@ -755,6 +1165,18 @@ build_cuda_program(program_cache_entry *src_entry)
 		else
 			target_cc = Min(53, target_cc);	/* should not happen */
 
+		/*
+		 * If NVRTC supports the device, it builds a relocatable cubin, so
+		 * backends only link it with the pre-built libraries on load.
+		 * Elsewhere, PTX is JIT compiled by every backend on cuLinkXXX().
+		 */
+#if CUDA_VERSION >= 11010
+		build_cubin = (nvrtc_version >= 11010 &&
+					   target_cc == src_entry->target_cc);
+#else
+		build_cubin = false;
+#endif
+
 		rc = nvrtcCreateProgram(&program,
 								source,
 								"pg-strom",
@@ -772,8 +1194,13 @@ build_cuda_program(program_cache_entry *src_entry)
 		options[opt_index++] = "-I " PGSHAREDIR "/pg_strom";
 		options[opt_index++] = "-I " PGSERV_INCLUDEDIR;
 		snprintf(gpu_arch_option, sizeof(gpu_arch_option),
-				 "--gpu-architecture=compute_%u", src_entry->target_cc);
+				 "--gpu-architecture=%s_%u",
+				 build_cubin ? "sm" : "compute", target_cc);
 		options[opt_index++] = gpu_arch_option;
+		/* same as CU_JIT_MAX_REGISTERS for ABI compatibility */
+		if (build_cubin)
+			options[opt_index++] = "--maxrregcount="
+				CppAsString2(CUDA_MAXREGCOUNT);
 		if ((src_entry->extra_flags & DEVKERNEL_BUILD_DEBUG_INFO) != 0)
 		{
 			options[opt_index++] = "--device-debug";
@@ -799,6 +1226,28 @@ build_cuda_program(program_cache_entry *src_entry)
 			werror("failed on nvrtcCompileProgram: %s",
 				   nvrtcGetErrorString(rc));
 		}
+#if CUDA_VERSION >= 11010
+		else if (build_cubin)
+		{
+			/*
+			 * Read relocatable cubin
+			 */
+			rc = nvrtcGetCUBINSize(program, &ptx_length);
+			if (rc != NVRTC_SUCCESS)
+				werror("failed on nvrtcGetCUBINSize: %s",
+					   nvrtcGetErrorString(rc));
+			ptx_image = malloc(ptx_length + 1);
+			if (!ptx_image)
+				werror("out of memory");
+
+			rc = nvrtcGetCUBIN(program, ptx_image);
+			if (rc != NVRTC_SUCCESS)
+				werror("failed on nvrtcGetCUBIN: %s",
+					   nvrtcGetErrorString(rc));
+			save_program_cache_file(src_entry, nvrtc_version,
+									ptx_image, ptx_length);
+		}
+#endif
 		else
 		{
 			/*
@@ -817,6 +1266,8 @@ build_cuda_program(program_cache_entry *src_entry)
 				werror("failed on nvrtcGetPTX: %s",
 					   nvrtcGetErrorString(rc));
 			ptx_image[ptx_length++] = '\0';
+			save_program_cache_file(src_entry, nvrtc_version,
+									ptx_image, ptx_length);
 		}
 
 		/*
@@ -845,12 +1296,24 @@ build_cuda_program(program_cache_entry *src_entry)
 		/*
 		 * Allocation of a new entry, to keep ptx_image/build_log
 		 */
+	setup_bin_entry:
 		length = (MAXALIGN(src_entry->kern_deflen + 1) +
 				  MAXALIGN(src_entry->kern_srclen + 1) +
 				  MAXALIGN(ptx_length + 1) +
 				  MAXALIGN(log_length + 1) +
 				  PGCACHE_MIN_ERRORMSG_BUFSIZE);
+		INSTR_TIME_SET_CURRENT(tv_end);
+		INSTR_TIME_SUBTRACT(tv_end, tv_start);
 		SpinLockAcquire(&pgcache_head->lock);
+		if (from_file)
+			pgcache_head->num_file_loads++;
+		else
+		{
+			pgcache_head->num_builds++;
+			if (!ptx_image)
+				pgcache_head->num_failures++;
+		}
+		pgcache_head->build_time += INSTR_TIME_GET_MICROSEC(tv_end);
 		bin_entry = create_cuda_program_entry_nolock(length);
 		if (!bin_entry)
 		{
@@ -952,20 +1415,22 @@ build_cuda_program(program_cache_entry *src_entry)
 }
 
 /*
- * pgstrom_create_cuda_program
+ * __create_cuda_program_common
  *
  * It makes a new GPU program cache entry, or acquires an existing entry if
- * equivalent one is already exists.
+ * equivalent one is already exists. If @gcontext is NULL, entry is not
+ * tracked by anybody, thus, it is just a hint for the program builders.
  */
-ProgramId
-__pgstrom_create_cuda_program(GpuContext *gcontext,
-							  cl_uint extra_flags,
-							  cl_uint varlena_bufsz,
-							  const char *kern_source,
-							  const char *kern_define,
-							  bool wait_for_build,
-							  bool explain_only,
-							  const char *filename, int lineno)
+static ProgramId
+__create_cuda_program_common(GpuContext *gcontext,
+							 int dindex,
+							 cl_uint extra_flags,
+							 cl_uint varlena_bufsz,
+							 const char *kern_source,
+							 const char *kern_define,
+							 bool wait_for_build,
+							 bool explain_only,
+							 const char *filename, int lineno)
 {
 	program_cache_entry	*entry;
 	ProgramId	program_id;
@@ -973,12 +1438,12 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	Size		kern_deflen = strlen(kern_define);
 	Size		length;
 	Size		usage = 0;
-	int			dindex = gcontext->cuda_dindex;
 	int			hindex;
 	cl_int		target_cc;
 	dlist_iter	iter;
 	pg_crc32	crc;
 
+	Assert(gcontext != NULL || !wait_for_build);
 	/* build with debug option? */
 	if (pgstrom_debug_jit_compile_options)
 		extra_flags |= DEVKERNEL_BUILD_DEBUG_INFO;
@@ -1010,14 +1475,16 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 			entry->varlena_bufsz >= varlena_bufsz)
 		{
 			program_id = entry->program_id;
-			get_cuda_program_entry_nolock(entry);
+			if (gcontext)
+				get_cuda_program_entry_nolock(entry);
+			pgcache_head->num_hits++;
 			/* Move this entry to the head of LRU list */
 			dlist_move_head(&pgcache_head->lru_list, &entry->lru_chain);
 		retry_checks:
 			if (entry->ptx_image != NULL || !wait_for_build)
 			{
-				if (!trackCudaProgram(gcontext, program_id,
-									  filename, lineno))
+				if (gcontext && !trackCudaProgram(gcontext, program_id,
+												  filename, lineno))
 				{
 					put_cuda_program_entry_nolock(entry);
 					SpinLockRelease(&pgcache_head->lock);
@@ -1079,6 +1546,7 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	length = (MAXALIGN(kern_srclen + 1) +
 			  MAXALIGN(kern_deflen + 1) +
 			  PGCACHE_MIN_ERRORMSG_BUFSIZE);
+	pgcache_head->num_misses++;
 	entry = create_cuda_program_entry_nolock(length);
 	if (!entry)
 	{
@@ -1113,11 +1581,25 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	 * e.g, substring(X from 0 for 3) will make different value from
 	 * the substring(X from 1 for 4), but code itself shall not be
 	 * changed. So, extra margin will help the case.
+	 * Constants are already delivered by kern_parambuf, thus, queries
+	 * that differ only in constants generate the identical source, but
+	 * length of the constants still affects @varlena_bufsz. So, we round
+	 * it up to the power of 2 (or multiple of 4KB if larger), to share
+	 * the program cache with such queries.
+	 * The margin shall not exceed KERN_CONTEXT_VARLENA_BUFSZ_LIMIT because
+	 * the buffer is allocated on the stack of GPU threads; the estimation
+	 * itself is already checked by the code generator.
 	 */
 	if (varlena_bufsz == 0)
 		entry->varlena_bufsz = 0;
+	else if (varlena_bufsz + 36 <= 4096)
+		entry->varlena_bufsz = Max(1U << get_next_log2(varlena_bufsz + 36),
+								   MAXIMUM_ALIGNOF * 16);
 	else
-		entry->varlena_bufsz = MAXALIGN(varlena_bufsz + 36);
+		entry->varlena_bufsz = TYPEALIGN(4096, varlena_bufsz + 36);
+	entry->varlena_bufsz = Min(entry->varlena_bufsz,
+							   Max(varlena_bufsz,
+								   KERN_CONTEXT_VARLENA_BUFSZ_LIMIT));
 
 	/* no cuda binary at this moment */
 	entry->ptx_image = NULL;
@@ -1134,11 +1616,12 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 					&entry->lru_chain);
 	dlist_push_head(&pgcache_head->build_list,
 					&entry->build_chain);
-	entry->refcnt = 2;	/* reference count (entry itself and owner) */
+	/* reference count (entry itself and owner, if any) */
+	entry->refcnt = (gcontext ? 2 : 1);
 
 	/* track this program entry by GpuContext */
-	if (!trackCudaProgram(gcontext, program_id,
-						  filename, lineno))
+	if (gcontext && !trackCudaProgram(gcontext, program_id,
+									  filename, lineno))
 	{
 		put_cuda_program_entry_nolock(entry);
 		SpinLockRelease(&pgcache_head->lock);
@@ -1193,6 +1676,71 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	return program_id;
 }
 
+/*
+ * pgstrom_create_cuda_program
+ */
+ProgramId
+__pgstrom_create_cuda_program(GpuContext *gcontext,
+							  cl_uint extra_flags,
+							  cl_uint varlena_bufsz,
+							  const char *kern_source,
+							  const char *kern_define,
+							  bool wait_for_build,
+							  bool explain_only,
+							  const char *filename, int lineno)
+{
+	return __create_cuda_program_common(gcontext,
+										gcontext->cuda_dindex,
+										extra_flags,
+										varlena_bufsz,
+										kern_source,
+										kern_define,
+										wait_for_build,
+										explain_only,
+										filename, lineno);
+}
+
+/*
+ * pgstrom_prebuild_cuda_program
+ *
+ * It kicks asynchronous build of the GPU program on the plan time, so the
+ * program shall be ready on the first EXECUTE of the prepared statement.
+ * @kern_node_define is the custom-scan specific part of the session info,
+ * that is usually built by assign_XXXX_session_info() on ExecInit.
+ */
+void
+pgstrom_prebuild_cuda_program(int cuda_dindex,
+							  cl_uint extra_flags,
+							  cl_uint varlena_bufsz,
+							  const char *kern_source,
+							  const char *kern_node_define)
+{
+	StringInfoData kern_define;
+
+	if (!pgstrom_enable_prebuild_cuda_program || numDevAttrs == 0)
+		return;
+	if (cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+		cuda_dindex = 0;
+	initStringInfo(&kern_define);
+	pgstrom_build_session_info(&kern_define, NULL,
+							   extra_flags & ~(DEVKERNEL_NEEDS_GPUSCAN |
+											   DEVKERNEL_NEEDS_GPUJOIN |
+											   DEVKERNEL_NEEDS_GPUPREAGG));
+	if (kern_node_define)
+		appendStringInfoString(&kern_define, kern_node_define);
+	/* never raise an error on build failure at the plan time */
+	__create_cuda_program_common(NULL,
+								 cuda_dindex,
+								 extra_flags,
+								 varlena_bufsz,
+								 kern_source,
+								 kern_define.data,
+								 false,
+								 true,
+								 __FILE__, __LINE__);
+	pfree(kern_define.data);
+}
+
 /*
  * pgstrom_put_cuda_program
  *
@@ -1746,6 +2294,183 @@ retry_checks:
 	return cuda_module;
 }
 
+/*
+ * pgstrom_cuda_program_is_ready
+ *
+ * It checks whether the CUDA program is already built (or failed), thus,
+ * pgstrom_load_cuda_program() does not need to wait for NVRTC.
+ */
+bool
+pgstrom_cuda_program_is_ready(ProgramId program_id)
+{
+	program_cache_entry *entry;
+	bool		retval = false;
+
+	SpinLockAcquire(&pgcache_head->lock);
+	entry = lookup_cuda_program_entry_nolock(program_id);
+	if (entry && entry->ptx_image != NULL)
+		retval = true;
+	SpinLockRelease(&pgcache_head->lock);
+
+	return retval;
+}
+
+/*
+ * lookup_tuning_slot_nolock - lookup or assign a program_tuning_slot
+ */
+static program_tuning_slot *
+lookup_tuning_slot_nolock(program_cache_entry *entry,
+						  const char *func_name,
+						  int cuda_dindex,
+						  int optimal_block_sz)
+{
+	program_tuning_slot *tslot;
+	int		i, j, k;
+
+	for (i=0; i < PGCACHE_TUNING_NSLOTS; i++)
+	{
+		tslot = &entry->tuning[i];
+		if (tslot->func_name[0] == '\0')
+			break;
+		if (tslot->cuda_dindex == cuda_dindex &&
+			strcmp(tslot->func_name, func_name) == 0)
+			return tslot;
+	}
+	if (i >= PGCACHE_TUNING_NSLOTS ||
+		strlen(func_name) >= sizeof(tslot->func_name))
+		return NULL;	/* no room to track */
+
+	/* assign a new slot; candidates are 1, 1/2 and 1/4 of the optimal */
+	strcpy(tslot->func_name, func_name);
+	tslot->cuda_dindex = cuda_dindex;
+	tslot->best_block_sz = 0;
+	for (j=0, k=0; j < PGCACHE_TUNING_NCANDS; j++)
+	{
+		int		block_sz = TYPEALIGN_DOWN(PGCACHE_TUNING_WARPSZ,
+										  optimal_block_sz >> j);
+		if (block_sz < 2 * PGCACHE_TUNING_WARPSZ)
+			break;
+		tslot->block_sz[k++] = block_sz;
+	}
+	if (k <= 1)
+		tslot->best_block_sz = optimal_block_sz;
+
+	return tslot;
+}
+
+/*
+ * pgstrom_tuned_block_size
+ *
+ * It returns the block size to launch the kernel function; one of the
+ * candidates not tried enough yet during the tuning, or the winner.
+ */
+int
+pgstrom_tuned_block_size(ProgramId program_id,
+						 const char *func_name,
+						 int cuda_dindex,
+						 int optimal_block_sz)
+{
+	program_cache_entry *entry;
+	program_tuning_slot *tslot;
+	int		block_sz = optimal_block_sz;
+	int		i;
+
+	if (!pgstrom_enable_kernel_autotuning)
+		return optimal_block_sz;
+
+	SpinLockAcquire(&pgcache_head->lock);
+	entry = lookup_cuda_program_entry_nolock(program_id);
+	if (entry)
+	{
+		tslot = lookup_tuning_slot_nolock(entry, func_name, cuda_dindex,
+										  optimal_block_sz);
+		if (!tslot)
+			block_sz = optimal_block_sz;
+		else if (tslot->best_block_sz > 0)
+			block_sz = tslot->best_block_sz;
+		else
+		{
+			for (i=0; i < PGCACHE_TUNING_NCANDS; i++)
+			{
+				if (tslot->block_sz[i] > 0 &&
+					tslot->ntrials[i] < PGCACHE_TUNING_NTRIALS)
+				{
+					block_sz = tslot->block_sz[i];
+					break;
+				}
+			}
+		}
+	}
+	SpinLockRelease(&pgcache_head->lock);
+
+	return Min(block_sz, optimal_block_sz);
+}
+
+/*
+ * pgstrom_tuned_block_size_feedback
+ *
+ * It records the throughput of the kernel launched with @block_sz; once
+ * all the candidates are tried, the winner is fixed.
+ */
+void
+pgstrom_tuned_block_size_feedback(ProgramId program_id,
+								  const char *func_name,
+								  int cuda_dindex,
+								  int block_sz,
+								  size_t nitems,
+								  uint64 usec)
+{
+	program_cache_entry *entry;
+	program_tuning_slot *tslot;
+	int		i, j;
+
+	if (!pgstrom_enable_kernel_autotuning || nitems == 0)
+		return;
+
+	SpinLockAcquire(&pgcache_head->lock);
+	entry = lookup_cuda_program_entry_nolock(program_id);
+	if (!entry)
+		goto out;
+	for (i=0; i < PGCACHE_TUNING_NSLOTS; i++)
+	{
+		tslot = &entry->tuning[i];
+		if (tslot->func_name[0] == '\0')
+			goto out;
+		if (tslot->cuda_dindex == cuda_dindex &&
+			strcmp(tslot->func_name, func_name) == 0)
+			break;
+	}
+	if (i >= PGCACHE_TUNING_NSLOTS || tslot->best_block_sz > 0)
+		goto out;
+
+	for (i=0; i < PGCACHE_TUNING_NCANDS; i++)
+	{
+		if (tslot->block_sz[i] == block_sz)
+		{
+			tslot->ntrials[i]++;
+			tslot->nitems[i] += nitems;
+			tslot->usec[i]   += Max(usec, 1);
+			break;
+		}
+	}
+	/* all the candidates are tried? */
+	for (i=0, j=-1; i < PGCACHE_TUNING_NCANDS; i++)
+	{
+		if (tslot->block_sz[i] == 0)
+			continue;
+		if (tslot->ntrials[i] < PGCACHE_TUNING_NTRIALS)
+			goto out;
+		if (j < 0 ||
+			((double)tslot->nitems[i] / (double)tslot->usec[i] >
+			 (double)tslot->nitems[j] / (double)tslot->usec[j]))
+			j = i;
+	}
+	if (j >= 0)
+		tslot->best_block_sz = tslot->block_sz[j];
+out:
+	SpinLockRelease(&pgcache_head->lock);
+}
+
 /*
  * cudaProgramBuilderSigTerm
  */
@@ -1791,6 +2516,10 @@ cudaProgramBuilderMain(Datum arg)
 	pg_atomic_fetch_add_u32(&pgbuilder_state->num_active_builders, 1);
 	PG_TRY();
 	{
+		/* the first builder loads the on-disk program cache */
+		if (builder_id == 0 && program_cache_dir)
+			warmup_program_cache();
+
 		while (!cuda_program_builder_got_signal)
 		{
 			program_cache_entry *entry;
@@ -1881,6 +2610,82 @@ cudaProgramBuilderWakeUp(bool error_if_no_builders)
 		elog(ERROR, "PG-Strom: no active CUDA C program builder");
 }
 
+/*
+ * pgstrom_stat_gpu_program_cache - statistics of the GPU program cache
+ */
+Datum pgstrom_stat_gpu_program_cache(PG_FUNCTION_ARGS);
+
+Datum
+pgstrom_stat_gpu_program_cache(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	bool		isnull[11];
+	Datum		values[11];
+	dlist_iter	iter;
+	size_t		free_sz = 0;
+	int64		num_entries = 0;
+	int			i;
+
+	tupdesc = CreateTemplateTupleDesc(11);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  1, "cache_size",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  2, "cache_usage",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  3, "num_entries",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  4, "hits",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  5, "misses",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  6, "evictions",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  7, "builds",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  8, "build_failures",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber)  9, "file_loads",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 10, "build_time",
+					   FLOAT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 11, "avg_build_time",
+					   FLOAT8OID, -1, 0);
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	memset(isnull, 0, sizeof(isnull));
+	SpinLockAcquire(&pgcache_head->lock);
+	for (i=PGCACHE_CHUNKSZ_MIN_BIT; i <= PGCACHE_CHUNKSZ_MAX_BIT; i++)
+	{
+		dlist_foreach(iter, &pgcache_head->free_list[i])
+			free_sz += (1UL << i);
+	}
+	dlist_foreach(iter, &pgcache_head->lru_list)
+		num_entries++;
+	values[0] = Int64GetDatum((size_t)program_cache_size_kb << 10);
+	values[1] = Int64GetDatum(((size_t)program_cache_size_kb << 10) -
+							  Min(free_sz, (size_t)program_cache_size_kb << 10));
+	values[2] = Int64GetDatum(num_entries);
+	values[3] = Int64GetDatum(pgcache_head->num_hits);
+	values[4] = Int64GetDatum(pgcache_head->num_misses);
+	values[5] = Int64GetDatum(pgcache_head->num_evictions);
+	values[6] = Int64GetDatum(pgcache_head->num_builds);
+	values[7] = Int64GetDatum(pgcache_head->num_failures);
+	values[8] = Int64GetDatum(pgcache_head->num_file_loads);
+	values[9] = Float8GetDatum((double)pgcache_head->build_time / 1000.0);
+	if (pgcache_head->num_builds + pgcache_head->num_file_loads == 0)
+		isnull[10] = true;
+	else
+		values[10] = Float8GetDatum((double)pgcache_head->build_time / 1000.0 /
+									(double)(pgcache_head->num_builds +
+											 pgcache_head->num_file_loads));
+	SpinLockRelease(&pgcache_head->lock);
+
+	tuple = heap_form_tuple(tupdesc, values, isnull);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_stat_gpu_program_cache);
+
 static void
 pgstrom_startup_cuda_program(void)
 {
@@ -1963,6 +2768,20 @@ pgstrom_init_cuda_program(void)
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
 
+	/*
+	 * directory of the on-disk program cache
+	 */
+	DefineCustomStringVariable("pg_strom.program_cache_dir",
+							   "directory to save the CUDA programs built",
+							   NULL,
+							   &program_cache_dir,
+							   NULL,
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE | GUC_SUPERUSER_ONLY,
+							   NULL, NULL, NULL);
+	if (program_cache_dir && *program_cache_dir == '\0')
+		program_cache_dir = NULL;
+
 	/*
 	 * number of worker process to build CUDA program
 	 */
@@ -2003,6 +2822,26 @@ pgstrom_init_cuda_program(void)
 							GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
 
+	/*
+	 * Runtime tuning of the launch parameters
+	 */
+	DefineCustomBoolVariable("pg_strom.enable_prebuild_cuda_program",
+							 "Enables asynchronous build of GPU programs on the plan time",
+							 NULL,
+							 &pgstrom_enable_prebuild_cuda_program,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomBoolVariable("pg_strom.enable_kernel_autotuning",
+							 "Enables runtime tuning of the GPU kernel block size",
+							 NULL,
+							 &pgstrom_enable_kernel_autotuning,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/* allocation of static shared memory */
 	RequestAddinShmemSpace(offsetof(program_cache_head, base) +
 						   ((size_t)program_cache_size_kb << 10));
@@ -57,10 +57,12 @@
 		if (VARATT_IS_EXTERNAL(addr) ||								\
 			VARATT_IS_COMPRESSED(addr))								\
 		{															\
-			result.isnull = true;									\
-			STROM_CPU_FALLBACK(kcxt,ERRCODE_STROM_VARLENA_UNSUPPORTED,\
-							   "compressed or external varlena");	\
-			return result;											\
+			addr = kern_decompress_varlena(kcxt, (varlena *)addr);	\
+			if (!addr)												\
+			{														\
+				result.isnull = true;								\
+				return result;										\
+			}														\
 		}															\
 		flags = *((char *)addr + VARSIZE_ANY(addr) - sizeof(char));	\
 		memcpy(&type_oid, VARDATA_ANY(addr), sizeof(cl_uint));		\
@@ -51,16 +51,17 @@ pg_bpchar_datum_extract(kern_context *kcxt, pg_bpchar_t arg,
 		return false;
 	if (arg.length < 0)
 	{
-		if (VARATT_IS_COMPRESSED(arg.value) ||
-			VARATT_IS_EXTERNAL(arg.value))
+		char   *vl = arg.value;
+
+		if (VARATT_IS_COMPRESSED(vl) || VARATT_IS_EXTERNAL(vl))
 		{
-			STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
-							   "varlena datum is compressed or external");
-			return false;
+			vl = (char *)kern_decompress_varlena(kcxt, (varlena *)vl);
+			if (!vl)
+				return false;
 		}
-		*s = VARDATA_ANY(arg.value);
-		*len = bpchar_truelen(VARDATA_ANY(arg.value),
-							  VARSIZE_ANY_EXHDR(arg.value));
+		*s = VARDATA_ANY(vl);
+		*len = bpchar_truelen(VARDATA_ANY(vl),
+							  VARSIZE_ANY_EXHDR(vl));
 	}
 	else
 	{
@@ -82,10 +83,12 @@ bpchar_compare(kern_context *kcxt,
 	{
 		if (VARATT_IS_COMPRESSED(s1) || VARATT_IS_EXTERNAL(s1))
 		{
-			*p_isnull = true;
-			STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
-							   "varlena datum is compressed or external");
-			return 0;
+			s1 = (const char *)kern_decompress_varlena(kcxt, (varlena *)s1);
+			if (!s1)
+			{
+				*p_isnull = true;
+				return 0;
+			}
 		}
 		len1 = bpchar_truelen(VARDATA_ANY(s1),
 							  VARSIZE_ANY_EXHDR(s1));
@@ -95,10 +98,12 @@ bpchar_compare(kern_context *kcxt,
 	{
 		if (VARATT_IS_COMPRESSED(s2) || VARATT_IS_EXTERNAL(s2))
 		{
-			*p_isnull = true;
-			STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
-							   "varlena datum is compressed or external");
-			return 0;
+			s2 = (const char *)kern_decompress_varlena(kcxt, (varlena *)s2);
+			if (!s2)
+			{
+				*p_isnull = true;
+				return 0;
+			}
 		}
 		len2 = bpchar_truelen(VARDATA_ANY(s2),
 							  VARSIZE_ANY_EXHDR(s2));
@@ -291,6 +296,56 @@ text_compare(kern_context *kcxt,
 	return 0;
 }
 
+/*
+ * text_equal
+ *
+ * Equality check that does not need the ordering; like texteq() in PG,
+ * strings in different length are never equal, and the bytes are compared
+ * by words if possible. It is the hot path of the GROUP BY keys match and
+ * the join quals on text keys, which already passed the hash-value check.
+ */
+STATIC_FUNCTION(cl_bool)
+text_equal(kern_context *kcxt,
+		   pg_text_t arg1,
+		   pg_text_t arg2,
+		   cl_bool *p_isnull)
+{
+	char	   *s1, *s2;
+	cl_int		len1;
+	cl_int		len2;
+
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s1, &len1) ||
+		!pg_varlena_datum_extract(kcxt, arg2, &s2, &len2))
+	{
+		*p_isnull = true;
+		return false;
+	}
+	if (len1 != len2)
+		return false;
+	if (s1 == s2)
+		return true;
+	if ((((uintptr_t)s1 | (uintptr_t)s2) & (sizeof(cl_ulong) - 1)) == 0)
+	{
+		while (len1 >= (cl_int)sizeof(cl_ulong))
+		{
+			if (*((cl_ulong *)s1) != *((cl_ulong *)s2))
+				return false;
+			s1 += sizeof(cl_ulong);
+			s2 += sizeof(cl_ulong);
+			len1 -= sizeof(cl_ulong);
+		}
+	}
+	while (len1 > 0)
+	{
+		if (*s1 != *s2)
+			return false;
+		s1++;
+		s2++;
+		len1--;
+	}
+	return true;
+}
+
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_texteq(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
 {
@@ -298,10 +353,7 @@ pgfn_texteq(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
 
 	result.isnull = (arg1.isnull | arg2.isnull);
 	if (!result.isnull)
-	{
-		result.value = (cl_bool)(text_compare(kcxt, arg1, arg2,
-											  &result.isnull) == 0);
-	}
+		result.value = text_equal(kcxt, arg1, arg2, &result.isnull);
 	return result;
 }
 
@@ -312,10 +364,7 @@ pgfn_textne(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
 
 	result.isnull = (arg1.isnull | arg2.isnull);
 	if (!result.isnull)
-	{
-		result.value = (cl_bool)(text_compare(kcxt, arg1, arg2,
-											  &result.isnull) != 0);
-	}
+		result.value = !text_equal(kcxt, arg1, arg2, &result.isnull);
 	return result;
 }
 
@@ -684,6 +733,63 @@ pgfn_text_substring_nolen(kern_context *kcxt,
 	return result;
 }
 
+/*
+ * upper / lower
+ *
+ * Only ASCII characters are converted, as PostgreSQL does in C-locale.
+ * The planner ensures collation of the function is C-locale.
+ */
+STATIC_FUNCTION(pg_text_t)
+text_case_convert(kern_context *kcxt, pg_text_t arg1, cl_bool to_upper)
+{
+	pg_text_t	result;
+	char	   *s;
+	char	   *pos;
+	cl_int		i, len;
+
+	if (arg1.isnull)
+		return arg1;
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s, &len))
+	{
+		result.isnull = true;
+		return result;
+	}
+	pos = (char *)kern_context_alloc(kcxt, VARHDRSZ + len);
+	if (!pos)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
+						   "out of memory");
+		result.isnull = true;
+		return result;
+	}
+	result.isnull = false;
+	result.value = pos;
+	result.length = -1;
+	SET_VARSIZE(pos, VARHDRSZ + len);
+	pos += VARHDRSZ;
+	for (i=0; i < len; i++)
+	{
+		cl_uchar	c = s[i];
+
+		if (to_upper ? (c >= 'a' && c <= 'z') : (c >= 'A' && c <= 'Z'))
+			c ^= 0x20;
+		pos[i] = c;
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_text_t)
+pgfn_text_lower(kern_context *kcxt, pg_text_t arg1)
+{
+	return text_case_convert(kcxt, arg1, false);
+}
+
+DEVICE_FUNCTION(pg_text_t)
+pgfn_text_upper(kern_context *kcxt, pg_text_t arg1)
+{
+	return text_case_convert(kcxt, arg1, true);
+}
+
 /*
  * Support for LIKE operator
  */
@@ -1130,3 +1236,558 @@ pgfn_bpcharicnlike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2)
 #undef LIKE_TRUE
 #undef LIKE_FALSE
 #undef LIKE_ABORT
+
+/*
+ * Support for regular expression operators
+ *
+ * It supports a limited subset of the advanced regular expression;
+ * literal characters, '.', bracket expressions of ASCII characters,
+ * quantifiers ('*', '+' and '?'), and anchors at the head / tail.
+ * A non-capturing group can enclose the whole expression, as
+ * similar_to_escape() generates for SIMILAR TO. The compiled expression
+ * is simulated as NFA with a bitmap of the states, thus, runs without
+ * any backtracking.
+ * The planner checks the pattern with devfunc_textregex_result_sz()
+ * preliminary, so unsupported pattern on run-time leads CPU fallback.
+ */
+#define REGEX_MAX_ATOMS			63
+#define REGEX_ATOM__CHAR		1
+#define REGEX_ATOM__ANY			2
+#define REGEX_ATOM__CLASS		3
+#define REGEX_QUANT__ONE		0
+#define REGEX_QUANT__OPT		1	/* '?' */
+#define REGEX_QUANT__STAR		2	/* '*' */
+
+typedef struct
+{
+	cl_uchar	kind;
+	cl_uchar	quant;
+	cl_uchar	negate;
+	cl_uchar	clen;
+	union {
+		cl_uchar	chr[4];		/* REGEX_ATOM__CHAR */
+		cl_uint		bitmap[4];	/* REGEX_ATOM__CLASS (ASCII only) */
+	} u;
+} regex_atom;
+
+STATIC_INLINE(cl_bool)
+__regex_is_escaped(const char *p, cl_int pos)
+{
+	cl_int		nslash = 0;
+
+	while (pos > 0 && p[pos-1] == '\\')
+	{
+		nslash++;
+		pos--;
+	}
+	return (nslash & 1) != 0;
+}
+
+STATIC_FUNCTION(cl_int)
+__regex_compile(const char *p, cl_int plen,
+				regex_atom *atoms,
+				cl_bool *p_anchor_head,
+				cl_bool *p_anchor_tail)
+{
+	cl_int		natoms = 0;
+	cl_int		c, d;
+
+	*p_anchor_head = false;
+	*p_anchor_tail = false;
+	if (plen > 0 && *p == '^')
+	{
+		*p_anchor_head = true;
+		p++;
+		plen--;
+	}
+	if (plen > 0 && p[plen-1] == '$' && !__regex_is_escaped(p, plen-1))
+	{
+		*p_anchor_tail = true;
+		plen--;
+	}
+	/* non-capturing group that encloses the whole expression */
+	if (plen >= 4 && p[0] == '(' && p[1] == '?' && p[2] == ':' &&
+		p[plen-1] == ')' && !__regex_is_escaped(p, plen-1))
+	{
+		p += 3;
+		plen -= 4;
+	}
+
+	while (plen > 0)
+	{
+		regex_atom *atom;
+
+		if (natoms >= REGEX_MAX_ATOMS)
+			return -1;
+		atom = &atoms[natoms];
+		memset(atom, 0, sizeof(regex_atom));
+
+		c = (cl_uchar)*p;
+		if (c == '.')
+		{
+			atom->kind = REGEX_ATOM__ANY;
+			p++;
+			plen--;
+		}
+		else if (c == '\\')
+		{
+			/* only escape of non-alphanumeric ASCII is literal */
+			if (plen < 2)
+				return -1;
+			c = (cl_uchar)p[1];
+			if (c >= 0x80 ||
+				(c >= '0' && c <= '9') ||
+				(c >= 'a' && c <= 'z') ||
+				(c >= 'A' && c <= 'Z'))
+				return -1;
+			atom->kind = REGEX_ATOM__CHAR;
+			atom->clen = 1;
+			atom->u.chr[0] = c;
+			p += 2;
+			plen -= 2;
+		}
+		else if (c == '[')
+		{
+			atom->kind = REGEX_ATOM__CLASS;
+			p++;
+			plen--;
+			if (plen > 0 && *p == '^')
+			{
+				atom->negate = true;
+				p++;
+				plen--;
+			}
+			for (;;)
+			{
+				if (plen <= 0)
+					return -1;
+				c = (cl_uchar)*p;
+				if (c == ']' && (cl_uint)atom->clen > 0)
+					break;
+				if (c >= 0x80 || c == '\\' ||
+					(c == '[' && plen > 1 && (p[1] == ':' ||
+											  p[1] == '.' ||
+											  p[1] == '=')))
+					return -1;
+				atom->clen = 1;		/* at least one item */
+				if (plen > 2 && p[1] == '-' && p[2] != ']')
+				{
+					d = (cl_uchar)p[2];
+					if (d >= 0x80 || d == '\\' || d == '[' || d < c)
+						return -1;
+					p += 3;
+					plen -= 3;
+				}
+				else
+				{
+					d = c;
+					p++;
+					plen--;
+				}
+				while (c <= d)
+				{
+					atom->u.bitmap[c / 32] |= (1U << (c % 32));
+					c++;
+				}
+			}
+			atom->clen = 0;
+			p++;
+			plen--;
+		}
+		else if (c == '(' || c == ')' || c == '{' || c == '}' ||
+				 c == '*' || c == '+' || c == '?' || c == '|' ||
+				 c == '^' || c == '$')
+		{
+			return -1;
+		}
+		else
+		{
+			d = pg_wchar_mblen(p);
+			if (d < 1 || d > 4 || d > plen)
+				return -1;
+			atom->kind = REGEX_ATOM__CHAR;
+			atom->clen = d;
+			memcpy(atom->u.chr, p, d);
+			p += d;
+			plen -= d;
+		}
+		natoms++;
+
+		/* quantifier, if any */
+		if (plen > 0)
+		{
+			c = *p;
+			if (c == '*')
+				atom->quant = REGEX_QUANT__STAR;
+			else if (c == '?')
+				atom->quant = REGEX_QUANT__OPT;
+			else if (c == '+')
+			{
+				/* X+ is equivalent to XX* */
+				if (natoms >= REGEX_MAX_ATOMS)
+					return -1;
+				memcpy(&atoms[natoms], atom, sizeof(regex_atom));
+				atoms[natoms].quant = REGEX_QUANT__STAR;
+				natoms++;
+			}
+			else if (c == '{')
+				return -1;
+			else
+				continue;
+			p++;
+			plen--;
+			/* non-greedy quantifier makes no difference on match */
+			if (plen > 0 && *p == '?')
+			{
+				p++;
+				plen--;
+			}
+			if (plen > 0 && (*p == '*' || *p == '+' ||
+							 *p == '?' || *p == '{'))
+				return -1;
+		}
+	}
+	return natoms;
+}
+
+STATIC_INLINE(cl_bool)
+__regex_atom_match(regex_atom *atom, const char *t, cl_int tlen)
+{
+	cl_uchar	c = *t;
+
+	switch (atom->kind)
+	{
+		case REGEX_ATOM__ANY:
+			return true;
+		case REGEX_ATOM__CHAR:
+			return (atom->clen == tlen &&
+					memcmp(atom->u.chr, t, tlen) == 0);
+		case REGEX_ATOM__CLASS:
+			/* non-ASCII characters match only negative class */
+			if (tlen != 1 || c >= 0x80)
+				return atom->negate;
+			return (((atom->u.bitmap[c / 32] & (1U << (c % 32))) != 0)
+					!= (atom->negate != 0));
+		default:
+			break;
+	}
+	return false;
+}
+
+STATIC_INLINE(cl_ulong)
+__regex_closure(regex_atom *atoms, cl_int natoms, cl_ulong states)
+{
+	cl_int		k;
+
+	/* atoms with '?' or '*' can be skipped */
+	for (k=0; k < natoms; k++)
+	{
+		if ((states & (1UL << k)) != 0 &&
+			atoms[k].quant != REGEX_QUANT__ONE)
+			states |= (1UL << (k+1));
+	}
+	return states;
+}
+
+/*
+ * GenericRegexMatch - returns 1 if matched, 0 if not matched, or -1 if
+ * the pattern is not supported on the device.
+ */
+STATIC_FUNCTION(cl_int)
+GenericRegexMatch(const char *t, cl_int tlen,
+				  const char *p, cl_int plen)
+{
+	regex_atom	atoms[REGEX_MAX_ATOMS];
+	cl_int		natoms;
+	cl_bool		anchor_head;
+	cl_bool		anchor_tail;
+	cl_ulong	accept;
+	cl_ulong	curr;
+	cl_ulong	next;
+	cl_int		k, l;
+
+	natoms = __regex_compile(p, plen, atoms, &anchor_head, &anchor_tail);
+	if (natoms < 0)
+		return -1;
+	accept = (1UL << natoms);
+	curr = __regex_closure(atoms, natoms, 1UL);
+	if (!anchor_tail && (curr & accept) != 0)
+		return 1;
+	while (tlen > 0)
+	{
+		l = pg_wchar_mblen(t);
+		if (l < 1 || l > tlen)
+			l = 1;
+		next = 0;
+		for (k=0; k < natoms; k++)
+		{
+			if ((curr & (1UL << k)) != 0 &&
+				__regex_atom_match(&atoms[k], t, l))
+			{
+				if (atoms[k].quant == REGEX_QUANT__STAR)
+					next |= (1UL << k);
+				else
+					next |= (1UL << (k+1));
+			}
+		}
+		t += l;
+		tlen -= l;
+		if (!anchor_head)
+			next |= 1UL;	/* match can begin at any position */
+		curr = __regex_closure(atoms, natoms, next);
+		if (curr == 0)
+			return 0;
+		if (!anchor_tail && (curr & accept) != 0)
+			return 1;
+	}
+	return ((curr & accept) != 0 ? 1 : 0);
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_textregexeq(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
+{
+	pg_bool_t	result;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (!result.isnull)
+	{
+		char	   *s, *p;
+		cl_int		slen;
+		cl_int		plen;
+		cl_int		retval;
+
+		if (!pg_varlena_datum_extract(kcxt, arg1, &s, &slen) ||
+			!pg_varlena_datum_extract(kcxt, arg2, &p, &plen))
+		{
+			result.isnull = true;
+			return result;
+		}
+		retval = GenericRegexMatch(s, slen, p, plen);
+		if (retval < 0)
+		{
+			STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+							   "regular expression is not supported");
+			result.isnull = true;
+			return result;
+		}
+		result.value = (retval > 0);
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_textregexne(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
+{
+	pg_bool_t	result = pgfn_textregexeq(kcxt, arg1, arg2);
+
+	if (!result.isnull)
+		result.value = !result.value;
+	return result;
+}
+
+/*
+ * __regex_match_longest - returns length of the longest match that begins
+ * at the head of the string, or -1 if not matched.
+ * Because all the quantifiers are greedy (the planner rejects non-greedy
+ * ones for regexp_replace), the preferred match of PostgreSQL is the
+ * leftmost-longest one.
+ */
+STATIC_FUNCTION(cl_int)
+__regex_match_longest(regex_atom *atoms, cl_int natoms,
+					  cl_bool anchor_tail,
+					  const char *t, cl_int tlen)
+{
+	cl_ulong	accept = (1UL << natoms);
+	cl_ulong	curr;
+	cl_ulong	next;
+	cl_int		pos = 0;
+	cl_int		longest = -1;
+	cl_int		k, l;
+
+	curr = __regex_closure(atoms, natoms, 1UL);
+	for (;;)
+	{
+		if ((curr & accept) != 0 && (!anchor_tail || pos == tlen))
+			longest = pos;
+		if (pos >= tlen)
+			break;
+		l = pg_wchar_mblen(t + pos);
+		if (l < 1 || l > tlen - pos)
+			l = 1;
+		next = 0;
+		for (k=0; k < natoms; k++)
+		{
+			if ((curr & (1UL << k)) != 0 &&
+				__regex_atom_match(&atoms[k], t + pos, l))
+			{
+				if (atoms[k].quant == REGEX_QUANT__STAR)
+					next |= (1UL << k);
+				else
+					next |= (1UL << (k+1));
+			}
+		}
+		curr = __regex_closure(atoms, natoms, next);
+		if (curr == 0)
+			break;
+		pos += l;
+	}
+	return longest;
+}
+
+/*
+ * regexp_replace
+ *
+ * Replacement string must not contain back-references; it is also checked
+ * by the planner, then CPU fallback on run-time.
+ */
+STATIC_FUNCTION(pg_text_t)
+text_regexp_replace(kern_context *kcxt,
+					pg_text_t arg1, pg_text_t arg2, pg_text_t arg3,
+					cl_bool is_global)
+{
+	regex_atom	atoms[REGEX_MAX_ATOMS];
+	cl_int		natoms;
+	cl_bool		anchor_head;
+	cl_bool		anchor_tail;
+	pg_text_t	result;
+	char	   *s, *p, *r;
+	cl_int		slen, plen, rlen;
+	char	   *dest = NULL;
+	cl_int		j, loop;
+
+	if (arg1.isnull || arg2.isnull || arg3.isnull)
+	{
+		result.isnull = true;
+		return result;
+	}
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s, &slen) ||
+		!pg_varlena_datum_extract(kcxt, arg2, &p, &plen) ||
+		!pg_varlena_datum_extract(kcxt, arg3, &r, &rlen))
+	{
+		result.isnull = true;
+		return result;
+	}
+	natoms = __regex_compile(p, plen, atoms, &anchor_head, &anchor_tail);
+	for (j=0; j < rlen && r[j] != '\\'; j++);
+	if (natoms < 0 || j < rlen)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "regular expression is not supported");
+		result.isnull = true;
+		return result;
+	}
+
+	/* 1st loop counts the result length, then 2nd loop writes out */
+	for (loop=0; loop < 2; loop++)
+	{
+		cl_int		nmatches = 0;
+		cl_int		nbytes = 0;
+		cl_int		copied = 0;
+		cl_int		i = 0;
+		cl_int		l, mlen;
+
+		while (i <= slen)
+		{
+			if (anchor_head && i > 0)
+				break;
+			mlen = __regex_match_longest(atoms, natoms, anchor_tail,
+										 s + i, slen - i);
+			if (mlen >= 0)
+			{
+				/* unmatched prefix, then replacement */
+				if (dest)
+				{
+					memcpy(dest + nbytes, s + copied, i - copied);
+					memcpy(dest + nbytes + (i - copied), r, rlen);
+				}
+				nbytes += (i - copied) + rlen;
+				nmatches++;
+				i += mlen;
+				copied = i;
+				if (!is_global)
+					break;
+				if (mlen > 0)
+					continue;
+			}
+			/* move to the next character */
+			if (i >= slen)
+				break;
+			l = pg_wchar_mblen(s + i);
+			i += (l < 1 || l > slen - i ? 1 : l);
+		}
+		/* no match, so returns the original string as is */
+		if (nmatches == 0)
+			return arg1;
+		/* unmatched suffix */
+		if (dest)
+		{
+			memcpy(dest + nbytes, s + copied, slen - copied);
+			break;
+		}
+		nbytes += slen - copied;
+
+		dest = (char *)kern_context_alloc(kcxt, VARHDRSZ + nbytes);
+		if (!dest)
+		{
+			STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
+							   "out of memory");
+			result.isnull = true;
+			return result;
+		}
+		SET_VARSIZE(dest, VARHDRSZ + nbytes);
+		result.isnull = false;
+		result.value = dest;
+		result.length = -1;
+		dest += VARHDRSZ;
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_text_t)
+pgfn_regexp_replace(kern_context *kcxt,
+					pg_text_t arg1, pg_text_t arg2, pg_text_t arg3)
+{
+	return text_regexp_replace(kcxt, arg1, arg2, arg3, false);
+}
+
+DEVICE_FUNCTION(pg_text_t)
+pgfn_regexp_replace_flags(kern_context *kcxt,
+						  pg_text_t arg1, pg_text_t arg2,
+						  pg_text_t arg3, pg_text_t arg4)
+{
+	pg_text_t	result;
+	cl_bool		is_global = false;
+	char	   *f;
+	cl_int		i, flen;
+
+	if (arg4.isnull)
+	{
+		result.isnull = true;
+		return result;
+	}
+	if (!pg_varlena_datum_extract(kcxt, arg4, &f, &flen))
+	{
+		result.isnull = true;
+		return result;
+	}
+	for (i=0; i < flen; i++)
+	{
+		if (f[i] != 'g')
+		{
+			STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+							   "regexp_replace flag is not supported");
+			result.isnull = true;
+			return result;
+		}
+		is_global = true;
+	}
+	return text_regexp_replace(kcxt, arg1, arg2, arg3, is_global);
+}
+
+#undef REGEX_MAX_ATOMS
+#undef REGEX_ATOM__CHAR
+#undef REGEX_ATOM__ANY
+#undef REGEX_ATOM__CLASS
+#undef REGEX_QUANT__ONE
+#undef REGEX_QUANT__OPT
+#undef REGEX_QUANT__STAR
@@ -83,6 +83,10 @@ pgfn_text_substring(kern_context *kcxt,
 DEVICE_FUNCTION(pg_text_t)
 pgfn_text_substring_nolen(kern_context *kcxt,
 						  pg_text_t arg1, pg_int4_t arg2);
+DEVICE_FUNCTION(pg_text_t)
+pgfn_text_lower(kern_context *kcxt, pg_text_t arg1);
+DEVICE_FUNCTION(pg_text_t)
+pgfn_text_upper(kern_context *kcxt, pg_text_t arg1);
 /* binary compatible type cast */
 DEVICE_INLINE(pg_text_t)
 to_text(pg_varchar_t arg)
@@ -121,5 +125,17 @@ DEVICE_FUNCTION(pg_bool_t)
 pgfn_bpchariclike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2);
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_bpcharicnlike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2);
+/* regular expression operator */
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_textregexeq(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_textregexne(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2);
+DEVICE_FUNCTION(pg_text_t)
+pgfn_regexp_replace(kern_context *kcxt,
+					pg_text_t arg1, pg_text_t arg2, pg_text_t arg3);
+DEVICE_FUNCTION(pg_text_t)
+pgfn_regexp_replace_flags(kern_context *kcxt,
+						  pg_text_t arg1, pg_text_t arg2,
+						  pg_text_t arg3, pg_text_t arg4);
 #endif	/* __CUDACC__ */
 #endif	/* CUDA_TEXTLIB_H */
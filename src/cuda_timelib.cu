@@ -674,41 +674,24 @@ pg_next_dst_boundary(const cl_long *timep,	/* pg_time_t in original */
 	return 1;
 }
 
+/*
+ * DetermineLocalTimeOffset
+ *
+ * It determines the timezone offset of the local time; supplied as pg_time_t
+ * taken as GMT time. Only the DST transition table of the timezone is
+ * referenced, without any calendar arithmetic.
+ */
 STATIC_FUNCTION(cl_int)
-DetermineTimeZoneOffset(struct pg_tm *tm,
-						const tz_state *sp)	/* pg_tz *tzp in original */
+DetermineLocalTimeOffset(cl_long mytime,	/* pg_time_t in original */
+						 int *p_isdst,
+						 const tz_state *sp)	/* pg_tz *tzp in original */
 {
-	cl_long t;					/* pg_time_t in original */
-
-	cl_long	*tp = &t;			/* pg_time_t in original */
-
-	int		date, sec;
-	cl_long	day, mytime, boundary; /* pg_time_t in original */
+	cl_long	boundary;			/* pg_time_t in original */
 	cl_long	prevtime, beforetime, aftertime; /* pg_time_t in original */
 	long	before_gmtoff,after_gmtoff;
 	int		before_isdst, after_isdst;
 	int		res;
 
-	/*
-	 * First, generate the pg_time_t value corresponding to the given
-	 * y/m/d/h/m/s taken as GMT time.  If this overflows, punt and decide the
-	 * timezone is GMT.  (For a valid Julian date, integer overflow should be
-	 * impossible with 64-bit pg_time_t, but let's check for safety.)
-	 */
-	if (!IS_VALID_JULIAN(tm->tm_year, tm->tm_mon, tm->tm_mday))
-		goto overflow;
-	date = date2j(tm->tm_year, tm->tm_mon, tm->tm_mday) - UNIX_EPOCH_JDATE;
-
-	day = ((cl_long) date) * SECS_PER_DAY;
-	if (day / SECS_PER_DAY != date)
-		goto overflow;
-	sec = (tm->tm_sec +
-		   (tm->tm_min + tm->tm_hour * MINS_PER_HOUR) * SECS_PER_MINUTE);
-	mytime = day + sec;
-	/* since sec >= 0, overflow could only be from +day to -mytime */
-	if (mytime < 0 && day > 0)
-		goto overflow;
-
 	/*
 	 * Find the DST time boundary just before or following the target time. We
 	 * assume that all zones have GMT offsets less than 24 hours, and that DST
@@ -730,8 +713,7 @@ DetermineTimeZoneOffset(struct pg_tm *tm,
 	if (res == 0)
 	{
 		/* Non-DST zone, life is simple */
-		tm->tm_isdst = before_isdst;
-		*tp = mytime - before_gmtoff;
+		*p_isdst = before_isdst;
 		return -(int) before_gmtoff;
 	}
 
@@ -758,14 +740,12 @@ DetermineTimeZoneOffset(struct pg_tm *tm,
 	 */
 	if (beforetime < boundary && aftertime < boundary)
 	{
-		tm->tm_isdst = before_isdst;
-		*tp = beforetime;
+		*p_isdst = before_isdst;
 		return -(int) before_gmtoff;
 	}
 	if (beforetime > boundary && aftertime >= boundary)
 	{
-		tm->tm_isdst = after_isdst;
-		*tp = aftertime;
+		*p_isdst = after_isdst;
 		return -(int) after_gmtoff;
 	}
 
@@ -779,18 +759,50 @@ DetermineTimeZoneOffset(struct pg_tm *tm,
 	 */
 	if (beforetime > aftertime)
 	{
-		tm->tm_isdst = before_isdst;
-		*tp = beforetime;
+		*p_isdst = before_isdst;
 		return -(int) before_gmtoff;
 	}
-	tm->tm_isdst = after_isdst;
-	*tp = aftertime;
+	*p_isdst = after_isdst;
 	return -(int) after_gmtoff;
 
+overflow:
+	/* Given date is out of range, so assume UTC */
+	*p_isdst = 0;
+	return 0;
+}
+
+STATIC_FUNCTION(cl_int)
+DetermineTimeZoneOffset(struct pg_tm *tm,
+						const tz_state *sp)	/* pg_tz *tzp in original */
+{
+	int		date, sec;
+	cl_long	day, mytime;		/* pg_time_t in original */
+
+	/*
+	 * First, generate the pg_time_t value corresponding to the given
+	 * y/m/d/h/m/s taken as GMT time.  If this overflows, punt and decide the
+	 * timezone is GMT.  (For a valid Julian date, integer overflow should be
+	 * impossible with 64-bit pg_time_t, but let's check for safety.)
+	 */
+	if (!IS_VALID_JULIAN(tm->tm_year, tm->tm_mon, tm->tm_mday))
+		goto overflow;
+	date = date2j(tm->tm_year, tm->tm_mon, tm->tm_mday) - UNIX_EPOCH_JDATE;
+
+	day = ((cl_long) date) * SECS_PER_DAY;
+	if (day / SECS_PER_DAY != date)
+		goto overflow;
+	sec = (tm->tm_sec +
+		   (tm->tm_min + tm->tm_hour * MINS_PER_HOUR) * SECS_PER_MINUTE);
+	mytime = day + sec;
+	/* since sec >= 0, overflow could only be from +day to -mytime */
+	if (mytime < 0 && day > 0)
+		goto overflow;
+
+	return DetermineLocalTimeOffset(mytime, &tm->tm_isdst, sp);
+
 overflow:
 	/* Given date is out of range, so assume UTC */
 	tm->tm_isdst = 0;
-	*tp = 0;
 	return 0;
 }
 
@@ -3964,3 +3976,351 @@ pgfn_extract_time(kern_context *kcxt, pg_text_t arg1, pg_time_t arg2)
                   "not a recognized unit of time");
 	return result;
 }
+
+/* ----------------------------------------------------------------
+ *
+ * date_trunc() and time_bucket()
+ *
+ * Units less than a day (and fixed-width buckets) are truncated by pure
+ * integer division. timestamptz references the transition table of the
+ * session timezone to shift the value to the local time and back.
+ * ---------------------------------------------------------------- */
+
+/* 2000-01-03 (Monday) as the origin of weeks and time buckets */
+#define TIME_BUCKET_ORIGIN		(2 * USECS_PER_DAY)
+
+STATIC_INLINE(Timestamp)
+__timestamp_floor(Timestamp ts, cl_long width, cl_long origin)
+{
+	cl_long		rem = (ts - origin) % width;
+
+	if (rem < 0)
+		rem += width;
+	return ts - rem;
+}
+
+/*
+ * timestamp_trunc_width - width of the unit if it is fixed, or 0
+ */
+STATIC_INLINE(cl_long)
+timestamp_trunc_width(cl_int val)
+{
+	switch (val)
+	{
+		case DTK_WEEK:		return 7 * USECS_PER_DAY;
+		case DTK_DAY:		return USECS_PER_DAY;
+		case DTK_HOUR:		return USECS_PER_HOUR;
+		case DTK_MINUTE:	return USECS_PER_MINUTE;
+		case DTK_SECOND:	return USECS_PER_SEC;
+		case DTK_MILLISEC:	return 1000L;
+		case DTK_MICROSEC:	return 1L;
+		default:
+			break;
+	}
+	return 0;
+}
+
+/*
+ * __date_trunc_tm - truncation by calendar units (month or larger)
+ */
+STATIC_FUNCTION(cl_bool)
+__date_trunc_tm(cl_int val, struct pg_tm *tm)
+{
+	switch (val)
+	{
+		case DTK_MILLENNIUM:
+			/* see comments in timestamptz_trunc */
+			if (tm->tm_year > 0)
+				tm->tm_year = ((tm->tm_year + 999) / 1000) * 1000 - 999;
+			else
+				tm->tm_year = -((999 - (tm->tm_year - 1)) / 1000) * 1000 + 1;
+		case DTK_CENTURY:
+			/* see comments in timestamptz_trunc */
+			if (tm->tm_year > 0)
+				tm->tm_year = ((tm->tm_year + 99) / 100) * 100 - 99;
+			else
+				tm->tm_year = -((99 - (tm->tm_year - 1)) / 100) * 100 + 1;
+		case DTK_DECADE:
+			/* see comments in timestamptz_trunc */
+			if (val != DTK_MILLENNIUM && val != DTK_CENTURY)
+			{
+				if (tm->tm_year > 0)
+					tm->tm_year = (tm->tm_year / 10) * 10;
+				else
+					tm->tm_year = -((8 - (tm->tm_year - 1)) / 10) * 10;
+			}
+		case DTK_YEAR:
+			tm->tm_mon = 1;
+		case DTK_QUARTER:
+			tm->tm_mon = (3 * ((tm->tm_mon - 1) / 3)) + 1;
+		case DTK_MONTH:
+			tm->tm_mday = 1;
+			tm->tm_hour = 0;
+			tm->tm_min = 0;
+			tm->tm_sec = 0;
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+/*
+ * __timestamptz_gmtoff - GMT offset (in seconds) of the session timezone
+ */
+STATIC_FUNCTION(cl_long)
+__timestamptz_gmtoff(TimestampTz ts)
+{
+	const tz_state *sp = &session_timezone_state;
+	cl_long		t;			/* pg_time_t in original */
+	int			i;
+
+	t = ts / USECS_PER_SEC;
+	if (ts % USECS_PER_SEC < 0)
+		t--;
+	t += (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * SECS_PER_DAY;
+
+	if ((sp->goback && t < sp->ats[0]) ||
+		(sp->goahead && t > sp->ats[sp->timecnt - 1]))
+	{
+		struct pg_tm	tm;
+
+		/* extrapolation by the generic code */
+		if (!pg_localtime(&t, &tm, sp))
+			return 0;
+		return tm.tm_gmtoff;
+	}
+	if (sp->timecnt == 0 || t < sp->ats[0])
+		i = sp->defaulttype;
+	else
+	{
+		int		lo = 1;
+		int		hi = sp->timecnt;
+
+		while (lo < hi)
+		{
+			int		mid = (lo + hi) >> 1;
+
+			if (t < sp->ats[mid])
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		i = (int) sp->types[lo - 1];
+	}
+	return sp->ttis[i].tt_gmtoff;
+}
+
+/*
+ * date_trunc(text,timestamp) - timestamp_trunc
+ */
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamp_trunc(kern_context *kcxt,
+					 pg_text_t arg1, pg_timestamp_t arg2)
+{
+	pg_timestamp_t result;
+	char	   *s;
+	cl_int		slen;
+	cl_int		type, val;
+	cl_long		width;
+	fsec_t		fsec;
+	struct pg_tm tm;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+	{
+		result.value = arg2.value;
+		return result;
+	}
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s, &slen) ||
+		!extract_decode_unit(s, slen, &type, &val) ||
+		type != UNITS)
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "timestamp units not recognized");
+		return result;
+	}
+
+	width = timestamp_trunc_width(val);
+	if (width > 0)
+	{
+		result.value = __timestamp_floor(arg2.value, width,
+										 val == DTK_WEEK
+										 ? TIME_BUCKET_ORIGIN : 0);
+	}
+	else if (!timestamp2tm(arg2.value, NULL, &tm, &fsec, NULL))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+	}
+	else if (!__date_trunc_tm(val, &tm))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "timestamp units not supported");
+	}
+	else if (!tm2timestamp(&tm, 0, NULL, &result.value))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+	}
+	return result;
+}
+
+/*
+ * date_trunc(text,timestamptz) - timestamptz_trunc
+ */
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamptz_trunc(kern_context *kcxt,
+					   pg_text_t arg1, pg_timestamptz_t arg2)
+{
+	pg_timestamptz_t result;
+	char	   *s;
+	cl_int		slen;
+	cl_int		type, val;
+	cl_long		width;
+	cl_long		gmtoff;
+	int			tz, isdst;
+	fsec_t		fsec;
+	struct pg_tm tm;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+	{
+		result.value = arg2.value;
+		return result;
+	}
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s, &slen) ||
+		!extract_decode_unit(s, slen, &type, &val) ||
+		type != UNITS)
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "timestamp with time zone units not recognized");
+		return result;
+	}
+
+	width = timestamp_trunc_width(val);
+	if (width > 0)
+	{
+		Timestamp	local;
+
+		gmtoff = __timestamptz_gmtoff(arg2.value) * USECS_PER_SEC;
+		local = __timestamp_floor(arg2.value + gmtoff, width,
+								  val == DTK_WEEK ? TIME_BUCKET_ORIGIN : 0);
+		if (width < USECS_PER_DAY)
+		{
+			/* keeps the original timezone offset */
+			result.value = local - gmtoff;
+		}
+		else
+		{
+			/* timezone offset at the local midnight */
+			tz = DetermineLocalTimeOffset(local / USECS_PER_SEC +
+										  (POSTGRES_EPOCH_JDATE -
+										   UNIX_EPOCH_JDATE) * SECS_PER_DAY,
+										  &isdst,
+										  &session_timezone_state);
+			result.value = local + tz * USECS_PER_SEC;
+		}
+	}
+	else if (!timestamp2tm(arg2.value, &tz, &tm, &fsec, NULL))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp with time zone out of range");
+	}
+	else if (!__date_trunc_tm(val, &tm))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "timestamp with time zone units not supported");
+	}
+	else
+	{
+		tz = DetermineTimeZoneOffset(&tm, &session_timezone_state);
+		if (!tm2timestamp(&tm, 0, &tz, &result.value))
+		{
+			result.isnull = true;
+			STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+						  "timestamp with time zone out of range");
+		}
+	}
+	return result;
+}
+
+/*
+ * pgstrom.time_bucket(interval,timestamp)
+ * pgstrom.time_bucket(interval,timestamptz)
+ *
+ * It truncates the timestamp by fixed-width buckets; that begin at
+ * 2000-01-03 (Monday) 00:00:00 UTC.
+ */
+STATIC_FUNCTION(cl_bool)
+__time_bucket_width(kern_context *kcxt, pg_interval_t arg, cl_long *p_width)
+{
+	cl_long		width;
+
+	if (arg.value.month != 0)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "time bucket by months is not supported");
+		return false;
+	}
+	width = arg.value.time + arg.value.day * USECS_PER_DAY;
+	if (width <= 0)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "bucket width must be greater than zero");
+		return false;
+	}
+	*p_width = width;
+	return true;
+}
+
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_time_bucket_timestamp(kern_context *kcxt,
+						   pg_interval_t arg1, pg_timestamp_t arg2)
+{
+	pg_timestamp_t result;
+	cl_long		width;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+		result.value = arg2.value;
+	else if (__time_bucket_width(kcxt, arg1, &width))
+		result.value = __timestamp_floor(arg2.value, width,
+										 TIME_BUCKET_ORIGIN);
+	else
+		result.isnull = true;
+	return result;
+}
+
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_time_bucket_timestamptz(kern_context *kcxt,
+							 pg_interval_t arg1, pg_timestamptz_t arg2)
+{
+	pg_timestamptz_t result;
+	cl_long		width;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+		result.value = arg2.value;
+	else if (__time_bucket_width(kcxt, arg1, &width))
+		result.value = __timestamp_floor(arg2.value, width,
+										 TIME_BUCKET_ORIGIN);
+	else
+		result.isnull = true;
+	return result;
+}
@@ -556,6 +556,21 @@ DEVICE_FUNCTION(pg_float8_t)
 pgfn_extract_timetz(kern_context *kcxt, pg_text_t arg1, pg_timetz_t arg2);
 DEVICE_FUNCTION(pg_float8_t)
 pgfn_extract_time(kern_context *kcxt, pg_text_t arg1, pg_time_t arg2);
+/*
+ * date_trunc() / time_bucket()
+ */
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamp_trunc(kern_context *kcxt,
+					 pg_text_t arg1, pg_timestamp_t arg2);
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamptz_trunc(kern_context *kcxt,
+					   pg_text_t arg1, pg_timestamptz_t arg2);
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_time_bucket_timestamp(kern_context *kcxt,
+						   pg_interval_t arg1, pg_timestamp_t arg2);
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_time_bucket_timestamptz(kern_context *kcxt,
+							 pg_interval_t arg1, pg_timestamptz_t arg2);
 
 #endif	/* __CUDACC__ */
 #endif	/* CUDA_TIMELIB_H */
@@ -814,10 +814,12 @@ PG_SCALAR_ARRAY_OP(kern_context *kcxt,
 	}
 	else
 	{
+		/*
+		 * Arrow::List elements are located at [start...start+length) of the
+		 * sub-field, and pg_datum_fetch_arrow() checks its nullmap.
+		 */
 		nitems = array.length;
 		base = (char *)array.value;
-		if (smeta->nullmap_offset != 0)
-			nullmap = base + __kds_unpack(smeta->nullmap_offset);
 	}
 	if (nitems == 0)
 		return result;
@@ -848,7 +850,7 @@ PG_SCALAR_ARRAY_OP(kern_context *kcxt,
 		{
 			/* Arrow::List */
 			assert(i < array.length);
-			pg_datum_fetch_arrow(kcxt, element, smeta, base, i);
+			pg_datum_fetch_arrow(kcxt, element, smeta, base, array.start + i);
 		}
 		/* call for the comparison function */
 		rv = compare_fn(kcxt, scalar, element);
@@ -885,5 +887,152 @@ PG_SCALAR_ARRAY_OP(kern_context *kcxt,
 	}
 	return result;
 }
+
+/*
+ * PG_SCALAR_ARRAY_LOOKUP
+ *
+ * 'scalar = ANY(array)' using the kern_array_lookup on the kparams. Its
+ * result follows ExecEvalScalarArrayOp; empty array is always false, and
+ * unmatched scalar is NULL if array contains NULL elements.
+ */
+template <typename ScalarType>
+DEVICE_INLINE(pg_bool_t)
+PG_SCALAR_ARRAY_LOOKUP(kern_context *kcxt,
+					   ScalarType scalar,
+					   cl_uint pindex)
+{
+	kern_array_lookup *alookup = (kern_array_lookup *)
+		kparam_get_value(kcxt->kparams, pindex);
+	pg_bool_t	result;
+	cl_long		key;
+	cl_uint		head, tail, curr;
+
+	result.isnull = false;
+	result.value = false;
+	if (!alookup)
+		result.isnull = true;
+	else if (alookup->nitems == 0 && !alookup->has_null)
+		result.value = false;
+	else if (scalar.isnull)
+		result.isnull = true;
+	else
+	{
+		key = (cl_long)scalar.value;
+		head = 0;
+		tail = alookup->nitems;
+		while (head < tail)
+		{
+			curr = head + (tail - head) / 2;
+			if (alookup->values[curr] < key)
+				head = curr + 1;
+			else
+				tail = curr;
+		}
+		if (head < alookup->nitems && alookup->values[head] == key)
+			result.value = true;
+		else if (alookup->has_null)
+			result.isnull = true;
+	}
+	return result;
+}
+
+/*
+ * Support routine of FieldSelect
+ *
+ * It fetches a sub-field of Arrow::Struct on KDS_FORMAT_ARROW directly.
+ * Composite datum in the row-format must be deformed by CPU.
+ */
+template <typename T>
+DEVICE_INLINE(T)
+pg_composite_fieldselect(kern_context *kcxt,
+						 pg_composite_t comp,
+						 cl_int fieldidx)
+{
+	T		result;
+
+	if (comp.isnull)
+		result.isnull = true;
+	else if (!comp.smeta)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "field selection on composite datum");
+		result.isnull = true;
+	}
+	else
+	{
+		assert(fieldidx >= 0 && fieldidx < comp.length);
+		pg_datum_fetch_arrow(kcxt, result,
+							 comp.smeta + fieldidx,
+							 comp.value, comp.rowidx);
+	}
+	return result;
+}
+
+/*
+ * Sketch functions for approximate aggregations
+ *
+ * hll_hash() uses pg_comp_hash() that is compatible to the hash function of
+ * the data type, so the host side code (aggfuncs.c) can generate identical
+ * hash values.
+ */
+template <typename T>
+DEVICE_INLINE(pg_int8_t)
+pgfn_hll_hash(kern_context *kcxt, T arg)
+{
+	pg_int8_t	result;
+
+	result.isnull = arg.isnull;
+	if (!result.isnull)
+		result.value = (cl_long)pg_comp_hash(kcxt, arg);
+	return result;
+}
+
+DEVICE_INLINE(pg_int4_t)
+pgfn_hll_bucket(kern_context *kcxt, pg_int8_t arg)
+{
+	pg_int4_t	result;
+
+	result.isnull = arg.isnull;
+	if (!result.isnull)
+		result.value = ((cl_uint)arg.value >> (32 - HLL_REGISTER_BITS));
+	return result;
+}
+
+DEVICE_INLINE(pg_int4_t)
+pgfn_hll_rank(kern_context *kcxt, pg_int8_t arg)
+{
+	pg_int4_t	result;
+	cl_uint		bits = ((cl_uint)arg.value << HLL_REGISTER_BITS);
+
+	result.isnull = arg.isnull;
+	if (!result.isnull)
+		result.value = (bits == 0 ? 32 - HLL_REGISTER_BITS : __clz(bits)) + 1;
+	return result;
+}
+
+DEVICE_INLINE(pg_int4_t)
+pgfn_dds_bucket(kern_context *kcxt, pg_float8_t arg)
+{
+	pg_int4_t	result;
+	cl_double	fval = fabs(arg.value);
+
+	result.isnull = arg.isnull;
+	if (!result.isnull)
+	{
+		if (isnan(arg.value))
+			result.value = DDS_KEY_NAN;
+		else if (isinf(arg.value))
+			result.value = (arg.value > 0.0 ? DDS_KEY_POS_INF : DDS_KEY_NEG_INF);
+		else if (fval == 0.0)
+			result.value = 0;
+		else
+		{
+			result.value = (cl_int)ceil(log(fval) / DDS_LOG_GAMMA) + DDS_KEY_OFFSET;
+			if (arg.value < 0.0)
+				result.value = -result.value;
+		}
+	}
+	return result;
+}
 #endif  /* __CUDACC__ */
 #endif  /* CUDA_UTILS_H */
@@ -219,6 +219,92 @@ ssize_t cuFileWrite(CUfileHandle_t fh,
 	return p_cuFileWrite(fh,devPtr_base,size,file_offset,devPtr_offset);
 }
 
+#ifdef WITH_CUFILE_BATCH
+/*
+ * cuFileBatchIOSetUp
+ */
+static CUfileError_t (*p_cuFileBatchIOSetUp)(
+	CUfileBatchHandle_t *batch_idp,
+	unsigned nr) = NULL;
+
+CUfileError_t
+cuFileBatchIOSetUp(CUfileBatchHandle_t *batch_idp, unsigned nr)
+{
+	if (!p_cuFileBatchIOSetUp)
+		return CUFILE_ERROR__DRIVER_NOT_INITIALIZED;
+	return p_cuFileBatchIOSetUp(batch_idp, nr);
+}
+
+/*
+ * cuFileBatchIOSubmit
+ */
+static CUfileError_t (*p_cuFileBatchIOSubmit)(
+	CUfileBatchHandle_t batch_idp,
+	unsigned nr,
+	CUfileIOParams_t *iocbp,
+	unsigned int flags) = NULL;
+
+CUfileError_t
+cuFileBatchIOSubmit(CUfileBatchHandle_t batch_idp,
+					unsigned nr,
+					CUfileIOParams_t *iocbp,
+					unsigned int flags)
+{
+	if (!p_cuFileBatchIOSubmit)
+		return CUFILE_ERROR__DRIVER_NOT_INITIALIZED;
+	return p_cuFileBatchIOSubmit(batch_idp, nr, iocbp, flags);
+}
+
+/*
+ * cuFileBatchIOGetStatus
+ */
+static CUfileError_t (*p_cuFileBatchIOGetStatus)(
+	CUfileBatchHandle_t batch_idp,
+	unsigned min_nr,
+	unsigned *nr,
+	CUfileIOEvents_t *iocbp,
+	struct timespec *timeout) = NULL;
+
+CUfileError_t
+cuFileBatchIOGetStatus(CUfileBatchHandle_t batch_idp,
+					   unsigned min_nr,
+					   unsigned *nr,
+					   CUfileIOEvents_t *iocbp,
+					   struct timespec *timeout)
+{
+	if (!p_cuFileBatchIOGetStatus)
+		return CUFILE_ERROR__DRIVER_NOT_INITIALIZED;
+	return p_cuFileBatchIOGetStatus(batch_idp, min_nr, nr, iocbp, timeout);
+}
+
+/*
+ * cuFileBatchIOCancel
+ */
+static CUfileError_t (*p_cuFileBatchIOCancel)(
+	CUfileBatchHandle_t batch_idp) = NULL;
+
+CUfileError_t
+cuFileBatchIOCancel(CUfileBatchHandle_t batch_idp)
+{
+	if (!p_cuFileBatchIOCancel)
+		return CUFILE_ERROR__DRIVER_NOT_INITIALIZED;
+	return p_cuFileBatchIOCancel(batch_idp);
+}
+
+/*
+ * cuFileBatchIODestroy
+ */
+static void (*p_cuFileBatchIODestroy)(
+	CUfileBatchHandle_t batch_idp) = NULL;
+
+void
+cuFileBatchIODestroy(CUfileBatchHandle_t batch_idp)
+{
+	if (p_cuFileBatchIODestroy)
+		p_cuFileBatchIODestroy(batch_idp);
+}
+#endif	/* WITH_CUFILE_BATCH */
+
 /*
  * lookup_cufile_function
  */
@@ -253,6 +339,26 @@ cuFileDriverLoaded(void)
 	return false;
 }
 
+/*
+ * cuFileBatchIOSupported
+ *
+ * It returns true, if the installed libcufile.so provides the batch I/O
+ * APIs. Elsewhere, GPUDirect SQL reads the file by synchronous cuFileRead.
+ */
+bool
+cuFileBatchIOSupported(void)
+{
+#ifdef WITH_CUFILE_BATCH
+	if (p_cuFileBatchIOSetUp != NULL &&
+		p_cuFileBatchIOSubmit != NULL &&
+		p_cuFileBatchIOGetStatus != NULL &&
+		p_cuFileBatchIOCancel != NULL &&
+		p_cuFileBatchIODestroy != NULL)
+		return true;
+#endif
+	return false;
+}
+
 /*
  * pgstrom_init_cufile
  */
@@ -291,6 +397,14 @@ pgstrom_init_cufile(void)
 		LOOKUP_CUFILE_FUNCTION(cuFileBufDeregister);
 		LOOKUP_CUFILE_FUNCTION(cuFileRead);
 		LOOKUP_CUFILE_FUNCTION(cuFileWrite);
+#ifdef WITH_CUFILE_BATCH
+		/* batch I/O APIs are optional; older libcufile.so lacks them */
+		p_cuFileBatchIOSetUp = dlsym(handle, "cuFileBatchIOSetUp");
+		p_cuFileBatchIOSubmit = dlsym(handle, "cuFileBatchIOSubmit");
+		p_cuFileBatchIOGetStatus = dlsym(handle, "cuFileBatchIOGetStatus");
+		p_cuFileBatchIOCancel = dlsym(handle, "cuFileBatchIOCancel");
+		p_cuFileBatchIODestroy = dlsym(handle, "cuFileBatchIODestroy");
+#endif
 	}
 	PG_CATCH();
 	{
@@ -309,6 +423,13 @@ pgstrom_init_cufile(void)
 		p_cuFileBufDeregister = NULL;
 		p_cuFileRead = NULL;
 		p_cuFileWrite = NULL;
+#ifdef WITH_CUFILE_BATCH
+		p_cuFileBatchIOSetUp = NULL;
+		p_cuFileBatchIOSubmit = NULL;
+		p_cuFileBatchIOGetStatus = NULL;
+		p_cuFileBatchIOCancel = NULL;
+		p_cuFileBatchIODestroy = NULL;
+#endif
 
 		elog(LOG, "failed on lookup cuFile symbols, cuFile is disabled.");
 		FlushErrorState();
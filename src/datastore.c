@@ -326,7 +326,6 @@ KDS_fetch_tuple_block(TupleTableSlot *slot,
 	{
 		block_nr = KERN_DATA_STORE_BLOCK_BLCKNR(kds, gts->curr_index);
 		hpage = KERN_DATA_STORE_BLOCK_PGPAGE(kds, gts->curr_index);
-		Assert(PageIsAllVisible(hpage));
 		max_lp_index = PageGetMaxOffsetNumber(hpage);
 		while (gts->curr_lp_index < max_lp_index)
 		{
@@ -335,6 +334,11 @@ KDS_fetch_tuple_block(TupleTableSlot *slot,
 			lpp = &hpage->pd_linp[lp_index];
 			if (!ItemIdIsNormal(lpp))
 				continue;
+			/* blocks by NVMe-Strom may not be all-visible */
+			if (!pgstromBlockTupleIsVisible(gts, hpage,
+											(HeapTupleHeader)
+											PageGetItem((Page)hpage, lpp)))
+				continue;
 
 			tuple->t_len = ItemIdGetLength(lpp);
 			BlockIdSet(&tuple->t_self.ip_blkid, block_nr);
@@ -475,12 +479,23 @@ PDS_release(pgstrom_data_store *pds)
 	Assert(refcnt >= 0);
 	if (refcnt == 0)
 	{
-		if (pds->gcontext)
+		if (pds->arena)
+		{
+			rc = gpuMemArenaFree(pds->arena);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on gpuMemArenaFree: %s", errorText(rc));
+		}
+		else if (pds->gcontext)
 		{
 			rc = gpuMemFree(gcontext, (CUdeviceptr) pds);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on gpuMemFree: %s", errorText(rc));
 		}
+		else if (pds->mmap_chunk)
+		{
+			Assert(pds->kds.format == KDS_FORMAT_ARROW);
+			arrowFdwUnmapRecordBatch(pds);
+		}
 		else
 		{
 			Assert(pds->kds.format == KDS_FORMAT_ARROW ||
@@ -852,6 +867,37 @@ __PDS_create_row(GpuContext *gcontext,
 	return pds;
 }
 
+/*
+ * PDS_create_row_on_arena - same as PDS_create_row, but sub-allocated on
+ * the supplied arena. It returns NULL if no room on the arena.
+ */
+pgstrom_data_store *
+PDS_create_row_on_arena(GpuMemArena *arena,
+						TupleDesc tupdesc,
+						size_t bytesize)
+{
+	pgstrom_data_store *pds;
+
+	bytesize = STROMALIGN_DOWN(bytesize);
+	pds = gpuMemArenaAlloc(arena, offsetof(pgstrom_data_store,
+										   kds) + bytesize);
+	if (!pds)
+		return NULL;
+
+	/* setup */
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pds->gcontext = arena->gcontext;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	pds->arena = arena;
+	init_kernel_data_store(&pds->kds, tupdesc, bytesize,
+						   KDS_FORMAT_ROW, INT_MAX);
+	pds->nblocks_uncached = 0;
+	pds->filedesc.rawfd = -1;
+	pds->iovec = NULL;
+
+	return pds;
+}
+
 pgstrom_data_store *
 __PDS_create_hash(GpuContext *gcontext,
 				  TupleDesc tupdesc,
@@ -938,10 +984,10 @@ pgstrom_data_store *
 __PDS_create_block(GpuContext *gcontext,
 				   TupleDesc tupdesc,
 				   NVMEScanState *nvme_sstate,
+				   cl_uint nrooms,
 				   const char *filename, int lineno)
 {
 	pgstrom_data_store *pds = NULL;
-	cl_uint		nrooms = nvme_sstate->nblocks_per_chunk;
 	size_t		length;
 	size_t		iovec_sz;
 	CUresult	rc;
@@ -950,6 +996,7 @@ __PDS_create_block(GpuContext *gcontext,
 		+ STROMALIGN(sizeof(BlockNumber) * nrooms)
 		+ BLCKSZ * nrooms;
 	iovec_sz = MAXALIGN(offsetof(strom_io_vector, ioc[nrooms]));
+	Assert(nrooms > 0 && nrooms <= nvme_sstate->nblocks_per_chunk);
 
 	if (offsetof(pgstrom_data_store,
 				 kds) + length + iovec_sz > pgstrom_chunk_size())
@@ -1281,6 +1328,43 @@ KDS_insert_hashitem(kern_data_store *kds,
 	return true;
 }
 
+/*
+ * __PDS_fillup_blocks_flush
+ *
+ * It reads the merged block ranges, by io_uring if available, or pread(2).
+ */
+#define PDS_FILLUP_BLOCKS_BATCHSZ	256
+
+static void
+__PDS_fillup_blocks_flush(pgstrom_data_store *pds, cl_int filedesc,
+						  hostFileReadChunk *chunks, int nchunks)
+{
+	int		i;
+
+	if (hostFileReadChunks(filedesc, chunks, nchunks,
+						   (char *)&pds->kds, pds->kds.length, true))
+		return;
+
+	for (i=0; i < nchunks; i++)
+	{
+		char   *dest_addr = chunks[i].dest;
+		loff_t	curr_fpos = chunks[i].fpos;
+		size_t	curr_size = chunks[i].len;
+		ssize_t	nbytes;
+
+		while (curr_size > 0)
+		{
+			nbytes = pread(filedesc, dest_addr, curr_size, curr_fpos);
+			Assert(nbytes <= curr_size);
+			if (nbytes < 0 || (nbytes == 0 && errno != EINTR))
+				werror("failed on pread(2): %m");
+			dest_addr += nbytes;
+			curr_fpos += nbytes;
+			curr_size -= nbytes;
+		}
+	}
+}
+
 /*
  * PDS_fillup_blocks
  *
@@ -1291,11 +1375,12 @@ PDS_fillup_blocks(pgstrom_data_store *pds)
 {
 	cl_int			filedesc = pds->filedesc.rawfd;
 	cl_int			i, nr_loaded;
-	ssize_t			nbytes;
+	cl_int			nchunks = 0;
 	char		   *dest_addr;
 	loff_t			curr_fpos;
 	size_t			curr_size;
 	BlockNumber	   *block_nums;
+	hostFileReadChunk chunks[PDS_FILLUP_BLOCKS_BATCHSZ];
 
 	if (pds->kds.format != KDS_FORMAT_BLOCK)
 		elog(ERROR, "Bug? only KDS_FORMAT_BLOCK can be filled up");
@@ -1322,31 +1407,39 @@ PDS_fillup_blocks(pgstrom_data_store *pds)
 		}
 		else
 		{
-			while (curr_size > 0)
+			if (curr_size > 0)
 			{
-				nbytes = pread(filedesc, dest_addr, curr_size, curr_fpos);
-				Assert(nbytes <= curr_size);
-				if (nbytes < 0 || (nbytes == 0 && errno != EINTR))
-					elog(ERROR, "failed on pread(2): %m");
-				dest_addr += nbytes;
-				curr_fpos += nbytes;
-				curr_size -= nbytes;
+				if (nchunks == PDS_FILLUP_BLOCKS_BATCHSZ)
+				{
+					__PDS_fillup_blocks_flush(pds, filedesc, chunks, nchunks);
+					nchunks = 0;
+				}
+				chunks[nchunks].dest = dest_addr;
+				chunks[nchunks].fpos = curr_fpos;
+				chunks[nchunks].len  = curr_size;
+				nchunks++;
+				dest_addr += curr_size;
 			}
 			curr_fpos = file_pos;
 			curr_size = BLCKSZ;
 		}
 	}
 
-	while (curr_size > 0)
+	if (curr_size > 0)
 	{
-		nbytes = pread(filedesc, dest_addr, curr_size, curr_fpos);
-		Assert(nbytes <= curr_size);
-		if (nbytes < 0 || (nbytes == 0 && errno != EINTR))
-			elog(ERROR, "failed on pread(2): %m");
-		dest_addr += nbytes;
-		curr_fpos += nbytes;
-		curr_size -= nbytes;
+		if (nchunks == PDS_FILLUP_BLOCKS_BATCHSZ)
+		{
+			__PDS_fillup_blocks_flush(pds, filedesc, chunks, nchunks);
+			nchunks = 0;
+		}
+		chunks[nchunks].dest = dest_addr;
+		chunks[nchunks].fpos = curr_fpos;
+		chunks[nchunks].len  = curr_size;
+		nchunks++;
+		dest_addr += curr_size;
 	}
+	if (nchunks > 0)
+		__PDS_fillup_blocks_flush(pds, filedesc, chunks, nchunks);
 	Assert(dest_addr == (char *)KERN_DATA_STORE_BLOCK_PGPAGE(&pds->kds,
 															 pds->kds.nitems));
 	pds->nblocks_uncached = 0;
@@ -1373,6 +1466,26 @@ __PDS_fillup_arrow(pgstrom_data_store *pds_dst,
 	pds_dst->iovec = NULL;
 	memcpy(&pds_dst->kds, kds_head, head_sz);
 
+	/* try io_uring first, if available */
+	if (iovec->nr_chunks > 0)
+	{
+		hostFileReadChunk *chunks
+			= alloca(sizeof(hostFileReadChunk) * iovec->nr_chunks);
+
+		for (j=0; j < iovec->nr_chunks; j++)
+		{
+			strom_io_chunk *ioc = &iovec->ioc[j];
+
+			chunks[j].dest = (char *)&pds_dst->kds + ioc->m_offset;
+			chunks[j].fpos = (size_t)ioc->fchunk_id * PAGE_SIZE;
+			chunks[j].len  = (size_t)ioc->nr_pages * PAGE_SIZE;
+		}
+		if (hostFileReadChunks(fdesc, chunks, iovec->nr_chunks,
+							   (char *)&pds_dst->kds, kds_head->length,
+							   false))
+			return;
+	}
+
 	for (j=0; j < iovec->nr_chunks; j++)
 	{
 		strom_io_chunk *ioc = &iovec->ioc[j];
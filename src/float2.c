@@ -152,6 +152,12 @@ Datum pgstrom_int2_as_float2(PG_FUNCTION_ARGS);
 Datum pgstrom_float2_accum(PG_FUNCTION_ARGS);
 Datum pgstrom_float2_sum(PG_FUNCTION_ARGS);
 
+/* vector distance functions */
+Datum pgstrom_vector_l2_distance(PG_FUNCTION_ARGS);
+Datum pgstrom_vector_inner_product(PG_FUNCTION_ARGS);
+Datum pgstrom_vector_negative_inner_product(PG_FUNCTION_ARGS);
+Datum pgstrom_vector_cosine_distance(PG_FUNCTION_ARGS);
+
 //#define DEBUG_FP16 1
 
 static inline void
@@ -1465,6 +1471,135 @@ pgstrom_float2_sum(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_float2_sum);
 
+/*
+ * Vector distance functions
+ *
+ * One-dimensional arrays of float2/float4/float8 are considered as vectors.
+ * Computation is done in float8, regardless of the element type.
+ * Also see pgfn_vector_* in cuda_misclib.cu.
+ */
+static float8 *
+__vector_array_values(ArrayType *array, int *p_nitems)
+{
+	Oid			elemtype = ARR_ELEMTYPE(array);
+	float8	   *values;
+	int			i, nitems;
+
+	if (ARR_NDIM(array) > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("vector must be one-dimensional array")));
+	if (ARR_HASNULL(array))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("vector must not contain nulls")));
+	nitems = ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+	values = palloc(sizeof(float8) * Max(nitems, 1));
+	switch (elemtype)
+	{
+		case FLOAT2OID:
+			for (i=0; i < nitems; i++)
+				values[i] = fp16_to_fp64(((half_t *)ARR_DATA_PTR(array))[i]);
+			break;
+		case FLOAT4OID:
+			for (i=0; i < nitems; i++)
+				values[i] = ((float4 *)ARR_DATA_PTR(array))[i];
+			break;
+		case FLOAT8OID:
+			memcpy(values, ARR_DATA_PTR(array), sizeof(float8) * nitems);
+			break;
+		default:
+			elog(ERROR, "unsupported vector element type: %s",
+				 format_type_be(elemtype));
+	}
+	*p_nitems = nitems;
+	return values;
+}
+
+static void
+__vector_distance_common(FunctionCallInfo fcinfo,
+						 float8 *p_dot,
+						 float8 *p_norm1,
+						 float8 *p_norm2,
+						 float8 *p_l2)
+{
+	float8	   *a, *b;
+	float8		dot = 0.0;
+	float8		norm1 = 0.0;
+	float8		norm2 = 0.0;
+	float8		l2 = 0.0;
+	int			i, n1, n2;
+
+	a = __vector_array_values(PG_GETARG_ARRAYTYPE_P(0), &n1);
+	b = __vector_array_values(PG_GETARG_ARRAYTYPE_P(1), &n2);
+	if (n1 != n2)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("different vector dimensions %d and %d", n1, n2)));
+	for (i=0; i < n1; i++)
+	{
+		float8	diff = a[i] - b[i];
+
+		dot   += a[i] * b[i];
+		norm1 += a[i] * a[i];
+		norm2 += b[i] * b[i];
+		l2    += diff * diff;
+	}
+	*p_dot = dot;
+	*p_norm1 = norm1;
+	*p_norm2 = norm2;
+	*p_l2 = l2;
+}
+
+Datum
+pgstrom_vector_l2_distance(PG_FUNCTION_ARGS)
+{
+	float8		dot, norm1, norm2, l2;
+
+	__vector_distance_common(fcinfo, &dot, &norm1, &norm2, &l2);
+	PG_RETURN_FLOAT8(sqrt(l2));
+}
+PG_FUNCTION_INFO_V1(pgstrom_vector_l2_distance);
+
+Datum
+pgstrom_vector_inner_product(PG_FUNCTION_ARGS)
+{
+	float8		dot, norm1, norm2, l2;
+
+	__vector_distance_common(fcinfo, &dot, &norm1, &norm2, &l2);
+	PG_RETURN_FLOAT8(dot);
+}
+PG_FUNCTION_INFO_V1(pgstrom_vector_inner_product);
+
+Datum
+pgstrom_vector_negative_inner_product(PG_FUNCTION_ARGS)
+{
+	float8		dot, norm1, norm2, l2;
+
+	__vector_distance_common(fcinfo, &dot, &norm1, &norm2, &l2);
+	PG_RETURN_FLOAT8(-dot);
+}
+PG_FUNCTION_INFO_V1(pgstrom_vector_negative_inner_product);
+
+Datum
+pgstrom_vector_cosine_distance(PG_FUNCTION_ARGS)
+{
+	float8		dot, norm1, norm2, l2;
+	float8		similarity;
+
+	__vector_distance_common(fcinfo, &dot, &norm1, &norm2, &l2);
+	if (norm1 == 0.0 || norm2 == 0.0)
+		PG_RETURN_FLOAT8(get_float8_nan());
+	similarity = dot / sqrt(norm1 * norm2);
+	/* keep in range, against the rounding error */
+	if (similarity > 1.0)
+		similarity = 1.0;
+	else if (similarity < -1.0)
+		similarity = -1.0;
+	PG_RETURN_FLOAT8(1.0 - similarity);
+}
+PG_FUNCTION_INFO_V1(pgstrom_vector_cosine_distance);
+
 Datum
 pgstrom_define_shell_type(PG_FUNCTION_ARGS)
 {
@@ -0,0 +1,736 @@
+/*
+ * gpu_analyze.c
+ *
+ * GPU accelerated ANALYZE for Arrow_Fdw and Gstore_Fdw foreign tables
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+
+/*
+ * NOTE: The standard ANALYZE computes statistics from a few thousands of
+ * sample rows, that are too small for the multi-TB Arrow_Fdw tables.
+ * pgstrom.gpu_analyze() instead feeds all the rows of the columns to GPU,
+ * then each chunk of the keys is processed by the kernel below; it updates
+ * the HyperLogLog registers for ndistinct, and picks up the samples by
+ * Bernoulli sampling according to the row position. Once all the rows are
+ * fed, the samples are sorted by bitonic-sorting on the device, then the
+ * MCV list and the equi-depth histogram are built from the sorted keys.
+ * Unless the number of rows exceeds pg_strom.gpu_analyze_max_rows, all the
+ * rows are sampled, so the statistics are exact.
+ *
+ * Keys are 64bit unsigned integers that keep the order of the datum, by
+ * gpu_btree_encode_datum(), so only the fixed-length data types that have
+ * the trivial order are supported. Other columns keep the statistics of
+ * the standard ANALYZE.
+ */
+static const char *gpu_analyze_kernel_source =
+	"typedef struct {\n"
+	"  cl_ulong  *samples;\n"
+	"  cl_uint    nrooms;\n"
+	"  cl_uint    nsamples;\n"
+	"  cl_uint    threshold;\n"
+	"  cl_uint    __padding;\n"
+	"  cl_uint    hll_regs[HLL_NUM_REGISTERS];\n"
+	"} kern_gpuanalyze;\n"
+	"\n"
+	"STATIC_INLINE(cl_uint)\n"
+	"__gpuanalyze_hash(cl_ulong x)\n"
+	"{\n"
+	"  x ^= (x >> 33);\n"
+	"  x *= 0xff51afd7ed558ccdUL;\n"
+	"  x ^= (x >> 33);\n"
+	"  x *= 0xc4ceb9fe1a85ec53UL;\n"
+	"  x ^= (x >> 33);\n"
+	"  return (cl_uint)x;\n"
+	"}\n"
+	"\n"
+	"KERNEL_FUNCTION(void)\n"
+	"gpuanalyze_hll_sample(kern_gpuanalyze *kgana,\n"
+	"                      const cl_ulong *keys,\n"
+	"                      cl_uint nitems,\n"
+	"                      cl_ulong base)\n"
+	"{\n"
+	"  cl_uint    i;\n"
+	"\n"
+	"  for (i = get_global_id(); i < nitems; i += get_global_size())\n"
+	"  {\n"
+	"    cl_ulong  key = keys[i];\n"
+	"    cl_uint   hash = __gpuanalyze_hash(key);\n"
+	"    cl_uint   bits = (hash << HLL_REGISTER_BITS);\n"
+	"    cl_uint   rank = (bits == 0 ? 32 - HLL_REGISTER_BITS : __clz(bits)) + 1;\n"
+	"\n"
+	"    atomicMax(&kgana->hll_regs[hash >> (32 - HLL_REGISTER_BITS)], rank);\n"
+	"    if (__gpuanalyze_hash(~(base + i)) <= kgana->threshold)\n"
+	"    {\n"
+	"      cl_uint  pos = atomicAdd(&kgana->nsamples, 1);\n"
+	"\n"
+	"      if (pos < kgana->nrooms)\n"
+	"        kgana->samples[pos] = key;\n"
+	"    }\n"
+	"  }\n"
+	"}\n"
+	"\n"
+	"KERNEL_FUNCTION(void)\n"
+	"gpuanalyze_bitonic_step(cl_ulong *samples,\n"
+	"                        cl_uint nitems,\n"
+	"                        cl_uint j,\n"
+	"                        cl_uint k)\n"
+	"{\n"
+	"  cl_uint    i;\n"
+	"\n"
+	"  for (i = get_global_id(); i < nitems; i += get_global_size())\n"
+	"  {\n"
+	"    cl_uint   l = (i ^ j);\n"
+	"\n"
+	"    if (l > i)\n"
+	"    {\n"
+	"      cl_ulong  a = samples[i];\n"
+	"      cl_ulong  b = samples[l];\n"
+	"\n"
+	"      if ((i & k) == 0 ? a > b : a < b)\n"
+	"      {\n"
+	"        samples[i] = b;\n"
+	"        samples[l] = a;\n"
+	"      }\n"
+	"    }\n"
+	"  }\n"
+	"}\n";
+
+/* host side definition; must be identical to the kernel source above */
+typedef struct
+{
+	CUdeviceptr	samples;
+	cl_uint		nrooms;
+	cl_uint		nsamples;
+	cl_uint		threshold;
+	cl_uint		__padding;
+	cl_uint		hll_regs[HLL_NUM_REGISTERS];
+} kern_gpuanalyze;
+
+#define GPU_ANALYZE_CHUNK_NITEMS	(1U << 20)
+
+struct gpuAnalyzeState
+{
+	Relation	frel;
+	Form_pg_attribute attr;
+	uint64		nvalues;		/* number of non-NULL values fed */
+	uint64		nnulls;			/* number of NULLs fed */
+	GpuContext *gcontext;
+	ProgramId	program_id;
+	CUfunction	kern_hll_sample;
+	CUfunction	kern_bitonic_step;
+	CUdeviceptr	m_kgana;
+	CUdeviceptr	m_samples;
+	CUdeviceptr	m_chunk;
+	cl_uint		nrooms;			/* power of 2 */
+	cl_uint		chunk_nitems;
+	uint64		chunk_base;		/* sequential number of the chunk head */
+};
+
+typedef struct
+{
+	cl_ulong	key;
+	cl_uint		count;
+} gpuAnalyzeTrackItem;
+
+/* static variables */
+static int		pgstrom_gpu_analyze_max_rows;		/* GUC */
+
+Datum pgstrom_gpu_analyze(PG_FUNCTION_ARGS);
+
+/*
+ * gpuAnalyzeSupportedColumn
+ */
+bool
+gpuAnalyzeSupportedColumn(Form_pg_attribute attr)
+{
+	if (attr->attisdropped || attr->attstattarget == 0)
+		return false;
+	switch (attr->atttypid)
+	{
+		case BOOLOID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case DATEOID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+/*
+ * __gpuAnalyzeLaunch
+ */
+static void
+__gpuAnalyzeLaunch(gpuAnalyzeState *gas, CUfunction kern_func,
+				   size_t nitems, void **kern_args)
+{
+	CUresult	rc;
+	int			grid_sz;
+	int			block_sz;
+
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_func,
+							 gas->gcontext->cuda_device,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Min(grid_sz, (nitems + block_sz - 1) / block_sz);
+	rc = cuLaunchKernel(kern_func,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+}
+
+/*
+ * __gpuAnalyzeFlushChunk
+ */
+static void
+__gpuAnalyzeFlushChunk(gpuAnalyzeState *gas)
+{
+	void	   *kern_args[4];
+	CUresult	rc;
+
+	if (gas->chunk_nitems == 0)
+		return;
+	kern_args[0] = &gas->m_kgana;
+	kern_args[1] = &gas->m_chunk;
+	kern_args[2] = &gas->chunk_nitems;
+	kern_args[3] = &gas->chunk_base;
+	__gpuAnalyzeLaunch(gas, gas->kern_hll_sample,
+					   gas->chunk_nitems, kern_args);
+	/* the chunk buffer is reused by the host next */
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+	gas->chunk_base += gas->chunk_nitems;
+	gas->chunk_nitems = 0;
+
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * gpuAnalyzeBeginColumn
+ *
+ * @totalrows is the expected number of rows, to determine the sampling
+ * ratio if it is larger than pg_strom.gpu_analyze_max_rows.
+ */
+gpuAnalyzeState *
+gpuAnalyzeBeginColumn(Relation frel, AttrNumber attnum,
+					  double totalrows, int cuda_dindex)
+{
+	gpuAnalyzeState *gas = palloc0(sizeof(gpuAnalyzeState));
+	kern_gpuanalyze *kgana;
+	CUmodule	cuda_module;
+	CUresult	rc;
+	cl_uint		nrooms;
+
+	gas->frel = frel;
+	gas->attr = tupleDescAttr(RelationGetDescr(frel), attnum - 1);
+	Assert(gpuAnalyzeSupportedColumn(gas->attr));
+
+	nrooms = Min(Max(totalrows, 1.0), (double)pgstrom_gpu_analyze_max_rows);
+	for (gas->nrooms = 1; gas->nrooms < nrooms; gas->nrooms <<= 1);
+
+	gas->gcontext = AllocGpuContext(cuda_dindex, true, false);
+	gas->program_id = pgstrom_create_cuda_program(gas->gcontext,
+												  0,
+												  0,
+												  gpu_analyze_kernel_source,
+												  "",
+												  true,
+												  false);
+	cuda_module = GpuContextLookupModule(gas->gcontext, gas->program_id);
+	rc = cuModuleGetFunction(&gas->kern_hll_sample,
+							 cuda_module,
+							 "gpuanalyze_hll_sample");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&gas->kern_bitonic_step,
+							 cuda_module,
+							 "gpuanalyze_bitonic_step");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
+	rc = gpuMemAllocManaged(gas->gcontext, &gas->m_kgana,
+							sizeof(kern_gpuanalyze),
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	rc = gpuMemAllocManaged(gas->gcontext, &gas->m_samples,
+							sizeof(cl_ulong) * (size_t)gas->nrooms,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	rc = gpuMemAllocManaged(gas->gcontext, &gas->m_chunk,
+							sizeof(cl_ulong) * GPU_ANALYZE_CHUNK_NITEMS,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+
+	/*
+	 * Bernoulli sampling, if the table is larger than the buffer. The ratio
+	 * is a bit smaller than the capacity, because the samples that overflow
+	 * the buffer are dropped regardless of the position.
+	 */
+	kgana = (kern_gpuanalyze *)gas->m_kgana;
+	memset(kgana, 0, sizeof(kern_gpuanalyze));
+	kgana->samples = gas->m_samples;
+	kgana->nrooms = nrooms;
+	if (totalrows <= (double)nrooms)
+		kgana->threshold = UINT_MAX;
+	else
+		kgana->threshold = (cl_uint)(0.95 * (double)UINT_MAX *
+									 ((double)nrooms / totalrows));
+	return gas;
+}
+
+/*
+ * gpuAnalyzePutDatum
+ */
+void
+gpuAnalyzePutDatum(gpuAnalyzeState *gas, Datum datum, bool isnull)
+{
+	cl_ulong   *chunk = (cl_ulong *)gas->m_chunk;
+
+	if (isnull)
+	{
+		gas->nnulls++;
+		return;
+	}
+	chunk[gas->chunk_nitems++] = gpu_btree_encode_datum(gas->attr->atttypid,
+														datum);
+	gas->nvalues++;
+	if (gas->chunk_nitems >= GPU_ANALYZE_CHUNK_NITEMS)
+		__gpuAnalyzeFlushChunk(gas);
+}
+
+/*
+ * __gpuAnalyzeHllEstimate - same as pgstrom.hll_count()
+ */
+static double
+__gpuAnalyzeHllEstimate(const cl_uint *hll_regs)
+{
+	const double two_to_32 = 4294967296.0;
+	double		m = (double)HLL_NUM_REGISTERS;
+	double		alpha = 0.7213 / (1.0 + 1.079 / m);
+	double		sum = 0.0;
+	double		estimate;
+	int			nzeros = 0;
+	int			i;
+
+	for (i=0; i < HLL_NUM_REGISTERS; i++)
+	{
+		sum += ldexp(1.0, -(int)hll_regs[i]);
+		if (hll_regs[i] == 0)
+			nzeros++;
+	}
+	estimate = alpha * m * m / sum;
+	if (estimate <= 2.5 * m && nzeros > 0)
+		estimate = m * log(m / (double)nzeros);		/* small range correction */
+	else if (estimate > two_to_32 / 30.0)
+		estimate = -two_to_32 * log(1.0 - estimate / two_to_32);
+	return estimate;
+}
+
+static int
+__gpuAnalyzeCompareKey(const void *__a, const void *__b)
+{
+	cl_ulong	a = *((const cl_ulong *)__a);
+	cl_ulong	b = *((const cl_ulong *)__b);
+
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+/*
+ * __gpuAnalyzeUpdateStatistics
+ *
+ * It writes the statistics on pg_statistic, like update_attstats() doing.
+ */
+static void
+__gpuAnalyzeUpdateStatistics(Relation frel, Form_pg_attribute attr,
+							 float4 stanullfrac, float4 stadistinct,
+							 int nmcv, Datum *mcv_values, Datum *mcv_freqs,
+							 int nhist, Datum *hist_values)
+{
+	Relation	sd;
+	HeapTuple	oldtup;
+	HeapTuple	stup;
+	Datum		values[Natts_pg_statistic];
+	bool		nulls[Natts_pg_statistic];
+	bool		replaces[Natts_pg_statistic];
+	int16		stakind[STATISTIC_NUM_SLOTS];
+	Oid			staop[STATISTIC_NUM_SLOTS];
+	Datum		stanumbers[STATISTIC_NUM_SLOTS];
+	Datum		stavalues[STATISTIC_NUM_SLOTS];
+	Oid			ltopr;
+	Oid			eqopr;
+	int			i, k = 0;
+
+	memset(stakind, 0, sizeof(stakind));
+	memset(staop, 0, sizeof(staop));
+	memset(stanumbers, 0, sizeof(stanumbers));
+	memset(stavalues, 0, sizeof(stavalues));
+	get_sort_group_operators(attr->atttypid,
+							 true, true, false,
+							 &ltopr, &eqopr, NULL, NULL);
+	if (nmcv > 0)
+	{
+		stakind[k] = STATISTIC_KIND_MCV;
+		staop[k] = eqopr;
+		stanumbers[k] = PointerGetDatum(construct_array(mcv_freqs, nmcv,
+														FLOAT4OID,
+														sizeof(float4),
+														FLOAT4PASSBYVAL,
+														'i'));
+		stavalues[k] = PointerGetDatum(construct_array(mcv_values, nmcv,
+													   attr->atttypid,
+													   attr->attlen,
+													   attr->attbyval,
+													   attr->attalign));
+		k++;
+	}
+	if (nhist > 1)
+	{
+		stakind[k] = STATISTIC_KIND_HISTOGRAM;
+		staop[k] = ltopr;
+		stavalues[k] = PointerGetDatum(construct_array(hist_values, nhist,
+													   attr->atttypid,
+													   attr->attlen,
+													   attr->attbyval,
+													   attr->attalign));
+		k++;
+	}
+
+	memset(nulls, 0, sizeof(nulls));
+	memset(replaces, 1, sizeof(replaces));
+	values[Anum_pg_statistic_starelid - 1] = ObjectIdGetDatum(RelationGetRelid(frel));
+	values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(attr->attnum);
+	values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(false);
+	values[Anum_pg_statistic_stanullfrac - 1] = Float4GetDatum(stanullfrac);
+	values[Anum_pg_statistic_stawidth - 1] = Int32GetDatum(attr->attlen);
+	values[Anum_pg_statistic_stadistinct - 1] = Float4GetDatum(stadistinct);
+	for (i=0; i < STATISTIC_NUM_SLOTS; i++)
+	{
+		values[Anum_pg_statistic_stakind1 - 1 + i] = Int16GetDatum(stakind[i]);
+		values[Anum_pg_statistic_staop1 - 1 + i] = ObjectIdGetDatum(staop[i]);
+#if PG_VERSION_NUM >= 120000
+		values[Anum_pg_statistic_stacoll1 - 1 + i]
+			= ObjectIdGetDatum(stakind[i] != 0 ? attr->attcollation : InvalidOid);
+#endif
+		values[Anum_pg_statistic_stanumbers1 - 1 + i] = stanumbers[i];
+		nulls[Anum_pg_statistic_stanumbers1 - 1 + i] = (stanumbers[i] == 0);
+		values[Anum_pg_statistic_stavalues1 - 1 + i] = stavalues[i];
+		nulls[Anum_pg_statistic_stavalues1 - 1 + i] = (stavalues[i] == 0);
+	}
+
+	sd = table_open(StatisticRelationId, RowExclusiveLock);
+	oldtup = SearchSysCache3(STATRELATTINH,
+							 ObjectIdGetDatum(RelationGetRelid(frel)),
+							 Int16GetDatum(attr->attnum),
+							 BoolGetDatum(false));
+	if (HeapTupleIsValid(oldtup))
+	{
+		stup = heap_modify_tuple(oldtup, RelationGetDescr(sd),
+								 values, nulls, replaces);
+		ReleaseSysCache(oldtup);
+		CatalogTupleUpdate(sd, &stup->t_self, stup);
+	}
+	else
+	{
+		stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
+		CatalogTupleInsert(sd, stup);
+	}
+	heap_freetuple(stup);
+	table_close(sd, RowExclusiveLock);
+}
+
+/*
+ * __gpuAnalyzeComputeStats
+ *
+ * It builds the statistics from the sorted samples, in the same manner as
+ * compute_scalar_stats() doing. If all the rows are sampled, ndistinct is
+ * the exact number of the distinct keys; elsewhere, HLL estimation over
+ * all the rows is used.
+ */
+static void
+__gpuAnalyzeComputeStats(gpuAnalyzeState *gas, const cl_ulong *keys,
+						 cl_uint nsamples, const cl_uint *hll_regs)
+{
+	Form_pg_attribute attr = gas->attr;
+	Oid			type_oid = attr->atttypid;
+	double		totalrows = (double)(gas->nvalues + gas->nnulls);
+	double		nonnull_frac;
+	double		stadistinct;
+	int			num_mcv;
+	int			num_hist;
+	gpuAnalyzeTrackItem *track;
+	int			track_cnt = 0;
+	int			nmcv = 0;
+	int			nhist = 0;
+	Datum	   *mcv_values = NULL;
+	Datum	   *mcv_freqs = NULL;
+	Datum	   *hist_values = NULL;
+	cl_ulong   *mcv_keys = NULL;
+	uint64		mcv_count = 0;
+	uint64		ndistinct = 0;
+	uint64		i, j;
+
+	if (totalrows == 0.0)
+		return;		/* empty table */
+	nonnull_frac = (double)gas->nvalues / totalrows;
+	if (gas->nvalues == 0)
+	{
+		/* all NULLs */
+		__gpuAnalyzeUpdateStatistics(gas->frel, attr,
+									 1.0, 0.0,
+									 0, NULL, NULL,
+									 0, NULL);
+		return;
+	}
+	if (nsamples == 0)
+		return;		/* should not happen */
+	num_mcv = (attr->attstattarget < 0
+			   ? default_statistics_target
+			   : attr->attstattarget);
+	num_hist = num_mcv + 1;
+
+	/* count the distinct keys, and track the most common ones */
+	track = palloc(sizeof(gpuAnalyzeTrackItem) * num_mcv);
+	for (i=0; i < nsamples; i=j)
+	{
+		cl_uint		count;
+
+		for (j=i+1; j < nsamples && keys[j] == keys[i]; j++);
+		count = j - i;
+		ndistinct++;
+		if (track_cnt < num_mcv || count > track[track_cnt-1].count)
+		{
+			int		k;
+
+			if (track_cnt < num_mcv)
+				track_cnt++;
+			for (k=track_cnt-1; k > 0 && track[k-1].count < count; k--)
+				track[k] = track[k-1];
+			track[k].key = keys[i];
+			track[k].count = count;
+		}
+	}
+
+	/* ndistinct */
+	if (nsamples == gas->nvalues)
+		stadistinct = (double)ndistinct;
+	else
+	{
+		stadistinct = __gpuAnalyzeHllEstimate(hll_regs);
+		stadistinct = Max(stadistinct, (double)ndistinct);
+		stadistinct = Min(stadistinct, (double)gas->nvalues);
+	}
+	stadistinct = floor(stadistinct + 0.5);
+	if (stadistinct > 0.1 * totalrows)
+		stadistinct = -(stadistinct / totalrows);
+
+	/* MCV */
+	if (nsamples == gas->nvalues && ndistinct <= (uint64)num_mcv)
+		nmcv = track_cnt;
+	else
+	{
+		double	avgcount = (double)nsamples / (double)ndistinct;
+		double	mincount = Max(1.25 * avgcount, 2.0);
+
+		while (nmcv < track_cnt && track[nmcv].count >= mincount)
+			nmcv++;
+	}
+	if (nmcv > 0)
+	{
+		mcv_values = palloc(sizeof(Datum) * nmcv);
+		mcv_freqs = palloc(sizeof(Datum) * nmcv);
+		mcv_keys = palloc(sizeof(cl_ulong) * nmcv);
+		for (i=0; i < nmcv; i++)
+		{
+			mcv_values[i] = gpu_btree_decode_datum(type_oid, track[i].key);
+			mcv_freqs[i] = Float4GetDatum((double)track[i].count /
+										  (double)nsamples * nonnull_frac);
+			mcv_keys[i] = track[i].key;
+			mcv_count += track[i].count;
+		}
+		qsort(mcv_keys, nmcv, sizeof(cl_ulong), __gpuAnalyzeCompareKey);
+	}
+
+	/* equi-depth histogram of the keys except for MCVs */
+	if (ndistinct - nmcv >= 2)
+	{
+		uint64		nvals = nsamples - mcv_count;
+		int			nbounds = Min((uint64)num_hist, ndistinct - nmcv);
+		uint64		index = 0;
+		int			t = 0;
+
+		hist_values = palloc(sizeof(Datum) * nbounds);
+		for (i=0; i < nsamples && t < nbounds; i=j)
+		{
+			uint64		pos;
+
+			for (j=i+1; j < nsamples && keys[j] == keys[i]; j++);
+			if (nmcv > 0 && bsearch(&keys[i], mcv_keys, nmcv, sizeof(cl_ulong),
+									__gpuAnalyzeCompareKey) != NULL)
+				continue;
+			pos = (uint64)((double)t * (double)(nvals - 1) /
+						   (double)(nbounds - 1));
+			if (pos < index + (j - i))
+			{
+				hist_values[nhist++] = gpu_btree_decode_datum(type_oid, keys[i]);
+				/* skip the bounds inside of this key */
+				do {
+					t++;
+					pos = (uint64)((double)t * (double)(nvals - 1) /
+								   (double)(nbounds - 1));
+				} while (t < nbounds && pos < index + (j - i));
+			}
+			index += (j - i);
+		}
+	}
+	__gpuAnalyzeUpdateStatistics(gas->frel, attr,
+								 (double)gas->nnulls / totalrows,
+								 stadistinct,
+								 nmcv, mcv_values, mcv_freqs,
+								 nhist, hist_values);
+}
+
+/*
+ * gpuAnalyzeEndColumn
+ */
+void
+gpuAnalyzeEndColumn(gpuAnalyzeState *gas)
+{
+	kern_gpuanalyze *kgana = (kern_gpuanalyze *)gas->m_kgana;
+	cl_ulong   *samples = (cl_ulong *)gas->m_samples;
+	cl_uint		nsamples;
+	cl_uint		nitems;
+	cl_uint		i, j, k;
+	void	   *kern_args[4];
+	CUresult	rc;
+
+	__gpuAnalyzeFlushChunk(gas);
+	nsamples = Min(kgana->nsamples, kgana->nrooms);
+
+	/* bitonic-sorting on the samples padded to 2^N */
+	for (nitems = 1; nitems < nsamples; nitems <<= 1);
+	Assert(nitems <= gas->nrooms);
+	for (i = nsamples; i < nitems; i++)
+		samples[i] = ULONG_MAX;
+	kern_args[0] = &gas->m_samples;
+	kern_args[1] = &nitems;
+	kern_args[2] = &j;
+	kern_args[3] = &k;
+	for (k = 2; k <= nitems; k <<= 1)
+	{
+		for (j = (k >> 1); j > 0; j >>= 1)
+			__gpuAnalyzeLaunch(gas, gas->kern_bitonic_step,
+							   nitems, kern_args);
+	}
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+
+	__gpuAnalyzeComputeStats(gas, samples, nsamples, kgana->hll_regs);
+
+	rc = gpuMemFree(gas->gcontext, gas->m_chunk);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+	rc = gpuMemFree(gas->gcontext, gas->m_samples);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+	rc = gpuMemFree(gas->gcontext, gas->m_kgana);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+	pgstrom_put_cuda_program(gas->gcontext, gas->program_id);
+	PutGpuContext(gas->gcontext);
+	pfree(gas);
+}
+
+/*
+ * pgstrom_gpu_analyze
+ *
+ * pgstrom.gpu_analyze(regclass) updates the statistics of Arrow_Fdw or
+ * Gstore_Fdw foreign table using GPU. Columns of unsupported data types
+ * keep the statistics by the standard ANALYZE.
+ */
+Datum
+pgstrom_gpu_analyze(PG_FUNCTION_ARGS)
+{
+	Oid			ftable_oid = PG_GETARG_OID(0);
+	Relation	frel;
+	double		totalrows;
+
+	frel = table_open(ftable_oid, ShareUpdateExclusiveLock);
+	if (!pg_class_ownercheck(ftable_oid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, OBJECT_FOREIGN_TABLE,
+					   RelationGetRelationName(frel));
+	if (RelationIsArrowFdw(frel))
+		totalrows = arrowFdwGpuAnalyze(frel);
+	else if (RelationIsGstoreFdw(frel))
+		totalrows = gstoreFdwGpuAnalyze(frel);
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is neither arrow_fdw nor gstore_fdw foreign table",
+						RelationGetRelationName(frel))));
+	vac_update_relstats(frel,
+						RelationGetForm(frel)->relpages,
+						totalrows,
+						0,
+						false,
+						InvalidTransactionId,
+						InvalidMultiXactId,
+						false);
+	table_close(frel, NoLock);
+
+	PG_RETURN_VOID();
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_analyze);
+
+/*
+ * pgstrom_init_gpu_analyze
+ */
+void
+pgstrom_init_gpu_analyze(void)
+{
+	DefineCustomIntVariable("pg_strom.gpu_analyze_max_rows",
+							"Max number of rows sampled by pgstrom.gpu_analyze()",
+							NULL,
+							&pgstrom_gpu_analyze_max_rows,
+							20000000,
+							10000,
+							(1 << 30),
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+}
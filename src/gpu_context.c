@@ -32,15 +32,146 @@ typedef struct CudaResource
 	CUdevice		cuda_device;
 	CUcontext		cuda_context;
 	bool			can_reuse;
+	/* CUDA context being created in background, if any */
+	bool			prewarm_running;
+	pthread_t		prewarm_thread;
+	CUdevice		prewarm_device;
+	CUcontext		prewarm_context;
+	CUresult		prewarm_rc;
+	/* modules kept loaded across queries, if context is reused */
+	dlist_head		module_cache;
+	cl_int			num_cached_modules;
 } CudaResource;
 
+/* CUDA module kept loaded on the reused CUDA context */
+typedef struct CudaModuleCache
+{
+	dlist_node		chain;
+	ProgramId		program_id;
+	CUmodule		cuda_module;
+} CudaModuleCache;
+
+#define CUDA_MODULE_CACHE_MAX_NUMS		32
+
 /* variables */
 int					pgstrom_max_async_tasks;		/* GUC */
+int					pgstrom_scan_readahead_chunks;	/* GUC */
+int					pgstrom_gpu_stream_priority;	/* GUC */
 bool				pgstrom_reuse_cuda_context;	/* GUC */
+static bool			pgstrom_prewarm_cuda_context;	/* GUC */
+bool				pgstrom_enable_cuda_graph;	/* GUC */
 static CudaResource *cuda_resources_array = NULL;
+static slock_t		cudaModuleCacheLock;
 static slock_t		activeGpuContextLock;
 static dlist_head	activeGpuContextList;
 
+/*
+ * GpuDeviceLoad - shared statistics of the workload per GPU device, to
+ * choose the least loaded device if GpuContext has no preference.
+ * The cumulative counters are exposed by pgstrom.pg_stat_gpu_device.
+ */
+typedef struct GpuDeviceLoad
+{
+	pg_atomic_uint32	nr_contexts;		/* # of active GpuContexts */
+	pg_atomic_uint32	nr_running_tasks;	/* # of GpuTasks in execution */
+	/* cumulative statistics */
+	pg_atomic_uint64	nr_tasks;			/* # of GpuTasks processed */
+	pg_atomic_uint64	nr_retries;			/* # of retries by lack of
+											 * GPU resources */
+	pg_atomic_uint64	busy_time;			/* total exec time in usec */
+	pg_atomic_uint64	bytes_h2d;			/* RAM-to-GPU DMA in bytes */
+	pg_atomic_uint64	bytes_d2h;			/* GPU-to-RAM DMA in bytes */
+	pg_atomic_uint64	bytes_gpudirect;	/* SSD-to-GPU DMA in bytes */
+} GpuDeviceLoad;
+
+static GpuDeviceLoad *gpuDeviceLoadArray = NULL;
+static shmem_startup_hook_type shmem_startup_next = NULL;
+
+/*
+ * GpuContextUpdateRunningTasks - update number of GpuTasks in execution
+ */
+static inline void
+GpuContextUpdateRunningTasks(GpuContext *gcontext, int delta)
+{
+	if (!gpuDeviceLoadArray)
+		return;
+	if (delta > 0)
+	{
+		pg_atomic_fetch_add_u32(&gcontext->nr_running_tasks, delta);
+		pg_atomic_fetch_add_u32(&gpuDeviceLoadArray[gcontext->cuda_dindex]
+								.nr_running_tasks, delta);
+	}
+	else
+	{
+		pg_atomic_fetch_sub_u32(&gcontext->nr_running_tasks, -delta);
+		pg_atomic_fetch_sub_u32(&gpuDeviceLoadArray[gcontext->cuda_dindex]
+								.nr_running_tasks, -delta);
+	}
+}
+
+/* bytes sent to the device by the current task (per worker thread) */
+static __thread size_t		GpuWorkerDMABytes = 0;
+
+/*
+ * gpuDeviceCountDMA - update the cumulative DMA statistics of the device
+ */
+void
+gpuDeviceCountDMA(GpuContext *gcontext,
+				  size_t h2d_sz, size_t d2h_sz, size_t gpudirect_sz)
+{
+	GpuDeviceLoad *dload;
+
+	GpuWorkerDMABytes += (h2d_sz + gpudirect_sz);
+	if (!gpuDeviceLoadArray)
+		return;
+	dload = &gpuDeviceLoadArray[gcontext->cuda_dindex];
+	if (h2d_sz > 0)
+		pg_atomic_fetch_add_u64(&dload->bytes_h2d, h2d_sz);
+	if (d2h_sz > 0)
+		pg_atomic_fetch_add_u64(&dload->bytes_d2h, d2h_sz);
+	if (gpudirect_sz > 0)
+		pg_atomic_fetch_add_u64(&dload->bytes_gpudirect, gpudirect_sz);
+}
+
+/*
+ * gpuDeviceLeastLoadedAmong - choose the GPU device that has the least number
+ * of GpuTasks in execution and active GpuContexts, among the candidate
+ * devices in the bitmap. Start point of the search depends on the process,
+ * to distribute concurrent sessions on idle devices.
+ */
+int
+gpuDeviceLeastLoadedAmong(cl_ulong devmask)
+{
+	int			base;
+	int			i, k;
+	int			best = -1;
+	uint64		best_load = 0;
+
+	base = (IsParallelWorker()
+			? ParallelWorkerNumber
+			: MyProc->pgprocno) % numDevAttrs;
+	for (i=0; i < numDevAttrs; i++)
+	{
+		GpuDeviceLoad *dload;
+		uint64		curr_load;
+
+		k = (base + i) % numDevAttrs;
+		if (k < GPU_DEVICE_MASK_BITS && (devmask & (1UL << k)) == 0)
+			continue;
+		if (!gpuDeviceLoadArray)
+			return k;
+		dload = &gpuDeviceLoadArray[k];
+		curr_load = (((uint64)pg_atomic_read_u32(&dload->nr_running_tasks) << 32) |
+					 (uint64)pg_atomic_read_u32(&dload->nr_contexts));
+		if (best < 0 || curr_load < best_load)
+		{
+			best = k;
+			best_load = curr_load;
+		}
+	}
+	return (best < 0 ? base : best);
+}
+
 /*
  * Resource tracker of GpuContext
  *
@@ -425,6 +556,107 @@ gpuIpcCloseMemHandle(GpuContext *gcontext, CUdeviceptr m_deviceptr)
 	return CUDA_ERROR_INVALID_VALUE;
 }
 
+/*
+ * lookupCachedCudaModule - takes a module out of the module cache of the
+ * reused CUDA context, if any. It is tracked by GpuContext during the
+ * query, then returned to the cache by ReleaseLocalResources().
+ */
+static CUmodule
+lookupCachedCudaModule(cl_int dindex, ProgramId program_id)
+{
+	CudaResource *cuda_resource = &cuda_resources_array[dindex];
+	CUmodule	cuda_module = NULL;
+	dlist_mutable_iter iter;
+
+	SpinLockAcquire(&cudaModuleCacheLock);
+	dlist_foreach_modify(iter, &cuda_resource->module_cache)
+	{
+		CudaModuleCache *mcache = dlist_container(CudaModuleCache,
+												  chain, iter.cur);
+		if (mcache->program_id == program_id)
+		{
+			dlist_delete(&mcache->chain);
+			cuda_resource->num_cached_modules--;
+			cuda_module = mcache->cuda_module;
+			free(mcache);
+			break;
+		}
+	}
+	SpinLockRelease(&cudaModuleCacheLock);
+
+	return cuda_module;
+}
+
+/*
+ * putCachedCudaModule - keeps the module loaded for the later queries.
+ * It returns false if the module should be unloaded by the caller.
+ */
+static bool
+putCachedCudaModule(cl_int dindex, ProgramId program_id, CUmodule cuda_module)
+{
+	CudaResource *cuda_resource = &cuda_resources_array[dindex];
+	CudaModuleCache *mcache;
+	CudaModuleCache *victim = NULL;
+	dlist_iter	iter;
+
+	if (!cuda_resource->can_reuse)
+		return false;
+	mcache = malloc(sizeof(CudaModuleCache));
+	if (!mcache)
+		return false;
+	mcache->program_id = program_id;
+	mcache->cuda_module = cuda_module;
+
+	SpinLockAcquire(&cudaModuleCacheLock);
+	dlist_foreach(iter, &cuda_resource->module_cache)
+	{
+		CudaModuleCache *temp = dlist_container(CudaModuleCache,
+												chain, iter.cur);
+		if (temp->program_id == program_id)
+		{
+			/* someone already cached the same module */
+			SpinLockRelease(&cudaModuleCacheLock);
+			free(mcache);
+			return false;
+		}
+	}
+	dlist_push_head(&cuda_resource->module_cache, &mcache->chain);
+	if (++cuda_resource->num_cached_modules > CUDA_MODULE_CACHE_MAX_NUMS)
+	{
+		victim = dlist_container(CudaModuleCache, chain,
+								 dlist_tail_node(&cuda_resource->module_cache));
+		dlist_delete(&victim->chain);
+		cuda_resource->num_cached_modules--;
+	}
+	SpinLockRelease(&cudaModuleCacheLock);
+
+	if (victim)
+	{
+		CUresult	rc = cuModuleUnload(victim->cuda_module);
+
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on cuModuleUnload: %s", errorText(rc));
+		free(victim);
+	}
+	return true;
+}
+
+/*
+ * releaseCachedCudaModules - forget the module cache; modules are unloaded
+ * by cuCtxDestroy.
+ */
+static void
+releaseCachedCudaModules(CudaResource *cuda_resource)
+{
+	while (!dlist_is_empty(&cuda_resource->module_cache))
+	{
+		dlist_node *dnode = dlist_pop_head_node(&cuda_resource->module_cache);
+
+		free(dlist_container(CudaModuleCache, chain, dnode));
+	}
+	cuda_resource->num_cached_modules = 0;
+}
+
 /*
  * __GpuContextLookupModule
  */
@@ -458,7 +690,10 @@ __GpuContextLookupModule(GpuContext *gcontext, ProgramId program_id,
 
 		if (!cuda_module)
 		{
-			cuda_module = pgstrom_load_cuda_program(program_id);
+			cuda_module = lookupCachedCudaModule(gcontext->cuda_dindex,
+												 program_id);
+			if (!cuda_module)
+				cuda_module = pgstrom_load_cuda_program(program_id);
 			tracker = calloc(1, sizeof(ResourceTracker));
             if (!tracker)
 			{
@@ -499,6 +734,16 @@ ReleaseLocalResources(GpuContext *gcontext, bool normal_exit)
 	int			i;
 
 	Assert(!gcontext->worker_is_running);
+	/* detach from the device load statistics */
+	if (gpuDeviceLoadArray)
+	{
+		GpuDeviceLoad *dload = &gpuDeviceLoadArray[gcontext->cuda_dindex];
+		uint32		nr_tasks = pg_atomic_read_u32(&gcontext->nr_running_tasks);
+
+		if (nr_tasks > 0)
+			pg_atomic_fetch_sub_u32(&dload->nr_running_tasks, nr_tasks);
+		pg_atomic_fetch_sub_u32(&dload->nr_contexts, 1);
+	}
 	/* OK, release other resources */
 	for (i=0; i < RESTRACK_HASHSIZE; i++)
 	{
@@ -532,6 +777,15 @@ ReleaseLocalResources(GpuContext *gcontext, bool normal_exit)
 							wnotice("failed on cuMemFreeHost: %s", errorText(rc));
 						GPUCONTEXT_POP(gcontext);
 					}
+					else if (tracker->u.devmem.extra == GPUMEM_DEVICE_POOL_EXTRA)
+					{
+						GPUCONTEXT_PUSH(gcontext);
+						rc = cuMemFreeAsync(tracker->u.devmem.ptr,
+											CU_STREAM_PER_WORKER);
+						if (rc != CUDA_SUCCESS)
+							wnotice("failed on cuMemFreeAsync: %s", errorText(rc));
+						GPUCONTEXT_POP(gcontext);
+					}
 					break;
 				case RESTRACK_CLASS__GPUMEMORY_IPC:
 					if (normal_exit)
@@ -575,6 +829,12 @@ ReleaseLocalResources(GpuContext *gcontext, bool normal_exit)
 					gpuDirectFileDescClose(&tracker->u.filedesc);
 					break;
 				case RESTRACK_CLASS__GPUMODULE:
+					if (normal_exit &&
+						pgstrom_reuse_cuda_context &&
+						putCachedCudaModule(gcontext->cuda_dindex,
+											tracker->u.module.program_id,
+											tracker->u.module.cuda_module))
+						break;
 					rc = cuModuleUnload(tracker->u.module.cuda_module);
 					if (rc != CUDA_SUCCESS)
 						wnotice("failed on cuModuleUnload: %s", errorText(rc));
@@ -603,10 +863,12 @@ ReleaseLocalResources(GpuContext *gcontext, bool normal_exit)
 			(!cuda_resource->can_reuse ||
 			 !pgstrom_reuse_cuda_context))
 		{
+			releaseCachedCudaModules(cuda_resource);
 			rc = cuCtxDestroy(cuda_resource->cuda_context);
 			if (rc != CUDA_SUCCESS)
 				elog(WARNING, "failed on cuCtxDestroy: %s", errorText(rc));
 			memset(cuda_resource, 0, sizeof(CudaResource));
+			dlist_init(&cuda_resource->module_cache);
 		}
 	}
 
@@ -669,10 +931,216 @@ GpuContextWorkerReportError(int elevel,
 	siglongjmp(*GpuWorkerExceptionStack, 1);
 }
 
+/*
+ * gpuLaunchKernelSequence
+ *
+ * It launches a series of GPU kernels on the CU_STREAM_PER_WORKER.
+ * If pg_strom.enable_cuda_graph is on, the launch sequence is built as a
+ * CUDA graph at the first time, then replayed with the updated kernel
+ * parameters for the later GpuTasks, to cut down the launch overhead per
+ * chunk. Instantiated graphs are cached per worker thread.
+ */
+#if CUDA_VERSION >= 11040
+#define GPU_KERNEL_GRAPH_NSLOTS		8
+
+typedef struct
+{
+	cl_uint			nkernels;
+	cl_uint			last_used;
+	CUfunction		kern_functions[GPU_KERNEL_SEQUENCE_MAX];
+	cl_uint			grid_sz[GPU_KERNEL_SEQUENCE_MAX];
+	cl_uint			block_sz[GPU_KERNEL_SEQUENCE_MAX];
+	cl_uint			shmem_sz[GPU_KERNEL_SEQUENCE_MAX];
+	CUgraphNode		nodes[GPU_KERNEL_SEQUENCE_MAX];
+	CUgraph			graph;
+	CUgraphExec		graph_exec;
+} GpuKernelGraph;
+
+static __thread GpuKernelGraph gpuKernelGraphCache[GPU_KERNEL_GRAPH_NSLOTS];
+static __thread cl_uint		gpuKernelGraphClock = 0;
+
+static inline void
+__setupKernelNodeParams(CUDA_KERNEL_NODE_PARAMS *kparams,
+						GpuKernelLaunchInfo *klaunch)
+{
+	memset(kparams, 0, sizeof(CUDA_KERNEL_NODE_PARAMS));
+	kparams->func = klaunch->kern_function;
+	kparams->gridDimX = klaunch->grid_sz;
+	kparams->gridDimY = 1;
+	kparams->gridDimZ = 1;
+	kparams->blockDimX = klaunch->block_sz;
+	kparams->blockDimY = 1;
+	kparams->blockDimZ = 1;
+	kparams->sharedMemBytes = klaunch->shmem_sz;
+	kparams->kernelParams = klaunch->kern_args;
+}
+
+static CUresult
+__gpuLaunchKernelGraph(int nkernels, GpuKernelLaunchInfo *klaunch)
+{
+	CUDA_KERNEL_NODE_PARAMS kparams;
+	GpuKernelGraph *kgraph = NULL;
+	CUresult	rc;
+	int			i, k;
+
+	for (k=0; k < GPU_KERNEL_GRAPH_NSLOTS; k++)
+	{
+		GpuKernelGraph *curr = &gpuKernelGraphCache[k];
+
+		if (curr->nkernels != nkernels)
+			goto next;
+		for (i=0; i < nkernels; i++)
+		{
+			if (curr->kern_functions[i] != klaunch[i].kern_function ||
+				curr->grid_sz[i]  != klaunch[i].grid_sz ||
+				curr->block_sz[i] != klaunch[i].block_sz ||
+				curr->shmem_sz[i] != klaunch[i].shmem_sz)
+				goto next;
+		}
+		/* Ok, replay the graph with new kernel parameters */
+		for (i=0; i < nkernels; i++)
+		{
+			__setupKernelNodeParams(&kparams, &klaunch[i]);
+			rc = cuGraphExecKernelNodeSetParams(curr->graph_exec,
+												curr->nodes[i],
+												&kparams);
+			if (rc != CUDA_SUCCESS)
+				return rc;
+		}
+		curr->last_used = ++gpuKernelGraphClock;
+		return cuGraphLaunch(curr->graph_exec, CU_STREAM_PER_WORKER);
+	next:
+		/* pick up a free or the least recently used slot */
+		if (!kgraph || curr->nkernels == 0 ||
+			(kgraph->nkernels > 0 && kgraph->last_used > curr->last_used))
+			kgraph = curr;
+	}
+
+	/* construction of a new graph */
+	if (kgraph->nkernels > 0)
+	{
+		cuGraphExecDestroy(kgraph->graph_exec);
+		cuGraphDestroy(kgraph->graph);
+		kgraph->nkernels = 0;
+	}
+	rc = cuGraphCreate(&kgraph->graph, 0);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	for (i=0; i < nkernels; i++)
+	{
+		__setupKernelNodeParams(&kparams, &klaunch[i]);
+		rc = cuGraphAddKernelNode(&kgraph->nodes[i],
+								  kgraph->graph,
+								  (i > 0 ? &kgraph->nodes[i-1] : NULL),
+								  (i > 0 ? 1 : 0),
+								  &kparams);
+		if (rc != CUDA_SUCCESS)
+			goto error;
+		kgraph->kern_functions[i] = klaunch[i].kern_function;
+		kgraph->grid_sz[i]  = klaunch[i].grid_sz;
+		kgraph->block_sz[i] = klaunch[i].block_sz;
+		kgraph->shmem_sz[i] = klaunch[i].shmem_sz;
+	}
+	rc = cuGraphInstantiateWithFlags(&kgraph->graph_exec, kgraph->graph, 0);
+	if (rc != CUDA_SUCCESS)
+		goto error;
+	kgraph->nkernels = nkernels;
+	kgraph->last_used = ++gpuKernelGraphClock;
+
+	return cuGraphLaunch(kgraph->graph_exec, CU_STREAM_PER_WORKER);
+
+error:
+	cuGraphDestroy(kgraph->graph);
+	return rc;
+}
+
+/*
+ * gpuReleaseKernelGraphs - release the graphs cached by the worker thread
+ */
+static void
+gpuReleaseKernelGraphs(void)
+{
+	int		k;
+
+	for (k=0; k < GPU_KERNEL_GRAPH_NSLOTS; k++)
+	{
+		GpuKernelGraph *kgraph = &gpuKernelGraphCache[k];
+
+		if (kgraph->nkernels == 0)
+			continue;
+		cuGraphExecDestroy(kgraph->graph_exec);
+		cuGraphDestroy(kgraph->graph);
+		kgraph->nkernels = 0;
+	}
+}
+#else	/* CUDA_VERSION < 11040 */
+#define gpuReleaseKernelGraphs()		do {} while(0)
+#endif	/* CUDA_VERSION */
+
+CUresult
+gpuLaunchKernelSequence(int nkernels, GpuKernelLaunchInfo *klaunch)
+{
+	CUresult	rc;
+	int			i;
+
+	Assert(nkernels > 0 && nkernels <= GPU_KERNEL_SEQUENCE_MAX);
+#if CUDA_VERSION >= 11040
+	if (pgstrom_enable_cuda_graph)
+		return __gpuLaunchKernelGraph(nkernels, klaunch);
+#endif
+
+	for (i=0; i < nkernels; i++)
+	{
+		rc = cuLaunchKernel(klaunch[i].kern_function,
+							klaunch[i].grid_sz, 1, 1,
+							klaunch[i].block_sz, 1, 1,
+							klaunch[i].shmem_sz,
+							CU_STREAM_PER_WORKER,
+							klaunch[i].kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			return rc;
+	}
+	return CUDA_SUCCESS;
+}
+
 /*
  * GpuContextWorkerMain
  */
 __thread CUevent		CU_EVENT_PER_THREAD = NULL;
+__thread CUstream		CU_STREAM_PER_WORKER = CU_STREAM_PER_THREAD;
+
+/*
+ * GpuContextWorkerCreateStream
+ *
+ * Worker threads run GPU tasks on the per-thread default stream, unless
+ * the query requested a higher priority. So, GPU tasks of an interactive
+ * query can be scheduled prior to the ones of batch queries that share
+ * the same device.
+ */
+static void
+GpuContextWorkerCreateStream(GpuContext *gcontext)
+{
+	int			least_prio;
+	int			greatest_prio;
+	int			priority;
+	CUresult	rc;
+
+	if (gcontext->stream_priority <= 0)
+		return;
+	rc = cuCtxGetStreamPriorityRange(&least_prio, &greatest_prio);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuCtxGetStreamPriorityRange: %s", errorText(rc));
+	/* NOTE: numerically smaller value means higher priority */
+	priority = Max(least_prio - gcontext->stream_priority, greatest_prio);
+	if (priority == least_prio)
+		return;		/* device does not support stream priority */
+	rc = cuStreamCreateWithPriority(&CU_STREAM_PER_WORKER,
+									CU_STREAM_DEFAULT,
+									priority);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuStreamCreateWithPriority: %s", errorText(rc));
+}
 
 static void *
 GpuContextWorkerMain(void *arg)
@@ -696,6 +1164,8 @@ GpuContextWorkerMain(void *arg)
 		return NULL;
 	}
 	GpuWorkerCurrentContext = gcontext;
+	/* run on the CPUs local to the GPU device */
+	gpuDeviceBindLocalNumaNode(gcontext->cuda_dindex);
 
 	STROM_TRY();
 	{
@@ -704,12 +1174,18 @@ GpuContextWorkerMain(void *arg)
 						   CU_EVENT_BLOCKING_SYNC);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuEventCreate: %s", errorText(rc));
+		/* setup CU_STREAM_PER_WORKER variable */
+		GpuContextWorkerCreateStream(gcontext);
 
 		while (pg_atomic_read_u32(&gcontext->terminate_workers) == 0)
 		{
 			GpuTaskState *gts;
 			CUmodule	cuda_module;
 			cl_int		retval;
+			instr_time	tv_start;
+			instr_time	tv_jit;
+			instr_time	tv_end;
+			instr_time	tv_diff;
 
 			pthreadMutexLock(&gcontext->worker_mutex);
 			if (dlist_is_empty(&gcontext->pending_tasks))
@@ -734,11 +1210,53 @@ GpuContextWorkerMain(void *arg)
 			{
 				dnode = dlist_pop_head_node(&gcontext->pending_tasks);
 				gtask = dlist_container(GpuTask, chain, dnode);
+				gts = gtask->gts;
+				INSTR_TIME_SET_CURRENT(tv_start);
+				tv_diff = tv_start;
+				INSTR_TIME_SUBTRACT(tv_diff, gtask->tv_enqueue);
+				gts->time_queue_wait += INSTR_TIME_GET_MICROSEC(tv_diff);
 				pthreadMutexUnlock(&gcontext->worker_mutex);
 
-				gts = gtask->gts;
+				/*
+				 * If GPU program is still being built, GpuTask may be
+				 * processed by CPU fallback, instead of the wait for NVRTC.
+				 */
+				if (pgstrom_cpu_fallback_on_jit &&
+					gts->cb_fallback_task &&
+					!pgstrom_cuda_program_is_ready(gtask->program_id))
+				{
+					bool	done;
+
+					pgstromNvtxRangePush(gts, "jit fallback");
+					done = gts->cb_fallback_task(gtask);
+					pgstromNvtxRangePop();
+					if (!done)
+						goto gpu_exec;
+
+					INSTR_TIME_SET_CURRENT(tv_end);
+					tv_diff = tv_end;
+					INSTR_TIME_SUBTRACT(tv_diff, tv_start);
+					pthreadMutexLock(&gcontext->worker_mutex);
+					gts->time_jit_fallback += INSTR_TIME_GET_MICROSEC(tv_diff);
+					if (gts->trace_events)
+						pgstromTraceGpuTask(gts, gtask, &tv_start,
+											&tv_end, &tv_end, true);
+					dlist_push_tail(&gts->ready_tasks,
+									&gtask->chain);
+					gts->num_running_tasks--;
+					gts->num_ready_tasks++;
+					pthreadMutexUnlock(&gcontext->worker_mutex);
+
+					SetLatch(MyLatch);
+					continue;
+				}
+			gpu_exec:
+				pgstromNvtxRangePush(gts, "jit wait");
 				cuda_module = GpuContextLookupModule(gcontext,
 													 gtask->program_id);
+				pgstromNvtxRangePop();
+				INSTR_TIME_SET_CURRENT(tv_jit);
+				GpuContextUpdateRunningTasks(gcontext, 1);
 			retry_gputask:
 				/*
 				 * pgstromProcessGpuTask() returns the following status:
@@ -750,13 +1268,81 @@ GpuContextWorkerMain(void *arg)
 				 * <0 : GpuTask gets completed successfully, and the
 				 *      handler wants to release GpuTask immediately.
 				 */
+				pgstromNvtxRangePush(gts, "gpu exec");
+				GpuWorkerDMABytes = 0;
 				retval = gts->cb_process_task(gtask, cuda_module);
+				pgstromNvtxRangePop();
+				GpuContextUpdateRunningTasks(gcontext, -1);
+				/*
+				 * NOTE: elapsed time of the GPU execution includes DMA send,
+				 * kernel execution, and write-back of the results until the
+				 * synchronization point. The attempts cancelled due to lack of
+				 * GPU resources, and the 40ms sleep, are not counted.
+				 */
+				if (retval <= 0)
+				{
+					uint64		exec_time;
+
+					INSTR_TIME_SET_CURRENT(tv_end);
+					tv_diff = tv_end;
+					INSTR_TIME_SUBTRACT(tv_diff, tv_jit);
+					exec_time = INSTR_TIME_GET_MICROSEC(tv_diff);
+					tv_diff = tv_jit;
+					INSTR_TIME_SUBTRACT(tv_diff, tv_start);
+					pthreadMutexLock(&gcontext->worker_mutex);
+					gts->time_jit_wait += INSTR_TIME_GET_MICROSEC(tv_diff);
+					gts->time_gpu_exec += exec_time;
+					gts->num_gpu_exec++;
+					gts->bytes_loaded += GpuWorkerDMABytes;
+					if (gts->trace_events)
+						pgstromTraceGpuTask(gts, gtask, &tv_start,
+											&tv_jit, &tv_end, false);
+					pthreadMutexUnlock(&gcontext->worker_mutex);
+					if (gpuDeviceLoadArray)
+					{
+						GpuDeviceLoad *dload
+							= &gpuDeviceLoadArray[gcontext->cuda_dindex];
+
+						pg_atomic_fetch_add_u64(&dload->nr_tasks, 1);
+						pg_atomic_fetch_add_u64(&dload->busy_time, exec_time);
+					}
+				}
+				else if (gpuDeviceLoadArray)
+				{
+					pg_atomic_fetch_add_u64(&gpuDeviceLoadArray[gcontext->cuda_dindex]
+											.nr_retries, 1);
+				}
 				if (retval > 0)
 				{
 					/* wait for 40ms */
 					pg_usleep(40000L);
-					if (pg_atomic_read_u32(&gcontext->terminate_workers) == 0)
+					if (gts->cancel_tasks)
+					{
+						/*
+						 * Backend does not need the result of this task any
+						 * more, so it shall not be retried. It is not safe to
+						 * release the task on the worker thread, so it is
+						 * backed to the ready_tasks, then released by
+						 * pgstromCleanupGpuTasks() on the backend.
+						 */
+						pthreadMutexLock(&gcontext->worker_mutex);
+						dlist_push_tail(&gts->ready_tasks,
+										&gtask->chain);
+						gts->num_running_tasks--;
+						gts->num_ready_tasks++;
+						pthreadMutexUnlock(&gcontext->worker_mutex);
+
+						SetLatch(MyLatch);
+					}
+					else if (!pg_atomic_read_u32(&gcontext->terminate_workers))
+					{
+						INSTR_TIME_SET_CURRENT(tv_diff);
+						INSTR_TIME_SUBTRACT(tv_diff, tv_jit);
+						INSTR_TIME_ADD(tv_start, tv_diff);
+						INSTR_TIME_SET_CURRENT(tv_jit);
+						GpuContextUpdateRunningTasks(gcontext, 1);
 						goto retry_gputask;
+					}
 					else
 					{
 						/*
@@ -829,6 +1415,12 @@ GpuContextWorkerMain(void *arg)
 		SetLatch(MyLatch);
 	}
 	STROM_END_TRY();
+	gpuReleaseKernelGraphs();
+	if (CU_STREAM_PER_WORKER != CU_STREAM_PER_THREAD)
+	{
+		cuStreamDestroy(CU_STREAM_PER_WORKER);
+		CU_STREAM_PER_WORKER = CU_STREAM_PER_THREAD;
+	}
 
 	return NULL;
 }
@@ -852,6 +1444,53 @@ gpuInit(unsigned int flags)
 	return rc;
 }
 
+/*
+ * prewarm_cuda_context - creates a CUDA context in background, to overlap
+ * cuCtxCreate with the executor startup; activate_cuda_context() picks
+ * it up later.
+ */
+static void *
+__prewarm_cuda_context_main(void *arg)
+{
+	CudaResource *cuda_resource = arg;
+	cl_int		dindex = cuda_resource - cuda_resources_array;
+	CUresult	rc;
+
+	rc = cuDeviceGet(&cuda_resource->prewarm_device,
+					 devAttrs[dindex].DEV_ID);
+	if (rc == CUDA_SUCCESS)
+	{
+		rc = cuCtxCreate(&cuda_resource->prewarm_context,
+						 CU_CTX_SCHED_AUTO,
+						 cuda_resource->prewarm_device);
+		if (rc == CUDA_SUCCESS)
+			cuCtxPopCurrent(NULL);
+	}
+	cuda_resource->prewarm_rc = rc;
+
+	return NULL;
+}
+
+static void
+prewarm_cuda_context(cl_int dindex)
+{
+	CudaResource *cuda_resource;
+
+	Assert(dindex >= 0 && dindex < numDevAttrs);
+	cuda_resource = &cuda_resources_array[dindex];
+	if (cuda_resource->cuda_context || cuda_resource->prewarm_running)
+		return;
+	cuda_resource->prewarm_context = NULL;
+	cuda_resource->prewarm_rc = CUDA_ERROR_NOT_INITIALIZED;
+	errno = pthread_create(&cuda_resource->prewarm_thread, NULL,
+						   __prewarm_cuda_context_main,
+						   cuda_resource);
+	if (errno != 0)
+		elog(DEBUG1, "failed on pthread_create: %m");
+	else
+		cuda_resource->prewarm_running = true;
+}
+
 /*
  * activate_cuda_context - create a CUDA context on demand
  */
@@ -876,6 +1515,29 @@ activate_cuda_context(GpuContext *gcontext)
 		cuda_resource->refcnt++;
 		return;
 	}
+	/* pick up the CUDA context created in background, if any */
+	if (cuda_resource->prewarm_running)
+	{
+		errno = pthread_join(cuda_resource->prewarm_thread, NULL);
+		if (errno != 0)
+			werror("failed on pthread_join: %m");
+		cuda_resource->prewarm_running = false;
+		if (cuda_resource->prewarm_rc == CUDA_SUCCESS)
+		{
+			cuda_device  = cuda_resource->prewarm_device;
+			cuda_context = cuda_resource->prewarm_context;
+			/* same as cuCtxCreate, make it current */
+			rc = cuCtxSetCurrent(cuda_context);
+			if (rc != CUDA_SUCCESS)
+			{
+				cuCtxDestroy(cuda_context);
+				werror("failed on cuCtxSetCurrent: %s", errorText(rc));
+			}
+			goto setup;
+		}
+		elog(DEBUG1, "failed on cuCtxCreate in background: %s",
+			 errorText(cuda_resource->prewarm_rc));
+	}
 	/* no valid CUDA context, so create a new one */
 	rc = cuDeviceGet(&cuda_device, devAttrs[dindex].DEV_ID);
 	if (rc != CUDA_SUCCESS)
@@ -886,6 +1548,7 @@ activate_cuda_context(GpuContext *gcontext)
 					 cuda_device);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuCtxCreate: %s", errorText(rc));
+setup:
 	gcontext->cuda_device  = cuda_device;
 	gcontext->cuda_context = cuda_context;
 
@@ -930,6 +1593,32 @@ activate_cuda_workers(GpuContext *gcontext)
 	}
 }
 
+/*
+ * HasActiveGpuContext - true, if the current resource owner already has
+ * an active GpuContext; that shall be reused by AllocGpuContext(-1,...)
+ */
+bool
+HasActiveGpuContext(void)
+{
+	dlist_iter		iter;
+	bool			found = false;
+
+	SpinLockAcquire(&activeGpuContextLock);
+	dlist_foreach(iter, &activeGpuContextList)
+	{
+		GpuContext *gcontext = dlist_container(GpuContext, chain, iter.cur);
+
+		if (gcontext->resowner == CurrentResourceOwner)
+		{
+			found = true;
+			break;
+		}
+	}
+	SpinLockRelease(&activeGpuContextLock);
+
+	return found;
+}
+
 /*
  * GetGpuContext - acquire a free GpuContext
  */
@@ -974,16 +1663,17 @@ AllocGpuContext(int cuda_dindex,
 
 	/* choose a device to use, if no preference */
 	if (cuda_dindex < 0)
-	{
-		cuda_dindex = (IsParallelWorker()
-					   ? ParallelWorkerNumber
-					   : MyProc->pgprocno) % numDevAttrs;
-	}
+		cuda_dindex = gpuDeviceLeastLoadedAmong(~0UL);
+	if (!activate_context && pgstrom_prewarm_cuda_context)
+		prewarm_cuda_context(cuda_dindex);
 
 	/* setup fields */
 	pg_atomic_init_u32(&gcontext->refcnt, 1);
 	gcontext->resowner		= CurrentResourceOwner;
 	gcontext->cuda_dindex	= cuda_dindex;
+	pg_atomic_init_u32(&gcontext->nr_running_tasks, 0);
+	if (gpuDeviceLoadArray)
+		pg_atomic_fetch_add_u32(&gpuDeviceLoadArray[cuda_dindex].nr_contexts, 1);
 	/* resource management */
 	SpinLockInit(&gcontext->restrack_lock);
 	for (i=0; i < RESTRACK_HASHSIZE; i++)
@@ -1002,6 +1692,7 @@ AllocGpuContext(int cuda_dindex,
 	pg_atomic_init_u32(&gcontext->terminate_workers, 0);
 	dlist_init(&gcontext->pending_tasks);
 	gcontext->num_workers = num_workers;
+	gcontext->stream_priority = pgstrom_gpu_stream_priority;
 	pg_atomic_init_u32(&gcontext->worker_index, 0);
 	for (i=0; i < num_workers; i++)
 		gcontext->worker_threads[i] = pthread_self();
@@ -1102,6 +1793,8 @@ SynchronizeGpuContext(GpuContext *gcontext)
 	}
 	memset(gcontext->worker_threads, 0,
 		   sizeof(pthread_t) * gcontext->num_workers);
+	/* also terminate the DMA thread after the completion of pending DMA */
+	gpuDirectDmaQueueTerminate(gcontext);
 	/* reset state for next activation */
 	gcontext->worker_is_running = false;
 	pg_atomic_write_u32(&gcontext->terminate_workers, 0);
@@ -1202,12 +1895,115 @@ gpucontext_shmem_exit_cleanup(int code, Datum arg)
 	}
 }
 
+/*
+ * pgstrom_startup_gpu_context
+ */
+static void
+pgstrom_startup_gpu_context(void)
+{
+	bool		found;
+	int			i;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	gpuDeviceLoadArray = ShmemInitStruct("GPU Device Load Statistics",
+										 STROMALIGN(sizeof(GpuDeviceLoad) *
+													numDevAttrs),
+										 &found);
+	if (found)
+		elog(ERROR, "Bug? GPU Device Load Statistics exists");
+	for (i=0; i < numDevAttrs; i++)
+	{
+		GpuDeviceLoad *dload = &gpuDeviceLoadArray[i];
+
+		pg_atomic_init_u32(&dload->nr_contexts, 0);
+		pg_atomic_init_u32(&dload->nr_running_tasks, 0);
+		pg_atomic_init_u64(&dload->nr_tasks, 0);
+		pg_atomic_init_u64(&dload->nr_retries, 0);
+		pg_atomic_init_u64(&dload->busy_time, 0);
+		pg_atomic_init_u64(&dload->bytes_h2d, 0);
+		pg_atomic_init_u64(&dload->bytes_d2h, 0);
+		pg_atomic_init_u64(&dload->bytes_gpudirect, 0);
+	}
+}
+
+/*
+ * pgstrom_stat_gpu_device - cumulative statistics per GPU device
+ */
+Datum pgstrom_stat_gpu_device(PG_FUNCTION_ARGS);
+
+Datum
+pgstrom_stat_gpu_device(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	GpuDeviceLoad  *dload;
+	HeapTuple		tuple;
+	bool			isnull[9];
+	Datum			values[9];
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc		tupdesc;
+		MemoryContext	oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+
+		tupdesc = CreateTemplateTupleDesc(9);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "device_nr",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "num_contexts",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 3, "running_tasks",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "processed_tasks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "oom_retries",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "busy_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 7, "h2d_bytes",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 8, "d2h_bytes",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 9, "gpudirect_bytes",
+						   INT8OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+
+	if (!gpuDeviceLoadArray || fncxt->call_cntr >= numDevAttrs)
+		SRF_RETURN_DONE(fncxt);
+	dload = &gpuDeviceLoadArray[fncxt->call_cntr];
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int32GetDatum(devAttrs[fncxt->call_cntr].DEV_ID);
+	values[1] = Int32GetDatum(pg_atomic_read_u32(&dload->nr_contexts));
+	values[2] = Int32GetDatum(pg_atomic_read_u32(&dload->nr_running_tasks));
+	values[3] = Int64GetDatum(pg_atomic_read_u64(&dload->nr_tasks));
+	values[4] = Int64GetDatum(pg_atomic_read_u64(&dload->nr_retries));
+	values[5] = Float8GetDatum((double)
+							   pg_atomic_read_u64(&dload->busy_time) / 1000.0);
+	values[6] = Int64GetDatum(pg_atomic_read_u64(&dload->bytes_h2d));
+	values[7] = Int64GetDatum(pg_atomic_read_u64(&dload->bytes_d2h));
+	values[8] = Int64GetDatum(pg_atomic_read_u64(&dload->bytes_gpudirect));
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_stat_gpu_device);
+
 /*
  * pgstrom_init_gpu_context
  */
 void
 pgstrom_init_gpu_context(void)
 {
+	int		i;
+
 	DefineCustomIntVariable("pg_strom.max_async_tasks",
 							"Soft limit for CUDA worker threads per backend",
 							NULL,
@@ -1218,6 +2014,26 @@ pgstrom_init_gpu_context(void)
 							PGC_SUSET,
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.scan_readahead_chunks",
+							"Number of chunks to be loaded ahead, during GPU execution",
+							NULL,
+							&pgstrom_scan_readahead_chunks,
+							2,
+							1,
+							64,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.gpu_stream_priority",
+							"Priority of CUDA streams for GPU tasks of the query",
+							"0 is the default priority. Larger value gives higher priority, as long as device supports",
+							&pgstrom_gpu_stream_priority,
+							0,
+							0,
+							16,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
 	DefineCustomBoolVariable("pg_strom.reuse_cuda_context",
 							 "Reuse CUDA context, if query completed successfully",
 							 NULL,
@@ -1226,6 +2042,22 @@ pgstrom_init_gpu_context(void)
 							 PGC_SUSET,
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
+	DefineCustomBoolVariable("pg_strom.prewarm_cuda_context",
+							 "Creates CUDA context in background on executor startup",
+							 NULL,
+							 &pgstrom_prewarm_cuda_context,
+							 false,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomBoolVariable("pg_strom.enable_cuda_graph",
+							 "Enables CUDA graph to replay kernel launch sequence per chunk",
+							 NULL,
+							 &pgstrom_enable_cuda_graph,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 
 	/* force to disable MPS to avoid troubles */
 	if (setenv("CUDA_MPS_PIPE_DIRECTORY", "/dev/null", 1) != 0)
@@ -1235,10 +2067,18 @@ pgstrom_init_gpu_context(void)
 	cuda_resources_array = calloc(numDevAttrs, sizeof(CudaResource));
 	if (!cuda_resources_array)
 		elog(ERROR, "out of memory");
+	for (i=0; i < numDevAttrs; i++)
+		dlist_init(&cuda_resources_array[i].module_cache);
+	SpinLockInit(&cudaModuleCacheLock);
 
 	SpinLockInit(&activeGpuContextLock);
 	dlist_init(&activeGpuContextList);
 
+	/* shared statistics of the device workloads */
+	RequestAddinShmemSpace(STROMALIGN(sizeof(GpuDeviceLoad) * numDevAttrs));
+	shmem_startup_next = shmem_startup_hook;
+	shmem_startup_hook = pgstrom_startup_gpu_context;
+
 	/* register the callback to clean up resources */
 	RegisterResourceReleaseCallback(gpucontext_cleanup_callback, NULL);
 	before_shmem_exit(gpucontext_shmem_exit_cleanup, 0);
@@ -22,6 +22,33 @@ DevAttributes	   *devAttrs = NULL;
 cl_int				numDevAttrs = 0;
 cl_uint				devBaselineMaxThreadsPerBlock = UINT_MAX;
 
+/*
+ * per-device cost parameters
+ *
+ * pg_strom.gpu_(setup|dma|operator)_cost are the cost of a typical device
+ * in the system; averages of the installed devices. Cost of the individual
+ * device is scaled by its capability, unless pg_strom.gpu_device_costs gives
+ * the value explicitly (e.g, the one suggested by gpubench -C).
+ */
+typedef struct
+{
+	cl_int		dev_id;
+	double		setup_cost;		/* negative, if not specified */
+	double		dma_cost;		/* negative, if not specified */
+	double		operator_cost;	/* negative, if not specified */
+} DevCostEntry;
+
+typedef struct
+{
+	int			nitems;
+	DevCostEntry entries[FLEXIBLE_ARRAY_MEMBER];
+} DevCostConfig;
+
+static char		   *pgstrom_gpu_device_costs = NULL;	/* GUC */
+static DevCostConfig *devCostConfig = NULL;
+static double		devAverageComputeUnits = 0.0;
+static double		devAveragePCIeBandwidth = 0.0;
+
 /* catalog of device attributes */
 typedef enum {
 	DEVATTRKIND__INT,
@@ -233,7 +260,40 @@ pgstrom_collect_gpu_device(void)
 				dattrs->NUMA_NODE_ID = atoi(linebuf);
 			fclose(filp);
 		}
-		
+
+		/*
+		 * read the PCI-E link speed and width from the sysfs entry, to
+		 * estimate the DMA cost of the device
+		 */
+		dattrs->DEV_PCIE_BANDWIDTH = 0.0;	/* unknown */
+		snprintf(path, sizeof(path),
+				 "/sys/bus/pci/devices/%04x:%02x:%02x.0/current_link_speed",
+				 dattrs->PCI_DOMAIN_ID,
+				 dattrs->PCI_BUS_ID,
+				 dattrs->PCI_DEVICE_ID);
+		filp = fopen(path, "r");
+		if (filp)
+		{
+			double	link_speed = 0.0;	/* GT/s */
+
+			if (fgets(linebuf, sizeof(linebuf), filp))
+				link_speed = atof(linebuf);
+			fclose(filp);
+
+			snprintf(path, sizeof(path),
+					 "/sys/bus/pci/devices/%04x:%02x:%02x.0/current_link_width",
+					 dattrs->PCI_DOMAIN_ID,
+					 dattrs->PCI_BUS_ID,
+					 dattrs->PCI_DEVICE_ID);
+			filp = fopen(path, "r");
+			if (filp)
+			{
+				if (fgets(linebuf, sizeof(linebuf), filp) && link_speed > 0.0)
+					dattrs->DEV_PCIE_BANDWIDTH = link_speed * atof(linebuf);
+				fclose(filp);
+			}
+		}
+
 		/* Log brief CUDA device properties */
 		resetStringInfo(&str);
 		appendStringInfo(&str, "GPU%d %s (%d SMs; %dMHz, L2 %dkB)",
@@ -279,6 +339,379 @@ pgstrom_collect_gpu_device(void)
 	numDevAttrs = j;
 	if (numDevAttrs == 0)
 		elog(ERROR, "PG-Strom: no supported GPU devices found");
+
+	/* average capability of the devices, for the cost estimation */
+	for (i=0, j=0; i < numDevAttrs; i++)
+	{
+		devAverageComputeUnits += ((double)devAttrs[i].MULTIPROCESSOR_COUNT *
+								   (double)devAttrs[i].CLOCK_RATE);
+		if (devAttrs[i].DEV_PCIE_BANDWIDTH > 0.0)
+		{
+			devAveragePCIeBandwidth += devAttrs[i].DEV_PCIE_BANDWIDTH;
+			j++;
+		}
+	}
+	devAverageComputeUnits /= (double)numDevAttrs;
+	if (j > 0)
+		devAveragePCIeBandwidth /= (double)j;
+
+	/* CPUs local to the devices, for NUMA-aware placement */
+	setup_numa_cpusets();
+}
+
+/*
+ * check_gpu_device_costs - check hook of pg_strom.gpu_device_costs
+ *
+ * It is a comma separated list of '<device id>=<setup>:<dma>:<operator>'.
+ * Empty field means the cost estimated by the device attributes.
+ * Entries for the device not installed are ignored, so a configuration file
+ * can be shared by the servers with different GPU models.
+ */
+static bool
+check_gpu_device_costs(char **newval, void **extra, GucSource source)
+{
+	DevCostConfig *config;
+	char	   *rawstring;
+	char	   *tok, *saveptr;
+	int			nrooms = 1;
+	char	   *pos;
+
+	if (!*newval)
+	{
+		*extra = NULL;
+		return true;
+	}
+	for (pos = *newval; *pos != '\0'; pos++)
+	{
+		if (*pos == ',')
+			nrooms++;
+	}
+	config = malloc(offsetof(DevCostConfig, entries[nrooms]));
+	rawstring = strdup(*newval);
+	if (!config || !rawstring)
+	{
+		if (config)
+			free(config);
+		GUC_check_errcode(ERRCODE_OUT_OF_MEMORY);
+		GUC_check_errmsg("out of memory");
+		return false;
+	}
+	config->nitems = 0;
+
+	for (tok = strtok_r(rawstring, ",", &saveptr);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &saveptr))
+	{
+		DevCostEntry *entry = &config->entries[config->nitems];
+		double	   *values[3];
+		char	   *end;
+		int			k;
+
+		values[0] = &entry->setup_cost;
+		values[1] = &entry->dma_cost;
+		values[2] = &entry->operator_cost;
+
+		tok = __trim(tok);
+		if (*tok == '\0')
+			continue;
+		entry->dev_id = strtol(tok, &end, 10);
+		if (end == tok || entry->dev_id < 0)
+			goto syntax_error;
+		pos = __trim(end);
+		if (*pos++ != '=')
+			goto syntax_error;
+		for (k=0; k < 3; k++)
+		{
+			pos = __trim(pos);
+			if (*pos == ':' || *pos == '\0')
+				*values[k] = -1.0;
+			else
+			{
+				*values[k] = strtod(pos, &end);
+				if (end == pos || *values[k] < 0.0)
+					goto syntax_error;
+				pos = __trim(end);
+			}
+			if (k < 2)
+			{
+				if (*pos == ':')
+					pos++;
+				else if (*pos != '\0')
+					goto syntax_error;
+			}
+			else if (*pos != '\0')
+				goto syntax_error;
+		}
+		config->nitems++;
+	}
+	free(rawstring);
+	*extra = config;
+	return true;
+
+syntax_error:
+	GUC_check_errdetail("'%s' is not '<device id>=<setup>:<dma>:<operator>'",
+						tok);
+	free(rawstring);
+	free(config);
+	return false;
+}
+
+static void
+assign_gpu_device_costs(const char *newval, void *extra)
+{
+	devCostConfig = (DevCostConfig *) extra;
+}
+
+/*
+ * lookup_device_cost_entry
+ */
+static DevCostEntry *
+lookup_device_cost_entry(int cuda_dindex)
+{
+	int		i;
+
+	if (cuda_dindex < 0 || cuda_dindex >= numDevAttrs || !devCostConfig)
+		return NULL;
+	for (i=0; i < devCostConfig->nitems; i++)
+	{
+		DevCostEntry *entry = &devCostConfig->entries[i];
+
+		if (entry->dev_id == devAttrs[cuda_dindex].DEV_ID)
+			return entry;
+	}
+	return NULL;
+}
+
+/*
+ * pgstromGpuSetupCost
+ *
+ * cost to setup the GPU device to run. It is mostly NVRTC build and module
+ * load on the host side, so we don't scale it by the device attributes.
+ */
+Cost
+pgstromGpuSetupCost(int cuda_dindex)
+{
+	DevCostEntry *entry = lookup_device_cost_entry(cuda_dindex);
+
+	if (entry && entry->setup_cost >= 0.0)
+		return entry->setup_cost;
+	return pgstrom_gpu_setup_cost;
+}
+
+/*
+ * pgstromGpuDmaCost
+ *
+ * cost to send/recv a chunk via DMA; scaled by the PCI-E link bandwidth
+ */
+Cost
+pgstromGpuDmaCost(int cuda_dindex)
+{
+	DevCostEntry *entry = lookup_device_cost_entry(cuda_dindex);
+
+	if (entry && entry->dma_cost >= 0.0)
+		return entry->dma_cost;
+	if (cuda_dindex >= 0 && cuda_dindex < numDevAttrs &&
+		devAttrs[cuda_dindex].DEV_PCIE_BANDWIDTH > 0.0 &&
+		devAveragePCIeBandwidth > 0.0)
+		return pgstrom_gpu_dma_cost * (devAveragePCIeBandwidth /
+									   devAttrs[cuda_dindex].DEV_PCIE_BANDWIDTH);
+	return pgstrom_gpu_dma_cost;
+}
+
+/*
+ * pgstromGpuOperatorCost
+ *
+ * cost to process an operator on GPU; scaled by the number of SMs and
+ * the clock rate of the device
+ */
+Cost
+pgstromGpuOperatorCost(int cuda_dindex)
+{
+	DevCostEntry *entry = lookup_device_cost_entry(cuda_dindex);
+
+	if (entry && entry->operator_cost >= 0.0)
+		return entry->operator_cost;
+	if (cuda_dindex >= 0 && cuda_dindex < numDevAttrs &&
+		devAverageComputeUnits > 0.0)
+	{
+		DevAttributes *dattrs = &devAttrs[cuda_dindex];
+		double		units = ((double)dattrs->MULTIPROCESSOR_COUNT *
+							 (double)dattrs->CLOCK_RATE);
+		if (units > 0.0)
+			return pgstrom_gpu_operator_cost * (devAverageComputeUnits / units);
+	}
+	return pgstrom_gpu_operator_cost;
+}
+
+/*
+ * pgstromGpuDeviceMemorySize
+ *
+ * device memory size of the GPU, or the smallest one if not determined yet
+ */
+size_t
+pgstromGpuDeviceMemorySize(int cuda_dindex)
+{
+	size_t		memsz = SIZE_MAX;
+	int			i;
+
+	if (cuda_dindex >= 0 && cuda_dindex < numDevAttrs)
+		return devAttrs[cuda_dindex].DEV_TOTAL_MEMSZ;
+	for (i=0; i < numDevAttrs; i++)
+		memsz = Min(memsz, devAttrs[i].DEV_TOTAL_MEMSZ);
+	return memsz;
+}
+
+/*
+ * NUMA-aware placement
+ *
+ * On the multi-socket servers, the GpuContext worker threads are bound to
+ * the CPUs of the numa-node local to the GPU device, and pinned host memory
+ * is allocated on the local node, to avoid DMA across the inter-socket link.
+ */
+#define DEV_NUMA_MAX_NODES		(8 * sizeof(unsigned long))
+
+static bool			pgstrom_numa_aware_placement;	/* GUC */
+static cpu_set_t   *devNumaCpuSets = NULL;	/* local CPUs per device */
+static unsigned long devNumaNodeMask = 0UL;	/* numa-nodes with GPUs */
+
+/*
+ * setup_numa_cpusets - read the CPUs of the numa-node of the devices
+ */
+static void
+setup_numa_cpusets(void)
+{
+	cpu_set_t	allowed;
+	char		path[MAXPGPATH];
+	char		linebuf[2048];
+	FILE	   *filp;
+	int			i, nnodes = 0;
+
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)
+	{
+		elog(LOG, "failed on sched_getaffinity: %m");
+		return;
+	}
+	devNumaCpuSets = calloc(numDevAttrs, sizeof(cpu_set_t));
+	if (!devNumaCpuSets)
+		elog(ERROR, "out of memory");
+
+	for (i=0; i < numDevAttrs; i++)
+	{
+		DevAttributes *dattrs = &devAttrs[i];
+		cpu_set_t  *cpuset = &devNumaCpuSets[i];
+		char	   *tok, *pos;
+		int			lo, hi;
+
+		CPU_ZERO(cpuset);
+		if (dattrs->NUMA_NODE_ID < 0 ||
+			dattrs->NUMA_NODE_ID >= DEV_NUMA_MAX_NODES)
+			continue;
+		snprintf(path, sizeof(path),
+				 "/sys/devices/system/node/node%d/cpulist",
+				 dattrs->NUMA_NODE_ID);
+		filp = fopen(path, "r");
+		if (!filp)
+			continue;
+		if (fgets(linebuf, sizeof(linebuf), filp))
+		{
+			/* e.g) "0-15,32-47" */
+			for (tok = strtok_r(linebuf, ",\n", &pos);
+				 tok != NULL;
+				 tok = strtok_r(NULL, ",\n", &pos))
+			{
+				if (sscanf(tok, "%d-%d", &lo, &hi) != 2)
+				{
+					if (sscanf(tok, "%d", &lo) != 1)
+						continue;
+					hi = lo;
+				}
+				while (lo <= hi && lo < CPU_SETSIZE)
+					CPU_SET(lo++, cpuset);
+			}
+		}
+		fclose(filp);
+		/* don't bind threads to the CPUs not allowed to the postmaster */
+		CPU_AND(cpuset, cpuset, &allowed);
+		if (CPU_COUNT(cpuset) == 0)
+			continue;
+		if ((devNumaNodeMask & (1UL << dattrs->NUMA_NODE_ID)) == 0)
+		{
+			devNumaNodeMask |= (1UL << dattrs->NUMA_NODE_ID);
+			nnodes++;
+		}
+	}
+	/* nothing to do on the single-socket system */
+	if (nnodes < 2)
+	{
+		free(devNumaCpuSets);
+		devNumaCpuSets = NULL;
+		devNumaNodeMask = 0UL;
+	}
+}
+
+/*
+ * gpuDeviceBindLocalNumaNode
+ *
+ * It binds the current thread to the CPUs local to the GPU device.
+ * It is safe to call from the GPU worker threads.
+ */
+void
+gpuDeviceBindLocalNumaNode(int cuda_dindex)
+{
+	cpu_set_t  *cpuset;
+
+	if (!pgstrom_numa_aware_placement || !devNumaCpuSets ||
+		cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+		return;
+	cpuset = &devNumaCpuSets[cuda_dindex];
+	if (CPU_COUNT(cpuset) > 0)
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), cpuset);
+}
+
+/*
+ * gpuDeviceSetNumaMemPolicy
+ *
+ * It sets up the memory policy of the current thread to allocate the pages
+ * on the numa-node local to the GPU device, or interleaved on the numa-nodes
+ * with GPUs if negative cuda_dindex. It returns true if the policy is changed,
+ * then caller must restore the policy by gpuDeviceResetNumaMemPolicy().
+ * It is safe to call from the GPU worker threads.
+ */
+bool
+gpuDeviceSetNumaMemPolicy(int cuda_dindex)
+{
+	unsigned long nodemask;
+	int			mode;
+
+	if (!pgstrom_numa_aware_placement || !devNumaCpuSets)
+		return false;
+	if (cuda_dindex < 0)
+	{
+		mode = MPOL_INTERLEAVE;
+		nodemask = devNumaNodeMask;
+	}
+	else if (cuda_dindex < numDevAttrs &&
+			 CPU_COUNT(&devNumaCpuSets[cuda_dindex]) > 0)
+	{
+		mode = MPOL_PREFERRED;
+		nodemask = (1UL << devAttrs[cuda_dindex].NUMA_NODE_ID);
+	}
+	else
+		return false;
+
+	if (syscall(SYS_set_mempolicy, mode, &nodemask,
+				DEV_NUMA_MAX_NODES) != 0)
+		return false;
+	return true;
+}
+
+/*
+ * gpuDeviceResetNumaMemPolicy
+ */
+void
+gpuDeviceResetNumaMemPolicy(void)
+{
+	syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
 }
 
 /*
@@ -308,6 +741,27 @@ pgstrom_init_gpu_device(void)
 	}
 	/* collect device properties by gpuinfo command */
 	pgstrom_collect_gpu_device();
+
+	/* cost parameters per device */
+	DefineCustomStringVariable("pg_strom.gpu_device_costs",
+							   "Cost parameters per GPU device",
+							   "comma separated list of '<device id>=<setup>:<dma>:<operator>'",
+							   &pgstrom_gpu_device_costs,
+							   NULL,
+							   PGC_USERSET,
+							   GUC_NOT_IN_SAMPLE,
+							   check_gpu_device_costs,
+							   assign_gpu_device_costs,
+							   NULL);
+	/* NUMA-aware placement */
+	DefineCustomBoolVariable("pg_strom.numa_aware_placement",
+							 "Binds worker threads and pinned memory to the numa-node local to GPU",
+							 NULL,
+							 &pgstrom_numa_aware_placement,
+							 true,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 }
 
 /*
@@ -0,0 +1,881 @@
+/*
+ * gpu_knnjoin.c
+ *
+ * Batched k-nearest neighbor join on vectors using GPU
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+
+/*
+ * NOTE: The vector distance operators evaluated per pair of rows on the
+ * join quals of GpuNestLoop are dominated by the memory traffic, because
+ * every inner vector is loaded again for each outer row. When all the
+ * N x M distances are required, like k-NN search for a batch of queries,
+ * it is a matrix product of the outer and the inner vectors, apart from
+ * the norms. pgstrom.vector_knn_join() loads all the inner vectors on the
+ * device memory, then the kernel below computes the dot products of a
+ * 16x16 tile of the outer and inner rows, staging both operands on the
+ * shared memory like SGEMM. The distances of the tile are immediately
+ * merged into the per-row max-heap of the top-k, also on the shared
+ * memory, so the distance matrix is never written out to the global
+ * memory.
+ *
+ * The vectors are kept in float2 if both sides are float2[], or float4
+ * elsewhere, and accumulated in float4 on the device.
+ */
+static const char *gpu_knnjoin_kernel_source =
+	"#define KNN_TILE_SZ          16\n"
+	"#define KNN_MAX_K            128\n"
+	"#define KNN_METRIC_L2        0\n"
+	"#define KNN_METRIC_NEG_IP    1\n"
+	"#define KNN_METRIC_COSINE    2\n"
+	"#ifdef KNN_HALF\n"
+	"typedef cl_half              knn_elem_t;\n"
+	"#define KNN_LOAD(x)          __half2float(x)\n"
+	"#else\n"
+	"typedef cl_float             knn_elem_t;\n"
+	"#define KNN_LOAD(x)          (x)\n"
+	"#endif\n"
+	"\n"
+	"typedef struct {\n"
+	"  cl_uint     ndims;\n"
+	"  cl_uint     k;\n"
+	"  cl_uint     metric;\n"
+	"  cl_uint     n_outer;\n"
+	"  cl_uint     n_inner;\n"
+	"  cl_uint     __padding;\n"
+	"  knn_elem_t *outer;\n"
+	"  knn_elem_t *inner;\n"
+	"  cl_float   *outer_norm;\n"
+	"  cl_float   *inner_norm;\n"
+	"  cl_float   *res_dist;\n"
+	"  cl_uint    *res_index;\n"
+	"} kern_knnjoin;\n"
+	"\n"
+	"KERNEL_FUNCTION(void)\n"
+	"knnjoin_norm(const knn_elem_t *vectors,\n"
+	"             cl_float *norms,\n"
+	"             cl_uint nitems,\n"
+	"             cl_uint ndims)\n"
+	"{\n"
+	"  cl_uint    i, j;\n"
+	"\n"
+	"  for (i = get_global_id(); i < nitems; i += get_global_size())\n"
+	"  {\n"
+	"    const knn_elem_t *v = vectors + (size_t)i * (size_t)ndims;\n"
+	"    cl_float  sum = 0.0;\n"
+	"\n"
+	"    for (j=0; j < ndims; j++)\n"
+	"    {\n"
+	"      cl_float  x = KNN_LOAD(v[j]);\n"
+	"\n"
+	"      sum += x * x;\n"
+	"    }\n"
+	"    norms[i] = sum;\n"
+	"  }\n"
+	"}\n"
+	"\n"
+	"STATIC_FUNCTION(void)\n"
+	"__knnjoin_heap_push(cl_float *hdist, cl_uint *hindex,\n"
+	"                    cl_uint *p_nitems, cl_uint k,\n"
+	"                    cl_float dist, cl_uint index)\n"
+	"{\n"
+	"  cl_uint    n = *p_nitems;\n"
+	"  cl_uint    i, j;\n"
+	"\n"
+	"  if (isnan(dist))\n"
+	"    return;\n"
+	"  if (n < k)\n"
+	"  {\n"
+	"    /* sift-up */\n"
+	"    for (i = n; i > 0; i = j)\n"
+	"    {\n"
+	"      j = (i - 1) / 2;\n"
+	"      if (hdist[j] >= dist)\n"
+	"        break;\n"
+	"      hdist[i] = hdist[j];\n"
+	"      hindex[i] = hindex[j];\n"
+	"    }\n"
+	"    hdist[i] = dist;\n"
+	"    hindex[i] = index;\n"
+	"    *p_nitems = n + 1;\n"
+	"  }\n"
+	"  else if (dist < hdist[0])\n"
+	"  {\n"
+	"    /* replace the largest one, then sift-down */\n"
+	"    for (i = 0; (j = 2 * i + 1) < n; i = j)\n"
+	"    {\n"
+	"      if (j + 1 < n && hdist[j+1] > hdist[j])\n"
+	"        j++;\n"
+	"      if (hdist[j] <= dist)\n"
+	"        break;\n"
+	"      hdist[i] = hdist[j];\n"
+	"      hindex[i] = hindex[j];\n"
+	"    }\n"
+	"    hdist[i] = dist;\n"
+	"    hindex[i] = index;\n"
+	"  }\n"
+	"}\n"
+	"\n"
+	"KERNEL_FUNCTION(void)\n"
+	"knnjoin_main(kern_knnjoin *kknn)\n"
+	"{\n"
+	"  __shared__ cl_float a_tile[KNN_TILE_SZ][KNN_TILE_SZ+1];\n"
+	"  __shared__ cl_float b_tile[KNN_TILE_SZ][KNN_TILE_SZ+1];\n"
+	"  __shared__ cl_float d_tile[KNN_TILE_SZ][KNN_TILE_SZ+1];\n"
+	"  __shared__ cl_float heap_dist[KNN_TILE_SZ][KNN_MAX_K];\n"
+	"  __shared__ cl_uint  heap_index[KNN_TILE_SZ][KNN_MAX_K];\n"
+	"  __shared__ cl_uint  heap_nitems[KNN_TILE_SZ];\n"
+	"  cl_uint    ndims = kknn->ndims;\n"
+	"  cl_uint    k = kknn->k;\n"
+	"  cl_uint    tx = threadIdx.x;\n"
+	"  cl_uint    ty = threadIdx.y;\n"
+	"  cl_uint    obase, ibase, dbase, j;\n"
+	"\n"
+	"  for (obase = blockIdx.x * KNN_TILE_SZ;\n"
+	"       obase < kknn->n_outer;\n"
+	"       obase += gridDim.x * KNN_TILE_SZ)\n"
+	"  {\n"
+	"    cl_uint   orow = obase + ty;\n"
+	"\n"
+	"    if (tx == 0)\n"
+	"      heap_nitems[ty] = 0;\n"
+	"    __syncthreads();\n"
+	"    for (ibase = 0; ibase < kknn->n_inner; ibase += KNN_TILE_SZ)\n"
+	"    {\n"
+	"      cl_uint   irow = ibase + ty;\n"
+	"      cl_uint   icol = ibase + tx;\n"
+	"      cl_float  dot = 0.0;\n"
+	"\n"
+	"      /* dot product of the tile, like SGEMM */\n"
+	"      for (dbase = 0; dbase < ndims; dbase += KNN_TILE_SZ)\n"
+	"      {\n"
+	"        cl_uint   d = dbase + tx;\n"
+	"\n"
+	"        a_tile[ty][tx] = (orow < kknn->n_outer && d < ndims\n"
+	"          ? KNN_LOAD(kknn->outer[(size_t)orow * ndims + d]) : 0.0);\n"
+	"        b_tile[ty][tx] = (irow < kknn->n_inner && d < ndims\n"
+	"          ? KNN_LOAD(kknn->inner[(size_t)irow * ndims + d]) : 0.0);\n"
+	"        __syncthreads();\n"
+	"        for (j=0; j < KNN_TILE_SZ; j++)\n"
+	"          dot += a_tile[ty][j] * b_tile[tx][j];\n"
+	"        __syncthreads();\n"
+	"      }\n"
+	"      /* distance */\n"
+	"      if (orow < kknn->n_outer && icol < kknn->n_inner)\n"
+	"      {\n"
+	"        cl_float  onorm = kknn->outer_norm[orow];\n"
+	"        cl_float  inorm = kknn->inner_norm[icol];\n"
+	"        cl_float  dist;\n"
+	"\n"
+	"        if (kknn->metric == KNN_METRIC_L2)\n"
+	"          dist = sqrtf(fmaxf(onorm + inorm - 2.0 * dot, 0.0));\n"
+	"        else if (kknn->metric == KNN_METRIC_NEG_IP)\n"
+	"          dist = -dot;\n"
+	"        else if (onorm == 0.0 || inorm == 0.0)\n"
+	"          dist = __int_as_float(0x7fc00000U);\n"
+	"        else\n"
+	"          dist = 1.0 - fminf(fmaxf(dot * rsqrtf(onorm * inorm),\n"
+	"                                   -1.0), 1.0);\n"
+	"        d_tile[ty][tx] = dist;\n"
+	"      }\n"
+	"      __syncthreads();\n"
+	"      /* fused top-k; merge the distances of the tile */\n"
+	"      if (tx == 0 && orow < kknn->n_outer)\n"
+	"      {\n"
+	"        for (j=0; j < KNN_TILE_SZ && ibase + j < kknn->n_inner; j++)\n"
+	"          __knnjoin_heap_push(heap_dist[ty],\n"
+	"                              heap_index[ty],\n"
+	"                              &heap_nitems[ty], k,\n"
+	"                              d_tile[ty][j], ibase + j);\n"
+	"      }\n"
+	"      __syncthreads();\n"
+	"    }\n"
+	"    /* write out the top-k (unsorted) */\n"
+	"    if (orow < kknn->n_outer)\n"
+	"    {\n"
+	"      for (j = tx; j < k; j += KNN_TILE_SZ)\n"
+	"      {\n"
+	"        size_t    pos = (size_t)orow * k + j;\n"
+	"\n"
+	"        if (j < heap_nitems[ty])\n"
+	"        {\n"
+	"          kknn->res_dist[pos] = heap_dist[ty][j];\n"
+	"          kknn->res_index[pos] = heap_index[ty][j];\n"
+	"        }\n"
+	"        else\n"
+	"          kknn->res_index[pos] = UINT_MAX;\n"
+	"      }\n"
+	"    }\n"
+	"    __syncthreads();\n"
+	"  }\n"
+	"}\n";
+
+/* host side definition; must be identical to the kernel source above */
+typedef struct
+{
+	cl_uint		ndims;
+	cl_uint		k;
+	cl_uint		metric;
+	cl_uint		n_outer;
+	cl_uint		n_inner;
+	cl_uint		__padding;
+	CUdeviceptr	outer;
+	CUdeviceptr	inner;
+	CUdeviceptr	outer_norm;
+	CUdeviceptr	inner_norm;
+	CUdeviceptr	res_dist;
+	CUdeviceptr	res_index;
+} kern_knnjoin;
+
+#define KNN_TILE_SZ				16
+#define KNN_MAX_K				128
+#define KNN_METRIC_L2			0
+#define KNN_METRIC_NEG_IP		1
+#define KNN_METRIC_COSINE		2
+#define KNN_FETCH_NROWS			1000
+#define KNN_OUTER_CHUNK_NITEMS	(1U << 16)
+
+typedef struct
+{
+	int			k;
+	int			metric;
+	Oid			elemtype;		/* element type of the vectors */
+	bool		is_half;		/* vectors are kept in float2 */
+	int			ndims;			/* -1, if not fixed yet */
+	size_t		unitsz;			/* width of a vector */
+	/* inner vectors */
+	int64	   *inner_ids;
+	char	   *inner_buf;
+	uint32		n_inner;
+	uint32		inner_nrooms;
+	/* outer vectors of the current chunk */
+	int64	   *outer_ids;
+	uint32		n_outer;
+	/* GPU resources */
+	GpuContext *gcontext;
+	ProgramId	program_id;
+	CUfunction	kern_norm;
+	CUfunction	kern_main;
+	CUdeviceptr	m_kknn;
+	CUdeviceptr	m_inner;
+	CUdeviceptr	m_outer;
+	CUdeviceptr	m_inner_norm;
+	CUdeviceptr	m_outer_norm;
+	CUdeviceptr	m_res_dist;
+	CUdeviceptr	m_res_index;
+	/* results */
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+	MemoryContext memcxt;		/* for the inner vectors */
+	MemoryContext tmp_cxt;		/* per fetch */
+} knnJoinState;
+
+typedef struct
+{
+	float		dist;
+	cl_uint		index;
+} knnJoinItem;
+
+Datum pgstrom_vector_knn_join(PG_FUNCTION_ARGS);
+
+/*
+ * __knnJoinParseMetric
+ */
+static int
+__knnJoinParseMetric(const char *metric)
+{
+	if (strcmp(metric, "l2") == 0 ||
+		strcmp(metric, "<->") == 0)
+		return KNN_METRIC_L2;
+	if (strcmp(metric, "negative_inner_product") == 0 ||
+		strcmp(metric, "<#>") == 0)
+		return KNN_METRIC_NEG_IP;
+	if (strcmp(metric, "cosine") == 0 ||
+		strcmp(metric, "<=>") == 0)
+		return KNN_METRIC_COSINE;
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("unknown vector distance metric: \"%s\"", metric),
+			 errhint("Valid metrics are \"l2\", \"negative_inner_product\" and \"cosine\".")));
+	return -1;		/* not reachable */
+}
+
+/*
+ * __knnJoinOpenCursor
+ *
+ * It opens a cursor of the query that returns (id, vector), and checks the
+ * result types.
+ */
+static Portal
+__knnJoinOpenCursor(knnJoinState *kjs, const char *query, const char *label)
+{
+	Portal		portal;
+	TupleDesc	tupdesc;
+	Oid			id_type;
+	Oid			elemtype;
+
+	portal = SPI_cursor_open_with_args(NULL, query, 0, NULL, NULL, NULL,
+									   true, 0);
+	if (!portal)
+		elog(ERROR, "failed on SPI_cursor_open_with_args: %s",
+			 SPI_result_code_string(SPI_result));
+	tupdesc = portal->tupDesc;
+	if (!tupdesc || tupdesc->natts != 2)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("%s query must return 2 columns (id, vector)", label)));
+	id_type = SPI_gettypeid(tupdesc, 1);
+	if (id_type != INT2OID &&
+		id_type != INT4OID &&
+		id_type != INT8OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("id of %s query must be integer, but %s",
+						label, format_type_be(id_type))));
+	elemtype = get_element_type(SPI_gettypeid(tupdesc, 2));
+	if (elemtype != FLOAT2OID &&
+		elemtype != FLOAT4OID &&
+		elemtype != FLOAT8OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("vector of %s query must be float2[], float4[] or float8[], but %s",
+						label, format_type_be(SPI_gettypeid(tupdesc, 2)))));
+	if (!OidIsValid(kjs->elemtype))
+	{
+		kjs->elemtype = elemtype;
+		kjs->is_half = (elemtype == FLOAT2OID);
+	}
+	else if (kjs->elemtype != elemtype)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("vector types mismatch: %s and %s",
+						format_type_be(kjs->elemtype),
+						format_type_be(elemtype))));
+	return portal;
+}
+
+/*
+ * __knnJoinFetchVector
+ *
+ * It returns the vector of the tuple, and its id on @p_id. NULL, if either
+ * of them is NULL; these rows never match.
+ */
+static ArrayType *
+__knnJoinFetchVector(knnJoinState *kjs, HeapTuple tuple, TupleDesc tupdesc,
+					 int64 *p_id)
+{
+	Datum		datum;
+	bool		isnull;
+	ArrayType  *array;
+	int			nitems;
+
+	datum = SPI_getbinval(tuple, tupdesc, 1, &isnull);
+	if (isnull)
+		return NULL;
+	switch (SPI_gettypeid(tupdesc, 1))
+	{
+		case INT2OID:
+			*p_id = DatumGetInt16(datum);
+			break;
+		case INT4OID:
+			*p_id = DatumGetInt32(datum);
+			break;
+		default:
+			*p_id = DatumGetInt64(datum);
+			break;
+	}
+	datum = SPI_getbinval(tuple, tupdesc, 2, &isnull);
+	if (isnull)
+		return NULL;
+	array = DatumGetArrayTypeP(datum);
+	if (ARR_NDIM(array) > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("vector must be one-dimensional array")));
+	if (ARR_HASNULL(array))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("vector must not contain nulls")));
+	nitems = ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+	if (kjs->ndims < 0)
+	{
+		/* the first vector determines the dimension */
+		if (nitems == 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("vector must not be empty")));
+		kjs->ndims = nitems;
+		kjs->unitsz = (kjs->is_half ? sizeof(cl_half) : sizeof(cl_float))
+			* (size_t)nitems;
+	}
+	else if (kjs->ndims != nitems)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("different vector dimensions %d and %d",
+						kjs->ndims, nitems)));
+	return array;
+}
+
+/*
+ * __knnJoinCopyVector
+ */
+static void
+__knnJoinCopyVector(knnJoinState *kjs, ArrayType *array, char *dest)
+{
+	int			i;
+
+	switch (kjs->elemtype)
+	{
+		case FLOAT2OID:
+		case FLOAT4OID:
+			memcpy(dest, ARR_DATA_PTR(array), kjs->unitsz);
+			break;
+		case FLOAT8OID:
+			for (i=0; i < kjs->ndims; i++)
+				((cl_float *)dest)[i] = ((float8 *)ARR_DATA_PTR(array))[i];
+			break;
+		default:
+			elog(ERROR, "unexpected vector element type: %s",
+				 format_type_be(kjs->elemtype));
+	}
+}
+
+/*
+ * __knnJoinLoadInner
+ *
+ * It loads all the inner vectors on the host buffer. The buffer is expanded
+ * on demand, because the number of rows is not known preliminary.
+ */
+static void
+__knnJoinLoadInner(knnJoinState *kjs, const char *inner_query)
+{
+	Portal		portal;
+	uint64		i;
+
+	portal = __knnJoinOpenCursor(kjs, inner_query, "inner");
+	for (;;)
+	{
+		MemoryContext oldcxt;
+
+		SPI_cursor_fetch(portal, true, KNN_FETCH_NROWS);
+		if (SPI_processed == 0)
+			break;
+		oldcxt = MemoryContextSwitchTo(kjs->tmp_cxt);
+		for (i=0; i < SPI_processed; i++)
+		{
+			ArrayType  *array;
+			int64		id;
+
+			array = __knnJoinFetchVector(kjs, SPI_tuptable->vals[i],
+										 SPI_tuptable->tupdesc, &id);
+			if (!array)
+				continue;
+			if (kjs->n_inner >= kjs->inner_nrooms)
+			{
+				uint32		nrooms;
+
+				/* UINT_MAX is a marker of empty slot on the results */
+				if (kjs->inner_nrooms >= UINT_MAX / 2)
+					ereport(ERROR,
+							(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+							 errmsg("too many inner vectors")));
+				nrooms = Max(2 * kjs->inner_nrooms, 10000);
+				if (!kjs->inner_ids)
+				{
+					kjs->inner_ids = MemoryContextAllocHuge(kjs->memcxt,
+												sizeof(int64) * nrooms);
+					kjs->inner_buf = MemoryContextAllocHuge(kjs->memcxt,
+												kjs->unitsz * nrooms);
+				}
+				else
+				{
+					kjs->inner_ids = repalloc_huge(kjs->inner_ids,
+												   sizeof(int64) * nrooms);
+					kjs->inner_buf = repalloc_huge(kjs->inner_buf,
+												   kjs->unitsz * nrooms);
+				}
+				kjs->inner_nrooms = nrooms;
+			}
+			kjs->inner_ids[kjs->n_inner] = id;
+			__knnJoinCopyVector(kjs, array, kjs->inner_buf +
+								kjs->unitsz * kjs->n_inner);
+			kjs->n_inner++;
+		}
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextReset(kjs->tmp_cxt);
+		SPI_freetuptable(SPI_tuptable);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+	SPI_cursor_close(portal);
+}
+
+/*
+ * __knnJoinComputeNorms
+ */
+static void
+__knnJoinComputeNorms(knnJoinState *kjs, CUdeviceptr m_vectors,
+					  CUdeviceptr m_norms, cl_uint nitems)
+{
+	cl_uint		ndims = kjs->ndims;
+	void	   *kern_args[4];
+	CUresult	rc;
+	int			grid_sz;
+	int			block_sz;
+
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kjs->kern_norm,
+							 kjs->gcontext->cuda_device,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Min(grid_sz, (nitems + block_sz - 1) / block_sz);
+	kern_args[0] = &m_vectors;
+	kern_args[1] = &m_norms;
+	kern_args[2] = &nitems;
+	kern_args[3] = &ndims;
+	rc = cuLaunchKernel(kjs->kern_norm,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+}
+
+/*
+ * __knnJoinSetupDevice
+ *
+ * It builds the kernel, then moves the inner vectors to the device memory.
+ */
+static void
+__knnJoinSetupDevice(knnJoinState *kjs)
+{
+	kern_knnjoin *kknn;
+	CUmodule	cuda_module;
+	CUresult	rc;
+	size_t		nslots = (size_t)KNN_OUTER_CHUNK_NITEMS * (size_t)kjs->k;
+
+	kjs->gcontext = AllocGpuContext(-1, true, false);
+	kjs->program_id = pgstrom_create_cuda_program(kjs->gcontext,
+												  0,
+												  0,
+												  gpu_knnjoin_kernel_source,
+												  kjs->is_half
+												  ? "#define KNN_HALF 1\n"
+												  : "",
+												  true,
+												  false);
+	cuda_module = GpuContextLookupModule(kjs->gcontext, kjs->program_id);
+	rc = cuModuleGetFunction(&kjs->kern_norm,
+							 cuda_module,
+							 "knnjoin_norm");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&kjs->kern_main,
+							 cuda_module,
+							 "knnjoin_main");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
+#define __KNN_ALLOC(m_ptr, sz)											\
+	do {																\
+		rc = gpuMemAllocManaged(kjs->gcontext, &(m_ptr), (sz),			\
+								CU_MEM_ATTACH_GLOBAL);					\
+		if (rc != CUDA_SUCCESS)											\
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc)); \
+	} while(0)
+	__KNN_ALLOC(kjs->m_kknn, sizeof(kern_knnjoin));
+	__KNN_ALLOC(kjs->m_inner, kjs->unitsz * kjs->n_inner);
+	__KNN_ALLOC(kjs->m_outer, kjs->unitsz * KNN_OUTER_CHUNK_NITEMS);
+	__KNN_ALLOC(kjs->m_inner_norm, sizeof(cl_float) * kjs->n_inner);
+	__KNN_ALLOC(kjs->m_outer_norm, sizeof(cl_float) * KNN_OUTER_CHUNK_NITEMS);
+	__KNN_ALLOC(kjs->m_res_dist, sizeof(cl_float) * nslots);
+	__KNN_ALLOC(kjs->m_res_index, sizeof(cl_uint) * nslots);
+#undef __KNN_ALLOC
+
+	memcpy((void *)kjs->m_inner, kjs->inner_buf,
+		   kjs->unitsz * kjs->n_inner);
+	pfree(kjs->inner_buf);
+	kjs->inner_buf = NULL;
+
+	kknn = (kern_knnjoin *)kjs->m_kknn;
+	memset(kknn, 0, sizeof(kern_knnjoin));
+	kknn->ndims = kjs->ndims;
+	kknn->k = kjs->k;
+	kknn->metric = kjs->metric;
+	kknn->n_outer = 0;
+	kknn->n_inner = kjs->n_inner;
+	kknn->outer = kjs->m_outer;
+	kknn->inner = kjs->m_inner;
+	kknn->outer_norm = kjs->m_outer_norm;
+	kknn->inner_norm = kjs->m_inner_norm;
+	kknn->res_dist = kjs->m_res_dist;
+	kknn->res_index = kjs->m_res_index;
+
+	__knnJoinComputeNorms(kjs, kjs->m_inner, kjs->m_inner_norm, kjs->n_inner);
+
+	kjs->outer_ids = palloc(sizeof(int64) * KNN_OUTER_CHUNK_NITEMS);
+}
+
+static int
+__knnJoinCompareItem(const void *__a, const void *__b)
+{
+	const knnJoinItem *a = __a;
+	const knnJoinItem *b = __b;
+
+	if (a->dist < b->dist)
+		return -1;
+	if (a->dist > b->dist)
+		return 1;
+	if (a->index < b->index)
+		return -1;
+	if (a->index > b->index)
+		return 1;
+	return 0;
+}
+
+/*
+ * __knnJoinFlushOuter
+ *
+ * It runs the kernel on the outer vectors of the current chunk, then put
+ * the top-k of each outer row on the tuplestore in the order of distance.
+ */
+static void
+__knnJoinFlushOuter(knnJoinState *kjs)
+{
+	kern_knnjoin *kknn = (kern_knnjoin *)kjs->m_kknn;
+	cl_float   *res_dist = (cl_float *)kjs->m_res_dist;
+	cl_uint	   *res_index = (cl_uint *)kjs->m_res_index;
+	knnJoinItem *items;
+	void	   *kern_args[1];
+	CUresult	rc;
+	int			grid_sz;
+	uint32		i, j;
+
+	if (kjs->n_outer == 0)
+		return;
+	kknn->n_outer = kjs->n_outer;
+	__knnJoinComputeNorms(kjs, kjs->m_outer, kjs->m_outer_norm, kjs->n_outer);
+
+	grid_sz = (kjs->n_outer + KNN_TILE_SZ - 1) / KNN_TILE_SZ;
+	kern_args[0] = &kjs->m_kknn;
+	rc = cuLaunchKernel(kjs->kern_main,
+						grid_sz, 1, 1,
+						KNN_TILE_SZ, KNN_TILE_SZ, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+	/* the buffers are referenced and reused by the host next */
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+
+	items = palloc(sizeof(knnJoinItem) * kjs->k);
+	for (i=0; i < kjs->n_outer; i++)
+	{
+		size_t		base = (size_t)i * (size_t)kjs->k;
+		int			nitems = 0;
+
+		/* the heap on the device is not sorted */
+		for (j=0; j < kjs->k; j++)
+		{
+			if (res_index[base + j] == UINT_MAX)
+				continue;
+			items[nitems].dist = res_dist[base + j];
+			items[nitems].index = res_index[base + j];
+			nitems++;
+		}
+		qsort(items, nitems, sizeof(knnJoinItem), __knnJoinCompareItem);
+		for (j=0; j < nitems; j++)
+		{
+			Datum		values[4];
+			bool		isnull[4];
+
+			values[0] = Int64GetDatum(kjs->outer_ids[i]);
+			values[1] = Int64GetDatum(kjs->inner_ids[items[j].index]);
+			values[2] = Int32GetDatum(j + 1);
+			values[3] = Float8GetDatum((float8)items[j].dist);
+			memset(isnull, 0, sizeof(isnull));
+			tuplestore_putvalues(kjs->tupstore, kjs->tupdesc,
+								 values, isnull);
+		}
+	}
+	pfree(items);
+	kjs->n_outer = 0;
+}
+
+/*
+ * __knnJoinProcessOuter
+ */
+static void
+__knnJoinProcessOuter(knnJoinState *kjs, const char *outer_query)
+{
+	Portal		portal;
+	uint64		i;
+
+	portal = __knnJoinOpenCursor(kjs, outer_query, "outer");
+	for (;;)
+	{
+		MemoryContext oldcxt;
+
+		SPI_cursor_fetch(portal, true, KNN_FETCH_NROWS);
+		if (SPI_processed == 0)
+			break;
+		oldcxt = MemoryContextSwitchTo(kjs->tmp_cxt);
+		for (i=0; i < SPI_processed; i++)
+		{
+			ArrayType  *array;
+			int64		id;
+
+			array = __knnJoinFetchVector(kjs, SPI_tuptable->vals[i],
+										 SPI_tuptable->tupdesc, &id);
+			if (!array)
+				continue;
+			kjs->outer_ids[kjs->n_outer] = id;
+			__knnJoinCopyVector(kjs, array, (char *)kjs->m_outer +
+								kjs->unitsz * kjs->n_outer);
+			if (++kjs->n_outer >= KNN_OUTER_CHUNK_NITEMS)
+				__knnJoinFlushOuter(kjs);
+		}
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextReset(kjs->tmp_cxt);
+		SPI_freetuptable(SPI_tuptable);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+	__knnJoinFlushOuter(kjs);
+	SPI_cursor_close(portal);
+}
+
+/*
+ * __knnJoinReleaseDevice
+ */
+static void
+__knnJoinReleaseDevice(knnJoinState *kjs)
+{
+	CUdeviceptr	m_buffers[7];
+	CUresult	rc;
+	int			i;
+
+	m_buffers[0] = kjs->m_res_index;
+	m_buffers[1] = kjs->m_res_dist;
+	m_buffers[2] = kjs->m_outer_norm;
+	m_buffers[3] = kjs->m_inner_norm;
+	m_buffers[4] = kjs->m_outer;
+	m_buffers[5] = kjs->m_inner;
+	m_buffers[6] = kjs->m_kknn;
+	for (i=0; i < lengthof(m_buffers); i++)
+	{
+		rc = gpuMemFree(kjs->gcontext, m_buffers[i]);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+	}
+	pgstrom_put_cuda_program(kjs->gcontext, kjs->program_id);
+	PutGpuContext(kjs->gcontext);
+	kjs->gcontext = NULL;
+}
+
+/*
+ * pgstrom_vector_knn_join
+ *
+ * pgstrom.vector_knn_join(outer_query text, inner_query text,
+ *                         k int, metric text = 'l2')
+ *
+ * Both of the queries return (id, vector); it returns the k nearest inner
+ * rows for each outer row, with rank and distance. Rows with NULL id or
+ * NULL vector are ignored.
+ */
+Datum
+pgstrom_vector_knn_join(PG_FUNCTION_ARGS)
+{
+	char	   *outer_query = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char	   *inner_query = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	int32		k = PG_GETARG_INT32(2);
+	char	   *metric = text_to_cstring(PG_GETARG_TEXT_PP(3));
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	knnJoinState *kjs;
+	MemoryContext oldcxt;
+
+	if (!rsinfo || !IsA(rsinfo, ReturnSetInfo) ||
+		(rsinfo->allowedModes & SFRM_Materialize) == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (k < 1 || k > KNN_MAX_K)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("k must be between 1 and %d", KNN_MAX_K)));
+
+	kjs = palloc0(sizeof(knnJoinState));
+	kjs->k = k;
+	kjs->metric = __knnJoinParseMetric(metric);
+	kjs->ndims = -1;
+	kjs->memcxt = CurrentMemoryContext;
+	kjs->tmp_cxt = AllocSetContextCreate(CurrentMemoryContext,
+										 "vector_knn_join temporary",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	/* tuplestore to be returned lives in the per-query memory context */
+	oldcxt = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	kjs->tupdesc = CreateTemplateTupleDesc(4);
+	TupleDescInitEntry(kjs->tupdesc, (AttrNumber) 1, "outer_id",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(kjs->tupdesc, (AttrNumber) 2, "inner_id",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(kjs->tupdesc, (AttrNumber) 3, "rank",
+					   INT4OID, -1, 0);
+	TupleDescInitEntry(kjs->tupdesc, (AttrNumber) 4, "distance",
+					   FLOAT8OID, -1, 0);
+	kjs->tupstore = tuplestore_begin_heap(true, false, work_mem);
+	MemoryContextSwitchTo(oldcxt);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "failed on SPI_connect");
+	PG_TRY();
+	{
+		__knnJoinLoadInner(kjs, inner_query);
+		/* no need to run the outer query, if inner is empty */
+		if (kjs->n_inner > 0)
+		{
+			__knnJoinSetupDevice(kjs);
+			__knnJoinProcessOuter(kjs, outer_query);
+		}
+	}
+	PG_CATCH();
+	{
+		if (kjs->gcontext)
+			PutGpuContext(kjs->gcontext);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	if (kjs->gcontext)
+		__knnJoinReleaseDevice(kjs);
+	SPI_finish();
+	MemoryContextDelete(kjs->tmp_cxt);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = kjs->tupstore;
+	rsinfo->setDesc = kjs->tupdesc;
+
+	return (Datum) 0;
+}
+PG_FUNCTION_INFO_V1(pgstrom_vector_knn_join);
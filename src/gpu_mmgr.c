@@ -29,6 +29,7 @@ typedef enum
 	GpuMemKind__IOMapMemory		= (1 << 2),
 	GpuMemKind__HostMemory		= (1 << 3),
 } GpuMemKind;
+#define GPUMEM_NUM_KINDS		4
 
 typedef struct
 {
@@ -57,20 +58,33 @@ typedef struct
 	GpuMemKind		gm_kind;	/* one of GpuMemKind__* */
 	CUdeviceptr		m_segment;	/* device pointer of the segment */
 	unsigned long	iomap_handle; /* only if GpuMemKind__IOMapMemory */
+	bool			on_huge_pages; /* only if GpuMemKind__HostMemory */
 	slock_t			lock;		/* protection of chunks */
 	pg_atomic_uint32 num_active_chunks; /* # of active chunks */
+	size_t			active_sz;	/* total size of active chunks */
 	dlist_head		free_chunks[GPUMEM_CHUNKSZ_MAX_BIT + 1];
 	GpuMemChunk		gm_chunks[FLEXIBLE_ARRAY_MEMBER];
 } GpuMemSegment;
 
+/* statistics of GPU memory usage (shared; per device and GpuMemKind) */
+typedef struct
+{
+	pg_atomic_uint64	segment_usage;	/* total size of the segments */
+	pg_atomic_uint64	chunk_usage;	/* total size of the active chunks */
+	pg_atomic_uint64	num_allocs;		/* # of chunk allocations */
+	pg_atomic_uint64	num_failures;	/* # of segment allocation failures */
+} GpuMemKindStatistics;
+
 /* statistics of GPU memory usage (shared; per device) */
 //to be used for memory release request mechanism
 typedef struct
 {
 	size_t				total_size;
-	pg_atomic_uint64	normal_usage;
-	pg_atomic_uint64	managed_usage;
-	pg_atomic_uint64	iomap_usage;
+	GpuMemKindStatistics kinds[GPUMEM_NUM_KINDS];
+	/* admission control of the device memory budget */
+	slock_t				budget_lock;
+	size_t				budget_reserved;
+	ConditionVariable	budget_cond;
 } GpuMemStatistics;
 
 /*
@@ -122,11 +136,63 @@ static shmem_startup_hook_type shmem_startup_next = NULL;
 static GpuMemStatistics *gm_stat_array = NULL;
 static int			gpu_memory_segment_size_kb;	/* GUC */
 static size_t		gm_segment_sz;	/* bytesize */
+static bool			gpu_memory_pool_enabled;	/* GUC */
+static double		gpu_memory_budget_ratio;	/* GUC */
+bool				pgstrom_gpu_memory_oversubscription;	/* GUC */
+static int			gpu_host_memory_huge_pages;	/* GUC; log2 of page size */
+
+static const struct config_enum_entry gpu_host_memory_huge_pages_options[] = {
+	{"off",	0,	false},
+	{"2MB",	21,	false},
+	{"1GB",	30,	false},
+	{NULL,	0,	false}
+};
 
 static bool			gpummgr_bgworker_got_signal = false;
 static GpuMemPreservedHead *gmemp_head = NULL;
 static HTAB		   *gmemp_htab = NULL;	/* for GpuMemPreserved */
 
+/*
+ * gpuMemKindStat - returns the statistics entry of the GpuMemKind
+ */
+static inline GpuMemKindStatistics *
+gpuMemKindStat(cl_int cuda_dindex, GpuMemKind gm_kind)
+{
+	GpuMemStatistics *gm_stat = &gm_stat_array[cuda_dindex];
+
+	switch (gm_kind)
+	{
+		case GpuMemKind__NormalMemory:
+			return &gm_stat->kinds[0];
+		case GpuMemKind__ManagedMemory:
+			return &gm_stat->kinds[1];
+		case GpuMemKind__IOMapMemory:
+			return &gm_stat->kinds[2];
+		case GpuMemKind__HostMemory:
+			return &gm_stat->kinds[3];
+		default:
+			break;
+	}
+	return NULL;
+}
+
+/*
+ * gpuMemReleaseSegmentStat - update statistics on release of a segment
+ */
+static inline void
+gpuMemReleaseSegmentStat(GpuMemSegment *gm_seg)
+{
+	GpuMemKindStatistics *gm_kstat = gpuMemKindStat(gm_seg->cuda_dindex,
+													gm_seg->gm_kind);
+	if (gm_kstat)
+	{
+		pg_atomic_sub_fetch_u64(&gm_kstat->segment_usage, gm_segment_sz);
+		if (gm_seg->active_sz > 0)
+			pg_atomic_sub_fetch_u64(&gm_kstat->chunk_usage,
+									gm_seg->active_sz);
+	}
+}
+
 /*
  * gpuMemFreeChunk
  */
@@ -141,6 +207,7 @@ gpuMemFreeChunk(GpuContext *gcontext,
 	cl_long			nchunks = gm_segment_sz / unitsz;
 	cl_long			index;
 	cl_long			shift;
+	size_t			chunk_sz;
 
 	Assert(m_deviceptr >= gm_seg->m_segment &&
 		   m_deviceptr <  gm_seg->m_segment + gm_segment_sz);
@@ -154,6 +221,9 @@ gpuMemFreeChunk(GpuContext *gcontext,
 		SpinLockRelease(&gm_seg->lock);
 		return CUDA_SUCCESS;
 	}
+	chunk_sz = (1UL << gm_chunk->mclass);
+	Assert(gm_seg->active_sz >= chunk_sz);
+	gm_seg->active_sz -= chunk_sz;
 
 	/* merge with prev/next free chunks if any */
 	while (gm_chunk->mclass < GPUMEM_CHUNKSZ_MAX_BIT)
@@ -203,7 +273,9 @@ gpuMemFreeChunk(GpuContext *gcontext,
 					&gm_chunk->chain);
 	pg_atomic_fetch_sub_u32(&gm_seg->num_active_chunks, 1);
 	SpinLockRelease(&gm_seg->lock);
-
+	pg_atomic_sub_fetch_u64(&gpuMemKindStat(gm_seg->cuda_dindex,
+											gm_seg->gm_kind)->chunk_usage,
+							chunk_sz);
     return CUDA_SUCCESS;
 }
 
@@ -224,6 +296,8 @@ gpuMemFreeExtra(GpuContext *gcontext,
 		rc = cuMemFree(m_deviceptr);
 	else if (extra == GPUMEM_HOST_RAW_EXTRA)
 		rc = cuMemFreeHost((void *)m_deviceptr);
+	else if (extra == GPUMEM_DEVICE_POOL_EXTRA)
+		rc = cuMemFreeAsync(m_deviceptr, CU_STREAM_PER_WORKER);
 	else
 		rc = gpuMemFreeChunk(gcontext, m_deviceptr, (GpuMemSegment *)extra);
 	GPUCONTEXT_POP(gcontext);
@@ -320,6 +394,59 @@ __gpuMemAllocManagedRaw(GpuContext *gcontext,
 	return rc;
 }
 
+/*
+ * gpuMemHostAllocHugePages
+ *
+ * It allocates host memory segment on the huge pages, then registers it as
+ * pinned memory at once. It returns CUDA_ERROR_NOT_SUPPORTED if huge pages
+ * are not configured or not available, then caller should fall back to
+ * the normal pinned memory.
+ */
+static CUresult
+gpuMemHostAllocHugePages(void **p_hostptr, size_t bytesize)
+{
+	size_t		page_sz = (1UL << gpu_host_memory_huge_pages);
+	void	   *hostptr;
+	CUresult	rc;
+
+	if (gpu_host_memory_huge_pages == 0 || bytesize % page_sz != 0)
+		return CUDA_ERROR_NOT_SUPPORTED;
+	hostptr = mmap(NULL, bytesize,
+				   PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | MAP_HUGETLB |
+				   (gpu_host_memory_huge_pages << MAP_HUGE_SHIFT),
+				   -1, 0);
+	if (hostptr == MAP_FAILED)
+		return CUDA_ERROR_NOT_SUPPORTED;	/* no reserved huge pages? */
+	rc = cuMemHostRegister(hostptr, bytesize, CU_MEMHOSTREGISTER_PORTABLE);
+	if (rc != CUDA_SUCCESS)
+	{
+		wnotice("failed on cuMemHostRegister: %s", errorText(rc));
+		munmap(hostptr, bytesize);
+		return CUDA_ERROR_NOT_SUPPORTED;
+	}
+	*p_hostptr = hostptr;
+	return CUDA_SUCCESS;
+}
+
+/*
+ * gpuMemFreeHostSegment
+ */
+static CUresult
+gpuMemFreeHostSegment(GpuMemSegment *gm_seg)
+{
+	CUresult	rc;
+
+	Assert(gm_seg->gm_kind == GpuMemKind__HostMemory);
+	if (!gm_seg->on_huge_pages)
+		return cuMemFreeHost((void *)gm_seg->m_segment);
+
+	rc = cuMemHostUnregister((void *)gm_seg->m_segment);
+	if (munmap((void *)gm_seg->m_segment, gm_segment_sz) != 0)
+		wnotice("failed on munmap: %m");
+	return rc;
+}
+
 /*
  * __gpuMemAllocHostRaw
  */
@@ -330,10 +457,14 @@ __gpuMemAllocHostRaw(GpuContext *gcontext,
 					 const char *filename, int lineno)
 {
 	void	   *hostptr;
+	bool		numa_policy;
 	CUresult	rc;
 
 	GPUCONTEXT_PUSH(gcontext);
+	numa_policy = gpuDeviceSetNumaMemPolicy(gcontext->cuda_dindex);
 	rc = cuMemAllocHost(&hostptr, bytesize);
+	if (numa_policy)
+		gpuDeviceResetNumaMemPolicy();
 	if (rc != CUDA_SUCCESS)
 		wnotice("failed on cuMemAllocHost(%zu): %s", bytesize, errorText(rc));
 	else if (!trackGpuMem(gcontext, (CUdeviceptr)hostptr,
@@ -447,7 +578,7 @@ gpuMemAllocChunk(GpuMemKind gm_kind,
 				 cl_int mclass,
 				 const char *filename, int lineno)
 {
-	GpuMemStatistics *gm_stat;
+	GpuMemKindStatistics *gm_kstat;
 	GpuMemSegment  *gm_seg;
 	GpuMemChunk	   *gm_chunk;
 	CUdeviceptr		m_deviceptr;
@@ -461,7 +592,9 @@ gpuMemAllocChunk(GpuMemKind gm_kind,
 	cl_int			i, __mclass;
 	size_t			segment_usage;
 	bool			has_exclusive_lock = false;
+	bool			numa_policy;
 
+	gm_kstat = gpuMemKindStat(gcontext->cuda_dindex, gm_kind);
 	switch (gm_kind)
 	{
 		case GpuMemKind__NormalMemory:
@@ -502,9 +635,12 @@ retry:
 				   gm_chunk->mclass == mclass);
 			memset(&gm_chunk->chain, 0, sizeof(dlist_node));
 			gm_chunk->refcnt++;
+			gm_seg->active_sz += (1UL << mclass);
 			pg_atomic_fetch_add_u32(&gm_seg->num_active_chunks, 1);
 			SpinLockRelease(&gm_seg->lock);
 			pthreadRWLockUnlock(&gcontext->gm_rwlock);
+			pg_atomic_add_fetch_u64(&gm_kstat->chunk_usage, 1UL << mclass);
+			pg_atomic_add_fetch_u64(&gm_kstat->num_allocs, 1);
 			/* ok, found */
 			Assert(gm_chunk >= gm_seg->gm_chunks &&
 				   (gm_chunk - gm_seg->gm_chunks) < nchunks);
@@ -579,8 +715,16 @@ retry:
 			break;
 
 		case GpuMemKind__HostMemory:
-			rc = cuMemHostAlloc((void **)&m_segment, gm_segment_sz,
-								CU_MEMHOSTALLOC_PORTABLE);
+			/* pinned pages on the numa-node local to the GPU */
+			numa_policy = gpuDeviceSetNumaMemPolicy(gcontext->cuda_dindex);
+			rc = gpuMemHostAllocHugePages((void **)&m_segment, gm_segment_sz);
+			if (rc == CUDA_SUCCESS)
+				gm_seg->on_huge_pages = true;
+			else
+				rc = cuMemHostAlloc((void **)&m_segment, gm_segment_sz,
+									CU_MEMHOSTALLOC_PORTABLE);
+			if (numa_policy)
+				gpuDeviceResetNumaMemPolicy();
 			//wnotice("hostmem m_segment = %p - %p", (void *)m_segment, (void *)(m_segment - gm_segment_sz));
 			break;
 
@@ -594,6 +738,7 @@ retry:
 	{
 		free(gm_seg);
 		pthreadRWLockUnlock(&gcontext->gm_rwlock);
+		pg_atomic_add_fetch_u64(&gm_kstat->num_failures, 1);
 		return rc;
 	}
 	/* setup of GpuMemSegment */
@@ -627,22 +772,126 @@ retry:
 	dlist_push_head(gm_segment_list, &gm_seg->chain);
 
 	/* update statistics */
-	gm_stat = &gm_stat_array[gcontext->cuda_dindex];
-	switch (gm_kind)
+	pg_atomic_add_fetch_u64(&gm_kstat->segment_usage, gm_segment_sz);
+	goto retry;
+}
+
+/*
+ * gpuMemPoolGetOrCreate - returns the stream-ordered memory pool of the
+ * GpuContext. It creates a new one on demand, or returns NULL if device
+ * does not support memory pools, then caller falls back to the buddy
+ * allocator.
+ */
+static CUmemoryPool
+gpuMemPoolGetOrCreate(GpuContext *gcontext)
+{
+	CUmemoryPool	mempool;
+	CUmemPoolProps	props;
+	cuuint64_t		threshold = UINT64_MAX;
+	int				supported = 0;
+	CUresult		rc;
+
+	pthreadRWLockReadLock(&gcontext->gm_rwlock);
+	mempool = gcontext->gm_mempool;
+	pthreadRWLockUnlock(&gcontext->gm_rwlock);
+	if (mempool)
+		return (mempool != (CUmemoryPool)(~0UL) ? mempool : NULL);
+
+	pthreadRWLockWriteLock(&gcontext->gm_rwlock);
+	if (!gcontext->gm_mempool)
 	{
-		case GpuMemKind__NormalMemory:
-			pg_atomic_add_fetch_u64(&gm_stat->normal_usage, gm_segment_sz);
-			break;
-		case GpuMemKind__ManagedMemory:
-			pg_atomic_add_fetch_u64(&gm_stat->managed_usage, gm_segment_sz);
-			break;
-		case GpuMemKind__IOMapMemory:
-			pg_atomic_add_fetch_u64(&gm_stat->iomap_usage, gm_segment_sz);
-			break;
-		default:
-			break;
+		rc = cuDeviceGetAttribute(&supported,
+								  CU_DEVICE_ATTRIBUTE_MEMORY_POOLS_SUPPORTED,
+								  gcontext->cuda_device);
+		if (rc != CUDA_SUCCESS || !supported)
+		{
+			wnotice("GPU%d does not support memory pools, so buddy allocator is used instead",
+					gcontext->cuda_dindex);
+			goto not_supported;
+		}
+		memset(&props, 0, sizeof(CUmemPoolProps));
+		props.allocType = CU_MEM_ALLOCATION_TYPE_PINNED;
+		props.handleTypes = CU_MEM_HANDLE_TYPE_NONE;
+		props.location.type = CU_MEM_LOCATION_TYPE_DEVICE;
+		props.location.id = devAttrs[gcontext->cuda_dindex].DEV_ID;
+		rc = cuMemPoolCreate(&mempool, &props);
+		if (rc != CUDA_SUCCESS)
+		{
+			wnotice("failed on cuMemPoolCreate: %s", errorText(rc));
+			goto not_supported;
+		}
+		/*
+		 * Keeps the physical memory once reserved by the pool, instead of
+		 * the release on every synchronization; gpuMemReclaimSegment()
+		 * trims it on the device memory pressure.
+		 */
+		rc = cuMemPoolSetAttribute(mempool,
+								   CU_MEMPOOL_ATTR_RELEASE_THRESHOLD,
+								   &threshold);
+		if (rc != CUDA_SUCCESS)
+			wnotice("failed on cuMemPoolSetAttribute: %s", errorText(rc));
+		gcontext->gm_mempool = mempool;
 	}
-	goto retry;
+	mempool = gcontext->gm_mempool;
+	pthreadRWLockUnlock(&gcontext->gm_rwlock);
+
+	return (mempool != (CUmemoryPool)(~0UL) ? mempool : NULL);
+
+not_supported:
+	gcontext->gm_mempool = (CUmemoryPool)(~0UL);
+	pthreadRWLockUnlock(&gcontext->gm_rwlock);
+	return NULL;
+}
+
+/*
+ * __gpuMemAllocPool - allocation of device memory from the stream-ordered
+ * memory pool. Unlike the buddy allocator, request is not rounded up to
+ * the power of two, and the pool grows its reservation on demand.
+ */
+static CUresult
+__gpuMemAllocPool(GpuContext *gcontext,
+				  CUmemoryPool mempool,
+				  CUdeviceptr *p_deviceptr,
+				  size_t bytesize,
+				  const char *filename, int lineno)
+{
+	CUdeviceptr	m_deviceptr;
+	CUresult	rc;
+
+	GPUCONTEXT_PUSH(gcontext);
+	rc = cuMemAllocFromPoolAsync(&m_deviceptr, bytesize, mempool,
+								 CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		wnotice("failed on cuMemAllocFromPoolAsync(%zu): %s",
+				bytesize, errorText(rc));
+	else
+	{
+		/*
+		 * Device memory is often consumed by the stream of another thread
+		 * (e.g, inner buffer of GpuJoin by GPU workers), so we have to
+		 * ensure the allocation is completed prior to return.
+		 */
+		rc = cuStreamSynchronize(CU_STREAM_PER_WORKER);
+		if (rc != CUDA_SUCCESS)
+		{
+			wnotice("failed on cuStreamSynchronize: %s", errorText(rc));
+			cuMemFreeAsync(m_deviceptr, CU_STREAM_PER_WORKER);
+		}
+		else if (!trackGpuMem(gcontext, m_deviceptr,
+							  GPUMEM_DEVICE_POOL_EXTRA,
+							  filename, lineno))
+		{
+			cuMemFreeAsync(m_deviceptr, CU_STREAM_PER_WORKER);
+			rc = CUDA_ERROR_OUT_OF_MEMORY;
+		}
+		else
+		{
+			*p_deviceptr = m_deviceptr;
+		}
+	}
+	GPUCONTEXT_POP(gcontext);
+
+	return rc;
 }
 
 /*
@@ -654,6 +903,16 @@ __gpuMemAlloc(GpuContext *gcontext,
 			  size_t bytesize,
 			  const char *filename, int lineno)
 {
+	if (gpu_memory_pool_enabled)
+	{
+		CUmemoryPool	mempool = gpuMemPoolGetOrCreate(gcontext);
+
+		if (mempool)
+			return __gpuMemAllocPool(gcontext, mempool,
+									 p_deviceptr, bytesize,
+									 filename, lineno);
+	}
+
 	if (bytesize <= gm_segment_sz / 2)
 	{
 		cl_int	mclass = Max(get_next_log2(bytesize),
@@ -755,6 +1014,78 @@ __gpuMemAllocHost(GpuContext *gcontext,
 								filename, lineno);
 }
 
+/*
+ * __gpuMemArenaCreate
+ *
+ * It allocates a managed memory region for a particular GpuTask at once.
+ * Only the arena itself is tracked by the resource tracker, and the task
+ * object and its buffers are sub-allocated by gpuMemArenaAlloc().
+ */
+CUresult
+__gpuMemArenaCreate(GpuContext *gcontext,
+					GpuMemArena **p_arena,
+					size_t bytesize,
+					const char *filename, int lineno)
+{
+	GpuMemArena *arena;
+	CUdeviceptr	m_deviceptr;
+	CUresult	rc;
+
+	bytesize = STROMALIGN(bytesize);
+	rc = __gpuMemAllocManaged(gcontext,
+							  &m_deviceptr,
+							  offsetof(GpuMemArena, data) + bytesize,
+							  CU_MEM_ATTACH_GLOBAL,
+							  filename, lineno);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	arena = (GpuMemArena *) m_deviceptr;
+	arena->gcontext = gcontext;
+	pg_atomic_init_u32(&arena->refcnt, 0);
+	arena->length = bytesize;
+	arena->usage = 0;
+
+	*p_arena = arena;
+	return CUDA_SUCCESS;
+}
+
+/*
+ * gpuMemArenaAlloc - bump-pointer allocation on the arena
+ *
+ * It returns NULL if no room on the arena. Each sub-allocation has to be
+ * released by gpuMemArenaFree().
+ */
+void *
+gpuMemArenaAlloc(GpuMemArena *arena, size_t bytesize)
+{
+	char	   *pos;
+
+	bytesize = STROMALIGN(bytesize);
+	if (arena->usage + bytesize > arena->length)
+		return NULL;
+	pos = arena->data + arena->usage;
+	arena->usage += bytesize;
+	pg_atomic_fetch_add_u32(&arena->refcnt, 1);
+
+	return pos;
+}
+
+/*
+ * gpuMemArenaFree - release a sub-allocation, and the arena itself if the
+ * last one is released.
+ */
+CUresult
+gpuMemArenaFree(GpuMemArena *arena)
+{
+	int32		refcnt;
+
+	refcnt = (int32)pg_atomic_sub_fetch_u32(&arena->refcnt, 1);
+	Assert(refcnt >= 0);
+	if (refcnt > 0)
+		return CUDA_SUCCESS;
+	return gpuMemFree(arena->gcontext, (CUdeviceptr) arena);
+}
+
 /*
  * __gpuMemRequestPreserved
  */
@@ -911,6 +1242,14 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 	CUresult		rc;
 
 	pthreadRWLockWriteLock(&gcontext->gm_rwlock);
+	if (gcontext->gm_mempool &&
+		gcontext->gm_mempool != (CUmemoryPool)(~0UL))
+	{
+		/* release the unused reservation of the memory pool */
+		rc = cuMemPoolTrimTo(gcontext->gm_mempool, 0);
+		if (rc != CUDA_SUCCESS)
+			wnotice("failed on cuMemPoolTrimTo: %s", errorText(rc));
+	}
 	if (!dlist_is_empty(dhead_n))
 		dnode_n = dlist_tail_node(dhead_n);
 	if (!dlist_is_empty(dhead_i))
@@ -938,6 +1277,7 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 					werror("failed on cuMemFree: %s", errorText(rc));
 				}
 				dlist_delete(&gm_seg->chain);
+				gpuMemReleaseSegmentStat(gm_seg);
 				free(gm_seg);
 				break;
 			}
@@ -965,6 +1305,7 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 					werror("failed on cuMemFree: %s", errorText(rc));
 				}
 				dlist_delete(&gm_seg->chain);
+				gpuMemReleaseSegmentStat(gm_seg);
 				free(gm_seg);
 				break;
 			}
@@ -987,6 +1328,7 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 					werror("failed on cuMemFree: %s", errorText(rc));
 				}
 				dlist_delete(&gm_seg->chain);
+				gpuMemReleaseSegmentStat(gm_seg);
 				free(gm_seg);
 			}
 		}
@@ -1000,13 +1342,14 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 			Assert(gm_seg->gm_kind == GpuMemKind__HostMemory);
 			if (pg_atomic_read_u32(&gm_seg->num_active_chunks) == 0)
 			{
-				rc = cuMemFreeHost((void *)gm_seg->m_segment);
+				rc = gpuMemFreeHostSegment(gm_seg);
 				if (rc != CUDA_SUCCESS)
 				{
 					pthreadRWLockUnlock(&gcontext->gm_rwlock);
 					werror("failed on cuMemFreeHost: %s", errorText(rc));
 				}
 				dlist_delete(&gm_seg->chain);
+				gpuMemReleaseSegmentStat(gm_seg);
 				free(gm_seg);
 			}
 		}
@@ -1014,6 +1357,106 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 	pthreadRWLockUnlock(&gcontext->gm_rwlock);
 }
 
+/*
+ * gpuMemPrefetchManaged - gives hints to the managed memory which may be
+ * larger than the device memory, then prefetches the range to the device
+ * asynchronously. Caller must push the CUDA context of the GpuContext.
+ */
+CUresult
+gpuMemPrefetchManaged(GpuContext *gcontext,
+					  CUdeviceptr m_addr, size_t length,
+					  bool read_mostly)
+{
+	CUresult	rc;
+
+	rc = cuMemAdvise(m_addr, length,
+					 CU_MEM_ADVISE_SET_PREFERRED_LOCATION,
+					 gcontext->cuda_device);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	if (read_mostly)
+	{
+		rc = cuMemAdvise(m_addr, length,
+						 CU_MEM_ADVISE_SET_READ_MOSTLY,
+						 gcontext->cuda_device);
+		if (rc != CUDA_SUCCESS)
+			return rc;
+	}
+	return cuMemPrefetchAsync(m_addr, length,
+							  gcontext->cuda_device,
+							  CU_STREAM_PER_WORKER);
+}
+
+/*
+ * gpuMemReserveBudget - admission control of the queries according to
+ * the estimated device memory footprint.
+ *
+ * It reserves @footprint bytes of the device memory budget shared by all
+ * the backends, or blocks the caller until concurrent queries release
+ * their budget. The returned size shall be released by gpuMemReleaseBudget,
+ * or on the release of GpuContext at least.
+ */
+size_t
+gpuMemReserveBudget(GpuContext *gcontext, size_t footprint)
+{
+	GpuMemStatistics *gm_stat;
+	size_t		budget_limit;
+
+	if (gpu_memory_budget_ratio <= 0.0 || footprint == 0)
+		return 0;
+	Assert(gcontext->cuda_dindex >= 0 &&
+		   gcontext->cuda_dindex < numDevAttrs);
+	gm_stat = &gm_stat_array[gcontext->cuda_dindex];
+	budget_limit = (double)gm_stat->total_size * gpu_memory_budget_ratio;
+	/* a query larger than the budget shall run alone */
+	footprint = Min(footprint, budget_limit);
+
+	SpinLockAcquire(&gm_stat->budget_lock);
+	/*
+	 * The backend which is already admitted (e.g, the second GpuJoin in
+	 * a query) never waits for others, to avoid self-deadlock.
+	 */
+	if (gcontext->gm_budget_sz == 0 &&
+		gm_stat->budget_reserved + footprint > budget_limit)
+	{
+		ConditionVariablePrepareToSleep(&gm_stat->budget_cond);
+		while (gm_stat->budget_reserved + footprint > budget_limit)
+		{
+			SpinLockRelease(&gm_stat->budget_lock);
+			ConditionVariableSleep(&gm_stat->budget_cond,
+								   PG_WAIT_EXTENSION);
+			SpinLockAcquire(&gm_stat->budget_lock);
+		}
+		ConditionVariableCancelSleep();
+	}
+	gm_stat->budget_reserved += footprint;
+	SpinLockRelease(&gm_stat->budget_lock);
+	gcontext->gm_budget_sz += footprint;
+
+	return footprint;
+}
+
+/*
+ * gpuMemReleaseBudget
+ */
+void
+gpuMemReleaseBudget(GpuContext *gcontext, size_t budget_sz)
+{
+	GpuMemStatistics *gm_stat;
+
+	if (budget_sz == 0)
+		return;
+	Assert(budget_sz <= gcontext->gm_budget_sz);
+	gm_stat = &gm_stat_array[gcontext->cuda_dindex];
+	SpinLockAcquire(&gm_stat->budget_lock);
+	Assert(gm_stat->budget_reserved >= budget_sz);
+	gm_stat->budget_reserved -= Min(gm_stat->budget_reserved, budget_sz);
+	SpinLockRelease(&gm_stat->budget_lock);
+	gcontext->gm_budget_sz -= budget_sz;
+
+	ConditionVariableBroadcast(&gm_stat->budget_cond);
+}
+
 /*
  * pgstrom_gpu_mmgr_init_gpucontext - Per GpuContext initialization
  */
@@ -1025,6 +1468,8 @@ pgstrom_gpu_mmgr_init_gpucontext(GpuContext *gcontext)
 	dlist_init(&gcontext->gm_iomap_list);
 	dlist_init(&gcontext->gm_managed_list);
 	dlist_init(&gcontext->gm_hostmem_list);
+	gcontext->gm_mempool = NULL;
+	gcontext->gm_budget_sz = 0;
 }
 
 /*
@@ -1037,7 +1482,6 @@ pgstrom_gpu_mmgr_init_gpucontext(GpuContext *gcontext)
 void
 pgstrom_gpu_mmgr_cleanup_gpucontext(GpuContext *gcontext)
 {
-	GpuMemStatistics *gm_stat = &gm_stat_array[gcontext->cuda_dindex];
 	GpuMemSegment  *gm_seg;
 	dlist_node	   *dnode;
 	CUresult		rc;
@@ -1049,7 +1493,7 @@ pgstrom_gpu_mmgr_cleanup_gpucontext(GpuContext *gcontext)
 		rc = cuMemFree(gm_seg->m_segment);
 		if (rc != CUDA_SUCCESS)
 			elog(WARNING, "failed on cuMemFree(normal): %s", errorText(rc));
-		pg_atomic_sub_fetch_u64(&gm_stat->normal_usage, gm_segment_sz);
+		gpuMemReleaseSegmentStat(gm_seg);
 		free(gm_seg);
 	}
 
@@ -1060,7 +1504,7 @@ pgstrom_gpu_mmgr_cleanup_gpucontext(GpuContext *gcontext)
 		rc = cuMemFree(gm_seg->m_segment);
         if (rc != CUDA_SUCCESS)
             elog(WARNING, "failed on cuMemFree(managed): %s", errorText(rc));
-		pg_atomic_sub_fetch_u64(&gm_stat->managed_usage, gm_segment_sz);
+		gpuMemReleaseSegmentStat(gm_seg);
 		free(gm_seg);
 	}
 
@@ -1077,7 +1521,7 @@ pgstrom_gpu_mmgr_cleanup_gpucontext(GpuContext *gcontext)
 		rc = cuMemFree(gm_seg->m_segment);
 		if (rc != CUDA_SUCCESS)
 			elog(WARNING, "failed on cuMemFree(io-map): %s", errorText(rc));
-		pg_atomic_sub_fetch_u64(&gm_stat->iomap_usage, gm_segment_sz);
+		gpuMemReleaseSegmentStat(gm_seg);
 		free(gm_seg);
 	}
 
@@ -1085,11 +1529,16 @@ pgstrom_gpu_mmgr_cleanup_gpucontext(GpuContext *gcontext)
 	{
 		dnode = dlist_pop_head_node(&gcontext->gm_hostmem_list);
 		gm_seg = dlist_container(GpuMemSegment, chain, dnode);
-		rc = cuMemFreeHost((void *)gm_seg->m_segment);
+		rc = gpuMemFreeHostSegment(gm_seg);
 		if (rc != CUDA_SUCCESS)
 			elog(WARNING, "failed on cuMemFreeHost: %s", errorText(rc));
+		gpuMemReleaseSegmentStat(gm_seg);
 		free(gm_seg);
 	}
+	/* memory pool is already released with CUDA context */
+	gcontext->gm_mempool = NULL;
+	/* budget not released yet, if query was aborted */
+	gpuMemReleaseBudget(gcontext, gcontext->gm_budget_sz);
 }
 
 /*
@@ -1345,6 +1794,97 @@ pgstrom_device_preserved_meminfo(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_device_preserved_meminfo);
 
+/*
+ * pgstrom_stat_gpu_memory - usage of the device memory per GpuMemKind
+ */
+Datum pgstrom_stat_gpu_memory(PG_FUNCTION_ARGS);
+
+Datum
+pgstrom_stat_gpu_memory(PG_FUNCTION_ARGS)
+{
+	static const char *gm_kind_names[GPUMEM_NUM_KINDS] = {
+		"normal", "managed", "iomap", "host"
+	};
+	FuncCallContext *fncxt;
+	GpuMemStatistics *gm_stat;
+	GpuMemKindStatistics *gm_kstat;
+	HeapTuple		tuple;
+	bool			isnull[9];
+	Datum			values[9];
+	int				dindex;
+	int				kindex;
+	uint64			segment_usage;
+	uint64			chunk_usage;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc		tupdesc;
+		MemoryContext	oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+
+		tupdesc = CreateTemplateTupleDesc(9);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "device_nr",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "kind",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 3, "segment_size",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "num_segments",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 5, "segment_usage",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 6, "chunk_usage",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 7, "fragmentation",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 8, "num_allocs",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 9, "num_failures",
+						   INT8OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+
+	if (!gm_stat_array ||
+		fncxt->call_cntr >= numDevAttrs * GPUMEM_NUM_KINDS)
+		SRF_RETURN_DONE(fncxt);
+	dindex = fncxt->call_cntr / GPUMEM_NUM_KINDS;
+	kindex = fncxt->call_cntr % GPUMEM_NUM_KINDS;
+	gm_stat = &gm_stat_array[dindex];
+	gm_kstat = &gm_stat->kinds[kindex];
+	segment_usage = pg_atomic_read_u64(&gm_kstat->segment_usage);
+	chunk_usage = pg_atomic_read_u64(&gm_kstat->chunk_usage);
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int32GetDatum(devAttrs[dindex].DEV_ID);
+	values[1] = CStringGetTextDatum(gm_kind_names[kindex]);
+	values[2] = Int64GetDatum(gm_segment_sz);
+	values[3] = Int64GetDatum(segment_usage / gm_segment_sz);
+	values[4] = Int64GetDatum(segment_usage);
+	values[5] = Int64GetDatum(chunk_usage);
+	/*
+	 * NOTE: fragmentation is the ratio of the segments not occupied by
+	 * the active chunks. Chunks are already rounded up to power-of-two,
+	 * so the internal fragmentation of the chunks is not counted.
+	 */
+	if (segment_usage == 0)
+		isnull[6] = true;
+	else
+		values[6] = Float8GetDatum(1.0 - (double)Min(chunk_usage,
+													 segment_usage) /
+								   (double)segment_usage);
+	values[7] = Int64GetDatum(pg_atomic_read_u64(&gm_kstat->num_allocs));
+	values[8] = Int64GetDatum(pg_atomic_read_u64(&gm_kstat->num_failures));
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_stat_gpu_memory);
+
 /*
  * pgstrom_startup_gpu_mmgr
  */
@@ -1368,7 +1908,11 @@ pgstrom_startup_gpu_mmgr(void)
 		elog(ERROR, "Bug? GPU Device Memory Statistics exists");
 	memset(gm_stat_array, 0, required);
 	for (i=0; i < numDevAttrs; i++)
+	{
 		gm_stat_array[i].total_size = devAttrs[i].DEV_TOTAL_MEMSZ;
+		SpinLockInit(&gm_stat_array[i].budget_lock);
+		ConditionVariableInit(&gm_stat_array[i].budget_cond);
+	}
 
 	/*
 	 * GpuMemPreservedHead
@@ -1424,6 +1968,57 @@ pgstrom_init_gpu_mmgr(void)
 			 (int)(pgstrom_chunk_size() >> 10));
 	gm_segment_sz = (size_t)gpu_memory_segment_size_kb << 10;
 
+	/*
+	 * Use of stream-ordered memory pool for the device memory
+	 */
+	DefineCustomBoolVariable("pg_strom.gpu_memory_pool",
+							 "Enables stream-ordered memory pool for GPU device memory",
+							 NULL,
+							 &gpu_memory_pool_enabled,
+							 false,
+							 PGC_POSTMASTER,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Huge pages for the pinned host memory segment
+	 */
+	DefineCustomEnumVariable("pg_strom.gpu_host_memory_huge_pages",
+							 "Page size of the pinned host memory segment",
+							 NULL,
+							 &gpu_host_memory_huge_pages,
+							 0,
+							 gpu_host_memory_huge_pages_options,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Managed memory for the buffer larger than device memory
+	 */
+	DefineCustomBoolVariable("pg_strom.gpu_memory_oversubscription",
+							 "Enables managed memory for oversized inner/final buffers",
+							 NULL,
+							 &pgstrom_gpu_memory_oversubscription,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Admission control by the device memory budget
+	 */
+	DefineCustomRealVariable("pg_strom.gpu_memory_budget_ratio",
+							 "Ratio of device memory for admission control of GPU queries",
+							 NULL,
+							 &gpu_memory_budget_ratio,
+							 0.0,
+							 0.0,
+							 1.0,
+							 PGC_SIGHUP,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/*
 	 * Background workers per device, to keep device memory for multi-process
 	 */
@@ -1482,9 +2077,10 @@ __gpuMemCopyFromSSD_Block(GpuContext *gcontext,
 		rc = cuMemcpyHtoDAsync(m_kds,
 							   &pds->kds,
 							   pds->kds.length,
-							   CU_STREAM_PER_THREAD);
+							   CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemcpyHtoDAsync: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds->kds.length, 0, 0);
 		return;
 	}
 	Assert(pds->nblocks_uncached <= pds->kds.nitems);
@@ -1497,9 +2093,10 @@ __gpuMemCopyFromSSD_Block(GpuContext *gcontext,
 	rc = cuMemcpyHtoDAsync(m_kds,
 						   &pds->kds,
 						   length,
-						   CU_STREAM_PER_THREAD);
+						   CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuMemcpyHtoDAsync: %s", errorText(rc));
+	gpuDeviceCountDMA(gcontext, length, 0, pds->kds.length - length);
 
 	/* (2) kick SSD2GPU P2P DMA, if any */
 	if (pds->iovec)
@@ -1531,10 +2128,11 @@ __gpuMemCopyFromSSD_Arrow(GpuContext *gcontext,
 	rc = cuMemcpyHtoDAsync(m_kds,
 						   &pds->kds,
 						   head_sz,
-						   CU_STREAM_PER_THREAD);
+						   CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuMemcpyHtoDAsync: %s", errorText(rc));
-	
+	gpuDeviceCountDMA(gcontext, head_sz, 0, pds->kds.length - head_sz);
+
 	/* (2) SSD2GPU P2P DMA */
 	if (pds->iovec)
 	{
@@ -17,6 +17,47 @@
  */
 #include "pg_strom.h"
 
+/* GUC variables */
+static char	   *pgstrom_gpu_trace_dir = NULL;
+static int			pgstrom_chunk_target_latency;	/* GUC; ms */
+static int			pgstrom_gpu_query_stats_size;	/* GUC */
+static double		pgstrom_gpu_query_stats_sample_rate;	/* GUC */
+
+/*
+ * GpuQuerySample - runtime statistics of a GpuTaskState sampled at its end
+ *
+ * Samples are written to a fixed-size ring buffer on the shared memory.
+ * Writers never take locks; @seqno is cleared during the update, then
+ * readers ignore the entry if @seqno is zero or changed during the copy.
+ */
+typedef struct
+{
+	pg_atomic_uint64 seqno;			/* 0 = invalid or under update */
+	Oid				dbid;
+	Oid				userid;
+	uint64			queryid;
+	TimestampTz		sampled_at;
+	char			node_name[NAMEDATALEN];
+	bool			is_worker;
+	uint64			num_chunks;
+	uint64			bytes_loaded;
+	uint64			num_fallbacks;
+	uint64			time_chunk_load;	/* usec */
+	uint64			time_jit_wait;		/* usec */
+	uint64			time_gpu_exec;		/* usec */
+	uint64			time_fallback;		/* usec */
+} GpuQuerySample;
+
+typedef struct
+{
+	pg_atomic_uint64 next_seqno;
+	uint32			nitems;
+	GpuQuerySample	samples[FLEXIBLE_ARRAY_MEMBER];
+} GpuQuerySampleRing;
+
+static shmem_startup_hook_type shmem_startup_next = NULL;
+static GpuQuerySampleRing *gpuQuerySampleRing = NULL;
+
 /*
  * see definition at xact.c
  *
@@ -74,10 +115,191 @@ __appendXactIdVector(StringInfo buf)
 	return poffset;
 }
 
+/*
+ * __appendXactSnapshot
+ *
+ * It appends kern_snapshot for device-side visibility checks of the heap
+ * blocks by SSD-to-GPU Direct SQL. Zero shall be returned if snapshot is
+ * not available on the device.
+ */
+static cl_uint
+__appendXactSnapshot(StringInfo buf, Snapshot snapshot)
+{
+	cl_uint		poffset = buf->len;
+	kern_snapshot *ksnap;
+	size_t		sz;
+
+	if (!snapshot ||
+		!IsMVCCSnapshot(snapshot) ||
+		snapshot->suboverflowed)
+		return 0;
+	sz = offsetof(kern_snapshot, xip[snapshot->xcnt + snapshot->subxcnt]);
+	enlargeStringInfo(buf, MAXALIGN(sz));
+	ksnap = (kern_snapshot *)(buf->data + buf->len);
+	buf->len += MAXALIGN(sz);
+
+	memset(ksnap, 0, MAXALIGN(sz));
+	SET_VARSIZE(ksnap, sz);
+	ksnap->xmin = snapshot->xmin;
+	ksnap->xmax = snapshot->xmax;
+	ksnap->curcid = snapshot->curcid;
+	ksnap->xcnt = snapshot->xcnt + snapshot->subxcnt;
+	if (snapshot->xcnt > 0)
+		memcpy(ksnap->xip, snapshot->xip,
+			   sizeof(TransactionId) * snapshot->xcnt);
+	if (snapshot->subxcnt > 0)
+		memcpy(ksnap->xip + snapshot->xcnt, snapshot->subxip,
+			   sizeof(TransactionId) * snapshot->subxcnt);
+	return poffset;
+}
+
+/*
+ * __fetchParamValue
+ *
+ * It fetches the current value of the Param node; see ExecEvalParamExec
+ * and ExecEvalParamExtern.
+ */
+static Datum
+__fetchParamValue(Param *param, ExprContext *econtext, bool *p_isnull)
+{
+	ParamListInfo param_info = econtext->ecxt_param_list_info;
+	int		param_id = param->paramid;
+	Datum	param_value = 0;
+	bool	param_isnull = true;
+
+	if (!param_info ||
+		param_id < 1 || param_id > param_info->numParams)
+		elog(ERROR, "no value found for parameter %d", param_id);
+
+	if (param->paramkind == PARAM_EXEC)
+	{
+		/* See ExecEvalParamExec */
+		ParamExecData  *prm
+			= &(econtext->ecxt_param_exec_vals[param_id]);
+		if (prm->execPlan != NULL)
+		{
+			/* Parameter not evaluated yet, so go do it */
+			ExecSetParamPlan(prm->execPlan, econtext);
+			/* ExecSetParamPlan should have processed this param... */
+			Assert(prm->execPlan == NULL);
+		}
+		param_isnull = prm->isnull;
+		param_value  = prm->value;
+	}
+	else if (param->paramkind == PARAM_EXTERN)
+	{
+		/* ExecEvalParamExtern */
+		ParamExternData *prm;
+		ParamExternData  prmData __attribute__((unused));
+
+#if PG_VERSION_NUM < 110000
+		prm = &param_info->params[param_id - 1];
+		if (!OidIsValid(prm->ptype) && param_info->paramFetch != NULL)
+			(*param_info->paramFetch) (param_info, param_id);
+#else
+		if (param_info->paramFetch != NULL)
+			prm = param_info->paramFetch(param_info, param_id,
+										 false, &prmData);
+		else
+			prm = &param_info->params[param_id - 1];
+#endif
+		if (!OidIsValid(prm->ptype))
+			elog(ERROR, "no value found for parameter %d", param_id);
+		else if (prm->ptype != param->paramtype)
+			elog(ERROR,
+				 "type of parameter %d (%s) does not match that "
+				 "when preparing the plan (%s)",
+				 param_id,
+				 format_type_be(prm->ptype),
+				 format_type_be(param->paramtype));
+		param_isnull = prm->isnull;
+		param_value  = prm->value;
+	}
+	else
+	{
+		elog(ERROR, "Bug? unexpected parameter kind: %d",
+			 (int)param->paramkind);
+	}
+	*p_isnull = param_isnull;
+	return param_value;
+}
+
+/*
+ * __appendArrayLookup
+ *
+ * It appends kern_array_lookup; sorted and unique copy of the integer array
+ * for PG_SCALAR_ARRAY_LOOKUP.
+ */
+static int
+__compArrayLookupItem(const void *a, const void *b)
+{
+	cl_long		x = *((const cl_long *)a);
+	cl_long		y = *((const cl_long *)b);
+
+	return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+static void
+__appendArrayLookup(StringInfo buf, ArrayType *array)
+{
+	kern_array_lookup *alookup;
+	Oid			elemtype = ARR_ELEMTYPE(array);
+	int16		typlen;
+	bool		typbyval;
+	char		typalign;
+	Datum	   *elems;
+	bool	   *nulls;
+	int			i, j, nitems;
+	size_t		sz;
+
+	get_typlenbyvalalign(elemtype, &typlen, &typbyval, &typalign);
+	deconstruct_array(array, elemtype, typlen, typbyval, typalign,
+					  &elems, &nulls, &nitems);
+	sz = offsetof(kern_array_lookup, values[nitems]);
+	enlargeStringInfo(buf, MAXALIGN(sz));
+	alookup = (kern_array_lookup *)(buf->data + buf->len);
+	memset(alookup, 0, offsetof(kern_array_lookup, values));
+	for (i=0, j=0; i < nitems; i++)
+	{
+		if (nulls[i])
+		{
+			alookup->has_null = true;
+			continue;
+		}
+		switch (elemtype)
+		{
+			case INT2OID:
+				alookup->values[j++] = DatumGetInt16(elems[i]);
+				break;
+			case INT4OID:
+			case DATEOID:
+				alookup->values[j++] = DatumGetInt32(elems[i]);
+				break;
+			case INT8OID:
+				alookup->values[j++] = DatumGetInt64(elems[i]);
+				break;
+			default:
+				elog(ERROR, "Bug? unexpected array element type: %s",
+					 format_type_be(elemtype));
+		}
+	}
+	qsort(alookup->values, j, sizeof(cl_long), __compArrayLookupItem);
+	for (i=0, nitems=0; i < j; i++)
+	{
+		if (nitems == 0 || alookup->values[nitems-1] != alookup->values[i])
+			alookup->values[nitems++] = alookup->values[i];
+	}
+	alookup->nitems = nitems;
+	buf->len += offsetof(kern_array_lookup, values[nitems]);
+	pfree(elems);
+	pfree(nulls);
+}
+
 /*
  * construct_kern_parambuf
  *
- * It construct a kernel parameter buffer to deliver Const/Param nodes.
+ * It construct a kernel parameter buffer to deliver Const/Param nodes,
+ * and row-invariant expressions hoisted by the code generator.
  */
 kern_parambuf *
 construct_kern_parambuf(List *used_params, ExprContext *econtext,
@@ -91,10 +313,11 @@ construct_kern_parambuf(List *used_params, ExprContext *econtext,
 	int			index = 0;
 	int			nparams = list_length(used_params);
 	cl_uint		xid_vec_offset;
+	cl_uint		xid_snap_offset;
 
 	/* seek to the head of variable length field */
 	offset = MAXALIGN(offsetof(kern_parambuf,
-							   poffset[nparams + 1]));
+							   poffset[nparams + 2]));
 	initStringInfo(&str);
 	enlargeStringInfo(&str, offset);
 	memset(str.data, 0, offset);
@@ -134,66 +357,32 @@ construct_kern_parambuf(List *used_params, ExprContext *econtext,
                                            VARSIZE(con->constvalue));
 			}
 		}
-		else if (IsA(node, Param))
+		else if (IsA(node, Param) ||
+				 IsA(node, FuncExpr) ||
+				 IsA(node, OpExpr) ||
+				 IsA(node, DistinctExpr))
 		{
-			ParamListInfo param_info = econtext->ecxt_param_list_info;
-			Param  *param = (Param *) node;
-			int		param_id = param->paramid;
 			Datum	param_value;
 			bool	param_isnull;
 
-			if (!param_info ||
-				param_id < 1 || param_id > param_info->numParams)
-				elog(ERROR, "no value found for parameter %d", param_id);
-
-			if (param->paramkind == PARAM_EXEC)
-			{
-				/* See ExecEvalParamExec */
-				ParamExecData  *prm
-					= &(econtext->ecxt_param_exec_vals[param_id]);
-				if (prm->execPlan != NULL)
-				{
-					/* Parameter not evaluated yet, so go do it */
-					ExecSetParamPlan(prm->execPlan, econtext);
-					/* ExecSetParamPlan should have processed this param... */
-					Assert(prm->execPlan == NULL);
-				}
-				param_isnull = prm->isnull;
-				param_value  = prm->value;
-			}
-			else if (param->paramkind == PARAM_EXTERN)
-			{
-				/* ExecEvalParamExtern */
-				ParamExternData *prm;
-				ParamExternData  prmData __attribute__((unused));
-
-#if PG_VERSION_NUM < 110000
-				prm = &param_info->params[param_id - 1];
-				if (!OidIsValid(prm->ptype) && param_info->paramFetch != NULL)
-					(*param_info->paramFetch) (param_info, param_id);
-#else
-				if (param_info->paramFetch != NULL)
-					prm = param_info->paramFetch(param_info, param_id,
-												 false, &prmData);
-				else
-					prm = &param_info->params[param_id - 1];
-#endif
-				if (!OidIsValid(prm->ptype))
-					elog(ERROR, "no value found for parameter %d", param_id);
-				else if (prm->ptype != param->paramtype)
-					elog(ERROR,
-						 "type of parameter %d (%s) does not match that "
-						 "when preparing the plan (%s)",
-						 param_id,
-						 format_type_be(prm->ptype),
-						 format_type_be(param->paramtype));
-				param_isnull = prm->isnull;
-				param_value  = prm->value;
-			}
+			if (IsA(node, Param))
+				param_value = __fetchParamValue((Param *) node, econtext,
+												&param_isnull);
 			else
 			{
-				elog(ERROR, "Bug? unexpected parameter kind: %d",
-					 (int)param->paramkind);
+				/*
+				 * Row-invariant expression hoisted by the code generator;
+				 * it is evaluated only once per scan, here.
+				 */
+				ExprState  *expr_state;
+
+				if (!econtext->ecxt_estate)
+					elog(ERROR, "no EState to evaluate expression: %s",
+						 nodeToString(node));
+				expr_state = ExecPrepareExpr((Expr *) node,
+											 econtext->ecxt_estate);
+				param_value = ExecEvalExpr(expr_state, econtext,
+										   &param_isnull);
 			}
 			kparams = (kern_parambuf *)str.data;
 			if (param_isnull)
@@ -203,7 +392,8 @@ construct_kern_parambuf(List *used_params, ExprContext *econtext,
 				int16	typlen;
 				bool	typbyval;
 
-				get_typlenbyval(param->paramtype, &typlen, &typbyval);
+				kparams->poffset[index] = str.len;
+				get_typlenbyval(exprType(node), &typlen, &typbyval);
 				if (typbyval)
 				{
 					appendBinaryStringInfo(&str,
@@ -228,6 +418,43 @@ construct_kern_parambuf(List *used_params, ExprContext *econtext,
 				}
 			}
 		}
+		else if (IsA(node, ScalarArrayOpExpr))
+		{
+			/* sorted array for PG_SCALAR_ARRAY_LOOKUP */
+			ScalarArrayOpExpr *opexpr = (ScalarArrayOpExpr *) node;
+			Node   *node_a = lsecond(opexpr->args);
+			Datum	array_value;
+			bool	array_isnull;
+
+			if (IsA(node_a, Var) &&
+				((Var *)node_a)->varno == INDEX_VAR &&
+				((Var *)node_a)->varattno <= list_length(custom_scan_tlist))
+			{
+				TargetEntry *tle = list_nth(custom_scan_tlist,
+											((Var *)node_a)->varattno - 1);
+				node_a = (Node *)tle->expr;
+			}
+
+			if (IsA(node_a, Const))
+			{
+				array_value = ((Const *) node_a)->constvalue;
+				array_isnull = ((Const *) node_a)->constisnull;
+			}
+			else if (IsA(node_a, Param))
+				array_value = __fetchParamValue((Param *) node_a, econtext,
+												&array_isnull);
+			else
+				elog(ERROR, "unexpected array node: %s", nodeToString(node_a));
+
+			kparams = (kern_parambuf *)str.data;
+			if (array_isnull)
+				kparams->poffset[index] = 0;	/* null */
+			else
+			{
+				kparams->poffset[index] = str.len;
+				__appendArrayLookup(&str, DatumGetArrayTypeP(array_value));
+			}
+		}
 		else if (!nested_custom_scan_tlist &&
 				 IsA(node, Var) &&
 				 custom_scan_tlist != NIL &&
@@ -258,13 +485,18 @@ construct_kern_parambuf(List *used_params, ExprContext *econtext,
 		index++;
 	}
 	xid_vec_offset = __appendXactIdVector(&str);
+	xid_snap_offset = __appendXactSnapshot(&str, econtext->ecxt_estate
+										   ? econtext->ecxt_estate->es_snapshot
+										   : NULL);
 
-	/* array of current transaction id */
+	/* array of current transaction id, and snapshot */
 	Assert(MAXALIGN(str.len) == str.len);
 	kparams = (kern_parambuf *)str.data;
 	kparams->xactStartTimestamp = GetCurrentTransactionStartTimestamp();
 	kparams->xactIdVector = nparams;
 	kparams->poffset[nparams++] = xid_vec_offset;
+	kparams->xactSnapshot = nparams;
+	kparams->poffset[nparams++] = xid_snap_offset;
 	kparams->length = str.len;
 	kparams->nparams = nparams;
 
@@ -279,6 +511,7 @@ pgstromInitGpuTaskState(GpuTaskState *gts,
 						GpuContext *gcontext,
 						GpuTaskKind task_kind,
 						List *outer_refs_list,
+						List *outer_quals,
 						List *used_params,
 						cl_int optimal_gpu,
 						cl_uint outer_nrows_per_block,
@@ -325,7 +558,9 @@ pgstromInitGpuTaskState(GpuTaskState *gts,
 		}
 		if (RelationIsArrowFdw(relation))
 			gts->af_state = ExecInitArrowFdw(optimal_gpu < 0 ? NULL : gcontext,
-											 relation, outer_refs);
+											 relation,
+											 outer_quals,
+											 outer_refs);
 		if (RelationIsGstoreFdw(relation))
 			gts->gs_state = ExecInitGstoreFdw(&gts->css.ss, eflags, outer_refs);
 	}
@@ -345,9 +580,262 @@ pgstromInitGpuTaskState(GpuTaskState *gts,
 
 	/* callbacks shall be set by the caller */
 	dlist_init(&gts->ready_tasks);
+	dlist_init(&gts->parked_tasks);
 	gts->num_ready_tasks = 0;
+	/* adaptive chunk size starts from pg_strom.chunk_size */
+	gts->chunk_size = pgstrom_chunk_size();
+	gts->num_gpu_exec = 0;
+	gts->num_result_overflow = 0;
+	gts->chunk_stat_nexec = 0;
+	gts->chunk_stat_noverflow = 0;
+	gts->chunk_stat_time = 0;
 	/* co-operation with CPU parallel (setup by DSM init handler) */
 	gts->pcxt = NULL;
+
+	/* label of the tracer / profiler */
+	snprintf(gts->trace_label, sizeof(gts->trace_label), "%s#%d",
+			 gts->css.methods->CustomName,
+			 gts->css.ss.ps.plan->plan_node_id);
+	gts->trace_category = gts->css.ss.ps.plan->plan_node_id + 1;
+#ifdef WITH_NVTX
+	nvtxNameCategoryA(gts->trace_category, gts->trace_label);
+#endif
+	gts->trace_events = NULL;
+	gts->trace_nitems = 0;
+	gts->trace_ndropped = 0;
+	/* sampling for pgstrom.gpu_query_stats */
+	gts->stats_sampled = false;
+	gts->num_loaded_chunks = 0;
+	gts->bytes_loaded = 0;
+	if (gpuQuerySampleRing &&
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0 &&
+		(pgstrom_gpu_query_stats_sample_rate >= 1.0 ||
+		 random() < (pgstrom_gpu_query_stats_sample_rate *
+					 (double)MAX_RANDOM_VALUE)))
+		gts->stats_sampled = true;
+	if (pgstrom_gpu_trace_dir && *pgstrom_gpu_trace_dir != '\0' &&
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0)
+		gts->trace_events = palloc(sizeof(GpuTaskTraceEvent) *
+								   GPUTASK_TRACE_MAX_EVENTS);
+}
+
+/*
+ * pgstromTraceGpuTask
+ *
+ * It records lifecycle of the GpuTask, by the worker thread. Caller must
+ * hold the worker_mutex.
+ */
+void
+pgstromTraceGpuTask(GpuTaskState *gts, GpuTask *gtask,
+					instr_time *tv_start,
+					instr_time *tv_jit,
+					instr_time *tv_end,
+					bool jit_fallback)
+{
+	GpuTaskTraceEvent *tev;
+
+	if (gts->trace_nitems >= GPUTASK_TRACE_MAX_EVENTS)
+	{
+		gts->trace_ndropped++;
+		return;
+	}
+	tev = &gts->trace_events[gts->trace_nitems++];
+	tev->tv_load      = gtask->tv_load;
+	tev->tv_enqueue   = gtask->tv_enqueue;
+	tev->tv_start     = *tv_start;
+	tev->tv_jit       = *tv_jit;
+	tev->tv_end       = *tv_end;
+	tev->worker_index = GpuWorkerIndex;
+	tev->jit_fallback = jit_fallback;
+}
+
+/*
+ * pgstromWriteGpuTaskTrace
+ *
+ * It writes out the recorded GpuTask's lifecycle in the Chrome trace event
+ * format; chrome://tracing or Perfetto can visualize the overlap of chunk
+ * load by the backend and GPU execution by the worker threads.
+ */
+static void
+pgstromWriteGpuTaskTrace(GpuTaskState *gts)
+{
+	EState	   *estate = gts->css.ss.ps.state;
+	uint64		query_id = estate->es_plannedstmt->queryId;
+	char		path[MAXPGPATH];
+	FILE	   *filp;
+	cl_uint		i;
+
+	snprintf(path, sizeof(path), "%s/pgstrom_%d_" UINT64_FORMAT "_%d.json",
+			 pgstrom_gpu_trace_dir, MyProcPid, query_id,
+			 gts->css.ss.ps.plan->plan_node_id);
+	filp = AllocateFile(path, PG_BINARY_W);
+	if (!filp)
+	{
+		elog(WARNING, "failed on open('%s'): %m", path);
+		return;
+	}
+	fprintf(filp,
+			"{\"otherData\": {\"label\": \"%s\", \"query_id\": " UINT64_FORMAT
+			", \"dropped\": %u},\n"
+			" \"traceEvents\": [\n"
+			"  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d,"
+			" \"tid\": 0, \"args\": {\"name\": \"backend\"}}",
+			gts->trace_label, query_id, gts->trace_ndropped, MyProcPid);
+	for (i=0; i < gts->trace_nitems; i++)
+	{
+		GpuTaskTraceEvent *tev = &gts->trace_events[i];
+		instr_time	tv_diff;
+		int			tid = tev->worker_index + 1;
+
+		/* chunk load by the backend */
+		tv_diff = tev->tv_enqueue;
+		INSTR_TIME_SUBTRACT(tv_diff, tev->tv_load);
+		fprintf(filp,
+				",\n  {\"name\": \"load\", \"cat\": \"%s\", \"ph\": \"X\","
+				" \"ts\": " UINT64_FORMAT ", \"dur\": " UINT64_FORMAT ","
+				" \"pid\": %d, \"tid\": 0, \"args\": {\"task\": %u}}",
+				gts->trace_label,
+				INSTR_TIME_GET_MICROSEC(tev->tv_load),
+				INSTR_TIME_GET_MICROSEC(tv_diff),
+				MyProcPid, i);
+		/* JIT wait, or CPU fallback instead of the wait */
+		tv_diff = tev->tv_jit;
+		INSTR_TIME_SUBTRACT(tv_diff, tev->tv_start);
+		fprintf(filp,
+				",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\","
+				" \"ts\": " UINT64_FORMAT ", \"dur\": " UINT64_FORMAT ","
+				" \"pid\": %d, \"tid\": %d, \"args\": {\"task\": %u,",
+				tev->jit_fallback ? "jit fallback" : "jit wait",
+				gts->trace_label,
+				INSTR_TIME_GET_MICROSEC(tev->tv_start),
+				INSTR_TIME_GET_MICROSEC(tv_diff),
+				MyProcPid, tid, i);
+		tv_diff = tev->tv_start;
+		INSTR_TIME_SUBTRACT(tv_diff, tev->tv_enqueue);
+		fprintf(filp, " \"queue_wait\": " UINT64_FORMAT "}}",
+				INSTR_TIME_GET_MICROSEC(tv_diff));
+		/* GPU execution by the worker thread */
+		if (!tev->jit_fallback)
+		{
+			tv_diff = tev->tv_end;
+			INSTR_TIME_SUBTRACT(tv_diff, tev->tv_jit);
+			fprintf(filp,
+					",\n  {\"name\": \"exec\", \"cat\": \"%s\", \"ph\": \"X\","
+					" \"ts\": " UINT64_FORMAT ", \"dur\": " UINT64_FORMAT ","
+					" \"pid\": %d, \"tid\": %d, \"args\": {\"task\": %u}}",
+					gts->trace_label,
+					INSTR_TIME_GET_MICROSEC(tev->tv_jit),
+					INSTR_TIME_GET_MICROSEC(tv_diff),
+					MyProcPid, tid, i);
+		}
+	}
+	fprintf(filp, "\n ]\n}\n");
+	if (ferror(filp))
+		elog(WARNING, "failed on write('%s'): %m", path);
+	FreeFile(filp);
+}
+
+/*
+ * gputask_scan_is_tail
+ *
+ * It checks whether the parallel block-based scan is close to the end,
+ * that is, the remaining blocks are less than what the participants would
+ * read ahead. At this point, we should not hold multiple chunks in-flight
+ * by a particular process, because the sibling processes which already
+ * completed their tasks cannot take them over; leaving the blocks to be
+ * picked up by idle processes evens out the tail latency.
+ */
+static bool
+gputask_scan_is_tail(GpuTaskState *gts)
+{
+	GpuTaskSharedState *gtss = gts->gtss;
+	uint64		nr_loaded;
+	uint64		nr_participants;
+	uint64		nr_allocated;
+	uint64		nr_remains;
+
+	if (!gtss || gts->af_state || gts->gs_state ||
+		!gts->css.ss.ss_currentRelation)
+		return false;
+	nr_loaded = pg_atomic_read_u32(&gtss->nr_loaded_chunks);
+	nr_participants = pg_atomic_read_u32(&gtss->nr_participants);
+	if (nr_loaded == 0 || nr_participants <= 1)
+		return false;
+
+	SpinLockAcquire(&gtss->pbs_mutex);
+	nr_allocated = gtss->pbs_nallocated;
+	SpinLockRelease(&gtss->pbs_mutex);
+	if (nr_allocated >= gtss->pbs_nblocks)
+		return true;
+	nr_remains = gtss->pbs_nblocks - nr_allocated;
+
+	/* nr_remains < nr_participants * readahead * (blocks per chunk) */
+	return (nr_remains * nr_loaded <
+			nr_participants * pgstrom_scan_readahead_chunks * nr_allocated);
+}
+
+/*
+ * pgstromGpuTaskChunkSize - current chunk size of the scan
+ */
+Size
+pgstromGpuTaskChunkSize(GpuTaskState *gts)
+{
+	if (pgstrom_chunk_target_latency <= 0 || gts->chunk_size == 0)
+		return pgstrom_chunk_size();
+	return gts->chunk_size;
+}
+
+/*
+ * gputask_update_chunk_size
+ *
+ * It adjusts the chunk size of the scan, towards the per-task latency of
+ * pg_strom.chunk_target_latency, according to the elapsed time of the GPU
+ * tasks completed since the last adjustment. The elapsed time includes
+ * DMA send, kernel execution and write-back, and a task suspended by the
+ * result buffer overflow also accounts the resumed kernel. If results
+ * overflowed on more than 25% of the tasks (that also means CPU fallback
+ * becomes expensive), we shrink the chunk more aggressive.
+ * The chunk size ranges from 1/16 of pg_strom.chunk_size to itself, because
+ * the buffers of gpu_mmgr.c are sized by pg_strom.chunk_size.
+ *
+ * Caller must hold gcontext->worker_mutex.
+ */
+#define GPUTASK_CHUNK_SIZE_INTERVAL		4
+
+static void
+gputask_update_chunk_size(GpuTaskState *gts)
+{
+	Size		chunk_max = pgstrom_chunk_size();
+	Size		chunk_min = TYPEALIGN(BLCKSZ, chunk_max / 16);
+	uint64		nexec = gts->num_gpu_exec - gts->chunk_stat_nexec;
+	uint64		noverflow;
+	uint64		exec_time;
+	double		latency;
+	double		ratio;
+	double		chunk_sz;
+
+	if (pgstrom_chunk_target_latency <= 0 ||
+		nexec < GPUTASK_CHUNK_SIZE_INTERVAL)
+		return;
+	noverflow = gts->num_result_overflow - gts->chunk_stat_noverflow;
+	exec_time = gts->time_gpu_exec - gts->chunk_stat_time;
+
+	latency = Max((double)exec_time / (double)nexec, 1.0);	/* usec */
+	ratio = (double)pgstrom_chunk_target_latency * 1000.0 / latency;
+	ratio = Min(Max(ratio, 0.5), 2.0);
+	if (noverflow * 4 > nexec)
+		ratio = Min(ratio, 0.5);
+	chunk_sz = (double)gts->chunk_size * ratio;
+	if (chunk_sz >= (double)chunk_max)
+		gts->chunk_size = chunk_max;
+	else if (chunk_sz <= (double)chunk_min)
+		gts->chunk_size = chunk_min;
+	else
+		gts->chunk_size = TYPEALIGN(BLCKSZ, (Size)chunk_sz);
+
+	gts->chunk_stat_nexec = gts->num_gpu_exec;
+	gts->chunk_stat_noverflow = gts->num_result_overflow;
+	gts->chunk_stat_time = gts->time_gpu_exec;
 }
 
 /*
@@ -361,28 +849,62 @@ fetch_next_gputask(GpuTaskState *gts)
 	dlist_node	   *dnode;
 	cl_int			num_async_tasks;
 	cl_int			ev;
+	instr_time		tv_start;
+	instr_time		tv_end;
 
 	/* force activate GpuContext on demand */
 	Assert(gcontext->worker_is_running);
 	CHECK_FOR_GPUCONTEXT(gcontext);
 
 	pthreadMutexLock(&gcontext->worker_mutex);
+	/* resume the tasks parked by pgstromSuspendGpuTaskState, if any */
+	while (!dlist_is_empty(&gts->parked_tasks))
+	{
+		dnode = dlist_pop_head_node(&gts->parked_tasks);
+		dlist_push_tail(&gcontext->pending_tasks, dnode);
+		gts->num_running_tasks++;
+		pthreadCondSignal(&gcontext->worker_cond);
+	}
 	while (!gts->scan_done)
 	{
 		ResetLatch(MyLatch);
 		num_async_tasks = (gts->num_ready_tasks +
 						   gts->num_running_tasks);
+		/*
+		 * NOTE: We load the next chunks ahead while GPU kernels are running
+		 * on the previous ones, as long as number of in-flight tasks is less
+		 * than pg_strom.scan_readahead_chunks. It keeps both of storage and
+		 * GPU devices busy, but total number of asynchronous tasks is still
+		 * bounded by pg_strom.max_async_tasks.
+		 * Once the parallel scan reached to its tail, we load the next chunk
+		 * only when we have no in-flight tasks, to leave the remaining blocks
+		 * for the sibling processes.
+		 */
 		if (num_async_tasks < pgstrom_max_async_tasks &&
-			(dlist_is_empty(&gts->ready_tasks) || gts->num_running_tasks == 0))
+			(dlist_is_empty(&gts->ready_tasks) ||
+			 gts->num_running_tasks < pgstrom_scan_readahead_chunks) &&
+			(num_async_tasks == 0 || !gputask_scan_is_tail(gts)))
 		{
+			gputask_update_chunk_size(gts);
 			pthreadMutexUnlock(&gcontext->worker_mutex);
+			INSTR_TIME_SET_CURRENT(tv_start);
+			pgstromNvtxRangePush(gts, "load chunk");
 			gtask = gts->cb_next_task(gts);
+			pgstromNvtxRangePop();
+			INSTR_TIME_SET_CURRENT(tv_end);
 			pthreadMutexLock(&gcontext->worker_mutex);
+			INSTR_TIME_SUBTRACT(tv_end, tv_start);
+			gts->time_chunk_load += INSTR_TIME_GET_MICROSEC(tv_end);
 			if (!gtask)
 			{
 				gts->scan_done = true;
 				break;
 			}
+			gts->num_loaded_chunks++;
+			if (gts->gtss)
+				pg_atomic_fetch_add_u32(&gts->gtss->nr_loaded_chunks, 1);
+			gtask->tv_load = tv_start;
+			INSTR_TIME_SET_CURRENT(gtask->tv_enqueue);
 			dlist_push_tail(&gcontext->pending_tasks, &gtask->chain);
 			gts->num_running_tasks++;
 			pthreadCondSignal(&gcontext->worker_cond);
@@ -465,6 +987,8 @@ retry:
 					}
 					else
 					{
+						INSTR_TIME_SET_CURRENT(gtask->tv_enqueue);
+						gtask->tv_load = gtask->tv_enqueue;
 						dlist_push_tail(&gcontext->pending_tasks,
 										&gtask->chain);
 						gts->num_running_tasks++;
@@ -513,10 +1037,31 @@ pgstromExecGpuTaskState(GpuTaskState *gts)
 {
 	TupleTableSlot *slot = NULL;
 
-	while (!gts->curr_task || !(slot = gts->cb_next_tuple(gts)))
+	for (;;)
 	{
 		GpuTask	   *gtask = gts->curr_task;
 
+		if (gtask)
+		{
+			if (!gtask->cpu_fallback)
+				slot = gts->cb_next_tuple(gts);
+			else
+			{
+				instr_time	tv_start;
+				instr_time	tv_end;
+
+				INSTR_TIME_SET_CURRENT(tv_start);
+				pgstromNvtxRangePush(gts, "cpu fallback");
+				slot = gts->cb_next_tuple(gts);
+				pgstromNvtxRangePop();
+				INSTR_TIME_SET_CURRENT(tv_end);
+				INSTR_TIME_SUBTRACT(tv_end, tv_start);
+				gts->time_cpu_fallback += INSTR_TIME_GET_MICROSEC(tv_end);
+			}
+			if (slot)
+				break;
+		}
+
 		/* release the current GpuTask object that was already scanned */
 		if (gtask)
 		{
@@ -526,7 +1071,9 @@ pgstromExecGpuTaskState(GpuTaskState *gts)
 			gts->curr_lp_index = 0;
 		}
 		/* reload next chunk to be scanned */
+		pgstromNvtxRangePush(gts, "fetch task");
 		gtask = fetch_next_gputask(gts);
+		pgstromNvtxRangePop();
 		if (!gtask)
 			return NULL;
 		if (gtask->cpu_fallback)
@@ -541,6 +1088,122 @@ pgstromExecGpuTaskState(GpuTaskState *gts)
 	return slot;
 }
 
+/*
+ * pgstromSuspendGpuTaskState
+ *
+ * It is called once the upper node needs no more tuples for a while (e.g,
+ * LIMIT is satisfied). The tasks not launched yet are detached from the
+ * pending queue of GpuContext, so GPU device and NVMe-SSD are not occupied
+ * by the tasks nobody consumes. These tasks are not released, because the
+ * executor may fetch rows again (e.g, the next FETCH on a cursor); then,
+ * fetch_next_gputask() puts them back to the pending queue.
+ * The tasks already running on the GPU device are completed as usual.
+ */
+void
+pgstromSuspendGpuTaskState(GpuTaskState *gts)
+{
+	GpuContext	   *gcontext = gts->gcontext;
+	dlist_mutable_iter iter;
+
+	if (!gcontext || !gcontext->worker_is_running)
+		return;
+	pthreadMutexLock(&gcontext->worker_mutex);
+	dlist_foreach_modify(iter, &gcontext->pending_tasks)
+	{
+		GpuTask	   *gtask = dlist_container(GpuTask, chain, iter.cur);
+
+		if (gtask->gts != gts)
+			continue;
+		dlist_delete(&gtask->chain);
+		dlist_push_tail(&gts->parked_tasks, &gtask->chain);
+		Assert(gts->num_running_tasks > 0);
+		gts->num_running_tasks--;
+	}
+	pthreadMutexUnlock(&gcontext->worker_mutex);
+}
+
+/*
+ * pgstromCleanupGpuTasks
+ *
+ * It releases all the tasks of GpuTaskState; tasks parked or already
+ * processed are released immediately, and tasks still in the pending
+ * queue shall never be launched. Then, it waits for completion of the
+ * tasks being executed by the worker threads, to release them also.
+ */
+static void
+pgstromCleanupGpuTasks(GpuTaskState *gts)
+{
+	GpuContext	   *gcontext = gts->gcontext;
+	dlist_mutable_iter iter;
+	dlist_head		dead_tasks;
+	dlist_node	   *dnode;
+	GpuTask		   *gtask;
+	cl_uint			num_running_tasks;
+	int				ev;
+
+	dlist_init(&dead_tasks);
+	pthreadMutexLock(&gcontext->worker_mutex);
+	gts->cancel_tasks = true;
+	dlist_foreach_modify(iter, &gcontext->pending_tasks)
+	{
+		gtask = dlist_container(GpuTask, chain, iter.cur);
+		if (gtask->gts != gts)
+			continue;
+		dlist_delete(&gtask->chain);
+		dlist_push_tail(&dead_tasks, &gtask->chain);
+		Assert(gts->num_running_tasks > 0);
+		gts->num_running_tasks--;
+	}
+	for (;;)
+	{
+		while (!dlist_is_empty(&gts->parked_tasks))
+		{
+			dnode = dlist_pop_head_node(&gts->parked_tasks);
+			dlist_push_tail(&dead_tasks, dnode);
+		}
+		while (!dlist_is_empty(&gts->ready_tasks))
+		{
+			dnode = dlist_pop_head_node(&gts->ready_tasks);
+			dlist_push_tail(&dead_tasks, dnode);
+			Assert(gts->num_ready_tasks > 0);
+			gts->num_ready_tasks--;
+		}
+		/*
+		 * NOTE: worker thread backs the cancelled task to the ready_tasks
+		 * prior to decrement of num_running_tasks, so no tasks are left
+		 * once we see num_running_tasks == 0 here.
+		 */
+		num_running_tasks = gts->num_running_tasks;
+		pthreadMutexUnlock(&gcontext->worker_mutex);
+
+		while (!dlist_is_empty(&dead_tasks))
+		{
+			dnode = dlist_pop_head_node(&dead_tasks);
+			gtask = dlist_container(GpuTask, chain, dnode);
+			gts->cb_release_task(gtask);
+		}
+		if (num_running_tasks == 0 || !gcontext->worker_is_running)
+		{
+			gts->cancel_tasks = false;
+			break;
+		}
+		/* wait for completion of the running tasks */
+		CHECK_FOR_GPUCONTEXT(gcontext);
+		ev = WaitLatch(MyLatch,
+					   WL_LATCH_SET |
+					   WL_TIMEOUT |
+					   WL_POSTMASTER_DEATH,
+					   500L,
+					   PG_WAIT_EXTENSION);
+		if (ev & WL_POSTMASTER_DEATH)
+			ereport(FATAL,
+					(errcode(ERRCODE_ADMIN_SHUTDOWN),
+					 errmsg("Unexpected Postmaster dead")));
+		ResetLatch(MyLatch);
+		pthreadMutexLock(&gcontext->worker_mutex);
+	}
+}
+
 /*
  * pgstromRescanGpuTaskState
  */
@@ -550,14 +1213,7 @@ pgstromRescanGpuTaskState(GpuTaskState *gts)
 	/*
 	 * release all the unprocessed tasks
 	 */
-	while (!dlist_is_empty(&gts->ready_tasks))
-	{
-		dlist_node *dnode = dlist_pop_head_node(&gts->ready_tasks);
-		GpuTask	   *gtask = dlist_container(GpuTask, chain, dnode);
-		gts->num_ready_tasks--;
-		Assert(gts->num_ready_tasks >= 0);
-		gts->cb_release_task(gtask);
-	}
+	pgstromCleanupGpuTasks(gts);
 
 	/* rewind the scan position if GTS scans a table */
 	pgstromRewindScanChunk(gts);
@@ -569,6 +1225,58 @@ pgstromRescanGpuTaskState(GpuTaskState *gts)
 		ExecReScanGstoreFdw(gts->gs_state);
 }
 
+/*
+ * pgstromRecordGpuQuerySample
+ *
+ * It writes out runtime statistics of the GpuTaskState to the sample ring.
+ * Caller must ensure the statistics are not merged with the ones of the
+ * parallel workers yet, because workers record their own samples.
+ */
+void
+pgstromRecordGpuQuerySample(GpuTaskState *gts)
+{
+	EState		   *estate = gts->css.ss.ps.state;
+	GpuQuerySample *qsample;
+	uint64			queryid = 0;
+	uint64			seqno;
+
+	if (!gts->stats_sampled)
+		return;
+	gts->stats_sampled = false;
+	if (!gpuQuerySampleRing || gpuQuerySampleRing->nitems == 0)
+		return;
+	if (estate->es_plannedstmt)
+		queryid = estate->es_plannedstmt->queryId;
+	if (queryid == 0 && estate->es_sourceText)
+		queryid = hash_any((const unsigned char *)estate->es_sourceText,
+						   strlen(estate->es_sourceText));
+
+	seqno = pg_atomic_fetch_add_u64(&gpuQuerySampleRing->next_seqno, 1);
+	qsample = &gpuQuerySampleRing->samples[seqno %
+										   gpuQuerySampleRing->nitems];
+	pg_atomic_write_u64(&qsample->seqno, 0);
+	pg_write_barrier();
+
+	qsample->dbid = MyDatabaseId;
+	qsample->userid = GetUserId();
+	qsample->queryid = queryid;
+	qsample->sampled_at = GetCurrentTimestamp();
+	strncpy(qsample->node_name, gts->css.methods->CustomName, NAMEDATALEN);
+	qsample->node_name[NAMEDATALEN-1] = '\0';
+	qsample->is_worker = IsParallelWorker();
+	qsample->num_chunks = gts->num_loaded_chunks;
+	qsample->bytes_loaded = gts->bytes_loaded;
+	qsample->num_fallbacks = gts->num_cpu_fallbacks;
+	qsample->time_chunk_load = gts->time_chunk_load;
+	qsample->time_jit_wait = gts->time_jit_wait;
+	qsample->time_gpu_exec = gts->time_gpu_exec;
+	qsample->time_fallback = (gts->time_cpu_fallback +
+							  gts->time_jit_fallback);
+
+	pg_write_barrier();
+	pg_atomic_write_u64(&qsample->seqno, seqno + 1);
+}
+
 /*
  * pgstromReleaseGpuTaskState
  */
@@ -576,18 +1284,13 @@ void
 pgstromReleaseGpuTaskState(GpuTaskState *gts, GpuTaskRuntimeStat *gt_rtstat)
 {
 	/*
-	 * release any unprocessed tasks
+	 * release any unprocessed tasks; the tasks not launched yet are
+	 * cancelled (e.g, cursor is closed prior to the end of the scan)
 	 */
-	while (!dlist_is_empty(&gts->ready_tasks))
-	{
-		dlist_node *dnode = dlist_pop_head_node(&gts->ready_tasks);
-		GpuTask	   *gtask = dlist_container(GpuTask, chain, dnode);
-		gts->num_ready_tasks--;
-		Assert(gts->num_ready_tasks >= 0);
-		gts->cb_release_task(gtask);
-	}
+	pgstromCleanupGpuTasks(gts);
 	/* cleanup per-query PDS-scan state, if any */
 	PDS_end_heapscan_state(gts);
+	pgstrom_ccache_end_scan(gts);
 	InstrEndLoop(&gts->outer_instrument);
 	/* release scan-desc if any */
 	if (gts->css.ss.ss_currentScanDesc)
@@ -600,6 +1303,19 @@ pgstromReleaseGpuTaskState(GpuTaskState *gts, GpuTaskRuntimeStat *gt_rtstat)
 	/* unreference CUDA program */
 	if (gts->program_id != INVALID_PROGRAM_ID)
 		pgstrom_put_cuda_program(gts->gcontext, gts->program_id);
+	/* release device memory budget, if admitted */
+	gpuMemReleaseBudget(gts->gcontext, gts->gm_budget_sz);
+	gts->gm_budget_sz = 0;
+	/* record runtime statistics, if sampled and not recorded yet */
+	pgstromRecordGpuQuerySample(gts);
+	/* write out the trace file, if any */
+	if (gts->trace_events)
+	{
+		if (gts->trace_nitems > 0)
+			pgstromWriteGpuTaskTrace(gts);
+		pfree(gts->trace_events);
+		gts->trace_events = NULL;
+	}
 	/* unreference GpuContext */
 	PutGpuContext(gts->gcontext);
 }
@@ -657,15 +1373,64 @@ pgstromExplainGpuTaskState(GpuTaskState *gts, ExplainState *es)
 	else if (es->format != EXPLAIN_FORMAT_TEXT)
 		ExplainPropertyText("NVMe-Strom", "disabled", es);
 
+	/* Columnar cache support */
+	if (rel && !gts->af_state && !gts->gs_state)
+	{
+		if (!es->analyze)
+		{
+			if (pgstrom_ccache_scan_is_available(gts))
+				ExplainPropertyText("CCache", "enabled", es);
+		}
+		else if (gts->ccache_sstate || gts->ccache_count > 0)
+			ExplainPropertyInteger("CCache Hits",
+								   NULL, gts->ccache_count, es);
+	}
+
 	/* Number of CPU fallbacks, if any */
 	if (es->analyze && gts->num_cpu_fallbacks > 0)
 		ExplainPropertyInteger("CPU fallbacks",
 							   NULL, gts->num_cpu_fallbacks, es);
+	/* Chunk size at the end of the scan, if adaptive */
+	if (es->analyze && pgstrom_chunk_target_latency > 0 &&
+		gts->chunk_size > 0 && !pgstrom_regression_test_mode)
+		ExplainPropertyInteger("Chunk Size", "kB",
+							   gts->chunk_size >> 10, es);
 	/* Properties of Arrow_Fdw/Gstore_Fdw if any */
 	if (gts->af_state)
 		ExplainArrowFdw(gts->af_state, rel, es);
 	if (gts->gs_state)
 		ExplainGstoreFdw(gts->gs_state, rel, es);
+	/* Per-stage elapsed time, if any */
+	if (es->analyze && !pgstrom_regression_test_mode)
+	{
+		double		time_fallback = (double)(gts->time_cpu_fallback +
+											 gts->time_jit_fallback);
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			snprintf(temp, sizeof(temp),
+					 "load=%.3fms, queue=%.3fms, jit=%.3fms, "
+					 "exec=%.3fms, fallback=%.3fms",
+					 (double)gts->time_chunk_load / 1000.0,
+					 (double)gts->time_queue_wait / 1000.0,
+					 (double)gts->time_jit_wait / 1000.0,
+					 (double)gts->time_gpu_exec / 1000.0,
+					 time_fallback / 1000.0);
+			ExplainPropertyText("GPU Timing", temp, es);
+		}
+		else
+		{
+			ExplainPropertyFloat("Chunk Load Time", "ms",
+								 (double)gts->time_chunk_load / 1000.0, 3, es);
+			ExplainPropertyFloat("Queue Wait Time", "ms",
+								 (double)gts->time_queue_wait / 1000.0, 3, es);
+			ExplainPropertyFloat("JIT Wait Time", "ms",
+								 (double)gts->time_jit_wait / 1000.0, 3, es);
+			ExplainPropertyFloat("GPU Exec Time", "ms",
+								 (double)gts->time_gpu_exec / 1000.0, 3, es);
+			ExplainPropertyFloat("CPU Fallback Time", "ms",
+								 time_fallback / 1000.0, 3, es);
+		}
+	}
 	/* Debug counter, if any */
 	if (es->analyze && (gts->debug_counter0 != 0 ||
 						gts->debug_counter1 != 0 ||
@@ -733,6 +1498,8 @@ pgstromInitDSMGpuTaskState(GpuTaskState *gts,
 	Snapshot	snapshot = estate->es_snapshot;
 	GpuTaskSharedState *gtss = coordinate;
 
+	pg_atomic_init_u32(&gtss->nr_participants, 0);
+	pg_atomic_init_u32(&gtss->nr_loaded_chunks, 0);
 	if (gts->af_state)
 	{
 		ExecInitDSMArrowFdw(gts->af_state, &gtss->af_rbatch_index);
@@ -779,8 +1546,11 @@ pgstromInitWorkerGpuTaskState(GpuTaskState *gts, void *coordinate)
 		/* begin parallel scan */
 		gts->css.ss.ss_currentScanDesc =
 			table_beginscan_parallel(relation, &gtss->phscan);
+		pg_atomic_fetch_add_u32(&gtss->nr_participants, 1);
 		/* try to choose NVMe-Strom, if available */
 		PDS_init_heapscan_state(gts);
+		/* try to load columnar cache, if available */
+		pgstrom_ccache_begin_scan(gts);
 	}
 	gts->gtss = gtss;
 }
@@ -799,6 +1569,9 @@ pgstromReInitializeDSMGpuTaskState(GpuTaskState *gts)
 	gtss->pbs_startblock = InvalidBlockNumber;
 	gtss->pbs_nallocated = 0;
 	SpinLockRelease(&gtss->pbs_mutex);
+	/* workers shall join again, but the leader is still here */
+	pg_atomic_write_u32(&gtss->nr_participants, 1);
+	pg_atomic_write_u32(&gtss->nr_loaded_chunks, 0);
 
 	if (gts->af_state)
 		ExecReInitDSMArrowFdw(gts->af_state);
@@ -820,11 +1593,218 @@ pgstromInitGpuTask(GpuTaskState *gts, GpuTask *gtask)
 	gtask->cpu_fallback = false;
 }
 
+/*
+ * pgstrom_gpu_query_samples - runtime statistics sampled per GpuTaskState
+ */
+Datum pgstrom_gpu_query_samples(PG_FUNCTION_ARGS);
+
+Datum
+pgstrom_gpu_query_samples(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	GpuQuerySample *qsample;
+	List		   *samples_list;
+	HeapTuple		tuple;
+	bool			isnull[13];
+	Datum			values[13];
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc		tupdesc;
+		MemoryContext	oldcxt;
+		uint32			i;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+
+		tupdesc = CreateTemplateTupleDesc(13);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  1, "dbid",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  2, "userid",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  3, "queryid",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  4, "node_name",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  5, "is_worker",
+						   BOOLOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  6, "chunks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  7, "bytes_loaded",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  8, "fallbacks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber)  9, "load_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 10, "jit_wait_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 11, "gpu_exec_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 12, "fallback_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 13, "sampled_at",
+						   TIMESTAMPTZOID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+
+		/* copy the valid samples; writers may update them concurrently */
+		samples_list = NIL;
+		for (i=0; gpuQuerySampleRing && i < gpuQuerySampleRing->nitems; i++)
+		{
+			GpuQuerySample *curr = &gpuQuerySampleRing->samples[i];
+			uint64		seqno = pg_atomic_read_u64(&curr->seqno);
+
+			if (seqno == 0)
+				continue;
+			qsample = palloc(sizeof(GpuQuerySample));
+			pg_read_barrier();
+			memcpy(qsample, curr, sizeof(GpuQuerySample));
+			pg_read_barrier();
+			if (pg_atomic_read_u64(&curr->seqno) != seqno)
+			{
+				pfree(qsample);
+				continue;
+			}
+			samples_list = lappend(samples_list, qsample);
+		}
+		fncxt->user_fctx = samples_list;
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	samples_list = fncxt->user_fctx;
+
+	if (samples_list == NIL)
+		SRF_RETURN_DONE(fncxt);
+	qsample = linitial(samples_list);
+	fncxt->user_fctx = list_delete_first(samples_list);
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = ObjectIdGetDatum(qsample->dbid);
+	values[1] = ObjectIdGetDatum(qsample->userid);
+	values[2] = Int64GetDatum((int64)qsample->queryid);
+	values[3] = CStringGetTextDatum(qsample->node_name);
+	values[4] = BoolGetDatum(qsample->is_worker);
+	values[5] = Int64GetDatum(qsample->num_chunks);
+	values[6] = Int64GetDatum(qsample->bytes_loaded);
+	values[7] = Int64GetDatum(qsample->num_fallbacks);
+	values[8] = Float8GetDatum((double)qsample->time_chunk_load / 1000.0);
+	values[9] = Float8GetDatum((double)qsample->time_jit_wait / 1000.0);
+	values[10] = Float8GetDatum((double)qsample->time_gpu_exec / 1000.0);
+	values[11] = Float8GetDatum((double)qsample->time_fallback / 1000.0);
+	values[12] = TimestampTzGetDatum(qsample->sampled_at);
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_query_samples);
+
+/*
+ * pgstrom_gpu_query_stats_reset - discard all the samples
+ */
+Datum pgstrom_gpu_query_stats_reset(PG_FUNCTION_ARGS);
+
+Datum
+pgstrom_gpu_query_stats_reset(PG_FUNCTION_ARGS)
+{
+	uint32		i;
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to reset GPU query statistics")));
+	for (i=0; gpuQuerySampleRing && i < gpuQuerySampleRing->nitems; i++)
+		pg_atomic_write_u64(&gpuQuerySampleRing->samples[i].seqno, 0);
+	PG_RETURN_VOID();
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_query_stats_reset);
+
+/*
+ * pgstrom_startup_gputasks
+ */
+static void
+pgstrom_startup_gputasks(void)
+{
+	Size		length;
+	bool		found;
+	uint32		i;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	length = offsetof(GpuQuerySampleRing,
+					  samples[pgstrom_gpu_query_stats_size]);
+	gpuQuerySampleRing = ShmemInitStruct("GPU Query Sample Ring",
+										 STROMALIGN(length),
+										 &found);
+	if (found)
+		elog(ERROR, "Bug? GPU Query Sample Ring exists");
+	pg_atomic_init_u64(&gpuQuerySampleRing->next_seqno, 0);
+	gpuQuerySampleRing->nitems = pgstrom_gpu_query_stats_size;
+	for (i=0; i < gpuQuerySampleRing->nitems; i++)
+	{
+		GpuQuerySample *qsample = &gpuQuerySampleRing->samples[i];
+
+		memset(qsample, 0, sizeof(GpuQuerySample));
+		pg_atomic_init_u64(&qsample->seqno, 0);
+	}
+}
+
 /*
  * pgstrom_init_gputasks
  */
 void
 pgstrom_init_gputasks(void)
 {
-	/* nothing to do */
+	/* pg_strom.gpu_trace_dir */
+	DefineCustomStringVariable("pg_strom.gpu_trace_dir",
+							   "Directory to write out trace files of GpuTasks",
+							   NULL,
+							   &pgstrom_gpu_trace_dir,
+							   NULL,
+							   PGC_SUSET,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	/* pg_strom.chunk_target_latency */
+	DefineCustomIntVariable("pg_strom.chunk_target_latency",
+							"Target latency per GpuTask to adjust the chunk size",
+							NULL,
+							&pgstrom_chunk_target_latency,
+							0,
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_MS,
+							NULL, NULL, NULL);
+	/* pg_strom.gpu_query_stats_size */
+	DefineCustomIntVariable("pg_strom.gpu_query_stats_size",
+							"Number of samples kept for pgstrom.gpu_query_stats",
+							NULL,
+							&pgstrom_gpu_query_stats_size,
+							4096,
+							0,
+							1048576,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* pg_strom.gpu_query_stats_sample_rate */
+	DefineCustomRealVariable("pg_strom.gpu_query_stats_sample_rate",
+							 "Rate of GPU plan nodes sampled for pgstrom.gpu_query_stats",
+							 NULL,
+							 &pgstrom_gpu_query_stats_sample_rate,
+							 1.0,
+							 0.0,
+							 1.0,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* sample ring on the shared memory */
+	if (pgstrom_gpu_query_stats_size > 0)
+	{
+		Size	length = offsetof(GpuQuerySampleRing,
+								  samples[pgstrom_gpu_query_stats_size]);
+
+		RequestAddinShmemSpace(STROMALIGN(length));
+		shmem_startup_next = shmem_startup_hook;
+		shmem_startup_hook = pgstrom_startup_gputasks;
+	}
 }
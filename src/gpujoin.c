@@ -44,11 +44,14 @@ typedef struct
 		Path	   *scan_path;		/* outer scan path */
 		List	   *hash_quals;		/* valid quals, if hash-join */
 		List	   *join_quals;		/* all the device quals, incl hash_quals */
+		bool		merge_join;		/* true, if merge-join by hash_quals */
 		IndexOptInfo *gist_index;	/* GiST index IndexOptInfo */
 		AttrNumber	gist_ctid_resno;/* CTID resno on the targetlist */
+		AttrNumber	gist_key_resno;	/* key resno, if synthetic GiST */
 		List	   *gist_clauses;	/* GiST index clause */
 		Selectivity	gist_selectivity; /* GiST index selectivity */
 		Size		ichunk_size;	/* expected inner chunk size */
+		cl_int		nbatches;		/* # of batches, if multi-batch hash-join */
 	} inners[FLEXIBLE_ARRAY_MEMBER];
 } GpuJoinPath;
 
@@ -74,6 +77,7 @@ typedef struct
 	/* inner relations */
 	cl_bool		inner_parallel;
 	cl_int		sibling_param_id;
+	cl_bool		join_reorderable;	/* depths may be joined in any order */
 	/* BRIN-index support */
 	Oid			index_oid;			/* OID of BRIN-index, if any */
 	List	   *index_conds;		/* BRIN-index key conditions */
@@ -82,13 +86,17 @@ typedef struct
 	List	   *plan_nrows_in;	/* list of floatVal for planned nrows_in */
 	List	   *plan_nrows_out;	/* list of floatVal for planned nrows_out */
 	List	   *ichunk_size;
+	List	   *inner_nbatches;	/* number of batches, if multi-batch */
 	List	   *join_types;
 	List	   *join_quals;
 	List	   *other_quals;
 	List	   *hash_inner_keys;	/* if hash-join */
 	List	   *hash_outer_keys;	/* if hash-join */
+	List	   *merge_join;			/* if merge-join by the hash keys */
 	List	   *gist_index_reloid;	/* if GiST-index */
 	List	   *gist_index_ctid_resno; /* if GiST-index */
+	List	   *gist_index_opclass;	/* if synthetic GiST-index */
+	List	   *gist_index_key_resno; /* if synthetic GiST-index */
 	List	   *gist_index_clauses;	/* if GiST-index */
 	/* supplemental information of ps_tlist */
 	List	   *ps_src_depth;	/* source depth of the ps_tlist entry */
@@ -118,6 +126,7 @@ form_gpujoin_info(CustomScan *cscan, GpuJoinInfo *gj_info)
 	privs = lappend(privs, makeInteger(gj_info->outer_nrows_per_block));
 	privs = lappend(privs, makeInteger(gj_info->inner_parallel));
 	privs = lappend(privs, makeInteger(gj_info->sibling_param_id));
+	privs = lappend(privs, makeInteger(gj_info->join_reorderable));
 	privs = lappend(privs, makeInteger(gj_info->index_oid));
 	privs = lappend(privs, gj_info->index_conds);
 	exprs = lappend(exprs, gj_info->index_quals);
@@ -125,13 +134,17 @@ form_gpujoin_info(CustomScan *cscan, GpuJoinInfo *gj_info)
 	privs = lappend(privs, gj_info->plan_nrows_in);
 	privs = lappend(privs, gj_info->plan_nrows_out);
 	privs = lappend(privs, gj_info->ichunk_size);
+	privs = lappend(privs, gj_info->inner_nbatches);
 	privs = lappend(privs, gj_info->join_types);
 	exprs = lappend(exprs, gj_info->join_quals);
 	exprs = lappend(exprs, gj_info->other_quals);
 	exprs = lappend(exprs, gj_info->hash_inner_keys);
 	exprs = lappend(exprs, gj_info->hash_outer_keys);
+	privs = lappend(privs, gj_info->merge_join);
 	privs = lappend(privs, gj_info->gist_index_reloid);
 	privs = lappend(privs, gj_info->gist_index_ctid_resno);
+	privs = lappend(privs, gj_info->gist_index_opclass);
+	privs = lappend(privs, gj_info->gist_index_key_resno);
 	exprs = lappend(exprs, gj_info->gist_index_clauses);
 
 	privs = lappend(privs, gj_info->ps_src_depth);
@@ -167,6 +180,7 @@ deform_gpujoin_info(CustomScan *cscan)
 	gj_info->outer_nrows_per_block = intVal(list_nth(privs, pindex++));
 	gj_info->inner_parallel = intVal(list_nth(privs, pindex++));
 	gj_info->sibling_param_id = intVal(list_nth(privs, pindex++));
+	gj_info->join_reorderable = intVal(list_nth(privs, pindex++));
 	gj_info->index_oid = intVal(list_nth(privs, pindex++));
 	gj_info->index_conds = list_nth(privs, pindex++);
 	gj_info->index_quals = list_nth(exprs, eindex++);
@@ -174,13 +188,17 @@ deform_gpujoin_info(CustomScan *cscan)
 	gj_info->plan_nrows_in = list_nth(privs, pindex++);
 	gj_info->plan_nrows_out = list_nth(privs, pindex++);
 	gj_info->ichunk_size = list_nth(privs, pindex++);
+	gj_info->inner_nbatches = list_nth(privs, pindex++);
 	gj_info->join_types = list_nth(privs, pindex++);
     gj_info->join_quals = list_nth(exprs, eindex++);
 	gj_info->other_quals = list_nth(exprs, eindex++);
 	gj_info->hash_inner_keys = list_nth(exprs, eindex++);
 	gj_info->hash_outer_keys = list_nth(exprs, eindex++);
+	gj_info->merge_join = list_nth(privs, pindex++);
 	gj_info->gist_index_reloid = list_nth(privs, pindex++);
 	gj_info->gist_index_ctid_resno = list_nth(privs, pindex++);
+	gj_info->gist_index_opclass = list_nth(privs, pindex++);
+	gj_info->gist_index_key_resno = list_nth(privs, pindex++);
 	gj_info->gist_index_clauses = list_nth(exprs, eindex++);
 
 	gj_info->ps_src_depth = list_nth(privs, pindex++);
@@ -208,6 +226,17 @@ typedef struct
 	size_t				preload_usage;
 	slist_head			preload_tuples;
 	Bitmapset		   *preload_flatten_attrs;
+	Bitmapset		   *preload_column_attrs;	/* by colidx */
+
+	/*
+	 * Multi-batch hash-join; inner tuples are partitioned by the hash
+	 * value, then spilled out to the temporary files per batch.
+	 */
+	int					nbatches;		/* 1, if single batch */
+	int					curr_batch;		/* batch on the inner buffer */
+	BufFile			  **batch_files;
+	size_t			   *batch_nitems;
+	size_t			   *batch_usage;
 
 	/*
 	 * Join properties; common
@@ -224,12 +253,21 @@ typedef struct
 	 */
 	List			   *hash_outer_keys;
 	List			   *hash_inner_keys;
+	bool				device_hash_build;	/* hash-table is built on GPU */
+	/* merge-join; inner rows are sorted by the hash_inner_keys */
+	bool				merge_join;
+	SortSupport			merge_ssup;		/* for each hash_inner_keys */
 
 	/*
 	 * Join properties; GiST index
 	 */
 	Relation			gist_irel;
 	AttrNumber			gist_ctid_resno;
+	/* synthetic GiST index, built on the inner preloading */
+	TupleDesc			gist_itupdesc;
+	AttrNumber			gist_key_resno;
+	FmgrInfo			gist_compress;
+	TypeCacheEntry	   *gist_rngtyp;	/* valid, if range index */
 
 	/* CPU Fallback related */
 	AttrNumber		   *inner_dst_resno;
@@ -250,8 +288,15 @@ typedef struct
 	kern_multirels *h_kmrels;			/* mmap of host shared memory */
 	CUdeviceptr		m_kmrels;			/* local map of preserved memory */
 	bool			m_kmrels_owner;
+	bool			m_kmrels_managed;	/* true, if managed memory */
+	pg_crc32		inner_cache_key;	/* 0, if inner buffer is not cacheable */
+	StringInfoData	inner_cache_keybuf;	/* serialized key of inner buffer */
+	int				inner_cache_index;	/* slot of GpuJoinInnerCache in use */
+	bool			inner_cache_capture; /* true, if relations are captured */
+	struct GpuJoinInnerCacheRel *inner_cache_rels;
 	bool			inner_parallel;
 	MemoryContext	preload_memcxt;		/* memory context for preloading */
+	int				batch_depth;		/* depth of multi-batch, or 0 */
 
 	/*
 	 * Expressions to be used in the CPU fallback path
@@ -265,6 +310,16 @@ typedef struct
 	/* result width per tuple for buffer length calculation */
 	int				result_width;
 
+	/*
+	 * Runtime join order; if all the depths are reorderable, the depth order
+	 * may be switched according to the selectivity observed on the first
+	 * outer chunks.
+	 */
+	bool			join_reorderable;
+	bool			depth_order_fixed;	/* true, if depth order is decided */
+	bool			depth_reordered;	/* true, if depth order is switched */
+	int			   *depth_order;		/* physical depth at the each step */
+
 	/*
 	 * CPU Fallback
 	 */
@@ -277,6 +332,15 @@ typedef struct
 	cl_long			fallback_thread_count;
 	cl_long			fallback_outer_index;
 
+	/*
+	 * RIGHT/FULL OUTER JOIN; range of the inner rows claimed by this
+	 * backend/worker to emit the unmatched rows.
+	 */
+	bool			outer_scan_detached;
+	cl_int			outer_join_depth;	/* 0, if no rows are claimed */
+	cl_uint			outer_join_row_base;
+	cl_uint			outer_join_row_end;
+
 	/*
 	 * Properties of underlying inner relations
 	 */
@@ -305,8 +369,12 @@ struct GpuJoinSharedState
 	pg_atomic_uint32 outer_scan_done;  /* non-zero, if outer is scanned */
 	pg_atomic_uint32 needs_colocation; /* non-zero, if colocation is needed */
 	cl_int			curr_outer_depth;
+	cl_uint			outer_read_pos;	/* next inner row of curr_outer_depth */
+	int				nr_workers_outer; /* # of running RIGHT OUTER tasks */
+	bool			ojmaps_on_host;	/* true, if outer-join-map is colocated */
 	struct {
 		int			nr_workers_gpujoin;
+		bool		managed_kmrels;	/* true, if private managed buffer */
 		size_t		bytesize;		/* not zero, if allocated */
 		CUipcMemHandle ipc_mhandle;	/* IPC handle of preserved memory */
 	} pergpu[FLEXIBLE_ARRAY_MEMBER];
@@ -319,12 +387,18 @@ typedef struct GpuJoinSharedState	GpuJoinSharedState;
 struct GpuJoinRuntimeStat
 {
 	GpuTaskRuntimeStat		c;		/* common statistics */
+	/* total length of the result buffers consumed by outer chunks */
+	pg_atomic_uint64		result_nchunks;
+	pg_atomic_uint64		result_length;
+	/* number of outer chunks processed in the planned depth order */
+	pg_atomic_uint64		sample_nchunks;
 	struct {
 		pg_atomic_uint64	inner_nrooms;
 		pg_atomic_uint64	inner_usage;
 		pg_atomic_uint64	inner_nitems;
 		pg_atomic_uint64	inner_nitems2;
 		pg_atomic_uint64	right_nitems;
+		pg_atomic_uint64	sample_nitems;	/* inner_nitems of the samples */
 	} jstat[FLEXIBLE_ARRAY_MEMBER];
 };
 typedef struct GpuJoinRuntimeStat	GpuJoinRuntimeStat;
@@ -362,12 +436,37 @@ typedef struct
 	GpuTask			task;
 	cl_bool			with_nvme_strom;	/* true, if NVMe-Strom */
 	cl_int			outer_depth;		/* base depth, if RIGHT OUTER */
+	size_t			result_length;		/* length of the results thrown */
+	GpuMemArena	   *arena;		/* task arena, or NULL if responder */
 	/* DMA buffers */
 	pgstrom_data_store *pds_src;	/* data store of outer relation */
 	pgstrom_data_store *pds_dst;	/* data store of result buffer */
 	kern_gpujoin	kern;		/* kern_gpujoin of this request */
 } GpuJoinTask;
 
+/*
+ * Upper limit of the result buffer length, by multiple of the chunk size
+ */
+#define GPUJOIN_RESULT_BUFFER_MAX_SCALE		4
+
+/*
+ * Number of outer chunks to estimate selectivity of each depth, prior to
+ * the runtime switch of the depth order
+ */
+#define GPUJOIN_REORDER_SAMPLE_NCHUNKS		4
+
+/*
+ * Number of inner rows to be claimed at once by backend/workers, to emit
+ * the unmatched rows of RIGHT/FULL OUTER JOIN
+ */
+#define GPUJOIN_RIGHT_OUTER_NROWS_PER_TASK	(1U << 18)
+
+/* used length of the result buffer in KDS_FORMAT_ROW */
+#define GPUJOIN_RESULT_BUFFER_USAGE(kds)							\
+	(KERN_DATA_STORE_HEAD_LENGTH(kds) +								\
+	 STROMALIGN(sizeof(cl_uint) * (kds)->nitems) +					\
+	 STROMALIGN(__kds_unpack((kds)->usage)))
+
 /* static variables */
 static set_join_pathlist_hook_type set_join_pathlist_next;
 static CustomPathMethods	gpujoin_path_methods;
@@ -375,7 +474,17 @@ static CustomScanMethods	gpujoin_plan_methods;
 static CustomExecMethods	gpujoin_exec_methods;
 static bool					enable_gpunestloop;				/* GUC */
 static bool					enable_gpuhashjoin;				/* GUC */
+static bool					enable_gpumergejoin;			/* GUC */
 static bool					enable_partitionwise_gpujoin;	/* GUC */
+static bool					enable_multibatch_gpuhashjoin;	/* GUC */
+static bool					enable_gpujoin_bloom_filter;	/* GUC */
+static bool					enable_gpujoin_hash_bucket;		/* GUC */
+static bool					enable_gpujoin_device_hash_build; /* GUC */
+static bool					enable_gpujoin_inner_columns;	/* GUC */
+static bool					enable_gpujoin_reorder;			/* GUC */
+static bool					enable_gpujoin_synthetic_gist;	/* GUC */
+static int					gpujoin_inner_cache_size_mb;	/* GUC */
+static shmem_startup_hook_type shmem_startup_next = NULL;
 
 /* static functions */
 static void gpujoin_switch_task(GpuTaskState *gts, GpuTask *gtask);
@@ -398,9 +507,15 @@ static char *gpujoin_codegen(PlannerInfo *root,
 static void createGpuJoinSharedState(GpuJoinState *gjs,
 									 ParallelContext *pcxt,
 									 void *coordinate);
+static void resetGpuJoinSharedState(GpuJoinState *gjs);
 static void cleanupGpuJoinSharedStateOnAbort(dsm_segment *segment,
 											 Datum ptr);
 static void gpujoinColocateOuterJoinMapsToHost(GpuJoinState *gjs);
+static void gpujoinDetachOuterJoin(GpuJoinState *gjs,
+								   GpuJoinSharedState *gj_sstate);
+static void gpujoinSwitchInnerBatch(GpuJoinState *gjs, int batchno);
+static pg_crc32 innerPreloadCacheKey(GpuJoinState *gjs,
+									GpuJoinInfo *gj_info);
 
 /*
  * misc declarations
@@ -519,6 +634,78 @@ __dump_gpujoin_rel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel)
 		appendStringInfo(buf, ")");
 }
 
+/*
+ * Right now, KDS_FORMAT_ROW/HASH does not support KDS size larger than 4GB,
+ * so inner chunk larger than the threshold below needs multi-batch join.
+ */
+#define GPUJOIN_MAX_INNER_CHUNK_SIZE	0x60000000UL
+
+/*
+ * check_gpumergejoin_quals
+ *
+ * GpuMergeJoin compares the join keys using the device comparison function
+ * in the order of the default btree operator class, so both sides of the
+ * hash-joinable quals must have the same type that supports it.
+ * It also informs whether the inner path is already sorted by the keys.
+ */
+static bool
+check_gpumergejoin_quals(PlannerInfo *root,
+						 Path *inner_path,
+						 List *hash_quals,
+						 bool *p_presorted)
+{
+	Relids		inner_relids = inner_path->parent->relids;
+	PathKey	   *pathkey = NULL;
+	ListCell   *lc;
+
+	*p_presorted = false;
+	if (inner_path->pathkeys != NIL)
+		pathkey = linitial(inner_path->pathkeys);
+	foreach (lc, hash_quals)
+	{
+		RestrictInfo   *rinfo = lfirst(lc);
+		OpExpr		   *op = (OpExpr *)rinfo->clause;
+		Node		   *arg1 = linitial(op->args);
+		Node		   *arg2 = lsecond(op->args);
+		Oid				type_oid = exprType(arg1);
+		Oid				collid = exprCollation(arg1);
+		TypeCacheEntry *tcache;
+		devtype_info   *dtype;
+
+		if (rinfo->mergeopfamilies == NIL ||
+			type_oid != exprType(arg2) ||
+			collid != exprCollation(arg2))
+			return false;
+		tcache = lookup_type_cache(type_oid, TYPECACHE_BTREE_OPFAMILY |
+											 TYPECACHE_LT_OPR);
+		if (!OidIsValid(tcache->lt_opr) ||
+			!list_member_oid(rinfo->mergeopfamilies, tcache->btree_opf))
+			return false;
+		dtype = pgstrom_devtype_lookup(type_oid);
+		if (!dtype || !pgstrom_devfunc_lookup_type_compare(dtype, collid))
+			return false;
+
+		/* is the inner path sorted by this key? */
+		if (pathkey &&
+			pathkey->pk_strategy == BTLessStrategyNumber &&
+			!pathkey->pk_nulls_first &&
+			rinfo->left_ec != NULL &&
+			rinfo->right_ec != NULL)
+		{
+			EquivalenceClass *inner_ec;
+
+			update_mergeclause_eclasses(root, rinfo);
+			if (bms_is_subset(rinfo->right_relids, inner_relids))
+				inner_ec = rinfo->right_ec;
+			else
+				inner_ec = rinfo->left_ec;
+			if (pathkey->pk_eclass == inner_ec)
+				*p_presorted = true;
+		}
+	}
+	return true;
+}
+
 /*
  * estimate_inner_buffersize
  */
@@ -572,8 +759,40 @@ estimate_inner_buffersize(PlannerInfo *root,
 		/*
 		 * estimation of the inner chunk in this depth
 		 */
+		gpath->inners[i].merge_join = false;
 		if (gpath->inners[i].hash_quals != NIL)
+		{
+			JoinType	join_type = gpath->inners[i].join_type;
+			Size		merge_size;
+			bool		presorted;
+
 			chunk_size = KDS_ESTIMATE_HASH_LENGTH(ncols,inner_nrows,htup_size);
+			/*
+			 * GpuMergeJoin needs no hash-table, but only the inner rows and
+			 * the index sorted by the join keys. It is preferable if inner
+			 * rows are already sorted, or hash-table is too large.
+			 */
+			if (enable_gpumergejoin &&
+				(join_type == JOIN_INNER ||
+				 join_type == JOIN_LEFT ||
+				 join_type == JOIN_RIGHT ||
+				 join_type == JOIN_FULL) &&
+				check_gpumergejoin_quals(root, inner_path,
+										 gpath->inners[i].hash_quals,
+										 &presorted))
+			{
+				merge_size = (KDS_ESTIMATE_ROW_LENGTH(ncols,inner_nrows,
+													  htup_size) +
+							  STROMALIGN(sizeof(cl_uint) * inner_nrows));
+				if (presorted ||
+					(chunk_size >= GPUJOIN_MAX_INNER_CHUNK_SIZE &&
+					 merge_size < GPUJOIN_MAX_INNER_CHUNK_SIZE))
+				{
+					gpath->inners[i].merge_join = true;
+					chunk_size = merge_size;
+				}
+			}
+		}
 		else
 			chunk_size = KDS_ESTIMATE_ROW_LENGTH(ncols,inner_nrows,htup_size);
 		gpath->inners[i].ichunk_size = chunk_size;
@@ -600,11 +819,14 @@ cost_gpujoin(PlannerInfo *root,
 	Cost		run_cost = 0.0;
 	Cost		startup_delay;
 	Size		inner_buffer_sz = 0;
-	double		gpu_ratio = pgstrom_gpu_operator_cost / cpu_operator_cost;
+	Cost		gpu_operator_cost = pgstromGpuOperatorCost(gpath->optimal_gpu);
+	Cost		gpu_dma_cost = pgstromGpuDmaCost(gpath->optimal_gpu);
+	double		gpu_ratio = gpu_operator_cost / cpu_operator_cost;
 	double		parallel_divisor = 1.0;
 	double		num_chunks;
 	double		outer_ntuples = outer_path->rows;
 	int			i, num_rels = gpath->num_rels;
+	cl_int		nbatches = 1;
 	bool		retval = false;
 
 	/*
@@ -632,9 +854,9 @@ cost_gpujoin(PlannerInfo *root,
 	else
 	{
 		if (pathtree_has_gpupath(outer_path))
-			startup_cost = pgstrom_gpu_setup_cost / 2;
+			startup_cost = pgstromGpuSetupCost(gpath->optimal_gpu) / 2;
 		else
-			startup_cost = pgstrom_gpu_setup_cost;
+			startup_cost = pgstromGpuSetupCost(gpath->optimal_gpu);
 		startup_cost = outer_path->startup_cost;
 		run_cost = outer_path->total_cost - outer_path->startup_cost;
 		num_chunks = estimate_num_chunks(outer_path);
@@ -675,7 +897,35 @@ cost_gpujoin(PlannerInfo *root,
 		 * least 3bit because row-/hash-item shall be always put on 64bit
 		 * aligned location.
 		 */
-		if (ichunk_size >= 0x60000000UL)
+		gpath->inners[i].nbatches = 1;
+		if (ichunk_size >= GPUJOIN_MAX_INNER_CHUNK_SIZE &&
+			enable_multibatch_gpuhashjoin &&
+			hash_quals != NIL &&
+			!gpath->inners[i].merge_join &&
+			gpath->inners[i].join_type == JOIN_INNER &&
+			parallel_nworkers == 0 &&
+			!gpath->inner_parallel &&
+			!gpath->sibling_param_id &&
+			nbatches == 1)
+		{
+			/*
+			 * Multi-batch GpuHashJoin - inner hash table is partitioned
+			 * to fit the device buffer, then outer relation is rescanned
+			 * for each batch. Only one depth can be partitioned.
+			 */
+			nbatches = (cl_int)
+				ceil(1.25 * (double) ichunk_size /
+					 (double) GPUJOIN_MAX_INNER_CHUNK_SIZE);
+			gpath->inners[i].nbatches = nbatches;
+			ichunk_size = ichunk_size / nbatches;
+			gpath->inners[i].ichunk_size = ichunk_size;
+			inner_buffer_sz -= ichunk_size * (nbatches - 1);
+			/* cost to write out / read back the inner batches */
+			inner_cost += (2.0 * seq_page_cost *
+						   (double)(ichunk_size * (nbatches - 1)) /
+						   (double) BLCKSZ);
+		}
+		else if (ichunk_size >= GPUJOIN_MAX_INNER_CHUNK_SIZE)
 		{
 			if (client_min_messages <= DEBUG1 || log_min_messages <= DEBUG1)
 			{
@@ -693,17 +943,14 @@ cost_gpujoin(PlannerInfo *root,
 		/*
 		 * cost to load all the tuples from inner-path
 		 *
-		 * FIXME: This is an ad-hoc workaround not to breal multi-level
-		 * GpuJoin chain. PostgreSQL v11 begins to support parallel build
-		 * of inner hash-table, and its cost tends to be discounted by
-		 * num of parallel workers. It is exactly a rapid option to process
-		 * inner side, however, cannot use combined GpuJoin+GpuPreAgg here.
-		 * So, we tentatively discount the inner cost by parallel_nworkers,
-		 * as if it is processed in parallel.
-		 * It shall be supported on the later PG-Strom version.
+		 * If inner_parallel, every participant scans a part of the inner
+		 * relation (partial path; its cost is already per participant),
+		 * then inserts the tuples into the shared inner buffer by itself.
+		 * Elsewhere, only one process scans the entire inner relation,
+		 * and others wait for the preload.
 		 */
 		inner_run_cost = (scan_path->total_cost -
-						  scan_path->startup_cost) / parallel_divisor;
+						  scan_path->startup_cost);
 		inner_cost += scan_path->startup_cost + inner_run_cost;
 
 		/* cost for join_qual startup */
@@ -715,7 +962,34 @@ cost_gpujoin(PlannerInfo *root,
 		 * cost to evaluate join qualifiers according to
 		 * the GpuJoin logic
 		 */
-		if (hash_quals != NIL)
+		if (hash_quals != NIL && gpath->inners[i].merge_join)
+		{
+			/*
+			 * GpuMergeJoin - It sorts the inner tuples by CPU, unless they
+			 * are already sorted, then looks up the range of inner tuples
+			 * with the same keys by binary search for each outer tuple.
+			 */
+			cl_uint		num_mergekeys = list_length(hash_quals);
+			double		inner_ntuples = Max(scan_path->rows, 2.0);
+			bool		presorted;
+
+			(void) check_gpumergejoin_quals(root, scan_path,
+											hash_quals, &presorted);
+			/* cost to preload and sort inner tuples by CPU */
+			inner_cost += cpu_tuple_cost * scan_path->rows;
+			if (presorted)
+				inner_cost += (cpu_operator_cost * num_mergekeys *
+							   scan_path->rows);
+			else
+				inner_cost += (2.0 * cpu_operator_cost * num_mergekeys *
+							   inner_ntuples * log2(inner_ntuples));
+			/* cost to search the inner tuples by GPU */
+			run_cost += (gpu_operator_cost * num_mergekeys *
+						 log2(inner_ntuples) * outer_ntuples);
+			/* cost to evaluate join qualifiers */
+			run_cost += join_quals_cost.per_tuple * outer_ntuples;
+		}
+		else if (hash_quals != NIL)
 		{
 			/*
 			 * GpuHashJoin - It computes hash-value of inner tuples by CPU,
@@ -730,7 +1004,7 @@ cost_gpujoin(PlannerInfo *root,
 			inner_cost += cpu_operator_cost * num_hashkeys * scan_path->rows;
 
 			/* cost to comput hash value by GPU */
-			run_cost += (pgstrom_gpu_operator_cost *
+			run_cost += (gpu_operator_cost *
 						 num_hashkeys *
 						 outer_ntuples);
 			/* cost to evaluate join qualifiers */
@@ -751,6 +1025,11 @@ cost_gpujoin(PlannerInfo *root,
 			/* cost to preload the entire index pages once */
 			inner_cost += seq_page_cost * (double)gist_index->pages;
 
+			/* cost to build synthetic GiST index by CPU, if any */
+			if (!OidIsValid(gist_index->indexoid))
+				inner_cost += (2.0 * cpu_operator_cost * inner_ntuples *
+							   log2(Max(inner_ntuples, 2.0)));
+
 			/* cost to evaluate GiST index by GPU */
 			cost_qual_eval(&gist_clause_cost, gist_clauses, root);
 			run_cost += (gist_clause_cost.per_tuple * gpu_ratio * outer_ntuples);
@@ -780,23 +1059,41 @@ cost_gpujoin(PlannerInfo *root,
 		/* number of outer items on the next depth */
 		outer_ntuples = join_nrows / parallel_divisor;
 	}
+
+	/*
+	 * Inner buffer must fit the device memory of the target GPU; or the
+	 * smallest one if GpuJoin may run on any devices.
+	 */
+	if (inner_buffer_sz > pgstromGpuDeviceMemorySize(gpath->optimal_gpu))
+	{
+		elog(DEBUG1, "expected inner buffer size (%zu) is larger than the device memory (%zu) of GPU%d",
+			 inner_buffer_sz,
+			 pgstromGpuDeviceMemorySize(gpath->optimal_gpu),
+			 gpath->optimal_gpu);
+		return false;
+	}
+
 	/* outer DMA send cost */
-	run_cost += (double)num_chunks * pgstrom_gpu_dma_cost;
+	run_cost += (double)num_chunks * gpu_dma_cost;
 
 	/* inner DMA send cost */
 	inner_cost += ((double)inner_buffer_sz /
-				   (double)pgstrom_chunk_size()) * pgstrom_gpu_dma_cost;
+				   (double)pgstrom_chunk_size()) * gpu_dma_cost;
 
 	/* cost for GPU projection */
 	startup_cost += joinrel->reltarget->cost.startup;
 	run_cost += (joinrel->reltarget->cost.per_tuple +
 				 cpu_tuple_cost) * gpu_ratio * gpath->cpath.path.rows;
 	/* cost for DMA receive (GPU-->host) */
-	run_cost += cost_for_dma_receive(joinrel, -1.0);
+	run_cost += cost_for_dma_receive(joinrel, -1.0, gpath->optimal_gpu);
 
 	/* cost to exchange tuples */
 	run_cost += cpu_tuple_cost * gpath->cpath.path.rows;
 
+	/* outer relation shall be rescanned for each inner batch */
+	if (nbatches > 1)
+		run_cost += (startup_cost + run_cost) * (double)(nbatches - 1);
+
 	/*
 	 * delay to fetch the first tuple
 	 */
@@ -833,13 +1130,17 @@ cost_gpujoin(PlannerInfo *root,
 			JoinType	join_type = gpath->inners[i].join_type;
 			Path	   *inner_path = gpath->inners[i].scan_path;
 			bool		is_nestloop = (gpath->inners[i].hash_quals == NIL);
+			bool		is_mergejoin = gpath->inners[i].merge_join;
 
 			__dump_gpujoin_rel(&buf, root, inner_path->parent);
 			appendStringInfo(&buf, " %s%s ",
 							 join_type == JOIN_FULL ? "F" :
 							 join_type == JOIN_LEFT ? "L" :
-							 join_type == JOIN_RIGHT ? "R" : "I",
-							 is_nestloop ? "NL" : "HJ");
+							 join_type == JOIN_RIGHT ? "R" :
+							 join_type == JOIN_SEMI ? "S" :
+							 join_type == JOIN_ANTI ? "A" : "I",
+							 is_nestloop ? "NL" :
+							 is_mergejoin ? "MJ" : "HJ");
 		}
 		__dump_gpujoin_rel(&buf, root, outer_path->parent);
 		elog(DEBUG1, "GpuJoin: %s Cost=%.2f..%.2f%s",
@@ -860,6 +1161,7 @@ typedef struct
 	List	   *hash_quals;
 	IndexOptInfo *gist_index;
 	AttrNumber	gist_ctid_resno;
+	AttrNumber	gist_key_resno;
 	List	   *gist_clauses;
 	Selectivity	gist_selectivity;
 	double		join_nrows;
@@ -933,11 +1235,14 @@ create_gpujoin_path(PlannerInfo *root,
 		gjpath->inners[i].scan_path = ip_item->inner_path;
 		gjpath->inners[i].hash_quals = hash_quals;
 		gjpath->inners[i].join_quals = ip_item->join_quals;
+		gjpath->inners[i].merge_join = false;	/* to be set later */
 		gjpath->inners[i].gist_index = ip_item->gist_index;
 		gjpath->inners[i].gist_ctid_resno = ip_item->gist_ctid_resno;
+		gjpath->inners[i].gist_key_resno = ip_item->gist_key_resno;
 		gjpath->inners[i].gist_clauses = ip_item->gist_clauses;
 		gjpath->inners[i].gist_selectivity = ip_item->gist_selectivity;
 		gjpath->inners[i].ichunk_size = 0;		/* to be set later */
+		gjpath->inners[i].nbatches = 1;			/* to be set later */
 		i++;
 	}
 	Assert(i == num_rels);
@@ -1034,6 +1339,167 @@ extract_gpuhashjoin_quals(PlannerInfo *root,
 	return hash_quals;
 }
 
+/*
+ * Synthetic GiST Index support
+ *
+ * If inner relation has no GiST index available for the join clause,
+ * GpuNestLoop can build an R-tree on the fly on the inner preloading,
+ * from the bounding-boxes of the geometry values.
+ * It has the same page layout of PostGIS's gist_geometry_ops_2d, so
+ * device code walks on the synthetic index as if it is a built-in one.
+ *
+ * Likewise, range-type overlap join (a.period && b.period) builds a 1-D
+ * R-tree of the inner ranges sorted by the lower bound, with the page layout
+ * of built-in range_ops. Every internal item keeps union of the child ranges,
+ * so the same "&&" qualifier prunes the subtree on device walk.
+ */
+#define SYNTHETIC_GIST_OPCLASS_NAME			"gist_geometry_ops_2d"
+#define SYNTHETIC_GIST_RANGE_OPCLASS_NAME	"range_ops"
+
+typedef struct
+{
+	float4		xmin, xmax;		/* same layout to box2df */
+	float4		ymin, ymax;
+} synthGistBox;
+
+typedef struct
+{
+	synthGistBox box;
+	cl_uint		code;			/* Z-order curve of the center */
+	cl_uint		ref;			/* inner tuple offset, or child block */
+} synthGistItem;
+
+typedef struct
+{
+	Datum		key;			/* index key; box2df or range */
+	cl_uint		ref;			/* inner tuple offset, or child block */
+} synthGistKey;
+
+typedef struct
+{
+	RangeBound	lower;
+	RangeBound	upper;
+	RangeType  *range;
+	cl_uint		ref;			/* inner tuple offset */
+} synthGistRange;
+
+typedef Datum (*synthGistUnionFn)(synthGistKey *keys, int nkeys, void *arg);
+
+/*
+ * synthetic_gist_keysz - upper limit of the index key length. Range keys
+ * are varlena, so it assumes the worst alignment of the bounds.
+ */
+static size_t
+synthetic_gist_keysz(Oid keytype)
+{
+	TypeCacheEntry *typcache;
+	int16		elemlen;
+
+	if (!type_is_range(keytype))
+		return get_typlen(keytype);
+	typcache = lookup_type_cache(keytype, TYPECACHE_RANGE_INFO);
+	if (!typcache->rngelemtype)
+		elog(ERROR, "type %s is not a range type", format_type_be(keytype));
+	elemlen = typcache->rngelemtype->typlen;
+	if (elemlen <= 0)
+		return 0;	/* not supported */
+	return (VARHDRSZ + sizeof(Oid) + 2 * MAXALIGN(elemlen) + sizeof(char));
+}
+
+static inline cl_uint
+synthetic_gist_items_per_page(size_t keysz)
+{
+	return ((BLCKSZ - MAXALIGN(SizeOfPageHeaderData) -
+			 MAXALIGN(sizeof(GISTPageOpaqueData))) /
+			(MAXALIGN(sizeof(IndexTupleData) + keysz) +
+			 sizeof(ItemIdData)));
+}
+
+static size_t
+synthetic_gist_nblocks(size_t nitems, size_t keysz)
+{
+	size_t		nitems_per_page = synthetic_gist_items_per_page(keysz);
+	size_t		nblocks = 0;
+
+	do {
+		nitems = Max((nitems + nitems_per_page - 1) / nitems_per_page, 1);
+		nblocks += nitems;
+	} while (nitems > 1);
+
+	return nblocks;
+}
+
+static Oid
+lookup_synthetic_gist_opclass(const char *opcname,
+							  Oid *p_opcfamily,
+							  Oid *p_opcintype,
+							  Oid *p_opckeytype)
+{
+	HeapTuple	tup;
+	Form_pg_opclass opcform;
+	Oid			opclass;
+
+	opclass = OpclassnameGetOpcid(GIST_AM_OID, opcname);
+	if (!OidIsValid(opclass))
+		return InvalidOid;
+	tup = SearchSysCache1(CLAOID, ObjectIdGetDatum(opclass));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for opclass %u", opclass);
+	opcform = (Form_pg_opclass) GETSTRUCT(tup);
+	if (p_opcfamily)
+		*p_opcfamily = opcform->opcfamily;
+	if (p_opcintype)
+		*p_opcintype = opcform->opcintype;
+	if (p_opckeytype)
+		*p_opckeytype = opcform->opckeytype;
+	ReleaseSysCache(tup);
+
+	return opclass;
+}
+
+static Oid
+get_synthetic_gist_keytype(void)
+{
+	Oid			opckeytype;
+
+	if (!OidIsValid(lookup_synthetic_gist_opclass(SYNTHETIC_GIST_OPCLASS_NAME,
+												  NULL, NULL, &opckeytype)))
+		elog(ERROR, "Bug? operator class \"%s\" is not found",
+			 SYNTHETIC_GIST_OPCLASS_NAME);
+	return opckeytype;
+}
+
+static IndexOptInfo *
+build_synthetic_gist_index(RelOptInfo *rel,
+						   AttrNumber attnum,
+						   Oid opcfamily,
+						   Oid opcintype,
+						   size_t keysz)
+{
+	IndexOptInfo *index = makeNode(IndexOptInfo);
+
+	index->indexoid = InvalidOid;
+	index->reltablespace = InvalidOid;
+	index->rel = rel;
+	index->pages = synthetic_gist_nblocks((size_t)Max(rel->rows, 1.0), keysz);
+	index->tuples = rel->rows;
+	index->tree_height = -1;
+	index->ncolumns = 1;
+#if PG_VERSION_NUM >= 110000
+	index->nkeycolumns = 1;
+#endif
+	index->indexkeys = palloc0(sizeof(int));
+	index->indexkeys[0] = attnum;
+	index->indexcollations = palloc0(sizeof(Oid));
+	index->opfamily = palloc0(sizeof(Oid));
+	index->opfamily[0] = opcfamily;
+	index->opcintype = palloc0(sizeof(Oid));
+	index->opcintype[0] = opcintype;
+	index->relam = GIST_AM_OID;
+
+	return index;
+}
+
 /*
  * GiST Index support
  */
@@ -1377,11 +1843,26 @@ __fixup_gist_clause_for_device_walker(Node *node, void *__context)
 		Oid			raw_collid;
 		Var		   *ivar;
 
-		get_atttypetypmodcoll(index->indexoid,
-							  indexcol+1,
-							  &raw_typid,
-							  &raw_typmod,
-							  &raw_collid);
+		if (OidIsValid(index->indexoid))
+			get_atttypetypmodcoll(index->indexoid,
+								  indexcol+1,
+								  &raw_typid,
+								  &raw_typmod,
+								  &raw_collid);
+		else if (index->opcintype[indexcol] == ANYRANGEOID)
+		{
+			/* synthetic range index stores the range value as is */
+			raw_typid = exprType(node);
+			raw_typmod = exprTypmod(node);
+			raw_collid = exprCollation(node);
+		}
+		else
+		{
+			/* synthetic GiST index has only opclass' storage type */
+			raw_typid = get_synthetic_gist_keytype();
+			raw_typmod = -1;
+			raw_collid = InvalidOid;
+		}
 		ivar = makeVar(INDEX_VAR,
 					   indexcol+1,
 					   raw_typid,
@@ -1548,6 +2029,131 @@ match_clause_to_index(PlannerInfo *root,
 	return clause;
 }
 
+/*
+ * extract_synthetic_gistindex_clause
+ *
+ * It picks up a geometry or range column of the inner base relation, if
+ * a synthetic GiST index on the column is usable for any of the join clauses.
+ */
+static void
+extract_synthetic_gistindex_clause(inner_path_item *ip_item,
+								   PlannerInfo *root,
+								   List *restrict_clauses)
+{
+	Path		   *inner_path = ip_item->inner_path;
+	RelOptInfo	   *inner_rel = inner_path->parent;
+	IndexOptInfo   *gist_index = NULL;
+	AttrNumber		gist_key_resno = -1;
+	Expr		   *gist_clause = NULL;
+	Selectivity		gist_selectivity = 1.0;
+	Oid				geom_opcfamily = InvalidOid;
+	Oid				geom_opcintype = InvalidOid;
+	Oid				geom_opckeytype;
+	Oid				range_opcfamily = InvalidOid;
+	List		   *range_clauses = NIL;
+	AttrNumber		resno = 1;
+	ListCell	   *lc;
+
+	if (inner_rel->reloptkind != RELOPT_BASEREL &&
+		inner_rel->reloptkind != RELOPT_OTHER_MEMBER_REL)
+		return;
+	if (OidIsValid(lookup_synthetic_gist_opclass(SYNTHETIC_GIST_OPCLASS_NAME,
+												 &geom_opcfamily,
+												 &geom_opcintype,
+												 &geom_opckeytype)) &&
+		(get_typlen(geom_opckeytype) != sizeof(synthGistBox) ||
+		 !pgstrom_devtype_lookup(geom_opckeytype)))
+		geom_opcintype = InvalidOid;
+	if (OidIsValid(lookup_synthetic_gist_opclass(SYNTHETIC_GIST_RANGE_OPCLASS_NAME,
+												 &range_opcfamily,
+												 NULL, NULL)))
+	{
+		/*
+		 * Union ranges on the internal items can prune the subtree only
+		 * by the overlap operator; "<<" or "<@" are not exact on them.
+		 */
+		foreach (lc, restrict_clauses)
+		{
+			RestrictInfo *rinfo = lfirst(lc);
+			OpExpr	   *op = (OpExpr *) rinfo->clause;
+
+			if (op && IsA(op, OpExpr) &&
+				get_op_opfamily_strategy(op->opno,
+										 range_opcfamily) == RANGESTRAT_OVERLAPS)
+				range_clauses = lappend(range_clauses, rinfo);
+		}
+	}
+
+	foreach (lc, inner_path->pathtarget->exprs)
+	{
+		Var	   *var = (Var *) lfirst(lc);
+		AttrNumber	curr_resno = resno++;
+		IndexOptInfo *curr_index;
+		Expr	   *curr_clause;
+		Selectivity	curr_selectivity;
+		size_t		keysz;
+
+		if (!IsA(var, Var) ||
+			var->varno != inner_rel->relid ||
+			var->varattno <= 0)
+			continue;
+
+		if (OidIsValid(geom_opcintype) && var->vartype == geom_opcintype)
+		{
+			curr_index = build_synthetic_gist_index(inner_rel,
+													var->varattno,
+													geom_opcfamily,
+													geom_opcintype,
+													sizeof(synthGistBox));
+			curr_clause = match_clause_to_index(root,
+												curr_index,
+												0,
+												restrict_clauses);
+		}
+		else if (range_clauses != NIL &&
+				 type_is_range(var->vartype) &&
+				 pgstrom_devtype_lookup(var->vartype) &&
+				 (keysz = synthetic_gist_keysz(var->vartype)) > 0)
+		{
+			curr_index = build_synthetic_gist_index(inner_rel,
+													var->varattno,
+													range_opcfamily,
+													ANYRANGEOID,
+													keysz);
+			curr_clause = match_clause_to_index(root,
+												curr_index,
+												0,
+												range_clauses);
+		}
+		else
+			continue;
+
+		if (curr_clause)
+		{
+			curr_selectivity = clauselist_selectivity(root,
+													  list_make1(curr_clause),
+													  inner_rel->relid,
+													  JOIN_INNER,
+													  NULL);
+			if (!gist_index || gist_selectivity > curr_selectivity)
+			{
+				gist_index = curr_index;
+				gist_key_resno = curr_resno;
+				gist_clause = curr_clause;
+				gist_selectivity = curr_selectivity;
+			}
+		}
+	}
+
+	if (gist_index)
+	{
+		ip_item->gist_index = gist_index;
+		ip_item->gist_key_resno = gist_key_resno;
+		ip_item->gist_clauses = list_make1(gist_clause);
+		ip_item->gist_selectivity = gist_selectivity;
+	}
+}
+
 static void
 extract_gpugistindex_clause(inner_path_item *ip_item,
 							PlannerInfo *root,
@@ -1666,6 +2272,10 @@ extract_gpugistindex_clause(inner_path_item *ip_item,
 	ip_item->gist_ctid_resno = gist_ctid_resno;
 	ip_item->gist_clauses = gist_clauses;
 	ip_item->gist_selectivity = gist_selectivity;
+
+	/* elsewhere, try to build a synthetic GiST index on the fly */
+	if (!gist_index && enable_gpujoin_synthetic_gist)
+		extract_synthetic_gistindex_clause(ip_item, root, restrict_clauses);
 }
 
 #if PG_VERSION_NUM >= 110000
@@ -1996,6 +2606,19 @@ buildPartitionedGpuJoinPaths(PlannerInfo *root,
 		double		nrows_ratio
 			= (join_nrows > 0.0 ? leaf_rel->rows / join_nrows : 0.0);
 
+		/*
+		 * Foreign partitions whose FDW can push down joins by itself
+		 * (e.g, postgres_fdw) shall be joined on the remote side, using
+		 * the partition-wise join of PostgreSQL; GpuJoin on the local GPU
+		 * has to fetch all the raw rows from the remote nodes.
+		 * Other FDWs (arrow_fdw, gstore_fdw, file_fdw, ...) just supply rows
+		 * to the local node, so GpuJoin is still worth to try.
+		 */
+		if (leaf_rel->fdwroutine &&
+			leaf_rel->fdwroutine->GetForeignJoinPaths != NULL &&
+			enable_partitionwise_join)
+			return NIL;
+
 		appinfos = find_appinfos_by_relids_nofail(root, leaf_rel->relids,
 												  &nappinfos);
 		/*
@@ -2473,7 +3096,9 @@ try_add_gpujoin_paths(PlannerInfo *root,
 	if (join_type != JOIN_INNER &&
 		join_type != JOIN_FULL &&
 		join_type != JOIN_RIGHT &&
-		join_type != JOIN_LEFT)
+		join_type != JOIN_LEFT &&
+		join_type != JOIN_SEMI &&
+		join_type != JOIN_ANTI)
 		return;
 
 	/*
@@ -2546,10 +3171,15 @@ try_add_gpujoin_paths(PlannerInfo *root,
 								  join_type,
 								  restrict_clauses);
 	if (ip_item->hash_quals == NIL)
+	{
+		/* SEMI/ANTI JOIN is supported only by GpuHashJoin */
+		if (join_type == JOIN_SEMI || join_type == JOIN_ANTI)
+			return;
 		extract_gpugistindex_clause(ip_item,
 									root,
 									join_type,
 									restrict_clauses);
+	}
 	ip_item->join_nrows = joinrel->rows;
 	ip_items_list = list_make1(ip_item);
 
@@ -3095,6 +3725,7 @@ PlanGpuJoinPath(PlannerInfo *root,
 	codegen_context	context;
 	Plan		   *outer_plan;
 	ListCell	   *lc;
+	Relids			outer_relids;
 	double			outer_nrows;
 	int				i, k;
 
@@ -3140,6 +3771,14 @@ PlanGpuJoinPath(PlannerInfo *root,
 	}
 	gj_info.inner_parallel = gjpath->inner_parallel;
 
+	/*
+	 * Star-join that consists of only INNER hash-joins, and each of the join
+	 * clauses references only the outer relation and its inner relation,
+	 * allows to switch the depth order at run-time.
+	 */
+	outer_relids = ((Path *)linitial(gjpath->cpath.custom_paths))->parent->relids;
+	gj_info.join_reorderable = (gjpath->num_rels > 1);
+
 	outer_nrows = outer_plan->plan_rows;
 	for (i=0; i < gjpath->num_rels; i++)
 	{
@@ -3149,6 +3788,8 @@ PlanGpuJoinPath(PlannerInfo *root,
 		List	   *other_quals = NIL;
 		Oid			gist_index_reloid = InvalidOid;
 		int			gist_index_ctid_resno = -1;
+		Oid			gist_index_opclass = InvalidOid;
+		int			gist_index_key_resno = -1;
 		List	   *gist_index_clauses = NULL;
 
 		/* GpuHashJoin properties */
@@ -3193,6 +3834,19 @@ PlanGpuJoinPath(PlannerInfo *root,
 			gist_index_reloid = gist_index->indexoid;
 			gist_index_ctid_resno = gjpath->inners[i].gist_ctid_resno;
 			gist_index_clauses = gjpath->inners[i].gist_clauses;
+			if (!OidIsValid(gist_index_reloid))
+			{
+				const char *opcname = (gist_index->opcintype[0] == ANYRANGEOID
+									   ? SYNTHETIC_GIST_RANGE_OPCLASS_NAME
+									   : SYNTHETIC_GIST_OPCLASS_NAME);
+
+				gist_index_opclass =
+					lookup_synthetic_gist_opclass(opcname, NULL, NULL, NULL);
+				if (!OidIsValid(gist_index_opclass))
+					elog(ERROR, "Bug? operator class \"%s\" is not found",
+						 opcname);
+				gist_index_key_resno = gjpath->inners[i].gist_key_resno;
+			}
 		}
 
 		/*
@@ -3204,6 +3858,8 @@ PlanGpuJoinPath(PlannerInfo *root,
 									pmakeFloat(gjpath->inners[i].join_nrows));
 		gj_info.ichunk_size = lappend_int(gj_info.ichunk_size,
 										  gjpath->inners[i].ichunk_size);
+		gj_info.inner_nbatches = lappend_int(gj_info.inner_nbatches,
+											 gjpath->inners[i].nbatches);
 		gj_info.join_types = lappend_int(gj_info.join_types,
 										 gjpath->inners[i].join_type);
 
@@ -3219,16 +3875,36 @@ PlanGpuJoinPath(PlannerInfo *root,
 												false);
 			other_quals = NIL;
 		}
+		/* Is this depth reorderable? */
+		if (gj_info.join_reorderable)
+		{
+			RelOptInfo *inner_rel = gjpath->inners[i].scan_path->parent;
+			Relids		refs = pull_varnos((Node *)join_quals);
+
+			if (gjpath->inners[i].join_type != JOIN_INNER ||
+				hash_outer_keys == NIL ||
+				gjpath->inners[i].merge_join ||
+				gjpath->inners[i].gist_index != NULL ||
+				!bms_is_subset(refs, bms_union(outer_relids,
+											   inner_rel->relids)))
+				gj_info.join_reorderable = false;
+		}
 		gj_info.join_quals = lappend(gj_info.join_quals, join_quals);
 		gj_info.other_quals = lappend(gj_info.other_quals, other_quals);
 		gj_info.hash_inner_keys = lappend(gj_info.hash_inner_keys,
 										  hash_inner_keys);
 		gj_info.hash_outer_keys = lappend(gj_info.hash_outer_keys,
 										  hash_outer_keys);
+		gj_info.merge_join = lappend_int(gj_info.merge_join,
+										 gjpath->inners[i].merge_join);
 		gj_info.gist_index_reloid = lappend_oid(gj_info.gist_index_reloid,
 												gist_index_reloid);
 		gj_info.gist_index_ctid_resno = lappend_int(gj_info.gist_index_ctid_resno,
 													gist_index_ctid_resno);
+		gj_info.gist_index_opclass = lappend_oid(gj_info.gist_index_opclass,
+												 gist_index_opclass);
+		gj_info.gist_index_key_resno = lappend_int(gj_info.gist_index_key_resno,
+												   gist_index_key_resno);
 		gj_info.gist_index_clauses = lappend(gj_info.gist_index_clauses,
 											 gist_index_clauses);
 		outer_nrows = gjpath->inners[i].join_nrows;
@@ -3413,7 +4089,14 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	StringInfoData	kern_define;
 	ProgramId		program_id;
 
-	/* activate a GpuContext for CUDA kernel execution */
+	/*
+	 * activate a GpuContext for CUDA kernel execution.
+	 * If GpuPreAgg on the upper level already activated a GpuContext, GPU
+	 * device shall not be changed, because it may pull up the GpuJoin.
+	 */
+	if (!HasActiveGpuContext())
+		gj_info->optimal_gpu = RelationChooseOptimalGpu(ss->ss_currentRelation,
+														gj_info->optimal_gpu);
 	gjs->gts.gcontext = AllocGpuContext(gj_info->optimal_gpu, false, false);
 
 	/*
@@ -3438,6 +4121,7 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 							gjs->gts.gcontext,
 							GpuTaskKind_GpuJoin,
 							gj_info->outer_refs,
+							gj_info->outer_quals,
 							gj_info->used_params,
 							gj_info->optimal_gpu,
 							gj_info->outer_nrows_per_block,
@@ -3449,10 +4133,27 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	gjs->gts.cb_process_task	= gpujoin_process_task;
 	gjs->gts.cb_release_task	= gpujoin_release_task;
 
+	/*
+	 * Admission control by the estimated footprint of the device memory;
+	 * inner buffer of all the depth, and outer/result buffer in-flight.
+	 * Parallel workers share the budget admitted by the leader.
+	 */
+	if (!explain_only && !IsParallelWorker())
+	{
+		size_t		footprint = 2 * pgstrom_chunk_size();
+
+		foreach (lc1, gj_info->ichunk_size)
+			footprint += (cl_uint)lfirst_int(lc1);
+		gjs->gts.gm_budget_sz = gpuMemReserveBudget(gjs->gts.gcontext,
+													footprint);
+	}
+
 	/* DSM & GPU memory of inner buffer */
 	gjs->h_kmrels = NULL;
 	gjs->m_kmrels = 0UL;
 	gjs->m_kmrels_owner = false;
+	gjs->m_kmrels_managed = false;
+	gjs->inner_cache_index = -1;
 	gjs->inner_parallel = gj_info->inner_parallel;
 	gjs->preload_memcxt = AllocSetContextCreate(estate->es_query_cxt,
 												"Inner GPU Buffer Preloading",
@@ -3488,6 +4189,16 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	 */
 	gjs->num_rels = gj_info->num_rels;
 	gjs->join_types = gj_info->join_types;
+	/*
+	 * NOTE: CPU fallback resumes the suspended GpuJoin kernel according to
+	 * the pseudo-stack built in the planned depth order, so runtime switch
+	 * of the depth order is not available if CPU fallback is enabled.
+	 */
+	gjs->join_reorderable = (gj_info->join_reorderable &&
+							 enable_gpujoin_reorder &&
+							 !pgstrom_cpu_fallback_enabled);
+	if (gjs->join_reorderable)
+		gjs->depth_order = palloc0(sizeof(int) * (gjs->num_rels + 1));
 	if (gj_info->outer_quals)
 		gjs->outer_quals = ExecInitQual(gj_info->outer_quals, &ss->ps);
 	gjs->outer_ratio = gj_info->outer_ratio;
@@ -3624,6 +4335,8 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 		List	   *hash_outer_keys;
 		Oid			gist_index_reloid;
 		AttrNumber	gist_index_ctid_resno;
+		Oid			gist_index_opclass;
+		AttrNumber	gist_index_key_resno;
 		TupleDesc	inner_tupdesc;
 		double		plan_nrows_in;
 		double		plan_nrows_out;
@@ -3640,6 +4353,13 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 		istate->nrows_ratio = plan_nrows_out / Max(plan_nrows_in, 1.0);
 		istate->ichunk_size = list_nth_int(gj_info->ichunk_size, i);
 		istate->join_type = (JoinType)list_nth_int(gj_info->join_types, i);
+		istate->nbatches = list_nth_int(gj_info->inner_nbatches, i);
+		istate->curr_batch = 0;
+		if (istate->nbatches > 1)
+		{
+			Assert(gjs->batch_depth == 0);
+			gjs->batch_depth = istate->depth;
+		}
 
 		/*
 		 * NOTE: We need to deal with Var-node references carefully,
@@ -3687,6 +4407,41 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 				istate->hash_outer_keys =
 					lappend(istate->hash_outer_keys, o_expr_state);
 			}
+			/*
+			 * Single batch hash-join can skip the hash calculation on the
+			 * inner preloading; GPU kernel builds the hash-table instead.
+			 * Multi-batch needs hash value to choose the batch of tuples.
+			 */
+			istate->device_hash_build = (enable_gpujoin_device_hash_build &&
+										 istate->nbatches == 1);
+
+			/*
+			 * Merge-join sorts the inner rows by the join keys in the order
+			 * of the default btree operator class, on the inner preloading.
+			 */
+			istate->merge_join = list_nth_int(gj_info->merge_join, i);
+			if (istate->merge_join)
+			{
+				int		nkeys = list_length(hash_inner_keys);
+				int		k = 0;
+
+				Assert(istate->nbatches == 1);
+				istate->device_hash_build = false;
+				istate->merge_ssup = palloc0(sizeof(SortSupportData) * nkeys);
+				foreach (lc1, hash_inner_keys)
+				{
+					Node	   *i_expr = lfirst(lc1);
+					SortSupport	ssup = &istate->merge_ssup[k++];
+					TypeCacheEntry *tcache;
+
+					tcache = lookup_type_cache(exprType(i_expr),
+											   TYPECACHE_LT_OPR);
+					ssup->ssup_cxt = CurrentMemoryContext;
+					ssup->ssup_collation = exprCollation(i_expr);
+					ssup->ssup_nulls_first = false;
+					PrepareSortSupportFromOrderingOp(tcache->lt_opr, ssup);
+				}
+			}
 		}
 
 		gist_index_reloid = list_nth_oid(gj_info->gist_index_reloid, i);
@@ -3707,6 +4462,64 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 			istate->gist_ctid_resno = gist_index_ctid_resno;
 		}
 
+		gist_index_opclass = list_nth_oid(gj_info->gist_index_opclass, i);
+		gist_index_key_resno = list_nth_int(gj_info->gist_index_key_resno, i);
+		if (OidIsValid(gist_index_opclass))
+		{
+			TargetEntry	*tle;
+			Var		   *var;
+			HeapTuple	tup;
+			Form_pg_opclass opcform;
+			Oid			compress_proc;
+
+			tup = SearchSysCache1(CLAOID, ObjectIdGetDatum(gist_index_opclass));
+			if (!HeapTupleIsValid(tup))
+				elog(ERROR, "cache lookup failed for opclass %u",
+					 gist_index_opclass);
+			opcform = (Form_pg_opclass) GETSTRUCT(tup);
+
+			if (gist_index_key_resno < 1 ||
+				gist_index_key_resno > list_length(inner_plan->targetlist))
+				elog(ERROR, "GPU-GiST: inner index key is out of range");
+			tle = list_nth(inner_plan->targetlist, gist_index_key_resno - 1);
+			var = (Var *)tle->expr;
+			if (!IsA(tle->expr, Var) ||
+				(opcform->opcintype == ANYRANGEOID
+				 ? !type_is_range(var->vartype)
+				 : var->vartype != opcform->opcintype))
+				elog(ERROR, "GPU-GiST: wrong Var-definition for inner index key");
+			istate->gist_key_resno = gist_index_key_resno;
+
+			istate->gist_itupdesc = CreateTemplateTupleDesc(1);
+			if (opcform->opcintype == ANYRANGEOID)
+			{
+				/* range_ops stores the range value as is */
+				istate->gist_rngtyp = lookup_type_cache(var->vartype,
+														TYPECACHE_RANGE_INFO);
+				TupleDescInitEntry(istate->gist_itupdesc, (AttrNumber) 1,
+								   "key", var->vartype, var->vartypmod, 0);
+			}
+			else
+			{
+				compress_proc = get_opfamily_proc(opcform->opcfamily,
+												  opcform->opcintype,
+												  opcform->opcintype,
+												  GIST_COMPRESS_PROC);
+				if (!OidIsValid(compress_proc))
+					elog(ERROR, "GPU-GiST: no compress function in opclass \"%s\"",
+						 NameStr(opcform->opcname));
+				fmgr_info(compress_proc, &istate->gist_compress);
+
+				TupleDescInitEntry(istate->gist_itupdesc, (AttrNumber) 1,
+								   "key", opcform->opckeytype, -1, 0);
+				if (tupleDescAttr(istate->gist_itupdesc, 0)->attlen !=
+					sizeof(synthGistBox))
+					elog(ERROR, "GPU-GiST: unexpected storage type of opclass \"%s\"",
+						 NameStr(opcform->opcname));
+			}
+			ReleaseSysCache(tup);
+		}
+
 		/*
 		 * CPU fallback setup for INNER reference
 		 */
@@ -3735,6 +4548,24 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 				else
 					attr = SystemAttributeDefinition(resno);
 				
+				/*
+				 * GpuNestLoop and GiST-join evaluate join quals for each
+				 * pair of rows, so fixed-length inner attributes referenced
+				 * by the quals are preloaded in columnar format also.
+				 */
+				if (enable_gpujoin_inner_columns &&
+					istate->hash_inner_keys == NIL &&
+					!istate->merge_join &&
+					resno > 0 &&
+					attr->attlen > 0 &&
+					att_align_nominal(attr->attlen,
+									  attr->attalign) == attr->attlen &&
+					(refby & (GPUJOIN_ATTR_REFERENCE_BY__JOIN_QUALS |
+							  GPUJOIN_ATTR_REFERENCE_BY__OTHER_QUALS)) != 0)
+					istate->preload_column_attrs =
+						bms_add_member(istate->preload_column_attrs,
+									   resno - 1);
+
 				if (istate->inner_src_anum_min > resno)
 					istate->inner_src_anum_min = resno;
 				if (istate->inner_src_anum_max < resno)
@@ -3772,6 +4603,10 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	gjs->gts.program_id = program_id;
 	pfree(kern_define.data);
 
+	/* check whether the inner buffer is cacheable */
+	if (!explain_only)
+		gjs->inner_cache_key = innerPreloadCacheKey(gjs, gj_info);
+
 	/* expected kresults buffer expand rate */
 	gjs->result_width =
 		MAXALIGN(offsetof(HeapTupleHeaderData,
@@ -3842,6 +4677,7 @@ static void
 ExecReScanGpuJoin(CustomScanState *node)
 {
 	GpuJoinState   *gjs = (GpuJoinState *) node;
+	bool			inner_rebuild = false;
 	cl_int			i;
 
 	/* wait for completion of any asynchronous GpuTask */
@@ -3854,6 +4690,12 @@ ExecReScanGpuJoin(CustomScanState *node)
 	/*
 	 * NOTE: ExecReScan() does not pay attention on the PlanState within
 	 * custom_ps, so we need to assign its chgParam by ourself.
+	 *
+	 * If no inner plans depend on the changed parameters, like the case
+	 * when only the outer side of a NestLoop or a correlated SubPlan is
+	 * parameterized, the inner hash/heap buffer is kept with its device
+	 * memory and the IPC handle for parallel workers. RIGHT/FULL OUTER JOIN
+	 * still rebuilds the buffer, because the outer-join-map is accumulated.
 	 */
 	if (gjs->gts.css.ss.ps.chgParam != NULL)
 	{
@@ -3861,13 +4703,35 @@ ExecReScanGpuJoin(CustomScanState *node)
 		{
 			innerState *istate = &gjs->inners[i];
 
-			UpdateChangedParamSet(gjs->inners[i].state,
+			UpdateChangedParamSet(istate->state,
 								  gjs->gts.css.ss.ps.chgParam);
 			if (istate->state->chgParam != NULL)
-				ExecReScan(istate->state);
+				inner_rebuild = true;
 		}
-		/* rewind the inner hash/heap buffer */
+		if (gjs->h_kmrels && gjs->h_kmrels->ojmaps_length > 0)
+			inner_rebuild = true;
+	}
+
+	if (inner_rebuild)
+	{
+		/* rewind the inner hash/heap buffer, then rescan all the inners */
 		GpuJoinInnerUnload(&gjs->gts, true);
+		if (gjs->gj_sstate && (!gjs->sibling || gjs->sibling->leader == gjs))
+			resetGpuJoinSharedState(gjs);
+		gjs->outer_scan_detached = false;
+		gjs->outer_join_depth = 0;
+		for (i=0; i < gjs->num_rels; i++)
+			ExecReScan(gjs->inners[i].state);
+	}
+	else
+	{
+		/* multi-batch hash-join has to restart from the first batch */
+		if (gjs->batch_depth > 0 &&
+			gjs->inners[gjs->batch_depth - 1].curr_batch != 0 &&
+			gjs->h_kmrels != NULL)
+			gpujoinSwitchInnerBatch(gjs, 0);
+		if (gjs->gj_sstate)
+			pg_atomic_write_u32(&gjs->gj_sstate->outer_scan_done, 0);
 	}
 	/* common rescan handling */
 	pgstromRescanGpuTaskState(&gjs->gts);
@@ -3950,6 +4814,9 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		ExplainPropertyInteger("Inner sibling-id", NULL,
 							   gj_info->sibling_param_id, es);
 	}
+	/* inner buffer is built by all the participants */
+	if (gj_info->inner_parallel && es->verbose)
+		ExplainPropertyText("Inner Build", "Parallel", es);
 
 	/* join-qualifiers */
 	depth = 1;
@@ -3969,6 +4836,9 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		innerState *istate = &gjs->inners[depth-1];
 		kern_data_store *kds_in = NULL;
 		kern_data_store *kds_gist = NULL;
+		size_t			bloom_sz = 0;
+		size_t			bucket_sz = 0;
+		size_t			column_sz = 0;
 		int			indent_width;
 		double		plan_nrows_in;
 		double		plan_nrows_out;
@@ -3981,6 +4851,30 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		{
 			kds_in = KERN_MULTIRELS_INNER_KDS(gjs->h_kmrels, depth);
 			kds_gist = KERN_MULTIRELS_GIST_INDEX(gjs->h_kmrels, depth);
+			if (KERN_MULTIRELS_BLOOM_FILTER(gjs->h_kmrels, depth))
+				bloom_sz = (GPUJOIN_BLOOM_BLOCK_SIZE *
+							gjs->h_kmrels->chunks[depth-1].bloom_nblocks);
+			if (KERN_MULTIRELS_HASH_BUCKET(gjs->h_kmrels, depth))
+				bucket_sz = (GPUJOIN_HASH_BUCKET_SIZE *
+							 gjs->h_kmrels->chunks[depth-1].bucket_nbuckets);
+			if (KERN_MULTIRELS_INNER_COLUMNS(gjs->h_kmrels, depth))
+			{
+				kern_inner_columns *icols
+					= KERN_MULTIRELS_INNER_COLUMNS(gjs->h_kmrels, depth);
+				cl_uint		k;
+
+				column_sz = STROMALIGN(offsetof(kern_inner_columns,
+												colattrs[icols->ncols]));
+				for (k=0; k < icols->ncols; k++)
+				{
+					if (icols->colattrs[k].values_offset == 0)
+						continue;
+					column_sz += (STROMALIGN(sizeof(cl_uint) *
+											 ((icols->nrooms + 31) / 32)) +
+								  STROMALIGN((size_t)icols->colattrs[k].attlen *
+											 (size_t)icols->nrooms));
+				}
+			}
 		}
 
 		/* fetch number of rows */
@@ -3999,13 +4893,22 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		}
 
 		resetStringInfo(&str);
-		if (hash_outer_key != NULL)
+		if (istate->merge_join)
 		{
-			appendStringInfo(&str, "GpuHash%sJoin",
+			appendStringInfo(&str, "GpuMerge%sJoin",
 							 join_type == JOIN_FULL ? "Full" :
 							 join_type == JOIN_LEFT ? "Left" :
 							 join_type == JOIN_RIGHT ? "Right" : "");
 		}
+		else if (hash_outer_key != NULL)
+		{
+			appendStringInfo(&str, "GpuHash%sJoin",
+							 join_type == JOIN_FULL ? "Full" :
+							 join_type == JOIN_LEFT ? "Left" :
+							 join_type == JOIN_RIGHT ? "Right" :
+							 join_type == JOIN_SEMI ? "Semi" :
+							 join_type == JOIN_ANTI ? "Anti" : "");
+		}
 		else if (gist_index_clauses != NULL)
 		{
 			appendStringInfo(&str, "GpuGiST%sJoin",
@@ -4053,13 +4956,15 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 			if (!kds_in)
 			{
 				appendStringInfo(es->str, "%sSize: %s",
-								 hash_outer_key ? "Hash" : "Heap",
+								 hash_outer_key && !istate->merge_join
+								 ? "Hash" : "Heap",
 								 format_bytesz(istate->ichunk_size));
 			}
 			else
 			{
 				appendStringInfo(es->str, "%sSize: %s (estimated: %s)",
-								 hash_outer_key ? "Hash" : "Heap",
+								 hash_outer_key && !istate->merge_join
+								 ? "Hash" : "Heap",
 								 format_bytesz(kds_in->length),
 								 format_bytesz(istate->ichunk_size));
 			}
@@ -4068,6 +4973,17 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 				appendStringInfo(es->str, ", IndexSize: %s",
 								 format_bytesz(kds_gist->length));
 			}
+			if (istate->nbatches > 1)
+				appendStringInfo(es->str, ", Batches: %d", istate->nbatches);
+			if (bloom_sz > 0)
+				appendStringInfo(es->str, ", BloomFilter: %s",
+								 format_bytesz(bloom_sz));
+			if (bucket_sz > 0)
+				appendStringInfo(es->str, ", HashBucket: %s",
+								 format_bytesz(bucket_sz));
+			if (column_sz > 0)
+				appendStringInfo(es->str, ", InnerColumns: %s",
+								 format_bytesz(column_sz));
 			appendStringInfoChar(es->str, '\n');
 		}
 		else
@@ -4102,6 +5018,26 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 
 			snprintf(qlabel, sizeof(qlabel), "Depth % 2d KDS Plan Size", depth);
 			ExplainPropertyInteger(qlabel, NULL, istate->ichunk_size, es);
+			if (istate->nbatches > 1)
+			{
+				snprintf(qlabel, sizeof(qlabel), "Depth % 2d Batches", depth);
+				ExplainPropertyInteger(qlabel, NULL, istate->nbatches, es);
+			}
+			if (bloom_sz > 0)
+			{
+				snprintf(qlabel, sizeof(qlabel), "Depth % 2d Bloom Filter Size", depth);
+				ExplainPropertyInteger(qlabel, NULL, bloom_sz, es);
+			}
+			if (bucket_sz > 0)
+			{
+				snprintf(qlabel, sizeof(qlabel), "Depth % 2d Hash Bucket Size", depth);
+				ExplainPropertyInteger(qlabel, NULL, bucket_sz, es);
+			}
+			if (column_sz > 0)
+			{
+				snprintf(qlabel, sizeof(qlabel), "Depth % 2d Inner Columns Size", depth);
+				ExplainPropertyInteger(qlabel, NULL, column_sz, es);
+			}
 			if (kds_in)
 			{
 				snprintf(qlabel, sizeof(qlabel), "Depth % 2d KDS Exec Size", depth);
@@ -4124,19 +5060,22 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 			if (es->format == EXPLAIN_FORMAT_TEXT)
 			{
 				appendStringInfoSpaces(es->str, indent_width);
-				appendStringInfo(es->str, "HashKeys: %s\n", temp);
+				appendStringInfo(es->str, "%sKeys: %s\n",
+								 istate->merge_join ? "Merge" : "Hash", temp);
 			}
 			else
 			{
 				snprintf(qlabel, sizeof(qlabel),
-						 "Depth% 2d HashKeys", depth);
+						 "Depth% 2d %sKeys", depth,
+						 istate->merge_join ? "Merge" : "Hash");
 				ExplainPropertyText(qlabel, temp, es);
 			}
 		}
 		/*
 		 * GiST Index, if any
 		 */
-		if (OidIsValid(gist_index_reloid) && gist_index_clauses != NIL)
+		if ((OidIsValid(gist_index_reloid) ||
+			 istate->gist_itupdesc != NULL) && gist_index_clauses != NIL)
 		{
 			const char *iname;
 			Node	   *clause;
@@ -4147,7 +5086,10 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 				clause = linitial(gist_index_clauses);
 
 			temp = deparse_expression(clause, dcontext, true, false);
-			iname = get_rel_name(gist_index_reloid);
+			if (OidIsValid(gist_index_reloid))
+				iname = get_rel_name(gist_index_reloid);
+			else
+				iname = "synthetic R-tree";
 			if (es->format == EXPLAIN_FORMAT_TEXT)
 			{
 				appendStringInfoSpaces(es->str, indent_width);
@@ -4219,7 +5161,17 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		}
 		depth++;
 	}
-	/* other common field */
+	/* depth order switched at run-time, if any */
+	if (es->analyze && gjs->depth_reordered)
+	{
+		resetStringInfo(&str);
+		for (depth=1; depth <= gjs->num_rels; depth++)
+			appendStringInfo(&str, "%s%d",
+							 depth > 1 ? ", " : "",
+							 gjs->depth_order[depth]);
+		ExplainPropertyText("Depth Order", str.data, es);
+	}
+	/* other common field */
 	pgstromExplainGpuTaskState(&gjs->gts, es);
 }
 
@@ -4322,6 +5274,9 @@ ExecShutdownGpuJoin(CustomScanState *node)
 	GpuJoinSharedState *gj_sstate_new;
 	size_t			i, length;
 
+	/* tasks not launched yet shall not occupy GPU (e.g, LIMIT satisfied) */
+	pgstromSuspendGpuTaskState(&gjs->gts);
+
 	/*
 	 * If this GpuJoin node is located under the inner side of another
 	 * GpuJoin, it should not be called under the background worker
@@ -4330,6 +5285,13 @@ ExecShutdownGpuJoin(CustomScanState *node)
 	if (!gj_sstate_old)
 		return;
 
+	/*
+	 * Detach from the outer scan, if terminated prior to RIGHT/FULL OUTER
+	 * JOIN, not to make other workers wait for this process.
+	 */
+	if (!gjs->sibling)
+		gpujoinDetachOuterJoin(gjs, gj_sstate_old);
+
 	/* parallel worker put runtime-stat on ExecEnd handler */
 	if (IsParallelWorker())
 	{
@@ -4516,8 +5478,9 @@ pgstrom_codegen_var_declarations(StringInfo source,
 			}
 			appendStringInfo(
 				decl,
-				"    datum = GPUJOIN_REF_DATUM(kds_in->colmeta,i_htup,%u);\n"
+				"    datum = gpujoin_inner_datum(kmrels,%u,kds_in,i_htup,%u);\n"
 				"    pg_datum_ref(kcxt,KVAR_%u,datum); //pg_%s_t\n",
+				depth,
 				kvar->varattno - 1,
 				kvar->varoattno,
 				dtype->type_name);
@@ -4829,6 +5792,249 @@ gpujoin_codegen_hash_value(StringInfo source,
 	pfree(body.data);
 }
 
+/*
+ * codegen for:
+ * STATIC_FUNCTION(cl_uint)
+ * gpujoin_inner_hash_value_depth%u(kern_context *kcxt,
+ *                                  kern_multirels *kmrels,
+ *                                  HeapTupleHeaderData *i_htup,
+ *                                  cl_bool *is_null_keys)
+ */
+static void
+gpujoin_codegen_inner_hash_value(StringInfo source,
+								 GpuJoinInfo *gj_info,
+								 int cur_depth,
+								 codegen_context *context)
+{
+	StringInfoData	decl;
+	StringInfoData	body;
+	List		   *hash_inner_keys;
+	List		   *type_oid_list = NIL;
+	ListCell	   *lc;
+
+	Assert(cur_depth > 0 && cur_depth <= gj_info->num_rels);
+	hash_inner_keys = list_nth(gj_info->hash_inner_keys, cur_depth - 1);
+	Assert(hash_inner_keys != NIL);
+
+	initStringInfo(&decl);
+	initStringInfo(&body);
+
+	appendStringInfo(
+		&decl,
+		"  cl_uint hash = 0xffffffffU;\n"
+		"  cl_bool is_null_keys = true;\n");
+
+	context->used_vars = NIL;
+	context->param_refs = NULL;
+	resetStringInfo(&context->decl_temp);
+	foreach (lc, hash_inner_keys)
+	{
+		Node	   *key_expr = lfirst(lc);
+		Oid			key_type = exprType(key_expr);
+		devtype_info *dtype;
+
+		dtype = pgstrom_devtype_lookup(key_type);
+		if (!dtype)
+			elog(ERROR, "Bug? device type \"%s\" not found",
+                 format_type_be(key_type));
+		appendStringInfo(
+			&body,
+			"  temp.%s_v = %s;\n"
+			"  if (!temp.%s_v.isnull)\n"
+			"  {\n"
+			"    is_null_keys = false;\n"
+			"    hash ^= pg_comp_hash(kcxt, temp.%s_v);\n"
+			"  }\n",
+			dtype->type_name,
+			pgstrom_codegen_expression(key_expr, context),
+			dtype->type_name,
+			dtype->type_name);
+		type_oid_list = list_append_unique_oid(type_oid_list,
+											   dtype->type_oid);
+	}
+
+	/*
+	 * variable/params declaration & initialization; all the variables
+	 * come from the i_htup of the current depth.
+	 */
+	pgstrom_union_type_declarations(&decl, "temp", type_oid_list);
+	gpujoin_codegen_var_param_decl(&decl, gj_info,
+								   cur_depth, context);
+	appendStringInfo(
+		source,
+		"STATIC_FUNCTION(cl_uint)\n"
+		"gpujoin_inner_hash_value_depth%u(kern_context *kcxt,\n"
+		"                                kern_multirels *kmrels,\n"
+		"                                HeapTupleHeaderData *i_htup,\n"
+		"                                cl_bool *p_is_null_keys)\n"
+		"{\n"
+		"%s%s%s"
+		"  *p_is_null_keys = is_null_keys;\n"
+		"  hash ^= 0xffffffff;\n"
+		"  return hash;\n"
+		"}\n"
+		"\n",
+		cur_depth,
+		decl.data,
+		context->decl_temp.data,
+		body.data);
+	pfree(decl.data);
+	pfree(body.data);
+}
+
+/*
+ * codegen for:
+ * STATIC_FUNCTION(cl_int)
+ * gpujoin_merge_keycomp_depth%u(kern_context *kcxt,
+ *                               kern_data_store *kds,
+ *                               kern_data_extra *extra,
+ *                               kern_multirels *kmrels,
+ *                               cl_int *o_buffer,
+ *                               HeapTupleHeaderData *i_htup,
+ *                               cl_bool *is_null_keys)
+ */
+static void
+gpujoin_codegen_merge_keycomp(StringInfo source,
+							  GpuJoinInfo *gj_info,
+							  int cur_depth,
+							  codegen_context *context)
+{
+	StringInfoData	decl;
+	StringInfoData	body;
+	List		   *hash_outer_keys;
+	List		   *hash_inner_keys;
+	List		   *type_oid_list = NIL;
+	ListCell	   *lc1, *lc2;
+
+	Assert(cur_depth > 0 && cur_depth <= gj_info->num_rels);
+	hash_outer_keys = list_nth(gj_info->hash_outer_keys, cur_depth - 1);
+	hash_inner_keys = list_nth(gj_info->hash_inner_keys, cur_depth - 1);
+	Assert(hash_outer_keys != NIL &&
+		   list_length(hash_outer_keys) == list_length(hash_inner_keys));
+
+	initStringInfo(&decl);
+	initStringInfo(&body);
+
+	appendStringInfo(
+		&decl,
+		"  pg_int4_t comp;\n");
+
+	context->used_vars = NIL;
+	context->param_refs = NULL;
+	resetStringInfo(&context->decl_temp);
+	forboth (lc1, hash_outer_keys,
+			 lc2, hash_inner_keys)
+	{
+		Node	   *o_expr = lfirst(lc1);
+		Node	   *i_expr = lfirst(lc2);
+		Oid			key_type = exprType(o_expr);
+		devtype_info *dtype;
+		devfunc_info *dfunc;
+		devtype_info *darg1;
+		devtype_info *darg2;
+		char	   *cast_darg1 = NULL;
+		char	   *cast_darg2 = NULL;
+
+		dtype = pgstrom_devtype_lookup_and_track(key_type, context);
+		if (!dtype)
+			elog(ERROR, "Bug? device type \"%s\" not found",
+				 format_type_be(key_type));
+		dfunc = pgstrom_devfunc_lookup_type_compare(dtype,
+													exprCollation(o_expr));
+		if (!dfunc)
+			elog(ERROR, "Bug? type (%s) has no device comparison function",
+				 format_type_be(key_type));
+		pgstrom_devfunc_track(context, dfunc);
+		darg1 = linitial(dfunc->func_args);
+		darg2 = lsecond(dfunc->func_args);
+		if (dtype->type_oid != darg1->type_oid)
+		{
+			if (!pgstrom_devtype_can_relabel(dtype->type_oid,
+											 darg1->type_oid))
+				elog(ERROR, "Bug? no binary compatible cast for %s -> %s",
+					 format_type_be(dtype->type_oid),
+					 format_type_be(darg1->type_oid));
+			cast_darg1 = psprintf("to_%s", darg1->type_name);
+		}
+		if (dtype->type_oid != darg2->type_oid)
+		{
+			if (!pgstrom_devtype_can_relabel(dtype->type_oid,
+											 darg2->type_oid))
+				elog(ERROR, "Bug? no binary compatible cast for %s -> %s",
+					 format_type_be(dtype->type_oid),
+					 format_type_be(darg2->type_oid));
+			cast_darg2 = psprintf("to_%s", darg2->type_name);
+		}
+
+		/*
+		 * NULL outer key never matches to any inner rows, and NULL inner
+		 * keys are sorted to the tail of the index.
+		 */
+		appendStringInfo(
+			&body,
+			"  o_temp.%s_v = %s;\n"
+			"  if (o_temp.%s_v.isnull)\n"
+			"  {\n"
+			"    *p_is_null_keys = true;\n"
+			"    return 0;\n"
+			"  }\n",
+			dtype->type_name,
+			pgstrom_codegen_expression(o_expr, context),
+			dtype->type_name);
+		appendStringInfo(
+			&body,
+			"  i_temp.%s_v = %s;\n"
+			"  if (i_temp.%s_v.isnull)\n"
+			"    return -1;\n"
+			"  comp = pgfn_%s(kcxt, %s(o_temp.%s_v), %s(i_temp.%s_v));\n"
+			"  if (!comp.isnull && comp.value != 0)\n"
+			"    return comp.value;\n",
+			dtype->type_name,
+			pgstrom_codegen_expression(i_expr, context),
+			dtype->type_name,
+			dfunc->func_devname,
+			cast_darg1 ? cast_darg1 : "", dtype->type_name,
+			cast_darg2 ? cast_darg2 : "", dtype->type_name);
+		type_oid_list = list_append_unique_oid(type_oid_list,
+											   dtype->type_oid);
+		if (cast_darg1)
+			pfree(cast_darg1);
+		if (cast_darg2)
+			pfree(cast_darg2);
+	}
+
+	/*
+	 * variable/params declaration & initialization
+	 */
+	pgstrom_union_type_declarations(&decl, "o_temp", type_oid_list);
+	pgstrom_union_type_declarations(&decl, "i_temp", type_oid_list);
+	gpujoin_codegen_var_param_decl(&decl, gj_info,
+								   cur_depth, context);
+	appendStringInfo(
+		source,
+		"STATIC_FUNCTION(cl_int)\n"
+		"gpujoin_merge_keycomp_depth%u(kern_context *kcxt,\n"
+		"                             kern_data_store *kds,\n"
+		"                             kern_data_extra *extra,\n"
+		"                             kern_multirels *kmrels,\n"
+		"                             cl_uint *o_buffer,\n"
+		"                             HeapTupleHeaderData *i_htup,\n"
+		"                             cl_bool *p_is_null_keys)\n"
+		"{\n"
+		"%s%s"
+		"  *p_is_null_keys = false;\n"
+		"%s"
+		"  return 0;\n"
+		"}\n"
+		"\n",
+		cur_depth,
+		decl.data,
+		context->decl_temp.data,
+		body.data);
+	pfree(decl.data);
+	pfree(body.data);
+}
+
 /*
  * gpujoin_codegen_gist_index_quals
  */
@@ -5708,7 +6914,8 @@ gpujoin_codegen(PlannerInfo *root,
 						  context,
 						  "gpujoin",
 						  cscan->scan.scanrelid,
-						  gj_info->outer_quals);
+						  gj_info->outer_quals,
+						  NULL);
 	varlena_bufsz = context->varlena_bufsz;
 
 	/*
@@ -5810,6 +7017,107 @@ gpujoin_codegen(PlannerInfo *root,
 		"}\n"
 		"\n");
 
+	/*
+	 * gpujoin_inner_hash_value
+	 */
+	depth = 1;
+	foreach (cell, gj_info->hash_inner_keys)
+	{
+		if (lfirst(cell) != NULL)
+		{
+			context->varlena_bufsz = 0;
+			gpujoin_codegen_inner_hash_value(&source, gj_info, depth, context);
+			varlena_bufsz = Max(varlena_bufsz, context->varlena_bufsz);
+		}
+		depth++;
+	}
+
+	appendStringInfo(
+		&source,
+		"DEVICE_FUNCTION(cl_uint)\n"
+		"gpujoin_inner_hash_value(kern_context *kcxt,\n"
+		"                         kern_multirels *kmrels,\n"
+		"                         cl_int depth,\n"
+		"                         HeapTupleHeaderData *i_htup,\n"
+		"                         cl_bool *is_null_keys)\n"
+		"{\n"
+		"  switch (depth)\n"
+		"  {\n");
+	depth = 1;
+	foreach (cell, gj_info->hash_inner_keys)
+	{
+		if (lfirst(cell) != NULL)
+		{
+			appendStringInfo(
+				&source,
+				"  case %u:\n"
+				"    return gpujoin_inner_hash_value_depth%u(kcxt,kmrels,\n"
+				"                                            i_htup,is_null_keys);\n",
+				depth, depth);
+		}
+		depth++;
+	}
+	appendStringInfo(
+		&source,
+		"  default:\n"
+		"    STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,\n"
+		"                  \"GpuJoin: wrong code generation\");\n"
+		"    break;\n"
+		"  }\n"
+		"  return (cl_uint)(-1);\n"
+		"}\n"
+		"\n");
+
+	/*
+	 * gpujoin_merge_keycomp
+	 */
+	for (depth=1; depth <= gj_path->num_rels; depth++)
+	{
+		if (!gj_path->inners[depth-1].merge_join)
+			continue;
+		context->varlena_bufsz = 0;
+		gpujoin_codegen_merge_keycomp(&source, gj_info, depth, context);
+		varlena_bufsz = Max(varlena_bufsz, context->varlena_bufsz);
+	}
+
+	appendStringInfo(
+		&source,
+		"DEVICE_FUNCTION(cl_int)\n"
+		"gpujoin_merge_keycomp(kern_context *kcxt,\n"
+		"                      kern_data_store *kds,\n"
+		"                      kern_data_extra *extra,\n"
+		"                      kern_multirels *kmrels,\n"
+		"                      cl_int depth,\n"
+		"                      cl_uint *o_buffer,\n"
+		"                      HeapTupleHeaderData *i_htup,\n"
+		"                      cl_bool *is_null_keys)\n"
+		"{\n"
+		"  switch (depth)\n"
+		"  {\n");
+	for (depth=1; depth <= gj_path->num_rels; depth++)
+	{
+		if (!gj_path->inners[depth-1].merge_join)
+			continue;
+		appendStringInfo(
+			&source,
+			"  case %u:\n"
+			"    return gpujoin_merge_keycomp_depth%u(kcxt,kds,extra,kmrels,\n"
+			"                                         o_buffer,i_htup,\n"
+			"                                         is_null_keys);\n",
+			depth, depth);
+	}
+	appendStringInfo(
+		&source,
+		"  default:\n"
+		"    STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,\n"
+		"                  \"GpuJoin: wrong code generation\");\n"
+		"    break;\n"
+		"  }\n"
+		"  *is_null_keys = true;\n"
+		"  return 0;\n"
+		"}\n"
+		"\n");
+
 	/*
 	 * gpujoin_gist_load_keys / gpujoin_gist_check_quals
 	 */
@@ -5902,12 +7210,78 @@ gpujoin_codegen(PlannerInfo *root,
 	gpujoin_codegen_projection(&source, cscan, gj_info, context);
 	varlena_bufsz = Max(varlena_bufsz, context->varlena_bufsz);
 
+	/* pseudo-stack rearranged to the planned order, if reorderable */
+	if (gj_info->join_reorderable)
+		varlena_bufsz += MAXALIGN(sizeof(cl_uint) * (gj_info->num_rels + 1));
 	/* required varlena buffer size */
 	gj_info->varlena_bufsz = varlena_bufsz;
 
 	return source.data;
 }
 
+/*
+ * gpujoin_setup_depth_order
+ *
+ * Once the first outer chunks are processed in the planned depth order, it
+ * estimates selectivity of each depth (by the ratio of nitems out/in), then
+ * switches the depth order for the remaining chunks to join the most
+ * selective depth first. Only reorderable (star-join of INNER hash-joins)
+ * GpuJoin can run any depth order, because join clauses of each depth
+ * reference only the outer relation and its own inner relation.
+ */
+static void
+gpujoin_setup_depth_order(GpuJoinState *gjs, kern_gpujoin *kgjoin)
+{
+	GpuJoinRuntimeStat *gj_rtstat = GPUJOIN_RUNTIME_STAT(gjs->gj_sstate);
+	cl_int		num_rels = gjs->num_rels;
+	cl_int		i, j;
+
+	if (!gjs->depth_order_fixed)
+	{
+		int		   *depth_order = gjs->depth_order;
+		double	   *selectivity;
+		uint64		nitems_in;
+		uint64		nitems_out;
+
+		if (pg_atomic_read_u64(&gj_rtstat->sample_nchunks) <
+			GPUJOIN_REORDER_SAMPLE_NCHUNKS)
+			return;
+
+		selectivity = palloc(sizeof(double) * (num_rels + 1));
+		nitems_in = pg_atomic_read_u64(&gj_rtstat->jstat[0].sample_nitems);
+		for (i=1; i <= num_rels; i++)
+		{
+			nitems_out = pg_atomic_read_u64(&gj_rtstat->jstat[i].sample_nitems);
+			if (nitems_in > 0)
+				selectivity[i] = (double)nitems_out / (double)nitems_in;
+			else
+				selectivity[i] = 1.0;	/* unknown */
+			nitems_in = nitems_out;
+		}
+		/* stable sort by the selectivity; ties keep the planned order */
+		for (i=1; i <= num_rels; i++)
+		{
+			for (j=i-1; j >= 1 && selectivity[depth_order[j]] > selectivity[i]; j--)
+				depth_order[j+1] = depth_order[j];
+			depth_order[j+1] = i;
+		}
+		for (i=1; i <= num_rels; i++)
+		{
+			if (depth_order[i] != i)
+				gjs->depth_reordered = true;
+		}
+		gjs->depth_order_fixed = true;
+		pfree(selectivity);
+	}
+
+	if (gjs->depth_reordered)
+	{
+		kgjoin->depth_reordered = true;
+		for (i=1; i <= num_rels; i++)
+			kgjoin->stat[i-1].depth = gjs->depth_order[i];
+	}
+}
+
 /*
  * GpuJoinSetupTask
  */
@@ -5939,6 +7313,18 @@ GpuJoinSetupTask(struct kern_gpujoin *kgjoin, GpuTaskState *gts,
 		kgjoin->suspend_size	= mp_count * suspend_sz;
 		kgjoin->num_rels		= gjs->num_rels;
 		kgjoin->src_read_pos	= 0;
+		kgjoin->outer_row_base	= 0;
+		kgjoin->outer_row_end	= UINT_MAX;
+		/* range of the inner rows claimed for RIGHT/FULL OUTER JOIN */
+		if (!pds_src && gjs->outer_join_depth > 0)
+		{
+			kgjoin->src_read_pos	= gjs->outer_join_row_base;
+			kgjoin->outer_row_base	= gjs->outer_join_row_base;
+			kgjoin->outer_row_end	= gjs->outer_join_row_end;
+		}
+		/* runtime switch of the depth order, if reorderable */
+		if (pds_src && gjs->join_reorderable)
+			gpujoin_setup_depth_order(gjs, kgjoin);
 
 		/* kern_parambuf */
 		memcpy(KERN_GPUJOIN_PARAMBUF(kgjoin),
@@ -5962,28 +7348,65 @@ gpujoin_create_task(GpuJoinState *gjs,
 	TupleDesc		scan_tupdesc = scan_slot->tts_tupleDescriptor;
 	GpuContext	   *gcontext = gjs->gts.gcontext;
 	GpuJoinTask	   *pgjoin;
+	GpuMemArena	   *arena;
 	Size			required;
-	CUdeviceptr		m_deviceptr;
+	Size			result_length = pgstrom_chunk_size();
 	CUresult		rc;
 
 	Assert(pds_src || (outer_depth > 0 && outer_depth <= gjs->num_rels));
 
+	/*
+	 * Adaptive sizing of the result buffer. Once an outer chunk overflows
+	 * the result buffer, GpuJoin kernel suspends, then the partial result
+	 * is returned and the kernel is relaunched with a new buffer.
+	 * To avoid the repeated relaunches on the join with large fan-out, we
+	 * allocate the result buffer based on the length consumed by the prior
+	 * outer chunks, by multiple of the chunk size because gpu_mmgr.c caches
+	 * the recently released buffer of identical length.
+	 */
+	if (pds_src)
+	{
+		GpuJoinRuntimeStat *gj_rtstat = GPUJOIN_RUNTIME_STAT(gjs->gj_sstate);
+		uint64		nchunks = pg_atomic_read_u64(&gj_rtstat->result_nchunks);
+
+		if (nchunks > 0)
+		{
+			uint64	length = (pg_atomic_read_u64(&gj_rtstat->result_length) /
+							  nchunks);
+
+			length += length / 4;	/* 25% margin */
+			length = TYPEALIGN(pgstrom_chunk_size(), length);
+			result_length = Min(Max(length, pgstrom_chunk_size()),
+								(uint64)pgstrom_chunk_size() *
+								GPUJOIN_RESULT_BUFFER_MAX_SCALE);
+		}
+	}
+
+	/*
+	 * GpuJoinTask (kern_gpujoin with pseudo-stack and suspend contexts)
+	 * and the result buffer are sub-allocated on a task arena, to track
+	 * the managed memory once per task.
+	 */
 	required = GpuJoinSetupTask(NULL, &gjs->gts, pds_src);
-	rc = gpuMemAllocManaged(gcontext,
-							&m_deviceptr,
-							offsetof(GpuJoinTask,
-									 kern) + required,
-							CU_MEM_ATTACH_GLOBAL);
+	rc = gpuMemArenaCreate(gcontext, &arena,
+						   STROMALIGN(offsetof(GpuJoinTask,
+											   kern) + required) +
+						   STROMALIGN(offsetof(pgstrom_data_store,
+											   kds) + result_length));
 	if (rc != CUDA_SUCCESS)
-		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
-	pgjoin = (GpuJoinTask *)m_deviceptr;
+		elog(ERROR, "failed on gpuMemArenaCreate: %s", errorText(rc));
+	pgjoin = gpuMemArenaAlloc(arena, offsetof(GpuJoinTask,
+											  kern) + required);
+	Assert(pgjoin != NULL);
 
 	memset(pgjoin, 0, offsetof(GpuJoinTask, kern));
 	pgstromInitGpuTask(&gjs->gts, &pgjoin->task);
+	pgjoin->arena = arena;
 	pgjoin->pds_src = pds_src;
-	pgjoin->pds_dst = PDS_create_row(gcontext,
-									 scan_tupdesc,
-									 pgstrom_chunk_size());
+	pgjoin->pds_dst = PDS_create_row_on_arena(arena,
+											  scan_tupdesc,
+											  result_length);
+	Assert(pgjoin->pds_dst != NULL);
 	pgjoin->outer_depth = outer_depth;
 
 	/* Is NVMe-Strom available to run this GpuJoin? */
@@ -6094,19 +7517,187 @@ gpujoin_next_task(GpuTaskState *gts)
 	return gtask;
 }
 
+/*
+ * __gpujoinOuterJoinMapIsPeerAccessible
+ *
+ * It checks whether the outer-join-map on the current device is accessible
+ * over P2P DMA from all the other devices that run this GpuJoin.
+ */
+static bool
+__gpujoinOuterJoinMapIsPeerAccessible(GpuJoinState *gjs,
+									  GpuJoinSharedState *gj_sstate)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	int				dindex = gcontext->cuda_dindex;
+	int				k;
+
+	for (k=0; k < numDevAttrs; k++)
+	{
+		CUdevice	peer_device;
+		CUresult	rc;
+		int			can_access;
+
+		if (k == dindex || (gj_sstate->pergpu[k].bytesize == 0 &&
+							!gj_sstate->pergpu[k].managed_kmrels))
+			continue;
+		rc = cuDeviceGet(&peer_device, devAttrs[k].DEV_ID);
+		if (rc != CUDA_SUCCESS)
+			return false;
+		rc = cuDeviceCanAccessPeer(&can_access,
+								   peer_device,
+								   gcontext->cuda_device);
+		if (rc != CUDA_SUCCESS || !can_access)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * gpujoinDetachOuterJoin
+ *
+ * It detaches the current backend/worker from the outer scan, and releases
+ * the inner rows claimed for RIGHT/FULL OUTER JOIN, if any.
+ * The outer-join-map on the device memory is usually merged by the GPU
+ * kernel on the emission of unmatched rows, because backend/workers on the
+ * same device share the device memory. Only if the map is private (managed
+ * memory) or any other device cannot access it over P2P DMA, it is colocated
+ * to the host by the last one on the device.
+ */
+static void
+gpujoinDetachOuterJoin(GpuJoinState *gjs, GpuJoinSharedState *gj_sstate)
+{
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	int				dindex = gjs->gts.gcontext->cuda_dindex;
+	bool			colocation = false;
+	int				i;
+
+	/* never attached the device buffer, if outer scan is already done */
+	if (!h_kmrels || gjs->m_kmrels == 0UL)
+		return;
+
+	if (!gjs->outer_scan_detached)
+	{
+		if (h_kmrels->ojmaps_length > 0)
+		{
+			if (gjs->m_kmrels_managed)
+				colocation = true;
+			else
+			{
+				SpinLockAcquire(&gj_sstate->mutex);
+				if (gj_sstate->pergpu[dindex].nr_workers_gpujoin == 1 &&
+					!__gpujoinOuterJoinMapIsPeerAccessible(gjs, gj_sstate))
+					colocation = true;
+				SpinLockRelease(&gj_sstate->mutex);
+			}
+			if (colocation)
+				gpujoinColocateOuterJoinMapsToHost(gjs);
+		}
+		SpinLockAcquire(&gj_sstate->mutex);
+		if (colocation)
+			gj_sstate->ojmaps_on_host = true;
+		Assert(gj_sstate->pergpu[dindex].nr_workers_gpujoin > 0);
+		if (--gj_sstate->pergpu[dindex].nr_workers_gpujoin == 0)
+		{
+			for (i=0; i < numDevAttrs; i++)
+			{
+				if (gj_sstate->pergpu[i].nr_workers_gpujoin > 0)
+					break;
+			}
+			if (i >= numDevAttrs)
+				ConditionVariableBroadcast(&gj_sstate->cond);
+		}
+		SpinLockRelease(&gj_sstate->mutex);
+		gjs->outer_scan_detached = true;
+	}
+
+	/* the task of RIGHT/FULL OUTER JOIN by this process was completed */
+	if (gjs->outer_join_depth > 0)
+	{
+		SpinLockAcquire(&gj_sstate->mutex);
+		Assert(gj_sstate->nr_workers_outer > 0);
+		if (--gj_sstate->nr_workers_outer == 0)
+			ConditionVariableBroadcast(&gj_sstate->cond);
+		SpinLockRelease(&gj_sstate->mutex);
+		gjs->outer_join_depth = 0;
+	}
+}
+
+/*
+ * __gpujoinClaimRightOuterRows
+ *
+ * It claims a range of the inner rows to emit the unmatched rows, then
+ * returns its depth. It returns 0 if caller has to wait for completion of
+ * the other workers, or -1 if no more rows to be emitted.
+ * Caller must hold gj_sstate->mutex.
+ */
+static int
+__gpujoinClaimRightOuterRows(GpuJoinState *gjs,
+							 GpuJoinSharedState *gj_sstate)
+{
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	kern_data_store *kds_in;
+	cl_int			depth;
+	int				i;
+
+	/* all the backend/workers must complete the outer scan */
+	for (i=0; i < numDevAttrs; i++)
+	{
+		if (gj_sstate->pergpu[i].nr_workers_gpujoin > 0)
+			return 0;
+	}
+
+	for (;;)
+	{
+		depth = gj_sstate->curr_outer_depth;
+		if (depth > gjs->num_rels)
+			return -1;
+		if (depth > 0)
+		{
+			kds_in = KERN_MULTIRELS_INNER_KDS(h_kmrels, depth);
+			if (gj_sstate->outer_read_pos < kds_in->nitems)
+			{
+				gjs->outer_join_depth = depth;
+				gjs->outer_join_row_base = gj_sstate->outer_read_pos;
+				gjs->outer_join_row_end =
+					Min(kds_in->nitems, (gj_sstate->outer_read_pos +
+										 GPUJOIN_RIGHT_OUTER_NROWS_PER_TASK));
+				gj_sstate->outer_read_pos = gjs->outer_join_row_end;
+				gj_sstate->nr_workers_outer++;
+				return depth;
+			}
+			/*
+			 * The running tasks may update the outer-join-map of the deeper
+			 * depth, so we cannot move to the next depth until completion.
+			 */
+			if (gj_sstate->nr_workers_outer > 0)
+				return 0;
+		}
+		/* move to the next RIGHT/FULL OUTER JOIN depth */
+		for (depth = Max(depth + 1, 1); depth <= gjs->num_rels; depth++)
+		{
+			if (h_kmrels->chunks[depth - 1].right_outer)
+				break;
+		}
+		gj_sstate->curr_outer_depth = depth;
+		gj_sstate->outer_read_pos = 0;
+	}
+}
+
 /*
  * gpujoinNextRightOuterJoinIfAny
+ *
+ * Once all the backend/workers completed the outer scan, the unmatched rows
+ * of RIGHT/FULL OUTER JOIN are emitted by all of them, by the range of inner
+ * rows claimed for each task. It returns the depth of the claimed rows, or
+ * -1 if nothing to do any more.
  */
 int
 gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts)
 {
 	GpuJoinState   *gjs = (GpuJoinState *)gts;
 	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
-	GpuContext	   *gcontext = gjs->gts.gcontext;
 	kern_multirels *h_kmrels = gjs->h_kmrels;
-	int				i, dindex = gcontext->cuda_dindex;
-	int				depth = -1;
-	uint32			needs_colocation;
+	int				depth;
 
 	if (gjs->sibling)
 	{
@@ -6116,20 +7707,16 @@ gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts)
 			return -1;
 		gj_sstate = sibling->leader->gj_sstate;
 	}
-	
-	SpinLockAcquire(&gj_sstate->mutex);
 	Assert(gj_sstate->phase == INNER_PHASE__GPUJOIN_EXEC);
 	Assert(h_kmrels != NULL);
 
-	if (h_kmrels->ojmaps_length == 0)
-	{
-		/*
-		 * This GpuJoin has no RIGHT/FULL OUTER JOIN.
-		 * So, we need to do nothing special at the end.
-		 */
-		gj_sstate->pergpu[dindex].nr_workers_gpujoin--;
-		goto out_unlock;
-	}
+	gpujoinDetachOuterJoin(gjs, gj_sstate);
+	/*
+	 * This GpuJoin has no RIGHT/FULL OUTER JOIN, or this process never
+	 * joined the outer scan. So, we need to do nothing special at the end.
+	 */
+	if (h_kmrels->ojmaps_length == 0 || gjs->m_kmrels == 0UL)
+		return -1;
 
 	/*
 	 * Now we don't support RIGHT/FULL OUTER JOIN with asymmetric
@@ -6138,76 +7725,164 @@ gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts)
 	Assert(!gjs->sibling);
 
 	/*
-	 * This context is not the last one to process this GpuJoin
-	 * at the current GPU device. Likely, other backend/workers
-	 * that shares same GPU shall handle RIGHT/FULL OUTER JOIN.
+	 * Parallel workers wait for the other backend/workers still running,
+	 * then emit the unmatched rows together. However, the leader process
+	 * never waits, because workers may be blocked by the tuple queue to be
+	 * read by the leader; it simply leaves the rest to the workers.
 	 */
-	if (gj_sstate->pergpu[dindex].nr_workers_gpujoin > 1)
+	SpinLockAcquire(&gj_sstate->mutex);
+	while ((depth = __gpujoinClaimRightOuterRows(gjs, gj_sstate)) == 0)
 	{
-		gj_sstate->pergpu[dindex].nr_workers_gpujoin--;
-		goto out_unlock;
+		if (!IsParallelWorker())
+		{
+			depth = -1;
+			break;
+		}
+		SpinLockRelease(&gj_sstate->mutex);
+		ConditionVariableSleep(&gj_sstate->cond, PG_WAIT_EXTENSION);
+		SpinLockAcquire(&gj_sstate->mutex);
 	}
+	SpinLockRelease(&gj_sstate->mutex);
+	ConditionVariableCancelSleep();
 
-	/*
-	 * In case when RIGHT/FULL OUTER JOIN was processed on multiple
-	 * GPU devices, or CPU fallback happen, we must collocate the
-	 * outer-join-map once.
-	 */
-	needs_colocation = pg_atomic_read_u32(&gj_sstate->needs_colocation);
-	if (needs_colocation > 1)
-		gpujoinColocateOuterJoinMapsToHost(gjs);
+	return depth;
+}
 
-	/*
-	 * If this process is exactly the last player for the RIGHT/FULL
-	 * OUTER JOIN, we suggest to kick GpuJoin kernel with NULL outer
-	 * buffer from a particular depth.
-	 */
-	Assert(gj_sstate->pergpu[dindex].nr_workers_gpujoin == 1);
-	for (i=0; i < numDevAttrs; i++)
-	{
-		if (i == dindex)
-			continue;
-		if (gj_sstate->pergpu[i].nr_workers_gpujoin > 0)
-			break;
-	}
-	if (i >= numDevAttrs)
+/*
+ * gpujoinMergeOuterJoinMaps
+ *
+ * It merges the outer-join-maps of the other devices (over P2P DMA through
+ * the IPC handle), and the one colocated on the host if any, to the local
+ * outer-join-map, for the range of inner rows claimed by the task.
+ * It is called by the GPU worker thread prior to RIGHT/FULL OUTER JOIN.
+ */
+void
+gpujoinMergeOuterJoinMaps(GpuTaskState *gts, CUmodule cuda_module,
+						  kern_gpujoin *kgjoin, cl_int outer_depth)
+{
+	GpuJoinState   *gjs = (GpuJoinState *) gts;
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	GpuContext	   *gcontext = GpuWorkerCurrentContext;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	kern_data_store *kds_in = KERN_MULTIRELS_INNER_KDS(h_kmrels, outer_depth);
+	CUfunction		kern_merge_ojmap;
+	CUdeviceptr		m_ojmap_dst;
+	CUdeviceptr		m_ojmap_src;
+	CUresult		rc;
+	size_t			offset;
+	cl_uint			nitems;
+	cl_int			grid_sz;
+	cl_int			block_sz;
+	void		   *kern_args[3];
+	int				dindex = gcontext->cuda_dindex;
+	int				k;
+
+	Assert(outer_depth > 0 && outer_depth <= gjs->num_rels);
+	/* only one outer-join-map, and no colocation */
+	if (pg_atomic_read_u32(&gj_sstate->needs_colocation) <= 1 &&
+		!gj_sstate->ojmaps_on_host)
+		return;
+	if (kgjoin->outer_row_base >= Min(kds_in->nitems, kgjoin->outer_row_end))
+		return;
+	nitems = (Min(kds_in->nitems, kgjoin->outer_row_end) -
+			  kgjoin->outer_row_base);
+	offset = (h_kmrels->kmrels_length +
+			  h_kmrels->chunks[outer_depth - 1].ojmap_offset +
+			  kgjoin->outer_row_base);
+	m_ojmap_dst = gjs->m_kmrels + offset;
+
+	rc = cuModuleGetFunction(&kern_merge_ojmap,
+							 cuda_module,
+							 "kern_gpujoin_merge_outer_join_map");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_merge_ojmap,
+							 CU_DEVICE_PER_THREAD,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Min(grid_sz, (nitems + block_sz - 1) / block_sz);
+	kern_args[0] = &m_ojmap_dst;
+	kern_args[1] = &m_ojmap_src;
+	kern_args[2] = &nitems;
+
+	for (k=0; k < numDevAttrs; k++)
 	{
-		int		__depth;
+		CUdevice	peer_device;
+		CUdeviceptr	m_peer;
+		int			can_access;
 
-		for (__depth = Max(gj_sstate->curr_outer_depth + 1, 1);
-			 __depth <= gjs->num_rels;
-			 __depth++)
+		if (gj_sstate->pergpu[k].bytesize == 0)
+			continue;
+		if (k == dindex)
 		{
-			if (h_kmrels->chunks[__depth - 1].right_outer)
-			{
-				depth = __depth;
-				gj_sstate->curr_outer_depth = depth;
-				break;
-			}
+			/* device buffer shared with other workers, if not managed */
+			if (!gjs->m_kmrels_managed)
+				continue;
 		}
-		/*
-		 * Once colocation happened, outer-join-map at the GPU device
-		 * memory is not latest. So, refresh it.
-		 */
-		if (depth >= 0 && needs_colocation > 1)
+		else
 		{
-			size_t		offset = h_kmrels->kmrels_length;
-			size_t		length = MAXALIGN(h_kmrels->ojmaps_length);
-			CUresult	rc;
-
-			rc = cuMemcpyHtoD(gjs->m_kmrels + offset,
-							  (char *)h_kmrels + offset,
-							  length);
+			/* it should be colocated on the host, if not accessible */
+			rc = cuDeviceGet(&peer_device, devAttrs[k].DEV_ID);
 			if (rc != CUDA_SUCCESS)
-			{
-				 SpinLockRelease(&gj_sstate->mutex);
-				 elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
-			}
+				werror("failed on cuDeviceGet: %s", errorText(rc));
+			rc = cuDeviceCanAccessPeer(&can_access,
+									   gcontext->cuda_device,
+									   peer_device);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuDeviceCanAccessPeer: %s", errorText(rc));
+			if (!can_access)
+				continue;
 		}
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &m_peer,
+								 gj_sstate->pergpu[k].ipc_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+		m_ojmap_src = m_peer + offset;
+		rc = cuLaunchKernel(kern_merge_ojmap,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_WORKER,
+							kern_args,
+							NULL);
+		if (rc == CUDA_SUCCESS)
+			rc = cuStreamSynchronize(CU_STREAM_PER_WORKER);
+		if (gpuIpcCloseMemHandle(gcontext, m_peer) != CUDA_SUCCESS)
+			wnotice("failed on gpuIpcCloseMemHandle");
+		if (rc != CUDA_SUCCESS)
+			werror("failed to merge outer-join-map of GPU%d: %s",
+				   devAttrs[k].DEV_ID, errorText(rc));
+	}
+
+	/* merge the outer-join-map colocated on the host */
+	if (gj_sstate->ojmaps_on_host)
+	{
+		rc = gpuMemAllocManaged(gcontext,
+								&m_ojmap_src,
+								nitems,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on gpuMemAllocManaged: %s", errorText(rc));
+		memcpy((void *)m_ojmap_src, (char *)h_kmrels + offset, nitems);
+		rc = cuLaunchKernel(kern_merge_ojmap,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_WORKER,
+							kern_args,
+							NULL);
+		if (rc == CUDA_SUCCESS)
+			rc = cuStreamSynchronize(CU_STREAM_PER_WORKER);
+		gpuMemFree(gcontext, m_ojmap_src);
+		if (rc != CUDA_SUCCESS)
+			werror("failed to merge outer-join-map on the host: %s",
+				   errorText(rc));
 	}
-out_unlock:
-	SpinLockRelease(&gj_sstate->mutex);
-	return depth;
 }
 
 /*
@@ -6219,7 +7894,37 @@ gpujoin_terminator_task(GpuTaskState *gts, cl_bool *task_is_ready)
 	GpuJoinState   *gjs = (GpuJoinState *) gts;
 	GpuTask		   *gtask = NULL;
 	cl_int			outer_depth;
-	
+
+	/*
+	 * Has more inner batches? If multi-batch hash-join, the next batch is
+	 * loaded onto the inner buffer, then outer relation is rescanned.
+	 */
+	if (gjs->batch_depth > 0)
+	{
+		innerState *istate = &gjs->inners[gjs->batch_depth - 1];
+
+		while (istate->curr_batch + 1 < istate->nbatches)
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			gpujoinSwitchInnerBatch(gjs, istate->curr_batch + 1);
+			/* rewind the outer scan */
+			pgstromRescanGpuTaskState(&gjs->gts);
+			if (outerPlanState(gjs))
+				ExecReScan(outerPlanState(gjs));
+			gjs->gts.scan_overflow = NULL;
+			pg_atomic_write_u32(&gjs->gj_sstate->outer_scan_done, 0);
+
+			gtask = gpujoin_next_task(&gjs->gts);
+			if (gtask)
+			{
+				gjs->gts.scan_done = false;
+				*task_is_ready = false;
+				return gtask;
+			}
+		}
+	}
+
 	/* Has RIGHT/FULL OUTER JOIN? */
 	outer_depth = gpujoinNextRightOuterJoinIfAny(&gjs->gts);
 	if (outer_depth > 0)
@@ -6447,6 +8152,12 @@ gpujoinFallbackHashJoin(int depth, GpuJoinState *gjs)
 	cl_uint			hash;
 	bool			retval;
 
+	/* SEMI/ANTI JOIN does not need to walk on the hash-chain any more */
+	if (istate->fallback_inner_matched &&
+		(istate->join_type == JOIN_SEMI ||
+		 istate->join_type == JOIN_ANTI))
+		return depth-1;
+
 	do {
 		if (istate->fallback_inner_index == 0)
 		{
@@ -6490,9 +8201,13 @@ gpujoinFallbackHashJoin(int depth, GpuJoinState *gjs)
 		retval = ExecQual(istate->other_quals, econtext);
 	} while (!retval);
 
+	istate->fallback_inner_matched = true;
 	/* update outer join map */
 	if (ojmaps)
 		ojmaps[khitem->t.rowid] = 1;
+	/* ANTI JOIN never emits the matched outer row */
+	if (istate->join_type == JOIN_ANTI)
+		return depth-1;
 	/* rewind the next depth */
 	if (depth < gjs->num_rels)
 	{
@@ -6505,7 +8220,8 @@ gpujoinFallbackHashJoin(int depth, GpuJoinState *gjs)
 end:
 	if (!istate->fallback_inner_matched &&
 		(istate->join_type == JOIN_LEFT ||
-		 istate->join_type == JOIN_FULL))
+		 istate->join_type == JOIN_FULL ||
+		 istate->join_type == JOIN_ANTI))
 	{
 		istate->fallback_inner_matched = true;
 		gpujoin_fallback_tuple_extract(gjs->slot_fallback,
@@ -6527,6 +8243,83 @@ end:
 	return depth-1;
 }
 
+/*
+ * Merge-Join for CPU fallback
+ *
+ * It walks on the inner rows in the order of the sorted index, so the
+ * position suspended by the GPU kernel is also valid as a starting point.
+ */
+static int
+gpujoinFallbackMergeJoin(int depth, GpuJoinState *gjs)
+{
+	ExprContext	   *econtext = gjs->gts.css.ss.ps.ps_ExprContext;
+	innerState	   *istate = &gjs->inners[depth-1];
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	kern_data_store *kds_in = KERN_MULTIRELS_INNER_KDS(h_kmrels, depth);
+	cl_bool		   *ojmaps = KERN_MULTIRELS_OUTER_JOIN_MAP(h_kmrels, depth);
+	cl_uint		   *sorted = KERN_MULTIRELS_MERGE_INDEX(h_kmrels, depth);
+	cl_uint			index;
+
+	for (index = istate->fallback_inner_index;
+		 index < kds_in->nitems;
+		 index++)
+	{
+		kern_tupitem   *tupitem = KERN_DATA_STORE_TUPITEM(kds_in,
+														  sorted[index]);
+
+		gpujoin_fallback_tuple_extract(gjs->slot_fallback,
+									   kds_in,
+									   &tupitem->htup.t_ctid,
+									   &tupitem->htup,
+									   istate->inner_dst_resno,
+									   istate->inner_src_anum_min,
+									   istate->inner_src_anum_max);
+		if (!ExecQual(istate->join_quals, econtext))
+			continue;
+		istate->fallback_inner_index = index + 1;
+		istate->fallback_inner_matched = true;
+		/* update outer join map */
+		if (ojmaps)
+			ojmaps[sorted[index]] = 1;
+		if (!ExecQual(istate->other_quals, econtext))
+			continue;
+		/* rewind the next depth */
+		if (depth < gjs->num_rels)
+		{
+			istate++;
+			istate->fallback_inner_index = 0;
+			istate->fallback_inner_matched = false;
+		}
+		return depth+1;
+	}
+
+	if (!istate->fallback_inner_matched &&
+		(istate->join_type == JOIN_LEFT ||
+		 istate->join_type == JOIN_FULL))
+	{
+		istate->fallback_inner_index = kds_in->nitems;
+		istate->fallback_inner_matched = true;
+
+		gpujoin_fallback_tuple_extract(gjs->slot_fallback,
+									   kds_in,
+									   NULL,
+									   NULL,
+									   istate->inner_dst_resno,
+									   istate->inner_src_anum_min,
+									   istate->inner_src_anum_max);
+		/* rewind the next depth */
+		if (depth < gjs->num_rels)
+		{
+			istate++;
+			istate->fallback_inner_index = 0;
+			istate->fallback_inner_matched = false;
+		}
+		return depth+1;
+	}
+	/* pop up one level */
+	return depth-1;
+}
+
 /*
  * Nest-Loop for CPU fallback
  */
@@ -6558,6 +8351,7 @@ gpujoinFallbackNestLoop(int depth, GpuJoinState *gjs)
 		if (retval)
 		{
 			istate->fallback_inner_index = index + 1;
+			istate->fallback_inner_matched = true;
 			/* update outer join map */
 			if (ojmaps)
 				ojmaps[index] = 1;
@@ -6600,15 +8394,16 @@ gpujoinFallbackNestLoop(int depth, GpuJoinState *gjs)
 }
 
 static int
-gpujoinFallbackLoadOuter(int depth, GpuJoinState *gjs)
+gpujoinFallbackLoadOuter(int depth, GpuJoinState *gjs, kern_gpujoin *kgjoin)
 {
 	kern_multirels *h_kmrels = gjs->h_kmrels;
 	kern_data_store *kds_in = KERN_MULTIRELS_INNER_KDS(h_kmrels, depth);
 	cl_bool		   *ojmaps = KERN_MULTIRELS_OUTER_JOIN_MAP(h_kmrels, depth);
+	cl_uint			nitems = Min(kds_in->nitems, kgjoin->outer_row_end);
 	cl_uint			index;
 
 	for (index = gjs->inners[depth-1].fallback_inner_index;
-		 index < kds_in->nitems;
+		 index < nitems;
 		 index++)
 	{
 		if (!ojmaps[index])
@@ -6689,6 +8484,8 @@ gpujoinFallbackLoadSource(int depth, GpuJoinState *gjs,
 			if (!ItemIdIsNormal(lpp))
 				continue;
 			htup = (HeapTupleHeader)PageGetItem(pg_page, lpp);
+			if (!pgstromBlockTupleIsVisible(&gjs->gts, pg_page, htup))
+				continue;
 			t_self.ip_blkid.bi_hi = block_nr >> 16;
 			t_self.ip_blkid.bi_lo = block_nr & 0xffff;
 			t_self.ip_posid = line_nr + 1;
@@ -6881,7 +8678,19 @@ lnext:
 			cl_bool		matched = sb->pd[depth+1].matched[local_id];
 
 			kds_in = KERN_MULTIRELS_INNER_KDS(h_kmrels, depth+1);
-			if (kds_in->format == KDS_FORMAT_HASH)
+			if (istate->merge_join)
+			{
+				if (l_state == UINT_MAX)
+				{
+					/* already reached end of the key range */
+					gjs->fallback_thread_count = (thread_index + 1) << 10;
+					goto lnext;
+				}
+				/* l_state is the next position on the sorted index + 1 */
+				istate->fallback_inner_index = (l_state == 0 ? 0 : l_state - 1);
+				istate->fallback_inner_matched = matched;
+			}
+			else if (kds_in->format == KDS_FORMAT_HASH)
 			{
 				if (l_state == 0)
 				{
@@ -6974,6 +8783,10 @@ gpujoinNextTupleFallback(GpuTaskState *gts,
 		gjs->fallback_outer_index = 0;
 		for (i=0; i < num_rels; i++)
 			gjs->inners[i].fallback_inner_index = 0;
+		/* RIGHT OUTER JOIN starts from the range of claimed inner rows */
+		if (outer_depth > 0)
+			gjs->inners[outer_depth-1].fallback_inner_index
+				= kgjoin->outer_row_base;
 
 		/*
 		 * Once CPU fallback happen, RIGHT/FULL OUTER JOIN map must
@@ -6981,6 +8794,7 @@ gpujoinNextTupleFallback(GpuTaskState *gts,
 		 * So, we ensure colocation by setting number larger than 1.
 		 */
 		pg_atomic_write_u32(&gj_sstate->needs_colocation, 123);
+		gj_sstate->ojmaps_on_host = true;
 		
 		depth = outer_depth;
 	}
@@ -7003,11 +8817,13 @@ gpujoinNextTupleFallback(GpuTaskState *gts,
 			else if (pds_src)
 				depth = gpujoinFallbackLoadSource(depth, gjs, pds_src);
 			else
-				depth = gpujoinFallbackLoadOuter(depth, gjs);
+				depth = gpujoinFallbackLoadOuter(depth, gjs, kgjoin);
 		}
 		else if (depth <= gjs->num_rels)
 		{
-			if (gjs->inners[depth-1].hash_outer_keys != NIL)
+			if (gjs->inners[depth-1].merge_join)
+				depth = gpujoinFallbackMergeJoin(depth, gjs);
+			else if (gjs->inners[depth-1].hash_outer_keys != NIL)
 				depth = gpujoinFallbackHashJoin(depth, gjs);
 			else
 				depth = gpujoinFallbackNestLoop(depth, gjs);
@@ -7101,7 +8917,10 @@ gpujoin_release_task(GpuTask *gtask)
 	if (pgjoin->pds_dst)
 		PDS_release(pgjoin->pds_dst);
 	/* release this gpu-task itself */
-	gpuMemFree(gts->gcontext, (CUdeviceptr)pgjoin);
+	if (pgjoin->arena)
+		gpuMemArenaFree(pgjoin->arena);
+	else
+		gpuMemFree(gts->gcontext, (CUdeviceptr)pgjoin);
 }
 
 void
@@ -7120,11 +8939,23 @@ gpujoinUpdateRunTimeStat(GpuTaskState *gts, kern_gpujoin *kgjoin)
 							kgjoin->outer_nitems);
 	for (i=0; i < gjs->num_rels; i++)
 	{
-		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[i+1].inner_nitems,
+		cl_int		depth = KERN_GPUJOIN_PHYSICAL_DEPTH(kgjoin, i+1);
+
+		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[depth].inner_nitems,
 								kgjoin->stat[i].nitems);
-		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[i+1].inner_nitems2,
+		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[depth].inner_nitems2,
 								kgjoin->stat[i].nitems2);
 	}
+	/* samples to estimate selectivity of each depth */
+	if (gjs->join_reorderable && !kgjoin->depth_reordered)
+	{
+		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[0].sample_nitems,
+								kgjoin->outer_nitems);
+		for (i=0; i < gjs->num_rels; i++)
+			pg_atomic_fetch_add_u64(&gj_rtstat->jstat[i+1].sample_nitems,
+									kgjoin->stat[i].nitems);
+		pg_atomic_fetch_add_u64(&gj_rtstat->sample_nchunks, 1);
+	}
 	/* debug counters if any */
 	if (kgjoin->debug_counter0 != 0)
 		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter0, kgjoin->debug_counter0);
@@ -7165,7 +8996,7 @@ gpujoin_throw_partial_result(GpuJoinTask *pgjoin)
 	rc = cuMemPrefetchAsync((CUdeviceptr) &pds_dst->kds,
 							pds_dst->kds.length,
 							CU_DEVICE_CPU,
-							CU_STREAM_PER_THREAD);
+							CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 
@@ -7195,6 +9026,7 @@ gpujoin_throw_partial_result(GpuJoinTask *pgjoin)
 		   KERN_GPUJOIN_PARAMBUF(&pgjoin->kern),
 		   KERN_GPUJOIN_PARAMBUF_LENGTH(&pgjoin->kern));
 	/* assign a new empty buffer */
+	pgjoin->result_length  += GPUJOIN_RESULT_BUFFER_USAGE(&pds_dst->kds);
 	pgjoin->pds_dst			= pds_new;
 
 	/* Back GpuTask to GTS */
@@ -7202,6 +9034,7 @@ gpujoin_throw_partial_result(GpuJoinTask *pgjoin)
 	dlist_push_tail(&gts->ready_tasks,
 					&gresp->task.chain);
 	gts->num_ready_tasks++;
+	gts->num_result_overflow++;
 	pthreadMutexUnlock(&gcontext->worker_mutex);
 
 	SetLatch(MyLatch);
@@ -7213,6 +9046,8 @@ gpujoin_throw_partial_result(GpuJoinTask *pgjoin)
  * It moves outer-join-map on the device memory to the host memory prior to
  * CPU fallback of RIGHT/FULL OUTER JOIN. When this function is called,
  * no GPU kernel shall not be working, so just cuMemcpyDtoH() works.
+ * Other backend/workers may update the host outer-join-map concurrently,
+ * so only the entries to be true are written byte-by-byte.
  */
 static void
 gpujoinColocateOuterJoinMapsToHost(GpuJoinState *gjs)
@@ -7226,12 +9061,12 @@ gpujoinColocateOuterJoinMapsToHost(GpuJoinState *gjs)
 
 	rc = cuMemcpyDtoH(m_ojmaps, gjs->m_kmrels + offset, length);
 	if (rc != CUDA_SUCCESS)
-		elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+		elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
 	/* merge outer join map */
-	for (offset=0; offset < length; offset += sizeof(cl_ulong))
+	for (offset=0; offset < length; offset++)
 	{
-		*((cl_ulong *)(h_ojmaps + offset))
-			|= *((cl_ulong *)(m_ojmaps + offset));
+		if (m_ojmaps[offset])
+			h_ojmaps[offset] = true;
 	}
 }
 
@@ -7255,6 +9090,7 @@ gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 	cl_int				retval = 10001;
 	void			   *kern_args[10];
 	void			   *last_suspend = NULL;
+	GpuKernelLaunchInfo	klaunch;
 
 	/* sanity checks */
 	Assert(pds_src->kds.format == KDS_FORMAT_ROW ||
@@ -7334,9 +9170,10 @@ gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 		rc = cuMemcpyHtoDAsync(m_kds_src,
 							   &pds_src->kds,
 							   pds_src->kds.length,
-							   CU_STREAM_PER_THREAD);
+							   CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemcpyHtoD: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 
 	}
 	else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
@@ -7344,9 +9181,10 @@ gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 		rc = cuMemPrefetchAsync(m_kds_src,
 								pds_src->kds.length,
 								CU_DEVICE_PER_THREAD,
-								CU_STREAM_PER_THREAD);
+								CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 	}
 
 	/* Launch:
@@ -7377,17 +9215,16 @@ resume_kernel:
 	kern_args[4] = &m_kds_dst;
 	kern_args[5] = &m_nullptr;
 
-	rc = cuLaunchKernel(kern_gpujoin_main,
-						grid_sz, 1, 1,
-						block_sz, 1, 1,
-						sizeof(cl_int) * block_sz,
-						CU_STREAM_PER_THREAD,
-						kern_args,
-						NULL);
+	klaunch.kern_function = kern_gpujoin_main;
+	klaunch.grid_sz = grid_sz;
+	klaunch.block_sz = block_sz;
+	klaunch.shmem_sz = sizeof(cl_int) * block_sz;
+	klaunch.kern_args = kern_args;
+	rc = gpuLaunchKernelSequence(1, &klaunch);
 	if (rc != CUDA_SUCCESS)
-		werror("failed on cuLaunchKernel: %s", errorText(rc));
+		werror("failed on gpuLaunchKernelSequence: %s", errorText(rc));
 
-	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
+	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuEventRecord: %s", errorText(rc));
 
@@ -7418,6 +9255,17 @@ resume_kernel:
 			goto resume_kernel;
 		}
 		gpujoinUpdateRunTimeStat(&gjs->gts, &pgjoin->kern);
+		/* length of the result buffers consumed by this outer chunk */
+		if (pds_src)
+		{
+			GpuJoinRuntimeStat *gj_rtstat
+				= GPUJOIN_RUNTIME_STAT(gjs->gj_sstate);
+
+			pgjoin->result_length += GPUJOIN_RESULT_BUFFER_USAGE(&pds_dst->kds);
+			pg_atomic_add_fetch_u64(&gj_rtstat->result_length,
+									pgjoin->result_length);
+			pg_atomic_add_fetch_u64(&gj_rtstat->result_nchunks, 1);
+		}
 		/* return task if any result rows */
 		retval = (pds_dst->kds.nitems > 0 ? 0 : -1);
 	}
@@ -7436,6 +9284,7 @@ resume_kernel:
 							  pds_src->kds.length);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemcpyDtoH: %s", errorText(rc));
+			gpuDeviceCountDMA(gcontext, 0, pds_src->kds.length, 0);
 			pds_src->nblocks_uncached = 0;
 		}
 		else if (pds_src->kds.format == KDS_FORMAT_ARROW &&
@@ -7488,7 +9337,8 @@ gpujoin_process_right_outer(GpuJoinTask *pgjoin, CUmodule cuda_module)
 	Assert(outer_depth > 0 && outer_depth <= gjs->num_rels);
 
 	/* Co-location of the outer join map */
-	//gpujoinColocateOuterJoinMaps(&gjs->gts, cuda_module);
+	gpujoinMergeOuterJoinMaps(&gjs->gts, cuda_module,
+							  &pgjoin->kern, outer_depth);
 
 	/* Lookup GPU kernel function */
 	rc = cuModuleGetFunction(&kern_gpujoin_main,
@@ -7524,13 +9374,13 @@ resume_kernel:
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
 						sizeof(cl_int) * block_sz,
-						CU_STREAM_PER_THREAD,
+						CU_STREAM_PER_WORKER,
 						kern_args,
 						NULL);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuLaunchKernel: %s", errorText(rc));
 
-	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
+	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuEventRecord: %s", errorText(rc));
 
@@ -7690,6 +9540,115 @@ typedef struct
 	kern_tupitem titem;
 } tupleEntry;
 
+/*
+ * gpujoin_inner_batchno
+ *
+ * It chooses the batch of the inner tuple by the hash value. Upper bits
+ * are used, because lower bits determine the hash-slot on the KDS.
+ */
+static inline int
+gpujoin_inner_batchno(cl_uint hash, int nbatches)
+{
+	return (int)(((cl_ulong)(hash * 0x9e3779b9U) * (cl_ulong)nbatches) >> 32);
+}
+
+/*
+ * innerPreloadSpillOneTuple
+ *
+ * It writes out an inner tuple to the temporary file of the batch.
+ */
+static void
+innerPreloadSpillOneTuple(GpuJoinState *leader, innerState *istate,
+						  cl_uint hash, HeapTuple htup)
+{
+	int			batchno = gpujoin_inner_batchno(hash, istate->nbatches);
+	BufFile	   *file;
+
+	if (!istate->batch_files)
+	{
+		MemoryContext	memcxt = leader->gts.css.ss.ps.state->es_query_cxt;
+
+		istate->batch_files = MemoryContextAllocZero(memcxt,
+									sizeof(BufFile *) * istate->nbatches);
+		istate->batch_nitems = MemoryContextAllocZero(memcxt,
+									sizeof(size_t) * istate->nbatches);
+		istate->batch_usage = MemoryContextAllocZero(memcxt,
+									sizeof(size_t) * istate->nbatches);
+	}
+	file = istate->batch_files[batchno];
+	if (!file)
+	{
+		file = BufFileCreateTemp(false);
+		istate->batch_files[batchno] = file;
+	}
+	if (BufFileWrite(file, &hash, sizeof(cl_uint)) != sizeof(cl_uint) ||
+		BufFileWrite(file, &htup->t_len, sizeof(cl_uint)) != sizeof(cl_uint) ||
+		BufFileWrite(file, &htup->t_self,
+					 sizeof(ItemPointerData)) != sizeof(ItemPointerData) ||
+		BufFileWrite(file, htup->t_data, htup->t_len) != htup->t_len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to GpuJoin temporary file: %m")));
+	istate->batch_nitems[batchno]++;
+	istate->batch_usage[batchno] += MAXALIGN(offsetof(kern_hashitem, t.htup) +
+											 htup->t_len);
+}
+
+/*
+ * innerPreloadLoadOneBatch
+ *
+ * It reads back the inner tuples of the batch from the temporary file.
+ */
+static void
+innerPreloadLoadOneBatch(GpuJoinState *leader, innerState *istate,
+						 int batchno)
+{
+	BufFile	   *file = istate->batch_files[batchno];
+	tupleEntry *entry;
+	cl_uint		header[2];
+	ItemPointerData	t_self;
+	size_t		nbytes;
+
+	Assert(istate->preload_nitems == 0 && istate->preload_usage == 0);
+	if (!file)
+		return;		/* empty batch */
+	if (BufFileSeek(file, 0, 0L, SEEK_SET) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not rewind GpuJoin temporary file: %m")));
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		nbytes = BufFileRead(file, header, sizeof(header));
+		if (nbytes == 0)
+			break;
+		if (nbytes != sizeof(header) ||
+			BufFileRead(file, &t_self,
+						sizeof(ItemPointerData)) != sizeof(ItemPointerData))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from GpuJoin temporary file: %m")));
+		entry = MemoryContextAlloc(leader->preload_memcxt,
+								   offsetof(tupleEntry,
+											titem.htup) + header[1]);
+		memset(entry, 0, offsetof(tupleEntry, titem.htup));
+		entry->hash = header[0];
+		entry->titem.t_len = header[1];
+		if (BufFileRead(file, &entry->titem.htup, header[1]) != header[1])
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read from GpuJoin temporary file: %m")));
+		memcpy(&entry->titem.htup.t_ctid, &t_self, sizeof(ItemPointerData));
+
+		istate->preload_nitems++;
+		istate->preload_usage += MAXALIGN(offsetof(kern_hashitem, t.htup) +
+										  entry->titem.t_len);
+		slist_push_head(&istate->preload_tuples, &entry->chain);
+	}
+	Assert(istate->preload_nitems == istate->batch_nitems[batchno]);
+}
+
 static void
 innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 {
@@ -7709,15 +9668,14 @@ innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 		size_t		usage;
 		Datum		datum;
 		bool		isnull;
+		bool		should_free = false;
 
 		CHECK_FOR_INTERRUPTS();
 
 		slot = ExecProcNode(ps);
 		if (TupIsNull(slot))
 			break;
-		if (bms_is_empty(istate->preload_flatten_attrs))
-			htup = ExecFetchSlotHeapTuple(slot, false, false);
-		else
+		if (!bms_is_empty(istate->preload_flatten_attrs))
 		{
 			/*
 			 * NOTE: If varlena datum is compressed / toasted, obviously,
@@ -7740,9 +9698,7 @@ innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 			}
 		}
 
-		/* Save the inner tuple temporaray */
-		htup = ExecFetchSlotHeapTuple(slot, false, false);
-		if (istate->hash_inner_keys != NIL)
+		if (istate->hash_inner_keys != NIL && !istate->device_hash_build)
 		{
 			/*
 			 * If join-keys are NULL, it is obvious that this inner tuple
@@ -7750,9 +9706,45 @@ innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 			 */
 			hash = get_tuple_hashvalue(istate, true, slot, &isnull);
 			if (isnull && (istate->join_type == JOIN_INNER ||
-						   istate->join_type == JOIN_LEFT))
+						   istate->join_type == JOIN_LEFT ||
+						   istate->join_type == JOIN_SEMI ||
+						   istate->join_type == JOIN_ANTI))
 				continue;
 		}
+
+		/*
+		 * Save the inner tuple temporaray.
+		 * Inner rows from GPU nodes (GpuScan/GpuJoin/GpuPreAgg) come on
+		 * virtual slots, so the heap-tuple is formed here only once, and
+		 * released after the copy to the preload buffer.
+		 */
+		htup = ExecFetchSlotHeapTuple(slot, false, &should_free);
+		if (istate->merge_join)
+		{
+			/*
+			 * Merge-join looks up the inner tuples by the sorted index,
+			 * so hash value is used only to check NULL keys above.
+			 */
+			hash = 0;
+		}
+		else if (istate->hash_inner_keys != NIL)
+		{
+			/*
+			 * In case of multi-batch hash-join, all the inner tuples are
+			 * written out to the temporary files, and only the first batch
+			 * is kept on the memory.
+			 */
+			if (istate->nbatches > 1)
+			{
+				innerPreloadSpillOneTuple(leader, istate, hash, htup);
+				if (gpujoin_inner_batchno(hash, istate->nbatches) != 0)
+				{
+					if (should_free)
+						heap_freetuple(htup);
+					continue;
+				}
+			}
+		}
 		else if (istate->gist_irel)
 		{
 			/*
@@ -7768,6 +9760,14 @@ innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 			memcpy(&htup->t_self, DatumGetPointer(datum),
 				   sizeof(ItemPointerData));
 		}
+		else if (istate->gist_itupdesc)
+		{
+			/*
+			 * Synthetic GiST index references the inner tuples by its
+			 * offset, so hash-slot is not used for lookup.
+			 */
+			hash = 0;
+		}
 		entry = MemoryContextAlloc(leader->preload_memcxt,
 								   offsetof(tupleEntry,
 											titem.htup) + htup->t_len);
@@ -7776,12 +9776,15 @@ innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 		entry->titem.t_len = htup->t_len;
 		memcpy(&entry->titem.htup, htup->t_data, htup->t_len);
 		memcpy(&entry->titem.htup.t_ctid, &htup->t_self, sizeof(ItemPointerData));
+		if (should_free)
+			heap_freetuple(htup);
 
-		if (istate->hash_inner_keys != NIL ||
-			istate->gist_irel != NULL)
-			usage = offsetof(kern_hashitem, t.htup) + htup->t_len;
+		if ((istate->hash_inner_keys != NIL && !istate->merge_join) ||
+			istate->gist_irel != NULL ||
+			istate->gist_itupdesc != NULL)
+			usage = offsetof(kern_hashitem, t.htup) + entry->titem.t_len;
 		else
-			usage = offsetof(kern_tupitem, htup) + htup->t_len;
+			usage = offsetof(kern_tupitem, htup) + entry->titem.t_len;
 
 		istate->preload_nitems++;
 		istate->preload_usage += MAXALIGN(usage);
@@ -7793,6 +9796,13 @@ innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 							istate->preload_usage);
 }
 
+/*
+ * Bloom-filter of the inner hash keys; 10bits per key gives about 1% of
+ * false positive rate. Its size is capped to 32MB.
+ */
+#define GPUJOIN_BLOOM_BITS_PER_KEY		10
+#define GPUJOIN_BLOOM_MAX_NBLOCKS		(1UL << 20)
+
 /*
  * innerPreloadAllocHostBuffer
  */
@@ -7829,6 +9839,17 @@ restart:
 
 		nrooms = pg_atomic_read_u64(&gj_rtstat->jstat[i+1].inner_nrooms);
 		usage  = pg_atomic_read_u64(&gj_rtstat->jstat[i+1].inner_usage);
+		if (istate->nbatches > 1 && istate->batch_files)
+		{
+			int		k;
+
+			/* inner buffer must have enough space for the largest batch */
+			for (k=0; k < istate->nbatches; k++)
+			{
+				nrooms = Max(nrooms, istate->batch_nitems[k]);
+				usage  = Max(usage,  istate->batch_usage[k]);
+			}
+		}
 		if (h_kmrels)
 		{
 			kds = (kern_data_store *)((char *)h_kmrels + kmrels_ofs);
@@ -7836,7 +9857,20 @@ restart:
 		}
 
 		nbytes = KDS_calculateHeadSize(tupdesc);
-		if (istate->hash_inner_keys != NIL)
+		if (istate->merge_join)
+		{
+			nbytes += (STROMALIGN(sizeof(cl_uint) * nrooms) +
+					   STROMALIGN(usage));
+			if (h_kmrels)
+			{
+				init_kernel_data_store(kds, tupdesc, nbytes,
+									   KDS_FORMAT_ROW, nrooms);
+				h_kmrels->chunks[i].merge_offset = kmrels_ofs + nbytes;
+			}
+			/* index of the inner rows sorted by the join keys */
+			nbytes += STROMALIGN(sizeof(cl_uint) * nrooms);
+		}
+		else if (istate->hash_inner_keys != NIL)
 		{
 			nbytes += (STROMALIGN(sizeof(cl_uint) * nrooms) +
 					   STROMALIGN(sizeof(cl_uint) * __KDS_NSLOTS(nrooms)) +
@@ -7846,6 +9880,45 @@ restart:
 				init_kernel_data_store(kds, tupdesc, nbytes,
 									   KDS_FORMAT_HASH, nrooms);
 				kds->nslots = __KDS_NSLOTS(nrooms);
+				h_kmrels->chunks[i].device_hash_build
+					= istate->device_hash_build;
+			}
+
+			/*
+			 * Bloom-filter of the first depth allows to drop outer rows
+			 * at the load step of the outer relation, if it never matches
+			 * to any inner rows; so, not applicable for LEFT/FULL/ANTI join.
+			 */
+			if (i == 0 &&
+				enable_gpujoin_bloom_filter &&
+				istate->join_type != JOIN_LEFT &&
+				istate->join_type != JOIN_FULL &&
+				istate->join_type != JOIN_ANTI)
+			{
+				size_t		nblocks = (nrooms * GPUJOIN_BLOOM_BITS_PER_KEY +
+									   8 * GPUJOIN_BLOOM_BLOCK_SIZE - 1) /
+					(8 * GPUJOIN_BLOOM_BLOCK_SIZE);
+
+				nblocks = Min(Max(nblocks, 1), GPUJOIN_BLOOM_MAX_NBLOCKS);
+				if (h_kmrels)
+				{
+					h_kmrels->chunks[i].bloom_offset = kmrels_ofs + nbytes;
+					h_kmrels->chunks[i].bloom_nblocks = nblocks;
+				}
+				nbytes += STROMALIGN(GPUJOIN_BLOOM_BLOCK_SIZE * nblocks);
+			}
+
+			/* Bucketized index of the hash-table for device side probe */
+			if (enable_gpujoin_hash_bucket && nrooms < UINT_MAX / 2)
+			{
+				size_t		nbuckets = GPUJOIN_HASH_BUCKET_NBUCKETS(nrooms);
+
+				if (h_kmrels)
+				{
+					h_kmrels->chunks[i].bucket_offset = kmrels_ofs + nbytes;
+					h_kmrels->chunks[i].bucket_nbuckets = nbuckets;
+				}
+				nbytes += STROMALIGN(GPUJOIN_HASH_BUCKET_SIZE * nbuckets);
 			}
 		}
 		else if (istate->gist_irel != NULL)
@@ -7882,6 +9955,40 @@ restart:
 			}
 			nbytes += gist_length;
 		}
+		else if (istate->gist_itupdesc != NULL)
+		{
+			TupleDesc	itupdesc = istate->gist_itupdesc;
+			size_t		keysz = synthetic_gist_keysz(tupleDescAttr(itupdesc, 0)->atttypid);
+			size_t		nblocks = synthetic_gist_nblocks(nrooms, keysz);
+			size_t		gist_length;
+
+			nbytes += (STROMALIGN(sizeof(cl_uint) * nrooms) +
+					   STROMALIGN(sizeof(cl_uint) * __KDS_NSLOTS(nrooms)) +
+					   STROMALIGN(usage));
+			/* portion of synthetic GiST-index (KDS_FORMAT_BLOCK) */
+			gist_length = (KDS_calculateHeadSize(itupdesc) +
+						   STROMALIGN(sizeof(BlockNumber) * nblocks) +
+						   BLCKSZ * nblocks);
+			if (gist_length >= (size_t)UINT_MAX)
+				elog(ERROR, "synthetic GiST-index is too large to load GPU memory");
+			if (h_kmrels)
+			{
+				kern_data_store	   *kds_gist;
+
+				/* KDS-Hash portion */
+				init_kernel_data_store(kds, tupdesc, nbytes,
+									   KDS_FORMAT_HASH, nrooms);
+				kds->nslots = __KDS_NSLOTS(nrooms);
+
+				/* GiST-index portion */
+				h_kmrels->chunks[i].gist_offset = (kmrels_ofs + nbytes);
+				kds_gist = (kern_data_store *)
+					((char *)h_kmrels + h_kmrels->chunks[i].gist_offset);
+				init_kernel_data_store(kds_gist, itupdesc, gist_length,
+									   KDS_FORMAT_BLOCK, nblocks);
+			}
+			nbytes += gist_length;
+		}
 		else
 		{
 			nbytes += (STROMALIGN(sizeof(cl_uint) * nrooms) +
@@ -7893,6 +10000,46 @@ restart:
 				h_kmrels->chunks[i].is_nestloop = true;
 			}
 		}
+
+		/* columnar copy of the inner attributes referenced by quals */
+		if (!bms_is_empty(istate->preload_column_attrs))
+		{
+			kern_inner_columns *icols = NULL;
+			size_t		head_ofs = nbytes;
+			int			ncols = 0;
+			int			k;
+
+			k = -1;
+			while ((k = bms_next_member(istate->preload_column_attrs, k)) >= 0)
+				ncols = k + 1;
+			if (h_kmrels)
+			{
+				h_kmrels->chunks[i].column_offset = kmrels_ofs + head_ofs;
+				icols = (kern_inner_columns *)
+					((char *)h_kmrels + kmrels_ofs + head_ofs);
+				memset(icols, 0, offsetof(kern_inner_columns,
+										  colattrs[ncols]));
+				icols->nrooms = nrooms;
+				icols->ncols = ncols;
+			}
+			nbytes += STROMALIGN(offsetof(kern_inner_columns,
+										  colattrs[ncols]));
+			k = -1;
+			while ((k = bms_next_member(istate->preload_column_attrs, k)) >= 0)
+			{
+				Form_pg_attribute attr = tupleDescAttr(tupdesc, k);
+
+				if (icols)
+				{
+					icols->colattrs[k].attlen = attr->attlen;
+					icols->colattrs[k].nullmap_offset = nbytes - head_ofs;
+				}
+				nbytes += STROMALIGN(sizeof(cl_uint) * ((nrooms + 31) / 32));
+				if (icols)
+					icols->colattrs[k].values_offset = nbytes - head_ofs;
+				nbytes += STROMALIGN(attr->attlen * nrooms);
+			}
+		}
 		kmrels_ofs += nbytes;
 
 		if (istate->join_type == JOIN_RIGHT ||
@@ -7911,6 +10058,16 @@ restart:
 			if (h_kmrels)
 				h_kmrels->chunks[i].left_outer = true;
 		}
+		if (istate->join_type == JOIN_SEMI)
+		{
+			if (h_kmrels)
+				h_kmrels->chunks[i].semi_join = true;
+		}
+		if (istate->join_type == JOIN_ANTI)
+		{
+			if (h_kmrels)
+				h_kmrels->chunks[i].anti_join = true;
+		}
 	}
 
 	/*
@@ -7977,7 +10134,8 @@ __innerPreloadSetupHeapBuffer(kern_data_store *kds,
 		kern_tupitem *titem = (kern_tupitem *)(curr_pos - sz);
 
 		Assert(entry->hash == 0);
-		memcpy(titem, &entry->titem, entry->titem.t_len);
+		memcpy(titem, &entry->titem,
+			   offsetof(kern_tupitem, htup) + entry->titem.t_len);
 
 		titem->rowid = rowid;
 		row_index[rowid++] = __kds_packed((char *)titem - (char *)kds);
@@ -8009,11 +10167,15 @@ __innerPreloadSetupHashBuffer(kern_data_store *kds,
 										   t.htup) + entry->titem.t_len);
 		kern_hashitem *hitem = (kern_hashitem *)(curr_pos - sz);
 		size_t		hindex = entry->hash % kds->nslots;
-		cl_uint		next, self;
+		cl_uint		next = 0, self;
 
-		self = __kds_packed((char *)hitem - (char *)kds);
-		__atomic_exchange(&hash_slot[hindex], &self, &next,
-						  __ATOMIC_SEQ_CST);
+		/* hash-slot shall be linked by gpujoin_build_hash_table */
+		if (!istate->device_hash_build)
+		{
+			self = __kds_packed((char *)hitem - (char *)kds);
+			__atomic_exchange(&hash_slot[hindex], &self, &next,
+							  __ATOMIC_SEQ_CST);
+		}
 		hitem->hash = entry->hash;
 		hitem->next = next;
 		memcpy(&hitem->t, &entry->titem,
@@ -8027,6 +10189,84 @@ __innerPreloadSetupHashBuffer(kern_data_store *kds,
 	Assert(istate->preload_usage == (tail_pos - curr_pos));
 }
 
+/*
+ * __innerPreloadSetupBloomFilter
+ *
+ * It adds hash values of the preloaded inner tuples to the bloom-filter.
+ * Concurrent workers may update the same block, so bits are set atomically.
+ */
+static void
+__innerPreloadSetupBloomFilter(kern_multirels *h_kmrels,
+							   innerState *istate)
+{
+	cl_uint	   *bloom = KERN_MULTIRELS_BLOOM_FILTER(h_kmrels, istate->depth);
+	cl_uint		nblocks = h_kmrels->chunks[istate->depth-1].bloom_nblocks;
+	slist_iter	iter;
+
+	if (!bloom)
+		return;
+	slist_foreach (iter, &istate->preload_tuples)
+	{
+		tupleEntry *entry = slist_container(tupleEntry, chain, iter.cur);
+		cl_uint	   *block;
+		cl_uint		mask[GPUJOIN_BLOOM_BLOCK_NWORDS];
+		int			k;
+
+		block = gpujoin_bloom_filter_block(bloom, nblocks,
+										   entry->hash, mask);
+		for (k=0; k < GPUJOIN_BLOOM_BLOCK_NWORDS; k++)
+		{
+			if ((block[k] & mask[k]) != mask[k])
+				__atomic_fetch_or(&block[k], mask[k], __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/*
+ * __innerPreloadSetupHashBucket
+ *
+ * It adds the preloaded inner tuples to the hash-bucket index. Concurrent
+ * workers may insert the same bucket, so empty entries are taken atomically.
+ */
+static void
+__innerPreloadSetupHashBucket(kern_multirels *h_kmrels,
+							  innerState *istate,
+							  kern_data_store *kds,
+							  cl_uint base_nitems)
+{
+	cl_uint	   *buckets = KERN_MULTIRELS_HASH_BUCKET(h_kmrels, istate->depth);
+	cl_uint		nbuckets = h_kmrels->chunks[istate->depth-1].bucket_nbuckets;
+	cl_uint		nentries = nbuckets * GPUJOIN_HASH_BUCKET_NITEMS;
+	cl_uint	   *row_index = KERN_DATA_STORE_ROWINDEX(kds);
+	cl_uint		i;
+
+	if (!buckets)
+		return;
+	for (i=0; i < istate->preload_nitems; i++)
+	{
+		kern_hashitem *hitem = (kern_hashitem *)
+			((char *)kds + __kds_unpack(row_index[base_nitems + i])
+			 - offsetof(kern_hashitem, t));
+		cl_uint		self = __kds_packed((char *)hitem - (char *)kds);
+		cl_uint		entry = ((hitem->hash % nbuckets) *
+							 GPUJOIN_HASH_BUCKET_NITEMS);
+		cl_uint		expected;
+
+		for (;;)
+		{
+			expected = 0;
+			if (__atomic_compare_exchange_n(gpujoin_hash_bucket_offset(buckets,
+																	   entry),
+											&expected, self, false,
+											__ATOMIC_SEQ_CST,
+											__ATOMIC_SEQ_CST))
+				break;
+			entry = (entry + 1) % nentries;
+		}
+		*gpujoin_hash_bucket_hash(buckets, entry) = hitem->hash;
+	}
+}
+
 static void
 __innerPreloadSetupGiSTIndexWalker(char *base,
 								   BlockNumber blkno,
@@ -8096,64 +10336,584 @@ __innerPreloadSetupGiSTIndexBuffer(innerState *istate,
 									   InvalidOffsetNumber);
 }
 
-static kern_multirels *
-innerPreloadMmapHostBuffer(GpuJoinState *leader, GpuJoinState *gjs)
+/*
+ * __innerPreloadSetupSyntheticGiSTIndex
+ *
+ * It builds an R-tree on the KDS_FORMAT_BLOCK buffer from the bounding-boxes
+ * of the inner tuples already loaded on the KDS_FORMAT_HASH buffer.
+ * The leaf items are sorted by Z-order curve of the center, then packed
+ * from the bottom level, with the root page at the block-0.
+ * Leaf items reference the inner tuples by offset (as gpujoin_prep_gistindex
+ * does for the built-in GiST index), so no device-side fixup is needed.
+ */
+static int
+__synthetic_gist_item_comp(const void *__a, const void *__b)
 {
-	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
-	kern_multirels *h_kmrels;
-	char		name[200];
-	int			fdesc;
-	struct stat	stat_buf;
+	const synthGistItem *a = __a;
+	const synthGistItem *b = __b;
+
+	if (a->code < b->code)
+		return -1;
+	if (a->code > b->code)
+		return 1;
+	return 0;
+}
 
-	/* already mapped? */
-	if (gjs->h_kmrels)
-		return gjs->h_kmrels;
+static inline cl_uint
+__synthetic_gist_zorder(float4 pos, float4 min, float4 max)
+{
+	double		width = (double)max - (double)min;
 
-	/* already mapped by the siblings? */
-	if (leader->h_kmrels)
-	{
-		gjs->h_kmrels = leader->h_kmrels;
-		return gjs->h_kmrels;
-	}
+	if (width <= 0.0)
+		return 0;
+	return (cl_uint)(((double)pos - (double)min) / width * (double)0xffffU);
+}
 
-	/* mmap host buffer */
-	snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
-			 PostPortNumber, gj_sstate->shmem_handle);
-	fdesc = shm_open(name, O_RDWR, 0);
-	if (fdesc < 0)
-		elog(ERROR, "failed on shm_open('%s'): %m", name);
-	if (fstat(fdesc, &stat_buf) != 0)
+/*
+ * __synthetic_gist_pack_pages
+ *
+ * It packs the sorted leaf keys from the bottom level. Block numbers are
+ * assigned from the root level, so the bottom level is placed at the tail.
+ */
+static void
+__synthetic_gist_pack_pages(innerState *istate,
+							kern_data_store *kds_gist,
+							synthGistKey *keys, size_t nkeys,
+							synthGistUnionFn union_fn, void *union_arg)
+{
+	char	   *base = (char *)KERN_DATA_STORE_BLOCK_PGPAGE(kds_gist, 0);
+	BlockNumber *block_nr = (BlockNumber *)KERN_DATA_STORE_BODY(kds_gist);
+	size_t		keysz = synthetic_gist_keysz(tupleDescAttr(istate->gist_itupdesc,
+														   0)->atttypid);
+	cl_uint		nitems_per_page = synthetic_gist_items_per_page(keysz);
+	size_t		nblocks;
+	size_t		blkno_base;
+	cl_uint		level_flags = F_LEAF;
+	cl_uint		i, j;
+
+	nblocks = synthetic_gist_nblocks(nkeys, keysz);
+	Assert(nblocks <= kds_gist->nrooms);
+	kds_gist->nrooms = nblocks;
+	blkno_base = nblocks;
+	for (;;)
 	{
-		close(fdesc);
-		elog(ERROR, "failed on fstat('%s'): %m", name);
-	}
-	Assert(stat_buf.st_size == gj_sstate->shmem_bytesize);
+		size_t		npages = Max((nkeys + nitems_per_page - 1) /
+								 nitems_per_page, 1);
 
-	h_kmrels = __mmapFile(NULL, TYPEALIGN(PAGE_SIZE, stat_buf.st_size),
-						  PROT_READ | PROT_WRITE,
-						  MAP_SHARED,
-						  fdesc, 0);
-	if (h_kmrels == MAP_FAILED)
-	{
-		close(fdesc);
-		elog(ERROR, "failed on mmap('%s'): %m", name);
-	}
-	close(fdesc);
+		blkno_base -= npages;
+		for (i=0; i < npages; i++)
+		{
+			BlockNumber	blkno = blkno_base + i;
+			Page		page = (Page)(base + BLCKSZ * blkno);
+			PageHeader	hpage = (PageHeader) page;
+			GISTPageOpaque op;
+			size_t		head = i * nitems_per_page;
+			size_t		tail = Min((i+1) * nitems_per_page, nkeys);
+			Datum		union_key = 0;
 
-	/* simple sanity checks */
-	if (h_kmrels->kmrels_length +
-		h_kmrels->ojmaps_length > stat_buf.st_size)
-		elog(ERROR, "Bug? filesize of '%s' is smaller than host buffer", name);
-	leader->h_kmrels = gjs->h_kmrels = h_kmrels;
+			PageInit(page, BLCKSZ, sizeof(GISTPageOpaqueData));
+			op = GistPageGetOpaque(page);
+			op->flags = level_flags;
+			op->rightlink = InvalidBlockNumber;
+			op->gist_page_id = GIST_PAGE_ID;
 
-	return h_kmrels;
+			for (j = head; j < tail; j++)
+			{
+				synthGistKey *key = &keys[j];
+				bool		isnull = false;
+				IndexTuple	itup;
+
+				itup = index_form_tuple(istate->gist_itupdesc,
+										&key->key, &isnull);
+				if ((level_flags & F_LEAF) != 0)
+				{
+					itup->t_tid.ip_blkid.bi_hi = (key->ref >> 16);
+					itup->t_tid.ip_blkid.bi_lo = (key->ref & 0x0000ffffU);
+					itup->t_tid.ip_posid = USHRT_MAX;
+				}
+				else
+				{
+					ItemPointerSet(&itup->t_tid, key->ref, USHRT_MAX);
+				}
+				if (PageAddItem(page, (Item) itup, IndexTupleSize(itup),
+								InvalidOffsetNumber,
+								false, false) == InvalidOffsetNumber)
+					elog(ERROR, "failed to add item on synthetic GiST-index");
+				pfree(itup);
+			}
+			if (head < tail)
+				union_key = union_fn(keys + head, tail - head, union_arg);
+			hpage->pd_lsn.xlogid = InvalidBlockNumber;
+			hpage->pd_lsn.xrecoff = InvalidOffsetNumber;
+			block_nr[blkno] = blkno;
+
+			/* i-th page is an item of the upper level; never overwrites */
+			keys[i].key = union_key;
+			keys[i].ref = blkno;
+		}
+		if (npages == 1)
+			break;
+		nkeys = npages;
+		level_flags = 0;
+	}
+	Assert(blkno_base == 0);
+
+	__innerPreloadSetupGiSTIndexWalker(base, 0, kds_gist->nrooms,
+									   InvalidBlockNumber,
+									   InvalidOffsetNumber);
 }
 
-static void
-__innerPreloadInitGiSTIndex(GpuJoinState *gjs, CUdeviceptr m_kmrels)
+static Datum
+__synthetic_gist_box_union(synthGistKey *keys, int nkeys, void *arg)
 {
-	GpuContext	   *gcontext = gjs->gts.gcontext;
-	CUmodule		cuda_module = NULL;
+	synthGistBox *union_box = palloc(sizeof(synthGistBox));
+	int			i;
+
+	union_box->xmin = union_box->ymin =  FLT_MAX;
+	union_box->xmax = union_box->ymax = -FLT_MAX;
+	for (i=0; i < nkeys; i++)
+	{
+		synthGistBox *box = (synthGistBox *)DatumGetPointer(keys[i].key);
+
+		union_box->xmin = Min(union_box->xmin, box->xmin);
+		union_box->xmax = Max(union_box->xmax, box->xmax);
+		union_box->ymin = Min(union_box->ymin, box->ymin);
+		union_box->ymax = Max(union_box->ymax, box->ymax);
+	}
+	return PointerGetDatum(union_box);
+}
+
+static void
+__innerPreloadSetupSyntheticGiSTIndex(innerState *istate,
+									  kern_data_store *kds_hash,
+									  kern_data_store *kds_gist)
+{
+	TupleDesc	tupdesc = planStateResultTupleDesc(istate->state);
+	cl_uint	   *row_index = KERN_DATA_STORE_ROWINDEX(kds_hash);
+	MemoryContext memcxt;
+	MemoryContext oldcxt;
+	synthGistItem *items;
+	synthGistKey *keys;
+	synthGistBox extent;
+	size_t		nitems = 0;
+	cl_uint		i, j;
+
+	Assert(kds_hash->format == KDS_FORMAT_HASH &&
+		   kds_gist->format == KDS_FORMAT_BLOCK);
+	memcxt = AllocSetContextCreate(CurrentMemoryContext,
+								   "synthetic GiST-index",
+								   ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(memcxt);
+	items = MemoryContextAllocHuge(memcxt,
+								   sizeof(synthGistItem) *
+								   Max(kds_hash->nitems, 1));
+	extent.xmin = extent.ymin =  FLT_MAX;
+	extent.xmax = extent.ymax = -FLT_MAX;
+	for (i=0; i < kds_hash->nitems; i++)
+	{
+		kern_tupitem   *titem = (kern_tupitem *)
+			((char *)kds_hash + __kds_unpack(row_index[i]));
+		HeapTupleData	tuple;
+		GISTENTRY		gentry;
+		GISTENTRY	   *rentry;
+		synthGistBox   *box;
+		Datum			datum;
+		bool			isnull;
+
+		tuple.t_len = titem->t_len;
+		ItemPointerSetInvalid(&tuple.t_self);
+		tuple.t_tableOid = InvalidOid;
+		tuple.t_data = &titem->htup;
+		datum = heap_getattr(&tuple, istate->gist_key_resno,
+							 tupdesc, &isnull);
+		if (isnull)
+			continue;
+		gistentryinit(gentry, datum, NULL, NULL, 0, true);
+		rentry = (GISTENTRY *)
+			DatumGetPointer(FunctionCall1(&istate->gist_compress,
+										  PointerGetDatum(&gentry)));
+		box = (synthGistBox *)DatumGetPointer(rentry->key);
+		/* empty geometry never matches any bounding-box */
+		if (isnan(box->xmin) || isnan(box->xmax) ||
+			isnan(box->ymin) || isnan(box->ymax))
+			continue;
+		items[nitems].box = *box;
+		items[nitems].ref = __kds_packed((char *)&titem->htup -
+										 (char *)kds_hash);
+		extent.xmin = Min(extent.xmin, box->xmin);
+		extent.xmax = Max(extent.xmax, box->xmax);
+		extent.ymin = Min(extent.ymin, box->ymin);
+		extent.ymax = Max(extent.ymax, box->ymax);
+		nitems++;
+	}
+
+	/* sort the leaf items by Z-order curve of the center */
+	for (i=0; i < nitems; i++)
+	{
+		synthGistBox *box = &items[i].box;
+		cl_uint		x, y, code = 0;
+
+		x = __synthetic_gist_zorder((box->xmin + box->xmax) / 2.0,
+									extent.xmin, extent.xmax);
+		y = __synthetic_gist_zorder((box->ymin + box->ymax) / 2.0,
+									extent.ymin, extent.ymax);
+		for (j=0; j < 16; j++)
+		{
+			code |= ((x >> j) & 1U) << (2 * j);
+			code |= ((y >> j) & 1U) << (2 * j + 1);
+		}
+		items[i].code = code;
+	}
+	qsort(items, nitems, sizeof(synthGistItem), __synthetic_gist_item_comp);
+
+	keys = MemoryContextAllocHuge(memcxt,
+								  sizeof(synthGistKey) * Max(nitems, 1));
+	for (i=0; i < nitems; i++)
+	{
+		keys[i].key = PointerGetDatum(&items[i].box);
+		keys[i].ref = items[i].ref;
+	}
+	__synthetic_gist_pack_pages(istate, kds_gist, keys, nitems,
+								__synthetic_gist_box_union, NULL);
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(memcxt);
+}
+
+/*
+ * __innerPreloadSetupMergeIndex
+ *
+ * It builds the index of the inner rows sorted by the join keys for
+ * GpuMergeJoin. Keys are extracted once, then sorted using SortSupport;
+ * the inner rows often come in sorted order (e.g, from GpuSort or index
+ * scan), and qsort_arg() finds out presorted input very cheaply.
+ */
+typedef struct
+{
+	innerState *istate;
+	int			nkeys;
+	Datum	   *values;		/* nitems x nkeys */
+	bool	   *isnull;		/* nitems x nkeys */
+} mergeIndexSortArg;
+
+static int
+__merge_index_item_comp(const void *__a, const void *__b, void *__arg)
+{
+	mergeIndexSortArg *marg = __arg;
+	size_t		a = (size_t)(*((const cl_uint *)__a)) * marg->nkeys;
+	size_t		b = (size_t)(*((const cl_uint *)__b)) * marg->nkeys;
+	int			k, comp;
+
+	for (k=0; k < marg->nkeys; k++)
+	{
+		comp = ApplySortComparator(marg->values[a+k], marg->isnull[a+k],
+								   marg->values[b+k], marg->isnull[b+k],
+								   &marg->istate->merge_ssup[k]);
+		if (comp != 0)
+			return comp;
+	}
+	return 0;
+}
+
+static void
+__innerPreloadSetupMergeIndex(innerState *istate,
+							  kern_data_store *kds,
+							  cl_uint *sorted)
+{
+	TupleDesc	tupdesc = planStateResultTupleDesc(istate->state);
+	ExprContext *econtext = istate->econtext;
+	TupleTableSlot *slot;
+	MemoryContext memcxt;
+	MemoryContext oldcxt;
+	mergeIndexSortArg marg;
+	ListCell   *lc;
+	cl_uint		i;
+	int			k;
+
+	Assert(kds->format == KDS_FORMAT_ROW);
+	memcxt = AllocSetContextCreate(CurrentMemoryContext,
+								   "merge-join index",
+								   ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(memcxt);
+	marg.istate = istate;
+	marg.nkeys = list_length(istate->hash_inner_keys);
+	marg.values = MemoryContextAllocHuge(memcxt, sizeof(Datum) *
+										 marg.nkeys * Max(kds->nitems, 1));
+	marg.isnull = MemoryContextAllocHuge(memcxt, sizeof(bool) *
+										 marg.nkeys * Max(kds->nitems, 1));
+	slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	for (i=0; i < kds->nitems; i++)
+	{
+		kern_tupitem   *titem = KERN_DATA_STORE_TUPITEM(kds, i);
+		HeapTupleData	tuple;
+		size_t			base = (size_t)i * marg.nkeys;
+
+		tuple.t_len = titem->t_len;
+		ItemPointerSetInvalid(&tuple.t_self);
+		tuple.t_tableOid = InvalidOid;
+		tuple.t_data = &titem->htup;
+
+		ExecClearTuple(slot);
+		heap_deform_tuple(&tuple, tupdesc,
+						  slot->tts_values,
+						  slot->tts_isnull);
+		ExecStoreVirtualTuple(slot);
+		econtext->ecxt_innertuple = slot;
+		k = 0;
+		foreach (lc, istate->hash_inner_keys)
+		{
+			ExprState  *clause = lfirst(lc);
+
+			marg.values[base+k] = ExecEvalExpr(clause, econtext,
+											   &marg.isnull[base+k]);
+			k++;
+		}
+		sorted[i] = i;
+	}
+	qsort_arg(sorted, kds->nitems, sizeof(cl_uint),
+			  __merge_index_item_comp, &marg);
+	ExecDropSingleTupleTableSlot(slot);
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(memcxt);
+}
+
+/*
+ * __innerPreloadSetupInnerColumns
+ *
+ * It deforms the inner rows once, then writes out the fixed-length
+ * attributes referenced by the join quals in columnar format; indexed by
+ * the rowid of kern_tupitem.
+ */
+static void
+__innerPreloadSetupInnerColumns(innerState *istate,
+								kern_data_store *kds,
+								kern_inner_columns *icols)
+{
+	TupleDesc	tupdesc = planStateResultTupleDesc(istate->state);
+	Datum	   *values = palloc(sizeof(Datum) * tupdesc->natts);
+	bool	   *isnull = palloc(sizeof(bool) * tupdesc->natts);
+	cl_uint		i;
+	int			k;
+
+	Assert(kds->nitems <= icols->nrooms);
+	k = -1;
+	while ((k = bms_next_member(istate->preload_column_attrs, k)) >= 0)
+	{
+		memset((char *)icols + icols->colattrs[k].nullmap_offset, 0,
+			   sizeof(cl_uint) * ((icols->nrooms + 31) / 32));
+	}
+
+	for (i=0; i < kds->nitems; i++)
+	{
+		kern_tupitem   *titem = KERN_DATA_STORE_TUPITEM(kds, i);
+		HeapTupleData	tuple;
+
+		tuple.t_len = titem->t_len;
+		ItemPointerSetInvalid(&tuple.t_self);
+		tuple.t_tableOid = InvalidOid;
+		tuple.t_data = &titem->htup;
+		heap_deform_tuple(&tuple, tupdesc, values, isnull);
+
+		Assert(titem->rowid == i);
+		k = -1;
+		while ((k = bms_next_member(istate->preload_column_attrs, k)) >= 0)
+		{
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, k);
+			cl_uint	   *nullmap;
+			char	   *dest;
+
+			if (isnull[k])
+				continue;
+			nullmap = (cl_uint *)
+				((char *)icols + icols->colattrs[k].nullmap_offset);
+			nullmap[i >> 5] |= (1U << (i & 0x1f));
+			dest = ((char *)icols + icols->colattrs[k].values_offset +
+					(size_t)attr->attlen * (size_t)i);
+			if (attr->attbyval)
+				store_att_byval(dest, values[k], attr->attlen);
+			else
+				memcpy(dest, DatumGetPointer(values[k]), attr->attlen);
+		}
+	}
+	pfree(values);
+	pfree(isnull);
+}
+
+/*
+ * __innerPreloadSetupSyntheticRangeIndex
+ *
+ * It builds a 1-D R-tree on the inner ranges sorted by the lower bound.
+ * Sibling leaves thus cover adjacent spans of the lower bounds, and the outer
+ * range walks down only the subtrees whose union range overlaps with.
+ */
+static int
+__synthetic_range_item_comp(const void *__a, const void *__b, void *arg)
+{
+	const synthGistRange *a = __a;
+	const synthGistRange *b = __b;
+	TypeCacheEntry *typcache = arg;
+	int			comp;
+
+	comp = range_cmp_bounds(typcache, &a->lower, &b->lower);
+	if (comp == 0)
+		comp = range_cmp_bounds(typcache, &a->upper, &b->upper);
+	return comp;
+}
+
+static Datum
+__synthetic_gist_range_union(synthGistKey *keys, int nkeys, void *arg)
+{
+	TypeCacheEntry *typcache = arg;
+	RangeBound	union_lower;
+	RangeBound	union_upper;
+	int			i;
+
+	for (i=0; i < nkeys; i++)
+	{
+		RangeType  *range = DatumGetRangeTypeP(keys[i].key);
+		RangeBound	lower;
+		RangeBound	upper;
+		bool		empty;
+
+		range_deserialize(typcache, range, &lower, &upper, &empty);
+		Assert(!empty);
+		if (i == 0 || range_cmp_bounds(typcache, &lower, &union_lower) < 0)
+			union_lower = lower;
+		if (i == 0 || range_cmp_bounds(typcache, &upper, &union_upper) > 0)
+			union_upper = upper;
+	}
+	return RangeTypePGetDatum(range_serialize(typcache,
+											  &union_lower,
+											  &union_upper, false));
+}
+
+static void
+__innerPreloadSetupSyntheticRangeIndex(innerState *istate,
+									   kern_data_store *kds_hash,
+									   kern_data_store *kds_gist)
+{
+	TupleDesc	tupdesc = planStateResultTupleDesc(istate->state);
+	TypeCacheEntry *typcache = istate->gist_rngtyp;
+	cl_uint	   *row_index = KERN_DATA_STORE_ROWINDEX(kds_hash);
+	MemoryContext memcxt;
+	MemoryContext oldcxt;
+	synthGistRange *items;
+	synthGistKey *keys;
+	size_t		nitems = 0;
+	cl_uint		i;
+
+	Assert(kds_hash->format == KDS_FORMAT_HASH &&
+		   kds_gist->format == KDS_FORMAT_BLOCK);
+	memcxt = AllocSetContextCreate(CurrentMemoryContext,
+								   "synthetic range-index",
+								   ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(memcxt);
+	items = MemoryContextAllocHuge(memcxt,
+								   sizeof(synthGistRange) *
+								   Max(kds_hash->nitems, 1));
+	for (i=0; i < kds_hash->nitems; i++)
+	{
+		kern_tupitem   *titem = (kern_tupitem *)
+			((char *)kds_hash + __kds_unpack(row_index[i]));
+		HeapTupleData	tuple;
+		RangeType	   *range;
+		Datum			datum;
+		bool			isnull;
+		bool			empty;
+
+		tuple.t_len = titem->t_len;
+		ItemPointerSetInvalid(&tuple.t_self);
+		tuple.t_tableOid = InvalidOid;
+		tuple.t_data = &titem->htup;
+		datum = heap_getattr(&tuple, istate->gist_key_resno,
+							 tupdesc, &isnull);
+		if (isnull)
+			continue;
+		range = DatumGetRangeTypeP(datum);
+		range_deserialize(typcache, range,
+						  &items[nitems].lower,
+						  &items[nitems].upper, &empty);
+		/* empty range never overlaps with any range */
+		if (empty)
+			continue;
+		items[nitems].range = range;
+		items[nitems].ref = __kds_packed((char *)&titem->htup -
+										 (char *)kds_hash);
+		nitems++;
+	}
+	qsort_arg(items, nitems, sizeof(synthGistRange),
+			  __synthetic_range_item_comp, typcache);
+
+	keys = MemoryContextAllocHuge(memcxt,
+								  sizeof(synthGistKey) * Max(nitems, 1));
+	for (i=0; i < nitems; i++)
+	{
+		keys[i].key = RangeTypePGetDatum(items[i].range);
+		keys[i].ref = items[i].ref;
+	}
+	__synthetic_gist_pack_pages(istate, kds_gist, keys, nitems,
+								__synthetic_gist_range_union, typcache);
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(memcxt);
+}
+
+static kern_multirels *
+innerPreloadMmapHostBuffer(GpuJoinState *leader, GpuJoinState *gjs)
+{
+	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
+	kern_multirels *h_kmrels;
+	char		name[200];
+	int			fdesc;
+	struct stat	stat_buf;
+
+	/* already mapped? */
+	if (gjs->h_kmrels)
+		return gjs->h_kmrels;
+
+	/* already mapped by the siblings? */
+	if (leader->h_kmrels)
+	{
+		gjs->h_kmrels = leader->h_kmrels;
+		return gjs->h_kmrels;
+	}
+
+	/* mmap host buffer */
+	snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
+			 PostPortNumber, gj_sstate->shmem_handle);
+	fdesc = shm_open(name, O_RDWR, 0);
+	if (fdesc < 0)
+		elog(ERROR, "failed on shm_open('%s'): %m", name);
+	if (fstat(fdesc, &stat_buf) != 0)
+	{
+		close(fdesc);
+		elog(ERROR, "failed on fstat('%s'): %m", name);
+	}
+	Assert(stat_buf.st_size == gj_sstate->shmem_bytesize);
+
+	h_kmrels = __mmapFile(NULL, TYPEALIGN(PAGE_SIZE, stat_buf.st_size),
+						  PROT_READ | PROT_WRITE,
+						  MAP_SHARED,
+						  fdesc, 0);
+	if (h_kmrels == MAP_FAILED)
+	{
+		close(fdesc);
+		elog(ERROR, "failed on mmap('%s'): %m", name);
+	}
+	close(fdesc);
+
+	/* simple sanity checks */
+	if (h_kmrels->kmrels_length +
+		h_kmrels->ojmaps_length > stat_buf.st_size)
+		elog(ERROR, "Bug? filesize of '%s' is smaller than host buffer", name);
+	leader->h_kmrels = gjs->h_kmrels = h_kmrels;
+
+	return h_kmrels;
+}
+
+static void
+__innerPreloadInitGiSTIndex(GpuJoinState *gjs, CUdeviceptr m_kmrels)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	CUmodule		cuda_module = NULL;
 	CUfunction		f_prep_gistindex = NULL;
 	CUresult		rc;
 	void		   *kern_args[2];
@@ -8161,49 +10921,870 @@ __innerPreloadInitGiSTIndex(GpuJoinState *gjs, CUdeviceptr m_kmrels)
 	cl_int			block_sz;
 	cl_int			depth;
 
-	for (depth=1; depth <= gjs->num_rels; depth++)
+	for (depth=1; depth <= gjs->num_rels; depth++)
+	{
+		if (!gjs->inners[depth-1].gist_irel)
+			continue;
+		/* load the CUDA module and function */
+		if (!cuda_module)
+		{
+			cuda_module = GpuContextLookupModule(gcontext,
+												 gjs->gts.program_id);
+           rc = cuModuleGetFunction(&f_prep_gistindex,
+                                    cuda_module,
+                                    "gpujoin_prep_gistindex");
+           if (rc != CUDA_SUCCESS)
+               elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+           rc = gpuOptimalBlockSize(&grid_sz,
+                                    &block_sz,
+                                    f_prep_gistindex,
+                                    gcontext->cuda_device,
+                                    0, 0);
+          if (rc != CUDA_SUCCESS)
+               elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+       }
+       /* launch kern_gpujoin_prep_gistindex */
+       kern_args[0] = &m_kmrels;
+       kern_args[1] = &depth;
+
+       rc = cuLaunchKernel(f_prep_gistindex,
+                           grid_sz, 1, 1,
+                           block_sz, 1, 1,
+                           0,
+                           CU_STREAM_PER_WORKER,
+                           kern_args,
+                           NULL);
+       if (rc != CUDA_SUCCESS)
+           elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+   }
+
+   if (cuda_module)
+   {
+       rc = cuStreamSynchronize(CU_STREAM_PER_WORKER);
+       if (rc != CUDA_SUCCESS)
+           elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+   }
+}
+
+/*
+ * __innerPreloadBuildHashTable
+ *
+ * It builds the hash-table of the inner buffer on the device, if the inner
+ * tuples were preloaded without hash values. Once built, the hash-table is
+ * written back to the host inner buffer, because CPU fallback and other
+ * GPU devices also reference the host buffer.
+ * Caller must hold gj_sstate->mutex, and the CUDA context must be pushed.
+ */
+static void
+__innerPreloadBuildHashTable(GpuJoinState *gjs, CUdeviceptr m_kmrels)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	kern_parambuf  *kparams = gjs->gts.kern_params;
+	CUmodule		cuda_module = NULL;
+	CUfunction		f_build_hash = NULL;
+	CUdeviceptr		m_kerror = 0UL;
+	CUdeviceptr		m_kparams;
+	CUresult		rc;
+	void		   *kern_args[4];
+	cl_int			grid_sz;
+	cl_int			block_sz;
+	cl_int			depth;
+
+	for (depth=1; depth <= gjs->num_rels; depth++)
+	{
+		kern_errorbuf *kerror;
+		size_t		offset;
+		size_t		length;
+
+		if (!h_kmrels->chunks[depth-1].device_hash_build)
+			continue;
+		/* load the CUDA module and function */
+		if (!cuda_module)
+		{
+			cuda_module = GpuContextLookupModule(gcontext,
+												 gjs->gts.program_id);
+			rc = cuModuleGetFunction(&f_build_hash,
+									 cuda_module,
+									 "gpujoin_build_hash_table");
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuModuleGetFunction: %s",
+					 errorText(rc));
+			rc = gpuOptimalBlockSize(&grid_sz,
+									 &block_sz,
+									 f_build_hash,
+									 gcontext->cuda_device,
+									 0, 0);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on gpuOptimalBlockSize: %s",
+					 errorText(rc));
+			/* error buffer and Const/Param buffer */
+			rc = gpuMemAllocManaged(gcontext,
+									&m_kerror,
+									MAXALIGN(sizeof(kern_errorbuf)) +
+									kparams->length,
+									CU_MEM_ATTACH_GLOBAL);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on gpuMemAllocManaged: %s",
+					 errorText(rc));
+			m_kparams = m_kerror + MAXALIGN(sizeof(kern_errorbuf));
+			memcpy((void *)m_kparams, kparams, kparams->length);
+		}
+		kerror = (kern_errorbuf *)m_kerror;
+		memset(kerror, 0, sizeof(kern_errorbuf));
+
+		/* launch gpujoin_build_hash_table */
+		kern_args[0] = &m_kmrels;
+		kern_args[1] = &depth;
+		kern_args[2] = &m_kparams;
+		kern_args[3] = &m_kerror;
+
+		rc = cuLaunchKernel(f_build_hash,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_WORKER,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+		rc = cuStreamSynchronize(CU_STREAM_PER_WORKER);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+		if (kerror->errcode != ERRCODE_STROM_SUCCESS)
+			ereport(ERROR,
+					(errcode(kerror->errcode & ~ERRCODE_FLAGS_CPU_FALLBACK),
+					 errmsg("GpuJoin failed on hash-table build at depth %d: %s",
+							depth, kerror->message),
+					 errhint("pg_strom.enable_gpujoin_device_hash_build = off "
+							 "builds the hash-table on the CPU")));
+
+		/* write back the hash-table (and bloom-filter/hash-bucket) to the host */
+		offset = h_kmrels->chunks[depth-1].chunk_offset;
+		length = KERN_MULTIRELS_INNER_KDS(h_kmrels, depth)->length;
+		if (h_kmrels->chunks[depth-1].bloom_offset != 0)
+			length = (h_kmrels->chunks[depth-1].bloom_offset +
+					  GPUJOIN_BLOOM_BLOCK_SIZE *
+					  h_kmrels->chunks[depth-1].bloom_nblocks) - offset;
+		if (h_kmrels->chunks[depth-1].bucket_offset != 0)
+			length = (h_kmrels->chunks[depth-1].bucket_offset +
+					  GPUJOIN_HASH_BUCKET_SIZE *
+					  h_kmrels->chunks[depth-1].bucket_nbuckets) - offset;
+		rc = cuMemcpyDtoH((char *)h_kmrels + offset,
+						  m_kmrels + offset,
+						  length);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+		h_kmrels->chunks[depth-1].device_hash_build = false;
+	}
+
+	if (m_kerror != 0UL)
+	{
+		rc = gpuMemFree(gcontext, m_kerror);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+	}
+}
+
+/*
+ * __innerPreloadCopyFromPeerDevice
+ *
+ * If any other GPU device already has the inner buffer, and it is accessible
+ * over P2P DMA from the current device, we replicate the device buffer with
+ * DtoD copy (usually, NVLink or PCIe switch) instead of HtoD copy.
+ * OUTER JOIN map is always copied from the host, because a peer device may
+ * update them concurrently. GiST-index needs to be setup on the device, so
+ * this shortcut is not applied.
+ * Caller must hold gj_sstate->mutex, and the CUDA context must be pushed.
+ */
+static bool
+__innerPreloadCopyFromPeerDevice(GpuJoinState *gjs,
+								 GpuJoinSharedState *gj_sstate,
+								 CUdeviceptr m_kmrels)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	size_t			bytesize = (h_kmrels->kmrels_length +
+								h_kmrels->ojmaps_length);
+	int				dindex = gcontext->cuda_dindex;
+	int				depth;
+	int				k;
+
+	for (depth=1; depth <= gjs->num_rels; depth++)
+	{
+		if (gjs->inners[depth-1].gist_irel)
+			return false;
+	}
+
+	for (k=0; k < numDevAttrs; k++)
+	{
+		CUdevice		peer_device;
+		CUdeviceptr		m_peer;
+		CUresult		rc;
+		int				can_access;
+
+		if (k == dindex || gj_sstate->pergpu[k].bytesize != bytesize)
+			continue;
+		rc = cuDeviceGet(&peer_device, devAttrs[k].DEV_ID);
+		if (rc != CUDA_SUCCESS)
+			continue;
+		rc = cuDeviceCanAccessPeer(&can_access,
+								   gcontext->cuda_device,
+								   peer_device);
+		if (rc != CUDA_SUCCESS || !can_access)
+			continue;
+
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &m_peer,
+								 gj_sstate->pergpu[k].ipc_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			continue;
+		rc = cuMemcpyDtoD(m_kmrels, m_peer, h_kmrels->kmrels_length);
+		if (rc == CUDA_SUCCESS && h_kmrels->ojmaps_length > 0)
+			rc = cuMemcpyHtoD(m_kmrels + h_kmrels->kmrels_length,
+							  (char *)h_kmrels + h_kmrels->kmrels_length,
+							  h_kmrels->ojmaps_length);
+		if (gpuIpcCloseMemHandle(gcontext, m_peer) != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuIpcCloseMemHandle");
+		if (rc == CUDA_SUCCESS)
+		{
+			elog(DEBUG2, "GpuJoin inner buffer replicated from GPU%d to GPU%d",
+				 devAttrs[k].DEV_ID, devAttrs[dindex].DEV_ID);
+			return true;
+		}
+		elog(DEBUG2, "failed on P2P copy of inner buffer: %s", errorText(rc));
+	}
+	return false;
+}
+
+/*
+ * GpuJoinInnerCache
+ *
+ * Shared cache of the inner buffers (host shared memory and preserved device
+ * memory), to reuse them for the later GpuJoin which has identical inner
+ * plans, instead of the rebuild by innerPreloadExecOneDepth().
+ *
+ * A cached inner buffer is valid only if none of inner relations are
+ * modified since its build. All the heap pages must be all-visible at the
+ * capture prior to the inner scan, and at the lookup; it ensures no tuples
+ * are invisible to the snapshot of the builder but visible to the later
+ * ones. Any modification clears the all-visible bit of the heap page, and
+ * only VACUUM sets it again, with update of the visibility-map page LSN.
+ * So, we compare the number of blocks and the largest LSN of the visibility
+ * map pages; it needs to read only one page per 32K heap blocks.
+ * Gstore_Fdw tables (by ForeignScan or GpuScan) are also cacheable. Their
+ * contents live in the device memory already, however, the inner buffer
+ * is built on the host as usual; so, the cache keeps the dimension tables
+ * on Gstore_Fdw device resident without reload. The version of contents
+ * is compared instead of the page LSN.
+ */
+#define GPUJOIN_INNER_CACHE_NSLOTS		64
+#define GPUJOIN_INNER_CACHE_MAXRELS		8
+
+typedef struct GpuJoinInnerCacheRel
+{
+	Oid				relid;
+	BlockNumber		nblocks;
+	XLogRecPtr		vm_lsn;				/* largest LSN of VM pages */
+	uint32			gstore_revision;	/* only Gstore_Fdw */
+	uint64			gstore_version;		/* only Gstore_Fdw */
+} GpuJoinInnerCacheRel;
+
+typedef struct
+{
+	pg_crc32		cache_key;		/* 0, if free slot */
+	char		   *key_data;		/* serialized key (shared memory) */
+	size_t			key_len;
+	Oid				database_oid;
+	cl_int			cuda_dindex;
+	cl_int			refcnt;
+	TimestampTz		last_used;
+	cl_int			nrels;
+	GpuJoinInnerCacheRel rels[GPUJOIN_INNER_CACHE_MAXRELS];
+	cl_uint			shmem_handle;	/* identifier of host inner-buffer */
+	size_t			shmem_bytesize;	/* length of the host inner-buffer */
+	size_t			bytesize;		/* length of the device inner-buffer */
+	CUipcMemHandle	ipc_mhandle;	/* IPC handle of preserved memory */
+} GpuJoinInnerCacheEntry;
+
+typedef struct
+{
+	slock_t			lock;
+	size_t			total_bytesize;
+	GpuJoinInnerCacheEntry entries[GPUJOIN_INNER_CACHE_NSLOTS];
+} GpuJoinInnerCacheHead;
+
+static GpuJoinInnerCacheHead *gj_inner_cache = NULL;
+/* number of cache entries referenced by this backend, for abort cleanup */
+static int		gj_inner_cache_refs[GPUJOIN_INNER_CACHE_NSLOTS];
+
+/*
+ * innerPreloadCacheGstoreState - returns GpuStoreFdwState if the inner
+ * plan is a simple scan on Gstore_Fdw, or NULL.
+ */
+static GpuStoreFdwState *
+innerPreloadCacheGstoreState(PlanState *ps)
+{
+	Relation	rel;
+
+	if (pgstrom_planstate_is_gpuscan(ps))
+		return ((GpuTaskState *)ps)->gs_state;
+	if (IsA(ps, ForeignScanState))
+	{
+		rel = ((ScanState *)ps)->ss_currentRelation;
+		if (rel && RelationIsGstoreFdw(rel))
+			return (GpuStoreFdwState *)((ForeignScanState *)ps)->fdw_state;
+	}
+	return NULL;
+}
+
+/*
+ * innerPreloadCacheKey - returns a hash key of the inner buffer, or 0 if
+ * not cacheable. The serialized key is built on gjs->inner_cache_keybuf.
+ */
+static pg_crc32
+innerPreloadCacheKey(GpuJoinState *gjs, GpuJoinInfo *gj_info)
+{
+	StringInfo	key = &gjs->inner_cache_keybuf;
+	pg_crc32	crc;
+	int			i, k;
+
+	if (gpujoin_inner_cache_size_mb <= 0 ||
+		gjs->num_rels > GPUJOIN_INNER_CACHE_MAXRELS)
+		return 0;
+
+	initStringInfo(key);
+	appendBinaryStringInfo(key, (char *)&MyDatabaseId, sizeof(Oid));
+	appendBinaryStringInfo(key, (char *)&gjs->num_rels, sizeof(int));
+	appendBinaryStringInfo(key, (char *)&enable_gpujoin_bloom_filter,
+						   sizeof(bool));
+	appendBinaryStringInfo(key, (char *)&enable_gpujoin_hash_bucket,
+						   sizeof(bool));
+	for (i=0; i < gjs->num_rels; i++)
+	{
+		innerState *istate = &gjs->inners[i];
+		PlanState  *ps = istate->state;
+		Plan	   *plan = ps->plan;
+		Relation	rel;
+		Oid			relid;
+		List	   *hash_keys = list_nth(gj_info->hash_inner_keys, i);
+		bool		is_gstore = (innerPreloadCacheGstoreState(ps) != NULL);
+		char	   *temp;
+
+		/* simple scan on the permanent relation or Gstore_Fdw only */
+		if ((!IsA(ps, SeqScanState) && !is_gstore) ||
+			plan->parallel_aware ||
+			plan->initPlan != NIL ||
+			!bms_is_empty(plan->extParam) ||
+			!bms_is_empty(plan->allParam) ||
+			contain_mutable_functions((Node *)plan->targetlist) ||
+			contain_mutable_functions((Node *)plan->qual))
+			return 0;
+		rel = ((ScanState *)ps)->ss_currentRelation;
+		if (!rel ||
+			(!is_gstore &&
+			 (rel->rd_rel->relpersistence != RELPERSISTENCE_PERMANENT ||
+			  !RelationNeedsWAL(rel))))
+			return 0;
+		/*
+		 * Gstore_Fdw has no all-visible state; so, the transaction snapshot
+		 * may be older than the version of the contents.
+		 */
+		if (is_gstore && IsolationUsesXactSnapshot())
+			return 0;
+		/* join properties that are built on the inner buffer */
+		if (istate->join_type != JOIN_INNER ||
+			istate->nbatches > 1 ||
+			istate->merge_join ||
+			istate->gist_irel != NULL ||
+			istate->gist_itupdesc != NULL)
+			return 0;
+
+		relid = RelationGetRelid(rel);
+		appendBinaryStringInfo(key, (char *)&relid, sizeof(Oid));
+		temp = nodeToString(plan->targetlist);
+		appendBinaryStringInfo(key, temp, strlen(temp) + 1);
+		temp = nodeToString(plan->qual);
+		appendBinaryStringInfo(key, temp, strlen(temp) + 1);
+		if (IsA(plan, ForeignScan))
+		{
+			ForeignScan *fscan = (ForeignScan *)plan;
+
+			if (contain_mutable_functions((Node *)fscan->fdw_exprs))
+				return 0;
+			temp = nodeToString(fscan->fdw_exprs);
+			appendBinaryStringInfo(key, temp, strlen(temp) + 1);
+			temp = nodeToString(fscan->fdw_private);
+			appendBinaryStringInfo(key, temp, strlen(temp) + 1);
+		}
+		else if (IsA(plan, CustomScan))
+		{
+			CustomScan *cscan = (CustomScan *)plan;
+
+			if (contain_mutable_functions((Node *)cscan->custom_exprs))
+				return 0;
+			temp = nodeToString(cscan->custom_exprs);
+			appendBinaryStringInfo(key, temp, strlen(temp) + 1);
+			temp = nodeToString(cscan->custom_private);
+			appendBinaryStringInfo(key, temp, strlen(temp) + 1);
+		}
+		temp = nodeToString(hash_keys);
+		appendBinaryStringInfo(key, temp, strlen(temp) + 1);
+		k = -1;
+		while ((k = bms_next_member(istate->preload_flatten_attrs, k)) >= 0)
+			appendBinaryStringInfo(key, (char *)&k, sizeof(int));
+	}
+	INIT_LEGACY_CRC32(crc);
+	COMP_LEGACY_CRC32(crc, key->data, key->len);
+	FIN_LEGACY_CRC32(crc);
+
+	return (crc != 0 ? crc : 1);
+}
+
+/*
+ * innerPreloadCacheRelState - fetch the number of blocks and the largest
+ * page LSN of the visibility map of the relation. It returns false if any
+ * pages are not all-visible.
+ * In case of Gstore_Fdw, it fetches the version of contents instead, and
+ * returns false if the contents are not stable.
+ */
+static bool
+innerPreloadCacheRelState(ScanState *ss, GpuJoinInnerCacheRel *crel)
+{
+	Relation	rel = ss->ss_currentRelation;
+	GpuStoreFdwState *gs_state = innerPreloadCacheGstoreState(&ss->ps);
+	BlockNumber	nblocks;
+	BlockNumber	vm_nblocks;
+	BlockNumber	all_visible;
+	BlockNumber	blkno;
+	XLogRecPtr	vm_lsn = InvalidXLogRecPtr;
+
+	memset(crel, 0, sizeof(GpuJoinInnerCacheRel));
+	crel->relid = RelationGetRelid(rel);
+	if (gs_state)
+		return ExecGstoreFdwGetDataVersion(gs_state,
+										   &crel->gstore_revision,
+										   &crel->gstore_version);
+	nblocks = RelationGetNumberOfBlocks(rel);
+	visibilitymap_count(rel, &all_visible, NULL);
+	if (all_visible != nblocks)
+		return false;
+
+	RelationOpenSmgr(rel);
+	if (nblocks > 0 && smgrexists(rel->rd_smgr, VISIBILITYMAP_FORKNUM))
+	{
+		vm_nblocks = smgrnblocks(rel->rd_smgr, VISIBILITYMAP_FORKNUM);
+		for (blkno=0; blkno < vm_nblocks; blkno++)
+		{
+			Buffer		buffer;
+			XLogRecPtr	lsn;
+
+			CHECK_FOR_INTERRUPTS();
+			buffer = ReadBufferExtended(rel, VISIBILITYMAP_FORKNUM, blkno,
+										RBM_ZERO_ON_ERROR, NULL);
+			LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			lsn = PageGetLSN(BufferGetPage(buffer));
+			UnlockReleaseBuffer(buffer);
+			if (vm_lsn < lsn)
+				vm_lsn = lsn;
+		}
+	}
+	crel->nblocks = nblocks;
+	crel->vm_lsn = vm_lsn;
+	return true;
+}
+
+/*
+ * innerPreloadCacheCapture - capture the state of inner relations prior
+ * to the inner scan
+ */
+static void
+innerPreloadCacheCapture(GpuJoinState *gjs)
+{
+	EState	   *estate = gjs->gts.css.ss.ps.state;
+	int			i;
+
+	gjs->inner_cache_capture = false;
+	if (!gjs->inner_cache_rels)
+		gjs->inner_cache_rels =
+			MemoryContextAlloc(estate->es_query_cxt,
+							   sizeof(GpuJoinInnerCacheRel) * gjs->num_rels);
+	for (i=0; i < gjs->num_rels; i++)
+	{
+		ScanState  *ss = (ScanState *)gjs->inners[i].state;
+
+		if (!innerPreloadCacheRelState(ss, &gjs->inner_cache_rels[i]))
+			return;
+	}
+	gjs->inner_cache_capture = true;
+}
+
+/*
+ * innerPreloadCacheEvict - release the inner buffer once cached
+ */
+static void
+innerPreloadCacheEvict(GpuJoinInnerCacheEntry *entry)
+{
+	char		name[200];
+	CUresult	rc;
+
+	if (entry->key_data)
+		pfree(entry->key_data);
+	rc = gpuMemFreePreserved(entry->cuda_dindex, entry->ipc_mhandle);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on gpuMemFreePreserved: %s", errorText(rc));
+	snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
+			 PostPortNumber, entry->shmem_handle);
+	if (shm_unlink(name) != 0)
+		elog(WARNING, "failed on shm_unlink('%s'): %m", name);
+}
+
+/*
+ * innerPreloadCacheRelease - unreference the cached inner buffer
+ */
+static void
+innerPreloadCacheRelease(GpuJoinState *gjs)
+{
+	GpuJoinInnerCacheEntry *entry;
+	int		index = gjs->inner_cache_index;
+
+	if (index < 0)
+		return;
+	SpinLockAcquire(&gj_inner_cache->lock);
+	entry = &gj_inner_cache->entries[index];
+	Assert(entry->refcnt > 0 && gj_inner_cache_refs[index] > 0);
+	entry->refcnt--;
+	entry->last_used = GetCurrentTimestamp();
+	gj_inner_cache_refs[index]--;
+	SpinLockRelease(&gj_inner_cache->lock);
+	gjs->inner_cache_index = -1;
+}
+
+/*
+ * innerPreloadCacheLookup - try to attach the cached inner buffer
+ */
+static bool
+innerPreloadCacheLookup(GpuJoinState *gjs)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	GpuJoinInnerCacheEntry *entry = NULL;
+	GpuJoinInnerCacheEntry	temp;
+	GpuJoinInnerCacheRel	crel;
+	kern_multirels *h_kmrels;
+	CUdeviceptr		m_kmrels;
+	CUresult		rc;
+	char			name[200];
+	int				fdesc;
+	int				i, index;
+
+	SpinLockAcquire(&gj_inner_cache->lock);
+	for (index=0; index < GPUJOIN_INNER_CACHE_NSLOTS; index++)
+	{
+		entry = &gj_inner_cache->entries[index];
+		if (entry->cache_key == gjs->inner_cache_key &&
+			entry->database_oid == MyDatabaseId &&
+			entry->cuda_dindex == gcontext->cuda_dindex &&
+			entry->nrels == gjs->num_rels)
+			break;
+	}
+	if (index >= GPUJOIN_INNER_CACHE_NSLOTS)
+	{
+		SpinLockRelease(&gj_inner_cache->lock);
+		return false;
+	}
+	entry->refcnt++;
+	gj_inner_cache_refs[index]++;
+	memcpy(&temp, entry, sizeof(GpuJoinInnerCacheEntry));
+	SpinLockRelease(&gj_inner_cache->lock);
+	gjs->inner_cache_index = index;
+
+	/* hash-key is identical, but the serialized key is the same? */
+	if (temp.key_len != gjs->inner_cache_keybuf.len ||
+		memcmp(temp.key_data, gjs->inner_cache_keybuf.data,
+			   temp.key_len) != 0)
+	{
+		innerPreloadCacheRelease(gjs);
+		return false;
+	}
+
+	/* check whether inner relations are modified since the build */
+	for (i=0; i < gjs->num_rels; i++)
+	{
+		ScanState  *ss = (ScanState *)gjs->inners[i].state;
+
+		if (!innerPreloadCacheRelState(ss, &crel) ||
+			crel.relid   != temp.rels[i].relid ||
+			crel.nblocks != temp.rels[i].nblocks ||
+			crel.vm_lsn  != temp.rels[i].vm_lsn ||
+			crel.gstore_revision != temp.rels[i].gstore_revision ||
+			crel.gstore_version  != temp.rels[i].gstore_version)
+		{
+			bool	evict = false;
+
+			/* invalidation of the cache entry */
+			SpinLockAcquire(&gj_inner_cache->lock);
+			gj_inner_cache_refs[index]--;
+			if (--entry->refcnt == 0 &&
+				entry->cache_key == temp.cache_key)
+			{
+				gj_inner_cache->total_bytesize -= (entry->bytesize +
+												   entry->shmem_bytesize);
+				memset(entry, 0, sizeof(GpuJoinInnerCacheEntry));
+				evict = true;
+			}
+			SpinLockRelease(&gj_inner_cache->lock);
+			gjs->inner_cache_index = -1;
+			if (evict)
+				innerPreloadCacheEvict(&temp);
+			return false;
+		}
+	}
+
+	/* mmap host buffer; private mapping not to break the cache */
+	snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
+			 PostPortNumber, temp.shmem_handle);
+	fdesc = shm_open(name, O_RDWR, 0);
+	if (fdesc < 0)
+		elog(ERROR, "failed on shm_open('%s'): %m", name);
+	h_kmrels = __mmapFile(NULL, TYPEALIGN(PAGE_SIZE, temp.shmem_bytesize),
+						  PROT_READ | PROT_WRITE,
+						  MAP_PRIVATE,
+						  fdesc, 0);
+	if (h_kmrels == MAP_FAILED)
+	{
+		close(fdesc);
+		elog(ERROR, "failed on mmap('%s'): %m", name);
+	}
+	close(fdesc);
+	gjs->h_kmrels = h_kmrels;
+
+	/* open the preserved device memory */
+	rc = gpuIpcOpenMemHandle(gcontext,
+							 &m_kmrels,
+							 temp.ipc_mhandle,
+							 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+	gjs->m_kmrels = m_kmrels;
+	gjs->m_kmrels_owner = true;
+
+	gj_sstate->phase = INNER_PHASE__GPUJOIN_EXEC;
+	pg_atomic_fetch_add_u32(&gj_sstate->needs_colocation, 1);
+	gj_sstate->curr_outer_depth = -1;
+
+	elog(DEBUG2, "GpuJoin reuses the cached inner buffer (%s)",
+		 format_bytesz(temp.bytesize));
+	return true;
+}
+
+/*
+ * innerPreloadCacheInsert - hand over the inner buffer built by this
+ * GpuJoin to the cache.
+ */
+static void
+innerPreloadCacheInsert(GpuJoinState *gjs)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	GpuJoinInnerCacheEntry *entry;
+	GpuJoinInnerCacheEntry	victims[GPUJOIN_INNER_CACHE_NSLOTS];
+	size_t			limit = (size_t)gpujoin_inner_cache_size_mb << 20;
+	size_t			required;
+	int				dindex = gcontext->cuda_dindex;
+	int				i, nvictims = 0;
+	int				index = -1;
+	char		   *key_data;
+
+	required = (gj_sstate->pergpu[dindex].bytesize +
+				gj_sstate->shmem_bytesize);
+	if (required > limit)
+		return;
+	/* spinlock section must not allocate memory */
+	key_data = MemoryContextAlloc(TopSharedMemoryContext,
+								  gjs->inner_cache_keybuf.len);
+	memcpy(key_data, gjs->inner_cache_keybuf.data,
+		   gjs->inner_cache_keybuf.len);
+
+	SpinLockAcquire(&gj_inner_cache->lock);
+	for (;;)
 	{
-		if (!gjs->inners[depth-1].gist_irel)
-			continue;
-		/* load the CUDA module and function */
-		if (!cuda_module)
+		GpuJoinInnerCacheEntry *lru = NULL;
+
+		/* pick up a free slot */
+		for (i=0; index < 0 && i < GPUJOIN_INNER_CACHE_NSLOTS; i++)
 		{
-			cuda_module = GpuContextLookupModule(gcontext,
-												 gjs->gts.program_id);
-           rc = cuModuleGetFunction(&f_prep_gistindex,
-                                    cuda_module,
-                                    "gpujoin_prep_gistindex");
-           if (rc != CUDA_SUCCESS)
-               elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
-           rc = gpuOptimalBlockSize(&grid_sz,
-                                    &block_sz,
-                                    f_prep_gistindex,
-                                    gcontext->cuda_device,
-                                    0, 0);
-          if (rc != CUDA_SUCCESS)
-               elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
-       }
-       /* launch kern_gpujoin_prep_gistindex */
-       kern_args[0] = &m_kmrels;
-       kern_args[1] = &depth;
+			if (gj_inner_cache->entries[i].cache_key == 0)
+				index = i;
+		}
+		if (index >= 0 &&
+			gj_inner_cache->total_bytesize + required <= limit)
+			break;
+		/* elsewhere, evict the least recently used entry */
+		for (i=0; i < GPUJOIN_INNER_CACHE_NSLOTS; i++)
+		{
+			entry = &gj_inner_cache->entries[i];
+			if (entry->cache_key != 0 && entry->refcnt == 0 &&
+				(!lru || lru->last_used > entry->last_used))
+				lru = entry;
+		}
+		if (!lru)
+		{
+			SpinLockRelease(&gj_inner_cache->lock);
+			pfree(key_data);
+			goto out;
+		}
+		memcpy(&victims[nvictims++], lru, sizeof(GpuJoinInnerCacheEntry));
+		gj_inner_cache->total_bytesize -= (lru->bytesize +
+										   lru->shmem_bytesize);
+		memset(lru, 0, sizeof(GpuJoinInnerCacheEntry));
+	}
+	entry = &gj_inner_cache->entries[index];
+	entry->cache_key = gjs->inner_cache_key;
+	entry->key_data = key_data;
+	entry->key_len = gjs->inner_cache_keybuf.len;
+	entry->database_oid = MyDatabaseId;
+	entry->cuda_dindex = dindex;
+	entry->refcnt = 1;
+	entry->last_used = GetCurrentTimestamp();
+	entry->nrels = gjs->num_rels;
+	memcpy(entry->rels, gjs->inner_cache_rels,
+		   sizeof(GpuJoinInnerCacheRel) * gjs->num_rels);
+	entry->shmem_handle = gj_sstate->shmem_handle;
+	entry->shmem_bytesize = gj_sstate->shmem_bytesize;
+	entry->bytesize = gj_sstate->pergpu[dindex].bytesize;
+	memcpy(&entry->ipc_mhandle, &gj_sstate->pergpu[dindex].ipc_mhandle,
+		   sizeof(CUipcMemHandle));
+	gj_inner_cache->total_bytesize += required;
+	gj_inner_cache_refs[index]++;
+	SpinLockRelease(&gj_inner_cache->lock);
+
+	/* cache entry owns the inner buffer from now */
+	gj_sstate->pergpu[dindex].bytesize = 0;
+	gj_sstate->shmem_handle = UINT_MAX;
+	gjs->inner_cache_index = index;
+out:
+	for (i=0; i < nvictims; i++)
+		innerPreloadCacheEvict(&victims[i]);
+}
 
-       rc = cuLaunchKernel(f_prep_gistindex,
-                           grid_sz, 1, 1,
-                           block_sz, 1, 1,
-                           0,
-                           CU_STREAM_PER_THREAD,
-                           kern_args,
-                           NULL);
-       if (rc != CUDA_SUCCESS)
-           elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
-   }
+/*
+ * gpujoinInnerCacheXactCallback - unreference the cached inner buffers
+ * on the transaction abort
+ */
+static void
+gpujoinInnerCacheXactCallback(XactEvent event, void *arg)
+{
+	int		index;
 
-   if (cuda_module)
-   {
-       rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
-       if (rc != CUDA_SUCCESS)
-           elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
-   }
+	if (event != XACT_EVENT_ABORT &&
+		event != XACT_EVENT_PARALLEL_ABORT)
+		return;
+	if (!gj_inner_cache)
+		return;
+	SpinLockAcquire(&gj_inner_cache->lock);
+	for (index=0; index < GPUJOIN_INNER_CACHE_NSLOTS; index++)
+	{
+		if (gj_inner_cache_refs[index] > 0)
+		{
+			gj_inner_cache->entries[index].refcnt -= gj_inner_cache_refs[index];
+			gj_inner_cache_refs[index] = 0;
+		}
+	}
+	SpinLockRelease(&gj_inner_cache->lock);
+}
+
+/*
+ * innerPreloadLoadManagedBuffer
+ *
+ * It loads the inner buffer larger than the device memory onto the managed
+ * memory, if pg_strom.gpu_memory_oversubscription is enabled. Inner chunks
+ * are prefetched to the device per depth as long as free device memory
+ * allows; the rest shall be migrated on demand.
+ * Only single process GpuJoin can use, because managed memory cannot be
+ * shared with other processes by IPC handle.
+ */
+static bool
+innerPreloadLoadManagedBuffer(GpuJoinState *gjs,
+							  GpuJoinSharedState *gj_sstate,
+							  size_t bytesize)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	CUdeviceptr		m_kmrels;
+	size_t			free_sz;
+	size_t			total_sz;
+	size_t			offset;
+	size_t			length;
+	CUresult		rc;
+	int				i;
+
+	if (!pgstrom_gpu_memory_oversubscription ||
+		gj_sstate->ss_handle != UINT_MAX || gjs->sibling)
+		return false;
+
+	rc = gpuMemAllocManaged(gcontext,
+							&m_kmrels,
+							bytesize,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	memcpy((void *)m_kmrels, h_kmrels, bytesize);
+
+	GPUCONTEXT_PUSH(gcontext);
+	rc = cuMemGetInfo(&free_sz, &total_sz);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemGetInfo: %s", errorText(rc));
+	free_sz = (double)free_sz * 0.9;	/* margin for other buffers */
+
+	/* header portion of the kern_multirels */
+	length = h_kmrels->chunks[0].chunk_offset;
+	rc = gpuMemPrefetchManaged(gcontext, m_kmrels, length, true);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemPrefetchManaged: %s", errorText(rc));
+	free_sz -= Min(free_sz, length);
+	/* inner chunks for each depth */
+	for (i=0; i < h_kmrels->nrels; i++)
+	{
+		kern_data_store *kds = KERN_MULTIRELS_INNER_KDS(h_kmrels, i+1);
+
+		offset = h_kmrels->chunks[i].chunk_offset;
+		length = kds->length;
+		if (length > free_sz)
+			break;
+		rc = gpuMemPrefetchManaged(gcontext, m_kmrels + offset,
+								   length, true);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemPrefetchManaged: %s",
+				 errorText(rc));
+		free_sz -= length;
+	}
+	/* hash-table must be built prior to the prefetch of outer-join map */
+	__innerPreloadBuildHashTable(gjs, m_kmrels);
+	/* outer-join map is updated by GPU kernel */
+	if (h_kmrels->ojmaps_length > 0)
+	{
+		rc = gpuMemPrefetchManaged(gcontext,
+								   m_kmrels + h_kmrels->kmrels_length,
+								   h_kmrels->ojmaps_length, false);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemPrefetchManaged: %s",
+				 errorText(rc));
+	}
+	__innerPreloadInitGiSTIndex(gjs, m_kmrels);
+	GPUCONTEXT_POP(gcontext);
+
+	elog(DEBUG2, "GpuJoin inner buffer (%s) is loaded on managed memory",
+		 format_bytesz(bytesize));
+	gjs->m_kmrels = m_kmrels;
+	gjs->m_kmrels_owner = false;
+	gjs->m_kmrels_managed = true;
+	gj_sstate->pergpu[gcontext->cuda_dindex].managed_kmrels = true;
+	pg_atomic_fetch_add_u32(&gj_sstate->needs_colocation, 1);
+	gj_sstate->curr_outer_depth = -1;
+
+	return true;
 }
 
 static void
@@ -8237,6 +11818,9 @@ innerPreloadLoadDeviceBuffer(GpuJoinState *leader,
 		rc = gpuMemAllocPreserved(dindex,
 								  &gj_sstate->pergpu[dindex].ipc_mhandle,
 								  bytesize);
+		if (rc == CUDA_ERROR_OUT_OF_MEMORY &&
+			innerPreloadLoadManagedBuffer(gjs, gj_sstate, bytesize))
+			return;
 		if (rc != CUDA_SUCCESS)
 			elog(ERROR, "failed on gpuMemAllocPreserved: %s", errorText(rc));
 		gj_sstate->pergpu[dindex].bytesize = bytesize;
@@ -8249,10 +11833,14 @@ innerPreloadLoadDeviceBuffer(GpuJoinState *leader,
 			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
 
 		GPUCONTEXT_PUSH(gcontext);
-		rc = cuMemcpyHtoD(m_kmrels, h_kmrels, bytesize);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
-		__innerPreloadInitGiSTIndex(gjs, m_kmrels);
+		if (!__innerPreloadCopyFromPeerDevice(gjs, gj_sstate, m_kmrels))
+		{
+			rc = cuMemcpyHtoD(m_kmrels, h_kmrels, bytesize);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+			__innerPreloadBuildHashTable(gjs, m_kmrels);
+			__innerPreloadInitGiSTIndex(gjs, m_kmrels);
+		}
 		GPUCONTEXT_POP(gcontext);
 
 		gjs->m_kmrels = m_kmrels;
@@ -8318,6 +11906,24 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 		leader = gjs;
 	gj_sstate = leader->gj_sstate;
 
+	/*
+	 * Try to reuse the cached inner buffer, if single process; or capture
+	 * the state of inner relations for the cache of the buffer to be built.
+	 */
+	if (gjs->inner_cache_key != 0 &&
+		leader == gjs &&
+		gj_sstate->ss_handle == UINT_MAX &&
+		gj_sstate->phase == INNER_PHASE__SCAN_RELATIONS)
+	{
+		if (innerPreloadCacheLookup(gjs))
+		{
+			if (p_m_kmrels)
+				*p_m_kmrels = gjs->m_kmrels;
+			return true;
+		}
+		innerPreloadCacheCapture(gjs);
+	}
+
 	/*
 	 * Inner PreLoad State Machine
 	 */
@@ -8415,9 +12021,17 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 												  nitems_base,
 												  usage_base);
 				else if (kds->format == KDS_FORMAT_HASH)
+				{
 					__innerPreloadSetupHashBuffer(kds, istate,
 												  nitems_base,
 												  usage_base);
+					if (!istate->device_hash_build)
+					{
+						__innerPreloadSetupHashBucket(h_kmrels, istate,
+													  kds, nitems_base);
+						__innerPreloadSetupBloomFilter(h_kmrels, istate);
+					}
+				}
 				else
 					elog(ERROR, "unexpected inner-KDS format");
 				
@@ -8438,17 +12052,41 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 				gj_sstate->nr_workers_setup == 0)
 			{
 				Assert(gj_sstate->phase == INNER_PHASE__SETUP_BUFFERS);
-				/* preload GiST index buffer, if any */
+				/* preload GiST index buffer or inner columns, if any */
 				for (i=0; i < leader->num_rels; i++)
 				{
 					innerState *istate = &leader->inners[i];
+					kern_data_store *kds_hash;
 					kern_data_store *kds_gist;
 
-					if (!istate->gist_irel)
+					/* columnar copy of the inner attributes, if any */
+					if (KERN_MULTIRELS_INNER_COLUMNS(h_kmrels, i+1))
+						__innerPreloadSetupInnerColumns(istate,
+							KERN_MULTIRELS_INNER_KDS(h_kmrels, i+1),
+							KERN_MULTIRELS_INNER_COLUMNS(h_kmrels, i+1));
+					/* sorted index for merge-join */
+					if (istate->merge_join)
+					{
+						__innerPreloadSetupMergeIndex(istate,
+							KERN_MULTIRELS_INNER_KDS(h_kmrels, i+1),
+							KERN_MULTIRELS_MERGE_INDEX(h_kmrels, i+1));
+						continue;
+					}
+					if (!istate->gist_irel && !istate->gist_itupdesc)
 						continue;
+					kds_hash = KERN_MULTIRELS_INNER_KDS(h_kmrels, i+1);
 					kds_gist = (kern_data_store *)
 						((char *)h_kmrels + h_kmrels->chunks[i].gist_offset);
-					__innerPreloadSetupGiSTIndexBuffer(istate, kds_gist);
+					if (istate->gist_irel)
+						__innerPreloadSetupGiSTIndexBuffer(istate, kds_gist);
+					else if (istate->gist_rngtyp)
+						__innerPreloadSetupSyntheticRangeIndex(istate,
+															   kds_hash,
+															   kds_gist);
+					else
+						__innerPreloadSetupSyntheticGiSTIndex(istate,
+															  kds_hash,
+															  kds_gist);
 				}
 				gj_sstate->phase = INNER_PHASE__GPUJOIN_EXEC;
 				ConditionVariableBroadcast(&gj_sstate->cond);
@@ -8497,6 +12135,16 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 	}
 	SpinLockRelease(&gj_sstate->mutex);
 
+	/* hand over the inner buffer to the cache, if captured */
+	if (gjs->inner_cache_capture)
+	{
+		gjs->inner_cache_capture = false;
+		if (gjs->m_kmrels != 0UL &&
+			gjs->m_kmrels_owner &&
+			gj_sstate->pergpu[dindex].bytesize > 0)
+			innerPreloadCacheInsert(gjs);
+	}
+
 	/*
 	 * Any backend or worker process, that tried to fetch the inner buffer
 	 * after the 'phase' is switched to INNER_PHASE__GPUJOIN_CLOSING, shall
@@ -8508,6 +12156,98 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 	return (gjs->m_kmrels != 0UL);
 }
 
+/*
+ * GpuJoinHasMultiBatchInner
+ *
+ * It returns true, if GpuJoin partitions any of inner hash table into
+ * multiple batches. Such GpuJoin cannot be combined to GpuPreAgg.
+ */
+bool
+GpuJoinHasMultiBatchInner(PlanState *ps)
+{
+	GpuJoinState   *gjs = (GpuJoinState *) ps;
+
+	Assert(pgstrom_planstate_is_gpujoin(ps));
+	return (gjs->batch_depth > 0);
+}
+
+/*
+ * gpujoinSwitchInnerBatch
+ *
+ * It replaces the contents of the partitioned inner hash table by the tuples
+ * of the specified batch, on both of the host and device buffer. Caller must
+ * ensure no GpuTasks are running.
+ */
+static void
+gpujoinSwitchInnerBatch(GpuJoinState *gjs, int batchno)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	innerState	   *istate;
+	kern_data_store *kds;
+	CUresult		rc;
+
+	Assert(gjs->batch_depth > 0 && !gjs->sibling);
+	istate = &gjs->inners[gjs->batch_depth - 1];
+	Assert(batchno >= 0 && batchno < istate->nbatches);
+	if (!h_kmrels)
+		elog(ERROR, "Bug? inner buffer of GpuJoin is not loaded yet");
+	kds = KERN_MULTIRELS_INNER_KDS(h_kmrels, istate->depth);
+	Assert(kds->format == KDS_FORMAT_HASH);
+
+	/* load the inner tuples of the batch from the temporary file */
+	MemoryContextReset(gjs->preload_memcxt);
+	slist_init(&istate->preload_tuples);
+	istate->preload_nitems = 0;
+	istate->preload_usage = 0;
+	if (istate->batch_files)
+		innerPreloadLoadOneBatch(gjs, istate, batchno);
+	if (istate->preload_nitems > kds->nrooms ||
+		KERN_DATA_STORE_HEAD_LENGTH(kds) +
+		STROMALIGN(sizeof(cl_uint) * kds->nrooms) +
+		STROMALIGN(sizeof(cl_uint) * kds->nslots) +
+		STROMALIGN(istate->preload_usage) > kds->length)
+		elog(ERROR, "Bug? GpuJoin batch %d is larger than inner buffer",
+			 batchno);
+
+	/* rebuild the hash table */
+	kds->nitems = istate->preload_nitems;
+	kds->usage = __kds_packed(istate->preload_usage);
+	memset(KERN_DATA_STORE_HASHSLOT(kds), 0, sizeof(cl_uint) * kds->nslots);
+	__innerPreloadSetupHashBuffer(kds, istate, 0, 0);
+	if (KERN_MULTIRELS_BLOOM_FILTER(h_kmrels, istate->depth))
+	{
+		memset(KERN_MULTIRELS_BLOOM_FILTER(h_kmrels, istate->depth), 0,
+			   GPUJOIN_BLOOM_BLOCK_SIZE *
+			   h_kmrels->chunks[istate->depth-1].bloom_nblocks);
+		__innerPreloadSetupBloomFilter(h_kmrels, istate);
+	}
+	if (KERN_MULTIRELS_HASH_BUCKET(h_kmrels, istate->depth))
+	{
+		memset(KERN_MULTIRELS_HASH_BUCKET(h_kmrels, istate->depth), 0,
+			   GPUJOIN_HASH_BUCKET_SIZE *
+			   h_kmrels->chunks[istate->depth-1].bucket_nbuckets);
+		__innerPreloadSetupHashBucket(h_kmrels, istate, kds, 0);
+	}
+
+	/* reset local buffer */
+	istate->preload_nitems = 0;
+	istate->preload_usage = 0;
+	slist_init(&istate->preload_tuples);
+	MemoryContextReset(gjs->preload_memcxt);
+
+	/* send the new inner buffer to the device */
+	if (gjs->m_kmrels != 0UL)
+	{
+		GPUCONTEXT_PUSH(gcontext);
+		rc = cuMemcpyHtoD(gjs->m_kmrels, h_kmrels, h_kmrels->kmrels_length);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+		GPUCONTEXT_POP(gcontext);
+	}
+	istate->curr_batch = batchno;
+}
+
 /*
  * GpuJoinInnerUnload
  */
@@ -8529,6 +12269,12 @@ GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan)
 				elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
 					 errorText(rc));
 		}
+		else if (gjs->m_kmrels_managed)
+		{
+			rc = gpuMemFree(gcontext, gjs->m_kmrels);
+			if (rc != CUDA_SUCCESS)
+				elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+		}
 		gjs->m_kmrels = 0UL;
 	}
 
@@ -8541,6 +12287,7 @@ GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan)
 		}
 		gjs->h_kmrels = NULL;
 	}
+	innerPreloadCacheRelease(gjs);
 
 	if (gj_sstate && !IsParallelWorker())
 	{
@@ -8567,35 +12314,47 @@ GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan)
 			gj_sstate->shmem_handle = UINT_MAX;
 		}
 	}
+	/* release temporary files of the multi-batch hash-join */
+	if (gjs->batch_depth > 0)
+	{
+		innerState *istate = &gjs->inners[gjs->batch_depth - 1];
+		int			k;
+
+		if (istate->batch_files)
+		{
+			for (k=0; k < istate->nbatches; k++)
+			{
+				if (istate->batch_files[k])
+					BufFileClose(istate->batch_files[k]);
+			}
+			pfree(istate->batch_files);
+			pfree(istate->batch_nitems);
+			pfree(istate->batch_usage);
+			istate->batch_files = NULL;
+			istate->batch_nitems = NULL;
+			istate->batch_usage = NULL;
+		}
+		istate->curr_batch = 0;
+	}
 	gjs->h_kmrels = NULL;
 	gjs->m_kmrels = 0UL;
 	gjs->m_kmrels_owner = false;
+	gjs->m_kmrels_managed = false;
 }
 
 /*
- * createGpuJoinSharedState
+ * __createGpuJoinHostBufferHandle
  *
- * It construct an empty inner multi-relations buffer. It can be shared with
- * multiple backends, and referenced by CPU/GPU.
+ * creation of the host inner buffer, but fallocate(2) and mmap(2) shall be
+ * done after the inner-preloading.
  */
-static void
-createGpuJoinSharedState(GpuJoinState *gjs,
-						 ParallelContext *pcxt,
-						 void *dsm_addr)
+static cl_uint
+__createGpuJoinHostBufferHandle(void)
 {
-	EState	   *estate = gjs->gts.css.ss.ps.state;
-	GpuJoinSharedState *gj_sstate;
-	GpuJoinRuntimeStat *gj_rtstat;
 	cl_uint		shmem_handle;
 	int			fdesc = -1;
 	char		name[200];
-	size_t		ss_length;
 
-	Assert(!IsParallelWorker());
-	/*
-	 * creation of the host inner buffer, but fallocate(2) and mmap(2)
-	 * shall be done after the inner-preloading.
-	 */
 	while (fdesc < 0)
 	{
 		shmem_handle = random();
@@ -8609,6 +12368,29 @@ createGpuJoinSharedState(GpuJoinState *gjs,
 	}
 	close(fdesc);
 
+	return shmem_handle;
+}
+
+/*
+ * createGpuJoinSharedState
+ *
+ * It construct an empty inner multi-relations buffer. It can be shared with
+ * multiple backends, and referenced by CPU/GPU.
+ */
+static void
+createGpuJoinSharedState(GpuJoinState *gjs,
+						 ParallelContext *pcxt,
+						 void *dsm_addr)
+{
+	EState	   *estate = gjs->gts.css.ss.ps.state;
+	GpuJoinSharedState *gj_sstate;
+	GpuJoinRuntimeStat *gj_rtstat;
+	cl_uint		shmem_handle;
+	size_t		ss_length;
+
+	Assert(!IsParallelWorker());
+	shmem_handle = __createGpuJoinHostBufferHandle();
+
 	/* allocation of the GpuJoinSharedState */
 	ss_length = (MAXALIGN(offsetof(GpuJoinSharedState,
 								   pergpu[numDevAttrs])) +
@@ -8636,6 +12418,40 @@ createGpuJoinSharedState(GpuJoinState *gjs,
 	gjs->gj_sstate = gj_sstate;
 }
 
+/*
+ * resetGpuJoinSharedState
+ *
+ * It rewinds the shared state to the initial phase, to rebuild the inner
+ * buffer on rescan. GpuJoinInnerUnload() must have released the buffers.
+ * The runtime statistics are kept as is.
+ */
+static void
+resetGpuJoinSharedState(GpuJoinState *gjs)
+{
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	int			dindex;
+
+	Assert(!IsParallelWorker());
+	if (gj_sstate->shmem_handle == UINT_MAX)
+		gj_sstate->shmem_handle = __createGpuJoinHostBufferHandle();
+	gj_sstate->shmem_bytesize = 0;
+	gj_sstate->phase = INNER_PHASE__SCAN_RELATIONS;
+	gj_sstate->nr_workers_scanning = 0;
+	gj_sstate->nr_workers_setup = 0;
+	pg_atomic_write_u32(&gj_sstate->outer_scan_done, 0);
+	pg_atomic_write_u32(&gj_sstate->needs_colocation, 0);
+	gj_sstate->curr_outer_depth = 0;
+	gj_sstate->outer_read_pos = 0;
+	gj_sstate->nr_workers_outer = 0;
+	gj_sstate->ojmaps_on_host = false;
+	for (dindex=0; dindex < numDevAttrs; dindex++)
+	{
+		Assert(gj_sstate->pergpu[dindex].bytesize == 0);
+		gj_sstate->pergpu[dindex].nr_workers_gpujoin = 0;
+		gj_sstate->pergpu[dindex].managed_kmrels = false;
+	}
+}
+
 /*
  * cleanupGpuJoinSharedStateOnAbort
  */
@@ -8669,6 +12485,26 @@ cleanupGpuJoinSharedStateOnAbort(dsm_segment *seg, Datum ptr)
 	}
 }
 
+/*
+ * pgstrom_startup_gpujoin
+ */
+static void
+pgstrom_startup_gpujoin(void)
+{
+	bool	found;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	gj_inner_cache = ShmemInitStruct("GpuJoin Inner Buffer Cache",
+									 sizeof(GpuJoinInnerCacheHead),
+									 &found);
+	if (found)
+		elog(ERROR, "Bug? GpuJoin Inner Buffer Cache exists");
+	memset(gj_inner_cache, 0, sizeof(GpuJoinInnerCacheHead));
+	SpinLockInit(&gj_inner_cache->lock);
+}
+
 /*
  * pgstrom_init_gpujoin
  *
@@ -8695,6 +12531,15 @@ pgstrom_init_gpujoin(void)
 							 PGC_USERSET,
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
+	/* turn on/off gpumergejoin */
+	DefineCustomBoolVariable("pg_strom.enable_gpumergejoin",
+							 "Enables the use of GpuMergeJoin logic",
+							 NULL,
+							 &enable_gpumergejoin,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 #if PG_VERSION_NUM >= 110000
 	/* turn on/off partition wise gpujoin */
 	DefineCustomBoolVariable("pg_strom.enable_partitionwise_gpujoin",
@@ -8708,6 +12553,80 @@ pgstrom_init_gpujoin(void)
 #else
 	enable_partitionwise_gpujoin = false;
 #endif
+	/* turn on/off multi-batch gpuhashjoin */
+	DefineCustomBoolVariable("pg_strom.enable_multibatch_gpuhashjoin",
+							 "Enables multi-batch GpuHashJoin for inner relations larger than GPU buffer",
+							 NULL,
+							 &enable_multibatch_gpuhashjoin,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off bloom-filter of GpuHashJoin */
+	DefineCustomBoolVariable("pg_strom.enable_gpujoin_bloom_filter",
+							 "Enables bloom-filter to drop outer rows prior to GpuHashJoin",
+							 NULL,
+							 &enable_gpujoin_bloom_filter,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off bucketized index of the hash-table */
+	DefineCustomBoolVariable("pg_strom.enable_gpujoin_hash_bucket",
+							 "Enables bucketized index of the GpuHashJoin hash-table for device side probe",
+							 NULL,
+							 &enable_gpujoin_hash_bucket,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off hash-table build on the device side */
+	DefineCustomBoolVariable("pg_strom.enable_gpujoin_device_hash_build",
+							 "Enables GpuHashJoin to build the inner hash-table on the device",
+							 NULL,
+							 &enable_gpujoin_device_hash_build,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off columnar copy of the inner attributes */
+	DefineCustomBoolVariable("pg_strom.enable_gpujoin_inner_columns",
+							 "Enables GpuNestLoop and GiST-join to load the inner attributes referenced by join quals in columnar format",
+							 NULL,
+							 &enable_gpujoin_inner_columns,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off runtime join order switch of GpuHashJoin */
+	DefineCustomBoolVariable("pg_strom.enable_gpujoin_reorder",
+							 "Enables GpuHashJoin to switch the depth order according to the observed selectivity",
+							 NULL,
+							 &enable_gpujoin_reorder,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off synthetic GiST index of GpuNestLoop */
+	DefineCustomBoolVariable("pg_strom.enable_gpujoin_synthetic_gist",
+							 "Enables GpuNestLoop to build R-tree on the inner geometry or range values on the fly",
+							 NULL,
+							 &enable_gpujoin_synthetic_gist,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* size of the shared inner buffer cache */
+	DefineCustomIntVariable("pg_strom.gpujoin_inner_cache_size",
+							"Size of the shared cache of GpuJoin inner buffers",
+							NULL,
+							&gpujoin_inner_cache_size_mb,
+							0,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_MB,
+							NULL, NULL, NULL);
 	/* setup path methods */
 	gpujoin_path_methods.CustomName				= "GpuJoin";
 	gpujoin_path_methods.PlanCustomPath			= PlanGpuJoinPath;
@@ -8732,6 +12651,12 @@ pgstrom_init_gpujoin(void)
 	gpujoin_exec_methods.ShutdownCustomScan		= ExecShutdownGpuJoin;
 	gpujoin_exec_methods.ExplainCustomScan		= ExplainGpuJoin;
 
+	/* shared cache of the inner buffer */
+	RequestAddinShmemSpace(MAXALIGN(sizeof(GpuJoinInnerCacheHead)));
+	shmem_startup_next = shmem_startup_hook;
+	shmem_startup_hook = pgstrom_startup_gpujoin;
+	RegisterXactCallback(gpujoinInnerCacheXactCallback, NULL);
+
 	/* hook registration */
 	set_join_pathlist_next = set_join_pathlist_hook;
 	set_join_pathlist_hook = gpujoin_add_join_path;
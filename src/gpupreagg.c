@@ -28,6 +28,8 @@ static bool					enable_gpupreagg;				/* GUC */
 static bool					enable_pullup_outer_join;		/* GUC */
 static bool					enable_partitionwise_gpupreagg;	/* GUC */
 static bool					enable_numeric_aggfuncs; 		/* GUC */
+static bool					enable_final_gpupreagg;			/* GUC */
+static bool					enable_fused_gpupreagg;			/* GUC */
 static double				gpupreagg_reduction_threshold;	/* GUC */
 
 typedef struct
@@ -55,6 +57,9 @@ typedef struct
 	cl_uint			extra_flags;
 	cl_uint			varlena_bufsz;
 	List		   *used_params;	/* referenced Const/Param */
+	bool			final_mode;		/* results are not aggregated on CPU */
+	cl_int			sibling_param_id; /* param slot of final buffer sharing */
+	cl_int		   *sibling_param_ref; /* only planner stage */
 } GpuPreAggInfo;
 
 static inline void
@@ -84,6 +89,8 @@ form_gpupreagg_info(CustomScan *cscan, GpuPreAggInfo *gpa_info)
 	privs = lappend(privs, makeInteger(gpa_info->extra_flags));
 	privs = lappend(privs, makeInteger(gpa_info->varlena_bufsz));
 	exprs = lappend(exprs, gpa_info->used_params);
+	privs = lappend(privs, makeInteger(gpa_info->final_mode));
+	privs = lappend(privs, makeInteger(gpa_info->sibling_param_id));
 
 	cscan->custom_private = privs;
 	cscan->custom_exprs = exprs;
@@ -119,12 +126,43 @@ deform_gpupreagg_info(CustomScan *cscan)
 	gpa_info->extra_flags = intVal(list_nth(privs, pindex++));
 	gpa_info->varlena_bufsz = intVal(list_nth(privs, pindex++));
 	gpa_info->used_params = list_nth(exprs, eindex++);
+	gpa_info->final_mode = intVal(list_nth(privs, pindex++));
+	gpa_info->sibling_param_id = intVal(list_nth(privs, pindex++));
 	Assert(pindex == list_length(privs));
 	Assert(eindex == list_length(exprs));
 
 	return gpa_info;
 }
 
+/*
+ * GpuPreAggSiblingState
+ *
+ * GpuPreAgg nodes under a partition-wise Append run one by one, and every
+ * node needs a final buffer and a final hash-slot of the same size. Once
+ * a node returned all the results, it puts back its buffer here, then the
+ * next sibling on the same GpuContext reuses it without new allocation.
+ */
+typedef struct
+{
+	cl_int			nr_siblings;	/* number of the sibling nodes */
+	GpuContext	   *gcontext;		/* GpuContext of the free buffer */
+	pgstrom_data_store *pds_final;	/* free final buffer, if any */
+	CUdeviceptr		m_fhash;		/* free final hash-slot, if any */
+	size_t			f_hashlimit;
+} GpuPreAggSiblingState;
+
+/*
+ * Spill-out of the final buffer
+ *
+ * Once the final buffer has no space for new groups, GPU kernel raises
+ * DataStoreNoSpace error. Unless GpuPreAgg runs in the final mode, the
+ * host side moves the final buffer to the host memory, then switches to
+ * a new empty one and retries the reduction. The spilled buffers are
+ * returned with the last one at the end, and CPU Agg merges partial
+ * results of the same groups in the different buffers.
+ */
+#define GPUPREAGG_MAX_SPILL_BUFFERS		32
+
 /*
  * GpuPreAggSharedState - to be allocated on DSM
  */
@@ -134,7 +172,9 @@ typedef struct
 	struct GpuPreAggSharedState *gpa_sstate;
 	struct GpuPreAggRuntimeStat *gpa_rtstat;
 	cl_bool			combined_gpujoin;
+	cl_bool			fused_nogroup;	/* combined GpuJoin reduces rows */
 	cl_bool			terminator_done;
+	cl_bool			final_mode;
 	cl_int			num_group_keys;
 	TupleTableSlot *gpreagg_slot;	/* Slot reflects tlist_dev (w/o junks) */
 	ExprState	   *outer_quals;
@@ -142,19 +182,48 @@ typedef struct
 	ProjectionInfo *outer_proj;		/* outer tlist -> custom_scan_tlist */
 
 	kern_data_store *kds_slot_head;
+	GpuPreAggSiblingState *sibling;	/* only partition-wise GpuPreAgg */
 	pgstrom_data_store *pds_final;
 	CUdeviceptr		m_fhash;
 	CUevent			ev_init_fhash;
 	size_t			f_hashsize;
 	size_t			f_hashlimit;
 	pthread_mutex_t	f_mutex;
+	/* final buffers spilled out to the host memory */
+	pthread_rwlock_t f_rwlock;		/* shared lock during final reduction */
+	cl_uint			f_generation;	/* incremented on every spill-out */
+	cl_int			num_spills;
+	cl_int			curr_spill;		/* next spilled buffer to be returned */
+	pgstrom_data_store *pds_spill[GPUPREAGG_MAX_SPILL_BUFFERS];
 
 	size_t			plan_nrows_per_chunk;	/* planned nrows/chunk */
 	size_t			plan_nrows_in;	/* num of outer rows planned */
 	size_t			plan_ngroups;	/* num of groups planned */
 	size_t			plan_extra_sz;	/* size of varlena planned */
+
+	/* run-time selection of the local reduction */
+	pg_atomic_uint32 lr_mode;		/* one of GPUPREAGG_LOCAL_REDUCTION__* */
+	pg_atomic_uint32 lr_nsamples;	/* # of sampled kernel invocations */
+	pg_atomic_uint64 lr_nitems;		/* # of sampled rows */
+	pg_atomic_uint64 lr_ngroups;	/* # of groups by local reduction */
 } GpuPreAggState;
 
+/*
+ * Run-time selection of the local reduction
+ *
+ * Group-by reduction kernel merges rows with same grouping-keys on the
+ * shared memory prior to the final hash-slot. It is waste of cycles if most
+ * of rows have individual grouping-keys, but the planner cannot know it
+ * if number of groups is mis-estimated. So, the first kernel invocations
+ * count number of the groups made by the local reduction, then the later
+ * ones skip it if the local reduction does not reduce enough rows.
+ */
+#define GPUPREAGG_LOCAL_REDUCTION__SAMPLING		0
+#define GPUPREAGG_LOCAL_REDUCTION__ENABLED		1
+#define GPUPREAGG_LOCAL_REDUCTION__DISABLED		2
+#define GPUPREAGG_LOCAL_REDUCTION_NSAMPLES		4
+#define GPUPREAGG_LOCAL_REDUCTION_THRESHOLD		0.50
+
 struct GpuPreAggRuntimeStat
 {
 	GpuTaskRuntimeStat	c;		/* common statistics */
@@ -222,6 +291,8 @@ static void createGpuPreAggSharedState(GpuPreAggState *gpas,
 									   void *dsm_addr);
 static void releaseGpuPreAggSharedState(GpuPreAggState *gpas);
 static void resetGpuPreAggSharedState(GpuPreAggState *gpas);
+static void gpupreagg_putback_final_buffer(GpuPreAggState *gpas);
+static void gpupreagg_release_spilled_buffers(GpuPreAggState *gpas);
 
 static GpuTask *gpupreagg_next_task(GpuTaskState *gts);
 static GpuTask *gpupreagg_terminator_task(GpuTaskState *gts,
@@ -243,6 +314,20 @@ static TupleTableSlot *gpupreagg_next_tuple(GpuTaskState *gts);
 #define ALTFUNC_EXPR_PCOV_X2		108	/* PCOV_X2(X,Y) */
 #define ALTFUNC_EXPR_PCOV_Y2		109	/* PCOV_Y2(X,Y) */
 #define ALTFUNC_EXPR_PCOV_XY		110	/* PCOV_XY(X,Y) */
+#define ALTFUNC_EXPR_HLL_BUCKET		111	/* HLL_BUCKET(X) as grouping-key */
+#define ALTFUNC_EXPR_HLL_RANK		112	/* PMAX(HLL_RANK(X)) */
+#define ALTFUNC_EXPR_DDS_BUCKET		113	/* DDS_BUCKET(X) as grouping-key */
+#define ALTFUNC_EXPR_CONST_ARG2		114	/* 2nd argument as a constant */
+#define ALTFUNC_EXPR_PSUM_NUMHI		115	/* PSUM(NUMERIC_SCALED_HI(X,s)) */
+#define ALTFUNC_EXPR_PSUM_NUMLO		116	/* PSUM(NUMERIC_SCALED_LO(X,s)) */
+#define ALTFUNC_EXPR_NUMERIC_SCALE	117	/* scale of NUMERIC(p,s) as a constant */
+#define ALTFUNC_EXPR_VALUE_KEY		118	/* X itself as grouping-key */
+
+/*
+ * Rough estimation of the number of DDSketch buckets per group; values in
+ * the range of 1e-4 ... 1e+4 are covered by ~900 buckets.
+ */
+#define DDS_ESTIMATED_NUM_BUCKETS	1000
 
 /*
  * XXX - GpuPreAgg with Numeric arguments are problematic because
@@ -253,6 +338,14 @@ static TupleTableSlot *gpupreagg_next_tuple(GpuTaskState *gts);
  */
 #define GPUPREAGG_SUPPORT_NUMERIC			1
 
+/*
+ * SUM/AVG of NUMERIC(p,s) with p <= NUMERIC_EXACT_MAX_PRECISION are
+ * accumulated exactly; the value is scaled to an integer (X * 10^s), then
+ * split into the upper and lower 32bit parts to be summed up by int8 atomic
+ * operations without overflow.
+ */
+#define NUMERIC_EXACT_MAX_PRECISION		18
+
 #ifndef INT8ARRAYOID
 #define INT8ARRAYOID		1016	/* see pg_type.h */
 #endif
@@ -267,7 +360,10 @@ static TupleTableSlot *gpupreagg_next_tuple(GpuTaskState *gts);
  * List of supported aggregate functions
  */
 typedef struct {
-	/* aggregate function can be preprocessed */
+	/*
+	 * aggregate function can be preprocessed
+	 * "s:" prefix means PG-Strom's special ones in pgstrom schema
+	 */
 	const char *aggfn_name;
 	int			aggfn_nargs;
 	Oid			aggfn_argtypes[4];
@@ -285,6 +381,8 @@ typedef struct {
 	int			partfn_argexprs[8];
 	int			extra_flags;
 	bool		numeric_aware;	/* ignored, if !enable_numeric_aggfuncs */
+	bool		numeric_exact;	/* only NUMERIC(p,s) with p <= 18 */
+	bool		ordered_set;	/* WITHIN GROUP (ORDER BY X) in ASC order */
 } aggfunc_catalog_t;
 static aggfunc_catalog_t  aggfunc_catalog[] = {
 	/* AVG(X) = EX_AVG(NROWS(), PSUM(X)) */
@@ -303,6 +401,11 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	  "s:pavg", 2, {INT8OID, INT8OID},
 	  {ALTFUNC_EXPR_NROWS, ALTFUNC_EXPR_PSUM}, 0, false
 	},
+	{ "avg",    1, {FLOAT2OID},
+	  "s:favg",     FLOAT8ARRAYOID,
+	  "s:pavg", 2, {INT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_NROWS, ALTFUNC_EXPR_PSUM}, 0, false
+	},
 	{ "avg",    1, {FLOAT4OID},
 	  "s:favg",     FLOAT8ARRAYOID,
 	  "s:pavg", 2, {INT8OID, FLOAT8OID},
@@ -314,6 +417,14 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	  {ALTFUNC_EXPR_NROWS, ALTFUNC_EXPR_PSUM}, 0, false
 	},
 #ifdef GPUPREAGG_SUPPORT_NUMERIC
+	{ "avg",	1, {NUMERICOID},
+	  "s:favg",     NUMERICARRAYOID,
+	  "s:pavg_numeric", 4, {INT8OID, INT8OID, INT8OID, INT4OID},
+	  {ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_PSUM_NUMHI,
+	   ALTFUNC_EXPR_PSUM_NUMLO,
+	   ALTFUNC_EXPR_NUMERIC_SCALE}, 0, true, true
+	},
 	{ "avg",	1, {NUMERICOID},
 	  "s:favg_numeric", FLOAT8ARRAYOID,
 	  "s:pavg", 2, {INT8OID, FLOAT8OID},
@@ -465,6 +576,11 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	  "varref", 1, {INT8OID},
 	  {ALTFUNC_EXPR_PSUM}, 0, false
 	},
+	{ "sum",    1, {FLOAT2OID},
+	  "c:sum",      FLOAT8OID,
+	  "varref", 1, {FLOAT8OID},
+	  {ALTFUNC_EXPR_PSUM}, 0, false
+	},
 	{ "sum",    1, {FLOAT4OID},
 	  "c:sum",      FLOAT4OID,
 	  "varref", 1, {FLOAT4OID},
@@ -476,6 +592,13 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	  {ALTFUNC_EXPR_PSUM}, 0, false
 	},
 #ifdef GPUPREAGG_SUPPORT_NUMERIC
+	{ "sum",    1, {NUMERICOID},
+	  "c:sum",      NUMERICOID,
+	  "s:psum_numeric", 3, {INT8OID, INT8OID, INT4OID},
+	  {ALTFUNC_EXPR_PSUM_NUMHI,
+	   ALTFUNC_EXPR_PSUM_NUMLO,
+	   ALTFUNC_EXPR_NUMERIC_SCALE}, 0, true, true
+	},
 	{ "sum",    1, {NUMERICOID},
 	  "s:fsum_numeric", FLOAT8OID,
 	  "varref", 1, {FLOAT8OID},
@@ -509,6 +632,13 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	   ALTFUNC_EXPR_PSUM,
 	   ALTFUNC_EXPR_PSUM_X2}, 0, false
 	},
+	{ "stddev",      1, {FLOAT2OID},
+	  "s:stddev",        FLOAT8ARRAYOID,
+	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_PSUM,
+	   ALTFUNC_EXPR_PSUM_X2}, 0, false
+	},
 	{ "stddev",      1, {FLOAT4OID},
 	  "s:stddev",        FLOAT8ARRAYOID,
 	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
@@ -554,6 +684,13 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	   ALTFUNC_EXPR_PSUM,
 	   ALTFUNC_EXPR_PSUM_X2}, 0
 	},
+	{ "stddev_pop",  1, {FLOAT2OID},
+	  "s:stddev_pop",    FLOAT8ARRAYOID,
+	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_PSUM,
+	   ALTFUNC_EXPR_PSUM_X2}, 0
+	},
 	{ "stddev_pop",  1, {FLOAT4OID},
 	  "s:stddev_pop",    FLOAT8ARRAYOID,
 	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
@@ -599,6 +736,13 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	   ALTFUNC_EXPR_PSUM,
 	   ALTFUNC_EXPR_PSUM_X2}, 0
 	},
+	{ "stddev_samp", 1, {FLOAT2OID},
+	  "s:stddev_samp",   FLOAT8ARRAYOID,
+	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_PSUM,
+	   ALTFUNC_EXPR_PSUM_X2}, 0
+	},
 	{ "stddev_samp", 1, {FLOAT4OID},
 	  "s:stddev_samp",   FLOAT8ARRAYOID,
 	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
@@ -644,6 +788,13 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	   ALTFUNC_EXPR_PSUM,
 	   ALTFUNC_EXPR_PSUM_X2}, 0
 	},
+	{ "variance",    1, {FLOAT2OID},
+	  "s:variance",      FLOAT8ARRAYOID,
+	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_PSUM,
+	   ALTFUNC_EXPR_PSUM_X2}, 0
+	},
 	{ "variance",    1, {FLOAT4OID},
 	  "s:variance",      FLOAT8ARRAYOID,
 	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
@@ -689,6 +840,13 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	   ALTFUNC_EXPR_PSUM,
 	   ALTFUNC_EXPR_PSUM_X2}, 0
 	},
+	{ "var_pop",     1, {FLOAT2OID},
+	  "s:var_pop",       FLOAT8ARRAYOID,
+	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_PSUM,
+	   ALTFUNC_EXPR_PSUM_X2}, 0
+	},
 	{ "var_pop",     1, {FLOAT4OID},
 	  "s:var_pop",       FLOAT8ARRAYOID,
 	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
@@ -734,6 +892,13 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	   ALTFUNC_EXPR_PSUM,
 	   ALTFUNC_EXPR_PSUM_X2}, 0
 	},
+	{ "var_samp",    1, {FLOAT2OID},
+	  "s:var_samp",      FLOAT8ARRAYOID,
+	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_PSUM,
+	   ALTFUNC_EXPR_PSUM_X2}, 0
+	},
 	{ "var_samp",    1, {FLOAT4OID},
 	  "s:var_samp",      FLOAT8ARRAYOID,
 	  "s:pvariance", 3, {INT8OID, FLOAT8OID, FLOAT8OID},
@@ -895,11 +1060,74 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	   ALTFUNC_EXPR_PCOV_Y2,
 	   ALTFUNC_EXPR_PCOV_XY}, 0
 	},
+	/*
+	 * HLL_COUNT(X) = HLL_MERGE(PHLL(HLL_BUCKET(X), PMAX(HLL_RANK(X))))
+	 * HLL_BUCKET(X) is a grouping-key of GpuPreAgg
+	 */
+	{ "s:hll_count", 1, {ANYELEMENTOID},
+	  "s:hll_merge", INT8OID,
+	  "s:phll", 2, {INT4OID, INT4OID},
+	  {ALTFUNC_EXPR_HLL_BUCKET,
+	   ALTFUNC_EXPR_HLL_RANK}, 0, false
+	},
+	/*
+	 * APPROX_PERCENTILE(X,P) = DDS_MERGE(PDDS(DDS_BUCKET(X), NROWS(X,P), P))
+	 * DDS_BUCKET(X) is a grouping-key of GpuPreAgg
+	 */
+	{ "s:approx_percentile", 2, {FLOAT8OID, FLOAT8OID},
+	  "s:dds_merge", FLOAT8ARRAYOID,
+	  "s:pdds", 3, {INT4OID, INT8OID, FLOAT8OID},
+	  {ALTFUNC_EXPR_DDS_BUCKET,
+	   ALTFUNC_EXPR_NROWS,
+	   ALTFUNC_EXPR_CONST_ARG2}, 0, false
+	},
+	/*
+	 * MODE() WITHIN GROUP (ORDER BY X) = MODE_MERGE(X, NROWS(X))
+	 * X itself is a grouping-key of GpuPreAgg, then the final aggregate
+	 * takes the histogram of the values as is.
+	 * Only types whose equality implies binary identity are accepted, see
+	 * aggfunc_value_key_is_binary_equal().
+	 */
+	{ "mode", 1, {ANYELEMENTOID},
+	  "s:mode_merge", ANYELEMENTOID,
+	  "varref", 2, {ANYELEMENTOID, INT8OID},
+	  {ALTFUNC_EXPR_VALUE_KEY,
+	   ALTFUNC_EXPR_NROWS}, 0, false, false, true
+	},
 };
 
+/*
+ * aggfunc_numeric_exact_scale
+ *
+ * It returns the scale of the NUMERIC(p,s) argument, if the aggregate can
+ * be accumulated exactly as scaled integers. Otherwise, -1.
+ */
+static int
+aggfunc_numeric_exact_scale(Aggref *aggref)
+{
+	TargetEntry *tle;
+	int32		typmod;
+	int			precision;
+
+	if (list_length(aggref->args) != 1)
+		return -1;
+	tle = linitial(aggref->args);
+	Assert(IsA(tle, TargetEntry));
+	if (exprType((Node *)tle->expr) != NUMERICOID)
+		return -1;
+	typmod = exprTypmod((Node *)tle->expr);
+	if (typmod < (int32) VARHDRSZ)
+		return -1;		/* unconstrained numeric */
+	precision = ((typmod - VARHDRSZ) >> 16) & 0xffff;
+	if (precision > NUMERIC_EXACT_MAX_PRECISION)
+		return -1;
+	return ((typmod - VARHDRSZ) & 0xffff);
+}
+
 static const aggfunc_catalog_t *
-aggfunc_lookup_by_oid(Oid aggfnoid)
+aggfunc_lookup_by_aggref(Aggref *aggref)
 {
+	Oid				aggfnoid = aggref->aggfnoid;
 	Form_pg_proc	proform;
 	HeapTuple		htup;
 	int				i;
@@ -912,13 +1140,24 @@ aggfunc_lookup_by_oid(Oid aggfnoid)
 	for (i=0; i < lengthof(aggfunc_catalog); i++)
 	{
 		aggfunc_catalog_t  *catalog = &aggfunc_catalog[i];
+		const char		   *aggfn_name = catalog->aggfn_name;
 
-		if (strcmp(catalog->aggfn_name, NameStr(proform->proname)) == 0 &&
+		if (strncmp(aggfn_name, "s:", 2) == 0)
+		{
+			if (proform->pronamespace != get_namespace_oid("pgstrom", false))
+				continue;
+			aggfn_name += 2;
+		}
+		if (strcmp(aggfn_name, NameStr(proform->proname)) == 0 &&
 			catalog->aggfn_nargs == proform->pronargs &&
 			memcmp(catalog->aggfn_argtypes,
 				   proform->proargtypes.values,
 				   sizeof(Oid) * catalog->aggfn_nargs) == 0)
 		{
+			/* exact NUMERIC aggregation needs NUMERIC(p,s) argument */
+			if (catalog->numeric_exact &&
+				aggfunc_numeric_exact_scale(aggref) < 0)
+				continue;
 			/* check status of device NUMERIC type support */
 			if (!enable_numeric_aggfuncs && catalog->numeric_aware)
 				catalog = NULL;
@@ -949,7 +1188,9 @@ cost_gpupreagg(PlannerInfo *root,
 			   List *index_quals,
 			   cl_long index_nblocks)
 {
-	double		gpu_cpu_ratio = pgstrom_gpu_operator_cost / cpu_operator_cost;
+	Cost		gpu_operator_cost = pgstromGpuOperatorCost(gpa_info->optimal_gpu);
+	Cost		gpu_setup_cost = pgstromGpuSetupCost(gpa_info->optimal_gpu);
+	double		gpu_cpu_ratio = gpu_operator_cost / cpu_operator_cost;
 	double		ntuples_out;
 	Cost		startup_cost;
 	Cost		run_cost;
@@ -976,13 +1217,14 @@ cost_gpupreagg(PlannerInfo *root,
 			pgstrom_path_is_gpujoin(input_path) &&
 			pgstrom_device_expression(root, outer_rel, (Expr *)outer_tlist))
 		{
-			outer_total -= cost_for_dma_receive(input_path->parent, -1.0);
+			outer_total -= cost_for_dma_receive(input_path->parent, -1.0,
+												gpa_info->optimal_gpu);
 			outer_total -= cpu_tuple_cost * input_path->rows;
 		}
 		else if (pathtree_has_gpupath(input_path))
-			outer_total += pgstrom_gpu_setup_cost / 2;
+			outer_total += gpu_setup_cost / 2;
 		else
-			outer_total += pgstrom_gpu_setup_cost;
+			outer_total += gpu_setup_cost;
 
 		gpa_info->outer_startup_cost = outer_startup;
 		gpa_info->outer_total_cost   = outer_total;
@@ -1080,7 +1322,7 @@ cost_gpupreagg(PlannerInfo *root,
 	startup_cost += (target_device->cost.per_tuple * input_path->rows +
 					 target_device->cost.startup) * gpu_cpu_ratio;
 	/* Cost estimation for grouping */
-	startup_cost += (pgstrom_gpu_operator_cost *
+	startup_cost += (gpu_operator_cost *
 					 num_group_keys *
 					 input_path->rows);
 	/* Cost estimation for aggregate function */
@@ -1328,6 +1570,7 @@ try_add_final_aggregation_paths(PlannerInfo *root,
 	/* make a final grouping path (nogroup) */
 	if (!parse->groupClause)
 	{
+		Assert(parse->groupingSets == NIL);
 		final_path = (Path *)create_agg_path(root,
 											 group_rel,
 											 partial_path,
@@ -1342,70 +1585,95 @@ try_add_final_aggregation_paths(PlannerInfo *root,
 													  final_path,
 													  target_upper));
 	}
-	else
+	else if (parse->groupingSets)
 	{
-		/* make a final grouping path (sort) */
-		if (can_sort)
+		GroupingSetsPath *gset_path = NULL;
+		Path	   *input_path;
+		ListCell   *lc;
+
+		/*
+		 * GpuPreAgg makes partial aggregates for the union of grouping
+		 * columns, then the final GroupingSets node generates all the
+		 * grouping sets from the partial results.
+		 *
+		 * TODO: In this version, we expect group_rel->pathlist have
+		 * a GroupingSetsPath constructed by the built-in code, to reuse
+		 * its rollups. It may not be right, if multiple CSP/FDW is installed
+		 * and cheaper path already eliminated the standard path.
+		 * However, it is a corner case now, and we don't support this
+		 * scenario _right now_.
+		 */
+		foreach (lc, group_rel->pathlist)
 		{
-			PathTarget *target_orig __attribute__((unused));
+			if (IsA(lfirst(lc), GroupingSetsPath))
+			{
+				gset_path = lfirst(lc);
+				break;
+			}
+		}
+		if (!gset_path)
+			return;		/* give up */
 
-			sort_path = (Path *)
+		/*
+		 * The first rollup requires the input sorted by the group_pathkeys,
+		 * unless all the grouping sets are hashed.
+		 */
+		if (gset_path->aggstrategy == AGG_HASHED)
+			input_path = partial_path;
+		else if (can_sort)
+			input_path = (Path *)
 				create_sort_path(root,
 								 group_rel,
 								 partial_path,
 								 root->group_pathkeys,
 								 -1.0);
-			if (parse->groupingSets)
-			{
-				AggStrategy	rollup_strategy = AGG_PLAIN;
-				List	   *rollup_data_list = NIL;
-				ListCell   *lc;
-				/*
-				 * TODO: In this version, we expect group_rel->pathlist have
-				 * a GroupingSetsPath constructed by the built-in code.
-				 * It may not be right, if multiple CSP/FDW is installed and
-				 * cheaper path already eliminated the standard path.
-				 * However, it is a corner case now, and we don't support
-				 * this scenario _right now_.
-				 */
-				foreach (lc, group_rel->pathlist)
-				{
-					GroupingSetsPath   *pathnode = lfirst(lc);
+		else
+			return;
 
-					if (IsA(pathnode, GroupingSetsPath))
-					{
-						rollup_strategy = pathnode->aggstrategy;
-						rollup_data_list = pathnode->rollups;
-						break;
-					}
-				}
-				if (!lc)
-					return;		/* give up */
-				final_path = (Path *)
-					create_groupingsets_path(root,
-											 group_rel,
-											 sort_path,
+		final_path = (Path *)
+			create_groupingsets_path(root,
+									 group_rel,
+									 input_path,
 #if PG_VERSION_NUM < 110000
-											 target_final,
+									 target_final,
 #endif
-											 (List *) parse->havingQual,
-											 rollup_strategy,
-											 rollup_data_list,
-											 agg_final_costs,
-											 num_groups);
+									 havingQuals,
+									 gset_path->aggstrategy,
+									 gset_path->rollups,
+									 agg_final_costs,
+									 num_groups);
 #if PG_VERSION_NUM >= 110000
-				/* adjust cost and overwrite PathTarget */
-				target_orig = final_path->pathtarget;
-				final_path->startup_cost += (target_final->cost.startup -
-											 target_orig->cost.startup);
-				final_path->total_cost += (target_final->cost.startup -
-										   target_orig->cost.startup) +
-					(target_final->cost.per_tuple -
-					 target_orig->cost.per_tuple) * final_path->rows;
-				final_path->pathtarget = target_final;
+		/* adjust cost and overwrite PathTarget */
+		{
+			PathTarget *target_orig = final_path->pathtarget;
+
+			final_path->startup_cost += (target_final->cost.startup -
+										 target_orig->cost.startup);
+			final_path->total_cost += (target_final->cost.startup -
+									   target_orig->cost.startup) +
+				(target_final->cost.per_tuple -
+				 target_orig->cost.per_tuple) * final_path->rows;
+			final_path->pathtarget = target_final;
+		}
 #endif
-			}
-			else if (parse->hasAggs)
+		add_path(group_rel, pgstrom_create_dummy_path(root,
+													  final_path,
+													  target_upper));
+	}
+	else
+	{
+		/* make a final grouping path (sort) */
+		if (can_sort)
+		{
+			PathTarget *target_orig __attribute__((unused));
+
+			sort_path = (Path *)
+				create_sort_path(root,
+								 group_rel,
+								 partial_path,
+								 root->group_pathkeys,
+								 -1.0);
+			if (parse->hasAggs)
 				final_path = (Path *)
 					create_agg_path(root,
 									group_rel,
@@ -1477,6 +1745,209 @@ try_add_final_aggregation_paths(PlannerInfo *root,
 	}
 }
 
+/*
+ * make_final_gpupreagg_expr
+ *
+ * It replaces the Aggref in the final target-list by an expression that
+ * finalizes a single partial state, because each group is never split
+ * over the multiple rows in the final mode.
+ * All the final aggregates in the catalog above merge partial states, thus
+ * a state "merged" with itself is the partial state as is, if no initial
+ * value is defined.
+ */
+static Node *
+make_final_gpupreagg_expr(Node *node, bool *p_supported)
+{
+	if (!node)
+		return NULL;
+	if (IsA(node, Aggref))
+	{
+		Aggref	   *aggref = (Aggref *) node;
+		Form_pg_aggregate aggform;
+		HeapTuple	htup;
+		Datum		datum;
+		bool		isnull;
+		Expr	   *pvalue;
+		Expr	   *state;
+		Oid			transfn_oid;
+		Oid			finalfn_oid;
+		Oid			transtype;
+
+		if (aggref->aggdirectargs != NIL ||
+			aggref->aggorder != NIL ||
+			aggref->aggdistinct != NIL ||
+			aggref->aggfilter != NULL ||
+			aggref->aggkind != AGGKIND_NORMAL ||
+			list_length(aggref->args) != 1)
+		{
+			*p_supported = false;
+			return node;
+		}
+		pvalue = ((TargetEntry *) linitial(aggref->args))->expr;
+
+		htup = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggref->aggfnoid));
+		if (!HeapTupleIsValid(htup))
+			elog(ERROR, "cache lookup failed for aggregate %u",
+				 aggref->aggfnoid);
+		aggform = (Form_pg_aggregate) GETSTRUCT(htup);
+		transfn_oid = aggform->aggtransfn;
+		finalfn_oid = aggform->aggfinalfn;
+		transtype = aggform->aggtranstype;
+		if (transtype == INTERNALOID || aggform->aggfinalextra)
+		{
+			ReleaseSysCache(htup);
+			*p_supported = false;
+			return node;
+		}
+		datum = SysCacheGetAttr(AGGFNOID, htup,
+								Anum_pg_aggregate_agginitval,
+								&isnull);
+		if (isnull)
+		{
+			/* the partial state is the state of the group as is */
+			if (exprType((Node *) pvalue) != transtype)
+			{
+				ReleaseSysCache(htup);
+				*p_supported = false;
+				return node;
+			}
+			state = pvalue;
+		}
+		else
+		{
+			char	   *initval = TextDatumGetCString(datum);
+			Oid			typinput;
+			Oid			typioparam;
+			int16		typlen;
+			bool		typbyval;
+			Const	   *con;
+			CaseExpr   *cexpr;
+			NullTest   *ntest;
+
+			/* non-strict transition may reference the aggregate context */
+			if (!func_strict(transfn_oid))
+			{
+				ReleaseSysCache(htup);
+				*p_supported = false;
+				return node;
+			}
+			getTypeInputInfo(transtype, &typinput, &typioparam);
+			get_typlenbyval(transtype, &typlen, &typbyval);
+			con = makeConst(transtype,
+							-1,
+							InvalidOid,
+							typlen,
+							OidInputFunctionCall(typinput, initval,
+												 typioparam, -1),
+							false,
+							typbyval);
+			/* CASE WHEN pvalue IS NULL THEN initval ELSE transfn(...) END */
+			ntest = makeNode(NullTest);
+			ntest->arg = pvalue;
+			ntest->nulltesttype = IS_NULL;
+			ntest->argisrow = false;
+			ntest->location = -1;
+
+			cexpr = makeNode(CaseExpr);
+			cexpr->casetype = transtype;
+			cexpr->casecollid = InvalidOid;
+			cexpr->arg = NULL;
+			cexpr->args = list_make1(makeNode(CaseWhen));
+			((CaseWhen *) linitial(cexpr->args))->expr = (Expr *) ntest;
+			((CaseWhen *) linitial(cexpr->args))->result = (Expr *) con;
+			((CaseWhen *) linitial(cexpr->args))->location = -1;
+			cexpr->defresult = (Expr *)
+				makeFuncExpr(transfn_oid,
+							 transtype,
+							 list_make2(copyObject(con), pvalue),
+							 InvalidOid,
+							 aggref->inputcollid,
+							 COERCE_EXPLICIT_CALL);
+			cexpr->location = -1;
+			state = (Expr *) cexpr;
+		}
+		ReleaseSysCache(htup);
+
+		if (!OidIsValid(finalfn_oid))
+		{
+			if (exprType((Node *) state) != aggref->aggtype)
+			{
+				*p_supported = false;
+				return node;
+			}
+			return (Node *) state;
+		}
+		return (Node *) makeFuncExpr(finalfn_oid,
+									 aggref->aggtype,
+									 list_make1(state),
+									 aggref->aggcollid,
+									 aggref->inputcollid,
+									 COERCE_EXPLICIT_CALL);
+	}
+	return expression_tree_mutator(node, make_final_gpupreagg_expr,
+								   (void *) p_supported);
+}
+
+/*
+ * try_add_final_gpupreagg_path
+ *
+ * If GpuPreAgg runs without parallel workers, partitions, extra grouping
+ * keys and CPU fallback, all the rows of a particular group are merged onto
+ * a unique entry of the global hash-slot on the device. So, the results of
+ * GpuPreAgg are already complete groups, and CPU side has to apply only the
+ * final functions on the partial states, without (Hash|Group)Aggregate.
+ */
+static void
+try_add_final_gpupreagg_path(PlannerInfo *root,
+							 RelOptInfo *group_rel,
+							 PathTarget *target_final,
+							 Path *partial_path,
+							 List *havingQuals,
+							 AggClauseCosts *agg_final_costs)
+{
+	Query	   *parse = root->parse;
+	PathTarget *target_upper = root->upper_targets[UPPERREL_GROUP_AGG];
+	PathTarget *target_proj;
+	CustomPath *cpath;
+	GpuPreAggInfo *gpa_info;
+	Path	   *final_path;
+	bool		supported = true;
+
+	if (!enable_final_gpupreagg ||
+		pgstrom_cpu_fallback_enabled ||
+		!parse->groupClause ||
+		parse->groupingSets != NIL ||
+		havingQuals != NIL ||
+		agg_final_costs->numOrderedAggs > 0 ||
+		!pgstrom_path_is_gpupreagg(partial_path) ||
+		partial_path->parallel_aware)
+		return;
+
+	target_proj = copy_pathtarget(target_final);
+	target_proj->exprs = (List *)
+		make_final_gpupreagg_expr((Node *) target_proj->exprs, &supported);
+	if (!supported)
+		return;
+	set_pathtarget_cost_width(root, target_proj);
+
+	/* GpuPreAgg in the final mode */
+	cpath = (CustomPath *) pgstrom_copy_gpupreagg_path(partial_path);
+	gpa_info = pmemdup(linitial(cpath->custom_private),
+					   sizeof(GpuPreAggInfo));
+	gpa_info->final_mode = true;
+	cpath->custom_private = list_make3(gpa_info,
+									   lsecond(cpath->custom_private),
+									   lthird(cpath->custom_private));
+
+	final_path = (Path *) create_projection_path(root,
+												 group_rel,
+												 &cpath->path,
+												 target_proj);
+	add_path(group_rel, pgstrom_create_dummy_path(root,
+												  final_path,
+												  target_upper));
+}
+
 /*
  * try_add_gpupreagg_append_paths
  */
@@ -1503,6 +1974,7 @@ try_add_gpupreagg_append_paths(PlannerInfo *root,
 	AppendPath *append_path;
 	Cost		discount_cost;
 	Path	   *partial_path;
+	cl_int	   *sibling_param_id = NULL;
 	ListCell   *lc;
 
 retry:
@@ -1516,7 +1988,11 @@ retry:
 	if (sub_paths_list == NIL)
 		return;
 	if (list_length(sub_paths_list) > 1)
+	{
 		discount_cost /= (Cost)(list_length(sub_paths_list) - 1);
+		sibling_param_id = palloc(sizeof(cl_int));
+		*sibling_param_id = -1;
+	}
 	else
 		discount_cost = 0.0;
 
@@ -1530,6 +2006,19 @@ retry:
 		AppendRelInfo **appinfos;
 		int				nappinfos;
 
+		/*
+		 * Foreign partitions whose FDW can push down aggregation by itself
+		 * (e.g, postgres_fdw) shall be aggregated on the remote side, using
+		 * the partition-wise aggregation of PostgreSQL; GpuPreAgg on the
+		 * local GPU has to fetch all the raw rows from the remote nodes.
+		 * Other FDWs (arrow_fdw, gstore_fdw, file_fdw, ...) just supply rows
+		 * to the local node, so GpuPreAgg is still worth to try.
+		 */
+		if (sub_rel->fdwroutine &&
+			sub_rel->fdwroutine->GetForeignUpperPaths != NULL &&
+			enable_partitionwise_aggregate)
+			return;
+
 		appinfos = find_appinfos_by_relids_nofail(root, sub_rel->relids,
 												  &nappinfos);
 		/* fixup varno */
@@ -1552,6 +2041,13 @@ retry:
 		if (!partial_path)
 			return;
 		partial_path->total_cost -= discount_cost;
+		/* siblings share the final buffer, if GpuPreAgg is the top */
+		if (sibling_param_id && pgstrom_path_is_gpupreagg(partial_path))
+		{
+			GpuPreAggInfo *gpa_info
+				= linitial(((CustomPath *)partial_path)->custom_private);
+			gpa_info->sibling_param_ref = sibling_param_id;
+		}
 		append_paths_list = lappend(append_paths_list, partial_path);
 	}
 	/* also see create_append_path(), some fields must be fixed up */
@@ -1607,6 +2103,117 @@ retry:
 #endif	/* PG_VERSION_NUM >= 110000 */
 }
 
+/*
+ * gpupreagg_next_sortgroupref
+ *
+ * It returns an unused sortgroupref to add extra grouping-keys of GpuPreAgg
+ * that do not appear in the GROUP BY clause.
+ */
+static Index
+gpupreagg_next_sortgroupref(PlannerInfo *root, PathTarget *target_device)
+{
+	Index		sortgroupref = 0;
+	ListCell   *lc;
+	int			i;
+
+	foreach (lc, root->parse->targetList)
+	{
+		TargetEntry *tle = lfirst(lc);
+
+		sortgroupref = Max(sortgroupref, tle->ressortgroupref);
+	}
+	for (i=0; i < list_length(target_device->exprs); i++)
+		sortgroupref = Max(sortgroupref,
+						   get_pathtarget_sortgroupref(target_device, i));
+	return sortgroupref + 1;
+}
+
+/*
+ * sketch_key_num_buckets
+ *
+ * It returns number of the buckets if the expression is a sketch key of
+ * approximate aggregates, or 0 elsewhere.
+ */
+static double
+sketch_key_num_buckets(Expr *expr)
+{
+	FuncExpr   *f = (FuncExpr *)expr;
+	char	   *func_name;
+	double		nbuckets = 0.0;
+
+	if (!IsA(f, FuncExpr) ||
+		get_func_namespace(f->funcid) != get_namespace_oid("pgstrom", false))
+		return 0.0;
+	func_name = get_func_name(f->funcid);
+	if (strcmp(func_name, "hll_bucket") == 0)
+		nbuckets = (double)HLL_NUM_REGISTERS;
+	else if (strcmp(func_name, "dds_bucket") == 0)
+		nbuckets = (double)DDS_ESTIMATED_NUM_BUCKETS;
+	pfree(func_name);
+
+	return nbuckets;
+}
+
+/*
+ * has_extra_grouping_keys
+ *
+ * It checks whether GpuPreAgg has grouping-keys not in the GROUP BY clause,
+ * then estimates number of the groups on GpuPreAgg if any.
+ */
+static bool
+has_extra_grouping_keys(PlannerInfo *root,
+						PathTarget *target_device,
+						Path *input_path,
+						List **p_extra_keys,
+						double *p_num_partial_groups)
+{
+	Query	   *parse = root->parse;
+	List	   *extra_keys = NIL;
+	List	   *distinct_keys = NIL;
+	double		sketch_factor = 1.0;
+	double		num_partial_groups = *p_num_partial_groups;
+	ListCell   *lc;
+	int			i = 0;
+
+	foreach (lc, target_device->exprs)
+	{
+		Expr   *expr = lfirst(lc);
+		Index	sortgroupref = get_pathtarget_sortgroupref(target_device, i++);
+		double	nbuckets;
+
+		if (sortgroupref == 0 ||
+			get_sortgroupref_clause_noerr(sortgroupref,
+										  parse->groupClause) != NULL)
+			continue;
+		extra_keys = lappend(extra_keys, expr);
+
+		nbuckets = sketch_key_num_buckets(expr);
+		if (nbuckets > 0.0)
+			sketch_factor *= nbuckets;
+		else
+			distinct_keys = lappend(distinct_keys, expr);
+	}
+	if (extra_keys == NIL)
+		return false;
+
+	if (distinct_keys != NIL)
+	{
+		List   *group_exprs = get_sortgrouplist_exprs(parse->groupClause,
+													  parse->targetList);
+		num_partial_groups = estimate_num_groups(root,
+												 list_concat(group_exprs,
+															 distinct_keys),
+												 input_path->rows,
+												 NULL);
+	}
+	num_partial_groups = Min(num_partial_groups * sketch_factor,
+							 input_path->rows);
+	*p_extra_keys = extra_keys;
+	*p_num_partial_groups = Max(num_partial_groups, 1.0);
+
+	return true;
+}
+
 /*
  * try_add_gpupreagg_paths
  */
@@ -1623,8 +2230,10 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 	PathTarget	   *target_device	= create_empty_pathtarget();
 	Path		   *partial_path;
 	Bitmapset	   *pfunc_bitmap;
+	List		   *extra_keys = NIL;
 	Node		   *havingQual;
 	double			num_groups;
+	double			num_partial_groups;
 	double			reduction_ratio;
 	bool			can_pullup_outerscan = true;
 	AggClauseCosts	agg_final_costs;
@@ -1648,11 +2257,27 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 
 		num_groups = Max(pathnode->rows, 1.0);
 	}
-	reduction_ratio = input_path->rows / num_groups;
+
+	/*
+	 * GpuPreAgg groups the rows by the union of the grouping columns, then
+	 * the final aggregation generates all the grouping sets from the results.
+	 */
+	num_partial_groups = num_groups;
+	if (parse->groupingSets)
+	{
+		List   *group_exprs = get_sortgrouplist_exprs(parse->groupClause,
+													  parse->targetList);
+		num_partial_groups = estimate_num_groups(root,
+												 group_exprs,
+												 input_path->rows,
+												 NULL);
+		num_partial_groups = Max(num_partial_groups, 1.0);
+	}
+	reduction_ratio = input_path->rows / num_partial_groups;
 	if (reduction_ratio < gpupreagg_reduction_threshold)
 	{
 		elog(DEBUG2, "GpuPreAgg: %.0f -> %.0f reduction ratio (%.2f) is bad",
-			 input_path->rows, num_groups, reduction_ratio);
+			 input_path->rows, num_partial_groups, reduction_ratio);
 		return;
 	}
 
@@ -1668,6 +2293,23 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 									 &can_pullup_outerscan))
 		return;
 
+	/*
+	 * Arguments of DISTINCT aggregates and sketch keys of approximate
+	 * aggregates are added to the grouping-keys of GpuPreAgg, so it makes
+	 * more groups than the final aggregation.
+	 */
+	if (has_extra_grouping_keys(root, target_device, input_path,
+								&extra_keys, &num_partial_groups))
+	{
+		reduction_ratio = input_path->rows / num_partial_groups;
+		if (reduction_ratio < gpupreagg_reduction_threshold)
+		{
+			elog(DEBUG2, "GpuPreAgg: %.0f -> %.0f reduction ratio (%.2f) with extra grouping-keys is bad",
+				 input_path->rows, num_partial_groups, reduction_ratio);
+			return;
+		}
+	}
+
 	/* Get cost of aggregations */
 	memset(&agg_final_costs, 0, sizeof(AggClauseCosts));
 	if (parse->hasAggs)
@@ -1677,14 +2319,12 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 		get_agg_clause_costs(root, havingQual,
 							 AGGSPLIT_SIMPLE, &agg_final_costs);
 	}
-	/* GpuPreAgg does not support ordered aggregation */
-	if (agg_final_costs.numOrderedAggs > 0)
-	{
-		elog(DEBUG2, "GpuPreAgg does not support ordered aggregation");
-		return;
-	}
-
-	if (enable_partitionwise_gpupreagg)
+	/*
+	 * NOTE: numOrderedAggs also counts DISTINCT aggregates, which are run
+	 * by the final aggregation on the deduplicated rows. Other ordered
+	 * aggregations are already rejected by make_alternative_aggref().
+	 */
+	if (enable_partitionwise_gpupreagg && extra_keys == NIL)
 		try_add_gpupreagg_append_paths(root,
 									   group_rel,
 									   target_final,
@@ -1704,7 +2344,7 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 										  target_device,
 										  input_path,
 										  pfunc_bitmap,
-										  num_groups,
+										  num_partial_groups,
 										  can_pullup_outerscan,
 										  try_parallel_path);
 	if (!partial_path ||
@@ -1718,6 +2358,13 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 									(List *) havingQual,
 									num_groups,
 									&agg_final_costs);
+	if (!try_parallel_path && extra_keys == NIL)
+		try_add_final_gpupreagg_path(root,
+									 group_rel,
+									 target_final,
+									 partial_path,
+									 (List *) havingQual,
+									 &agg_final_costs);
 }
 
 /*
@@ -1978,7 +2625,8 @@ make_expr_conditional(Expr *expr, Expr *filter, bool zero_if_unmatched)
  * make_altfunc_simple_expr - constructor of simple function call
  */
 static FuncExpr *
-make_altfunc_simple_expr(const char *func_name, Expr *func_arg)
+__make_altfunc_simple_expr(const char *func_name, Expr *func_arg,
+						   bool missing_ok)
 {
 	Oid			namespace_oid = get_namespace_oid("pgstrom", false);
 	Oid			argtype_oid = InvalidOid;
@@ -2001,10 +2649,14 @@ make_altfunc_simple_expr(const char *func_name, Expr *func_arg)
 							PointerGetDatum(func_argtypes),
 							ObjectIdGetDatum(namespace_oid));
 	if (!HeapTupleIsValid(tuple))
+	{
+		if (missing_ok)
+			return NULL;
 		elog(ERROR, "alternative function not found: %s",
 			 func_arg != NULL
 			 ? funcname_signature_string(func_name, 1, NIL, &argtype_oid)
 			 : funcname_signature_string(func_name, 0, NIL, NULL));
+	}
 
 	proc_form = (Form_pg_proc) GETSTRUCT(tuple);
 	func_expr = makeFuncExpr(PgProcTupleGetOid(tuple),
@@ -2017,6 +2669,8 @@ make_altfunc_simple_expr(const char *func_name, Expr *func_arg)
 
 	return func_expr;
 }
+#define make_altfunc_simple_expr(func_name,func_arg)		\
+	__make_altfunc_simple_expr((func_name),(func_arg),false)
 
 /*
  * make_altfunc_nrows_expr - constructor of the partial number of rows
@@ -2099,6 +2753,48 @@ make_altfunc_psum_expr(Aggref *aggref, const char *func_name, Oid psum_typeoid)
 	return make_altfunc_simple_expr(func_name, expr);
 }
 
+/*
+ * make_altfunc_psum_numeric_expr - constructor of a scaled NUMERIC reference
+ */
+static FuncExpr *
+make_altfunc_psum_numeric_expr(Aggref *aggref, const char *func_name)
+{
+	Oid				namespace_oid = get_namespace_oid("pgstrom", false);
+	Oid				func_argtypes_oid[2];
+	Oid				func_oid;
+	TargetEntry	   *tle;
+	Expr		   *expr;
+	int				scale = aggfunc_numeric_exact_scale(aggref);
+
+	Assert(list_length(aggref->args) == 1 && scale >= 0);
+	tle = linitial(aggref->args);
+	Assert(IsA(tle, TargetEntry));
+
+	/* lookup numeric_scaled_XX function */
+	func_argtypes_oid[0] = NUMERICOID;
+	func_argtypes_oid[1] = INT4OID;
+	func_oid = get_function_oid(func_name,
+								buildoidvector(func_argtypes_oid, 2),
+								namespace_oid, false);
+	expr = (Expr *)makeFuncExpr(func_oid,
+								INT8OID,
+								list_make2(copyObject(tle->expr),
+										   makeConst(INT4OID,
+													 -1,
+													 InvalidOid,
+													 sizeof(int32),
+													 Int32GetDatum(scale),
+													 false,
+													 true)),
+								InvalidOid,
+								InvalidOid,
+								COERCE_EXPLICIT_CALL);
+	/* make conditional if aggref has any filter */
+	expr = make_expr_conditional(expr, aggref->aggfilter, true);
+
+	return make_altfunc_simple_expr("psum", expr);
+}
+
 /*
  * make_altfunc_pcov_xy - constructor of a co-variance arguments
  */
@@ -2144,6 +2840,88 @@ make_altfunc_pcov_xy(Aggref *aggref, const char *func_name)
 						COERCE_EXPLICIT_CALL);
 }
 
+/*
+ * make_altfunc_sketch_expr - constructor of the sketch keys/values
+ *
+ * It returns NULL, if the argument type has no hash function for HLL.
+ */
+static Expr *
+make_altfunc_sketch_expr(Aggref *aggref, cl_int action)
+{
+	TargetEntry	   *tle;
+	Expr		   *expr;
+
+	tle = linitial(aggref->args);
+	Assert(IsA(tle, TargetEntry));
+	switch (action)
+	{
+		case ALTFUNC_EXPR_HLL_BUCKET:
+		case ALTFUNC_EXPR_HLL_RANK:
+			expr = (Expr *)__make_altfunc_simple_expr("hll_hash",
+													  tle->expr, true);
+			if (!expr)
+				return NULL;
+			if (action == ALTFUNC_EXPR_HLL_BUCKET)
+				expr = (Expr *)make_altfunc_simple_expr("hll_bucket", expr);
+			else
+			{
+				expr = (Expr *)make_altfunc_simple_expr("hll_rank", expr);
+				/* make conditional if aggref has any filter */
+				expr = make_expr_conditional(expr, aggref->aggfilter, false);
+				expr = (Expr *)make_altfunc_simple_expr("pmax", expr);
+			}
+			break;
+		case ALTFUNC_EXPR_DDS_BUCKET:
+			expr = make_expr_typecast(tle->expr, FLOAT8OID);
+			expr = (Expr *)make_altfunc_simple_expr("dds_bucket", expr);
+			break;
+		default:
+			elog(ERROR, "Bug? not a sketch function code: %d", action);
+	}
+	return expr;
+}
+
+/*
+ * aggfunc_value_key_is_binary_equal
+ *
+ * It checks whether equality of the type implies binary identity. Values
+ * equal to each other are merged into one grouping-key, so the aggregate
+ * on the histogram of values cannot tell 1.0 from 1.00 of numeric, or
+ * 0 from -0 of float8, for example.
+ */
+static bool
+aggfunc_value_key_is_binary_equal(Oid type_oid, Oid collid)
+{
+	switch (type_oid)
+	{
+		case BOOLOID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case OIDOID:
+		case CASHOID:
+		case DATEOID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case UUIDOID:
+		case BYTEAOID:
+			return true;
+		case TEXTOID:
+		case VARCHAROID:
+#if PG_VERSION_NUM >= 120000
+			/* non-deterministic collation may be equal to other strings */
+			if (OidIsValid(collid) && !get_collation_isdeterministic(collid))
+				return false;
+#endif
+			return true;
+		default:
+			/* float, numeric, interval, bpchar, ... */
+			break;
+	}
+	return false;
+}
+
 /*
  * make_alternative_aggref
  *
@@ -2162,7 +2940,10 @@ make_alternative_aggref(PlannerInfo *root,
 	const aggfunc_catalog_t *aggfn_cat;
 	Aggref	   *aggref_new;
 	List	   *altfunc_args = NIL;
+	List	   *final_args = NIL;
+	List	   *final_argtypes = NIL;
 	Expr	   *expr_host;
+	ListCell   *cell;
 	Oid			namespace_oid;
 	Oid			func_oid;
 	const char *func_name;
@@ -2172,31 +2953,53 @@ make_alternative_aggref(PlannerInfo *root,
 	Form_pg_proc proc_form;
 	Form_pg_aggregate agg_form;
 
-	if (aggref->aggorder || aggref->aggdistinct)
+	if (aggref->aggdistinct ||
+		(aggref->aggorder && !AGGKIND_IS_ORDERED_SET(aggref->aggkind)))
 	{
 		elog(DEBUG2, "Aggregate with DISTINCT/ORDER BY is not supported: %s",
 			 nodeToString(aggref));
 		return NULL;
 	}
-	if (AGGKIND_IS_ORDERED_SET(aggref->aggkind))
-	{
-		elog(DEBUG2, "ORDERED SET Aggregation is not supported: %s",
-			 nodeToString(aggref));
-		return NULL;
-	}
 
 	/*
 	 * Lookup properties of aggregate function
 	 */
-	aggfn_cat = aggfunc_lookup_by_oid(aggref->aggfnoid);
+	aggfn_cat = aggfunc_lookup_by_aggref(aggref);
 	if (!aggfn_cat)
 	{
 		elog(DEBUG2, "Aggregate function is not device executable: %s",
 			 format_procedure(aggref->aggfnoid));
 		return NULL;
 	}
+	if (AGGKIND_IS_ORDERED_SET(aggref->aggkind))
+	{
+		SortGroupClause *sortcl;
+		TypeCacheEntry *tcache;
+
+		/*
+		 * Only mode() is supported right now. It picks up the smallest
+		 * value on ties, so the sort order must be ascending.
+		 */
+		if (!aggfn_cat->ordered_set ||
+			aggref->aggdirectargs != NIL ||
+			list_length(aggref->aggorder) != 1)
+		{
+			elog(DEBUG2, "ORDERED SET Aggregation is not supported: %s",
+				 nodeToString(aggref));
+			return NULL;
+		}
+		sortcl = linitial(aggref->aggorder);
+		tcache = lookup_type_cache(linitial_oid(aggref->aggargtypes),
+								   TYPECACHE_LT_OPR);
+		if (sortcl->sortop != tcache->lt_opr)
+		{
+			elog(DEBUG2, "ORDERED SET Aggregation by non-default order: %s",
+				 nodeToString(aggref));
+			return NULL;
+		}
+	}
 	/* sanity checks */
-	Assert(aggref->aggkind == AGGKIND_NORMAL &&
+	Assert((aggref->aggkind == AGGKIND_NORMAL || aggfn_cat->ordered_set) &&
 		   !aggref->aggvariadic &&
 		   list_length(aggref->args) <= 2);
 
@@ -2209,6 +3012,120 @@ make_alternative_aggref(PlannerInfo *root,
 		cl_int		argtype = aggfn_cat->partfn_argtypes[i];
 		FuncExpr   *pfunc;
 
+		if (action == ALTFUNC_EXPR_HLL_BUCKET ||
+			action == ALTFUNC_EXPR_DDS_BUCKET)
+		{
+			Expr	   *skey = make_altfunc_sketch_expr(aggref, action);
+			Node	   *temp;
+			ListCell   *lc;
+			int			j = 0;
+
+			/*
+			 * Sketch key is added to the grouping-keys of GpuPreAgg, then
+			 * the partial function takes it as an argument.
+			 */
+			if (!skey)
+				return NULL;
+			temp = replace_expression_by_outerref((Node *)skey, target_input);
+			if (!pgstrom_device_expression(root, NULL, (Expr *)temp))
+				return NULL;
+			foreach (lc, target_device->exprs)
+			{
+				if (equal(skey, lfirst(lc)))
+					break;
+				j++;
+			}
+			if (!lc)
+				add_column_to_pathtarget(target_device, skey,
+										 gpupreagg_next_sortgroupref(root,
+																	 target_device));
+			else if (get_pathtarget_sortgroupref(target_device, j) == 0)
+				return NULL;	/* should not happen */
+			altfunc_args = lappend(altfunc_args, skey);
+			continue;
+		}
+		else if (action == ALTFUNC_EXPR_VALUE_KEY)
+		{
+			TargetEntry *tle = linitial(aggref->args);
+			Expr	   *vkey = tle->expr;
+			Oid			vkey_type = exprType((Node *)vkey);
+			List	   *group_exprs;
+			devtype_info *dtype;
+			Node	   *temp;
+			ListCell   *lc;
+			int			j = 0;
+
+			/*
+			 * The value itself is added to the grouping-keys of GpuPreAgg,
+			 * so same restriction to the grouping-keys is applied.
+			 */
+			dtype = pgstrom_devtype_lookup(vkey_type);
+			if (!dtype || !dtype->hash_func ||
+				!pgstrom_devfunc_lookup_type_equal(dtype,
+												   exprCollation((Node *)vkey)) ||
+				!aggfunc_value_key_is_binary_equal(vkey_type,
+												   exprCollation((Node *)vkey)))
+			{
+				elog(DEBUG2, "%s contains unsupported type (%s): %s",
+					 format_procedure(aggref->aggfnoid),
+					 format_type_be(vkey_type),
+					 nodeToString(vkey));
+				return NULL;
+			}
+			temp = replace_expression_by_outerref((Node *)vkey, target_input);
+			if (!pgstrom_device_expression(root, NULL, (Expr *)temp))
+				return NULL;
+			/* no need to add, if GROUP BY already contains the value */
+			group_exprs = get_sortgrouplist_exprs(root->parse->groupClause,
+												  root->parse->targetList);
+			if (!list_member(group_exprs, vkey))
+			{
+				foreach (lc, target_device->exprs)
+				{
+					if (equal(vkey, lfirst(lc)))
+						break;
+					j++;
+				}
+				if (!lc)
+					add_column_to_pathtarget(target_device, copyObject(vkey),
+						gpupreagg_next_sortgroupref(root, target_device));
+				else if (get_pathtarget_sortgroupref(target_device, j) == 0)
+					target_device->sortgrouprefs[j] =
+						gpupreagg_next_sortgroupref(root, target_device);
+			}
+			altfunc_args = lappend(altfunc_args, copyObject(vkey));
+			continue;
+		}
+		else if (action == ALTFUNC_EXPR_CONST_ARG2)
+		{
+			TargetEntry *tle = lsecond(aggref->args);
+
+			if (!IsA(tle->expr, Const) || ((Const *)tle->expr)->constisnull)
+			{
+				elog(DEBUG2, "2nd argument of %s must be a constant: %s",
+					 format_procedure(aggref->aggfnoid),
+					 nodeToString(tle->expr));
+				return NULL;
+			}
+			altfunc_args = lappend(altfunc_args, copyObject(tle->expr));
+			continue;
+		}
+		else if (action == ALTFUNC_EXPR_NUMERIC_SCALE)
+		{
+			int		scale = aggfunc_numeric_exact_scale(aggref);
+
+			Assert(scale >= 0);
+			altfunc_args = lappend(altfunc_args,
+								   makeConst(INT4OID,
+											 -1,
+											 InvalidOid,
+											 sizeof(int32),
+											 Int32GetDatum(scale),
+											 false,
+											 true));
+			continue;
+		}
+
 		switch (action)
 		{
 			case ALTFUNC_EXPR_NROWS:    /* NROWS(X) */
@@ -2226,6 +3143,14 @@ make_alternative_aggref(PlannerInfo *root,
 			case ALTFUNC_EXPR_PSUM_X2:  /* PSUM_X2(X) = PSUM(X^2) */
 				pfunc = make_altfunc_psum_expr(aggref, "psum_x2", argtype);
 				break;
+			case ALTFUNC_EXPR_PSUM_NUMHI:	/* PSUM(NUMERIC_SCALED_HI(X,s)) */
+				pfunc = make_altfunc_psum_numeric_expr(aggref,
+													   "numeric_scaled_hi");
+				break;
+			case ALTFUNC_EXPR_PSUM_NUMLO:	/* PSUM(NUMERIC_SCALED_LO(X,s)) */
+				pfunc = make_altfunc_psum_numeric_expr(aggref,
+													   "numeric_scaled_lo");
+				break;
 			case ALTFUNC_EXPR_PCOV_X:   /* PCOV_X(X,Y) */
 				pfunc = make_altfunc_pcov_xy(aggref, "pcov_x");
 				break;
@@ -2241,6 +3166,11 @@ make_alternative_aggref(PlannerInfo *root,
 			case ALTFUNC_EXPR_PCOV_XY:  /* PCOV_XY(X,Y) */
 				pfunc = make_altfunc_pcov_xy(aggref, "pcov_xy");
 				break;
+			case ALTFUNC_EXPR_HLL_RANK:	/* PMAX(HLL_RANK(X)) */
+				pfunc = (FuncExpr *)make_altfunc_sketch_expr(aggref, action);
+				if (!pfunc)
+					return NULL;
+				break;
 			default:
 				elog(ERROR, "unknown alternative function code: %d", action);
 				break;
@@ -2280,8 +3210,25 @@ make_alternative_aggref(PlannerInfo *root,
 	 */
 	if (strcmp(aggfn_cat->partfn_name, "varref") == 0)
 	{
-		Assert(list_length(altfunc_args) == 1);
-		expr_host = linitial(altfunc_args);
+		/*
+		 * The final aggregate takes the partial values as is, but constant
+		 * arguments are not added to the target_partial.
+		 */
+		Assert(list_length(altfunc_args) == aggfn_cat->partfn_nargs);
+		foreach (cell, altfunc_args)
+		{
+			Expr   *arg = lfirst(cell);
+
+			if (!IsA(arg, Const))
+				add_new_column_to_pathtarget(target_partial, arg);
+			final_args = lappend(final_args,
+								 makeTargetEntry(arg,
+												 list_length(final_args) + 1,
+												 NULL,
+												 false));
+			final_argtypes = lappend_oid(final_argtypes,
+										 exprType((Node *)arg));
+		}
 	}
 	else
 	{
@@ -2314,9 +3261,12 @@ make_alternative_aggref(PlannerInfo *root,
 										 InvalidOid,
 										 COERCE_EXPLICIT_CALL);
 		ReleaseSysCache(tuple);
+
+		/* add expression if unique */
+		add_new_column_to_pathtarget(target_partial, expr_host);
+		final_args = list_make1(makeTargetEntry(expr_host, 1, NULL, false));
+		final_argtypes = list_make1_oid(exprType((Node *)expr_host));
 	}
-	/* add expression if unique */
-	add_new_column_to_pathtarget(target_partial, expr_host);
 
 	/* construction of the final Aggref */
 	if (strncmp(aggfn_cat->finalfn_name, "c:", 2) == 0)
@@ -2327,12 +3277,17 @@ make_alternative_aggref(PlannerInfo *root,
 		elog(ERROR, "Bug? incorrect alternative function catalog");
 
 	func_name = aggfn_cat->finalfn_name + 2;
-	func_argtypes = buildoidvector(&aggfn_cat->finalfn_argtype, 1);
+	if (list_length(final_args) > 1)
+		func_argtypes = buildoidvector(aggfn_cat->partfn_argtypes,
+									   aggfn_cat->partfn_nargs);
+	else
+		func_argtypes = buildoidvector(&aggfn_cat->finalfn_argtype, 1);
 	func_oid = get_function_oid(func_name,
 								func_argtypes,
 								namespace_oid, false);
 	/* sanity check */
-	Assert(aggref->aggtype == get_func_rettype(func_oid));
+	Assert(aggref->aggtype == get_func_rettype(func_oid) ||
+		   IsPolymorphicType(get_func_rettype(func_oid)));
 
 	tuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(func_oid));
 	if (!HeapTupleIsValid(tuple))
@@ -2345,12 +3300,9 @@ make_alternative_aggref(PlannerInfo *root,
 	aggref_new->aggcollid		= aggref->aggcollid;
 	aggref_new->inputcollid		= aggref->inputcollid;
 	aggref_new->aggtranstype	= agg_form->aggtranstype;
-	aggref_new->aggargtypes		= list_make1_oid(exprType((Node *)expr_host));
+	aggref_new->aggargtypes		= final_argtypes;
 	aggref_new->aggdirectargs	= NIL;
-	aggref_new->args			= list_make1(makeTargetEntry(expr_host,
-															 1,
-															 NULL,
-															 false));
+	aggref_new->args			= final_args;
 	aggref_new->aggorder		= NIL;	/* see sanity check */
 	aggref_new->aggdistinct		= NIL;	/* see sanity check */
 	aggref_new->aggfilter		= NULL;	/* moved to GpuPreAgg */
@@ -2376,6 +3328,7 @@ typedef struct
 	PathTarget *target_input;
 	RelOptInfo *input_rel;
 	Bitmapset  *pfunc_bitmap;
+	List	   *distinct_aggrefs;
 } gpupreagg_build_path_target_context;
 
 static Node *
@@ -2387,7 +3340,17 @@ replace_expression_by_altfunc(Node *node,
 
 	if (!node)
 		return NULL;
-	if (IsA(node, Aggref))
+	if (IsA(node, Aggref) && ((Aggref *)node)->aggdistinct != NIL)
+	{
+		/*
+		 * DISTINCT aggregate is kept as is, then the final aggregation
+		 * runs it on the rows deduplicated by GpuPreAgg.
+		 * See add_distinct_aggref_keys() also.
+		 */
+		con->distinct_aggrefs = lappend(con->distinct_aggrefs, node);
+		return copyObject(node);
+	}
+	else if (IsA(node, Aggref))
 	{
 		Node   *aggfn = make_alternative_aggref(con->root,
 												(Aggref *)node,
@@ -2420,6 +3383,118 @@ replace_expression_by_altfunc(Node *node,
 	return expression_tree_mutator(node, replace_expression_by_altfunc, con);
 }
 
+/*
+ * add_distinct_aggref_keys
+ *
+ * It adds arguments of the DISTINCT aggregates to the grouping-keys of
+ * GpuPreAgg, to eliminate duplicated values on the device side. Then,
+ * the final aggregation runs the original DISTINCT aggregates on the
+ * partial results; that contains at most one row per (grouping-keys,
+ * distinct values) for each GpuPreAgg task.
+ */
+static bool
+add_distinct_aggref_keys(gpupreagg_build_path_target_context *con,
+						 bool *p_can_pullup_outerscan)
+{
+	PlannerInfo *root = con->root;
+	Query	   *parse = root->parse;
+	PathTarget *target_partial = con->target_partial;
+	PathTarget *target_device = con->target_device;
+	ListCell   *lc1, *lc2, *cell;
+	int			j, n;
+
+	if (con->distinct_aggrefs == NIL)
+		return true;
+	if (parse->groupingSets)
+	{
+		elog(DEBUG2, "GpuPreAgg does not support DISTINCT aggregates with GROUPING SETS");
+		return false;
+	}
+
+	foreach (lc1, con->distinct_aggrefs)
+	{
+		Aggref	   *aggref = lfirst(lc1);
+
+		if (aggref->aggfilter)
+		{
+			elog(DEBUG2, "DISTINCT aggregate with FILTER is not supported: %s",
+				 nodeToString(aggref));
+			return false;
+		}
+		if (AGGKIND_IS_ORDERED_SET(aggref->aggkind))
+		{
+			elog(DEBUG2, "ORDERED SET Aggregation is not supported: %s",
+				 nodeToString(aggref));
+			return false;
+		}
+
+		foreach (lc2, aggref->args)
+		{
+			TargetEntry *tle = lfirst(lc2);
+			Expr	   *expr = tle->expr;
+			devtype_info *dtype;
+			Index		sortgroupref;
+
+			if (tle->resjunk)
+				continue;
+			/* same restriction to the grouping-keys */
+			dtype = pgstrom_devtype_lookup(exprType((Node *)expr));
+			if (!dtype || !dtype->hash_func ||
+				!pgstrom_devfunc_lookup_type_equal(dtype,
+												   exprCollation((Node *)expr)))
+			{
+				elog(DEBUG2, "DISTINCT aggregate contains unsupported type (%s): %s",
+					 format_type_be(exprType((Node *)expr)),
+					 nodeToString((Node *)expr));
+				return false;
+			}
+			if (!pgstrom_device_expression(root, con->input_rel, expr))
+				*p_can_pullup_outerscan = false;
+
+			/* argument of DISTINCT aggregate should be on the input items */
+			j = 0;
+			foreach (cell, target_device->exprs)
+			{
+				if (equal(expr, lfirst(cell)))
+					break;
+				j++;
+			}
+			if (!cell)
+			{
+				elog(DEBUG2, "DISTINCT aggregate argument is not on the input tlist: %s",
+					 nodeToString((Node *)expr));
+				return false;
+			}
+			if (target_device->sortgrouprefs[j] != 0)
+				continue;	/* already a grouping-key */
+			sortgroupref = gpupreagg_next_sortgroupref(root, target_device);
+			target_device->sortgrouprefs[j] = sortgroupref;
+
+			j = 0;
+			foreach (cell, target_partial->exprs)
+			{
+				if (equal(expr, lfirst(cell)) &&
+					(!target_partial->sortgrouprefs ||
+					 target_partial->sortgrouprefs[j] == 0))
+				{
+					n = list_length(target_partial->exprs);
+					target_partial->sortgrouprefs =
+						(!target_partial->sortgrouprefs
+						 ? palloc0(sizeof(Index) * (n+1))
+						 : repalloc(target_partial->sortgrouprefs,
+									sizeof(Index) * (n+1)));
+					target_partial->sortgrouprefs[j] = sortgroupref;
+					break;
+				}
+				j++;
+			}
+			if (!cell)
+				add_column_to_pathtarget(target_partial, expr, sortgroupref);
+		}
+	}
+	return true;
+}
+
 /*
  * gpupreagg_build_path_target
  *
@@ -2583,6 +3658,9 @@ gpupreagg_build_path_target(PlannerInfo *root,			/* in */
 	}
 	*p_havingQual = havingQual;
 
+	if (!add_distinct_aggref_keys(&con, p_can_pullup_outerscan))
+		return false;
+
 	set_pathtarget_cost_width(root, target_final);
 	set_pathtarget_cost_width(root, target_partial);
 	set_pathtarget_cost_width(root, target_device);
@@ -2735,8 +3813,40 @@ PlanGpuPreAggPath(PlannerInfo *root,
 	gpa_info->outer_refs = outer_refs;
 	gpa_info->used_params = context.used_params;
 
+	if (!gpa_info->sibling_param_ref)
+		gpa_info->sibling_param_id = -1;
+	else
+	{
+		cl_int	param_id = *gpa_info->sibling_param_ref;
+
+		if (param_id < 0)
+		{
+			PlannerGlobal  *glob = root->glob;
+#if PG_VERSION_NUM < 110000
+			param_id = glob->nParamExec++;
+#else
+			param_id = list_length(glob->paramExecTypes);
+			glob->paramExecTypes = lappend_oid(glob->paramExecTypes,
+											   INTERNALOID);
+#endif
+			*gpa_info->sibling_param_ref = param_id;
+		}
+		gpa_info->sibling_param_id = param_id;
+	}
 	form_gpupreagg_info(cscan, gpa_info);
 
+	/*
+	 * kick the program builder prior to the first execution, unless it
+	 * may be combined with GpuJoin on ExecInit; that adds definitions
+	 * for the combined kernel.
+	 */
+	if (!outer_plan)
+		pgstrom_prebuild_cuda_program(gpa_info->optimal_gpu,
+									  gpa_info->extra_flags,
+									  gpa_info->varlena_bufsz,
+									  gpa_info->kern_source,
+									  NULL);
+
 	return &cscan->scan.plan;
 }
 
@@ -3325,6 +4435,7 @@ gpupreagg_codegen_projection_row(StringInfo kern,
 	 * Execute expression and store the value on dst_values/dst_isnull
 	 */
 	resetStringInfo(&temp);
+	pgstrom_codegen_cse_setup(context, tlist_alt);
 	foreach (lc, tlist_alt)
 	{
 		TargetEntry	   *tle = lfirst(lc);
@@ -3390,6 +4501,7 @@ gpupreagg_codegen_projection_row(StringInfo kern,
 		type_oid_list = list_append_unique_oid(type_oid_list,
 											   dtype->type_oid);
 	}
+	pgstrom_codegen_cse_setup(context, NIL);
 	appendStringInfoString(&tbody, temp.data);
 	appendStringInfoString(&sbody, temp.data);
 	appendStringInfoString(&abody, temp.data);
@@ -3961,7 +5073,8 @@ gpupreagg_codegen(codegen_context *context,
 	/* gpuscan_quals_eval */
 	codegen_gpuscan_quals(&body, context, "gpupreagg",
 						  cscan->scan.scanrelid,
-						  gpa_info->outer_quals);
+						  gpa_info->outer_quals,
+						  NULL);
 
 	/*
 	 * gpupreagg_projection_(row|slot)
@@ -4140,6 +5253,8 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 
 	Assert(scan_rel ? outerPlan(node) == NULL : outerPlan(cscan) != NULL);
 	/* activate a GpuContext for CUDA kernel execution */
+	gpa_info->optimal_gpu = RelationChooseOptimalGpu(scan_rel,
+													 gpa_info->optimal_gpu);
 	gpas->gts.gcontext = AllocGpuContext(gpa_info->optimal_gpu, false, false);
 
 	/* setup common GpuTaskState fields */
@@ -4147,6 +5262,7 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 							gpas->gts.gcontext,
 							GpuTaskKind_GpuPreAgg,
 							gpa_info->outer_refs,
+							gpa_info->outer_quals,
 							gpa_info->used_params,
 							gpa_info->optimal_gpu,
 							gpa_info->outer_nrows_per_block,
@@ -4157,6 +5273,22 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 	gpas->gts.cb_process_task    = gpupreagg_process_task;
 	gpas->gts.cb_release_task    = gpupreagg_release_task;
 	gpas->num_group_keys	= gpa_info->num_group_keys;
+	gpas->final_mode		= gpa_info->final_mode;
+	pthreadRWLockInit(&gpas->f_rwlock);
+	if (gpa_info->sibling_param_id >= 0)
+	{
+		ParamExecData  *param
+			= &(estate->es_param_exec_vals[gpa_info->sibling_param_id]);
+		if (param->value == 0UL)
+		{
+			GpuPreAggSiblingState *sibling
+				= palloc0(sizeof(GpuPreAggSiblingState));
+			param->isnull = false;
+			param->value = PointerGetDatum(sibling);
+		}
+		gpas->sibling = (GpuPreAggSiblingState *)DatumGetPointer(param->value);
+		gpas->sibling->nr_siblings++;
+	}
 
 	/* initialization of the outer relation */
 	if (outerPlan(cscan))
@@ -4168,6 +5300,7 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 		outer_ps = ExecInitNode(outerPlan(cscan), estate, eflags);
 		if (enable_pullup_outer_join &&
 			pgstrom_planstate_is_gpujoin(outer_ps) &&
+			!GpuJoinHasMultiBatchInner(outer_ps) &&
 			!outer_ps->ps_ProjInfo)
 		{
 			gpas->combined_gpujoin = true;
@@ -4188,6 +5321,8 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 									gpa_info->index_oid,
 									gpa_info->index_conds,
 									gpa_info->index_quals);
+		/* lookup the result cache, if Arrow_Fdw/Gstore_Fdw */
+		pgstrom_result_cache_begin(&gpas->gts, eflags);
 	}
 
 	/*
@@ -4218,6 +5353,29 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 						   KDS_FORMAT_SLOT,
 						   INT_MAX);	/* to be set individually */
 
+	/*
+	 * Combined GpuJoin can reduce the joined rows by itself, if no grouping
+	 * keys and all the attributes are fixed-length; so nothing to be copied
+	 * from the kds_src/kmrels to the kds_slot.
+	 */
+	if (gpas->combined_gpujoin &&
+		gpas->num_group_keys == 0 &&
+		enable_fused_gpupreagg)
+	{
+		kern_data_store *kds_slot = gpas->kds_slot_head;
+		int		j;
+
+		gpas->fused_nogroup = true;
+		for (j=0; j < kds_slot->ncols; j++)
+		{
+			if (kds_slot->colmeta[j].attlen <= 0)
+			{
+				gpas->fused_nogroup = false;
+				break;
+			}
+		}
+	}
+
 	/* Save the plan-time estimations */
 	gpas->plan_nrows_per_chunk =
 		(gpa_info->plan_nchunks > 0
@@ -4226,6 +5384,30 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
     gpas->plan_nrows_in		= gpa_info->outer_nrows;
 	gpas->plan_ngroups		= gpa_info->plan_ngroups;
 	gpas->plan_extra_sz		= gpa_info->plan_extra_sz;
+	pg_atomic_init_u32(&gpas->lr_mode, GPUPREAGG_LOCAL_REDUCTION__SAMPLING);
+	pg_atomic_init_u32(&gpas->lr_nsamples, 0);
+	pg_atomic_init_u64(&gpas->lr_nitems, 0);
+	pg_atomic_init_u64(&gpas->lr_ngroups, 0);
+
+	/*
+	 * Admission control by the estimated footprint of the device memory;
+	 * final buffer and hash-slot for the planned number of groups, and
+	 * source/result buffer in-flight.
+	 * Parallel workers share the budget admitted by the leader.
+	 */
+	if (!explain_only && !IsParallelWorker())
+	{
+		size_t		footprint = 2 * pgstrom_chunk_size();
+		size_t		unitsz;
+
+		unitsz = (MAXALIGN(sizeof(Datum) * gpreagg_tupdesc->natts) +
+				  MAXALIGN(sizeof(bool) * gpreagg_tupdesc->natts) +
+				  MAXALIGN(gpas->plan_extra_sz) +
+				  4 * sizeof(pagg_hashslot));
+		footprint += (size_t)((double)unitsz * gpas->plan_ngroups);
+		gpas->gts.gm_budget_sz = gpuMemReserveBudget(gpas->gts.gcontext,
+													 footprint);
+	}
 
 	/* Get CUDA program and async build if any */
 	if (gpas->combined_gpujoin)
@@ -4268,6 +5450,15 @@ ExecReCheckGpuPreAgg(CustomScanState *node, TupleTableSlot *slot)
 	return true;
 }
 
+/*
+ * ExecAccessGpuPreAgg
+ */
+static TupleTableSlot *
+ExecAccessGpuPreAgg(GpuPreAggState *gpas)
+{
+	return pgstrom_result_cache_exec(&gpas->gts, gpas->gpreagg_slot);
+}
+
 /*
  * ExecGpuPreAgg
  */
@@ -4275,13 +5466,18 @@ static TupleTableSlot *
 ExecGpuPreAgg(CustomScanState *node)
 {
 	GpuPreAggState *gpas = (GpuPreAggState *) node;
+	TupleTableSlot *slot;
 
 	ActivateGpuContext(gpas->gts.gcontext);
 	if (!gpas->gpa_sstate)
 		createGpuPreAggSharedState(gpas, NULL, NULL);
-	return ExecScan(&node->ss,
-					(ExecScanAccessMtd) pgstromExecGpuTaskState,
+	slot = ExecScan(&node->ss,
+					(ExecScanAccessMtd) ExecAccessGpuPreAgg,
 					(ExecScanRecheckMtd) ExecReCheckGpuPreAgg);
+	/* final buffer is no longer needed, so hand it over to the siblings */
+	if (TupIsNull(slot) && gpas->sibling)
+		gpupreagg_putback_final_buffer(gpas);
+	return slot;
 }
 
 /*
@@ -4300,7 +5496,7 @@ ExecEndGpuPreAgg(CustomScanState *node)
 	{
 		GPUCONTEXT_PUSH(gcontext);
 		rc = cuEventRecord(gpas->ev_init_fhash,
-						   CU_STREAM_PER_THREAD);
+						   CU_STREAM_PER_WORKER);
 		GPUCONTEXT_POP(gcontext);
 		if (rc != CUDA_SUCCESS)
 			elog(ERROR, "failed on cuEventRecord: %s", errorText(rc));
@@ -4313,16 +5509,32 @@ ExecEndGpuPreAgg(CustomScanState *node)
 		ExecEndNode(outerPlanState(node));
 
 	/* release final buffer / hashslot */
+	if (gpas->sibling)
+	{
+		GpuPreAggSiblingState *sibling = gpas->sibling;
+
+		gpupreagg_putback_final_buffer(gpas);
+		Assert(sibling->nr_siblings > 0);
+		if (--sibling->nr_siblings == 0 && sibling->pds_final)
+		{
+			PDS_release(sibling->pds_final);
+			gpuMemFree(sibling->gcontext, sibling->m_fhash);
+			sibling->pds_final = NULL;
+			sibling->m_fhash = 0UL;
+		}
+	}
 	if (gpas->pds_final)
 		PDS_release(gpas->pds_final);
 	if (gpas->m_fhash)
 		gpuMemFree(gcontext, gpas->m_fhash);
+	gpupreagg_release_spilled_buffers(gpas);
 
 	/* release any other resources */
 	if (gpas->gpreagg_slot)
 		ExecDropSingleTupleTableSlot(gpas->gpreagg_slot);
 	if (gpas->outer_slot)
 		ExecDropSingleTupleTableSlot(gpas->outer_slot);
+	pgstrom_result_cache_end(&gpas->gts);
 	releaseGpuPreAggSharedState(gpas);
 	pgstromReleaseGpuTaskState(&gpas->gts, gt_rtstat);
 }
@@ -4342,6 +5554,10 @@ ExecReScanGpuPreAgg(CustomScanState *node)
 		ExecEndNode(outerPlanState(node));
 	/* reset shared state */
 	resetGpuPreAggSharedState(gpas);
+	/* spilled final buffers are no longer needed */
+	gpupreagg_release_spilled_buffers(gpas);
+	/* no result cache on rescan */
+	pgstrom_result_cache_end(&gpas->gts);
 	/* common rescan handling */
 	pgstromRescanGpuTaskState(&gpas->gts);
 	/* reset other stuff */
@@ -4510,8 +5726,24 @@ ExplainGpuPreAgg(CustomScanState *node, List *ancestors, ExplainState *es)
 		ExplainPropertyText("Combined GpuJoin", "enabled", es);
 	else if (es->format != EXPLAIN_FORMAT_TEXT)
 		ExplainPropertyText("Combined GpuJoin", "disabled", es);
+	if (gpas->fused_nogroup)
+		ExplainPropertyText("Fused Reduction", "enabled", es);
+	else if (es->format != EXPLAIN_FORMAT_TEXT)
+		ExplainPropertyText("Fused Reduction", "disabled", es);
+	/* final results without CPU aggregation? */
+	if (gpas->final_mode)
+		ExplainPropertyText("Final Aggregation", "enabled", es);
+	else if (es->format != EXPLAIN_FORMAT_TEXT)
+		ExplainPropertyText("Final Aggregation", "disabled", es);
+	/* siblings-identifier for partition-wise GpuPreAgg */
+	if (gpa_info->sibling_param_id >= 0)
+	{
+		ExplainPropertyInteger("Final buffer sibling-id", NULL,
+							   gpa_info->sibling_param_id, es);
+	}
 	/* other common fields */
 	pgstromExplainGpuTaskState(&gpas->gts, es);
+	pgstrom_result_cache_explain(&gpas->gts, es);
 	/* other run-time statistics, if any */
 	if (gpa_rtstat)
 	{
@@ -4521,6 +5753,9 @@ ExplainGpuPreAgg(CustomScanState *node, List *ancestors, ExplainState *es)
 		if (fallback_count > 0)
 			ExplainPropertyInteger("Num of CPU fallback rows",
 								   NULL, fallback_count, es);
+		if (gpas->num_spills > 0)
+			ExplainPropertyInteger("Num of spilled final buffers",
+								   NULL, gpas->num_spills, es);
 	}
 }
 
@@ -4571,6 +5806,62 @@ resetGpuPreAggSharedState(GpuPreAggState *gpas)
 	/* nothing to do */
 }
 
+/*
+ * gpupreagg_putback_final_buffer
+ *
+ * It hands over the final buffer and hash-slot to the sibling GpuPreAgg
+ * nodes once all the results are returned.
+ */
+static void
+gpupreagg_putback_final_buffer(GpuPreAggState *gpas)
+{
+	GpuPreAggSiblingState *sibling = gpas->sibling;
+	GpuContext	   *gcontext = gpas->gts.gcontext;
+	CUresult		rc;
+
+	Assert(sibling != NULL);
+	if (!gpas->pds_final)
+		return;
+	if (gpas->ev_init_fhash)
+	{
+		GPUCONTEXT_PUSH(gcontext);
+		rc = cuEventDestroy(gpas->ev_init_fhash);
+		GPUCONTEXT_POP(gcontext);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on cuEventDestroy: %s", errorText(rc));
+		gpas->ev_init_fhash = NULL;
+	}
+	/* only one free buffer is kept, so older one shall be released */
+	if (sibling->pds_final)
+	{
+		PDS_release(sibling->pds_final);
+		gpuMemFree(sibling->gcontext, sibling->m_fhash);
+	}
+	sibling->gcontext	= gcontext;
+	sibling->pds_final	= gpas->pds_final;
+	sibling->m_fhash	= gpas->m_fhash;
+	sibling->f_hashlimit = gpas->f_hashlimit;
+	gpas->pds_final		= NULL;
+	gpas->m_fhash		= 0UL;
+}
+
+/*
+ * gpupreagg_release_spilled_buffers
+ */
+static void
+gpupreagg_release_spilled_buffers(GpuPreAggState *gpas)
+{
+	int		i;
+
+	for (i=gpas->curr_spill; i < gpas->num_spills; i++)
+	{
+		PDS_release(gpas->pds_spill[i]);
+		gpas->pds_spill[i] = NULL;
+	}
+	gpas->num_spills = 0;
+	gpas->curr_spill = 0;
+}
+
 /*
  * gpupreagg_alloc_final_buffer
  */
@@ -4589,12 +5880,32 @@ gpupreagg_alloc_final_buffer(GpuPreAggState *gpas)
 	if (gpas->pds_final)
 		return;
 
-	/* final buffer allocation */
-	pds_final = PDS_create_slot(gcontext,
-								gpa_tupdesc,
-								0xffff8000UL);	/* 4GB - 32KB */
+	/* final buffer allocation, or reuse the one released by siblings */
+	if (gpas->sibling &&
+		gpas->sibling->pds_final &&
+		gpas->sibling->gcontext == gcontext &&
+		KDS_schemaIsCompatible(gpa_tupdesc, &gpas->sibling->pds_final->kds))
+	{
+		GpuPreAggSiblingState *sibling = gpas->sibling;
+
+		pds_final = sibling->pds_final;
+		pds_final->kds.nitems = 0;
+		pds_final->kds.usage = 0;
+		m_fhash = sibling->m_fhash;
+		f_hashlimit = sibling->f_hashlimit;
+		sibling->pds_final = NULL;
+		sibling->m_fhash = 0UL;
+		sibling->gcontext = NULL;
+	}
+	else
+	{
+		pds_final = PDS_create_slot(gcontext,
+									gpa_tupdesc,
+									0xffff8000UL);	/* 4GB - 32KB */
+		f_hashlimit = (size_t)((double)pds_final->kds.nrooms * 1.33);
+		m_fhash = 0UL;
+	}
 	/* final hash-slot allocation */
-	f_hashlimit = (size_t)((double)pds_final->kds.nrooms * 1.33);
 	if (gpas->plan_ngroups < 400000)
 		f_hashsize = 4 * gpas->plan_ngroups;
 	else if (gpas->plan_ngroups < 1200000)
@@ -4620,13 +5931,16 @@ gpupreagg_alloc_final_buffer(GpuPreAggState *gpas)
 	 * uses only @f_hashsize slot. If needs, GPU kernel extends the final
 	 * hash table on demand.
 	 */
-	rc = gpuMemAllocManaged(gcontext,
-							&m_fhash,
-							offsetof(kern_global_hashslot,
-									 hash_slot[f_hashlimit]),
-							CU_MEM_ATTACH_GLOBAL);
-	if (rc != CUDA_SUCCESS)
-		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	if (!m_fhash)
+	{
+		rc = gpuMemAllocManaged(gcontext,
+								&m_fhash,
+								offsetof(kern_global_hashslot,
+										 hash_slot[f_hashlimit]),
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	}
 	gpas->pds_final		= pds_final;
 	gpas->m_fhash		= m_fhash;
 	gpas->ev_init_fhash	= NULL;
@@ -4712,6 +6026,16 @@ gpupreagg_create_task(GpuPreAggState *gpas,
 		unitsz = MAXALIGN((sizeof(Datum) + sizeof(char)) * kds_slot->ncols);
 		kds_slot_length = pgstrom_chunk_size();
 	}
+	if (gpas->fused_nogroup)
+	{
+		/*
+		 * Fused reduction writes only one partial row per thread-block,
+		 * so kds_slot needs rooms for the largest grid-size at most.
+		 */
+		sm_count = devAttrs[gcontext->cuda_dindex].MULTIPROCESSOR_COUNT;
+		kds_slot_length = (KERN_DATA_STORE_HEAD_LENGTH(kds_slot) +
+						   unitsz * GPUKERNEL_MAX_SM_MULTIPLICITY * sm_count);
+	}
 	kds_slot_nrooms = (kds_slot_length -
 					   KERN_DATA_STORE_HEAD_LENGTH(kds_slot)) / unitsz;
 	/* buffer of row-invalidation-map */
@@ -4747,6 +6071,7 @@ gpupreagg_create_task(GpuPreAggState *gpas,
 		gpreagg->kgjoin = (kern_gpujoin *)
 			((char *)gpreagg + head_sz + suspend_sz + row_inval_sz);
 		GpuJoinSetupTask(gpreagg->kgjoin, outer_gts, pds_src);
+		gpreagg->kgjoin->fused_nogroup = gpas->fused_nogroup;
 		gpreagg->m_kmrels = m_kmrels;
 		gpreagg->outer_depth = outer_depth;
 	}
@@ -4975,15 +6300,96 @@ gpupreagg_next_tuple(GpuTaskState *gts)
 	{
 		slot = gpupreagg_next_tuple_fallback(gpas, gpreagg);
 	}
-	else if (gpas->gts.curr_index < pds_final->kds.nitems)
+	else
 	{
-		slot = gpas->gpreagg_slot;
-		ExecClearTuple(slot);
-		PDS_fetch_tuple(slot, pds_final, &gpas->gts);
+		/*
+		 * The final buffers spilled out to the host memory are returned
+		 * prior to the last one, if any.
+		 */
+		while (gpas->curr_spill < gpas->num_spills)
+		{
+			pgstrom_data_store *pds_spill
+				= gpas->pds_spill[gpas->curr_spill];
+
+			if (gpas->gts.curr_index < pds_spill->kds.nitems)
+			{
+				pds_final = pds_spill;
+				break;
+			}
+			PDS_release(pds_spill);
+			gpas->pds_spill[gpas->curr_spill++] = NULL;
+			gpas->gts.curr_index = 0;
+		}
+
+		if (gpas->gts.curr_index < pds_final->kds.nitems)
+		{
+			slot = gpas->gpreagg_slot;
+			ExecClearTuple(slot);
+			PDS_fetch_tuple(slot, pds_final, &gpas->gts);
+		}
 	}
 	return slot;
 }
 
+/*
+ * __gpupreagg_init_final_hash
+ *
+ * It kicks gpupreagg_init_final_hash kernel on the worker stream, to
+ * initialize the first @f_hashsize slots of the final hash-slot.
+ */
+static void
+__gpupreagg_init_final_hash(GpuPreAggState *gpas, CUmodule cuda_module)
+{
+	CUfunction	kern_init_fhash;
+	CUresult	rc;
+	cl_int		grid_sz;
+	cl_int		block_sz;
+	void	   *kern_args[3];
+
+	rc = cuModuleGetFunction(&kern_init_fhash,
+							 cuda_module,
+							 "gpupreagg_init_final_hash");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_init_fhash,
+							 CU_DEVICE_PER_THREAD,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Min(grid_sz, (gpas->f_hashsize +
+							block_sz - 1) / block_sz);
+	/*
+	 * Final hash-slot may be larger than the device memory; so,
+	 * only the portion initially used is prefetched.
+	 */
+	if (pgstrom_gpu_memory_oversubscription)
+	{
+		rc = gpuMemPrefetchManaged(GpuWorkerCurrentContext,
+								   gpas->m_fhash,
+								   offsetof(kern_global_hashslot,
+											hash_slot[gpas->f_hashsize]),
+								   false);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on gpuMemPrefetchManaged: %s",
+				   errorText(rc));
+	}
+	kern_args[0] = &gpas->m_fhash;
+	kern_args[1] = &gpas->f_hashsize;
+	kern_args[2] = &gpas->f_hashlimit;
+	rc = cuLaunchKernel(kern_init_fhash,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_WORKER,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+}
+
 /*
  * gpupreagg_init_final_hash
  */
@@ -4992,59 +6398,29 @@ gpupreagg_init_final_hash(GpuPreAggTask *gpreagg,
 						  CUmodule cuda_module)
 {
 	GpuPreAggState *gpas = (GpuPreAggState *)gpreagg->task.gts;
-	CUfunction	kern_init_fhash;
 	CUevent		ev_init_fhash;
 	CUresult	rc;
-	cl_int		grid_sz;
-	cl_int		block_sz;
-	void	   *kern_args[3];
 
 	pthreadMutexLock(&gpas->f_mutex);
 	STROM_TRY();
 	{
 		if (!gpas->ev_init_fhash)
 		{
-			rc = cuModuleGetFunction(&kern_init_fhash,
-									 cuda_module,
-									 "gpupreagg_init_final_hash");
-			if (rc != CUDA_SUCCESS)
-				werror("failed on cuModuleGetFunction: %s", errorText(rc));
-
 			rc = cuEventCreate(&ev_init_fhash,
 							   CU_EVENT_BLOCKING_SYNC);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuEventCreate: %s", errorText(rc));
 
-			rc = gpuOptimalBlockSize(&grid_sz,
-									 &block_sz,
-									 kern_init_fhash,
-									 CU_DEVICE_PER_THREAD,
-									 0, 0);
-			if (rc != CUDA_SUCCESS)
-				werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
-			grid_sz = Min(grid_sz, (gpas->f_hashsize +
-									block_sz - 1) / block_sz);
-			kern_args[0] = &gpas->m_fhash;
-			kern_args[1] = &gpas->f_hashsize;
-			kern_args[2] = &gpas->f_hashlimit;
-			rc = cuLaunchKernel(kern_init_fhash,
-								grid_sz, 1, 1,
-								block_sz, 1, 1,
-								0,
-								CU_STREAM_PER_THREAD,
-								kern_args,
-								NULL);
-			if (rc != CUDA_SUCCESS)
-				werror("failed on cuLaunchKernel: %s", errorText(rc));
+			__gpupreagg_init_final_hash(gpas, cuda_module);
 
 			rc = cuEventRecord(ev_init_fhash,
-							   CU_STREAM_PER_THREAD);
+							   CU_STREAM_PER_WORKER);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuEventRecord: %s", errorText(rc));
 
 			gpas->ev_init_fhash = ev_init_fhash;
 
-			rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+			rc = cuStreamSynchronize(CU_STREAM_PER_WORKER);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuStreamSynchronize: %s", errorText(rc));
 		}
@@ -5057,13 +6433,188 @@ gpupreagg_init_final_hash(GpuPreAggTask *gpreagg,
 	STROM_END_TRY();
 	pthreadMutexUnlock(&gpas->f_mutex);
 	/* Point of synchronization */
-	rc = cuStreamWaitEvent(CU_STREAM_PER_THREAD,
+	rc = cuStreamWaitEvent(CU_STREAM_PER_WORKER,
 						   gpas->ev_init_fhash,
 						   0);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuStreamWaitEvent: %s", errorText(rc));
 }
 
+/*
+ * gpupreagg_final_buffer_overflow
+ *
+ * It checks whether the reduction kernel stopped because the final buffer
+ * or the final hash-slot has no space any more, and the final buffer can
+ * be spilled out to continue the reduction.
+ */
+static inline bool
+gpupreagg_final_buffer_overflow(GpuPreAggTask *gpreagg)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+
+	return (!gpas->final_mode &&
+			gpreagg->kern.num_group_keys > 0 &&
+			gpreagg->kern.setup_slot_done &&
+			(gpreagg->kern.kerror.errcode &
+			 ~ERRCODE_FLAGS_CPU_FALLBACK) == ERRCODE_STROM_DATASTORE_NOSPACE);
+}
+
+/*
+ * gpupreagg_spill_final_buffer
+ *
+ * It moves the final buffer that has no space any more to the host memory,
+ * then switches to a new empty one with the final hash-slot initialized
+ * again. It returns false if no more final buffer can be spilled out, so
+ * caller has to handle the error as usual.
+ */
+static bool
+gpupreagg_spill_final_buffer(GpuPreAggTask *gpreagg,
+							 CUmodule cuda_module,
+							 cl_uint f_generation)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+	GpuContext	   *gcontext = GpuWorkerCurrentContext;
+	volatile bool	retval = true;
+
+	pthreadRWLockWriteLock(&gpas->f_rwlock);
+	STROM_TRY();
+	{
+		pgstrom_data_store *pds_old = gpas->pds_final;
+		pgstrom_data_store *pds_new;
+		kern_data_store	   *kds_old = &pds_old->kds;
+		kern_global_hashslot *f_hash;
+		CUdeviceptr	m_deviceptr;
+		CUresult	rc;
+		size_t		head_sz;
+		size_t		extra_sz;
+
+		if (gpas->f_generation != f_generation)
+		{
+			/* concurrent worker already switched the final buffer */
+		}
+		else if (gpas->num_spills >= GPUPREAGG_MAX_SPILL_BUFFERS ||
+				 kds_old->nitems == 0)
+		{
+			retval = false;
+		}
+		else
+		{
+			rc = gpuMemAllocManaged(gcontext,
+									&m_deviceptr,
+									offsetof(pgstrom_data_store, kds) +
+									kds_old->length,
+									CU_MEM_ATTACH_GLOBAL);
+			if (rc == CUDA_ERROR_OUT_OF_MEMORY)
+				retval = false;
+			else if (rc != CUDA_SUCCESS)
+				werror("failed on gpuMemAllocManaged: %s", errorText(rc));
+			else
+			{
+				/* setup a new empty final buffer */
+				pds_new = (pgstrom_data_store *) m_deviceptr;
+				memcpy(pds_new, pds_old,
+					   offsetof(pgstrom_data_store, kds) +
+					   KERN_DATA_STORE_HEAD_LENGTH(kds_old));
+				pg_atomic_init_u32(&pds_new->refcnt, 1);
+				pds_new->kds.nitems = 0;
+				pds_new->kds.usage = 0;
+
+				/* move the rows and the extra area to the host memory */
+				head_sz = (offsetof(pgstrom_data_store, kds) +
+						   KERN_DATA_STORE_SLOT_LENGTH(kds_old,
+													   kds_old->nitems));
+				rc = cuMemPrefetchAsync((CUdeviceptr)pds_old,
+										head_sz,
+										CU_DEVICE_CPU,
+										CU_STREAM_PER_WORKER);
+				if (rc != CUDA_SUCCESS)
+					werror("failed on cuMemPrefetchAsync: %s",
+						   errorText(rc));
+				extra_sz = __kds_unpack(kds_old->usage);
+				if (extra_sz > 0)
+				{
+					rc = cuMemPrefetchAsync((CUdeviceptr)kds_old +
+											kds_old->length - extra_sz,
+											extra_sz,
+											CU_DEVICE_CPU,
+											CU_STREAM_PER_WORKER);
+					if (rc != CUDA_SUCCESS)
+						werror("failed on cuMemPrefetchAsync: %s",
+							   errorText(rc));
+				}
+				gpuDeviceCountDMA(gcontext, 0, head_sz + extra_sz, 0);
+				gpas->pds_spill[gpas->num_spills++] = pds_old;
+				gpas->pds_final = pds_new;
+
+				/*
+				 * The final hash-slot is initialized again with the size
+				 * already expanded, because the later reduction will also
+				 * produce many groups.
+				 */
+				f_hash = (kern_global_hashslot *) gpas->m_fhash;
+				gpas->f_hashsize = Min(f_hash->hash_size,
+									   f_hash->hash_limit);
+				__gpupreagg_init_final_hash(gpas, cuda_module);
+				rc = cuStreamSynchronize(CU_STREAM_PER_WORKER);
+				if (rc != CUDA_SUCCESS)
+					werror("failed on cuStreamSynchronize: %s",
+						   errorText(rc));
+				gpas->f_generation++;
+			}
+		}
+	}
+	STROM_CATCH();
+	{
+		pthreadRWLockUnlock(&gpas->f_rwlock);
+		STROM_RE_THROW();
+	}
+	STROM_END_TRY();
+	pthreadRWLockUnlock(&gpas->f_rwlock);
+
+	return retval;
+}
+
+/*
+ * gpupreagg_launch_final_reduction
+ *
+ * It launches the reduction kernel under the shared lock of the final
+ * buffer, and waits for its completion. It returns the generation of the
+ * final buffer the kernel worked on.
+ */
+static cl_uint
+gpupreagg_launch_final_reduction(GpuPreAggState *gpas,
+								 CUfunction kern_reduction,
+								 cl_int grid_sz,
+								 cl_int block_sz,
+								 cl_uint shmem_sz,
+								 void **kern_args,
+								 CUdeviceptr *p_kds_final)
+{
+	cl_uint		f_generation;
+	CUresult	rc;
+
+	pthreadRWLockReadLock(&gpas->f_rwlock);
+	f_generation = gpas->f_generation;
+	*p_kds_final = (CUdeviceptr)&gpas->pds_final->kds;
+	rc = cuLaunchKernel(kern_reduction,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						shmem_sz,
+						CU_STREAM_PER_WORKER,
+						kern_args,
+						NULL);
+	if (rc == CUDA_SUCCESS)
+		rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_WORKER);
+	/* Point of synchronization */
+	if (rc == CUDA_SUCCESS)
+		rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
+	pthreadRWLockUnlock(&gpas->f_rwlock);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on GpuPreAgg reduction kernel: %s", errorText(rc));
+
+	return f_generation;
+}
+
 /*
  * gpupreaggUpdateRunTimeStat
  */
@@ -5080,6 +6631,62 @@ gpupreaggUpdateRunTimeStat(GpuTaskState *gts, kern_gpupreagg *kgpreagg)
 	//TODO: other statistics
 }
 
+/*
+ * gpupreagg_setup_local_reduction
+ */
+static void
+gpupreagg_setup_local_reduction(GpuPreAggTask *gpreagg)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+
+	gpreagg->kern.local_reduction =
+		(pg_atomic_read_u32(&gpas->lr_mode) !=
+		 GPUPREAGG_LOCAL_REDUCTION__DISABLED);
+	gpreagg->kern.local_groups = 0;
+}
+
+/*
+ * gpupreagg_sample_local_reduction
+ *
+ * It accumulates number of the rows and groups by the local reduction,
+ * then determines whether the later kernel invocations use the local
+ * reduction, or not.
+ */
+static void
+gpupreagg_sample_local_reduction(GpuPreAggTask *gpreagg,
+								 kern_data_store *kds_slot)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+	uint64		nitems;
+	uint64		ngroups;
+	uint32		lr_mode;
+
+	if (gpreagg->kern.num_group_keys == 0 ||
+		!gpreagg->kern.local_reduction ||
+		kds_slot->nitems == 0 ||
+		pg_atomic_read_u32(&gpas->lr_mode) !=
+		GPUPREAGG_LOCAL_REDUCTION__SAMPLING)
+		return;
+
+	nitems = pg_atomic_add_fetch_u64(&gpas->lr_nitems,
+									 kds_slot->nitems);
+	ngroups = pg_atomic_add_fetch_u64(&gpas->lr_ngroups,
+									  gpreagg->kern.local_groups);
+	gpreagg->kern.local_groups = 0;
+	if (pg_atomic_add_fetch_u32(&gpas->lr_nsamples, 1) <
+		GPUPREAGG_LOCAL_REDUCTION_NSAMPLES)
+		return;
+
+	/* only the first one who reached the number of samples decides */
+	lr_mode = GPUPREAGG_LOCAL_REDUCTION__SAMPLING;
+	pg_atomic_compare_exchange_u32(&gpas->lr_mode, &lr_mode,
+								   (double)ngroups >
+								   (double)nitems *
+								   GPUPREAGG_LOCAL_REDUCTION_THRESHOLD
+								   ? GPUPREAGG_LOCAL_REDUCTION__DISABLED
+								   : GPUPREAGG_LOCAL_REDUCTION__ENABLED);
+}
+
 /*
  * gpupreagg_throw_partial_result
  */
@@ -5097,7 +6704,7 @@ gpupreagg_throw_partial_result(GpuPreAggTask *gpreagg,
 	rc = cuMemPrefetchAsync((CUdeviceptr) kds_slot,
 							gpreagg->kds_slot_length,
 							CU_DEVICE_CPU,
-							CU_STREAM_PER_THREAD);
+							CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 
@@ -5133,11 +6740,26 @@ gpupreagg_throw_partial_result(GpuPreAggTask *gpreagg,
 	dlist_push_tail(&gts->ready_tasks,
 					&gresp->task.chain);
 	gts->num_ready_tasks++;
+	gts->num_result_overflow++;
 	pthreadMutexUnlock(&gcontext->worker_mutex);
 
 	SetLatch(MyLatch);
 }
 
+/*
+ * gpupreagg_cpu_fallback_enabled
+ *
+ * CPU fallback generates partial results of the groups, so it is not
+ * available when GpuPreAgg runs in the final mode.
+ */
+static inline bool
+gpupreagg_cpu_fallback_enabled(GpuPreAggTask *gpreagg)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+
+	return (pgstrom_cpu_fallback_enabled && !gpas->final_mode);
+}
+
 /*
  * gpupreagg_process_reduction_task
  *
@@ -5149,7 +6771,6 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 {
 	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
 	GpuContext	   *gcontext = gpas->gts.gcontext;
-	pgstrom_data_store *pds_final = gpas->pds_final;
 	pgstrom_data_store *pds_src = gpreagg->pds_src;
 	const char	   *kfunc_setup;
 	CUfunction		kern_setup;
@@ -5159,11 +6780,12 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 	CUdeviceptr		m_kds_src = 0UL;
 	CUdeviceptr		m_kds_extra = 0UL;
 	CUdeviceptr		m_kds_slot = 0UL;
-	CUdeviceptr		m_kds_final = (CUdeviceptr)&pds_final->kds;
+	CUdeviceptr		m_kds_final = 0UL;
 	CUdeviceptr		m_fhash = gpas->m_fhash;
 	bool			m_kds_src_release = false;
 	cl_int			grid_sz;
 	cl_int			block_sz;
+	cl_uint			f_generation;
 	void		   *last_suspend = NULL;
 	void		   *kern_args[6];
 	void		   *temp;
@@ -5292,18 +6914,20 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 		rc = cuMemcpyHtoDAsync(m_kds_src,
 							   &pds_src->kds,
 							   pds_src->kds.length,
-							   CU_STREAM_PER_THREAD);
+							   CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemcpyHtoD: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 	}
 	else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
 	{
 		rc = cuMemPrefetchAsync(m_kds_src,
 								pds_src->kds.length,
 								CU_DEVICE_PER_THREAD,
-								CU_STREAM_PER_THREAD);
+								CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 	}
 
 	/*
@@ -5321,6 +6945,7 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
 	gpreagg->kern.grid_sz = grid_sz;
 	gpreagg->kern.block_sz = block_sz;
+	gpupreagg_setup_local_reduction(gpreagg);
 resume_kernel:
 	/* make kds_slot empty */
 	((kern_data_store *)m_kds_slot)->nitems = 0;
@@ -5334,7 +6959,7 @@ resume_kernel:
 						gpreagg->kern.grid_sz, 1, 1,
 						gpreagg->kern.block_sz, 1, 1,
 						sizeof(cl_int) * 1024,	/* for StairlikeSum */
-						CU_STREAM_PER_THREAD,
+						CU_STREAM_PER_WORKER,
 						kern_args,
 						NULL);
 	if (rc != CUDA_SUCCESS)
@@ -5361,36 +6986,29 @@ resume_kernel:
 	kern_args[2] = &m_kds_slot;
 	kern_args[3] = &m_kds_final;
 	kern_args[4] = &m_fhash;
-	rc = cuLaunchKernel(kern_reduction,
-						grid_sz, 1, 1,
-						block_sz, 1, 1,
-						sizeof(cl_int) * 1024,	/* for StairlikeSum */
-						CU_STREAM_PER_THREAD,
-						kern_args,
-						NULL);
-	if (rc != CUDA_SUCCESS)
-		werror("failed on cuLaunchKernel: %s", errorText(rc));
-
-	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
-	if (rc != CUDA_SUCCESS)
-		werror("failed on cuEventRecord: %s", errorText(rc));
-
-	/* Point of synchronization */
-	rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
-	if (rc != CUDA_SUCCESS)
-		werror("failed on cuEventSynchronize: %s", errorText(rc));
-
+retry_reduction:
+	f_generation = gpupreagg_launch_final_reduction(gpas,
+													kern_reduction,
+													grid_sz,
+													block_sz,
+													sizeof(cl_int) * 1024,
+													kern_args,
+													&m_kds_final);
 	/*
-	 * XXX - Even though we speculatively allocate large virtual device
-	 * memory, GPU kernel may raise NoDataSpace error.
-	 * In this case, we need working device memory.
-	 * For pds_final, all we need to do is pre-allocation of very large
-	 * virtual device memory with 64bit offset support.
-	 * In case of final hash table, we have to re-organize hash table
-	 * again, because hash table must be initialized to (0,-1), thus, it
-	 * leads page-fault and physical memory allocation. We cannot pre-allocate
-	 * too large memory.
+	 * GPU kernel raises NoDataSpace error once the final buffer or the
+	 * final hash-slot expanded up to its limit is filled up. In this case,
+	 * the current final buffer is spilled out to the host memory, then
+	 * the reduction is retried on a new empty one. Rows already merged
+	 * are skipped according to the row-invalidation-map.
 	 */
+	if (gpupreagg_final_buffer_overflow(gpreagg) &&
+		gpupreagg_spill_final_buffer(gpreagg, cuda_module, f_generation))
+	{
+		CHECK_WORKER_TERMINATION();
+		memset(&gpreagg->kern.kerror, 0, sizeof(kern_errorbuf));
+		gpreagg->kern.read_slot_pos = 0;
+		goto retry_reduction;
+	}
 
 	/*
      * Clear the error code if CPU fallback case.
@@ -5400,6 +7018,8 @@ resume_kernel:
 		   &gpreagg->kern.kerror, sizeof(kern_errorbuf));
 	if (gpreagg->task.kerror.errcode == ERRCODE_STROM_SUCCESS)
 	{
+		gpupreagg_sample_local_reduction(gpreagg,
+										 (kern_data_store *)m_kds_slot);
 		if (gpreagg->kern.suspend_count > 0)
 		{
 			CHECK_WORKER_TERMINATION();
@@ -5415,7 +7035,7 @@ resume_kernel:
 		gpupreaggUpdateRunTimeStat(gpreagg->task.gts, &gpreagg->kern);
 		retval = -1;
 	}
-	else if (pgstrom_cpu_fallback_enabled &&
+	else if (gpupreagg_cpu_fallback_enabled(gpreagg) &&
 			 (gpreagg->task.kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
 	{
 		memset(&gpreagg->task.kerror, 0, sizeof(kern_errorbuf));
@@ -5436,6 +7056,7 @@ resume_kernel:
 								  pds_src->kds.length);
 				if (rc != CUDA_SUCCESS)
 					werror("failed on cuMemcpyDtoH: %s", errorText(rc));
+				gpuDeviceCountDMA(gcontext, 0, pds_src->kds.length, 0);
 				pds_src->nblocks_uncached = 0;
 			}
 			else if (pds_src->kds.format == KDS_FORMAT_ARROW &&
@@ -5484,7 +7105,7 @@ resume_kernel:
 			rc = cuMemPrefetchAsync(m_kds_slot,
 									gpreagg->kds_slot_length,
 									CU_DEVICE_CPU,
-									CU_STREAM_PER_THREAD);
+									CU_STREAM_PER_WORKER);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 			gpreagg->kds_slot = (kern_data_store *) m_kds_slot;
@@ -5516,7 +7137,6 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 {
 	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
 	GpuContext	   *gcontext = gpas->gts.gcontext;
-	pgstrom_data_store *pds_final = gpas->pds_final;
 	pgstrom_data_store *pds_src = gpreagg->pds_src;
 	kern_gpujoin   *kgjoin = gpreagg->kgjoin;
 	CUfunction		kern_gpujoin_main;
@@ -5527,7 +7147,7 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 	CUdeviceptr		m_kds_src = 0UL;
 	CUdeviceptr		m_kds_extra = 0UL;
 	CUdeviceptr		m_kds_slot = 0UL;
-	CUdeviceptr		m_kds_final = (CUdeviceptr)&pds_final->kds;
+	CUdeviceptr		m_kds_final = 0UL;
 	CUdeviceptr		m_fhash = gpas->m_fhash;
 	CUdeviceptr		m_kparams = ((CUdeviceptr)&gpreagg->kern +
 								 offsetof(kern_gpupreagg, kparams));
@@ -5535,10 +7155,13 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 	bool			m_kds_src_release = false;
 	cl_int			grid_sz;
 	cl_int			block_sz;
+	cl_uint			f_generation;
 	void		   *kern_args[10];
+	void		   *kern_args_r[5];
 	void		   *last_suspend = NULL;
 	void		   *temp;
 	int				retval = 1;
+	GpuKernelLaunchInfo klaunch[2];
 
 	/*
 	 * Ensure the final buffer & hashslot are ready to use
@@ -5649,20 +7272,27 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 			rc = cuMemcpyHtoDAsync(m_kds_src,
 								   &pds_src->kds,
 								   pds_src->kds.length,
-								   CU_STREAM_PER_THREAD);
+								   CU_STREAM_PER_WORKER);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemcpyHtoDAsync: %s", errorText(rc));
+			gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 		}
 		else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
 		{
 			rc = cuMemPrefetchAsync(m_kds_src,
 									pds_src->kds.length,
 									CU_DEVICE_PER_THREAD,
-									CU_STREAM_PER_THREAD);
+									CU_STREAM_PER_WORKER);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+			gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 		}
 	}
+	gpupreagg_setup_local_reduction(gpreagg);
+	/* merge outer-join-maps prior to RIGHT/FULL OUTER JOIN */
+	if (!pds_src)
+		gpujoinMergeOuterJoinMaps((GpuTaskState *)outerPlanState(gpas),
+								  cuda_module, kgjoin, gpreagg->outer_depth);
 resume_kernel:
 	/* make kds_slot empty again */
 	((kern_data_store *)m_kds_slot)->nitems = 0;
@@ -5711,15 +7341,11 @@ resume_kernel:
 		kern_args[3] = &m_kds_slot;
 		kern_args[4] = &m_kparams;
 	}
-	rc = cuLaunchKernel(kern_gpujoin_main,
-						grid_sz, 1, 1,
-						block_sz, 1, 1,
-						sizeof(cl_int) * block_sz,
-						CU_STREAM_PER_THREAD,
-						kern_args,
-						NULL);
-	if (rc != CUDA_SUCCESS)
-		werror("failed on cuLaunchKernel: %s", errorText(rc));
+	klaunch[0].kern_function = kern_gpujoin_main;
+	klaunch[0].grid_sz = grid_sz;
+	klaunch[0].block_sz = block_sz;
+	klaunch[0].shmem_sz = sizeof(cl_int) * block_sz;
+	klaunch[0].kern_args = kern_args;
 
 	/*
 	 * Launch:
@@ -5738,33 +7364,60 @@ resume_kernel:
 	if (rc != CUDA_SUCCESS)
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
 
-	kern_args[0] = &m_gpreagg;
-	kern_args[1] = &m_kgjoin;
-	kern_args[2] = &m_kds_slot;
-	kern_args[3] = &m_kds_final;
-	kern_args[4] = &m_fhash;
-	rc = cuLaunchKernel(kern_gpupreagg_reduction,
-						grid_sz, 1, 1,
-						block_sz, 1, 1,
-						sizeof(cl_int) * block_sz,	/* for StairlikeSum */
-						CU_STREAM_PER_THREAD,
-						kern_args,
-						NULL);
-	if (rc != CUDA_SUCCESS)
-		werror("failed on cuLaunchKernel: %s", errorText(rc));
-
-	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
-	if (rc != CUDA_SUCCESS)
-		werror("failed on cuEventRecord: %s", errorText(rc));
+	kern_args_r[0] = &m_gpreagg;
+	kern_args_r[1] = &m_kgjoin;
+	kern_args_r[2] = &m_kds_slot;
+	kern_args_r[3] = &m_kds_final;
+	kern_args_r[4] = &m_fhash;
+	klaunch[1].kern_function = kern_gpupreagg_reduction;
+	klaunch[1].grid_sz = grid_sz;
+	klaunch[1].block_sz = block_sz;
+	klaunch[1].shmem_sz = sizeof(cl_int) * block_sz;	/* for StairlikeSum */
+	klaunch[1].kern_args = kern_args_r;
 
+	/*
+	 * kick GpuJoin and GpuPreAgg reduction in series, under the shared
+	 * lock of the final buffer (see gpupreagg_launch_final_reduction)
+	 */
+	pthreadRWLockReadLock(&gpas->f_rwlock);
+	f_generation = gpas->f_generation;
+	m_kds_final = (CUdeviceptr)&gpas->pds_final->kds;
+	rc = gpuLaunchKernelSequence(2, klaunch);
+	if (rc == CUDA_SUCCESS)
+		rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_WORKER);
 	/* Point of synchronization */
-	rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
+	if (rc == CUDA_SUCCESS)
+		rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
+	pthreadRWLockUnlock(&gpas->f_rwlock);
 	if (rc != CUDA_SUCCESS)
-		werror("failed on cuEventSynchronize: %s", errorText(rc));
+		werror("failed on GpuJoin+GpuPreAgg kernels: %s", errorText(rc));
+
+	/*
+	 * If the final buffer has no space any more, spill out it to the host
+	 * memory, then retry only the reduction on the kds_slot built by the
+	 * GpuJoin. Rows already merged are skipped according to the row-
+	 * invalidation-map.
+	 */
+	while (kgjoin->kerror.errcode == ERRCODE_STROM_SUCCESS &&
+		   gpupreagg_final_buffer_overflow(gpreagg) &&
+		   gpupreagg_spill_final_buffer(gpreagg, cuda_module, f_generation))
+	{
+		CHECK_WORKER_TERMINATION();
+		memset(&gpreagg->kern.kerror, 0, sizeof(kern_errorbuf));
+		gpreagg->kern.read_slot_pos = 0;
+		f_generation =
+			gpupreagg_launch_final_reduction(gpas,
+											 kern_gpupreagg_reduction,
+											 klaunch[1].grid_sz,
+											 klaunch[1].block_sz,
+											 klaunch[1].shmem_sz,
+											 kern_args_r,
+											 &m_kds_final);
+	}
 
 	if (kgjoin->kerror.errcode != ERRCODE_STROM_SUCCESS)
 	{
-		if (pgstrom_cpu_fallback_enabled &&
+		if (gpupreagg_cpu_fallback_enabled(gpreagg) &&
 			(kgjoin->kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
 		{
 			/*
@@ -5785,6 +7438,7 @@ resume_kernel:
 								  pds_src->kds.length);
 				if (rc != CUDA_SUCCESS)
 					werror("failed on cuMemcpyDtoH: %s", errorText(rc));
+				gpuDeviceCountDMA(gcontext, 0, pds_src->kds.length, 0);
 				pds_src->nblocks_uncached = 0;
 			}
 			else if (pds_src &&
@@ -5809,7 +7463,7 @@ resume_kernel:
 	}
 	else if (gpreagg->kern.kerror.errcode != ERRCODE_STROM_SUCCESS)
 	{
-		if (pgstrom_cpu_fallback_enabled &&
+		if (gpupreagg_cpu_fallback_enabled(gpreagg) &&
 			(gpreagg->kern.kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
 		{
 			/*
@@ -5848,7 +7502,7 @@ resume_kernel:
 				rc = cuMemPrefetchAsync(m_kds_slot,
 										gpreagg->kds_slot_length,
 										CU_DEVICE_CPU,
-										CU_STREAM_PER_THREAD);
+										CU_STREAM_PER_WORKER);
 				if (rc != CUDA_SUCCESS)
 					werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 				gpreagg->task.cpu_fallback = true;
@@ -5869,6 +7523,8 @@ resume_kernel:
 		 * Only GpuJoin-side can break GPU kernel execution.
 		 */
 		Assert(gpreagg->kern.suspend_count == 0);
+		gpupreagg_sample_local_reduction(gpreagg,
+										 (kern_data_store *)m_kds_slot);
 		if (kgjoin->suspend_count > 0)
 		{
 			CHECK_WORKER_TERMINATION();
@@ -5984,6 +7640,24 @@ pgstrom_init_gpupreagg(void)
 #else
 	enable_partitionwise_gpupreagg = false;
 #endif
+	/* pg_strom.enable_final_gpupreagg */
+	DefineCustomBoolVariable("pg_strom.enable_final_gpupreagg",
+							 "Enables GpuPreAgg to produce the final results",
+							 NULL,
+							 &enable_final_gpupreagg,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.enable_fused_gpupreagg */
+	DefineCustomBoolVariable("pg_strom.enable_fused_gpupreagg",
+							 "Enables combined GpuJoin to reduce rows for GpuPreAgg without grouping keys",
+							 NULL,
+							 &enable_fused_gpupreagg,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 	/* pg_strom.enable_numeric_aggfuncs */
 	DefineCustomBoolVariable("pg_strom.enable_numeric_aggfuncs",
 							 "Enables aggregate functions on numeric type",
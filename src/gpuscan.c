@@ -25,6 +25,9 @@ static CustomScanMethods	gpuscan_plan_methods;
 static CustomExecMethods	gpuscan_exec_methods;
 bool						enable_gpuscan;		/* GUC */
 static bool					enable_pullup_outer_scan;
+static bool					enable_gpuscan_parallel_feeder;	/* GUC */
+static bool					enable_gpuscan_qual_reorder;	/* GUC */
+static bool					enable_gpuscan_selection_vector; /* GUC */
 
 /*
  * form/deform interface of private field of CustomScan(GpuScan)
@@ -40,6 +43,7 @@ typedef struct {
 	List	   *outer_refs;		/* referenced outer attributes */
 	List	   *used_params;
 	List	   *dev_quals;		/* implicitly-ANDed device quals */
+	cl_int		qstat_index;	/* kparam index of kern_gpuscan_qstat, or -1 */
 	Oid			index_oid;		/* OID of BRIN-index, if any */
 	List	   *index_conds;	/* BRIN-index key conditions */
 	List	   *index_quals;	/* original BRIN-index qualifier */
@@ -61,6 +65,7 @@ form_gpuscan_info(CustomScan *cscan, GpuScanInfo *gs_info)
 	privs = lappend(privs, gs_info->outer_refs);
 	exprs = lappend(exprs, gs_info->used_params);
 	exprs = lappend(exprs, gs_info->dev_quals);
+	privs = lappend(privs, makeInteger(gs_info->qstat_index));
 	privs = lappend(privs, makeInteger(gs_info->index_oid));
 	privs = lappend(privs, gs_info->index_conds);
 	exprs = lappend(exprs, gs_info->index_quals);
@@ -88,6 +93,7 @@ deform_gpuscan_info(CustomScan *cscan)
 	gs_info->outer_refs = list_nth(privs, pindex++);
 	gs_info->used_params = list_nth(exprs, eindex++);
 	gs_info->dev_quals = list_nth(exprs, eindex++);
+	gs_info->qstat_index = intVal(list_nth(privs, pindex++));
 	gs_info->index_oid = intVal(list_nth(privs, pindex++));
 	gs_info->index_conds = list_nth(privs, pindex++);
 	gs_info->index_quals = list_nth(exprs, eindex++);
@@ -99,12 +105,42 @@ typedef struct {
 	GpuTaskRuntimeStat	c;		/* common statistics */
 } GpuScanRuntimeStat;
 
+/*
+ * Parallel feeder mode
+ *
+ * In this mode, parallel workers never touch the GPU device. They load the
+ * heap blocks and check visibility of the tuples, then put the chunk on
+ * the slots of the shared memory. The leader process is the only GPU
+ * executor; it picks up the chunks prepared by the workers (and also loads
+ * chunks by itself), then kicks the GPU kernels.
+ */
+#define GPUSCAN_FEEDER_NSLOTS_PER_WORKER	2
+#define GPUSCAN_FEEDER_MAX_LENGTH			(1UL << 30)	/* 1GB */
+#define GPUSCAN_FEEDER_SLOT__FREE			0
+#define GPUSCAN_FEEDER_SLOT__BUSY			1
+#define GPUSCAN_FEEDER_SLOT__READY			2
+
 typedef struct {
 	dsm_handle		ss_handle;		/* DSM handle of the SharedState */
 	cl_uint			ss_length;		/* Length of the SharedState */
 	GpuScanRuntimeStat gs_rtstat;
+	/* parallel feeder mode */
+	slock_t			feeder_lock;
+	ConditionVariable feeder_cond;
+	cl_bool			feeder_abort;	/* leader no longer needs chunks */
+	cl_int			feeder_nactive;	/* number of running feeders */
+	cl_int			feeder_nslots;	/* number of slots, or 0 if not used */
+	size_t			feeder_slot_sz;	/* length of a slot */
+	cl_char			feeder_status[FLEXIBLE_ARRAY_MEMBER];
 } GpuScanSharedState;
 
+#define GPUSCAN_FEEDER_SLOT(gs_sstate, index)							\
+	((pgstrom_data_store *)												\
+	 ((char *)(gs_sstate) +												\
+	  STROMALIGN(offsetof(GpuScanSharedState,							\
+						  feeder_status[(gs_sstate)->feeder_nslots])) +	\
+	  (gs_sstate)->feeder_slot_sz * (index)))
+
 typedef struct {
 	GpuTaskState	gts;
 	GpuScanSharedState *gs_sstate;
@@ -115,8 +151,23 @@ typedef struct {
 	/* resource for CPU fallback */
 	cl_uint			fallback_group_id;
 	cl_uint			fallback_local_id;
+	cl_uint			recheck_index;
 	TupleTableSlot *base_slot;
 	ProjectionInfo *base_proj;
+	/* selection vector mode for KDS_FORMAT_ARROW */
+	bool			selection_vector_ok;
+	/* results per source item, to size the destination buffer */
+	pg_atomic_uint64 result_nsrcs;
+	pg_atomic_uint64 result_nitems;
+	pg_atomic_uint64 result_extra_sz;
+	/* runtime reordering of the device quals */
+	cl_int			qstat_index;	/* index of kern_gpuscan_qstat, or -1 */
+	pg_atomic_uint64 qstat_nevals;
+	pg_atomic_uint64 qstat_npassed[GPUSCAN_QSTAT_MAX_QUALS];
+	/* parallel feeder mode */
+	cl_int			feeder_nslots;	/* valid only until shutdown */
+	cl_int			feeder_slots_used; /* for EXPLAIN */
+	bool			feeder_scan_done;
 } GpuScanState;
 
 typedef struct
@@ -137,18 +188,20 @@ static GpuTask  *gpuscan_next_task(GpuTaskState *gts);
 static TupleTableSlot *gpuscan_next_tuple(GpuTaskState *gts);
 static void gpuscan_switch_task(GpuTaskState *gts, GpuTask *gtask);
 static int gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module);
+static bool gpuscan_fallback_task(GpuTask *gtask);
 static void gpuscan_release_task(GpuTask *gtask);
 
 static void createGpuScanSharedState(GpuScanState *gss,
 									 ParallelContext *pcxt,
 									 void *dsm_addr);
 static void resetGpuScanSharedState(GpuScanState *gss);
+static void gpuscan_feeder_main(GpuScanState *gss);
 
 /*
  * cost_for_dma_receive - cost estimation for DMA receive (GPU->host)
  */
 Cost
-cost_for_dma_receive(RelOptInfo *rel, double ntuples)
+cost_for_dma_receive(RelOptInfo *rel, double ntuples, int cuda_dindex)
 {
 	PathTarget *reltarget = rel->reltarget;
 	cl_int		nattrs = list_length(reltarget->exprs);
@@ -160,7 +213,7 @@ cost_for_dma_receive(RelOptInfo *rel, double ntuples)
 		MAXALIGN(offsetof(HeapTupleHeaderData,
 						  t_bits[BITMAPLEN(nattrs)])) +
 		MAXALIGN(reltarget->width);
-	return pgstrom_gpu_dma_cost *
+	return pgstromGpuDmaCost(cuda_dindex) *
 		(((double)width_per_tuple * ntuples) / (double)pgstrom_chunk_size());
 }
 
@@ -232,7 +285,8 @@ create_gpuscan_path(PlannerInfo *root,
 						: baserel->rows) / parallel_divisor;
 
 	/* cost for DMA receive (GPU-->host) */
-	run_cost += cost_for_dma_receive(baserel, scan_ntuples);
+	run_cost += cost_for_dma_receive(baserel, scan_ntuples,
+									 gs_info->optimal_gpu);
 
 	/* cost for CPU qualifiers */
 	cost_qual_eval(&qcost, host_quals, root);
@@ -317,6 +371,12 @@ gpuscan_add_scan_path(PlannerInfo *root,
 		if (!baseRelIsArrowFdw(baserel) &&
 			!baseRelIsGstoreFdw(baserel))
 			return;
+		/* virtual partition-key columns are not loaded on the device */
+		if (baseRelHasArrowVirtualRefs(baserel))
+			return;
+		/* primary key lookup is served by the host-side hash-index */
+		if (baseRelHasGstorePrimaryKeyLookup(root, baserel))
+			return;
 	}
 	else if (rte->relkind != RELKIND_RELATION &&
 			 rte->relkind != RELKIND_MATVIEW)
@@ -435,13 +495,150 @@ reorder_devqual_clauses(PlannerInfo *root, List *dev_quals, List *dev_costs)
 	return results;
 }
 
+/*
+ * __rename_single_var_label
+ *
+ * It replaces the label of the variable (e.g, KVAR_3) by the position-
+ * independent one (KVAR_0), to make the source of single-variable quals
+ * identical regardless of the column position.
+ */
+static char *
+__rename_single_var_label(const char *expr_code,
+						  const char *var_label, AttrNumber varattno)
+{
+	StringInfoData buf;
+	char		label[NAMEDATALEN];
+	const char *pos;
+	int			len;
+
+	len = snprintf(label, sizeof(label), "%s_%u", var_label, varattno);
+	initStringInfo(&buf);
+	while ((pos = strstr(expr_code, label)) != NULL)
+	{
+		appendBinaryStringInfo(&buf, expr_code, pos - expr_code);
+		if (isdigit(pos[len]))
+			appendBinaryStringInfo(&buf, pos, len);
+		else
+			appendStringInfo(&buf, "%s_0", var_label);
+		expr_code = pos + len;
+	}
+	appendStringInfoString(&buf, expr_code);
+
+	return buf.data;
+}
+
+/*
+ * __codegen_gpuscan_qstat
+ *
+ * It adds a kern_gpuscan_qstat parameter to reorder the qualifiers at
+ * run-time, then returns its index on the kern_parambuf.
+ */
+static int
+__codegen_gpuscan_qstat(codegen_context *context, List *dev_quals_list)
+{
+	kern_gpuscan_qstat *qstat = palloc0(sizeof(kern_gpuscan_qstat));
+	ListCell   *lc;
+	int			i = 0;
+
+	SET_VARSIZE(qstat, sizeof(kern_gpuscan_qstat));
+	qstat->nquals = list_length(dev_quals_list);
+	qstat->sampling = true;
+	foreach (lc, dev_quals_list)
+	{
+		int		devcost = 0;
+
+		if (!pgstrom_device_expression_devcost(context->root,
+											   context->baserel,
+											   lfirst(lc),
+											   &devcost))
+			elog(ERROR, "Bug? not a device executable qualifier: %s",
+				 nodeToString(lfirst(lc)));
+		qstat->order[i] = i;
+		qstat->cost[i] = Max(devcost, 1);
+		i++;
+	}
+	context->used_params = lappend(context->used_params,
+								   makeConst(BYTEAOID,
+											 -1,
+											 InvalidOid,
+											 -1,
+											 PointerGetDatum(qstat),
+											 false,
+											 false));
+	return list_length(context->used_params) - 1;
+}
+
+/*
+ * __codegen_gpuscan_quals_body
+ *
+ * It returns the body of the qualifier evaluation; if @qual_codes is
+ * supplied, the qualifiers are evaluated in the order of kern_gpuscan_qstat.
+ */
+static char *
+__codegen_gpuscan_quals_body(const char *expr_code,
+							 List *qual_codes, int qstat_index)
+{
+	StringInfoData buf;
+	ListCell   *lc;
+	int			i = 0;
+
+	if (qual_codes == NIL)
+		return psprintf("  return %s;\n",
+						!expr_code ? "true" : psprintf("EVAL(%s)", expr_code));
+
+	initStringInfo(&buf);
+	appendStringInfo(
+		&buf,
+		"  {\n"
+		"    kern_gpuscan_qstat *qstat = (kern_gpuscan_qstat *)\n"
+		"      kparam_get_value(kcxt->kparams, %d);\n"
+		"    cl_bool result = true;\n"
+		"    cl_bool rv;\n"
+		"    cl_int  i;\n\n"
+		"    for (i=0; i < %d; i++)\n"
+		"    {\n"
+		"      switch (qstat->order[i])\n"
+		"      {\n",
+		qstat_index,
+		list_length(qual_codes));
+	foreach (lc, qual_codes)
+	{
+		appendStringInfo(
+			&buf,
+			"        case %d:\n"
+			"          rv = EVAL(%s);\n"
+			"          break;\n",
+			i++, (char *)lfirst(lc));
+	}
+	appendStringInfoString(
+		&buf,
+		"        default:\n"
+		"          rv = false;\n"
+		"          break;\n"
+		"      }\n"
+		"      if (qstat->sampling)\n"
+		"        gpuscan_qstat_count(qstat, i, rv);\n"
+		"      else if (!rv)\n"
+		"        return false;\n"
+		"      result &= rv;\n"
+		"    }\n"
+		"    return result;\n"
+		"  }\n");
+	return buf.data;
+}
+
 /*
  * Code generator for GpuScan's qualifier
+ *
+ * If @p_qstat_index is supplied, multiple qualifiers may be evaluated in
+ * the order determined at run-time; the index of kern_gpuscan_qstat on
+ * the kern_parambuf is returned, or -1 if not.
  */
 void
 codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
 					  const char *component,
-					  Index scanrelid, List *dev_quals_list)
+					  Index scanrelid, List *dev_quals_list,
+					  cl_int *p_qstat_index)
 {
 	devtype_info   *dtype;
 	StringInfoData	tfunc;
@@ -451,6 +648,9 @@ codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
 	Node		   *dev_quals;
 	Var			   *var;
 	char		   *expr_code = NULL;
+	char		   *body;
+	List		   *qual_codes = NIL;
+	int				qstat_index = -1;
 	ListCell	   *lc;
 
 	initStringInfo(&tfunc);
@@ -462,7 +662,23 @@ codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
 		goto output;
 	/* Let's walk on the device expression tree */
 	dev_quals = (Node *)make_flat_ands_explicit(dev_quals_list);
-	expr_code = pgstrom_codegen_expression(dev_quals, context);
+	pgstrom_codegen_cse_setup(context, list_make1(dev_quals));
+	if (p_qstat_index &&
+		enable_gpuscan_qual_reorder &&
+		list_length(dev_quals_list) > 1 &&
+		list_length(dev_quals_list) <= GPUSCAN_QSTAT_MAX_QUALS)
+	{
+		foreach (lc, dev_quals_list)
+		{
+			char   *qual_code = pgstrom_codegen_expression(lfirst(lc),
+														   context);
+			qual_codes = lappend(qual_codes, qual_code);
+		}
+		qstat_index = __codegen_gpuscan_qstat(context, dev_quals_list);
+	}
+	else
+		expr_code = pgstrom_codegen_expression(dev_quals, context);
+	pgstrom_codegen_cse_setup(context, NIL);
 	/* Const/Param declarations */
 	pgstrom_codegen_param_declarations(&tfunc, context);
 	pgstrom_codegen_param_declarations(&afunc, context);
@@ -488,48 +704,85 @@ codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
 	 * Var declarations - if qualifier uses only one variables (like x > 0),
 	 * the pg_xxxx_vref() service routine is more efficient because it may
 	 * use attcacheoff to skip walking on tuple attributes.
+	 *
+	 * In addition, column index of the variable is delivered by the
+	 * kern_parambuf, and the variable is renamed to the position independent
+	 * label. So, simple qualifiers in the same shape (like int8col > $1)
+	 * share the same CUDA program, regardless of the column position.
 	 */
 	if (list_length(context->used_vars) <= 1)
 	{
 		foreach (lc, context->used_vars)
 		{
-			var = lfirst(lc);
+			Const	   *con;
+			ListCell   *cell;
+			int			pindex;
 
+			var = lfirst(lc);
 			if (var->varattno <= 0)
 				elog(ERROR, "Bug? system column appeared in expression");
 
+			pgstrom_devtype_lookup_and_track(INT4OID, context);
+			con = makeConst(INT4OID,
+							-1,
+							InvalidOid,
+							sizeof(int32),
+							Int32GetDatum(var->varattno - 1),
+							false,
+							true);
+			context->used_params = lappend(context->used_params, con);
+			pindex = list_length(context->used_params) - 1;
+			context->param_refs = bms_add_member(context->param_refs, pindex);
+			if (expr_code)
+				expr_code = __rename_single_var_label(expr_code,
+													  context->var_label,
+													  var->varattno);
+			foreach (cell, qual_codes)
+				lfirst(cell) = __rename_single_var_label(lfirst(cell),
+														 context->var_label,
+														 var->varattno);
 			dtype = pgstrom_devtype_lookup(var->vartype);
+			appendStringInfo(
+				&temp,
+				"  pg_int4_t KPARAM_%u = pg_int4_param(kcxt,%d);\n",
+				pindex, pindex);
 			appendStringInfo(
 				&tfunc,
-				"  pg_%s_t %s_%u;\n\n"
-				"  addr = kern_get_datum_tuple(kds->colmeta,htup,%u);\n"
-				"  pg_datum_ref(kcxt,%s_%u,addr);\n",
-				dtype->type_name,
-				context->var_label, var->varattno,
-				var->varattno - 1,
-				context->var_label, var->varattno);
+				"%s"
+				"  pg_%s_t %s_0;\n\n"
+				"  addr = kern_get_datum_tuple(kds->colmeta,htup,"
+				"KPARAM_%u.value);\n"
+				"  pg_datum_ref(kcxt,%s_0,addr);\n",
+				temp.data,
+				dtype->type_name, context->var_label,
+				pindex,
+				context->var_label);
 			appendStringInfo(
 				&afunc,
-				"  pg_%s_t %s_%u;\n\n"
-				"  pg_datum_ref_arrow(kcxt,%s_%u,kds,%u,row_index);\n",
-				dtype->type_name,
-				context->var_label, var->varattno,
-				context->var_label, var->varattno,
-				var->varattno - 1);
+				"%s"
+				"  pg_%s_t %s_0;\n\n"
+				"  pg_datum_ref_arrow(kcxt,%s_0,kds,"
+				"KPARAM_%u.value,row_index);\n",
+				temp.data,
+				dtype->type_name, context->var_label,
+				context->var_label,
+				pindex);
 			appendStringInfo(
 				&cfunc,
-				"  pg_%s_t %s_%u;\n\n"
-				"  addr = kern_get_datum_column(kds,extra,%u,row_index);\n"
-				"  pg_datum_ref(kcxt,%s_%u,addr);\n",
-				dtype->type_name,
-				context->var_label, var->varattno,
-				var->varattno - 1,
-				context->var_label, var->varattno);
+				"%s"
+				"  pg_%s_t %s_0;\n\n"
+				"  addr = kern_get_datum_column(kds,extra,"
+				"KPARAM_%u.value,row_index);\n"
+				"  pg_datum_ref(kcxt,%s_0,addr);\n",
+				temp.data,
+				dtype->type_name, context->var_label,
+				pindex,
+				context->var_label);
 		}
 	}
 	else
 	{
-		AttrNumber		anum, varattno_max = 0;
+		AttrNumber		anum, varattno_min = 0, varattno_max = 0;
 
 		/* declarations */
 		/* note that no expression including system column reference are*/
@@ -544,17 +797,24 @@ codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
 				"  pg_%s_t %s_%u;\n",
 				dtype->type_name,
 				context->var_label, var->varattno);
+			if (varattno_min == 0 || var->varattno < varattno_min)
+				varattno_min = var->varattno;
 			varattno_max = Max(varattno_max, var->varattno);
 		}
 		appendStringInfoString(&tfunc, temp.data);
 		appendStringInfoString(&afunc, temp.data);
 		appendStringInfoString(&cfunc, temp.data);
 
-		appendStringInfoString(
+		/*
+		 * Deform the tuple from the first referenced attribute; it can skip
+		 * the fixed-width prefix using attcacheoff if tuple has no NULLs.
+		 */
+		appendStringInfo(
 			&tfunc,
 			"  assert(htup != NULL);\n"
-			"  EXTRACT_HEAP_TUPLE_BEGIN(addr,kds,htup);\n");
-		for (anum=1; anum <= varattno_max; anum++)
+			"  EXTRACT_HEAP_TUPLE_BEGIN_AT(addr,kds,htup,%d);\n",
+			varattno_min - 1);
+		for (anum=varattno_min; anum <= varattno_max; anum++)
 		{
 			foreach (lc, context->used_vars)
 			{
@@ -595,6 +855,7 @@ codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
 			"  EXTRACT_HEAP_TUPLE_END();\n");
 	}
 output:
+	body = __codegen_gpuscan_quals_body(expr_code, qual_codes, qstat_index);
 	appendStringInfo(
 		kern,
 		"DEVICE_FUNCTION(cl_bool)\n"
@@ -605,7 +866,7 @@ output:
 		"{\n"
 		"  void *addr __attribute__((unused));\n"
 		"%s%s\n"
-		"  return %s;\n"
+		"%s"
 		"}\n\n"
 		"DEVICE_FUNCTION(cl_bool)\n"
 		"%s_quals_eval_arrow(kern_context *kcxt,\n"
@@ -614,7 +875,7 @@ output:
 		"{\n"
 		"  void *addr __attribute__((unused));\n"
 		"%s%s\n"
-		"  return %s;\n"
+		"%s"
 		"}\n\n"
 		"DEVICE_FUNCTION(cl_bool)\n"
 		"%s_quals_eval_column(kern_context *kcxt,\n"
@@ -624,20 +885,22 @@ output:
 		"{\n"
 		"  void *addr __attribute__((unused));\n"
 		"%s%s\n"
-		"  return %s;\n"
+		"%s"
 		"}\n\n",
 		component,
 		context->decl_temp.data,
 		tfunc.data,
-		!expr_code ? "true" : psprintf("EVAL(%s)", expr_code),
+		body,
 		component,
 		context->decl_temp.data,
 		afunc.data,
-		!expr_code ? "true" : psprintf("EVAL(%s)", expr_code),
+		body,
 		component,
 		context->decl_temp.data,
 		cfunc.data,
-		!expr_code ? "true" : psprintf("EVAL(%s)", expr_code));
+		body);
+	if (p_qstat_index)
+		*p_qstat_index = qstat_index;
 }
 
 /*
@@ -789,15 +1052,23 @@ codegen_gpuscan_projection(StringInfo kern,
 	/*
 	 * step.4 - reference attributes for each
 	 */
-	resetStringInfo(&temp);
-	appendStringInfoString(
-		&temp,
-		"  EXTRACT_HEAP_TUPLE_BEGIN(addr,kds_src,htup);\n");
 	for (i=0; i < tupdesc->natts; i++)
 	{
 		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
 		bool		referenced = false;
 
+		/*
+		 * Deform the tuple from the first referenced attribute; it can skip
+		 * the fixed-width prefix using attcacheoff if tuple has no NULLs.
+		 */
+		if (num_referenced == 0)
+		{
+			resetStringInfo(&temp);
+			appendStringInfo(
+				&temp,
+				"  EXTRACT_HEAP_TUPLE_BEGIN_AT(addr,kds_src,htup,%d);\n", i);
+		}
+
 		dtype = pgstrom_devtype_lookup(attr->atttypid);
 		k = attr->attnum - FirstLowInvalidHeapAttributeNumber;
 
@@ -941,6 +1212,7 @@ codegen_gpuscan_projection(StringInfo kern,
 	 */
 	resetStringInfo(&context->decl_temp);
 	resetStringInfo(&temp);
+	pgstrom_codegen_cse_setup(context, tlist_dev);
 	foreach (lc, tlist_dev)
 	{
 		TargetEntry	   *tle = lfirst(lc);
@@ -975,6 +1247,7 @@ codegen_gpuscan_projection(StringInfo kern,
 		type_oid_list = list_append_unique_oid(type_oid_list,
 											   dtype->type_oid);
 	}
+	pgstrom_codegen_cse_setup(context, NIL);
 	appendStringInfoString(&tbody, temp.data);
 	appendStringInfoString(&abody, temp.data);
 	appendStringInfoString(&cbody, temp.data);
@@ -1340,8 +1613,10 @@ PlanGpuScanPath(PlannerInfo *root,
 	cl_int			proj_tuple_sz = 0;
 	cl_int			proj_extra_sz = 0;
 	cl_int			qual_extra_sz = 0;
+	cl_int			qstat_index = -1;
 	cl_int			i, j;
 	StringInfoData	kern;
+	StringInfoData	kern_define;
 	codegen_context	context;
 
 	/* It should be a base relation */
@@ -1389,7 +1664,7 @@ PlanGpuScanPath(PlannerInfo *root,
 	initStringInfo(&kern);
 	pgstrom_init_codegen_context(&context, root, baserel);
 	codegen_gpuscan_quals(&kern, &context, "gpuscan",
-						  baserel->relid, dev_quals);
+						  baserel->relid, dev_quals, &qstat_index);
 	qual_extra_sz = context.varlena_bufsz;
 	tlist_dev = build_gpuscan_projection(root,
 										 baserel,
@@ -1448,9 +1723,20 @@ PlanGpuScanPath(PlannerInfo *root,
 	gs_info->outer_refs = outer_refs;
 	gs_info->used_params = context.used_params;
 	gs_info->dev_quals = dev_quals;
+	gs_info->qstat_index = qstat_index;
 	gs_info->index_quals = index_quals;
 	form_gpuscan_info(cscan, gs_info);
 
+	/* kick the program builder prior to the first execution */
+	initStringInfo(&kern_define);
+	__assign_gpuscan_session_info(&kern_define, cscan);
+	pgstrom_prebuild_cuda_program(gs_info->optimal_gpu,
+								  gs_info->extra_flags,
+								  gs_info->varlena_bufsz,
+								  gs_info->kern_source,
+								  kern_define.data);
+	pfree(kern_define.data);
+
 	return &cscan->scan.plan;
 }
 
@@ -1490,7 +1776,8 @@ pgstrom_pullup_outer_scan(PlannerInfo *root,
 		if (pgstrom_path_is_gpuscan(outer_path))
 			break;	/* OK, only if GpuScan */
 		if (outer_path->pathtype == T_ForeignScan &&
-			(baseRelIsArrowFdw(outer_path->parent) ||
+			((baseRelIsArrowFdw(outer_path->parent) &&
+			  !baseRelHasArrowVirtualRefs(outer_path->parent)) ||
 			 baseRelIsGstoreFdw(outer_path->parent)))
 			break;	/* OK, only if ArrowFdw or GstoreFdw */
 		if (IsA(outer_path, ProjectionPath))
@@ -1646,10 +1933,8 @@ fixup_varnode_to_origin(Node *node, List *custom_scan_tlist)
  * assign_gpuscan_session_info
  */
 void
-assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts)
+__assign_gpuscan_session_info(StringInfo buf, CustomScan *cscan)
 {
-	CustomScan *cscan = (CustomScan *)gts->css.ss.ps.plan;
-
 	appendStringInfo(
 		buf,
 		"/* GpuScan session info */\n"
@@ -1657,6 +1942,12 @@ assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts)
 		cscan->custom_scan_tlist != NIL ? 1 : 0);
 }
 
+void
+assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts)
+{
+	__assign_gpuscan_session_info(buf, (CustomScan *)gts->css.ss.ps.plan);
+}
+
 /*
  * gpuscan_create_scan_state - allocation of GpuScanState
  */
@@ -1694,6 +1985,7 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 	ListCell	   *lc;
 	StringInfoData	kern_define;
 	ProgramId		program_id;
+	int				i;
 
 	/* gpuscan should not have inner/outer plan right now */
 	Assert(scan_rel != NULL);
@@ -1701,6 +1993,8 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 	Assert(innerPlanState(node) == NULL);
 	
 	/* setup GpuContext for CUDA kernel execution */
+	gs_info->optimal_gpu = RelationChooseOptimalGpu(scan_rel,
+													gs_info->optimal_gpu);
 	gcontext = AllocGpuContext(gs_info->optimal_gpu, false, false);
 	gss->gts.gcontext = gcontext;
 
@@ -1716,11 +2010,20 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 						  &TTSOpsVirtual);
 	ExecAssignScanProjectionInfoWithVarno(&gss->gts.css.ss, INDEX_VAR);
 
+	/*
+	 * @dev_quals for CPU fallback references raw tuples regardless of device
+	 * projection. So, it must be initialized to reference the raw tuples.
+	 */
+	dev_quals_raw = (List *)
+		fixup_varnode_to_origin((Node *)gs_info->dev_quals,
+								cscan->custom_scan_tlist);
+
 	/* setup common GpuTaskState fields */
 	pgstromInitGpuTaskState(&gss->gts,
 							gcontext,
 							GpuTaskKind_GpuScan,
 							gs_info->outer_refs,
+							dev_quals_raw,
 							gs_info->used_params,
 							gs_info->optimal_gpu,
 							gs_info->nrows_per_block,
@@ -1729,17 +2032,10 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 	gss->gts.cb_next_tuple  = gpuscan_next_tuple;
 	gss->gts.cb_switch_task = gpuscan_switch_task;
 	gss->gts.cb_process_task = gpuscan_process_task;
+	gss->gts.cb_fallback_task = gpuscan_fallback_task;
 	gss->gts.cb_release_task = gpuscan_release_task;
 
-	/*
-	 * initialize device qualifiers/projection stuff, for CPU fallback
-	 *
-	 * @dev_quals for CPU fallback references raw tuples regardless of device
-	 * projection. So, it must be initialized to reference the raw tuples.
-	 */
-	dev_quals_raw = (List *)
-		fixup_varnode_to_origin((Node *)gs_info->dev_quals,
-								cscan->custom_scan_tlist);
+	/* initialize device qualifiers/projection stuff, for CPU fallback */
 	gss->dev_quals = ExecInitQual(dev_quals_raw, &gss->gts.css.ss.ps);
 
 	foreach (lc, cscan->custom_scan_tlist)
@@ -1754,6 +2050,14 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 	/* device projection related resource consumption */
 	gss->proj_tuple_sz = gs_info->proj_tuple_sz;
 	gss->proj_extra_sz = gs_info->proj_extra_sz;
+	/* runtime reordering of device quals */
+	gss->qstat_index = gs_info->qstat_index;
+	pg_atomic_init_u64(&gss->qstat_nevals, 0);
+	for (i=0; i < GPUSCAN_QSTAT_MAX_QUALS; i++)
+		pg_atomic_init_u64(&gss->qstat_npassed[i], 0);
+	pg_atomic_init_u64(&gss->result_nsrcs, 0);
+	pg_atomic_init_u64(&gss->result_nitems, 0);
+	pg_atomic_init_u64(&gss->result_extra_sz, 0);
 	/* initialize resource for CPU fallback */
 	gss->base_slot = MakeSingleTupleTableSlot(RelationGetDescr(scan_rel),
 											  &TTSOpsVirtual);
@@ -1762,6 +2066,23 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 											 gss->gts.css.ss.ss_ScanTupleSlot,
 											 &gss->gts.css.ss.ps,
 											 RelationGetDescr(scan_rel));
+	/*
+	 * GPU kernel may return only the index of rows survived, if the rows
+	 * can be fetched from the host-side Arrow buffer as is. It is valid
+	 * only when the projection references the columns, because it is
+	 * executed by CPU on fetch.
+	 */
+	gss->selection_vector_ok = enable_gpuscan_selection_vector;
+	foreach (lc, dev_tlist)
+	{
+		TargetEntry	   *tle = lfirst(lc);
+
+		if (!IsA(tle->expr, Var))
+		{
+			gss->selection_vector_ok = false;
+			break;
+		}
+	}
 	/* init BRIN-index support, if any */
 	pgstromExecInitBrinIndexMap(&gss->gts,
 								gs_info->index_oid,
@@ -1834,6 +2155,21 @@ ExecGpuScan(CustomScanState *node)
 {
 	GpuScanState   *gss = (GpuScanState *) node;
 
+	/*
+	 * In the parallel feeder mode, workers only prepare the chunks for the
+	 * leader, and never return any tuples by themselves.
+	 */
+	if (IsParallelWorker() &&
+		gss->gs_sstate &&
+		gss->gs_sstate->feeder_nslots > 0)
+	{
+		if (!gss->feeder_scan_done)
+		{
+			gpuscan_feeder_main(gss);
+			gss->feeder_scan_done = true;
+		}
+		return NULL;
+	}
 	ActivateGpuContext(gss->gts.gcontext);
 	if (!gss->gs_sstate)
 		createGpuScanSharedState(gss, NULL, NULL);
@@ -1875,6 +2211,47 @@ ExecReScanGpuScan(CustomScanState *node)
 	resetGpuScanSharedState(gss);
 	/* common rescan handling */
 	pgstromRescanGpuTaskState(&gss->gts);
+	gss->feeder_scan_done = false;
+}
+
+/*
+ * gpuscan_feeder_nslots - number of the chunk slots for the parallel feeder
+ * mode, or 0 if not applicable.
+ */
+static int
+gpuscan_feeder_nslots(GpuScanState *gss, ParallelContext *pcxt)
+{
+	if (!enable_gpuscan_parallel_feeder ||
+		pcxt->nworkers == 0 ||
+		!gss->gts.css.ss.ss_currentRelation ||
+		gss->gts.af_state ||
+		gss->gts.gs_state)
+		return 0;
+#if PG_VERSION_NUM >= 110000
+	/* leader must be the GPU executor */
+	if (!parallel_leader_participation)
+		return 0;
+#endif
+	return Max(Min(GPUSCAN_FEEDER_NSLOTS_PER_WORKER * pcxt->nworkers,
+				   GPUSCAN_FEEDER_MAX_LENGTH /
+				   STROMALIGN(pgstrom_chunk_size())), 1);
+}
+
+/*
+ * gpuscan_shared_state_length
+ */
+static size_t
+gpuscan_shared_state_length(int feeder_nslots)
+{
+	size_t		len = MAXALIGN(sizeof(GpuScanSharedState));
+
+	if (feeder_nslots > 0)
+	{
+		len = STROMALIGN(offsetof(GpuScanSharedState,
+								  feeder_status[feeder_nslots]));
+		len += STROMALIGN(pgstrom_chunk_size()) * feeder_nslots;
+	}
+	return len;
 }
 
 /*
@@ -1884,7 +2261,10 @@ static Size
 ExecGpuScanEstimateDSM(CustomScanState *node,
 					   ParallelContext *pcxt)
 {
-	return (MAXALIGN(sizeof(GpuScanSharedState)) +
+	GpuScanState   *gss = (GpuScanState *) node;
+	int				feeder_nslots = gpuscan_feeder_nslots(gss, pcxt);
+
+	return (gpuscan_shared_state_length(feeder_nslots) +
 			pgstromSizeOfBrinIndexMap((GpuTaskState *) node) +
 			pgstromEstimateDSMGpuTaskState((GpuTaskState *)node, pcxt));
 }
@@ -1932,8 +2312,7 @@ ExecGpuScanInitWorker(CustomScanState *node,
 	on_dsm_detach(dsm_find_mapping(gss->gs_sstate->ss_handle),
 				  SynchronizeGpuContextOnDSMDetach,
 				  PointerGetDatum(gss->gts.gcontext));
-	coordinate = ((char *)coordinate +
-				  MAXALIGN(sizeof(GpuScanSharedState)));
+	coordinate = ((char *)coordinate + gss->gs_sstate->ss_length);
 	if (gss->gts.outer_index_state)
 	{
 		gss->gts.outer_index_map = (Bitmapset *)coordinate;
@@ -1947,6 +2326,16 @@ static void
 ExecGpuScanReInitializeDSM(CustomScanState *node,
 						   ParallelContext *pcxt, void *coordinate)
 {
+	GpuScanSharedState *gs_sstate = ((GpuScanState *) node)->gs_sstate;
+
+	/* all the chunk slots become free again */
+	if (gs_sstate->feeder_nslots > 0)
+	{
+		gs_sstate->feeder_abort = false;
+		gs_sstate->feeder_nactive = 0;
+		memset(gs_sstate->feeder_status, GPUSCAN_FEEDER_SLOT__FREE,
+			   sizeof(cl_char) * gs_sstate->feeder_nslots);
+	}
 	pgstromReInitializeDSMGpuTaskState((GpuTaskState *) node);
 }
 
@@ -1957,6 +2346,9 @@ ExecShutdownGpuScan(CustomScanState *node)
 	GpuScanRuntimeStat *gs_rtstat_old = gss->gs_rtstat;
 	GpuScanRuntimeStat *gs_rtstat_new;
 
+	/* tasks not launched yet shall not occupy GPU (e.g, LIMIT satisfied) */
+	pgstromSuspendGpuTaskState(&gss->gts);
+
 	/*
 	 * Note that GpuScan may not be executed if GpuScan node is located
 	 * under the GpuJoin at parallel background worker context, because
@@ -1970,6 +2362,18 @@ ExecShutdownGpuScan(CustomScanState *node)
 	if (!gs_rtstat_old)
 		return;
 
+	/* feeders waiting for free slots shall exit */
+	if (!IsParallelWorker() && gss->feeder_nslots > 0)
+	{
+		GpuScanSharedState *gs_sstate = gss->gs_sstate;
+
+		SpinLockAcquire(&gs_sstate->feeder_lock);
+		gs_sstate->feeder_abort = true;
+		SpinLockRelease(&gs_sstate->feeder_lock);
+		ConditionVariableBroadcast(&gs_sstate->feeder_cond);
+		gss->feeder_nslots = 0;
+	}
+
 	if (IsParallelWorker())
 		mergeGpuTaskRuntimeStatParallelWorker(&gss->gts, &gs_rtstat_old->c);
 	else
@@ -2044,6 +2448,10 @@ ExplainGpuScan(CustomScanState *node, List *ancestors, ExplainState *es)
 	}
 	/* BRIN-index properties */
 	pgstromExplainBrinIndexMap(&gss->gts, es, dcontext);
+	/* parallel feeder mode */
+	if (gss->feeder_slots_used > 0)
+		ExplainPropertyInteger("Parallel Feeder Slots", NULL,
+							   gss->feeder_slots_used, es);
 	/* common portion of EXPLAIN */
 	pgstromExplainGpuTaskState(&gss->gts, es);
 }
@@ -2059,19 +2467,30 @@ createGpuScanSharedState(GpuScanState *gss,
 	EState	   *estate = gss->gts.css.ss.ps.state;
 	GpuScanSharedState *gs_sstate;
 	GpuScanRuntimeStat *gs_rtstat;
-	size_t		ss_length = MAXALIGN(sizeof(GpuScanSharedState));
+	int			feeder_nslots = (pcxt ? gpuscan_feeder_nslots(gss, pcxt) : 0);
+	size_t		ss_length = gpuscan_shared_state_length(feeder_nslots);
 
 	if (dsm_addr)
 		gs_sstate = dsm_addr;
 	else
 		gs_sstate = MemoryContextAlloc(estate->es_query_cxt, ss_length);
-	memset(gs_sstate, 0, ss_length);
+	/* chunk slots are initialized by the feeders on demand */
+	memset(gs_sstate, 0, offsetof(GpuScanSharedState,
+								  feeder_status[feeder_nslots]));
 	gs_sstate->ss_handle = (pcxt ? dsm_segment_handle(pcxt->seg) : UINT_MAX);
 	gs_sstate->ss_length = ss_length;
 
 	gs_rtstat = &gs_sstate->gs_rtstat;
 	SpinLockInit(&gs_rtstat->c.lock);
 
+	SpinLockInit(&gs_sstate->feeder_lock);
+	ConditionVariableInit(&gs_sstate->feeder_cond);
+	gs_sstate->feeder_nslots = feeder_nslots;
+	gs_sstate->feeder_slot_sz = STROMALIGN(pgstrom_chunk_size());
+	gss->feeder_nslots = feeder_nslots;
+	gss->feeder_slots_used = feeder_nslots;
+	gss->feeder_scan_done = false;
+
 	gss->gs_sstate = gs_sstate;
 	gss->gs_rtstat = gs_rtstat;
 }
@@ -2085,6 +2504,96 @@ resetGpuScanSharedState(GpuScanState *gss)
 	/* do nothing */
 }
 
+/*
+ * gpuscan_qstat_reorder
+ *
+ * Once GPU kernels have sampled sufficient number of rows, it chooses the
+ * order of the device qualifiers; the one with the least cost per rows to
+ * be filtered out is evaluated first. The order is delivered to the tasks
+ * created later, using the template of the kern_parambuf.
+ */
+#define GPUSCAN_QSTAT_SAMPLING_NROWS		100000
+
+static void
+gpuscan_qstat_reorder(GpuScanState *gss)
+{
+	kern_gpuscan_qstat *qstat;
+	uint64		nevals;
+	double		rank[GPUSCAN_QSTAT_MAX_QUALS];
+	int			nquals;
+	int			i, j, k;
+
+	if (gss->qstat_index < 0)
+		return;
+	qstat = (kern_gpuscan_qstat *)
+		kparam_get_value(gss->gts.kern_params, gss->qstat_index);
+	if (!qstat || !qstat->sampling)
+		return;
+	nevals = pg_atomic_read_u64(&gss->qstat_nevals);
+	if (nevals < GPUSCAN_QSTAT_SAMPLING_NROWS)
+		return;
+
+	nquals = qstat->nquals;
+	for (i=0; i < nquals; i++)
+	{
+		uint64	npassed = pg_atomic_read_u64(&gss->qstat_npassed[i]);
+		double	nfiltered = (double)(nevals - Min(npassed, nevals));
+
+		/* qualifier which filters out nothing shall be evaluated last */
+		rank[i] = (nfiltered > 0.0
+				   ? (double)qstat->cost[i] * (double)nevals / nfiltered
+				   : DBL_MAX);
+		qstat->order[i] = i;
+	}
+	/* stable sort by the rank */
+	for (i=1; i < nquals; i++)
+	{
+		k = qstat->order[i];
+		for (j=i; j > 0 && rank[qstat->order[j-1]] > rank[k]; j--)
+			qstat->order[j] = qstat->order[j-1];
+		qstat->order[j] = k;
+	}
+	qstat->sampling = false;
+}
+
+/*
+ * gpuscan_result_length
+ *
+ * It estimates length of the destination buffer by the number of rows and
+ * extra usage per source item on the prior chunks, with 25% margin. Device
+ * projection that makes large varlena datum (text, jsonb, numeric, ...) may
+ * overflow pgstrom_chunk_size(), then GPU kernel has to be suspended and
+ * resumed with a new buffer. The length is rounded up to multiple of the
+ * chunk size, because gpu_mmgr.c caches the recently released buffer.
+ */
+static size_t
+gpuscan_result_length(GpuScanState *gss,
+					  pgstrom_data_store *pds_src,
+					  TupleDesc tupdesc)
+{
+	size_t		chunk_sz = pgstrom_chunk_size();
+	uint64		nsrcs = pg_atomic_read_u64(&gss->result_nsrcs);
+	double		ratio;
+	double		nitems;
+	double		extra_sz;
+	double		length;
+
+	if (nsrcs == 0)
+		return chunk_sz;
+	ratio = 1.25 * (double)pds_src->kds.nitems / (double)nsrcs;
+	nitems = ratio * (double)pg_atomic_read_u64(&gss->result_nitems);
+	extra_sz = ratio * (double)pg_atomic_read_u64(&gss->result_extra_sz);
+	length = ((double)KDS_calculateHeadSize(tupdesc) +
+			  (double)LONGALIGN((sizeof(Datum) +
+								 sizeof(char)) * tupdesc->natts) * nitems +
+			  extra_sz);
+	if (length <= (double)chunk_sz)
+		return chunk_sz;
+	if (length >= (double)(4 * chunk_sz))
+		return 4 * chunk_sz;
+	return TYPEALIGN(chunk_sz, (size_t)length);
+}
+
 /*
  * gpuscan_create_task - constructor of GpuScanTask
  */
@@ -2099,6 +2608,8 @@ gpuscan_create_task(GpuScanState *gss,
 	GpuScanTask	   *gscan;
 	cl_int			sm_count = 0;
 	size_t			suspend_sz = 0;
+	size_t			recheck_nrooms = 0;
+	size_t			lookback_nrooms = 0;
 	size_t			result_index_sz = 0;
 	size_t			length;
 	CUdeviceptr		m_deviceptr;
@@ -2106,25 +2617,64 @@ gpuscan_create_task(GpuScanState *gss,
 
 	/*
 	 * A rough estimation for length of the destination buffer. Even though
-	 * pgstrom_chunk_size() is not sufficient for the GpuScan result, we can
-	 * suspend the kernel execution then resume it with new buffer. So, here
-	 * is no problem, and allocation of identical length has another benefit
-	 * because gpu_mmgr.c caches the recently released buffer.
+	 * it is not sufficient for the GpuScan result, we can suspend the kernel
+	 * execution then resume it with new buffer. So, here is no problem.
+	 *
+	 * If KDS_FORMAT_ARROW is already loaded on the host-side, GPU kernel
+	 * returns only the index of rows survived, then CPU fetches the values
+	 * from the source buffer; no need to write back the projected rows.
 	 */
-	pds_dst = PDS_create_slot(gcontext,
-							  scan_tupdesc,
-							  pgstrom_chunk_size());
+	if (gss->selection_vector_ok &&
+		pds_src->kds.format == KDS_FORMAT_ARROW &&
+		pds_src->iovec == NULL)
+		result_index_sz = offsetof(gpuscanResultIndex,
+								   results[pds_src->kds.nitems]);
+	else
+		pds_dst = PDS_create_slot(gcontext,
+								  scan_tupdesc,
+								  gpuscan_result_length(gss, pds_src,
+														scan_tupdesc));
 
 	sm_count = devAttrs[gcontext->cuda_dindex].MULTIPROCESSOR_COUNT;
 	suspend_sz = STROMALIGN(sizeof(gpuscanSuspendContext) *
 							GPUKERNEL_MAX_SM_MULTIPLICITY * sm_count);
 
+	/*
+	 * Tiles for the decoupled look-back. KDS_FORMAT_ROW/ARROW kernels
+	 * process a tile per block_sz rows, and block size is never less
+	 * than the warp size.
+	 */
+	if (pds_src->kds.format == KDS_FORMAT_ROW ||
+		pds_src->kds.format == KDS_FORMAT_ARROW)
+	{
+		cl_int		warp_sz = devAttrs[gcontext->cuda_dindex].WARP_SIZE;
+
+		lookback_nrooms = (pds_src->kds.nitems + warp_sz - 1) / warp_sz;
+	}
+
+	/*
+	 * Buffer for the rows to be rechecked by CPU. Rows which raised
+	 * CpuReCheck error on evaluation of the qualifiers are rechecked by CPU
+	 * individually, instead of the entire chunk. If it overflows, we fall
+	 * back to the entire chunk, so KDS_FORMAT_BLOCK has a rough capacity.
+	 */
+	if (pgstrom_cpu_fallback_enabled)
+	{
+		if (pds_src->kds.format == KDS_FORMAT_ROW ||
+			pds_src->kds.format == KDS_FORMAT_ARROW)
+			recheck_nrooms = pds_src->kds.nitems;
+		else if (pds_src->kds.format == KDS_FORMAT_BLOCK)
+			recheck_nrooms = pds_src->kds.nitems * 32;
+	}
+
 	/*
 	 * allocation of pgstrom_gpuscan
 	 */
 	length = (STROMALIGN(offsetof(GpuScanTask, kern.kparams)) +
 			  STROMALIGN(gss->gts.kern_params->length) +
 			  STROMALIGN(suspend_sz) +
+			  STROMALIGN(sizeof(gpuscanLookbackTile) * lookback_nrooms) +
+			  STROMALIGN(sizeof(gpuscanRecheckItem) * recheck_nrooms) +
 			  STROMALIGN(result_index_sz));
 	rc = gpuMemAllocManaged(gcontext,
 							&m_deviceptr,
@@ -2143,7 +2693,10 @@ gpuscan_create_task(GpuScanState *gss,
 	gscan->pds_src = pds_src;
 	gscan->pds_dst = pds_dst;
 	gscan->kern.suspend_sz = suspend_sz;
+	gscan->kern.nrooms_lookback = lookback_nrooms;
+	gscan->kern.nrooms_recheck = recheck_nrooms;
 	/* kern_parambuf */
+	gpuscan_qstat_reorder(gss);
 	memcpy(KERN_GPUSCAN_PARAMBUF(&gscan->kern),
 		   gss->gts.kern_params,
 		   gss->gts.kern_params->length);
@@ -2157,6 +2710,186 @@ gpuscan_switch_task(GpuTaskState *gts, GpuTask *gtask)
 
 	gss->fallback_group_id = 0;
 	gss->fallback_local_id = 0;
+	gss->recheck_index = 0;
+}
+
+/*
+ * gpuscan_feeder_main - main loop of the feeder worker
+ */
+static void
+gpuscan_feeder_main(GpuScanState *gss)
+{
+	GpuScanSharedState *gs_sstate = gss->gs_sstate;
+	Relation		rel = gss->gts.css.ss.ss_currentRelation;
+	pgstrom_data_store *pds;
+	bool			more_blocks = true;
+	int				index;
+
+	SpinLockAcquire(&gs_sstate->feeder_lock);
+	if (gs_sstate->feeder_abort)
+	{
+		SpinLockRelease(&gs_sstate->feeder_lock);
+		return;
+	}
+	gs_sstate->feeder_nactive++;
+	SpinLockRelease(&gs_sstate->feeder_lock);
+
+	while (more_blocks)
+	{
+		bool	waiting = false;
+
+		/* wait for a free slot */
+		for (;;)
+		{
+			SpinLockAcquire(&gs_sstate->feeder_lock);
+			if (gs_sstate->feeder_abort)
+			{
+				SpinLockRelease(&gs_sstate->feeder_lock);
+				index = -1;
+				break;
+			}
+			for (index=0; index < gs_sstate->feeder_nslots; index++)
+			{
+				if (gs_sstate->feeder_status[index] ==
+					GPUSCAN_FEEDER_SLOT__FREE)
+				{
+					gs_sstate->feeder_status[index] = GPUSCAN_FEEDER_SLOT__BUSY;
+					break;
+				}
+			}
+			SpinLockRelease(&gs_sstate->feeder_lock);
+			if (index < gs_sstate->feeder_nslots)
+				break;
+
+			if (!waiting)
+			{
+				ConditionVariablePrepareToSleep(&gs_sstate->feeder_cond);
+				waiting = true;
+			}
+			else
+				ConditionVariableSleep(&gs_sstate->feeder_cond,
+									   PG_WAIT_EXTENSION);
+		}
+		if (waiting)
+			ConditionVariableCancelSleep();
+		if (index < 0)
+			break;
+
+		/* load the heap blocks onto the slot */
+		pds = GPUSCAN_FEEDER_SLOT(gs_sstate, index);
+		memset(pds, 0, offsetof(pgstrom_data_store, kds));
+		pg_atomic_init_u32(&pds->refcnt, 1);
+		pds->filedesc.rawfd = -1;
+		init_kernel_data_store(&pds->kds,
+							   RelationGetDescr(rel),
+							   STROMALIGN_DOWN(gs_sstate->feeder_slot_sz -
+											   offsetof(pgstrom_data_store,
+														kds)),
+							   KDS_FORMAT_ROW, INT_MAX);
+		more_blocks = pgstromExecScanChunkFeeder(&gss->gts, pds);
+
+		SpinLockAcquire(&gs_sstate->feeder_lock);
+		gs_sstate->feeder_status[index] = (more_blocks && pds->kds.nitems > 0
+										   ? GPUSCAN_FEEDER_SLOT__READY
+										   : GPUSCAN_FEEDER_SLOT__FREE);
+		SpinLockRelease(&gs_sstate->feeder_lock);
+		ConditionVariableBroadcast(&gs_sstate->feeder_cond);
+	}
+
+	SpinLockAcquire(&gs_sstate->feeder_lock);
+	Assert(gs_sstate->feeder_nactive > 0);
+	gs_sstate->feeder_nactive--;
+	SpinLockRelease(&gs_sstate->feeder_lock);
+	ConditionVariableBroadcast(&gs_sstate->feeder_cond);
+}
+
+/*
+ * gpuscan_feeder_fetch_chunk
+ *
+ * It picks up a chunk prepared by the feeder workers, or loads a chunk by
+ * the leader itself if no chunks are ready. Once the leader reached to the
+ * end of the relation, it waits for the feeders still running.
+ */
+static pgstrom_data_store *
+gpuscan_feeder_fetch_chunk(GpuScanState *gss)
+{
+	GpuScanSharedState *gs_sstate = gss->gs_sstate;
+	Relation		rel = gss->gts.css.ss.ss_currentRelation;
+	pgstrom_data_store *pds_slot;
+	pgstrom_data_store *pds;
+	kern_data_store *kds;
+	size_t			head_sz;
+	size_t			usage;
+	bool			waiting = false;
+	int				index;
+
+	for (;;)
+	{
+		SpinLockAcquire(&gs_sstate->feeder_lock);
+		for (index=0; index < gs_sstate->feeder_nslots; index++)
+		{
+			if (gs_sstate->feeder_status[index] == GPUSCAN_FEEDER_SLOT__READY)
+			{
+				gs_sstate->feeder_status[index] = GPUSCAN_FEEDER_SLOT__BUSY;
+				break;
+			}
+		}
+		if (index < gs_sstate->feeder_nslots)
+		{
+			SpinLockRelease(&gs_sstate->feeder_lock);
+			break;
+		}
+		if (gss->feeder_scan_done && gs_sstate->feeder_nactive == 0)
+		{
+			SpinLockRelease(&gs_sstate->feeder_lock);
+			if (waiting)
+				ConditionVariableCancelSleep();
+			return NULL;
+		}
+		SpinLockRelease(&gs_sstate->feeder_lock);
+
+		if (!gss->feeder_scan_done)
+		{
+			pds = pgstromExecScanChunk(&gss->gts);
+			if (pds)
+				return pds;
+			gss->feeder_scan_done = true;
+		}
+		else if (!waiting)
+		{
+			ConditionVariablePrepareToSleep(&gs_sstate->feeder_cond);
+			waiting = true;
+		}
+		else
+			ConditionVariableSleep(&gs_sstate->feeder_cond,
+								   PG_WAIT_EXTENSION);
+	}
+	if (waiting)
+		ConditionVariableCancelSleep();
+
+	/*
+	 * Copy the chunk to the managed memory; the KDS_FORMAT_ROW has the
+	 * row-index next to the header and tuples from the tail.
+	 */
+	pds_slot = GPUSCAN_FEEDER_SLOT(gs_sstate, index);
+	kds = &pds_slot->kds;
+	pds = PDS_create_row(gss->gts.gcontext,
+						 RelationGetDescr(rel),
+						 kds->length);
+	Assert(pds->kds.length == kds->length);
+	head_sz = (KERN_DATA_STORE_HEAD_LENGTH(kds) +
+			   STROMALIGN(sizeof(cl_uint) * kds->nitems));
+	usage = __kds_unpack(kds->usage);
+	memcpy(&pds->kds, kds, head_sz);
+	memcpy((char *)&pds->kds + kds->length - usage,
+		   (char *)kds + kds->length - usage, usage);
+
+	SpinLockAcquire(&gs_sstate->feeder_lock);
+	gs_sstate->feeder_status[index] = GPUSCAN_FEEDER_SLOT__FREE;
+	SpinLockRelease(&gs_sstate->feeder_lock);
+	ConditionVariableBroadcast(&gs_sstate->feeder_cond);
+
+	return pds;
 }
 
 /*
@@ -2173,6 +2906,8 @@ gpuscan_next_task(GpuTaskState *gts)
 		pds = ExecScanChunkArrowFdw(gts);
 	else if (gss->gts.gs_state)
 		pds = ExecScanChunkGstoreFdw(gts);
+	else if (gss->feeder_nslots > 0)
+		pds = gpuscan_feeder_fetch_chunk(gss);
 	else
 		pds = pgstromExecScanChunk(gts);
 	if (!pds)
@@ -2184,46 +2919,37 @@ gpuscan_next_task(GpuTaskState *gts)
 
 /*
  * gpuscan_next_tuple_suspended_tuple
+ *
+ * KDS_FORMAT_ROW/ARROW kernels process the tiles in order, so all the rows
+ * since the first tile of the last invocation are not returned yet.
  */
 static bool
 gpuscan_next_tuple_suspended_tuple(GpuScanState *gss, GpuScanTask *gscan)
 {
 	pgstrom_data_store *pds_src = gscan->pds_src;
-	gpuscanSuspendContext *con;
-	cl_uint		window_sz = gscan->kern.block_sz * gscan->kern.grid_sz;
-	cl_uint		group_id;
-	cl_uint		local_id;
-	cl_uint		part_index;
-	size_t		base_index;
+	size_t		base_index = ((size_t)gscan->kern.lookback_base *
+							  (size_t)gscan->kern.block_sz);
+	size_t		row_index;
 
-	while (gss->fallback_group_id < gscan->kern.grid_sz)
+	while ((row_index = base_index +
+			gss->fallback_local_id) < pds_src->kds.nitems)
 	{
-		group_id = gss->fallback_group_id;
-		local_id = gss->fallback_local_id;
-
-		con = KERN_GPUSCAN_SUSPEND_CONTEXT(&gscan->kern, group_id);
-		part_index = con->part_index;
-		Assert(con->line_index == 0);
-
-		base_index = (part_index * window_sz +
-					  group_id * gscan->kern.block_sz);
-		if (base_index >= pds_src->kds.nitems)
+		gss->fallback_local_id++;
+		if (pds_src->kds.format == KDS_FORMAT_ROW)
 		{
-			gss->fallback_group_id++;
-			gss->fallback_local_id = 0;
-			continue;
+			if (KDS_fetch_tuple_row(gss->base_slot,
+									&pds_src->kds,
+									&gss->gts.curr_tuple,
+									row_index))
+				return true;
 		}
-
-		if (++gss->fallback_local_id >= gscan->kern.block_sz)
+		else
 		{
-			con->part_index++;
-			gss->fallback_local_id = 0;
+			if (KDS_fetch_tuple_arrow(gss->base_slot,
+									  &pds_src->kds,
+									  row_index))
+				return true;
 		}
-		if (KDS_fetch_tuple_row(gss->base_slot,
-								&pds_src->kds,
-								&gss->gts.curr_tuple,
-								base_index + local_id))
-			return true;
 	}
 	return false;
 }
@@ -2282,7 +3008,10 @@ gpuscan_next_tuple_suspended_block(GpuScanState *gss, GpuScanTask *gscan)
 			gss->fallback_local_id++;
 
 			lpp = &hpage->pd_linp[line_no];
-			if (ItemIdIsNormal(lpp))
+			if (ItemIdIsNormal(lpp) &&
+				pgstromBlockTupleIsVisible(&gss->gts, hpage,
+										   (HeapTupleHeader)
+										   PageGetItem((Page)hpage, lpp)))
 			{
 				HeapTuple	tuple = &gss->gts.curr_tuple;
 
@@ -2317,8 +3046,56 @@ gpuscan_next_tuple_suspended_block(GpuScanState *gss, GpuScanTask *gscan)
 	return false;
 }
 
+/*
+ * gpuscan_next_tuple_recheck
+ */
+static bool
+gpuscan_next_tuple_recheck(GpuScanState *gss, GpuScanTask *gscan)
+{
+	pgstrom_data_store *pds_src = gscan->pds_src;
+	gpuscanRecheckItem *ritem;
+
+	Assert(gss->recheck_index < gscan->kern.nitems_recheck);
+	ritem = KERN_GPUSCAN_RECHECK_ITEMS(&gscan->kern) + gss->recheck_index++;
+	if (pds_src->kds.format == KDS_FORMAT_ROW)
+		return KDS_fetch_tuple_row(gss->base_slot,
+								   &pds_src->kds,
+								   &gss->gts.curr_tuple,
+								   ritem->row_index);
+	else if (pds_src->kds.format == KDS_FORMAT_ARROW)
+		return KDS_fetch_tuple_arrow(gss->base_slot,
+									 &pds_src->kds,
+									 ritem->row_index);
+	else if (pds_src->kds.format == KDS_FORMAT_BLOCK)
+	{
+		HeapTuple	tuple = &gss->gts.curr_tuple;
+		PageHeader	hpage;
+		ItemId		lpp;
+
+		/* visibility was already checked by the GPU kernel */
+		hpage = KERN_DATA_STORE_BLOCK_PGPAGE(&pds_src->kds,
+											 ritem->row_index);
+		lpp = &hpage->pd_linp[ritem->line_no];
+		Assert(ItemIdIsNormal(lpp));
+		tuple->t_len = ItemIdGetLength(lpp);
+		BlockIdSet(&tuple->t_self.ip_blkid,
+				   KERN_DATA_STORE_BLOCK_BLCKNR(&pds_src->kds,
+												ritem->row_index));
+		tuple->t_self.ip_posid = ritem->line_no + 1;
+		tuple->t_tableOid = pds_src->kds.table_oid;
+		tuple->t_data = (HeapTupleHeader)((char *)hpage +
+										  ItemIdGetOffset(lpp));
+		ExecForceStoreHeapTuple(tuple, gss->base_slot, false);
+		return true;
+	}
+	elog(ERROR, "Bug? unexpected KDS format: %d", pds_src->kds.format);
+}
+
 /*
  * gpuscan_next_tuple_fallback - GPU fallback case
+ *
+ * It rechecks the rows which raised CpuReCheck error on the device first,
+ * then runs the rest of chunk by CPU if the entire chunk falls back.
  */
 static TupleTableSlot *
 gpuscan_next_tuple_fallback(GpuScanState *gss, GpuScanTask *gscan)
@@ -2331,7 +3108,11 @@ gpuscan_next_tuple_fallback(GpuScanState *gss, GpuScanTask *gscan)
 
 retry_next:
 	ExecClearTuple(gss->base_slot);
-	if (!gscan->kern.resume_context)
+	if (gss->recheck_index < gscan->kern.nitems_recheck)
+		status = gpuscan_next_tuple_recheck(gss, gscan);
+	else if (!gscan->task.cpu_fallback)
+		status = false;
+	else if (!gscan->kern.resume_context)
 		status = PDS_fetch_tuple(gss->base_slot, pds_src, &gss->gts);
 	else if (pds_src->kds.format == KDS_FORMAT_ROW ||
 			 pds_src->kds.format == KDS_FORMAT_ARROW)
@@ -2391,7 +3172,7 @@ gpuscan_next_tuple(GpuTaskState *gts)
 		slot = gss->gts.css.ss.ss_ScanTupleSlot;
 		ExecClearTuple(slot);
 		if (!PDS_fetch_tuple(slot, pds_dst, &gss->gts))
-			slot = NULL;
+			slot = gpuscan_next_tuple_fallback(gss, gscan);
 	}
 	else
 	{
@@ -2399,12 +3180,33 @@ gpuscan_next_tuple(GpuTaskState *gts)
 		gpuscanResultIndex *gs_results
 			= KERN_GPUSCAN_RESULT_INDEX(&gscan->kern);
 
-		Assert(pds_src->kds.format == KDS_FORMAT_ROW);
-		if (gss->gts.curr_index < gs_results->nitems)
+		if (gss->gts.curr_index >= gs_results->nitems)
+			slot = gpuscan_next_tuple_fallback(gss, gscan);
+		else if (pds_src->kds.format == KDS_FORMAT_ARROW)
+		{
+			ExprContext *econtext = gss->gts.css.ss.ps.ps_ExprContext;
+			cl_uint		row_index;
+
+			/* selection vector; fetch the values from the Arrow buffer */
+			row_index = gs_results->results[gss->gts.curr_index++];
+			ExecClearTuple(gss->base_slot);
+			if (!KDS_fetch_tuple_arrow(gss->base_slot,
+									   &pds_src->kds,
+									   row_index))
+				elog(ERROR, "Bug? GpuScan returned out of range row-index");
+			ResetExprContext(econtext);
+			econtext->ecxt_scantuple = gss->base_slot;
+			if (!gss->base_proj)
+				slot = gss->base_slot;
+			else
+				slot = ExecProject(gss->base_proj);
+		}
+		else
 		{
 			HeapTuple	tuple = &gss->gts.curr_tuple;
 			cl_uint		kds_offset;
 
+			Assert(pds_src->kds.format == KDS_FORMAT_ROW);
 			kds_offset = gs_results->results[gss->gts.curr_index++];
 			tuple->t_data = KDS_ROW_REF_HTUP(&pds_src->kds,
 											 kds_offset,
@@ -2458,6 +3260,7 @@ gpuscan_throw_partial_result(GpuScanTask *gscan, pgstrom_data_store *pds_dst)
 	dlist_push_tail(&gts->ready_tasks,
 					&gresp->task.chain);
 	gts->num_ready_tasks++;
+	gts->num_result_overflow++;
 	pthreadMutexUnlock(&gcontext->worker_mutex);
 
 	SetLatch(MyLatch);
@@ -2471,8 +3274,10 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 {
 	GpuContext	   *gcontext = GpuWorkerCurrentContext;
 	GpuScanTask	   *gscan = (GpuScanTask *) gtask;
+	GpuScanState   *gss = (GpuScanState *) gscan->task.gts;
 	pgstrom_data_store *pds_src = gscan->pds_src;
 	pgstrom_data_store *pds_dst = gscan->pds_dst;
+	kern_gpuscan_qstat *qstat = NULL;
 	CUfunction		kern_gpuscan_quals;
 	CUdeviceptr		m_gpuscan = (CUdeviceptr)&gscan->kern;
 	CUdeviceptr		m_kds_src = 0UL;
@@ -2482,12 +3287,17 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	const char	   *kern_fname;
 	void		   *kern_args[5];
 	void		   *last_suspend = NULL;
+	cl_uint			last_nitems_recheck = 0;
 	size_t			offset;
 	size_t			length;
 	cl_int			grid_sz;
 	cl_int			block_sz;
 	size_t			nitems_in;
 	size_t			nitems_out;
+	size_t			total_nitems_out = 0;
+	size_t			total_extra_sz = 0;
+	instr_time		tv_start;
+	instr_time		tv_end;
 	CUresult		rc;
 	int				retval = 100001;
 
@@ -2574,7 +3384,7 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	rc = cuMemPrefetchAsync((CUdeviceptr)&gscan->kern,
 							length,
 							CU_DEVICE_PER_THREAD,
-							CU_STREAM_PER_THREAD);
+							CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 
@@ -2588,18 +3398,34 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 		rc = cuMemcpyHtoDAsync(m_kds_src,
 							   &pds_src->kds,
 							   pds_src->kds.length,
-							   CU_STREAM_PER_THREAD);
+							   CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemcpyHtoDAsync: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
+	}
+	else if (!pds_dst && pds_src->kds.format == KDS_FORMAT_ARROW)
+	{
+		/*
+		 * CPU fetches the rows from the source buffer later, so it shall
+		 * be duplicated to the device, not migrated.
+		 */
+		rc = gpuMemPrefetchManaged(gcontext,
+								   m_kds_src,
+								   pds_src->kds.length,
+								   true);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on gpuMemPrefetchManaged: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 	}
 	else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
 	{
 		rc = cuMemPrefetchAsync(m_kds_src,
 								pds_src->kds.length,
 								CU_DEVICE_PER_THREAD,
-								CU_STREAM_PER_THREAD);
+								CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		gpuDeviceCountDMA(gcontext, pds_src->kds.length, 0, 0);
 	}
 
 	/* head of the kds_dst, if any */
@@ -2609,7 +3435,7 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 		rc = cuMemPrefetchAsync((CUdeviceptr)&pds_dst->kds,
 								length,
 								CU_DEVICE_PER_THREAD,
-								CU_STREAM_PER_THREAD);
+								CU_STREAM_PER_WORKER);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 	}
@@ -2627,29 +3453,57 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 							 0, sizeof(cl_int));
 	if (rc != CUDA_SUCCESS)
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	block_sz = pgstrom_tuned_block_size(gscan->task.program_id,
+										kern_fname,
+										gcontext->cuda_dindex,
+										block_sz);
 	gscan->kern.grid_sz = grid_sz;
 	gscan->kern.block_sz = block_sz;
+	if (gss->qstat_index >= 0)
+		qstat = (kern_gpuscan_qstat *)
+			kparam_get_value(KERN_GPUSCAN_PARAMBUF(&gscan->kern),
+							 gss->qstat_index);
 resume_kernel:
 	gscan->kern.nitems_in = 0;
 	gscan->kern.nitems_out = 0;
 	gscan->kern.extra_size = 0;
 	gscan->kern.suspend_count = 0;
+	if (gscan->kern.nrooms_lookback > 0)
+	{
+		gscan->kern.lookback_next = gscan->kern.lookback_base;
+		gscan->kern.lookback_suspend = UINT_MAX;
+		gscan->kern.lookback_abort = 0;
+		rc = cuMemsetD32Async((CUdeviceptr)
+							  KERN_GPUSCAN_LOOKBACK_TILES(&gscan->kern),
+							  0,
+							  KERN_GPUSCAN_LOOKBACK_LENGTH(&gscan->kern)
+							  / sizeof(cl_uint),
+							  CU_STREAM_PER_WORKER);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuMemsetD32Async: %s", errorText(rc));
+	}
+	if (qstat && qstat->sampling)
+	{
+		qstat->nevals = 0;
+		memset(qstat->npassed, 0, sizeof(qstat->npassed));
+	}
 	kern_args[0] = &m_gpuscan;
 	kern_args[1] = &m_kds_src;
 	kern_args[2] = &m_kds_extra;
 	kern_args[3] = &m_kds_dst;
 
+	INSTR_TIME_SET_CURRENT(tv_start);
 	rc = cuLaunchKernel(kern_gpuscan_quals,
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
 						sizeof(cl_int) * 1024,
-						CU_STREAM_PER_THREAD,
+						CU_STREAM_PER_WORKER,
 						kern_args,
 						NULL);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuLaunchKernel: %s", errorText(rc));
 
-	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
+	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_WORKER);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuEventRecord: %s", errorText(rc));
 
@@ -2669,17 +3523,63 @@ resume_kernel:
 		   &((kern_gpuscan *)m_gpuscan)->kerror, sizeof(kern_errorbuf));
 	if (gscan->task.kerror.errcode == ERRCODE_STROM_SUCCESS)
 	{
-		GpuScanState	   *gss = (GpuScanState *)gscan->task.gts;
 		GpuScanRuntimeStat *gs_rtstat = gss->gs_rtstat;
 
+		/* throughput of the block size, for the runtime tuning */
+		if (!last_suspend && gscan->kern.suspend_count == 0)
+		{
+			INSTR_TIME_SET_CURRENT(tv_end);
+			INSTR_TIME_SUBTRACT(tv_end, tv_start);
+			pgstrom_tuned_block_size_feedback(gscan->task.program_id,
+											  kern_fname,
+											  gcontext->cuda_dindex,
+											  block_sz,
+											  nitems_in,
+											  INSTR_TIME_GET_MICROSEC(tv_end));
+		}
+
+		/* selectivity of the device quals, for the runtime reordering */
+		if (qstat && qstat->sampling)
+		{
+			cl_uint		i;
+
+			pg_atomic_add_fetch_u64(&gss->qstat_nevals, qstat->nevals);
+			for (i=0; i < qstat->nquals; i++)
+				pg_atomic_add_fetch_u64(&gss->qstat_npassed[i],
+										qstat->npassed[i]);
+		}
+
 		/* update stat */
 		pg_atomic_add_fetch_u64(&gs_rtstat->c.source_nitems,
 								nitems_in);
 		pg_atomic_add_fetch_u64(&gs_rtstat->c.nitems_filtered,
 								nitems_in - nitems_out);
+		/*
+		 * Rows to be rechecked by CPU must be loaded on the host-side,
+		 * even if NVMe-Strom mode.
+		 */
+		if (gscan->kern.nitems_recheck > 0)
+		{
+			if (pds_src->kds.format == KDS_FORMAT_BLOCK &&
+				pds_src->nblocks_uncached > 0)
+			{
+				rc = cuMemcpyDtoH(&pds_src->kds,
+								  m_kds_src,
+								  pds_src->kds.length);
+				if (rc != CUDA_SUCCESS)
+					werror("failed on cuMemcpyDtoH: %s", errorText(rc));
+				gpuDeviceCountDMA(gcontext, 0, pds_src->kds.length, 0);
+				pds_src->nblocks_uncached = 0;
+			}
+			else if (pds_src->kds.format == KDS_FORMAT_ARROW &&
+					 pds_src->iovec != NULL)
+			{
+				gscan->pds_src = PDS_writeback_arrow(pds_src, m_kds_src);
+			}
+		}
 		if (!pds_dst)
 		{
-			/* may not use this code path no longer */
+			/* selection vector mode */
 			Assert(gscan->kern.extra_size == 0);
 
 			rc = cuMemPrefetchAsync((CUdeviceptr)
@@ -2687,7 +3587,7 @@ resume_kernel:
 									offsetof(gpuscanResultIndex,
 											 results[nitems_out]),
 									CU_DEVICE_CPU,
-									CU_STREAM_PER_THREAD);
+									CU_STREAM_PER_WORKER);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 		}
@@ -2697,7 +3597,7 @@ resume_kernel:
 			rc = cuMemPrefetchAsync((CUdeviceptr)&pds_dst->kds,
 									length,
 									CU_DEVICE_CPU,
-									CU_STREAM_PER_THREAD);
+									CU_STREAM_PER_WORKER);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 
@@ -2708,7 +3608,7 @@ resume_kernel:
 				rc = cuMemPrefetchAsync((CUdeviceptr)(&pds_dst->kds) + offset,
 										length,
 										CU_DEVICE_CPU,
-										CU_STREAM_PER_THREAD);
+										CU_STREAM_PER_WORKER);
 				if (rc != CUDA_SUCCESS)
 					werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
 			}
@@ -2726,6 +3626,7 @@ resume_kernel:
 			/* reset error status, then resume kernel with new buffer */
 			memset(&gscan->kern.kerror, 0, sizeof(kern_errorbuf));
 			gscan->kern.resume_context = true;
+			gscan->kern.lookback_base = gscan->kern.lookback_suspend;
 			gscan->pds_dst = pds_dst;
 			m_kds_dst = (CUdeviceptr)&pds_dst->kds;
 			/*
@@ -2739,8 +3640,22 @@ resume_kernel:
 				last_suspend = alloca(gscan->kern.suspend_sz);
 			temp = KERN_GPUSCAN_SUSPEND_CONTEXT(&gscan->kern, 0);
 			memcpy(last_suspend, temp, gscan->kern.suspend_sz);
+			last_nitems_recheck = gscan->kern.nitems_recheck;
+			total_nitems_out += nitems_out;
+			total_extra_sz += gscan->kern.extra_size;
 			goto resume_kernel;
 		}
+		else if (pds_dst)
+		{
+			/* results per source item, for the later chunks */
+			pg_atomic_add_fetch_u64(&gss->result_nsrcs,
+									pds_src->kds.nitems);
+			pg_atomic_add_fetch_u64(&gss->result_nitems,
+									total_nitems_out + nitems_out);
+			pg_atomic_add_fetch_u64(&gss->result_extra_sz,
+									total_extra_sz +
+									gscan->kern.extra_size);
+		}
 	}
 	else
 	{
@@ -2761,6 +3676,7 @@ resume_kernel:
 								  pds_src->kds.length);
 				if (rc != CUDA_SUCCESS)
 					werror("failed on cuMemcpyDtoH: %s", errorText(rc));
+				gpuDeviceCountDMA(gcontext, 0, pds_src->kds.length, 0);
 				pds_src->nblocks_uncached = 0;
 			}
 			else if (pds_src->kds.format == KDS_FORMAT_ARROW &&
@@ -2770,6 +3686,11 @@ resume_kernel:
 			}
 			memset(&gscan->task.kerror, 0, sizeof(kern_errorbuf));
 			gscan->task.cpu_fallback = true;
+			/*
+			 * rows to be rechecked on the prior steps are still valid,
+			 * but the rest of chunk shall be rechecked by CPU.
+			 */
+			gscan->kern.nitems_recheck = last_nitems_recheck;
 			/* restore suspend context, if any */
 			gscan->kern.resume_context = (last_suspend != NULL);
 			if (last_suspend)
@@ -2830,6 +3751,29 @@ gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	return retval;
 }
 
+/*
+ * gpuscan_fallback_task - run GpuScanTask by CPU without GPU kernel
+ */
+static bool
+gpuscan_fallback_task(GpuTask *gtask)
+{
+	GpuScanTask	   *gscan = (GpuScanTask *) gtask;
+	pgstrom_data_store *pds_src = gscan->pds_src;
+
+	if (!pgstrom_cpu_fallback_enabled)
+		return false;
+	/* source buffer must be already loaded on the host-side */
+	if ((pds_src->kds.format == KDS_FORMAT_BLOCK &&
+		 pds_src->nblocks_uncached > 0) ||
+		(pds_src->kds.format == KDS_FORMAT_ARROW &&
+		 pds_src->iovec != NULL) ||
+		pds_src->kds.format == KDS_FORMAT_COLUMN)
+		return false;
+	gscan->task.cpu_fallback = true;
+	gscan->kern.resume_context = false;
+	return true;
+}
+
 /*
  * gpuscan_release_task
  */
@@ -2870,6 +3814,33 @@ pgstrom_init_gpuscan(void)
 							 PGC_USERSET,
                              GUC_NOT_IN_SAMPLE,
                              NULL, NULL, NULL);
+	/* pg_strom.gpuscan_parallel_feeder */
+	DefineCustomBoolVariable("pg_strom.gpuscan_parallel_feeder",
+							 "Parallel workers of GpuScan only load chunks for the GPU executor of the leader",
+							 NULL,
+							 &enable_gpuscan_parallel_feeder,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.enable_gpuscan_qual_reorder */
+	DefineCustomBoolVariable("pg_strom.enable_gpuscan_qual_reorder",
+							 "Enables to reorder the device qualifiers of GpuScan by the measured selectivity",
+							 NULL,
+							 &enable_gpuscan_qual_reorder,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.enable_gpuscan_selection_vector */
+	DefineCustomBoolVariable("pg_strom.enable_gpuscan_selection_vector",
+							 "Enables GpuScan on Arrow_Fdw to return only the index of rows survived",
+							 NULL,
+							 &enable_gpuscan_selection_vector,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 
 	/* setup path methods */
 	memset(&gpuscan_path_methods, 0, sizeof(gpuscan_path_methods));
@@ -0,0 +1,1803 @@
+/*
+ * gpusort.c
+ *
+ * GPU accelerated sorting on top of the bitonic sorting kernels
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+#include "cuda_gpusort.h"
+
+static CustomScanMethods	gpusort_plan_methods;
+static CustomExecMethods	gpusort_exec_methods;
+static bool					enable_gpusort;		/* GUC */
+static int					gpusort_max_memory_kb;	/* GUC */
+
+/*
+ * form/deform interface of private field of CustomScan(GpuSort)
+ */
+typedef struct {
+	cl_int		optimal_gpu;	/* optimal GPU selection, or -1 */
+	char	   *kern_source;	/* source of the CUDA kernel */
+	cl_uint		extra_flags;	/* extra libraries to be included */
+	cl_uint		varlena_bufsz;	/* buffer size of temporary varlena datum */
+	cl_uint		num_chunks;		/* estimated number of chunks */
+	cl_int		bound;			/* number of rows required, or -1 */
+	List	   *used_params;
+	/* sorting keys, delivered from the original Sort */
+	int			numCols;		/* number of sort-key columns */
+	AttrNumber *sortColIdx;		/* attribute numbers on the outer tuple */
+	Oid		   *sortOperators;	/* OIDs of operators to sort them by */
+	Oid		   *collations;		/* OIDs of collations */
+	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
+} GpuSortInfo;
+
+static inline void
+form_gpusort_info(CustomScan *cscan, GpuSortInfo *gsort_info)
+{
+	List	   *privs = NIL;
+	List	   *exprs = NIL;
+	List	   *temp;
+	int			i;
+
+	privs = lappend(privs, makeInteger(gsort_info->optimal_gpu));
+	privs = lappend(privs, makeString(gsort_info->kern_source));
+	privs = lappend(privs, makeInteger(gsort_info->extra_flags));
+	privs = lappend(privs, makeInteger(gsort_info->varlena_bufsz));
+	privs = lappend(privs, makeInteger(gsort_info->num_chunks));
+	privs = lappend(privs, makeInteger(gsort_info->bound));
+	exprs = lappend(exprs, gsort_info->used_params);
+	privs = lappend(privs, makeInteger(gsort_info->numCols));
+	/* sortColIdx */
+	for (temp = NIL, i=0; i < gsort_info->numCols; i++)
+		temp = lappend_int(temp, gsort_info->sortColIdx[i]);
+	privs = lappend(privs, temp);
+	/* sortOperators */
+	for (temp = NIL, i=0; i < gsort_info->numCols; i++)
+		temp = lappend_oid(temp, gsort_info->sortOperators[i]);
+	privs = lappend(privs, temp);
+	/* collations */
+	for (temp = NIL, i=0; i < gsort_info->numCols; i++)
+		temp = lappend_oid(temp, gsort_info->collations[i]);
+	privs = lappend(privs, temp);
+	/* nullsFirst */
+	for (temp = NIL, i=0; i < gsort_info->numCols; i++)
+		temp = lappend_int(temp, gsort_info->nullsFirst[i]);
+	privs = lappend(privs, temp);
+
+	cscan->custom_private = privs;
+	cscan->custom_exprs = exprs;
+}
+
+static inline GpuSortInfo *
+deform_gpusort_info(CustomScan *cscan)
+{
+	GpuSortInfo *gsort_info = palloc0(sizeof(GpuSortInfo));
+	List	   *privs = cscan->custom_private;
+	List	   *exprs = cscan->custom_exprs;
+	List	   *temp;
+	ListCell   *lc;
+	int			pindex = 0;
+	int			eindex = 0;
+	int			i;
+
+	gsort_info->optimal_gpu = intVal(list_nth(privs, pindex++));
+	gsort_info->kern_source = strVal(list_nth(privs, pindex++));
+	gsort_info->extra_flags = intVal(list_nth(privs, pindex++));
+	gsort_info->varlena_bufsz = intVal(list_nth(privs, pindex++));
+	gsort_info->num_chunks = intVal(list_nth(privs, pindex++));
+	gsort_info->bound = intVal(list_nth(privs, pindex++));
+	gsort_info->used_params = list_nth(exprs, eindex++);
+	gsort_info->numCols = intVal(list_nth(privs, pindex++));
+	/* sortColIdx */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gsort_info->numCols);
+	gsort_info->sortColIdx = palloc0(sizeof(AttrNumber) * gsort_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gsort_info->sortColIdx[i++] = lfirst_int(lc);
+	/* sortOperators */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gsort_info->numCols);
+	gsort_info->sortOperators = palloc0(sizeof(Oid) * gsort_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gsort_info->sortOperators[i++] = lfirst_oid(lc);
+	/* collations */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gsort_info->numCols);
+	gsort_info->collations = palloc0(sizeof(Oid) * gsort_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gsort_info->collations[i++] = lfirst_oid(lc);
+	/* nullsFirst */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gsort_info->numCols);
+	gsort_info->nullsFirst = palloc0(sizeof(bool) * gsort_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gsort_info->nullsFirst[i++] = lfirst_int(lc);
+
+	return gsort_info;
+}
+
+/*
+ * GpuSortTask - a chunk of the outer rows to be sorted on GPU
+ */
+typedef struct
+{
+	GpuTask				task;
+	pgstrom_data_store *pds_src;	/* KDS_FORMAT_ROW */
+	cl_int				bound;		/* top-k rows to be returned, or -1 */
+	kern_gpusort		kern;
+} GpuSortTask;
+
+/*
+ * GpuSortState
+ */
+typedef struct
+{
+	GpuTaskState	gts;
+	cl_int			bound;			/* top-k rows to be returned, or -1 */
+	/* sorting keys */
+	int				numCols;
+	SortSupport		ssup_keys;
+	/* chunks already sorted */
+	cl_int			num_chunks;
+	cl_int			max_chunks;
+	GpuSortTask	  **sorted_chunks;
+	Size			chunks_usage;	/* host memory consumed by the chunks */
+	/* sorted runs written out to tuplestores, if any */
+	cl_int			num_runs;
+	cl_int			max_runs;
+	Tuplestorestate **sorted_runs;
+	/* k-way merge of the chunks, or of the runs if merge_runs */
+	bool			merge_runs;
+	cl_int			num_slots;
+	TupleTableSlot **chunk_slots;	/* current tuple of each chunk/run */
+	cl_uint		   *chunk_curpos;	/* current position of each chunk */
+	binaryheap	   *merge_heap;		/* binary-heap for k-way merging */
+	bool			sort_done;		/* true, if all chunks are sorted */
+	bool			merge_ready;	/* true, if merge_heap is built */
+	/* run-time statistics */
+	cl_long			nitems_sorted;
+	cl_long			nitems_bounded;	/* # of rows dropped by the bound */
+	cl_long			num_gpu_chunks;
+	cl_long			num_spilled_chunks;
+} GpuSortState;
+
+/*
+ * static functions
+ */
+static GpuTask *gpusort_next_task(GpuTaskState *gts);
+static int		gpusort_process_task(GpuTask *gtask, CUmodule cuda_module);
+static void		gpusort_release_task(GpuTask *gtask);
+static void		gpusort_spill_chunks(GpuSortState *gss);
+
+/*
+ * cost_gpusort
+ *
+ * cost estimation for GpuSort. Outer rows are split into chunks, then
+ * individual chunks are sorted by the bitonic-sorting kernels; that takes
+ * O(N * Log2(N)^2) comparisons. CPU merges the sorted chunks on output,
+ * using a binary-heap; that takes O(N * Log2(K)) for K chunks.
+ * If GpuSort is bounded by LIMIT, only the top-k rows of individual chunks
+ * are written back to the host, and merge stops on the k-th row.
+ * If the chunks are larger than pg_strom.gpusort_max_memory, they are
+ * written out to temporary files as sorted runs, then merged again.
+ */
+#define LOG2(x)		(log(x) / 0.693147180559945)
+
+static void
+cost_gpusort(Sort *sort,
+			 cl_int bound,
+			 Cost *p_startup_cost,
+			 Cost *p_total_cost,
+			 cl_uint *p_num_chunks)
+{
+	Plan	   *outer_plan = outerPlan(sort);
+	double		ntuples = outer_plan->plan_rows;
+	double		nrows_output;
+	int			nattrs = list_length(outer_plan->targetlist);
+	double		unitsz;
+	double		nrows_per_chunk;
+	double		num_chunks;
+	double		nsteps;
+	double		usage;
+	Cost		startup_cost;
+	Cost		run_cost = 0.0;
+	Cost		cpu_comp_cost = 2.0 * cpu_operator_cost;
+	Cost		gpu_comp_cost = 2.0 * pgstrom_gpu_operator_cost;
+
+	if (ntuples < 2.0)
+		ntuples = 2.0;
+
+	/* number of chunks in row-format */
+	unitsz = (MAXALIGN(offsetof(kern_tupitem, htup) +
+					   MAXALIGN(offsetof(HeapTupleHeaderData, t_bits) +
+								BITMAPLEN(nattrs)) +
+					   MAXALIGN(outer_plan->plan_width)) + sizeof(cl_uint));
+	nrows_per_chunk = ((double)(pgstrom_chunk_size() -
+								KDS_ESTIMATE_HEAD_LENGTH(nattrs)) / unitsz);
+	nrows_per_chunk = Max(Min(nrows_per_chunk, ntuples), 2.0);
+	num_chunks = ceil(ntuples / nrows_per_chunk);
+
+	/* Cost come from the outer-plan, and GPU kernel setup */
+	startup_cost = outer_plan->total_cost + pgstrom_gpu_setup_cost;
+	/* Cost to load the outer rows onto the chunks, and DMA send/recv */
+	startup_cost += cpu_tuple_cost * ntuples;
+	startup_cost += 2.0 * pgstrom_gpu_dma_cost * num_chunks;
+	/* Cost for the bitonic-sorting on GPU */
+	nsteps = LOG2(nrows_per_chunk);
+	startup_cost += (gpu_comp_cost * ntuples *
+					 nsteps * (nsteps + 1.0) / 2.0);
+	/* Cost to compact the top-k rows of the chunks, if bounded */
+	nrows_output = ntuples;
+	if (bound >= 0 && (double) bound < nrows_per_chunk)
+	{
+		startup_cost += cpu_tuple_cost * (double) bound * num_chunks;
+		nrows_output = Min((double) bound, ntuples);
+	}
+	/* Cost for the k-way merge on CPU */
+	if (num_chunks > 1.0)
+		run_cost += cpu_comp_cost * LOG2(num_chunks) * nrows_output;
+	run_cost += cpu_operator_cost * nrows_output;
+	/* Cost to write out and read back the sorted runs, like cost_sort() */
+	if (bound >= 0 && (double) bound < nrows_per_chunk)
+		usage = unitsz * (double) bound * num_chunks;
+	else
+		usage = (double) pgstrom_chunk_size() * num_chunks;
+	if (usage > (double) gpusort_max_memory_kb * 1024.0)
+	{
+		double	npages = ceil(unitsz * nrows_output / BLCKSZ);
+
+		startup_cost += 2.0 * npages * (seq_page_cost * 0.75 +
+										random_page_cost * 0.25);
+		startup_cost += cpu_comp_cost * LOG2(num_chunks) * nrows_output;
+	}
+
+	*p_startup_cost = startup_cost;
+	*p_total_cost = startup_cost + run_cost;
+	*p_num_chunks = (cl_uint) num_chunks;
+}
+
+/*
+ * gpusort_codegen_keycomp
+ *
+ * DEVICE_FUNCTION(cl_int)
+ * gpusort_keycomp(kern_context *kcxt,
+ *                 kern_data_store *kds_src,
+ *                 cl_uint x_index,
+ *                 cl_uint y_index);
+ *
+ * If @keydiff, it generates gpusort_keydiff() instead; that returns index
+ * of the first sorting key which is not equal, or @numCols if all equal.
+ */
+static void
+gpusort_codegen_keycomp(StringInfo kern,
+						codegen_context *context,
+						int numCols,
+						AttrNumber *sortColIdx,
+						Oid *sortOperators,
+						Oid *collations,
+						bool *nullsFirst,
+						List *outer_tlist,
+						bool keydiff)
+{
+	StringInfoData	decl;
+	StringInfoData	body;
+	List		   *type_oid_list = NIL;
+	int				i;
+
+	initStringInfo(&decl);
+	initStringInfo(&body);
+
+	appendStringInfoString(
+		&decl,
+		"  HeapTupleHeaderData *x_htup;\n"
+		"  HeapTupleHeaderData *y_htup;\n"
+		"  void       *addr;\n"
+		"  pg_int4_t   comp;\n");
+	appendStringInfoString(
+		&body,
+		"  assert(kds_src->format == KDS_FORMAT_ROW);\n"
+		"  x_htup = &KERN_DATA_STORE_TUPITEM(kds_src, x_index)->htup;\n"
+		"  y_htup = &KERN_DATA_STORE_TUPITEM(kds_src, y_index)->htup;\n\n");
+
+	for (i=0; i < numCols; i++)
+	{
+		AttrNumber		anum = sortColIdx[i];
+		TargetEntry	   *tle = get_tle_by_resno(outer_tlist, anum);
+		TypeCacheEntry *tcache;
+		Oid				type_oid;
+		devtype_info   *dtype;
+		devfunc_info   *dfunc;
+		devtype_info   *darg1;
+		devtype_info   *darg2;
+		char		   *cast_darg1 = NULL;
+		char		   *cast_darg2 = NULL;
+		char		   *ret_comp;
+		char		   *ret_lt;
+		char		   *ret_gt;
+		bool			is_reverse;
+
+		if (!tle)
+			elog(ERROR, "Bug? resno %d not found on the outer tlist", anum);
+		type_oid = exprType((Node *)tle->expr);
+		dtype = pgstrom_devtype_lookup_and_track(type_oid, context);
+		if (!dtype)
+			elog(ERROR, "Bug? type (%s) is not supported at GPU",
+				 format_type_be(type_oid));
+		dfunc = pgstrom_devfunc_lookup_type_compare(dtype, collations[i]);
+		if (!dfunc)
+			elog(ERROR, "Bug? type (%s) has no device comparison function",
+				 format_type_be(type_oid));
+		pgstrom_devfunc_track(context, dfunc);
+		darg1 = linitial(dfunc->func_args);
+		darg2 = lsecond(dfunc->func_args);
+		if (dtype->type_oid != darg1->type_oid)
+		{
+			if (!pgstrom_devtype_can_relabel(dtype->type_oid,
+											 darg1->type_oid))
+				elog(ERROR, "Bug? no binary compatible cast for %s -> %s",
+					 format_type_be(dtype->type_oid),
+					 format_type_be(darg1->type_oid));
+			cast_darg1 = psprintf("to_%s", darg1->type_name);
+		}
+		if (dtype->type_oid != darg2->type_oid)
+		{
+			if (!pgstrom_devtype_can_relabel(dtype->type_oid,
+											 darg2->type_oid))
+				elog(ERROR, "Bug? no binary compatible cast for %s -> %s",
+					 format_type_be(dtype->type_oid),
+					 format_type_be(darg2->type_oid));
+			cast_darg2 = psprintf("to_%s", darg2->type_name);
+		}
+		/* direction of the sorting */
+		tcache = lookup_type_cache(type_oid, TYPECACHE_GT_OPR);
+		is_reverse = (sortOperators[i] == tcache->gt_opr);
+		if (keydiff)
+		{
+			ret_comp = psprintf("%d", i);
+			ret_lt = psprintf("%d", i);
+			ret_gt = psprintf("%d", i);
+		}
+		else
+		{
+			ret_comp = pstrdup(is_reverse ? "-comp.value" : "comp.value");
+			ret_lt = psprintf("%d", nullsFirst[i] ? -1 : 1);
+			ret_gt = psprintf("%d", nullsFirst[i] ? 1 : -1);
+		}
+
+		appendStringInfo(
+			&body,
+			"  /* sort key comparison on the attribute %d */\n"
+			"  addr = kern_get_datum_tuple(kds_src->colmeta, x_htup, %d);\n"
+			"  pg_datum_ref(kcxt, x_temp.%s_v, addr);\n"
+			"  addr = kern_get_datum_tuple(kds_src->colmeta, y_htup, %d);\n"
+			"  pg_datum_ref(kcxt, y_temp.%s_v, addr);\n"
+			"  if (!x_temp.%s_v.isnull && !y_temp.%s_v.isnull)\n"
+			"  {\n"
+			"    comp = pgfn_%s(kcxt, %s(x_temp.%s_v), %s(y_temp.%s_v));\n"
+			"    if (!comp.isnull && comp.value != 0)\n"
+			"      return %s;\n"
+			"  }\n"
+			"  else if (x_temp.%s_v.isnull && !y_temp.%s_v.isnull)\n"
+			"    return %s;\n"
+			"  else if (!x_temp.%s_v.isnull && y_temp.%s_v.isnull)\n"
+			"    return %s;\n"
+			"\n",
+			anum,
+			anum - 1,
+			dtype->type_name,
+			anum - 1,
+			dtype->type_name,
+			dtype->type_name, dtype->type_name,
+			dfunc->func_devname,
+			cast_darg1 ? cast_darg1 : "", dtype->type_name,
+			cast_darg2 ? cast_darg2 : "", dtype->type_name,
+			ret_comp,
+			dtype->type_name, dtype->type_name,
+			ret_lt,
+			dtype->type_name, dtype->type_name,
+			ret_gt);
+
+		type_oid_list = list_append_unique_oid(type_oid_list,
+											   dtype->type_oid);
+		if (cast_darg1)
+			pfree(cast_darg1);
+		if (cast_darg2)
+			pfree(cast_darg2);
+		pfree(ret_comp);
+		pfree(ret_lt);
+		pfree(ret_gt);
+	}
+	/* declaration of temporary variable */
+	pgstrom_union_type_declarations(&decl, "x_temp", type_oid_list);
+	pgstrom_union_type_declarations(&decl, "y_temp", type_oid_list);
+
+	appendStringInfo(
+		kern,
+		"DEVICE_FUNCTION(cl_int)\n"
+		"%s(kern_context *kcxt,\n"
+		"                kern_data_store *kds_src,\n"
+		"                cl_uint x_index,\n"
+		"                cl_uint y_index)\n"
+		"{\n"
+		"%s\n%s"
+		"  return %d;\n"
+		"}\n\n",
+		keydiff ? "gpusort_keydiff" : "gpusort_keycomp",
+		decl.data, body.data,
+		keydiff ? numCols : 0);
+	pfree(decl.data);
+	pfree(body.data);
+}
+
+/*
+ * pgstrom_gpusort_codegen
+ *
+ * It generates the device functions for sorting the outer rows by the
+ * supplied keys. If @with_keydiff, gpusort_keydiff() is also generated
+ * for the consumers that need to know boundary of the groups of the
+ * sorted rows, like GpuWindowAgg.
+ */
+char *
+pgstrom_gpusort_codegen(codegen_context *context,
+						int numCols,
+						AttrNumber *sortColIdx,
+						Oid *sortOperators,
+						Oid *collations,
+						bool *nullsFirst,
+						List *outer_tlist,
+						bool with_keydiff)
+{
+	StringInfoData	kern;
+
+	initStringInfo(&kern);
+	/*
+	 * GpuSort does not evaluate any qualifiers by itself, because
+	 * the outer plan already filtered out the rows.
+	 */
+	appendStringInfoString(
+		&kern,
+		"DEVICE_FUNCTION(cl_bool)\n"
+		"gpusort_quals_eval(kern_context *kcxt,\n"
+		"                   kern_data_store *kds,\n"
+		"                   cl_uint row_index)\n"
+		"{\n"
+		"  return true;\n"
+		"}\n\n");
+	gpusort_codegen_keycomp(&kern, context,
+							numCols, sortColIdx, sortOperators,
+							collations, nullsFirst,
+							outer_tlist, false);
+	if (with_keydiff)
+		gpusort_codegen_keycomp(&kern, context,
+								numCols, sortColIdx, sortOperators,
+								collations, nullsFirst,
+								outer_tlist, true);
+	return kern.data;
+}
+
+/*
+ * gpusort_compute_bound
+ *
+ * It returns number of rows required by the Limit node, or -1 if unknown
+ * at the plan time.
+ */
+static cl_int
+gpusort_compute_bound(Limit *limit)
+{
+	Const	   *con;
+	int64		count;
+	int64		offset = 0;
+
+#if PG_VERSION_NUM >= 130000
+	/* WITH TIES may return more rows than the LIMIT clause */
+	if (limit->limitOption != LIMIT_OPTION_COUNT)
+		return -1;
+#endif
+	if (!limit->limitCount || !IsA(limit->limitCount, Const))
+		return -1;
+	con = (Const *) limit->limitCount;
+	if (con->constisnull)
+		return -1;
+	count = DatumGetInt64(con->constvalue);
+	if (limit->limitOffset)
+	{
+		if (!IsA(limit->limitOffset, Const))
+			return -1;
+		con = (Const *) limit->limitOffset;
+		if (!con->constisnull)
+			offset = DatumGetInt64(con->constvalue);
+	}
+	if (count < 0 || offset < 0 || count + offset > INT_MAX)
+		return -1;
+	return (cl_int)(count + offset);
+}
+
+/*
+ * pgstrom_gpusort_sortable
+ *
+ * It checks whether the Sort node can be processed by the device sorting,
+ * that is, its outer plan is GPU-aware custom-scan and all the sorting
+ * keys are comparable on the device. @outerColIdx returns attribute
+ * numbers of the sorting keys on the outer tuple.
+ */
+bool
+pgstrom_gpusort_sortable(Sort *sort, AttrNumber *outerColIdx)
+{
+	Plan	   *outer_plan = outerPlan(sort);
+	int			i;
+
+	Assert(IsA(sort, Sort));
+	if (sort->plan.qual != NIL || !outer_plan)
+		return false;
+	if (!pgstrom_plan_is_gpuscan(outer_plan) &&
+		!pgstrom_plan_is_gpujoin(outer_plan) &&
+		!pgstrom_plan_is_gpupreagg(outer_plan))
+	{
+		/*
+		 * Agg node to finalize the partial results of GpuPreAgg is also
+		 * a reasonable candidate, because its number of output rows is
+		 * usually small enough to load the chunks.
+		 */
+		if (!IsA(outer_plan, Agg) ||
+			!outerPlan(outer_plan) ||
+			!pgstrom_plan_is_gpupreagg(outerPlan(outer_plan)))
+			return false;
+	}
+
+	for (i=0; i < sort->numCols; i++)
+	{
+		TargetEntry	   *tle = get_tle_by_resno(sort->plan.targetlist,
+											   sort->sortColIdx[i]);
+		Var			   *var;
+		Oid				type_oid;
+		TypeCacheEntry *tcache;
+		devtype_info   *dtype;
+
+		/*
+		 * Target-entry of Sort plan should be a Var-node that references
+		 * a particular column of the outer plan, even if sorting key
+		 * contains formula.
+		 */
+		if (!tle || !IsA(tle->expr, Var))
+			return false;
+		var = (Var *) tle->expr;
+		if (var->varno != OUTER_VAR || var->varattno <= 0)
+			return false;
+		type_oid = exprType((Node *) var);
+		dtype = pgstrom_devtype_lookup(type_oid);
+		if (!dtype ||
+			!pgstrom_devfunc_lookup_type_compare(dtype, sort->collations[i]))
+			return false;
+		/* sorting operator must be the default one of the data type */
+		tcache = lookup_type_cache(type_oid,
+								   TYPECACHE_LT_OPR | TYPECACHE_GT_OPR);
+		if (sort->sortOperators[i] != tcache->lt_opr &&
+			sort->sortOperators[i] != tcache->gt_opr)
+			return false;
+		outerColIdx[i] = var->varattno;
+	}
+	return true;
+}
+
+/*
+ * pgstrom_try_insert_gpusort
+ *
+ * It replaces a Sort node by GpuSort, if its outer plan is a GPU-aware
+ * custom-scan and all the sorting keys are comparable on the device.
+ * If @limit is not NULL, it is a Limit node just above the Sort; then
+ * GpuSort returns only the top-k rows of each chunk (Top-K pushdown).
+ */
+void
+pgstrom_try_insert_gpusort(PlannedStmt *pstmt, Plan **p_plan, Limit *limit)
+{
+	Sort	   *sort = (Sort *)(*p_plan);
+	Plan	   *outer_plan = outerPlan(sort);
+	CustomScan *cscan;
+	GpuSortInfo	gsort_info;
+	codegen_context context;
+	Cost		startup_cost;
+	Cost		total_cost;
+	cl_uint		num_chunks;
+	cl_int		bound = -1;
+	ListCell   *lc;
+
+	/* nothing to do, if feature is turned off */
+	if (!pgstrom_enabled || !enable_gpusort)
+		return;
+	/* only a simple Sort just above GPU-aware custom-scan */
+	memset(&gsort_info, 0, sizeof(GpuSortInfo));
+	gsort_info.numCols = sort->numCols;
+	gsort_info.sortColIdx = palloc0(sizeof(AttrNumber) * sort->numCols);
+	gsort_info.sortOperators = sort->sortOperators;
+	gsort_info.collations = sort->collations;
+	gsort_info.nullsFirst = sort->nullsFirst;
+	if (!pgstrom_gpusort_sortable(sort, gsort_info.sortColIdx))
+		return;
+	if (limit)
+		bound = gpusort_compute_bound(limit);
+
+	/*
+	 * OK, cost estimation with GpuSort
+	 */
+	cost_gpusort(sort, bound, &startup_cost, &total_cost, &num_chunks);
+	elog(DEBUG1,
+		 "GpuSort (cost=%.2f..%.2f) has%sadvantage to Sort (cost=%.2f..%.2f)",
+		 startup_cost, total_cost,
+		 total_cost >= sort->plan.total_cost ? " no " : " ",
+		 sort->plan.startup_cost, sort->plan.total_cost);
+	if (total_cost >= sort->plan.total_cost)
+		return;
+
+	/*
+	 * OK, GpuSort is enough reasonable to replace the Sort
+	 */
+	cscan = makeNode(CustomScan);
+	cscan->scan.plan.startup_cost = startup_cost;
+	cscan->scan.plan.total_cost = total_cost;
+	cscan->scan.plan.plan_rows = sort->plan.plan_rows;
+	cscan->scan.plan.plan_width = sort->plan.plan_width;
+	cscan->scan.plan.parallel_aware = false;
+	cscan->scan.plan.parallel_safe = sort->plan.parallel_safe;
+	cscan->scan.plan.initPlan = sort->plan.initPlan;
+	cscan->scan.plan.extParam = bms_copy(sort->plan.extParam);
+	cscan->scan.plan.allParam = bms_copy(sort->plan.allParam);
+	cscan->scan.scanrelid = 0;
+	cscan->flags = 0;
+	cscan->custom_relids = NULL;
+	cscan->methods = &gpusort_plan_methods;
+	foreach (lc, sort->plan.targetlist)
+	{
+		TargetEntry	   *tle = copyObject(lfirst(lc));
+		Var			   *var = (Var *) tle->expr;
+
+		if (!IsA(var, Var) || var->varno != OUTER_VAR)
+			elog(ERROR, "Bug? Sort has unexpected target-entry: %s",
+				 nodeToString(tle));
+		var->varno = INDEX_VAR;
+		cscan->scan.plan.targetlist =
+			lappend(cscan->scan.plan.targetlist, tle);
+	}
+	foreach (lc, outer_plan->targetlist)
+	{
+		TargetEntry	   *tle = lfirst(lc);
+		Var			   *var;
+
+		var = makeVar(OUTER_VAR,
+					  tle->resno,
+					  exprType((Node *) tle->expr),
+					  exprTypmod((Node *) tle->expr),
+					  exprCollation((Node *) tle->expr),
+					  0);
+		cscan->custom_scan_tlist =
+			lappend(cscan->custom_scan_tlist,
+					makeTargetEntry((Expr *) var,
+									tle->resno,
+									tle->resname ? pstrdup(tle->resname) : NULL,
+									false));
+	}
+	outerPlan(cscan) = outer_plan;
+
+	pgstrom_init_codegen_context(&context, NULL, NULL);
+	gsort_info.optimal_gpu = -1;
+	gsort_info.kern_source = pgstrom_gpusort_codegen(&context,
+													 gsort_info.numCols,
+													 gsort_info.sortColIdx,
+													 gsort_info.sortOperators,
+													 gsort_info.collations,
+													 gsort_info.nullsFirst,
+													 outer_plan->targetlist,
+													 false);
+	gsort_info.extra_flags = (context.extra_flags |
+							  DEVKERNEL_NEEDS_GPUSORT);
+	gsort_info.varlena_bufsz = context.varlena_bufsz;
+	gsort_info.num_chunks = num_chunks;
+	gsort_info.bound = bound;
+	gsort_info.used_params = context.used_params;
+	form_gpusort_info(cscan, &gsort_info);
+
+	*p_plan = &cscan->scan.plan;
+}
+
+/*
+ * pgstrom_plan_is_gpusort
+ */
+bool
+pgstrom_plan_is_gpusort(const Plan *plan)
+{
+	if (IsA(plan, CustomScan) &&
+		((CustomScan *) plan)->methods == &gpusort_plan_methods)
+		return true;
+	return false;
+}
+
+/*
+ * pgstrom_planstate_is_gpusort
+ */
+bool
+pgstrom_planstate_is_gpusort(const PlanState *ps)
+{
+	if (IsA(ps, CustomScanState) &&
+		((CustomScanState *) ps)->methods == &gpusort_exec_methods)
+		return true;
+	return false;
+}
+
+/*
+ * gpusort_create_scan_state - allocation of GpuSortState
+ */
+static Node *
+gpusort_create_scan_state(CustomScan *cscan)
+{
+	GpuSortState   *gss = MemoryContextAllocZero(CurTransactionContext,
+												 sizeof(GpuSortState));
+	/* Set tag and executor callbacks */
+	NodeSetTag(gss, T_CustomScanState);
+	gss->gts.css.flags = cscan->flags;
+	if (cscan->methods == &gpusort_plan_methods)
+		gss->gts.css.methods = &gpusort_exec_methods;
+	else
+		elog(ERROR, "Bug? unexpected CustomPlanMethods");
+
+	return (Node *) gss;
+}
+
+/*
+ * ExecInitGpuSort
+ */
+static void
+ExecInitGpuSort(CustomScanState *node, EState *estate, int eflags)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+	CustomScan	   *cscan = (CustomScan *) node->ss.ps.plan;
+	GpuSortInfo	   *gsort_info = deform_gpusort_info(cscan);
+	GpuContext	   *gcontext;
+	TupleDesc		scan_tupdesc;
+	bool			explain_only = ((eflags & EXEC_FLAG_EXPLAIN_ONLY) != 0);
+	StringInfoData	kern_define;
+	ProgramId		program_id;
+	int				i;
+
+	Assert(node->ss.ss_currentRelation == NULL);
+	Assert(outerPlan(cscan) != NULL);
+	/* setup GpuContext for CUDA kernel execution */
+	gcontext = AllocGpuContext(gsort_info->optimal_gpu, false, false);
+	gss->gts.gcontext = gcontext;
+
+	/*
+	 * GpuSort returns the tuples on the chunks as is, so scan tuple
+	 * descriptor is identical to the outer plan's one.
+	 */
+	scan_tupdesc = ExecCleanTypeFromTL(cscan->custom_scan_tlist);
+	ExecInitScanTupleSlot(estate, &gss->gts.css.ss, scan_tupdesc,
+						  &TTSOpsVirtual);
+	ExecAssignScanProjectionInfoWithVarno(&gss->gts.css.ss, INDEX_VAR);
+
+	/* setup common GpuTaskState fields */
+	pgstromInitGpuTaskState(&gss->gts,
+							gcontext,
+							GpuTaskKind_GpuSort,
+							NIL,
+							NIL,
+							gsort_info->used_params,
+							gsort_info->optimal_gpu,
+							0,
+							eflags);
+	gss->gts.cb_next_task    = gpusort_next_task;
+	gss->gts.cb_process_task = gpusort_process_task;
+	gss->gts.cb_release_task = gpusort_release_task;
+
+	/*
+	 * GpuSort always materializes the results, so outer plan does not
+	 * need to support backward scan, mark/restore or rewind.
+	 */
+	outerPlanState(gss) = ExecInitNode(outerPlan(cscan), estate,
+									   eflags & ~(EXEC_FLAG_REWIND |
+												  EXEC_FLAG_BACKWARD |
+												  EXEC_FLAG_MARK));
+	/* sorting keys for the k-way merge on CPU */
+	gss->numCols = gsort_info->numCols;
+	gss->ssup_keys = palloc0(sizeof(SortSupportData) * gss->numCols);
+	for (i=0; i < gss->numCols; i++)
+	{
+		SortSupport		ssup = &gss->ssup_keys[i];
+
+		ssup->ssup_cxt = CurrentMemoryContext;
+		ssup->ssup_collation = gsort_info->collations[i];
+		ssup->ssup_nulls_first = gsort_info->nullsFirst[i];
+		ssup->ssup_attno = gsort_info->sortColIdx[i];
+		PrepareSortSupportFromOrderingOp(gsort_info->sortOperators[i], ssup);
+	}
+	gss->bound = gsort_info->bound;
+	gss->max_chunks = Max(gsort_info->num_chunks, 8);
+	gss->sorted_chunks = palloc0(sizeof(GpuSortTask *) * gss->max_chunks);
+
+	/* Get CUDA program and async build if any */
+	initStringInfo(&kern_define);
+	pgstrom_build_session_info(&kern_define,
+							   &gss->gts,
+							   gsort_info->extra_flags);
+	program_id = pgstrom_create_cuda_program(gcontext,
+											 gsort_info->extra_flags,
+											 gsort_info->varlena_bufsz,
+											 gsort_info->kern_source,
+											 kern_define.data,
+											 false,
+											 explain_only);
+	gss->gts.program_id = program_id;
+	pfree(kern_define.data);
+}
+
+/*
+ * gpusort_create_task - constructor of GpuSortTask
+ */
+static GpuTask *
+gpusort_create_task(GpuSortState *gss, pgstrom_data_store *pds_src)
+{
+	GpuContext	   *gcontext = gss->gts.gcontext;
+	GpuSortTask	   *gsort;
+	gpusortResultIndex *kresults;
+	CUdeviceptr		m_deviceptr;
+	CUresult		rc;
+	size_t			length;
+
+	length = (STROMALIGN(offsetof(GpuSortTask, kern.kparams) +
+						 gss->gts.kern_params->length) +
+			  STROMALIGN(offsetof(gpusortResultIndex,
+								  results[pds_src->kds.nitems])));
+	rc = gpuMemAllocManaged(gcontext,
+							&m_deviceptr,
+							length,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	gsort = (GpuSortTask *) m_deviceptr;
+	memset(gsort, 0, offsetof(GpuSortTask, kern.kparams));
+
+	pgstromInitGpuTask(&gss->gts, &gsort->task);
+	gsort->pds_src = pds_src;
+	gsort->bound = gss->bound;
+	gsort->kern.nitems_in = pds_src->kds.nitems;
+	/* kern_parambuf */
+	memcpy(KERN_GPUSORT_PARAMBUF(&gsort->kern),
+		   gss->gts.kern_params,
+		   gss->gts.kern_params->length);
+	/* gpusortResultIndex */
+	kresults = KERN_GPUSORT_RESULT_INDEX(&gsort->kern);
+	kresults->nitems = 0;
+
+	return &gsort->task;
+}
+
+/*
+ * gpusort_next_task
+ *
+ * It loads the rows from the outer plan onto a chunk, then makes
+ * a GpuSortTask to sort them on the device.
+ */
+static GpuTask *
+gpusort_next_task(GpuTaskState *gts)
+{
+	GpuSortState   *gss = (GpuSortState *) gts;
+	PlanState	   *outer_ps = outerPlanState(gss);
+	TupleDesc		tupdesc = planStateResultTupleDesc(outer_ps);
+	pgstrom_data_store *pds = NULL;
+	TupleTableSlot *slot;
+
+	while (true)
+	{
+		if (gts->scan_overflow)
+		{
+			if (gts->scan_overflow == (void *)(~0UL))
+				break;
+			slot = gts->scan_overflow;
+			gts->scan_overflow = NULL;
+		}
+		else
+		{
+			slot = ExecProcNode(outer_ps);
+			if (TupIsNull(slot))
+			{
+				gts->scan_overflow = (void *)(~0UL);
+				break;
+			}
+		}
+
+		/* create a new data-store on demand */
+		if (!pds)
+		{
+			pds = PDS_create_row(gts->gcontext,
+								 tupdesc,
+								 pgstrom_chunk_size());
+		}
+
+		if (!PDS_insert_tuple(pds, slot))
+		{
+			if (pds->kds.nitems == 0)
+				elog(ERROR, "GpuSort: too large tuple for the chunk (%zu)",
+					 (size_t) pds->kds.length);
+			gts->scan_overflow = slot;
+			break;
+		}
+	}
+	if (!pds)
+		return NULL;
+	return gpusort_create_task(gss, pds);
+}
+
+/*
+ * gpusortLaunchBitonicSorting
+ *
+ * It enqueues a series of the bitonic-sorting kernels of @kgpusort on the
+ * CU_STREAM_PER_WORKER; both of @kgpusort and @kds_src must be already
+ * prefetched to the device. Caller has to synchronize the stream.
+ * It is also used by GpuWindowAgg that sorts the rows prior to the window
+ * functions.
+ */
+void
+gpusortLaunchBitonicSorting(CUmodule cuda_module,
+							kern_gpusort *kgpusort,
+							kern_data_store *kds_src)
+{
+	CUfunction		kern_setup;
+	CUfunction		kern_local;
+	CUfunction		kern_step;
+	CUfunction		kern_merge;
+	CUdeviceptr		m_gpusort = (CUdeviceptr)kgpusort;
+	CUdeviceptr		m_kds_src = (CUdeviceptr)kds_src;
+	void		   *kern_args[4];
+	cl_uint			nitems = kds_src->nitems;
+	cl_uint			part_sz = 2 * BITONIC_MAX_LOCAL_SZ;
+	cl_uint			num_parts = (nitems + part_sz - 1) / part_sz;
+	cl_uint			block_size;
+	cl_uint			unit_size;
+	cl_bool			reversing;
+	size_t			work_sz;
+	int				grid_sz;
+	int				block_sz;
+	int				local_sz;
+	int				step_sz;
+	int				min_grid_sz;
+	CUresult		rc;
+
+	/*
+	 * Lookup GPU kernel functions
+	 */
+	rc = cuModuleGetFunction(&kern_setup, cuda_module,
+							 "kern_gpusort_setup_row");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&kern_local, cuda_module,
+							 "kern_gpusort_bitonic_local");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&kern_step, cuda_module,
+							 "kern_gpusort_bitonic_step");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&kern_merge, cuda_module,
+							 "kern_gpusort_bitonic_merge");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpusort_setup_row(kern_gpusort *kgpusort,
+	 *                        kern_data_store *kds_src)
+	 */
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_setup,
+							 CU_DEVICE_PER_THREAD,
+							 0, sizeof(cl_uint));
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	kern_args[0] = &m_gpusort;
+	kern_args[1] = &m_kds_src;
+	rc = cuLaunchKernel(kern_setup,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						sizeof(cl_uint) * block_sz,
+						CU_STREAM_PER_WORKER,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+	/*
+	 * KERNEL_FUNCTION_MAXTHREADS(void)
+	 * kern_gpusort_bitonic_local(kern_gpusort *kgpusort,
+	 *                            kern_data_store *kds_src)
+	 *
+	 * It sorts every partition that has up to (2 * BITONIC_MAX_LOCAL_SZ)
+	 * items on the shared memory.
+	 */
+	rc = gpuOccupancyMaxPotentialBlockSize(&min_grid_sz,
+										   &local_sz,
+										   kern_local,
+										   0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOccupancyMaxPotentialBlockSize: %s",
+			   errorText(rc));
+	local_sz = Min(local_sz, BITONIC_MAX_LOCAL_SZ);
+	rc = cuLaunchKernel(kern_local,
+						num_parts, 1, 1,
+						local_sz, 1, 1,
+						0,
+						CU_STREAM_PER_WORKER,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+	/*
+	 * Inter-partitions bitonic sorting, if chunk has multiple partitions
+	 */
+	rc = gpuOccupancyMaxPotentialBlockSize(&min_grid_sz,
+										   &step_sz,
+										   kern_step,
+										   0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOccupancyMaxPotentialBlockSize: %s",
+			   errorText(rc));
+	for (block_size = 2 * part_sz; block_size / 2 < nitems; block_size *= 2)
+	{
+		for (unit_size = block_size; unit_size > part_sz; unit_size /= 2)
+		{
+			/*
+			 * KERNEL_FUNCTION_MAXTHREADS(void)
+			 * kern_gpusort_bitonic_step(kern_gpusort *kgpusort,
+			 *                           kern_data_store *kds_src,
+			 *                           cl_uint unitsz,
+			 *                           cl_bool reversing)
+			 */
+			reversing = (unit_size == block_size);
+			work_sz = (((nitems + unit_size - 1) / unit_size)
+					   * unit_size / 2);
+			kern_args[2] = &unit_size;
+			kern_args[3] = &reversing;
+			rc = cuLaunchKernel(kern_step,
+								(work_sz + step_sz - 1) / step_sz, 1, 1,
+								step_sz, 1, 1,
+								0,
+								CU_STREAM_PER_WORKER,
+								kern_args,
+								NULL);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuLaunchKernel: %s", errorText(rc));
+		}
+
+		/*
+		 * KERNEL_FUNCTION_MAXTHREADS(void)
+		 * kern_gpusort_bitonic_merge(kern_gpusort *kgpusort,
+		 *                            kern_data_store *kds_src)
+		 */
+		rc = cuLaunchKernel(kern_merge,
+							num_parts, 1, 1,
+							local_sz, 1, 1,
+							0,
+							CU_STREAM_PER_WORKER,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuLaunchKernel: %s", errorText(rc));
+	}
+}
+
+/*
+ * gpusort_process_task
+ */
+static int
+__gpusort_process_task(GpuTask *gtask, CUmodule cuda_module)
+{
+	GpuSortTask	   *gsort = (GpuSortTask *) gtask;
+	pgstrom_data_store *pds_src = gsort->pds_src;
+	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(&gsort->kern);
+	CUdeviceptr		m_gpusort = (CUdeviceptr)&gsort->kern;
+	CUdeviceptr		m_kds_src = (CUdeviceptr)&pds_src->kds;
+	cl_uint			nitems = pds_src->kds.nitems;
+	size_t			length;
+	CUresult		rc;
+
+	/*
+	 * OK, prefetch the chunk and the result index, then enqueue a series
+	 * of the sorting kernels
+	 */
+	length = ((char *)kresults - (char *)&gsort->kern) +
+		offsetof(gpusortResultIndex, results[nitems]);
+	rc = cuMemPrefetchAsync(m_gpusort,
+							length,
+							CU_DEVICE_PER_THREAD,
+							CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	rc = cuMemPrefetchAsync(m_kds_src,
+							pds_src->kds.length,
+							CU_DEVICE_PER_THREAD,
+							CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+
+	gpusortLaunchBitonicSorting(cuda_module, &gsort->kern, &pds_src->kds);
+
+	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuEventRecord: %s", errorText(rc));
+
+	/* Point of synchronization */
+	rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuEventSynchronize: %s", errorText(rc));
+
+	/*
+	 * Check GPU kernel status
+	 */
+	memcpy(&gsort->task.kerror,
+		   &gsort->kern.kerror, sizeof(kern_errorbuf));
+	if (gsort->task.kerror.errcode == ERRCODE_STROM_SUCCESS)
+	{
+		gsort->kern.nitems_out = kresults->nitems;
+		if (gsort->bound >= 0 && gsort->bound < kresults->nitems)
+			gsort->kern.nitems_out = gsort->bound;
+		/* write back the sorted index to the host */
+		rc = cuMemPrefetchAsync((CUdeviceptr) kresults,
+								offsetof(gpusortResultIndex,
+										 results[gsort->kern.nitems_out]),
+								CU_DEVICE_CPU,
+								CU_STREAM_PER_WORKER);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		/*
+		 * Unless GpuSort is bounded, whole the source chunk shall be
+		 * referenced by the backend. Elsewhere, only the top-k rows are
+		 * copied to the host on demand.
+		 */
+		if (gsort->kern.nitems_out == kresults->nitems)
+		{
+			rc = cuMemPrefetchAsync(m_kds_src,
+									pds_src->kds.length,
+									CU_DEVICE_CPU,
+									CU_STREAM_PER_WORKER);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		}
+	}
+	else if (pgstrom_cpu_fallback_enabled &&
+			 (gsort->task.kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
+	{
+		/* chunk shall be sorted by CPU on the backend side */
+		memset(&gsort->task.kerror, 0, sizeof(kern_errorbuf));
+		gsort->task.cpu_fallback = true;
+	}
+	return 0;
+}
+
+static int
+gpusort_process_task(GpuTask *gtask, CUmodule cuda_module)
+{
+	volatile int	retval;
+
+	STROM_TRY();
+	{
+		retval = __gpusort_process_task(gtask, cuda_module);
+	}
+	STROM_CATCH();
+	{
+		STROM_RE_THROW();
+	}
+	STROM_END_TRY();
+
+	return retval;
+}
+
+/*
+ * gpusort_release_task
+ */
+static void
+gpusort_release_task(GpuTask *gtask)
+{
+	GpuSortTask	   *gsort = (GpuSortTask *) gtask;
+	GpuContext	   *gcontext = gtask->gts->gcontext;
+
+	if (gsort->pds_src)
+		PDS_release(gsort->pds_src);
+	gpuMemFree(gcontext, (CUdeviceptr) gsort);
+}
+
+/*
+ * gpusort_compare_slots - compare two tuples by the sorting keys
+ */
+static int
+gpusort_compare_slots(GpuSortState *gss,
+					  TupleTableSlot *x_slot,
+					  TupleTableSlot *y_slot)
+{
+	int		i, comp;
+
+	for (i=0; i < gss->numCols; i++)
+	{
+		SortSupport	ssup = &gss->ssup_keys[i];
+		Datum		x_datum, y_datum;
+		bool		x_isnull, y_isnull;
+
+		x_datum = slot_getattr(x_slot, ssup->ssup_attno, &x_isnull);
+		y_datum = slot_getattr(y_slot, ssup->ssup_attno, &y_isnull);
+		comp = ApplySortComparator(x_datum, x_isnull,
+								   y_datum, y_isnull,
+								   ssup);
+		if (comp != 0)
+			return comp;
+	}
+	return 0;
+}
+
+/*
+ * gpusort_fallback_quicksort - sort a chunk on CPU, if GPU kernel
+ * reported an error with CPU fallback flag.
+ */
+typedef struct
+{
+	GpuSortState   *gss;
+	kern_data_store *kds;
+	TupleTableSlot *x_slot;
+	TupleTableSlot *y_slot;
+} gpusortFallbackArg;
+
+static int
+gpusort_fallback_comp(const void *__x, const void *__y, void *__arg)
+{
+	gpusortFallbackArg *fb_arg = __arg;
+	GpuSortState   *gss = fb_arg->gss;
+	cl_uint			x_index = *((const cl_uint *) __x);
+	cl_uint			y_index = *((const cl_uint *) __y);
+
+	if (!KDS_fetch_tuple_row(fb_arg->x_slot, fb_arg->kds,
+							 &gss->gts.curr_tuple, x_index) ||
+		!KDS_fetch_tuple_row(fb_arg->y_slot, fb_arg->kds,
+							 &gss->gts.curr_tuple, y_index))
+		elog(ERROR, "Bug? GpuSort fallback references out of range");
+	return gpusort_compare_slots(gss, fb_arg->x_slot, fb_arg->y_slot);
+}
+
+static void
+gpusort_fallback_quicksort(GpuSortState *gss, GpuSortTask *gsort)
+{
+	kern_data_store *kds = &gsort->pds_src->kds;
+	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(&gsort->kern);
+	TupleDesc		tupdesc = planStateResultTupleDesc(outerPlanState(gss));
+	gpusortFallbackArg fb_arg;
+	cl_uint			i;
+
+	for (i=0; i < kds->nitems; i++)
+		kresults->results[i] = i;
+	kresults->nitems = kds->nitems;
+
+	fb_arg.gss = gss;
+	fb_arg.kds = kds;
+	fb_arg.x_slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	fb_arg.y_slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	qsort_arg(kresults->results, kresults->nitems, sizeof(cl_uint),
+			  gpusort_fallback_comp, &fb_arg);
+	ExecDropSingleTupleTableSlot(fb_arg.x_slot);
+	ExecDropSingleTupleTableSlot(fb_arg.y_slot);
+	gsort->kern.nitems_out = kresults->nitems;
+	if (gsort->bound >= 0 && gsort->bound < kresults->nitems)
+		gsort->kern.nitems_out = gsort->bound;
+}
+
+/*
+ * gpusort_compact_chunk
+ *
+ * It moves the top-k rows of the bounded chunk to a small data store,
+ * then releases the source chunk, not to keep the rows never returned.
+ */
+static void
+gpusort_compact_chunk(GpuSortState *gss, GpuSortTask *gsort)
+{
+	pgstrom_data_store *pds_src = gsort->pds_src;
+	pgstrom_data_store *pds_dst;
+	kern_data_store *kds_src = &pds_src->kds;
+	kern_data_store *kds_dst;
+	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(&gsort->kern);
+	TupleDesc	tupdesc = planStateResultTupleDesc(outerPlanState(gss));
+	cl_uint		nitems = gsort->kern.nitems_out;
+	cl_uint	   *tup_index;
+	size_t		usage = 0;
+	size_t		length;
+	cl_uint		i;
+
+	Assert(nitems < kresults->nitems);
+	for (i=0; i < nitems; i++)
+	{
+		kern_tupitem   *tupitem
+			= KERN_DATA_STORE_TUPITEM(kds_src, kresults->results[i]);
+		usage += MAXALIGN(offsetof(kern_tupitem, htup) + tupitem->t_len);
+	}
+	length = (KERN_DATA_STORE_HEAD_LENGTH(kds_src) +
+			  STROMALIGN(sizeof(cl_uint) * nitems) +
+			  STROMALIGN(usage));
+	pds_dst = PDS_create_row(gss->gts.gcontext, tupdesc, length);
+	kds_dst = &pds_dst->kds;
+	Assert(KERN_DATA_STORE_HEAD_LENGTH(kds_dst) ==
+		   KERN_DATA_STORE_HEAD_LENGTH(kds_src));
+	tup_index = KERN_DATA_STORE_ROWINDEX(kds_dst);
+	usage = 0;
+	for (i=0; i < nitems; i++)
+	{
+		kern_tupitem   *titem_src
+			= KERN_DATA_STORE_TUPITEM(kds_src, kresults->results[i]);
+		kern_tupitem   *titem_dst;
+		size_t			sz = offsetof(kern_tupitem, htup) + titem_src->t_len;
+
+		usage += MAXALIGN(sz);
+		titem_dst = (kern_tupitem *)((char *)kds_dst + kds_dst->length - usage);
+		memcpy(titem_dst, titem_src, sz);
+		titem_dst->rowid = i;
+		tup_index[i] = __kds_packed((uintptr_t)titem_dst -
+									(uintptr_t)kds_dst);
+		kresults->results[i] = i;
+	}
+	kds_dst->nitems = nitems;
+	kds_dst->usage = __kds_packed(usage);
+	kresults->nitems = nitems;
+
+	gss->nitems_bounded += (kds_src->nitems - nitems);
+	gsort->pds_src = pds_dst;
+	PDS_release(pds_src);
+}
+
+/*
+ * gpusort_exec_sort - run GPU sorting for all the outer chunks
+ */
+static void
+gpusort_exec_sort(GpuSortState *gss)
+{
+	GpuTask	   *gtask;
+
+	while ((gtask = fetch_next_gputask(&gss->gts)) != NULL)
+	{
+		GpuSortTask	   *gsort = (GpuSortTask *) gtask;
+		gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(&gsort->kern);
+
+		if (gtask->cpu_fallback)
+		{
+			gss->gts.num_cpu_fallbacks++;
+			gpusort_fallback_quicksort(gss, gsort);
+		}
+		else
+			gss->num_gpu_chunks++;
+		gss->nitems_sorted += gsort->pds_src->kds.nitems;
+		if (gsort->kern.nitems_out < kresults->nitems)
+			gpusort_compact_chunk(gss, gsort);
+
+		if (gss->num_chunks == gss->max_chunks)
+		{
+			gss->max_chunks *= 2;
+			gss->sorted_chunks = repalloc(gss->sorted_chunks,
+										  sizeof(GpuSortTask *) *
+										  gss->max_chunks);
+		}
+		gss->sorted_chunks[gss->num_chunks++] = gsort;
+		gss->chunks_usage += gsort->pds_src->kds.length;
+		if (gss->chunks_usage > (Size) gpusort_max_memory_kb * 1024)
+			gpusort_spill_chunks(gss);
+	}
+	/* the last chunks also, if any runs were written out */
+	if (gss->num_runs > 0 && gss->num_chunks > 0)
+		gpusort_spill_chunks(gss);
+	gss->merge_runs = (gss->num_runs > 0);
+	gss->sort_done = true;
+}
+
+/*
+ * gpusort_fetch_chunk - fetch the current tuple of the chunk
+ */
+static bool
+gpusort_fetch_chunk(GpuSortState *gss, int chunk_id)
+{
+	GpuSortTask	   *gsort = gss->sorted_chunks[chunk_id];
+	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(&gsort->kern);
+	cl_uint			curpos = gss->chunk_curpos[chunk_id];
+
+	if (curpos >= kresults->nitems)
+		return false;
+	if (!KDS_fetch_tuple_row(gss->chunk_slots[chunk_id],
+							 &gsort->pds_src->kds,
+							 &gss->gts.curr_tuple,
+							 kresults->results[curpos]))
+		elog(ERROR, "Bug? GpuSort result index is out of range");
+	gss->chunk_curpos[chunk_id] = curpos + 1;
+	return true;
+}
+
+/*
+ * gpusort_fetch_source - fetch the next tuple of the chunk or the run
+ */
+static bool
+gpusort_fetch_source(GpuSortState *gss, int source_id)
+{
+	if (gss->merge_runs)
+		return tuplestore_gettupleslot(gss->sorted_runs[source_id],
+									   true, false,
+									   gss->chunk_slots[source_id]);
+	return gpusort_fetch_chunk(gss, source_id);
+}
+
+/*
+ * gpusort_heap_compare - comparator of the binary-heap (max-heap),
+ * so it inverts the result to pick up the smallest tuple first.
+ */
+static int
+gpusort_heap_compare(Datum a, Datum b, void *arg)
+{
+	GpuSortState   *gss = (GpuSortState *) arg;
+	int				x_id = DatumGetInt32(a);
+	int				y_id = DatumGetInt32(b);
+	int				comp;
+
+	comp = gpusort_compare_slots(gss,
+								 gss->chunk_slots[x_id],
+								 gss->chunk_slots[y_id]);
+	return (comp > 0 ? -1 : (comp < 0 ? 1 : 0));
+}
+
+/*
+ * gpusort_setup_merge - setup the k-way merge of the sorted chunks, or
+ * the sorted runs if merge_runs
+ */
+static void
+gpusort_setup_merge(GpuSortState *gss)
+{
+	TupleDesc	tupdesc = planStateResultTupleDesc(outerPlanState(gss));
+	int			nsources = (gss->merge_runs ? gss->num_runs : gss->num_chunks);
+	int			i;
+
+	if (!gss->chunk_slots)
+	{
+		gss->num_slots = nsources;
+		gss->chunk_slots = palloc0(sizeof(TupleTableSlot *) *
+								   Max(nsources, 1));
+		gss->chunk_curpos = palloc0(sizeof(cl_uint) * Max(nsources, 1));
+		for (i=0; i < nsources; i++)
+			gss->chunk_slots[i] = MakeSingleTupleTableSlot(tupdesc,
+								gss->merge_runs ? &TTSOpsMinimalTuple
+												: &TTSOpsVirtual);
+		gss->merge_heap = binaryheap_allocate(Max(nsources, 1),
+											  gpusort_heap_compare,
+											  gss);
+	}
+	Assert(gss->num_slots == nsources);
+	binaryheap_reset(gss->merge_heap);
+	for (i=0; i < nsources; i++)
+	{
+		gss->chunk_curpos[i] = 0;
+		if (gss->merge_runs)
+			tuplestore_rescan(gss->sorted_runs[i]);
+		if (gpusort_fetch_source(gss, i))
+			binaryheap_add_unordered(gss->merge_heap, Int32GetDatum(i));
+	}
+	binaryheap_build(gss->merge_heap);
+	gss->merge_ready = true;
+}
+
+/*
+ * gpusort_merge_advance - move to the next tuple of the source on the top
+ */
+static void
+gpusort_merge_advance(GpuSortState *gss, int source_id)
+{
+	if (gpusort_fetch_source(gss, source_id))
+		binaryheap_replace_first(gss->merge_heap, Int32GetDatum(source_id));
+	else
+		(void) binaryheap_remove_first(gss->merge_heap);
+}
+
+/*
+ * gpusort_release_merge - release the slots and binary-heap of the merge
+ */
+static void
+gpusort_release_merge(GpuSortState *gss)
+{
+	int		i;
+
+	if (gss->chunk_slots)
+	{
+		for (i=0; i < gss->num_slots; i++)
+			ExecDropSingleTupleTableSlot(gss->chunk_slots[i]);
+		pfree(gss->chunk_slots);
+		pfree(gss->chunk_curpos);
+		binaryheap_free(gss->merge_heap);
+		gss->num_slots = 0;
+		gss->chunk_slots = NULL;
+		gss->chunk_curpos = NULL;
+		gss->merge_heap = NULL;
+	}
+	gss->merge_ready = false;
+}
+
+/*
+ * gpusort_spill_chunks
+ *
+ * It merges the sorted chunks into a sorted run on a tuplestore, that is
+ * written out to a temporary file beyond work_mem, then releases the
+ * chunks. The sorted runs are merged on output, like the external merge
+ * of tuplesort.c.
+ */
+static void
+gpusort_spill_chunks(GpuSortState *gss)
+{
+	Tuplestorestate *run;
+	cl_long		count = 0;
+	int			i;
+
+	Assert(!gss->merge_runs);
+	run = tuplestore_begin_heap(false, false, work_mem);
+	gpusort_setup_merge(gss);
+	while (!binaryheap_empty(gss->merge_heap) &&
+		   (gss->bound < 0 || count < gss->bound))
+	{
+		int		chunk_id = DatumGetInt32(binaryheap_first(gss->merge_heap));
+
+		tuplestore_puttupleslot(run, gss->chunk_slots[chunk_id]);
+		gpusort_merge_advance(gss, chunk_id);
+		count++;
+	}
+	gpusort_release_merge(gss);
+	for (i=0; i < gss->num_chunks; i++)
+		gpusort_release_task(&gss->sorted_chunks[i]->task);
+	gss->num_spilled_chunks += gss->num_chunks;
+	gss->num_chunks = 0;
+	gss->chunks_usage = 0;
+
+	if (gss->num_runs == gss->max_runs)
+	{
+		gss->max_runs = Max(2 * gss->max_runs, 8);
+		if (!gss->sorted_runs)
+			gss->sorted_runs = palloc(sizeof(Tuplestorestate *) *
+									  gss->max_runs);
+		else
+			gss->sorted_runs = repalloc(gss->sorted_runs,
+										sizeof(Tuplestorestate *) *
+										gss->max_runs);
+	}
+	gss->sorted_runs[gss->num_runs++] = run;
+}
+
+/*
+ * gpusort_next_tuple
+ */
+static TupleTableSlot *
+gpusort_next_tuple(GpuSortState *gss)
+{
+	TupleTableSlot *scan_slot = gss->gts.css.ss.ss_ScanTupleSlot;
+	TupleTableSlot *slot;
+	int				chunk_id;
+
+	if (!gss->sort_done)
+		gpusort_exec_sort(gss);
+	if (!gss->merge_ready)
+		gpusort_setup_merge(gss);
+	if (binaryheap_empty(gss->merge_heap))
+		return NULL;
+
+	chunk_id = DatumGetInt32(binaryheap_first(gss->merge_heap));
+	slot = gss->chunk_slots[chunk_id];
+	ExecCopySlot(scan_slot, slot);
+	/* move to the next tuple of the chunk */
+	gpusort_merge_advance(gss, chunk_id);
+
+	return scan_slot;
+}
+
+/*
+ * ExecReCheckGpuSort
+ */
+static bool
+ExecReCheckGpuSort(CustomScanState *node, TupleTableSlot *slot)
+{
+	/*
+	 * GpuSort shall be never located under the LockRows, so we don't
+	 * expect that we need to have valid EPQ recheck here.
+	 */
+	return true;
+}
+
+/*
+ * ExecGpuSort
+ */
+static TupleTableSlot *
+ExecGpuSort(CustomScanState *node)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+
+	ActivateGpuContext(gss->gts.gcontext);
+	return ExecScan(&node->ss,
+					(ExecScanAccessMtd) gpusort_next_tuple,
+					(ExecScanRecheckMtd) ExecReCheckGpuSort);
+}
+
+/*
+ * gpusort_cleanup_chunks
+ */
+static void
+gpusort_cleanup_chunks(GpuSortState *gss)
+{
+	int		i;
+
+	gpusort_release_merge(gss);
+	for (i=0; i < gss->num_chunks; i++)
+		gpusort_release_task(&gss->sorted_chunks[i]->task);
+	for (i=0; i < gss->num_runs; i++)
+		tuplestore_end(gss->sorted_runs[i]);
+	gss->num_chunks = 0;
+	gss->chunks_usage = 0;
+	gss->num_runs = 0;
+	gss->num_spilled_chunks = 0;
+	gss->merge_runs = false;
+	gss->sort_done = false;
+}
+
+/*
+ * ExecEndGpuSort
+ */
+static void
+ExecEndGpuSort(CustomScanState *node)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+
+	/* wait for completion of asynchronous GpuTaks */
+	SynchronizeGpuContext(gss->gts.gcontext);
+	/* release the sorted chunks */
+	gpusort_cleanup_chunks(gss);
+	/* clean up subtree */
+	ExecEndNode(outerPlanState(node));
+	pgstromReleaseGpuTaskState(&gss->gts, NULL);
+}
+
+/*
+ * ExecReScanGpuSort
+ */
+static void
+ExecReScanGpuSort(CustomScanState *node)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+	PlanState	   *outer_ps = outerPlanState(node);
+
+	/*
+	 * If outer-plan is not changed, we can rewind the merge of the sorted
+	 * chunks. Elsewhere, we have to forget the previous results then re-sort
+	 * the outer rows again.
+	 */
+	if (gss->sort_done && outer_ps->chgParam == NULL)
+	{
+		gss->merge_ready = false;
+		return;
+	}
+	/* wait for completion of asynchronous GpuTaks */
+	SynchronizeGpuContext(gss->gts.gcontext);
+	gpusort_cleanup_chunks(gss);
+	/* common rescan handling */
+	pgstromRescanGpuTaskState(&gss->gts);
+	gss->gts.scan_done = false;
+	gss->gts.scan_overflow = NULL;
+	if (outer_ps->chgParam == NULL)
+		ExecReScan(outer_ps);
+}
+
+/*
+ * ExplainGpuSort
+ */
+static void
+ExplainGpuSort(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+	CustomScan	   *cscan = (CustomScan *) node->ss.ps.plan;
+	GpuSortInfo	   *gsort_info = deform_gpusort_info(cscan);
+	List		   *dcontext;
+	List		   *sort_keys = NIL;
+	int				i;
+
+	/* Set up deparsing context */
+	dcontext = set_deparse_context_planstate(es->deparse_cxt,
+											 (Node *)&gss->gts.css.ss.ps,
+											 ancestors);
+	/* shows sorting keys */
+	for (i=0; i < gsort_info->numCols; i++)
+	{
+		TargetEntry	   *tle;
+		char		   *exprstr;
+
+		tle = get_tle_by_resno(cscan->custom_scan_tlist,
+							   gsort_info->sortColIdx[i]);
+		if (!tle)
+			elog(ERROR, "no tlist entry for key %d",
+				 gsort_info->sortColIdx[i]);
+		exprstr = deparse_expression((Node *) tle->expr, dcontext,
+									 es->verbose, false);
+		sort_keys = lappend(sort_keys, exprstr);
+	}
+	if (sort_keys != NIL)
+		ExplainPropertyList("Sort Key", sort_keys, es);
+
+	/* run-time statistics, if any */
+	if (es->analyze && gss->sort_done)
+	{
+		ExplainPropertyInteger("Sorted chunks", NULL,
+							   gss->num_chunks + gss->num_spilled_chunks, es);
+		if (gss->num_runs > 0)
+			ExplainPropertyInteger("Sorted runs", NULL,
+								   gss->num_runs, es);
+		ExplainPropertyInteger("Sorted rows", NULL,
+							   gss->nitems_sorted, es);
+		if (gss->bound >= 0)
+			ExplainPropertyInteger("Rows dropped by bound", NULL,
+								   gss->nitems_bounded, es);
+		if (gss->gts.num_cpu_fallbacks > 0)
+			ExplainPropertyInteger("Num of CPU fallback chunks", NULL,
+								   gss->gts.num_cpu_fallbacks, es);
+	}
+	else if (es->verbose)
+		ExplainPropertyInteger("Estimated chunks", NULL,
+							   gsort_info->num_chunks, es);
+	if (gss->bound >= 0)
+		ExplainPropertyInteger("Top-K bound", NULL, gss->bound, es);
+	/* other common fields */
+	pgstromExplainGpuTaskState(&gss->gts, es);
+}
+
+/*
+ * pgstrom_init_gpusort
+ */
+void
+pgstrom_init_gpusort(void)
+{
+	/* pg_strom.enable_gpusort */
+	DefineCustomBoolVariable("pg_strom.enable_gpusort",
+							 "Enables the use of GPU accelerated sorting",
+							 NULL,
+							 &enable_gpusort,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpusort_max_memory */
+	DefineCustomIntVariable("pg_strom.gpusort_max_memory",
+							"Max size of the sorted chunks kept in memory by GpuSort",
+							"Chunks beyond the size are written out to temporary files as sorted runs",
+							&gpusort_max_memory_kb,
+							1048576,	/* 1GB */
+							4096,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	/* setup plan methods */
+	memset(&gpusort_plan_methods, 0, sizeof(gpusort_plan_methods));
+	gpusort_plan_methods.CustomName			= "GpuSort";
+	gpusort_plan_methods.CreateCustomScanState = gpusort_create_scan_state;
+	RegisterCustomScanMethods(&gpusort_plan_methods);
+
+	/* setup exec methods */
+	memset(&gpusort_exec_methods, 0, sizeof(gpusort_exec_methods));
+	gpusort_exec_methods.CustomName         = "GpuSort";
+	gpusort_exec_methods.BeginCustomScan    = ExecInitGpuSort;
+	gpusort_exec_methods.ExecCustomScan     = ExecGpuSort;
+	gpusort_exec_methods.EndCustomScan      = ExecEndGpuSort;
+	gpusort_exec_methods.ReScanCustomScan   = ExecReScanGpuSort;
+	gpusort_exec_methods.ExplainCustomScan  = ExplainGpuSort;
+}
@@ -0,0 +1,2043 @@
+/*
+ * gpuwinagg.c
+ *
+ * GPU accelerated window functions on top of the device sorting
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+#include "cuda_gpusort.h"
+#include "cuda_gpuwinagg.h"
+
+static CustomScanMethods	gpuwinagg_plan_methods;
+static CustomExecMethods	gpuwinagg_exec_methods;
+static bool					enable_gpuwindowagg;	/* GUC */
+
+/*
+ * List of supported window functions
+ */
+typedef struct {
+	const char *func_name;
+	int			func_nargs;
+	Oid			func_argtypes[3];	/* InvalidOid means any type */
+	int			func_kind;			/* one of GPUWINAGG_FUNC__* */
+	int			shift_dir;			/* -1 for lag, +1 for lead */
+} gpuwinagg_catalog_t;
+
+static gpuwinagg_catalog_t	gpuwinagg_catalog[] = {
+	{ "row_number", 0, {},                GPUWINAGG_FUNC__ROW_NUMBER, 0 },
+	{ "rank",       0, {},                GPUWINAGG_FUNC__RANK, 0 },
+	{ "dense_rank", 0, {},                GPUWINAGG_FUNC__DENSE_RANK, 0 },
+	{ "lag",        1, {InvalidOid},      GPUWINAGG_FUNC__SHIFT, -1 },
+	{ "lag",        2, {InvalidOid, INT4OID},
+	                                      GPUWINAGG_FUNC__SHIFT, -1 },
+	{ "lag",        3, {InvalidOid, INT4OID, InvalidOid},
+	                                      GPUWINAGG_FUNC__SHIFT, -1 },
+	{ "lead",       1, {InvalidOid},      GPUWINAGG_FUNC__SHIFT, 1 },
+	{ "lead",       2, {InvalidOid, INT4OID},
+	                                      GPUWINAGG_FUNC__SHIFT, 1 },
+	{ "lead",       3, {InvalidOid, INT4OID, InvalidOid},
+	                                      GPUWINAGG_FUNC__SHIFT, 1 },
+	{ "count",      0, {},                GPUWINAGG_FUNC__COUNT_ROWS, 0 },
+	{ "count",      1, {InvalidOid},      GPUWINAGG_FUNC__COUNT, 0 },
+	{ "sum",        1, {INT2OID},         GPUWINAGG_FUNC__SUM_INT, 0 },
+	{ "sum",        1, {INT4OID},         GPUWINAGG_FUNC__SUM_INT, 0 },
+	{ "sum",        1, {FLOAT4OID},       GPUWINAGG_FUNC__SUM_FLOAT, 0 },
+	{ "sum",        1, {FLOAT8OID},       GPUWINAGG_FUNC__SUM_FLOAT, 0 },
+};
+
+/*
+ * form/deform interface of private field of CustomScan(GpuWindowAgg)
+ */
+typedef struct {
+	cl_int		optimal_gpu;	/* optimal GPU selection, or -1 */
+	char	   *kern_source;	/* source of the CUDA kernel */
+	cl_uint		extra_flags;	/* extra libraries to be included */
+	cl_uint		varlena_bufsz;	/* buffer size of temporary varlena datum */
+	List	   *used_params;
+	/* sorting keys, delivered from the original Sort */
+	int			numCols;		/* number of sort-key columns */
+	AttrNumber *sortColIdx;		/* attribute numbers on the outer tuple */
+	Oid		   *sortOperators;	/* OIDs of operators to sort them by */
+	Oid		   *collations;		/* OIDs of collations */
+	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
+	cl_int		part_nkeys;		/* # of leading keys for PARTITION BY */
+	cl_int		peer_nkeys;		/* # of leading keys for PARTITION/ORDER BY */
+	/* window functions */
+	List	   *func_kinds;		/* GPUWINAGG_FUNC__* */
+	List	   *func_start_kinds; /* GPUWINAGG_FRAME__* */
+	List	   *func_start_offsets;
+	List	   *func_end_kinds;	/* GPUWINAGG_FRAME__* */
+	List	   *func_end_offsets;
+	List	   *func_arg_attnums; /* argument of the aggregates, or 0 */
+	List	   *func_arg_types;	/* type of the argument, or InvalidOid */
+	List	   *func_shift_args; /* value and default of lag/lead, or NIL */
+} GpuWinAggInfo;
+
+static inline void
+form_gpuwinagg_info(CustomScan *cscan, GpuWinAggInfo *gwa_info)
+{
+	List	   *privs = NIL;
+	List	   *exprs = NIL;
+	List	   *temp;
+	int			i;
+
+	privs = lappend(privs, makeInteger(gwa_info->optimal_gpu));
+	privs = lappend(privs, makeString(gwa_info->kern_source));
+	privs = lappend(privs, makeInteger(gwa_info->extra_flags));
+	privs = lappend(privs, makeInteger(gwa_info->varlena_bufsz));
+	exprs = lappend(exprs, gwa_info->used_params);
+	privs = lappend(privs, makeInteger(gwa_info->numCols));
+	/* sortColIdx */
+	for (temp = NIL, i=0; i < gwa_info->numCols; i++)
+		temp = lappend_int(temp, gwa_info->sortColIdx[i]);
+	privs = lappend(privs, temp);
+	/* sortOperators */
+	for (temp = NIL, i=0; i < gwa_info->numCols; i++)
+		temp = lappend_oid(temp, gwa_info->sortOperators[i]);
+	privs = lappend(privs, temp);
+	/* collations */
+	for (temp = NIL, i=0; i < gwa_info->numCols; i++)
+		temp = lappend_oid(temp, gwa_info->collations[i]);
+	privs = lappend(privs, temp);
+	/* nullsFirst */
+	for (temp = NIL, i=0; i < gwa_info->numCols; i++)
+		temp = lappend_int(temp, gwa_info->nullsFirst[i]);
+	privs = lappend(privs, temp);
+	privs = lappend(privs, makeInteger(gwa_info->part_nkeys));
+	privs = lappend(privs, makeInteger(gwa_info->peer_nkeys));
+	/* window functions */
+	privs = lappend(privs, gwa_info->func_kinds);
+	privs = lappend(privs, gwa_info->func_start_kinds);
+	privs = lappend(privs, gwa_info->func_start_offsets);
+	privs = lappend(privs, gwa_info->func_end_kinds);
+	privs = lappend(privs, gwa_info->func_end_offsets);
+	privs = lappend(privs, gwa_info->func_arg_attnums);
+	privs = lappend(privs, gwa_info->func_arg_types);
+	exprs = lappend(exprs, gwa_info->func_shift_args);
+
+	cscan->custom_private = privs;
+	cscan->custom_exprs = exprs;
+}
+
+static inline GpuWinAggInfo *
+deform_gpuwinagg_info(CustomScan *cscan)
+{
+	GpuWinAggInfo *gwa_info = palloc0(sizeof(GpuWinAggInfo));
+	List	   *privs = cscan->custom_private;
+	List	   *exprs = cscan->custom_exprs;
+	List	   *temp;
+	ListCell   *lc;
+	int			pindex = 0;
+	int			eindex = 0;
+	int			i;
+
+	gwa_info->optimal_gpu = intVal(list_nth(privs, pindex++));
+	gwa_info->kern_source = strVal(list_nth(privs, pindex++));
+	gwa_info->extra_flags = intVal(list_nth(privs, pindex++));
+	gwa_info->varlena_bufsz = intVal(list_nth(privs, pindex++));
+	gwa_info->used_params = list_nth(exprs, eindex++);
+	gwa_info->numCols = intVal(list_nth(privs, pindex++));
+	/* sortColIdx */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gwa_info->numCols);
+	gwa_info->sortColIdx = palloc0(sizeof(AttrNumber) * gwa_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gwa_info->sortColIdx[i++] = lfirst_int(lc);
+	/* sortOperators */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gwa_info->numCols);
+	gwa_info->sortOperators = palloc0(sizeof(Oid) * gwa_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gwa_info->sortOperators[i++] = lfirst_oid(lc);
+	/* collations */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gwa_info->numCols);
+	gwa_info->collations = palloc0(sizeof(Oid) * gwa_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gwa_info->collations[i++] = lfirst_oid(lc);
+	/* nullsFirst */
+	temp = list_nth(privs, pindex++);
+	Assert(list_length(temp) == gwa_info->numCols);
+	gwa_info->nullsFirst = palloc0(sizeof(bool) * gwa_info->numCols);
+	i = 0;
+	foreach (lc, temp)
+		gwa_info->nullsFirst[i++] = lfirst_int(lc);
+	gwa_info->part_nkeys = intVal(list_nth(privs, pindex++));
+	gwa_info->peer_nkeys = intVal(list_nth(privs, pindex++));
+	/* window functions */
+	gwa_info->func_kinds = list_nth(privs, pindex++);
+	gwa_info->func_start_kinds = list_nth(privs, pindex++);
+	gwa_info->func_start_offsets = list_nth(privs, pindex++);
+	gwa_info->func_end_kinds = list_nth(privs, pindex++);
+	gwa_info->func_end_offsets = list_nth(privs, pindex++);
+	gwa_info->func_arg_attnums = list_nth(privs, pindex++);
+	gwa_info->func_arg_types = list_nth(privs, pindex++);
+	gwa_info->func_shift_args = list_nth(exprs, eindex++);
+
+	return gwa_info;
+}
+
+/*
+ * GpuWinAggTask - all the outer rows to be processed on GPU
+ */
+typedef struct
+{
+	GpuTask				task;
+	pgstrom_data_store *pds_src;	/* KDS_FORMAT_ROW */
+	kern_gpuwinagg	   *kgwinagg;	/* managed memory */
+	kern_gpusort		kern;
+} GpuWinAggTask;
+
+/*
+ * GpuWinAggState
+ */
+typedef struct
+{
+	cl_int			func_kind;
+	cl_int			start_kind;
+	cl_int			start_offset;
+	cl_int			end_kind;
+	cl_int			end_offset;
+	AttrNumber		arg_attnum;		/* argument of the aggregate, or 0 */
+	Oid				arg_type;
+	Oid				result_type;
+	ExprState	   *shift_value;	/* value of lag/lead */
+	ExprState	   *shift_default;	/* default of lag/lead, if any */
+} gpuwinaggFuncState;
+
+typedef struct
+{
+	GpuTaskState	gts;
+	cl_int			part_nkeys;
+	cl_int			peer_nkeys;
+	/* sorting keys for CPU fallback */
+	int				numCols;
+	SortSupport		ssup_keys;
+	/* window functions */
+	cl_int			nfuncs;
+	gpuwinaggFuncState *funcs;
+	cl_int			num_outer_cols;
+	size_t			chunk_length;	/* initial length of the chunk */
+	TupleTableSlot *outer_slot;		/* current row of the outer */
+	TupleTableSlot *shift_slot;		/* source row of lag/lead */
+	GpuWinAggTask  *gwinagg;		/* the task already processed */
+	cl_uint			curr_pos;		/* current position on the sorted rows */
+	bool			winagg_done;	/* true, if window functions are done */
+	/* run-time statistics */
+	cl_long			nitems_in;
+} GpuWinAggState;
+
+/*
+ * static functions
+ */
+static GpuTask *gpuwinagg_next_task(GpuTaskState *gts);
+static int		gpuwinagg_process_task(GpuTask *gtask, CUmodule cuda_module);
+static void		gpuwinagg_release_task(GpuTask *gtask);
+
+/*
+ * cost_gpuwinagg
+ *
+ * cost estimation for GpuWindowAgg. All the outer rows are loaded onto
+ * a chunk, then sorted by the bitonic-sorting kernels; that takes
+ * O(N * Log2(N)^2) comparisons. Boundary of the partitions and peer groups,
+ * and aggregation on the window frame are computed by the parallel scan
+ * that takes O(N * Log2(N)). CPU only forms the result rows.
+ */
+#define LOG2(x)		(log(x) / 0.693147180559945)
+
+static void
+cost_gpuwinagg(Plan *outer_plan,
+			   int nfuncs,
+			   Cost *p_startup_cost,
+			   Cost *p_total_cost,
+			   size_t *p_chunk_length)
+{
+	double		ntuples = outer_plan->plan_rows;
+	int			nattrs = list_length(outer_plan->targetlist);
+	double		unitsz;
+	double		length;
+	double		nsteps;
+	Cost		startup_cost;
+	Cost		run_cost;
+	Cost		gpu_comp_cost = 2.0 * pgstrom_gpu_operator_cost;
+
+	if (ntuples < 2.0)
+		ntuples = 2.0;
+
+	/* length of the chunk in row-format */
+	unitsz = (MAXALIGN(offsetof(kern_tupitem, htup) +
+					   MAXALIGN(offsetof(HeapTupleHeaderData, t_bits) +
+								BITMAPLEN(nattrs)) +
+					   MAXALIGN(outer_plan->plan_width)) + sizeof(cl_uint));
+	length = KDS_ESTIMATE_HEAD_LENGTH(nattrs) + unitsz * ntuples;
+
+	/* Cost come from the outer-plan, and GPU kernel setup */
+	startup_cost = outer_plan->total_cost + pgstrom_gpu_setup_cost;
+	/* Cost to load the outer rows onto the chunk, and DMA send/recv */
+	startup_cost += cpu_tuple_cost * ntuples;
+	startup_cost += (2.0 * pgstrom_gpu_dma_cost *
+					 ceil(length / (double) pgstrom_chunk_size()));
+	/* Cost for the bitonic-sorting on GPU */
+	nsteps = LOG2(ntuples);
+	startup_cost += (gpu_comp_cost * ntuples *
+					 nsteps * (nsteps + 1.0) / 2.0);
+	/* Cost for the scan of the boundaries and the window frames */
+	startup_cost += (pgstrom_gpu_operator_cost * ntuples *
+					 nsteps * (double)(1 + nfuncs));
+	/* Cost to form the result rows on CPU */
+	run_cost = (cpu_tuple_cost + cpu_operator_cost * nfuncs) * ntuples;
+
+	*p_startup_cost = startup_cost;
+	*p_total_cost = startup_cost + run_cost;
+	/* 25% margin, but expanded on demand */
+	length *= 1.25;
+	*p_chunk_length = (size_t) Max(length, (double) pgstrom_chunk_size());
+}
+
+/*
+ * gpuwinagg_codegen_fetch_value
+ *
+ * DEVICE_FUNCTION(cl_bool)
+ * gpuwinagg_fetch_value(kern_context *kcxt,
+ *                       kern_data_store *kds_src,
+ *                       cl_uint row_index,
+ *                       cl_int fnum,
+ *                       cl_long *p_ival,
+ *                       cl_double *p_fval);
+ */
+static void
+gpuwinagg_codegen_fetch_value(StringInfo kern,
+							  codegen_context *context,
+							  GpuWinAggInfo *gwa_info)
+{
+	StringInfoData	decl;
+	StringInfoData	body;
+	List		   *type_oid_list = NIL;
+	ListCell	   *lc1, *lc2, *lc3;
+	int				fnum = 0;
+
+	initStringInfo(&decl);
+	initStringInfo(&body);
+
+	appendStringInfoString(
+		&decl,
+		"  HeapTupleHeaderData *htup;\n"
+		"  void       *addr;\n");
+	appendStringInfoString(
+		&body,
+		"  assert(kds_src->format == KDS_FORMAT_ROW);\n"
+		"  htup = &KERN_DATA_STORE_TUPITEM(kds_src, row_index)->htup;\n"
+		"  switch (fnum)\n"
+		"  {\n");
+
+	forthree (lc1, gwa_info->func_kinds,
+			  lc2, gwa_info->func_arg_attnums,
+			  lc3, gwa_info->func_arg_types)
+	{
+		cl_int		func_kind = lfirst_int(lc1);
+		AttrNumber	anum = lfirst_int(lc2);
+		Oid			type_oid = lfirst_oid(lc3);
+		devtype_info *dtype;
+
+		if (func_kind == GPUWINAGG_FUNC__COUNT)
+		{
+			/* count(X) needs only nullness of the argument */
+			appendStringInfo(
+				&body,
+				"  case %d:\n"
+				"    addr = kern_get_datum_tuple(kds_src->colmeta, htup, %d);\n"
+				"    return (addr != NULL);\n",
+				fnum, anum - 1);
+		}
+		else if (func_kind == GPUWINAGG_FUNC__SUM_INT ||
+				 func_kind == GPUWINAGG_FUNC__SUM_FLOAT)
+		{
+			dtype = pgstrom_devtype_lookup_and_track(type_oid, context);
+			if (!dtype)
+				elog(ERROR, "Bug? type (%s) is not supported at GPU",
+					 format_type_be(type_oid));
+			appendStringInfo(
+				&body,
+				"  case %d:\n"
+				"    addr = kern_get_datum_tuple(kds_src->colmeta, htup, %d);\n"
+				"    pg_datum_ref(kcxt, temp.%s_v, addr);\n"
+				"    if (temp.%s_v.isnull)\n"
+				"      return false;\n"
+				"    *%s = (%s) temp.%s_v.value;\n"
+				"    return true;\n",
+				fnum, anum - 1,
+				dtype->type_name,
+				dtype->type_name,
+				func_kind == GPUWINAGG_FUNC__SUM_INT ? "p_ival" : "p_fval",
+				func_kind == GPUWINAGG_FUNC__SUM_INT ? "cl_long" : "cl_double",
+				dtype->type_name);
+			type_oid_list = list_append_unique_oid(type_oid_list,
+												   dtype->type_oid);
+		}
+		fnum++;
+	}
+	appendStringInfoString(
+		&body,
+		"  default:\n"
+		"    break;\n"
+		"  }\n");
+	/* declaration of temporary variable */
+	pgstrom_union_type_declarations(&decl, "temp", type_oid_list);
+
+	appendStringInfo(
+		kern,
+		"DEVICE_FUNCTION(cl_bool)\n"
+		"gpuwinagg_fetch_value(kern_context *kcxt,\n"
+		"                      kern_data_store *kds_src,\n"
+		"                      cl_uint row_index,\n"
+		"                      cl_int fnum,\n"
+		"                      cl_long *p_ival,\n"
+		"                      cl_double *p_fval)\n"
+		"{\n"
+		"%s\n%s"
+		"  return false;\n"
+		"}\n\n", decl.data, body.data);
+	pfree(decl.data);
+	pfree(body.data);
+}
+
+/*
+ * gpuwinagg_lookup_catalog
+ */
+static const gpuwinagg_catalog_t *
+gpuwinagg_lookup_catalog(WindowFunc *wfunc)
+{
+	Form_pg_proc	proform;
+	HeapTuple		htup;
+	int				i, j;
+
+	htup = SearchSysCache1(PROCOID, ObjectIdGetDatum(wfunc->winfnoid));
+	if (!HeapTupleIsValid(htup))
+		elog(ERROR, "cache lookup failed for function %u", wfunc->winfnoid);
+	proform = (Form_pg_proc) GETSTRUCT(htup);
+	if (proform->pronamespace != PG_CATALOG_NAMESPACE)
+	{
+		ReleaseSysCache(htup);
+		return NULL;
+	}
+	for (i=0; i < lengthof(gpuwinagg_catalog); i++)
+	{
+		gpuwinagg_catalog_t *catalog = &gpuwinagg_catalog[i];
+
+		if (strcmp(catalog->func_name, NameStr(proform->proname)) != 0 ||
+			catalog->func_nargs != proform->pronargs)
+			continue;
+		for (j=0; j < catalog->func_nargs; j++)
+		{
+			if (OidIsValid(catalog->func_argtypes[j]) &&
+				catalog->func_argtypes[j] != proform->proargtypes.values[j])
+				break;
+		}
+		if (j == catalog->func_nargs)
+		{
+			ReleaseSysCache(htup);
+			return catalog;
+		}
+	}
+	ReleaseSysCache(htup);
+	return NULL;
+}
+
+/*
+ * gpuwinagg_frame_offset - offset of ROWS frame must be a constant
+ */
+static bool
+gpuwinagg_frame_offset(Node *expr, cl_int *p_offset)
+{
+	Const	   *con = (Const *) expr;
+	int64		offset;
+
+	if (!con || !IsA(con, Const) || con->constisnull ||
+		con->consttype != INT8OID)
+		return false;
+	offset = DatumGetInt64(con->constvalue);
+	/* negative offset raises an error by WindowAgg */
+	if (offset < 0)
+		return false;
+	/* larger offset than any partitions makes no difference */
+	*p_offset = (cl_int) Min(offset, (int64) INT_MAX);
+	return true;
+}
+
+/*
+ * gpuwinagg_check_frame
+ *
+ * It translates the frame options of the WindowAgg to GPUWINAGG_FRAME__*.
+ * ROWS frame can have constant offsets, and RANGE frame is supported only
+ * if it is bounded by UNBOUNDED or CURRENT ROW. GROUPS and EXCLUDE are not
+ * supported right now.
+ */
+static bool
+gpuwinagg_check_frame(WindowAgg *wagg, int func_kind,
+					  cl_int *p_start_kind, cl_int *p_start_offset,
+					  cl_int *p_end_kind, cl_int *p_end_offset)
+{
+	int			opts = wagg->frameOptions;
+	cl_int		offset;
+
+#if PG_VERSION_NUM >= 110000
+	if ((opts & (FRAMEOPTION_GROUPS | FRAMEOPTION_EXCLUSION)) != 0)
+		return false;
+#endif
+	/* start of the frame */
+	*p_start_offset = 0;
+	if ((opts & FRAMEOPTION_START_UNBOUNDED_PRECEDING) != 0)
+		*p_start_kind = GPUWINAGG_FRAME__UNBOUNDED;
+	else if ((opts & FRAMEOPTION_START_CURRENT_ROW) != 0)
+		*p_start_kind = ((opts & FRAMEOPTION_ROWS) != 0
+						 ? GPUWINAGG_FRAME__ROWS
+						 : GPUWINAGG_FRAME__PEERS);
+	else if ((opts & (FRAMEOPTION_START_OFFSET_PRECEDING |
+					  FRAMEOPTION_START_OFFSET_FOLLOWING)) != 0)
+	{
+		if ((opts & FRAMEOPTION_ROWS) == 0 ||
+			!gpuwinagg_frame_offset(wagg->startOffset, &offset))
+			return false;
+		*p_start_kind = GPUWINAGG_FRAME__ROWS;
+		*p_start_offset = ((opts & FRAMEOPTION_START_OFFSET_PRECEDING) != 0
+						   ? -offset : offset);
+	}
+	else
+		return false;
+	/* end of the frame */
+	*p_end_offset = 0;
+	if ((opts & FRAMEOPTION_END_UNBOUNDED_FOLLOWING) != 0)
+		*p_end_kind = GPUWINAGG_FRAME__UNBOUNDED;
+	else if ((opts & FRAMEOPTION_END_CURRENT_ROW) != 0)
+		*p_end_kind = ((opts & FRAMEOPTION_ROWS) != 0
+					   ? GPUWINAGG_FRAME__ROWS
+					   : GPUWINAGG_FRAME__PEERS);
+	else if ((opts & (FRAMEOPTION_END_OFFSET_PRECEDING |
+					  FRAMEOPTION_END_OFFSET_FOLLOWING)) != 0)
+	{
+		if ((opts & FRAMEOPTION_ROWS) == 0 ||
+			!gpuwinagg_frame_offset(wagg->endOffset, &offset))
+			return false;
+		*p_end_kind = GPUWINAGG_FRAME__ROWS;
+		*p_end_offset = ((opts & FRAMEOPTION_END_OFFSET_PRECEDING) != 0
+						 ? -offset : offset);
+	}
+	else
+		return false;
+
+	/*
+	 * Sum of floating-point values on the sliding frame is computed by
+	 * the loop on the frame, instead of the subtraction of prefix-sum,
+	 * so we need the frame bounded by the offsets.
+	 */
+	if (func_kind == GPUWINAGG_FUNC__SUM_FLOAT &&
+		*p_start_kind != GPUWINAGG_FRAME__UNBOUNDED &&
+		(*p_start_kind != GPUWINAGG_FRAME__ROWS ||
+		 *p_end_kind != GPUWINAGG_FRAME__ROWS))
+		return false;
+	return true;
+}
+
+/*
+ * gpuwinagg_pull_wfuncs_walker - collect WindowFuncs in the target-list
+ */
+static bool
+gpuwinagg_pull_wfuncs_walker(Node *node, List **p_wfuncs)
+{
+	if (!node)
+		return false;
+	if (IsA(node, WindowFunc))
+	{
+		*p_wfuncs = list_append_unique(*p_wfuncs, node);
+		return false;
+	}
+	return expression_tree_walker(node, gpuwinagg_pull_wfuncs_walker,
+								  (void *) p_wfuncs);
+}
+
+/*
+ * gpuwinagg_replace_refs_mutator
+ *
+ * It replaces the Var-nodes that reference the Sort by the ones that
+ * reference the outer plan of the Sort (varno = OUTER_VAR) or the scan
+ * tuple of GpuWindowAgg (varno = INDEX_VAR). In the latter case, window
+ * functions are also replaced by the references to the scan tuple.
+ */
+typedef struct
+{
+	List	   *sort_tlist;		/* target-list of the Sort */
+	List	   *wfuncs;			/* WindowFuncs on the WindowAgg */
+	int			num_outer_cols;	/* number of the outer columns */
+	Index		varno;			/* OUTER_VAR or INDEX_VAR */
+} gpuwinagg_replace_context;
+
+static Node *
+gpuwinagg_replace_refs_mutator(Node *node, gpuwinagg_replace_context *con)
+{
+	if (!node)
+		return NULL;
+	if (IsA(node, Var))
+	{
+		Var		   *var = (Var *) node;
+		TargetEntry *tle;
+
+		if (var->varno != OUTER_VAR)
+			elog(ERROR, "Bug? WindowAgg has unexpected Var-node: %s",
+				 nodeToString(var));
+		tle = get_tle_by_resno(con->sort_tlist, var->varattno);
+		if (!tle || !IsA(tle->expr, Var) ||
+			((Var *) tle->expr)->varno != OUTER_VAR)
+			elog(ERROR, "Bug? Sort has unexpected target-entry: %s",
+				 nodeToString(tle));
+		var = copyObject((Var *) tle->expr);
+		var->varno = con->varno;
+		return (Node *) var;
+	}
+	if (IsA(node, WindowFunc) && con->varno == INDEX_VAR && con->wfuncs)
+	{
+		WindowFunc *wfunc = (WindowFunc *) node;
+		ListCell   *lc;
+		int			index = 0;
+
+		foreach (lc, con->wfuncs)
+		{
+			if (equal(wfunc, lfirst(lc)))
+				return (Node *) makeVar(INDEX_VAR,
+										con->num_outer_cols + index + 1,
+										wfunc->wintype,
+										-1,
+										wfunc->wincollid,
+										0);
+			index++;
+		}
+		elog(ERROR, "Bug? WindowFunc is not tracked: %s",
+			 nodeToString(wfunc));
+	}
+	return expression_tree_mutator(node, gpuwinagg_replace_refs_mutator,
+								   (void *) con);
+}
+
+/*
+ * pgstrom_try_insert_gpuwinagg
+ *
+ * It replaces a pair of WindowAgg and Sort by GpuWindowAgg, if the Sort
+ * is executable by the device sorting, and all the window functions are
+ * supported by the device code.
+ */
+void
+pgstrom_try_insert_gpuwinagg(PlannedStmt *pstmt, Plan **p_plan)
+{
+	WindowAgg  *wagg = (WindowAgg *)(*p_plan);
+	Sort	   *sort = (Sort *) outerPlan(wagg);
+	Plan	   *outer_plan;
+	CustomScan *cscan;
+	GpuWinAggInfo gwa_info;
+	codegen_context context;
+	gpuwinagg_replace_context rcon;
+	StringInfoData kern;
+	List	   *wfuncs = NIL;
+	List	   *outer_wfuncs = NIL;
+	Cost		startup_cost;
+	Cost		total_cost;
+	size_t		chunk_length;
+	ListCell   *lc;
+	int			i, j;
+
+	/* nothing to do, if feature is turned off */
+	if (!pgstrom_enabled || !enable_gpuwindowagg)
+		return;
+	/* only a simple WindowAgg just above the Sort */
+	Assert(IsA(wagg, WindowAgg));
+	if (wagg->plan.qual != NIL || !sort || !IsA(sort, Sort) ||
+		sort->plan.initPlan != NIL)
+		return;
+	outer_plan = outerPlan(sort);
+
+	memset(&gwa_info, 0, sizeof(GpuWinAggInfo));
+	gwa_info.numCols = sort->numCols;
+	gwa_info.sortColIdx = palloc0(sizeof(AttrNumber) * sort->numCols);
+	gwa_info.sortOperators = sort->sortOperators;
+	gwa_info.collations = sort->collations;
+	gwa_info.nullsFirst = sort->nullsFirst;
+	if (!pgstrom_gpusort_sortable(sort, gwa_info.sortColIdx))
+		return;
+
+	/*
+	 * The partition keys, then the ordering keys of the window must be
+	 * the leading sorting keys, to detect the boundary by the key changes.
+	 */
+	if (wagg->partNumCols + wagg->ordNumCols > sort->numCols)
+		return;
+	for (i=0; i < wagg->partNumCols; i++)
+	{
+		for (j=0; j < wagg->partNumCols; j++)
+		{
+			if (wagg->partColIdx[i] == sort->sortColIdx[j])
+				break;
+		}
+		if (j == wagg->partNumCols)
+			return;
+	}
+	for (i=0; i < wagg->ordNumCols; i++)
+	{
+		if (wagg->ordColIdx[i] != sort->sortColIdx[wagg->partNumCols + i])
+			return;
+	}
+	gwa_info.part_nkeys = wagg->partNumCols;
+	gwa_info.peer_nkeys = wagg->partNumCols + wagg->ordNumCols;
+
+	/*
+	 * Check window functions
+	 */
+	gpuwinagg_pull_wfuncs_walker((Node *) wagg->plan.targetlist, &wfuncs);
+	if (wfuncs == NIL)
+		return;
+	memset(&rcon, 0, sizeof(gpuwinagg_replace_context));
+	rcon.sort_tlist = sort->plan.targetlist;
+	rcon.num_outer_cols = list_length(outer_plan->targetlist);
+	foreach (lc, wfuncs)
+	{
+		WindowFunc *wfunc = lfirst(lc);
+		WindowFunc *outer_wfunc;
+		const gpuwinagg_catalog_t *catalog;
+		cl_int		start_kind = GPUWINAGG_FRAME__UNBOUNDED;
+		cl_int		start_offset = 0;
+		cl_int		end_kind = GPUWINAGG_FRAME__UNBOUNDED;
+		cl_int		end_offset = 0;
+		AttrNumber	arg_attnum = 0;
+		Oid			arg_type = InvalidOid;
+		List	   *shift_args = NIL;
+
+		if (wfunc->winref != wagg->winref || wfunc->aggfilter != NULL)
+			return;
+		catalog = gpuwinagg_lookup_catalog(wfunc);
+		if (!catalog)
+			return;
+		rcon.varno = OUTER_VAR;
+		outer_wfunc = (WindowFunc *)
+			gpuwinagg_replace_refs_mutator((Node *) wfunc, &rcon);
+
+		if (catalog->func_kind == GPUWINAGG_FUNC__SHIFT)
+		{
+			Node	   *expr;
+			int32		offset = 1;
+
+			/* offset of lag/lead must be a constant */
+			if (list_length(wfunc->args) >= 2)
+			{
+				Const  *con = lsecond(wfunc->args);
+
+				if (!IsA(con, Const) || con->constisnull ||
+					con->consttype != INT4OID)
+					return;
+				offset = DatumGetInt32(con->constvalue);
+				if (offset == PG_INT32_MIN)
+					return;
+			}
+			start_offset = catalog->shift_dir * offset;
+			/* value and default are evaluated on CPU */
+			rcon.varno = INDEX_VAR;
+			expr = gpuwinagg_replace_refs_mutator(linitial(wfunc->args),
+												  &rcon);
+			shift_args = list_make1(expr);
+			if (list_length(wfunc->args) >= 3)
+			{
+				expr = gpuwinagg_replace_refs_mutator(lthird(wfunc->args),
+													  &rcon);
+				shift_args = lappend(shift_args, expr);
+			}
+		}
+		else if (catalog->func_kind == GPUWINAGG_FUNC__COUNT_ROWS ||
+				 GPUWINAGG_FUNC_IS_AGGREGATE(catalog->func_kind))
+		{
+			if (!gpuwinagg_check_frame(wagg, catalog->func_kind,
+									   &start_kind, &start_offset,
+									   &end_kind, &end_offset))
+				return;
+			if (catalog->func_kind != GPUWINAGG_FUNC__COUNT_ROWS)
+			{
+				Var	   *var = linitial(outer_wfunc->args);
+
+				/* argument of aggregate must be a simple column reference */
+				if (!IsA(var, Var) ||
+					var->varno != OUTER_VAR ||
+					var->varattno <= 0)
+					return;
+				arg_attnum = var->varattno;
+				arg_type = var->vartype;
+			}
+		}
+		gwa_info.func_kinds = lappend_int(gwa_info.func_kinds,
+										  catalog->func_kind);
+		gwa_info.func_start_kinds = lappend_int(gwa_info.func_start_kinds,
+												start_kind);
+		gwa_info.func_start_offsets = lappend_int(gwa_info.func_start_offsets,
+												  start_offset);
+		gwa_info.func_end_kinds = lappend_int(gwa_info.func_end_kinds,
+											  end_kind);
+		gwa_info.func_end_offsets = lappend_int(gwa_info.func_end_offsets,
+												end_offset);
+		gwa_info.func_arg_attnums = lappend_int(gwa_info.func_arg_attnums,
+												arg_attnum);
+		gwa_info.func_arg_types = lappend_oid(gwa_info.func_arg_types,
+											  arg_type);
+		gwa_info.func_shift_args = lappend(gwa_info.func_shift_args,
+										   shift_args);
+		outer_wfuncs = lappend(outer_wfuncs, outer_wfunc);
+	}
+
+	/*
+	 * OK, cost estimation with GpuWindowAgg
+	 */
+	cost_gpuwinagg(outer_plan, list_length(wfuncs),
+				   &startup_cost, &total_cost, &chunk_length);
+	elog(DEBUG1,
+		 "GpuWindowAgg (cost=%.2f..%.2f) has%sadvantage to WindowAgg (cost=%.2f..%.2f)",
+		 startup_cost, total_cost,
+		 total_cost >= wagg->plan.total_cost ? " no " : " ",
+		 wagg->plan.startup_cost, wagg->plan.total_cost);
+	if (total_cost >= wagg->plan.total_cost)
+		return;
+
+	/*
+	 * OK, GpuWindowAgg is enough reasonable to replace the WindowAgg
+	 */
+	cscan = makeNode(CustomScan);
+	cscan->scan.plan.startup_cost = startup_cost;
+	cscan->scan.plan.total_cost = total_cost;
+	cscan->scan.plan.plan_rows = wagg->plan.plan_rows;
+	cscan->scan.plan.plan_width = wagg->plan.plan_width;
+	cscan->scan.plan.parallel_aware = false;
+	cscan->scan.plan.parallel_safe = wagg->plan.parallel_safe;
+	cscan->scan.plan.initPlan = wagg->plan.initPlan;
+	cscan->scan.plan.extParam = bms_copy(wagg->plan.extParam);
+	cscan->scan.plan.allParam = bms_copy(wagg->plan.allParam);
+	cscan->scan.scanrelid = 0;
+	cscan->flags = 0;
+	cscan->custom_relids = NULL;
+	cscan->methods = &gpuwinagg_plan_methods;
+	rcon.wfuncs = wfuncs;
+	rcon.varno = INDEX_VAR;
+	cscan->scan.plan.targetlist = (List *)
+		gpuwinagg_replace_refs_mutator((Node *) wagg->plan.targetlist, &rcon);
+	/* scan tuple has the outer columns, then results of window functions */
+	foreach (lc, outer_plan->targetlist)
+	{
+		TargetEntry	   *tle = lfirst(lc);
+		Var			   *var;
+
+		var = makeVar(OUTER_VAR,
+					  tle->resno,
+					  exprType((Node *) tle->expr),
+					  exprTypmod((Node *) tle->expr),
+					  exprCollation((Node *) tle->expr),
+					  0);
+		cscan->custom_scan_tlist =
+			lappend(cscan->custom_scan_tlist,
+					makeTargetEntry((Expr *) var,
+									tle->resno,
+									tle->resname ? pstrdup(tle->resname) : NULL,
+									false));
+	}
+	foreach (lc, outer_wfuncs)
+	{
+		cscan->custom_scan_tlist =
+			lappend(cscan->custom_scan_tlist,
+					makeTargetEntry((Expr *) lfirst(lc),
+									list_length(cscan->custom_scan_tlist) + 1,
+									NULL,
+									false));
+	}
+	outerPlan(cscan) = outer_plan;
+
+	pgstrom_init_codegen_context(&context, NULL, NULL);
+	initStringInfo(&kern);
+	appendStringInfoString(&kern,
+						   pgstrom_gpusort_codegen(&context,
+												   gwa_info.numCols,
+												   gwa_info.sortColIdx,
+												   gwa_info.sortOperators,
+												   gwa_info.collations,
+												   gwa_info.nullsFirst,
+												   outer_plan->targetlist,
+												   true));
+	gpuwinagg_codegen_fetch_value(&kern, &context, &gwa_info);
+	gwa_info.optimal_gpu = -1;
+	gwa_info.kern_source = kern.data;
+	gwa_info.extra_flags = (context.extra_flags |
+							DEVKERNEL_NEEDS_GPUSORT |
+							DEVKERNEL_NEEDS_GPUWINAGG);
+	gwa_info.varlena_bufsz = context.varlena_bufsz;
+	gwa_info.used_params = context.used_params;
+	form_gpuwinagg_info(cscan, &gwa_info);
+
+	*p_plan = &cscan->scan.plan;
+}
+
+/*
+ * pgstrom_plan_is_gpuwinagg
+ */
+bool
+pgstrom_plan_is_gpuwinagg(const Plan *plan)
+{
+	if (IsA(plan, CustomScan) &&
+		((CustomScan *) plan)->methods == &gpuwinagg_plan_methods)
+		return true;
+	return false;
+}
+
+/*
+ * gpuwinagg_create_scan_state - allocation of GpuWinAggState
+ */
+static Node *
+gpuwinagg_create_scan_state(CustomScan *cscan)
+{
+	GpuWinAggState *gws = MemoryContextAllocZero(CurTransactionContext,
+												 sizeof(GpuWinAggState));
+	/* Set tag and executor callbacks */
+	NodeSetTag(gws, T_CustomScanState);
+	gws->gts.css.flags = cscan->flags;
+	if (cscan->methods == &gpuwinagg_plan_methods)
+		gws->gts.css.methods = &gpuwinagg_exec_methods;
+	else
+		elog(ERROR, "Bug? unexpected CustomPlanMethods");
+
+	return (Node *) gws;
+}
+
+/*
+ * ExecInitGpuWinAgg
+ */
+static void
+ExecInitGpuWinAgg(CustomScanState *node, EState *estate, int eflags)
+{
+	GpuWinAggState *gws = (GpuWinAggState *) node;
+	CustomScan	   *cscan = (CustomScan *) node->ss.ps.plan;
+	GpuWinAggInfo  *gwa_info = deform_gpuwinagg_info(cscan);
+	GpuContext	   *gcontext;
+	TupleDesc		scan_tupdesc;
+	TupleDesc		outer_tupdesc;
+	bool			explain_only = ((eflags & EXEC_FLAG_EXPLAIN_ONLY) != 0);
+	StringInfoData	kern_define;
+	ProgramId		program_id;
+	Cost			startup_cost;
+	Cost			total_cost;
+	int				i;
+
+	Assert(node->ss.ss_currentRelation == NULL);
+	Assert(outerPlan(cscan) != NULL);
+	/* setup GpuContext for CUDA kernel execution */
+	gcontext = AllocGpuContext(gwa_info->optimal_gpu, false, false);
+	gws->gts.gcontext = gcontext;
+
+	/*
+	 * Scan tuple of GpuWindowAgg consists of the outer columns and
+	 * the results of window functions.
+	 */
+	scan_tupdesc = ExecCleanTypeFromTL(cscan->custom_scan_tlist);
+	ExecInitScanTupleSlot(estate, &gws->gts.css.ss, scan_tupdesc,
+						  &TTSOpsVirtual);
+	ExecAssignScanProjectionInfoWithVarno(&gws->gts.css.ss, INDEX_VAR);
+
+	/* setup common GpuTaskState fields */
+	pgstromInitGpuTaskState(&gws->gts,
+							gcontext,
+							GpuTaskKind_GpuWinAgg,
+							NIL,
+							NIL,
+							gwa_info->used_params,
+							gwa_info->optimal_gpu,
+							0,
+							eflags);
+	gws->gts.cb_next_task    = gpuwinagg_next_task;
+	gws->gts.cb_process_task = gpuwinagg_process_task;
+	gws->gts.cb_release_task = gpuwinagg_release_task;
+
+	/*
+	 * GpuWindowAgg always materializes the results, so outer plan does not
+	 * need to support backward scan, mark/restore or rewind.
+	 */
+	outerPlanState(gws) = ExecInitNode(outerPlan(cscan), estate,
+									   eflags & ~(EXEC_FLAG_REWIND |
+												  EXEC_FLAG_BACKWARD |
+												  EXEC_FLAG_MARK));
+	outer_tupdesc = planStateResultTupleDesc(outerPlanState(gws));
+	gws->num_outer_cols = outer_tupdesc->natts;
+	gws->outer_slot = MakeSingleTupleTableSlot(outer_tupdesc,
+											   &TTSOpsVirtual);
+	gws->shift_slot = MakeSingleTupleTableSlot(outer_tupdesc,
+											   &TTSOpsVirtual);
+	cost_gpuwinagg(outerPlan(cscan),
+				   list_length(gwa_info->func_kinds),
+				   &startup_cost,
+				   &total_cost,
+				   &gws->chunk_length);
+
+	/* sorting keys for CPU fallback */
+	gws->part_nkeys = gwa_info->part_nkeys;
+	gws->peer_nkeys = gwa_info->peer_nkeys;
+	gws->numCols = gwa_info->numCols;
+	gws->ssup_keys = palloc0(sizeof(SortSupportData) * gws->numCols);
+	for (i=0; i < gws->numCols; i++)
+	{
+		SortSupport		ssup = &gws->ssup_keys[i];
+
+		ssup->ssup_cxt = CurrentMemoryContext;
+		ssup->ssup_collation = gwa_info->collations[i];
+		ssup->ssup_nulls_first = gwa_info->nullsFirst[i];
+		ssup->ssup_attno = gwa_info->sortColIdx[i];
+		PrepareSortSupportFromOrderingOp(gwa_info->sortOperators[i], ssup);
+	}
+
+	/* window functions */
+	gws->nfuncs = list_length(gwa_info->func_kinds);
+	gws->funcs = palloc0(sizeof(gpuwinaggFuncState) * gws->nfuncs);
+	for (i=0; i < gws->nfuncs; i++)
+	{
+		gpuwinaggFuncState *fstate = &gws->funcs[i];
+		List	   *shift_args = list_nth(gwa_info->func_shift_args, i);
+
+		fstate->func_kind = list_nth_int(gwa_info->func_kinds, i);
+		fstate->start_kind = list_nth_int(gwa_info->func_start_kinds, i);
+		fstate->start_offset = list_nth_int(gwa_info->func_start_offsets, i);
+		fstate->end_kind = list_nth_int(gwa_info->func_end_kinds, i);
+		fstate->end_offset = list_nth_int(gwa_info->func_end_offsets, i);
+		fstate->arg_attnum = list_nth_int(gwa_info->func_arg_attnums, i);
+		fstate->arg_type = list_nth_oid(gwa_info->func_arg_types, i);
+		fstate->result_type = TupleDescAttr(scan_tupdesc,
+											gws->num_outer_cols + i)->atttypid;
+		if (shift_args != NIL)
+		{
+			fstate->shift_value = ExecInitExpr(linitial(shift_args),
+											   &gws->gts.css.ss.ps);
+			if (list_length(shift_args) > 1)
+				fstate->shift_default = ExecInitExpr(lsecond(shift_args),
+													 &gws->gts.css.ss.ps);
+		}
+	}
+
+	/* Get CUDA program and async build if any */
+	initStringInfo(&kern_define);
+	pgstrom_build_session_info(&kern_define,
+							   &gws->gts,
+							   gwa_info->extra_flags);
+	program_id = pgstrom_create_cuda_program(gcontext,
+											 gwa_info->extra_flags,
+											 gwa_info->varlena_bufsz,
+											 gwa_info->kern_source,
+											 kern_define.data,
+											 false,
+											 explain_only);
+	gws->gts.program_id = program_id;
+	pfree(kern_define.data);
+}
+
+/*
+ * gpuwinagg_create_task - constructor of GpuWinAggTask
+ */
+static GpuTask *
+gpuwinagg_create_task(GpuWinAggState *gws, pgstrom_data_store *pds_src)
+{
+	GpuContext	   *gcontext = gws->gts.gcontext;
+	GpuWinAggTask  *gwinagg;
+	kern_gpuwinagg *kgwinagg;
+	gpusortResultIndex *kresults;
+	CUdeviceptr		m_deviceptr;
+	CUresult		rc;
+	cl_uint			nitems = pds_src->kds.nitems;
+	size_t			uint_sz = STROMALIGN(sizeof(cl_uint) * nitems);
+	size_t			long_sz = STROMALIGN(sizeof(cl_long) * nitems);
+	size_t			char_sz = STROMALIGN(sizeof(cl_char) * nitems);
+	size_t			offset;
+	size_t			length;
+	int				i;
+
+	/* GpuWinAggTask with kern_gpusort */
+	length = (STROMALIGN(offsetof(GpuWinAggTask, kern.kparams) +
+						 gws->gts.kern_params->length) +
+			  STROMALIGN(offsetof(gpusortResultIndex, results[nitems])));
+	rc = gpuMemAllocManaged(gcontext,
+							&m_deviceptr,
+							length,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	gwinagg = (GpuWinAggTask *) m_deviceptr;
+	memset(gwinagg, 0, offsetof(GpuWinAggTask, kern.kparams));
+
+	pgstromInitGpuTask(&gws->gts, &gwinagg->task);
+	gwinagg->pds_src = pds_src;
+	gwinagg->kern.nitems_in = nitems;
+	/* kern_parambuf */
+	memcpy(KERN_GPUSORT_PARAMBUF(&gwinagg->kern),
+		   gws->gts.kern_params,
+		   gws->gts.kern_params->length);
+	/* gpusortResultIndex */
+	kresults = KERN_GPUSORT_RESULT_INDEX(&gwinagg->kern);
+	kresults->nitems = 0;
+
+	/* kern_gpuwinagg and the per-row buffers */
+	offset = STROMALIGN(offsetof(kern_gpuwinagg, funcs[gws->nfuncs]));
+	length = offset + 10 * uint_sz;
+	for (i=0; i < gws->nfuncs; i++)
+	{
+		if (GPUWINAGG_FUNC_IS_AGGREGATE(gws->funcs[i].func_kind))
+			length += 3 * long_sz + 3 * uint_sz;
+		length += long_sz + char_sz;
+	}
+	rc = gpuMemAllocManaged(gcontext,
+							&m_deviceptr,
+							length,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+	{
+		gpuMemFree(gcontext, (CUdeviceptr) gwinagg);
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	}
+	kgwinagg = (kern_gpuwinagg *) m_deviceptr;
+	memset(kgwinagg, 0, offsetof(kern_gpuwinagg, funcs[gws->nfuncs]));
+	kgwinagg->nitems = nitems;
+	kgwinagg->part_nkeys = gws->part_nkeys;
+	kgwinagg->peer_nkeys = gws->peer_nkeys;
+	kgwinagg->nfuncs = gws->nfuncs;
+	kgwinagg->length = length;
+#define __NEXT_BUFFER(field, sz)		\
+	do { (field) = offset; offset += (sz); } while(0)
+	__NEXT_BUFFER(kgwinagg->part_head[0], uint_sz);
+	__NEXT_BUFFER(kgwinagg->part_head[1], uint_sz);
+	__NEXT_BUFFER(kgwinagg->part_tail[0], uint_sz);
+	__NEXT_BUFFER(kgwinagg->part_tail[1], uint_sz);
+	__NEXT_BUFFER(kgwinagg->peer_head[0], uint_sz);
+	__NEXT_BUFFER(kgwinagg->peer_head[1], uint_sz);
+	__NEXT_BUFFER(kgwinagg->peer_tail[0], uint_sz);
+	__NEXT_BUFFER(kgwinagg->peer_tail[1], uint_sz);
+	__NEXT_BUFFER(kgwinagg->peer_count[0], uint_sz);
+	__NEXT_BUFFER(kgwinagg->peer_count[1], uint_sz);
+	for (i=0; i < gws->nfuncs; i++)
+	{
+		gpuwinaggFuncState *fstate = &gws->funcs[i];
+		kern_gpuwinagg_func *kfunc = &kgwinagg->funcs[i];
+
+		kfunc->func_kind = fstate->func_kind;
+		kfunc->start_kind = fstate->start_kind;
+		kfunc->start_offset = fstate->start_offset;
+		kfunc->end_kind = fstate->end_kind;
+		kfunc->end_offset = fstate->end_offset;
+		if (GPUWINAGG_FUNC_IS_AGGREGATE(fstate->func_kind))
+		{
+			__NEXT_BUFFER(kfunc->v_raw, long_sz);
+			__NEXT_BUFFER(kfunc->v_scan[0], long_sz);
+			__NEXT_BUFFER(kfunc->v_scan[1], long_sz);
+			__NEXT_BUFFER(kfunc->c_raw, uint_sz);
+			__NEXT_BUFFER(kfunc->c_scan[0], uint_sz);
+			__NEXT_BUFFER(kfunc->c_scan[1], uint_sz);
+		}
+		__NEXT_BUFFER(kfunc->r_values, long_sz);
+		__NEXT_BUFFER(kfunc->r_isnull, char_sz);
+	}
+#undef __NEXT_BUFFER
+	Assert(offset == length);
+	gwinagg->kgwinagg = kgwinagg;
+
+	return &gwinagg->task;
+}
+
+/*
+ * gpuwinagg_expand_chunk - expand the chunk twice
+ */
+static pgstrom_data_store *
+gpuwinagg_expand_chunk(GpuWinAggState *gws, pgstrom_data_store *pds_old)
+{
+	TupleDesc	tupdesc = planStateResultTupleDesc(outerPlanState(gws));
+	pgstrom_data_store *pds_new;
+	size_t		length = 2 * pds_old->kds.length;
+	cl_uint		i;
+
+	if (length > KDS_OFFSET_MAX_SIZE)
+		elog(ERROR, "GpuWindowAgg: too large outer rows to load (%zu)",
+			 (size_t) pds_old->kds.length);
+	pds_new = PDS_create_row(gws->gts.gcontext, tupdesc, length);
+	for (i=0; i < pds_old->kds.nitems; i++)
+	{
+		if (!KDS_fetch_tuple_row(gws->outer_slot, &pds_old->kds,
+								 &gws->gts.curr_tuple, i) ||
+			!PDS_insert_tuple(pds_new, gws->outer_slot))
+			elog(ERROR, "Bug? GpuWindowAgg failed to expand the chunk");
+	}
+	ExecClearTuple(gws->outer_slot);
+	PDS_release(pds_old);
+
+	return pds_new;
+}
+
+/*
+ * gpuwinagg_next_task
+ *
+ * It loads all the rows from the outer plan onto a chunk, because window
+ * functions reference the rows across the partition, then makes a task to
+ * process them on the device at once.
+ */
+static GpuTask *
+gpuwinagg_next_task(GpuTaskState *gts)
+{
+	GpuWinAggState *gws = (GpuWinAggState *) gts;
+	PlanState	   *outer_ps = outerPlanState(gws);
+	TupleDesc		tupdesc = planStateResultTupleDesc(outer_ps);
+	pgstrom_data_store *pds = NULL;
+	TupleTableSlot *slot;
+
+	if (gts->scan_overflow == (void *)(~0UL))
+		return NULL;
+	for (;;)
+	{
+		slot = ExecProcNode(outer_ps);
+		if (TupIsNull(slot))
+			break;
+		/* create a new data-store on demand */
+		if (!pds)
+			pds = PDS_create_row(gts->gcontext,
+								 tupdesc,
+								 gws->chunk_length);
+		while (!PDS_insert_tuple(pds, slot))
+			pds = gpuwinagg_expand_chunk(gws, pds);
+	}
+	gts->scan_overflow = (void *)(~0UL);
+	if (!pds)
+		return NULL;
+	gws->nitems_in = pds->kds.nitems;
+	return gpuwinagg_create_task(gws, pds);
+}
+
+/*
+ * gpuwinagg_process_task
+ */
+static int
+__gpuwinagg_process_task(GpuTask *gtask, CUmodule cuda_module)
+{
+	GpuWinAggTask  *gwinagg = (GpuWinAggTask *) gtask;
+	pgstrom_data_store *pds_src = gwinagg->pds_src;
+	kern_gpuwinagg *kgwinagg = gwinagg->kgwinagg;
+	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(&gwinagg->kern);
+	CUfunction		kern_setup;
+	CUfunction		kern_bounds;
+	CUfunction		kern_values;
+	CUfunction		kern_final;
+	CUdeviceptr		m_gpusort = (CUdeviceptr)&gwinagg->kern;
+	CUdeviceptr		m_gwinagg = (CUdeviceptr)kgwinagg;
+	CUdeviceptr		m_kds_src = (CUdeviceptr)&pds_src->kds;
+	void		   *kern_args[4];
+	cl_uint			nitems = pds_src->kds.nitems;
+	cl_uint			dist;
+	cl_int			bank;
+	cl_int			bounds_bank;
+	cl_int			values_bank;
+	bool			has_aggregates = false;
+	size_t			length;
+	int				grid_sz;
+	int				block_sz;
+	cl_uint			i;
+	CUresult		rc;
+
+	/*
+	 * Lookup GPU kernel functions
+	 */
+	rc = cuModuleGetFunction(&kern_setup, cuda_module,
+							 "kern_gpuwinagg_setup");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&kern_bounds, cuda_module,
+							 "kern_gpuwinagg_bounds_step");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&kern_values, cuda_module,
+							 "kern_gpuwinagg_values_step");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = cuModuleGetFunction(&kern_final, cuda_module,
+							 "kern_gpuwinagg_final");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+
+	/*
+	 * OK, prefetch the buffers, then sort the rows on the device
+	 */
+	length = ((char *)kresults - (char *)&gwinagg->kern) +
+		offsetof(gpusortResultIndex, results[nitems]);
+	rc = cuMemPrefetchAsync(m_gpusort,
+							length,
+							CU_DEVICE_PER_THREAD,
+							CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	rc = cuMemPrefetchAsync(m_kds_src,
+							pds_src->kds.length,
+							CU_DEVICE_PER_THREAD,
+							CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	rc = cuMemPrefetchAsync(m_gwinagg,
+							kgwinagg->length,
+							CU_DEVICE_PER_THREAD,
+							CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+
+	gpusortLaunchBitonicSorting(cuda_module, &gwinagg->kern, &pds_src->kds);
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpuwinagg_setup(kern_gpusort *kgpusort,
+	 *                      kern_gpuwinagg *kgwinagg,
+	 *                      kern_data_store *kds_src)
+	 */
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_setup,
+							 CU_DEVICE_PER_THREAD,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	kern_args[0] = &m_gpusort;
+	kern_args[1] = &m_gwinagg;
+	kern_args[2] = &m_kds_src;
+	rc = cuLaunchKernel(kern_setup,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_WORKER,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpuwinagg_bounds_step(kern_gpuwinagg *kgwinagg,
+	 *                            cl_uint dist,
+	 *                            cl_int bank)
+	 */
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_bounds,
+							 CU_DEVICE_PER_THREAD,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	kern_args[0] = &m_gwinagg;
+	kern_args[1] = &dist;
+	kern_args[2] = &bank;
+	for (dist = 1, bank = 0; dist < nitems; dist *= 2, bank = 1 - bank)
+	{
+		rc = cuLaunchKernel(kern_bounds,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_WORKER,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuLaunchKernel: %s", errorText(rc));
+	}
+	bounds_bank = bank;
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpuwinagg_values_step(kern_gpuwinagg *kgwinagg,
+	 *                            cl_uint dist,
+	 *                            cl_int bank,
+	 *                            cl_int bounds_bank)
+	 */
+	for (i=0; i < kgwinagg->nfuncs; i++)
+	{
+		if (GPUWINAGG_FUNC_IS_AGGREGATE(kgwinagg->funcs[i].func_kind))
+			has_aggregates = true;
+	}
+	bank = 0;
+	if (has_aggregates)
+	{
+		rc = gpuOptimalBlockSize(&grid_sz,
+								 &block_sz,
+								 kern_values,
+								 CU_DEVICE_PER_THREAD,
+								 0, 0);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+		kern_args[0] = &m_gwinagg;
+		kern_args[1] = &dist;
+		kern_args[2] = &bank;
+		kern_args[3] = &bounds_bank;
+		for (dist = 1; dist < nitems; dist *= 2, bank = 1 - bank)
+		{
+			rc = cuLaunchKernel(kern_values,
+								grid_sz, 1, 1,
+								block_sz, 1, 1,
+								0,
+								CU_STREAM_PER_WORKER,
+								kern_args,
+								NULL);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuLaunchKernel: %s", errorText(rc));
+		}
+	}
+	values_bank = bank;
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpuwinagg_final(kern_gpuwinagg *kgwinagg,
+	 *                      cl_int bounds_bank,
+	 *                      cl_int values_bank)
+	 */
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_final,
+							 CU_DEVICE_PER_THREAD,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	kern_args[0] = &m_gwinagg;
+	kern_args[1] = &bounds_bank;
+	kern_args[2] = &values_bank;
+	rc = cuLaunchKernel(kern_final,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_WORKER,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_WORKER);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuEventRecord: %s", errorText(rc));
+
+	/* Point of synchronization */
+	rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuEventSynchronize: %s", errorText(rc));
+
+	/*
+	 * Check GPU kernel status
+	 */
+	if (gwinagg->kern.kerror.errcode != ERRCODE_STROM_SUCCESS)
+		memcpy(&gwinagg->task.kerror,
+			   &gwinagg->kern.kerror, sizeof(kern_errorbuf));
+	else
+		memcpy(&gwinagg->task.kerror,
+			   &kgwinagg->kerror, sizeof(kern_errorbuf));
+	if (gwinagg->task.kerror.errcode == ERRCODE_STROM_SUCCESS)
+	{
+		gwinagg->kern.nitems_out = kresults->nitems;
+		/* write back the sorted index, source rows and the results */
+		rc = cuMemPrefetchAsync((CUdeviceptr) kresults,
+								offsetof(gpusortResultIndex,
+										 results[nitems]),
+								CU_DEVICE_CPU,
+								CU_STREAM_PER_WORKER);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		rc = cuMemPrefetchAsync(m_kds_src,
+								pds_src->kds.length,
+								CU_DEVICE_CPU,
+								CU_STREAM_PER_WORKER);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		for (i=0; i < kgwinagg->nfuncs; i++)
+		{
+			kern_gpuwinagg_func *kfunc = &kgwinagg->funcs[i];
+
+			rc = cuMemPrefetchAsync(m_gwinagg + kfunc->r_values,
+									sizeof(cl_long) * nitems,
+									CU_DEVICE_CPU,
+									CU_STREAM_PER_WORKER);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+			rc = cuMemPrefetchAsync(m_gwinagg + kfunc->r_isnull,
+									sizeof(cl_char) * nitems,
+									CU_DEVICE_CPU,
+									CU_STREAM_PER_WORKER);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		}
+	}
+	else if (pgstrom_cpu_fallback_enabled &&
+			 (gwinagg->task.kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
+	{
+		/* window functions shall be computed by CPU on the backend side */
+		memset(&gwinagg->task.kerror, 0, sizeof(kern_errorbuf));
+		gwinagg->task.cpu_fallback = true;
+	}
+	return 0;
+}
+
+static int
+gpuwinagg_process_task(GpuTask *gtask, CUmodule cuda_module)
+{
+	volatile int	retval;
+
+	STROM_TRY();
+	{
+		retval = __gpuwinagg_process_task(gtask, cuda_module);
+	}
+	STROM_CATCH();
+	{
+		STROM_RE_THROW();
+	}
+	STROM_END_TRY();
+
+	return retval;
+}
+
+/*
+ * gpuwinagg_release_task
+ */
+static void
+gpuwinagg_release_task(GpuTask *gtask)
+{
+	GpuWinAggTask  *gwinagg = (GpuWinAggTask *) gtask;
+	GpuContext	   *gcontext = gtask->gts->gcontext;
+
+	if (gwinagg->pds_src)
+		PDS_release(gwinagg->pds_src);
+	if (gwinagg->kgwinagg)
+		gpuMemFree(gcontext, (CUdeviceptr) gwinagg->kgwinagg);
+	gpuMemFree(gcontext, (CUdeviceptr) gwinagg);
+}
+
+/*
+ * gpuwinagg_keydiff_slots - index of the first sorting key which is not
+ * equal between the two tuples, or number of the keys if all equal.
+ */
+static int
+gpuwinagg_keydiff_slots(GpuWinAggState *gws,
+						TupleTableSlot *x_slot,
+						TupleTableSlot *y_slot)
+{
+	int		i;
+
+	for (i=0; i < gws->numCols; i++)
+	{
+		SortSupport	ssup = &gws->ssup_keys[i];
+		Datum		x_datum, y_datum;
+		bool		x_isnull, y_isnull;
+
+		x_datum = slot_getattr(x_slot, ssup->ssup_attno, &x_isnull);
+		y_datum = slot_getattr(y_slot, ssup->ssup_attno, &y_isnull);
+		if (ApplySortComparator(x_datum, x_isnull,
+								y_datum, y_isnull,
+								ssup) != 0)
+			return i;
+	}
+	return gws->numCols;
+}
+
+/*
+ * gpuwinagg_fallback_comp - comparator of the CPU fallback
+ */
+typedef struct
+{
+	GpuWinAggState *gws;
+	kern_data_store *kds;
+	TupleTableSlot *x_slot;
+	TupleTableSlot *y_slot;
+} gpuwinaggFallbackArg;
+
+static int
+gpuwinagg_fallback_comp(const void *__x, const void *__y, void *__arg)
+{
+	gpuwinaggFallbackArg *fb_arg = __arg;
+	GpuWinAggState *gws = fb_arg->gws;
+	cl_uint			x_index = *((const cl_uint *) __x);
+	cl_uint			y_index = *((const cl_uint *) __y);
+	int				i;
+
+	if (!KDS_fetch_tuple_row(fb_arg->x_slot, fb_arg->kds,
+							 &gws->gts.curr_tuple, x_index) ||
+		!KDS_fetch_tuple_row(fb_arg->y_slot, fb_arg->kds,
+							 &gws->gts.curr_tuple, y_index))
+		elog(ERROR, "Bug? GpuWindowAgg fallback references out of range");
+	for (i=0; i < gws->numCols; i++)
+	{
+		SortSupport	ssup = &gws->ssup_keys[i];
+		Datum		x_datum, y_datum;
+		bool		x_isnull, y_isnull;
+		int			comp;
+
+		x_datum = slot_getattr(fb_arg->x_slot, ssup->ssup_attno, &x_isnull);
+		y_datum = slot_getattr(fb_arg->y_slot, ssup->ssup_attno, &y_isnull);
+		comp = ApplySortComparator(x_datum, x_isnull,
+								   y_datum, y_isnull,
+								   ssup);
+		if (comp != 0)
+			return comp;
+	}
+	return 0;
+}
+
+/*
+ * gpuwinagg_fallback_compute
+ *
+ * It sorts the rows, then computes the window functions on CPU, if GPU
+ * kernel reported an error with CPU fallback flag. The per-row buffers
+ * on the first bank are set up as if GPU kernel completed the scans, then
+ * the results are computed by the common gpuwinagg_final_row().
+ */
+static void
+gpuwinagg_fallback_compute(GpuWinAggState *gws, GpuWinAggTask *gwinagg)
+{
+	kern_data_store *kds = &gwinagg->pds_src->kds;
+	kern_gpuwinagg *kgwinagg = gwinagg->kgwinagg;
+	gpusortResultIndex *kresults = KERN_GPUSORT_RESULT_INDEX(&gwinagg->kern);
+	TupleDesc		tupdesc = planStateResultTupleDesc(outerPlanState(gws));
+	gpuwinaggFallbackArg fb_arg;
+	TupleTableSlot *slots[2];
+	cl_uint		   *part_head;
+	cl_uint		   *part_tail;
+	cl_uint		   *peer_head;
+	cl_uint		   *peer_tail;
+	cl_uint		   *peer_count;
+	cl_int		   *keydiff;
+	cl_uint			nitems = kds->nitems;
+	cl_uint			pos;
+	int				i;
+
+	/* sort the rows by qsort */
+	for (pos=0; pos < nitems; pos++)
+		kresults->results[pos] = pos;
+	kresults->nitems = nitems;
+	fb_arg.gws = gws;
+	fb_arg.kds = kds;
+	fb_arg.x_slot = slots[0] = MakeSingleTupleTableSlot(tupdesc,
+														&TTSOpsVirtual);
+	fb_arg.y_slot = slots[1] = MakeSingleTupleTableSlot(tupdesc,
+														&TTSOpsVirtual);
+	qsort_arg(kresults->results, nitems, sizeof(cl_uint),
+			  gpuwinagg_fallback_comp, &fb_arg);
+	gwinagg->kern.nitems_out = nitems;
+
+	/* boundary of the partitions and peer groups */
+	part_head = KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_head[0]);
+	part_tail = KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->part_tail[0]);
+	peer_head = KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_head[0]);
+	peer_tail = KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_tail[0]);
+	peer_count = KERN_GPUWINAGG_BUFFER(kgwinagg, kgwinagg->peer_count[0]);
+	keydiff = palloc(sizeof(cl_int) * (nitems + 1));
+	for (pos=0; pos < nitems; pos++)
+	{
+		TupleTableSlot *slot = slots[pos % 2];
+
+		if (!KDS_fetch_tuple_row(slot, kds,
+								 &gws->gts.curr_tuple,
+								 kresults->results[pos]))
+			elog(ERROR, "Bug? GpuWindowAgg fallback references out of range");
+		keydiff[pos] = (pos == 0 ? 0 :
+						gpuwinagg_keydiff_slots(gws, slots[(pos + 1) % 2],
+												slot));
+		if (pos == 0 || keydiff[pos] < gws->part_nkeys)
+			part_head[pos] = pos;
+		else
+			part_head[pos] = part_head[pos - 1];
+		if (pos == 0 || keydiff[pos] < gws->peer_nkeys)
+		{
+			peer_head[pos] = pos;
+			peer_count[pos] = (pos == 0 ? 1 : peer_count[pos - 1] + 1);
+		}
+		else
+		{
+			peer_head[pos] = peer_head[pos - 1];
+			peer_count[pos] = peer_count[pos - 1];
+		}
+
+		/* segmented prefix-sum of the aggregate arguments */
+		for (i=0; i < gws->nfuncs; i++)
+		{
+			gpuwinaggFuncState *fstate = &gws->funcs[i];
+			kern_gpuwinagg_func *kfunc = &kgwinagg->funcs[i];
+			cl_uint	   *c_raw;
+			cl_uint	   *c_scan;
+			Datum		datum;
+			bool		isnull;
+			bool		is_head = (part_head[pos] == pos);
+
+			if (!GPUWINAGG_FUNC_IS_AGGREGATE(fstate->func_kind))
+				continue;
+			datum = slot_getattr(slot, fstate->arg_attnum, &isnull);
+			c_raw = KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->c_raw);
+			c_scan = KERN_GPUWINAGG_BUFFER(kgwinagg, kfunc->c_scan[0]);
+			c_raw[pos] = (isnull ? 0 : 1);
+			c_scan[pos] = c_raw[pos] + (is_head ? 0 : c_scan[pos - 1]);
+			if (fstate->func_kind == GPUWINAGG_FUNC__SUM_FLOAT)
+			{
+				cl_double  *v_raw = KERN_GPUWINAGG_BUFFER(kgwinagg,
+														  kfunc->v_raw);
+				cl_double  *v_scan = KERN_GPUWINAGG_BUFFER(kgwinagg,
+														   kfunc->v_scan[0]);
+				if (isnull)
+					v_raw[pos] = 0.0;
+				else if (fstate->arg_type == FLOAT4OID)
+					v_raw[pos] = DatumGetFloat4(datum);
+				else
+					v_raw[pos] = DatumGetFloat8(datum);
+				v_scan[pos] = v_raw[pos] + (is_head ? 0.0 : v_scan[pos - 1]);
+			}
+			else
+			{
+				cl_long	   *v_raw = KERN_GPUWINAGG_BUFFER(kgwinagg,
+														  kfunc->v_raw);
+				cl_long	   *v_scan = KERN_GPUWINAGG_BUFFER(kgwinagg,
+														   kfunc->v_scan[0]);
+				if (isnull || fstate->func_kind == GPUWINAGG_FUNC__COUNT)
+					v_raw[pos] = 0;
+				else if (fstate->arg_type == INT2OID)
+					v_raw[pos] = DatumGetInt16(datum);
+				else
+					v_raw[pos] = DatumGetInt32(datum);
+				v_scan[pos] = v_raw[pos] + (is_head ? 0 : v_scan[pos - 1]);
+			}
+		}
+	}
+	/* tail of the partitions and peer groups */
+	keydiff[nitems] = 0;
+	for (pos = nitems; pos-- > 0; )
+	{
+		if (pos + 1 == nitems || keydiff[pos + 1] < gws->part_nkeys)
+			part_tail[pos] = pos;
+		else
+			part_tail[pos] = part_tail[pos + 1];
+		if (pos + 1 == nitems || keydiff[pos + 1] < gws->peer_nkeys)
+			peer_tail[pos] = pos;
+		else
+			peer_tail[pos] = peer_tail[pos + 1];
+	}
+	/* results of the window functions */
+	for (pos=0; pos < nitems; pos++)
+		gpuwinagg_final_row(kgwinagg, pos, 0, 0);
+
+	pfree(keydiff);
+	ExecDropSingleTupleTableSlot(slots[0]);
+	ExecDropSingleTupleTableSlot(slots[1]);
+}
+
+/*
+ * gpuwinagg_exec_window - run the window functions on all the outer rows
+ */
+static void
+gpuwinagg_exec_window(GpuWinAggState *gws)
+{
+	GpuTask	   *gtask;
+
+	while ((gtask = fetch_next_gputask(&gws->gts)) != NULL)
+	{
+		GpuWinAggTask  *gwinagg = (GpuWinAggTask *) gtask;
+
+		if (gtask->cpu_fallback)
+		{
+			gws->gts.num_cpu_fallbacks++;
+			gpuwinagg_fallback_compute(gws, gwinagg);
+		}
+		Assert(!gws->gwinagg);
+		gws->gwinagg = gwinagg;
+	}
+	gws->curr_pos = 0;
+	gws->winagg_done = true;
+}
+
+/*
+ * gpuwinagg_next_tuple
+ */
+static TupleTableSlot *
+gpuwinagg_next_tuple(GpuWinAggState *gws)
+{
+	TupleTableSlot *scan_slot = gws->gts.css.ss.ss_ScanTupleSlot;
+	TupleTableSlot *outer_slot = gws->outer_slot;
+	ExprContext	   *econtext = gws->gts.css.ss.ps.ps_ExprContext;
+	GpuWinAggTask  *gwinagg;
+	kern_gpuwinagg *kgwinagg;
+	kern_data_store *kds;
+	gpusortResultIndex *kresults;
+	cl_uint			pos;
+	int				i, j;
+
+	if (!gws->winagg_done)
+		gpuwinagg_exec_window(gws);
+	gwinagg = gws->gwinagg;
+	if (!gwinagg)
+		return NULL;
+	kgwinagg = gwinagg->kgwinagg;
+	kds = &gwinagg->pds_src->kds;
+	kresults = KERN_GPUSORT_RESULT_INDEX(&gwinagg->kern);
+	if (gws->curr_pos >= kresults->nitems)
+		return NULL;
+	pos = gws->curr_pos++;
+
+	/* outer columns of the current row */
+	if (!KDS_fetch_tuple_row(outer_slot, kds,
+							 &gws->gts.curr_tuple,
+							 kresults->results[pos]))
+		elog(ERROR, "Bug? GpuWindowAgg result index is out of range");
+	slot_getallattrs(outer_slot);
+	ExecClearTuple(scan_slot);
+	for (j=0; j < gws->num_outer_cols; j++)
+	{
+		scan_slot->tts_values[j] = outer_slot->tts_values[j];
+		scan_slot->tts_isnull[j] = outer_slot->tts_isnull[j];
+	}
+	/* results of the window functions */
+	for (i=0; i < gws->nfuncs; i++, j++)
+	{
+		gpuwinaggFuncState *fstate = &gws->funcs[i];
+		kern_gpuwinagg_func *kfunc = &kgwinagg->funcs[i];
+		cl_long	   *r_lvalues = KERN_GPUWINAGG_BUFFER(kgwinagg,
+													  kfunc->r_values);
+		cl_double  *r_fvalues = KERN_GPUWINAGG_BUFFER(kgwinagg,
+													  kfunc->r_values);
+		cl_char	   *r_isnull = KERN_GPUWINAGG_BUFFER(kgwinagg,
+													 kfunc->r_isnull);
+		bool		isnull;
+
+		if (fstate->func_kind == GPUWINAGG_FUNC__SHIFT)
+		{
+			/* lag/lead returns the value on the source row */
+			if (r_isnull[pos])
+			{
+				if (fstate->shift_default)
+				{
+					econtext->ecxt_scantuple = outer_slot;
+					scan_slot->tts_values[j] =
+						ExecEvalExprSwitchContext(fstate->shift_default,
+												  econtext, &isnull);
+					scan_slot->tts_isnull[j] = isnull;
+				}
+				else
+				{
+					scan_slot->tts_values[j] = 0;
+					scan_slot->tts_isnull[j] = true;
+				}
+			}
+			else
+			{
+				if (!KDS_fetch_tuple_row(gws->shift_slot, kds,
+										 &gws->gts.curr_tuple,
+										 kresults->results[r_lvalues[pos]]))
+					elog(ERROR, "Bug? GpuWindowAgg source row is out of range");
+				econtext->ecxt_scantuple = gws->shift_slot;
+				scan_slot->tts_values[j] =
+					ExecEvalExprSwitchContext(fstate->shift_value,
+											  econtext, &isnull);
+				scan_slot->tts_isnull[j] = isnull;
+			}
+		}
+		else if (r_isnull[pos])
+		{
+			scan_slot->tts_values[j] = 0;
+			scan_slot->tts_isnull[j] = true;
+		}
+		else if (fstate->func_kind == GPUWINAGG_FUNC__SUM_FLOAT)
+		{
+			if (fstate->result_type == FLOAT4OID)
+				scan_slot->tts_values[j] = Float4GetDatum(r_fvalues[pos]);
+			else
+				scan_slot->tts_values[j] = Float8GetDatum(r_fvalues[pos]);
+			scan_slot->tts_isnull[j] = false;
+		}
+		else
+		{
+			scan_slot->tts_values[j] = Int64GetDatum(r_lvalues[pos]);
+			scan_slot->tts_isnull[j] = false;
+		}
+	}
+	ExecStoreVirtualTuple(scan_slot);
+
+	return scan_slot;
+}
+
+/*
+ * ExecReCheckGpuWinAgg
+ */
+static bool
+ExecReCheckGpuWinAgg(CustomScanState *node, TupleTableSlot *slot)
+{
+	/*
+	 * GpuWindowAgg shall be never located under the LockRows, so we don't
+	 * expect that we need to have valid EPQ recheck here.
+	 */
+	return true;
+}
+
+/*
+ * ExecGpuWinAgg
+ */
+static TupleTableSlot *
+ExecGpuWinAgg(CustomScanState *node)
+{
+	GpuWinAggState *gws = (GpuWinAggState *) node;
+
+	ActivateGpuContext(gws->gts.gcontext);
+	return ExecScan(&node->ss,
+					(ExecScanAccessMtd) gpuwinagg_next_tuple,
+					(ExecScanRecheckMtd) ExecReCheckGpuWinAgg);
+}
+
+/*
+ * gpuwinagg_cleanup_task
+ */
+static void
+gpuwinagg_cleanup_task(GpuWinAggState *gws)
+{
+	ExecClearTuple(gws->outer_slot);
+	ExecClearTuple(gws->shift_slot);
+	if (gws->gwinagg)
+		gpuwinagg_release_task(&gws->gwinagg->task);
+	gws->gwinagg = NULL;
+	gws->curr_pos = 0;
+	gws->winagg_done = false;
+}
+
+/*
+ * ExecEndGpuWinAgg
+ */
+static void
+ExecEndGpuWinAgg(CustomScanState *node)
+{
+	GpuWinAggState *gws = (GpuWinAggState *) node;
+
+	/* wait for completion of asynchronous GpuTaks */
+	SynchronizeGpuContext(gws->gts.gcontext);
+	/* release the processed rows */
+	gpuwinagg_cleanup_task(gws);
+	ExecDropSingleTupleTableSlot(gws->outer_slot);
+	ExecDropSingleTupleTableSlot(gws->shift_slot);
+	/* clean up subtree */
+	ExecEndNode(outerPlanState(node));
+	pgstromReleaseGpuTaskState(&gws->gts, NULL);
+}
+
+/*
+ * ExecReScanGpuWinAgg
+ */
+static void
+ExecReScanGpuWinAgg(CustomScanState *node)
+{
+	GpuWinAggState *gws = (GpuWinAggState *) node;
+	PlanState	   *outer_ps = outerPlanState(node);
+
+	/*
+	 * If outer-plan is not changed, we can rewind the results of the window
+	 * functions. Elsewhere, we have to forget the previous results then
+	 * process the outer rows again.
+	 */
+	if (gws->winagg_done && outer_ps->chgParam == NULL)
+	{
+		gws->curr_pos = 0;
+		return;
+	}
+	/* wait for completion of asynchronous GpuTaks */
+	SynchronizeGpuContext(gws->gts.gcontext);
+	gpuwinagg_cleanup_task(gws);
+	/* common rescan handling */
+	pgstromRescanGpuTaskState(&gws->gts);
+	gws->gts.scan_done = false;
+	gws->gts.scan_overflow = NULL;
+	if (outer_ps->chgParam == NULL)
+		ExecReScan(outer_ps);
+}
+
+/*
+ * ExplainGpuWinAgg
+ */
+static void
+ExplainGpuWinAgg(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	GpuWinAggState *gws = (GpuWinAggState *) node;
+	CustomScan	   *cscan = (CustomScan *) node->ss.ps.plan;
+	GpuWinAggInfo  *gwa_info = deform_gpuwinagg_info(cscan);
+	List		   *dcontext;
+	List		   *part_keys = NIL;
+	List		   *order_keys = NIL;
+	int				i;
+
+	/* Set up deparsing context */
+	dcontext = set_deparse_context_planstate(es->deparse_cxt,
+											 (Node *)&gws->gts.css.ss.ps,
+											 ancestors);
+	/* shows partition and ordering keys */
+	for (i=0; i < gwa_info->peer_nkeys; i++)
+	{
+		TargetEntry	   *tle;
+		char		   *exprstr;
+
+		tle = get_tle_by_resno(cscan->custom_scan_tlist,
+							   gwa_info->sortColIdx[i]);
+		if (!tle)
+			elog(ERROR, "no tlist entry for key %d",
+				 gwa_info->sortColIdx[i]);
+		exprstr = deparse_expression((Node *) tle->expr, dcontext,
+									 es->verbose, false);
+		if (i < gwa_info->part_nkeys)
+			part_keys = lappend(part_keys, exprstr);
+		else
+			order_keys = lappend(order_keys, exprstr);
+	}
+	if (part_keys != NIL)
+		ExplainPropertyList("Partition Key", part_keys, es);
+	if (order_keys != NIL)
+		ExplainPropertyList("Order Key", order_keys, es);
+
+	/* run-time statistics, if any */
+	if (es->analyze && gws->winagg_done)
+	{
+		ExplainPropertyInteger("Processed rows", NULL,
+							   gws->nitems_in, es);
+		if (gws->gts.num_cpu_fallbacks > 0)
+			ExplainPropertyInteger("Num of CPU fallback chunks", NULL,
+								   gws->gts.num_cpu_fallbacks, es);
+	}
+	/* other common fields */
+	pgstromExplainGpuTaskState(&gws->gts, es);
+}
+
+/*
+ * pgstrom_init_gpuwinagg
+ */
+void
+pgstrom_init_gpuwinagg(void)
+{
+	/* pg_strom.enable_gpuwindowagg */
+	DefineCustomBoolVariable("pg_strom.enable_gpuwindowagg",
+							 "Enables the use of GPU accelerated window functions",
+							 NULL,
+							 &enable_gpuwindowagg,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/* setup plan methods */
+	memset(&gpuwinagg_plan_methods, 0, sizeof(gpuwinagg_plan_methods));
+	gpuwinagg_plan_methods.CustomName			= "GpuWindowAgg";
+	gpuwinagg_plan_methods.CreateCustomScanState = gpuwinagg_create_scan_state;
+	RegisterCustomScanMethods(&gpuwinagg_plan_methods);
+
+	/* setup exec methods */
+	memset(&gpuwinagg_exec_methods, 0, sizeof(gpuwinagg_exec_methods));
+	gpuwinagg_exec_methods.CustomName         = "GpuWindowAgg";
+	gpuwinagg_exec_methods.BeginCustomScan    = ExecInitGpuWinAgg;
+	gpuwinagg_exec_methods.ExecCustomScan     = ExecGpuWinAgg;
+	gpuwinagg_exec_methods.EndCustomScan      = ExecEndGpuWinAgg;
+	gpuwinagg_exec_methods.ReScanCustomScan   = ExecReScanGpuWinAgg;
+	gpuwinagg_exec_methods.ExplainCustomScan  = ExplainGpuWinAgg;
+}
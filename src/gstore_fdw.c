@@ -27,6 +27,8 @@
 #define GSTORE_BACKGROUND_CMD__APPLY_REDO		'A'
 #define GSTORE_BACKGROUND_CMD__COMPACTION		'C'
 #define GSTORE_BACKGROUND_CMD__DROP_UNLOAD		'D'
+#define GSTORE_BACKGROUND_CMD__SYNC_REDO		'S'
+#define GSTORE_BACKGROUND_CMD__CHECKPOINT		'K'
 typedef struct
 {
 	dlist_node	chain;
@@ -35,7 +37,7 @@ typedef struct
 	Latch	   *backend;		/* MyLatch of the backend, if any */
 	int			command;		/* one of GSTORE_MAINTAIN_CMD__* */
 	CUresult	retval;
-	uint64		end_pos;		/* for APPLY_REDO */
+	uint64		end_pos;		/* for APPLY_REDO and SYNC_REDO */
 } GpuStoreBackgroundCommand;
 
 /*
@@ -88,15 +90,23 @@ typedef struct
 	ssize_t			max_num_rows;
 	ssize_t			num_hash_slots;
 	AttrNumber		primary_key;
+	AttrNumber		range_index;
+	/* bitmap of dictionary-compressed columns (per column option) */
+	cl_uint			dict_columns[(GSTORE_DICT_MAX_COLUMNS + 31) / 32];
 	bool			preserve_files;
 	const char	   *base_file;
 	const char	   *redo_log_file;
 	size_t			redo_log_limit;
 	cl_long			gpu_update_interval;
 	size_t			gpu_update_threshold;
+	cl_long			redo_sync_delay;	/* in ms; 0 means sync on commit */
 
 #define GSTORE_NUM_BASE_ROW_LOCKS		1000
 #define GSTORE_NUM_HASH_SLOT_LOCKS		1200
+/* rowids reserved at once by a backend; see gstoreFdwAllocateRowId */
+#define GSTORE_ROWID_CACHE_NUMS			64
+#define GSTORE_ROWID_RESERVED			(UINT_MAX - 1)
+#define GSTORE_REDO_SYNC_DELAY_MAX		60000	/* 60s */
 	/* Runtime state */
 	LWLock			base_mmap_lock;
 	uint32			base_mmap_revision;
@@ -105,23 +115,62 @@ typedef struct
 	/* NOTE: hash_slot_lock must be acquired outside of the base_row_lock */
 	slock_t			base_row_lock[GSTORE_NUM_BASE_ROW_LOCKS];
 	slock_t			hash_slot_lock[GSTORE_NUM_HASH_SLOT_LOCKS];
+	/* odd while hash_slot_lock is held; for lock-free readers */
+	pg_atomic_uint32 hash_slot_seqno[GSTORE_NUM_HASH_SLOT_LOCKS];
 
 	slock_t			redo_pos_lock;
 	uint64			redo_write_nitems;
-	uint64			redo_write_pos;
+	uint64			redo_write_pos;		/* logs before this are written */
+	uint64			redo_alloc_pos;		/* logs before this are reserved */
 	uint64			redo_read_nitems;
 	uint64			redo_read_pos;
 	volatile uint64	redo_sync_pos;
+	LWLock			redo_sync_lock;		/* lock for group commit */
+	uint64			redo_sync_timestamp;	/* time when last sync */
+	uint64			redo_checkpoint_pos;	/* redo_write_pos at the last
+											 * checkpoint */
+	uint64			redo_checkpoint_timestamp;	/* time when last checkpoint */
 	uint64			redo_repl_pos[4];		/* under the replication */
+	Latch		   *redo_repl_latch[4];		/* replicas waiting for new logs */
 	uint64			redo_last_timestamp;	/* time when last command sent.
 											 * not a timestamp redo-logs are
 											 * applied on the GPU buffer. */
+	/*
+	 * Version of the visible contents. Transactions that modified the table
+	 * increment it at PRE_COMMIT and COMMIT/ABORT, so odd number means
+	 * visibility of the rows may be changing now.
+	 */
+	pg_atomic_uint64 data_version;
+	/*
+	 * The latest transaction that incremented the data_version. A scan can
+	 * rely on the data_version only if its snapshot can see this xid.
+	 */
+	pg_atomic_uint32 data_version_xid;
 	/* Device data store */
 	pthread_rwlock_t gpu_bufer_lock;
 	CUipcMemHandle	gpu_main_mhandle;		/* mhandle to main portion */
 	CUipcMemHandle	gpu_extra_mhandle;		/* mhandle to extra portion */
 	size_t			gpu_main_size;
 	size_t			gpu_extra_size;
+
+	/*
+	 * Range index (optional) - rowids sorted by the key column, for range
+	 * lookups and ORDER BY. NULLs are located at the tail. It is merged
+	 * with INSERT logs on demand, see gstoreFdwRefreshRangeIndex.
+	 */
+	LWLock			range_index_lock;
+	uint64			range_index_pos;	/* redo position already merged */
+	cl_uint			range_index_nkeys;	/* number of non-NULL keys */
+	cl_uint			range_index_nitems;	/* number of entries */
+	cl_uint		   *range_index_rowids;	/* on TopSharedMemoryContext */
+
+	/*
+	 * Aggregate view (optional) - snapshot of the aggregate view on the
+	 * device memory; copied by the maintainer for each micro-batch of the
+	 * redo logs. See gstoreFdwParseAggViewOptions for the definition.
+	 */
+	LWLock			aggview_lock;
+	kern_gpustore_aggview *aggview;		/* on TopSharedMemoryContext */
 } GpuStoreSharedState;
 
 typedef struct
@@ -132,6 +181,7 @@ typedef struct
 	TransactionId	xmax_ftable;
 	GpuStoreSharedState *gs_sstate;
 	dlist_head		gs_undo_logs;		/* list of GpuStoreUndoLogs */
+	bool			data_version_odd;	/* data_version is odd by us */
 	/* base file mapping */
 	GpuStoreBaseFileHead *base_mmap;
 	uint32			base_mmap_revision;
@@ -139,6 +189,10 @@ typedef struct
 	int				base_mmap_is_pmem;
 	GpuStoreRowIdMapHead *rowid_map;	/* RowID map section */
 	GpuStoreHashIndexHead *hash_index;	/* Hash-index section (optional) */
+	/* rowids reserved by this backend, but not used yet */
+	cl_uint			rowid_cache_head;
+	cl_uint			rowid_cache_tail;
+	cl_uint			rowid_cache[GSTORE_ROWID_CACHE_NUMS];
 	/* redo log mapping */
 	char		   *redo_mmap;
 	size_t			redo_mmap_sz;
@@ -146,6 +200,7 @@ typedef struct
 	/* fields below are valid only GpuStore Maintainer */
 	CUdeviceptr		gpu_main_devptr;
 	CUdeviceptr		gpu_extra_devptr;
+	CUdeviceptr		gpu_aggview_devptr;	/* managed memory, if any */
 } GpuStoreDesc;
 
 /*
@@ -161,9 +216,21 @@ struct GpuStoreFdwState
 	Bitmapset	   *referenced;
 	cl_bool			sysattr_refs;
 	cl_uint			nitems;			/* kds->nitems on BeginScan */
+	uint64			data_version;	/* data_version on BeginScan */
+	TransactionId	snapshot_xmin;	/* xmin of the scan snapshot, or invalid
+									 * if not MVCC snapshot */
 	cl_bool			is_first;
 	cl_uint			last_rowid;		/* last rowid returned */
 	ExprState	   *indexExprState;
+	bool			index_is_array;	/* PK = ANY(ARRAY) */
+	cl_uint		   *index_rowids;	/* rowids with the matched key */
+	cl_uint			index_nitems;
+	/* range index scan */
+	bool			range_scan;
+	ExprState	   *rangeLowerState;
+	ExprState	   *rangeUpperState;
+	cl_uint		   *range_rowids;	/* local copy of the index */
+	cl_uint			range_nitems;
 };
 
 /*
@@ -197,6 +264,10 @@ static shmem_startup_hook_type shmem_startup_next = NULL;
 static bool			gstore_fdw_enabled;		/* GUC */
 static char		   *gstore_fdw_default_base_dir;	/* GUC */
 static char		   *gstore_fdw_default_redo_dir;	/* GUC */
+static bool			gstore_fdw_continuous_apply;	/* GUC */
+static int			gstore_fdw_redo_apply_batch_size;	/* GUC */
+static int			gstore_fdw_checkpoint_interval;	/* GUC */
+static CUstream		gstore_fdw_apply_stream = NULL;	/* only bgworker */
 static object_access_hook_type object_access_next = NULL;
 
 /* ---- Forward declarations ---- */
@@ -204,6 +275,8 @@ Datum pgstrom_gstore_fdw_handler(PG_FUNCTION_ARGS);
 Datum pgstrom_gstore_fdw_validator(PG_FUNCTION_ARGS);
 Datum pgstrom_gstore_fdw_apply_redo(PG_FUNCTION_ARGS);
 Datum pgstrom_gstore_fdw_compaction(PG_FUNCTION_ARGS);
+Datum pgstrom_gstore_fdw_export_columns(PG_FUNCTION_ARGS);
+Datum pgstrom_gstore_fdw_put_columns(PG_FUNCTION_ARGS);
 Datum pgstrom_gstore_fdw_post_creation(PG_FUNCTION_ARGS);
 Datum pgstrom_gstore_fdw_sysattr_in(PG_FUNCTION_ARGS);
 Datum pgstrom_gstore_fdw_sysattr_out(PG_FUNCTION_ARGS);
@@ -224,8 +297,8 @@ static CUresult gstoreFdwInvokeCompaction(Oid ftable_oid,
 										  int cuda_dindex, bool is_async);
 static CUresult gstoreFdwInvokeDropUnload(Oid ftable_oid,
 										  int cuda_dindex, bool is_async);
-static cl_uint	gstoreFdwAllocateRowId(GpuStoreSharedState *gs_sstate,
-									   GpuStoreRowIdMapHead *rowid_map);
+static cl_uint	gstoreFdwAllocateRowId(GpuStoreDesc *gs_desc);
+static void		gstoreFdwReleaseRowIdCache(GpuStoreDesc *gs_desc);
 static void		gstoreFdwReleaseRowId(GpuStoreSharedState *gs_sstate,
 									  GpuStoreRowIdMapHead *rowid_map,
 									  cl_uint rowid);
@@ -235,6 +308,11 @@ static void		gstoreFdwReleaseRowIdMulti(GpuStoreSharedState *gs_sstate,
 static bool		gstoreFdwCheckRowId(GpuStoreSharedState *gs_sstate,
 									GpuStoreRowIdMapHead *rowid_map,
 									cl_uint rowid);
+static void		gstoreFdwRefreshRangeIndex(GpuStoreDesc *gs_desc);
+static cl_uint *gstoreFdwLookupRangeIndex(GpuStoreDesc *gs_desc,
+										  bool has_lower, Datum lower,
+										  bool has_upper, Datum upper,
+										  cl_uint *p_nitems);
 static void		gstoreFdwInsertIntoPrimaryKey(GpuStoreDesc *gs_desc,
 											  GpuStoreUndoLogs *gs_undo,
 											  cl_uint rowid);
@@ -333,13 +411,26 @@ gstoreFdwSpinUnlockBaseRow(GpuStoreDesc *gs_desc, cl_uint rowid)
 	return false;
 }
 
+/*
+ * NOTE: lock index must be derived from the hash-slot, not the hash value,
+ * because different hash values may share the same hash-slot.
+ */
+static inline cl_uint
+gstoreFdwHashSlotLockIndex(GpuStoreDesc *gs_desc, Datum hash)
+{
+	GpuStoreHashIndexHead *hash_index = gs_desc->hash_index;
+
+	return (hash % hash_index->nslots) % GSTORE_NUM_HASH_SLOT_LOCKS;
+}
+
 static inline bool
 gstoreFdwSpinLockHashSlot(GpuStoreDesc *gs_desc, Datum hash)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
-	cl_uint		lindex = hash % GSTORE_NUM_HASH_SLOT_LOCKS;
+	cl_uint		lindex = gstoreFdwHashSlotLockIndex(gs_desc, hash);
 
 	SpinLockAcquire(&gs_sstate->hash_slot_lock[lindex]);
+	pg_atomic_fetch_add_u32(&gs_sstate->hash_slot_seqno[lindex], 1);
 
 	return true;
 }
@@ -348,8 +439,9 @@ static inline bool
 gstoreFdwSpinUnlockHashSlot(GpuStoreDesc *gs_desc, Datum hash)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
-	cl_uint		lindex = hash % GSTORE_NUM_HASH_SLOT_LOCKS;
+	cl_uint		lindex = gstoreFdwHashSlotLockIndex(gs_desc, hash);
 
+	pg_atomic_fetch_add_u32(&gs_sstate->hash_slot_seqno[lindex], 1);
 	SpinLockRelease(&gs_sstate->hash_slot_lock[lindex]);
 
 	return false;
@@ -424,6 +516,38 @@ match_clause_to_primary_key(PlannerInfo *root,
 	Node	   *right;
 	TypeCacheEntry *tcache;
 
+	/*
+	 * PK = ANY(ARRAY-Expression) is also looked up by the hash-index
+	 * for each element; the array-type of the expression tells the
+	 * executor multiple keys are supplied.
+	 */
+	if (IsA(rinfo->clause, ScalarArrayOpExpr))
+	{
+		ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *)rinfo->clause;
+		Var		   *var;
+
+		if (!saop->useOr || list_length(saop->args) != 2)
+			return NULL;
+		var = (Var *) linitial(saop->args);
+		right = (Node *) lsecond(saop->args);
+		if (IsA(var, RelabelType))
+			var = (Var *)((RelabelType *)var)->arg;
+		if (!IsA(var, Var) ||
+			var->varno != baserel->relid ||
+			var->varattno != primary_key ||
+			type_is_array(var->vartype) ||
+			exprType(right) != get_array_type(var->vartype))
+			return NULL;
+		tcache = lookup_type_cache(var->vartype,
+								   TYPECACHE_EQ_OPR);
+		if (tcache->eq_opr != saop->opno ||
+			contain_var_clause(right) ||
+			contain_volatile_functions(right))
+			return NULL;
+		/* Ok, Left-VAR = ANY(Right-Expression) */
+		return right;
+	}
+
 	if (!IsA(op, OpExpr) || list_length(op->args) != 2)
 		return false;	/* binary operator */
 
@@ -470,6 +594,143 @@ match_clause_to_primary_key(PlannerInfo *root,
 	return NULL;
 }
 
+/*
+ * match_clause_to_range_index
+ *
+ * It checks whether the supplied clause is a btree comparison between the
+ * key column of the range index and an expression of the same data type.
+ * Both of the bounds are handled as inclusive, because the scan clauses
+ * shall be rechecked on the fetched rows anyway.
+ */
+static bool
+match_clause_to_range_index(PlannerInfo *root,
+							RelOptInfo *baserel,
+							RestrictInfo *rinfo,
+							int range_index,
+							Node **p_lower,
+							Node **p_upper)
+{
+	OpExpr	   *op = (OpExpr *)rinfo->clause;
+	Node	   *left;
+	Node	   *right;
+	Node	   *other;
+	Var		   *var;
+	TypeCacheEntry *tcache;
+	int			strategy;
+
+	if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+		return false;	/* binary operator */
+
+	left = (Node *) linitial(op->args);
+	right = (Node *) lsecond(op->args);
+	if (exprType(left) != exprType(right))
+		return false;	/* type not compatible */
+	if (IsA(left, RelabelType))
+		left = (Node *)((RelabelType *)left)->arg;
+	if (IsA(right, RelabelType))
+		right = (Node *)((RelabelType *)right)->arg;
+
+	if (IsA(left, Var) &&
+		((Var *)left)->varno == baserel->relid &&
+		((Var *)left)->varattno == range_index &&
+		!bms_is_member(baserel->relid, rinfo->right_relids) &&
+		!contain_volatile_functions(right))
+	{
+		/* Left-VAR OP Right-Expression */
+		var = (Var *)left;
+		other = right;
+	}
+	else if (IsA(right, Var) &&
+			 ((Var *)right)->varno == baserel->relid &&
+			 ((Var *)right)->varattno == range_index &&
+			 !bms_is_member(baserel->relid, rinfo->left_relids) &&
+			 !contain_volatile_functions(left))
+	{
+		/* Left-Expression OP Right-Var */
+		var = (Var *)right;
+		other = left;
+	}
+	else
+		return false;
+
+	tcache = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(tcache->btree_opf))
+		return false;
+	strategy = get_op_opfamily_strategy(op->opno, tcache->btree_opf);
+	if ((Node *)var == right)
+	{
+		/* commute the strategy */
+		if (strategy == BTLessStrategyNumber)
+			strategy = BTGreaterStrategyNumber;
+		else if (strategy == BTLessEqualStrategyNumber)
+			strategy = BTGreaterEqualStrategyNumber;
+		else if (strategy == BTGreaterEqualStrategyNumber)
+			strategy = BTLessEqualStrategyNumber;
+		else if (strategy == BTGreaterStrategyNumber)
+			strategy = BTLessStrategyNumber;
+	}
+
+	switch (strategy)
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+			if (*p_upper)
+				return false;
+			*p_upper = other;
+			break;
+		case BTEqualStrategyNumber:
+			if (*p_lower || *p_upper)
+				return false;
+			*p_lower = other;
+			*p_upper = other;
+			break;
+		case BTGreaterEqualStrategyNumber:
+		case BTGreaterStrategyNumber:
+			if (*p_lower)
+				return false;
+			*p_lower = other;
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+/*
+ * baseRelHasGstorePrimaryKeyLookup
+ *
+ * It checks whether the scan on Gstore_Fdw is a lookup by the primary key;
+ * that is served by the host-side hash-index much faster than GPU.
+ */
+bool
+baseRelHasGstorePrimaryKeyLookup(PlannerInfo *root, RelOptInfo *baserel)
+{
+	GpuStoreDesc   *gs_desc;
+	AttrNumber		primary_key;
+	ListCell	   *lc;
+
+	if (!baseRelIsGstoreFdw(baserel))
+		return false;
+	if (!baserel->fdw_private)
+	{
+		RangeTblEntry *rte = root->simple_rte_array[baserel->relid];
+
+		GstoreGetForeignRelSize(root, baserel, rte->relid);
+	}
+	gs_desc = baserel->fdw_private;
+	primary_key = gs_desc->gs_sstate->primary_key;
+	if (primary_key <= 0)
+		return false;
+	foreach (lc, baserel->baserestrictinfo)
+	{
+		RestrictInfo   *rinfo = lfirst(lc);
+
+		if (match_clause_to_primary_key(root, baserel, rinfo, primary_key))
+			return true;
+	}
+	return false;
+}
+
 /*
  * GetOptimalGpuForGstoreFdw
  */
@@ -497,6 +758,7 @@ GstoreGetForeignPaths(PlannerInfo *root,
 	GpuStoreDesc   *gs_desc = baserel->fdw_private;
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
 	AttrNumber		primary_key = gs_sstate->primary_key;
+	AttrNumber		range_index = gs_sstate->range_index;
 	Relids			required_outer = baserel->lateral_relids;
 	ParamPathInfo  *param_info;
 	ForeignPath	   *fpath;
@@ -532,7 +794,12 @@ GstoreGetForeignPaths(PlannerInfo *root,
 	else
 		qual_cost = baserel->baserestrictcost;
 	if (indexExpr)
-		ntuples = 1.0;
+	{
+		if (type_is_array(exprType(indexExpr)))
+			ntuples = Min(estimate_array_length(indexExpr), baserel->tuples);
+		else
+			ntuples = 1.0;
+	}
 	startup_cost += qual_cost.startup;
 	startup_cost += baserel->reltarget->cost.startup;
 	run_cost += (cpu_tuple_cost + qual_cost.per_tuple) * ntuples;
@@ -549,7 +816,82 @@ GstoreGetForeignPaths(PlannerInfo *root,
 									NULL,	/* no extra plan */
 									list_make1(indexExpr));
 	add_path(baserel, (Path *)fpath);
-	
+
+	/*
+	 * Range index scan, if any range clauses or ORDER BY on the key column.
+	 * Its fdw_private has three items (NULL, lower and upper bound) to be
+	 * distinguished from the above paths.
+	 */
+	if (range_index > 0 && !indexExpr)
+	{
+		Node	   *lower = NULL;
+		Node	   *upper = NULL;
+		List	   *pathkeys = NIL;
+		Selectivity	selectivity = 1.0;
+		TypeCacheEntry *tcache;
+		Oid			atttypid;
+		int32		atttypmod;
+		Oid			attcollid;
+
+		foreach (lc, baserel->baserestrictinfo)
+		{
+			RestrictInfo   *rinfo = lfirst(lc);
+
+			if (match_clause_to_range_index(root,
+											baserel,
+											rinfo,
+											range_index,
+											&lower, &upper))
+				selectivity *= clause_selectivity(root,
+												  (Node *)rinfo,
+												  0,
+												  JOIN_INNER,
+												  NULL);
+		}
+		get_atttypetypmodcoll(foreigntableid, range_index,
+							  &atttypid, &atttypmod, &attcollid);
+		tcache = lookup_type_cache(atttypid, TYPECACHE_LT_OPR);
+		if (OidIsValid(tcache->lt_opr))
+		{
+			Var	   *var = makeVar(baserel->relid,
+								  range_index,
+								  atttypid,
+								  atttypmod,
+								  attcollid,
+								  0);
+			pathkeys = build_expression_pathkey(root,
+												(Expr *)var,
+												NULL,
+												tcache->lt_opr,
+												baserel->relids,
+												false);
+		}
+
+		if (lower || upper || pathkeys != NIL)
+		{
+			ntuples = Max(baserel->tuples * selectivity, 1.0);
+			startup_cost = qual_cost.startup + baserel->reltarget->cost.startup;
+			if (!gstore_fdw_enabled)
+				startup_cost += disable_cost;
+			/* binary search on the range index */
+			startup_cost += cpu_operator_cost *
+				ceil(log(Max(baserel->tuples, 2.0)) / log(2.0));
+			run_cost = ((cpu_tuple_cost + qual_cost.per_tuple) * ntuples +
+						baserel->reltarget->cost.per_tuple * baserel->rows);
+
+			fpath = create_foreignscan_path(root,
+											baserel,
+											NULL,	/* default pathtarget */
+											baserel->rows,
+											startup_cost,
+											startup_cost + run_cost,
+											pathkeys,
+											required_outer,
+											NULL,	/* no extra plan */
+											list_make3(NULL, lower, upper));
+			add_path(baserel, (Path *)fpath);
+		}
+	}
 	//TODO: parameterized paths
 }
 
@@ -964,6 +1306,12 @@ gstoreFdwApplyRedoDeviceBuffer(GpuStoreSharedState *gs_sstate)
 	/* see  __gstoreFdwAppendRedoLog */
 	SpinLockAcquire(&gs_sstate->redo_pos_lock);
 	end_pos = gs_sstate->redo_write_pos;
+	if (end_pos <= gs_sstate->redo_read_pos)
+	{
+		/* already applied, e.g, by the continuous mode */
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+		return CUDA_SUCCESS;
+	}
 	SpinLockRelease(&gs_sstate->redo_pos_lock);
 
 	return gstoreFdwInvokeApplyRedo(gs_sstate->ftable_oid, end_pos,
@@ -1024,11 +1372,20 @@ __ExecInitGstoreFdw(ScanState *ss, Bitmapset *outer_refs, Expr *indexExpr,
 	pg_atomic_init_u64(&fdw_state->__read_pos, 0);
 	fdw_state->read_pos = &fdw_state->__read_pos;
 	fdw_state->nitems = gs_desc->base_mmap->schema.nitems;
+	fdw_state->data_version = pg_atomic_read_u64(&gs_desc->gs_sstate->data_version);
+	pg_memory_barrier();
+	if (IsMVCCSnapshot(ss->ps.state->es_snapshot))
+		fdw_state->snapshot_xmin = ss->ps.state->es_snapshot->xmin;
+	else
+		fdw_state->snapshot_xmin = InvalidTransactionId;
 	fdw_state->last_rowid = UINT_MAX;
 	fdw_state->is_first = true;
 	fdw_state->referenced = referenced;
 	if (indexExpr != NULL)
+	{
 		fdw_state->indexExprState = ExecInitExpr(indexExpr, &ss->ps);
+		fdw_state->index_is_array = type_is_array(exprType((Node *)indexExpr));
+	}
 	/* synchronize device buffer prior to the kernel call */
 	if (apply_redo_log)
 		gstoreFdwApplyRedoDeviceBuffer(gs_desc->gs_sstate);
@@ -1049,6 +1406,7 @@ static void
 GstoreBeginForeignScan(ForeignScanState *node, int eflags)
 {
 	ForeignScan	   *fscan = (ForeignScan *)node->ss.ps.plan;
+	GpuStoreFdwState *fdw_state;
 	Bitmapset	   *outer_refs = NULL;
 	Expr		   *indexExpr = NULL;
 	ListCell	   *lc;
@@ -1064,7 +1422,21 @@ GstoreBeginForeignScan(ForeignScanState *node, int eflags)
 	if (fscan->fdw_exprs != NIL)
 		indexExpr = linitial(fscan->fdw_exprs);
 
-	node->fdw_state = __ExecInitGstoreFdw(&node->ss, outer_refs, indexExpr, false);
+	fdw_state = __ExecInitGstoreFdw(&node->ss, outer_refs, indexExpr, false);
+	/* range index scan has (NULL, lower bound, upper bound) */
+	if (list_length(fscan->fdw_exprs) == 3)
+	{
+		Expr   *lower = lsecond(fscan->fdw_exprs);
+		Expr   *upper = lthird(fscan->fdw_exprs);
+
+		Assert(!indexExpr && fdw_state->gs_desc->gs_sstate->range_index > 0);
+		fdw_state->range_scan = true;
+		if (lower)
+			fdw_state->rangeLowerState = ExecInitExpr(lower, &node->ss.ps);
+		if (upper)
+			fdw_state->rangeUpperState = ExecInitExpr(upper, &node->ss.ps);
+	}
+	node->fdw_state = fdw_state;
 }
 
 /*
@@ -1222,101 +1594,237 @@ __gstoreFillupTupleTableSlot(TupleTableSlot *slot,
 	return slot;
 }
 
-static TupleTableSlot *
-__gstoreIterateForeignIndexScan(ForeignScanState *node)
+/*
+ * gstoreFdwLookupPrimaryKey
+ *
+ * It returns the rowids whose primary key matches any of the @keys,
+ * regardless of the visibility. If primary key is fixed-length, it walks
+ * on the hash-slot without the hash_slot_lock; concurrent updates of the
+ * slot are detected by hash_slot_seqno, then retried. Elsewhere, varlena
+ * keys may be partially overwritten during the comparison, so the lock is
+ * acquired as usual.
+ */
+#define GSTORE_HASH_SLOT_MAX_RETRIES	100
+
+static int
+__gstoreWalkHashSlot(GpuStoreDesc *gs_desc, TypeCacheEntry *tcache,
+					 Datum key, Datum hash, cl_uint *rowids, int nrooms)
 {
-	Relation		frel __attribute__((unused))
-		= node->ss.ss_currentRelation;
-	EState		   *estate = node->ss.ps.state;
-	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
-	GpuStoreFdwState *fdw_state = node->fdw_state;
-	GpuStoreDesc   *gs_desc = fdw_state->gs_desc;
-	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
 	GpuStoreHashIndexHead *hash_index = gs_desc->hash_index;
 	kern_data_store *kds = &gs_desc->base_mmap->schema;
-	kern_colmeta *cmeta = &kds->colmeta[gs_sstate->primary_key - 1];
-	cl_uint		   *rowmap;
+	kern_colmeta   *cmeta = &kds->colmeta[gs_desc->gs_sstate->primary_key - 1];
+	cl_uint		   *rowmap = &hash_index->slots[hash_index->nslots];
+	cl_uint			curr_id;
+	cl_uint			count = 0;
+	int				nitems = 0;
+
+	for (curr_id = hash_index->slots[hash % hash_index->nslots];
+		 curr_id < hash_index->nrooms && count < hash_index->nrooms;
+		 curr_id = rowmap[curr_id], count++)
+	{
+		Datum	vdatum;
+		bool	isnull;
+
+		vdatum = KDS_fetch_datum_column(kds, cmeta, curr_id, &isnull);
+		if (!isnull && DatumGetBool(FunctionCall2(&tcache->eq_opr_finfo,
+												  key, vdatum)))
+		{
+			if (nitems < nrooms)
+				rowids[nitems] = curr_id;
+			nitems++;
+		}
+	}
+	return nitems;
+}
+
+static int
+__compare_rowids(const void *a, const void *b)
+{
+	cl_uint		x = *((const cl_uint *)a);
+	cl_uint		y = *((const cl_uint *)b);
+
+	return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+static cl_uint *
+gstoreFdwLookupPrimaryKey(GpuStoreDesc *gs_desc,
+						  Datum *keys, int nkeys,
+						  cl_uint *p_nitems)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	kern_data_store *kds = &gs_desc->base_mmap->schema;
+	kern_colmeta   *cmeta = &kds->colmeta[gs_sstate->primary_key - 1];
 	TypeCacheEntry *tcache;
-	cl_uint			rowid = UINT_MAX;
-	Datum			kdatum;
-	Datum			vdatum;
-	Datum			hash;
-	bool			isnull;
-	GstoreFdwSysattr sysattr;
+	cl_uint		   *rowids;
+	int				nrooms = Max(nkeys, 8);
+	int				nitems = 0;
+	int				i;
 
-	Assert(hash_index != NULL &&
-		   gs_sstate->primary_key > 0 &&
-		   gs_sstate->primary_key <= RelationGetNumberOfAttributes(frel));
-	if (pg_atomic_fetch_add_u64(fdw_state->read_pos, 1) > 0)
-		return NULL;
-	rowmap = &hash_index->slots[hash_index->nslots];
-		
-	/* extract the key value */
-	kdatum = ExecEvalExpr(fdw_state->indexExprState,
-						  node->ss.ps.ps_ExprContext,
-						  &isnull);
-	if (isnull)
-		return NULL;
-	/* calculation of hash-value */
 	tcache = lookup_type_cache(cmeta->atttypid,
 							   TYPECACHE_HASH_PROC_FINFO |
 							   TYPECACHE_EQ_OPR_FINFO);
-	hash = FunctionCall1(&tcache->hash_proc_finfo, kdatum);
-
-	/* walk on the hash-table */
-	gstoreFdwSpinLockHashSlot(gs_desc, hash);
-	PG_TRY();
+	rowids = palloc(sizeof(cl_uint) * nrooms);
+	for (i=0; i < nkeys; i++)
 	{
-		GstoreFdwSysattr __sysattr;
-		cl_uint		curr_id;
+		Datum		hash = FunctionCall1(&tcache->hash_proc_finfo, keys[i]);
+		cl_uint		lindex = gstoreFdwHashSlotLockIndex(gs_desc, hash);
+		bool		use_lock = (cmeta->attlen <= 0);
+		int			nretries = 0;
+		volatile int nmatch;
 
-		curr_id = hash_index->slots[hash % hash_index->nslots];
-		while (curr_id < hash_index->nrooms)
+		for (;;)
 		{
-			gstoreFdwSpinLockBaseRow(gs_desc, curr_id);
-			PG_TRY();
+			if (!use_lock)
 			{
-				if (gstoreCheckVisibilityForRead(gs_desc, curr_id,
-												 estate->es_snapshot,
-												 &__sysattr))
+				uint32		seqno;
+
+				seqno = pg_atomic_read_u32(&gs_sstate->hash_slot_seqno[lindex]);
+				if ((seqno & 1) == 0)
 				{
-					vdatum = KDS_fetch_datum_column(kds, cmeta,
-													curr_id,
-													&isnull);
-					if (!isnull && FunctionCall2(&tcache->eq_opr_finfo,
-												 kdatum, vdatum))
-					{
-						if (rowid != UINT_MAX)
-							elog(ERROR, "index corruption? duplicate primary key");
-						rowid = curr_id;
-						sysattr = __sysattr;
-					}
+					pg_read_barrier();
+					nmatch = __gstoreWalkHashSlot(gs_desc, tcache,
+												  keys[i], hash,
+												  rowids + nitems,
+												  nrooms - nitems);
+					pg_read_barrier();
+					if (pg_atomic_read_u32(&gs_sstate->hash_slot_seqno[lindex]) != seqno)
+						nmatch = -1;	/* concurrent update, retry */
+				}
+				else
+				{
+					nmatch = -1;		/* now locked, retry */
+					SPIN_DELAY();
 				}
+				/* give up lock-free walk if slot is updated frequently */
+				if (nmatch < 0 && ++nretries >= GSTORE_HASH_SLOT_MAX_RETRIES)
+					use_lock = true;
 			}
-			PG_CATCH();
+			else
 			{
-				gstoreFdwSpinUnlockBaseRow(gs_desc, curr_id);
-				PG_RE_THROW();
+				gstoreFdwSpinLockHashSlot(gs_desc, hash);
+				PG_TRY();
+				{
+					nmatch = __gstoreWalkHashSlot(gs_desc, tcache,
+												  keys[i], hash,
+												  rowids + nitems,
+												  nrooms - nitems);
+				}
+				PG_CATCH();
+				{
+					gstoreFdwSpinUnlockHashSlot(gs_desc, hash);
+					PG_RE_THROW();
+				}
+				PG_END_TRY();
+				gstoreFdwSpinUnlockHashSlot(gs_desc, hash);
 			}
-			PG_END_TRY();
-			gstoreFdwSpinUnlockBaseRow(gs_desc, curr_id);
 
-			curr_id = rowmap[curr_id];
+			if (nmatch < 0)
+				continue;
+			if (nitems + nmatch <= nrooms)
+			{
+				nitems += nmatch;
+				break;
+			}
+			/* buffer is too small, so walk again */
+			nrooms = 2 * (nitems + nmatch);
+			rowids = repalloc(rowids, sizeof(cl_uint) * nrooms);
+		}
+	}
+	/* remove duplicated rowids, if PK = ANY(ARRAY) has same keys */
+	if (nkeys > 1 && nitems > 1)
+	{
+		int		j = 0;
+
+		qsort(rowids, nitems, sizeof(cl_uint), __compare_rowids);
+		for (i=1; i < nitems; i++)
+		{
+			if (rowids[i] != rowids[j])
+				rowids[++j] = rowids[i];
 		}
+		nitems = j + 1;
 	}
-	PG_CATCH();
+	*p_nitems = nitems;
+
+	return rowids;
+}
+
+static TupleTableSlot *
+__gstoreIterateForeignIndexScan(ForeignScanState *node)
+{
+	Relation		frel __attribute__((unused))
+		= node->ss.ss_currentRelation;
+	EState		   *estate = node->ss.ps.state;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	GpuStoreFdwState *fdw_state = node->fdw_state;
+	GpuStoreDesc   *gs_desc = fdw_state->gs_desc;
+	GpuStoreSharedState *gs_sstate __attribute__((unused)) = gs_desc->gs_sstate;
+	cl_uint			index;
+	bool			visible;
+	GstoreFdwSysattr sysattr;
+
+	Assert(gs_desc->hash_index != NULL &&
+		   gs_sstate->primary_key > 0 &&
+		   gs_sstate->primary_key <= RelationGetNumberOfAttributes(frel));
+	if (!fdw_state->index_rowids)
 	{
-		gstoreFdwSpinUnlockHashSlot(gs_desc, hash);
-		PG_RE_THROW();
+		Datum		kdatum;
+		bool		isnull;
+
+		/* extract the key value(s) */
+		kdatum = ExecEvalExpr(fdw_state->indexExprState,
+							  node->ss.ps.ps_ExprContext,
+							  &isnull);
+		if (isnull)
+		{
+			fdw_state->index_rowids = palloc(sizeof(cl_uint));
+			fdw_state->index_nitems = 0;
+		}
+		else if (!fdw_state->index_is_array)
+		{
+			fdw_state->index_rowids =
+				gstoreFdwLookupPrimaryKey(gs_desc, &kdatum, 1,
+										  &fdw_state->index_nitems);
+		}
+		else
+		{
+			ArrayType  *array = DatumGetArrayTypeP(kdatum);
+			int16		typlen;
+			bool		typbyval;
+			char		typalign;
+			Datum	   *elems;
+			bool	   *nulls;
+			int			i, nelems, nkeys = 0;
+
+			get_typlenbyvalalign(ARR_ELEMTYPE(array),
+								 &typlen, &typbyval, &typalign);
+			deconstruct_array(array, ARR_ELEMTYPE(array),
+							  typlen, typbyval, typalign,
+							  &elems, &nulls, &nelems);
+			for (i=0; i < nelems; i++)
+			{
+				if (!nulls[i])
+					elems[nkeys++] = elems[i];
+			}
+			fdw_state->index_rowids =
+				gstoreFdwLookupPrimaryKey(gs_desc, elems, nkeys,
+										  &fdw_state->index_nitems);
+		}
 	}
-	PG_END_TRY();
-	gstoreFdwSpinUnlockHashSlot(gs_desc, hash);
 
-	if (rowid == UINT_MAX)
-		return NULL;	/* not found */
+	do {
+		index = pg_atomic_fetch_add_u64(fdw_state->read_pos, 1);
+		if (index >= fdw_state->index_nitems)
+			return NULL;
+		index = fdw_state->index_rowids[index];
+		gstoreFdwSpinLockBaseRow(gs_desc, index);
+		visible = gstoreCheckVisibilityForRead(gs_desc, index,
+											   estate->es_snapshot,
+											   &sysattr);
+		gstoreFdwSpinUnlockBaseRow(gs_desc, index);
+	} while (!visible);
 
 	return __gstoreFillupTupleTableSlot(slot, gs_desc,
-										rowid, &sysattr,
+										index, &sysattr,
 										fdw_state);
 }
 
@@ -1352,22 +1860,95 @@ __gstoreIterateForeignSeqScan(ForeignScanState *node)
 }
 
 static TupleTableSlot *
-GstoreIterateForeignScan(ForeignScanState *node)
+__gstoreIterateForeignRangeScan(ForeignScanState *node)
 {
+	EState		   *estate = node->ss.ps.state;
+	ExprContext	   *econtext = node->ss.ps.ps_ExprContext;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
 	GpuStoreFdwState *fdw_state = node->fdw_state;
+	GpuStoreDesc   *gs_desc = fdw_state->gs_desc;
+	cl_uint			index;
+	bool			visible;
+	GstoreFdwSysattr sysattr;
 
-	ExecClearTuple(node->ss.ss_ScanTupleSlot);
-	if (fdw_state->indexExprState)
-		return __gstoreIterateForeignIndexScan(node);
-	else
-		return __gstoreIterateForeignSeqScan(node);
-}
+	if (!fdw_state->range_rowids)
+	{
+		Datum		lower = 0;
+		Datum		upper = 0;
+		bool		isnull;
 
-void
-ExecReScanGstoreFdw(GpuStoreFdwState *fdw_state)
-{
-	pg_atomic_write_u64(fdw_state->read_pos, 0);
-}
+		/* extract the lower/upper bounds */
+		if (fdw_state->rangeLowerState)
+		{
+			lower = ExecEvalExpr(fdw_state->rangeLowerState,
+								 econtext, &isnull);
+			if (isnull)
+				return NULL;
+		}
+		if (fdw_state->rangeUpperState)
+		{
+			upper = ExecEvalExpr(fdw_state->rangeUpperState,
+								 econtext, &isnull);
+			if (isnull)
+				return NULL;
+		}
+		fdw_state->range_rowids =
+			gstoreFdwLookupRangeIndex(gs_desc,
+									  fdw_state->rangeLowerState != NULL, lower,
+									  fdw_state->rangeUpperState != NULL, upper,
+									  &fdw_state->range_nitems);
+	}
+
+	do {
+		index = pg_atomic_fetch_add_u64(fdw_state->read_pos, 1);
+		if (index >= fdw_state->range_nitems)
+			return NULL;
+		index = fdw_state->range_rowids[index];
+		gstoreFdwSpinLockBaseRow(gs_desc, index);
+		visible = gstoreCheckVisibilityForRead(gs_desc, index,
+											   estate->es_snapshot,
+											   &sysattr);
+		gstoreFdwSpinUnlockBaseRow(gs_desc, index);
+	} while (!visible);
+
+	return __gstoreFillupTupleTableSlot(slot, gs_desc,
+										index, &sysattr,
+										fdw_state);
+}
+
+static TupleTableSlot *
+GstoreIterateForeignScan(ForeignScanState *node)
+{
+	GpuStoreFdwState *fdw_state = node->fdw_state;
+
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	if (fdw_state->indexExprState)
+		return __gstoreIterateForeignIndexScan(node);
+	else if (fdw_state->range_scan)
+		return __gstoreIterateForeignRangeScan(node);
+	else
+		return __gstoreIterateForeignSeqScan(node);
+}
+
+void
+ExecReScanGstoreFdw(GpuStoreFdwState *fdw_state)
+{
+	pg_atomic_write_u64(fdw_state->read_pos, 0);
+	/* key of index scan shall be re-evaluated */
+	if (fdw_state->index_rowids)
+	{
+		pfree(fdw_state->index_rowids);
+		fdw_state->index_rowids = NULL;
+		fdw_state->index_nitems = 0;
+	}
+	/* bounds of range index scan shall be re-evaluated */
+	if (fdw_state->range_rowids)
+	{
+		pfree(fdw_state->range_rowids);
+		fdw_state->range_rowids = NULL;
+		fdw_state->range_nitems = 0;
+	}
+}
 
 static void
 GstoreReScanForeignScan(ForeignScanState *node)
@@ -1387,6 +1968,69 @@ GstoreEndForeignScan(ForeignScanState *node)
 	ExecEndGstoreFdw((GpuStoreFdwState *)node->fdw_state);
 }
 
+/*
+ * ExecGstoreFdwDataVersion
+ *
+ * It appends the version of the visible contents of the gstore table.
+ * It returns false if the contents are not stable; some transaction is
+ * committing or committed after the BeginScan, or the current transaction
+ * has its own modification.
+ */
+bool
+ExecGstoreFdwDataVersion(GpuStoreFdwState *fdw_state, StringInfo buf)
+{
+	GpuStoreSharedState *gs_sstate = fdw_state->gs_desc->gs_sstate;
+	uint32			revision;
+	uint64			data_version;
+
+	if (!ExecGstoreFdwGetDataVersion(fdw_state, &revision, &data_version))
+		return false;
+	appendStringInfo(buf, "[%u:%u:" UINT64_FORMAT "]",
+					 gs_sstate->ftable_oid,
+					 revision,
+					 data_version);
+	return true;
+}
+
+/*
+ * ExecGstoreFdwGetDataVersion
+ *
+ * Same as above, but returns the revision of the base file and the version
+ * of the contents in binary.
+ */
+bool
+ExecGstoreFdwGetDataVersion(GpuStoreFdwState *fdw_state,
+							uint32 *p_revision, uint64 *p_data_version)
+{
+	GpuStoreDesc   *gs_desc = fdw_state->gs_desc;
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	uint64			data_version;
+	TransactionId	xid;
+
+	if (!dlist_is_empty(&gs_desc->gs_undo_logs))
+		return false;
+	/*
+	 * The transaction snapshot may be older than the data_version, and
+	 * the statement snapshot may be taken prior to the last commit.
+	 */
+	if (IsolationUsesXactSnapshot() ||
+		!TransactionIdIsValid(fdw_state->snapshot_xmin))
+		return false;
+	pg_memory_barrier();
+	data_version = pg_atomic_read_u64(&gs_sstate->data_version);
+	if ((data_version & 1) != 0 ||
+		data_version != fdw_state->data_version)
+		return false;
+	pg_read_barrier();
+	xid = pg_atomic_read_u32(&gs_sstate->data_version_xid);
+	if (TransactionIdIsNormal(xid) &&
+		!TransactionIdPrecedes(xid, fdw_state->snapshot_xmin))
+		return false;
+	*p_revision = gs_sstate->base_mmap_revision;
+	*p_data_version = data_version;
+	return true;
+}
+
 /*
  * NOTE: Right now, gstore_fdw does not support CPU parallel because
  *       it makes little sense. So, routines below are just dummy.
@@ -1424,32 +2068,66 @@ ExecShutdownGstoreFdw(GpuStoreFdwState *fdw_state)
 	/* nothing to do */
 }
 
+/*
+ * __gstoreFdwUpdateCheckpoint
+ *
+ * It records the offset of the redo log file where the recovery process
+ * starts replay, on the header of the base file. Caller must ensure the
+ * base file is already synchronized with the redo logs prior to the offset.
+ */
+static void
+__gstoreFdwUpdateCheckpoint(GpuStoreDesc *gs_desc, uint64 checkpoint_offset)
+{
+	GpuStoreBaseFileHead *base_mmap = gs_desc->base_mmap;
+
+	base_mmap->checkpoint_offset = checkpoint_offset;
+	if (gs_desc->base_mmap_is_pmem)
+		pmem_persist(&base_mmap->checkpoint_offset, sizeof(uint64));
+	else if (pmem_msync(&base_mmap->checkpoint_offset, sizeof(uint64)) != 0)
+		elog(WARNING, "failed on pmem_msync('%s'): %m",
+			 gs_desc->gs_sstate->base_file);
+}
+
+/*
+ * __gstoreFdwAppendRedoLog
+ *
+ * It reserves a region of the redo log buffer under the redo_pos_lock, then
+ * copies the log outside of the lock, so concurrent writers can fill up their
+ * own regions in parallel. The redo_write_pos is advanced in order of the
+ * reservation once the log is written, so readers never see logs in-progress.
+ */
 static uint64
 __gstoreFdwAppendRedoLog(GpuStoreDesc *gs_desc,
 						 GstoreTxLogCommon *tx_log)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
 	size_t		required = tx_log->length + sizeof(uint32);
+	uint64		reserved_pos = 0;
 	uint64		written_pos = 0;
+	char	   *dest_ptr = NULL;
 	bool		has_base_mmap_lock = false;
+	Latch	   *repl_latch[4];
+	int			repl_nwaits = 0;
+	SpinDelayStatus delay_status;
 
 	Assert(tx_log->length == MAXALIGN(tx_log->length));
 	if (required > gs_sstate->redo_log_limit)
 		elog(ERROR, "gstore_fdw: length of REDO must be larger than 'redo_log_limit'");
 	for (;;)
 	{
-		char	   *dest_ptr;
 		size_t		dest_pos;
 		size_t		len;
 
 		SpinLockAcquire(&gs_sstate->redo_pos_lock);
-		Assert(gs_sstate->redo_write_pos >= gs_sstate->redo_read_pos);
+		Assert(gs_sstate->redo_alloc_pos >= gs_sstate->redo_write_pos &&
+			   gs_sstate->redo_write_pos >= gs_sstate->redo_read_pos);
+		reserved_pos = gs_sstate->redo_alloc_pos;
 		/*
 		 * If this redo-log makes the write position rewound, we must ensure
 		 * the base_mmap is up-to-date prior to the overwrites of redo-log
 		 * buffer.
 		 */
-		dest_pos = gs_sstate->redo_write_pos % gs_sstate->redo_log_limit;
+		dest_pos = gs_sstate->redo_alloc_pos % gs_sstate->redo_log_limit;
 		if (dest_pos + required > gs_sstate->redo_log_limit)
 		{
 			struct timeval	tv1, tv2;
@@ -1464,9 +2142,14 @@ __gstoreFdwAppendRedoLog(GpuStoreDesc *gs_desc,
 				has_base_mmap_lock = true;
 				continue;
 			}
+			/*
+			 * The padding has no type, but its length tells the recovery
+			 * process to rewind to the head of the redo log buffer.
+			 */
 			len = gs_sstate->redo_log_limit - dest_pos;
 			memset(gs_desc->redo_mmap + dest_pos, 0, len);
-			gs_sstate->redo_write_pos += len;
+			((GstoreTxLogCommon *)(gs_desc->redo_mmap + dest_pos))->length = len;
+			gs_sstate->redo_alloc_pos += len;
 
 			/* checkpoint of the base file */
 			gettimeofday(&tv1, NULL);
@@ -1478,6 +2161,8 @@ __gstoreFdwAppendRedoLog(GpuStoreDesc *gs_desc,
 			{
 				elog(WARNING, "failed on pmem_msync('%s'): %m", gs_sstate->base_file);
 			}
+			__gstoreFdwUpdateCheckpoint(gs_desc, 0);
+			gs_sstate->redo_checkpoint_pos = gs_sstate->redo_alloc_pos;
 			gettimeofday(&tv2, NULL);
 
 			elog(LOG, "gstore_fdw: checkpoint applied on '%s' [%.2fms]",
@@ -1485,7 +2170,7 @@ __gstoreFdwAppendRedoLog(GpuStoreDesc *gs_desc,
 			dest_pos = 0;
 		}
 
-		len = gs_sstate->redo_write_pos - gs_sstate->redo_read_pos;
+		len = gs_sstate->redo_alloc_pos - gs_sstate->redo_read_pos;
 		if (len + required > gs_sstate->redo_log_limit)
 		{
 			/*
@@ -1534,15 +2219,51 @@ __gstoreFdwAppendRedoLog(GpuStoreDesc *gs_desc,
 			}
 		}
 		dest_ptr = gs_desc->redo_mmap + dest_pos;
-		gs_sstate->redo_write_pos += tx_log->length;
-		gs_sstate->redo_write_nitems++;
-		memcpy(dest_ptr, tx_log, tx_log->length);
-		written_pos = gs_sstate->redo_write_pos;
+		gs_sstate->redo_alloc_pos += tx_log->length;
+		written_pos = gs_sstate->redo_alloc_pos;
+		/*
+		 * The terminator next to the last log tells the tail of redo log
+		 * to the recovery process. The next writer overwrites it after
+		 * the reservation, so it never breaks the logs of others.
+		 */
+		*((uint32 *)(dest_ptr + tx_log->length)) = GSTORE_TX_LOG__TERMINATOR;
 		SpinLockRelease(&gs_sstate->redo_pos_lock);
 		break;
 	}
+	/* write out the redo-log on the reserved region */
+	memcpy(dest_ptr, tx_log, tx_log->length);
+
+	/*
+	 * wait for the concurrent writers that reserved the prior regions.
+	 * No errors are raised between the reservation and here, so they
+	 * shall complete shortly.
+	 */
+	init_local_spin_delay(&delay_status);
+	while (((volatile GpuStoreSharedState *)gs_sstate)->redo_write_pos != reserved_pos)
+		perform_spin_delay(&delay_status);
+	finish_spin_delay(&delay_status);
+
+	SpinLockAcquire(&gs_sstate->redo_pos_lock);
+	Assert(gs_sstate->redo_write_pos == reserved_pos);
+	gs_sstate->redo_write_pos = written_pos;
+	gs_sstate->redo_write_nitems++;
+	/* wake up replicas that subscribe this redo log, on commit */
+	if (tx_log->type == GSTORE_TX_LOG__COMMIT)
+	{
+		int		i;
+
+		for (i=0; i < lengthof(gs_sstate->redo_repl_latch); i++)
+		{
+			if (gs_sstate->redo_repl_latch[i])
+				repl_latch[repl_nwaits++] = gs_sstate->redo_repl_latch[i];
+		}
+	}
+	SpinLockRelease(&gs_sstate->redo_pos_lock);
+
 	if (has_base_mmap_lock)
 		LWLockRelease(&gs_sstate->base_mmap_lock);
+	while (repl_nwaits > 0)
+		SetLatch(repl_latch[--repl_nwaits]);
 	return written_pos;
 }
 
@@ -1894,8 +2615,7 @@ __gstoreExecForeignModify(EState *estate,
 			/* new RowId allocation */
 			for (;;)
 			{
-				rowid = gstoreFdwAllocateRowId(gs_desc->gs_sstate,
-											   gs_desc->rowid_map);
+				rowid = gstoreFdwAllocateRowId(gs_desc);
 				if (rowid >= kds->nrooms)
 					elog(ERROR, "gstore_fdw: '%s' has no room to INSERT any rows %u",
 						 RelationGetRelationName(frel), rowid);
@@ -2022,6 +2742,36 @@ static void
 GstoreEndForeignModify(EState *estate, ResultRelInfo *rinfo)
 {}
 
+#if PG_VERSION_NUM >= 110000
+/*
+ * GstoreBeginForeignInsert
+ *
+ * It allows tuple-routing of INSERT/COPY, if Gstore_Fdw foreign tables are
+ * attached to a partitioned table. Each partition can have its own
+ * gpu_device_id, thus, a partitioned table works as a sharded GPU store;
+ * every partition has its own base file, redo log and primary-key index,
+ * and scan on the individual partition runs on its own GPU device.
+ */
+static void
+GstoreBeginForeignInsert(ModifyTableState *mtstate,
+						 ResultRelInfo *rinfo)
+{
+	GpuStoreFdwModify *gs_mstate = palloc0(sizeof(GpuStoreFdwModify));
+	Relation	frel = rinfo->ri_RelationDesc;
+
+	gs_mstate->gs_desc = gstoreFdwLookupGpuStoreDesc(frel);
+	gs_mstate->updatedCols = NULL;
+	gs_mstate->oldestXmin = GetOldestXmin(frel, PROCARRAY_FLAGS_VACUUM);
+	gs_mstate->ctid_attno = InvalidAttrNumber;
+	gs_mstate->gs_undo = gstoreFdwLookupUndoLogs(gs_mstate->gs_desc);
+	rinfo->ri_FdwState = gs_mstate;
+}
+
+static void
+GstoreEndForeignInsert(EState *estate, ResultRelInfo *rinfo)
+{}
+#endif
+
 void
 ExplainGstoreFdw(GpuStoreFdwState *fdw_state,
 				 Relation frel, ExplainState *es)
@@ -2066,11 +2816,36 @@ ExplainGstoreFdw(GpuStoreFdwState *fdw_state,
 		Assert(gs_sstate->primary_key > 0 &&
 			   gs_sstate->primary_key <= tupdesc->natts);
 		attr = tupleDescAttr(tupdesc, gs_sstate->primary_key - 1);
-		appendStringInfo(&buf, "%s = %s",
+		appendStringInfo(&buf, (fdw_state->index_is_array
+								 ? "%s = ANY(%s)"
+								 : "%s = %s"),
 						 quote_identifier(NameStr(attr->attname)),
 						 deparse_expression(indexExpr, dcontext, false, false));
 		ExplainPropertyText("Index Cond", buf.data, es);
 	}
+	else if (fdw_state->range_scan)
+	{
+		Form_pg_attribute attr;
+		const char *attname;
+
+		Assert(gs_sstate->range_index > 0 &&
+			   gs_sstate->range_index <= tupdesc->natts);
+		attr = tupleDescAttr(tupdesc, gs_sstate->range_index - 1);
+		attname = quote_identifier(NameStr(attr->attname));
+		if (fdw_state->rangeLowerState)
+			appendStringInfo(&buf, "%s >= %s", attname,
+							 deparse_expression((Node *)fdw_state->rangeLowerState->expr,
+												dcontext, false, false));
+		if (fdw_state->rangeUpperState)
+			appendStringInfo(&buf, "%s%s <= %s",
+							 buf.len > 0 ? " AND " : "", attname,
+							 deparse_expression((Node *)fdw_state->rangeUpperState->expr,
+												dcontext, false, false));
+		if (buf.len > 0)
+			ExplainPropertyText("Range Index Cond", buf.data, es);
+		else
+			ExplainPropertyText("Range Index", attname, es);
+	}
 
 	/* shows base&redo filename */
 	if (es->verbose)
@@ -2111,7 +2886,27 @@ pgstrom_gstore_fdw_validator(PG_FUNCTION_ARGS)
 	Oid			catalog = PG_GETARG_OID(1);
 	ListCell   *lc;
 
-	if (catalog != ForeignTableRelationId)
+	if (catalog == AttributeRelationId)
+	{
+		foreach (lc, options)
+		{
+			DefElem	   *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "compression") == 0)
+			{
+				char   *token = defGetString(def);
+
+				if (strcmp(token, "none") != 0 &&
+					strcmp(token, "dictionary") != 0)
+					elog(ERROR, "compression = '%s' is not supported", token);
+			}
+			else
+				elog(ERROR, "unknown FDW options at columns: %s",
+					 def->defname);
+		}
+		PG_RETURN_VOID();
+	}
+	else if (catalog != ForeignTableRelationId)
 	{
 		if (options != NIL)
 			elog(ERROR, "unknown FDW options");
@@ -2181,10 +2976,32 @@ pgstrom_gstore_fdw_validator(PG_FUNCTION_ARGS)
 				elog(ERROR, "'%s' is not a valid configuration for '%s'",
 					 token, def->defname);
 		}
-		else if (strcmp(def->defname, "primary_key") == 0)
+		else if (strcmp(def->defname, "redo_sync_delay") == 0)
+		{
+			char   *token = defGetString(def);
+			long	delay = strtol(token, &endp, 10);
+
+			if (delay < 0 || delay > GSTORE_REDO_SYNC_DELAY_MAX || *endp != '\0')
+				elog(ERROR, "'%s' is not a valid configuration for '%s'",
+					 token, def->defname);
+		}
+		else if (strcmp(def->defname, "primary_key") == 0 ||
+				 strcmp(def->defname, "range_index") == 0 ||
+				 strcmp(def->defname, "aggview_keys") == 0 ||
+				 strcmp(def->defname, "aggview_targets") == 0)
 		{
 			/* column name shall be validated later */
 		}
+		else if (strcmp(def->defname, "aggview_max_groups") == 0)
+		{
+			char   *token = defGetString(def);
+			long	ngroups = strtol(token, &endp, 10);
+
+			if (ngroups <= 0 || ngroups > GSTORE_AGGVIEW_MAX_GROUPS ||
+				*endp != '\0')
+				elog(ERROR, "'%s' is not a valid configuration for '%s'",
+					 token, def->defname);
+		}
 		else if (strcmp(def->defname, "preserve_files") == 0)
 		{
 			/* boolean values */
@@ -2201,6 +3018,163 @@ pgstrom_gstore_fdw_validator(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_gstore_fdw_validator);
 
+static Form_pg_attribute
+__gstoreFdwLookupAggViewColumn(TupleDesc tupdesc, char *name,
+							   const char *option)
+{
+	size_t		len = strlen(name);
+	int			j;
+
+	if (len >= 2 && name[0] == '"' && name[len-1] == '"')
+	{
+		name[len-1] = '\0';
+		name++;
+	}
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc,j);
+
+		if (!attr->attisdropped &&
+			strcmp(name, NameStr(attr->attname)) == 0)
+			return attr;
+	}
+	elog(ERROR, "'%s' specified by '%s' option not found", name, option);
+}
+
+/*
+ * gstoreFdwParseAggViewOptions
+ *
+ * It builds the definition of the aggregate view by the 'aggview_keys'
+ * (comma separated column names of the fixed-length and by-value types),
+ * 'aggview_targets' (comma separated count(*), count(X), sum(X), min(X)
+ * or max(X), where X is int2/int4/int8/float4/float8 except for count)
+ * and 'aggview_max_groups' options. ntargets = 0 means no aggregate view.
+ */
+static void
+gstoreFdwParseAggViewOptions(Relation frel,
+							 char *aggview_keys,
+							 char *aggview_targets,
+							 long aggview_max_groups,
+							 kern_gpustore_aggview *aggview)
+{
+	TupleDesc	tupdesc = RelationGetDescr(frel);
+	List	   *keys_list = NIL;
+	ListCell   *lc;
+	char	   *tok, *saveptr;
+
+	memset(aggview, 0, sizeof(kern_gpustore_aggview));
+	if (!aggview_targets)
+	{
+		if (aggview_keys)
+			elog(ERROR, "'aggview_keys' needs 'aggview_targets' option");
+		return;
+	}
+
+	if (aggview_keys)
+	{
+		if (!SplitIdentifierString(pstrdup(aggview_keys), ',', &keys_list))
+			elog(ERROR, "invalid aggview_keys: %s", aggview_keys);
+		if (list_length(keys_list) > GSTORE_AGGVIEW_MAX_KEYS)
+			elog(ERROR, "too many aggview_keys (up to %d)",
+				 GSTORE_AGGVIEW_MAX_KEYS);
+	}
+	foreach (lc, keys_list)
+	{
+		Form_pg_attribute attr;
+		kern_gpustore_aggview_attr *key = &aggview->keys[aggview->nkeys++];
+
+		attr = __gstoreFdwLookupAggViewColumn(tupdesc, lfirst(lc),
+											  "aggview_keys");
+		if (!attr->attbyval || attr->attlen <= 0)
+			elog(ERROR, "'aggview_keys' supports only fixed-length and by-value column, but '%s' is %s",
+				 NameStr(attr->attname), format_type_be(attr->atttypid));
+		key->colidx = attr->attnum - 1;
+		key->attlen = attr->attlen;
+		key->attfp = (attr->atttypid == FLOAT4OID ||
+					  attr->atttypid == FLOAT8OID);
+		key->aggfunc = 0;
+		key->atttypid = attr->atttypid;
+	}
+
+	for (tok = strtok_r(pstrdup(aggview_targets), ",", &saveptr);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &saveptr))
+	{
+		kern_gpustore_aggview_attr *target;
+		Form_pg_attribute attr;
+		char	   *fname = __trim(tok);
+		char	   *arg = strchr(fname, '(');
+		char	   *tail;
+
+		if (aggview->ntargets >= GSTORE_AGGVIEW_MAX_TARGETS)
+			elog(ERROR, "too many aggview_targets (up to %d)",
+				 GSTORE_AGGVIEW_MAX_TARGETS);
+		target = &aggview->targets[aggview->ntargets++];
+		tail = fname + strlen(fname) - 1;
+		if (!arg || *tail != ')')
+			elog(ERROR, "invalid aggview_targets: %s", aggview_targets);
+		*arg++ = '\0';
+		*tail = '\0';
+		fname = __trim(fname);
+		arg = __trim(arg);
+
+		if (strcasecmp(fname, "count") == 0 && strcmp(arg, "*") == 0)
+		{
+			target->colidx = -1;
+			target->aggfunc = GSTORE_AGGFUNC__NROWS;
+			target->atttypid = INT8OID;
+			continue;
+		}
+		attr = __gstoreFdwLookupAggViewColumn(tupdesc, arg,
+											  "aggview_targets");
+		target->colidx = attr->attnum - 1;
+		target->attlen = attr->attlen;
+		if (strcasecmp(fname, "count") == 0)
+		{
+			target->aggfunc = GSTORE_AGGFUNC__COUNT;
+			target->atttypid = INT8OID;
+			continue;
+		}
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+				target->attfp = false;
+				break;
+			case FLOAT4OID:
+			case FLOAT8OID:
+				target->attfp = true;
+				break;
+			default:
+				elog(ERROR, "'aggview_targets' supports only int2/int4/int8/float4/float8 for %s(), but '%s' is %s",
+					 fname, NameStr(attr->attname),
+					 format_type_be(attr->atttypid));
+		}
+		if (strcasecmp(fname, "sum") == 0)
+		{
+			target->aggfunc = GSTORE_AGGFUNC__SUM;
+			target->atttypid = (target->attfp ? FLOAT8OID : INT8OID);
+		}
+		else if (strcasecmp(fname, "min") == 0)
+		{
+			target->aggfunc = GSTORE_AGGFUNC__MIN;
+			target->atttypid = attr->atttypid;
+		}
+		else if (strcasecmp(fname, "max") == 0)
+		{
+			target->aggfunc = GSTORE_AGGFUNC__MAX;
+			target->atttypid = attr->atttypid;
+		}
+		else
+			elog(ERROR, "'aggview_targets' does not support %s()", fname);
+	}
+	if (aggview->ntargets == 0)
+		elog(ERROR, "invalid aggview_targets: %s", aggview_targets);
+	aggview->nrooms = aggview_max_groups;
+	aggview->nslots = aggview_max_groups + aggview_max_groups / 2 + 1;
+}
+
 static void
 gstoreFdwExtractOptions(Relation frel,
 						cl_int *p_cuda_dindex,
@@ -2210,7 +3184,11 @@ gstoreFdwExtractOptions(Relation frel,
 						size_t *p_redo_log_limit,
 						cl_long *p_gpu_update_interval,
 						size_t *p_gpu_update_threshold,
+						cl_long *p_redo_sync_delay,
 						AttrNumber *p_primary_key,
+						AttrNumber *p_range_index,
+						cl_uint *p_dict_columns,
+						kern_gpustore_aggview *p_aggview,
 						bool *p_preserve_files)
 {
 	ForeignTable *ft = GetForeignTable(RelationGetRelid(frel));
@@ -2223,8 +3201,14 @@ gstoreFdwExtractOptions(Relation frel,
 	ssize_t		redo_log_limit = (512U << 20);	/* default: 512MB */
 	cl_long		gpu_update_interval = 15;		/* default: 15s */
 	ssize_t		gpu_update_threshold = -1;		/* default: 20% of redo_log_limit */
+	cl_long		redo_sync_delay = 0;			/* default: sync on commit */
 	AttrNumber	primary_key = -1;
+	AttrNumber	range_index = -1;
+	char	   *aggview_keys = NULL;
+	char	   *aggview_targets = NULL;
+	long		aggview_max_groups = 10000;		/* default: 10000 */
 	bool		preserve_files = false;
+	int			j;
 
 	/*
 	 * check foreign relation's option
@@ -2340,6 +3324,15 @@ gstoreFdwExtractOptions(Relation frel,
 				elog(ERROR, "invalid redo_log_sz: %s", value);
 			gpu_update_threshold = threshold;
 		}
+		else if (strcmp(def->defname, "redo_sync_delay") == 0)
+		{
+			char   *value = defGetString(def);
+			long	delay = strtol(value, &endp, 10);
+
+			if (delay < 0 || delay > GSTORE_REDO_SYNC_DELAY_MAX || *endp != '\0')
+				elog(ERROR, "invalid redo_sync_delay: %s", value);
+			redo_sync_delay = delay;
+		}
 		else if (strcmp(def->defname, "primary_key") == 0)
 		{
 			char   *pk_name = defGetString(def);
@@ -2359,6 +3352,53 @@ gstoreFdwExtractOptions(Relation frel,
 				elog(ERROR, "'%s' specified by 'primary_key' option not found",
 					 pk_name);
 		}
+		else if (strcmp(def->defname, "range_index") == 0)
+		{
+			char   *ri_name = defGetString(def);
+			int		j;
+
+			for (j=0; j < tupdesc->natts; j++)
+			{
+				Form_pg_attribute attr = tupleDescAttr(tupdesc,j);
+
+				if (strcmp(ri_name, NameStr(attr->attname)) == 0)
+				{
+					TypeCacheEntry *tcache;
+
+					if (attr->attlen <= 0)
+						elog(ERROR, "'range_index' supports only fixed-length column, but '%s' is %s",
+							 ri_name, format_type_be(attr->atttypid));
+					tcache = lookup_type_cache(attr->atttypid,
+											   TYPECACHE_CMP_PROC);
+					if (!OidIsValid(tcache->cmp_proc))
+						elog(ERROR, "data type %s has no comparison function for 'range_index'",
+							 format_type_be(attr->atttypid));
+					range_index = attr->attnum;
+					break;
+				}
+			}
+			if (range_index < 0)
+				elog(ERROR, "'%s' specified by 'range_index' option not found",
+					 ri_name);
+		}
+		else if (strcmp(def->defname, "aggview_keys") == 0)
+		{
+			aggview_keys = defGetString(def);
+		}
+		else if (strcmp(def->defname, "aggview_targets") == 0)
+		{
+			aggview_targets = defGetString(def);
+		}
+		else if (strcmp(def->defname, "aggview_max_groups") == 0)
+		{
+			char   *value = defGetString(def);
+
+			aggview_max_groups = strtol(value, &endp, 10);
+			if (aggview_max_groups <= 0 ||
+				aggview_max_groups > GSTORE_AGGVIEW_MAX_GROUPS ||
+				*endp != '\0')
+				elog(ERROR, "invalid aggview_max_groups: %s", value);
+		}
 		else if (strcmp(def->defname, "preserve_files") == 0)
 		{
             preserve_files = defGetBoolean(def);
@@ -2367,6 +3407,46 @@ gstoreFdwExtractOptions(Relation frel,
 			elog(ERROR, "gstore_fdw: unknown option: %s", def->defname);
 	}
 
+	/*
+	 * check column's option
+	 */
+	memset(p_dict_columns, 0, sizeof(cl_uint) *
+		   ((GSTORE_DICT_MAX_COLUMNS + 31) / 32));
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc,j);
+		List	   *options;
+
+		if (attr->attisdropped)
+			continue;
+		options = GetForeignColumnOptions(RelationGetRelid(frel),
+										  attr->attnum);
+		foreach (lc, options)
+		{
+			DefElem	   *def = lfirst(lc);
+
+			if (strcmp(def->defname, "compression") == 0)
+			{
+				char   *token = defGetString(def);
+
+				if (strcmp(token, "dictionary") == 0)
+				{
+					if (attr->attlen != -1)
+						elog(ERROR, "'dictionary' compression supports only variable-length column, but '%s' is %s",
+							 NameStr(attr->attname),
+							 format_type_be(attr->atttypid));
+					p_dict_columns[j >> 5] |= (1U << (j & 0x1f));
+				}
+				else if (strcmp(token, "none") != 0)
+					elog(ERROR, "gstore_fdw: compression = '%s' is not supported",
+						 token);
+			}
+			else
+				elog(ERROR, "gstore_fdw: unknown column option: %s",
+					 def->defname);
+		}
+	}
+
 	/*
 	 * Check Mandatory Options
 	 */
@@ -2380,6 +3460,11 @@ gstoreFdwExtractOptions(Relation frel,
 			 gpu_update_threshold > redo_log_limit / 2)
 		elog(ERROR, "gpu_update_threshold is out of range: must be [%zu..%zu]",
 			 redo_log_limit / 50, redo_log_limit / 2);
+	gstoreFdwParseAggViewOptions(frel,
+								 aggview_keys,
+								 aggview_targets,
+								 aggview_max_groups,
+								 p_aggview);
 	/*
 	 * Write-back Results
 	 */
@@ -2390,7 +3475,9 @@ gstoreFdwExtractOptions(Relation frel,
 	*p_redo_log_limit       = redo_log_limit;
 	*p_gpu_update_interval  = gpu_update_interval;
 	*p_gpu_update_threshold = gpu_update_threshold;
+	*p_redo_sync_delay      = redo_sync_delay;
 	*p_primary_key          = primary_key;
+	*p_range_index          = range_index;
 	*p_preserve_files       = preserve_files;
 }
 
@@ -2555,7 +3642,11 @@ gstoreFdwAllocSharedState(Relation frel)
 	size_t		redo_log_limit;
 	cl_long		gpu_update_interval;
 	size_t		gpu_update_threshold;
+	cl_long		redo_sync_delay;
 	AttrNumber	primary_key;
+	AttrNumber	range_index;
+	cl_uint		dict_columns[(GSTORE_DICT_MAX_COLUMNS + 31) / 32];
+	kern_gpustore_aggview aggview;
 	bool		preserve_files;
 	size_t		len;
 	char	   *pos;
@@ -2570,7 +3661,11 @@ gstoreFdwAllocSharedState(Relation frel)
 							&redo_log_limit,
 							&gpu_update_interval,
 							&gpu_update_threshold,
+							&redo_sync_delay,
 							&primary_key,
+							&range_index,
+							dict_columns,
+							&aggview,
 							&preserve_files);
 	/* allocation of GpuStoreSharedState */
 	len = MAXALIGN(sizeof(GpuStoreSharedState));
@@ -2610,25 +3705,46 @@ gstoreFdwAllocSharedState(Relation frel)
 	gs_sstate->max_num_rows = max_num_rows;
 	gs_sstate->num_hash_slots = num_hash_slots;
 	gs_sstate->primary_key = primary_key;
+	gs_sstate->range_index = range_index;
+	memcpy(gs_sstate->dict_columns, dict_columns, sizeof(dict_columns));
 	gs_sstate->preserve_files = preserve_files;
 	gs_sstate->redo_log_limit = redo_log_limit;
 	gs_sstate->gpu_update_interval = gpu_update_interval;
 	gs_sstate->gpu_update_threshold = gpu_update_threshold;
+	gs_sstate->redo_sync_delay = redo_sync_delay;
 
 	LWLockInitialize(&gs_sstate->base_mmap_lock, -1);
 	gs_sstate->base_mmap_revision = UINT_MAX;
+	pg_atomic_init_u64(&gs_sstate->data_version, 0);
+	pg_atomic_init_u32(&gs_sstate->data_version_xid, InvalidTransactionId);
 
 	SpinLockInit(&gs_sstate->rowid_map_lock);
 	for (i=0; i < GSTORE_NUM_BASE_ROW_LOCKS; i++)
 		SpinLockInit(&gs_sstate->base_row_lock[i]);
 	for (i=0; i < GSTORE_NUM_HASH_SLOT_LOCKS; i++)
+	{
 		SpinLockInit(&gs_sstate->hash_slot_lock[i]);
+		pg_atomic_init_u32(&gs_sstate->hash_slot_seqno[i], 0);
+	}
 	SpinLockInit(&gs_sstate->redo_pos_lock);
 	gs_sstate->redo_write_pos = 0;
+	gs_sstate->redo_alloc_pos = 0;
 	gs_sstate->redo_read_pos = 0;
+	LWLockInitialize(&gs_sstate->redo_sync_lock, -1);
 	
 	pthreadRWLockInit(&gs_sstate->gpu_bufer_lock);
 
+	LWLockInitialize(&gs_sstate->range_index_lock, -1);
+	gs_sstate->range_index_pos = ULONG_MAX;
+	gs_sstate->range_index_rowids = NULL;
+
+	LWLockInitialize(&gs_sstate->aggview_lock, -1);
+	if (aggview.ntargets > 0)
+	{
+		len = KERN_GPUSTORE_AGGVIEW_LENGTH(aggview.nslots, aggview.nrooms);
+		gs_sstate->aggview = MemoryContextAllocZero(TopSharedMemoryContext, len);
+		memcpy(gs_sstate->aggview, &aggview, sizeof(kern_gpustore_aggview));
+	}
 	return gs_sstate;
 }
 
@@ -2644,28 +3760,84 @@ gstoreFdwRowIdMapSize(cl_uint nrooms)
 	return MAXALIGN(offsetof(GpuStoreRowIdMapHead, rowid_chain[nrooms]));
 }
 
+/*
+ * gstoreFdwAllocateRowId
+ *
+ * It picks up a free rowid from the backend local cache. Once the cache gets
+ * empty, it reserves a batch of free rowids at once, to avoid contention on
+ * the rowid_map_lock by concurrent INSERTs. Reserved rowids are marked as
+ * GSTORE_ROWID_RESERVED, thus never considered as in-use rows, and returned
+ * to the free list at end of the transaction.
+ */
 static cl_uint
-gstoreFdwAllocateRowId(GpuStoreSharedState *gs_sstate,
-                       GpuStoreRowIdMapHead *rowid_map)
+gstoreFdwAllocateRowId(GpuStoreDesc *gs_desc)
 {
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	GpuStoreRowIdMapHead *rowid_map = gs_desc->rowid_map;
 	cl_uint		rowid;
 
-	SpinLockAcquire(&gs_sstate->rowid_map_lock);
-	rowid = rowid_map->first_free_rowid;
-	if (rowid != UINT_MAX)
+	if (gs_desc->rowid_cache_head >= gs_desc->rowid_cache_tail)
 	{
-		Assert(rowid < rowid_map->nrooms);
-		rowid_map->first_free_rowid = rowid_map->rowid_chain[rowid];
-		rowid_map->rowid_chain[rowid] = UINT_MAX;	/* currently in-use */
+		cl_uint		nitems = 0;
+
+		SpinLockAcquire(&gs_sstate->rowid_map_lock);
+		while (nitems < GSTORE_ROWID_CACHE_NUMS)
+		{
+			rowid = rowid_map->first_free_rowid;
+			if (rowid == UINT_MAX)
+				break;
+			Assert(rowid < rowid_map->nrooms);
+			rowid_map->first_free_rowid = rowid_map->rowid_chain[rowid];
+			rowid_map->rowid_chain[rowid] = GSTORE_ROWID_RESERVED;
+			gs_desc->rowid_cache[nitems++] = rowid;
+		}
+		SpinLockRelease(&gs_sstate->rowid_map_lock);
+
+		gs_desc->rowid_cache_head = 0;
+		gs_desc->rowid_cache_tail = nitems;
+		if (nitems == 0)
+			return UINT_MAX;
 	}
-	SpinLockRelease(&gs_sstate->rowid_map_lock);
+	rowid = gs_desc->rowid_cache[gs_desc->rowid_cache_head++];
+	Assert(rowid_map->rowid_chain[rowid] == GSTORE_ROWID_RESERVED);
+	rowid_map->rowid_chain[rowid] = UINT_MAX;	/* currently in-use */
 
 	return rowid;
 }
 
+/*
+ * gstoreFdwReleaseRowIdCache
+ *
+ * It returns the rowids reserved by gstoreFdwAllocateRowId, but not used yet.
+ */
 static void
-gstoreFdwReleaseRowId(GpuStoreSharedState *gs_sstate,
-					  GpuStoreRowIdMapHead *rowid_map,
+gstoreFdwReleaseRowIdCache(GpuStoreDesc *gs_desc)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	GpuStoreRowIdMapHead *rowid_map = gs_desc->rowid_map;
+	cl_uint		rowid;
+
+	if (gs_desc->rowid_cache_head >= gs_desc->rowid_cache_tail)
+		return;
+	Assert(rowid_map != NULL);
+	SpinLockAcquire(&gs_sstate->rowid_map_lock);
+	/* push back in the reverse order, to keep the original order */
+	while (gs_desc->rowid_cache_tail > gs_desc->rowid_cache_head)
+	{
+		rowid = gs_desc->rowid_cache[--gs_desc->rowid_cache_tail];
+		Assert(rowid < rowid_map->nrooms);
+		Assert(rowid_map->rowid_chain[rowid] == GSTORE_ROWID_RESERVED);
+		rowid_map->rowid_chain[rowid] = rowid_map->first_free_rowid;
+		rowid_map->first_free_rowid = rowid;
+	}
+	SpinLockRelease(&gs_sstate->rowid_map_lock);
+	gs_desc->rowid_cache_head = 0;
+	gs_desc->rowid_cache_tail = 0;
+}
+
+static void
+gstoreFdwReleaseRowId(GpuStoreSharedState *gs_sstate,
+					  GpuStoreRowIdMapHead *rowid_map,
 					  cl_uint rowid)
 {
 	SpinLockAcquire(&gs_sstate->rowid_map_lock);
@@ -2721,6 +3893,393 @@ gstoreFdwCheckRowId(GpuStoreSharedState *gs_sstate,
 	return retval;
 }
 
+/* ----------------------------------------------------------------
+ *
+ * Routines for range index
+ *
+ * ----------------------------------------------------------------
+ */
+typedef struct
+{
+	kern_data_store *kds;
+	kern_colmeta   *cmeta;
+	FmgrInfo	   *cmp_func;
+	Oid				collation;
+} gstoreRangeIndexCompArg;
+
+static int
+__gstoreRangeIndexCompare(const void *__x, const void *__y, void *__arg)
+{
+	gstoreRangeIndexCompArg *c_arg = __arg;
+	cl_uint		x_rowid = *((const cl_uint *) __x);
+	cl_uint		y_rowid = *((const cl_uint *) __y);
+	Datum		x_datum;
+	Datum		y_datum;
+	bool		x_isnull;
+	bool		y_isnull;
+
+	x_datum = KDS_fetch_datum_column(c_arg->kds, c_arg->cmeta,
+									 x_rowid, &x_isnull);
+	y_datum = KDS_fetch_datum_column(c_arg->kds, c_arg->cmeta,
+									 y_rowid, &y_isnull);
+	Assert(!x_isnull && !y_isnull);
+	return DatumGetInt32(FunctionCall2Coll(c_arg->cmp_func,
+										   c_arg->collation,
+										   x_datum, y_datum));
+}
+
+static void
+__gstoreRangeIndexCompArgInit(gstoreRangeIndexCompArg *c_arg,
+							  GpuStoreDesc *gs_desc)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	kern_data_store *kds = &gs_desc->base_mmap->schema;
+	kern_colmeta   *cmeta = &kds->colmeta[gs_sstate->range_index - 1];
+	TypeCacheEntry *tcache;
+
+	tcache = lookup_type_cache(cmeta->atttypid, TYPECACHE_CMP_PROC_FINFO);
+	if (!OidIsValid(tcache->cmp_proc_finfo.fn_oid))
+		elog(ERROR, "data type %s has no comparison function",
+			 format_type_be(cmeta->atttypid));
+	c_arg->kds = kds;
+	c_arg->cmeta = cmeta;
+	c_arg->cmp_func = &tcache->cmp_proc_finfo;
+	c_arg->collation = get_typcollation(cmeta->atttypid);
+}
+
+/*
+ * __gstoreRangeIndexSortRowIds
+ *
+ * It moves rowids with NULL key to the tail, then sorts the rest.
+ * Returns number of non-NULL keys.
+ */
+static cl_uint
+__gstoreRangeIndexSortRowIds(gstoreRangeIndexCompArg *c_arg,
+							 cl_uint *rowids, cl_uint nitems)
+{
+	cl_uint		head = 0;
+	cl_uint		tail = nitems;
+	bool		isnull;
+
+	while (head < tail)
+	{
+		KDS_fetch_datum_column(c_arg->kds, c_arg->cmeta,
+							   rowids[head], &isnull);
+		if (!isnull)
+			head++;
+		else
+		{
+			cl_uint		temp = rowids[--tail];
+
+			rowids[tail] = rowids[head];
+			rowids[head] = temp;
+		}
+	}
+	qsort_arg(rowids, head, sizeof(cl_uint),
+			  __gstoreRangeIndexCompare, c_arg);
+	return head;
+}
+
+/*
+ * gstoreFdwRefreshRangeIndex
+ *
+ * It merges the rows inserted since the last refresh into the range index.
+ * Rows are picked up from the INSERT logs; then, entries of the rowids
+ * already released, or reused by the new rows, are removed. If the redo
+ * log is already overwritten, we rebuild the index from the base file.
+ * Caller must hold the range_index_lock in exclusive mode.
+ */
+static void
+gstoreFdwRefreshRangeIndex(GpuStoreDesc *gs_desc)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	GpuStoreRowIdMapHead *rowid_map = gs_desc->rowid_map;
+	kern_data_store *kds = &gs_desc->base_mmap->schema;
+	gstoreRangeIndexCompArg c_arg;
+	cl_uint	   *rowids;
+	cl_uint		nitems = 0;
+	cl_uint		nkeys;
+	uint64		base_pos;
+	uint64		tail_pos;
+	int			slot_index;
+
+	Assert(gs_sstate->range_index > 0 &&
+		   gs_sstate->range_index < kds->ncols);
+	if (!gs_sstate->range_index_rowids)
+	{
+		gs_sstate->range_index_rowids =
+			MemoryContextAllocHuge(TopSharedMemoryContext,
+								   sizeof(cl_uint) * kds->nrooms);
+		gs_sstate->range_index_pos = ULONG_MAX;
+	}
+	__gstoreRangeIndexCompArgInit(&c_arg, gs_desc);
+
+	/* pin the redo log not to be overwritten during the refresh */
+	for (;;)
+	{
+		SpinLockAcquire(&gs_sstate->redo_pos_lock);
+		for (slot_index=0; slot_index < 4; slot_index++)
+		{
+			if (gs_sstate->redo_repl_pos[slot_index] == ULONG_MAX)
+				break;
+		}
+		if (slot_index < 4)
+			break;
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+		pg_usleep(1000L);	/* 1ms */
+	}
+	base_pos = gs_sstate->range_index_pos;
+	tail_pos = gs_sstate->redo_write_pos;
+	if (base_pos == tail_pos)
+	{
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+		return;		/* already up to date */
+	}
+	if (base_pos == ULONG_MAX ||
+		base_pos + gs_sstate->redo_log_limit < tail_pos)
+	{
+		cl_uint		i;
+
+		/* rebuild the range index from the base file */
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+
+		rowids = gs_sstate->range_index_rowids;
+		for (i=0; i < kds->nitems; i++)
+		{
+			if (!gstoreFdwCheckRowId(gs_sstate, rowid_map, i))
+				continue;
+			/* wait for the writer to complete the row */
+			gstoreFdwSpinLockBaseRow(gs_desc, i);
+			gstoreFdwSpinUnlockBaseRow(gs_desc, i);
+			rowids[nitems++] = i;
+		}
+		nkeys = __gstoreRangeIndexSortRowIds(&c_arg, rowids, nitems);
+	}
+	else
+	{
+		cl_uint	   *old_rowids = gs_sstate->range_index_rowids;
+		cl_uint		old_nkeys = gs_sstate->range_index_nkeys;
+		cl_uint		old_nitems = gs_sstate->range_index_nitems;
+		cl_uint	   *new_rowids;
+		cl_uint		new_nkeys;
+		cl_uint		new_nitems = 0;
+		bitmapword *new_rowmap;
+		cl_uint		i, j, k;
+
+#define RANGE_ROWMAP_TEST(rowid)									\
+		((new_rowmap[WORDNUM(rowid)] & ((bitmapword) 1 << BITNUM(rowid))) != 0)
+
+		gs_sstate->redo_repl_pos[slot_index] = base_pos;
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+
+		/* pick up rowids of the newly inserted rows */
+		new_rowmap = palloc0(sizeof(bitmapword) *
+							 (kds->nrooms / BITS_PER_BITMAPWORD + 1));
+		PG_TRY();
+		{
+			while (base_pos < tail_pos)
+			{
+				GstoreTxLogCommon  *tx_log;
+				size_t		offset = base_pos % gs_sstate->redo_log_limit;
+
+				tx_log = (GstoreTxLogCommon *)(gs_desc->redo_mmap + offset);
+				if (tx_log->type == GSTORE_TX_LOG__INSERT)
+				{
+					GstoreTxLogInsert *i_log = (GstoreTxLogInsert *)tx_log;
+					cl_uint		rowid = i_log->rowid;
+
+					if (rowid < kds->nrooms)
+						new_rowmap[WORDNUM(rowid)] |= ((bitmapword) 1 << BITNUM(rowid));
+					base_pos += tx_log->length;
+				}
+				else if (tx_log->type == GSTORE_TX_LOG__DELETE ||
+						 tx_log->type == GSTORE_TX_LOG__COMMIT)
+				{
+					base_pos += tx_log->length;
+				}
+				else if (tx_log->type == 0)
+				{
+					/* round to the redo buffer head */
+					base_pos += (gs_sstate->redo_log_limit - offset);
+				}
+				else
+				{
+					elog(ERROR, "gstore_fdw: Redo log buffer looks corrupted at %zu",
+						 offset);
+				}
+			}
+		}
+		PG_CATCH();
+		{
+			SpinLockAcquire(&gs_sstate->redo_pos_lock);
+			gs_sstate->redo_repl_pos[slot_index] = ULONG_MAX;
+			SpinLockRelease(&gs_sstate->redo_pos_lock);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+		SpinLockAcquire(&gs_sstate->redo_pos_lock);
+		gs_sstate->redo_repl_pos[slot_index] = ULONG_MAX;
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+
+		/* new rows still in use */
+		new_rowids = palloc_extended(sizeof(cl_uint) * kds->nrooms,
+									 MCXT_ALLOC_HUGE);
+		for (i=0; i < kds->nrooms; i++)
+		{
+			if (!RANGE_ROWMAP_TEST(i))
+				continue;
+			if (!gstoreFdwCheckRowId(gs_sstate, rowid_map, i))
+				continue;
+			/* wait for the writer to complete the row */
+			gstoreFdwSpinLockBaseRow(gs_desc, i);
+			gstoreFdwSpinUnlockBaseRow(gs_desc, i);
+			new_rowids[new_nitems++] = i;
+		}
+		new_nkeys = __gstoreRangeIndexSortRowIds(&c_arg, new_rowids,
+												 new_nitems);
+		/* remove the entries released, or reused by the new rows */
+		for (i=0, j=0, k=0; i < old_nitems; i++)
+		{
+			cl_uint		rowid = old_rowids[i];
+
+			if (i < old_nkeys)
+				k = j;
+			if (RANGE_ROWMAP_TEST(rowid) ||
+				!gstoreFdwCheckRowId(gs_sstate, rowid_map, rowid))
+				continue;
+			old_rowids[j++] = rowid;
+			if (i < old_nkeys)
+				k = j;
+		}
+		old_nkeys = k;
+		old_nitems = j;
+		pfree(new_rowmap);
+#undef RANGE_ROWMAP_TEST
+
+		/*
+		 * Merge the new entries into the range index. NULL keys are kept
+		 * at the tail, so they are moved first.
+		 */
+		Assert(old_nitems + new_nitems <= kds->nrooms);
+		rowids = old_rowids;
+		nitems = old_nitems + new_nitems;
+		nkeys = old_nkeys + new_nkeys;
+		memmove(rowids + nkeys, rowids + old_nkeys,
+				sizeof(cl_uint) * (old_nitems - old_nkeys));
+		memcpy(rowids + nkeys + (old_nitems - old_nkeys),
+			   new_rowids + new_nkeys,
+			   sizeof(cl_uint) * (new_nitems - new_nkeys));
+		i = old_nkeys;
+		j = new_nkeys;
+		k = nkeys;
+		while (j > 0)
+		{
+			if (i > 0 && __gstoreRangeIndexCompare(&rowids[i-1],
+												   &new_rowids[j-1],
+												   &c_arg) > 0)
+				rowids[--k] = rowids[--i];
+			else
+				rowids[--k] = new_rowids[--j];
+		}
+		pfree(new_rowids);
+	}
+	gs_sstate->range_index_nkeys = nkeys;
+	gs_sstate->range_index_nitems = nitems;
+	gs_sstate->range_index_pos = tail_pos;
+}
+
+/*
+ * __gstoreRangeIndexSearch
+ *
+ * It returns the first position of the range index whose key is larger
+ * than (or equal to, if 'inclusive') the supplied key.
+ */
+static cl_uint
+__gstoreRangeIndexSearch(gstoreRangeIndexCompArg *c_arg,
+						 cl_uint *rowids, cl_uint nkeys,
+						 Datum key, bool inclusive)
+{
+	cl_uint		head = 0;
+	cl_uint		tail = nkeys;
+
+	while (head < tail)
+	{
+		cl_uint		curr = head + (tail - head) / 2;
+		Datum		datum;
+		bool		isnull;
+		int			comp;
+
+		datum = KDS_fetch_datum_column(c_arg->kds, c_arg->cmeta,
+									   rowids[curr], &isnull);
+		Assert(!isnull);
+		comp = DatumGetInt32(FunctionCall2Coll(c_arg->cmp_func,
+											   c_arg->collation,
+											   datum, key));
+		if (comp < 0 || (comp == 0 && !inclusive))
+			head = curr + 1;
+		else
+			tail = curr;
+	}
+	return head;
+}
+
+/*
+ * gstoreFdwLookupRangeIndex
+ *
+ * It refreshes the range index, then returns a local copy of the rowids
+ * within the supplied bounds. If no bounds, rowids with NULL key are also
+ * returned at the tail.
+ */
+static cl_uint *
+gstoreFdwLookupRangeIndex(GpuStoreDesc *gs_desc,
+						  bool has_lower, Datum lower,
+						  bool has_upper, Datum upper,
+						  cl_uint *p_nitems)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	gstoreRangeIndexCompArg c_arg;
+	cl_uint	   *rowids;
+	cl_uint		head, tail;
+
+	LWLockAcquire(&gs_sstate->range_index_lock, LW_EXCLUSIVE);
+	PG_TRY();
+	{
+		gstoreFdwRefreshRangeIndex(gs_desc);
+	}
+	PG_CATCH();
+	{
+		LWLockRelease(&gs_sstate->range_index_lock);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	LWLockRelease(&gs_sstate->range_index_lock);
+
+	__gstoreRangeIndexCompArgInit(&c_arg, gs_desc);
+	LWLockAcquire(&gs_sstate->range_index_lock, LW_SHARED);
+	head = 0;
+	tail = gs_sstate->range_index_nkeys;
+	if (has_lower)
+		head = __gstoreRangeIndexSearch(&c_arg,
+										gs_sstate->range_index_rowids,
+										tail, lower, true);
+	if (has_upper)
+		tail = __gstoreRangeIndexSearch(&c_arg,
+										gs_sstate->range_index_rowids,
+										tail, upper, false);
+	else if (!has_lower)
+		tail = gs_sstate->range_index_nitems;	/* includes NULLs */
+	if (tail < head)
+		tail = head;
+	rowids = palloc_extended(sizeof(cl_uint) * (tail - head + 1),
+							 MCXT_ALLOC_HUGE);
+	memcpy(rowids, gs_sstate->range_index_rowids + head,
+		   sizeof(cl_uint) * (tail - head));
+	LWLockRelease(&gs_sstate->range_index_lock);
+
+	*p_nitems = tail - head;
+	return rowids;
+}
+
 /* ----------------------------------------------------------------
  *
  * Routines for hash-base primary key index
@@ -3582,7 +5141,8 @@ gstoreFdwApplyRedoHostBuffer(Relation frel, GpuStoreSharedState *gs_sstate,
 	PG_TRY();
 	{
 		cl_uint		i, nitems = 0;
-		char	   *pos, *end;
+		char	   *head, *pos, *end;
+		bool		rewound = false;
 		uint64		start_pos;
 		StringInfoData buf;
 
@@ -3601,15 +5161,23 @@ gstoreFdwApplyRedoHostBuffer(Relation frel, GpuStoreSharedState *gs_sstate,
 			elog(ERROR, "failed on pmem_map_file('%s'): %m",
 				 gs_sstate->redo_log_file);
 		/*
-		 * Seek to the position where last written
+		 * Seek to the position where last written, from the last checkpoint.
+		 * Logs prior to the checkpoint are already synchronized to the base
+		 * file, so we don't need to replay them.
 		 */
 		initStringInfo(&buf);
-		pos = redo_mmap;
 		end = redo_mmap + gs_sstate->redo_log_limit;
+		if (base_mmap->checkpoint_offset < gs_sstate->redo_log_limit)
+			head = redo_mmap + base_mmap->checkpoint_offset;
+		else
+			head = redo_mmap;
+		pos = head;
 		while (pos + offsetof(GstoreTxLogCommon, data) <= end)
 		{
 			GstoreTxLogCommon *curr = (GstoreTxLogCommon *)pos;
 
+			if (rewound && pos >= head)
+				break;
 			if (((curr->type == GSTORE_TX_LOG__INSERT) ||
 				 (curr->type == GSTORE_TX_LOG__DELETE) ||
 				 (curr->type == GSTORE_TX_LOG__COMMIT)) &&
@@ -3622,6 +5190,14 @@ gstoreFdwApplyRedoHostBuffer(Relation frel, GpuStoreSharedState *gs_sstate,
 				pos += curr->length;
 				continue;
 			}
+			/* padding to the end of redo log buffer */
+			if (curr->type == 0 && !rewound &&
+				(char *)curr + curr->length == end)
+			{
+				pos = redo_mmap;
+				rewound = true;
+				continue;
+			}
 			break;
 		}
 
@@ -3660,13 +5236,24 @@ gstoreFdwApplyRedoHostBuffer(Relation frel, GpuStoreSharedState *gs_sstate,
 				RelationGetRelationName(frel), nitems);
 		}
 		start_pos = (pos - (char *)redo_mmap);
+		/* the new redo logs shall be written from the tail */
+		base_mmap->checkpoint_offset = start_pos;
+		if (base_is_pmem)
+			pmem_persist(&base_mmap->checkpoint_offset, sizeof(uint64));
+		else
+			pmem_msync(&base_mmap->checkpoint_offset, sizeof(uint64));
 		gs_sstate->redo_write_pos = start_pos;
+		gs_sstate->redo_alloc_pos = start_pos;
 		gs_sstate->redo_read_pos  = start_pos;
 		gs_sstate->redo_sync_pos  = start_pos;
+		gs_sstate->redo_checkpoint_pos = start_pos;
+		gs_sstate->redo_checkpoint_timestamp = GetCurrentTimestamp();
 		gs_sstate->redo_repl_pos[0] = ULONG_MAX;
 		gs_sstate->redo_repl_pos[1] = ULONG_MAX;
 		gs_sstate->redo_repl_pos[2] = ULONG_MAX;
 		gs_sstate->redo_repl_pos[3] = ULONG_MAX;
+		memset(gs_sstate->redo_repl_latch, 0,
+			   sizeof(gs_sstate->redo_repl_latch));
 		pfree(buf.data);
 	}
 	PG_CATCH();
@@ -3755,6 +5342,8 @@ gstoreFdwCreateSharedState(Relation frel, bool may_create_files)
 			unlink(gs_sstate->base_file);
 		if (redo_create)
 			unlink(gs_sstate->redo_log_file);
+		if (gs_sstate->aggview)
+			pfree(gs_sstate->aggview);
 		pfree(gs_sstate);
 		PG_RE_THROW();
 	}
@@ -3863,12 +5452,15 @@ gstoreFdwInitGpuStoreDesc(GpuStoreDesc *gs_desc, GpuStoreSharedState *gs_sstate)
 	gs_desc->xmax_ftable = InvalidTransactionId;
 	gs_desc->gs_sstate  = gs_sstate;
 	dlist_init(&gs_desc->gs_undo_logs);
+	gs_desc->data_version_odd = false;
 	/* base file mapping */
 	gs_desc->base_mmap = NULL;
 	gs_desc->base_mmap_revision = UINT_MAX;
 	gs_desc->base_mmap_is_pmem = 0;
 	gs_desc->rowid_map = NULL;
 	gs_desc->hash_index = NULL;
+	gs_desc->rowid_cache_head = 0;
+	gs_desc->rowid_cache_tail = 0;
 	/* redo-log file mapping */
 	gs_desc->redo_mmap = NULL;
 	gs_desc->redo_mmap_sz = 0;
@@ -3876,6 +5468,7 @@ gstoreFdwInitGpuStoreDesc(GpuStoreDesc *gs_desc, GpuStoreSharedState *gs_sstate)
 	/* background-worker only fields */
 	gs_desc->gpu_main_devptr = 0UL;
 	gs_desc->gpu_extra_devptr = 0UL;
+	gs_desc->gpu_aggview_devptr = 0UL;
 }
 
 static bool
@@ -4026,6 +5619,18 @@ __gstoreFdwXactOnPreCommit(GpuStoreDesc *gs_desc, GpuStoreUndoLogs *gs_undo,
 	Assert(pos <= gs_undo->buf.data + gs_undo->buf.len);
 	if (p_written_pos)
 		*p_written_pos = Max(*p_written_pos, written_pos);
+	/* wake up the bgworker that tails the redo log */
+	if (gstore_fdw_continuous_apply)
+	{
+		int		cuda_dindex = gs_desc->gs_sstate->cuda_dindex;
+		Latch  *latch;
+
+		SpinLockAcquire(&gstore_shared_head->bgworker_cmd_lock);
+		latch = gstore_shared_head->bgworkers[cuda_dindex].latch;
+		SpinLockRelease(&gstore_shared_head->bgworker_cmd_lock);
+		if (latch)
+			SetLatch(latch);
+	}
 }
 
 /*
@@ -4035,12 +5640,35 @@ static void
 __gstoreFdwXactSyncRedoLog(GpuStoreDesc *gs_desc, uint64 written_pos)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
-	uint64		sync_pos = gs_sstate->redo_sync_pos;
-	uint64		__sync_pos = sync_pos % gs_sstate->redo_log_limit;
-	uint64		__written_pos = written_pos % gs_sstate->redo_log_limit;
+	uint64		sync_pos;
+	uint64		__sync_pos;
+	uint64		__written_pos;
 
+	/*
+	 * Group commit - only one process syncs the redo log at a time, and
+	 * it also syncs the logs written by the concurrent committers. Others
+	 * just wait for the lock, then recheck whether their own logs are
+	 * already synced.
+	 */
+	for (;;)
+	{
+		if (written_pos <= gs_sstate->redo_sync_pos)
+			return;
+		if (LWLockAcquireOrWait(&gs_sstate->redo_sync_lock, LW_EXCLUSIVE))
+			break;
+	}
+	sync_pos = gs_sstate->redo_sync_pos;
 	if (written_pos <= sync_pos)
+	{
+		LWLockRelease(&gs_sstate->redo_sync_lock);
 		return;
+	}
+	SpinLockAcquire(&gs_sstate->redo_pos_lock);
+	written_pos = Max(written_pos, gs_sstate->redo_write_pos);
+	SpinLockRelease(&gs_sstate->redo_pos_lock);
+
+	__sync_pos = sync_pos % gs_sstate->redo_log_limit;
+	__written_pos = written_pos % gs_sstate->redo_log_limit;
 	if (written_pos >= sync_pos + gs_sstate->redo_log_limit)
 	{
 		/* corner case - entire redo log buffer must be sync */
@@ -4055,7 +5683,7 @@ __gstoreFdwXactSyncRedoLog(GpuStoreDesc *gs_desc, uint64 written_pos)
 	else if (__written_pos > __sync_pos)
 	{
 		char   *ptr = gs_desc->redo_mmap + __sync_pos;
-		size_t	sz = __written_pos - __sync_pos;
+		size_t	sz = __written_pos - __sync_pos + sizeof(uint32);
 
 		if (gs_desc->redo_mmap_is_pmem)
 			pmem_persist(ptr, sz);
@@ -4071,19 +5699,21 @@ __gstoreFdwXactSyncRedoLog(GpuStoreDesc *gs_desc, uint64 written_pos)
 		if (gs_desc->redo_mmap_is_pmem)
 		{
 			pmem_persist(ptr, sz);
-			pmem_persist(gs_desc->redo_mmap, __written_pos);
+			pmem_persist(gs_desc->redo_mmap, __written_pos + sizeof(uint32));
 		}
 		else
 		{
 			if (pmem_msync(ptr, sz) != 0)
 				elog(WARNING, "failed on pmem_msync('%s'): %m",
 					 gs_sstate->redo_log_file);
-			if (pmem_msync(gs_desc->redo_mmap, __written_pos) != 0)
+			if (pmem_msync(gs_desc->redo_mmap, __written_pos + sizeof(uint32)) != 0)
 				elog(WARNING, "failed on pmem_msync('%s'): %m",
 					 gs_sstate->redo_log_file);
 		}
 	}
 	atomicMax64(&gs_sstate->redo_sync_pos, written_pos);
+	gs_sstate->redo_sync_timestamp = GetCurrentTimestamp();
+	LWLockRelease(&gs_sstate->redo_sync_lock);
 }
 
 /*
@@ -4222,9 +5852,34 @@ __gstoreFdwXactDropResources(GpuStoreDesc *gs_desc)
 		if (unlink(gs_sstate->redo_log_file) != 0)
 			elog(WARNING, "failed on unlink('%s'): %m", gs_sstate->redo_log_file);
 	}
+	if (gs_sstate->range_index_rowids)
+		pfree(gs_sstate->range_index_rowids);
+	if (gs_sstate->aggview)
+		pfree(gs_sstate->aggview);
 	pfree(gs_sstate);
 }
 
+/*
+ * gstoreFdwUpdateDataVersionXid
+ *
+ * It tracks the latest xid that increments the data_version; concurrent
+ * transactions may commit in different order to their xids.
+ */
+static void
+gstoreFdwUpdateDataVersionXid(GpuStoreSharedState *gs_sstate,
+							  TransactionId curr_xid)
+{
+	uint32		oldval = pg_atomic_read_u32(&gs_sstate->data_version_xid);
+
+	while (!TransactionIdIsNormal(oldval) ||
+		   TransactionIdFollows(curr_xid, oldval))
+	{
+		if (pg_atomic_compare_exchange_u32(&gs_sstate->data_version_xid,
+										   &oldval, curr_xid))
+			break;
+	}
+}
+
 /*
  * gstoreFdwXactCallback
  */
@@ -4262,9 +5917,27 @@ gstoreFdwXactCallback(XactEvent event, void *arg)
 				gs_undo = dlist_container(GpuStoreUndoLogs,
 										  chain, iter.cur);
 				if (gs_undo->curr_xid == curr_xid)
+				{
+					if (!gs_desc->data_version_odd)
+					{
+						gstoreFdwUpdateDataVersionXid(gs_desc->gs_sstate,
+													  curr_xid);
+						pg_atomic_fetch_add_u64(&gs_desc->gs_sstate->data_version, 1);
+						gs_desc->data_version_odd = true;
+					}
 					__gstoreFdwXactOnPreCommit(gs_desc, gs_undo, &written_pos);
+				}
 			}
-			__gstoreFdwXactSyncRedoLog(gs_desc, written_pos);
+			/*
+			 * If 'redo_sync_delay' is configured, commit does not wait for
+			 * the sync of redo log until the delay is elapsed from the last
+			 * sync. GpuStore maintainer syncs the remaining logs later.
+			 */
+			if (written_pos > 0 &&
+				(gs_desc->gs_sstate->redo_sync_delay == 0 ||
+				 GetCurrentTimestamp() >= (gs_desc->gs_sstate->redo_sync_timestamp +
+										   gs_desc->gs_sstate->redo_sync_delay * 1000L)))
+				__gstoreFdwXactSyncRedoLog(gs_desc, written_pos);
 		}
 	}
 	else if (event == XACT_EVENT_COMMIT ||
@@ -4277,6 +5950,7 @@ gstoreFdwXactCallback(XactEvent event, void *arg)
 		{
 			bool	drop_this = false;
 
+			gstoreFdwReleaseRowIdCache(gs_desc);
 			dlist_foreach_modify(iter, &gs_desc->gs_undo_logs)
 			{
 				gs_undo = dlist_container(GpuStoreUndoLogs,
@@ -4290,6 +5964,11 @@ gstoreFdwXactCallback(XactEvent event, void *arg)
 					pfree(gs_undo);
 				}
 			}
+			if (gs_desc->data_version_odd)
+			{
+				pg_atomic_fetch_add_u64(&gs_desc->gs_sstate->data_version, 1);
+				gs_desc->data_version_odd = false;
+			}
 			if (TransactionIdIsNormal(curr_xid) &&
 				gs_desc->xmin_ftable == curr_xid)
 			{
@@ -4521,47 +6200,579 @@ pgstrom_gstore_fdw_apply_redo(PG_FUNCTION_ARGS)
 PG_FUNCTION_INFO_V1(pgstrom_gstore_fdw_apply_redo);
 
 /*
- * __gstoreFdwHostBufferCompaction
+ * pgstrom_gstore_fdw_aggview
  *
- * note; caller must have AccessExclusiveLock
+ * It returns the aggregate view of the Gstore_Fdw table, after the redo
+ * logs are applied to the device buffer. The caller must supply the column
+ * definition list; keys, then aggregate targets, in order of the options.
  */
-static void
-__gstoreFdwHostBufferCompaction(Relation frel)
+static Datum
+__gstoreFdwAggViewDatum(kern_gpustore_aggview_attr *target,
+						kern_gpustore_aggview_group *group, int i,
+						bool *p_isnull)
 {
-	GpuStoreDesc	*gs_desc = gstoreFdwLookupGpuStoreDesc(frel);
-	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
-	kern_data_store *kds = &gs_desc->base_mmap->schema;
-	kern_data_extra	*old_extra;
-	kern_data_extra *new_extra;
-	uint32			old_revision = gs_sstate->base_mmap_revision;
-	size_t			new_length;
-	size_t			file_sz;
-	cl_uint			i, j;
-	int				rawfd;
+	cl_ulong	value = group->values[i];
+	double		fval;
 
-	if (!kds->has_varlena)
-		return;		/* nothing to do */
+	*p_isnull = false;
+	switch (target->aggfunc)
+	{
+		case GSTORE_AGGFUNC__NROWS:
+			return Int64GetDatum(group->nrows);
+		case GSTORE_AGGFUNC__COUNT:
+			return Int64GetDatum(group->counts[i]);
+		default:
+			break;
+	}
+	if (group->counts[i] <= 0)
+	{
+		*p_isnull = true;
+		return 0;
+	}
+	memcpy(&fval, &value, sizeof(double));
+	switch (target->atttypid)
+	{
+		case INT2OID:
+			return Int16GetDatum((int16)value);
+		case INT4OID:
+			return Int32GetDatum((int32)value);
+		case INT8OID:
+			return Int64GetDatum((int64)value);
+		case FLOAT4OID:
+			return Float4GetDatum((float4)fval);
+		case FLOAT8OID:
+			return Float8GetDatum(fval);
+		default:
+			elog(ERROR, "unexpected type of aggregate view: %s",
+				 format_type_be(target->atttypid));
+	}
+	return 0;
+}
 
-	old_extra = (kern_data_extra *)((char *)kds + kds->extra_hoffset);
-	new_length = PAGE_ALIGN(old_extra->usage);
-	new_extra = MemoryContextAllocHuge(CurrentMemoryContext, new_length);
-	memcpy(new_extra->signature, GPUSTORE_EXTRABUF_SIGNATURE, 8);
-	new_extra->length = new_length;		/* tentative */
-	new_extra->usage  = offsetof(kern_data_extra, data);
+Datum
+pgstrom_gstore_fdw_aggview(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	kern_gpustore_aggview *aggview;
+	kern_gpustore_aggview_group *group;
+	HeapTuple	tuple;
+	Datum	   *values;
+	bool	   *isnull;
+	int			i, k;
 
-	Assert(kds->format == KDS_FORMAT_COLUMN);
-	for (j=0; j < kds->ncols; j++)
+	if (SRF_IS_FIRSTCALL())
 	{
-		kern_colmeta   *cmeta = &kds->colmeta[j];
-		bits8		   *nullmap = NULL;
-		cl_uint		   *values;
+		Oid				ftable_oid = PG_GETARG_OID(0);
+		Relation		frel;
+		GpuStoreDesc   *gs_desc;
+		GpuStoreSharedState *gs_sstate;
+		TupleDesc		tupdesc;
+		MemoryContext	oldcxt;
+		CUresult		rc;
+		size_t			len;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+
+		frel = table_open(ftable_oid, AccessShareLock);
+		if (!RelationIsGstoreFdw(frel))
+			elog(ERROR, "relation '%s' is not a foreign table of gstore_fdw",
+				 RelationGetRelationName(frel));
+		gs_desc = gstoreFdwLookupGpuStoreDesc(frel);
+		gs_sstate = gs_desc->gs_sstate;
+		if (!gs_sstate->aggview)
+			elog(ERROR, "gstore_fdw: '%s' has no aggregate view (see 'aggview_targets' option)",
+				 RelationGetRelationName(frel));
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			elog(ERROR, "function returning record called in context that cannot accept type record");
+		if (tupdesc->natts != (gs_sstate->aggview->nkeys +
+							   gs_sstate->aggview->ntargets))
+			elog(ERROR, "aggregate view of '%s' has %u keys and %u targets, but %d columns are defined",
+				 RelationGetRelationName(frel),
+				 gs_sstate->aggview->nkeys,
+				 gs_sstate->aggview->ntargets,
+				 tupdesc->natts);
+		for (i=0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
+			Oid		type_oid = (i < gs_sstate->aggview->nkeys
+								? gs_sstate->aggview->keys[i].atttypid
+								: gs_sstate->aggview->targets[i - gs_sstate->aggview->nkeys].atttypid);
 
-		if (cmeta->attlen != -1)
-			continue;
-		Assert(!cmeta->attbyval);
+			if (attr->atttypid != type_oid)
+				elog(ERROR, "column %d of the aggregate view must be %s, but %s is defined",
+					 i+1, format_type_be(type_oid),
+					 format_type_be(attr->atttypid));
+		}
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
 
-		if (cmeta->nullmap_offset != 0)
-			nullmap = (bits8 *)((char *)kds + __kds_unpack(cmeta->nullmap_offset));
+		/* synchronize device buffer (and the aggregate view) */
+		rc = gstoreFdwApplyRedoDeviceBuffer(gs_sstate);
+		if (rc == CUDA_SUCCESS && !gs_sstate->aggview->is_valid)
+		{
+			/* the device buffer may not be loaded yet */
+			rc = gstoreFdwInvokeApplyRedo(gs_sstate->ftable_oid, 0,
+										  gs_sstate->cuda_dindex, false);
+		}
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "gstore_fdw: failed on apply redo logs: %s",
+				 errorText(rc));
+
+		/* local copy of the snapshot */
+		LWLockAcquire(&gs_sstate->aggview_lock, LW_SHARED);
+		len = ((char *)KERN_GPUSTORE_AGGVIEW_GROUPS(gs_sstate->aggview) -
+			   (char *)gs_sstate->aggview +
+			   sizeof(kern_gpustore_aggview_group) * gs_sstate->aggview->nitems);
+		aggview = MemoryContextAllocHuge(fncxt->multi_call_memory_ctx, len);
+		memcpy(aggview, gs_sstate->aggview, len);
+		LWLockRelease(&gs_sstate->aggview_lock);
+		if (aggview->overflow)
+			elog(ERROR, "gstore_fdw: aggregate view of '%s' has more groups than aggview_max_groups (%u)",
+				 RelationGetRelationName(frel), aggview->nrooms);
+		if (!aggview->is_valid)
+			elog(ERROR, "gstore_fdw: aggregate view of '%s' is not built yet",
+				 RelationGetRelationName(frel));
+		table_close(frel, NoLock);
+
+		fncxt->user_fctx = aggview;
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	aggview = fncxt->user_fctx;
+
+	/* skip the empty groups */
+	do {
+		if (fncxt->call_cntr >= aggview->nitems)
+			SRF_RETURN_DONE(fncxt);
+		group = KERN_GPUSTORE_AGGVIEW_GROUPS(aggview) + fncxt->call_cntr;
+		if (group->nrows <= 0)
+			fncxt->call_cntr++;
+	} while (group->nrows <= 0);
+
+	values = alloca(sizeof(Datum) * (aggview->nkeys + aggview->ntargets));
+	isnull = alloca(sizeof(bool)  * (aggview->nkeys + aggview->ntargets));
+	for (k=0; k < aggview->nkeys; k++)
+	{
+		isnull[k] = ((group->key_nulls & (1U << k)) != 0);
+		values[k] = (Datum)group->keys[k];
+	}
+	for (i=0; i < aggview->ntargets; i++)
+	{
+		values[k+i] = __gstoreFdwAggViewDatum(&aggview->targets[i],
+											  group, i, &isnull[k+i]);
+	}
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_gstore_fdw_aggview);
+
+/*
+ * pgstrom_gstore_fdw_export_columns
+ *
+ * It exports the device buffer of the Gstore_Fdw table to other processes,
+ * like Python scripts, using CUDA IPC handles. The main and extra portions
+ * are the live device buffers, not a copy; only the bitmap of the rows
+ * visible to the current snapshot is built on the preserved device memory,
+ * and kept until gstore_fdw_put_columns() or end of the session.
+ */
+typedef struct
+{
+	dlist_node		chain;
+	cl_int			cuda_dindex;
+	CUipcMemHandle	valid_mhandle;
+	char			ident[FLEXIBLE_ARRAY_MEMBER];
+} GpuStoreExportTracker;
+
+static dlist_head	gstore_export_tracker_list = DLIST_STATIC_INIT(gstore_export_tracker_list);
+
+static void
+__gstoreFdwPutExportTracker(GpuStoreExportTracker *tracker)
+{
+	CUresult	rc;
+
+	rc = gpuMemFreePreserved(tracker->cuda_dindex,
+							 tracker->valid_mhandle);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on gpuMemFreePreserved: %s", errorText(rc));
+	dlist_delete(&tracker->chain);
+	pfree(tracker);
+}
+
+static void
+gstoreFdwPutAllExportTracker(int code, Datum arg)
+{
+	dlist_mutable_iter	iter;
+
+	dlist_foreach_modify(iter, &gstore_export_tracker_list)
+	{
+		GpuStoreExportTracker *tracker =
+			dlist_container(GpuStoreExportTracker, chain, iter.cur);
+
+		__gstoreFdwPutExportTracker(tracker);
+	}
+}
+
+static const char *
+__gstoreFdwExportColumnType(Form_pg_attribute attr)
+{
+	switch (attr->atttypid)
+	{
+		case BOOLOID:			return "bool";
+		case INT2OID:			return "int16";
+		case INT4OID:			return "int32";
+		case INT8OID:			return "int64";
+		case FLOAT4OID:			return "float32";
+		case FLOAT8OID:			return "float64";
+		case DATEOID:			return "date";
+		case TIMEOID:			return "time";
+		case TIMESTAMPOID:		return "timestamp";
+		case TIMESTAMPTZOID:	return "timestamptz";
+		default:
+			break;
+	}
+	return (attr->attlen > 0 ? "binary" : "varlena");
+}
+
+static void
+__appendIpcMemHandle(StringInfo buf, CUipcMemHandle *mhandle)
+{
+	enlargeStringInfo(buf, 2 * sizeof(CUipcMemHandle));
+	hex_encode((const char *)mhandle,
+			   sizeof(CUipcMemHandle),
+			   buf->data + buf->len);
+	buf->len += 2 * sizeof(CUipcMemHandle);
+	buf->data[buf->len] = '\0';
+}
+
+char *
+gstoreFdwExportColumns(Oid ftable_oid)
+{
+	Relation		frel;
+	TupleDesc		tupdesc;
+	GpuStoreDesc   *gs_desc;
+	GpuStoreSharedState *gs_sstate;
+	kern_data_store *schema;
+	Snapshot		snapshot = GetActiveSnapshot();
+	GpuContext	   *volatile gcontext = NULL;
+	CUipcMemHandle	main_mhandle;
+	CUipcMemHandle	extra_mhandle;
+	CUipcMemHandle	valid_mhandle;
+	size_t			main_size;
+	size_t			extra_size;
+	CUdeviceptr		m_valid = 0UL;
+	uint8		   *h_valid;
+	cl_uint			nitems, rowid;
+	size_t			valid_sz;
+	StringInfoData	ident;
+	GpuStoreExportTracker *tracker;
+	static bool		on_before_shmem_callback_registered = false;
+	CUresult		rc;
+	int				j, count;
+
+	frel = table_open(ftable_oid, AccessShareLock);
+	if (!RelationIsGstoreFdw(frel))
+		elog(ERROR, "relation '%s' is not a foreign table of gstore_fdw",
+			 RelationGetRelationName(frel));
+	strom_foreign_table_aclcheck(ftable_oid, GetUserId(), ACL_SELECT);
+	gs_desc = gstoreFdwLookupGpuStoreDesc(frel);
+	gs_sstate = gs_desc->gs_sstate;
+	schema = &gs_desc->base_mmap->schema;
+	tupdesc = RelationGetDescr(frel);
+	Assert(tupdesc->natts + 1 == schema->ncols);
+
+	/* synchronize device buffer to the redo logs written */
+	rc = gstoreFdwApplyRedoDeviceBuffer(gs_sstate);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "gstore_fdw: failed on apply redo logs: %s",
+			 errorText(rc));
+	if (gs_sstate->gpu_main_size == 0)
+		elog(ERROR, "gstore_fdw: device buffer of '%s' is not loaded yet",
+			 RelationGetRelationName(frel));
+
+	/*
+	 * Bitmap of the rows visible to the current snapshot. The host buffer
+	 * has the same rows on the same rowid, once redo logs are applied.
+	 */
+	nitems = schema->nitems;
+	valid_sz = MAXALIGN(BITMAPLEN(Max(nitems, 1)));
+	h_valid = MemoryContextAllocExtended(CurrentMemoryContext, valid_sz,
+										 MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+	for (rowid=0; rowid < nitems; rowid++)
+	{
+		bool	visible;
+
+		gstoreFdwSpinLockBaseRow(gs_desc, rowid);
+		visible = gstoreCheckVisibilityForRead(gs_desc, rowid,
+											   snapshot, NULL);
+		gstoreFdwSpinUnlockBaseRow(gs_desc, rowid);
+		if (visible)
+			h_valid[rowid >> 3] |= (1 << (rowid & 7));
+	}
+
+	rc = gpuMemAllocPreserved(gs_sstate->cuda_dindex,
+							  &valid_mhandle,
+							  valid_sz);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocPreserved: %s", errorText(rc));
+	PG_TRY();
+	{
+		gcontext = AllocGpuContext(gs_sstate->cuda_dindex, true, false);
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &m_valid,
+								 valid_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+		rc = cuMemcpyHtoD(m_valid, h_valid, valid_sz);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+		rc = gpuIpcCloseMemHandle(gcontext, m_valid);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
+				 errorText(rc));
+		PutGpuContext(gcontext);
+		gcontext = NULL;
+
+		/*
+		 * Build identifier string; the main portion is described by the
+		 * common tokens, then the extra portion and the valid bitmap.
+		 * Layout of the columns is "type:unitsz:values:nullmap" where
+		 * unitsz is -1 for varlena, and nullmap is -1 if no buffer.
+		 */
+		pthreadRWLockReadLock(&gs_sstate->gpu_bufer_lock);
+		main_size = gs_sstate->gpu_main_size;
+		extra_size = gs_sstate->gpu_extra_size;
+		memcpy(&main_mhandle, &gs_sstate->gpu_main_mhandle,
+			   sizeof(CUipcMemHandle));
+		memcpy(&extra_mhandle, &gs_sstate->gpu_extra_mhandle,
+			   sizeof(CUipcMemHandle));
+		pthreadRWLockUnlock(&gs_sstate->gpu_bufer_lock);
+
+		initStringInfo(&ident);
+		appendStringInfo(&ident,
+						 "device_id=%d,bytesize=%zu,ipc_handle=",
+						 devAttrs[gs_sstate->cuda_dindex].DEV_ID,
+						 main_size);
+		__appendIpcMemHandle(&ident, &main_mhandle);
+		appendStringInfo(&ident, ",format=gstore-columns,nitems=%u,table_oid=%u",
+						 nitems, ftable_oid);
+		if (extra_size > 0)
+		{
+			appendStringInfo(&ident, ",extra_size=%zu,extra_handle=",
+							 extra_size);
+			__appendIpcMemHandle(&ident, &extra_mhandle);
+		}
+		appendStringInfo(&ident, ",valid_size=%zu,valid_handle=", valid_sz);
+		__appendIpcMemHandle(&ident, &valid_mhandle);
+
+		appendStringInfoString(&ident, ",attnums=");
+		for (j=0, count=0; j < tupdesc->natts; j++)
+		{
+			if (tupleDescAttr(tupdesc, j)->attisdropped)
+				continue;
+			appendStringInfo(&ident, "%s%d", count++ > 0 ? " " : "", j+1);
+		}
+		appendStringInfoString(&ident, ",columns=");
+		for (j=0, count=0; j < tupdesc->natts; j++)
+		{
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+			kern_colmeta   *cmeta = &schema->colmeta[j];
+
+			if (attr->attisdropped)
+				continue;
+			appendStringInfo(&ident, "%s%s:%d:%zu:%ld",
+							 count++ > 0 ? " " : "",
+							 __gstoreFdwExportColumnType(attr),
+							 attr->attlen > 0
+							 ? (int)TYPEALIGN(cmeta->attalign, cmeta->attlen)
+							 : -1,
+							 __kds_unpack(cmeta->values_offset),
+							 cmeta->nullmap_offset != 0
+							 ? (long)__kds_unpack(cmeta->nullmap_offset)
+							 : -1L);
+		}
+
+		tracker = MemoryContextAllocZero(CacheMemoryContext,
+										 offsetof(GpuStoreExportTracker,
+												  ident[ident.len + 1]));
+		tracker->cuda_dindex = gs_sstate->cuda_dindex;
+		memcpy(&tracker->valid_mhandle, &valid_mhandle,
+			   sizeof(CUipcMemHandle));
+		strcpy(tracker->ident, ident.data);
+	}
+	PG_CATCH();
+	{
+		if (gcontext)
+			PutGpuContext(gcontext);
+		rc = gpuMemFreePreserved(gs_sstate->cuda_dindex, valid_mhandle);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFreePreserved: %s",
+				 errorText(rc));
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	dlist_push_head(&gstore_export_tracker_list, &tracker->chain);
+	if (!on_before_shmem_callback_registered)
+	{
+		before_shmem_exit(gstoreFdwPutAllExportTracker, 0);
+		on_before_shmem_callback_registered = true;
+	}
+	pfree(h_valid);
+	table_close(frel, NoLock);
+
+	return ident.data;
+}
+
+Datum
+pgstrom_gstore_fdw_export_columns(PG_FUNCTION_ARGS)
+{
+	Oid			ftable_oid = PG_GETARG_OID(0);
+
+	PG_RETURN_TEXT_P(cstring_to_text(gstoreFdwExportColumns(ftable_oid)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_gstore_fdw_export_columns);
+
+/*
+ * pgstrom_gstore_fdw_put_columns
+ *
+ * It releases the valid bitmap exported by gstore_fdw_export_columns().
+ */
+void
+gstoreFdwPutColumns(const char *ident)
+{
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &gstore_export_tracker_list)
+	{
+		GpuStoreExportTracker *tracker =
+			dlist_container(GpuStoreExportTracker, chain, iter.cur);
+
+		if (strcmp(tracker->ident, ident) == 0)
+		{
+			__gstoreFdwPutExportTracker(tracker);
+			return;
+		}
+	}
+	elog(ERROR, "Not found GPU buffer with identifier=[%s]", ident);
+}
+
+Datum
+pgstrom_gstore_fdw_put_columns(PG_FUNCTION_ARGS)
+{
+	gstoreFdwPutColumns(TextDatumGetCString(PG_GETARG_TEXT_P(0)));
+
+	PG_RETURN_BOOL(true);
+}
+PG_FUNCTION_INFO_V1(pgstrom_gstore_fdw_put_columns);
+
+/*
+ * gstoreFdwGpuAnalyze
+ *
+ * It feeds the values of the rows visible to the current snapshot to
+ * gpu_analyze.c, on the device where the GPU buffer is located.
+ */
+double
+gstoreFdwGpuAnalyze(Relation frel)
+{
+	TupleDesc		tupdesc = RelationGetDescr(frel);
+	GpuStoreDesc   *gs_desc = gstoreFdwLookupGpuStoreDesc(frel);
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	kern_data_store *schema = &gs_desc->base_mmap->schema;
+	Snapshot		snapshot = GetActiveSnapshot();
+	uint8		   *h_valid;
+	cl_uint			nitems = schema->nitems;
+	cl_uint			nvisibles = 0;
+	cl_uint			rowid;
+	int				j;
+
+	Assert(tupdesc->natts + 1 == schema->ncols);
+	h_valid = MemoryContextAllocExtended(CurrentMemoryContext,
+										 BITMAPLEN(Max(nitems, 1)),
+										 MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+	for (rowid=0; rowid < nitems; rowid++)
+	{
+		bool	visible;
+
+		gstoreFdwSpinLockBaseRow(gs_desc, rowid);
+		visible = gstoreCheckVisibilityForRead(gs_desc, rowid,
+											   snapshot, NULL);
+		gstoreFdwSpinUnlockBaseRow(gs_desc, rowid);
+		if (visible)
+		{
+			h_valid[rowid >> 3] |= (1 << (rowid & 7));
+			nvisibles++;
+		}
+	}
+
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		kern_colmeta   *cmeta = &schema->colmeta[j];
+		gpuAnalyzeState *gas;
+
+		if (!gpuAnalyzeSupportedColumn(tupleDescAttr(tupdesc, j)))
+			continue;
+		gas = gpuAnalyzeBeginColumn(frel, j+1, (double)nvisibles,
+									gs_sstate->cuda_dindex);
+		for (rowid=0; rowid < nitems; rowid++)
+		{
+			Datum	datum;
+			bool	isnull;
+
+			if ((h_valid[rowid >> 3] & (1 << (rowid & 7))) == 0)
+				continue;
+			datum = KDS_fetch_datum_column(schema, cmeta, rowid, &isnull);
+			gpuAnalyzePutDatum(gas, datum, isnull);
+		}
+		gpuAnalyzeEndColumn(gas);
+	}
+	pfree(h_valid);
+
+	return (double)nvisibles;
+}
+
+/*
+ * __gstoreFdwHostBufferCompaction
+ *
+ * note; caller must have AccessExclusiveLock
+ */
+static void
+__gstoreFdwHostBufferCompaction(Relation frel)
+{
+	GpuStoreDesc	*gs_desc = gstoreFdwLookupGpuStoreDesc(frel);
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	kern_data_store *kds = &gs_desc->base_mmap->schema;
+	kern_data_extra	*old_extra;
+	kern_data_extra *new_extra;
+	uint32			old_revision = gs_sstate->base_mmap_revision;
+	size_t			new_length;
+	size_t			file_sz;
+	cl_uint			i, j;
+	int				rawfd;
+
+	if (!kds->has_varlena)
+		return;		/* nothing to do */
+
+	old_extra = (kern_data_extra *)((char *)kds + kds->extra_hoffset);
+	new_length = PAGE_ALIGN(old_extra->usage);
+	new_extra = MemoryContextAllocHuge(CurrentMemoryContext, new_length);
+	memcpy(new_extra->signature, GPUSTORE_EXTRABUF_SIGNATURE, 8);
+	new_extra->length = new_length;		/* tentative */
+	new_extra->usage  = offsetof(kern_data_extra, data);
+
+	Assert(kds->format == KDS_FORMAT_COLUMN);
+	for (j=0; j < kds->ncols; j++)
+	{
+		kern_colmeta   *cmeta = &kds->colmeta[j];
+		bits8		   *nullmap = NULL;
+		cl_uint		   *values;
+
+		if (cmeta->attlen != -1)
+			continue;
+		Assert(!cmeta->attbyval);
+
+		if (cmeta->nullmap_offset != 0)
+			nullmap = (bits8 *)((char *)kds + __kds_unpack(cmeta->nullmap_offset));
 		values = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
 		for (i=0; i < kds->nitems; i++)
 		{
@@ -4924,75 +7135,262 @@ __gstoreFdwGetCudaModule(CUmodule *p_cuda_module, cl_int cuda_dindex)
 
 static CUresult	__gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc);
 static CUresult	__gstoreFdwBackgroundInitialLoadNoLock(GpuStoreDesc *gs_desc);
+static CUresult	__gstoreFdwBackgroundRebuildAggView(GpuStoreDesc *gs_desc);
 
 /*
- * GstoreFdwBackgrondInitialLoad
+ * __gstoreFdwLoadMainByGpuDirect
+ *
+ * It loads the main portion of the base file onto the device buffer using
+ * GPUDirect SQL, instead of cuMemcpyHtoD() from the mmap'ed base file that
+ * reads the entire file through the page cache. Because the schema is not
+ * page-aligned in the file, pages are read into the staging buffers then
+ * copied to the destination; a staging buffer is copied asynchronously,
+ * while the file is read into the other one.
+ * It returns false if GPUDirect SQL is not available or failed, then caller
+ * should load the main portion from the host memory.
  */
-static CUresult
-__gstoreFdwBackgroundInitialLoadNoLock(GpuStoreDesc *gs_desc)
+#define GSTORE_GPUDIRECT_STAGING_SZ		(64UL << 20)	/* 64MB */
+
+static bool
+__gstoreFdwLoadMainByGpuDirect(GpuStoreDesc *gs_desc)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
 	GpuStoreBaseFileHead *base_mmap = gs_desc->base_mmap;
 	kern_data_store *schema = &base_mmap->schema;
-	const char *ftable_name = base_mmap->ftable_name;
+	GPUDirectFileDesc gds_fdesc;
+	volatile bool gds_fdesc_valid = false;
+	volatile bool retval = false;
+	CUdeviceptr	m_staging[2] = { 0UL, 0UL };
+	unsigned long iomap_handle[2] = { 0UL, 0UL };
+	CUevent		ev_staging[2] = { NULL, NULL };
+	CUstream	cuda_stream = NULL;
+	int			i;
 	CUresult	rc;
 
-	/* main portion of the device buffer */
-	rc = cuMemAlloc(&gs_desc->gpu_main_devptr, schema->length);
-	if (rc != CUDA_SUCCESS)
-	{
-		elog(WARNING, "failed on cuMemAlloc: %s", errorText(rc));
-		goto error_0;
-	}
-	rc = cuMemcpyHtoD(gs_desc->gpu_main_devptr, schema, schema->length);
-	if (rc != CUDA_SUCCESS)
+	if (gs_desc->base_mmap_is_pmem ||
+		GetOptimalGpuForFilePath(gs_sstate->base_file) < 0)
+		return false;
+	/* system attributes might be fixed up on the mmap'ed base file */
+	if (pmem_msync(base_mmap, gs_desc->base_mmap_sz) != 0)
 	{
-		elog(WARNING, "failed on cuMemcpyHtoD: %s", errorText(rc));
-		goto error_1;
+		elog(WARNING, "failed on pmem_msync('%s'): %m", gs_sstate->base_file);
+		return false;
 	}
-	rc = cuIpcGetMemHandle(&gs_sstate->gpu_main_mhandle,
-						   gs_desc->gpu_main_devptr);
+
+	/* staging buffers */
+	rc = cuStreamCreate(&cuda_stream, CU_STREAM_NON_BLOCKING);
 	if (rc != CUDA_SUCCESS)
 	{
-		elog(WARNING, "failed on cuIpcGetMemHandle: %s", errorText(rc));
-		goto error_1;
+		elog(WARNING, "failed on cuStreamCreate: %s", errorText(rc));
+		goto bailout;
 	}
-	gs_sstate->gpu_main_size = schema->length;
-	/*
-	 * extra portion of the device buffer (if needed).
-	 */
-	if (schema->has_varlena)
+	for (i=0; i < 2; i++)
 	{
-		kern_data_extra *extra = (kern_data_extra *)
-			((char *)schema + schema->extra_hoffset);
-
-		rc = cuMemAllocManaged(&gs_desc->gpu_extra_devptr,
-							   extra->length,
-							   CU_MEM_ATTACH_GLOBAL);
+		rc = cuMemAlloc(&m_staging[i], GSTORE_GPUDIRECT_STAGING_SZ);
 		if (rc != CUDA_SUCCESS)
 		{
-			elog(WARNING, "failed on cuMemAllocManaged: %s", errorText(rc));
-			goto error_1;
+			elog(WARNING, "failed on cuMemAlloc: %s", errorText(rc));
+			m_staging[i] = 0UL;
+			goto bailout;
 		}
-		memcpy((void *)gs_desc->gpu_extra_devptr, extra, extra->usage);
-
-		/* compaction, and swap device extra buffer */
-		rc = __gstoreFdwBackgroundCompationNoLock(gs_desc);
+		rc = gpuDirectMapGpuMemory(m_staging[i],
+								   GSTORE_GPUDIRECT_STAGING_SZ,
+								   &iomap_handle[i]);
 		if (rc != CUDA_SUCCESS)
-			goto error_2;
+		{
+			elog(WARNING, "failed on gpuDirectMapGpuMemory: %s",
+				 errorText(rc));
+			goto bailout;
+		}
+		rc = cuEventCreate(&ev_staging[i], CU_EVENT_DISABLE_TIMING);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "failed on cuEventCreate: %s", errorText(rc));
+			ev_staging[i] = NULL;
+			goto bailout;
+		}
 	}
-	elog(LOG, "gstore_fdw: initial load [%s] - main %zu bytes, extra %zu bytes",
-		 ftable_name,
-		 gs_sstate->gpu_main_size,
-		 gs_sstate->gpu_extra_size);
+
+	PG_TRY();
+	{
+		size_t		file_base = offsetof(GpuStoreBaseFileHead, schema);
+		size_t		offset;
+		int			k;
+
+		gpuDirectFileDescOpenByPath(&gds_fdesc, gs_sstate->base_file);
+		gds_fdesc_valid = true;
+
+		for (offset=0, k=0; offset < schema->length; k++)
+		{
+			strom_io_vector iovec;
+			size_t		file_pos = file_base + offset;
+			size_t		shift = file_pos & (PAGE_SIZE - 1);
+			size_t		nbytes;
+
+			i = (k & 1);
+			/* wait for the previous copy from this staging buffer */
+			rc = cuEventSynchronize(ev_staging[i]);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuEventSynchronize: %s",
+					 errorText(rc));
+			nbytes = Min(schema->length - offset,
+						 GSTORE_GPUDIRECT_STAGING_SZ - shift);
+			iovec.nr_chunks = 1;
+			iovec.ioc[0].m_offset  = 0;
+			iovec.ioc[0].fchunk_id = file_pos / PAGE_SIZE;
+			iovec.ioc[0].nr_pages  = (shift + nbytes +
+									  PAGE_SIZE - 1) / PAGE_SIZE;
+			gpuDirectFileReadIOV(&gds_fdesc,
+								 m_staging[i],
+								 iomap_handle[i],
+								 0,
+								 &iovec);
+			rc = cuMemcpyDtoDAsync(gs_desc->gpu_main_devptr + offset,
+								   m_staging[i] + shift,
+								   nbytes,
+								   cuda_stream);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuMemcpyDtoDAsync: %s", errorText(rc));
+			rc = cuEventRecord(ev_staging[i], cuda_stream);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuEventRecord: %s", errorText(rc));
+			offset += nbytes;
+		}
+		rc = cuStreamSynchronize(cuda_stream);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+		retval = true;
+	}
+	PG_CATCH();
+	{
+		/* not a fatal error; caller loads the main portion from the host */
+		EmitErrorReport();
+		FlushErrorState();
+	}
+	PG_END_TRY();
+
+bailout:
+	if (cuda_stream)
+		cuStreamSynchronize(cuda_stream);
+	for (i=0; i < 2; i++)
+	{
+		if (ev_staging[i])
+			cuEventDestroy(ev_staging[i]);
+		if (m_staging[i] != 0UL)
+		{
+			if (iomap_handle[i] != 0UL)
+				gpuDirectUnmapGpuMemory(m_staging[i], iomap_handle[i]);
+			cuMemFree(m_staging[i]);
+		}
+	}
+	if (cuda_stream)
+		cuStreamDestroy(cuda_stream);
+	if (gds_fdesc_valid)
+		gpuDirectFileDescClose(&gds_fdesc);
+	if (retval)
+		elog(LOG, "gstore_fdw: main portion of [%s] was loaded by GPUDirect SQL",
+			 base_mmap->ftable_name);
+	return retval;
+}
+
+/*
+ * GstoreFdwBackgrondInitialLoad
+ */
+static CUresult
+__gstoreFdwBackgroundInitialLoadNoLock(GpuStoreDesc *gs_desc)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	GpuStoreBaseFileHead *base_mmap = gs_desc->base_mmap;
+	kern_data_store *schema = &base_mmap->schema;
+	const char *ftable_name = base_mmap->ftable_name;
+	CUresult	rc;
+
+	/* main portion of the device buffer */
+	rc = cuMemAlloc(&gs_desc->gpu_main_devptr, schema->length);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(WARNING, "failed on cuMemAlloc: %s", errorText(rc));
+		goto error_0;
+	}
+	if (!__gstoreFdwLoadMainByGpuDirect(gs_desc))
+	{
+		rc = cuMemcpyHtoD(gs_desc->gpu_main_devptr, schema, schema->length);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "failed on cuMemcpyHtoD: %s", errorText(rc));
+			goto error_1;
+		}
+	}
+	rc = cuIpcGetMemHandle(&gs_sstate->gpu_main_mhandle,
+						   gs_desc->gpu_main_devptr);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(WARNING, "failed on cuIpcGetMemHandle: %s", errorText(rc));
+		goto error_1;
+	}
+	gs_sstate->gpu_main_size = schema->length;
+	/*
+	 * extra portion of the device buffer (if needed).
+	 */
+	if (schema->has_varlena)
+	{
+		kern_data_extra *extra = (kern_data_extra *)
+			((char *)schema + schema->extra_hoffset);
+
+		rc = cuMemAllocManaged(&gs_desc->gpu_extra_devptr,
+							   extra->length,
+							   CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "failed on cuMemAllocManaged: %s", errorText(rc));
+			goto error_1;
+		}
+		memcpy((void *)gs_desc->gpu_extra_devptr, extra, extra->usage);
+
+		/* compaction, and swap device extra buffer */
+		rc = __gstoreFdwBackgroundCompationNoLock(gs_desc);
+		if (rc != CUDA_SUCCESS)
+			goto error_2;
+	}
+	/*
+	 * aggregate view (if any) is built from the loaded rows, then
+	 * maintained by the redo logs.
+	 */
+	if (gs_sstate->aggview)
+	{
+		kern_gpustore_aggview *aggview = gs_sstate->aggview;
+
+		rc = cuMemAllocManaged(&gs_desc->gpu_aggview_devptr,
+							   KERN_GPUSTORE_AGGVIEW_LENGTH(aggview->nslots,
+															aggview->nrooms),
+							   CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "failed on cuMemAllocManaged: %s", errorText(rc));
+			goto error_2;
+		}
+		memcpy((void *)gs_desc->gpu_aggview_devptr, aggview,
+			   sizeof(kern_gpustore_aggview));
+		rc = __gstoreFdwBackgroundRebuildAggView(gs_desc);
+		if (rc != CUDA_SUCCESS)
+			goto error_3;
+	}
+	elog(LOG, "gstore_fdw: initial load [%s] - main %zu bytes, extra %zu bytes",
+		 ftable_name,
+		 gs_sstate->gpu_main_size,
+		 gs_sstate->gpu_extra_size);
 
 	return CUDA_SUCCESS;
 
+error_3:
+	cuMemFree(gs_desc->gpu_aggview_devptr);
 error_2:
-	cuMemFree(gs_desc->gpu_extra_devptr);
+	if (gs_desc->gpu_extra_devptr != 0UL)
+		cuMemFree(gs_desc->gpu_extra_devptr);
 error_1:
 	cuMemFree(gs_desc->gpu_main_devptr);
 error_0:
+	gs_desc->gpu_aggview_devptr = 0UL;
 	gs_desc->gpu_extra_devptr = 0UL;
 	gs_desc->gpu_main_devptr = 0UL;
 	memset(&gs_sstate->gpu_main_mhandle, 0, sizeof(CUipcMemHandle));
@@ -5015,35 +7413,39 @@ GstoreFdwBackgroundInitialLoad(GpuStoreDesc *gs_desc)
 }
 
 /*
- * GSTORE_BACKGROUND_CMD__COMPACTION command
+ * __gstoreFdwBackgroundBuildCompactExtra
+ *
+ * It builds a compacted extra buffer on the new device memory. If
+ * 'm_new_values' is valid, offsets of the varlena values are written to
+ * this array, and the main buffer is not modified.
  */
 static CUresult
-__gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
+__gstoreFdwBackgroundBuildCompactExtra(GpuStoreDesc *gs_desc,
+									   CUdeviceptr m_new_values,
+									   CUdeviceptr *p_new_extra,
+									   CUipcMemHandle *p_new_mhandle,
+									   size_t *p_new_length)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
 	kern_data_extra	h_extra;
 	CUdeviceptr		m_new_extra;
-	CUdeviceptr		m_temp;
 	CUipcMemHandle	new_extra_mhandle;
 	CUmodule		cuda_module;
 	CUfunction		kfunc_compaction;
+	CUfunction		kfunc_dict = NULL;
+	CUdeviceptr		m_dict = 0UL;
+	kern_gpustore_dictionary *h_dict = NULL;
+	size_t			dict_sz = 0;
 	CUresult		rc;
 	size_t			curr_usage;
 	int				grid_sz, block_sz;
-	void		   *kern_args[4];
+	int				j, ndicts = 0;
+	void		   *kern_args[5];
 
 	memset(&h_extra, 0, offsetof(kern_data_extra, data));
 	memcpy(h_extra.signature, GPUSTORE_EXTRABUF_SIGNATURE, 8);
 	h_extra.usage  = offsetof(kern_data_extra, data);
 
-	/* device memory must be allocated first of all */
-	if (gs_desc->gpu_main_devptr == 0UL)
-	{
-		rc = GstoreFdwBackgroundInitialLoad(gs_desc);
-		if (rc != CUDA_SUCCESS)
-			return rc;
-	}
-
 	/*
 	 * Lookup kern_gpustore_compaction device function
 	 */
@@ -5070,6 +7472,44 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 		return rc;
 	grid_sz = Min(grid_sz, (gs_sstate->max_num_rows +
 							block_sz - 1) / block_sz);
+
+	/*
+	 * hash table to de-duplicate values of the dictionary-compressed columns
+	 */
+	for (j=0; j < GSTORE_DICT_MAX_COLUMNS; j++)
+	{
+		if ((gs_sstate->dict_columns[j >> 5] & (1U << (j & 0x1f))) != 0)
+			ndicts++;
+	}
+	if (ndicts > 0)
+	{
+		size_t		nslots;
+
+		rc = cuModuleGetFunction(&kfunc_dict, cuda_module,
+								 "kern_gpustore_compaction_dict");
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "GPU kernel function 'kern_gpustore_compaction_dict' not found: %s",
+				 errorText(rc));
+			return rc;
+		}
+		nslots = 2 * (size_t)ndicts * gs_desc->base_mmap->schema.nitems + 1000;
+		nslots = Min(nslots, UINT_MAX);
+		dict_sz = offsetof(kern_gpustore_dictionary, slots[nslots]);
+		rc = cuMemAllocManaged(&m_dict, dict_sz, CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "failed on cuMemAllocManaged(%zu): %s",
+				 dict_sz, errorText(rc));
+			return rc;
+		}
+		h_dict = (kern_gpustore_dictionary *)m_dict;
+		memset(h_dict, 0, dict_sz);
+		h_dict->nslots = nslots;
+		memcpy(h_dict->columns, gs_sstate->dict_columns,
+			   sizeof(gs_sstate->dict_columns));
+	}
+
 	/*
 	 * estimation of the required device memory. this dummy extra buffer
 	 * is initialized usage > length, so compaction kernel never copy
@@ -5080,7 +7520,7 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 	if (rc != CUDA_SUCCESS)
 	{
 		elog(WARNING, "failed on cuMemAllocManaged: %s", errorText(rc));
-		return rc;
+		goto bailout_dict;
 	}
 	memcpy((void *)m_new_extra, &h_extra, sizeof(kern_data_extra));
 
@@ -5088,6 +7528,8 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 	kern_args[0] = &gs_desc->gpu_main_devptr;
 	kern_args[1] = &gs_desc->gpu_extra_devptr;
 	kern_args[2] = &m_new_extra;
+	kern_args[3] = &m_new_values;
+	kern_args[4] = &m_dict;
 	rc = cuLaunchKernel(kfunc_compaction,
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
@@ -5116,6 +7558,10 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 	rc = cuMemFree(m_new_extra);
 	if (rc != CUDA_SUCCESS)
 		elog(WARNING, "failed on cuMemFree: %s", errorText(rc));
+	/* reset the dictionary for the main portion */
+	if (h_dict)
+		memset(h_dict->slots, 0, dict_sz - offsetof(kern_gpustore_dictionary,
+													slots));
 
 	/* main portion of the compaction */
 	rc = cuMemAlloc(&m_new_extra, h_extra.length);
@@ -5123,7 +7569,7 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 	{
 		elog(WARNING, "failed on cuMemAlloc(%zu): %s",
 			 h_extra.length, errorText(rc));
-		return rc;
+		goto bailout_dict;
 	}
 	rc = cuIpcGetMemHandle(&new_extra_mhandle, m_new_extra);
 	if (rc != CUDA_SUCCESS)
@@ -5141,6 +7587,8 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 	kern_args[0] = &gs_desc->gpu_main_devptr;
 	kern_args[1] = &gs_desc->gpu_extra_devptr;
 	kern_args[2] = &m_new_extra;
+	kern_args[3] = &m_new_values;
+	kern_args[4] = &m_dict;
 	rc = cuLaunchKernel(kfunc_compaction,
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
@@ -5153,6 +7601,26 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 		elog(WARNING, "failed on cuLaunchKernel: %s", errorText(rc));
 		goto bailout;
 	}
+	/* assign offsets of the de-duplicated values */
+	if (kfunc_dict)
+	{
+		kern_args[0] = &gs_desc->gpu_main_devptr;
+		kern_args[1] = &gs_desc->gpu_extra_devptr;
+		kern_args[2] = &m_new_values;
+		kern_args[3] = &m_dict;
+		rc = cuLaunchKernel(kfunc_dict,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_THREAD,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "failed on cuLaunchKernel: %s", errorText(rc));
+			goto bailout;
+		}
+	}
 	/* check status of the kernel execution status */
 	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
@@ -5163,27 +7631,181 @@ __gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
 
 	elog(LOG, "gstore_fdw: extra compaction {length=%zu->%zu, usage=%zu}",
 		 gs_sstate->gpu_extra_size, h_extra.length, h_extra.usage);
-	/* All Ok, swap old and new */
-	m_temp = gs_desc->gpu_extra_devptr;
-	gs_desc->gpu_extra_devptr = m_new_extra;
-	m_new_extra = m_temp;
-	gs_sstate->gpu_extra_size = h_extra.length;
-	memcpy(&gs_sstate->gpu_extra_mhandle,
-		   &new_extra_mhandle, sizeof(CUipcMemHandle));
+	*p_new_extra = m_new_extra;
+	*p_new_length = h_extra.length;
+	memcpy(p_new_mhandle, &new_extra_mhandle, sizeof(CUipcMemHandle));
+	if (m_dict != 0UL)
+		cuMemFree(m_dict);
+	return CUDA_SUCCESS;
+
 bailout:
 	cuMemFree(m_new_extra);
+bailout_dict:
+	if (m_dict != 0UL)
+		cuMemFree(m_dict);
+	return rc;
+}
+
+/*
+ * __gstoreFdwBackgroundSwitchExtra
+ *
+ * It replaces the extra buffer by the compacted one, then releases the old
+ * buffer. Caller must hold the gpu_bufer_lock in exclusive mode.
+ */
+static void
+__gstoreFdwBackgroundSwitchExtra(GpuStoreDesc *gs_desc,
+								 CUdeviceptr m_new_extra,
+								 CUipcMemHandle *new_mhandle,
+								 size_t new_length)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	CUdeviceptr	m_old_extra = gs_desc->gpu_extra_devptr;
+	CUresult	rc;
+
+	gs_desc->gpu_extra_devptr = m_new_extra;
+	gs_sstate->gpu_extra_size = new_length;
+	memcpy(&gs_sstate->gpu_extra_mhandle,
+		   new_mhandle, sizeof(CUipcMemHandle));
+	if (m_old_extra != 0UL)
+	{
+		rc = cuMemFree(m_old_extra);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on cuMemFree: %s", errorText(rc));
+	}
+}
+
+/*
+ * __gstoreFdwBackgroundCompationNoLock
+ *
+ * It runs compaction of the extra buffer, and modifies the main buffer in
+ * place. Caller must hold the gpu_bufer_lock in exclusive mode.
+ */
+static CUresult
+__gstoreFdwBackgroundCompationNoLock(GpuStoreDesc *gs_desc)
+{
+	CUdeviceptr		m_new_extra;
+	CUipcMemHandle	new_mhandle;
+	size_t			new_length;
+	CUresult		rc;
+
+	/* device memory must be allocated first of all */
+	if (gs_desc->gpu_main_devptr == 0UL)
+	{
+		rc = GstoreFdwBackgroundInitialLoad(gs_desc);
+		if (rc != CUDA_SUCCESS)
+			return rc;
+	}
+	rc = __gstoreFdwBackgroundBuildCompactExtra(gs_desc, 0UL,
+												&m_new_extra,
+												&new_mhandle,
+												&new_length);
+	if (rc == CUDA_SUCCESS)
+		__gstoreFdwBackgroundSwitchExtra(gs_desc, m_new_extra,
+										 &new_mhandle, new_length);
 	return rc;
 }
 
 /*
  * GSTORE_BACKGROUND_CMD__COMPACTION command
+ *
+ * The compacted extra buffer is built as copy-on-write; its varlena offsets
+ * are kept in a separate device array, so concurrent GpuScan can read the
+ * main and old extra buffer under the shared lock. Then, we switch to the
+ * new extra buffer under the exclusive lock, that waits for the completion
+ * of the tasks which mapped the old buffer. The exclusive section is just
+ * a copy of the offsets on the device.
+ * Only the GpuStore maintainer modifies the device buffers, so no redo log
+ * is applied between the build and the switch.
  */
 static CUresult
 GstoreFdwBackgroundCompation(GpuStoreDesc *gs_desc)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
-	CUresult	rc;
+	kern_data_store *schema = &gs_desc->base_mmap->schema;
+	CUdeviceptr		m_new_values = 0UL;
+	CUdeviceptr		m_new_extra;
+	CUipcMemHandle	new_mhandle;
+	size_t			new_length;
+	CUmodule		cuda_module;
+	CUfunction		kfunc_switch;
+	int				grid_sz, block_sz;
+	void		   *kern_args[2];
+	int				j, nvarlena = 0;
+	CUresult		rc;
+
+	for (j=0; j < schema->ncols - 1; j++)
+	{
+		kern_colmeta   *cmeta = &schema->colmeta[j];
+
+		if (!cmeta->attbyval && cmeta->attlen == -1)
+			nvarlena++;
+	}
+	if (gs_desc->gpu_main_devptr == 0UL || nvarlena == 0)
+		goto blocking;
 
+	rc = __gstoreFdwGetCudaModule(&cuda_module, gs_sstate->cuda_dindex);
+	if (rc != CUDA_SUCCESS)
+		goto blocking;
+	rc = cuModuleGetFunction(&kfunc_switch, cuda_module,
+							 "kern_gpustore_compaction_switch");
+	if (rc != CUDA_SUCCESS)
+		goto blocking;
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   kfunc_switch,
+							   gs_sstate->cuda_dindex, 0, 0);
+	if (rc != CUDA_SUCCESS)
+		goto blocking;
+	grid_sz = Min(grid_sz, (gs_sstate->max_num_rows +
+							block_sz - 1) / block_sz);
+
+	rc = cuMemAlloc(&m_new_values, sizeof(cl_uint) *
+					(size_t)schema->nrooms * nvarlena);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gstore_fdw: no device memory for online compaction, so fallback to the blocking mode: %s",
+			 errorText(rc));
+		goto blocking;
+	}
+
+	/* build the new extra buffer, concurrently with GpuScan */
+	pthreadRWLockReadLock(&gs_sstate->gpu_bufer_lock);
+	rc = __gstoreFdwBackgroundBuildCompactExtra(gs_desc, m_new_values,
+												&m_new_extra,
+												&new_mhandle,
+												&new_length);
+	pthreadRWLockUnlock(&gs_sstate->gpu_bufer_lock);
+	if (rc != CUDA_SUCCESS)
+		goto bailout;
+
+	/* switch to the new extra buffer */
+	pthreadRWLockWriteLock(&gs_sstate->gpu_bufer_lock);
+	kern_args[0] = &gs_desc->gpu_main_devptr;
+	kern_args[1] = &m_new_values;
+	rc = cuLaunchKernel(kfunc_switch,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc == CUDA_SUCCESS)
+		rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc == CUDA_SUCCESS)
+		__gstoreFdwBackgroundSwitchExtra(gs_desc, m_new_extra,
+										 &new_mhandle, new_length);
+	else
+	{
+		elog(WARNING, "failed on kern_gpustore_compaction_switch: %s",
+			 errorText(rc));
+		cuMemFree(m_new_extra);
+	}
+	pthreadRWLockUnlock(&gs_sstate->gpu_bufer_lock);
+bailout:
+	cuMemFree(m_new_values);
+	return rc;
+
+blocking:
 	pthreadRWLockWriteLock(&gs_sstate->gpu_bufer_lock);
 	rc = __gstoreFdwBackgroundCompationNoLock(gs_desc);
 	pthreadRWLockUnlock(&gs_sstate->gpu_bufer_lock);
@@ -5209,6 +7831,9 @@ __gstoreFdwCallKernelApplyRedo(GpuStoreDesc *gs_desc,
 	int			block_sz, __block_sz;
 	void	   *kern_args[4];
 
+	if (!gstore_fdw_apply_stream)
+		gstore_fdw_apply_stream = CU_STREAM_PER_THREAD;
+
 	rc = __gstoreFdwGetCudaModule(&cuda_module, cuda_dindex);
 	if (rc != CUDA_SUCCESS)
 		return rc;
@@ -5249,7 +7874,7 @@ retry:
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
 						0,
-						CU_STREAM_PER_THREAD,
+						gstore_fdw_apply_stream,
 						kern_args,
 						NULL);
 	if (rc != CUDA_SUCCESS)
@@ -5266,7 +7891,7 @@ retry:
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
 						0,
-						CU_STREAM_PER_THREAD,
+						gstore_fdw_apply_stream,
 						kern_args,
 						NULL);
 	if (rc != CUDA_SUCCESS)
@@ -5283,7 +7908,7 @@ retry:
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
 						0,
-						CU_STREAM_PER_THREAD,
+						gstore_fdw_apply_stream,
 						kern_args,
 						NULL);
 	if (rc != CUDA_SUCCESS)
@@ -5300,7 +7925,24 @@ retry:
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
 						0,
-						CU_STREAM_PER_THREAD,
+						gstore_fdw_apply_stream,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(WARNING, "failed on cuLaunchKernel: %s", errorText(rc));
+		goto out_error;
+	}
+
+	/*
+	 * apply redo logs (phase-4) - apply COMMIT logs
+	 */
+	phase = 4;
+	rc = cuLaunchKernel(kfunc_apply_redo,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						gstore_fdw_apply_stream,
 						kern_args,
 						NULL);
 	if (rc != CUDA_SUCCESS)
@@ -5308,60 +7950,344 @@ retry:
 		elog(WARNING, "failed on cuLaunchKernel: %s", errorText(rc));
 		goto out_error;
 	}
+	/* check status of the kernel execution status */
+	rc = cuStreamSynchronize(gstore_fdw_apply_stream);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+
+	if (h_redo->kerror.errcode == ERRCODE_OUT_OF_MEMORY)
+	{
+		rc = __gstoreFdwBackgroundCompationNoLock(gs_desc);
+		if (rc == CUDA_SUCCESS)
+		{
+			memset(&h_redo->kerror, 0, sizeof(kern_errorbuf));
+			goto retry;
+		}
+	}
+	return CUDA_SUCCESS;
+
+out_error:
+	cuStreamSynchronize(gstore_fdw_apply_stream);
+	return rc;
+}
+
+/*
+ * __gstoreFdwCallKernelAggView
+ *
+ * It adds (sign > 0) or removes (sign < 0) the committed rows on 'm_rowids'
+ * to/from the aggregate view. If 'm_rowids' is NULL, the first 'nitems'
+ * rows are accumulated.
+ */
+static CUresult
+__gstoreFdwCallKernelAggView(GpuStoreDesc *gs_desc,
+							 CUdeviceptr m_rowids,
+							 cl_uint nitems,
+							 cl_int sign)
+{
+	int			cuda_dindex = gs_desc->gs_sstate->cuda_dindex;
+	CUmodule	cuda_module;
+	CUfunction	kfunc_aggview;
+	CUresult	rc;
+	int			grid_sz;
+	int			block_sz;
+	void	   *kern_args[6];
+
+	if (nitems == 0)
+		return CUDA_SUCCESS;
+	if (!gstore_fdw_apply_stream)
+		gstore_fdw_apply_stream = CU_STREAM_PER_THREAD;
+
+	rc = __gstoreFdwGetCudaModule(&cuda_module, cuda_dindex);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	rc = cuModuleGetFunction(&kfunc_aggview, cuda_module,
+							 "kern_gpustore_aggview_update");
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   kfunc_aggview,
+							   cuda_dindex, 0, 0);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	grid_sz = Min(grid_sz, (nitems + block_sz - 1) / block_sz);
+
+	kern_args[0] = &gs_desc->gpu_main_devptr;
+	kern_args[1] = &gs_desc->gpu_extra_devptr;
+	kern_args[2] = &gs_desc->gpu_aggview_devptr;
+	kern_args[3] = &m_rowids;
+	kern_args[4] = &nitems;
+	kern_args[5] = &sign;
+	rc = cuLaunchKernel(kfunc_aggview,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						gstore_fdw_apply_stream,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on cuLaunchKernel: %s", errorText(rc));
+	return rc;
+}
+
+/*
+ * __gstoreFdwBackgroundSnapshotAggView
+ *
+ * It copies the aggregate view on the (managed) device memory to the
+ * shared snapshot. Caller must synchronize the stream.
+ */
+static void
+__gstoreFdwBackgroundSnapshotAggView(GpuStoreDesc *gs_desc)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	kern_gpustore_aggview *aggview = (kern_gpustore_aggview *)
+		gs_desc->gpu_aggview_devptr;
+	kern_gpustore_aggview *snapshot = gs_sstate->aggview;
+	cl_uint		nitems = Min(aggview->nitems, aggview->nrooms);
+
+	LWLockAcquire(&gs_sstate->aggview_lock, LW_EXCLUSIVE);
+	memcpy(KERN_GPUSTORE_AGGVIEW_GROUPS(snapshot),
+		   KERN_GPUSTORE_AGGVIEW_GROUPS(aggview),
+		   sizeof(kern_gpustore_aggview_group) * nitems);
+	snapshot->nitems = nitems;
+	snapshot->overflow = aggview->overflow;
+	snapshot->is_valid = (!aggview->overflow && !aggview->needs_rebuild);
+	LWLockRelease(&gs_sstate->aggview_lock);
+}
+
+/*
+ * __gstoreFdwBackgroundRebuildAggView
+ *
+ * It rebuilds the aggregate view from all the committed rows; when DELETE
+ * removed the current MIN/MAX value, or the previous apply failed.
+ */
+static CUresult
+__gstoreFdwBackgroundRebuildAggView(GpuStoreDesc *gs_desc)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	kern_gpustore_aggview *aggview = (kern_gpustore_aggview *)
+		gs_desc->gpu_aggview_devptr;
+	CUresult	rc;
+
+	rc = cuStreamSynchronize(gstore_fdw_apply_stream);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	memset(KERN_GPUSTORE_AGGVIEW_SLOTS(aggview), -1,
+		   sizeof(cl_uint) * aggview->nslots);
+	aggview->nitems = 0;
+	aggview->needs_rebuild = 0;
+	aggview->overflow = 0;
+	rc = __gstoreFdwCallKernelAggView(gs_desc, 0UL,
+									  gs_sstate->max_num_rows, 1);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	rc = cuStreamSynchronize(gstore_fdw_apply_stream);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	if (aggview->overflow)
+		elog(LOG, "gstore_fdw: aggregate view of [%s] has more groups than aggview_max_groups (%u)",
+			 gs_desc->base_mmap->ftable_name, aggview->nrooms);
+	__gstoreFdwBackgroundSnapshotAggView(gs_desc);
+
+	return CUDA_SUCCESS;
+}
+
+/*
+ * __gstoreFdwCollectAggViewRowIds
+ *
+ * It collects the rowids to be modified by the redo logs, without
+ * duplication.
+ */
+static int
+__gstoreFdwCompareRowId(const void *__a, const void *__b)
+{
+	cl_uint		a = *((const cl_uint *)__a);
+	cl_uint		b = *((const cl_uint *)__b);
+
+	return (a < b ? -1 : (a > b ? 1 : 0));
+}
+
+static cl_uint
+__gstoreFdwCollectAggViewRowIds(kern_gpustore_redolog *h_redo,
+								cl_uint *h_rowids)
+{
+	cl_uint		nitems = 0;
+	cl_uint		i, j, k;
+
+	for (i=0; i < h_redo->nitems; i++)
+	{
+		GstoreTxLogCommon *tx_log = (GstoreTxLogCommon *)
+			((char *)h_redo + __kds_unpack(h_redo->log_index[i]));
+
+		if (tx_log->type == GSTORE_TX_LOG__INSERT)
+			h_rowids[nitems++] = ((GstoreTxLogInsert *)tx_log)->rowid;
+		else if (tx_log->type == GSTORE_TX_LOG__DELETE)
+			h_rowids[nitems++] = ((GstoreTxLogDelete *)tx_log)->rowid;
+		else if (tx_log->type == GSTORE_TX_LOG__COMMIT)
+		{
+			GstoreTxLogCommit *c_log = (GstoreTxLogCommit *)tx_log;
+			char	   *pos = c_log->data;
+
+			for (j=0; j < c_log->nitems; j++)
+			{
+				if (*pos != 'I' && *pos != 'D')
+					break;
+				memcpy(&h_rowids[nitems++], pos+1, sizeof(cl_uint));
+				pos += 5;
+			}
+		}
+	}
+	if (nitems == 0)
+		return 0;
+	qsort(h_rowids, nitems, sizeof(cl_uint), __gstoreFdwCompareRowId);
+	for (i=1, k=1; i < nitems; i++)
+	{
+		if (h_rowids[i] != h_rowids[k-1])
+			h_rowids[k++] = h_rowids[i];
+	}
+	return k;
+}
+
+/*
+ * GSTORE_BACKGROUND_CMD__APPLY_REDO command
+ *
+ * It applies the redo logs until 'end_pos' in micro-batches of
+ * gstore_fdw.redo_apply_batch_size entries. redo_read_pos is the watermark;
+ * it moves forward for each micro-batch, and the gpu_bufer_lock is released
+ * between them, so concurrent GpuScan is not blocked during the entire apply.
+ */
+static CUresult
+__gstoreFdwBackgroundApplyRedoBatch(GpuStoreDesc *gs_desc,
+									kern_gpustore_redolog *h_redo,
+									cl_uint *h_rowids,
+									uint64 head_pos,
+									uint64 tail_pos,
+									uint64 *p_curr_pos)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	kern_gpustore_aggview *aggview = (kern_gpustore_aggview *)
+		gs_desc->gpu_aggview_devptr;
+	uint64		curr_pos = head_pos;
+	size_t		offset;
+	cl_uint		index = 0;
+	cl_uint		nrowids = 0;
+	CUresult	rc = CUDA_SUCCESS;
+
+	memset(h_redo, 0, offsetof(kern_gpustore_redolog, log_index));
+	offset = MAXALIGN(offsetof(kern_gpustore_redolog,
+							   log_index[h_redo->nrooms]));
+	while (curr_pos < tail_pos && index < h_redo->nrooms)
+	{
+		uint64		file_pos = (curr_pos % gs_sstate->redo_log_limit);
+		GstoreTxLogCommon *tx_log
+			= (GstoreTxLogCommon *)(gs_desc->redo_mmap + file_pos);
+
+		if (file_pos + offsetof(GstoreTxLogCommon, data) > gs_sstate->redo_log_limit)
+		{
+			curr_pos += (gs_sstate->redo_log_limit - file_pos);
+			continue;
+		}
+		if ((tx_log->type & 0xffffff00U) != GSTORE_TX_LOG__MAGIC)
+		{
+			curr_pos += (gs_sstate->redo_log_limit - file_pos);
+			continue;
+		}
+		Assert(tx_log->length == MAXALIGN(tx_log->length));
+		memcpy((char *)h_redo + offset, tx_log, tx_log->length);
+		h_redo->log_index[index++] = __kds_packed(offset);
+		offset += tx_log->length;
+		curr_pos += tx_log->length;
+	}
+	h_redo->nitems = index;
+	h_redo->length = offset;
 
 	/*
-	 * apply redo logs (phase-4) - apply COMMIT logs
+	 * The aggregate view (if any) is maintained by the rows to be modified;
+	 * it removes their current contribution prior to the apply, then adds
+	 * them again after the apply. Once it overflowed on the rebuild, the
+	 * aggregate view is no longer maintained.
 	 */
-	phase = 4;
-	rc = cuLaunchKernel(kfunc_apply_redo,
-						grid_sz, 1, 1,
-						block_sz, 1, 1,
-						0,
-						CU_STREAM_PER_THREAD,
-						kern_args,
-						NULL);
+	if (aggview && aggview->overflow)
+		aggview = NULL;
+	if (aggview)
+		nrowids = __gstoreFdwCollectAggViewRowIds(h_redo, h_rowids);
+
+	/*
+	 * Kick the kernel to apply REDO log
+	 */
+	pthreadRWLockWriteLock(&gs_sstate->gpu_bufer_lock);
+	if (aggview && !aggview->needs_rebuild)
+		rc = __gstoreFdwCallKernelAggView(gs_desc, (CUdeviceptr)h_rowids,
+										  nrowids, -1);
+	if (rc == CUDA_SUCCESS)
+		rc = __gstoreFdwCallKernelApplyRedo(gs_desc, h_redo);
+	if (rc == CUDA_SUCCESS && aggview)
+	{
+		rc = __gstoreFdwCallKernelAggView(gs_desc, (CUdeviceptr)h_rowids,
+										  nrowids, 1);
+		if (rc == CUDA_SUCCESS)
+			rc = cuStreamSynchronize(gstore_fdw_apply_stream);
+		if (rc == CUDA_SUCCESS)
+		{
+			if (aggview->needs_rebuild)
+				rc = __gstoreFdwBackgroundRebuildAggView(gs_desc);
+			else
+				__gstoreFdwBackgroundSnapshotAggView(gs_desc);
+		}
+	}
 	if (rc != CUDA_SUCCESS)
 	{
-		elog(WARNING, "failed on cuLaunchKernel: %s", errorText(rc));
-		goto out_error;
+		elog(WARNING, "failed on GPU Apply Redo Logs: %s", errorText(rc));
+		if (aggview)
+		{
+			cuStreamSynchronize(gstore_fdw_apply_stream);
+			aggview->needs_rebuild = 1;
+		}
 	}
-	/* check status of the kernel execution status */
-	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
-	if (rc != CUDA_SUCCESS)
-		return rc;
-
-	if (h_redo->kerror.errcode == ERRCODE_OUT_OF_MEMORY)
+	else
 	{
-		rc = __gstoreFdwBackgroundCompationNoLock(gs_desc);
-		if (rc == CUDA_SUCCESS)
+		SpinLockAcquire(&gs_sstate->redo_pos_lock);
+		/*
+		 * Wait for a short moment if any concurrent process fetch redo buffer,
+		 * and update of redo_read_pos may overwrite the redo buffer by the
+		 * following update by OLTP operations.
+		 */
+		while (curr_pos > gs_sstate->redo_repl_pos[0] ||
+			   curr_pos > gs_sstate->redo_repl_pos[1] ||
+			   curr_pos > gs_sstate->redo_repl_pos[2] ||
+			   curr_pos > gs_sstate->redo_repl_pos[3])
 		{
-			memset(&h_redo->kerror, 0, sizeof(kern_errorbuf));
-			goto retry;
+			SpinLockRelease(&gs_sstate->redo_pos_lock);
+			pg_usleep(2000L);	/* 2ms */
+			SpinLockAcquire(&gs_sstate->redo_pos_lock);
 		}
+		gs_sstate->redo_read_pos = curr_pos;
+		gs_sstate->redo_read_nitems += index;
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+
+		elog(DEBUG1, "gstore_fdw: Log applied (nitems=%u, length=%zu, pos %zu => %zu)",
+			 h_redo->nitems,
+			 h_redo->length,
+			 head_pos, curr_pos);
 	}
-	return CUDA_SUCCESS;
+	pthreadRWLockUnlock(&gs_sstate->gpu_bufer_lock);
+	*p_curr_pos = curr_pos;
 
-out_error:
-	cuStreamSynchronize(CU_STREAM_PER_THREAD);
 	return rc;
 }
 
-/*
- * GSTORE_BACKGROUND_CMD__APPLY_REDO command
- */
 static CUresult
 GstoreFdwBackgroundApplyRedoLog(GpuStoreDesc *gs_desc, uint64 end_pos)
 {
 	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
 	size_t		length;
-	size_t		offset;
-	int			index;
 	uint64		nitems;
 	uint64		head_pos;
 	uint64		tail_pos;
 	uint64		curr_pos;
 	kern_gpustore_redolog *h_redo;
 	CUdeviceptr	m_redo = 0UL;
+	CUdeviceptr	m_rowids = 0UL;
 	CUresult	rc;
 
 	/* device memory must be allocated */
@@ -5385,13 +8311,25 @@ GstoreFdwBackgroundApplyRedoLog(GpuStoreDesc *gs_desc, uint64 end_pos)
 	Assert(end_pos <= gs_sstate->redo_write_pos);
 	SpinLockRelease(&gs_sstate->redo_pos_lock);
 
+	/*
+	 * We don't need to apply the logs written after 'end_pos'; the caller
+	 * waits for the logs older than its snapshot only. A micro-batch may
+	 * exceed 'end_pos' until the next log boundary.
+	 */
+	tail_pos = Min(tail_pos, end_pos);
+	if (nitems == 0)
+		nitems = (tail_pos - head_pos) / sizeof(GstoreTxLogDelete) + 1;
+	if (gstore_fdw_redo_apply_batch_size > 0)
+		nitems = Min(nitems, gstore_fdw_redo_apply_batch_size);
+
 	/*
 	 * allocation of managed memory for kern_gpustore_redolog
 	 * (index to log and redo-log itself)
 	 */
 	length = (MAXALIGN(offsetof(kern_gpustore_redolog,
 								log_index[nitems])) +
-			  MAXALIGN(tail_pos - head_pos));
+			  MAXALIGN(Min(tail_pos - head_pos,
+						   gs_sstate->redo_log_limit)));
 	rc = cuMemAllocManaged(&m_redo, length, CU_MEM_ATTACH_GLOBAL);
 	if (rc != CUDA_SUCCESS)
 	{
@@ -5400,77 +8338,114 @@ GstoreFdwBackgroundApplyRedoLog(GpuStoreDesc *gs_desc, uint64 end_pos)
 		return rc;
 	}
 	h_redo = (kern_gpustore_redolog *)m_redo;
-	memset(h_redo, 0, offsetof(kern_gpustore_redolog, log_index));
 	h_redo->nrooms = nitems;
-	h_redo->length = length;
-	offset = MAXALIGN(offsetof(kern_gpustore_redolog,
-							   log_index[nitems]));
-	index = 0;
-	curr_pos = head_pos;
-	while (curr_pos < tail_pos && index < nitems)
-	{
-		uint64		file_pos = (curr_pos % gs_sstate->redo_log_limit);
-		GstoreTxLogCommon *tx_log
-			= (GstoreTxLogCommon *)(gs_desc->redo_mmap + file_pos);
 
-		if (file_pos + offsetof(GstoreTxLogCommon, data) > gs_sstate->redo_log_limit)
-		{
-			curr_pos += (gs_sstate->redo_log_limit - file_pos);
-			continue;
-		}
-		if ((tx_log->type & 0xffffff00U) != GSTORE_TX_LOG__MAGIC)
-		{
-			curr_pos += (gs_sstate->redo_log_limit - file_pos);
-			continue;
-		}
-		Assert(tx_log->length == MAXALIGN(tx_log->length));
-		memcpy((char *)h_redo + offset, tx_log, tx_log->length);
-		h_redo->log_index[index++] = __kds_packed(offset);
-		offset += tx_log->length;
-		curr_pos += tx_log->length;
-	}
-	h_redo->nitems = index;
-	h_redo->length = offset;
-	
 	/*
-	 * Kick the kernel to apply REDO log
+	 * rowids to be modified by a micro-batch, for the aggregate view.
+	 * A commit log entry consumes 5 bytes per row.
 	 */
-	pthreadRWLockWriteLock(&gs_sstate->gpu_bufer_lock);
-	rc = __gstoreFdwCallKernelApplyRedo(gs_desc, h_redo);
-	if (rc != CUDA_SUCCESS)
-	{
-		elog(WARNING, "failed on GPU Apply Redo Logs: %s", errorText(rc));
-	}
-	else
+	if (gs_desc->gpu_aggview_devptr != 0UL)
 	{
-		SpinLockAcquire(&gs_sstate->redo_pos_lock);
-		/*
-		 * Wait for a short moment if any concurrent process fetch redo buffer,
-		 * and update of redo_read_pos may overwrite the redo buffer by the
-		 * following update by OLTP operations.
-		 */
-		while (curr_pos > gs_sstate->redo_repl_pos[0] ||
-			   curr_pos > gs_sstate->redo_repl_pos[1] ||
-			   curr_pos > gs_sstate->redo_repl_pos[2] ||
-			   curr_pos > gs_sstate->redo_repl_pos[3])
+		rc = cuMemAllocManaged(&m_rowids,
+							   sizeof(cl_uint) * (nitems + length / 5),
+							   CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
 		{
-			SpinLockRelease(&gs_sstate->redo_pos_lock);
-			pg_usleep(2000L);	/* 2ms */
-			SpinLockAcquire(&gs_sstate->redo_pos_lock);
+			elog(LOG, "failed on cuMemAllocManaged: %s", errorText(rc));
+			cuMemFree(m_redo);
+			return rc;
 		}
-		gs_sstate->redo_read_pos = curr_pos;
-		SpinLockRelease(&gs_sstate->redo_pos_lock);
+	}
 
-		elog(LOG, "gstore_fdw: Log applied (nitems=%u, length=%zu, pos %zu => %zu)",
-			 h_redo->nitems,
-			 h_redo->length,
-			 head_pos, curr_pos);
+	curr_pos = head_pos;
+	while (curr_pos < tail_pos)
+	{
+		rc = __gstoreFdwBackgroundApplyRedoBatch(gs_desc, h_redo,
+												 (cl_uint *)m_rowids,
+												 curr_pos, tail_pos,
+												 &curr_pos);
+		if (rc != CUDA_SUCCESS)
+			break;
 	}
-	pthreadRWLockUnlock(&gs_sstate->gpu_bufer_lock);
+	elog(LOG, "gstore_fdw: Log applied (pos %zu => %zu)",
+		 head_pos, curr_pos);
 
 	rc = cuMemFree(m_redo);
 	if (rc != CUDA_SUCCESS)
 		elog(WARNING, "failed on cuMemFree: %s", errorText(rc));
+	if (m_rowids != 0UL)
+	{
+		rc = cuMemFree(m_rowids);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on cuMemFree: %s", errorText(rc));
+	}
+
+	return CUDA_SUCCESS;
+}
+
+/*
+ * GSTORE_BACKGROUND_CMD__CHECKPOINT command
+ *
+ * It synchronizes the base file, including the row-id map and hash index,
+ * then records the position of redo log on the base file header. So, the
+ * recovery process needs to replay only the redo logs after the checkpoint.
+ */
+static CUresult
+GstoreFdwBackgroundCheckpoint(GpuStoreDesc *gs_desc)
+{
+	GpuStoreSharedState *gs_sstate = gs_desc->gs_sstate;
+	uint64		checkpoint_pos;
+	struct timeval tv1, tv2;
+	int			i;
+
+	gettimeofday(&tv1, NULL);
+	SpinLockAcquire(&gs_sstate->redo_pos_lock);
+	checkpoint_pos = gs_sstate->redo_write_pos;
+	SpinLockRelease(&gs_sstate->redo_pos_lock);
+
+	/*
+	 * INSERT writes the base file after the redo log under the base_row_lock
+	 * (DELETE updates the base file prior to the redo log), so wait for the
+	 * concurrent writers who put redo logs prior to the checkpoint_pos.
+	 */
+	for (i=0; i < GSTORE_NUM_BASE_ROW_LOCKS; i++)
+	{
+		SpinLockAcquire(&gs_sstate->base_row_lock[i]);
+		SpinLockRelease(&gs_sstate->base_row_lock[i]);
+	}
+
+	LWLockAcquire(&gs_sstate->base_mmap_lock, LW_SHARED);
+	if (gs_desc->base_mmap_revision != gs_sstate->base_mmap_revision &&
+		!gstoreFdwRemapBaseFile(gs_desc, false))
+	{
+		LWLockRelease(&gs_sstate->base_mmap_lock);
+		return CUDA_ERROR_MAP_FAILED;
+	}
+	if (gs_desc->base_mmap_is_pmem)
+		pmem_persist(gs_desc->base_mmap, gs_desc->base_mmap_sz);
+	else if (pmem_msync(gs_desc->base_mmap, gs_desc->base_mmap_sz) != 0)
+	{
+		elog(WARNING, "failed on pmem_msync('%s'): %m", gs_sstate->base_file);
+		LWLockRelease(&gs_sstate->base_mmap_lock);
+		return CUDA_ERROR_MAP_FAILED;
+	}
+	/*
+	 * If redo log buffer is rewound during the synchronization, a newer
+	 * checkpoint was already recorded at the head of the buffer.
+	 */
+	SpinLockAcquire(&gs_sstate->redo_pos_lock);
+	if (checkpoint_pos > gs_sstate->redo_checkpoint_pos)
+	{
+		__gstoreFdwUpdateCheckpoint(gs_desc, checkpoint_pos %
+									gs_sstate->redo_log_limit);
+		gs_sstate->redo_checkpoint_pos = checkpoint_pos;
+	}
+	SpinLockRelease(&gs_sstate->redo_pos_lock);
+	LWLockRelease(&gs_sstate->base_mmap_lock);
+	gettimeofday(&tv2, NULL);
+
+	elog(LOG, "gstore_fdw: checkpoint applied on '%s' [%.2fms]",
+		 gs_sstate->base_file, TV_DIFF(tv2,tv1));
 
 	return CUDA_SUCCESS;
 }
@@ -5500,6 +8475,13 @@ GstoreFdwBackgroundDropUnload(GpuStoreDesc *gs_desc)
 			elog(LOG, "gstore_fdw drop unload: failed on cuMemFree: %s",
 				 errorText(rc));
 	}
+	if (gs_desc->gpu_aggview_devptr != 0UL)
+	{
+		rc = cuMemFree(gs_desc->gpu_aggview_devptr);
+		if (rc != CUDA_SUCCESS)
+			elog(LOG, "gstore_fdw drop unload: failed on cuMemFree: %s",
+				 errorText(rc));
+	}
 	if (gs_desc->base_mmap)
 	{
 		if (pmem_unmap(gs_desc->base_mmap,
@@ -5524,7 +8506,19 @@ GstoreFdwBackgroundDropUnload(GpuStoreDesc *gs_desc)
 void
 gstoreFdwBgWorkerBegin(int cuda_dindex)
 {
+	CUresult	rc;
+
 	Assert(cuda_dindex >= 0 && cuda_dindex < numDevAttrs);
+	/*
+	 * A dedicated stream to apply redo logs, not to be synchronized with
+	 * the other works on the device; e.g, compaction of the extra buffer.
+	 */
+	rc = cuStreamCreate(&gstore_fdw_apply_stream, CU_STREAM_NON_BLOCKING);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "failed on cuStreamCreate: %s", errorText(rc));
+		gstore_fdw_apply_stream = CU_STREAM_PER_THREAD;
+	}
 	SpinLockAcquire(&gstore_shared_head->bgworker_cmd_lock);
 	gstore_shared_head->bgworkers[cuda_dindex].latch = MyLatch;
 	SpinLockRelease(&gstore_shared_head->bgworker_cmd_lock);
@@ -5599,6 +8593,13 @@ __gstoreFdwBgWorkerDispatchCommand(int cuda_dindex, GpuStoreBackgroundCommand *c
 		case GSTORE_BACKGROUND_CMD__DROP_UNLOAD:
 			rc = GstoreFdwBackgroundDropUnload(gs_desc);
 			break;
+		case GSTORE_BACKGROUND_CMD__SYNC_REDO:
+			__gstoreFdwXactSyncRedoLog(gs_desc, cmd->end_pos);
+			rc = CUDA_SUCCESS;
+			break;
+		case GSTORE_BACKGROUND_CMD__CHECKPOINT:
+			rc = GstoreFdwBackgroundCheckpoint(gs_desc);
+			break;
 		default:
 			elog(LOG, "Unsupported Gstore maintainer command: %d", cmd->command);
 			rc = CUDA_ERROR_INVALID_VALUE;
@@ -5650,6 +8651,45 @@ gstoreFdwBgWorkerDispatch(int cuda_dindex)
 	return false;
 }
 
+/*
+ * __gstoreFdwBgWorkerEnqueueCommand
+ *
+ * It enqueues an asynchronous command for the GpuStore maintainer itself.
+ * Caller must hold the redo_pos_lock.
+ */
+static bool
+__gstoreFdwBgWorkerEnqueueCommand(GpuStoreSharedState *gs_sstate,
+								  int command, uint64 end_pos)
+{
+	slock_t	   *cmd_lock = &gstore_shared_head->bgworker_cmd_lock;
+	dlist_head *cmd_flist = &gstore_shared_head->bgworker_free_cmds;
+	dlist_head *cmd_queue =
+		&gstore_shared_head->bgworkers[gs_sstate->cuda_dindex].cmd_queue;
+	bool		retval = false;
+
+	SpinLockAcquire(cmd_lock);
+	if (!dlist_is_empty(cmd_flist))
+	{
+		GpuStoreBackgroundCommand *cmd;
+
+		cmd = dlist_container(GpuStoreBackgroundCommand, chain,
+							  dlist_pop_head_node(cmd_flist));
+		memset(cmd, 0, sizeof(GpuStoreBackgroundCommand));
+		cmd->database_oid = gs_sstate->database_oid;
+		cmd->ftable_oid   = gs_sstate->ftable_oid;
+		cmd->backend      = NULL;
+		cmd->command      = command;
+		cmd->end_pos      = end_pos;
+		cmd->retval       = (CUresult) UINT_MAX;
+
+		dlist_push_tail(cmd_queue, &cmd->chain);
+		retval = true;
+	}
+	SpinLockRelease(cmd_lock);
+
+	return retval;
+}
+
 bool
 gstoreFdwBgWorkerIdleTask(int cuda_dindex)
 {
@@ -5673,38 +8713,62 @@ gstoreFdwBgWorkerIdleTask(int cuda_dindex)
 			if (gs_sstate->cuda_dindex != cuda_dindex)
 				continue;
 			SpinLockAcquire(&gs_sstate->redo_pos_lock);
-			threshold = (gs_sstate->gpu_update_interval * 1000000L +
-						 gs_sstate->redo_last_timestamp);
+			/*
+			 * In the continuous mode, we tail the redo log and apply
+			 * the logs not applied yet, without waiting for the
+			 * 'gpu_update_interval'.
+			 */
+			if (gstore_fdw_continuous_apply)
+				threshold = gs_sstate->redo_last_timestamp;
+			else
+				threshold = (gs_sstate->gpu_update_interval * 1000000L +
+							 gs_sstate->redo_last_timestamp);
 			if (GetCurrentTimestamp () > threshold &&
-				gs_sstate->redo_write_nitems > gs_sstate->redo_read_nitems)
+				gs_sstate->redo_write_pos > gs_sstate->redo_read_pos)
 			{
-				slock_t	   *cmd_lock = &gstore_shared_head->bgworker_cmd_lock;
-				dlist_head *cmd_flist = &gstore_shared_head->bgworker_free_cmds;
-				dlist_head *cmd_queue =
-					&gstore_shared_head->bgworkers[gs_sstate->cuda_dindex].cmd_queue;
-
-				SpinLockAcquire(cmd_lock);
-				if (!dlist_is_empty(cmd_flist))
+				if (__gstoreFdwBgWorkerEnqueueCommand(gs_sstate,
+													  GSTORE_BACKGROUND_CMD__APPLY_REDO,
+													  gs_sstate->redo_write_pos))
 				{
-					GpuStoreBackgroundCommand *cmd;
-
-					cmd = dlist_container(GpuStoreBackgroundCommand, chain,
-										  dlist_pop_head_node(cmd_flist));
-					memset(cmd, 0, sizeof(GpuStoreBackgroundCommand));
-					cmd->database_oid = gs_sstate->database_oid;
-					cmd->ftable_oid   = gs_sstate->ftable_oid;
-					cmd->backend      = NULL;
-					cmd->command      = GSTORE_BACKGROUND_CMD__APPLY_REDO;
-					cmd->end_pos      = gs_sstate->redo_write_pos;
-					cmd->retval       = (CUresult) UINT_MAX;
-
-					dlist_push_tail(cmd_queue, &cmd->chain);
-
-					retval = true;
-
+					/* dispatch the command immediately, if continuous mode */
+					if (gstore_fdw_continuous_apply)
+						retval = false;
 					gs_sstate->redo_last_timestamp = GetCurrentTimestamp();
 				}
-				SpinLockRelease(cmd_lock);
+			}
+			/*
+			 * Sync of the redo logs deferred by 'redo_sync_delay'; it bounds
+			 * the window of the logs that may be lost on system crash.
+			 */
+			if (gs_sstate->redo_sync_delay > 0 &&
+				gs_sstate->redo_write_pos > gs_sstate->redo_sync_pos &&
+				GetCurrentTimestamp() >= (gs_sstate->redo_sync_timestamp +
+										  gs_sstate->redo_sync_delay * 1000L))
+			{
+				if (__gstoreFdwBgWorkerEnqueueCommand(gs_sstate,
+													  GSTORE_BACKGROUND_CMD__SYNC_REDO,
+													  gs_sstate->redo_write_pos))
+				{
+					retval = false;
+					gs_sstate->redo_sync_timestamp = GetCurrentTimestamp();
+				}
+			}
+			/*
+			 * Periodic checkpoint; it bounds the amount of redo logs to be
+			 * replayed on the recovery.
+			 */
+			if (gstore_fdw_checkpoint_interval > 0 &&
+				gs_sstate->redo_write_pos > gs_sstate->redo_checkpoint_pos &&
+				GetCurrentTimestamp() >= (gs_sstate->redo_checkpoint_timestamp +
+										  gstore_fdw_checkpoint_interval * 1000000L))
+			{
+				if (__gstoreFdwBgWorkerEnqueueCommand(gs_sstate,
+													  GSTORE_BACKGROUND_CMD__CHECKPOINT,
+													  gs_sstate->redo_write_pos))
+				{
+					retval = false;
+					gs_sstate->redo_checkpoint_timestamp = GetCurrentTimestamp();
+				}
 			}
 			SpinLockRelease(&gs_sstate->redo_pos_lock);
 		}
@@ -5720,6 +8784,11 @@ gstoreFdwBgWorkerEnd(int cuda_dindex)
 	SpinLockAcquire(&gstore_shared_head->bgworker_cmd_lock);
 	gstore_shared_head->bgworkers[cuda_dindex].latch = NULL;
 	SpinLockRelease(&gstore_shared_head->bgworker_cmd_lock);
+
+	if (gstore_fdw_apply_stream &&
+		gstore_fdw_apply_stream != CU_STREAM_PER_THREAD)
+		cuStreamDestroy(gstore_fdw_apply_stream);
+	gstore_fdw_apply_stream = NULL;
 }
 
 /*
@@ -5931,6 +9000,10 @@ pgstrom_init_gstore_fdw(void)
     r->ExecForeignUpdate			= GstoreExecForeignUpdate;
     r->ExecForeignDelete			= GstoreExecForeignDelete;
     r->EndForeignModify				= GstoreEndForeignModify;
+#if PG_VERSION_NUM >= 110000
+	r->BeginForeignInsert			= GstoreBeginForeignInsert;
+	r->EndForeignInsert				= GstoreEndForeignInsert;
+#endif
 
 	/* EXPLAIN/ANALYZE */
 	r->ExplainForeignScan			= GstoreExplainForeignScan;
@@ -5986,6 +9059,40 @@ pgstrom_init_gstore_fdw(void)
 							   PGC_SUSET,
 							   GUC_NOT_IN_SAMPLE,
 							   NULL, NULL, NULL);
+
+	/* GUC: gstore_fdw.continuous_apply */
+	DefineCustomBoolVariable("gstore_fdw.continuous_apply",
+							 "Enables continuous apply of redo logs on the GPU buffer",
+							 NULL,
+							 &gstore_fdw_continuous_apply,
+							 false,
+							 PGC_POSTMASTER,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/* GUC: gstore_fdw.redo_apply_batch_size */
+	DefineCustomIntVariable("gstore_fdw.redo_apply_batch_size",
+							"Max number of redo logs applied by a kernel call",
+							"0 means no limitation",
+							&gstore_fdw_redo_apply_batch_size,
+							65536,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	/* GUC: gstore_fdw.checkpoint_interval */
+	DefineCustomIntVariable("gstore_fdw.checkpoint_interval",
+							"Interval of the checkpoint of base files",
+							"0 means no periodic checkpoint",
+							&gstore_fdw_checkpoint_interval,
+							300,
+							0,
+							86400,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_S,
+							NULL, NULL, NULL);
 	/*
 	 * Background worker to load GPU store on startup
 	 */
@@ -6021,15 +9128,22 @@ pgstrom_init_gstore_fdw(void)
 }
 
 /*
- * pgstrom.gstore_fdw_replication_base(regclass,int)
+ * pgstrom.gstore_fdw_replication_base(regclass,int,bigint)
  *
  * Get base backup under ShareRowExclusiveLock; to prevent any writes.
+ * If 'rep_lpos' of the leader session is given, it fetches the chunk under
+ * AccessShareLock for parallel backup, on the assumption that the leader
+ * session still holds the ShareRowExclusiveLock.
  */
 Datum
 pgstrom_gstore_fdw_replication_base(PG_FUNCTION_ARGS)
 {
 	Oid			ftable_oid = PG_GETARG_OID(0);
 	int32		index = PG_GETARG_INT32(1);
+	int64		leader_lpos = PG_GETARG_INT64(2);
+	LOCKMODE	lockmode = (leader_lpos < 0
+							? ShareRowExclusiveLock
+							: AccessShareLock);
 	Relation	frel;
 	GpuStoreDesc *gs_desc;
 	GpuStoreSharedState *gs_sstate;
@@ -6047,7 +9161,7 @@ pgstrom_gstore_fdw_replication_base(PG_FUNCTION_ARGS)
 					   OBJECT_FOREIGN_TABLE,
 					   get_rel_name(ftable_oid));
 
-	frel = table_open(ftable_oid, ShareRowExclusiveLock);
+	frel = table_open(ftable_oid, lockmode);
 	if (!RelationIsGstoreFdw(frel))
 		elog(ERROR, "relation '%s' is not a foreign table with gstore_fdw",
 			 RelationGetRelationName(frel));
@@ -6058,6 +9172,9 @@ pgstrom_gstore_fdw_replication_base(PG_FUNCTION_ARGS)
 	SpinLockAcquire(&gs_sstate->redo_pos_lock);
 	rep_lpos = gs_sstate->redo_write_pos;
 	SpinLockRelease(&gs_sstate->redo_pos_lock);
+	if (leader_lpos >= 0 && rep_lpos != leader_lpos)
+		elog(ERROR, "gstore_fdw: '%s' was modified after the base backup started",
+			 RelationGetRelationName(frel));
 
 	/* try to fetch base chunk */
 	kds = &gs_desc->base_mmap->schema;
@@ -6073,9 +9190,10 @@ pgstrom_gstore_fdw_replication_base(PG_FUNCTION_ARGS)
 											data) + chunk_sz);
 		repl = (GpuStoreReplicationChunk *)retval->vl_dat;
 		repl->rep_kind = 'b';
-		repl->rep_dindex = 1234;	/* now multi-device is not supported */
+		repl->rep_dindex = 0;	/* now multi-device is not supported */
 		repl->rep_nitems = -1;
 		repl->rep_lpos = rep_lpos;
+		repl->rep_offset = offset;
 		memcpy(repl->data, (char *)gs_desc->base_mmap + offset, chunk_sz);
 		SET_VARSIZE(retval, VARHDRSZ + offsetof(GpuStoreReplicationChunk,
 												data) + chunk_sz);
@@ -6099,11 +9217,22 @@ pgstrom_gstore_fdw_replication_base(PG_FUNCTION_ARGS)
 			repl->rep_dindex = 0;	/* now multi-device is not supported */
 			repl->rep_nitems = -1;
 			repl->rep_lpos = rep_lpos;
+			repl->rep_offset = ((char *)extra - (char *)gs_desc->base_mmap) + offset;
 			memcpy(repl->data, (char *)extra + offset, chunk_sz);
 			SET_VARSIZE(retval, VARHDRSZ + offsetof(GpuStoreReplicationChunk,
 													data) + chunk_sz);
 		}
 	}
+	/* ensure the leader session still blocks writes during the copy */
+	if (leader_lpos >= 0)
+	{
+		SpinLockAcquire(&gs_sstate->redo_pos_lock);
+		rep_lpos = gs_sstate->redo_write_pos;
+		SpinLockRelease(&gs_sstate->redo_pos_lock);
+		if (rep_lpos != leader_lpos)
+			elog(ERROR, "gstore_fdw: '%s' was modified during the base backup",
+				 RelationGetRelationName(frel));
+	}
 	table_close(frel, NoLock);	/* table lock must be kept */
 	if (!retval)
 		PG_RETURN_NULL();
@@ -6117,9 +9246,9 @@ pgstrom_gstore_fdw_replication_redo(PG_FUNCTION_ARGS)
 {
 	Oid				ftable_oid = PG_GETARG_OID(0);
 	uint64			base_pos = PG_GETARG_INT64(1);
-	float8			duration = PG_GETARG_FLOAT8(2);
-	int64			min_length = PG_GETARG_INT64(3);
-	int64			max_length = PG_GETARG_INT64(4);
+	float8			duration = PG_GETARG_FLOAT8(2) * 1000.0;	/* ms */
+	int64			min_length = PG_GETARG_INT64(3) << 10;		/* kB */
+	int64			max_length = PG_GETARG_INT64(4) << 10;		/* kB */
 	Relation		frel;
 	GpuStoreDesc   *gs_desc;
 	GpuStoreSharedState *gs_sstate;
@@ -6144,8 +9273,8 @@ pgstrom_gstore_fdw_replication_redo(PG_FUNCTION_ARGS)
 
 	/* result buffer */
 	initStringInfo(&buf);
-	enlargeStringInfo(&buf, offsetof(GpuStoreReplicationChunk, data));
-	buf.len = offsetof(GpuStoreReplicationChunk, data);
+	enlargeStringInfo(&buf, VARHDRSZ + offsetof(GpuStoreReplicationChunk, data));
+	buf.len = VARHDRSZ + offsetof(GpuStoreReplicationChunk, data);
 
 	gettimeofday(&tv1, NULL);
 	for (;;)
@@ -6160,6 +9289,13 @@ pgstrom_gstore_fdw_replication_redo(PG_FUNCTION_ARGS)
 			elog(ERROR, "gstore_fdw: REDO log of '%s' at %p is already overwritten",
 				 RelationGetRelationName(frel), (void *)base_pos);
 		}
+		/* logical position is reset on restart; previous backup is stale */
+		if (base_pos > gs_sstate->redo_write_pos)
+		{
+			SpinLockRelease(&gs_sstate->redo_pos_lock);
+			elog(ERROR, "gstore_fdw: REDO log of '%s' at %p is not written yet, server may be restarted",
+				 RelationGetRelationName(frel), (void *)base_pos);
+		}
 		/* wait until any of redo_repl_pos slot become ready */
 		for (slot_index=0; slot_index < 4; slot_index++)
 		{
@@ -6208,29 +9344,71 @@ pgstrom_gstore_fdw_replication_redo(PG_FUNCTION_ARGS)
 			}
 		}
 		/* length exceeds the minimum chunk size */
-		if (buf.len >= min_length)
+		if (nitems > 0 && buf.len >= min_length)
 			break;
 		gettimeofday(&tv2, NULL);
 		/* even though the length is not enough, function call spent too much */
-		if (TV_DIFF(tv2, tv1) >= (double)duration)
+		if (TV_DIFF(tv2, tv1) >= duration)
 			break;
-		/* wait for 50ms, then retry again */
+		/*
+		 * Subscribe the redo log, then sleep until any backend commits
+		 * a new transaction, or the duration is expired. The latch is
+		 * reset prior to the check of redo_write_pos, so we never miss
+		 * the wakeup by concurrent commits.
+		 */
+		ResetLatch(MyLatch);
 		SpinLockAcquire(&gs_sstate->redo_pos_lock);
 		gs_sstate->redo_repl_pos[slot_index] = ULONG_MAX;
-		SpinLockRelease(&gs_sstate->redo_pos_lock);
+		if (base_pos >= gs_sstate->redo_write_pos)
+		{
+			long	timeout = Max((long)(duration - TV_DIFF(tv2, tv1)), 1L);
+			int		i, ev;
 
-		pg_usleep(50000L);
+			for (i=0; i < lengthof(gs_sstate->redo_repl_latch); i++)
+			{
+				if (!gs_sstate->redo_repl_latch[i])
+				{
+					gs_sstate->redo_repl_latch[i] = MyLatch;
+					break;
+				}
+			}
+			SpinLockRelease(&gs_sstate->redo_pos_lock);
+			/* fallback to polling, if too many replicas are waiting */
+			if (i >= lengthof(gs_sstate->redo_repl_latch))
+				timeout = Min(timeout, 50L);
+
+			ev = WaitLatch(MyLatch,
+						   WL_LATCH_SET |
+						   WL_TIMEOUT |
+						   WL_POSTMASTER_DEATH,
+						   timeout,
+						   PG_WAIT_EXTENSION);
+			if (i < lengthof(gs_sstate->redo_repl_latch))
+			{
+				SpinLockAcquire(&gs_sstate->redo_pos_lock);
+				gs_sstate->redo_repl_latch[i] = NULL;
+				SpinLockRelease(&gs_sstate->redo_pos_lock);
+			}
+			if (ev & WL_POSTMASTER_DEATH)
+				elog(FATAL, "unexpected postmaster dead");
+			CHECK_FOR_INTERRUPTS();
+		}
+		else
+		{
+			SpinLockRelease(&gs_sstate->redo_pos_lock);
+		}
 	}
-	repl = (GpuStoreReplicationChunk *)buf.data;
+	repl = (GpuStoreReplicationChunk *)(buf.data + VARHDRSZ);
 	repl->rep_kind = 'r';
 	repl->rep_dindex = 0;
 	repl->rep_nitems = nitems;
 	repl->rep_lpos = base_pos;
-	SET_VARSIZE(repl, buf.len);
+	repl->rep_offset = 0;
+	SET_VARSIZE(buf.data, buf.len);
 
 	table_close(frel, AccessShareLock);
 
-	PG_RETURN_BYTEA_P(repl);
+	PG_RETURN_BYTEA_P((bytea *)buf.data);
 }
 PG_FUNCTION_INFO_V1(pgstrom_gstore_fdw_replication_redo);
 
@@ -57,8 +57,8 @@
  * The 4th section (extra buffer) is used to store the variable length
  * values, and can be expanded on the demand.
  */
-#define GPUSTORE_BASEFILE_SIGNATURE		"@BASE-1@"
-#define GPUSTORE_BASEFILE_MAPPED_SIGNATURE "%Base-1%"
+#define GPUSTORE_BASEFILE_SIGNATURE		"@BASE-2@"
+#define GPUSTORE_BASEFILE_MAPPED_SIGNATURE "%Base-2%"
 #define GPUSTORE_ROWIDMAP_SIGNATURE		"@ROW-ID@"
 #define GPUSTORE_HASHINDEX_SIGNATURE	"@HINDEX@"
 #define GPUSTORE_EXTRABUF_SIGNATURE		"@EXTRA1@"
@@ -69,6 +69,8 @@ typedef struct
 	uint64		rowid_map_offset;
 	uint64		hash_index_offset;	/* optional (if primary key exist)  */
 	char		ftable_name[NAMEDATALEN];
+	uint64		checkpoint_offset;	/* offset of the redo log file to start
+									 * replay on recovery */
 	kern_data_store schema;
 } GpuStoreBaseFileHead;
 
@@ -105,6 +107,7 @@ typedef struct
 	uint16			rep_dindex;
 	uint32			rep_nitems;		/* valid only if rep_kind == 'r' */
 	uint64			rep_lpos;
+	uint64			rep_offset;		/* offset in the base file, if 'b' or 'e' */
 	char			data[FLEXIBLE_ARRAY_MEMBER];
 } GpuStoreReplicationChunk;
 
@@ -24,6 +24,7 @@ PG_MODULE_MAGIC;
  */
 bool		pgstrom_enabled;
 bool		pgstrom_cpu_fallback_enabled;
+bool		pgstrom_cpu_fallback_on_jit;
 bool		pgstrom_regression_test_mode;
 static int	pgstrom_chunk_size_kb;
 
@@ -72,6 +73,15 @@ pgstrom_init_common_guc(void)
 							 PGC_USERSET,
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
+	/* turn on/off CPU fallback while GPU program is still being built */
+	DefineCustomBoolVariable("pg_strom.cpu_fallback_on_jit",
+							 "Runs GpuTasks by CPU until GPU program gets built",
+							 NULL,
+							 &pgstrom_cpu_fallback_on_jit,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 	/* default length of pgstrom_data_store */
 	DefineCustomIntVariable("pg_strom.chunk_size",
 							"default size of pgstrom_data_store",
@@ -452,6 +462,44 @@ pgstrom_post_planner_recurse(PlannedStmt *pstmt, Plan **p_plan)
 			}
 			break;
 
+		case T_Limit:
+			if (plan->lefttree && IsA(plan->lefttree, Sort))
+			{
+				Plan   *sort = plan->lefttree;
+
+				/* Sort + Limit may be replaced by bounded GpuSort */
+				if (sort->lefttree)
+					pgstrom_post_planner_recurse(pstmt, &sort->lefttree);
+				pgstrom_try_insert_gpusort(pstmt, &plan->lefttree,
+										   (Limit *) plan);
+				return;
+			}
+			break;
+
+		case T_WindowAgg:
+			if (plan->lefttree && IsA(plan->lefttree, Sort))
+			{
+				Plan   *sort = plan->lefttree;
+
+				/* WindowAgg + Sort may be replaced by GpuWindowAgg */
+				if (sort->lefttree)
+					pgstrom_post_planner_recurse(pstmt, &sort->lefttree);
+				pgstrom_try_insert_gpuwinagg(pstmt, p_plan);
+				if (*p_plan == plan)
+					pgstrom_try_insert_gpusort(pstmt, &plan->lefttree, NULL);
+				return;
+			}
+			break;
+
+		case T_Sort:
+			{
+				/* GpuSort shall be built on the outer plan already fixed */
+				if (plan->lefttree)
+					pgstrom_post_planner_recurse(pstmt, &plan->lefttree);
+				pgstrom_try_insert_gpusort(pstmt, p_plan, NULL);
+			}
+			return;
+
 		default:
 			break;
 	}
@@ -564,8 +612,14 @@ _PG_init(void)
 	pgstrom_init_gpuscan();
 	pgstrom_init_gpujoin();
 	pgstrom_init_gpupreagg();
+	pgstrom_init_gpusort();
+	pgstrom_init_gpuwinagg();
 	pgstrom_init_relscan();
+	pgstrom_init_ccache();
+	pgstrom_init_result_cache();
+	pgstrom_init_gpu_analyze();
 	pgstrom_init_arrow_fdw();
+	pgstrom_init_arrow_s3();
 	pgstrom_init_gstore_fdw();
 
 	/* dummy custom-scan node */
@@ -816,6 +816,8 @@ Datum pgstrom_random_tsrange(PG_FUNCTION_ARGS);
 Datum pgstrom_random_tstzrange(PG_FUNCTION_ARGS);
 Datum pgstrom_random_daterange(PG_FUNCTION_ARGS);
 Datum pgstrom_abort_if(PG_FUNCTION_ARGS);
+Datum pgstrom_time_bucket_timestamp(PG_FUNCTION_ARGS);
+Datum pgstrom_time_bucket_timestamptz(PG_FUNCTION_ARGS);
 
 static unsigned int		pgstrom_random_seed = 0;
 static bool				pgstrom_random_seed_set = false;
@@ -1411,6 +1413,54 @@ pgstrom_abort_if(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_abort_if);
 
+/*
+ * pgstrom.time_bucket(interval,timestamp[tz])
+ *
+ * It truncates the timestamp by fixed-width buckets that begin at
+ * 2000-01-03 (Monday) 00:00:00; so weekly buckets start on Monday, like
+ * date_trunc('week'). Buckets of timestamptz are aligned to UTC.
+ * Also see pgfn_time_bucket_timestamp[tz] in cuda_timelib.cu.
+ */
+static Timestamp
+__time_bucket_common(Interval *span, Timestamp ts)
+{
+	int64		origin = 2 * USECS_PER_DAY;
+	int64		width;
+	int64		rem;
+
+	if (TIMESTAMP_NOT_FINITE(ts))
+		return ts;
+	if (span->month != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("time bucket by months is not supported")));
+	width = span->time + span->day * USECS_PER_DAY;
+	if (width <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("bucket width must be greater than zero")));
+	rem = (ts - origin) % width;
+	if (rem < 0)
+		rem += width;
+	return ts - rem;
+}
+
+Datum
+pgstrom_time_bucket_timestamp(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_TIMESTAMP(__time_bucket_common(PG_GETARG_INTERVAL_P(0),
+											 PG_GETARG_TIMESTAMP(1)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_time_bucket_timestamp);
+
+Datum
+pgstrom_time_bucket_timestamptz(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_TIMESTAMPTZ(__time_bucket_common(PG_GETARG_INTERVAL_P(0),
+											   PG_GETARG_TIMESTAMPTZ(1)));
+}
+PG_FUNCTION_INFO_V1(pgstrom_time_bucket_timestamptz);
+
 /*
  * Simple wrapper for read(2) and write(2) to ensure full-buffer read and
  * write, regardless of i/o-size and signal interrupts.
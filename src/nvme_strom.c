@@ -16,6 +16,9 @@
  * GNU General Public License for more details.
  */
 #include "pg_strom.h"
+#ifdef WITH_LIBURING
+#include <liburing.h>
+#endif
 
 /*
  * NvmeAttributes - properties of NVMe disks
@@ -33,6 +36,8 @@ typedef struct NvmeAttributes
 	cl_int		nvme_pcie_func_id;	/* f of DDDD:bb:dd.f */
 	cl_int		numa_node_id;		/* numa node id */
 	cl_int		nvme_optimal_gpu;	/* optimal GPU index */
+	cl_ulong	nvme_optimal_gpus;	/* bitmap of the GPUs equally close to
+									 * the nvme_optimal_gpu */
 	cl_int		nvme_distances[FLEXIBLE_ARRAY_MEMBER];	/* distance map */
 } NvmeAttributes;
 
@@ -58,8 +63,11 @@ static HTAB	   *nvmeHash = NULL;
 static char	   *pgstrom_gpudirect_driver;	/* GUC */
 static bool		pgstrom_gpudirect_enabled;	/* GUC */
 static int		pgstrom_gpudirect_threshold_kb;	/* GUC */
+static bool		pgstrom_gpudirect_md_striping;	/* GUC */
 
 static char	   *nvme_manual_distance_map;	/* GUC */
+static char	   *nvme_calibration_files;		/* GUC */
+static void		apply_nvme_calibrated_distance_map(void);
 static void		apply_nvme_manual_distance_map(void);
 static bool		sysfs_read_pcie_root_complex(const char *dirname,
 											 const char *my_name,
@@ -428,6 +436,7 @@ sysfs_read_block_attrs(void)
 		memcpy(nvme, &temp, offsetof(NvmeAttributes,
 									 nvme_distances));
 		nvme->nvme_optimal_gpu = -1;
+		nvme->nvme_optimal_gpus = 0UL;
 		for (i=0; i < numDevAttrs; i++)
 			nvme->nvme_distances[i] = -1;
 	}
@@ -778,11 +787,21 @@ setup_nvme_distance_map(void)
 				nvme->nvme_distances[i] = -1;
 		}
 		nvme->nvme_optimal_gpu = optimal_gpu;
+		/* GPUs in the same distance can be chosen at run-time */
+		nvme->nvme_optimal_gpus = 0UL;
+		for (i=0; i < numDevAttrs && i < GPU_DEVICE_MASK_BITS; i++)
+		{
+			if (optimal_gpu >= 0 && nvme->nvme_distances[i] == optimal_dist)
+				nvme->nvme_optimal_gpus |= (1UL << i);
+		}
 	}
 	/* Print PCIe tree */
 	foreach (lc, pcie_root)
 		print_pcie_device_tree(lfirst(lc), 2);
 
+	/* Overwrite the distance map by the measured bandwidth */
+	if (nvme_calibration_files)
+		apply_nvme_calibrated_distance_map();
 	/* Overwrite the distance map by manual configuration */
 	if (nvme_manual_distance_map)
 		apply_nvme_manual_distance_map();
@@ -835,6 +854,268 @@ setup_nvme_distance_map(void)
 	}
 }
 
+/*
+ * apply_nvme_calibrated_distance_map
+ *
+ * It runs 'gpubench -T' on the files listed in pg_strom.nvme_calibration_files
+ * (one file per NVME volume), then replaces the hop-count based distance of
+ * the NVME devices under the volumes by the measured GPUDirect bandwidth.
+ * The distance is the inverse of the bandwidth, so the sum of distances on
+ * striped volumes is still meaningful. The gpubench output is cached in
+ * the data directory, and reused unless the file list or GPUs are changed.
+ */
+#define NVME_CALIBRATION_CACHE		"pg_strom_nvme_calibration.cache"
+#define NVME_CALIBRATION_READSZ		256		/* MB to be read per GPU */
+
+typedef struct
+{
+	char	   *filename;
+	char	   *nvme_devices;	/* comma separated, like "nvme0,nvme1" */
+	double	   *bandwidth;		/* MB/s per GPU; <0 if not measured */
+} nvme_calibration_entry;
+
+static nvme_calibration_entry *
+__lookup_nvme_calibration_entry(List **p_entries, const char *filename)
+{
+	nvme_calibration_entry *entry;
+	ListCell   *lc;
+	int			i;
+
+	foreach (lc, *p_entries)
+	{
+		entry = lfirst(lc);
+		if (strcmp(entry->filename, filename) == 0)
+			return entry;
+	}
+	entry = palloc0(sizeof(nvme_calibration_entry));
+	entry->filename = pstrdup(filename);
+	entry->bandwidth = palloc(sizeof(double) * numDevAttrs);
+	for (i=0; i < numDevAttrs; i++)
+		entry->bandwidth[i] = -1.0;
+	*p_entries = lappend(*p_entries, entry);
+
+	return entry;
+}
+
+/*
+ * __parse_nvme_calibration_line
+ *
+ * GPUDIRECT:<filename>:DEVICE<N>:BANDWIDTH=<MB/s>
+ * GPUDIRECT:<filename>:NVME_DEVICES=<nvmeX>[,<nvmeY>...]
+ *
+ * Other lines of 'gpubench -T -m' are not interested.
+ */
+static void
+__parse_nvme_calibration_line(List **p_entries, char *linebuf)
+{
+	nvme_calibration_entry *entry;
+	char	   *tok_attr;
+	char	   *tok_val;
+	char	   *pos;
+
+	if (strncmp(linebuf, "GPUDIRECT:", 10) != 0)
+		return;
+	tok_val = strrchr(linebuf, '=');
+	if (!tok_val)
+		return;
+	*tok_val++ = '\0';
+	/* filename may contain ':', so tokens are picked up from the tail */
+	tok_attr = strrchr(linebuf, ':');
+	if (tok_attr == linebuf + 9)
+		return;
+	*tok_attr++ = '\0';
+
+	if (strcmp(tok_attr, "NVME_DEVICES") == 0)
+	{
+		entry = __lookup_nvme_calibration_entry(p_entries, linebuf + 10);
+		entry->nvme_devices = pstrdup(tok_val);
+	}
+	else if (strcmp(tok_attr, "BANDWIDTH") == 0)
+	{
+		int		cuda_dindex;
+
+		pos = strrchr(linebuf, ':');
+		if (pos == linebuf + 9 || strncmp(pos, ":DEVICE", 7) != 0)
+			return;
+		*pos = '\0';
+		cuda_dindex = atoi(pos + 7);
+		if (cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+			return;
+		entry = __lookup_nvme_calibration_entry(p_entries, linebuf + 10);
+		entry->bandwidth[cuda_dindex] = strtod(tok_val, NULL);
+	}
+}
+
+static void
+__trim_tail_newline(char *linebuf)
+{
+	char   *pos = linebuf + strlen(linebuf);
+
+	while (pos > linebuf && isspace(pos[-1]))
+		*--pos = '\0';
+}
+
+static void
+apply_nvme_calibrated_distance_map(void)
+{
+	StringInfoData signature;
+	StringInfoData output;
+	StringInfoData cmdline;
+	List	   *entries = NIL;
+	ListCell   *lc;
+	char		linebuf[MAXPGPATH + 200];
+	char	   *config;
+	char	   *tok, *pos;
+	FILE	   *filp;
+	bool		cached = false;
+	int			i;
+
+	if (numDevAttrs == 0)
+		return;
+	/*
+	 * Signature of the calibration; file list and GPUs installed
+	 */
+	initStringInfo(&signature);
+	appendStringInfo(&signature, "SIGNATURE:%s", nvme_calibration_files);
+	for (i=0; i < numDevAttrs; i++)
+		appendStringInfo(&signature, ":%s", devAttrs[i].DEV_UUID);
+
+	/*
+	 * Try to load the cache of the former calibration
+	 */
+	initStringInfo(&output);
+	filp = AllocateFile(NVME_CALIBRATION_CACHE, PG_BINARY_R);
+	if (filp)
+	{
+		if (fgets(linebuf, sizeof(linebuf), filp) != NULL)
+		{
+			__trim_tail_newline(linebuf);
+			if (strcmp(linebuf, signature.data) == 0)
+			{
+				while (fgets(linebuf, sizeof(linebuf), filp) != NULL)
+				{
+					__trim_tail_newline(linebuf);
+					__parse_nvme_calibration_line(&entries, linebuf);
+				}
+				cached = true;
+			}
+		}
+		FreeFile(filp);
+	}
+
+	/*
+	 * Elsewhere, run gpubench to measure the GPUDirect bandwidth
+	 */
+	if (!cached)
+	{
+		initStringInfo(&cmdline);
+		appendStringInfo(&cmdline, "%s -T -m -S %d",
+						 CMD_GPUBENCH_PATH, NVME_CALIBRATION_READSZ);
+		config = pstrdup(nvme_calibration_files);
+		for (tok = strtok_r(config, ",", &pos);
+			 tok != NULL;
+			 tok = strtok_r(NULL, ",", &pos))
+		{
+			appendStringInfo(&cmdline, " '%s'", __trim(tok));
+		}
+		elog(LOG, "NVME calibration: %s", cmdline.data);
+
+		filp = OpenPipeStream(cmdline.data, PG_BINARY_R);
+		if (!filp)
+			elog(ERROR, "failed on OpenPipeStream('%s'): %m", cmdline.data);
+		while (fgets(linebuf, sizeof(linebuf), filp) != NULL)
+		{
+			__trim_tail_newline(linebuf);
+			appendStringInfo(&output, "%s\n", linebuf);
+			__parse_nvme_calibration_line(&entries, linebuf);
+		}
+		if (ClosePipeStream(filp) != 0)
+		{
+			elog(LOG, "NVME calibration failed, so hop-count based distance map is used instead");
+			return;
+		}
+	}
+
+	/*
+	 * Update the distance map of NVME devices under the volumes
+	 */
+	foreach (lc, entries)
+	{
+		nvme_calibration_entry *entry = lfirst(lc);
+		int			optimal_gpu = -1;
+		double		optimal_bw = 0.0;
+
+		for (i=0; i < numDevAttrs; i++)
+		{
+			if (entry->bandwidth[i] > optimal_bw)
+			{
+				optimal_gpu = i;
+				optimal_bw = entry->bandwidth[i];
+			}
+		}
+		if (!entry->nvme_devices || optimal_gpu < 0)
+		{
+			elog(LOG, "NVME calibration: no GPUDirect bandwidth on '%s'",
+				 entry->filename);
+			continue;
+		}
+
+		config = pstrdup(entry->nvme_devices);
+		for (tok = strtok_r(config, ",", &pos);
+			 tok != NULL;
+			 tok = strtok_r(NULL, ",", &pos))
+		{
+			NvmeAttributes *nvme;
+			HASH_SEQ_STATUS	hseq;
+			char		temp[128];
+			size_t		sz;
+
+			sz = snprintf(temp, sizeof(temp), "%sn", tok);
+			hash_seq_init(&hseq, nvmeHash);
+			while ((nvme = hash_seq_search(&hseq)) != NULL)
+			{
+				if (strncmp(temp, nvme->nvme_name, sz) != 0)
+					continue;
+
+				nvme->nvme_optimal_gpu = optimal_gpu;
+				nvme->nvme_optimal_gpus = 0UL;
+				for (i=0; i < numDevAttrs; i++)
+				{
+					double	bw = entry->bandwidth[i];
+
+					/* 1000 means 1GB/s; smaller is closer */
+					nvme->nvme_distances[i] = (bw > 0.0
+											   ? Max((int)(1.0e6 / bw), 1)
+											   : -1);
+					/* GPUs within 5% of the best are equally close */
+					if (i < GPU_DEVICE_MASK_BITS && bw >= 0.95 * optimal_bw)
+						nvme->nvme_optimal_gpus |= (1UL << i);
+				}
+			}
+		}
+		pfree(config);
+		elog(LOG, "NVME calibration: '%s' (%s) is closest to GPU%d at %.1fMB/s%s",
+			 entry->filename, entry->nvme_devices,
+			 optimal_gpu, optimal_bw, cached ? " (cached)" : "");
+	}
+
+	/*
+	 * Save the calibration result for the next startup
+	 */
+	if (!cached && entries != NIL)
+	{
+		filp = AllocateFile(NVME_CALIBRATION_CACHE, PG_BINARY_W);
+		if (!filp)
+			elog(LOG, "could not open \"%s\": %m", NVME_CALIBRATION_CACHE);
+		else
+		{
+			fprintf(filp, "%s\n%s", signature.data, output.data);
+			if (FreeFile(filp) != 0)
+				elog(LOG, "could not write \"%s\": %m", NVME_CALIBRATION_CACHE);
+		}
+	}
+}
+
 /*
  * apply_nvme_manual_distance_map
  */
@@ -895,6 +1176,8 @@ apply_nvme_manual_distance_map(void)
 				if (strncasecmp(temp, nvme->nvme_name, sz) == 0)
 				{
 					nvme->nvme_optimal_gpu = cuda_dindex;
+					nvme->nvme_optimal_gpus = (cuda_dindex < GPU_DEVICE_MASK_BITS
+											   ? (1UL << cuda_dindex) : 0UL);
 					found = true;
 				}
 			}
@@ -916,12 +1199,14 @@ typedef struct
 {
 	Oid		tablespace_oid;
 	int		optimal_gpu;
+	cl_ulong optimal_gpus;	/* GPUs equally close to the optimal_gpu */
 } tablespace_optimal_gpu_hentry;
 
 typedef struct
 {
 	dev_t	st_dev;		/* may be a partition device */
 	int		optimal_gpu;
+	cl_ulong optimal_gpus;	/* GPUs equally close to the optimal_gpu */
 } filesystem_optimal_gpu_hentry;
 
 static HTAB	   *tablespace_optimal_gpu_htable = NULL;
@@ -939,23 +1224,33 @@ tablespace_optimal_gpu_cache_callback(Datum arg, int cacheid, uint32 hashvalue)
 }
 
 /*
- * __GetOptimalGpuForBlockDevice
+ * __GetNvmeAttributesForBlockDevice
  */
-static int
-__GetOptimalGpuForBlockDevice(int major, int minor)
+static NvmeAttributes *
+__GetNvmeAttributesForBlockDevice(int major, int minor)
 {
 	NvmeAttributes	key;
-	NvmeAttributes *nvme;
 
 	memset(&key, 0, sizeof(NvmeAttributes));
 	key.nvme_major = major;
 	key.nvme_minor = minor;
 
 	if (!nvmeHash)
-		return -1;
-	nvme = hash_search(nvmeHash, &key, HASH_FIND, NULL);
+		return NULL;
+	return hash_search(nvmeHash, &key, HASH_FIND, NULL);
+}
+
+/*
+ * __GetOptimalGpuForBlockDevice
+ */
+static int
+__GetOptimalGpuForBlockDevice(int major, int minor, cl_ulong *p_optimal_gpus)
+{
+	NvmeAttributes *nvme = __GetNvmeAttributesForBlockDevice(major, minor);
+
 	if (!nvme)
 		return -1;
+	*p_optimal_gpus = nvme->nvme_optimal_gpus;
 	return nvme->nvme_optimal_gpu;
 }
 
@@ -963,11 +1258,15 @@ __GetOptimalGpuForBlockDevice(int major, int minor)
  * __GetOptimalGpuForRaidVolume
  */
 static int
-__GetOptimalGpuForRaidVolume(const char *sysfs_base)
+__GetOptimalGpuForRaidVolume(const char *sysfs_base, cl_ulong *p_optimal_gpus)
 {
 	char		namebuf[MAXPGPATH];
 	const char *value;
 	int			optimal_gpu = -1;
+	cl_ulong	optimal_gpus = ~0UL;
+	bool		optimal_gpu_mismatch = false;
+	int		   *dist_sum;
+	int			i, min_dist;
 	ssize_t		sz;
 	DIR		   *dir;
 	struct dirent *dent;
@@ -985,7 +1284,12 @@ __GetOptimalGpuForRaidVolume(const char *sysfs_base)
 	dir = AllocateDir(sysfs_base);
 	if (!dir)
 		elog(ERROR, "failed on AllocateDir('%s'): %m", sysfs_base);
-	
+
+	/*
+	 * sum of the distances from the members; negative if any of members
+	 * is not reachable, or on the different numa-node (CPU socket)
+	 */
+	dist_sum = palloc0(sizeof(int) * Max(numDevAttrs, 1));
 	while ((dent = ReadDir(dir, sysfs_base)) != NULL)
 	{
 		if (dent->d_name[0] == 'r' &&
@@ -994,7 +1298,7 @@ __GetOptimalGpuForRaidVolume(const char *sysfs_base)
 		{
 			int		__major;
 			int		__minor;
-			int		__dindex;
+			NvmeAttributes *nvme;
 
 			snprintf(namebuf, sizeof(namebuf),
 					 "%s/%s/block/dev",
@@ -1019,31 +1323,65 @@ __GetOptimalGpuForRaidVolume(const char *sysfs_base)
 					elog(ERROR, "failed on parse '%s' [%s]",
 						 namebuf, value);
 			}
-			__dindex = __GetOptimalGpuForBlockDevice(__major, __minor);
-			if (__dindex < 0)
+			nvme = __GetNvmeAttributesForBlockDevice(__major, __minor);
+			if (!nvme || nvme->nvme_optimal_gpu < 0)
 			{
 				optimal_gpu = -1;
+				optimal_gpu_mismatch = false;
 				break;		/* no optimal GPU */
 			}
-			else if (optimal_gpu < 0)
-				optimal_gpu = __dindex;
-			else if (optimal_gpu != __dindex)
+			optimal_gpus &= nvme->nvme_optimal_gpus;
+			if (optimal_gpu < 0 && !optimal_gpu_mismatch)
+				optimal_gpu = nvme->nvme_optimal_gpu;
+			else if (optimal_gpu != nvme->nvme_optimal_gpu)
 			{
 				optimal_gpu = -1;
-				break;		/* no optimal GPU */
+				optimal_gpu_mismatch = true;
+			}
+			for (i=0; i < numDevAttrs; i++)
+			{
+				if (nvme->nvme_distances[i] < 0)
+					dist_sum[i] = -1;
+				else if (dist_sum[i] >= 0)
+					dist_sum[i] += nvme->nvme_distances[i];
 			}
 		}
 	}
 	FreeDir(dir);
 
+	/*
+	 * If the members have different optimal GPUs, pick up the nearest GPU
+	 * reachable from all the members on the same CPU socket.
+	 */
+	if (optimal_gpu_mismatch)
+	{
+		min_dist = INT_MAX;
+		for (i=0; i < numDevAttrs; i++)
+		{
+			if (dist_sum[i] >= 0 && dist_sum[i] < min_dist)
+			{
+				optimal_gpu = i;
+				min_dist = dist_sum[i];
+			}
+		}
+		optimal_gpus = 0UL;
+		for (i=0; i < numDevAttrs && i < GPU_DEVICE_MASK_BITS; i++)
+		{
+			if (optimal_gpu >= 0 && dist_sum[i] == min_dist)
+				optimal_gpus |= (1UL << i);
+		}
+	}
+	pfree(dist_sum);
+
+	*p_optimal_gpus = (optimal_gpu >= 0 ? optimal_gpus : 0UL);
 	return optimal_gpu;
 }
 
 /*
  * GetOptimalGpuForFile
  */
-int
-GetOptimalGpuForFile(File fdesc)
+static int
+__GetOptimalGpuForFile(File fdesc, cl_ulong *p_optimal_gpus)
 {
 	filesystem_optimal_gpu_hentry *hentry;
 	struct stat	stat_buf;
@@ -1069,6 +1407,7 @@ GetOptimalGpuForFile(File fdesc)
 	if (!found)
 	{
 		int		optimal_gpu = -1;
+		cl_ulong optimal_gpus = 0UL;
 		int		major = major(stat_buf.st_dev);
 		int		minor = minor(stat_buf.st_dev);
 		char	namebuf[MAXPGPATH];
@@ -1099,18 +1438,21 @@ GetOptimalGpuForFile(File fdesc)
 			{
 				if ((stat_buf.st_mode & S_IFMT) != S_IFDIR)
 					elog(ERROR, "sysfs entry '%s' is not a directory", namebuf);
-				optimal_gpu = __GetOptimalGpuForRaidVolume(namebuf);
+				optimal_gpu = __GetOptimalGpuForRaidVolume(namebuf,
+														   &optimal_gpus);
 			}
 			else if (errno == ENOENT)
 			{
 				/* not a md-RAID device */
-				optimal_gpu = __GetOptimalGpuForBlockDevice(major, minor);
+				optimal_gpu = __GetOptimalGpuForBlockDevice(major, minor,
+															&optimal_gpus);
 			}
 			else
 			{
 				elog(ERROR, "failed on stat('%s'): %m", namebuf);
 			}
 			hentry->optimal_gpu = optimal_gpu;
+			hentry->optimal_gpus = optimal_gpus;
 		}
 		PG_CATCH();
 		{
@@ -1122,17 +1464,48 @@ GetOptimalGpuForFile(File fdesc)
 		}
 		PG_END_TRY();
 	}
+	*p_optimal_gpus = hentry->optimal_gpus;
 	return hentry->optimal_gpu;
 }
 
+int
+GetOptimalGpuForFile(File fdesc)
+{
+	cl_ulong	optimal_gpus;
+
+	return __GetOptimalGpuForFile(fdesc, &optimal_gpus);
+}
+
+/*
+ * GetOptimalGpuForFilePath - optimal GPU for the file, or -1 if GPUDirect
+ * SQL is disabled or not available for the file.
+ */
+int
+GetOptimalGpuForFilePath(const char *pathname)
+{
+	File	fdesc;
+	int		optimal_gpu;
+
+	if (!pgstrom_gpudirect_enabled)
+		return -1;
+	fdesc = PathNameOpenFile(pathname, O_RDONLY | PG_BINARY);
+	if (fdesc < 0)
+		return -1;
+	optimal_gpu = GetOptimalGpuForFile(fdesc);
+	FileClose(fdesc);
+
+	return optimal_gpu;
+}
+
 static cl_int
-GetOptimalGpuForTablespace(Oid tablespace_oid)
+GetOptimalGpuForTablespace(Oid tablespace_oid, cl_ulong *p_optimal_gpus)
 {
 	tablespace_optimal_gpu_hentry *hentry;
 	char   *pathname;
 	File	fdesc;
 	bool	found;
 
+	*p_optimal_gpus = 0UL;
 	if (!pgstrom_gpudirect_enabled)
 		return -1;
 
@@ -1164,6 +1537,7 @@ GetOptimalGpuForTablespace(Oid tablespace_oid)
 		{
 			Assert(hentry->tablespace_oid == tablespace_oid);
 			hentry->optimal_gpu = -1;
+			hentry->optimal_gpus = 0UL;
 
 			pathname = GetDatabasePath(MyDatabaseId, tablespace_oid);
 			fdesc = PathNameOpenFile(pathname, O_RDONLY | O_DIRECTORY);
@@ -1174,7 +1548,8 @@ GetOptimalGpuForTablespace(Oid tablespace_oid)
 			}
 			else
 			{
-				hentry->optimal_gpu = GetOptimalGpuForFile(fdesc);
+				hentry->optimal_gpu = __GetOptimalGpuForFile(fdesc,
+															 &hentry->optimal_gpus);
 				FileClose(fdesc);
 			}
 		}
@@ -1188,6 +1563,7 @@ GetOptimalGpuForTablespace(Oid tablespace_oid)
 		}
 		PG_END_TRY();
 	}
+	*p_optimal_gpus = hentry->optimal_gpus;
 	return hentry->optimal_gpu;
 }
 
@@ -1198,11 +1574,13 @@ GetOptimalGpuForRelation(PlannerInfo *root, RelOptInfo *rel)
 	HeapTuple	tup;
 	char		relpersistence;
 	cl_int		cuda_dindex;
+	cl_ulong	optimal_gpus;
 
 	if (baseRelIsArrowFdw(rel))
 		return GetOptimalGpuForArrowFdw(root, rel);
 
-	cuda_dindex = GetOptimalGpuForTablespace(rel->reltablespace);
+	cuda_dindex = GetOptimalGpuForTablespace(rel->reltablespace,
+											 &optimal_gpus);
 	if (cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
 		return -1;
 
@@ -1226,14 +1604,50 @@ RelationCanUseNvmeStrom(Relation relation)
 {
 	Oid		tablespace_oid = RelationGetForm(relation)->reltablespace;
 	cl_int	cuda_dindex;
+	cl_ulong optimal_gpus;
 	/* SSD2GPU on temp relation is not supported */
 	if (RelationUsesLocalBuffers(relation))
 		return false;
-	cuda_dindex = GetOptimalGpuForTablespace(tablespace_oid);
+	cuda_dindex = GetOptimalGpuForTablespace(tablespace_oid, &optimal_gpus);
 	return (cuda_dindex >= 0 &&
 			cuda_dindex <  numDevAttrs);
 }
 
+/*
+ * RelationChooseOptimalGpu
+ *
+ * The planner picks up one GPU for the storage of the relation, however,
+ * multiple GPUs are often equally close to the storage (e.g, md-raid0 volume
+ * or GPUs under the same PCIe switch). It chooses the least loaded one
+ * among them at the executor startup, to distribute the scan over all the
+ * GPUs close to the storage by the concurrent sessions or parallel workers.
+ */
+cl_int
+RelationChooseOptimalGpu(Relation relation, cl_int optimal_gpu)
+{
+	Oid		tablespace_oid;
+	cl_ulong optimal_gpus;
+	char	relkind;
+
+	if (!relation || optimal_gpu < 0 ||
+		optimal_gpu >= GPU_DEVICE_MASK_BITS ||
+		RelationUsesLocalBuffers(relation))
+		return optimal_gpu;
+	relkind = RelationGetForm(relation)->relkind;
+	if (relkind != RELKIND_RELATION &&
+		relkind != RELKIND_MATVIEW)
+		return optimal_gpu;
+
+	tablespace_oid = RelationGetForm(relation)->reltablespace;
+	if (GetOptimalGpuForTablespace(tablespace_oid,
+								   &optimal_gpus) != optimal_gpu ||
+		(optimal_gpus & (1UL << optimal_gpu)) == 0 ||
+		(optimal_gpus & (optimal_gpus - 1)) == 0)
+		return optimal_gpu;		/* no other candidates */
+
+	return gpuDeviceLeastLoadedAmong(optimal_gpus);
+}
+
 /*
  * ScanPathWillUseNvmeStrom - Optimizer Hint
  */
@@ -1304,6 +1718,7 @@ ScanPathWillUseNvmeStrom(PlannerInfo *root, RelOptInfo *baserel)
 
 #ifdef WITH_CUFILE
 static int		pgstrom_cufile_io_unitsz;	/* GUC */
+static int		pgstrom_cufile_io_depth;	/* GUC */
 
 /* GUC checker */
 static bool
@@ -1317,6 +1732,68 @@ cufile_io_unitsz_checker(int *p_newval, void **extra, GucSource source)
 }
 #endif
 
+/*
+ * gpuDirectFileDescSetupStripe
+ *
+ * It checks whether the file is on md-raid0 volume, and saves its geometry
+ * if pg_strom.gpudirect_md_striping is enabled; gpuDirectFileReadIOV()
+ * decomposes the i/o vector into per-member stripes then.
+ */
+static void
+gpuDirectFileDescSetupStripe(GPUDirectFileDesc *gds_fdesc)
+{
+	struct stat	stat_buf;
+	char		namebuf[MAXPGPATH];
+	const char *value;
+	int			major, minor;
+	long		chunk_sz;
+	int			raid_disks;
+
+	gds_fdesc->stripe_sz = 0;
+	gds_fdesc->stripe_width = 0;
+	if (!pgstrom_gpudirect_md_striping)
+		return;
+	if (fstat(gds_fdesc->rawfd, &stat_buf) != 0)
+		elog(ERROR, "failed on fstat(2): %m");
+	major = major(stat_buf.st_dev);
+	minor = minor(stat_buf.st_dev);
+
+	/* lookup the mother block device, if partition volume */
+	snprintf(namebuf, sizeof(namebuf),
+			 "/sys/dev/block/%d:%d/partition", major, minor);
+	value = sysfs_read_line(namebuf, false);
+	if (value && atoi(value) != 0)
+	{
+		snprintf(namebuf, sizeof(namebuf),
+				 "/sys/dev/block/%d:%d/../dev", major, minor);
+		value = sysfs_read_line(namebuf, false);
+		if (!value || sscanf(value, "%d:%d", &major, &minor) != 2)
+			return;
+	}
+	snprintf(namebuf, sizeof(namebuf),
+			 "/sys/dev/block/%d:%d/md/level", major, minor);
+	value = sysfs_read_line(namebuf, false);
+	if (!value || strcmp(value, "raid0") != 0)
+		return;		/* not a md-raid0 volume */
+
+	snprintf(namebuf, sizeof(namebuf),
+			 "/sys/dev/block/%d:%d/md/chunk_size", major, minor);
+	value = sysfs_read_line(namebuf, false);
+	chunk_sz = (value ? atol(value) : 0);
+	if (chunk_sz < PAGE_SIZE || (chunk_sz & (PAGE_SIZE - 1)) != 0)
+		return;		/* unsupported md-raid chunk-size */
+
+	snprintf(namebuf, sizeof(namebuf),
+			 "/sys/dev/block/%d:%d/md/raid_disks", major, minor);
+	value = sysfs_read_line(namebuf, false);
+	raid_disks = (value ? atoi(value) : 0);
+	if (raid_disks < 2)
+		return;
+
+	gds_fdesc->stripe_sz = chunk_sz;
+	gds_fdesc->stripe_width = raid_disks;
+}
+
 /*
  * gpuDirectFileDescOpen
  */
@@ -1362,6 +1839,7 @@ gpuDirectFileDescOpenByPath(GPUDirectFileDesc *gds_fdesc, const char *pathname)
 		elog(ERROR, "failed on open('%s'): %m", pathname);
 #endif
 	gds_fdesc->rawfd = rawfd;
+	gpuDirectFileDescSetupStripe(gds_fdesc);
 }
 
 /*
@@ -1396,6 +1874,7 @@ gpuDirectFileDescOpen(GPUDirectFileDesc *gds_fdesc, File pg_fdesc)
 			elog(ERROR, "failed on dup(2): %m");
 	}
 	gds_fdesc->rawfd = rawfd;
+	gpuDirectFileDescSetupStripe(gds_fdesc);
 #endif
 }
 
@@ -1463,6 +1942,545 @@ gpuDirectUnmapGpuMemory(CUdeviceptr m_segment,
 #endif
 }
 
+#ifndef WITH_CUFILE
+/*
+ * Asynchronous completion of the nvme_strom DMA tasks
+ *
+ * Once STROM_IOCTL__MEMCPY_SSD2GPU_RAW submitted a DMA task, the worker
+ * thread enqueues a request to the completion queue of the GpuContext,
+ * and cuStreamWaitValue32() on the slot of the pinned host memory that
+ * is mapped to the device. Then, it can go ahead to enqueue the following
+ * RAM-to-GPU DMA and GPU kernels without blocking; they are executed once
+ * the DMA thread of the GpuContext got the completion by the blocking
+ * STROM_IOCTL__MEMCPY_WAIT, and updated the slot.
+ * If the device does not support the stream memory operations, or no free
+ * slots are available, the worker thread waits for completion by itself.
+ */
+#define GPUDIRECT_DMA_NSLOTS		256
+
+struct gpuDirectDmaQueue
+{
+	GpuContext	   *gcontext;
+	pthread_t		thread;
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	bool			terminate;
+	dlist_head		pending_list;	/* list of gpuDirectDmaRequest */
+	dlist_head		free_list;		/* list of gpuDirectDmaRequest */
+	volatile cl_uint *h_slots;		/* pinned host memory */
+	CUdeviceptr		m_slots;		/* device address of the h_slots */
+	struct {
+		dlist_node		chain;
+		cl_uint			slot;
+		cl_uint			generation;
+		unsigned long	dma_task_id;
+	} requests[GPUDIRECT_DMA_NSLOTS];
+};
+typedef struct gpuDirectDmaQueue	gpuDirectDmaQueue;
+#define gpuDirectDmaRequest		\
+	__typeof__(((gpuDirectDmaQueue *)NULL)->requests[0])
+
+/*
+ * __gpuDirectWaitDmaTask - blocking wait for completion of the DMA task
+ */
+static void
+__gpuDirectWaitDmaTask(unsigned long dma_task_id)
+{
+	StromCmd__MemCopyWait cmd;
+
+	memset(&cmd, 0, sizeof(StromCmd__MemCopyWait));
+	cmd.dma_task_id = dma_task_id;
+	while (nvme_strom_ioctl(STROM_IOCTL__MEMCPY_WAIT, &cmd) != 0)
+	{
+		if (errno != EINTR)
+			werror("failed on nvme_strom_ioctl(STROM_IOCTL__MEMCPY_WAIT): %m");
+	}
+	if (cmd.status != 0)
+		werror("SSD-to-GPU DMA task was failed (status=%ld)", cmd.status);
+}
+
+/*
+ * gpuDirectDmaThreadMain - DMA thread to service the completion queue
+ */
+static void *
+gpuDirectDmaThreadMain(void *arg)
+{
+	gpuDirectDmaQueue *dqueue = arg;
+	sigjmp_buf	local_sigjmp_buf;
+
+	/* werror() by this thread is reported to the GpuContext */
+	GpuWorkerCurrentContext = dqueue->gcontext;
+	GpuWorkerExceptionStack = &local_sigjmp_buf;
+
+	pthreadMutexLock(&dqueue->mutex);
+	for (;;)
+	{
+		gpuDirectDmaRequest *dreq;
+		dlist_node *dnode;
+
+		if (dlist_is_empty(&dqueue->pending_list))
+		{
+			if (dqueue->terminate)
+				break;
+			pthreadCondWait(&dqueue->cond, &dqueue->mutex);
+			continue;
+		}
+		dnode = dlist_pop_head_node(&dqueue->pending_list);
+		dreq = dlist_container(gpuDirectDmaRequest, chain, dnode);
+		pthreadMutexUnlock(&dqueue->mutex);
+
+		if (sigsetjmp(local_sigjmp_buf, 0) == 0)
+			__gpuDirectWaitDmaTask(dreq->dma_task_id);
+		/*
+		 * Even if DMA task was failed, the error is already reported to
+		 * the GpuContext, so we release the stream anyway.
+		 */
+		pg_memory_barrier();
+		dqueue->h_slots[dreq->slot] = dreq->generation;
+
+		pthreadMutexLock(&dqueue->mutex);
+		dlist_push_head(&dqueue->free_list, &dreq->chain);
+	}
+	pthreadMutexUnlock(&dqueue->mutex);
+
+	return NULL;
+}
+
+/*
+ * gpuDirectDmaQueueGet - get (or create on demand) the completion queue
+ */
+static gpuDirectDmaQueue *
+gpuDirectDmaQueueGet(GpuContext *gcontext)
+{
+	gpuDirectDmaQueue *dqueue;
+	void	   *h_slots = NULL;
+	int			i, supported = 0;
+	CUresult	rc;
+
+	pthreadMutexLock(&gcontext->worker_mutex);
+	dqueue = gcontext->gpudirect_dma_queue;
+	if (dqueue || gcontext->gpudirect_dma_disabled)
+		goto out;
+	/* disabled, unless the setup below gets successful */
+	gcontext->gpudirect_dma_disabled = true;
+#if CUDA_VERSION < 12000
+	rc = cuDeviceGetAttribute(&supported,
+							  CU_DEVICE_ATTRIBUTE_CAN_USE_STREAM_MEM_OPS,
+							  gcontext->cuda_device);
+	if (rc != CUDA_SUCCESS || !supported)
+		goto out;
+#else
+	/* CUDA 12 always supports the stream memory operations */
+	supported = 1;
+#endif
+	rc = cuMemHostAlloc(&h_slots, sizeof(cl_uint) * GPUDIRECT_DMA_NSLOTS,
+						CU_MEMHOSTALLOC_PORTABLE | CU_MEMHOSTALLOC_DEVICEMAP);
+	if (rc != CUDA_SUCCESS)
+	{
+		wnotice("failed on cuMemHostAlloc: %s", errorText(rc));
+		goto out;
+	}
+	memset(h_slots, 0, sizeof(cl_uint) * GPUDIRECT_DMA_NSLOTS);
+
+	dqueue = calloc(1, sizeof(gpuDirectDmaQueue));
+	if (!dqueue)
+	{
+		cuMemFreeHost(h_slots);
+		goto out;
+	}
+	dqueue->gcontext = gcontext;
+	pthreadMutexInit(&dqueue->mutex, 0);
+	pthreadCondInit(&dqueue->cond, 0);
+	dlist_init(&dqueue->pending_list);
+	dlist_init(&dqueue->free_list);
+	dqueue->h_slots = h_slots;
+	rc = cuMemHostGetDevicePointer(&dqueue->m_slots, h_slots, 0);
+	if (rc != CUDA_SUCCESS)
+	{
+		wnotice("failed on cuMemHostGetDevicePointer: %s", errorText(rc));
+		goto bailout;
+	}
+	for (i=0; i < GPUDIRECT_DMA_NSLOTS; i++)
+	{
+		dqueue->requests[i].slot = i;
+		dlist_push_tail(&dqueue->free_list, &dqueue->requests[i].chain);
+	}
+	if ((errno = pthread_create(&dqueue->thread, NULL,
+								gpuDirectDmaThreadMain, dqueue)) != 0)
+	{
+		wnotice("failed on pthread_create: %m");
+		goto bailout;
+	}
+	gcontext->gpudirect_dma_queue = dqueue;
+	gcontext->gpudirect_dma_disabled = false;
+out:
+	pthreadMutexUnlock(&gcontext->worker_mutex);
+	return dqueue;
+
+bailout:
+	cuMemFreeHost(h_slots);
+	free(dqueue);
+	pthreadMutexUnlock(&gcontext->worker_mutex);
+	return NULL;
+}
+
+/*
+ * gpuDirectDmaQueueEnqueue
+ *
+ * It enqueues the DMA task to the completion queue, then makes the
+ * CU_STREAM_PER_WORKER wait for its completion.
+ * It returns false, if the caller has to wait for the completion by itself.
+ */
+static bool
+gpuDirectDmaQueueEnqueue(unsigned long dma_task_id)
+{
+	GpuContext *gcontext = GpuWorkerCurrentContext;
+	gpuDirectDmaQueue *dqueue;
+	gpuDirectDmaRequest *dreq;
+	CUresult	rc;
+
+	if (!gcontext)
+		return false;
+	dqueue = gpuDirectDmaQueueGet(gcontext);
+	if (!dqueue)
+		return false;
+
+	pthreadMutexLock(&dqueue->mutex);
+	if (dlist_is_empty(&dqueue->free_list))
+	{
+		pthreadMutexUnlock(&dqueue->mutex);
+		return false;
+	}
+	dreq = dlist_container(gpuDirectDmaRequest, chain,
+						   dlist_pop_head_node(&dqueue->free_list));
+	/* the slot value is monotonically increased */
+	dreq->generation++;
+	dreq->dma_task_id = dma_task_id;
+	rc = cuStreamWaitValue32(CU_STREAM_PER_WORKER,
+							 dqueue->m_slots + sizeof(cl_uint) * dreq->slot,
+							 dreq->generation,
+							 CU_STREAM_WAIT_VALUE_GEQ);
+	if (rc != CUDA_SUCCESS)
+	{
+		dreq->generation--;
+		dlist_push_head(&dqueue->free_list, &dreq->chain);
+		pthreadMutexUnlock(&dqueue->mutex);
+		werror("failed on cuStreamWaitValue32: %s", errorText(rc));
+	}
+	dlist_push_tail(&dqueue->pending_list, &dreq->chain);
+	pthreadCondSignal(&dqueue->cond);
+	pthreadMutexUnlock(&dqueue->mutex);
+
+	return true;
+}
+#endif	/* !WITH_CUFILE */
+
+/*
+ * gpuDirectDmaQueueTerminate
+ *
+ * It waits for completion of the pending DMA tasks, then terminates the
+ * DMA thread of the GpuContext. Caller must ensure no worker threads are
+ * running.
+ */
+void
+gpuDirectDmaQueueTerminate(GpuContext *gcontext)
+{
+#ifndef WITH_CUFILE
+	gpuDirectDmaQueue *dqueue = gcontext->gpudirect_dma_queue;
+	CUresult	rc;
+
+	if (dqueue)
+	{
+		pthreadMutexLock(&dqueue->mutex);
+		dqueue->terminate = true;
+		pthreadCondSignal(&dqueue->cond);
+		pthreadMutexUnlock(&dqueue->mutex);
+
+		if ((errno = pthread_join(dqueue->thread, NULL)) != 0)
+			elog(PANIC, "failed on pthread_join: %m");
+		rc = cuCtxPushCurrent(gcontext->cuda_context);
+		if (rc == CUDA_SUCCESS)
+		{
+			rc = cuMemFreeHost((void *)dqueue->h_slots);
+			if (rc != CUDA_SUCCESS)
+				wnotice("failed on cuMemFreeHost: %s", errorText(rc));
+			cuCtxPopCurrent(NULL);
+		}
+		else
+			wnotice("failed on cuCtxPushCurrent: %s", errorText(rc));
+		free(dqueue);
+	}
+#endif
+	gcontext->gpudirect_dma_queue = NULL;
+	gcontext->gpudirect_dma_disabled = false;
+}
+
+#ifdef WITH_CUFILE_BATCH
+/*
+ * Batch handle of cuFile per worker thread; set up on the first use,
+ * and kept during the process lifetime.
+ */
+static __thread CUfileBatchHandle_t cufile_batch_handle;
+static __thread unsigned int cufile_batch_nrooms = 0;
+
+/*
+ * __gpuDirectFileReadIOVBatch
+ *
+ * It kicks the reads of the slices of strom_io_chunks by the batch I/O APIs,
+ * with up to pg_strom.cufile_io_depth outstanding requests; so NVMe devices
+ * (and the members of md-raid0 volume) can process them in parallel.
+ * The next slices are submitted as soon as the previous ones get completed.
+ * If multiple i/o vectors are given (per-member stripes of md-raid0 volume),
+ * the slices are picked up from them in round-robin, to keep all the member
+ * devices busy.
+ */
+static void
+__gpuDirectFileReadIOVBatch(const GPUDirectFileDesc *gds_fdesc,
+							CUdeviceptr m_segment,
+							off_t m_offset,
+							strom_io_vector **iovecs,
+							unsigned int nvecs,
+							size_t unitsz,
+							unsigned int depth)
+{
+	CUfileIOParams_t params[depth];
+	CUfileIOEvents_t events[depth];
+	size_t		slot_size[depth];
+	unsigned int free_slots[depth];
+	unsigned int nfree = depth;
+	unsigned int ninflight = 0;
+	unsigned int i, k, nr;
+	unsigned int curr = 0;
+	int			ioc_index[nvecs];
+	size_t		remained[nvecs];
+	off_t		file_pos[nvecs];
+	off_t		dest_pos[nvecs];
+	CUfileError_t rv;
+	const char *errmsg = NULL;
+	long		errcode = 0;
+
+	if (cufile_batch_nrooms < depth)
+	{
+		if (cufile_batch_nrooms > 0)
+			cuFileBatchIODestroy(cufile_batch_handle);
+		cufile_batch_nrooms = 0;
+		rv = cuFileBatchIOSetUp(&cufile_batch_handle, depth);
+		if (rv.cu_err != CUDA_SUCCESS || rv.err != CU_FILE_SUCCESS)
+			werror("failed on cuFileBatchIOSetUp: %s",
+				   errorText(rv.cu_err != CUDA_SUCCESS ? rv.cu_err : rv.err));
+		cufile_batch_nrooms = depth;
+	}
+	for (i=0; i < depth; i++)
+		free_slots[i] = i;
+	memset(ioc_index, 0, sizeof(int) * nvecs);
+	memset(remained, 0, sizeof(size_t) * nvecs);
+
+	for (;;)
+	{
+		/* fill up the free slots by the next slices */
+		for (nr=0; nfree > 0; nr++)
+		{
+			unsigned int	slot;
+			size_t			sz;
+
+			for (k=0; k < nvecs; k++, curr = (curr + 1) % nvecs)
+			{
+				strom_io_vector *iovec = iovecs[curr];
+
+				while (remained[curr] == 0 &&
+					   ioc_index[curr] < iovec->nr_chunks)
+				{
+					strom_io_chunk *ioc = &iovec->ioc[ioc_index[curr]++];
+
+					remained[curr] = ioc->nr_pages * PAGE_SIZE;
+					file_pos[curr] = ioc->fchunk_id * PAGE_SIZE;
+					dest_pos[curr] = m_offset + ioc->m_offset;
+				}
+				if (remained[curr] > 0)
+					break;
+			}
+			if (k == nvecs)
+				break;
+			sz = Min(remained[curr], unitsz);
+			slot = free_slots[--nfree];
+			slot_size[slot] = sz;
+
+			memset(&params[nr], 0, sizeof(CUfileIOParams_t));
+			params[nr].mode = CUFILE_BATCH;
+			params[nr].u.batch.devPtr_base = (void *)m_segment;
+			params[nr].u.batch.file_offset = file_pos[curr];
+			params[nr].u.batch.devPtr_offset = dest_pos[curr];
+			params[nr].u.batch.size = sz;
+			params[nr].fh = gds_fdesc->fhandle;
+			params[nr].opcode = CUFILE_READ;
+			params[nr].cookie = (void *)((uintptr_t)slot);
+
+			file_pos[curr] += sz;
+			dest_pos[curr] += sz;
+			remained[curr] -= sz;
+			/* next slice shall be picked up from the next member */
+			curr = (curr + 1) % nvecs;
+		}
+		if (nr > 0)
+		{
+			rv = cuFileBatchIOSubmit(cufile_batch_handle, nr, params, 0);
+			if (rv.cu_err != CUDA_SUCCESS || rv.err != CU_FILE_SUCCESS)
+			{
+				errmsg = "failed on cuFileBatchIOSubmit";
+				errcode = (rv.cu_err != CUDA_SUCCESS ? rv.cu_err : rv.err);
+				break;
+			}
+			ninflight += nr;
+		}
+		if (ninflight == 0)
+			break;
+
+		/* wait for completion of one or more requests */
+		nr = ninflight;
+		rv = cuFileBatchIOGetStatus(cufile_batch_handle, 1, &nr, events, NULL);
+		if (rv.cu_err != CUDA_SUCCESS || rv.err != CU_FILE_SUCCESS)
+		{
+			errmsg = "failed on cuFileBatchIOGetStatus";
+			errcode = (rv.cu_err != CUDA_SUCCESS ? rv.cu_err : rv.err);
+			break;
+		}
+		for (i=0; i < nr; i++)
+		{
+			unsigned int	slot = (uintptr_t)events[i].cookie;
+
+			if (events[i].status != CUFILE_COMPLETE)
+			{
+				errmsg = "cuFile batch i/o failed";
+				errcode = events[i].status;
+			}
+			else if (events[i].ret != slot_size[slot])
+			{
+				errmsg = "cuFile batch i/o read shorter than the required";
+				errcode = events[i].ret;
+			}
+			free_slots[nfree++] = slot;
+			ninflight--;
+		}
+		if (errmsg)
+			break;
+	}
+
+	if (errmsg)
+	{
+		/* cancel the outstanding requests, and discard the batch handle */
+		if (ninflight > 0)
+			cuFileBatchIOCancel(cufile_batch_handle);
+		cuFileBatchIODestroy(cufile_batch_handle);
+		cufile_batch_nrooms = 0;
+		werror("%s (%ld)", errmsg, errcode);
+	}
+}
+#endif	/* WITH_CUFILE_BATCH */
+
+#if !defined(WITH_CUFILE) || defined(WITH_CUFILE_BATCH)
+/*
+ * gpuDirectSplitIOVByStripe
+ *
+ * It decomposes the i/o vector into the pieces not across the md-raid0
+ * chunk boundary, then groups them by the member device; the piece at
+ * file offset 'pos' belongs to the member (pos / stripe_sz) % width.
+ * The per-member vectors are returned on the buffer of the worker thread,
+ * so caller must not release them.
+ */
+static __thread char   *stripe_iovec_buffer = NULL;
+static __thread size_t	stripe_iovec_bufsz = 0;
+
+static strom_io_vector **
+gpuDirectSplitIOVByStripe(const GPUDirectFileDesc *gds_fdesc,
+						  strom_io_vector *iovec)
+{
+	unsigned int	width = gds_fdesc->stripe_width;
+	unsigned int	stripe_pages = gds_fdesc->stripe_sz / PAGE_SIZE;
+	strom_io_vector **results;
+	size_t			nr_pieces = 0;
+	size_t			required;
+	char		   *pos;
+	unsigned int	i, k;
+
+	/* upper bound of the number of pieces */
+	for (i=0; i < iovec->nr_chunks; i++)
+		nr_pieces += iovec->ioc[i].nr_pages / stripe_pages + 2;
+	required = (MAXALIGN(sizeof(strom_io_vector *) * width) +
+				MAXALIGN(offsetof(strom_io_vector, ioc)) * width +
+				sizeof(strom_io_chunk) * (nr_pieces + width));
+	if (stripe_iovec_bufsz < required)
+	{
+		char   *temp = realloc(stripe_iovec_buffer, required);
+
+		if (!temp)
+			werror("out of memory");
+		stripe_iovec_buffer = temp;
+		stripe_iovec_bufsz = required;
+	}
+	/*
+	 * The member vectors are laid out sequentially; each one may consume
+	 * up to the number of pieces, so we first count the pieces per member.
+	 */
+	results = (strom_io_vector **)stripe_iovec_buffer;
+	pos = stripe_iovec_buffer + MAXALIGN(sizeof(strom_io_vector *) * width);
+	{
+		size_t	counts[width];
+
+		memset(counts, 0, sizeof(size_t) * width);
+		for (i=0; i < iovec->nr_chunks; i++)
+		{
+			strom_io_chunk *ioc = &iovec->ioc[i];
+			unsigned int	fchunk_id = ioc->fchunk_id;
+			unsigned int	remained = ioc->nr_pages;
+
+			while (remained > 0)
+			{
+				unsigned int	sz = stripe_pages - fchunk_id % stripe_pages;
+
+				sz = Min(sz, remained);
+				counts[(fchunk_id / stripe_pages) % width]++;
+				fchunk_id += sz;
+				remained -= sz;
+			}
+		}
+		for (k=0; k < width; k++)
+		{
+			results[k] = (strom_io_vector *)pos;
+			results[k]->nr_chunks = 0;
+			pos += MAXALIGN(offsetof(strom_io_vector, ioc)) +
+				sizeof(strom_io_chunk) * (counts[k] + 1);
+		}
+	}
+
+	for (i=0; i < iovec->nr_chunks; i++)
+	{
+		strom_io_chunk *ioc = &iovec->ioc[i];
+		unsigned long	m_offset = ioc->m_offset;
+		unsigned int	fchunk_id = ioc->fchunk_id;
+		unsigned int	remained = ioc->nr_pages;
+
+		while (remained > 0)
+		{
+			strom_io_vector *sub;
+			strom_io_chunk *dst;
+			unsigned int	sz = stripe_pages - fchunk_id % stripe_pages;
+
+			sz = Min(sz, remained);
+			sub = results[(fchunk_id / stripe_pages) % width];
+			dst = &sub->ioc[sub->nr_chunks++];
+			dst->m_offset  = m_offset;
+			dst->fchunk_id = fchunk_id;
+			dst->nr_pages  = sz;
+
+			m_offset  += sz * PAGE_SIZE;
+			fchunk_id += sz;
+			remained  -= sz;
+		}
+	}
+	return results;
+}
+#endif
+
 /*
  * gpuDirectFileReadIOV
  */
@@ -1477,6 +2495,34 @@ gpuDirectFileReadIOV(const GPUDirectFileDesc *gds_fdesc,
 	size_t		unitsz = ((size_t)pgstrom_cufile_io_unitsz << 10);
 	int			i;
 
+#ifdef WITH_CUFILE_BATCH
+	if (pgstrom_cufile_io_depth > 1 && cuFileBatchIOSupported())
+	{
+		if (gds_fdesc->stripe_width > 1)
+		{
+			/* per-member queues of md-raid0 volume */
+			__gpuDirectFileReadIOVBatch(gds_fdesc,
+										m_segment,
+										m_offset,
+										gpuDirectSplitIOVByStripe(gds_fdesc,
+																  iovec),
+										gds_fdesc->stripe_width,
+										Min(unitsz, gds_fdesc->stripe_sz),
+										Max(pgstrom_cufile_io_depth,
+											gds_fdesc->stripe_width));
+		}
+		else
+		{
+			__gpuDirectFileReadIOVBatch(gds_fdesc,
+										m_segment,
+										m_offset,
+										&iovec, 1,
+										unitsz,
+										pgstrom_cufile_io_depth);
+		}
+		return;
+	}
+#endif
 	for (i=0; i < iovec->nr_chunks; i++)
 	{
 		strom_io_chunk *ioc = &iovec->ioc[i];
@@ -1510,6 +2556,46 @@ gpuDirectFileReadIOV(const GPUDirectFileDesc *gds_fdesc,
 	StromCmd__MemCopySsdToGpuRaw cmd;
 
 	Assert(iomap_handle != 0UL);
+	if (gds_fdesc->stripe_width > 1)
+	{
+		strom_io_vector **sub_iovecs;
+		unsigned long	dma_task_ids[gds_fdesc->stripe_width];
+		unsigned int	k, nr_tasks = 0;
+
+		/*
+		 * Submit the per-member stripes of md-raid0 volume individually,
+		 * so that the member devices process the DMA tasks concurrently,
+		 * then wait for completion of all of them.
+		 */
+		sub_iovecs = gpuDirectSplitIOVByStripe(gds_fdesc, iovec);
+		for (k=0; k < gds_fdesc->stripe_width; k++)
+		{
+			if (sub_iovecs[k]->nr_chunks == 0)
+				continue;
+			memset(&cmd, 0, sizeof(StromCmd__MemCopySsdToGpuRaw));
+			cmd.handle    = iomap_handle;
+			cmd.offset    = m_offset;
+			cmd.file_desc = gds_fdesc->rawfd;
+			cmd.nr_chunks = sub_iovecs[k]->nr_chunks;
+			cmd.page_sz   = PAGE_SIZE;
+			cmd.io_chunks = sub_iovecs[k]->ioc;
+
+			if (nvme_strom_ioctl(STROM_IOCTL__MEMCPY_SSD2GPU_RAW, &cmd) != 0)
+			{
+				/* DMA tasks already submitted must be completed */
+				while (nr_tasks > 0)
+					__gpuDirectWaitDmaTask(dma_task_ids[--nr_tasks]);
+				werror("failed on STROM_IOCTL__MEMCPY_SSD2GPU_RAW: %m");
+			}
+			dma_task_ids[nr_tasks++] = cmd.dma_task_id;
+		}
+		for (k=0; k < nr_tasks; k++)
+		{
+			if (!gpuDirectDmaQueueEnqueue(dma_task_ids[k]))
+				__gpuDirectWaitDmaTask(dma_task_ids[k]);
+		}
+		return;
+	}
 	memset(&cmd, 0, sizeof(StromCmd__MemCopySsdToGpuRaw));
 	cmd.handle    = iomap_handle;
 	cmd.offset    = m_offset;
@@ -1520,21 +2606,311 @@ gpuDirectFileReadIOV(const GPUDirectFileDesc *gds_fdesc,
 
 	if (nvme_strom_ioctl(STROM_IOCTL__MEMCPY_SSD2GPU_RAW, &cmd) != 0)
 		werror("failed on STROM_IOCTL__MEMCPY_SSD2GPU_RAW: %m");
+	if (!gpuDirectDmaQueueEnqueue(cmd.dma_task_id))
+		__gpuDirectWaitDmaTask(cmd.dma_task_id);
+#endif
+}
+
+#ifdef WITH_LIBURING
+static int		pgstrom_io_uring_queue_depth;	/* GUC */
+
+#define IO_URING_UNIT_SZ		(1UL << 20)		/* 1MB */
+#define IO_URING_DIRECT_ALIGN	4096
+
+typedef struct
+{
+	char	   *dest;
+	off_t		fpos;
+	size_t		len;
+	bool		direct;		/* true, if O_DIRECT file descriptor is used */
+	bool		fixed;		/* true, if registered buffer is used */
+	int			next_free;
+} ioUringSlot;
+
+/*
+ * __hostFileReadUringSubmit
+ */
+static bool
+__hostFileReadUringSubmit(struct io_uring *ring,
+						  ioUringSlot *slot, int slot_id,
+						  int fdesc, int dfdesc)
+{
+	struct io_uring_sqe *sqe;
+	size_t		len = Min(slot->len, IO_URING_UNIT_SZ);
+
+	/* O_DIRECT requires aligned destination, position and length */
+	if (slot->direct &&
+		(dfdesc < 0 ||
+		 (((uintptr_t)slot->dest |
+		   (uintptr_t)slot->fpos |
+		   (uintptr_t)len) & (IO_URING_DIRECT_ALIGN - 1)) != 0))
+		slot->direct = false;
+
+	sqe = io_uring_get_sqe(ring);
+	if (!sqe)
+		return false;
+	if (slot->fixed)
+		io_uring_prep_read_fixed(sqe, slot->direct ? dfdesc : fdesc,
+								 slot->dest, len, slot->fpos, 0);
 	else
+		io_uring_prep_read(sqe, slot->direct ? dfdesc : fdesc,
+						   slot->dest, len, slot->fpos);
+	io_uring_sqe_set_data(sqe, (void *)((uintptr_t)slot_id));
+	return true;
+}
+
+/*
+ * hostFileReadChunks
+ *
+ * It reads the supplied file chunks onto the host buffer using io_uring,
+ * with O_DIRECT if alignment allows, and deep queue depth. If the buffer
+ * is already pinned (by gpuMemAllocHost), it is registered as fixed buffer
+ * of the ring. It returns false if io_uring is not available, then caller
+ * has to read the chunks by pread(2) as usual.
+ * It is called by both of the backend and the GPU worker thread, so errors
+ * are raised by elog() on the backend, or werror() on the worker. Backend
+ * also checks the pending interrupts after the in-flight requests are all
+ * reaped, because they may write on the buffer.
+ * Due to the page_sz alignment, we may try to read the file over its tail,
+ * so the region over the EOF is filled up by zero.
+ */
+bool
+hostFileReadChunks(int fdesc, hostFileReadChunk *chunks, int nchunks,
+				   char *buf_base, size_t buf_len, bool buf_pinned)
+{
+	struct io_uring	ring;
+	ioUringSlot	   *slots;
+	int				depth = pgstrom_io_uring_queue_depth;
+	int				dfdesc = -1;
+	int				free_id = -1;
+	int				nr_inflight = 0;
+	int				curr_chunk = 0;
+	size_t			curr_off = 0;
+	bool			fixed = false;
+	bool			interrupted = false;
+	char			namebuf[64];
+	const char	   *emsg = NULL;
+	int				eval = 0;
+	int				i, rv;
+
+	if (depth <= 0 || nchunks <= 0)
+		return false;
+	if (io_uring_queue_init(depth, &ring, 0) != 0)
+		return false;
+	/* registered buffer, if host-pinned memory */
+	if (buf_pinned)
+	{
+		struct iovec	iov;
+
+		iov.iov_base = buf_base;
+		iov.iov_len  = buf_len;
+		if (io_uring_register_buffers(&ring, &iov, 1) == 0)
+			fixed = true;
+	}
+	/* another file descriptor with O_DIRECT, if filesystem supports */
+	snprintf(namebuf, sizeof(namebuf), "/proc/self/fd/%d", fdesc);
+	dfdesc = open(namebuf, O_RDONLY | O_DIRECT);
+
+	slots = alloca(sizeof(ioUringSlot) * depth);
+	for (i=depth-1; i >= 0; i--)
 	{
-		StromCmd__MemCopyWait __cmd;
+		slots[i].next_free = free_id;
+		free_id = i;
+	}
+
+	while (curr_chunk < nchunks || nr_inflight > 0)
+	{
+		struct io_uring_cqe *cqe;
+		int			nsubmit = 0;
 
-		memset(&__cmd, 0, sizeof(StromCmd__MemCopyWait));
-		__cmd.dma_task_id = cmd.dma_task_id;
-		//TODO: stat
-		while (nvme_strom_ioctl(STROM_IOCTL__MEMCPY_WAIT, &__cmd) != 0)
+		if (!GpuWorkerCurrentContext)
+		{
+			/* the in-flight requests must be reaped prior to the cancel */
+			if (InterruptPending)
+			{
+				interrupted = true;
+				goto bailout;
+			}
+		}
+		else if (pg_atomic_read_u32(&GpuWorkerCurrentContext->
+									terminate_workers))
 		{
-			if (errno != EINTR)
-				werror("failed on nvme_strom_ioctl(STROM_IOCTL__MEMCPY_WAIT): %m");
+			emsg = "GpuContext worker termination";
+			goto bailout;
+		}
+		/* fill up the submission queue */
+		while (curr_chunk < nchunks && free_id >= 0)
+		{
+			hostFileReadChunk *chunk = &chunks[curr_chunk];
+			ioUringSlot *slot = &slots[free_id];
+			size_t		len = Min(chunk->len - curr_off, IO_URING_UNIT_SZ);
+
+			if (len == 0)
+			{
+				curr_chunk++;
+				curr_off = 0;
+				continue;
+			}
+			slot->dest   = chunk->dest + curr_off;
+			slot->fpos   = chunk->fpos + curr_off;
+			slot->len    = len;
+			slot->direct = true;
+			slot->fixed  = fixed;
+			if (!__hostFileReadUringSubmit(&ring, slot, free_id,
+										   fdesc, dfdesc))
+				break;
+			free_id = slot->next_free;
+			nr_inflight++;
+			nsubmit++;
+			curr_off += len;
+			if (curr_off >= chunk->len)
+			{
+				curr_chunk++;
+				curr_off = 0;
+			}
+		}
+		if (nsubmit > 0)
+		{
+			rv = io_uring_submit(&ring);
+			if (rv < 0)
+			{
+				emsg = "failed on io_uring_submit";
+				eval = -rv;
+				nr_inflight -= nsubmit;
+				goto bailout;
+			}
+		}
+		if (nr_inflight == 0)
+			continue;
+
+		/* wait for completion, then reap them in batch */
+		rv = io_uring_wait_cqe(&ring, &cqe);
+		if (rv == -EINTR)
+			continue;
+		if (rv < 0)
+		{
+			emsg = "failed on io_uring_wait_cqe";
+			eval = -rv;
+			goto bailout;
+		}
+		nsubmit = 0;
+		do {
+			int			slot_id = (int)(uintptr_t)io_uring_cqe_get_data(cqe);
+			ioUringSlot *slot = &slots[slot_id];
+			int			res = cqe->res;
+
+			io_uring_cqe_seen(&ring, cqe);
+			if (res > 0)
+			{
+				Assert(res <= slot->len);
+				slot->dest += res;
+				slot->fpos += res;
+				slot->len  -= res;
+			}
+			else if (res == 0)
+			{
+				/* read over the tail of file */
+				memset(slot->dest, 0, slot->len);
+				slot->len = 0;
+			}
+			else if (res == -EINVAL && slot->direct)
+			{
+				/* filesystem may not accept O_DIRECT; retry buffered */
+				slot->direct = false;
+				close(dfdesc);
+				dfdesc = -1;
+			}
+			else if (res == -EFAULT && slot->fixed)
+			{
+				/* fixed buffer is not usable; retry unregistered */
+				slot->fixed = false;
+				fixed = false;
+			}
+			else if (res != -EINTR && res != -EAGAIN)
+			{
+				emsg = "failed on io_uring read";
+				eval = -res;
+				nr_inflight--;
+				goto bailout;
+			}
+
+			if (slot->len == 0)
+			{
+				slot->next_free = free_id;
+				free_id = slot_id;
+				nr_inflight--;
+			}
+			else if (__hostFileReadUringSubmit(&ring, slot, slot_id,
+												fdesc, dfdesc))
+				nsubmit++;
+			else
+			{
+				emsg = "no submission queue entry for io_uring";
+				nr_inflight--;
+				goto bailout;
+			}
+		} while (io_uring_peek_cqe(&ring, &cqe) == 0);
+
+		if (nsubmit > 0)
+		{
+			rv = io_uring_submit(&ring);
+			if (rv < 0)
+			{
+				emsg = "failed on io_uring_submit";
+				eval = -rv;
+				nr_inflight -= nsubmit;
+				goto bailout;
+			}
 		}
 	}
-#endif
+bailout:
+	/* in-flight requests may still write on the buffer */
+	while (nr_inflight > 0)
+	{
+		struct io_uring_cqe *cqe;
+
+		if (io_uring_wait_cqe(&ring, &cqe) != 0)
+			break;
+		io_uring_cqe_seen(&ring, cqe);
+		nr_inflight--;
+	}
+	if (dfdesc >= 0)
+		close(dfdesc);
+	io_uring_queue_exit(&ring);
+	if (interrupted)
+	{
+		CHECK_FOR_INTERRUPTS();
+		/* interrupts are held off; caller reads the chunks by pread(2) */
+		return false;
+	}
+	if (emsg)
+	{
+		/* backend (PDS_fillup_blocks, __PDS_fillup_arrow) or GPU worker */
+		if (!GpuWorkerCurrentContext)
+		{
+			if (eval != 0)
+			{
+				errno = eval;
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("%s: %m", emsg)));
+			}
+			elog(ERROR, "%s", emsg);
+		}
+		if (eval != 0)
+			werror("%s: %s", emsg, strerror(eval));
+		werror("%s", emsg);
+	}
+	return true;
 }
+#else
+bool
+hostFileReadChunks(int fdesc, hostFileReadChunk *chunks, int nchunks,
+				   char *buf_base, size_t buf_len, bool buf_pinned)
+{
+	return false;
+}
+#endif /* WITH_LIBURING */
 
 /*
  * pgstrom_init_gpu_direct
@@ -1593,7 +2969,29 @@ pgstrom_init_gpu_direct(void)
 							PGC_SUSET,
                             GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
                             cufile_io_unitsz_checker, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.cufile_io_depth",
+							"Number of outstanding cuFile batch i/o requests (0 or 1 = synchronous cuFileRead)",
+							NULL,
+							&pgstrom_cufile_io_depth,
+							32,
+							0,
+							128,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
 #endif /* WITH_CUFILE */
+#ifdef WITH_LIBURING
+	DefineCustomIntVariable("pg_strom.io_uring_queue_depth",
+							"Queue depth of io_uring for host memory fallback (0 = disabled)",
+							NULL,
+							&pgstrom_io_uring_queue_depth,
+							64,
+							0,
+							1024,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+#endif /* WITH_LIBURING */
 
 	/*
 	 * MEMO: Threshold of table's physical size to use NVMe-Strom:
@@ -1617,6 +3015,14 @@ pgstrom_init_gpu_direct(void)
 							PGC_SUSET,
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
+	DefineCustomBoolVariable("pg_strom.gpudirect_md_striping",
+							 "Submits SSD-to-GPU Direct reads to md-raid0 members individually",
+							 NULL,
+							 &pgstrom_gpudirect_md_striping,
+							 false,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 
 	/*
 	 * pg_strom.nvme_distance_map
@@ -1634,5 +3040,20 @@ pgstrom_init_gpu_direct(void)
 							   PGC_POSTMASTER,
 							   GUC_NOT_IN_SAMPLE,
 							   NULL, NULL, NULL);
+	/*
+	 * pg_strom.nvme_calibration_files
+	 *
+	 * config := <filename>[,<filename>...]
+	 *
+	 * eg) /opt/nvme0/calibration.dat,/opt/nvme1/calibration.dat
+	 */
+	DefineCustomStringVariable("pg_strom.nvme_calibration_files",
+							   "Files on NVME volumes to measure GPU<->NVME bandwidth at startup",
+							   NULL,
+							   &nvme_calibration_files,
+							   NULL,
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
 	setup_nvme_distance_map();
 }
@@ -0,0 +1,259 @@
+/*
+ * parquet_defs.h
+ *
+ * Definitions of Apache Parquet file format, for the reader of Arrow_Fdw.
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef _PARQUET_DEFS_H_
+#define _PARQUET_DEFS_H_
+
+#define PARQUET_MAGIC			"PAR1"
+#define PARQUET_MAGIC_LEN		4
+
+/*
+ * Type : physical type of the values
+ */
+typedef enum
+{
+	ParquetType__BOOLEAN			= 0,
+	ParquetType__INT32				= 1,
+	ParquetType__INT64				= 2,
+	ParquetType__INT96				= 3,
+	ParquetType__FLOAT				= 4,
+	ParquetType__DOUBLE				= 5,
+	ParquetType__BYTE_ARRAY			= 6,
+	ParquetType__FIXED_LEN_BYTE_ARRAY = 7,
+} ParquetType;
+
+/*
+ * ConvertedType : (legacy) logical type annotation
+ */
+typedef enum
+{
+	ParquetConvertedType__UTF8		= 0,
+	ParquetConvertedType__MAP		= 1,
+	ParquetConvertedType__MAP_KEY_VALUE = 2,
+	ParquetConvertedType__LIST		= 3,
+	ParquetConvertedType__ENUM		= 4,
+	ParquetConvertedType__DECIMAL	= 5,
+	ParquetConvertedType__DATE		= 6,
+	ParquetConvertedType__TIME_MILLIS = 7,
+	ParquetConvertedType__TIME_MICROS = 8,
+	ParquetConvertedType__TIMESTAMP_MILLIS = 9,
+	ParquetConvertedType__TIMESTAMP_MICROS = 10,
+	ParquetConvertedType__UINT_8	= 11,
+	ParquetConvertedType__UINT_16	= 12,
+	ParquetConvertedType__UINT_32	= 13,
+	ParquetConvertedType__UINT_64	= 14,
+	ParquetConvertedType__INT_8		= 15,
+	ParquetConvertedType__INT_16	= 16,
+	ParquetConvertedType__INT_32	= 17,
+	ParquetConvertedType__INT_64	= 18,
+	ParquetConvertedType__JSON		= 19,
+	ParquetConvertedType__BSON		= 20,
+	ParquetConvertedType__INTERVAL	= 21,
+} ParquetConvertedType;
+
+/*
+ * LogicalType : field-id of the LogicalType union
+ */
+typedef enum
+{
+	ParquetLogicalType__NONE		= 0,
+	ParquetLogicalType__STRING		= 1,
+	ParquetLogicalType__MAP			= 2,
+	ParquetLogicalType__LIST		= 3,
+	ParquetLogicalType__ENUM		= 4,
+	ParquetLogicalType__DECIMAL		= 5,
+	ParquetLogicalType__DATE		= 6,
+	ParquetLogicalType__TIME		= 7,
+	ParquetLogicalType__TIMESTAMP	= 8,
+	/* 9 is reserved for INTERVAL */
+	ParquetLogicalType__INTEGER		= 10,
+	ParquetLogicalType__UNKNOWN		= 11,
+	ParquetLogicalType__JSON		= 12,
+	ParquetLogicalType__BSON		= 13,
+	ParquetLogicalType__UUID		= 14,
+} ParquetLogicalType;
+
+/*
+ * TimeUnit : field-id of the TimeUnit union
+ */
+typedef enum
+{
+	ParquetTimeUnit__MILLIS			= 1,
+	ParquetTimeUnit__MICROS			= 2,
+	ParquetTimeUnit__NANOS			= 3,
+} ParquetTimeUnit;
+
+/*
+ * FieldRepetitionType
+ */
+typedef enum
+{
+	ParquetRepetition__REQUIRED		= 0,
+	ParquetRepetition__OPTIONAL		= 1,
+	ParquetRepetition__REPEATED		= 2,
+} ParquetRepetition;
+
+/*
+ * Encoding
+ */
+typedef enum
+{
+	ParquetEncoding__PLAIN			= 0,
+	ParquetEncoding__PLAIN_DICTIONARY = 2,
+	ParquetEncoding__RLE			= 3,
+	ParquetEncoding__BIT_PACKED		= 4,
+	ParquetEncoding__DELTA_BINARY_PACKED = 5,
+	ParquetEncoding__DELTA_LENGTH_BYTE_ARRAY = 6,
+	ParquetEncoding__DELTA_BYTE_ARRAY = 7,
+	ParquetEncoding__RLE_DICTIONARY	= 8,
+	ParquetEncoding__BYTE_STREAM_SPLIT = 9,
+} ParquetEncoding;
+
+/*
+ * CompressionCodec
+ */
+typedef enum
+{
+	ParquetCodec__UNCOMPRESSED		= 0,
+	ParquetCodec__SNAPPY			= 1,
+	ParquetCodec__GZIP				= 2,
+	ParquetCodec__LZO				= 3,
+	ParquetCodec__BROTLI			= 4,
+	ParquetCodec__LZ4				= 5,
+	ParquetCodec__ZSTD				= 6,
+	ParquetCodec__LZ4_RAW			= 7,
+} ParquetCodec;
+
+/*
+ * PageType
+ */
+typedef enum
+{
+	ParquetPageType__DATA_PAGE		= 0,
+	ParquetPageType__INDEX_PAGE		= 1,
+	ParquetPageType__DICTIONARY_PAGE = 2,
+	ParquetPageType__DATA_PAGE_V2	= 3,
+} ParquetPageType;
+
+/*
+ * ParquetSchemaElement
+ */
+typedef struct
+{
+	char	   *name;
+	int			type;				/* ParquetType, or -1 for groups */
+	int			type_length;		/* for FIXED_LEN_BYTE_ARRAY */
+	int			repetition_type;	/* ParquetRepetition, or -1 */
+	int			num_children;
+	int			converted_type;		/* ParquetConvertedType, or -1 */
+	int			scale;
+	int			precision;
+	/* LogicalType, if any */
+	int			logical_type;		/* ParquetLogicalType */
+	int			logical_unit;		/* ParquetTimeUnit of TIME/TIMESTAMP */
+	bool		logical_utc;		/* isAdjustedToUTC of TIME/TIMESTAMP */
+	int			logical_bitwidth;	/* bitWidth of INTEGER */
+	bool		logical_signed;		/* isSigned of INTEGER */
+} ParquetSchemaElement;
+
+/*
+ * ParquetStatistics - raw min/max values in PLAIN encoding
+ */
+typedef struct
+{
+	const char *min_value;
+	int			min_len;
+	const char *max_value;
+	int			max_len;
+	int64		null_count;			/* -1, if unknown */
+} ParquetStatistics;
+
+/*
+ * ParquetColumnChunk
+ */
+typedef struct
+{
+	int			type;				/* ParquetType */
+	int			codec;				/* ParquetCodec */
+	int64		num_values;
+	int64		total_compressed_size;
+	int64		data_page_offset;
+	int64		dictionary_page_offset;	/* -1, if none */
+	ParquetStatistics stats;
+} ParquetColumnChunk;
+
+/*
+ * ParquetRowGroup
+ */
+typedef struct
+{
+	int64		num_rows;
+	int			num_columns;
+	ParquetColumnChunk *columns;
+} ParquetRowGroup;
+
+/*
+ * ParquetFileInfo - state information of readParquetFileDesc()
+ */
+typedef struct
+{
+	const char *filename;
+	int			version;
+	int64		num_rows;
+	int			num_schema;
+	ParquetSchemaElement *schema;	/* [0] is the root group */
+	int			num_row_groups;
+	ParquetRowGroup *row_groups;
+	char	   *footer;				/* raw footer; stats points here */
+	size_t		footer_len;
+} ParquetFileInfo;
+
+/*
+ * ParquetDecodeBuffer - output of parquetDecodeColumnChunk()
+ *
+ * Values are decoded into the layout of KDS_FORMAT_ARROW; @nullmap is
+ * a validity bitmap (NULL if no nulls), @values is a fixed-length array,
+ * a bitmap of bool, or uint32 offset array of variable-length values on
+ * the @extra buffer.
+ */
+typedef struct
+{
+	char	   *nullmap;
+	size_t		nullmap_len;
+	char	   *values;
+	size_t		values_len;
+	char	   *extra;
+	size_t		extra_len;
+	int64		null_count;
+} ParquetDecodeBuffer;
+
+/*
+ * parquet_read.c
+ */
+extern bool		isParquetFileDesc(int fdesc);
+extern void		readParquetFileDesc(int fdesc, const char *filename,
+									ParquetFileInfo *pq_info);
+extern Oid		parquetTypeToPGTypeOid(ParquetSchemaElement *elem,
+									   ArrowTypeOptions *attopts);
+extern void		parquetDecodeColumnChunk(const char *filename,
+										 const char *chunk, size_t chunk_sz,
+										 Oid atttypid,
+										 int pq_type, int pq_type_length,
+										 int pq_codec, int pq_max_deflevel,
+										 int64 nrows,
+										 ParquetDecodeBuffer *result);
+#endif	/* _PARQUET_DEFS_H_ */
@@ -0,0 +1,1703 @@
+/*
+ * parquet_read.c
+ *
+ * Routines to read Apache Parquet files on behalf of Arrow_Fdw; parser of
+ * the file footer (Thrift compact protocol) and decoder of column chunks.
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+#include "arrow_defs.h"
+#include "parquet_defs.h"
+#ifdef WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Thrift compact protocol
+ */
+#define THRIFT_CTYPE__STOP				0
+#define THRIFT_CTYPE__BOOLEAN_TRUE		1
+#define THRIFT_CTYPE__BOOLEAN_FALSE		2
+#define THRIFT_CTYPE__BYTE				3
+#define THRIFT_CTYPE__I16				4
+#define THRIFT_CTYPE__I32				5
+#define THRIFT_CTYPE__I64				6
+#define THRIFT_CTYPE__DOUBLE			7
+#define THRIFT_CTYPE__BINARY			8
+#define THRIFT_CTYPE__LIST				9
+#define THRIFT_CTYPE__SET				10
+#define THRIFT_CTYPE__MAP				11
+#define THRIFT_CTYPE__STRUCT			12
+
+typedef struct
+{
+	const char	   *filename;
+	const uint8	   *pos;
+	const uint8	   *end;
+} thriftCursor;
+
+static inline uint8
+__thriftReadByte(thriftCursor *c)
+{
+	if (c->pos >= c->end)
+		elog(ERROR, "parquet: thrift buffer overrun in '%s'", c->filename);
+	return *c->pos++;
+}
+
+static uint64
+__thriftReadVarint(thriftCursor *c)
+{
+	uint64		value = 0;
+	int			shift;
+	uint8		b;
+
+	for (shift=0; shift < 64; shift += 7)
+	{
+		b = __thriftReadByte(c);
+		value |= ((uint64)(b & 0x7f)) << shift;
+		if ((b & 0x80) == 0)
+			return value;
+	}
+	elog(ERROR, "parquet: corrupted varint in '%s'", c->filename);
+}
+
+static inline int64
+__thriftReadZigZag(thriftCursor *c)
+{
+	uint64		value = __thriftReadVarint(c);
+
+	return (int64)(value >> 1) ^ -((int64)(value & 1));
+}
+
+static inline int32
+__thriftReadI32(thriftCursor *c)
+{
+	return (int32)__thriftReadZigZag(c);
+}
+
+static const char *
+__thriftReadBinary(thriftCursor *c, int *p_len)
+{
+	uint64		len = __thriftReadVarint(c);
+	const char *result = (const char *)c->pos;
+
+	if (len > (uint64)(c->end - c->pos))
+		elog(ERROR, "parquet: thrift buffer overrun in '%s'", c->filename);
+	c->pos += len;
+	*p_len = len;
+	return result;
+}
+
+static bool
+__thriftReadFieldBegin(thriftCursor *c, int *p_fid, int *p_ftype)
+{
+	uint8		b = __thriftReadByte(c);
+	int			delta;
+
+	if (b == THRIFT_CTYPE__STOP)
+		return false;
+	delta = (b >> 4);
+	*p_ftype = (b & 0x0f);
+	if (delta != 0)
+		*p_fid += delta;
+	else
+		*p_fid = (int16)__thriftReadZigZag(c);
+	return true;
+}
+
+static int
+__thriftReadListBegin(thriftCursor *c, int *p_etype)
+{
+	uint8		b = __thriftReadByte(c);
+	uint64		nitems = (b >> 4);
+
+	*p_etype = (b & 0x0f);
+	if (nitems == 15)
+		nitems = __thriftReadVarint(c);
+	/* every element consumes one byte at least */
+	if (nitems > (uint64)(c->end - c->pos))
+		elog(ERROR, "parquet: thrift list is too large in '%s'", c->filename);
+	return nitems;
+}
+
+/*
+ * __thriftSkip - skip a value; note that boolean fields carry the value in
+ * the field header, but boolean elements of containers consume one byte.
+ */
+static void
+__thriftSkip(thriftCursor *c, int ftype, bool is_elem, int depth)
+{
+	int			i, nitems;
+	int			fid, etype;
+
+	if (depth > 32)
+		elog(ERROR, "parquet: too deep thrift structure in '%s'", c->filename);
+	switch (ftype)
+	{
+		case THRIFT_CTYPE__BOOLEAN_TRUE:
+		case THRIFT_CTYPE__BOOLEAN_FALSE:
+			if (is_elem)
+				(void) __thriftReadByte(c);
+			break;
+		case THRIFT_CTYPE__BYTE:
+			(void) __thriftReadByte(c);
+			break;
+		case THRIFT_CTYPE__I16:
+		case THRIFT_CTYPE__I32:
+		case THRIFT_CTYPE__I64:
+			(void) __thriftReadVarint(c);
+			break;
+		case THRIFT_CTYPE__DOUBLE:
+			if (c->end - c->pos < sizeof(double))
+				elog(ERROR, "parquet: thrift buffer overrun in '%s'",
+					 c->filename);
+			c->pos += sizeof(double);
+			break;
+		case THRIFT_CTYPE__BINARY:
+			(void) __thriftReadBinary(c, &i);
+			break;
+		case THRIFT_CTYPE__LIST:
+		case THRIFT_CTYPE__SET:
+			nitems = __thriftReadListBegin(c, &etype);
+			for (i=0; i < nitems; i++)
+				__thriftSkip(c, etype, true, depth+1);
+			break;
+		case THRIFT_CTYPE__MAP:
+			nitems = __thriftReadVarint(c);
+			if (nitems > 0)
+			{
+				uint8	kvtype = __thriftReadByte(c);
+
+				for (i=0; i < nitems; i++)
+				{
+					__thriftSkip(c, (kvtype >> 4), true, depth+1);
+					__thriftSkip(c, (kvtype & 0x0f), true, depth+1);
+				}
+			}
+			break;
+		case THRIFT_CTYPE__STRUCT:
+			fid = 0;
+			while (__thriftReadFieldBegin(c, &fid, &etype))
+				__thriftSkip(c, etype, false, depth+1);
+			break;
+		default:
+			elog(ERROR, "parquet: unknown thrift type (%d) in '%s'",
+				 ftype, c->filename);
+	}
+}
+
+/*
+ * __thriftFieldIs - checks type of the field, or skip it if mismatch
+ */
+static inline bool
+__thriftFieldIs(thriftCursor *c, int ftype, int expected)
+{
+	if (ftype == expected ||
+		(expected == THRIFT_CTYPE__BOOLEAN_TRUE &&
+		 ftype == THRIFT_CTYPE__BOOLEAN_FALSE))
+		return true;
+	__thriftSkip(c, ftype, false, 0);
+	return false;
+}
+
+/*
+ * Parquet metadata structures
+ */
+static int
+__readParquetTimeUnit(thriftCursor *c)
+{
+	int			fid = 0, ftype;
+	int			unit = -1;
+
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		/* TimeUnit is a union of empty structs */
+		if (ftype == THRIFT_CTYPE__STRUCT)
+			unit = fid;
+		__thriftSkip(c, ftype, false, 0);
+	}
+	return unit;
+}
+
+static void
+__readParquetLogicalType(thriftCursor *c, ParquetSchemaElement *elem)
+{
+	int			fid = 0, ftype;
+	int			__fid, __ftype;
+
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		if (ftype != THRIFT_CTYPE__STRUCT)
+		{
+			__thriftSkip(c, ftype, false, 0);
+			continue;
+		}
+		elem->logical_type = fid;
+		__fid = 0;
+		while (__thriftReadFieldBegin(c, &__fid, &__ftype))
+		{
+			switch (fid)
+			{
+				case ParquetLogicalType__DECIMAL:
+					if (__fid == 1 &&
+						__thriftFieldIs(c, __ftype, THRIFT_CTYPE__I32))
+						elem->scale = __thriftReadI32(c);
+					else if (__fid == 2 &&
+							 __thriftFieldIs(c, __ftype, THRIFT_CTYPE__I32))
+						elem->precision = __thriftReadI32(c);
+					else if (__fid < 1 || __fid > 2)
+						__thriftSkip(c, __ftype, false, 0);
+					break;
+				case ParquetLogicalType__TIME:
+				case ParquetLogicalType__TIMESTAMP:
+					if (__fid == 1 &&
+						__thriftFieldIs(c, __ftype, THRIFT_CTYPE__BOOLEAN_TRUE))
+						elem->logical_utc = (__ftype == THRIFT_CTYPE__BOOLEAN_TRUE);
+					else if (__fid == 2 &&
+							 __thriftFieldIs(c, __ftype, THRIFT_CTYPE__STRUCT))
+						elem->logical_unit = __readParquetTimeUnit(c);
+					else if (__fid < 1 || __fid > 2)
+						__thriftSkip(c, __ftype, false, 0);
+					break;
+				case ParquetLogicalType__INTEGER:
+					if (__fid == 1 &&
+						__thriftFieldIs(c, __ftype, THRIFT_CTYPE__BYTE))
+						elem->logical_bitwidth = (int8)__thriftReadByte(c);
+					else if (__fid == 2 &&
+							 __thriftFieldIs(c, __ftype, THRIFT_CTYPE__BOOLEAN_TRUE))
+						elem->logical_signed = (__ftype == THRIFT_CTYPE__BOOLEAN_TRUE);
+					else if (__fid < 1 || __fid > 2)
+						__thriftSkip(c, __ftype, false, 0);
+					break;
+				default:
+					__thriftSkip(c, __ftype, false, 0);
+					break;
+			}
+		}
+	}
+}
+
+static void
+__readParquetSchemaElement(thriftCursor *c, ParquetSchemaElement *elem)
+{
+	int			fid = 0, ftype;
+	const char *name;
+	int			len;
+
+	memset(elem, 0, sizeof(ParquetSchemaElement));
+	elem->type = -1;
+	elem->repetition_type = -1;
+	elem->converted_type = -1;
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					elem->type = __thriftReadI32(c);
+				break;
+			case 2:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					elem->type_length = __thriftReadI32(c);
+				break;
+			case 3:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					elem->repetition_type = __thriftReadI32(c);
+				break;
+			case 4:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__BINARY))
+				{
+					name = __thriftReadBinary(c, &len);
+					elem->name = pnstrdup(name, len);
+				}
+				break;
+			case 5:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					elem->num_children = __thriftReadI32(c);
+				break;
+			case 6:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					elem->converted_type = __thriftReadI32(c);
+				break;
+			case 7:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					elem->scale = __thriftReadI32(c);
+				break;
+			case 8:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					elem->precision = __thriftReadI32(c);
+				break;
+			case 10:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__STRUCT))
+					__readParquetLogicalType(c, elem);
+				break;
+			default:
+				__thriftSkip(c, ftype, false, 0);
+				break;
+		}
+	}
+}
+
+static void
+__readParquetStatistics(thriftCursor *c, ParquetStatistics *stats)
+{
+	int			fid = 0, ftype;
+	const char *legacy_min = NULL;
+	const char *legacy_max = NULL;
+	int			legacy_min_len = 0;
+	int			legacy_max_len = 0;
+
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__BINARY))
+					legacy_max = __thriftReadBinary(c, &legacy_max_len);
+				break;
+			case 2:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__BINARY))
+					legacy_min = __thriftReadBinary(c, &legacy_min_len);
+				break;
+			case 3:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I64))
+					stats->null_count = __thriftReadZigZag(c);
+				break;
+			case 5:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__BINARY))
+					stats->max_value = __thriftReadBinary(c, &stats->max_len);
+				break;
+			case 6:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__BINARY))
+					stats->min_value = __thriftReadBinary(c, &stats->min_len);
+				break;
+			default:
+				__thriftSkip(c, ftype, false, 0);
+				break;
+		}
+	}
+	/*
+	 * The legacy min/max are ordered by signed comparison, so they are
+	 * still valid for the numeric types; caller shall pick up them for
+	 * INT32, INT64, FLOAT and DOUBLE only.
+	 */
+	if (!stats->min_value || !stats->max_value)
+	{
+		stats->min_value = legacy_min;
+		stats->min_len   = legacy_min_len;
+		stats->max_value = legacy_max;
+		stats->max_len   = legacy_max_len;
+	}
+}
+
+static void
+__readParquetColumnMetaData(thriftCursor *c, ParquetColumnChunk *cchunk)
+{
+	int			fid = 0, ftype;
+
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					cchunk->type = __thriftReadI32(c);
+				break;
+			case 4:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					cchunk->codec = __thriftReadI32(c);
+				break;
+			case 5:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I64))
+					cchunk->num_values = __thriftReadZigZag(c);
+				break;
+			case 7:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I64))
+					cchunk->total_compressed_size = __thriftReadZigZag(c);
+				break;
+			case 9:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I64))
+					cchunk->data_page_offset = __thriftReadZigZag(c);
+				break;
+			case 11:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I64))
+					cchunk->dictionary_page_offset = __thriftReadZigZag(c);
+				break;
+			case 12:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__STRUCT))
+					__readParquetStatistics(c, &cchunk->stats);
+				break;
+			default:
+				__thriftSkip(c, ftype, false, 0);
+				break;
+		}
+	}
+}
+
+static void
+__readParquetColumnChunk(thriftCursor *c, ParquetColumnChunk *cchunk)
+{
+	int			fid = 0, ftype;
+	bool		has_metadata = false;
+
+	memset(cchunk, 0, sizeof(ParquetColumnChunk));
+	cchunk->type = -1;
+	cchunk->dictionary_page_offset = -1;
+	cchunk->stats.null_count = -1;
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				/* column chunk in the external file */
+				elog(ERROR, "parquet: file '%s' refers external column chunks, not supported",
+					 c->filename);
+				break;
+			case 3:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__STRUCT))
+				{
+					__readParquetColumnMetaData(c, cchunk);
+					has_metadata = true;
+				}
+				break;
+			default:
+				__thriftSkip(c, ftype, false, 0);
+				break;
+		}
+	}
+	if (!has_metadata)
+		elog(ERROR, "parquet: file '%s' has column chunks without metadata (encrypted?)",
+			 c->filename);
+}
+
+static void
+__readParquetRowGroup(thriftCursor *c, ParquetRowGroup *rgroup)
+{
+	int			fid = 0, ftype;
+	int			i, etype;
+
+	memset(rgroup, 0, sizeof(ParquetRowGroup));
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__LIST))
+				{
+					rgroup->num_columns = __thriftReadListBegin(c, &etype);
+					if (rgroup->num_columns > 0 &&
+						etype != THRIFT_CTYPE__STRUCT)
+						elog(ERROR, "parquet: corrupted RowGroup in '%s'",
+							 c->filename);
+					rgroup->columns = palloc0(sizeof(ParquetColumnChunk) *
+											  Max(rgroup->num_columns, 1));
+					for (i=0; i < rgroup->num_columns; i++)
+						__readParquetColumnChunk(c, &rgroup->columns[i]);
+				}
+				break;
+			case 3:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I64))
+					rgroup->num_rows = __thriftReadZigZag(c);
+				break;
+			default:
+				__thriftSkip(c, ftype, false, 0);
+				break;
+		}
+	}
+}
+
+static void
+__readParquetFileMetaData(thriftCursor *c, ParquetFileInfo *pq_info)
+{
+	int			fid = 0, ftype;
+	int			i, etype;
+
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					pq_info->version = __thriftReadI32(c);
+				break;
+			case 2:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__LIST))
+				{
+					pq_info->num_schema = __thriftReadListBegin(c, &etype);
+					if (pq_info->num_schema > 0 &&
+						etype != THRIFT_CTYPE__STRUCT)
+						elog(ERROR, "parquet: corrupted schema in '%s'",
+							 c->filename);
+					pq_info->schema = palloc0(sizeof(ParquetSchemaElement) *
+											  Max(pq_info->num_schema, 1));
+					for (i=0; i < pq_info->num_schema; i++)
+						__readParquetSchemaElement(c, &pq_info->schema[i]);
+				}
+				break;
+			case 3:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I64))
+					pq_info->num_rows = __thriftReadZigZag(c);
+				break;
+			case 4:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__LIST))
+				{
+					pq_info->num_row_groups = __thriftReadListBegin(c, &etype);
+					if (pq_info->num_row_groups > 0 &&
+						etype != THRIFT_CTYPE__STRUCT)
+						elog(ERROR, "parquet: corrupted RowGroup in '%s'",
+							 c->filename);
+					pq_info->row_groups = palloc0(sizeof(ParquetRowGroup) *
+												  Max(pq_info->num_row_groups, 1));
+					for (i=0; i < pq_info->num_row_groups; i++)
+						__readParquetRowGroup(c, &pq_info->row_groups[i]);
+				}
+				break;
+			default:
+				__thriftSkip(c, ftype, false, 0);
+				break;
+		}
+	}
+}
+
+/*
+ * isParquetFileDesc
+ */
+bool
+isParquetFileDesc(int fdesc)
+{
+	struct stat	stat_buf;
+	char		magic[PARQUET_MAGIC_LEN];
+
+	if (fstat(fdesc, &stat_buf) != 0 ||
+		stat_buf.st_size < 2 * PARQUET_MAGIC_LEN + sizeof(int32))
+		return false;
+	if (pread(fdesc, magic, PARQUET_MAGIC_LEN, 0) != PARQUET_MAGIC_LEN ||
+		memcmp(magic, PARQUET_MAGIC, PARQUET_MAGIC_LEN) != 0)
+		return false;
+	if (pread(fdesc, magic, PARQUET_MAGIC_LEN,
+			  stat_buf.st_size - PARQUET_MAGIC_LEN) != PARQUET_MAGIC_LEN ||
+		memcmp(magic, PARQUET_MAGIC, PARQUET_MAGIC_LEN) != 0)
+		return false;
+	return true;
+}
+
+/*
+ * readParquetFileDesc
+ *
+ * It reads the footer of Parquet file; that is FileMetaData serialized by
+ * the Thrift compact protocol, followed by its length and the magic.
+ */
+void
+readParquetFileDesc(int fdesc, const char *filename, ParquetFileInfo *pq_info)
+{
+	struct stat	stat_buf;
+	char		tail[sizeof(int32) + PARQUET_MAGIC_LEN];
+	int32		footer_len;
+	thriftCursor c;
+
+	memset(pq_info, 0, sizeof(ParquetFileInfo));
+	pq_info->filename = filename;
+	if (fstat(fdesc, &stat_buf) != 0)
+		elog(ERROR, "failed on fstat('%s'): %m", filename);
+	if (stat_buf.st_size < 2 * PARQUET_MAGIC_LEN + sizeof(int32))
+		elog(ERROR, "file '%s' is too short for Apache Parquet", filename);
+	if (pread(fdesc, tail, sizeof(tail),
+			  stat_buf.st_size - sizeof(tail)) != sizeof(tail))
+		elog(ERROR, "failed on pread('%s'): %m", filename);
+	if (memcmp(tail + sizeof(int32), PARQUET_MAGIC, PARQUET_MAGIC_LEN) != 0)
+		elog(ERROR, "file '%s' is not Apache Parquet", filename);
+	memcpy(&footer_len, tail, sizeof(int32));
+	if (footer_len <= 0 ||
+		footer_len > stat_buf.st_size - PARQUET_MAGIC_LEN - sizeof(tail))
+		elog(ERROR, "parquet: file '%s' has corrupted footer length (%d)",
+			 filename, footer_len);
+	pq_info->footer = palloc(footer_len);
+	pq_info->footer_len = footer_len;
+	if (pread(fdesc, pq_info->footer, footer_len,
+			  stat_buf.st_size - sizeof(tail) - footer_len) != footer_len)
+		elog(ERROR, "failed on pread('%s'): %m", filename);
+
+	c.filename = filename;
+	c.pos = (const uint8 *)pq_info->footer;
+	c.end = (const uint8 *)pq_info->footer + footer_len;
+	__readParquetFileMetaData(&c, pq_info);
+	if (pq_info->num_schema < 1 || pq_info->schema[0].num_children < 0)
+		elog(ERROR, "parquet: file '%s' has no valid schema", filename);
+}
+
+/*
+ * parquetTypeToPGTypeOid
+ *
+ * It returns PostgreSQL type that is compatible to the leaf column of
+ * Parquet schema, or InvalidOid if not supported.
+ */
+Oid
+parquetTypeToPGTypeOid(ParquetSchemaElement *elem, ArrowTypeOptions *attopts)
+{
+	int		ltype = elem->logical_type;
+	int		ctype = elem->converted_type;
+	int		unit;
+
+	memset(attopts, 0, sizeof(ArrowTypeOptions));
+	if (elem->type < 0 ||
+		elem->num_children > 0 ||
+		elem->repetition_type == ParquetRepetition__REPEATED)
+		return InvalidOid;
+	if (ltype == ParquetLogicalType__DECIMAL ||
+		ctype == ParquetConvertedType__DECIMAL)
+	{
+		if (elem->precision < 1 || elem->precision > 38 ||
+			elem->scale < 0 || elem->scale > elem->precision)
+			return InvalidOid;
+		if (elem->type != ParquetType__INT32 &&
+			elem->type != ParquetType__INT64 &&
+			(elem->type != ParquetType__FIXED_LEN_BYTE_ARRAY ||
+			 elem->type_length < 1 || elem->type_length > sizeof(int128)))
+			return InvalidOid;
+		attopts->decimal.precision = elem->precision;
+		attopts->decimal.scale = elem->scale;
+		return NUMERICOID;
+	}
+
+	switch (elem->type)
+	{
+		case ParquetType__BOOLEAN:
+			return BOOLOID;
+
+		case ParquetType__INT32:
+			if (ltype == ParquetLogicalType__DATE ||
+				ctype == ParquetConvertedType__DATE)
+			{
+				attopts->date.unit = ArrowDateUnit__Day;
+				return DATEOID;
+			}
+			if ((ltype == ParquetLogicalType__TIME &&
+				 elem->logical_unit == ParquetTimeUnit__MILLIS) ||
+				ctype == ParquetConvertedType__TIME_MILLIS)
+			{
+				attopts->time.unit = ArrowTimeUnit__MilliSecond;
+				return TIMEOID;
+			}
+			if (ltype == ParquetLogicalType__INTEGER)
+			{
+				if (elem->logical_bitwidth == 8 ||
+					(elem->logical_bitwidth == 16 && elem->logical_signed))
+					return INT2OID;
+				if (elem->logical_bitwidth == 16 || elem->logical_signed)
+					return INT4OID;
+				return InvalidOid;		/* uint32 */
+			}
+			if (ctype == ParquetConvertedType__INT_8 ||
+				ctype == ParquetConvertedType__INT_16 ||
+				ctype == ParquetConvertedType__UINT_8)
+				return INT2OID;
+			if (ctype == ParquetConvertedType__UINT_32)
+				return InvalidOid;
+			return INT4OID;
+
+		case ParquetType__INT64:
+			if (ltype == ParquetLogicalType__TIMESTAMP ||
+				ctype == ParquetConvertedType__TIMESTAMP_MILLIS ||
+				ctype == ParquetConvertedType__TIMESTAMP_MICROS)
+			{
+				if (ltype == ParquetLogicalType__TIMESTAMP)
+					unit = elem->logical_unit;
+				else if (ctype == ParquetConvertedType__TIMESTAMP_MILLIS)
+					unit = ParquetTimeUnit__MILLIS;
+				else
+					unit = ParquetTimeUnit__MICROS;
+				switch (unit)
+				{
+					case ParquetTimeUnit__MILLIS:
+						attopts->timestamp.unit = ArrowTimeUnit__MilliSecond;
+						break;
+					case ParquetTimeUnit__MICROS:
+						attopts->timestamp.unit = ArrowTimeUnit__MicroSecond;
+						break;
+					case ParquetTimeUnit__NANOS:
+						attopts->timestamp.unit = ArrowTimeUnit__NanoSecond;
+						break;
+					default:
+						return InvalidOid;
+				}
+				/* legacy converted types are adjusted to UTC */
+				if (ltype != ParquetLogicalType__TIMESTAMP || elem->logical_utc)
+					return TIMESTAMPTZOID;
+				return TIMESTAMPOID;
+			}
+			if ((ltype == ParquetLogicalType__TIME &&
+				 elem->logical_unit == ParquetTimeUnit__MICROS) ||
+				ctype == ParquetConvertedType__TIME_MICROS)
+			{
+				attopts->time.unit = ArrowTimeUnit__MicroSecond;
+				return TIMEOID;
+			}
+			if (ltype == ParquetLogicalType__TIME &&
+				elem->logical_unit == ParquetTimeUnit__NANOS)
+			{
+				attopts->time.unit = ArrowTimeUnit__NanoSecond;
+				return TIMEOID;
+			}
+			if ((ltype == ParquetLogicalType__INTEGER &&
+				 !elem->logical_signed) ||
+				ctype == ParquetConvertedType__UINT_64)
+				return InvalidOid;		/* uint64 */
+			return INT8OID;
+
+		case ParquetType__FLOAT:
+			return FLOAT4OID;
+
+		case ParquetType__DOUBLE:
+			return FLOAT8OID;
+
+		case ParquetType__BYTE_ARRAY:
+			if (ltype == ParquetLogicalType__STRING ||
+				ltype == ParquetLogicalType__ENUM ||
+				ltype == ParquetLogicalType__JSON ||
+				ctype == ParquetConvertedType__UTF8 ||
+				ctype == ParquetConvertedType__ENUM ||
+				ctype == ParquetConvertedType__JSON)
+				return TEXTOID;
+			return BYTEAOID;
+
+		case ParquetType__FIXED_LEN_BYTE_ARRAY:
+			if (elem->type_length < 0)
+				return InvalidOid;
+			return BYTEAOID;
+
+		default:
+			/* INT96 (deprecated) */
+			break;
+	}
+	return InvalidOid;
+}
+
+/*
+ * Page header
+ */
+typedef struct
+{
+	int			type;					/* ParquetPageType */
+	int			uncompressed_page_size;
+	int			compressed_page_size;
+	int			num_values;
+	int			encoding;				/* ParquetEncoding */
+	int			def_level_encoding;		/* DATA_PAGE */
+	int			def_levels_byte_length;	/* DATA_PAGE_V2 */
+	int			rep_levels_byte_length;	/* DATA_PAGE_V2 */
+	bool		is_compressed;			/* DATA_PAGE_V2 */
+} parquetPageHeader;
+
+static void
+__readParquetSubPageHeader(thriftCursor *c, parquetPageHeader *phdr,
+						   int page_type)
+{
+	int			fid = 0, ftype;
+
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		int		value = -1;
+
+		if (ftype == THRIFT_CTYPE__I32)
+			value = __thriftReadI32(c);
+		else if (page_type == ParquetPageType__DATA_PAGE_V2 && fid == 7 &&
+				 (ftype == THRIFT_CTYPE__BOOLEAN_TRUE ||
+				  ftype == THRIFT_CTYPE__BOOLEAN_FALSE))
+		{
+			phdr->is_compressed = (ftype == THRIFT_CTYPE__BOOLEAN_TRUE);
+			continue;
+		}
+		else
+		{
+			__thriftSkip(c, ftype, false, 0);
+			continue;
+		}
+
+		switch (page_type)
+		{
+			case ParquetPageType__DATA_PAGE:
+				if (fid == 1)
+					phdr->num_values = value;
+				else if (fid == 2)
+					phdr->encoding = value;
+				else if (fid == 3)
+					phdr->def_level_encoding = value;
+				break;
+			case ParquetPageType__DICTIONARY_PAGE:
+				if (fid == 1)
+					phdr->num_values = value;
+				else if (fid == 2)
+					phdr->encoding = value;
+				break;
+			case ParquetPageType__DATA_PAGE_V2:
+				if (fid == 1)
+					phdr->num_values = value;
+				else if (fid == 4)
+					phdr->encoding = value;
+				else if (fid == 5)
+					phdr->def_levels_byte_length = value;
+				else if (fid == 6)
+					phdr->rep_levels_byte_length = value;
+				break;
+		}
+	}
+}
+
+static void
+__readParquetPageHeader(thriftCursor *c, parquetPageHeader *phdr)
+{
+	int			fid = 0, ftype;
+
+	memset(phdr, 0, sizeof(parquetPageHeader));
+	phdr->type = -1;
+	phdr->def_level_encoding = ParquetEncoding__RLE;
+	phdr->is_compressed = true;
+	while (__thriftReadFieldBegin(c, &fid, &ftype))
+	{
+		switch (fid)
+		{
+			case 1:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					phdr->type = __thriftReadI32(c);
+				break;
+			case 2:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					phdr->uncompressed_page_size = __thriftReadI32(c);
+				break;
+			case 3:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__I32))
+					phdr->compressed_page_size = __thriftReadI32(c);
+				break;
+			case 5:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__STRUCT))
+					__readParquetSubPageHeader(c, phdr,
+											   ParquetPageType__DATA_PAGE);
+				break;
+			case 7:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__STRUCT))
+					__readParquetSubPageHeader(c, phdr,
+											   ParquetPageType__DICTIONARY_PAGE);
+				break;
+			case 8:
+				if (__thriftFieldIs(c, ftype, THRIFT_CTYPE__STRUCT))
+					__readParquetSubPageHeader(c, phdr,
+											   ParquetPageType__DATA_PAGE_V2);
+				break;
+			default:
+				__thriftSkip(c, ftype, false, 0);
+				break;
+		}
+	}
+	if (phdr->compressed_page_size < 0 ||
+		phdr->uncompressed_page_size < 0 ||
+		phdr->num_values < 0)
+		elog(ERROR, "parquet: corrupted page header in '%s'", c->filename);
+}
+
+/*
+ * __snappyDecompress - raw snappy format (not framed)
+ */
+static void
+__snappyDecompress(const char *filename,
+				   char *dest, size_t dest_len,
+				   const char *src, size_t src_len)
+{
+	const uint8 *pos = (const uint8 *)src;
+	const uint8 *end = (const uint8 *)src + src_len;
+	uint64		ulen = 0;
+	size_t		d_pos = 0;
+	int			shift;
+	uint8		b;
+
+	/* preamble; length of the uncompressed data */
+	for (shift=0; ; shift += 7)
+	{
+		if (pos >= end || shift > 28)
+			goto corrupted;
+		b = *pos++;
+		ulen |= ((uint64)(b & 0x7f)) << shift;
+		if ((b & 0x80) == 0)
+			break;
+	}
+	if (ulen != dest_len)
+		goto corrupted;
+
+	while (pos < end)
+	{
+		uint8		tag = *pos++;
+		size_t		len, off, i;
+
+		switch (tag & 3)
+		{
+			case 0:		/* literal */
+				len = (tag >> 2);
+				if (len >= 60)
+				{
+					int		nbytes = len - 59;
+
+					if (end - pos < nbytes)
+						goto corrupted;
+					for (i=0, len=0; i < nbytes; i++)
+						len |= ((size_t)pos[i]) << (8 * i);
+					pos += nbytes;
+				}
+				len += 1;
+				if (end - pos < len || dest_len - d_pos < len)
+					goto corrupted;
+				memcpy(dest + d_pos, pos, len);
+				pos += len;
+				d_pos += len;
+				continue;
+			case 1:		/* copy with 1-byte offset */
+				if (end - pos < 1)
+					goto corrupted;
+				len = ((tag >> 2) & 7) + 4;
+				off = ((size_t)(tag >> 5) << 8) | pos[0];
+				pos += 1;
+				break;
+			case 2:		/* copy with 2-bytes offset */
+				if (end - pos < 2)
+					goto corrupted;
+				len = (tag >> 2) + 1;
+				off = (size_t)pos[0] | ((size_t)pos[1] << 8);
+				pos += 2;
+				break;
+			default:	/* copy with 4-bytes offset */
+				if (end - pos < 4)
+					goto corrupted;
+				len = (tag >> 2) + 1;
+				off = ((size_t)pos[0]       | ((size_t)pos[1] << 8) |
+					   ((size_t)pos[2] << 16) | ((size_t)pos[3] << 24));
+				pos += 4;
+				break;
+		}
+		if (off == 0 || off > d_pos || dest_len - d_pos < len)
+			goto corrupted;
+		/* copy source may overlap with the destination */
+		for (i=0; i < len; i++)
+			dest[d_pos + i] = dest[d_pos - off + i];
+		d_pos += len;
+	}
+	if (d_pos == dest_len)
+		return;
+corrupted:
+	elog(ERROR, "parquet: corrupted Snappy buffer in '%s'", filename);
+}
+
+static void
+__parquetDecompress(int codec, const char *filename,
+					char *dest, size_t dest_len,
+					const char *src, size_t src_len)
+{
+	switch (codec)
+	{
+		case ParquetCodec__UNCOMPRESSED:
+			if (src_len != dest_len)
+				elog(ERROR, "parquet: uncompressed page of '%s' has unexpected length (%zu of %zu)",
+					 filename, src_len, dest_len);
+			memcpy(dest, src, src_len);
+			break;
+		case ParquetCodec__SNAPPY:
+			__snappyDecompress(filename, dest, dest_len, src, src_len);
+			break;
+		case ParquetCodec__ZSTD:
+#ifdef WITH_ZSTD
+			{
+				size_t		rv = ZSTD_decompress(dest, dest_len, src, src_len);
+
+				if (ZSTD_isError(rv))
+					elog(ERROR, "failed on ZSTD_decompress('%s'): %s",
+						 filename, ZSTD_getErrorName(rv));
+				if (rv != dest_len)
+					elog(ERROR, "parquet: ZSTD page of '%s' has unexpected length (%zu of %zu)",
+						 filename, rv, dest_len);
+			}
+#else
+			elog(ERROR, "parquet: ZSTD compression is not supported in this build");
+#endif
+			break;
+		case ParquetCodec__LZ4_RAW:
+#ifdef WITH_LZ4
+			{
+				int		rv = LZ4_decompress_safe(src, dest, src_len, dest_len);
+
+				if (rv < 0 || rv != dest_len)
+					elog(ERROR, "failed on LZ4_decompress_safe('%s'): %d",
+						 filename, rv);
+			}
+#else
+			elog(ERROR, "parquet: LZ4_RAW compression is not supported in this build");
+#endif
+			break;
+		default:
+			elog(ERROR, "parquet: compression codec (%d) of '%s' is not supported",
+				 codec, filename);
+	}
+}
+
+/*
+ * RLE / Bit-packing hybrid decoder
+ */
+typedef struct
+{
+	const char	   *filename;
+	const uint8	   *pos;
+	const uint8	   *end;
+	int				bit_width;
+	uint32			rle_count;
+	uint32			rle_value;
+	uint32			bp_count;
+	uint32			bp_index;
+	const uint8	   *bp_base;
+} parquetHybridDecoder;
+
+static inline void
+__parquetHybridInit(parquetHybridDecoder *dec, const char *filename,
+					const char *pos, const char *end, int bit_width)
+{
+	memset(dec, 0, sizeof(parquetHybridDecoder));
+	dec->filename = filename;
+	dec->pos = (const uint8 *)pos;
+	dec->end = (const uint8 *)end;
+	dec->bit_width = bit_width;
+}
+
+static uint32
+__parquetHybridNext(parquetHybridDecoder *dec)
+{
+	for (;;)
+	{
+		if (dec->rle_count > 0)
+		{
+			dec->rle_count--;
+			return dec->rle_value;
+		}
+		if (dec->bp_count > 0)
+		{
+			uint64	bitpos = (uint64)dec->bp_index * dec->bit_width;
+			uint32	value = 0;
+			int		i;
+
+			for (i=0; i < dec->bit_width; i++, bitpos++)
+			{
+				if (dec->bp_base[bitpos >> 3] & (1U << (bitpos & 7)))
+					value |= (1U << i);
+			}
+			dec->bp_index++;
+			dec->bp_count--;
+			return value;
+		}
+		else
+		{
+			thriftCursor c;
+			uint64		header;
+			size_t		nbytes;
+
+			c.filename = dec->filename;
+			c.pos = dec->pos;
+			c.end = dec->end;
+			header = __thriftReadVarint(&c);
+			dec->pos = c.pos;
+			if (header & 1)
+			{
+				/* bit-packed run of (header >> 1) groups of 8 values */
+				if ((header >> 1) > (uint64)(dec->end - dec->pos))
+					goto corrupted;
+				nbytes = (header >> 1) * dec->bit_width;
+				if (nbytes > dec->end - dec->pos)
+					goto corrupted;
+				dec->bp_base  = dec->pos;
+				dec->bp_index = 0;
+				dec->bp_count = (header >> 1) * 8;
+				dec->pos += nbytes;
+			}
+			else
+			{
+				/* RLE run */
+				int		i;
+
+				nbytes = (dec->bit_width + 7) / 8;
+				if (nbytes > dec->end - dec->pos)
+					goto corrupted;
+				dec->rle_count = Min(header >> 1, UINT_MAX);
+				dec->rle_value = 0;
+				for (i=0; i < nbytes; i++)
+					dec->rle_value |= ((uint32)dec->pos[i]) << (8 * i);
+				dec->pos += nbytes;
+			}
+		}
+	}
+corrupted:
+	elog(ERROR, "parquet: corrupted RLE/Bit-packed buffer in '%s'",
+		 dec->filename);
+}
+
+/*
+ * Column chunk decoder
+ */
+typedef struct
+{
+	const char *filename;
+	Oid			atttypid;
+	int			pq_type;
+	int			pq_type_length;
+	int			pq_codec;
+	int			max_deflevel;
+	int			dst_unitsz;		/* 0 = bitmap, -1 = varlena */
+	int64		nrows;
+	int64		row_index;
+	/* dictionary */
+	int64		dict_nitems;
+	const char *dict_values;	/* fixed-length values */
+	const char **dict_ptrs;		/* BYTE_ARRAY values */
+	uint32	   *dict_lens;
+	/* working buffer */
+	char	   *pbuf;
+	size_t		pbuf_sz;
+	uint8	   *deflevels;
+	size_t		deflevels_sz;
+	/* output buffer */
+	ParquetDecodeBuffer *result;
+	size_t		extra_size;
+} parquetDecodeState;
+
+static inline void
+__parquetStoreNull(parquetDecodeState *ds, int64 row)
+{
+	ParquetDecodeBuffer *result = ds->result;
+
+	if (ds->dst_unitsz < 0)
+	{
+		uint32	   *offsets = (uint32 *)result->values;
+
+		offsets[row+1] = offsets[row];
+	}
+	result->null_count++;
+}
+
+static void
+__parquetStoreValue(parquetDecodeState *ds, int64 row,
+					const char *addr, uint32 len)
+{
+	ParquetDecodeBuffer *result = ds->result;
+
+	if (result->nullmap)
+		result->nullmap[row >> 3] |= (1 << (row & 7));
+	switch (ds->atttypid)
+	{
+		case TEXTOID:
+		case BYTEAOID:
+			{
+				uint32	   *offsets = (uint32 *)result->values;
+
+				if (result->extra_len + len >= UINT_MAX)
+					elog(ERROR, "parquet: column chunk of '%s' is too large",
+						 ds->filename);
+				if (result->extra_len + len > ds->extra_size)
+				{
+					while (result->extra_len + len > ds->extra_size)
+						ds->extra_size += ds->extra_size;
+					result->extra = repalloc_huge(result->extra,
+												  ds->extra_size);
+				}
+				memcpy(result->extra + result->extra_len, addr, len);
+				result->extra_len += len;
+				offsets[row+1] = result->extra_len;
+			}
+			break;
+		case NUMERICOID:
+			{
+				int128		ival = 0;
+
+				if (ds->pq_type == ParquetType__INT32)
+					ival = *((int32 *)addr);
+				else if (ds->pq_type == ParquetType__INT64)
+					ival = *((int64 *)addr);
+				else
+				{
+					/* big-endian two's complement */
+					int		i;
+
+					if (len > 0 && (addr[0] & 0x80) != 0)
+						ival = -1;
+					for (i=0; i < len; i++)
+						ival = (ival << 8) | (uint8)addr[i];
+				}
+				((int128 *)result->values)[row] = ival;
+			}
+			break;
+		case INT2OID:
+			((int16 *)result->values)[row] = (int16)(*((int32 *)addr));
+			break;
+		default:
+			Assert(ds->dst_unitsz == len);
+			memcpy(result->values + ds->dst_unitsz * row, addr, len);
+			break;
+	}
+}
+
+static inline void
+__parquetStoreBool(parquetDecodeState *ds, int64 row, bool value)
+{
+	ParquetDecodeBuffer *result = ds->result;
+
+	if (result->nullmap)
+		result->nullmap[row >> 3] |= (1 << (row & 7));
+	if (value)
+		result->values[row >> 3] |= (1 << (row & 7));
+}
+
+static int
+__parquetSourceUnitSize(parquetDecodeState *ds)
+{
+	switch (ds->pq_type)
+	{
+		case ParquetType__INT32:
+		case ParquetType__FLOAT:
+			return sizeof(int32);
+		case ParquetType__INT64:
+		case ParquetType__DOUBLE:
+			return sizeof(int64);
+		case ParquetType__FIXED_LEN_BYTE_ARRAY:
+			return ds->pq_type_length;
+		default:
+			return -1;
+	}
+}
+
+/*
+ * __parquetSetupDictionary - dictionary page is always PLAIN encoded
+ */
+static void
+__parquetSetupDictionary(parquetDecodeState *ds, parquetPageHeader *phdr,
+						 const char *pos, const char *end)
+{
+	int64		i, nitems = phdr->num_values;
+
+	if (phdr->encoding != ParquetEncoding__PLAIN &&
+		phdr->encoding != ParquetEncoding__PLAIN_DICTIONARY)
+		elog(ERROR, "parquet: dictionary page of '%s' has unknown encoding (%d)",
+			 ds->filename, phdr->encoding);
+	if (ds->pq_type == ParquetType__BOOLEAN)
+		elog(ERROR, "parquet: dictionary page of boolean in '%s'",
+			 ds->filename);
+	if (ds->pq_type == ParquetType__BYTE_ARRAY)
+	{
+		ds->dict_ptrs = palloc(sizeof(char *) * Max(nitems, 1));
+		ds->dict_lens = palloc(sizeof(uint32) * Max(nitems, 1));
+		for (i=0; i < nitems; i++)
+		{
+			uint32		len;
+
+			if (end - pos < sizeof(uint32))
+				goto corrupted;
+			memcpy(&len, pos, sizeof(uint32));
+			pos += sizeof(uint32);
+			if (len > end - pos)
+				goto corrupted;
+			ds->dict_ptrs[i] = pos;
+			ds->dict_lens[i] = len;
+			pos += len;
+		}
+	}
+	else
+	{
+		int		unitsz = __parquetSourceUnitSize(ds);
+
+		if (unitsz < 0 || nitems * unitsz > end - pos)
+			goto corrupted;
+		ds->dict_values = pos;
+	}
+	ds->dict_nitems = nitems;
+	return;
+corrupted:
+	elog(ERROR, "parquet: corrupted dictionary page in '%s'", ds->filename);
+}
+
+/*
+ * __parquetDecodeValues - decode values of a data page
+ */
+static void
+__parquetDecodeValues(parquetDecodeState *ds, int encoding, int nvalues,
+					  const uint8 *deflevels, const char *pos, const char *end)
+{
+	int64		row = ds->row_index;
+	int			unitsz = __parquetSourceUnitSize(ds);
+	int			i;
+
+	if (encoding == ParquetEncoding__PLAIN)
+	{
+		uint64		bitpos = 0;
+
+		for (i=0; i < nvalues; i++, row++)
+		{
+			if (deflevels && deflevels[i] < ds->max_deflevel)
+			{
+				__parquetStoreNull(ds, row);
+			}
+			else if (ds->pq_type == ParquetType__BOOLEAN)
+			{
+				if ((bitpos >> 3) >= end - pos)
+					goto corrupted;
+				__parquetStoreBool(ds, row, ((pos[bitpos >> 3] >>
+											  (bitpos & 7)) & 1) != 0);
+				bitpos++;
+			}
+			else if (ds->pq_type == ParquetType__BYTE_ARRAY)
+			{
+				uint32		len;
+
+				if (end - pos < sizeof(uint32))
+					goto corrupted;
+				memcpy(&len, pos, sizeof(uint32));
+				pos += sizeof(uint32);
+				if (len > end - pos)
+					goto corrupted;
+				__parquetStoreValue(ds, row, pos, len);
+				pos += len;
+			}
+			else
+			{
+				if (unitsz > end - pos)
+					goto corrupted;
+				__parquetStoreValue(ds, row, pos, unitsz);
+				pos += unitsz;
+			}
+		}
+	}
+	else if (encoding == ParquetEncoding__RLE &&
+			 ds->pq_type == ParquetType__BOOLEAN)
+	{
+		parquetHybridDecoder dec;
+		uint32		len;
+
+		if (end - pos < sizeof(uint32))
+			goto corrupted;
+		memcpy(&len, pos, sizeof(uint32));
+		pos += sizeof(uint32);
+		if (len > end - pos)
+			goto corrupted;
+		__parquetHybridInit(&dec, ds->filename, pos, pos + len, 1);
+		for (i=0; i < nvalues; i++, row++)
+		{
+			if (deflevels && deflevels[i] < ds->max_deflevel)
+				__parquetStoreNull(ds, row);
+			else
+				__parquetStoreBool(ds, row, __parquetHybridNext(&dec) != 0);
+		}
+	}
+	else if (encoding == ParquetEncoding__PLAIN_DICTIONARY ||
+			 encoding == ParquetEncoding__RLE_DICTIONARY)
+	{
+		parquetHybridDecoder dec;
+		int			bit_width;
+
+		if (!ds->dict_ptrs && !ds->dict_values)
+			elog(ERROR, "parquet: dictionary page is missing in '%s'",
+				 ds->filename);
+		if (pos >= end)
+		{
+			/* all the values are NULL */
+			bit_width = 0;
+		}
+		else
+		{
+			bit_width = (uint8)*pos++;
+			if (bit_width > 32)
+				goto corrupted;
+		}
+		__parquetHybridInit(&dec, ds->filename, pos, end, bit_width);
+		for (i=0; i < nvalues; i++, row++)
+		{
+			uint32		index;
+
+			if (deflevels && deflevels[i] < ds->max_deflevel)
+			{
+				__parquetStoreNull(ds, row);
+				continue;
+			}
+			index = __parquetHybridNext(&dec);
+			if (index >= ds->dict_nitems)
+				goto corrupted;
+			if (ds->pq_type == ParquetType__BYTE_ARRAY)
+				__parquetStoreValue(ds, row,
+									ds->dict_ptrs[index],
+									ds->dict_lens[index]);
+			else
+				__parquetStoreValue(ds, row,
+									ds->dict_values + unitsz * index,
+									unitsz);
+		}
+	}
+	else
+	{
+		elog(ERROR, "parquet: encoding (%d) in '%s' is not supported",
+			 encoding, ds->filename);
+	}
+	ds->row_index = row;
+	return;
+corrupted:
+	elog(ERROR, "parquet: corrupted data page in '%s'", ds->filename);
+}
+
+/*
+ * __parquetDecodeDefLevels
+ */
+static void
+__parquetDecodeDefLevels(parquetDecodeState *ds, int nvalues,
+						 const char *pos, const char *end)
+{
+	parquetHybridDecoder dec;
+	int			bit_width = 0;
+	int			i;
+
+	while ((1 << bit_width) <= ds->max_deflevel)
+		bit_width++;
+	if (ds->deflevels_sz < nvalues)
+	{
+		if (ds->deflevels)
+			pfree(ds->deflevels);
+		ds->deflevels_sz = Max(nvalues, 1024);
+		ds->deflevels = palloc(ds->deflevels_sz);
+	}
+	__parquetHybridInit(&dec, ds->filename, pos, end, bit_width);
+	for (i=0; i < nvalues; i++)
+		ds->deflevels[i] = __parquetHybridNext(&dec);
+}
+
+/*
+ * __parquetPageBuffer - decompress the page body, if needed
+ */
+static const char *
+__parquetPageBuffer(parquetDecodeState *ds, bool is_compressed,
+					size_t dest_len, const char *src, size_t src_len)
+{
+	if (!is_compressed || ds->pq_codec == ParquetCodec__UNCOMPRESSED)
+	{
+		if (src_len != dest_len)
+			elog(ERROR, "parquet: uncompressed page of '%s' has unexpected length (%zu of %zu)",
+				 ds->filename, src_len, dest_len);
+		return src;
+	}
+	if (!ds->pbuf || ds->pbuf_sz < dest_len)
+	{
+		if (ds->pbuf)
+			pfree(ds->pbuf);
+		ds->pbuf_sz = Max(dest_len, BLCKSZ);
+		ds->pbuf = MemoryContextAllocHuge(CurrentMemoryContext, ds->pbuf_sz);
+	}
+	__parquetDecompress(ds->pq_codec, ds->filename,
+						ds->pbuf, dest_len, src, src_len);
+	return ds->pbuf;
+}
+
+/*
+ * parquetDecodeColumnChunk
+ *
+ * It decodes a column chunk (dictionary page, if any, and data pages) into
+ * the buffers in the layout of KDS_FORMAT_ARROW. Only flat columns (max
+ * repetition level is zero) are supported.
+ */
+void
+parquetDecodeColumnChunk(const char *filename,
+						 const char *chunk, size_t chunk_sz,
+						 Oid atttypid,
+						 int pq_type, int pq_type_length,
+						 int pq_codec, int pq_max_deflevel,
+						 int64 nrows,
+						 ParquetDecodeBuffer *result)
+{
+	parquetDecodeState ds;
+	const char *pos = chunk;
+	const char *end = chunk + chunk_sz;
+	size_t		nullmap_len = (nrows + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
+
+	memset(&ds, 0, sizeof(parquetDecodeState));
+	ds.filename       = filename;
+	ds.atttypid       = atttypid;
+	ds.pq_type        = pq_type;
+	ds.pq_type_length = pq_type_length;
+	ds.pq_codec       = pq_codec;
+	ds.max_deflevel   = pq_max_deflevel;
+	ds.nrows          = nrows;
+	ds.result         = result;
+
+	memset(result, 0, sizeof(ParquetDecodeBuffer));
+	if (pq_max_deflevel > 0)
+	{
+		result->nullmap_len = nullmap_len;
+		result->nullmap = MemoryContextAllocExtended(CurrentMemoryContext,
+													 Max(nullmap_len, 1),
+													 MCXT_ALLOC_HUGE |
+													 MCXT_ALLOC_ZERO);
+	}
+	switch (atttypid)
+	{
+		case BOOLOID:
+			ds.dst_unitsz = 0;
+			result->values_len = nullmap_len;
+			break;
+		case TEXTOID:
+		case BYTEAOID:
+			ds.dst_unitsz = -1;
+			result->values_len = sizeof(uint32) * (nrows + 1);
+			ds.extra_size = Max(chunk_sz, BLCKSZ);
+			result->extra = MemoryContextAllocHuge(CurrentMemoryContext,
+												   ds.extra_size);
+			break;
+		case NUMERICOID:
+			ds.dst_unitsz = sizeof(int128);
+			result->values_len = sizeof(int128) * nrows;
+			break;
+		case INT2OID:
+			ds.dst_unitsz = sizeof(int16);
+			result->values_len = sizeof(int16) * nrows;
+			break;
+		default:
+			ds.dst_unitsz = __parquetSourceUnitSize(&ds);
+			if (ds.dst_unitsz <= 0)
+				elog(ERROR, "parquet: unexpected type mapping %s of '%s'",
+					 format_type_be(atttypid), filename);
+			result->values_len = ds.dst_unitsz * nrows;
+			break;
+	}
+	result->values = MemoryContextAllocExtended(CurrentMemoryContext,
+												Max(result->values_len, 1),
+												MCXT_ALLOC_HUGE |
+												MCXT_ALLOC_ZERO);
+
+	while (pos < end && ds.row_index < nrows)
+	{
+		parquetPageHeader phdr;
+		thriftCursor c;
+		const char *body;
+		const char *buf;
+		const char *buf_end;
+
+		c.filename = filename;
+		c.pos = (const uint8 *)pos;
+		c.end = (const uint8 *)end;
+		__readParquetPageHeader(&c, &phdr);
+		body = (const char *)c.pos;
+		if (phdr.compressed_page_size > end - body)
+			elog(ERROR, "parquet: page of '%s' is out of the column chunk",
+				 filename);
+		pos = body + phdr.compressed_page_size;
+		if (phdr.type == ParquetPageType__DATA_PAGE ||
+			phdr.type == ParquetPageType__DATA_PAGE_V2)
+		{
+			if (phdr.num_values > nrows - ds.row_index)
+				elog(ERROR, "parquet: column chunk of '%s' has more values than the RowGroup",
+					 filename);
+		}
+
+		switch (phdr.type)
+		{
+			case ParquetPageType__DICTIONARY_PAGE:
+				if (pq_codec == ParquetCodec__UNCOMPRESSED)
+					buf = body;
+				else
+				{
+					/* dictionary must be kept during the decoding */
+					char   *dbuf = MemoryContextAllocHuge(CurrentMemoryContext,
+														  Max(phdr.uncompressed_page_size, 1));
+					__parquetDecompress(pq_codec, filename,
+										dbuf, phdr.uncompressed_page_size,
+										body, phdr.compressed_page_size);
+					buf = dbuf;
+				}
+				__parquetSetupDictionary(&ds, &phdr, buf,
+										 buf + phdr.uncompressed_page_size);
+				break;
+
+			case ParquetPageType__DATA_PAGE:
+				buf = __parquetPageBuffer(&ds, true,
+										  phdr.uncompressed_page_size,
+										  body, phdr.compressed_page_size);
+				buf_end = buf + phdr.uncompressed_page_size;
+				if (ds.max_deflevel > 0)
+				{
+					uint32	len;
+
+					if (phdr.def_level_encoding != ParquetEncoding__RLE)
+						elog(ERROR, "parquet: definition level encoding (%d) in '%s' is not supported",
+							 phdr.def_level_encoding, filename);
+					if (buf_end - buf < sizeof(uint32))
+						elog(ERROR, "parquet: corrupted data page in '%s'",
+							 filename);
+					memcpy(&len, buf, sizeof(uint32));
+					buf += sizeof(uint32);
+					if (len > buf_end - buf)
+						elog(ERROR, "parquet: corrupted data page in '%s'",
+							 filename);
+					__parquetDecodeDefLevels(&ds, phdr.num_values,
+											 buf, buf + len);
+					buf += len;
+				}
+				__parquetDecodeValues(&ds, phdr.encoding, phdr.num_values,
+									  ds.max_deflevel > 0 ? ds.deflevels : NULL,
+									  buf, buf_end);
+				break;
+
+			case ParquetPageType__DATA_PAGE_V2:
+				{
+					int		levels_sz = (phdr.rep_levels_byte_length +
+										 phdr.def_levels_byte_length);
+
+					if (phdr.rep_levels_byte_length < 0 ||
+						phdr.def_levels_byte_length < 0 ||
+						levels_sz > phdr.compressed_page_size ||
+						levels_sz > phdr.uncompressed_page_size)
+						elog(ERROR, "parquet: corrupted data page in '%s'",
+							 filename);
+					if (phdr.rep_levels_byte_length > 0)
+						elog(ERROR, "parquet: repeated column in '%s' is not supported",
+							 filename);
+					/* levels are never compressed in DATA_PAGE_V2 */
+					if (ds.max_deflevel > 0)
+						__parquetDecodeDefLevels(&ds, phdr.num_values, body,
+												 body + levels_sz);
+					buf = __parquetPageBuffer(&ds, phdr.is_compressed,
+											  phdr.uncompressed_page_size - levels_sz,
+											  body + levels_sz,
+											  phdr.compressed_page_size - levels_sz);
+					__parquetDecodeValues(&ds, phdr.encoding, phdr.num_values,
+										  ds.max_deflevel > 0 ? ds.deflevels : NULL,
+										  buf, buf + (phdr.uncompressed_page_size -
+													  levels_sz));
+				}
+				break;
+
+			default:
+				/* INDEX_PAGE or unknown; skip it */
+				break;
+		}
+	}
+	if (ds.row_index != nrows)
+		elog(ERROR, "parquet: column chunk of '%s' has %ld rows, but %ld rows are expected",
+			 filename, ds.row_index, nrows);
+	if (result->nullmap && result->null_count == 0)
+	{
+		pfree(result->nullmap);
+		result->nullmap = NULL;
+		result->nullmap_len = 0;
+	}
+	if (ds.pbuf)
+		pfree(ds.pbuf);
+	if (ds.deflevels)
+		pfree(ds.deflevels);
+}
@@ -101,6 +101,17 @@
 	extract_actual_join_clauses((a),(c),(d))
 #endif
 
+/*
+ * MEMO: PG11 renamed FRAMEOPTION_*_VALUE_* to FRAMEOPTION_*_OFFSET_*, and
+ * added GROUPS and EXCLUDE clauses of the window frame.
+ */
+#if PG_VERSION_NUM < 110000
+#define FRAMEOPTION_START_OFFSET_PRECEDING	FRAMEOPTION_START_VALUE_PRECEDING
+#define FRAMEOPTION_END_OFFSET_PRECEDING	FRAMEOPTION_END_VALUE_PRECEDING
+#define FRAMEOPTION_START_OFFSET_FOLLOWING	FRAMEOPTION_START_VALUE_FOLLOWING
+#define FRAMEOPTION_END_OFFSET_FOLLOWING	FRAMEOPTION_END_VALUE_FOLLOWING
+#endif
+
 /*
  * MEMO: PG11 adds PathNameOpenFilePerm and removed creation permission
  * flags from the PathNameOpenFile.
@@ -246,7 +257,10 @@ static inline HeapTuple
 ExecFetchSlotHeapTuple(TupleTableSlot *slot,
 					   bool materialize, bool *shouldFree)
 {
-	Assert(!materialize && !shouldFree);
+	Assert(!materialize);
+	/* the tuple is always owned by the slot in the older version */
+	if (shouldFree)
+		*shouldFree = false;
 	return ExecFetchSlotTuple(slot);
 }
 #endif	/* < PG12 */
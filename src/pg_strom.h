@@ -21,21 +21,30 @@
 #define PG_MINOR_VERSION		(PG_VERSION_NUM % 100)
 
 #include "access/brin.h"
+#include "access/brin_pageops.h"
 #include "access/brin_revmap.h"
 #include "access/gist.h"
 #include "access/hash.h"
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/nbtree.h"
 #include "access/reloptions.h"
 #include "access/relscan.h"
+#include "access/stratnum.h"
 #include "access/sysattr.h"
+#if PG_VERSION_NUM >= 120000
+#include "access/tableam.h"
+#endif
 #include "access/tuptoaster.h"
 #include "access/twophase.h"
 #include "access/visibilitymap.h"
 #include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xloginsert.h"
 #include "catalog/catalog.h"
 #include "catalog/dependency.h"
 #include "catalog/heap.h"
+#include "catalog/index.h"
 #include "catalog/indexing.h"
 #include "catalog/namespace.h"
 #include "catalog/objectaccess.h"
@@ -52,6 +61,7 @@
 #include "catalog/pg_foreign_table.h"
 #include "catalog/pg_language.h"
 #include "catalog/pg_namespace.h"
+#include "catalog/pg_opclass.h"
 #include "catalog/pg_proc.h"
 #include "catalog/pg_statistic.h"
 #include "catalog/pg_tablespace.h"
@@ -68,9 +78,11 @@
 #include "commands/event_trigger.h"
 #include "commands/explain.h"
 #include "commands/proclang.h"
+#include "commands/tablecmds.h"
 #include "commands/tablespace.h"
 #include "commands/trigger.h"
 #include "commands/typecmds.h"
+#include "commands/vacuum.h"
 #include "commands/variable.h"
 #include "common/base64.h"
 #include "common/md5.h"
@@ -79,15 +91,18 @@
 #include "executor/nodeIndexscan.h"
 #include "executor/nodeCustom.h"
 #include "executor/nodeSubplan.h"
+#include "executor/spi.h"
 #include "fmgr.h"
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
 #include "funcapi.h"
+#include "lib/binaryheap.h"
 #include "lib/ilist.h"
 #include "lib/stringinfo.h"
 #include "libpq/be-fsstubs.h"
 #include "libpq/libpq-fs.h"
 #include "libpq/pqsignal.h"
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "nodes/execnodes.h"
 #include "nodes/extensible.h"
@@ -132,7 +147,9 @@
 #include "postmaster/bgworker.h"
 #include "postmaster/postmaster.h"
 #include "storage/buf.h"
+#include "storage/buffile.h"
 #include "storage/buf_internals.h"
+#include "storage/condition_variable.h"
 #include "storage/ipc.h"
 #include "storage/itemptr.h"
 #include "storage/fd.h"
@@ -147,6 +164,7 @@
 #include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "storage/spin.h"
+#include "tcop/tcopprot.h"
 #include "utils/array.h"
 #include "utils/arrayaccess.h"
 #include "utils/builtins.h"
@@ -154,6 +172,7 @@
 #include "utils/cash.h"
 #include "utils/catcache.h"
 #include "utils/date.h"
+#include "utils/datum.h"
 #if PG_VERSION_NUM >= 120000
 #include "utils/float.h"
 #endif
@@ -176,6 +195,7 @@
 #include "utils/ruleutils.h"
 #include "utils/selfuncs.h"
 #include "utils/snapmgr.h"
+#include "utils/sortsupport.h"
 #include "utils/spccache.h"
 #include "utils/syscache.h"
 #if PG_VERSION_NUM < 120000
@@ -192,16 +212,24 @@
 #ifdef WITH_CUFILE
 #include <cufile.h>
 #endif
+#ifdef WITH_NVTX
+#include <nvtx3/nvToolsExt.h>
+#endif
 #include <assert.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <float.h>
 #include <libgen.h>
 #include <limits.h>
+#include <linux/magic.h>
+#include <linux/mempolicy.h>
 #include <math.h>
+#include <sched.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/sysmacros.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -248,6 +276,7 @@ typedef struct GpuContext
 	cl_int			cuda_dindex;
 	CUdevice		cuda_device;
 	CUcontext		cuda_context;
+	pg_atomic_uint32 nr_running_tasks;	/* # of tasks in GPU kernel */
 	/* resource management */
 	slock_t			restrack_lock;
 	dlist_head		restrack[RESTRACK_HASHSIZE];
@@ -257,6 +286,8 @@ typedef struct GpuContext
 	dlist_head		gm_iomap_list;		/* list of I/O map memory segments */
 	dlist_head		gm_managed_list;	/* list of managed memory segments */
 	dlist_head		gm_hostmem_list;	/* list of Host memory segments */
+	CUmemoryPool	gm_mempool;			/* stream-ordered pool, if any */
+	size_t			gm_budget_sz;		/* admitted budget of device memory */
 	/* error information buffer */
 	pg_atomic_uint32 error_level;
 	int				error_code;
@@ -276,7 +307,11 @@ typedef struct GpuContext
 	pg_atomic_uint32 terminate_workers;
 	dlist_head		pending_tasks;		/* list of GpuTask */
 	cl_int			num_workers;
+	cl_int			stream_priority;	/* pg_strom.gpu_stream_priority */
 	pg_atomic_uint32 worker_index;
+	/* completion queue of the SSD-to-GPU DMA tasks (nvme_strom) */
+	struct gpuDirectDmaQueue *gpudirect_dma_queue;
+	bool			gpudirect_dma_disabled;
 	pthread_t		worker_threads[FLEXIBLE_ARRAY_MEMBER];
 } GpuContext;
 
@@ -292,6 +327,7 @@ typedef enum {
 	GpuTaskKind_GpuJoin,
 	GpuTaskKind_GpuPreAgg,
 	GpuTaskKind_GpuSort,
+	GpuTaskKind_GpuWinAgg,
 	GpuTaskKind_PL_CUDA,
 } GpuTaskKind;
 
@@ -307,8 +343,26 @@ typedef struct GpuStoreFdwState		GpuStoreFdwState;
  * A common structure of the state machine of GPU related tasks.
  */
 struct NVMEScanState;
+struct ccacheScanState;
+struct resultCacheState;
 struct GpuTaskSharedState;
 
+/*
+ * GpuTaskTraceEvent - lifecycle of a GpuTask; written to the trace file
+ * at end of the scan, if pg_strom.gpu_trace_dir is configured.
+ */
+typedef struct
+{
+	instr_time		tv_load;		/* start of the chunk load */
+	instr_time		tv_enqueue;		/* enqueued to the pending list */
+	instr_time		tv_start;		/* picked up by a worker thread */
+	instr_time		tv_jit;			/* GPU program got ready */
+	instr_time		tv_end;			/* completion of the task */
+	cl_int			worker_index;	/* index of the worker thread */
+	cl_bool			jit_fallback;	/* CPU fallback during JIT build */
+} GpuTaskTraceEvent;
+#define GPUTASK_TRACE_MAX_EVENTS	4096
+
 struct GpuTaskState
 {
 	CustomScanState	css;
@@ -334,6 +388,7 @@ struct GpuTaskState
 
 	IndexScanDesc	outer_brin_index;	/* brin index of outer scan, if any */
 	long			outer_brin_count;	/* # of blocks skipped by index */
+	BlockNumber		outer_brin_prefetch; /* next block to be prefetched */
 
 	ArrowFdwState  *af_state;			/* for GpuTask on Arrow_Fdw */
 	GpuStoreFdwState *gs_state;			/* for GpuTask on Gstore_Fdw */
@@ -344,6 +399,20 @@ struct GpuTaskState
 	 */
 	struct NVMEScanState *nvme_sstate;
 	long			nvme_count;			/* # of blocks loaded by SSD2GPU */
+	size_t			gm_budget_sz;		/* admitted device memory budget */
+
+	/*
+	 * A state object for columnar cache. If not NULL, chunks already built
+	 * are loaded from the cache instead of the heap blocks.
+	 */
+	struct ccacheScanState *ccache_sstate;
+	long			ccache_count;		/* # of chunks loaded from ccache */
+
+	/*
+	 * A state object for result cache. If not NULL, results of the scan
+	 * are served from / saved to the shared result cache.
+	 */
+	struct resultCacheState *rcache_state;
 
 	/*
 	 * fields to fetch rows from the current task
@@ -369,14 +438,45 @@ struct GpuTaskState
 	TupleTableSlot *(*cb_next_tuple)(GpuTaskState *gts);
 	int			  (*cb_process_task)(GpuTask *gtask,
 									 CUmodule cuda_module);
+	bool		  (*cb_fallback_task)(GpuTask *gtask);	/* optional */
 	void		  (*cb_release_task)(GpuTask *gtask);
 	/* list of GpuTasks (protexted with GpuContext->mutex) */
 	dlist_head		ready_tasks;	/* list of tasks already processed */
 	cl_uint			num_running_tasks;	/* # of running tasks */
 	cl_uint			num_ready_tasks;	/* # of ready tasks */
+	dlist_head		parked_tasks;	/* tasks detached from pending queue */
+	bool			cancel_tasks;	/* no more retry of the running tasks */
 
 	/* misc fields */
 	cl_long			num_cpu_fallbacks;	/* # of CPU fallback chunks */
+	/*
+	 * adaptive chunk size (see gputask_update_chunk_size); the counters
+	 * are updated by worker under mutex, and @chunk_stat_* are snapshot
+	 * of them at the last adjustment.
+	 */
+	Size			chunk_size;			/* current chunk size of the scan */
+	uint64			num_gpu_exec;		/* # of tasks executed on GPU */
+	uint64			num_result_overflow; /* # of result buffer overflow */
+	uint64			chunk_stat_nexec;
+	uint64			chunk_stat_noverflow;
+	uint64			chunk_stat_time;
+	/* per-stage elapsed time in usec (updated by worker under mutex) */
+	uint64			time_chunk_load;	/* cb_next_task by the backend */
+	uint64			time_queue_wait;	/* wait for GPU worker thread */
+	uint64			time_jit_wait;		/* wait for CUDA program build */
+	uint64			time_gpu_exec;		/* DMA send, kernel exec and sync */
+	uint64			time_cpu_fallback;	/* CPU fallback by the backend */
+	uint64			time_jit_fallback;	/* CPU fallback during JIT build */
+	/* sampled statistics for pgstrom.gpu_query_stats */
+	bool			stats_sampled;		/* true, if to be recorded at end */
+	uint64			num_loaded_chunks;	/* # of chunks loaded by backend */
+	uint64			bytes_loaded;		/* DMA bytes (updated by worker) */
+	/* profiler support (protected by GpuContext->worker_mutex) */
+	char			trace_label[NAMEDATALEN];	/* e.g, GpuJoin#3 */
+	cl_uint			trace_category;	/* NVTX category of this node */
+	GpuTaskTraceEvent *trace_events; /* NULL, if no trace file */
+	cl_uint			trace_nitems;
+	cl_uint			trace_ndropped;
 	uint64			debug_counter0;
 	uint64			debug_counter1;
 	uint64			debug_counter2;
@@ -401,6 +501,9 @@ struct GpuTaskSharedState
 	slock_t			pbs_mutex;		/* lock of the fields below */
 	BlockNumber		pbs_startblock;	/* starting block number */
 	BlockNumber		pbs_nallocated;	/* # of blocks allocated to workers */
+	/* for balancing of the tail of scan */
+	pg_atomic_uint32 nr_participants; /* # of processes joined to the scan */
+	pg_atomic_uint32 nr_loaded_chunks; /* # of chunks loaded by them */
 
 	/* common parallel table scan descriptor */
 	ParallelTableScanDescData phscan;
@@ -416,8 +519,15 @@ typedef struct
 	pg_atomic_uint64	source_nitems;
 	pg_atomic_uint64	nitems_filtered;
 	pg_atomic_uint64	nvme_count;
+	pg_atomic_uint64	ccache_count;
 	pg_atomic_uint64	brin_count;
 	pg_atomic_uint64	fallback_count;
+	/* per-stage elapsed time in usec */
+	pg_atomic_uint64	time_chunk_load;
+	pg_atomic_uint64	time_queue_wait;
+	pg_atomic_uint64	time_jit_wait;
+	pg_atomic_uint64	time_gpu_exec;
+	pg_atomic_uint64	time_cpu_fallback;
 	/* debug counter */
 	pg_atomic_uint64	debug_counter0;
 	pg_atomic_uint64	debug_counter1;
@@ -425,6 +535,9 @@ typedef struct
 	pg_atomic_uint64	debug_counter3;
 } GpuTaskRuntimeStat;
 
+/* see gpu_tasks.c */
+extern void pgstromRecordGpuQuerySample(GpuTaskState *gts);
+
 static inline void
 mergeGpuTaskRuntimeStatParallelWorker(GpuTaskState *gts,
 									  GpuTaskRuntimeStat *gt_rtstat)
@@ -437,9 +550,22 @@ mergeGpuTaskRuntimeStatParallelWorker(GpuTaskState *gts,
 				 &gts->outer_instrument);
 	SpinLockRelease(&gt_rtstat->lock);
 	pg_atomic_add_fetch_u64(&gt_rtstat->nvme_count, gts->nvme_count);
+	pg_atomic_add_fetch_u64(&gt_rtstat->ccache_count, gts->ccache_count);
 	pg_atomic_add_fetch_u64(&gt_rtstat->brin_count, gts->outer_brin_count);
 	pg_atomic_add_fetch_u64(&gt_rtstat->fallback_count,
 							gts->num_cpu_fallbacks);
+	/* per-stage elapsed time */
+	pg_atomic_add_fetch_u64(&gt_rtstat->time_chunk_load,
+							gts->time_chunk_load);
+	pg_atomic_add_fetch_u64(&gt_rtstat->time_queue_wait,
+							gts->time_queue_wait);
+	pg_atomic_add_fetch_u64(&gt_rtstat->time_jit_wait,
+							gts->time_jit_wait);
+	pg_atomic_add_fetch_u64(&gt_rtstat->time_gpu_exec,
+							gts->time_gpu_exec);
+	pg_atomic_add_fetch_u64(&gt_rtstat->time_cpu_fallback,
+							gts->time_cpu_fallback +
+							gts->time_jit_fallback);
 	/* debug counter */
 	if (gts->debug_counter0 != 0)
 		pg_atomic_add_fetch_u64(&gt_rtstat->debug_counter0, gts->debug_counter0);
@@ -455,6 +581,9 @@ static inline void
 mergeGpuTaskRuntimeStat(GpuTaskState *gts,
 						GpuTaskRuntimeStat *gt_rtstat)
 {
+	/* sample the own statistics prior to the merge */
+	pgstromRecordGpuQuerySample(gts);
+
 	InstrAggNode(&gts->outer_instrument,
 				 &gt_rtstat->outer_instrument);
 	gts->outer_instrument.tuplecount = (double)
@@ -462,8 +591,14 @@ mergeGpuTaskRuntimeStat(GpuTaskState *gts,
 	gts->outer_instrument.nfiltered1 = (double)
 		pg_atomic_read_u64(&gt_rtstat->nitems_filtered);
 	gts->nvme_count += pg_atomic_read_u64(&gt_rtstat->nvme_count);
+	gts->ccache_count += pg_atomic_read_u64(&gt_rtstat->ccache_count);
 	gts->outer_brin_count += pg_atomic_read_u64(&gt_rtstat->brin_count);
 	gts->num_cpu_fallbacks += pg_atomic_read_u64(&gt_rtstat->fallback_count);
+	gts->time_chunk_load += pg_atomic_read_u64(&gt_rtstat->time_chunk_load);
+	gts->time_queue_wait += pg_atomic_read_u64(&gt_rtstat->time_queue_wait);
+	gts->time_jit_wait += pg_atomic_read_u64(&gt_rtstat->time_jit_wait);
+	gts->time_gpu_exec += pg_atomic_read_u64(&gt_rtstat->time_gpu_exec);
+	gts->time_cpu_fallback += pg_atomic_read_u64(&gt_rtstat->time_cpu_fallback);
 
 	gts->debug_counter0 += pg_atomic_read_u64(&gt_rtstat->debug_counter0);
 	gts->debug_counter1 += pg_atomic_read_u64(&gt_rtstat->debug_counter1);
@@ -490,8 +625,34 @@ struct GpuTask
 	ProgramId		program_id;		/* same with GTS's one */
 	GpuTaskState   *gts;			/* GTS reference in the backend */
 	bool			cpu_fallback;	/* true, if task needs CPU fallback */
+	instr_time		tv_load;		/* time when chunk load started */
+	instr_time		tv_enqueue;		/* time when task was enqueued */
 };
 
+/*
+ * NVTX ranges for the profilers like Nsight Systems; ranges are grouped
+ * by the category per plan node. No-op unless built with NVTX.
+ */
+#ifdef WITH_NVTX
+static inline void
+pgstromNvtxRangePush(GpuTaskState *gts, const char *stage)
+{
+	nvtxEventAttributes_t	attr;
+
+	memset(&attr, 0, sizeof(nvtxEventAttributes_t));
+	attr.version = NVTX_VERSION;
+	attr.size = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
+	attr.category = gts->trace_category;
+	attr.messageType = NVTX_MESSAGE_TYPE_ASCII;
+	attr.message.ascii = stage;
+	nvtxRangePushEx(&attr);
+}
+#define pgstromNvtxRangePop()		nvtxRangePop()
+#else
+#define pgstromNvtxRangePush(gts,stage)		((void)0)
+#define pgstromNvtxRangePop()				((void)0)
+#endif
+
 /*
  * Type declarations for code generator
  */
@@ -499,6 +660,7 @@ struct GpuTask
 #define DEVKERNEL_NEEDS_GPUJOIN			0x00000002	/* GpuJoin */
 #define DEVKERNEL_NEEDS_GPUPREAGG		0x00000004	/* GpuPreAgg */
 #define DEVKERNEL_NEEDS_GPUSORT			0x00000008	/* GpuSort */
+#define DEVKERNEL_NEEDS_GPUWINAGG		0x00000010	/* GpuWindowAgg */
 
 #define DEVKERNEL_NEEDS_PRIMITIVE		0x00000100
 #define DEVKERNEL_NEEDS_TIMELIB			0x00000200
@@ -599,11 +761,23 @@ typedef struct devcast_info {
 typedef struct GPUDirectFileDesc
 {
 	int				rawfd;
+	cl_uint			stripe_sz;		/* chunk size of md-raid0, if striped */
+	cl_uint			stripe_width;	/* number of md-raid0 members */
 #ifdef WITH_CUFILE
 	CUfileHandle_t	fhandle;
 #endif
 } GPUDirectFileDesc;
 
+/*
+ * hostFileReadChunk - a unit of file read onto host memory
+ */
+typedef struct hostFileReadChunk
+{
+	char		   *dest;
+	off_t			fpos;
+	size_t			len;
+} hostFileReadChunk;
+
 typedef struct NVMEScanState
 {
 	cl_uint			nrows_per_block;
@@ -626,6 +800,9 @@ typedef struct pgstrom_data_store
 	/* reference counter */
 	pg_atomic_uint32	refcnt;
 
+	/* GpuMemArena if PDS is sub-allocated on the task arena, or NULL */
+	struct GpuMemArena *arena;
+
 	/*
 	 * NOTE: Extra information for KDS_FORMAT_BLOCK.
 	 * @nblocks_uncached is number of PostgreSQL blocks, to be processed
@@ -639,6 +816,8 @@ typedef struct pgstrom_data_store
 	 * If NULL, KDS is preliminary loaded by CPU and filesystem, and
 	 * PDS is also allocated on managed memory area. So, worker don't
 	 * need to kick DMA operations explicitly.
+	 * @mmap_chunk is valid if the column buffers are mapped on the file
+	 * directly by CPU-only scan, instead of the copy.
 	 *
 	 * NOTE: Extra information for KDS_FORMAT_COLUMN
 	 * @gs_sstate points the GpuStoreShareState for reference IPC handle
@@ -648,6 +827,7 @@ typedef struct pgstrom_data_store
 	cl_uint				nblocks_uncached;	/* for KDS_FORMAT_BLOCK */
 	GPUDirectFileDesc	filedesc;
 	strom_io_vector	   *iovec;				/* for KDS_FORMAT_ARROW */
+	struct arrowMmapChunk *mmap_chunk;		/* for KDS_FORMAT_ARROW */
 	/* for KDS_FORMAT_COLUMN */
 	void			   *gs_sstate;
 	CUdeviceptr			m_kds_base;
@@ -676,6 +856,7 @@ typedef struct DevAttributes
 	char		DEV_UUID[48];
 	size_t		DEV_TOTAL_MEMSZ;
 	size_t		DEV_BAR1_MEMSZ;
+	double		DEV_PCIE_BANDWIDTH;	/* GT/s x lanes, or 0.0 if unknown */
 	bool		DEV_SUPPORT_GPUDIRECT;
 #define DEV_ATTR(LABEL,a,b,c)		\
 	cl_int		LABEL;
@@ -683,11 +864,21 @@ typedef struct DevAttributes
 #undef DEV_ATTR
 } DevAttributes;
 
+/* bitmap of GPU devices */
+#define GPU_DEVICE_MASK_BITS	((int)(8 * sizeof(cl_ulong)))
+
 extern DevAttributes   *devAttrs;
 extern cl_int			numDevAttrs;
 extern cl_uint			devBaselineMaxThreadsPerBlock;
 
 extern void pgstrom_init_gpu_device(void);
+extern Cost		pgstromGpuSetupCost(int cuda_dindex);
+extern Cost		pgstromGpuDmaCost(int cuda_dindex);
+extern Cost		pgstromGpuOperatorCost(int cuda_dindex);
+extern size_t	pgstromGpuDeviceMemorySize(int cuda_dindex);
+extern void		gpuDeviceBindLocalNumaNode(int cuda_dindex);
+extern bool		gpuDeviceSetNumaMemPolicy(int cuda_dindex);
+extern void		gpuDeviceResetNumaMemPolicy(void);
 
 #define GPUKERNEL_MAX_SM_MULTIPLICITY		4
 
@@ -718,6 +909,23 @@ extern MemoryContext	TopSharedMemoryContext;
 /*
  * gpu_mmgr.c
  */
+
+/*
+ * GpuMemArena - a task scoped managed memory region; it is allocated and
+ * tracked once, then the task object and its buffers are sub-allocated by
+ * bump-pointer. The arena is released when the last sub-allocation is
+ * released.
+ */
+typedef struct GpuMemArena
+{
+	GpuContext	   *gcontext;
+	pg_atomic_uint32 refcnt;	/* # of living sub-allocations */
+	size_t			length;		/* length of the data[] */
+	size_t			usage;		/* current usage of the data[] */
+	char			data[FLEXIBLE_ARRAY_MEMBER]
+					__attribute__ ((aligned (STROMALIGN_LEN)));
+} GpuMemArena;
+
 extern CUresult __gpuMemAllocRaw(GpuContext *gcontext,
 								 CUdeviceptr *p_devptr,
 								 size_t bytesize,
@@ -771,6 +979,12 @@ extern CUresult gpuMemFreePreserved(cl_int cuda_dindex,
 									CUipcMemHandle m_handle);
 extern CUresult gpuIpcCloseMemHandle(GpuContext *gcontext,
 									 CUdeviceptr m_deviceptr);
+extern CUresult __gpuMemArenaCreate(GpuContext *gcontext,
+									GpuMemArena **p_arena,
+									size_t bytesize,
+									const char *filename, int lineno);
+extern void	   *gpuMemArenaAlloc(GpuMemArena *arena, size_t bytesize);
+extern CUresult gpuMemArenaFree(GpuMemArena *arena);
 
 #define gpuMemAllocRaw(a,b,c)				\
 	__gpuMemAllocRaw((a),(b),(c),__FILE__,__LINE__)
@@ -792,8 +1006,16 @@ extern CUresult gpuIpcCloseMemHandle(GpuContext *gcontext,
 	__gpuMemAllocPreserved((a),(b),(c),__FILE__,__LINE__)
 #define gpuIpcOpenMemHandle(a,b,c,d)		\
 	__gpuIpcOpenMemHandle((a),(b),(c),(d),__FILE__,__LINE__)
+#define gpuMemArenaCreate(a,b,c)			\
+	__gpuMemArenaCreate((a),(b),(c),__FILE__,__LINE__)
 
 extern void gpuMemReclaimSegment(GpuContext *gcontext);
+extern bool	pgstrom_gpu_memory_oversubscription;
+extern CUresult gpuMemPrefetchManaged(GpuContext *gcontext,
+									  CUdeviceptr m_addr, size_t length,
+									  bool read_mostly);
+extern size_t gpuMemReserveBudget(GpuContext *gcontext, size_t footprint);
+extern void gpuMemReleaseBudget(GpuContext *gcontext, size_t budget_sz);
 
 extern void gpuMemCopyFromSSD(CUdeviceptr m_kds, pgstrom_data_store *pds);
 
@@ -805,6 +1027,8 @@ extern void pgstrom_init_gpu_mmgr(void);
  * gpu_context.c
  */
 extern int		pgstrom_max_async_tasks;		/* GUC */
+extern int		pgstrom_scan_readahead_chunks;	/* GUC */
+extern int		pgstrom_gpu_stream_priority;	/* GUC */
 extern __thread GpuContext	   *GpuWorkerCurrentContext;
 extern __thread sigjmp_buf	   *GpuWorkerExceptionStack;
 extern __thread int				GpuWorkerIndex;
@@ -816,6 +1040,20 @@ extern __thread int				GpuWorkerIndex;
 	(GpuWorkerCurrentContext->cuda_dindex)
 
 extern __thread CUevent			CU_EVENT_PER_THREAD;
+extern __thread CUstream		CU_STREAM_PER_WORKER;
+
+#define GPU_KERNEL_SEQUENCE_MAX		4
+typedef struct
+{
+	CUfunction		kern_function;
+	cl_uint			grid_sz;
+	cl_uint			block_sz;
+	cl_uint			shmem_sz;
+	void		  **kern_args;
+} GpuKernelLaunchInfo;
+extern bool		pgstrom_enable_cuda_graph;		/* GUC */
+extern CUresult gpuLaunchKernelSequence(int nkernels,
+										GpuKernelLaunchInfo *klaunch);
 
 extern void GpuContextWorkerReportError(int elevel,
 										int errcode,
@@ -851,12 +1089,16 @@ CHECK_FOR_GPUCONTEXT(GpuContext *gcontext)
 	}
 	CHECK_FOR_INTERRUPTS();
 }
+extern int	gpuDeviceLeastLoadedAmong(cl_ulong devmask);
+extern void gpuDeviceCountDMA(GpuContext *gcontext, size_t h2d_sz,
+							  size_t d2h_sz, size_t gpudirect_sz);
 extern CUresult gpuInit(unsigned int flags);
 extern GpuContext *AllocGpuContext(int cuda_dindex,
 								   bool activate_context,
 								   bool activate_workers);
 extern void ActivateGpuContext(GpuContext *gcontext);
 extern void ActivateGpuContextNoWorkers(GpuContext *gcontext);
+extern bool HasActiveGpuContext(void);
 extern GpuContext *GetGpuContext(GpuContext *gcontext);
 extern void PutGpuContext(GpuContext *gcontext);
 extern void SynchronizeGpuContext(GpuContext *gcontext);
@@ -864,6 +1106,7 @@ extern void SynchronizeGpuContextOnDSMDetach(dsm_segment *seg, Datum arg);
 
 #define GPUMEM_DEVICE_RAW_EXTRA		((void *)(~0L))
 #define GPUMEM_HOST_RAW_EXTRA		((void *)(~1L))
+#define GPUMEM_DEVICE_POOL_EXTRA	((void *)(~2L))
 
 extern bool trackCudaProgram(GpuContext *gcontext, ProgramId program_id,
 							 const char *filename, int lineno);
@@ -1001,12 +1244,14 @@ extern void pgstromInitGpuTaskState(GpuTaskState *gts,
 									GpuContext *gcontext,
 									GpuTaskKind task_kind,
 									List *outer_refs,
+									List *outer_quals,
 									List *used_params,
 									cl_int optimal_gpu,
 									cl_uint outer_nrows_per_block,
 									cl_int eflags);
 extern TupleTableSlot *pgstromExecGpuTaskState(GpuTaskState *gts);
 extern void pgstromRescanGpuTaskState(GpuTaskState *gts);
+extern void pgstromSuspendGpuTaskState(GpuTaskState *gts);
 extern void pgstromReleaseGpuTaskState(GpuTaskState *gts,
 									   GpuTaskRuntimeStat *gt_rtstat);
 extern void pgstromExplainGpuTaskState(GpuTaskState *gts, ExplainState *es);
@@ -1020,8 +1265,14 @@ extern void pgstromInitWorkerGpuTaskState(GpuTaskState *gts,
 extern void pgstromReInitializeDSMGpuTaskState(GpuTaskState *gts);
 
 extern GpuTask *fetch_next_gputask(GpuTaskState *gts);
+extern void pgstromTraceGpuTask(GpuTaskState *gts, GpuTask *gtask,
+								instr_time *tv_start,
+								instr_time *tv_jit,
+								instr_time *tv_end,
+								bool jit_fallback);
 
 extern void pgstromInitGpuTask(GpuTaskState *gts, GpuTask *gtask);
+extern Size pgstromGpuTaskChunkSize(GpuTaskState *gts);
 extern void pgstrom_init_gputasks(void);
 
 /*
@@ -1029,11 +1280,13 @@ extern void pgstrom_init_gputasks(void);
  */
 extern Size	pgstrom_gpudirect_threshold(void);
 extern int	GetOptimalGpuForFile(File fdesc);
+extern int	GetOptimalGpuForFilePath(const char *pathname);
 extern int	GetOptimalGpuForRelation(PlannerInfo *root,
 									 RelOptInfo *rel);
 extern bool ScanPathWillUseNvmeStrom(PlannerInfo *root,
 									 RelOptInfo *baserel);
 extern bool RelationCanUseNvmeStrom(Relation relation);
+extern cl_int RelationChooseOptimalGpu(Relation relation, cl_int optimal_gpu);
 
 extern void	gpuDirectFileDescOpen(GPUDirectFileDesc *gds_fdesc, File pg_fdesc);
 extern void	gpuDirectFileDescOpenByPath(GPUDirectFileDesc *gds_fdesc,
@@ -1050,6 +1303,11 @@ extern void gpuDirectFileReadIOV(const GPUDirectFileDesc *gds_fdesc,
 								 unsigned long iomap_handle,
 								 off_t m_offset,
 								 strom_io_vector *iovec);
+extern void gpuDirectDmaQueueTerminate(GpuContext *gcontext);
+extern bool hostFileReadChunks(int fdesc,
+							   hostFileReadChunk *chunks, int nchunks,
+							   char *buf_base, size_t buf_len,
+							   bool buf_pinned);
 extern void	pgstrom_init_gpu_direct(void);
 
 /*
@@ -1067,7 +1325,23 @@ extern ProgramId __pgstrom_create_cuda_program(GpuContext *gcontext,
 #define pgstrom_create_cuda_program(a,b,c,d,e,f,g)				\
 	__pgstrom_create_cuda_program((a),(b),(c),(d),(e),(f),(g),	\
 								  __FILE__,__LINE__)
+extern void	pgstrom_prebuild_cuda_program(int cuda_dindex,
+										  cl_uint extra_flags,
+										  cl_uint varlena_bufsz,
+										  const char *kern_source,
+										  const char *kern_node_define);
 extern CUmodule pgstrom_load_cuda_program(ProgramId program_id);
+extern bool pgstrom_cuda_program_is_ready(ProgramId program_id);
+extern int	pgstrom_tuned_block_size(ProgramId program_id,
+									 const char *func_name,
+									 int cuda_dindex,
+									 int optimal_block_sz);
+extern void pgstrom_tuned_block_size_feedback(ProgramId program_id,
+											  const char *func_name,
+											  int cuda_dindex,
+											  int block_sz,
+											  size_t nitems,
+											  uint64 usec);
 extern void pgstrom_put_cuda_program(GpuContext *gcontext,
 									 ProgramId program_id);
 extern void pgstrom_build_session_info(StringInfo str,
@@ -1096,7 +1370,10 @@ struct codegen_context {
 	List	   *pseudo_tlist;	/* pseudo tlist expression, if any */
 	int			extra_flags;	/* external libraries to be included */
 	int			varlena_bufsz;	/* required size of temporary varlena buffer */
+	bool		decompress_bufsz_reserved; /* vlbuf for compressed datum */
 	int			devcost;	/* relative device cost */
+	List	   *cse_exprs;	/* common subexpressions in the function */
+	List	   *cse_temps;	/* temporary variable number of the CSE */
 };
 typedef struct codegen_context	codegen_context;
 
@@ -1120,6 +1397,8 @@ extern devcast_info *pgstrom_devcast_lookup(Oid src_type_oid,
 extern bool pgstrom_devtype_can_relabel(Oid src_type_oid,
 										Oid dst_type_oid);
 extern char *pgstrom_codegen_expression(Node *expr, codegen_context *context);
+extern void pgstrom_codegen_cse_setup(codegen_context *context,
+									 List *exprs_list);
 extern void pgstrom_codegen_param_declarations(StringInfo buf,
 											   codegen_context *context);
 extern void pgstrom_union_type_declarations(StringInfo buf,
@@ -1196,6 +1475,9 @@ extern pgstrom_data_store *__PDS_create_row(GpuContext *gcontext,
 											TupleDesc tupdesc,
 											Size length,
 											const char *fname, int lineno);
+extern pgstrom_data_store *PDS_create_row_on_arena(GpuMemArena *arena,
+												   TupleDesc tupdesc,
+												   Size length);
 extern pgstrom_data_store *__PDS_create_hash(GpuContext *gcontext,
 											 TupleDesc tupdesc,
 											 Size length,
@@ -1207,6 +1489,7 @@ extern pgstrom_data_store *__PDS_create_slot(GpuContext *gcontext,
 extern pgstrom_data_store *__PDS_create_block(GpuContext *gcontext,
 											  TupleDesc tupdesc,
 											  NVMEScanState *nvme_sstate,
+											  cl_uint nrooms,
 											  const char *fname, int lineno);
 #define PDS_create_row(a,b,c)					\
 	__PDS_create_row((a),(b),(c),__FILE__,__LINE__)
@@ -1214,8 +1497,8 @@ extern pgstrom_data_store *__PDS_create_block(GpuContext *gcontext,
 	__PDS_create_hash((a),(b),(c),__FILE__,__LINE__)
 #define PDS_create_slot(a,b,c)					\
 	__PDS_create_slot((a),(b),(c),__FILE__,__LINE__)
-#define PDS_create_block(a,b,c)					\
-	__PDS_create_block((a),(b),(c),__FILE__,__LINE__)
+#define PDS_create_block(a,b,c,d)				\
+	__PDS_create_block((a),(b),(c),(d),__FILE__,__LINE__)
 #define KDS_clone(a,b)							\
 	__KDS_clone((a),(b),__FILE__,__LINE__)
 #define PDS_clone(a)							\
@@ -1283,7 +1566,14 @@ extern void pgstromExplainBrinIndexMap(GpuTaskState *gts,
 									   List *dcontext);
 
 extern pgstrom_data_store *pgstromExecScanChunk(GpuTaskState *gts);
+extern bool pgstromExecScanChunkFeeder(GpuTaskState *gts,
+									   pgstrom_data_store *pds);
 extern void pgstromRewindScanChunk(GpuTaskState *gts);
+extern bool pgstromBlockTupleIsVisible(GpuTaskState *gts,
+									   PageHeader hpage,
+									   HeapTupleHeader htup);
+extern cl_ulong gpu_btree_encode_datum(Oid type_oid, Datum datum);
+extern Datum gpu_btree_decode_datum(Oid type_oid, cl_ulong value);
 
 extern void pgstromExplainOuterScan(GpuTaskState *gts,
 									List *deparse_context,
@@ -1297,16 +1587,56 @@ extern void pgstromExplainOuterScan(GpuTaskState *gts,
 
 extern void pgstrom_init_relscan(void);
 
+/*
+ * ccache.c
+ */
+#define CCACHE_CHUNK_SIZE		(128UL << 20)	/* 128MB */
+#define CCACHE_CHUNK_NBLOCKS	((BlockNumber)(CCACHE_CHUNK_SIZE / BLCKSZ))
+
+extern bool pgstrom_ccache_scan_is_available(GpuTaskState *gts);
+extern void pgstrom_ccache_begin_scan(GpuTaskState *gts);
+extern void pgstrom_ccache_end_scan(GpuTaskState *gts);
+extern bool pgstrom_ccache_is_ready(GpuTaskState *gts, BlockNumber block_nr);
+extern pgstrom_data_store *pgstrom_ccache_load_chunk(GpuTaskState *gts,
+													 BlockNumber block_nr);
+extern void pgstrom_init_ccache(void);
+
+/*
+ * result_cache.c
+ */
+extern void pgstrom_result_cache_begin(GpuTaskState *gts, int eflags);
+extern TupleTableSlot *pgstrom_result_cache_exec(GpuTaskState *gts,
+												 TupleTableSlot *slot);
+extern void pgstrom_result_cache_end(GpuTaskState *gts);
+extern void pgstrom_result_cache_explain(GpuTaskState *gts, ExplainState *es);
+extern void pgstrom_init_result_cache(void);
+
+/*
+ * gpu_analyze.c
+ */
+typedef struct gpuAnalyzeState	gpuAnalyzeState;
+extern bool gpuAnalyzeSupportedColumn(Form_pg_attribute attr);
+extern gpuAnalyzeState *gpuAnalyzeBeginColumn(Relation frel,
+											  AttrNumber attnum,
+											  double totalrows,
+											  int cuda_dindex);
+extern void gpuAnalyzePutDatum(gpuAnalyzeState *gas,
+							   Datum datum, bool isnull);
+extern void gpuAnalyzeEndColumn(gpuAnalyzeState *gas);
+extern void pgstrom_init_gpu_analyze(void);
+
 /*
  * gpuscan.c
  */
 extern bool enable_gpuscan;		/* GUC */
-extern Cost cost_for_dma_receive(RelOptInfo *rel, double ntuples);
+extern Cost cost_for_dma_receive(RelOptInfo *rel, double ntuples,
+								 int cuda_dindex);
 extern void codegen_gpuscan_quals(StringInfo kern,
 								  codegen_context *context,
 								  const char *component,
 								  Index scanrelid,
-								  List *dev_quals_list);
+								  List *dev_quals_list,
+								  cl_int *p_qstat_index);
 extern bool pgstrom_pullup_outer_scan(PlannerInfo *root,
 									  const Path *outer_path,
 									  Index *p_outer_relid,
@@ -1320,6 +1650,7 @@ extern bool pgstrom_path_is_gpuscan(const Path *path);
 extern bool pgstrom_plan_is_gpuscan(const Plan *plan);
 extern bool pgstrom_planstate_is_gpuscan(const PlanState *ps);
 extern Path *pgstrom_copy_gpuscan_path(const Path *pathnode);
+extern void __assign_gpuscan_session_info(StringInfo buf, CustomScan *cscan);
 extern void assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts);
 extern void pgstrom_init_gpuscan(void);
 
@@ -1360,9 +1691,14 @@ extern ProgramId GpuJoinCreateCombinedProgram(PlanState *node,
 											  const char *gpa_kern_source,
 											  bool explain_only);
 extern bool GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels);
+extern bool GpuJoinHasMultiBatchInner(PlanState *ps);
 extern void GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan);
 extern pgstrom_data_store *GpuJoinExecOuterScanChunk(GpuTaskState *gts);
 extern int  gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts);
+extern void gpujoinMergeOuterJoinMaps(GpuTaskState *gts,
+									  CUmodule cuda_module,
+									  struct kern_gpujoin *kgjoin,
+									  cl_int outer_depth);
 extern TupleTableSlot *gpujoinNextTupleFallback(GpuTaskState *gts,
 												struct kern_gpujoin *kgjoin,
 												pgstrom_data_store *pds_src,
@@ -1382,19 +1718,47 @@ extern void assign_gpupreagg_session_info(StringInfo buf,
 										  GpuTaskState *gts);
 extern void pgstrom_init_gpupreagg(void);
 
+/*
+ * gpusort.c
+ */
+extern bool pgstrom_gpusort_sortable(Sort *sort, AttrNumber *outerColIdx);
+extern char *pgstrom_gpusort_codegen(codegen_context *context,
+									 int numCols,
+									 AttrNumber *sortColIdx,
+									 Oid *sortOperators,
+									 Oid *collations,
+									 bool *nullsFirst,
+									 List *outer_tlist,
+									 bool with_keydiff);
+extern void pgstrom_try_insert_gpusort(PlannedStmt *pstmt, Plan **p_plan,
+									   Limit *limit);
+extern bool pgstrom_plan_is_gpusort(const Plan *plan);
+extern bool pgstrom_planstate_is_gpusort(const PlanState *ps);
+extern void pgstrom_init_gpusort(void);
+
+/*
+ * gpuwinagg.c
+ */
+extern void pgstrom_try_insert_gpuwinagg(PlannedStmt *pstmt, Plan **p_plan);
+extern bool pgstrom_plan_is_gpuwinagg(const Plan *plan);
+extern void pgstrom_init_gpuwinagg(void);
+
 /*
  * arrow_fdw.c and arrow_read.c
  */
 extern bool baseRelIsArrowFdw(RelOptInfo *baserel);
+extern bool baseRelHasArrowVirtualRefs(RelOptInfo *baserel);
 extern bool RelationIsArrowFdw(Relation frel);
 extern cl_int GetOptimalGpuForArrowFdw(PlannerInfo *root,
 									   RelOptInfo *baserel);
 extern bool KDS_fetch_tuple_arrow(TupleTableSlot *slot,
 								  kern_data_store *kds,
 								  size_t row_index);
+extern void arrowFdwUnmapRecordBatch(pgstrom_data_store *pds);
 
 extern ArrowFdwState *ExecInitArrowFdw(GpuContext *gcontext,
 									   Relation relation,
+									   List *outer_quals,
 									   Bitmapset *outer_refs);
 extern pgstrom_data_store *ExecScanChunkArrowFdw(GpuTaskState *gts);
 extern void ExecReScanArrowFdw(ArrowFdwState *af_state);
@@ -1406,14 +1770,36 @@ extern void ExecReInitDSMArrowFdw(ArrowFdwState *af_state);
 extern void ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
 								   pg_atomic_uint32 *rbatch_index);
 extern void ExecShutdownArrowFdw(ArrowFdwState *af_state);
+extern bool ExecArrowFdwDataVersion(ArrowFdwState *af_state, StringInfo buf);
 extern void ExplainArrowFdw(ArrowFdwState *af_state,
 							Relation frel, ExplainState *es);
+extern pgstrom_data_store *arrowFdwLoadCacheFile(const char *pathname,
+												 Relation relation,
+												 Bitmapset *referenced,
+												 GpuContext *gcontext);
+extern void setupArrowSQLbufferSchema(struct SQLtable *table,
+									  TupleDesc tupdesc);
+extern char *arrowFdwExportGpuBufferColumns(Oid frel_oid);
+extern void arrowFdwPutGpuBuffer(const char *ident);
+extern double arrowFdwGpuAnalyze(Relation frel);
 extern void pgstrom_init_arrow_fdw(void);
 
+/*
+ * arrow_s3.c
+ */
+extern char *arrowS3ResolveCacheFile(const char *url);
+extern bool arrowS3IsCacheFile(const char *fname);
+extern void arrowS3FetchCacheRanges(const char *fname, int nranges,
+									const off_t *offsets,
+									const size_t *lengths);
+extern void pgstrom_init_arrow_s3(void);
+
 /*
  * gstore_fdw.c
  */
 extern bool	baseRelIsGstoreFdw(RelOptInfo *baserel);
+extern bool	baseRelHasGstorePrimaryKeyLookup(PlannerInfo *root,
+											 RelOptInfo *baserel);
 extern bool RelationIsGstoreFdw(Relation frel);
 extern int	GetOptimalGpuForGstoreFdw(PlannerInfo *root,
 									  RelOptInfo *baserel);
@@ -1429,12 +1815,20 @@ extern void ExecReInitDSMGstoreFdw(GpuStoreFdwState *gstore_state);
 extern void ExecInitWorkerGstoreFdw(GpuStoreFdwState *gstore_state,
 									pg_atomic_uint64 *gstore_read_pos);
 extern void ExecShutdownGstoreFdw(GpuStoreFdwState *gstore_state);
+extern bool ExecGstoreFdwDataVersion(GpuStoreFdwState *gstore_state,
+									 StringInfo buf);
+extern bool ExecGstoreFdwGetDataVersion(GpuStoreFdwState *gstore_state,
+										uint32 *p_revision,
+										uint64 *p_data_version);
 extern void ExplainGstoreFdw(GpuStoreFdwState *af_state,
 							 Relation frel, ExplainState *es);
 extern CUresult gstoreFdwMapDeviceMemory(GpuContext *gcontext,
 										 pgstrom_data_store *pds);
 extern void gstoreFdwUnmapDeviceMemory(GpuContext *gcontext,
 									   pgstrom_data_store *pds);
+extern char *gstoreFdwExportColumns(Oid ftable_oid);
+extern void gstoreFdwPutColumns(const char *ident);
+extern double gstoreFdwGpuAnalyze(Relation frel);
 
 #define GSTORE_FDW_SYSATTR_OID		6116
 extern void gstoreFdwBgWorkerBegin(int cuda_dindex);
@@ -1494,6 +1888,7 @@ extern void		pgstrom_init_nvrtc(void);
  * cufile.c
  */
 extern bool		cuFileDriverLoaded(void);
+extern bool		cuFileBatchIOSupported(void);
 extern void		pgstrom_init_cufile(void);
 
 /*
@@ -1514,6 +1909,7 @@ extern void		pgstrom_init_extra(void);
 extern bool		pgstrom_enabled;
 extern bool		pgstrom_bulkexec_enabled;
 extern bool		pgstrom_cpu_fallback_enabled;
+extern bool		pgstrom_cpu_fallback_on_jit;
 extern bool		pgstrom_regression_test_mode;
 extern int		pgstrom_max_async_tasks;
 extern double	pgstrom_gpu_setup_cost;
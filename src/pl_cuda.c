@@ -0,0 +1,861 @@
+/*
+ * pl_cuda.c
+ *
+ * PL/CUDA SQL function support
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+
+/*
+ * NOTE: Unlike the older PL/CUDA that built a host program with nvcc and
+ * ran it as a child process, the function body is now a device code that
+ * shall be built by NVRTC through cuda_program.c, and its program cache.
+ * The function body must define the entrypoint below:
+ *
+ *   KERNEL_FUNCTION(void)
+ *   plcuda_main(kern_plcuda *kplcuda)
+ *
+ * Arguments of regclass type are Gstore_Fdw or Arrow_Fdw foreign tables;
+ * their GPU buffers are mapped to the kernel as is, using the IPC handles
+ * of gstore_fdw_export_columns() or arrow_fdw_export_columns().
+ */
+static const char *plcuda_kernel_prologue =
+	"/* ---- PL/CUDA common definitions ---- */\n"
+	"typedef struct {\n"
+	"  cl_int     unitsz;     /* >0: fixed-length, 0: bitmap of bool, -1: varlena */\n"
+	"  cl_uint    __padding;\n"
+	"  char      *values;     /* NULL if not exported */\n"
+	"  cl_uchar  *nullmap;    /* NULL if no NULLs; bit=1 means not null */\n"
+	"  char      *extra;      /* only variable-length column */\n"
+	"} kern_plcuda_column;\n"
+	"\n"
+	"#define PLCUDA_TABLE_FORMAT__ARROW    1\n"
+	"#define PLCUDA_TABLE_FORMAT__GSTORE   2\n"
+	"typedef struct {\n"
+	"  cl_uint    format;     /* one of PLCUDA_TABLE_FORMAT__* */\n"
+	"  cl_uint    ncols;      /* columns[] is indexed by attnum - 1 */\n"
+	"  cl_ulong   nitems;\n"
+	"  cl_uchar  *valid;      /* bitmap of the visible rows, or NULL */\n"
+	"  kern_plcuda_column columns[1];\n"
+	"} kern_plcuda_table;\n"
+	"\n"
+	"typedef struct {\n"
+	"  cl_ulong   value;      /* Datum, or elements of the array */\n"
+	"  kern_plcuda_table *table;  /* regclass argument only */\n"
+	"  cl_uint    nitems;     /* number of the array elements */\n"
+	"  cl_bool    isnull;\n"
+	"} kern_plcuda_arg;\n"
+	"\n"
+	"typedef struct {\n"
+	"  cl_ulong   result;     /* Datum of the result */\n"
+	"  cl_bool    result_isnull;\n"
+	"  cl_uint    nargs;\n"
+	"  kern_plcuda_arg args[1];\n"
+	"} kern_plcuda;\n"
+	"\n"
+	"STATIC_INLINE(cl_bool)\n"
+	"plcuda_row_is_valid(kern_plcuda_table *table, cl_ulong rowid)\n"
+	"{\n"
+	"  if (rowid >= table->nitems)\n"
+	"    return false;\n"
+	"  if (!table->valid)\n"
+	"    return true;\n"
+	"  return (table->valid[rowid >> 3] & (1U << (rowid & 7))) != 0;\n"
+	"}\n"
+	"\n"
+	"STATIC_INLINE(cl_bool)\n"
+	"plcuda_column_isnull(kern_plcuda_table *table,\n"
+	"                     cl_uint colidx, cl_ulong rowid)\n"
+	"{\n"
+	"  kern_plcuda_column *cmeta = &table->columns[colidx];\n"
+	"\n"
+	"  if (colidx >= table->ncols || !cmeta->values)\n"
+	"    return true;\n"
+	"  if (cmeta->nullmap &&\n"
+	"      (cmeta->nullmap[rowid >> 3] & (1U << (rowid & 7))) == 0)\n"
+	"    return true;\n"
+	"  if (table->format == PLCUDA_TABLE_FORMAT__GSTORE &&\n"
+	"      cmeta->unitsz < 0 && ((cl_uint *)cmeta->values)[rowid] == 0)\n"
+	"    return true;\n"
+	"  return false;\n"
+	"}\n"
+	"\n"
+	"STATIC_INLINE(void *)\n"
+	"plcuda_column_value(kern_plcuda_table *table,\n"
+	"                    cl_uint colidx, cl_ulong rowid)\n"
+	"{\n"
+	"  kern_plcuda_column *cmeta = &table->columns[colidx];\n"
+	"\n"
+	"  if (cmeta->unitsz <= 0)\n"
+	"    return NULL;\n"
+	"  return cmeta->values + cmeta->unitsz * rowid;\n"
+	"}\n"
+	"\n"
+	"STATIC_INLINE(char *)\n"
+	"plcuda_column_varlena(kern_plcuda_table *table,\n"
+	"                      cl_uint colidx, cl_ulong rowid, cl_uint *p_len)\n"
+	"{\n"
+	"  kern_plcuda_column *cmeta = &table->columns[colidx];\n"
+	"  cl_uint   *offsets = (cl_uint *)cmeta->values;\n"
+	"  char      *vl;\n"
+	"\n"
+	"  if (cmeta->unitsz >= 0)\n"
+	"    return NULL;\n"
+	"  if (table->format == PLCUDA_TABLE_FORMAT__ARROW)\n"
+	"  {\n"
+	"    *p_len = offsets[rowid+1] - offsets[rowid];\n"
+	"    return cmeta->extra + offsets[rowid];\n"
+	"  }\n"
+	"  vl = cmeta->extra + __kds_unpack(offsets[rowid]);\n"
+	"  *p_len = VARSIZE_ANY_EXHDR(vl);\n"
+	"  return VARDATA_ANY(vl);\n"
+	"}\n"
+	"\n"
+	"/* ---- PL/CUDA function body ---- */\n";
+
+#define PLCUDA_TABLE_FORMAT__ARROW		1
+#define PLCUDA_TABLE_FORMAT__GSTORE		2
+
+/* host side definitions; must be identical to the prologue above */
+typedef struct
+{
+	cl_int		unitsz;
+	cl_uint		__padding;
+	CUdeviceptr	values;
+	CUdeviceptr	nullmap;
+	CUdeviceptr	extra;
+} kern_plcuda_column;
+
+typedef struct
+{
+	cl_uint		format;
+	cl_uint		ncols;
+	cl_ulong	nitems;
+	CUdeviceptr	valid;
+	kern_plcuda_column columns[FLEXIBLE_ARRAY_MEMBER];
+} kern_plcuda_table;
+
+typedef struct
+{
+	cl_ulong	value;
+	CUdeviceptr	table;
+	cl_uint		nitems;
+	cl_bool		isnull;
+} kern_plcuda_arg;
+
+typedef struct
+{
+	cl_ulong	result;
+	cl_bool		result_isnull;
+	cl_uint		nargs;
+	kern_plcuda_arg args[FLEXIBLE_ARRAY_MEMBER];
+} kern_plcuda;
+
+/*
+ * plcudaTableDesc - GPU buffer of a foreign table argument
+ */
+typedef struct
+{
+	char	   *ident;			/* identifier of the exported buffer */
+	bool		is_gstore;		/* exported by gstore_fdw, or arrow_fdw */
+	Oid			ftable_oid;
+	int			cuda_dindex;
+	cl_uint		format;
+	size_t		nitems;
+	CUipcMemHandle main_mhandle;
+	CUipcMemHandle extra_mhandle;	/* gstore only */
+	CUipcMemHandle valid_mhandle;	/* gstore only */
+	bool		has_extra;
+	int			ncols;
+	struct {
+		cl_int	unitsz;
+		ssize_t	values_offset;		/* -1, if not exported */
+		ssize_t	nullmap_offset;
+		ssize_t	extra_offset;		/* arrow only */
+	}		   *cols;
+	/* device pointers mapped on the kernel invocation */
+	CUdeviceptr	m_main;
+	CUdeviceptr	m_extra;
+	CUdeviceptr	m_valid;
+} plcudaTableDesc;
+
+/*
+ * plcudaFuncInfo - cached at fn_extra
+ */
+typedef struct
+{
+	Oid			fn_oid;
+	TransactionId fn_xmin;
+	ItemPointerData fn_tid;
+	char	   *kern_source;
+	int			nargs;
+	Oid		   *argtypes;
+	Oid		   *argelems;		/* element type, if array */
+	Oid			rettype;
+} plcudaFuncInfo;
+
+Datum pgstrom_plcuda_validator(PG_FUNCTION_ARGS);
+Datum pgstrom_plcuda_handler(PG_FUNCTION_ARGS);
+
+/*
+ * plcuda_check_function_types
+ *
+ * PL/CUDA supports fixed-length and pass-by-value data types, 1-dimensional
+ * array of them, and regclass of Gstore_Fdw/Arrow_Fdw as arguments.
+ */
+static bool
+plcuda_check_scalar_type(Oid type_oid)
+{
+	int16		typlen;
+	bool		typbyval;
+
+	get_typlenbyval(type_oid, &typlen, &typbyval);
+	return (typbyval && typlen > 0);
+}
+
+static void
+plcuda_check_function_types(Form_pg_proc proc)
+{
+	int			i;
+
+	if (proc->proretset)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("PL/CUDA function cannot return set")));
+	if (proc->prorettype != VOIDOID &&
+		!plcuda_check_scalar_type(proc->prorettype))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("PL/CUDA function cannot return %s",
+						format_type_be(proc->prorettype)),
+				 errhint("fixed-length and pass-by-value data type, or void is supported")));
+	for (i=0; i < proc->proargtypes.dim1; i++)
+	{
+		Oid		type_oid = proc->proargtypes.values[i];
+		Oid		elem_oid = get_element_type(type_oid);
+
+		if (type_oid == REGCLASSOID)
+			continue;
+		if (OidIsValid(elem_oid)
+			? plcuda_check_scalar_type(elem_oid)
+			: plcuda_check_scalar_type(type_oid))
+			continue;
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("PL/CUDA function cannot take %s as argument",
+						format_type_be(type_oid)),
+				 errhint("regclass of Gstore_Fdw/Arrow_Fdw, fixed-length and pass-by-value data type, or 1-dimensional array of them are supported")));
+	}
+}
+
+/*
+ * plcuda_build_kernel_source
+ */
+static char *
+plcuda_build_kernel_source(HeapTuple protup)
+{
+	Form_pg_proc proc = (Form_pg_proc) GETSTRUCT(protup);
+	StringInfoData buf;
+	Datum		datum;
+	bool		isnull;
+	char	   *prosrc;
+
+	datum = SysCacheGetAttr(PROCOID, protup,
+							Anum_pg_proc_prosrc, &isnull);
+	if (isnull)
+		elog(ERROR, "PL/CUDA function '%s' has null prosrc",
+			 NameStr(proc->proname));
+	prosrc = TextDatumGetCString(datum);
+	if (!strstr(prosrc, "plcuda_main"))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_FUNCTION_DEFINITION),
+				 errmsg("PL/CUDA function '%s' has no entrypoint",
+						NameStr(proc->proname)),
+				 errhint("function body must define KERNEL_FUNCTION(void) plcuda_main(kern_plcuda *kplcuda)")));
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, plcuda_kernel_prologue);
+	appendStringInfo(&buf, "#line 1 \"%s\"\n%s\n",
+					 NameStr(proc->proname), prosrc);
+	pfree(prosrc);
+
+	return buf.data;
+}
+
+/*
+ * plcuda_build_cuda_program
+ */
+static ProgramId
+plcuda_build_cuda_program(GpuContext *gcontext, const char *kern_source,
+						  CUfunction *p_kern_main)
+{
+	ProgramId	program_id;
+	CUmodule	cuda_module;
+	CUresult	rc;
+
+	program_id = pgstrom_create_cuda_program(gcontext,
+											 0,
+											 0,
+											 kern_source,
+											 "",
+											 true,
+											 false);
+	if (p_kern_main)
+	{
+		cuda_module = GpuContextLookupModule(gcontext, program_id);
+		rc = cuModuleGetFunction(p_kern_main,
+								 cuda_module,
+								 "plcuda_main");
+		if (rc != CUDA_SUCCESS)
+		{
+			pgstrom_put_cuda_program(gcontext, program_id);
+			elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+		}
+	}
+	return program_id;
+}
+
+/*
+ * pgstrom_plcuda_validator
+ */
+Datum
+pgstrom_plcuda_validator(PG_FUNCTION_ARGS)
+{
+	Oid			func_oid = PG_GETARG_OID(0);
+	HeapTuple	protup;
+	char	   *kern_source;
+
+	if (!CheckFunctionValidatorAccess(fcinfo->flinfo->fn_oid, func_oid))
+		PG_RETURN_VOID();
+
+	protup = SearchSysCache1(PROCOID, ObjectIdGetDatum(func_oid));
+	if (!HeapTupleIsValid(protup))
+		elog(ERROR, "cache lookup failed for function %u", func_oid);
+	plcuda_check_function_types((Form_pg_proc) GETSTRUCT(protup));
+	if (check_function_bodies)
+	{
+		kern_source = plcuda_build_kernel_source(protup);
+		/* try to build the function body, if GPU is available */
+		if (numDevAttrs > 0)
+		{
+			GpuContext *gcontext = AllocGpuContext(-1, true, false);
+			ProgramId	program_id;
+
+			PG_TRY();
+			{
+				program_id = plcuda_build_cuda_program(gcontext,
+													   kern_source,
+													   NULL);
+				pgstrom_put_cuda_program(gcontext, program_id);
+			}
+			PG_CATCH();
+			{
+				PutGpuContext(gcontext);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+			PutGpuContext(gcontext);
+		}
+	}
+	ReleaseSysCache(protup);
+
+	PG_RETURN_VOID();
+}
+PG_FUNCTION_INFO_V1(pgstrom_plcuda_validator);
+
+/*
+ * plcuda_lookup_function_info
+ */
+static plcudaFuncInfo *
+plcuda_lookup_function_info(FmgrInfo *flinfo)
+{
+	plcudaFuncInfo *finfo = flinfo->fn_extra;
+	HeapTuple	protup;
+	Form_pg_proc proc;
+	MemoryContext oldcxt;
+	int			i;
+
+	protup = SearchSysCache1(PROCOID, ObjectIdGetDatum(flinfo->fn_oid));
+	if (!HeapTupleIsValid(protup))
+		elog(ERROR, "cache lookup failed for function %u", flinfo->fn_oid);
+	if (finfo &&
+		finfo->fn_xmin == HeapTupleHeaderGetRawXmin(protup->t_data) &&
+		ItemPointerEquals(&finfo->fn_tid, &protup->t_self))
+	{
+		ReleaseSysCache(protup);
+		return finfo;
+	}
+	proc = (Form_pg_proc) GETSTRUCT(protup);
+	plcuda_check_function_types(proc);
+
+	oldcxt = MemoryContextSwitchTo(flinfo->fn_mcxt);
+	finfo = palloc0(sizeof(plcudaFuncInfo));
+	finfo->fn_oid = flinfo->fn_oid;
+	finfo->fn_xmin = HeapTupleHeaderGetRawXmin(protup->t_data);
+	finfo->fn_tid = protup->t_self;
+	finfo->kern_source = plcuda_build_kernel_source(protup);
+	finfo->nargs = proc->proargtypes.dim1;
+	finfo->argtypes = palloc0(sizeof(Oid) * (finfo->nargs + 1));
+	finfo->argelems = palloc0(sizeof(Oid) * (finfo->nargs + 1));
+	for (i=0; i < finfo->nargs; i++)
+	{
+		Oid		type_oid = proc->proargtypes.values[i];
+
+		finfo->argtypes[i] = type_oid;
+		finfo->argelems[i] = get_element_type(type_oid);
+	}
+	finfo->rettype = proc->prorettype;
+	MemoryContextSwitchTo(oldcxt);
+	ReleaseSysCache(protup);
+
+	flinfo->fn_extra = finfo;
+	return finfo;
+}
+
+/*
+ * plcuda_parse_buffer_ident
+ *
+ * It parses the identifier of GPU buffer exported by Gstore_Fdw/Arrow_Fdw.
+ */
+static int
+__plcuda_arrow_column_unitsz(const char *type_name)
+{
+	if (strcmp(type_name, "bool") == 0)
+		return 0;
+	if (strcmp(type_name, "int16") == 0 ||
+		strcmp(type_name, "float16") == 0)
+		return sizeof(cl_short);
+	if (strcmp(type_name, "int32") == 0 ||
+		strcmp(type_name, "float32") == 0 ||
+		strcmp(type_name, "date32") == 0 ||
+		strncmp(type_name, "time32[", 7) == 0)
+		return sizeof(cl_int);
+	if (strcmp(type_name, "int64") == 0 ||
+		strcmp(type_name, "float64") == 0 ||
+		strcmp(type_name, "date64") == 0 ||
+		strncmp(type_name, "time64[", 7) == 0 ||
+		strncmp(type_name, "timestamp[", 10) == 0)
+		return sizeof(cl_long);
+	if (strcmp(type_name, "utf8") == 0 ||
+		strcmp(type_name, "binary") == 0)
+		return -1;
+	elog(ERROR, "PL/CUDA: unknown column type '%s'", type_name);
+}
+
+static void
+__plcuda_decode_ipc_handle(const char *hex, CUipcMemHandle *mhandle)
+{
+	if (strlen(hex) != 2 * sizeof(CUipcMemHandle))
+		elog(ERROR, "PL/CUDA: invalid IPC handle [%s]", hex);
+	hex_decode(hex, 2 * sizeof(CUipcMemHandle), (char *)mhandle);
+}
+
+static void
+plcuda_parse_buffer_ident(plcudaTableDesc *tdesc)
+{
+	char	   *buffer = pstrdup(tdesc->ident);
+	char	   *attnums = NULL;
+	char	   *columns = NULL;
+	char	   *tok, *saveptr;
+	char	   *c_tok, *c_saveptr;
+	char	   *a_tok, *a_saveptr;
+	int			i, natts;
+
+	tdesc->cuda_dindex = -1;
+	for (tok = strtok_r(buffer, ",", &saveptr);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &saveptr))
+	{
+		char   *pos = strchr(tok, '=');
+
+		if (!pos)
+			elog(ERROR, "PL/CUDA: invalid GPU buffer identifier");
+		*pos++ = '\0';
+		if (strcmp(tok, "device_id") == 0)
+		{
+			int		device_id = atoi(pos);
+
+			for (i=0; i < numDevAttrs; i++)
+			{
+				if (devAttrs[i].DEV_ID == device_id)
+				{
+					tdesc->cuda_dindex = i;
+					break;
+				}
+			}
+		}
+		else if (strcmp(tok, "ipc_handle") == 0)
+			__plcuda_decode_ipc_handle(pos, &tdesc->main_mhandle);
+		else if (strcmp(tok, "extra_handle") == 0)
+		{
+			__plcuda_decode_ipc_handle(pos, &tdesc->extra_mhandle);
+			tdesc->has_extra = true;
+		}
+		else if (strcmp(tok, "valid_handle") == 0)
+			__plcuda_decode_ipc_handle(pos, &tdesc->valid_mhandle);
+		else if (strcmp(tok, "format") == 0)
+		{
+			if (strcmp(pos, "arrow-columns") == 0)
+				tdesc->format = PLCUDA_TABLE_FORMAT__ARROW;
+			else if (strcmp(pos, "gstore-columns") == 0)
+				tdesc->format = PLCUDA_TABLE_FORMAT__GSTORE;
+			else
+				elog(ERROR, "PL/CUDA: unexpected GPU buffer format [%s]", pos);
+		}
+		else if (strcmp(tok, "nitems") == 0)
+			tdesc->nitems = strtoul(pos, NULL, 10);
+		else if (strcmp(tok, "attnums") == 0)
+			attnums = pos;
+		else if (strcmp(tok, "columns") == 0)
+			columns = pos;
+	}
+	if (tdesc->cuda_dindex < 0 || tdesc->format == 0 || !attnums || !columns)
+		elog(ERROR, "PL/CUDA: invalid GPU buffer identifier");
+
+	natts = get_relnatts(tdesc->ftable_oid);
+	tdesc->ncols = natts;
+	tdesc->cols = palloc0(sizeof(*tdesc->cols) * Max(natts, 1));
+	for (i=0; i < natts; i++)
+	{
+		tdesc->cols[i].values_offset = -1;
+		tdesc->cols[i].nullmap_offset = -1;
+		tdesc->cols[i].extra_offset = -1;
+	}
+	for (a_tok = strtok_r(attnums, " ", &a_saveptr),
+		 c_tok = strtok_r(columns, " ", &c_saveptr);
+		 a_tok != NULL && c_tok != NULL;
+		 a_tok = strtok_r(NULL, " ", &a_saveptr),
+		 c_tok = strtok_r(NULL, " ", &c_saveptr))
+	{
+		int		anum = atoi(a_tok);
+		char   *fields[5];
+		int		nfields = 0;
+		char   *f_tok, *f_saveptr;
+
+		if (anum < 1 || anum > natts)
+			elog(ERROR, "PL/CUDA: unexpected attribute number %d", anum);
+		for (f_tok = strtok_r(c_tok, ":", &f_saveptr);
+			 f_tok != NULL && nfields < lengthof(fields);
+			 f_tok = strtok_r(NULL, ":", &f_saveptr))
+			fields[nfields++] = f_tok;
+
+		if (tdesc->format == PLCUDA_TABLE_FORMAT__ARROW)
+		{
+			/* type:values:nullmap:extra:extra_length */
+			if (nfields != 5)
+				elog(ERROR, "PL/CUDA: invalid layout of arrow-columns");
+			tdesc->cols[anum-1].unitsz = __plcuda_arrow_column_unitsz(fields[0]);
+			tdesc->cols[anum-1].values_offset = atol(fields[1]);
+			tdesc->cols[anum-1].nullmap_offset = atol(fields[2]);
+			tdesc->cols[anum-1].extra_offset = atol(fields[3]);
+		}
+		else
+		{
+			/* type:unitsz:values:nullmap */
+			if (nfields != 4)
+				elog(ERROR, "PL/CUDA: invalid layout of gstore-columns");
+			tdesc->cols[anum-1].unitsz = atoi(fields[1]);
+			tdesc->cols[anum-1].values_offset = atol(fields[2]);
+			tdesc->cols[anum-1].nullmap_offset = atol(fields[3]);
+		}
+	}
+	pfree(buffer);
+}
+
+/*
+ * plcuda_export_table_argument
+ *
+ * It exports the GPU buffer of the foreign table on @tdesc. Caller must
+ * release it by plcuda_release_table_argument, even if it raised an error
+ * after the export.
+ */
+static void
+plcuda_export_table_argument(plcudaTableDesc *tdesc, Oid ftable_oid)
+{
+	Relation	frel;
+	bool		is_gstore;
+
+	frel = table_open(ftable_oid, AccessShareLock);
+	if (RelationIsGstoreFdw(frel))
+		is_gstore = true;
+	else if (RelationIsArrowFdw(frel))
+		is_gstore = false;
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is neither gstore_fdw nor arrow_fdw foreign table",
+						RelationGetRelationName(frel))));
+	table_close(frel, NoLock);
+
+	strom_foreign_table_aclcheck(ftable_oid, GetUserId(), ACL_SELECT);
+	tdesc->ftable_oid = ftable_oid;
+	tdesc->is_gstore = is_gstore;
+	if (is_gstore)
+		tdesc->ident = gstoreFdwExportColumns(ftable_oid);
+	else
+		tdesc->ident = arrowFdwExportGpuBufferColumns(ftable_oid);
+	plcuda_parse_buffer_ident(tdesc);
+}
+
+static void
+plcuda_release_table_argument(plcudaTableDesc *tdesc)
+{
+	if (!tdesc->ident)
+		return;
+	if (tdesc->is_gstore)
+		gstoreFdwPutColumns(tdesc->ident);
+	else
+		arrowFdwPutGpuBuffer(tdesc->ident);
+	tdesc->ident = NULL;
+}
+
+/*
+ * plcuda_setup_table_argument
+ */
+static void
+plcuda_setup_table_argument(GpuContext *gcontext,
+							plcudaTableDesc *tdesc,
+							kern_plcuda_table *ktable)
+{
+	CUresult	rc;
+	int			j;
+
+	rc = gpuIpcOpenMemHandle(gcontext,
+							 &tdesc->m_main,
+							 tdesc->main_mhandle,
+							 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+	if (tdesc->format == PLCUDA_TABLE_FORMAT__GSTORE)
+	{
+		if (tdesc->has_extra)
+		{
+			rc = gpuIpcOpenMemHandle(gcontext,
+									 &tdesc->m_extra,
+									 tdesc->extra_mhandle,
+									 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on gpuIpcOpenMemHandle: %s",
+					 errorText(rc));
+		}
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &tdesc->m_valid,
+								 tdesc->valid_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+	}
+	memset(ktable, 0, offsetof(kern_plcuda_table, columns[tdesc->ncols]));
+	ktable->format = tdesc->format;
+	ktable->ncols = tdesc->ncols;
+	ktable->nitems = tdesc->nitems;
+	ktable->valid = tdesc->m_valid;
+	for (j=0; j < tdesc->ncols; j++)
+	{
+		kern_plcuda_column *kcol = &ktable->columns[j];
+
+		if (tdesc->cols[j].values_offset < 0)
+			continue;
+		kcol->unitsz = tdesc->cols[j].unitsz;
+		kcol->values = tdesc->m_main + tdesc->cols[j].values_offset;
+		if (tdesc->cols[j].nullmap_offset >= 0)
+			kcol->nullmap = tdesc->m_main + tdesc->cols[j].nullmap_offset;
+		if (kcol->unitsz < 0)
+		{
+			if (tdesc->format == PLCUDA_TABLE_FORMAT__ARROW)
+				kcol->extra = tdesc->m_main + tdesc->cols[j].extra_offset;
+			else
+				kcol->extra = tdesc->m_extra;
+		}
+	}
+}
+
+/*
+ * pgstrom_plcuda_handler
+ */
+Datum
+pgstrom_plcuda_handler(PG_FUNCTION_ARGS)
+{
+	plcudaFuncInfo *finfo = plcuda_lookup_function_info(fcinfo->flinfo);
+	plcudaTableDesc **tdescs;
+	GpuContext *volatile gcontext = NULL;
+	volatile ProgramId program_id = INVALID_PROGRAM_ID;
+	int			cuda_dindex = -1;
+	size_t		nitems_max = 0;
+	size_t		length;
+	CUdeviceptr	m_kplcuda = 0UL;
+	kern_plcuda *kplcuda;
+	Datum		result = 0;
+	bool		result_isnull = false;
+	int			i;
+
+	tdescs = palloc0(sizeof(plcudaTableDesc *) * (finfo->nargs + 1));
+	PG_TRY();
+	{
+		CUfunction	kern_main;
+		CUresult	rc;
+		char	   *pos;
+		void	   *kern_args[1];
+		int			grid_sz;
+		int			block_sz;
+
+		/*
+		 * Export GPU buffers of the foreign table arguments; the kernel runs
+		 * on the device where the first one is located.
+		 */
+		length = MAXALIGN(offsetof(kern_plcuda, args[finfo->nargs]));
+		for (i=0; i < finfo->nargs; i++)
+		{
+			if (PG_ARGISNULL(i))
+				continue;
+			if (finfo->argtypes[i] == REGCLASSOID)
+			{
+				plcudaTableDesc *tdesc = palloc0(sizeof(plcudaTableDesc));
+
+				tdescs[i] = tdesc;
+				plcuda_export_table_argument(tdesc, PG_GETARG_OID(i));
+				if (cuda_dindex < 0)
+					cuda_dindex = tdesc->cuda_dindex;
+				nitems_max = Max(nitems_max, tdesc->nitems);
+				length += MAXALIGN(offsetof(kern_plcuda_table,
+											columns[tdesc->ncols]));
+			}
+			else if (OidIsValid(finfo->argelems[i]))
+			{
+				ArrayType  *array = PG_GETARG_ARRAYTYPE_P(i);
+
+				if (ARR_NDIM(array) > 1 || ARR_HASNULL(array))
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("PL/CUDA takes only 1-dimensional array without NULLs")));
+				length += MAXALIGN(ARR_SIZE(array) - ARR_DATA_OFFSET(array));
+			}
+		}
+
+		gcontext = AllocGpuContext(cuda_dindex, true, false);
+		program_id = plcuda_build_cuda_program(gcontext,
+											   finfo->kern_source,
+											   &kern_main);
+		rc = gpuMemAllocManaged(gcontext, &m_kplcuda, length,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+
+		/* setup kern_plcuda and the arguments */
+		kplcuda = (kern_plcuda *)m_kplcuda;
+		memset(kplcuda, 0, offsetof(kern_plcuda, args[finfo->nargs]));
+		kplcuda->nargs = finfo->nargs;
+		pos = (char *)kplcuda + MAXALIGN(offsetof(kern_plcuda,
+												  args[finfo->nargs]));
+		for (i=0; i < finfo->nargs; i++)
+		{
+			kern_plcuda_arg *karg = &kplcuda->args[i];
+
+			if (PG_ARGISNULL(i))
+			{
+				karg->isnull = true;
+			}
+			else if (tdescs[i])
+			{
+				plcudaTableDesc *tdesc = tdescs[i];
+
+				plcuda_setup_table_argument(gcontext, tdesc,
+											(kern_plcuda_table *)pos);
+				karg->table = (CUdeviceptr)pos;
+				pos += MAXALIGN(offsetof(kern_plcuda_table,
+										 columns[tdesc->ncols]));
+			}
+			else if (OidIsValid(finfo->argelems[i]))
+			{
+				ArrayType  *array = PG_GETARG_ARRAYTYPE_P(i);
+				size_t		sz = ARR_SIZE(array) - ARR_DATA_OFFSET(array);
+
+				memcpy(pos, ARR_DATA_PTR(array), sz);
+				karg->value = (cl_ulong)pos;
+				karg->nitems = ArrayGetNItems(ARR_NDIM(array),
+											  ARR_DIMS(array));
+				pos += MAXALIGN(sz);
+			}
+			else
+			{
+				karg->value = (cl_ulong)PG_GETARG_DATUM(i);
+			}
+		}
+		Assert(pos - (char *)kplcuda <= length);
+
+		/*
+		 * kick the kernel; grid-size is enough to process the largest table
+		 * argument in a grid-stride loop.
+		 */
+		rc = gpuOptimalBlockSize(&grid_sz,
+								 &block_sz,
+								 kern_main,
+								 gcontext->cuda_device,
+								 0, 0);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+		if (nitems_max > 0)
+			grid_sz = Min(grid_sz, (nitems_max + block_sz - 1) / block_sz);
+		kern_args[0] = &m_kplcuda;
+		rc = cuLaunchKernel(kern_main,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_THREAD,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+		rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "PL/CUDA function '%s' failed: %s",
+				 get_func_name(finfo->fn_oid), errorText(rc));
+		result = (Datum)kplcuda->result;
+		result_isnull = kplcuda->result_isnull;
+
+		rc = gpuMemFree(gcontext, m_kplcuda);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+		pgstrom_put_cuda_program(gcontext, program_id);
+	}
+	PG_CATCH();
+	{
+		if (gcontext)
+		{
+			if (program_id != INVALID_PROGRAM_ID)
+				pgstrom_put_cuda_program(gcontext, program_id);
+			PutGpuContext(gcontext);
+		}
+		for (i=0; i < finfo->nargs; i++)
+		{
+			if (tdescs[i])
+				plcuda_release_table_argument(tdescs[i]);
+		}
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	/* IPC mapping of the GPU buffers are closed with GpuContext */
+	PutGpuContext(gcontext);
+	for (i=0; i < finfo->nargs; i++)
+	{
+		if (tdescs[i])
+			plcuda_release_table_argument(tdescs[i]);
+	}
+
+	if (finfo->rettype == VOIDOID)
+		PG_RETURN_VOID();
+	if (result_isnull)
+		PG_RETURN_NULL();
+	PG_RETURN_DATUM(result);
+}
+PG_FUNCTION_INFO_V1(pgstrom_plcuda_handler);
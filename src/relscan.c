@@ -27,6 +27,8 @@ typedef struct
 
 /*--- static variables ---*/
 static bool		pgstrom_enable_brin;
+static bool		pgstrom_enable_bitmapindex;
+static bool		pgstrom_nvme_strom_gpu_visibility;
 
 /*
  * simple_match_clause_to_indexcol
@@ -98,6 +100,7 @@ simple_match_clause_to_index(IndexOptInfo *index,
 							 IndexClauseSet *clauseset)
 {
 	int		indexcol;
+	int		nkeycolumns;
 
 	/*
 	 * Never match pseudoconstants to indexes.  (Normally a match could not
@@ -115,8 +118,13 @@ simple_match_clause_to_index(IndexOptInfo *index,
 	if (!restriction_is_securely_promotable(rinfo, index->rel))
 		return;
 
-	/* OK, check each index column for a match */
-	for (indexcol = 0; indexcol < index->ncolumns; indexcol++)
+	/* OK, check each index key column for a match */
+#if PG_VERSION_NUM >= 110000
+	nkeycolumns = index->nkeycolumns;	/* INCLUDE columns are not keys */
+#else
+	nkeycolumns = index->ncolumns;
+#endif
+	for (indexcol = 0; indexcol < nkeycolumns; indexcol++)
 	{
 		if (simple_match_clause_to_indexcol(index,
 											indexcol,
@@ -275,6 +283,57 @@ estimate_brinindex_scan_nblocks(PlannerInfo *root,
 	return (cl_long)(indexSelectivity * (double) baserel->pages);
 }
 
+/*
+ * estimate_bitmapindex_scan_nblocks
+ *
+ * Estimation of the number of heap blocks to be fetched by bitmap-index
+ * scan on the B-tree, GIN, GiST and so on.
+ * Also see compute_bitmap_pages at optimizer/path/costsize.c
+ */
+static cl_long
+estimate_bitmapindex_scan_nblocks(PlannerInfo *root,
+								  RelOptInfo *baserel,
+								  IndexOptInfo *index,
+								  IndexClauseSet *clauseset,
+								  List **p_indexQuals)
+{
+	List		   *indexQuals = NIL;
+	ListCell	   *lc;
+	int				icol;
+	Selectivity		indexSelectivity;
+	double			T = (baserel->pages > 1 ? (double) baserel->pages : 1.0);
+	double			tuples_fetched;
+	double			pages_fetched;
+
+	for (icol=0; icol < index->ncolumns; icol++)
+	{
+		foreach (lc, clauseset->indexclauses[icol])
+			indexQuals = lappend(indexQuals, lfirst(lc));
+	}
+	indexSelectivity = clauselist_selectivity(root,
+											  indexQuals,
+											  baserel->relid,
+											  JOIN_INNER,
+											  NULL);
+	tuples_fetched = clamp_row_est(indexSelectivity * baserel->tuples);
+
+	/*
+	 * Mackert and Lohman formula; the heap blocks shall be fetched in
+	 * the physical order once TIDBitmap is constructed.
+	 */
+	pages_fetched = (2.0 * T * tuples_fetched) / (2.0 * T + tuples_fetched);
+	if (pages_fetched >= T)
+		pages_fetched = T;
+	else
+		pages_fetched = ceil(pages_fetched);
+
+	/* index quals, if any */
+	if (p_indexQuals)
+		*p_indexQuals = indexQuals;
+	/* estimated number of blocks to read */
+	return (cl_long) pages_fetched;
+}
+
 /*
  * extract_index_conditions
  */
@@ -354,8 +413,8 @@ pgstrom_tryfind_brinindex(PlannerInfo *root,
 	List		   *indexQuals = NIL;
 	ListCell	   *cell;
 
-	/* skip if GUC disables BRIN-index */
-	if (!pgstrom_enable_brin)
+	/* skip if GUC disables both of BRIN and bitmap-index */
+	if (!pgstrom_enable_brin && !pgstrom_enable_bitmapindex)
 		return NULL;
 
 	/* skip if no indexes */
@@ -377,8 +436,16 @@ pgstrom_tryfind_brinindex(PlannerInfo *root,
 		if (index->indpred != NIL && !index->predOK)
 			continue;
 
-		/* Only BRIN-indexes are now supported */
-		if (index->relam != BRIN_AM_OID)
+		/*
+		 * BRIN-index, or other index-AM which supports bitmap-scan
+		 * (B-tree, GIN, GiST, ...) are supported.
+		 */
+		if (index->relam == BRIN_AM_OID)
+		{
+			if (!pgstrom_enable_brin)
+				continue;
+		}
+		else if (!index->amhasgetbitmap || !pgstrom_enable_bitmapindex)
 			continue;
 
 		/* see match_clauses_to_index */
@@ -393,13 +460,19 @@ pgstrom_tryfind_brinindex(PlannerInfo *root,
 			continue;
 
 		/*
-		 * In case when multiple BRIN-indexes are configured,
+		 * In case when multiple indexes are configured,
 		 * the one with minimal selectivity is the best choice.
 		 */
- 		nblocks = estimate_brinindex_scan_nblocks(root, baserel,
-												  index,
-												  &clauseset,
-												  &temp);
+		if (index->relam == BRIN_AM_OID)
+			nblocks = estimate_brinindex_scan_nblocks(root, baserel,
+													  index,
+													  &clauseset,
+													  &temp);
+		else
+			nblocks = estimate_bitmapindex_scan_nblocks(root, baserel,
+														index,
+														&clauseset,
+														&temp);
 		if (indexNBlocks > nblocks)
 		{
 			indexOpt = index;
@@ -443,7 +516,9 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 	Cost		run_cost = 0.0;
 	Cost		index_scan_cost = 0.0;
 	Cost		disk_scan_cost;
-	double		gpu_ratio = pgstrom_gpu_operator_cost / cpu_operator_cost;
+	int			cuda_dindex = GetOptimalGpuForRelation(root, scan_rel);
+	Cost		gpu_setup_cost = pgstromGpuSetupCost(cuda_dindex);
+	double		gpu_ratio = pgstromGpuOperatorCost(cuda_dindex) / cpu_operator_cost;
 	double		parallel_divisor;
 	double		ntuples = scan_rel->tuples;
 	double		nblocks = scan_rel->pages;
@@ -474,25 +549,47 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 							  &spc_seq_page_cost);
 	disk_scan_cost = spc_seq_page_cost * nblocks;
 
-	/* consideration for BRIN-index, if any */
+	/* consideration for BRIN/bitmap-index, if any */
 	if (indexOpt)
 	{
-		BrinStatsData	statsData;
-		Relation		index_rel;
 		Cost			x;
 
-		index_rel = index_open(indexOpt->indexoid, AccessShareLock);
-		brinGetStats(index_rel, &statsData);
-		index_close(index_rel, AccessShareLock);
-
 		get_tablespace_page_costs(indexOpt->reltablespace,
 								  &spc_rand_page_cost,
 								  &spc_seq_page_cost);
-		index_scan_cost = spc_seq_page_cost * statsData.revmapNumPages;
-		foreach (lc, indexQuals)
+		if (indexOpt->relam == BRIN_AM_OID)
+		{
+			BrinStatsData	statsData;
+			Relation		index_rel;
+
+			index_rel = index_open(indexOpt->indexoid, AccessShareLock);
+			brinGetStats(index_rel, &statsData);
+			index_close(index_rel, AccessShareLock);
+
+			index_scan_cost = spc_seq_page_cost * statsData.revmapNumPages;
+			foreach (lc, indexQuals)
+			{
+				cost_qual_eval_node(&qcost, (Node *)lfirst(lc), root);
+				index_scan_cost += qcost.startup + qcost.per_tuple;
+			}
+		}
+		else
 		{
-			cost_qual_eval_node(&qcost, (Node *)lfirst(lc), root);
-			index_scan_cost += qcost.startup + qcost.per_tuple;
+			Selectivity	index_sel;
+			double		index_ntuples;
+
+			/* bitmap-index scan; also see genericcostestimate */
+			index_sel = clauselist_selectivity(root,
+											   indexQuals,
+											   scan_rel->relid,
+											   JOIN_INNER,
+											   NULL);
+			index_ntuples = clamp_row_est(index_sel * indexOpt->tuples);
+			index_scan_cost = spc_rand_page_cost *
+				ceil(index_sel * (double) indexOpt->pages);
+			cost_qual_eval_node(&qcost, (Node *)indexQuals, root);
+			index_scan_cost += qcost.startup + index_ntuples *
+				(cpu_index_tuple_cost + qcost.per_tuple);
 		}
 
 		x = index_scan_cost + spc_rand_page_cost * (double)indexNBlocks;
@@ -535,13 +632,13 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 		 * be shared with all the worker process, so we can discount the
 		 * cost by parallel_divisor.
 		 */
-		startup_cost += pgstrom_gpu_setup_cost / 2
-			+ (pgstrom_gpu_setup_cost / (2 * parallel_divisor));
+		startup_cost += gpu_setup_cost / 2
+			+ (gpu_setup_cost / (2 * parallel_divisor));
 	}
 	else
 	{
 		parallel_divisor = 1.0;
-		startup_cost += pgstrom_gpu_setup_cost;
+		startup_cost += gpu_setup_cost;
 	}
 	/*
 	 * Cost discount for more efficient I/O with multiplexing.
@@ -596,7 +693,7 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 	ntuples *= selectivity;
 
 	/* Cost for DMA transfer (host/storage --> GPU) */
-	run_cost += pgstrom_gpu_dma_cost * nchunks;
+	run_cost += pgstromGpuDmaCost(cuda_dindex) * nchunks;
 
 	*p_parallel_divisor = parallel_divisor;
 	*p_scan_ntuples = ntuples / parallel_divisor;
@@ -677,7 +774,7 @@ pgstrom_pullup_outer_refs(PlannerInfo *root,
 }
 
 /*
- * pgstromIndexState - runtime status of BRIN-index for relation scan
+ * pgstromIndexState - runtime status of BRIN/bitmap-index for relation scan
  */
 typedef struct pgstromIndexState
 {
@@ -686,8 +783,8 @@ typedef struct pgstromIndexState
 	Node	   *index_quals;	/* for EXPLAIN */
 	BlockNumber	nblocks;
 	BlockNumber	range_sz;
-	BrinRevmap *brin_revmap;
-	BrinDesc   *brin_desc;
+	BrinRevmap *brin_revmap;	/* only BRIN */
+	BrinDesc   *brin_desc;		/* only BRIN */
 	ScanKey		scan_keys;
 	int			num_scan_keys;
 	IndexRuntimeKeyInfo *runtime_keys_info;
@@ -743,12 +840,21 @@ pgstromExecInitBrinIndexMap(GpuTaskState *gts,
 	else
 		pi_state->runtime_econtext = NULL;
 
-	/* BRIN index specific initialization */
 	pi_state->nblocks = RelationGetNumberOfBlocks(relation);
-	pi_state->brin_revmap = brinRevmapInitialize(pi_state->index_rel,
-												 &pi_state->range_sz,
-												 estate->es_snapshot);
-	pi_state->brin_desc = brin_build_desc(pi_state->index_rel);
+	if (pi_state->index_rel->rd_rel->relam == BRIN_AM_OID)
+	{
+		/* BRIN index specific initialization */
+		pi_state->brin_revmap = brinRevmapInitialize(pi_state->index_rel,
+													 &pi_state->range_sz,
+													 estate->es_snapshot);
+		pi_state->brin_desc = brin_build_desc(pi_state->index_rel);
+	}
+	else
+	{
+		/* bitmap-index scan maps every heap block individually */
+		Assert(pi_state->index_rel->rd_amroutine->amgetbitmap != NULL);
+		pi_state->range_sz = 1;
+	}
 
 	/* save the state */
 	gts->outer_index_state = pi_state;
@@ -898,6 +1004,63 @@ __pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
 	brin_map->nwords = nwords;
 }
 
+/*
+ * __pgstromExecGetBitmapIndexMap
+ *
+ * It runs bitmap-index scan, then marks the heap blocks which contain
+ * no matched tuples to be skipped. Lossy pages are fetched as is, because
+ * GPU re-checks all the qualifiers anyway.
+ * Also see MultiExecBitmapIndexScan
+ */
+static void
+__pgstromExecGetBitmapIndexMap(pgstromIndexState *pi_state,
+							   Bitmapset *index_map,
+							   Snapshot snapshot)
+{
+	BlockNumber		nblocks = pi_state->nblocks;
+	IndexScanDesc	iscan;
+	TIDBitmap	   *tbm;
+	TBMIterator	   *tbm_iter;
+	TBMIterateResult *tbm_res;
+	int				nwords;
+
+	nwords = (nblocks + BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
+	Assert(index_map->nwords < 0);
+	memset(index_map->words, ~0, sizeof(bitmapword) * nwords);
+	if (nblocks % BITS_PER_BITMAPWORD != 0)
+		index_map->words[nwords - 1]
+			= ((bitmapword)1 << (nblocks % BITS_PER_BITMAPWORD)) - 1;
+
+	tbm = tbm_create(work_mem * 1024L, NULL);
+	iscan = index_beginscan_bitmap(pi_state->index_rel,
+								   snapshot,
+								   pi_state->num_scan_keys);
+	index_rescan(iscan,
+				 pi_state->scan_keys,
+				 pi_state->num_scan_keys,
+				 NULL, 0);
+	index_getbitmap(iscan, tbm);
+	index_endscan(iscan);
+
+	/* TIDBitmap returns blocks in ascending order */
+	tbm_iter = tbm_begin_iterate(tbm);
+	while ((tbm_res = tbm_iterate(tbm_iter)) != NULL)
+	{
+		BlockNumber	blkno = tbm_res->blockno;
+
+		CHECK_FOR_INTERRUPTS();
+		if (blkno < nblocks)
+			index_map->words[blkno / BITS_PER_BITMAPWORD]
+				&= ~((bitmapword)1 << (blkno % BITS_PER_BITMAPWORD));
+	}
+	tbm_end_iterate(tbm_iter);
+	tbm_free(tbm);
+
+	/* mark this bitmapset is ready */
+	pg_memory_barrier();
+	index_map->nwords = nwords;
+}
+
 void
 pgstromExecGetBrinIndexMap(GpuTaskState *gts)
 {
@@ -921,9 +1084,23 @@ pgstromExecGetBrinIndexMap(GpuTaskState *gts)
 		{
 			if (!IsParallelWorker())
 			{
-				__pgstromExecGetBrinIndexMap(pi_state,
-											 gts->outer_index_map,
-											 estate->es_snapshot);
+				/* evaluate runtime keys, if any */
+				if (pi_state->num_runtime_keys > 0 &&
+					!pi_state->runtime_key_ready)
+				{
+					ExecIndexEvalRuntimeKeys(pi_state->runtime_econtext,
+											 pi_state->runtime_keys_info,
+											 pi_state->num_runtime_keys);
+					pi_state->runtime_key_ready = true;
+				}
+				if (pi_state->brin_desc)
+					__pgstromExecGetBrinIndexMap(pi_state,
+												 gts->outer_index_map,
+												 estate->es_snapshot);
+				else
+					__pgstromExecGetBitmapIndexMap(pi_state,
+												   gts->outer_index_map,
+												   estate->es_snapshot);
 				/* wake up parallel workers if any */
 				if (gts->pcxt)
 				{
@@ -985,7 +1162,8 @@ pgstromExecEndBrinIndexMap(GpuTaskState *gts)
 
 	if (!pi_state)
 		return;
-	brinRevmapTerminate(pi_state->brin_revmap);
+	if (pi_state->brin_revmap)
+		brinRevmapTerminate(pi_state->brin_revmap);
 	index_close(pi_state->index_rel, NoLock);
 }
 
@@ -1002,32 +1180,43 @@ pgstromExplainBrinIndexMap(GpuTaskState *gts,
 						   List *dcontext)
 {
 	pgstromIndexState *pi_state = gts->outer_index_state;
+	const char *label;
 	char	   *conds_str;
 	char		temp[128];
 
 	if (!pi_state)
 		return;
+	label = (pi_state->brin_desc ? "BRIN" : "Bitmap Index");
 
 	conds_str = deparse_expression(pi_state->index_quals,
 								   dcontext, es->verbose, false);
-	ExplainPropertyText("BRIN cond", conds_str, es);
+	snprintf(temp, sizeof(temp), "%s cond", label);
+	ExplainPropertyText(temp, conds_str, es);
+	if (!pi_state->brin_desc)
+		ExplainPropertyText("Bitmap Index",
+							RelationGetRelationName(pi_state->index_rel), es);
 	if (es->analyze)
 	{
+		char	buf[128];
+
 		if (es->format == EXPLAIN_FORMAT_TEXT)
 		{
-			snprintf(temp, sizeof(temp), "%ld of %ld (%.2f%%)",
+			snprintf(buf, sizeof(buf), "%ld of %ld (%.2f%%)",
 					 gts->outer_brin_count,
 					 (long)pi_state->nblocks,
 					 100.0 * ((double) gts->outer_brin_count /
 							  (double) pi_state->nblocks));
-			ExplainPropertyText("BRIN skipped", temp, es);
+			snprintf(temp, sizeof(temp), "%s skipped", label);
+			ExplainPropertyText(temp, buf, es);
 		}
 		else
 		{
-			ExplainPropertyInteger("BRIN fetched", NULL,
+			snprintf(temp, sizeof(temp), "%s fetched", label);
+			ExplainPropertyInteger(temp, NULL,
 								   pi_state->nblocks -
 								   gts->outer_brin_count, es);
-			ExplainPropertyInteger("BRIN skipped", NULL,
+			snprintf(temp, sizeof(temp), "%s skipped", label);
+			ExplainPropertyInteger(temp, NULL,
 								   gts->outer_brin_count, es);
 		}
 	}
@@ -1098,6 +1287,22 @@ mergePDSHeapScanBlockState(pgstrom_data_store *pds,
 									   ioc[iovec->nr_chunks]));
 }
 
+/*
+ * heapscan_nblocks_per_chunk - number of blocks to be loaded onto a PDS of
+ * KDS_FORMAT_BLOCK, according to the adaptive chunk size of the scan.
+ */
+static cl_uint
+heapscan_nblocks_per_chunk(GpuTaskState *gts)
+{
+	NVMEScanState *nvme_sstate = gts->nvme_sstate;
+	double		ratio = ((double)pgstromGpuTaskChunkSize(gts) /
+						 (double)pgstrom_chunk_size());
+	cl_uint		nrooms;
+
+	nrooms = (cl_uint)((double)nvme_sstate->nblocks_per_chunk * ratio);
+	return Min(Max(nrooms, 1), nvme_sstate->nblocks_per_chunk);
+}
+
 static bool
 PDS_exec_heapscan_block(GpuTaskState *gts,
 						pgstrom_data_store *pds,
@@ -1126,12 +1331,20 @@ PDS_exec_heapscan_block(GpuTaskState *gts,
 
 	/*
 	 * NVMe-Strom can be applied only when filesystem supports the feature,
-	 * and the current source block is all-visible.
+	 * and the current source block is all-visible, or device code can check
+	 * visibility of the tuples according to the snapshot (tuples whose
+	 * hint bits are not set yet shall be checked by CPU fallback).
 	 * Elsewhere, we will go fallback with synchronized buffer scan.
 	 */
 	if (RelationCanUseNvmeStrom(relation) &&
-		VM_ALL_VISIBLE(relation, blknum,
-					   &nvme_sstate->curr_vmbuffer))
+		(VM_ALL_VISIBLE(relation, blknum,
+						&nvme_sstate->curr_vmbuffer) ||
+		 (pgstrom_nvme_strom_gpu_visibility &&
+		  pgstrom_cpu_fallback_enabled &&
+		  IsMVCCSnapshot(snapshot) &&
+		  !snapshot->suboverflowed &&
+		  !snapshot->takenDuringRecovery &&
+		  !IsolationIsSerializable())))
 	{
 		BufferTag	newTag;
 		uint32		newHash;
@@ -1237,6 +1450,71 @@ PDS_exec_heapscan_block(GpuTaskState *gts,
 	return true;
 }
 
+/*
+ * pgstromBlockTupleIsVisible
+ *
+ * It checks visibility of the tuple on KDS_FORMAT_BLOCK for CPU fallback.
+ * Blocks loaded by NVMe-Strom may not be all-visible, and their tuples
+ * are not checked by CPU prior to the GPU kernel execution. Unlike
+ * HeapTupleSatisfiesMVCC(), it never sets hint bits because the page is
+ * not on the shared buffer.
+ */
+bool
+pgstromBlockTupleIsVisible(GpuTaskState *gts,
+						   PageHeader hpage,
+						   HeapTupleHeader htup)
+{
+	Snapshot		snapshot = gts->css.ss.ps.state->es_snapshot;
+	TransactionId	xmin = HeapTupleHeaderGetRawXmin(htup);
+	TransactionId	xmax;
+
+	if (PageIsAllVisible((Page) hpage))
+		return true;
+	/* check xmin */
+	if (HeapTupleHeaderXminInvalid(htup))
+		return false;
+	if (!HeapTupleHeaderXminFrozen(htup) &&
+		TransactionIdIsNormal(xmin))
+	{
+		if (TransactionIdIsCurrentTransactionId(xmin))
+		{
+			if (HeapTupleHeaderGetCmin(htup) >= snapshot->curcid)
+				return false;	/* inserted after scan started */
+			if ((htup->t_infomask & HEAP_XMAX_INVALID) != 0 ||
+				HEAP_XMAX_IS_LOCKED_ONLY(htup->t_infomask))
+				return true;
+			if ((htup->t_infomask & HEAP_XMAX_IS_MULTI) != 0)
+				xmax = HeapTupleGetUpdateXid(htup);
+			else
+				xmax = HeapTupleHeaderGetRawXmax(htup);
+			if (!TransactionIdIsCurrentTransactionId(xmax))
+				return true;	/* deleting subtransaction must have aborted */
+			return (HeapTupleHeaderGetCmax(htup) >= snapshot->curcid);
+		}
+		if (XidInMVCCSnapshot(xmin, snapshot))
+			return false;
+		if (!HeapTupleHeaderXminCommitted(htup) &&
+			!TransactionIdDidCommit(xmin))
+			return false;
+	}
+	/* by here, the inserting transaction has committed */
+	if ((htup->t_infomask & HEAP_XMAX_INVALID) != 0 ||
+		HEAP_XMAX_IS_LOCKED_ONLY(htup->t_infomask))
+		return true;
+	if ((htup->t_infomask & HEAP_XMAX_IS_MULTI) != 0)
+		xmax = HeapTupleGetUpdateXid(htup);
+	else if ((htup->t_infomask & HEAP_XMAX_COMMITTED) == 0)
+		xmax = HeapTupleHeaderGetRawXmax(htup);
+	else
+		return XidInMVCCSnapshot(HeapTupleHeaderGetRawXmax(htup), snapshot);
+
+	if (TransactionIdIsCurrentTransactionId(xmax))
+		return (HeapTupleHeaderGetCmax(htup) >= snapshot->curcid);
+	if (XidInMVCCSnapshot(xmax, snapshot))
+		return true;
+	return !TransactionIdDidCommit(xmax);
+}
+
 /*
  * PDS_exec_heapscan_row - PDS scan for KDS_FORMAT_ROW format
  */
@@ -1363,13 +1641,59 @@ heapscan_report_location(HeapScanDesc hscan)
 #endif
 }
 
+/*
+ * heapscan_prefetch_extent
+ *
+ * BRIN-index makes the heap scan skip the ranges that never contain the
+ * matched rows, so kernel's readahead hardly works on the buffered read.
+ * We give hints for the coalesced extent of the valid ranges beginning from
+ * @page, up to the size of a chunk, to keep the i/o sequential.
+ */
+static void
+heapscan_prefetch_extent(GpuTaskState *gts,
+						 Bitmapset *brin_map,
+						 cl_long brin_range_sz,
+						 BlockNumber page,
+						 BlockNumber nblocks)
+{
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	BlockNumber	window = pgstrom_chunk_size() / BLCKSZ;
+	BlockNumber	curr = page;
+	BlockNumber	tail;
+
+	/* already prefetched? */
+	if (page < gts->outer_brin_prefetch &&
+		page + window >= gts->outer_brin_prefetch)
+		return;
+	if (brin_map)
+	{
+		long	pos = page / brin_range_sz;
+
+		tail = page;
+		while (tail < nblocks && tail - page < window &&
+			   !bms_is_member(pos, brin_map))
+		{
+			pos++;
+			tail = Min(pos * brin_range_sz, nblocks);
+		}
+		tail = Min(tail, page + window);
+	}
+	else
+		tail = Min(page + window, nblocks);
+
+	while (curr < tail)
+		PrefetchBuffer(relation, MAIN_FORKNUM, curr++);
+	gts->outer_brin_prefetch = tail;
+}
+
 /*
  * pgstromExecHeapScanChunkParallel - read the heap relation by parallel scan
  */
 static pgstrom_data_store *
 pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 								 Bitmapset *brin_map,
-								 cl_long brin_range_sz)
+								 cl_long brin_range_sz,
+								 pgstrom_data_store *pds_feeder)
 {
 	GpuTaskSharedState *gtss = gts->gtss;
 	Relation			relation = gts->css.ss.ss_currentRelation;
@@ -1423,7 +1747,7 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 			 * number of DMA requests.
 			 */
 			if (!nvme_sstate)
-				nr_blocks = 8;
+				nr_blocks = (brin_map ? Max(brin_range_sz, 8) : 8);
 			else if (pds)
 			{
 				if (pds->kds.nitems >= pds->kds.nrooms)
@@ -1431,7 +1755,7 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 				nr_blocks = pds->kds.nrooms - pds->kds.nitems;
 			}
 			else
-				nr_blocks = nvme_sstate->nblocks_per_chunk;
+				nr_blocks = heapscan_nblocks_per_chunk(gts);
 
 		retry_lock:
 			SpinLockAcquire(&gtss->pbs_mutex);
@@ -1483,6 +1807,24 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 				nr_blocks = RELSEG_SIZE - (page % RELSEG_SIZE);
 			Assert(nr_blocks > 0);
 
+			/*
+			 * In case of columnar cache, block allocation shall be aligned
+			 * to the chunk of ccache, to load the chunk by a worker at once.
+			 */
+			if (gts->ccache_sstate)
+			{
+				cl_long		head = page % CCACHE_CHUNK_NBLOCKS;
+
+				if (head == 0 &&
+					page + CCACHE_CHUNK_NBLOCKS <= (cl_long)hscan->rs_nblocks &&
+					nr_allocated + CCACHE_CHUNK_NBLOCKS <= (cl_long)hscan->rs_nblocks &&
+					(startblock <= page ||
+					 startblock >= page + CCACHE_CHUNK_NBLOCKS))
+					nr_blocks = CCACHE_CHUNK_NBLOCKS;
+				else if (head + nr_blocks > CCACHE_CHUNK_NBLOCKS)
+					nr_blocks = CCACHE_CHUNK_NBLOCKS - head;
+			}
+
 			if (brin_map)
 			{
 				long	pos = page / brin_range_sz;
@@ -1540,8 +1882,42 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 
 			hscan->rs_cblock = page;
 			hscan->rs_numblocks = nr_blocks;
+			/*
+			 * Blocks allocated to this worker are continuous, so we give
+			 * hints to read them by a large i/o, if buffered read with
+			 * BRIN-index.
+			 */
+			if (brin_map && !nvme_sstate && nr_blocks > 0)
+				heapscan_prefetch_extent(gts, NULL, 0, page,
+										 page + nr_blocks);
 			continue;
 		}
+		/* load the columnar cache, if ready */
+		if (gts->ccache_sstate &&
+			(hscan->rs_cblock % CCACHE_CHUNK_NBLOCKS) == 0 &&
+			hscan->rs_numblocks >= CCACHE_CHUNK_NBLOCKS &&
+			pgstrom_ccache_is_ready(gts, hscan->rs_cblock))
+		{
+			pgstrom_data_store *pds_cc;
+
+			if (pds)
+				break;		/* returns the PDS being built first */
+			pds_cc = pgstrom_ccache_load_chunk(gts, hscan->rs_cblock);
+			if (pds_cc)
+			{
+				hscan->rs_numblocks -= CCACHE_CHUNK_NBLOCKS;
+				hscan->rs_cblock += CCACHE_CHUNK_NBLOCKS;
+				if (hscan->rs_cblock >= hscan->rs_nblocks)
+					hscan->rs_cblock = 0;
+				heapscan_report_location(hscan);
+				if (hscan->rs_cblock == hscan->rs_startblock)
+					hscan->rs_cblock = InvalidBlockNumber;
+				if (pds_cc->kds.nitems > 0)
+					return pds_cc;
+				PDS_release(pds_cc);
+				continue;
+			}
+		}
 		/* scan next block */
 		if (gts->nvme_sstate)
 		{
@@ -1550,7 +1926,8 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 			{
 				pds = PDS_create_block(gts->gcontext,
 									   RelationGetDescr(relation),
-									   gts->nvme_sstate);
+									   gts->nvme_sstate,
+									   heapscan_nblocks_per_chunk(gts));
 				pds->kds.table_oid = RelationGetRelid(relation);
 				initPDSHeapScanBlockState(pds, bstate);
 			}
@@ -1562,9 +1939,12 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 			/* KDS_FORMAT_ROW */
 			if (!pds)
 			{
-				pds = PDS_create_row(gts->gcontext,
-									 RelationGetDescr(relation),
-									 pgstrom_chunk_size());
+				if (pds_feeder)
+					pds = pds_feeder;
+				else
+					pds = PDS_create_row(gts->gcontext,
+										 RelationGetDescr(relation),
+										 pgstromGpuTaskChunkSize(gts));
 				pds->kds.table_oid = RelationGetRelid(relation);
 			}
 			if (!PDS_exec_heapscan_row(gts, pds))
@@ -1642,6 +2022,41 @@ pgstromExecHeapScanChunk(GpuTaskState *gts,
 				gts->outer_brin_count += (page - prev);
 				goto skip;
 			}
+			/* hints for the extent of the following valid ranges */
+			if (!gts->nvme_sstate)
+				heapscan_prefetch_extent(gts, brin_map, brin_range_sz,
+										 page, hscan->rs_nblocks);
+		}
+
+		/*
+		 * If columnar cache is already built for the chunk that begins from
+		 * the current block, we load the cache instead of the heap blocks.
+		 */
+		if (gts->ccache_sstate &&
+			(page % CCACHE_CHUNK_NBLOCKS) == 0 &&
+			page + CCACHE_CHUNK_NBLOCKS <= hscan->rs_nblocks &&
+			(hscan->rs_startblock <= page ||
+			 hscan->rs_startblock >= page + CCACHE_CHUNK_NBLOCKS) &&
+			pgstrom_ccache_is_ready(gts, page))
+		{
+			pgstrom_data_store *pds_cc;
+
+			if (pds)
+				break;		/* returns the PDS being built first */
+			pds_cc = pgstrom_ccache_load_chunk(gts, page);
+			if (pds_cc)
+			{
+				hscan->rs_cblock = page + CCACHE_CHUNK_NBLOCKS;
+				if (hscan->rs_cblock >= hscan->rs_nblocks)
+					hscan->rs_cblock = 0;
+				heapscan_report_location(hscan);
+				if (hscan->rs_cblock == hscan->rs_startblock)
+					hscan->rs_cblock = InvalidBlockNumber;
+				if (pds_cc->kds.nitems > 0)
+					return pds_cc;
+				PDS_release(pds_cc);
+				continue;
+			}
 		}
 		/* scan the next block */
 		if (gts->nvme_sstate)
@@ -1650,7 +2065,8 @@ pgstromExecHeapScanChunk(GpuTaskState *gts,
 			{
 				pds =  PDS_create_block(gts->gcontext,
 										RelationGetDescr(rel),
-										gts->nvme_sstate);
+										gts->nvme_sstate,
+										heapscan_nblocks_per_chunk(gts));
 				pds->kds.table_oid = RelationGetRelid(rel);
 				initPDSHeapScanBlockState(pds, bstate);
 			}
@@ -1663,7 +2079,7 @@ pgstromExecHeapScanChunk(GpuTaskState *gts,
 			{
 				pds = PDS_create_row(gts->gcontext,
 									 RelationGetDescr(rel),
-									 pgstrom_chunk_size());
+									 pgstromGpuTaskChunkSize(gts));
 				pds->kds.table_oid = RelationGetRelid(rel);
 			}
 			if (!PDS_exec_heapscan_row(gts, pds))
@@ -1722,6 +2138,8 @@ pgstromExecScanChunk(GpuTaskState *gts)
 		 * only scan.
 		 */
 		PDS_init_heapscan_state(gts);
+		/* Try to load columnar cache, if available */
+		pgstrom_ccache_begin_scan(gts);
 	}
 	InstrStartNode(&gts->outer_instrument);
 	/* Load the BRIN-index bitmap, if any */
@@ -1732,7 +2150,8 @@ pgstromExecScanChunk(GpuTaskState *gts)
 		brin_range_sz = gts->outer_index_state->range_sz;
 
 	if (gts->gtss)
-		pds = pgstromExecHeapScanChunkParallel(gts, brin_map, brin_range_sz);
+		pds = pgstromExecHeapScanChunkParallel(gts, brin_map, brin_range_sz,
+											   NULL);
 	else
 		pds = pgstromExecHeapScanChunk(gts, brin_map, brin_range_sz);
 
@@ -1781,6 +2200,46 @@ pgstromExecScanChunk(GpuTaskState *gts)
 	return pds;
 }
 
+/*
+ * pgstromExecScanChunkFeeder
+ *
+ * It loads the heap blocks onto the supplied @pds, usually located on the
+ * shared memory, without GPU device memory. It is used by the parallel
+ * workers that only prepare the chunks for the GPU executor of the leader.
+ * It returns false on the end of the relation.
+ */
+bool
+pgstromExecScanChunkFeeder(GpuTaskState *gts, pgstrom_data_store *pds)
+{
+	Relation		rel = gts->css.ss.ss_currentRelation;
+	TableScanDesc	tscan = gts->css.ss.ss_currentScanDesc;
+	Bitmapset	   *brin_map;
+	cl_long			brin_range_sz = 0;
+	pgstrom_data_store *pds_result;
+
+	Assert(gts->gtss != NULL);
+	if (!tscan)
+	{
+		tscan = table_beginscan_parallel(rel, &gts->gtss->phscan);
+		gts->css.ss.ss_currentScanDesc = tscan;
+	}
+	Assert(!gts->nvme_sstate && !gts->ccache_sstate);
+	InstrStartNode(&gts->outer_instrument);
+	/* Load the BRIN-index bitmap, if any */
+	if (gts->outer_index_state)
+		pgstromExecGetBrinIndexMap(gts);
+	brin_map = gts->outer_index_map;
+	if (brin_map)
+		brin_range_sz = gts->outer_index_state->range_sz;
+
+	pds_result = pgstromExecHeapScanChunkParallel(gts, brin_map,
+												  brin_range_sz, pds);
+	Assert(!pds_result || pds_result == pds);
+	InstrStopNode(&gts->outer_instrument,
+				  pds_result ? (double)pds->kds.nitems : 0.0);
+	return (pds_result != NULL);
+}
+
 /*
  * pgstromRewindScanChunk
  */
@@ -1790,6 +2249,7 @@ pgstromRewindScanChunk(GpuTaskState *gts)
 	TableScanDesc		tscan = gts->css.ss.ss_currentScanDesc;
 
 	InstrEndLoop(&gts->outer_instrument);
+	gts->outer_brin_prefetch = 0;
 	if (tscan)
 	{
 		table_rescan(tscan, NULL);
@@ -1967,18 +2427,1751 @@ pgstromExplainOuterScan(GpuTaskState *gts,
 }
 
 /*
- * pgstrom_init_relscan
+ * pgstrom_gpu_brin_summarize_new_values
+ *
+ * It summarizes the page ranges of BRIN-index that are not summarized yet,
+ * like brin_summarize_new_values(), but min/max of the ranges are computed
+ * on the GPU device. Heap blocks are loaded onto KDS_FORMAT_BLOCK buffer,
+ * then the generated kernel computes min/max of the indexed columns per
+ * block. The index shall consist of minmax operator classes on the fixed-
+ * length numeric / date and time types.
  */
-void
-pgstrom_init_relscan(void)
+typedef struct
 {
-	/* pg_strom.enable_brin */
-	DefineCustomBoolVariable("pg_strom.enable_brin",
-							 "Enables to use BRIN-index",
-							 NULL,
-							 &pgstrom_enable_brin,
-							 true,
-							 PGC_USERSET,
-                             GUC_NOT_IN_SAMPLE,
-                             NULL, NULL, NULL);
+	BlockNumber	heapBlk;		/* head block of the range */
+	BlockNumber	kds_index;		/* first block index on the KDS */
+	BlockNumber	nblocks;		/* number of blocks loaded */
+	Buffer		phbuf;			/* buffer of the placeholder tuple */
+	OffsetNumber phoff;			/* offset of the placeholder tuple */
+	BrinTuple  *phtup;			/* copy of the placeholder tuple */
+	Size		phsz;
+} gpuBrinRange;
+
+static char *
+gpu_brin_build_kernel_source(Relation heapRel, Relation indexRel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(heapRel);
+	int			nkeys = indexRel->rd_index->indnatts;
+	StringInfoData buf;
+	int			keyno;
+
+	initStringInfo(&buf);
+	appendStringInfo(
+		&buf,
+		"STATIC_INLINE(cl_bool)\n"
+		"__brin_float_lt(cl_double a, cl_double b)\n"
+		"{\n"
+		"  /* NaN is larger than any other values, like PostgreSQL */\n"
+		"  if (isnan(a))\n"
+		"    return false;\n"
+		"  if (isnan(b))\n"
+		"    return true;\n"
+		"  return (a < b);\n"
+		"}\n\n"
+		"KERNEL_FUNCTION(void)\n"
+		"kern_gpu_brin_summarize(kern_data_store *kds,\n"
+		"                        cl_long *results)\n"
+		"{\n"
+		"  cl_uint  block_id;\n\n"
+		"  for (block_id = get_global_id();\n"
+		"       block_id < kds->nitems;\n"
+		"       block_id += get_global_size())\n"
+		"  {\n"
+		"    PageHeaderData *pg_page = KERN_DATA_STORE_BLOCK_PGPAGE(kds, block_id);\n"
+		"    cl_uint   maxoff = PageGetMaxOffsetNumber(pg_page);\n"
+		"    cl_long  *res = results + %d * block_id;\n"
+		"    cl_uint   i;\n",
+		3 * nkeys);
+	for (keyno=0; keyno < nkeys; keyno++)
+	{
+		AttrNumber	anum = indexRel->rd_index->indkey.values[keyno];
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, anum - 1);
+		bool		is_float = (attr->atttypid == FLOAT4OID ||
+								attr->atttypid == FLOAT8OID);
+
+		appendStringInfo(
+			&buf,
+			"    cl_bool   has_values_%d = false;\n"
+			"    cl_bool   has_nulls_%d = false;\n"
+			"    %s  min_%d = 0;\n"
+			"    %s  max_%d = 0;\n",
+			keyno, keyno,
+			is_float ? "cl_double" : "cl_long  ", keyno,
+			is_float ? "cl_double" : "cl_long  ", keyno);
+	}
+	appendStringInfo(
+		&buf,
+		"\n"
+		"    for (i=0; i < maxoff; i++)\n"
+		"    {\n"
+		"      ItemIdData *lpp = &pg_page->pd_linp[i];\n"
+		"      HeapTupleHeaderData *htup;\n"
+		"      void   *addr;\n\n"
+		"      if (!ItemIdIsNormal(lpp))\n"
+		"        continue;\n"
+		"      htup = (HeapTupleHeaderData *)PageGetItem(pg_page, lpp);\n");
+	for (keyno=0; keyno < nkeys; keyno++)
+	{
+		AttrNumber	anum = indexRel->rd_index->indkey.values[keyno];
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, anum - 1);
+		const char *ctype;
+		bool		is_float = false;
+
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+				ctype = "cl_short";
+				break;
+			case INT4OID:
+			case DATEOID:
+				ctype = "cl_int";
+				break;
+			case FLOAT4OID:
+				ctype = "cl_float";
+				is_float = true;
+				break;
+			case FLOAT8OID:
+				ctype = "cl_double";
+				is_float = true;
+				break;
+			default:
+				ctype = "cl_long";
+				break;
+		}
+		appendStringInfo(
+			&buf,
+			"      addr = kern_get_datum_tuple(kds->colmeta, htup, %d);\n"
+			"      if (!addr)\n"
+			"        has_nulls_%d = true;\n"
+			"      else\n"
+			"      {\n"
+			"        %s  v = *((%s *)addr);\n\n"
+			"        if (!has_values_%d)\n"
+			"        {\n"
+			"          min_%d = max_%d = v;\n"
+			"          has_values_%d = true;\n"
+			"        }\n",
+			anum - 1,
+			keyno,
+			is_float ? "cl_double" : "cl_long", ctype,
+			keyno,
+			keyno, keyno,
+			keyno);
+		if (is_float)
+			appendStringInfo(
+				&buf,
+				"        else\n"
+				"        {\n"
+				"          if (__brin_float_lt(v, min_%d))\n"
+				"            min_%d = v;\n"
+				"          if (__brin_float_lt(max_%d, v))\n"
+				"            max_%d = v;\n"
+				"        }\n"
+				"      }\n",
+				keyno, keyno, keyno, keyno);
+		else
+			appendStringInfo(
+				&buf,
+				"        else\n"
+				"        {\n"
+				"          if (v < min_%d)\n"
+				"            min_%d = v;\n"
+				"          if (v > max_%d)\n"
+				"            max_%d = v;\n"
+				"        }\n"
+				"      }\n",
+				keyno, keyno, keyno, keyno);
+	}
+	appendStringInfo(&buf, "    }\n");
+	for (keyno=0; keyno < nkeys; keyno++)
+	{
+		AttrNumber	anum = indexRel->rd_index->indkey.values[keyno];
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, anum - 1);
+		bool		is_float = (attr->atttypid == FLOAT4OID ||
+								attr->atttypid == FLOAT8OID);
+
+		appendStringInfo(
+			&buf,
+			"    res[%d] = ((has_values_%d ? 1 : 0) | (has_nulls_%d ? 2 : 0));\n",
+			3 * keyno, keyno, keyno);
+		if (is_float)
+			appendStringInfo(
+				&buf,
+				"    res[%d] = __double_as_longlong(min_%d);\n"
+				"    res[%d] = __double_as_longlong(max_%d);\n",
+				3 * keyno + 1, keyno,
+				3 * keyno + 2, keyno);
+		else
+			appendStringInfo(
+				&buf,
+				"    res[%d] = min_%d;\n"
+				"    res[%d] = max_%d;\n",
+				3 * keyno + 1, keyno,
+				3 * keyno + 2, keyno);
+	}
+	appendStringInfo(&buf, "  }\n}\n");
+
+	return buf.data;
+}
+
+/*
+ * gpu_brin_check_index - checks whether BRIN-index is supported
+ */
+static void
+gpu_brin_check_index(Relation heapRel, Relation indexRel, BrinDesc *bdesc)
+{
+	TupleDesc	tupdesc = RelationGetDescr(heapRel);
+	int			keyno;
+
+	for (keyno=0; keyno < indexRel->rd_index->indnatts; keyno++)
+	{
+		AttrNumber	anum = indexRel->rd_index->indkey.values[keyno];
+		Form_pg_attribute attr;
+
+		if (anum <= 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("BRIN-index \"%s\" has expression key, not supported on GPU",
+							RelationGetRelationName(indexRel)),
+					 errhint("use brin_summarize_new_values() instead")));
+		if (index_getprocid(indexRel, keyno + 1,
+							BRIN_PROCNUM_OPCINFO) != F_BRIN_MINMAX_OPCINFO)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("BRIN-index \"%s\" has non-minmax operator class, not supported on GPU",
+							RelationGetRelationName(indexRel)),
+					 errhint("use brin_summarize_new_values() instead")));
+		attr = tupleDescAttr(tupdesc, anum - 1);
+		if (bdesc->bd_info[keyno]->oi_typcache[0]->type_id != attr->atttypid)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("BRIN-index \"%s\" stores %s values for column \"%s\", not supported on GPU",
+							RelationGetRelationName(indexRel),
+							format_type_be(bdesc->bd_info[keyno]->oi_typcache[0]->type_id),
+							NameStr(attr->attname))));
+#if PG_VERSION_NUM >= 110000
+		if (attr->atthasmissing)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("column \"%s\" has missing values by ALTER TABLE ADD COLUMN, not supported on GPU",
+							NameStr(attr->attname)),
+					 errhint("use brin_summarize_new_values() instead")));
+#endif
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+			case DATEOID:
+			case TIMEOID:
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+				break;
+			default:
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("BRIN-index \"%s\" on %s column is not supported on GPU",
+								RelationGetRelationName(indexRel),
+								format_type_be(attr->atttypid)),
+						 errhint("use brin_summarize_new_values() instead")));
+		}
+	}
+}
+
+/*
+ * gpu_brin_union_tuples - also see union_tuples() in brin.c
+ */
+static void
+gpu_brin_union_tuples(BrinDesc *bdesc, BrinMemTuple *a, BrinTuple *b)
+{
+	BrinMemTuple *db = brin_deform_tuple(bdesc, b, NULL);
+	int			keyno;
+
+	for (keyno=0; keyno < bdesc->bd_tupdesc->natts; keyno++)
+	{
+		BrinValues *col_a = &a->bt_columns[keyno];
+		BrinValues *col_b = &db->bt_columns[keyno];
+		FmgrInfo   *unionFn;
+
+		if (col_b->bv_hasnulls)
+			col_a->bv_hasnulls = true;
+		if (col_b->bv_allnulls)
+			continue;
+		if (col_a->bv_allnulls)
+		{
+			/* all the supported types are pass-by-value */
+			col_a->bv_allnulls = false;
+			col_a->bv_values[0] = col_b->bv_values[0];
+			col_a->bv_values[1] = col_b->bv_values[1];
+			continue;
+		}
+		unionFn = index_getprocinfo(bdesc->bd_index, keyno + 1,
+									BRIN_PROCNUM_UNION);
+		FunctionCall3Coll(unionFn,
+						  bdesc->bd_index->rd_indcollation[keyno],
+						  PointerGetDatum(bdesc),
+						  PointerGetDatum(col_a),
+						  PointerGetDatum(col_b));
+	}
+}
+
+/*
+ * gpu_brin_update_range
+ *
+ * It replaces the placeholder tuple by the summary built from the results
+ * of GPU kernel; also see summarize_range() in brin.c
+ */
+static void
+gpu_brin_update_range(Relation heapRel, Relation indexRel,
+					  BrinDesc *bdesc, BrinRevmap *revmap,
+					  BlockNumber range_sz,
+					  gpuBrinRange *brange, cl_long *results)
+{
+	TupleDesc	tupdesc = RelationGetDescr(heapRel);
+	int			nkeys = indexRel->rd_index->indnatts;
+	BrinMemTuple *dtup = brin_new_memtuple(bdesc);
+	BlockNumber	i;
+	int			keyno;
+
+	for (keyno=0; keyno < nkeys; keyno++)
+	{
+		AttrNumber	anum = indexRel->rd_index->indkey.values[keyno];
+		Oid			atttypid = tupleDescAttr(tupdesc, anum - 1)->atttypid;
+		BrinValues *bval = &dtup->bt_columns[keyno];
+		bool		has_values = false;
+		bool		has_nulls = false;
+		cl_long		ival_min = 0, ival_max = 0;
+		cl_double	fval_min = 0.0, fval_max = 0.0;
+
+		for (i=0; i < brange->nblocks; i++)
+		{
+			cl_long	   *res = results + 3 * (nkeys * (brange->kds_index + i) + keyno);
+
+			if ((res[0] & 2) != 0)
+				has_nulls = true;
+			if ((res[0] & 1) == 0)
+				continue;
+			if (atttypid == FLOAT4OID || atttypid == FLOAT8OID)
+			{
+				cl_double	fmin, fmax;
+
+				memcpy(&fmin, &res[1], sizeof(cl_double));
+				memcpy(&fmax, &res[2], sizeof(cl_double));
+				if (!has_values)
+				{
+					fval_min = fmin;
+					fval_max = fmax;
+				}
+				else
+				{
+					/* NaN is larger than any other values */
+					if (!isnan(fmin) && (isnan(fval_min) || fmin < fval_min))
+						fval_min = fmin;
+					if (!isnan(fval_max) && (isnan(fmax) || fmax > fval_max))
+						fval_max = fmax;
+				}
+			}
+			else if (!has_values)
+			{
+				ival_min = res[1];
+				ival_max = res[2];
+			}
+			else
+			{
+				ival_min = Min(ival_min, res[1]);
+				ival_max = Max(ival_max, res[2]);
+			}
+			has_values = true;
+		}
+		bval->bv_hasnulls = has_nulls;
+		bval->bv_allnulls = !has_values;
+		if (!has_values)
+			continue;
+		switch (atttypid)
+		{
+			case INT2OID:
+				bval->bv_values[0] = Int16GetDatum((int16)ival_min);
+				bval->bv_values[1] = Int16GetDatum((int16)ival_max);
+				break;
+			case INT4OID:
+				bval->bv_values[0] = Int32GetDatum((int32)ival_min);
+				bval->bv_values[1] = Int32GetDatum((int32)ival_max);
+				break;
+			case DATEOID:
+				bval->bv_values[0] = DateADTGetDatum((DateADT)ival_min);
+				bval->bv_values[1] = DateADTGetDatum((DateADT)ival_max);
+				break;
+			case FLOAT4OID:
+				bval->bv_values[0] = Float4GetDatum((float4)fval_min);
+				bval->bv_values[1] = Float4GetDatum((float4)fval_max);
+				break;
+			case FLOAT8OID:
+				bval->bv_values[0] = Float8GetDatum(fval_min);
+				bval->bv_values[1] = Float8GetDatum(fval_max);
+				break;
+			default:	/* int8, time, timestamp, timestamptz */
+				bval->bv_values[0] = Int64GetDatum(ival_min);
+				bval->bv_values[1] = Int64GetDatum(ival_max);
+				break;
+		}
+	}
+
+	for (;;)
+	{
+		BrinTuple  *newtup;
+		Size		newsz;
+		bool		samepage;
+		bool		didupdate;
+
+		CHECK_FOR_INTERRUPTS();
+
+		newtup = brin_form_tuple(bdesc, brange->heapBlk, dtup, &newsz);
+		samepage = brin_can_do_samepage_update(brange->phbuf,
+											   brange->phsz, newsz);
+		didupdate = brin_doupdate(indexRel, range_sz, revmap,
+								  brange->heapBlk,
+								  brange->phbuf, brange->phoff,
+								  brange->phtup, brange->phsz,
+								  newtup, newsz, samepage);
+		brin_free_tuple(brange->phtup);
+		brin_free_tuple(newtup);
+		brange->phtup = NULL;
+		if (didupdate)
+			break;
+
+		/*
+		 * The placeholder tuple was updated by the concurrent insertion,
+		 * so merge it to the summary by GPU, then retry.
+		 */
+		brange->phtup = brinGetTupleForHeapBlock(revmap, brange->heapBlk,
+												 &brange->phbuf,
+												 &brange->phoff,
+												 &brange->phsz,
+												 BUFFER_LOCK_SHARE,
+												 NULL);
+		if (!brange->phtup)
+			elog(ERROR, "missing placeholder tuple");
+		brange->phtup = brin_copy_tuple(brange->phtup, brange->phsz,
+										NULL, NULL);
+		LockBuffer(brange->phbuf, BUFFER_LOCK_UNLOCK);
+		gpu_brin_union_tuples(bdesc, dtup, brange->phtup);
+	}
+}
+
+Datum
+pgstrom_gpu_brin_summarize_new_values(PG_FUNCTION_ARGS)
+{
+	Oid			indexoid = PG_GETARG_OID(0);
+	Oid			heapoid;
+	Relation	heapRel;
+	Relation	indexRel;
+	BrinDesc   *bdesc;
+	BrinRevmap *revmap;
+	BlockNumber	range_sz;
+	BlockNumber	heapBlk;
+	BlockNumber	nblocks;
+	BlockNumber	nrooms;
+	BufferAccessStrategy strategy;
+	GpuContext *gcontext = NULL;
+	ProgramId	program_id = INVALID_PROGRAM_ID;
+	CUdeviceptr	m_kds = 0UL;
+	CUdeviceptr	m_results = 0UL;
+	kern_data_store *kds;
+	gpuBrinRange *branges;
+	MemoryContext perBatchCxt;
+	MemoryContext oldcxt;
+	size_t		length;
+	char	   *kern_source;
+	int			nkeys;
+	int			count = 0;
+
+	if (RecoveryInProgress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("recovery is in progress"),
+				 errhint("BRIN control functions cannot be executed during recovery.")));
+	/* like brin_summarize_range(), lock the table prior to the index */
+	heapoid = IndexGetRelation(indexoid, true);
+	if (OidIsValid(heapoid))
+		heapRel = table_open(heapoid, ShareUpdateExclusiveLock);
+	else
+		heapRel = NULL;
+	indexRel = index_open(indexoid, ShareUpdateExclusiveLock);
+	if (indexRel->rd_rel->relkind != RELKIND_INDEX ||
+		indexRel->rd_rel->relam != BRIN_AM_OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a BRIN index",
+						RelationGetRelationName(indexRel))));
+	if (!heapRel || heapoid != IndexGetRelation(indexoid, false))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_TABLE),
+				 errmsg("could not open parent table of index %s",
+						RelationGetRelationName(indexRel))));
+	if (!pg_class_ownercheck(indexoid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, OBJECT_INDEX,
+					   RelationGetRelationName(indexRel));
+
+	bdesc = brin_build_desc(indexRel);
+	gpu_brin_check_index(heapRel, indexRel, bdesc);
+	revmap = brinRevmapInitialize(indexRel, &range_sz, NULL);
+	nkeys = indexRel->rd_index->indnatts;
+	strategy = GetAccessStrategy(BAS_BULKREAD);
+	perBatchCxt = AllocSetContextCreate(CurrentMemoryContext,
+										"GPU BRIN summarization",
+										ALLOCSET_DEFAULT_SIZES);
+	/* number of blocks per batch; by multiple ranges, at least one range */
+	nrooms = (pgstrom_chunk_size() / BLCKSZ / range_sz) * range_sz;
+	if (nrooms < range_sz)
+		nrooms = range_sz;
+	length = (KDS_calculateHeadSize(RelationGetDescr(heapRel)) +
+			  STROMALIGN(sizeof(BlockNumber) * nrooms) +
+			  BLCKSZ * (size_t)nrooms);
+	branges = palloc0(sizeof(gpuBrinRange) * (nrooms / range_sz));
+
+	PG_TRY();
+	{
+		CUmodule	cuda_module;
+		CUfunction	kern_summarize;
+		CUresult	rc;
+		int			grid_sz;
+		int			block_sz;
+
+		gcontext = AllocGpuContext(-1, true, false);
+		kern_source = gpu_brin_build_kernel_source(heapRel, indexRel);
+		program_id = pgstrom_create_cuda_program(gcontext,
+												 0,
+												 0,
+												 kern_source,
+												 "",
+												 true,
+												 false);
+		cuda_module = GpuContextLookupModule(gcontext, program_id);
+		rc = cuModuleGetFunction(&kern_summarize,
+								 cuda_module,
+								 "kern_gpu_brin_summarize");
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+		rc = gpuOptimalBlockSize(&grid_sz,
+								 &block_sz,
+								 kern_summarize,
+								 gcontext->cuda_device,
+								 0, 0);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+
+		rc = gpuMemAllocManaged(gcontext, &m_kds, length,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+		rc = gpuMemAllocManaged(gcontext, &m_results,
+								sizeof(cl_long) * 3 * nkeys * nrooms,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+		kds = (kern_data_store *)m_kds;
+
+		heapBlk = 0;
+		for (;;)
+		{
+			int			nranges = 0;
+			int			k;
+			void	   *kern_args[2];
+			Buffer		buf = InvalidBuffer;
+
+			oldcxt = MemoryContextSwitchTo(perBatchCxt);
+			init_kernel_data_store(kds, RelationGetDescr(heapRel), length,
+								   KDS_FORMAT_BLOCK, nrooms);
+			/*
+			 * Insert the placeholder tuples for the ranges not summarized
+			 * yet, prior to the read of heap blocks. So, concurrent insertion
+			 * shall update the placeholder, or shall be visible to us.
+			 */
+			nblocks = RelationGetNumberOfBlocks(heapRel);
+			for (; heapBlk < nblocks &&
+					 (nranges + 1) * range_sz <= nrooms;
+				 heapBlk += range_sz)
+			{
+				gpuBrinRange *brange = &branges[nranges];
+				BrinTuple  *tup;
+				OffsetNumber off;
+
+				CHECK_FOR_INTERRUPTS();
+
+				tup = brinGetTupleForHeapBlock(revmap, heapBlk, &buf, &off,
+											   NULL, BUFFER_LOCK_SHARE, NULL);
+				if (tup)
+				{
+					/* already summarized */
+					LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+					continue;
+				}
+				memset(brange, 0, sizeof(gpuBrinRange));
+				brange->heapBlk = heapBlk;
+				brange->phbuf = InvalidBuffer;
+				brange->phtup = brin_form_placeholder_tuple(bdesc, heapBlk,
+															&brange->phsz);
+				brange->phoff = brin_doinsert(indexRel, range_sz, revmap,
+											  &brange->phbuf, heapBlk,
+											  brange->phtup, brange->phsz);
+				nranges++;
+			}
+			if (buf != InvalidBuffer)
+				ReleaseBuffer(buf);
+			if (nranges == 0)
+			{
+				MemoryContextSwitchTo(oldcxt);
+				break;
+			}
+
+			/* load the heap blocks onto the KDS */
+			nblocks = RelationGetNumberOfBlocks(heapRel);
+			for (k=0; k < nranges; k++)
+			{
+				gpuBrinRange *brange = &branges[k];
+				BlockNumber	blkno;
+
+				brange->kds_index = kds->nitems;
+				for (blkno = brange->heapBlk;
+					 blkno < Min(brange->heapBlk + range_sz, nblocks);
+					 blkno++)
+				{
+					Buffer		hbuf;
+
+					CHECK_FOR_INTERRUPTS();
+
+					hbuf = ReadBufferExtended(heapRel, MAIN_FORKNUM, blkno,
+											  RBM_NORMAL, strategy);
+					LockBuffer(hbuf, BUFFER_LOCK_SHARE);
+					memcpy(KERN_DATA_STORE_BLOCK_PGPAGE(kds, kds->nitems),
+						   BufferGetPage(hbuf), BLCKSZ);
+					UnlockReleaseBuffer(hbuf);
+					KERN_DATA_STORE_BLOCK_BLCKNR(kds, kds->nitems) = blkno;
+					kds->nitems++;
+					brange->nblocks++;
+				}
+			}
+
+			/* kick the kernel to summarize the blocks */
+			if (kds->nitems > 0)
+			{
+				kern_args[0] = &m_kds;
+				kern_args[1] = &m_results;
+				rc = cuLaunchKernel(kern_summarize,
+									grid_sz, 1, 1,
+									block_sz, 1, 1,
+									0,
+									CU_STREAM_PER_THREAD,
+									kern_args,
+									NULL);
+				if (rc != CUDA_SUCCESS)
+					elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+				rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+				if (rc != CUDA_SUCCESS)
+					elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+			}
+
+			/* replace the placeholders by the summary */
+			for (k=0; k < nranges; k++)
+			{
+				gpu_brin_update_range(heapRel, indexRel, bdesc, revmap,
+									  range_sz, &branges[k],
+									  (cl_long *)m_results);
+				ReleaseBuffer(branges[k].phbuf);
+				count++;
+			}
+			MemoryContextSwitchTo(oldcxt);
+			MemoryContextReset(perBatchCxt);
+		}
+		gpuMemFree(gcontext, m_results);
+		gpuMemFree(gcontext, m_kds);
+		pgstrom_put_cuda_program(gcontext, program_id);
+		PutGpuContext(gcontext);
+	}
+	PG_CATCH();
+	{
+		if (gcontext)
+		{
+			if (m_results)
+				gpuMemFree(gcontext, m_results);
+			if (m_kds)
+				gpuMemFree(gcontext, m_kds);
+			if (program_id != INVALID_PROGRAM_ID)
+				pgstrom_put_cuda_program(gcontext, program_id);
+			PutGpuContext(gcontext);
+		}
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	FreeAccessStrategy(strategy);
+	brinRevmapTerminate(revmap);
+	brin_free_desc(bdesc);
+	MemoryContextDelete(perBatchCxt);
+
+	index_close(indexRel, ShareUpdateExclusiveLock);
+	table_close(heapRel, ShareUpdateExclusiveLock);
+
+	PG_RETURN_INT32(count);
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_brin_summarize_new_values);
+
+/*
+ * pgstrom_gpu_btree_build
+ *
+ * It rebuilds the specified B-tree index like REINDEX INDEX, but the index
+ * entries are sorted on the GPU device. The build scan of the heap (that
+ * also handles HOT chains, partial and expression indexes) encodes every
+ * entry to a record of order-preserving 64bit words, then the records are
+ * sorted on the GPU device per chunk by the bitonic sorting kernel. The
+ * sorted chunks are merged on CPU, then written to the leaf pages in
+ * order, and the upper levels are built from the left to the right; like
+ * the bulk loader of nbtree (nbtsort.c), but its functions are not exposed
+ * to extensions.
+ * The index shall consist of the default operator classes on the fixed-
+ * length numeric / date and time types. The index is written in the B-tree
+ * version 3 format, which is readable by any PostgreSQL v11 or later.
+ */
+#if PG_VERSION_NUM >= 110000
+#define GPU_BTREE_MAX_KEYS				8
+#define GPU_BTREE_RECORD_NWORDS(nkeys)	(2 * (nkeys) + 1)
+
+typedef struct
+{
+	CUdeviceptr	m_chunk;		/* records + rindex on the managed memory */
+	cl_ulong   *records;
+	cl_uint	   *rindex;			/* index of the records; to be sorted */
+	cl_uint		nitems;
+	cl_uint		curpos;			/* current position for k-way merge */
+} gpuBtreeChunk;
+
+typedef struct
+{
+	Relation	indexRel;
+	int			nkeys;
+	cl_uint		nwords;			/* GPU_BTREE_RECORD_NWORDS(nkeys) */
+	Oid			keytypes[GPU_BTREE_MAX_KEYS];
+	bool		desc[GPU_BTREE_MAX_KEYS];
+	bool		nulls_first[GPU_BTREE_MAX_KEYS];
+	GpuContext *gcontext;
+	CUfunction	kern_bitonic;
+	int			grid_sz;
+	int			block_sz;
+	cl_uint		chunk_nrooms;
+	int			num_chunks;
+	int			max_chunks;
+	gpuBtreeChunk *chunks;
+	double		indtuples;
+} gpuBtreeBuildState;
+
+/*
+ * per-level state of the B-tree pages being built
+ */
+typedef struct gpuBtreePageState
+{
+	Page		page;			/* current page being filled */
+	BlockNumber	blkno;			/* block number of the current page */
+	IndexTuple	minkey;			/* copy of the minimum key on the page */
+	OffsetNumber lastoff;		/* last item offset loaded */
+	uint32		level;			/* tree level (0 = leaf) */
+	Size		full;			/* "full" if less than this much free space */
+	struct gpuBtreePageState *next;	/* link to the parent level, if any */
+} gpuBtreePageState;
+
+typedef struct
+{
+	Relation	indexRel;
+	bool		use_wal;		/* dump the pages to WAL? */
+	BlockNumber	pages_alloced;	/* # of pages allocated so far */
+	BlockNumber	pages_written;	/* # of pages written out so far */
+	Page		zeropage;		/* workspace for filling zeroes */
+	gpuBtreePageState *leaf;	/* state of the leaf level */
+} gpuBtreeWriteState;
+
+/*
+ * gpu_btree_check_index
+ */
+static void
+gpu_btree_check_index(Relation heapRel, Relation indexRel)
+{
+	TupleDesc	tupdesc = RelationGetDescr(indexRel);
+	int			nkeys = IndexRelationGetNumberOfKeyAttributes(indexRel);
+	int			keyno;
+
+	if (IsSystemRelation(heapRel))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("B-tree index \"%s\" on the system catalog is not supported on GPU",
+						RelationGetRelationName(indexRel)),
+				 errhint("use REINDEX INDEX instead")));
+	if (indexRel->rd_index->indisunique ||
+		indexRel->rd_index->indisexclusion)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("B-tree index \"%s\" has unique or exclusion constraint, not supported on GPU",
+						RelationGetRelationName(indexRel)),
+				 errhint("use REINDEX INDEX instead")));
+	if (nkeys != IndexRelationGetNumberOfAttributes(indexRel))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("B-tree index \"%s\" has INCLUDE columns, not supported on GPU",
+						RelationGetRelationName(indexRel)),
+				 errhint("use REINDEX INDEX instead")));
+	if (nkeys > GPU_BTREE_MAX_KEYS)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("B-tree index \"%s\" has too many keys (%d), not supported on GPU",
+						RelationGetRelationName(indexRel), nkeys),
+				 errhint("use REINDEX INDEX instead")));
+	for (keyno=0; keyno < nkeys; keyno++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, keyno);
+		Oid			opclass;
+
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case FLOAT4OID:
+			case FLOAT8OID:
+			case DATEOID:
+			case TIMEOID:
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+				break;
+			default:
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("B-tree index \"%s\" on %s key is not supported on GPU",
+								RelationGetRelationName(indexRel),
+								format_type_be(attr->atttypid)),
+						 errhint("use REINDEX INDEX instead")));
+		}
+		opclass = GetDefaultOpClass(attr->atttypid, BTREE_AM_OID);
+		if (!OidIsValid(opclass) ||
+			get_opclass_family(opclass) != indexRel->rd_opfamily[keyno])
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("B-tree index \"%s\" has non-default operator class, not supported on GPU",
+							RelationGetRelationName(indexRel)),
+					 errhint("use REINDEX INDEX instead")));
+	}
+}
+
+/*
+ * gpu_btree_encode_datum / gpu_btree_decode_datum
+ *
+ * Order-preserving conversion between the datum and 64bit unsigned word.
+ * It is also used by gpu_analyze.c. Sign bit of the integers is flipped. Floating-point values are promoted
+ * to double, then all the bits are flipped if negative, or only the sign
+ * bit is flipped elsewhere. NaN is normalized to be larger than any other
+ * values, like PostgreSQL.
+ */
+cl_ulong
+gpu_btree_encode_datum(Oid type_oid, Datum datum)
+{
+	union {
+		cl_double	fval;
+		cl_ulong	ival;
+	} u;
+
+	switch (type_oid)
+	{
+		case BOOLOID:
+			return (DatumGetBool(datum) ? 1UL : 0UL);
+		case INT2OID:
+			return (cl_ulong)((cl_long)DatumGetInt16(datum)) ^ (1UL << 63);
+		case INT4OID:
+		case DATEOID:
+			return (cl_ulong)((cl_long)DatumGetInt32(datum)) ^ (1UL << 63);
+		case INT8OID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return (cl_ulong)DatumGetInt64(datum) ^ (1UL << 63);
+		case FLOAT4OID:
+		case FLOAT8OID:
+			if (type_oid == FLOAT4OID)
+				u.fval = (cl_double)DatumGetFloat4(datum);
+			else
+				u.fval = DatumGetFloat8(datum);
+			if (isnan(u.fval))
+				u.ival = 0x7ff8000000000000UL;
+			if ((u.ival & (1UL << 63)) != 0)
+				return ~u.ival;
+			return u.ival | (1UL << 63);
+		default:
+			elog(ERROR, "Bug? unexpected key type: %s",
+				 format_type_be(type_oid));
+	}
+}
+
+Datum
+gpu_btree_decode_datum(Oid type_oid, cl_ulong value)
+{
+	union {
+		cl_double	fval;
+		cl_ulong	ival;
+	} u;
+
+	switch (type_oid)
+	{
+		case BOOLOID:
+			return BoolGetDatum(value != 0);
+		case INT2OID:
+			return Int16GetDatum((cl_long)(value ^ (1UL << 63)));
+		case INT4OID:
+		case DATEOID:
+			return Int32GetDatum((cl_long)(value ^ (1UL << 63)));
+		case INT8OID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return Int64GetDatum((cl_long)(value ^ (1UL << 63)));
+		case FLOAT4OID:
+		case FLOAT8OID:
+			if ((value & (1UL << 63)) != 0)
+				u.ival = (value & ~(1UL << 63));
+			else
+				u.ival = ~value;
+			if (type_oid == FLOAT4OID)
+				return Float4GetDatum((cl_float)u.fval);
+			return Float8GetDatum(u.fval);
+		default:
+			elog(ERROR, "Bug? unexpected key type: %s",
+				 format_type_be(type_oid));
+	}
+}
+
+/*
+ * gpu_btree_build_kernel_source
+ */
+static char *
+gpu_btree_build_kernel_source(cl_uint nwords)
+{
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	appendStringInfo(
+		&buf,
+		"#define GPU_BTREE_NWORDS  %u\n\n"
+		"/*\n"
+		" * A step of the bitonic sorting network; the first step of the\n"
+		" * every block compares the mirrored items (reversing), then the\n"
+		" * following steps compare the items by unit_sz. As all the steps\n"
+		" * sort the items in ascending order, items beyond the nitems never\n"
+		" * move, so nitems can be any numbers.\n"
+		" */\n"
+		"KERNEL_FUNCTION(void)\n"
+		"kern_gpu_btree_bitonic_step(const cl_ulong *records,\n"
+		"                            cl_uint *rindex,\n"
+		"                            cl_uint nitems,\n"
+		"                            cl_uint block_sz,\n"
+		"                            cl_uint unit_sz,\n"
+		"                            cl_bool reversing)\n"
+		"{\n"
+		"  cl_uint  x;\n\n"
+		"  for (x = get_global_id();\n"
+		"       x < nitems;\n"
+		"       x += get_global_size())\n"
+		"  {\n"
+		"    cl_uint  y = (reversing ? (x ^ (block_sz - 1)) : (x ^ unit_sz));\n"
+		"    const cl_ulong *x_rec;\n"
+		"    const cl_ulong *y_rec;\n"
+		"    cl_uint  x_index;\n"
+		"    cl_uint  y_index;\n"
+		"    cl_uint  i;\n\n"
+		"    if (y <= x || y >= nitems)\n"
+		"      continue;\n"
+		"    x_index = rindex[x];\n"
+		"    y_index = rindex[y];\n"
+		"    x_rec = records + (size_t)GPU_BTREE_NWORDS * x_index;\n"
+		"    y_rec = records + (size_t)GPU_BTREE_NWORDS * y_index;\n"
+		"    for (i=0; i < GPU_BTREE_NWORDS; i++)\n"
+		"    {\n"
+		"      if (x_rec[i] < y_rec[i])\n"
+		"        break;\n"
+		"      if (x_rec[i] > y_rec[i])\n"
+		"      {\n"
+		"        rindex[x] = y_index;\n"
+		"        rindex[y] = x_index;\n"
+		"        break;\n"
+		"      }\n"
+		"    }\n"
+		"  }\n"
+		"}\n",
+		nwords);
+	return buf.data;
+}
+
+/*
+ * gpu_btree_sort_chunk - sorts the current chunk on GPU
+ */
+static void
+gpu_btree_sort_chunk(gpuBtreeBuildState *bstate, gpuBtreeChunk *chunk)
+{
+	CUdeviceptr	m_records = (CUdeviceptr) chunk->records;
+	CUdeviceptr	m_rindex = (CUdeviceptr) chunk->rindex;
+	cl_uint		nitems = chunk->nitems;
+	cl_uint		block_sz;
+	cl_uint		unit_sz;
+	cl_bool		reversing;
+	void	   *kern_args[6];
+	int			grid_sz;
+	CUresult	rc;
+
+	if (nitems < 2)
+		return;
+	grid_sz = Min(bstate->grid_sz,
+				  (nitems + bstate->block_sz - 1) / bstate->block_sz);
+	kern_args[0] = &m_records;
+	kern_args[1] = &m_rindex;
+	kern_args[2] = &nitems;
+	kern_args[3] = &block_sz;
+	kern_args[4] = &unit_sz;
+	kern_args[5] = &reversing;
+	for (block_sz = 2; block_sz / 2 < nitems; block_sz *= 2)
+	{
+		for (unit_sz = block_sz / 2; unit_sz > 0; unit_sz /= 2)
+		{
+			reversing = (unit_sz == block_sz / 2);
+			rc = cuLaunchKernel(bstate->kern_bitonic,
+								grid_sz, 1, 1,
+								bstate->block_sz, 1, 1,
+								0,
+								CU_STREAM_PER_THREAD,
+								kern_args,
+								NULL);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+		}
+	}
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+}
+
+/*
+ * gpu_btree_build_callback - callback of the index build scan
+ */
+static void
+#if PG_VERSION_NUM >= 130000
+gpu_btree_build_callback(Relation index,
+						 ItemPointer tid,
+						 Datum *values,
+						 bool *isnull,
+						 bool tupleIsAlive,
+						 void *state)
+#else
+gpu_btree_build_callback(Relation index,
+						 HeapTuple htup,
+						 Datum *values,
+						 bool *isnull,
+						 bool tupleIsAlive,
+						 void *state)
+#endif
+{
+	gpuBtreeBuildState *bstate = (gpuBtreeBuildState *) state;
+	gpuBtreeChunk *chunk = NULL;
+	cl_ulong   *rec;
+	int			keyno;
+#if PG_VERSION_NUM < 130000
+	ItemPointer	tid = &htup->t_self;
+#endif
+
+	if (bstate->num_chunks > 0)
+	{
+		chunk = &bstate->chunks[bstate->num_chunks - 1];
+		if (chunk->nitems >= bstate->chunk_nrooms)
+		{
+			gpu_btree_sort_chunk(bstate, chunk);
+			chunk = NULL;
+		}
+	}
+	/* allocation of a new chunk on demand */
+	if (!chunk)
+	{
+		size_t		length;
+		CUresult	rc;
+
+		if (bstate->num_chunks == bstate->max_chunks)
+		{
+			bstate->max_chunks *= 2;
+			bstate->chunks = repalloc(bstate->chunks,
+									  sizeof(gpuBtreeChunk) *
+									  bstate->max_chunks);
+		}
+		chunk = &bstate->chunks[bstate->num_chunks];
+		memset(chunk, 0, sizeof(gpuBtreeChunk));
+		length = (STROMALIGN(sizeof(cl_ulong) * bstate->nwords *
+							 (size_t)bstate->chunk_nrooms) +
+				  STROMALIGN(sizeof(cl_uint) * bstate->chunk_nrooms));
+		rc = gpuMemAllocManaged(bstate->gcontext, &chunk->m_chunk, length,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+		chunk->records = (cl_ulong *) chunk->m_chunk;
+		chunk->rindex = (cl_uint *)
+			((char *)chunk->m_chunk +
+			 STROMALIGN(sizeof(cl_ulong) * bstate->nwords *
+						(size_t)bstate->chunk_nrooms));
+		bstate->num_chunks++;
+	}
+	/* encode the index entry */
+	rec = chunk->records + (size_t)bstate->nwords * chunk->nitems;
+	for (keyno=0; keyno < bstate->nkeys; keyno++)
+	{
+		if (isnull[keyno])
+		{
+			rec[2 * keyno]     = (bstate->nulls_first[keyno] ? 0 : 1);
+			rec[2 * keyno + 1] = 0;
+		}
+		else
+		{
+			cl_ulong	value = gpu_btree_encode_datum(bstate->keytypes[keyno],
+													   values[keyno]);
+			rec[2 * keyno]     = (bstate->nulls_first[keyno] ? 1 : 0);
+			rec[2 * keyno + 1] = (bstate->desc[keyno] ? ~value : value);
+		}
+	}
+	rec[2 * bstate->nkeys] = (((cl_ulong)ItemPointerGetBlockNumber(tid) << 16) |
+							  (cl_ulong)ItemPointerGetOffsetNumber(tid));
+	chunk->rindex[chunk->nitems] = chunk->nitems;
+	chunk->nitems++;
+	bstate->indtuples += 1.0;
+}
+
+/*
+ * gpu_btree_form_tuple - decodes a record to IndexTuple
+ */
+static IndexTuple
+gpu_btree_form_tuple(gpuBtreeBuildState *bstate, const cl_ulong *rec)
+{
+	Datum		values[GPU_BTREE_MAX_KEYS];
+	bool		isnull[GPU_BTREE_MAX_KEYS];
+	cl_ulong	tidval = rec[2 * bstate->nkeys];
+	IndexTuple	itup;
+	int			keyno;
+
+	for (keyno=0; keyno < bstate->nkeys; keyno++)
+	{
+		cl_ulong	value = rec[2 * keyno + 1];
+
+		isnull[keyno] = (rec[2 * keyno] != (bstate->nulls_first[keyno] ? 1 : 0));
+		if (isnull[keyno])
+			values[keyno] = 0;
+		else
+			values[keyno] = gpu_btree_decode_datum(bstate->keytypes[keyno],
+												   bstate->desc[keyno]
+												   ? ~value : value);
+	}
+	itup = index_form_tuple(RelationGetDescr(bstate->indexRel),
+							values, isnull);
+	ItemPointerSet(&itup->t_tid,
+				   (BlockNumber)(tidval >> 16),
+				   (OffsetNumber)(tidval & 0xffffU));
+	return itup;
+}
+
+/*
+ * gpu_btree_blwritepage - also see _bt_blwritepage() in nbtsort.c
+ */
+static void
+gpu_btree_blwritepage(gpuBtreeWriteState *wstate, Page page, BlockNumber blkno)
+{
+	Relation	indexRel = wstate->indexRel;
+
+	/* Ensure rd_smgr is open (could have been closed by relcache flush!) */
+	RelationOpenSmgr(indexRel);
+
+	/* XLOG stuff */
+	if (wstate->use_wal)
+		log_newpage(&indexRel->rd_node, MAIN_FORKNUM, blkno, page, true);
+
+	/* write out zero pages, if we skipped some blocks */
+	while (blkno > wstate->pages_written)
+	{
+		if (!wstate->zeropage)
+			wstate->zeropage = (Page) palloc0(BLCKSZ);
+		smgrextend(indexRel->rd_smgr, MAIN_FORKNUM,
+				   wstate->pages_written++,
+				   (char *) wstate->zeropage,
+				   true);
+	}
+	PageSetChecksumInplace(page, blkno);
+	if (blkno == wstate->pages_written)
+	{
+		smgrextend(indexRel->rd_smgr, MAIN_FORKNUM, blkno,
+				   (char *) page, true);
+		wstate->pages_written++;
+	}
+	else
+	{
+		smgrwrite(indexRel->rd_smgr, MAIN_FORKNUM, blkno,
+				  (char *) page, true);
+	}
+	pfree(page);
+}
+
+/*
+ * gpu_btree_pagestate - also see _bt_blnewpage() and _bt_pagestate()
+ */
+static gpuBtreePageState *
+gpu_btree_pagestate(gpuBtreeWriteState *wstate, uint32 level)
+{
+	gpuBtreePageState *state = palloc0(sizeof(gpuBtreePageState));
+	BTPageOpaque opaque;
+	Page		page;
+
+	page = (Page) palloc(BLCKSZ);
+	_bt_pageinit(page, BLCKSZ);
+	opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	opaque->btpo_prev = opaque->btpo_next = P_NONE;
+	opaque->btpo.level = level;
+	opaque->btpo_flags = (level > 0 ? 0 : BTP_LEAF);
+	opaque->btpo_cycleid = 0;
+	/* make the P_HIKEY line pointer appear allocated */
+	((PageHeader) page)->pd_lower += sizeof(ItemIdData);
+
+	state->page = page;
+	state->blkno = wstate->pages_alloced++;
+	state->minkey = NULL;
+	state->lastoff = P_HIKEY;
+	state->level = level;
+	if (level > 0)
+		state->full = (BLCKSZ * (100 - BTREE_NONLEAF_FILLFACTOR) / 100);
+	else
+#if PG_VERSION_NUM >= 130000
+		state->full = BTGetTargetPageFreeSpace(wstate->indexRel);
+#else
+		state->full = RelationGetTargetPageFreeSpace(wstate->indexRel,
+													  BTREE_DEFAULT_FILLFACTOR);
+#endif
+	state->next = NULL;
+
+	return state;
+}
+
+/*
+ * gpu_btree_sortaddtup - also see _bt_sortaddtup()
+ *
+ * The first data item on the internal pages is the "minus infinity" item,
+ * so its key is truncated.
+ */
+static void
+gpu_btree_sortaddtup(Page page, Size itemsize,
+					 IndexTuple itup, OffsetNumber itup_off)
+{
+	BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+	IndexTupleData trunctuple;
+
+	if (!P_ISLEAF(opaque) && itup_off == P_FIRSTKEY)
+	{
+		trunctuple = *itup;
+		trunctuple.t_info = sizeof(IndexTupleData);
+#if PG_VERSION_NUM >= 130000
+		BTreeTupleSetNAtts(&trunctuple, 0, false);
+#else
+		BTreeTupleSetNAtts(&trunctuple, 0);
+#endif
+		itup = &trunctuple;
+		itemsize = sizeof(IndexTupleData);
+	}
+	if (PageAddItem(page, (Item) itup, itemsize, itup_off,
+					false, false) == InvalidOffsetNumber)
+		elog(ERROR, "failed to add item to the index page");
+}
+
+/*
+ * gpu_btree_buildadd - also see _bt_buildadd()
+ *
+ * It adds an item to the page of the level. Once the page gets full,
+ * its last item is moved to the new right sibling page, and becomes
+ * the high key of the old page. Then, the old page is linked to the
+ * parent level by its minimum key, and written out.
+ */
+static void
+gpu_btree_buildadd(gpuBtreeWriteState *wstate,
+				   gpuBtreePageState *state,
+				   IndexTuple itup)
+{
+	Page		npage = state->page;
+	BlockNumber	nblkno = state->blkno;
+	OffsetNumber last_off = state->lastoff;
+	Size		pgspc = PageGetFreeSpace(npage);
+	Size		itupsz = MAXALIGN(IndexTupleSize(itup));
+
+	if (pgspc < itupsz || (pgspc < state->full && last_off > P_FIRSTKEY))
+	{
+		Page		opage = npage;
+		BlockNumber	oblkno = nblkno;
+		BTPageOpaque oopaque;
+		BTPageOpaque nopaque;
+		ItemId		ii;
+		ItemId		hii;
+		IndexTuple	oitup;
+		gpuBtreePageState *nstate;
+
+		/* create a new page of the same level */
+		nstate = gpu_btree_pagestate(wstate, state->level);
+		npage = nstate->page;
+		nblkno = nstate->blkno;
+		pfree(nstate);
+
+		/* move the last item on the old page to the new page */
+		ii = PageGetItemId(opage, last_off);
+		oitup = (IndexTuple) PageGetItem(opage, ii);
+		gpu_btree_sortaddtup(npage, ItemIdGetLength(ii), oitup, P_FIRSTKEY);
+
+		/* the last item also becomes the high key of the old page */
+		hii = PageGetItemId(opage, P_HIKEY);
+		*hii = *ii;
+		ItemIdSetUnused(ii);
+		((PageHeader) opage)->pd_lower -= sizeof(ItemIdData);
+
+		/* link the old page to the parent, by its minimum key */
+		if (!state->next)
+			state->next = gpu_btree_pagestate(wstate, state->level + 1);
+		Assert(state->minkey != NULL);
+		ItemPointerSet(&state->minkey->t_tid, oblkno, P_HIKEY);
+		gpu_btree_buildadd(wstate, state->next, state->minkey);
+		pfree(state->minkey);
+		state->minkey = CopyIndexTuple(oitup);
+
+		/* set the sibling links */
+		oopaque = (BTPageOpaque) PageGetSpecialPointer(opage);
+		nopaque = (BTPageOpaque) PageGetSpecialPointer(npage);
+		oopaque->btpo_next = nblkno;
+		nopaque->btpo_prev = oblkno;
+		nopaque->btpo_next = P_NONE;
+
+		/* write out the old page */
+		gpu_btree_blwritepage(wstate, opage, oblkno);
+
+		last_off = P_FIRSTKEY;
+	}
+	/* the first item on the page is the minimum key */
+	if (last_off == P_HIKEY)
+	{
+		Assert(state->minkey == NULL);
+		state->minkey = CopyIndexTuple(itup);
+	}
+	last_off = OffsetNumberNext(last_off);
+	gpu_btree_sortaddtup(npage, itupsz, itup, last_off);
+
+	state->page = npage;
+	state->blkno = nblkno;
+	state->lastoff = last_off;
+}
+
+/*
+ * gpu_btree_uppershutdown - also see _bt_uppershutdown()
+ *
+ * It finishes the rightmost pages of every level, then writes out the
+ * metapage.
+ */
+static void
+gpu_btree_uppershutdown(gpuBtreeWriteState *wstate)
+{
+	gpuBtreePageState *state;
+	BlockNumber	rootblkno = P_NONE;
+	uint32		rootlevel = 0;
+	Page		metapage;
+
+	for (state = wstate->leaf; state != NULL; state = state->next)
+	{
+		Page		page = state->page;
+		BTPageOpaque opaque = (BTPageOpaque) PageGetSpecialPointer(page);
+		OffsetNumber maxoff = PageGetMaxOffsetNumber(page);
+
+		if (!state->next)
+		{
+			opaque->btpo_flags |= BTP_ROOT;
+			rootblkno = state->blkno;
+			rootlevel = state->level;
+		}
+		else
+		{
+			Assert(state->minkey != NULL);
+			ItemPointerSet(&state->minkey->t_tid, state->blkno, P_HIKEY);
+			gpu_btree_buildadd(wstate, state->next, state->minkey);
+			pfree(state->minkey);
+			state->minkey = NULL;
+		}
+		/*
+		 * The rightmost page has no high key, so the ItemId array needs to
+		 * be slid back one slot; also see _bt_slideleft().
+		 */
+		if (maxoff >= P_FIRSTKEY)
+		{
+			ItemId		previi = PageGetItemId(page, P_HIKEY);
+			OffsetNumber off;
+
+			for (off = P_FIRSTKEY; off <= maxoff; off = OffsetNumberNext(off))
+			{
+				ItemId	thisii = PageGetItemId(page, off);
+
+				*previi = *thisii;
+				previi = thisii;
+			}
+			((PageHeader) page)->pd_lower -= sizeof(ItemIdData);
+		}
+		gpu_btree_blwritepage(wstate, page, state->blkno);
+	}
+	/* the metapage in the version 3 format */
+	metapage = (Page) palloc(BLCKSZ);
+#if PG_VERSION_NUM >= 130000
+	_bt_initmetapage(metapage, rootblkno, rootlevel, false);
+#else
+	_bt_initmetapage(metapage, rootblkno, rootlevel);
+#endif
+#if PG_VERSION_NUM >= 120000
+	/* PG12 or later writes the version 4 by default */
+	BTPageGetMeta(metapage)->btm_version = BTREE_NOVAC_VERSION;
+#endif
+	gpu_btree_blwritepage(wstate, metapage, BTREE_METAPAGE);
+}
+
+/*
+ * gpu_btree_build_chunk_compare - comparator for the k-way merge
+ */
+static int
+gpu_btree_build_chunk_compare(Datum a, Datum b, void *arg)
+{
+	gpuBtreeBuildState *bstate = (gpuBtreeBuildState *) arg;
+	gpuBtreeChunk *x_chunk = &bstate->chunks[DatumGetInt32(a)];
+	gpuBtreeChunk *y_chunk = &bstate->chunks[DatumGetInt32(b)];
+	const cl_ulong *x_rec;
+	const cl_ulong *y_rec;
+	cl_uint		i;
+
+	x_rec = x_chunk->records + ((size_t)bstate->nwords *
+								x_chunk->rindex[x_chunk->curpos]);
+	y_rec = y_chunk->records + ((size_t)bstate->nwords *
+								y_chunk->rindex[y_chunk->curpos]);
+	for (i=0; i < bstate->nwords; i++)
+	{
+		/* binaryheap is max-heap, so comparison is inverted */
+		if (x_rec[i] < y_rec[i])
+			return 1;
+		if (x_rec[i] > y_rec[i])
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ * gpu_btree_load - merges the sorted chunks, and loads the B-tree pages
+ */
+static void
+gpu_btree_load(gpuBtreeBuildState *bstate, gpuBtreeWriteState *wstate)
+{
+	binaryheap *merge_heap;
+	int			i;
+
+	merge_heap = binaryheap_allocate(Max(bstate->num_chunks, 1),
+									 gpu_btree_build_chunk_compare,
+									 bstate);
+	for (i=0; i < bstate->num_chunks; i++)
+	{
+		if (bstate->chunks[i].nitems > 0)
+			binaryheap_add_unordered(merge_heap, Int32GetDatum(i));
+	}
+	binaryheap_build(merge_heap);
+
+	while (!binaryheap_empty(merge_heap))
+	{
+		int			k = DatumGetInt32(binaryheap_first(merge_heap));
+		gpuBtreeChunk *chunk = &bstate->chunks[k];
+		const cl_ulong *rec;
+		IndexTuple	itup;
+
+		CHECK_FOR_INTERRUPTS();
+
+		rec = chunk->records + ((size_t)bstate->nwords *
+								chunk->rindex[chunk->curpos]);
+		itup = gpu_btree_form_tuple(bstate, rec);
+		if (!wstate->leaf)
+			wstate->leaf = gpu_btree_pagestate(wstate, 0);
+		gpu_btree_buildadd(wstate, wstate->leaf, itup);
+		pfree(itup);
+
+		if (++chunk->curpos < chunk->nitems)
+			binaryheap_replace_first(merge_heap, Int32GetDatum(k));
+		else
+			binaryheap_remove_first(merge_heap);
+	}
+	binaryheap_free(merge_heap);
+
+	gpu_btree_uppershutdown(wstate);
+
+	/*
+	 * Like _bt_load(), the index must be fsync'ed even if the pages are
+	 * WAL-logged, because they were not written through the shared buffers.
+	 */
+	if (RelationNeedsWAL(wstate->indexRel))
+	{
+		RelationOpenSmgr(wstate->indexRel);
+		smgrimmedsync(wstate->indexRel->rd_smgr, MAIN_FORKNUM);
+	}
+}
+
+/*
+ * gpu_btree_update_index_state - also see reindex_index()
+ */
+static void
+gpu_btree_update_index_state(Relation heapRel, Relation indexRel,
+							 IndexInfo *indexInfo)
+{
+	Relation	pg_index;
+	HeapTuple	indexTuple;
+	Form_pg_index indexForm;
+	bool		index_bad;
+
+	pg_index = table_open(IndexRelationId, RowExclusiveLock);
+	indexTuple = SearchSysCacheCopy1(INDEXRELID,
+									 ObjectIdGetDatum(RelationGetRelid(indexRel)));
+	if (!HeapTupleIsValid(indexTuple))
+		elog(ERROR, "cache lookup failed for index %u",
+			 RelationGetRelid(indexRel));
+	indexForm = (Form_pg_index) GETSTRUCT(indexTuple);
+
+	index_bad = (!indexForm->indisvalid ||
+				 !indexForm->indisready ||
+				 !indexForm->indislive);
+	if (index_bad ||
+		(indexForm->indcheckxmin && !indexInfo->ii_BrokenHotChain))
+	{
+		if (!indexInfo->ii_BrokenHotChain)
+			indexForm->indcheckxmin = false;
+		else if (index_bad)
+			indexForm->indcheckxmin = true;
+		indexForm->indisvalid = true;
+		indexForm->indisready = true;
+		indexForm->indislive = true;
+		CatalogTupleUpdate(pg_index, &indexTuple->t_self, indexTuple);
+		CacheInvalidateRelcache(heapRel);
+	}
+	table_close(pg_index, RowExclusiveLock);
+}
+#endif	/* >= PG11 */
+
+Datum
+pgstrom_gpu_btree_build(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM < 110000
+	elog(ERROR, "%s: not supported on PostgreSQL v10", __FUNCTION__);
+#else
+	Oid			indexoid = PG_GETARG_OID(0);
+	Oid			heapoid;
+	Relation	heapRel;
+	Relation	indexRel;
+	IndexInfo  *indexInfo;
+	gpuBtreeBuildState bstate;
+	gpuBtreeWriteState wstate;
+	ProgramId	program_id = INVALID_PROGRAM_ID;
+	char		persistence;
+	char	   *kern_source;
+	size_t		unitsz;
+	int			keyno;
+	int			i;
+
+	if (RecoveryInProgress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("recovery is in progress"),
+				 errhint("B-tree index cannot be built during recovery.")));
+	/* like reindex_index(), lock the table prior to the index */
+	heapoid = IndexGetRelation(indexoid, true);
+	if (OidIsValid(heapoid))
+		heapRel = table_open(heapoid, ShareLock);
+	else
+		heapRel = NULL;
+	indexRel = index_open(indexoid, AccessExclusiveLock);
+	if (indexRel->rd_rel->relkind != RELKIND_INDEX ||
+		indexRel->rd_rel->relam != BTREE_AM_OID)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a B-tree index",
+						RelationGetRelationName(indexRel))));
+	if (!heapRel || heapoid != IndexGetRelation(indexoid, false))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_TABLE),
+				 errmsg("could not open parent table of index %s",
+						RelationGetRelationName(indexRel))));
+	if (!pg_class_ownercheck(indexoid, GetUserId()))
+		aclcheck_error(ACLCHECK_NOT_OWNER, OBJECT_INDEX,
+					   RelationGetRelationName(indexRel));
+	if (RELATION_IS_OTHER_TEMP(indexRel))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot reindex temporary tables of other sessions")));
+	CheckTableNotInUse(indexRel, "REINDEX INDEX");
+	gpu_btree_check_index(heapRel, indexRel);
+	/* like reindex_index(), predicate locks go up to the heap */
+	TransferPredicateLocksToHeapRelation(indexRel);
+
+	indexInfo = BuildIndexInfo(indexRel);
+	memset(&bstate, 0, sizeof(gpuBtreeBuildState));
+	bstate.indexRel = indexRel;
+	bstate.nkeys = IndexRelationGetNumberOfKeyAttributes(indexRel);
+	bstate.nwords = GPU_BTREE_RECORD_NWORDS(bstate.nkeys);
+	for (keyno=0; keyno < bstate.nkeys; keyno++)
+	{
+		int16		indopt = indexRel->rd_indoption[keyno];
+
+		bstate.keytypes[keyno] = tupleDescAttr(RelationGetDescr(indexRel),
+											   keyno)->atttypid;
+		bstate.desc[keyno] = ((indopt & INDOPTION_DESC) != 0);
+		bstate.nulls_first[keyno] = ((indopt & INDOPTION_NULLS_FIRST) != 0);
+	}
+	unitsz = sizeof(cl_ulong) * bstate.nwords + sizeof(cl_uint);
+	bstate.chunk_nrooms = Max(pgstrom_chunk_size() / unitsz, 1024);
+	bstate.max_chunks = 16;
+	bstate.chunks = palloc0(sizeof(gpuBtreeChunk) * bstate.max_chunks);
+
+	/* assign a new relfilenode, like REINDEX */
+	persistence = indexRel->rd_rel->relpersistence;
+#if PG_VERSION_NUM >= 120000
+	RelationSetNewRelfilenode(indexRel, persistence);
+#else
+	RelationSetNewRelfilenode(indexRel, persistence,
+							  InvalidTransactionId,
+							  InvalidMultiXactId);
+#endif
+	PG_TRY();
+	{
+		CUmodule	cuda_module;
+		CUresult	rc;
+
+		bstate.gcontext = AllocGpuContext(-1, true, false);
+		kern_source = gpu_btree_build_kernel_source(bstate.nwords);
+		program_id = pgstrom_create_cuda_program(bstate.gcontext,
+												 0,
+												 0,
+												 kern_source,
+												 "",
+												 true,
+												 false);
+		cuda_module = GpuContextLookupModule(bstate.gcontext, program_id);
+		rc = cuModuleGetFunction(&bstate.kern_bitonic,
+								 cuda_module,
+								 "kern_gpu_btree_bitonic_step");
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+		rc = gpuOptimalBlockSize(&bstate.grid_sz,
+								 &bstate.block_sz,
+								 bstate.kern_bitonic,
+								 bstate.gcontext->cuda_device,
+								 0, 0);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+
+		/* scan the heap, and sort the index entries per chunk */
+#if PG_VERSION_NUM >= 120000
+		table_index_build_scan(heapRel, indexRel, indexInfo, true, false,
+							   gpu_btree_build_callback,
+							   (void *) &bstate, NULL);
+#else
+		IndexBuildHeapScan(heapRel, indexRel, indexInfo, true,
+						   gpu_btree_build_callback,
+						   (void *) &bstate, NULL);
+#endif
+		if (bstate.num_chunks > 0)
+			gpu_btree_sort_chunk(&bstate,
+								 &bstate.chunks[bstate.num_chunks - 1]);
+
+		/* merge the sorted chunks, and write out the B-tree pages */
+		memset(&wstate, 0, sizeof(gpuBtreeWriteState));
+		wstate.indexRel = indexRel;
+		wstate.use_wal = (XLogIsNeeded() && RelationNeedsWAL(indexRel));
+		wstate.pages_alloced = BTREE_METAPAGE + 1;
+		wstate.pages_written = 0;
+		gpu_btree_load(&bstate, &wstate);
+
+		for (i=0; i < bstate.num_chunks; i++)
+			gpuMemFree(bstate.gcontext, bstate.chunks[i].m_chunk);
+		pgstrom_put_cuda_program(bstate.gcontext, program_id);
+		PutGpuContext(bstate.gcontext);
+	}
+	PG_CATCH();
+	{
+		if (bstate.gcontext)
+		{
+			for (i=0; i < bstate.num_chunks; i++)
+				gpuMemFree(bstate.gcontext, bstate.chunks[i].m_chunk);
+			if (program_id != INVALID_PROGRAM_ID)
+				pgstrom_put_cuda_program(bstate.gcontext, program_id);
+			PutGpuContext(bstate.gcontext);
+		}
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	/* unlogged index also needs the init fork, like index_build() */
+	if (persistence == RELPERSISTENCE_UNLOGGED)
+	{
+		RelationOpenSmgr(indexRel);
+		smgrcreate(indexRel->rd_smgr, INIT_FORKNUM, false);
+#if PG_VERSION_NUM >= 120000
+		indexRel->rd_indam->ambuildempty(indexRel);
+#else
+		indexRel->rd_amroutine->ambuildempty(indexRel);
+#endif
+	}
+	/* update the statistics and the state of the index */
+	vac_update_relstats(indexRel,
+						RelationGetNumberOfBlocks(indexRel),
+						bstate.indtuples,
+						0,
+						false,
+						InvalidTransactionId,
+						InvalidMultiXactId,
+						false);
+	gpu_btree_update_index_state(heapRel, indexRel, indexInfo);
+	CommandCounterIncrement();
+
+	index_close(indexRel, NoLock);
+	table_close(heapRel, NoLock);
+
+	PG_RETURN_INT64((int64) bstate.indtuples);
+#endif
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_btree_build);
+
+/*
+ * pgstrom_init_relscan
+ */
+void
+pgstrom_init_relscan(void)
+{
+	/* pg_strom.enable_brin */
+	DefineCustomBoolVariable("pg_strom.enable_brin",
+							 "Enables to use BRIN-index",
+							 NULL,
+							 &pgstrom_enable_brin,
+							 true,
+							 PGC_USERSET,
+                             GUC_NOT_IN_SAMPLE,
+                             NULL, NULL, NULL);
+	/* pg_strom.enable_bitmapindex */
+	DefineCustomBoolVariable("pg_strom.enable_bitmapindex",
+							 "Enables to use bitmap-index (B-tree, GIN, ...) scan",
+							 NULL,
+							 &pgstrom_enable_bitmapindex,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.nvme_strom_gpu_visibility */
+	DefineCustomBoolVariable("pg_strom.nvme_strom_gpu_visibility",
+							 "Enables SSD-to-GPU Direct SQL on blocks which are not all-visible, with visibility checks on GPU",
+							 NULL,
+							 &pgstrom_nvme_strom_gpu_visibility,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 }
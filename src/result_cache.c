@@ -0,0 +1,475 @@
+/*
+ * result_cache.c
+ *
+ * Shared cache of the query results on Arrow_Fdw / Gstore_Fdw tables
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "pg_strom.h"
+
+/*
+ * resultCacheEntry - a set of result tuples on TopSharedMemoryContext.
+ *
+ * data[] contains the key (see resultCacheBuildKey), then MAXALIGN'ed
+ * MinimalTuples. The first 'prefix_len' bytes of the key identifies the
+ * relation and its data version, so the entries built on the older contents
+ * of the same relation are released when a new entry is saved.
+ */
+typedef struct
+{
+	dlist_node	hash_chain;
+	dlist_node	lru_chain;
+	uint32		hash;
+	size_t		usage;			/* allocated size of this entry */
+	Oid			database_oid;
+	Oid			relation_oid;
+	TimestampTz	ctime;			/* time of the build */
+	uint64		nhits;			/* number of cache hits */
+	int64		ntuples;		/* number of result tuples */
+	size_t		prefix_len;
+	size_t		key_len;
+	size_t		data_len;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} resultCacheEntry;
+
+#define RESULT_CACHE_NSLOTS		997
+
+typedef struct
+{
+	LWLock		lock;
+	size_t		total_usage;
+	dlist_head	lru_list;
+	dlist_head	hash_slots[RESULT_CACHE_NSLOTS];
+} resultCacheHead;
+
+/*
+ * resultCacheState - per scan state
+ */
+#define RESULT_CACHE_STATUS__MISS		0	/* running, results are recorded */
+#define RESULT_CACHE_STATUS__HIT		1	/* results are served from cache */
+#define RESULT_CACHE_STATUS__SAVED		2	/* results are saved to cache */
+#define RESULT_CACHE_STATUS__DISCARD	3	/* results are not cacheable */
+
+typedef struct resultCacheState
+{
+	int				status;			/* one of RESULT_CACHE_STATUS__* */
+	Oid				relation_oid;
+	StringInfoData	key;
+	size_t			prefix_len;
+	uint32			hash;
+	StringInfoData	buf;			/* result tuples */
+	size_t			buf_pos;		/* read position, if HIT */
+	int64			ntuples;
+} resultCacheState;
+
+/* static variables */
+static shmem_startup_hook_type shmem_startup_next = NULL;
+static resultCacheHead *rcache_head = NULL;
+static bool		pgstrom_gpu_result_cache;			/* GUC */
+static int		pgstrom_gpu_result_cache_size_kb;	/* GUC */
+
+#define pgstrom_gpu_result_cache_size		\
+	((size_t)pgstrom_gpu_result_cache_size_kb << 10)
+
+/*
+ * resultCacheBuildPrefix
+ *
+ * It appends the relation and version of its contents to be scanned.
+ * Only Arrow_Fdw and Gstore_Fdw can tell us the version without any
+ * data access.
+ */
+static bool
+resultCacheBuildPrefix(GpuTaskState *gts, StringInfo buf)
+{
+	Relation	relation = gts->css.ss.ss_currentRelation;
+
+	appendStringInfo(buf, "%u:%u:", MyDatabaseId, RelationGetRelid(relation));
+	if (gts->af_state)
+		return ExecArrowFdwDataVersion(gts->af_state, buf);
+	if (gts->gs_state)
+		return ExecGstoreFdwDataVersion(gts->gs_state, buf);
+	return false;
+}
+
+/*
+ * resultCacheBuildKey
+ *
+ * The key consists of the relation and its data version (prefix), session
+ * parameters that affects device code, values of the Const/Param nodes,
+ * and the plan itself.
+ */
+static bool
+resultCacheBuildKey(GpuTaskState *gts, resultCacheState *rcs)
+{
+	Plan		   *plan = gts->css.ss.ps.plan;
+	kern_parambuf  *kparams = gts->kern_params;
+	StringInfo		key = &rcs->key;
+	size_t			head;
+
+	if (!resultCacheBuildPrefix(gts, key))
+		return false;
+	rcs->prefix_len = key->len;
+
+	appendStringInfo(key, "\nTimeZone=%s\nDateStyle=%s\nIntervalStyle=%s\n",
+					 GetConfigOption("TimeZone", false, false),
+					 GetConfigOption("DateStyle", false, false),
+					 GetConfigOption("IntervalStyle", false, false));
+	/*
+	 * Const/Param values; the xid-vector and snapshot at the tail of the
+	 * kern_parambuf are not a part of the key.
+	 */
+	head = MAXALIGN(offsetof(kern_parambuf, poffset[kparams->nparams]));
+	appendBinaryStringInfo(key, (char *)kparams->poffset,
+						   sizeof(cl_uint) * kparams->xactIdVector);
+	appendBinaryStringInfo(key, (char *)kparams + head,
+						   kparams->poffset[kparams->xactIdVector] - head);
+	appendStringInfoChar(key, '\n');
+	appendStringInfoString(key, nodeToString(plan));
+
+	rcs->hash = hash_any((unsigned char *)key->data, key->len);
+
+	return true;
+}
+
+/*
+ * pgstrom_result_cache_begin
+ */
+void
+pgstrom_result_cache_begin(GpuTaskState *gts, int eflags)
+{
+	Relation		relation = gts->css.ss.ss_currentRelation;
+	CustomScan	   *cscan = (CustomScan *)gts->css.ss.ps.plan;
+	resultCacheState *rcs;
+	dlist_iter		iter;
+	int				hindex;
+
+	gts->rcache_state = NULL;
+	if (!pgstrom_gpu_result_cache ||
+		pgstrom_gpu_result_cache_size_kb == 0 ||
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY) != 0 ||
+		!relation ||
+		outerPlan(cscan) != NULL ||
+		cscan->custom_plans != NIL ||
+		cscan->scan.plan.parallel_aware ||
+		IsParallelWorker())
+		return;
+	if (!gts->af_state && !gts->gs_state)
+		return;
+
+	rcs = palloc0(sizeof(resultCacheState));
+	rcs->relation_oid = RelationGetRelid(relation);
+	initStringInfo(&rcs->key);
+	if (!resultCacheBuildKey(gts, rcs))
+	{
+		pfree(rcs->key.data);
+		pfree(rcs);
+		return;
+	}
+	initStringInfo(&rcs->buf);
+	rcs->status = RESULT_CACHE_STATUS__MISS;
+
+	hindex = rcs->hash % RESULT_CACHE_NSLOTS;
+	LWLockAcquire(&rcache_head->lock, LW_EXCLUSIVE);
+	dlist_foreach (iter, &rcache_head->hash_slots[hindex])
+	{
+		resultCacheEntry *entry = dlist_container(resultCacheEntry,
+												  hash_chain, iter.cur);
+		if (entry->hash == rcs->hash &&
+			entry->key_len == rcs->key.len &&
+			memcmp(entry->data, rcs->key.data, rcs->key.len) == 0)
+		{
+			appendBinaryStringInfo(&rcs->buf,
+								   entry->data + entry->key_len,
+								   entry->data_len);
+			rcs->ntuples = entry->ntuples;
+			rcs->status = RESULT_CACHE_STATUS__HIT;
+			entry->nhits++;
+			dlist_move_head(&rcache_head->lru_list, &entry->lru_chain);
+			break;
+		}
+	}
+	LWLockRelease(&rcache_head->lock);
+
+	gts->rcache_state = rcs;
+}
+
+/*
+ * resultCacheReleaseEntry - caller must hold the exclusive lock
+ */
+static void
+resultCacheReleaseEntry(resultCacheEntry *entry)
+{
+	dlist_delete(&entry->hash_chain);
+	dlist_delete(&entry->lru_chain);
+	Assert(rcache_head->total_usage >= entry->usage);
+	rcache_head->total_usage -= entry->usage;
+	pfree(entry);
+}
+
+/*
+ * resultCacheSaveEntry
+ */
+static void
+resultCacheSaveEntry(resultCacheState *rcs)
+{
+	resultCacheEntry *entry;
+	dlist_mutable_iter iter;
+	size_t			usage;
+	int				hindex = rcs->hash % RESULT_CACHE_NSLOTS;
+
+	usage = MAXALIGN(offsetof(resultCacheEntry, data) +
+					 rcs->key.len + rcs->buf.len);
+	if (usage > pgstrom_gpu_result_cache_size)
+		return;
+
+	LWLockAcquire(&rcache_head->lock, LW_EXCLUSIVE);
+	/* already saved by the concurrent session? */
+	dlist_foreach_modify (iter, &rcache_head->hash_slots[hindex])
+	{
+		entry = dlist_container(resultCacheEntry,
+								hash_chain, iter.cur);
+		if (entry->hash == rcs->hash &&
+			entry->key_len == rcs->key.len &&
+			memcmp(entry->data, rcs->key.data, rcs->key.len) == 0)
+		{
+			LWLockRelease(&rcache_head->lock);
+			return;
+		}
+	}
+	/* release the entries built on the older version of the relation */
+	dlist_foreach_modify (iter, &rcache_head->lru_list)
+	{
+		entry = dlist_container(resultCacheEntry,
+								lru_chain, iter.cur);
+		if (entry->database_oid == MyDatabaseId &&
+			entry->relation_oid == rcs->relation_oid &&
+			(entry->prefix_len != rcs->prefix_len ||
+			 memcmp(entry->data, rcs->key.data, rcs->prefix_len) != 0))
+			resultCacheReleaseEntry(entry);
+	}
+	/* evict the least recently used entries */
+	while (!dlist_is_empty(&rcache_head->lru_list) &&
+		   rcache_head->total_usage + usage > pgstrom_gpu_result_cache_size)
+	{
+		entry = dlist_container(resultCacheEntry, lru_chain,
+								dlist_tail_node(&rcache_head->lru_list));
+		resultCacheReleaseEntry(entry);
+	}
+	/* LWLock shall be released on error */
+	entry = MemoryContextAlloc(TopSharedMemoryContext, usage);
+	memset(entry, 0, offsetof(resultCacheEntry, data));
+	entry->hash = rcs->hash;
+	entry->usage = usage;
+	entry->database_oid = MyDatabaseId;
+	entry->relation_oid = rcs->relation_oid;
+	entry->ctime = GetCurrentTimestamp();
+	entry->nhits = 0;
+	entry->ntuples = rcs->ntuples;
+	entry->prefix_len = rcs->prefix_len;
+	entry->key_len = rcs->key.len;
+	entry->data_len = rcs->buf.len;
+	memcpy(entry->data, rcs->key.data, rcs->key.len);
+	memcpy(entry->data + rcs->key.len, rcs->buf.data, rcs->buf.len);
+
+	dlist_push_head(&rcache_head->hash_slots[hindex], &entry->hash_chain);
+	dlist_push_head(&rcache_head->lru_list, &entry->lru_chain);
+	rcache_head->total_usage += usage;
+	LWLockRelease(&rcache_head->lock);
+
+	rcs->status = RESULT_CACHE_STATUS__SAVED;
+}
+
+/*
+ * pgstrom_result_cache_exec
+ *
+ * It returns the next tuple from the result cache, if HIT. Elsewhere, it
+ * runs the GpuTaskState and records the tuples. The cached tuples are
+ * stored on the 'slot'; that has to be compatible to the ones returned by
+ * the GpuTaskState.
+ */
+TupleTableSlot *
+pgstrom_result_cache_exec(GpuTaskState *gts, TupleTableSlot *slot)
+{
+	resultCacheState *rcs = gts->rcache_state;
+	MinimalTuple	mtup;
+	bool			should_free;
+
+	if (!rcs)
+		return pgstromExecGpuTaskState(gts);
+
+	if (rcs->status == RESULT_CACHE_STATUS__HIT)
+	{
+		if (rcs->buf_pos >= rcs->buf.len)
+			return NULL;
+		mtup = (MinimalTuple)(rcs->buf.data + rcs->buf_pos);
+		rcs->buf_pos += MAXALIGN(mtup->t_len);
+		ExecForceStoreMinimalTuple(mtup, slot, false);
+		return slot;
+	}
+
+	slot = pgstromExecGpuTaskState(gts);
+	if (rcs->status != RESULT_CACHE_STATUS__MISS)
+		return slot;
+	if (TupIsNull(slot))
+	{
+		StringInfoData	version;
+
+		/* save the results, if contents were not changed during the scan */
+		initStringInfo(&version);
+		if (resultCacheBuildPrefix(gts, &version) &&
+			version.len == rcs->prefix_len &&
+			memcmp(version.data, rcs->key.data, rcs->prefix_len) == 0)
+			resultCacheSaveEntry(rcs);
+		if (rcs->status == RESULT_CACHE_STATUS__MISS)
+			rcs->status = RESULT_CACHE_STATUS__DISCARD;
+		pfree(version.data);
+		pfree(rcs->buf.data);
+		rcs->buf.data = NULL;
+	}
+	else
+	{
+		mtup = ExecFetchSlotMinimalTuple(slot, &should_free);
+		if (rcs->buf.len + MAXALIGN(mtup->t_len) > pgstrom_gpu_result_cache_size)
+		{
+			/* too large results to save */
+			rcs->status = RESULT_CACHE_STATUS__DISCARD;
+			pfree(rcs->buf.data);
+			rcs->buf.data = NULL;
+		}
+		else
+		{
+			appendBinaryStringInfo(&rcs->buf, (char *)mtup, mtup->t_len);
+			while (rcs->buf.len != MAXALIGN(rcs->buf.len))
+				appendStringInfoChar(&rcs->buf, '\0');
+			rcs->ntuples++;
+		}
+		if (should_free)
+			pfree(mtup);
+	}
+	return slot;
+}
+
+/*
+ * pgstrom_result_cache_end
+ *
+ * It releases the result cache state. Rescan shall not use the result cache
+ * any more, because results of the GpuTaskState are no longer complete.
+ */
+void
+pgstrom_result_cache_end(GpuTaskState *gts)
+{
+	resultCacheState *rcs = gts->rcache_state;
+
+	if (rcs)
+	{
+		if (rcs->buf.data)
+			pfree(rcs->buf.data);
+		pfree(rcs->key.data);
+		pfree(rcs);
+		gts->rcache_state = NULL;
+	}
+}
+
+/*
+ * pgstrom_result_cache_explain
+ */
+void
+pgstrom_result_cache_explain(GpuTaskState *gts, ExplainState *es)
+{
+	resultCacheState *rcs = gts->rcache_state;
+	const char *label;
+	char		temp[120];
+
+	if (!rcs || !es->analyze)
+		return;
+	switch (rcs->status)
+	{
+		case RESULT_CACHE_STATUS__HIT:
+			label = "hit";
+			break;
+		case RESULT_CACHE_STATUS__SAVED:
+			label = "miss, saved";
+			break;
+		case RESULT_CACHE_STATUS__DISCARD:
+			label = "miss, not saved";
+			break;
+		default:
+			label = "miss";
+			break;
+	}
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		snprintf(temp, sizeof(temp), "%s (%ld rows)",
+				 label, (long)rcs->ntuples);
+		ExplainPropertyText("Result Cache", temp, es);
+	}
+	else
+	{
+		ExplainPropertyText("Result Cache", label, es);
+		ExplainPropertyInteger("Result Cache Rows", NULL, rcs->ntuples, es);
+	}
+}
+
+/*
+ * pgstrom_startup_result_cache
+ */
+static void
+pgstrom_startup_result_cache(void)
+{
+	bool		found;
+	int			i;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	rcache_head = ShmemInitStruct("PG-Strom Result Cache Head",
+								  sizeof(resultCacheHead),
+								  &found);
+	if (found)
+		elog(ERROR, "Bug? resultCacheHead already exists");
+	memset(rcache_head, 0, sizeof(resultCacheHead));
+	LWLockInitialize(&rcache_head->lock, -1);
+	dlist_init(&rcache_head->lru_list);
+	for (i=0; i < RESULT_CACHE_NSLOTS; i++)
+		dlist_init(&rcache_head->hash_slots[i]);
+}
+
+/*
+ * pgstrom_init_result_cache
+ */
+void
+pgstrom_init_result_cache(void)
+{
+	DefineCustomBoolVariable("pg_strom.gpu_result_cache",
+							 "Enables the result cache of GpuPreAgg on Arrow_Fdw/Gstore_Fdw",
+							 NULL,
+							 &pgstrom_gpu_result_cache,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.gpu_result_cache_size",
+							"Total size of the result cache",
+							NULL,
+							&pgstrom_gpu_result_cache_size_kb,
+							65536,		/* 64MB */
+							0,
+							INT_MAX,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(resultCacheHead)));
+	shmem_startup_next = shmem_startup_hook;
+	shmem_startup_hook = pgstrom_startup_result_cache;
+}
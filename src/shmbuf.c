@@ -92,6 +92,8 @@ static struct sigaction sigaction_orig_sigbus;
 static size_t	shmbuf_segment_size;
 static int		shmbuf_segment_size_kb;		/* GUC */
 static int		shmbuf_num_logical_segment;	/* GUC */
+static char	   *shmbuf_hugetlbfs_path = NULL;	/* GUC */
+static size_t	shmbuf_huge_page_size = 0;
 static shmBufferSegmentHead *shmBufSegHead = NULL;	/* shared memory */
 static shmBufferLocalMap *shmBufLocalMaps = NULL;
 static char	   *shmbuf_segment_vaddr_head = NULL;
@@ -138,6 +140,37 @@ shmBufferSegmentFromChunk(shmBufferChunk *chunk)
 	snprintf((namebuf),NAMEDATALEN,"/.pg_shmbuf_%u.%u:%u",	\
 			 PostPortNumber,(segment_id),(revision)>>1)
 
+/*
+ * shmBufferOpenFile / shmBufferUnlinkFile
+ *
+ * shared memory segment is a file on the hugetlbfs if shmbuf.hugetlbfs_path
+ * is configured, or a POSIX shared memory object elsewhere. These routines
+ * are also called in the signal handler, so must be async-signal-safe.
+ */
+static int
+shmBufferOpenFile(const char *namebuf, int flags)
+{
+	char		pathbuf[MAXPGPATH];
+
+	if (!shmbuf_hugetlbfs_path)
+		return shm_open(namebuf, flags, 0600);
+	strlcpy(pathbuf, shmbuf_hugetlbfs_path, MAXPGPATH);
+	strlcat(pathbuf, namebuf, MAXPGPATH);
+	return open(pathbuf, flags, 0600);
+}
+
+static int
+shmBufferUnlinkFile(const char *namebuf)
+{
+	char		pathbuf[MAXPGPATH];
+
+	if (!shmbuf_hugetlbfs_path)
+		return shm_unlink(namebuf);
+	strlcpy(pathbuf, shmbuf_hugetlbfs_path, MAXPGPATH);
+	strlcat(pathbuf, namebuf, MAXPGPATH);
+	return unlink(pathbuf);
+}
+
 /*
  * shmBufferAttachSegmentOnDemand
  *
@@ -222,7 +255,7 @@ shmBufferAttachSegmentOnDemand(int signum, siginfo_t *siginfo, void *unused)
 		 * Open an "existing" shared memory segment
 		 */
 		SHMBUF_SEGMENT_FILENAME(namebuf, segment_id, revision);
-		fdesc = shm_open(namebuf, O_RDWR, 0600);
+		fdesc = shmBufferOpenFile(namebuf, O_RDWR);
 		if (fdesc < 0)
 		{
 			SpinLockRelease(&lmap->mutex);
@@ -240,7 +273,7 @@ shmBufferAttachSegmentOnDemand(int signum, siginfo_t *siginfo, void *unused)
 				 fdesc, 0) != mmap_ptr)
 		{
 			close(fdesc);
-			shm_unlink(namebuf);
+			shmBufferUnlinkFile(namebuf);
 			SpinLockRelease(&lmap->mutex);
 			fprintf(stderr, "pid=%u: %s on %p (seg_id=%u,rev=%u) - "
 					"failed on mmap('%s'): %m",
@@ -299,6 +332,7 @@ shmBufferCreateSegment(void)
 	char	   *tail_ptr;
 	char		namebuf[NAMEDATALEN];
 	int			i, fdesc;
+	bool		numa_policy;
 	
 	/* pick up a free shared memory segment */
 	SpinLockAcquire(&shmBufSegHead->lock);
@@ -345,18 +379,27 @@ shmBufferCreateSegment(void)
 	/*
 	 * Create a new shared memory segment
 	 */
-	fdesc = shm_open(namebuf, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	fdesc = shmBufferOpenFile(namebuf, O_RDWR | O_CREAT | O_TRUNC);
 	if (fdesc < 0)
 		elog(ERROR, "failed on shm_open('%s'): %m", namebuf);
 
+	/*
+	 * shared memory segment is not tied to a particular GPU, so its pages
+	 * are interleaved on the numa-nodes where GPUs are installed.
+	 */
+	numa_policy = gpuDeviceSetNumaMemPolicy(-1);
 	while (fallocate(fdesc, 0, 0, shmbuf_segment_size) != 0)
 	{
 		if (errno == EINTR)
 			continue;
+		if (numa_policy)
+			gpuDeviceResetNumaMemPolicy();
 		close(fdesc);
-		shm_unlink(namebuf);
+		shmBufferUnlinkFile(namebuf);
 		elog(ERROR, "failed on fallocate('%s'): %m", namebuf);
 	}
+	if (numa_policy)
+		gpuDeviceResetNumaMemPolicy();
 
 	if (mmap(mmap_ptr, shmbuf_segment_size,
 			 PROT_READ | PROT_WRITE,
@@ -364,7 +407,7 @@ shmBufferCreateSegment(void)
 			 fdesc, 0) != mmap_ptr)
 	{
 		close(fdesc);
-		shm_unlink(namebuf);
+		shmBufferUnlinkFile(namebuf);
 		elog(ERROR, "failed on mmap('%s'): %m", namebuf);
 	}
 	close(fdesc);
@@ -446,12 +489,12 @@ shmBufferDropSegment(shmBufferSegment *seg)
 	 * exception, and signal handler unmap the segment at other processes also.
 	 */
 	SHMBUF_SEGMENT_FILENAME(namebuf, segment_id, revision);
-	fdesc = shm_open(namebuf, O_RDWR | O_TRUNC, 0600);
+	fdesc = shmBufferOpenFile(namebuf, O_RDWR | O_TRUNC);
 	if (fdesc < 0)
 		elog(FATAL, "failed on shm_opem('%s') with O_TRUNC: %m", namebuf);
 	close(fdesc);
 
-	if (shm_unlink(namebuf) < 0)
+	if (shmBufferUnlinkFile(namebuf) < 0)
 		elog(FATAL, "failed on shm_unlink('%s'): %m", namebuf);
 }
 
@@ -650,11 +693,12 @@ shmBufferCleanupOnPostmasterExit(int code, Datum arg)
 {
 	if (MyProcPid == PostmasterPid)
 	{
-		DIR			   *dir = opendir("/dev/shm");
+		DIR			   *dir;
 		struct dirent  *dentry;
 		char			namebuf[NAMEDATALEN];
 		size_t			namelen;
 
+		dir = opendir(shmbuf_hugetlbfs_path ? shmbuf_hugetlbfs_path : "/dev/shm");
 		namelen = snprintf(namebuf, sizeof(namebuf),
 						   ".pg_shmbuf_%u.", PostPortNumber);
 		if (!dir)
@@ -665,7 +709,10 @@ shmBufferCleanupOnPostmasterExit(int code, Datum arg)
 				continue;
 			if (strncmp(dentry->d_name, namebuf, namelen) == 0)
 			{
-				if (shm_unlink(dentry->d_name) != 0)
+				char	fname[MAXPGPATH];
+
+				snprintf(fname, sizeof(fname), "/%s", dentry->d_name);
+				if (shmBufferUnlinkFile(fname) != 0)
 					elog(LOG, "failed on shm_unlink('%s'): %m",
 						 dentry->d_name);
 				else
@@ -1428,14 +1475,44 @@ pgstrom_init_shmbuf(void)
 							PGC_POSTMASTER,
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
-	/* preserver private address space but no physical memory assignment */
+	DefineCustomStringVariable("shmbuf.hugetlbfs_path",
+							   "Mount point of hugetlbfs for the shared memory segments",
+							   "page size of the segments is the one of the hugetlbfs",
+							   &shmbuf_hugetlbfs_path,
+							   NULL,
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	if (shmbuf_hugetlbfs_path)
+	{
+		struct statfs	statbuf;
+
+		if (statfs(shmbuf_hugetlbfs_path, &statbuf) != 0)
+			elog(ERROR, "failed on statfs('%s'): %m", shmbuf_hugetlbfs_path);
+		if (statbuf.f_type != HUGETLBFS_MAGIC)
+			elog(ERROR, "shmbuf.hugetlbfs_path ('%s') is not hugetlbfs",
+				 shmbuf_hugetlbfs_path);
+		shmbuf_huge_page_size = statbuf.f_bsize;
+		if (shmbuf_segment_size % shmbuf_huge_page_size != 0)
+			elog(ERROR, "shmbuf.segment_size (%dkB) is not multiple of the huge page size (%zukB)",
+				 shmbuf_segment_size_kb, shmbuf_huge_page_size >> 10);
+	}
+
+	/*
+	 * preserver private address space but no physical memory assignment.
+	 * hugetlbfs file has to be mapped at the address aligned to the huge
+	 * page size.
+	 */
 	length = shmbuf_segment_size * shmbuf_num_logical_segment;
-	shmbuf_segment_vaddr_head = mmap(NULL, length,
+	shmbuf_segment_vaddr_head = mmap(NULL, length + shmbuf_huge_page_size,
 									 PROT_NONE,
 									 MAP_PRIVATE | MAP_ANONYMOUS,
 									 -1, 0);
 	if (shmbuf_segment_vaddr_head == MAP_FAILED)
 		elog(ERROR, "failed on mmap(2): %m");
+	if (shmbuf_huge_page_size > 0)
+		shmbuf_segment_vaddr_head = (char *)
+			TYPEALIGN(shmbuf_huge_page_size, shmbuf_segment_vaddr_head);
 	shmbuf_segment_vaddr_tail = shmbuf_segment_vaddr_head + length;
 
 	/* allocation of static shared memory */
@@ -0,0 +1,117 @@
+--
+-- test for approximate aggregate functions on GpuPreAgg
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_agg_approx_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_agg_approx_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_agg_approx_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  cat  int,
+  uid  int,
+  tag  text,
+  v    float8
+);
+INSERT INTO rt_data (
+  SELECT x, x % 5,
+            (x * 7919) % 5000,
+            CASE WHEN x % 13 = 0 THEN NULL
+                 ELSE 'tag-' || ((x * 104729) % 3000)
+            END,
+            ((x * 104729) % 10000 + 1) / 10.0
+    FROM generate_series(1,100000) x);
+VACUUM ANALYZE;
+-- force to use GpuPreAgg, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- sketch keys are added to the grouping keys
+SET pg_strom.gpupreagg_reduction_threshold = 1;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuPreAgg
+CREATE OR REPLACE FUNCTION explain_gpupreagg(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuPreAgg' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- hll_count() shall be identical to the one on CPU
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, pgstrom.hll_count(uid) hu, pgstrom.hll_count(tag) ht, count(*) nrows FROM rt_data GROUP BY cat');
+SELECT cat, pgstrom.hll_count(uid) hu, pgstrom.hll_count(tag) ht,
+            count(*) nrows
+  INTO test01g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, pgstrom.hll_count(uid) hu, pgstrom.hll_count(tag) ht,
+            count(*) nrows
+  INTO test01p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY cat;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY cat;
+
+-- approx_percentile() shall be identical to the one on CPU
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, pgstrom.approx_percentile(v, 0.5) p50, pgstrom.approx_percentile(v, 0.9) p90 FROM rt_data GROUP BY cat');
+SELECT cat, pgstrom.approx_percentile(v, 0.5) p50,
+            pgstrom.approx_percentile(v, 0.9) p90
+  INTO test02g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, pgstrom.approx_percentile(v, 0.5) p50,
+            pgstrom.approx_percentile(v, 0.9) p90
+  INTO test02p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY cat;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY cat;
+
+-- approximate aggregates without GROUP BY
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT pgstrom.hll_count(uid) hu, pgstrom.approx_percentile(v, 0.25) p25 FROM rt_data WHERE id > 1000');
+SELECT pgstrom.hll_count(uid) hu,
+       pgstrom.approx_percentile(v, 0.25) p25
+  INTO test03g
+  FROM rt_data
+ WHERE id > 1000;
+SET pg_strom.enabled = off;
+SELECT pgstrom.hll_count(uid) hu,
+       pgstrom.approx_percentile(v, 0.25) p25
+  INTO test03p
+  FROM rt_data
+ WHERE id > 1000;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY hu;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY hu;
+
+-- accuracy of the estimation
+SET pg_strom.enabled = on;
+SELECT cat, abs(hu - nu)::float / nu < 0.05 hll_ok,
+            abs(p50 - e50) / e50 < 0.02 dds_ok
+  FROM (SELECT cat, pgstrom.hll_count(uid) hu, count(DISTINCT uid) nu,
+               pgstrom.approx_percentile(v, 0.5) p50,
+               percentile_cont(0.5) WITHIN GROUP (ORDER BY v) e50
+          FROM rt_data
+         GROUP BY cat) qry
+ ORDER BY cat;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_agg_approx_temp CASCADE;
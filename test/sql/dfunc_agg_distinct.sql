@@ -0,0 +1,117 @@
+--
+-- test for DISTINCT aggregates on GpuPreAgg
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_agg_distinct_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_agg_distinct_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_agg_distinct_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  cat  int,
+  uid  int,
+  tag  text,
+  a    int8
+);
+INSERT INTO rt_data (
+  SELECT x, x % 10,
+            (x * 7919) % 40,
+            CASE WHEN x % 17 = 0 THEN NULL
+                 ELSE 't' || ((x * 7919) % 5)
+            END,
+            (x * 104729) % 1000
+    FROM generate_series(1,20000) x);
+VACUUM ANALYZE;
+-- force to use GpuPreAgg, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- arguments of DISTINCT aggregates are added to the grouping keys
+SET pg_strom.gpupreagg_reduction_threshold = 5;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuPreAgg
+CREATE OR REPLACE FUNCTION explain_gpupreagg(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuPreAgg' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- count(DISTINCT) with other aggregates
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, count(DISTINCT uid) nu, count(*) nrows, sum(a) sum_a FROM rt_data GROUP BY cat');
+SELECT cat, count(DISTINCT uid) nu, count(*) nrows, sum(a) sum_a
+  INTO test01g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, count(DISTINCT uid) nu, count(*) nrows, sum(a) sum_a
+  INTO test01p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY cat;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY cat;
+
+-- multiple DISTINCT aggregates on different arguments
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, count(DISTINCT tag) nt, sum(DISTINCT uid) su, avg(a)::numeric(12,4) avg_a, max(tag) mt FROM rt_data GROUP BY cat');
+SELECT cat, count(DISTINCT tag) nt, sum(DISTINCT uid) su,
+            avg(a)::numeric(12,4) avg_a, max(tag) mt
+  INTO test02g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, count(DISTINCT tag) nt, sum(DISTINCT uid) su,
+            avg(a)::numeric(12,4) avg_a, max(tag) mt
+  INTO test02p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY cat;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY cat;
+
+-- DISTINCT aggregate without GROUP BY
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT count(DISTINCT uid) nu, count(DISTINCT tag) nt, count(*) nrows FROM rt_data WHERE id > 1000');
+SELECT count(DISTINCT uid) nu, count(DISTINCT tag) nt, count(*) nrows
+  INTO test03g
+  FROM rt_data
+ WHERE id > 1000;
+SET pg_strom.enabled = off;
+SELECT count(DISTINCT uid) nu, count(DISTINCT tag) nt, count(*) nrows
+  INTO test03p
+  FROM rt_data
+ WHERE id > 1000;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY nu;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY nu;
+
+-- DISTINCT aggregate with FILTER is not supported
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, count(DISTINCT uid) FILTER (WHERE a > 500) nu FROM rt_data GROUP BY cat');
+SELECT cat, count(DISTINCT uid) FILTER (WHERE a > 500) nu
+  INTO test04g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, count(DISTINCT uid) FILTER (WHERE a > 500) nu
+  INTO test04p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test04g EXCEPT SELECT * FROM test04p) ORDER BY cat;
+(SELECT * FROM test04p EXCEPT SELECT * FROM test04g) ORDER BY cat;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_agg_distinct_temp CASCADE;
@@ -0,0 +1,109 @@
+--
+-- test for aggregate functions on float2 by GpuPreAgg
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_agg_float2_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_agg_float2_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_agg_float2_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  cat  int,
+  a    float2,   -- multiple of 0.25, so partial sums are exact
+  b    float2    -- contains NULLs
+);
+INSERT INTO rt_data (
+  SELECT x, x % 11,
+            ((x * 7919) % 2001 - 1000) / 4.0,
+            CASE WHEN x % 13 = 0 THEN NULL
+                 ELSE ((x * 104729) % 801 - 400) / 8.0
+            END
+    FROM generate_series(1,6000) x);
+VACUUM ANALYZE;
+-- force to use GpuPreAgg, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuPreAgg
+CREATE OR REPLACE FUNCTION explain_gpupreagg(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuPreAgg' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- sum() and avg() on float2
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, count(*) nrows, sum(a) sum_a, avg(a) avg_a, count(b) nb, sum(b) sum_b, avg(b) avg_b FROM rt_data GROUP BY cat');
+SELECT cat, count(*) nrows, sum(a) sum_a, avg(a) avg_a,
+            count(b) nb, sum(b) sum_b, avg(b) avg_b
+  INTO test01g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, count(*) nrows, sum(a) sum_a, avg(a) avg_a,
+            count(b) nb, sum(b) sum_b, avg(b) avg_b
+  INTO test01p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY cat;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY cat;
+
+-- variance and standard deviation on float2; rounded because the
+-- device accumulates sum of squares, unlike CPU
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, variance(a), var_pop(a), var_samp(b), stddev(a), stddev_pop(b), stddev_samp(b) FROM rt_data GROUP BY cat');
+SELECT cat, round(variance(a)::numeric, 6) v1,
+            round(var_pop(a)::numeric, 6) v2,
+            round(var_samp(b)::numeric, 6) v3,
+            round(stddev(a)::numeric, 6) s1,
+            round(stddev_pop(b)::numeric, 6) s2,
+            round(stddev_samp(b)::numeric, 6) s3
+  INTO test02g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, round(variance(a)::numeric, 6) v1,
+            round(var_pop(a)::numeric, 6) v2,
+            round(var_samp(b)::numeric, 6) v3,
+            round(stddev(a)::numeric, 6) s1,
+            round(stddev_pop(b)::numeric, 6) s2,
+            round(stddev_samp(b)::numeric, 6) s3
+  INTO test02p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY cat;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY cat;
+
+-- aggregation without GROUP BY
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT sum(a) sum_a, avg(b) avg_b, round(stddev(b)::numeric, 6) sd FROM rt_data WHERE id > 100');
+SELECT sum(a) sum_a, avg(b) avg_b, round(stddev(b)::numeric, 6) sd
+  INTO test03g
+  FROM rt_data
+ WHERE id > 100;
+SET pg_strom.enabled = off;
+SELECT sum(a) sum_a, avg(b) avg_b, round(stddev(b)::numeric, 6) sd
+  INTO test03p
+  FROM rt_data
+ WHERE id > 100;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY sum_a;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY sum_a;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_agg_float2_temp CASCADE;
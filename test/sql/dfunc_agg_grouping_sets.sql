@@ -0,0 +1,119 @@
+--
+-- test for GROUPING SETS, ROLLUP and CUBE on GpuPreAgg
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_agg_grouping_sets_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_agg_grouping_sets_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_agg_grouping_sets_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  a    int,
+  b    text,
+  c    date,
+  v    int8,
+  w    numeric(9,2)
+);
+INSERT INTO rt_data (
+  SELECT x, x % 5,
+            'b' || (x % 4),
+            CASE WHEN x % 11 = 0 THEN NULL
+                 ELSE '2020-01-01'::date + (x % 3)
+            END,
+            (x * 7919) % 1000,
+            ((x * 104729) % 100000) / 100.0
+    FROM generate_series(1,20000) x);
+VACUUM ANALYZE;
+-- force to use GpuPreAgg, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuPreAgg
+CREATE OR REPLACE FUNCTION explain_gpupreagg(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuPreAgg' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- GROUPING SETS
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT a, b, c, count(*) nrows, sum(v) sum_v, max(w) max_w FROM rt_data GROUP BY GROUPING SETS ((a, b), (c), ())');
+SELECT a, b, c, count(*) nrows, sum(v) sum_v, max(w) max_w
+  INTO test01g
+  FROM rt_data
+ GROUP BY GROUPING SETS ((a, b), (c), ());
+SET pg_strom.enabled = off;
+SELECT a, b, c, count(*) nrows, sum(v) sum_v, max(w) max_w
+  INTO test01p
+  FROM rt_data
+ GROUP BY GROUPING SETS ((a, b), (c), ());
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY a, b, c;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY a, b, c;
+
+-- ROLLUP with GROUPING()
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT a, b, grouping(a, b) g, count(*) nrows, avg(v)::numeric(12,4) avg_v FROM rt_data GROUP BY ROLLUP (a, b)');
+SELECT a, b, grouping(a, b) g, count(*) nrows, avg(v)::numeric(12,4) avg_v
+  INTO test02g
+  FROM rt_data
+ GROUP BY ROLLUP (a, b);
+SET pg_strom.enabled = off;
+SELECT a, b, grouping(a, b) g, count(*) nrows, avg(v)::numeric(12,4) avg_v
+  INTO test02p
+  FROM rt_data
+ GROUP BY ROLLUP (a, b);
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY a, b, g;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY a, b, g;
+
+-- CUBE with HAVING
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT b, c, count(*) nrows, sum(w) sum_w, min(v) min_v FROM rt_data WHERE id % 7 != 0 GROUP BY CUBE (b, c) HAVING sum(w) > 10000.0');
+SELECT b, c, count(*) nrows, sum(w) sum_w, min(v) min_v
+  INTO test03g
+  FROM rt_data
+ WHERE id % 7 != 0
+ GROUP BY CUBE (b, c)
+HAVING sum(w) > 10000.0;
+SET pg_strom.enabled = off;
+SELECT b, c, count(*) nrows, sum(w) sum_w, min(v) min_v
+  INTO test03p
+  FROM rt_data
+ WHERE id % 7 != 0
+ GROUP BY CUBE (b, c)
+HAVING sum(w) > 10000.0;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY b, c;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY b, c;
+
+-- mixture of plain GROUP BY and ROLLUP
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT a, b, c, count(*) nrows, sum(v) sum_v FROM rt_data GROUP BY a, ROLLUP (b, c)');
+SELECT a, b, c, count(*) nrows, sum(v) sum_v
+  INTO test04g
+  FROM rt_data
+ GROUP BY a, ROLLUP (b, c);
+SET pg_strom.enabled = off;
+SELECT a, b, c, count(*) nrows, sum(v) sum_v
+  INTO test04p
+  FROM rt_data
+ GROUP BY a, ROLLUP (b, c);
+(SELECT * FROM test04g EXCEPT SELECT * FROM test04p) ORDER BY a, b, c;
+(SELECT * FROM test04p EXCEPT SELECT * FROM test04g) ORDER BY a, b, c;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_agg_grouping_sets_temp CASCADE;
@@ -0,0 +1,118 @@
+--
+-- test for mode() on GpuPreAgg
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_agg_mode_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_agg_mode_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_agg_mode_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  cat  int,
+  a    int4,
+  b    text,
+  c    date,
+  n    numeric,   -- 1.0 and 1.00 are equal, but not identical
+  f    float8,    -- 0 and -0 are equal, but not identical
+  v    interval   -- '1 day' and '24 hours' are equal, but not identical
+);
+INSERT INTO rt_data (
+  SELECT x, x % 7,
+            (x * 7919) % 13,
+            'v' || ((x * 31) % 11),
+            '2020-01-01'::date + (x * 17) % 9,
+            CASE WHEN x % 3 = 0 THEN 1.0 ELSE 1.00 END,
+            CASE WHEN x % 3 = 0 THEN 0.0::float8 ELSE -0.0::float8 END,
+            CASE WHEN x % 3 = 0 THEN '1 day'::interval ELSE '24 hours'::interval END
+    FROM generate_series(1,3000) x);
+VACUUM ANALYZE;
+
+-- force to use GpuPreAgg, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuPreAgg
+CREATE OR REPLACE FUNCTION explain_gpupreagg(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuPreAgg' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- mode() on the types whose equality implies binary identity
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, mode() WITHIN GROUP (ORDER BY a) a, mode() WITHIN GROUP (ORDER BY b) b, mode() WITHIN GROUP (ORDER BY c) c, count(*) nrows FROM rt_data GROUP BY cat');
+SELECT cat, mode() WITHIN GROUP (ORDER BY a) a,
+            mode() WITHIN GROUP (ORDER BY b) b,
+            mode() WITHIN GROUP (ORDER BY c) c,
+            count(*) nrows
+  INTO test01g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, mode() WITHIN GROUP (ORDER BY a) a,
+            mode() WITHIN GROUP (ORDER BY b) b,
+            mode() WITHIN GROUP (ORDER BY c) c,
+            count(*) nrows
+  INTO test01p
+  FROM rt_data
+ GROUP BY cat;
+SELECT cat, a, b, nrows FROM test01g ORDER BY cat;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY cat;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY cat;
+-- mode() with FILTER and GROUP BY on the same column
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT a, mode() WITHIN GROUP (ORDER BY a) FILTER (WHERE cat > 2) m, mode() WITHIN GROUP (ORDER BY b) mb FROM rt_data GROUP BY a');
+SELECT a, mode() WITHIN GROUP (ORDER BY a) FILTER (WHERE cat > 2) m,
+           mode() WITHIN GROUP (ORDER BY b) mb
+  INTO test02g
+  FROM rt_data
+ GROUP BY a;
+SET pg_strom.enabled = off;
+SELECT a, mode() WITHIN GROUP (ORDER BY a) FILTER (WHERE cat > 2) m,
+           mode() WITHIN GROUP (ORDER BY b) mb
+  INTO test02p
+  FROM rt_data
+ GROUP BY a;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY a;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY a;
+-- equal but not identical values shall not be merged on the device,
+-- and order sensitive aggregates are not supported
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, mode() WITHIN GROUP (ORDER BY n) FROM rt_data GROUP BY cat');
+SELECT explain_gpupreagg('SELECT cat, mode() WITHIN GROUP (ORDER BY f) FROM rt_data GROUP BY cat');
+SELECT explain_gpupreagg('SELECT cat, mode() WITHIN GROUP (ORDER BY v) FROM rt_data GROUP BY cat');
+SELECT explain_gpupreagg('SELECT cat, mode() WITHIN GROUP (ORDER BY a DESC) FROM rt_data GROUP BY cat');
+SELECT explain_gpupreagg('SELECT cat, array_agg(a) FROM rt_data GROUP BY cat');
+SELECT explain_gpupreagg('SELECT cat, string_agg(b, '','') FROM rt_data GROUP BY cat');
+SELECT cat, mode() WITHIN GROUP (ORDER BY n)::text n,
+            mode() WITHIN GROUP (ORDER BY f)::text f,
+            mode() WITHIN GROUP (ORDER BY v)::text v
+  INTO test03g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, mode() WITHIN GROUP (ORDER BY n)::text n,
+            mode() WITHIN GROUP (ORDER BY f)::text f,
+            mode() WITHIN GROUP (ORDER BY v)::text v
+  INTO test03p
+  FROM rt_data
+ GROUP BY cat;
+SELECT count(*) FROM test03g;
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_agg_mode_temp CASCADE;
@@ -0,0 +1,116 @@
+--
+-- test for exact sum/avg of numeric(p,s) on GpuPreAgg
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_agg_numeric_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_agg_numeric_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_agg_numeric_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  cat  int,
+  q    numeric(6,2),
+  a    numeric(12,2),
+  b    numeric(18,4),
+  c    numeric(18,2)
+);
+INSERT INTO rt_data (
+  SELECT x, x % 10,
+            0.01,
+            CASE WHEN x % 13 = 0 THEN NULL
+                 ELSE ((x * 7919) % 2000000 - 1000000) / 100.0
+            END,
+            ((x * 104729) % 100000000 - 50000000) / 10000.0,
+            9999999999999999.99 - (x * 7919) % 100000 / 100.0
+    FROM generate_series(1,20000) x);
+VACUUM ANALYZE;
+-- force to use GpuPreAgg, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuPreAgg
+CREATE OR REPLACE FUNCTION explain_gpupreagg(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuPreAgg' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- sum() of numeric(p,s) shall not lose precision
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, sum(q) sum_q, sum(a) sum_a, sum(b) sum_b, sum(c) sum_c FROM rt_data GROUP BY cat');
+SELECT cat, sum(q) sum_q, sum(a) sum_a, sum(b) sum_b, sum(c) sum_c
+  INTO test01g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, sum(q) sum_q, sum(a) sum_a, sum(b) sum_b, sum(c) sum_c
+  INTO test01p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY cat;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY cat;
+SELECT cat, sum_q = 20.00 exact FROM test01g ORDER BY cat;
+
+-- avg() of numeric(p,s)
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, avg(a) avg_a, avg(b) avg_b, avg(c) avg_c, count(a) cnt_a FROM rt_data GROUP BY cat');
+SELECT cat, avg(a) avg_a, avg(b) avg_b, avg(c) avg_c, count(a) cnt_a
+  INTO test02g
+  FROM rt_data
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, avg(a) avg_a, avg(b) avg_b, avg(c) avg_c, count(a) cnt_a
+  INTO test02p
+  FROM rt_data
+ GROUP BY cat;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY cat;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY cat;
+
+-- no rows to be aggregated
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT cat, sum(a) sum_a, avg(a) avg_a FROM rt_data WHERE a IS NULL GROUP BY cat');
+SELECT cat, sum(a) sum_a, avg(a) avg_a
+  INTO test03g
+  FROM rt_data
+ WHERE a IS NULL
+ GROUP BY cat;
+SET pg_strom.enabled = off;
+SELECT cat, sum(a) sum_a, avg(a) avg_a
+  INTO test03p
+  FROM rt_data
+ WHERE a IS NULL
+ GROUP BY cat;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY cat;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY cat;
+
+-- no GROUP BY clause
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT sum(a) sum_a, avg(b) avg_b, sum(c) sum_c FROM rt_data');
+SELECT sum(a) sum_a, avg(b) avg_b, sum(c) sum_c
+  INTO test04g
+  FROM rt_data;
+SET pg_strom.enabled = off;
+SELECT sum(a) sum_a, avg(b) avg_b, sum(c) sum_c
+  INTO test04p
+  FROM rt_data;
+(SELECT * FROM test04g EXCEPT SELECT * FROM test04p) ORDER BY sum_a;
+(SELECT * FROM test04p EXCEPT SELECT * FROM test04g) ORDER BY sum_a;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_agg_numeric_temp CASCADE;
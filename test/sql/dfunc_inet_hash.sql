@@ -0,0 +1,126 @@
+--
+-- test for GpuHashJoin on inet/cidr keys
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_inet_hash_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_inet_hash_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_inet_hash_temp,public;
+CREATE TABLE rt_outer (
+  id    int,
+  addr  inet,
+  net   cidr,
+  v     int
+);
+INSERT INTO rt_outer (
+  SELECT x, a, network(set_masklen(a, CASE WHEN family(a) = 4 THEN 16 ELSE 48 END)), x % 1000
+    FROM (SELECT x, CASE WHEN x % 41 = 0 THEN NULL
+                         WHEN x % 3 = 0
+                         THEN ('2001:db8::' || to_hex(x % 509) ||
+                               CASE WHEN x % 2 = 0 THEN '/128' ELSE '/64' END)::inet
+                         ELSE ('10.' || x % 4 || '.' || x % 251 || '.' || x % 7 ||
+                               CASE WHEN x % 5 = 0 THEN '/24' ELSE '' END)::inet
+                    END a
+            FROM generate_series(1,20000) x) s);
+CREATE TABLE rt_inner (
+  aid   int,
+  addr  inet,
+  label text
+);
+INSERT INTO rt_inner (
+  SELECT y, ro.addr, 'label-' || y
+    FROM generate_series(1,600) y, rt_outer ro
+   WHERE ro.id = y * 31 AND y % 5 != 0);
+CREATE TABLE rt_net (
+  net    cidr,
+  region text
+);
+INSERT INTO rt_net (
+  SELECT net, 'region-' || row_number() OVER (ORDER BY net)
+    FROM (SELECT DISTINCT net FROM rt_outer WHERE net IS NOT NULL) s);
+VACUUM ANALYZE;
+-- force to use GpuJoin, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuHashJoin
+CREATE OR REPLACE FUNCTION explain_gpuhashjoin(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuHashJoin' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- GpuHashJoin on inet keys
+SET pg_strom.enabled = on;
+SELECT explain_gpuhashjoin('SELECT o.id, o.addr, i.label FROM rt_outer o JOIN rt_inner i ON o.addr = i.addr');
+SELECT o.id, o.addr, i.label
+  INTO test01g
+  FROM rt_outer o JOIN rt_inner i ON o.addr = i.addr;
+SET pg_strom.enabled = off;
+SELECT o.id, o.addr, i.label
+  INTO test01p
+  FROM rt_outer o JOIN rt_inner i ON o.addr = i.addr;
+(SELECT * FROM test01g EXCEPT ALL SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT ALL SELECT * FROM test01g) ORDER BY id;
+
+-- GpuHashJoin on cidr keys
+SET pg_strom.enabled = on;
+SELECT explain_gpuhashjoin('SELECT o.id, o.net, n.region FROM rt_outer o JOIN rt_net n ON o.net = n.net');
+SELECT o.id, o.net, n.region
+  INTO test02g
+  FROM rt_outer o JOIN rt_net n ON o.net = n.net;
+SET pg_strom.enabled = off;
+SELECT o.id, o.net, n.region
+  INTO test02p
+  FROM rt_outer o JOIN rt_net n ON o.net = n.net;
+(SELECT * FROM test02g EXCEPT ALL SELECT * FROM test02p) ORDER BY id;
+(SELECT * FROM test02p EXCEPT ALL SELECT * FROM test02g) ORDER BY id;
+
+-- LEFT OUTER GpuHashJoin on inet keys with NULLs
+SET pg_strom.enabled = on;
+SELECT explain_gpuhashjoin('SELECT o.id, o.addr, i.aid FROM rt_outer o LEFT JOIN rt_inner i ON o.addr = i.addr WHERE o.id % 3 = 0');
+SELECT o.id, o.addr, i.aid
+  INTO test03g
+  FROM rt_outer o LEFT JOIN rt_inner i ON o.addr = i.addr
+ WHERE o.id % 3 = 0;
+SET pg_strom.enabled = off;
+SELECT o.id, o.addr, i.aid
+  INTO test03p
+  FROM rt_outer o LEFT JOIN rt_inner i ON o.addr = i.addr
+ WHERE o.id % 3 = 0;
+(SELECT * FROM test03g EXCEPT ALL SELECT * FROM test03p) ORDER BY id;
+(SELECT * FROM test03p EXCEPT ALL SELECT * FROM test03g) ORDER BY id;
+
+-- aggregation over GpuHashJoin on inet keys
+SET pg_strom.enabled = on;
+SELECT explain_gpuhashjoin('SELECT i.addr, count(*) nrows, sum(o.v) sum_v FROM rt_outer o JOIN rt_inner i ON o.addr = i.addr GROUP BY i.addr');
+SELECT i.addr, count(*) nrows, sum(o.v) sum_v
+  INTO test04g
+  FROM rt_outer o JOIN rt_inner i ON o.addr = i.addr
+ GROUP BY i.addr;
+SET pg_strom.enabled = off;
+SELECT i.addr, count(*) nrows, sum(o.v) sum_v
+  INTO test04p
+  FROM rt_outer o JOIN rt_inner i ON o.addr = i.addr
+ GROUP BY i.addr;
+(SELECT * FROM test04g EXCEPT SELECT * FROM test04p) ORDER BY addr;
+(SELECT * FROM test04p EXCEPT SELECT * FROM test04g) ORDER BY addr;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_inet_hash_temp CASCADE;
@@ -0,0 +1,131 @@
+--
+-- test for jsonb path extraction (#>, #>>) on GPU
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_jsonb_path_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_jsonb_path_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_jsonb_path_temp,public;
+CREATE TABLE rt_data (
+  id    int,
+  v     jsonb
+);
+INSERT INTO rt_data (
+  SELECT x, jsonb_build_object(
+              'a', jsonb_build_object(
+                     'b', x,
+                     'c', jsonb_build_array(x % 3, 's' || x,
+                                            jsonb_build_object('k', x % 5))),
+              'd', CASE WHEN x % 4 = 0 THEN NULL ELSE 'str' || x END,
+              'e', x * 0.5)
+    FROM generate_series(1,4000) x);
+VACUUM ANALYZE;
+-- force to use GpuScan, instead of SeqScan
+SET enable_seqscan = off;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuScan
+CREATE OR REPLACE FUNCTION explain_gpuscan(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuScan' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- #> and #>> operators with object keys and array indexes
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, v #> ''{a,b}'' p1, v #> ''{a,c}'' p2, v #> ''{a,c,2}'' p3, v #>> ''{a,c,1}'' p4, v #>> ''{a,c,2,k}'' p5, v #>> ''{d}'' p6 FROM rt_data WHERE id > 100');
+SELECT id, v #> '{a,b}' p1,
+           v #> '{a,c}' p2,
+           v #> '{a,c,2}' p3,
+           v #>> '{a,c,1}' p4,
+           v #>> '{a,c,2,k}' p5,
+           v #>> '{d}' p6
+  INTO test01g
+  FROM rt_data
+ WHERE id > 100;
+SET pg_strom.enabled = off;
+SELECT id, v #> '{a,b}' p1,
+           v #> '{a,c}' p2,
+           v #> '{a,c,2}' p3,
+           v #>> '{a,c,1}' p4,
+           v #>> '{a,c,2,k}' p5,
+           v #>> '{d}' p6
+  INTO test01p
+  FROM rt_data
+ WHERE id > 100;
+(SELECT * FROM test01g EXCEPT ALL SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT ALL SELECT * FROM test01g) ORDER BY id;
+
+-- jsonb_extract_path() and jsonb_extract_path_text()
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, jsonb_extract_path(v, ''a'', ''c'', ''0'') p1, jsonb_extract_path_text(v, ''a'', ''b'') p2, jsonb_extract_path_text(v, ''e'') p3 FROM rt_data WHERE id % 3 = 0');
+SELECT id, jsonb_extract_path(v, 'a', 'c', '0') p1,
+           jsonb_extract_path_text(v, 'a', 'b') p2,
+           jsonb_extract_path_text(v, 'e') p3
+  INTO test02g
+  FROM rt_data
+ WHERE id % 3 = 0;
+SET pg_strom.enabled = off;
+SELECT id, jsonb_extract_path(v, 'a', 'c', '0') p1,
+           jsonb_extract_path_text(v, 'a', 'b') p2,
+           jsonb_extract_path_text(v, 'e') p3
+  INTO test02p
+  FROM rt_data
+ WHERE id % 3 = 0;
+(SELECT * FROM test02g EXCEPT ALL SELECT * FROM test02p) ORDER BY id;
+(SELECT * FROM test02p EXCEPT ALL SELECT * FROM test02g) ORDER BY id;
+
+-- missing keys, out of range indexes and negative indexes
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, v #> ''{a,x}'' p1, v #> ''{a,c,3}'' p2, v #>> ''{a,c,-1,k}'' p3, v #>> ''{a,b,c}'' p4, v #>> ''{a,c,z}'' p5 FROM rt_data WHERE id < 3000');
+SELECT id, v #> '{a,x}' p1,
+           v #> '{a,c,3}' p2,
+           v #>> '{a,c,-1,k}' p3,
+           v #>> '{a,b,c}' p4,
+           v #>> '{a,c,z}' p5
+  INTO test03g
+  FROM rt_data
+ WHERE id < 3000;
+SET pg_strom.enabled = off;
+SELECT id, v #> '{a,x}' p1,
+           v #> '{a,c,3}' p2,
+           v #>> '{a,c,-1,k}' p3,
+           v #>> '{a,b,c}' p4,
+           v #>> '{a,c,z}' p5
+  INTO test03p
+  FROM rt_data
+ WHERE id < 3000;
+(SELECT * FROM test03g EXCEPT ALL SELECT * FROM test03p) ORDER BY id;
+(SELECT * FROM test03p EXCEPT ALL SELECT * FROM test03g) ORDER BY id;
+
+-- path extraction in the qualifier
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, v FROM rt_data WHERE v #>> ''{a,c,1}'' LIKE ''s1%'' AND v #> ''{d}'' IS NOT NULL');
+SELECT id, v
+  INTO test04g
+  FROM rt_data
+ WHERE v #>> '{a,c,1}' LIKE 's1%' AND v #> '{d}' IS NOT NULL;
+SET pg_strom.enabled = off;
+SELECT id, v
+  INTO test04p
+  FROM rt_data
+ WHERE v #>> '{a,c,1}' LIKE 's1%' AND v #> '{d}' IS NOT NULL;
+(SELECT * FROM test04g EXCEPT ALL SELECT * FROM test04p) ORDER BY id;
+(SELECT * FROM test04p EXCEPT ALL SELECT * FROM test04g) ORDER BY id;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_jsonb_path_temp CASCADE;
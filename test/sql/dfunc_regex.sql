@@ -0,0 +1,121 @@
+--
+-- test for regular expression operators on GPU
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_regex_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_regex_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_regex_temp,public;
+CREATE TABLE rt_data (
+  id    int,
+  memo  text,
+  tag   text
+);
+INSERT INTO rt_data (
+  SELECT x, md5(x::text),
+            CASE WHEN x % 7 = 0 THEN NULL
+                 ELSE (ARRAY['alpha','beta','gamma','delta','a.b','a+b'])[x % 6 + 1] || '-' || (x % 100)::text
+            END
+    FROM generate_series(1,6000) x);
+VACUUM ANALYZE;
+-- force to use GpuScan, instead of SeqScan
+SET enable_seqscan = off;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuScan
+CREATE OR REPLACE FUNCTION explain_gpuscan(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuScan' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- literal characters, bracket expressions and quantifiers
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, memo, tag FROM rt_data WHERE memo ~ ''^a[0-9]+f'' OR memo ~ ''b.c.?d'' OR memo ~ ''ff*e+$''');
+SELECT id, memo, tag
+  INTO test01g
+  FROM rt_data
+ WHERE memo ~ '^a[0-9]+f' OR memo ~ 'b.c.?d' OR memo ~ 'ff*e+$';
+SET pg_strom.enabled = off;
+SELECT id, memo, tag
+  INTO test01p
+  FROM rt_data
+ WHERE memo ~ '^a[0-9]+f' OR memo ~ 'b.c.?d' OR memo ~ 'ff*e+$';
+(SELECT * FROM test01g EXCEPT ALL SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT ALL SELECT * FROM test01g) ORDER BY id;
+
+-- negative match and negated bracket expressions
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, memo, tag FROM rt_data WHERE memo !~ ''[0-4]'' OR tag ~ ''^[^a-c]+-9[0-9]$''');
+SELECT id, memo, tag
+  INTO test02g
+  FROM rt_data
+ WHERE memo !~ '[0-4]' OR tag ~ '^[^a-c]+-9[0-9]$';
+SET pg_strom.enabled = off;
+SELECT id, memo, tag
+  INTO test02p
+  FROM rt_data
+ WHERE memo !~ '[0-4]' OR tag ~ '^[^a-c]+-9[0-9]$';
+(SELECT * FROM test02g EXCEPT ALL SELECT * FROM test02p) ORDER BY id;
+(SELECT * FROM test02p EXCEPT ALL SELECT * FROM test02g) ORDER BY id;
+
+-- escaped meta characters and non-greedy quantifiers
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, memo, tag FROM rt_data WHERE tag ~ ''^a\.b-1'' OR tag ~ ''a\+b-.*?7$'' OR memo ~ ''c.+?0d''');
+SELECT id, memo, tag
+  INTO test03g
+  FROM rt_data
+ WHERE tag ~ '^a\.b-1' OR tag ~ 'a\+b-.*?7$' OR memo ~ 'c.+?0d';
+SET pg_strom.enabled = off;
+SELECT id, memo, tag
+  INTO test03p
+  FROM rt_data
+ WHERE tag ~ '^a\.b-1' OR tag ~ 'a\+b-.*?7$' OR memo ~ 'c.+?0d';
+(SELECT * FROM test03g EXCEPT ALL SELECT * FROM test03p) ORDER BY id;
+(SELECT * FROM test03p EXCEPT ALL SELECT * FROM test03g) ORDER BY id;
+
+-- SIMILAR TO is translated to the regular expression
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, memo, tag FROM rt_data WHERE tag SIMILAR TO ''gam%-_'' OR memo SIMILAR TO ''%a_bc%''');
+SELECT id, memo, tag
+  INTO test04g
+  FROM rt_data
+ WHERE tag SIMILAR TO 'gam%-_' OR memo SIMILAR TO '%a_bc%';
+SET pg_strom.enabled = off;
+SELECT id, memo, tag
+  INTO test04p
+  FROM rt_data
+ WHERE tag SIMILAR TO 'gam%-_' OR memo SIMILAR TO '%a_bc%';
+(SELECT * FROM test04g EXCEPT ALL SELECT * FROM test04p) ORDER BY id;
+(SELECT * FROM test04p EXCEPT ALL SELECT * FROM test04g) ORDER BY id;
+
+-- unsupported patterns are evaluated on CPU
+SET pg_strom.enabled = on;
+SELECT id, memo, tag
+  INTO test05g
+  FROM rt_data
+ WHERE memo ~ '(ab|cd){2}' OR tag ~* '^BETA';
+SET pg_strom.enabled = off;
+SELECT id, memo, tag
+  INTO test05p
+  FROM rt_data
+ WHERE memo ~ '(ab|cd){2}' OR tag ~* '^BETA';
+(SELECT * FROM test05g EXCEPT ALL SELECT * FROM test05p) ORDER BY id;
+(SELECT * FROM test05p EXCEPT ALL SELECT * FROM test05g) ORDER BY id;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_regex_temp CASCADE;
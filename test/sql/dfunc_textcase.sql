@@ -0,0 +1,127 @@
+--
+-- test for lower(), upper() and regexp_replace() on GpuScan
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_textcase_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_textcase_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_textcase_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  t    text COLLATE "C"
+);
+INSERT INTO rt_data (
+  SELECT x, CASE WHEN x % 13 = 0 THEN NULL
+                 WHEN x % 7 = 0 THEN 'Straße-' || x || '-ÄbÇ'
+                 WHEN x % 2 = 0 THEN 'AbC-' || md5(x::text)
+                 ELSE md5(x::text) || '-Mixed-' || x
+            END
+    FROM generate_series(1,10000) x);
+VACUUM ANALYZE;
+-- force to use GpuScan, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuScan
+CREATE OR REPLACE FUNCTION explain_gpuscan(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuScan' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- lower() and upper() convert ASCII characters only
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, lower(t) lt, upper(t) ut FROM rt_data WHERE lower(t) LIKE ''%abc%'' OR upper(t) LIKE ''%MIXED-1%''');
+SELECT id, lower(t) lt, upper(t) ut
+  INTO test01g
+  FROM rt_data
+ WHERE lower(t) LIKE '%abc%' OR upper(t) LIKE '%MIXED-1%';
+SET pg_strom.enabled = off;
+SELECT id, lower(t) lt, upper(t) ut
+  INTO test01p
+  FROM rt_data
+ WHERE lower(t) LIKE '%abc%' OR upper(t) LIKE '%MIXED-1%';
+(SELECT * FROM test01g EXCEPT ALL SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT ALL SELECT * FROM test01g) ORDER BY id;
+
+-- regexp_replace() on the first match
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, regexp_replace(t, ''[0-9]+'', ''#'') r1, regexp_replace(t, ''^[a-z]+'', '''') r2 FROM rt_data WHERE regexp_replace(t, ''[0-9]+'', ''#'') LIKE ''%#%''');
+SELECT id, regexp_replace(t, '[0-9]+', '#') r1,
+           regexp_replace(t, '^[a-z]+', '') r2
+  INTO test02g
+  FROM rt_data
+ WHERE regexp_replace(t, '[0-9]+', '#') LIKE '%#%';
+SET pg_strom.enabled = off;
+SELECT id, regexp_replace(t, '[0-9]+', '#') r1,
+           regexp_replace(t, '^[a-z]+', '') r2
+  INTO test02p
+  FROM rt_data
+ WHERE regexp_replace(t, '[0-9]+', '#') LIKE '%#%';
+(SELECT * FROM test02g EXCEPT ALL SELECT * FROM test02p) ORDER BY id;
+(SELECT * FROM test02p EXCEPT ALL SELECT * FROM test02g) ORDER BY id;
+
+-- regexp_replace() with 'g' flag
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, regexp_replace(t, ''[aeiou]'', ''*'', ''g'') r1, regexp_replace(t, ''[a-f0-9]+'', '''', ''g'') r2 FROM rt_data WHERE regexp_replace(lower(t), ''c+'', ''CC'', ''g'') LIKE ''%CC%''');
+SELECT id, regexp_replace(t, '[aeiou]', '*', 'g') r1,
+           regexp_replace(t, '[a-f0-9]+', '', 'g') r2
+  INTO test03g
+  FROM rt_data
+ WHERE regexp_replace(lower(t), 'c+', 'CC', 'g') LIKE '%CC%';
+SET pg_strom.enabled = off;
+SELECT id, regexp_replace(t, '[aeiou]', '*', 'g') r1,
+           regexp_replace(t, '[a-f0-9]+', '', 'g') r2
+  INTO test03p
+  FROM rt_data
+ WHERE regexp_replace(lower(t), 'c+', 'CC', 'g') LIKE '%CC%';
+(SELECT * FROM test03g EXCEPT ALL SELECT * FROM test03p) ORDER BY id;
+(SELECT * FROM test03p EXCEPT ALL SELECT * FROM test03g) ORDER BY id;
+
+-- back-reference in the replacement is not supported
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, regexp_replace(t, ''(ab)c'', ''\1x'') r FROM rt_data WHERE regexp_replace(t, ''(ab)c'', ''\1x'') != t');
+SELECT id, regexp_replace(t, '(ab)c', '\1x') r
+  INTO test04g
+  FROM rt_data
+ WHERE regexp_replace(t, '(ab)c', '\1x') != t;
+SET pg_strom.enabled = off;
+SELECT id, regexp_replace(t, '(ab)c', '\1x') r
+  INTO test04p
+  FROM rt_data
+ WHERE regexp_replace(t, '(ab)c', '\1x') != t;
+(SELECT * FROM test04g EXCEPT ALL SELECT * FROM test04p) ORDER BY id;
+(SELECT * FROM test04p EXCEPT ALL SELECT * FROM test04g) ORDER BY id;
+
+-- non-greedy quantifier is not supported
+SET pg_strom.enabled = on;
+SELECT explain_gpuscan('SELECT id, regexp_replace(t, ''a.*?e'', ''_'') r FROM rt_data WHERE regexp_replace(t, ''a.*?e'', ''_'') != t');
+SELECT id, regexp_replace(t, 'a.*?e', '_') r
+  INTO test05g
+  FROM rt_data
+ WHERE regexp_replace(t, 'a.*?e', '_') != t;
+SET pg_strom.enabled = off;
+SELECT id, regexp_replace(t, 'a.*?e', '_') r
+  INTO test05p
+  FROM rt_data
+ WHERE regexp_replace(t, 'a.*?e', '_') != t;
+(SELECT * FROM test05g EXCEPT ALL SELECT * FROM test05p) ORDER BY id;
+(SELECT * FROM test05p EXCEPT ALL SELECT * FROM test05g) ORDER BY id;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_textcase_temp CASCADE;
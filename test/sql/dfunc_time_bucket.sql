@@ -0,0 +1,195 @@
+--
+-- test for date_trunc() and time_bucket() on GpuPreAgg
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_time_bucket_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_time_bucket_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_time_bucket_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  ts   timestamp,
+  tz   timestamptz
+);
+INSERT INTO rt_data (
+  SELECT x, CASE WHEN x % 101 = 0 THEN NULL
+                 ELSE '2019-01-01 00:00:00'::timestamp
+                      + (x * 2237.125) * '1 second'::interval
+            END,
+            CASE WHEN x % 103 = 0 THEN NULL
+                 ELSE '2019-01-01 00:00:00 UTC'::timestamptz
+                      + (x * 2237.125) * '1 second'::interval
+            END
+    FROM generate_series(1,40000) x);
+VACUUM ANALYZE;
+-- force to use GpuPreAgg, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.gpu_setup_cost = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+-- shows whether the query runs on GpuPreAgg
+CREATE OR REPLACE FUNCTION explain_gpupreagg(query text)
+RETURNS bool AS
+$$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (costs off) ' || query
+  LOOP
+    IF ln ~ 'GpuPreAgg' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE 'plpgsql';
+
+-- date_trunc(text,timestamp) by fixed-width units
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT date_trunc(''day'', ts) d, min(date_trunc(''hour'', ts)) min_h, max(date_trunc(''minute'', ts)) max_m, max(date_trunc(''second'', ts)) max_s, min(date_trunc(''milliseconds'', ts)) min_ms, count(*) nrows FROM rt_data GROUP BY 1');
+SELECT date_trunc('day', ts) d,
+       min(date_trunc('hour', ts)) min_h,
+       max(date_trunc('minute', ts)) max_m,
+       max(date_trunc('second', ts)) max_s,
+       min(date_trunc('milliseconds', ts)) min_ms,
+       count(*) nrows
+  INTO test01g
+  FROM rt_data
+ GROUP BY 1;
+SET pg_strom.enabled = off;
+SELECT date_trunc('day', ts) d,
+       min(date_trunc('hour', ts)) min_h,
+       max(date_trunc('minute', ts)) max_m,
+       max(date_trunc('second', ts)) max_s,
+       min(date_trunc('milliseconds', ts)) min_ms,
+       count(*) nrows
+  INTO test01p
+  FROM rt_data
+ GROUP BY 1;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY d;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY d;
+
+-- date_trunc(text,timestamp) by calendar units
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT date_trunc(''month'', ts) m, date_trunc(''quarter'', ts) q, date_trunc(''year'', ts) y, date_trunc(''decade'', ts) dc, min(date_trunc(''week'', ts)) min_w, count(*) nrows FROM rt_data GROUP BY 1,2,3,4');
+SELECT date_trunc('month', ts) m,
+       date_trunc('quarter', ts) q,
+       date_trunc('year', ts) y,
+       date_trunc('decade', ts) dc,
+       min(date_trunc('week', ts)) min_w,
+       count(*) nrows
+  INTO test02g
+  FROM rt_data
+ GROUP BY 1,2,3,4;
+SET pg_strom.enabled = off;
+SELECT date_trunc('month', ts) m,
+       date_trunc('quarter', ts) q,
+       date_trunc('year', ts) y,
+       date_trunc('decade', ts) dc,
+       min(date_trunc('week', ts)) min_w,
+       count(*) nrows
+  INTO test02p
+  FROM rt_data
+ GROUP BY 1,2,3,4;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY m;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY m;
+
+SET TimeZone = 'America/New_York';
+
+-- date_trunc(text,timestamptz) across DST transitions
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT date_trunc(''day'', tz) d, min(date_trunc(''hour'', tz)) min_h, max(date_trunc(''minute'', tz)) max_m, count(*) nrows FROM rt_data GROUP BY 1');
+SELECT date_trunc('day', tz) d,
+       min(date_trunc('hour', tz)) min_h,
+       max(date_trunc('minute', tz)) max_m,
+       count(*) nrows
+  INTO test03g
+  FROM rt_data
+ GROUP BY 1;
+SET pg_strom.enabled = off;
+SELECT date_trunc('day', tz) d,
+       min(date_trunc('hour', tz)) min_h,
+       max(date_trunc('minute', tz)) max_m,
+       count(*) nrows
+  INTO test03p
+  FROM rt_data
+ GROUP BY 1;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY d;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY d;
+
+-- date_trunc(text,timestamptz) by calendar units
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT date_trunc(''month'', tz) m, date_trunc(''year'', tz) y, min(date_trunc(''week'', tz)) min_w, count(*) nrows FROM rt_data GROUP BY 1,2');
+SELECT date_trunc('month', tz) m,
+       date_trunc('year', tz) y,
+       min(date_trunc('week', tz)) min_w,
+       count(*) nrows
+  INTO test04g
+  FROM rt_data
+ GROUP BY 1,2;
+SET pg_strom.enabled = off;
+SELECT date_trunc('month', tz) m,
+       date_trunc('year', tz) y,
+       min(date_trunc('week', tz)) min_w,
+       count(*) nrows
+  INTO test04p
+  FROM rt_data
+ GROUP BY 1,2;
+(SELECT * FROM test04g EXCEPT SELECT * FROM test04p) ORDER BY m;
+(SELECT * FROM test04p EXCEPT SELECT * FROM test04g) ORDER BY m;
+
+SET TimeZone = 'Asia/Kolkata';
+
+-- date_trunc(text,timestamptz) on non-hourly offset
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT date_trunc(''day'', tz) d, min(date_trunc(''hour'', tz)) min_h, max(date_trunc(''hour'', tz)) max_h, count(*) nrows FROM rt_data GROUP BY 1');
+SELECT date_trunc('day', tz) d,
+       min(date_trunc('hour', tz)) min_h,
+       max(date_trunc('hour', tz)) max_h,
+       count(*) nrows
+  INTO test05g
+  FROM rt_data
+ GROUP BY 1;
+SET pg_strom.enabled = off;
+SELECT date_trunc('day', tz) d,
+       min(date_trunc('hour', tz)) min_h,
+       max(date_trunc('hour', tz)) max_h,
+       count(*) nrows
+  INTO test05p
+  FROM rt_data
+ GROUP BY 1;
+(SELECT * FROM test05g EXCEPT SELECT * FROM test05p) ORDER BY d;
+(SELECT * FROM test05p EXCEPT SELECT * FROM test05g) ORDER BY d;
+
+-- pgstrom.time_bucket() by fixed-width buckets
+SET pg_strom.enabled = on;
+SELECT explain_gpupreagg('SELECT pgstrom.time_bucket(''3 days'', ts) b1, min(pgstrom.time_bucket(''6 hours'', ts)) min_b2, max(pgstrom.time_bucket(''90 minutes'', tz)) max_b3, min(pgstrom.time_bucket(''1 day 30 seconds'', tz)) min_b4, count(*) nrows FROM rt_data GROUP BY 1');
+SELECT pgstrom.time_bucket('3 days', ts) b1,
+       min(pgstrom.time_bucket('6 hours', ts)) min_b2,
+       max(pgstrom.time_bucket('90 minutes', tz)) max_b3,
+       min(pgstrom.time_bucket('1 day 30 seconds', tz)) min_b4,
+       count(*) nrows
+  INTO test06g
+  FROM rt_data
+ GROUP BY 1;
+SET pg_strom.enabled = off;
+SELECT pgstrom.time_bucket('3 days', ts) b1,
+       min(pgstrom.time_bucket('6 hours', ts)) min_b2,
+       max(pgstrom.time_bucket('90 minutes', tz)) max_b3,
+       min(pgstrom.time_bucket('1 day 30 seconds', tz)) min_b4,
+       count(*) nrows
+  INTO test06p
+  FROM rt_data
+ GROUP BY 1;
+(SELECT * FROM test06g EXCEPT SELECT * FROM test06p) ORDER BY b1;
+(SELECT * FROM test06p EXCEPT SELECT * FROM test06g) ORDER BY b1;
+
+RESET TimeZone;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_time_bucket_temp CASCADE;
@@ -0,0 +1,160 @@
+--
+-- test for vector distance functions and k-NN join
+--
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_dfunc_vector_temp CASCADE;
+CREATE SCHEMA regtest_dfunc_vector_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_dfunc_vector_temp,public;
+CREATE TABLE rt_data (
+  id   int,
+  v    float4[]	-- 8 dimensions, integer values between -50 and 50
+);
+INSERT INTO rt_data (
+  SELECT x, ARRAY(SELECT ((x * (j + 3) * 7919) % 101 - 50)::float4
+                    FROM generate_series(0,7) j)
+    FROM generate_series(1,2000) x);
+VACUUM ANALYZE;
+
+-- force to use GpuScan, instead of SeqScan
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+-- not to print kernel source code
+SET pg_strom.debug_kernel_source = off;
+
+SELECT '{1,2,3}'::float2[] <-> '{4,6,3}'::float2[] AS l2,
+       pgstrom.vector_inner_product('{1,2,3}'::float2[], '{4,6,3}'::float2[]) AS ip,
+       '{1,2,3}'::float2[] <#> '{4,6,3}'::float2[] AS nip,
+       '{1,2,3}'::float2[] <=> '{4,6,3}'::float2[] AS cos;
+SELECT '{1,2,3}'::float4[] <-> '{4,6,3}'::float4[] AS l2,
+       pgstrom.vector_inner_product('{1,2,3}'::float4[], '{4,6,3}'::float4[]) AS ip,
+       '{1,2,3}'::float4[] <#> '{4,6,3}'::float4[] AS nip,
+       '{1,2,3}'::float4[] <=> '{4,6,3}'::float4[] AS cos;
+SELECT '{1,2,3}'::float8[] <-> '{4,6,3}'::float8[] AS l2,
+       pgstrom.vector_inner_product('{1,2,3}'::float8[], '{4,6,3}'::float8[]) AS ip,
+       '{1,2,3}'::float8[] <#> '{4,6,3}'::float8[] AS nip,
+       '{1,2,3}'::float8[] <=> '{4,6,3}'::float8[] AS cos;
+SELECT '{0,0}'::float8[] <=> '{1,2}'::float8[] AS cos;
+SELECT '{1,2,3}'::float8[] <-> '{1,2}'::float8[];
+SELECT '{1,null,3}'::float8[] <-> '{1,2,3}'::float8[];
+
+-- distance on the device
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, v
+  INTO test01g
+  FROM rt_data
+ WHERE v <-> '{0,0,0,0,0,0,0,0}' < 80::float8;
+SELECT id, v
+  INTO test01g
+  FROM rt_data
+ WHERE v <-> '{0,0,0,0,0,0,0,0}' < 80::float8;
+SET pg_strom.enabled = off;
+SELECT id, v
+  INTO test01p
+  FROM rt_data
+ WHERE v <-> '{0,0,0,0,0,0,0,0}' < 80::float8;
+SELECT count(*) FROM test01g;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY id;
+
+-- k-NN join; distances of each rank shall be identical to the CPU ones,
+-- but inner_id may differ if multiple inner rows have the same distance.
+SET pg_strom.enabled = on;
+SELECT *
+  INTO test02g
+  FROM pgstrom.vector_knn_join('SELECT id, v FROM rt_data WHERE id <= 50',
+                               'SELECT id, v FROM rt_data', 10, 'l2');
+SELECT outer_id, inner_id, rank, distance
+  INTO test02p
+  FROM (SELECT o.id::bigint AS outer_id, i.id::bigint AS inner_id,
+               row_number() OVER (PARTITION BY o.id
+                                  ORDER BY o.v <-> i.v, i.id)::int AS rank,
+               o.v <-> i.v AS distance
+          FROM rt_data o, rt_data i
+         WHERE o.id <= 50) qry
+ WHERE rank <= 10;
+SELECT count(*), count(distinct outer_id) FROM test02g;
+SELECT g.*, p.distance
+  FROM test02g g JOIN test02p p USING (outer_id, rank)
+ WHERE abs(g.distance - p.distance) > 1.0e-4;
+SELECT g.*
+  FROM test02g g, rt_data o, rt_data i
+ WHERE g.outer_id = o.id AND g.inner_id = i.id
+   AND abs(g.distance - (o.v <-> i.v)) > 1.0e-4;
+SELECT *
+  INTO test03g
+  FROM pgstrom.vector_knn_join('SELECT id, v FROM rt_data WHERE id <= 50',
+                               'SELECT id, v FROM rt_data', 10, 'negative_inner_product');
+SELECT outer_id, inner_id, rank, distance
+  INTO test03p
+  FROM (SELECT o.id::bigint AS outer_id, i.id::bigint AS inner_id,
+               row_number() OVER (PARTITION BY o.id
+                                  ORDER BY o.v <#> i.v, i.id)::int AS rank,
+               o.v <#> i.v AS distance
+          FROM rt_data o, rt_data i
+         WHERE o.id <= 50) qry
+ WHERE rank <= 10;
+SELECT count(*), count(distinct outer_id) FROM test03g;
+SELECT g.*, p.distance
+  FROM test03g g JOIN test03p p USING (outer_id, rank)
+ WHERE abs(g.distance - p.distance) > 1.0e-4;
+SELECT g.*
+  FROM test03g g, rt_data o, rt_data i
+ WHERE g.outer_id = o.id AND g.inner_id = i.id
+   AND abs(g.distance - (o.v <#> i.v)) > 1.0e-4;
+SELECT *
+  INTO test04g
+  FROM pgstrom.vector_knn_join('SELECT id, v FROM rt_data WHERE id <= 50',
+                               'SELECT id, v FROM rt_data', 10, 'cosine');
+SELECT outer_id, inner_id, rank, distance
+  INTO test04p
+  FROM (SELECT o.id::bigint AS outer_id, i.id::bigint AS inner_id,
+               row_number() OVER (PARTITION BY o.id
+                                  ORDER BY o.v <=> i.v, i.id)::int AS rank,
+               o.v <=> i.v AS distance
+          FROM rt_data o, rt_data i
+         WHERE o.id <= 50) qry
+ WHERE rank <= 10;
+SELECT count(*), count(distinct outer_id) FROM test04g;
+SELECT g.*, p.distance
+  FROM test04g g JOIN test04p p USING (outer_id, rank)
+ WHERE abs(g.distance - p.distance) > 1.0e-4;
+SELECT g.*
+  FROM test04g g, rt_data o, rt_data i
+ WHERE g.outer_id = o.id AND g.inner_id = i.id
+   AND abs(g.distance - (o.v <=> i.v)) > 1.0e-4;
+SELECT *
+  INTO test05g
+  FROM pgstrom.vector_knn_join('SELECT id, v::float2[] FROM rt_data WHERE id <= 50',
+                               'SELECT id, v::float2[] FROM rt_data', 10, 'l2');
+SELECT outer_id, inner_id, rank, distance
+  INTO test05p
+  FROM (SELECT o.id::bigint AS outer_id, i.id::bigint AS inner_id,
+               row_number() OVER (PARTITION BY o.id
+                                  ORDER BY o.v::float2[] <-> i.v::float2[], i.id)::int AS rank,
+               o.v::float2[] <-> i.v::float2[] AS distance
+          FROM rt_data o, rt_data i
+         WHERE o.id <= 50) qry
+ WHERE rank <= 10;
+SELECT count(*), count(distinct outer_id) FROM test05g;
+SELECT g.*, p.distance
+  FROM test05g g JOIN test05p p USING (outer_id, rank)
+ WHERE abs(g.distance - p.distance) > 1.0e-4;
+SELECT g.*
+  FROM test05g g, rt_data o, rt_data i
+ WHERE g.outer_id = o.id AND g.inner_id = i.id
+   AND abs(g.distance - (o.v::float2[] <-> i.v::float2[])) > 1.0e-4;
+
+-- error cases
+SELECT * FROM pgstrom.vector_knn_join('SELECT id, v FROM rt_data',
+                                      'SELECT id, v FROM rt_data', 0);
+SELECT * FROM pgstrom.vector_knn_join('SELECT id, v FROM rt_data',
+                                      'SELECT id, v FROM rt_data', 10, 'hamming');
+SELECT * FROM pgstrom.vector_knn_join('SELECT id, v::float8[] FROM rt_data',
+                                      'SELECT id, v FROM rt_data', 10);
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_dfunc_vector_temp CASCADE;
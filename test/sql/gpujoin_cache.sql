@@ -0,0 +1,104 @@
+---
+--- Test for the shared cache of GpuJoin inner buffer
+---
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_gpujoin_cache_temp CASCADE;
+CREATE SCHEMA regtest_gpujoin_cache_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_gpujoin_cache_temp,public;
+CREATE TABLE regtest_data (
+  id    int,
+  aid   int,
+  a     float8
+);
+CREATE TABLE regtest_inner (
+  aid   int,
+  z     float8
+);
+INSERT INTO regtest_data (
+  SELECT x, x % 1200, (x % 89)::float8
+    FROM generate_series(1,20000) x
+);
+INSERT INTO regtest_inner (
+  SELECT x, (x % 13)::float8
+    FROM generate_series(1,1000) x
+);
+-- inner buffer is cacheable only if all the pages are all-visible
+VACUUM ANALYZE regtest_data;
+VACUUM ANALYZE regtest_inner;
+
+-- enables the inner buffer cache
+ALTER SYSTEM SET pg_strom.gpujoin_inner_cache_size = '64MB';
+SELECT pg_reload_conf();
+SELECT pg_sleep(0.5);
+SHOW pg_strom.gpujoin_inner_cache_size;
+
+-- force to use GpuJoin and disables to print source files
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.debug_kernel_source = off;
+SET pg_strom.gpu_setup_cost = 0;
+
+-- the first run builds the inner buffer, then the second one reuses it
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, a, z
+  INTO test01g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SELECT id, a, z
+  INTO test01g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SELECT id, a, z
+  INTO test02g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SET pg_strom.enabled = off;
+SELECT id, a, z
+  INTO test01p
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY id;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test02g) ORDER BY id;
+
+-- modification of the inner relation invalidates the cached buffer
+UPDATE regtest_inner SET z = z + 100.0 WHERE aid % 7 = 0;
+SET pg_strom.enabled = on;
+SELECT id, a, z
+  INTO test03g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SET pg_strom.enabled = off;
+SELECT id, a, z
+  INTO test03p
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY id;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY id;
+
+-- VACUUM makes the inner relation cacheable again
+VACUUM regtest_inner;
+SET pg_strom.enabled = on;
+SELECT id, a, z
+  INTO test04g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SELECT id, a, z
+  INTO test05g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+(SELECT * FROM test04g EXCEPT SELECT * FROM test03p) ORDER BY id;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test04g) ORDER BY id;
+(SELECT * FROM test05g EXCEPT SELECT * FROM test03p) ORDER BY id;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test05g) ORDER BY id;
+
+-- cleanup
+ALTER SYSTEM RESET pg_strom.gpujoin_inner_cache_size;
+SELECT pg_reload_conf();
+SET client_min_messages = error;
+DROP SCHEMA regtest_gpujoin_cache_temp CASCADE;
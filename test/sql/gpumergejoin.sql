@@ -0,0 +1,117 @@
+---
+--- Test for GpuMergeJoin
+---
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_gpumergejoin_temp CASCADE;
+CREATE SCHEMA regtest_gpumergejoin_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_gpumergejoin_temp,public;
+CREATE TABLE regtest_data (
+  id    int,
+  aid   int,
+  a     float8
+);
+CREATE TABLE regtest_inner (
+  aid   int primary key,
+  z     float8
+);
+CREATE TABLE regtest_inner2 (
+  aid   int,
+  z     float8
+);
+CREATE INDEX regtest_inner2_aid_idx ON regtest_inner2 (aid);
+INSERT INTO regtest_data (
+  SELECT x, x % 1200, (x % 89)::float8
+    FROM generate_series(1,20000) x
+);
+INSERT INTO regtest_inner (
+  SELECT x, (x % 13)::float8
+    FROM generate_series(1,1000) x
+);
+INSERT INTO regtest_inner2 (
+  SELECT x % 500, x::float8
+    FROM generate_series(1,2000) x
+);
+VACUUM ANALYZE regtest_data;
+VACUUM ANALYZE regtest_inner;
+VACUUM ANALYZE regtest_inner2;
+
+-- inner rows are read by index scan, so already sorted by the join keys
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.debug_kernel_source = off;
+SET pg_strom.gpu_setup_cost = 0;
+
+-- INNER JOIN on the unique keys
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, d.aid, a, z
+  INTO test01g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SELECT id, d.aid, a, z
+  INTO test01g
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SET pg_strom.enabled = off;
+SELECT id, d.aid, a, z
+  INTO test01p
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+SELECT count(*) FROM test01g;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY id, aid, a, z;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY id, aid, a, z;
+
+-- LEFT JOIN; outer rows without matched inner rows
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, d.aid, a, z
+  INTO test02g
+  FROM regtest_data d LEFT JOIN regtest_inner i ON d.aid = i.aid
+ WHERE d.id > 0;
+SELECT id, d.aid, a, z
+  INTO test02g
+  FROM regtest_data d LEFT JOIN regtest_inner i ON d.aid = i.aid
+ WHERE d.id > 0;
+SET pg_strom.enabled = off;
+SELECT id, d.aid, a, z
+  INTO test02p
+  FROM regtest_data d LEFT JOIN regtest_inner i ON d.aid = i.aid
+ WHERE d.id > 0;
+SELECT count(*) FROM test02g;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY id, aid, a, z;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY id, aid, a, z;
+
+-- INNER JOIN on the duplicated keys
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, d.aid, a, z
+  INTO test03g
+  FROM regtest_data d, regtest_inner2 i
+ WHERE d.aid = i.aid AND d.id > 0;
+SELECT id, d.aid, a, z
+  INTO test03g
+  FROM regtest_data d, regtest_inner2 i
+ WHERE d.aid = i.aid AND d.id > 0;
+SET pg_strom.enabled = off;
+SELECT id, d.aid, a, z
+  INTO test03p
+  FROM regtest_data d, regtest_inner2 i
+ WHERE d.aid = i.aid AND d.id > 0;
+SELECT count(*) FROM test03g;
+(SELECT * FROM test03g EXCEPT SELECT * FROM test03p) ORDER BY id, aid, a, z;
+(SELECT * FROM test03p EXCEPT SELECT * FROM test03g) ORDER BY id, aid, a, z;
+
+-- disabled
+SET pg_strom.enabled = on;
+SET pg_strom.enable_gpumergejoin = off;
+EXPLAIN (costs off)
+SELECT id, d.aid, a, z
+  FROM regtest_data d, regtest_inner i
+ WHERE d.aid = i.aid AND d.id > 0;
+RESET pg_strom.enable_gpumergejoin;
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_gpumergejoin_temp CASCADE;
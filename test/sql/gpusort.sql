@@ -0,0 +1,122 @@
+---
+--- Test for GpuSort and bounded (Top-K) GpuSort
+---
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_gpusort_temp CASCADE;
+CREATE SCHEMA regtest_gpusort_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_gpusort_temp,public;
+CREATE TABLE regtest_data (
+  id    int,
+  a     int,
+  b     float8
+);
+INSERT INTO regtest_data (
+  SELECT x, (x * 7919) % 1000, (x % 97)::float8
+    FROM generate_series(1,20000) x
+);
+ANALYZE regtest_data;
+
+-- force to use GpuScan and disables to print source files
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.debug_kernel_source = off;
+-- GpuSort is preferable only when device setup is negligible
+SET pg_strom.gpu_setup_cost = 0;
+SET pg_strom.gpu_operator_cost = 0.00001;
+
+-- test for full sorting
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, a, b
+  INTO test01g
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id;
+SELECT id, a, b
+  INTO test01g
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id;
+SET pg_strom.enabled = off;
+SELECT id, a, b
+  INTO test01p
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY id;
+
+-- tail of the sorted rows shall be in order
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id OFFSET 18992;
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id OFFSET 18992;
+
+-- test for bounded sorting (Top-K)
+EXPLAIN (costs off)
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id LIMIT 8 OFFSET 4;
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id LIMIT 8 OFFSET 4;
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id LIMIT 8 OFFSET 1000;
+
+-- sorted runs written out to the temporary files
+SET pg_strom.gpusort_max_memory = '4MB';
+EXPLAIN (costs off)
+SELECT id, a, b
+  INTO test02g
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id;
+SELECT id, a, b
+  INTO test02g
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test02g) ORDER BY id;
+SELECT count(*)
+  FROM (SELECT a, id, lag(a) OVER () pa, lag(id) OVER () pid
+          FROM (SELECT a, id
+                  FROM regtest_data
+                 WHERE id > 1000
+                 ORDER BY a, id) s) t
+ WHERE (pa, pid) > (a, id);
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id OFFSET 18992;
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id LIMIT 8 OFFSET 1000;
+RESET pg_strom.gpusort_max_memory;
+
+-- GpuSort shall not be used if disabled
+SET pg_strom.enable_gpusort = off;
+EXPLAIN (costs off)
+SELECT id, a, b
+  FROM regtest_data
+ WHERE id > 1000
+ ORDER BY a, id;
+RESET pg_strom.enable_gpusort;
+
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_gpusort_temp CASCADE;
@@ -0,0 +1,124 @@
+---
+--- Test for GpuWindowAgg
+---
+SET pg_strom.regression_test_mode = on;
+SET client_min_messages = error;
+DROP SCHEMA IF EXISTS regtest_gpuwinagg_temp CASCADE;
+CREATE SCHEMA regtest_gpuwinagg_temp;
+RESET client_min_messages;
+
+SET search_path = regtest_gpuwinagg_temp,public;
+CREATE TABLE regtest_data (
+  id    int,
+  a     int,
+  b     float8
+);
+INSERT INTO regtest_data (
+  SELECT x, (x * 7919) % 1000, (x % 97)::float8
+    FROM generate_series(1,20000) x
+);
+ANALYZE regtest_data;
+
+-- force to use GpuScan and disables to print source files
+SET enable_seqscan = off;
+SET max_parallel_workers_per_gather = 0;
+SET pg_strom.debug_kernel_source = off;
+-- GpuWindowAgg is preferable only when device setup is negligible
+SET pg_strom.gpu_setup_cost = 0;
+SET pg_strom.gpu_operator_cost = 0.00001;
+
+-- rank, dense_rank, count and sum on the peer groups
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, a, b,
+       rank() OVER w AS rk,
+       dense_rank() OVER w AS drk,
+       count(*) OVER w AS cnt,
+       sum(b) OVER w AS sum_b
+  INTO test01g
+  FROM regtest_data
+ WHERE id > 1000
+WINDOW w AS (PARTITION BY a ORDER BY b);
+SELECT id, a, b,
+       rank() OVER w AS rk,
+       dense_rank() OVER w AS drk,
+       count(*) OVER w AS cnt,
+       sum(b) OVER w AS sum_b
+  INTO test01g
+  FROM regtest_data
+ WHERE id > 1000
+WINDOW w AS (PARTITION BY a ORDER BY b);
+SET pg_strom.enabled = off;
+SELECT id, a, b,
+       rank() OVER w AS rk,
+       dense_rank() OVER w AS drk,
+       count(*) OVER w AS cnt,
+       sum(b) OVER w AS sum_b
+  INTO test01p
+  FROM regtest_data
+ WHERE id > 1000
+WINDOW w AS (PARTITION BY a ORDER BY b);
+SELECT count(*) FROM test01g;
+(SELECT * FROM test01g EXCEPT SELECT * FROM test01p) ORDER BY id;
+(SELECT * FROM test01p EXCEPT SELECT * FROM test01g) ORDER BY id;
+
+-- row_number, lag/lead, count and sum on the sliding frame
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, a, b,
+       row_number() OVER w AS rn,
+       lag(b) OVER w AS lag_b,
+       lead(b, 2, -1.0::float8) OVER w AS lead_b,
+       count(*) OVER w AS cnt,
+       sum(a) OVER w AS sum_a,
+       sum(b) OVER w AS sum_b
+  INTO test02g
+  FROM regtest_data
+ WHERE id > 1000
+WINDOW w AS (PARTITION BY a ORDER BY id
+             ROWS BETWEEN 2 PRECEDING AND 2 FOLLOWING);
+SELECT id, a, b,
+       row_number() OVER w AS rn,
+       lag(b) OVER w AS lag_b,
+       lead(b, 2, -1.0::float8) OVER w AS lead_b,
+       count(*) OVER w AS cnt,
+       sum(a) OVER w AS sum_a,
+       sum(b) OVER w AS sum_b
+  INTO test02g
+  FROM regtest_data
+ WHERE id > 1000
+WINDOW w AS (PARTITION BY a ORDER BY id
+             ROWS BETWEEN 2 PRECEDING AND 2 FOLLOWING);
+SET pg_strom.enabled = off;
+SELECT id, a, b,
+       row_number() OVER w AS rn,
+       lag(b) OVER w AS lag_b,
+       lead(b, 2, -1.0::float8) OVER w AS lead_b,
+       count(*) OVER w AS cnt,
+       sum(a) OVER w AS sum_a,
+       sum(b) OVER w AS sum_b
+  INTO test02p
+  FROM regtest_data
+ WHERE id > 1000
+WINDOW w AS (PARTITION BY a ORDER BY id
+             ROWS BETWEEN 2 PRECEDING AND 2 FOLLOWING);
+SELECT count(*) FROM test02g;
+(SELECT * FROM test02g EXCEPT SELECT * FROM test02p) ORDER BY id;
+(SELECT * FROM test02p EXCEPT SELECT * FROM test02g) ORDER BY id;
+
+-- unsupported window function keeps WindowAgg, but Sort runs on GPU
+SET pg_strom.enabled = on;
+EXPLAIN (costs off)
+SELECT id, a, b, avg(b) OVER (PARTITION BY a ORDER BY id)
+  FROM regtest_data
+ WHERE id > 1000;
+-- disabled
+SET pg_strom.enable_gpuwindowagg = off;
+EXPLAIN (costs off)
+SELECT id, a, b, row_number() OVER (PARTITION BY a ORDER BY id)
+  FROM regtest_data
+ WHERE id > 1000;
+RESET pg_strom.enable_gpuwindowagg;
+-- cleanup
+SET client_min_messages = error;
+DROP SCHEMA regtest_gpuwinagg_temp CASCADE;
@@ -6,6 +6,7 @@ SHOW pg_strom.enable_gpuscan;
 SHOW pg_strom.enable_gpuhashjoin;
 SHOW pg_strom.enable_gpunestloop;
 SHOW pg_strom.enable_gpupreagg;
+SHOW pg_strom.enable_gpusort;
 SHOW pg_strom.enable_numeric_aggfuncs;
 SHOW pg_strom.cpu_fallback;
 SHOW pg_strom.gpu_setup_cost;
@@ -0,0 +1,250 @@
+#!/bin/bash
+#
+# ssbm-bench.sh - throughput benchmark harness of the Star Schema Benchmark
+#
+# It loads the SSBM data at the scale factors into the heap tables, and
+# (optionally) into Arrow_Fdw and Gstore_Fdw foreign tables, then runs the
+# 13 queries at 1..N concurrent clients using pgbench. The report contains
+# QPS and latency percentiles for each storage, scale factor, query and
+# concurrency, and the EXPLAIN ANALYZE output (incl. "GPU Timing" of the
+# GpuTasks) is kept for each query.
+#
+CWD=`dirname $0`
+DBNAME="ssbm"
+SCALES="1"
+STORAGES="heap"
+CLIENTS="1,2,4,8"
+DURATION=60
+QUERIES="11,12,13,21,22,23,31,32,33,34,41,42,43"
+ARROW_DIR=""
+OUTDIR=~/ssbm-logs/bench_`date +%Y%m%d_%H%M%S`
+SKIP_LOAD=0
+PGBENCH_OPTS=""
+
+usage()
+{
+  cat <<EOF >&2
+usage: `basename $0` [options]
+  -d DBNAME      : database name (default: $DBNAME)
+  -s SCALES      : comma separated scale factors (default: $SCALES)
+  -t STORAGES    : comma separated storages of lineorder;
+                   heap, arrow or gstore (default: $STORAGES)
+  -c CLIENTS     : comma separated number of concurrent clients
+                   (default: $CLIENTS)
+  -T SECONDS     : duration of each run (default: $DURATION)
+  -q QUERIES     : comma separated query numbers (default: all the 13 queries)
+  -a DIR         : directory to write out Apache Arrow files
+                   (mandatory for the 'arrow' storage)
+  -o DIR         : directory of the logs and report
+                   (default: ~/ssbm-logs/bench_<timestamp>)
+  -n             : skip data loading; use the existing tables
+  -P OPTS        : extra options of pgbench
+  -h             : shows this message
+EOF
+  exit 1
+}
+
+while getopts "d:s:t:c:T:q:a:o:nP:h" opt
+do
+  case $opt in
+    d) DBNAME="$OPTARG" ;;
+    s) SCALES="$OPTARG" ;;
+    t) STORAGES="$OPTARG" ;;
+    c) CLIENTS="$OPTARG" ;;
+    T) DURATION="$OPTARG" ;;
+    q) QUERIES="$OPTARG" ;;
+    a) ARROW_DIR="$OPTARG" ;;
+    o) OUTDIR="$OPTARG" ;;
+    n) SKIP_LOAD=1 ;;
+    P) PGBENCH_OPTS="$OPTARG" ;;
+    *) usage ;;
+  esac
+done
+
+for s in `echo $STORAGES | tr ',' ' '`
+do
+  case $s in
+    heap|gstore) ;;
+    arrow)
+      test -n "$ARROW_DIR" || { echo "-a DIR is mandatory for arrow" >&2; exit 1; }
+      mkdir -p "$ARROW_DIR" || exit 1
+      ;;
+    *)
+      echo "unknown storage: $s" >&2
+      exit 1
+      ;;
+  esac
+done
+
+mkdir -p ${OUTDIR}/queries ${OUTDIR}/explain ${OUTDIR}/pgbench || exit 1
+PSQL="psql -X -q -v ON_ERROR_STOP=1 ${DBNAME}"
+
+#
+# extract the 13 queries from ssbm-all-strom.sql
+#
+awk -v dir=${OUTDIR}/queries '
+/^--Q[0-9]_[0-9]/ {
+  qnum = substr($1, 4, 1) substr($1, 6, 1);
+  fname = dir "/ssbm-" qnum ".sql";
+  explain = 0; done = 0;
+  next;
+}
+qnum == "" || done { next; }
+/^explain/ { explain = 1; next; }
+explain { if ($0 ~ /;[ \t]*$/) explain = 0; next; }
+/^[ \t]*$/ { next; }
+{
+  print $0 > fname;
+  if ($0 ~ /;[ \t]*$/) { done = 1; close(fname); }
+}' ${CWD}/ssbm-all-strom.sql
+
+#
+# load_ssbm SCALE
+#
+load_ssbm()
+{
+  SF=$1
+  HEAP="ssbm_sf${SF}"
+
+  echo "loading the SSBM data (SF=${SF}) into ${HEAP}"
+  ${PSQL} <<EOF || exit 1
+DROP SCHEMA IF EXISTS ${HEAP} CASCADE;
+CREATE SCHEMA ${HEAP};
+SET search_path = ${HEAP};
+\i ${CWD}/ssbm-ddl.sql
+\copy customer  FROM PROGRAM 'dbgen-ssbm -q -s${SF} -X -Tc' DELIMITER '|';
+\copy date1     FROM PROGRAM 'dbgen-ssbm -q -s${SF} -X -Td' DELIMITER '|';
+\copy lineorder FROM PROGRAM 'dbgen-ssbm -q -s${SF} -X -Tl' DELIMITER '|';
+\copy part      FROM PROGRAM 'dbgen-ssbm -q -s${SF} -X -Tp' DELIMITER '|';
+\copy supplier  FROM PROGRAM 'dbgen-ssbm -q -s${SF} -X -Ts' DELIMITER '|';
+VACUUM ANALYZE;
+EOF
+
+  for s in `echo $STORAGES | tr ',' ' '`
+  do
+    test "$s" = "heap" && continue
+    SCHEMA="${HEAP}_${s}"
+
+    # dimension tables are shared with the heap schema
+    ${PSQL} <<EOF || exit 1
+DROP SCHEMA IF EXISTS ${SCHEMA} CASCADE;
+CREATE SCHEMA ${SCHEMA};
+CREATE VIEW ${SCHEMA}.customer AS SELECT * FROM ${HEAP}.customer;
+CREATE VIEW ${SCHEMA}.date1    AS SELECT * FROM ${HEAP}.date1;
+CREATE VIEW ${SCHEMA}.part     AS SELECT * FROM ${HEAP}.part;
+CREATE VIEW ${SCHEMA}.supplier AS SELECT * FROM ${HEAP}.supplier;
+EOF
+    case $s in
+      arrow)
+        ARROW_FILE="${ARROW_DIR}/lineorder_sf${SF}.arrow"
+        rm -f ${ARROW_FILE}
+        pg2arrow -d ${DBNAME} -t ${HEAP}.lineorder \
+                 -o ${ARROW_FILE} --stat=lo_orderdate || exit 1
+        ${PSQL} <<EOF || exit 1
+IMPORT FOREIGN SCHEMA lineorder
+  FROM SERVER arrow_fdw INTO ${SCHEMA}
+  OPTIONS (file '${ARROW_FILE}');
+ANALYZE ${SCHEMA}.lineorder;
+EOF
+        ;;
+      gstore)
+        ${PSQL} <<EOF || exit 1
+SELECT format('CREATE FOREIGN TABLE ${SCHEMA}.lineorder (%s)
+                 SERVER gstore_fdw
+                 OPTIONS (max_num_rows ''%s'')',
+              string_agg(quote_ident(attname) || ' ' ||
+                         format_type(atttypid, atttypmod), ', '
+                         ORDER BY attnum),
+              (SELECT (count(*) * 1.2)::bigint FROM ${HEAP}.lineorder))
+  FROM pg_attribute
+ WHERE attrelid = '${HEAP}.lineorder'::regclass
+   AND attnum > 0 AND NOT attisdropped
+\gexec
+INSERT INTO ${SCHEMA}.lineorder SELECT * FROM ${HEAP}.lineorder;
+EOF
+        ;;
+    esac
+  done
+}
+
+#
+# run_ssbm SCALE STORAGE
+#
+run_ssbm()
+{
+  SF=$1
+  STORAGE=$2
+  SCHEMA="ssbm_sf${SF}"
+  test "$STORAGE" = "heap" || SCHEMA="${SCHEMA}_${STORAGE}"
+  export PGOPTIONS="-c search_path=${SCHEMA},public"
+
+  for q in `echo $QUERIES | tr ',' ' '`
+  do
+    QFILE="${OUTDIR}/queries/ssbm-${q}.sql"
+    test -f ${QFILE} || { echo "unknown query: ${q}" >&2; exit 1; }
+    LABEL="sf${SF}_${STORAGE}_q${q}"
+
+    # EXPLAIN ANALYZE for the stage timings; also warms up the caches
+    (echo "EXPLAIN (ANALYZE, VERBOSE)"; cat ${QFILE}) | \
+      psql -X ${DBNAME} > ${OUTDIR}/explain/${LABEL}.txt 2>&1
+
+    for c in `echo $CLIENTS | tr ',' ' '`
+    do
+      echo "running Q${q} on ${STORAGE} (SF=${SF}) by ${c} clients"
+      rm -f ${OUTDIR}/pgbench/${LABEL}_c${c}.*
+      (cd ${OUTDIR}/pgbench &&
+       pgbench -n -c ${c} -j ${c} -T ${DURATION} ${PGBENCH_OPTS} \
+               -f ${QFILE} -l --log-prefix=${LABEL}_c${c} ${DBNAME} \
+               > ${LABEL}_c${c}.out 2>&1) || \
+        echo "pgbench failed; see ${OUTDIR}/pgbench/${LABEL}_c${c}.out" >&2
+      # pgbench log: client_id xact_no latency(us) script_no epoch epoch_us
+      cat ${OUTDIR}/pgbench/${LABEL}_c${c}.[0-9]* 2>/dev/null | \
+        awk '{print $3}' | sort -n | \
+        awk -v sf=${SF} -v st=${STORAGE} -v q=${q} -v c=${c} -v T=${DURATION} '
+        { v[NR] = $1; sum += $1; }
+        function pct(p,  i) { i = int(NR * p + 0.999); if (i < 1) i = 1; return v[i] / 1000.0; }
+        END {
+          if (NR == 0) { printf("%s,%s,Q%s,%d,0,0,,,,,\n", sf, st, q, c); exit; }
+          printf("%s,%s,Q%s,%d,%d,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                 sf, st, q, c, NR, NR / T, sum / NR / 1000.0,
+                 pct(0.50), pct(0.90), pct(0.99), v[NR] / 1000.0);
+        }' >> ${OUTDIR}/report.csv
+    done
+  done
+}
+
+#
+# main
+#
+if [ $SKIP_LOAD -eq 0 ]; then
+  for sf in `echo $SCALES | tr ',' ' '`
+  do
+    load_ssbm $sf
+  done
+fi
+
+echo "scale,storage,query,clients,count,qps,avg_ms,p50_ms,p90_ms,p99_ms,max_ms" \
+  > ${OUTDIR}/report.csv
+for sf in `echo $SCALES | tr ',' ' '`
+do
+  for s in `echo $STORAGES | tr ',' ' '`
+  do
+    run_ssbm $sf $s
+  done
+done
+
+#
+# GPU Timing lines of EXPLAIN ANALYZE
+#
+for f in ${OUTDIR}/explain/*.txt
+do
+  grep -H "GPU Timing:" $f | sed -e "s|^${OUTDIR}/explain/||" -e 's|\.txt:[ ]*|: |'
+done > ${OUTDIR}/gpu_timing.txt
+
+(echo "## SSBM throughput (DB=${DBNAME}, duration=${DURATION}s)"
+ echo
+ column -s, -t < ${OUTDIR}/report.csv
+ echo
+ echo "## GPU Timing of EXPLAIN ANALYZE"
+ echo
+ cat ${OUTDIR}/gpu_timing.txt) | tee ${OUTDIR}/report.txt
@@ -0,0 +1,1399 @@
+/*
+ * gpubench.c
+ *
+ * Micro-benchmark of the device functions and the data-store formats.
+ *
+ * It builds the GPU kernels in src/cuda_gpubench.h by NVRTC, and links
+ * them with the pre-built device libraries (cuda_*.fatbin) as PG-Strom
+ * doing at run-time. Then, it launches the device function families over
+ * the synthetic chunks of KDS_FORMAT_ROW/BLOCK/ARROW/COLUMN, and reports
+ * the throughput (rows/s and GB/s) per kernel and GPU model.
+ *
+ * With -C option, it also measures the PCIe bandwidth, kernel launch
+ * latency, per-operator throughput and SSD-to-GPU Direct bandwidth, then
+ * suggests pg_strom.gpu_(setup|dma|operator)_cost for this hardware.
+ *
+ * With -T option, it measures the DMA bandwidth of all the GPUs, P2P
+ * bandwidth between GPUs, and SSD-to-GPU Direct bandwidth from the volumes
+ * of the supplied files to each GPU, then suggests pg_strom.nvme_distance_map
+ * according to the measured performance.
+ * ----
+ * Copyright 2011-2020 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2020 (C) The PG-Strom Development Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <assert.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cuda.h>
+#include <nvrtc.h>
+#include "nvme_strom.h"
+
+/*
+ * command line options
+ */
+static int			machine_format = 0;
+static int			device_id = 0;
+static unsigned int	num_rows = (1U << 22);
+static int			num_loops = 10;
+static const char  *include_path = PGSHAREDIR "/pg_strom";
+static const char  *library_path = PGSHAREDIR "/pg_strom";
+static const char  *family_list = NULL;
+static const char  *format_list = NULL;
+static int			calibration = 0;
+static int			topology = 0;
+static const char  *direct_file = NULL;
+static double		seq_page_bandwidth = -1.0;	/* MB/s */
+static size_t		chunk_size = (65534UL << 10);	/* pg_strom.chunk_size */
+static size_t		direct_read_limit = 0;			/* 0 means whole file */
+
+#define lengthof(array)			(sizeof (array) / sizeof ((array)[0]))
+
+/* see cuda_common.h */
+#define KDS_FORMAT_ROW			1
+#define KDS_FORMAT_BLOCK		4
+#define KDS_FORMAT_COLUMN		5
+#define KDS_FORMAT_ARROW		6
+#define KERN_ERRORBUF_SIZE		512
+
+static struct {
+	const char *name;
+	const char *libname;
+} family_catalog[] = {
+	{ "fetch",		NULL },
+	{ "primitive",	"cuda_primitive" },
+	{ "numeric",	"cuda_numeric" },
+	{ "textlib",	"cuda_textlib" },
+};
+
+static struct {
+	const char *name;
+	int			format;
+} format_catalog[] = {
+	{ "row",	KDS_FORMAT_ROW },
+	{ "block",	KDS_FORMAT_BLOCK },
+	{ "arrow",	KDS_FORMAT_ARROW },
+	{ "column",	KDS_FORMAT_COLUMN },
+};
+
+static const char *
+cuErrorName(CUresult error_code)
+{
+	const char *error_name;
+
+	if (cuGetErrorName(error_code, &error_name) != CUDA_SUCCESS)
+		error_name = "unknown error";
+	return error_name;
+}
+
+#define elog(fmt,...)								\
+	do {											\
+		fprintf(stderr, "gpubench:%d  " fmt "\n",	\
+				__LINE__, ##__VA_ARGS__);			\
+		exit(1);									\
+	} while(0)
+
+/*
+ * is_listed - checks whether the token is in the comma separated list
+ */
+static int
+is_listed(const char *list, const char *name)
+{
+	const char *pos = list;
+	size_t		len = strlen(name);
+
+	if (!list)
+		return 1;
+	while (*pos != '\0')
+	{
+		const char *end = strchr(pos, ',');
+		size_t		sz = (end ? end - pos : strlen(pos));
+
+		if (sz == len && strncmp(pos, name, len) == 0)
+			return 1;
+		if (!end)
+			break;
+		pos = end + 1;
+	}
+	return 0;
+}
+
+/*
+ * build_gpubench_module
+ *
+ * It compiles the benchmark kernels with the same options as PG-Strom
+ * uses for the run-time compilation, then links them with the device
+ * libraries.
+ */
+static CUmodule
+build_gpubench_module(CUdevice cuda_device)
+{
+	static const char *source =
+		"#include <cuda_device_runtime_api.h>\n"
+		"#define KERN_CONTEXT_VARLENA_BUFSZ 256\n"
+		"#define KERN_CONTEXT_STACK_LIMIT 1024\n"
+		"#include \"cuda_common.h\"\n"
+		"#include \"cuda_primitive.h\"\n"
+		"#include \"cuda_gpubench.h\"\n";
+	nvrtcProgram program;
+	nvrtcResult	rv;
+	const char *options[10];
+	int			opt_index = 0;
+	char		include_option[1024];
+	char		gpu_arch_option[80];
+	int			major, minor;
+	char	   *ptx_image;
+	size_t		ptx_length;
+	CUlinkState	lstate;
+	CUjit_option jit_options[4];
+	void	   *jit_option_values[4];
+	char		log_buffer[16384];
+	char		pathname[1024];
+	void	   *bin_image;
+	size_t		bin_length;
+	CUmodule	cuda_module;
+	CUresult	rc;
+	int			i;
+
+	rc = cuDeviceGetAttribute(&major,
+							  CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR,
+							  cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetAttribute: %s", cuErrorName(rc));
+	rc = cuDeviceGetAttribute(&minor,
+							  CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR,
+							  cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetAttribute: %s", cuErrorName(rc));
+
+	rv = nvrtcCreateProgram(&program, source, "gpubench", 0, NULL, NULL);
+	if (rv != NVRTC_SUCCESS)
+		elog("failed on nvrtcCreateProgram: %s", nvrtcGetErrorString(rv));
+
+	snprintf(include_option, sizeof(include_option), "-I %s", include_path);
+	snprintf(gpu_arch_option, sizeof(gpu_arch_option),
+			 "--gpu-architecture=compute_%d", major * 10 + minor);
+	options[opt_index++] = "-D__" CPU_ARCH "__=1";
+	options[opt_index++] = "-I " CUDA_INCLUDE_PATH;
+	options[opt_index++] = include_option;
+	options[opt_index++] = "-I " PGSERV_INCLUDEDIR;
+	options[opt_index++] = gpu_arch_option;
+	options[opt_index++] = "--use_fast_math";
+	options[opt_index++] = "--device-c";
+	options[opt_index++] = "--std=c++11";
+
+	rv = nvrtcCompileProgram(program, opt_index, options);
+	if (rv != NVRTC_SUCCESS)
+	{
+		size_t	log_length;
+		char   *build_log;
+
+		if (nvrtcGetProgramLogSize(program, &log_length) == NVRTC_SUCCESS &&
+			(build_log = malloc(log_length + 1)) != NULL &&
+			nvrtcGetProgramLog(program, build_log) == NVRTC_SUCCESS)
+			fprintf(stderr, "%s\n", build_log);
+		elog("failed on nvrtcCompileProgram: %s", nvrtcGetErrorString(rv));
+	}
+	rv = nvrtcGetPTXSize(program, &ptx_length);
+	if (rv != NVRTC_SUCCESS)
+		elog("failed on nvrtcGetPTXSize: %s", nvrtcGetErrorString(rv));
+	ptx_image = malloc(ptx_length + 1);
+	if (!ptx_image)
+		elog("out of memory");
+	rv = nvrtcGetPTX(program, ptx_image);
+	if (rv != NVRTC_SUCCESS)
+		elog("failed on nvrtcGetPTX: %s", nvrtcGetErrorString(rv));
+	nvrtcDestroyProgram(&program);
+
+	/* link with the pre-built device libraries */
+	jit_options[0] = CU_JIT_MAX_REGISTERS;
+	jit_option_values[0] = (void *)CUDA_MAXREGCOUNT;
+	jit_options[1] = CU_JIT_TARGET_FROM_CUCONTEXT;
+	jit_option_values[1] = NULL;
+	jit_options[2] = CU_JIT_ERROR_LOG_BUFFER;
+	jit_option_values[2] = (void *)log_buffer;
+	jit_options[3] = CU_JIT_ERROR_LOG_BUFFER_SIZE_BYTES;
+	jit_option_values[3] = (void *)sizeof(log_buffer);
+
+	rc = cuLinkCreate(4, jit_options, jit_option_values, &lstate);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLinkCreate: %s", cuErrorName(rc));
+	rc = cuLinkAddData(lstate, CU_JIT_INPUT_PTX,
+					   ptx_image, ptx_length,
+					   "gpubench", 0, NULL, NULL);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLinkAddData: %s", cuErrorName(rc));
+	for (i = -1; i < (int)lengthof(family_catalog); i++)
+	{
+		const char *libname = (i < 0 ? "cuda_common"
+							   : family_catalog[i].libname);
+		if (!libname)
+			continue;
+		snprintf(pathname, sizeof(pathname), "%s/%s.fatbin",
+				 library_path, libname);
+		rc = cuLinkAddFile(lstate, CU_JIT_INPUT_FATBINARY,
+						   pathname, 0, NULL, NULL);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuLinkAddFile(\"%s\"): %s",
+				 pathname, cuErrorName(rc));
+	}
+	rc = cuLinkComplete(lstate, &bin_image, &bin_length);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLinkComplete: %s\nLog: %s",
+			 cuErrorName(rc), log_buffer);
+	rc = cuModuleLoadData(&cuda_module, bin_image);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuModuleLoadData: %s", cuErrorName(rc));
+	rc = cuLinkDestroy(lstate);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLinkDestroy: %s", cuErrorName(rc));
+	free(ptx_image);
+
+	return cuda_module;
+}
+
+/*
+ * launch_kernel - launches the kernel with the optimal grid size
+ */
+static void
+launch_kernel(CUfunction kern_func, void **kern_args, int single_thread)
+{
+	int			grid_sz = 1;
+	int			block_sz = 1;
+	CUresult	rc;
+
+	if (!single_thread)
+	{
+		rc = cuOccupancyMaxPotentialBlockSize(&grid_sz,
+											  &block_sz,
+											  kern_func,
+											  NULL, 0, 0);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuOccupancyMaxPotentialBlockSize: %s",
+				 cuErrorName(rc));
+	}
+	rc = cuLaunchKernel(kern_func,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0, NULL, kern_args, NULL);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLaunchKernel: %s", cuErrorName(rc));
+}
+
+/*
+ * setup_gpubench_chunk - builds a synthetic chunk on the device memory
+ */
+static CUdeviceptr
+setup_gpubench_chunk(CUmodule cuda_module, int format,
+					 CUdeviceptr *p_extra,
+					 size_t *p_length)
+{
+	CUfunction	kern_setup_header;
+	CUfunction	kern_setup_body;
+	CUdeviceptr	m_length;
+	CUdeviceptr	m_kds = 0UL;
+	CUdeviceptr	m_extra = 0UL;
+	unsigned long long length[2];
+	char		fmt = format;
+	void	   *kern_args[4];
+	CUresult	rc;
+
+	rc = cuModuleGetFunction(&kern_setup_header, cuda_module,
+							 "kern_gpubench_setup_header");
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuModuleGetFunction: %s", cuErrorName(rc));
+	rc = cuModuleGetFunction(&kern_setup_body, cuda_module,
+							 "kern_gpubench_setup_body");
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuModuleGetFunction: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_length, sizeof(length));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+
+	/* estimate the length of KDS */
+	kern_args[0] = &m_kds;
+	kern_args[1] = &m_length;
+	kern_args[2] = &fmt;
+	kern_args[3] = &num_rows;
+	launch_kernel(kern_setup_header, kern_args, 1);
+	rc = cuMemcpyDtoH(length, m_length, sizeof(length));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemcpyDtoH: %s", cuErrorName(rc));
+	if (length[0] == 0)
+		elog("unknown data-store format: %d", format);
+
+	rc = cuMemAlloc(&m_kds, length[0]);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuMemsetD8(m_kds, 0, length[0]);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemsetD8: %s", cuErrorName(rc));
+	if (length[1] > 0)
+	{
+		rc = cuMemAlloc(&m_extra, length[1]);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+		rc = cuMemsetD8(m_extra, 0, length[1]);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemsetD8: %s", cuErrorName(rc));
+	}
+
+	/* setup the header, then the body */
+	launch_kernel(kern_setup_header, kern_args, 1);
+	kern_args[0] = &m_kds;
+	kern_args[1] = &m_extra;
+	kern_args[2] = &num_rows;
+	launch_kernel(kern_setup_body, kern_args, 0);
+	rc = cuCtxSynchronize();
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuCtxSynchronize: %s", cuErrorName(rc));
+	cuMemFree(m_length);
+
+	*p_extra = m_extra;
+	*p_length = length[0] + length[1];
+	return m_kds;
+}
+
+/*
+ * run_gpubench
+ */
+static double
+run_gpubench(CUmodule cuda_module, const char *family, const char *format,
+			 CUdeviceptr m_kds, CUdeviceptr m_extra, size_t length,
+			 CUdeviceptr m_kparams, CUdeviceptr m_result,
+			 CUdeviceptr m_kerror)
+{
+	CUfunction	kern_func;
+	CUevent		ev_start;
+	CUevent		ev_stop;
+	char		kern_name[200];
+	void	   *kern_args[6];
+	unsigned long long result;
+	int			errcode;
+	float		elapsed;
+	double		rows_per_sec;
+	double		gbytes_per_sec;
+	CUresult	rc;
+	int			i;
+
+	snprintf(kern_name, sizeof(kern_name),
+			 "kern_gpubench_%s_%s", family, format);
+	rc = cuModuleGetFunction(&kern_func, cuda_module, kern_name);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuModuleGetFunction('%s'): %s",
+			 kern_name, cuErrorName(rc));
+	rc = cuEventCreate(&ev_start, CU_EVENT_DEFAULT);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventCreate: %s", cuErrorName(rc));
+	rc = cuEventCreate(&ev_stop, CU_EVENT_DEFAULT);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventCreate: %s", cuErrorName(rc));
+	rc = cuMemsetD8(m_kerror, 0, KERN_ERRORBUF_SIZE);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemsetD8: %s", cuErrorName(rc));
+
+	kern_args[0] = &m_kparams;
+	kern_args[1] = &m_kds;
+	kern_args[2] = &m_extra;
+	kern_args[3] = &num_rows;
+	kern_args[4] = &m_result;
+	kern_args[5] = &m_kerror;
+
+	/* warm-up */
+	launch_kernel(kern_func, kern_args, 0);
+	rc = cuMemsetD8(m_result, 0, sizeof(result));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemsetD8: %s", cuErrorName(rc));
+
+	rc = cuEventRecord(ev_start, NULL);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventRecord: %s", cuErrorName(rc));
+	for (i=0; i < num_loops; i++)
+		launch_kernel(kern_func, kern_args, 0);
+	rc = cuEventRecord(ev_stop, NULL);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventRecord: %s", cuErrorName(rc));
+	rc = cuEventSynchronize(ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventSynchronize: %s", cuErrorName(rc));
+	rc = cuEventElapsedTime(&elapsed, ev_start, ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventElapsedTime: %s", cuErrorName(rc));
+
+	rc = cuMemcpyDtoH(&result, m_result, sizeof(result));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemcpyDtoH: %s", cuErrorName(rc));
+	rc = cuMemcpyDtoH(&errcode, m_kerror, sizeof(errcode));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemcpyDtoH: %s", cuErrorName(rc));
+	cuEventDestroy(ev_start);
+	cuEventDestroy(ev_stop);
+	if (calibration && errcode != 0)
+		elog("%s raised an error (code=%d)", kern_name, errcode);
+
+	elapsed /= (float)num_loops;	/* ms per chunk */
+	rows_per_sec = (double)num_rows / ((double)elapsed / 1000.0);
+	gbytes_per_sec = ((double)length / ((double)elapsed / 1000.0)) / 1.0e9;
+	if (calibration)
+		return elapsed;
+	if (!machine_format)
+		printf("%-10s %-7s %10.3fms %14.0f rows/s %8.2f GB/s%s\n",
+			   family, format, elapsed, rows_per_sec, gbytes_per_sec,
+			   errcode != 0 ? "  (error)" : "");
+	else
+	{
+		printf("BENCH:%s:%s:ELAPSED_MS=%.3f\n", family, format, elapsed);
+		printf("BENCH:%s:%s:ROWS_PER_SEC=%.0f\n",
+			   family, format, rows_per_sec);
+		printf("BENCH:%s:%s:GBYTES_PER_SEC=%.3f\n",
+			   family, format, gbytes_per_sec);
+		printf("BENCH:%s:%s:CHECKSUM=%llu\n", family, format,
+			   result / (unsigned long long)num_loops);
+		printf("BENCH:%s:%s:ERRCODE=%d\n", family, format, errcode);
+	}
+	return elapsed;
+}
+
+static double
+timeval_diff_ms(struct timeval *tv1, struct timeval *tv2)
+{
+	return ((double)(tv2->tv_sec - tv1->tv_sec) * 1000.0 +
+			(double)(tv2->tv_usec - tv1->tv_usec) / 1000.0);
+}
+
+/*
+ * measure_dma_bandwidth - MB/s of DMA between the pinned host memory and
+ * the device memory, in the unit of chunk_size.
+ */
+static double
+measure_dma_bandwidth(int host_to_device)
+{
+	void	   *h_buf;
+	CUdeviceptr	m_buf;
+	CUevent		ev_start;
+	CUevent		ev_stop;
+	float		elapsed;
+	CUresult	rc;
+	int			i;
+
+	rc = cuMemAllocHost(&h_buf, chunk_size);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAllocHost: %s", cuErrorName(rc));
+	memset(h_buf, 0, chunk_size);
+	rc = cuMemAlloc(&m_buf, chunk_size);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuEventCreate(&ev_start, CU_EVENT_DEFAULT);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventCreate: %s", cuErrorName(rc));
+	rc = cuEventCreate(&ev_stop, CU_EVENT_DEFAULT);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventCreate: %s", cuErrorName(rc));
+
+	for (i = -1; i < num_loops; i++)
+	{
+		if (i == 0)
+		{
+			rc = cuEventRecord(ev_start, NULL);
+			if (rc != CUDA_SUCCESS)
+				elog("failed on cuEventRecord: %s", cuErrorName(rc));
+		}
+		if (host_to_device)
+			rc = cuMemcpyHtoDAsync(m_buf, h_buf, chunk_size, NULL);
+		else
+			rc = cuMemcpyDtoHAsync(h_buf, m_buf, chunk_size, NULL);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemcpy%sAsync: %s",
+				 host_to_device ? "HtoD" : "DtoH", cuErrorName(rc));
+	}
+	rc = cuEventRecord(ev_stop, NULL);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventRecord: %s", cuErrorName(rc));
+	rc = cuEventSynchronize(ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventSynchronize: %s", cuErrorName(rc));
+	rc = cuEventElapsedTime(&elapsed, ev_start, ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventElapsedTime: %s", cuErrorName(rc));
+
+	cuEventDestroy(ev_start);
+	cuEventDestroy(ev_stop);
+	cuMemFree(m_buf);
+	cuMemFreeHost(h_buf);
+
+	return ((double)chunk_size * (double)num_loops /
+			((double)elapsed / 1000.0)) / 1.0e6;
+}
+
+/*
+ * measure_launch_latency - usec to launch a tiny kernel and wait for it
+ */
+static double
+measure_launch_latency(CUmodule cuda_module)
+{
+	CUfunction	kern_func;
+	CUdeviceptr	m_kds = 0UL;
+	CUdeviceptr	m_length;
+	char		fmt = KDS_FORMAT_ROW;
+	void	   *kern_args[4];
+	struct timeval tv1, tv2;
+	int			nloops = 1000;
+	CUresult	rc;
+	int			i;
+
+	rc = cuModuleGetFunction(&kern_func, cuda_module,
+							 "kern_gpubench_setup_header");
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuModuleGetFunction: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_length, 2 * sizeof(unsigned long long));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	kern_args[0] = &m_kds;
+	kern_args[1] = &m_length;
+	kern_args[2] = &fmt;
+	kern_args[3] = &num_rows;
+
+	for (i = -1; i < nloops; i++)
+	{
+		if (i == 0)
+			gettimeofday(&tv1, NULL);
+		launch_kernel(kern_func, kern_args, 1);
+		rc = cuCtxSynchronize();
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuCtxSynchronize: %s", cuErrorName(rc));
+	}
+	gettimeofday(&tv2, NULL);
+	cuMemFree(m_length);
+
+	return timeval_diff_ms(&tv1, &tv2) * 1000.0 / (double)nloops;
+}
+
+/*
+ * measure_storage_bandwidth - MB/s of sequential read(2) of the file
+ */
+static double
+measure_storage_bandwidth(const char *filename)
+{
+	int			fdesc;
+	char	   *buffer;
+	size_t		unitsz = (1UL << 20);
+	size_t		total = 0;
+	ssize_t		nbytes;
+	struct timeval tv1, tv2;
+
+	fdesc = open(filename, O_RDONLY);
+	if (fdesc < 0)
+		elog("failed on open('%s'): %m", filename);
+	/* drop the page cache; we need the storage performance */
+	posix_fadvise(fdesc, 0, 0, POSIX_FADV_DONTNEED);
+	buffer = malloc(unitsz);
+	if (!buffer)
+		elog("out of memory");
+	gettimeofday(&tv1, NULL);
+	while ((nbytes = read(fdesc, buffer, unitsz)) != 0)
+	{
+		if (nbytes < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			elog("failed on read('%s'): %m", filename);
+		}
+		total += nbytes;
+	}
+	gettimeofday(&tv2, NULL);
+	free(buffer);
+	close(fdesc);
+
+	if (total == 0)
+		elog("file '%s' is empty", filename);
+	return ((double)total / (timeval_diff_ms(&tv1, &tv2) / 1000.0)) / 1.0e6;
+}
+
+/*
+ * measure_direct_bandwidth - MB/s of SSD-to-GPU Direct read of the file
+ * by nvme_strom, or negative value if not available.
+ */
+static double
+measure_direct_bandwidth(const char *filename)
+{
+	StromCmd__MapGpuMemory cmd_map;
+	StromCmd__UnmapGpuMemory cmd_unmap;
+	int			ioctl_fd;
+	int			fdesc;
+	CUdeviceptr	m_buf;
+	off_t		file_sz;
+	unsigned int page_sz = sysconf(_SC_PAGESIZE);
+	unsigned int fchunk_id = 0;
+	unsigned int nr_pages;
+	size_t		total = 0;
+	struct timeval tv1, tv2;
+	CUresult	rc;
+
+	ioctl_fd = open(NVME_STROM_IOCTL_PATHNAME, O_RDONLY);
+	if (ioctl_fd < 0)
+		return -1.0;
+	fdesc = open(filename, O_RDONLY);
+	if (fdesc < 0)
+		elog("failed on open('%s'): %m", filename);
+	file_sz = lseek(fdesc, 0, SEEK_END);
+	nr_pages = file_sz / page_sz;
+	if (direct_read_limit > 0 && nr_pages > direct_read_limit / page_sz)
+		nr_pages = direct_read_limit / page_sz;
+	if (nr_pages == 0)
+		elog("file '%s' is too small", filename);
+	posix_fadvise(fdesc, 0, 0, POSIX_FADV_DONTNEED);
+
+	rc = cuMemAlloc(&m_buf, chunk_size);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	memset(&cmd_map, 0, sizeof(StromCmd__MapGpuMemory));
+	cmd_map.vaddress = m_buf;
+	cmd_map.length = chunk_size;
+	if (ioctl(ioctl_fd, STROM_IOCTL__MAP_GPU_MEMORY, &cmd_map) != 0)
+	{
+		fprintf(stderr, "gpubench: failed on STROM_IOCTL__MAP_GPU_MEMORY: %m\n");
+		cuMemFree(m_buf);
+		close(fdesc);
+		close(ioctl_fd);
+		return -1.0;
+	}
+
+	gettimeofday(&tv1, NULL);
+	while (fchunk_id < nr_pages)
+	{
+		StromCmd__MemCopySsdToGpuRaw cmd;
+		StromCmd__MemCopyWait cmd_wait;
+		strom_io_chunk ioc;
+
+		ioc.m_offset = 0;
+		ioc.fchunk_id = fchunk_id;
+		ioc.nr_pages = chunk_size / page_sz;
+		if (ioc.nr_pages > nr_pages - fchunk_id)
+			ioc.nr_pages = nr_pages - fchunk_id;
+
+		memset(&cmd, 0, sizeof(StromCmd__MemCopySsdToGpuRaw));
+		cmd.handle    = cmd_map.handle;
+		cmd.offset    = 0;
+		cmd.file_desc = fdesc;
+		cmd.nr_chunks = 1;
+		cmd.page_sz   = page_sz;
+		cmd.io_chunks = &ioc;
+		if (ioctl(ioctl_fd, STROM_IOCTL__MEMCPY_SSD2GPU_RAW, &cmd) != 0)
+			elog("failed on STROM_IOCTL__MEMCPY_SSD2GPU_RAW: %m");
+		memset(&cmd_wait, 0, sizeof(StromCmd__MemCopyWait));
+		cmd_wait.dma_task_id = cmd.dma_task_id;
+		while (ioctl(ioctl_fd, STROM_IOCTL__MEMCPY_WAIT, &cmd_wait) != 0)
+		{
+			if (errno != EINTR)
+				elog("failed on STROM_IOCTL__MEMCPY_WAIT: %m");
+		}
+		fchunk_id += ioc.nr_pages;
+		total += (size_t)ioc.nr_pages * page_sz;
+	}
+	gettimeofday(&tv2, NULL);
+
+	memset(&cmd_unmap, 0, sizeof(StromCmd__UnmapGpuMemory));
+	cmd_unmap.handle = cmd_map.handle;
+	if (ioctl(ioctl_fd, STROM_IOCTL__UNMAP_GPU_MEMORY, &cmd_unmap) != 0)
+		fprintf(stderr, "gpubench: failed on STROM_IOCTL__UNMAP_GPU_MEMORY: %m\n");
+	cuMemFree(m_buf);
+	close(fdesc);
+	close(ioctl_fd);
+
+	return ((double)total / (timeval_diff_ms(&tv1, &tv2) / 1000.0)) / 1.0e6;
+}
+
+/*
+ * run_calibration
+ *
+ * It measures the hardware, then suggests the cost parameters of PG-Strom.
+ * The planner's cost unit is seq_page_cost (= 1.0), a sequential read of
+ * 8kB page; so, the time of each GPU operation is divided by the time to
+ * read a page at the storage bandwidth.
+ */
+static void
+run_calibration(CUmodule cuda_module, double setup_ms)
+{
+	CUdeviceptr	m_kds;
+	CUdeviceptr	m_extra;
+	CUdeviceptr	m_kparams;
+	CUdeviceptr	m_result;
+	CUdeviceptr	m_kerror;
+	size_t		length;
+	double		h2d_bw, d2h_bw;
+	double		direct_bw = -1.0;
+	double		launch_us;
+	double		fetch_ms, primitive_ms;
+	double		operator_ns;
+	double		page_us;
+	double		dma_ms;
+	double		setup_cost, dma_cost, operator_cost;
+	CUresult	rc;
+
+	h2d_bw = measure_dma_bandwidth(1);
+	d2h_bw = measure_dma_bandwidth(0);
+	launch_us = measure_launch_latency(cuda_module);
+	if (direct_file)
+	{
+		if (seq_page_bandwidth < 0.0)
+			seq_page_bandwidth = measure_storage_bandwidth(direct_file);
+		direct_bw = measure_direct_bandwidth(direct_file);
+	}
+	else if (seq_page_bandwidth < 0.0)
+		seq_page_bandwidth = 1000.0;	/* 1GB/s */
+
+	/*
+	 * per-operator cost; the primitive family runs three operators per row
+	 * on top of the fetch family.
+	 */
+	rc = cuMemAlloc(&m_kparams, 4096);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuMemsetD8(m_kparams, 0, 4096);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemsetD8: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_result, sizeof(unsigned long long));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_kerror, KERN_ERRORBUF_SIZE);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	m_kds = setup_gpubench_chunk(cuda_module, KDS_FORMAT_BLOCK,
+								 &m_extra, &length);
+	fetch_ms = run_gpubench(cuda_module, "fetch", "block",
+							m_kds, m_extra, length,
+							m_kparams, m_result, m_kerror);
+	primitive_ms = run_gpubench(cuda_module, "primitive", "block",
+								m_kds, m_extra, length,
+								m_kparams, m_result, m_kerror);
+	cuMemFree(m_kds);
+	if (m_extra)
+		cuMemFree(m_extra);
+	cuMemFree(m_kparams);
+	cuMemFree(m_result);
+	cuMemFree(m_kerror);
+	operator_ns = (primitive_ms > fetch_ms ? primitive_ms - fetch_ms
+				   : primitive_ms) * 1.0e6 / (3.0 * (double)num_rows);
+
+	/* time per cost unit */
+	page_us = 8192.0 / seq_page_bandwidth;
+	/* DMA of a chunk; GPUDirect SQL replaces the RAM-to-GPU copy if any */
+	dma_ms = ((double)chunk_size / 1.0e6) /
+		(direct_bw > h2d_bw ? direct_bw : h2d_bw) * 1000.0 + launch_us / 1000.0;
+
+	setup_cost = (setup_ms * 1000.0) / page_us;
+	dma_cost = (dma_ms * 1000.0) / page_us;
+	operator_cost = (operator_ns / 1000.0) / page_us;
+
+	if (!machine_format)
+	{
+		printf("PCIe bandwidth (HtoD): %.1f MB/s\n", h2d_bw);
+		printf("PCIe bandwidth (DtoH): %.1f MB/s\n", d2h_bw);
+		printf("Kernel launch latency: %.2f us\n", launch_us);
+		printf("Operator throughput:   %.3f ns/op\n", operator_ns);
+		printf("Device setup time:     %.2f ms\n", setup_ms);
+		if (direct_file)
+		{
+			printf("Storage bandwidth:     %.1f MB/s (read(2) of %s)\n",
+				   seq_page_bandwidth, direct_file);
+			if (direct_bw < 0.0)
+				printf("GPUDirect bandwidth:   not available\n");
+			else
+				printf("GPUDirect bandwidth:   %.1f MB/s\n", direct_bw);
+		}
+		else
+			printf("Storage bandwidth:     %.1f MB/s (assumed)\n",
+				   seq_page_bandwidth);
+		printf("\n"
+			   "# Suggested cost parameters for this device\n"
+			   "pg_strom.gpu_setup_cost = %.2f\n"
+			   "pg_strom.gpu_dma_cost = %.4f\n"
+			   "pg_strom.gpu_operator_cost = %.8f\n"
+			   "pg_strom.gpu_device_costs = '%d=%.2f:%.4f:%.8f'\n",
+			   setup_cost, dma_cost, operator_cost,
+			   device_id, setup_cost, dma_cost, operator_cost);
+	}
+	else
+	{
+		printf("DEVICE%d:PCIE_HTOD_BANDWIDTH=%.1f\n", device_id, h2d_bw);
+		printf("DEVICE%d:PCIE_DTOH_BANDWIDTH=%.1f\n", device_id, d2h_bw);
+		printf("DEVICE%d:LAUNCH_LATENCY_US=%.2f\n", device_id, launch_us);
+		printf("DEVICE%d:OPERATOR_NS=%.3f\n", device_id, operator_ns);
+		printf("DEVICE%d:SETUP_MS=%.2f\n", device_id, setup_ms);
+		printf("DEVICE%d:STORAGE_BANDWIDTH=%.1f\n",
+			   device_id, seq_page_bandwidth);
+		if (direct_bw >= 0.0)
+			printf("DEVICE%d:GPUDIRECT_BANDWIDTH=%.1f\n",
+				   device_id, direct_bw);
+		printf("DEVICE%d:GPU_SETUP_COST=%.2f\n", device_id, setup_cost);
+		printf("DEVICE%d:GPU_DMA_COST=%.4f\n", device_id, dma_cost);
+		printf("DEVICE%d:GPU_OPERATOR_COST=%.8f\n", device_id, operator_cost);
+	}
+}
+
+/*
+ * measure_p2p_bandwidth - MB/s of the device-to-device copy
+ */
+static double
+measure_p2p_bandwidth(CUcontext src_context, CUcontext dst_context)
+{
+	CUdeviceptr	m_src;
+	CUdeviceptr	m_dst;
+	CUevent		ev_start;
+	CUevent		ev_stop;
+	float		elapsed;
+	CUresult	rc;
+	int			i;
+
+	rc = cuCtxSetCurrent(dst_context);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuCtxSetCurrent: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_dst, chunk_size);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+
+	rc = cuCtxSetCurrent(src_context);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuCtxSetCurrent: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_src, chunk_size);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuMemsetD8(m_src, 0, chunk_size);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemsetD8: %s", cuErrorName(rc));
+	rc = cuEventCreate(&ev_start, CU_EVENT_DEFAULT);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventCreate: %s", cuErrorName(rc));
+	rc = cuEventCreate(&ev_stop, CU_EVENT_DEFAULT);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventCreate: %s", cuErrorName(rc));
+
+	for (i = -1; i < num_loops; i++)
+	{
+		if (i == 0)
+		{
+			rc = cuEventRecord(ev_start, NULL);
+			if (rc != CUDA_SUCCESS)
+				elog("failed on cuEventRecord: %s", cuErrorName(rc));
+		}
+		rc = cuMemcpyPeerAsync(m_dst, dst_context,
+							   m_src, src_context,
+							   chunk_size, NULL);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemcpyPeerAsync: %s", cuErrorName(rc));
+	}
+	rc = cuEventRecord(ev_stop, NULL);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventRecord: %s", cuErrorName(rc));
+	rc = cuEventSynchronize(ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventSynchronize: %s", cuErrorName(rc));
+	rc = cuEventElapsedTime(&elapsed, ev_start, ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventElapsedTime: %s", cuErrorName(rc));
+
+	cuEventDestroy(ev_start);
+	cuEventDestroy(ev_stop);
+	cuMemFree(m_src);
+	cuCtxSetCurrent(dst_context);
+	cuMemFree(m_dst);
+
+	return ((double)chunk_size * (double)num_loops /
+			((double)elapsed / 1000.0)) / 1.0e6;
+}
+
+/*
+ * lookup_nvme_devices
+ *
+ * It returns comma separated names of the NVME devices (like "nvme0,nvme1")
+ * that store the file, or NULL if not on NVME. The volume may be a partition
+ * or md-raid0 of NVME devices.
+ */
+static int
+__append_nvme_device(char *buf, size_t bufsz, const char *blkdev)
+{
+	size_t		len = strlen(buf);
+	const char *c;
+
+	/* "nvme<N>n<M>" or "nvme<N>n<M>p<P>" */
+	if (strncmp(blkdev, "nvme", 4) != 0 || !isdigit(blkdev[4]))
+		return 0;
+	for (c = blkdev + 4; isdigit(*c); c++);
+	if (*c != 'n')
+		return 0;
+	snprintf(buf + len, bufsz - len, "%s%.*s",
+			 len > 0 ? "," : "", (int)(c - blkdev), blkdev);
+	return 1;
+}
+
+static char *
+lookup_nvme_devices(const char *filename)
+{
+	struct stat	stat_buf;
+	char		path[PATH_MAX];
+	char		real[PATH_MAX];
+	char		buf[1024];
+	char	   *blkdev;
+	DIR		   *dir;
+	struct dirent *dent;
+
+	if (stat(filename, &stat_buf) != 0)
+		elog("failed on stat('%s'): %m", filename);
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u",
+			 major(stat_buf.st_dev), minor(stat_buf.st_dev));
+	if (!realpath(path, real))
+		return NULL;
+	blkdev = basename(real);
+	buf[0] = '\0';
+	if (strncmp(blkdev, "md", 2) == 0)
+	{
+		/* md-raid; walk on the member devices */
+		snprintf(path, sizeof(path), "%s/slaves", real);
+		dir = opendir(path);
+		if (!dir)
+			return NULL;
+		while ((dent = readdir(dir)) != NULL)
+		{
+			if (dent->d_name[0] == '.')
+				continue;
+			if (!__append_nvme_device(buf, sizeof(buf), dent->d_name))
+			{
+				closedir(dir);
+				return NULL;	/* contains non-NVME device */
+			}
+		}
+		closedir(dir);
+	}
+	else if (!__append_nvme_device(buf, sizeof(buf), blkdev))
+		return NULL;
+
+	return (buf[0] != '\0' ? strdup(buf) : NULL);
+}
+
+/*
+ * run_topology
+ *
+ * It measures the bandwidth of all the data paths, then suggests
+ * pg_strom.nvme_distance_map that assigns each NVME device to the GPU
+ * with the best SSD-to-GPU Direct bandwidth.
+ */
+static int
+run_topology(int nfiles, char * const files[])
+{
+	CUcontext  *contexts;
+	CUdevice	cuda_device;
+	double	   *direct_bw;
+	char	  **nvme_devs;
+	char		nvme_map[4096];
+	int			ndevs;
+	int			i, j, k;
+	CUresult	rc;
+
+	rc = cuDeviceGetCount(&ndevs);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetCount: %s", cuErrorName(rc));
+	if (ndevs == 0)
+		elog("no GPU devices found");
+	contexts = calloc(ndevs, sizeof(CUcontext));
+	direct_bw = calloc(nfiles * ndevs + 1, sizeof(double));
+	nvme_devs = calloc(nfiles + 1, sizeof(char *));
+	if (!contexts || !direct_bw || !nvme_devs)
+		elog("out of memory");
+
+	/* PCIe bandwidth of the host memory <-> GPU */
+	for (i=0; i < ndevs; i++)
+	{
+		char	dev_name[256];
+		double	h2d_bw, d2h_bw;
+
+		rc = cuDeviceGet(&cuda_device, i);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuDeviceGet: %s", cuErrorName(rc));
+		rc = cuDeviceGetName(dev_name, sizeof(dev_name), cuda_device);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuDeviceGetName: %s", cuErrorName(rc));
+		rc = cuCtxCreate(&contexts[i], 0, cuda_device);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuCtxCreate: %s", cuErrorName(rc));
+		h2d_bw = measure_dma_bandwidth(1);
+		d2h_bw = measure_dma_bandwidth(0);
+		if (!machine_format)
+			printf("GPU%d (%s): HtoD %.1f MB/s, DtoH %.1f MB/s\n",
+				   i, dev_name, h2d_bw, d2h_bw);
+		else
+		{
+			printf("DEVICE%d:DEVICE_NAME=%s\n", i, dev_name);
+			printf("DEVICE%d:PCIE_HTOD_BANDWIDTH=%.1f\n", i, h2d_bw);
+			printf("DEVICE%d:PCIE_DTOH_BANDWIDTH=%.1f\n", i, d2h_bw);
+		}
+	}
+
+	/* P2P bandwidth between GPUs */
+	for (i=0; i < ndevs; i++)
+	{
+		for (j=0; j < ndevs; j++)
+		{
+			CUdevice	peer_device;
+			int			can_access = 0;
+			double		p2p_bw;
+
+			if (i == j)
+				continue;
+			rc = cuDeviceGet(&cuda_device, i);
+			if (rc == CUDA_SUCCESS)
+				rc = cuDeviceGet(&peer_device, j);
+			if (rc == CUDA_SUCCESS)
+				rc = cuDeviceCanAccessPeer(&can_access,
+										   cuda_device, peer_device);
+			if (rc != CUDA_SUCCESS)
+				elog("failed on cuDeviceCanAccessPeer: %s", cuErrorName(rc));
+			if (can_access)
+			{
+				rc = cuCtxSetCurrent(contexts[i]);
+				if (rc != CUDA_SUCCESS)
+					elog("failed on cuCtxSetCurrent: %s", cuErrorName(rc));
+				rc = cuCtxEnablePeerAccess(contexts[j], 0);
+				if (rc != CUDA_SUCCESS &&
+					rc != CUDA_ERROR_PEER_ACCESS_ALREADY_ENABLED)
+					elog("failed on cuCtxEnablePeerAccess: %s", cuErrorName(rc));
+			}
+			/* copy is staged by the host memory, if no P2P access */
+			p2p_bw = measure_p2p_bandwidth(contexts[i], contexts[j]);
+			if (!machine_format)
+				printf("GPU%d -> GPU%d: %.1f MB/s%s\n",
+					   i, j, p2p_bw, can_access ? "" : " (no P2P access)");
+			else
+			{
+				printf("P2P:DEVICE%d:DEVICE%d:ACCESS=%d\n", i, j, can_access);
+				printf("P2P:DEVICE%d:DEVICE%d:BANDWIDTH=%.1f\n", i, j, p2p_bw);
+			}
+		}
+	}
+
+	/* SSD-to-GPU Direct bandwidth from the volume of each file */
+	for (k=0; k < nfiles; k++)
+	{
+		nvme_devs[k] = lookup_nvme_devices(files[k]);
+		if (!machine_format)
+			printf("%s (%s):",
+				   files[k], nvme_devs[k] ? nvme_devs[k] : "not on NVME");
+		for (i=0; i < ndevs; i++)
+		{
+			double	bw;
+
+			rc = cuCtxSetCurrent(contexts[i]);
+			if (rc != CUDA_SUCCESS)
+				elog("failed on cuCtxSetCurrent: %s", cuErrorName(rc));
+			bw = measure_direct_bandwidth(files[k]);
+			direct_bw[k * ndevs + i] = bw;
+			if (!machine_format)
+			{
+				if (bw < 0.0)
+					printf(" GPU%d n/a", i);
+				else
+					printf(" GPU%d %.1f MB/s", i, bw);
+			}
+			else if (bw >= 0.0)
+				printf("GPUDIRECT:%s:DEVICE%d:BANDWIDTH=%.1f\n",
+					   files[k], i, bw);
+		}
+		if (!machine_format)
+			putchar('\n');
+		else if (nvme_devs[k])
+			printf("GPUDIRECT:%s:NVME_DEVICES=%s\n", files[k], nvme_devs[k]);
+	}
+
+	/* suggest nvme_distance_map for the best GPU of each volume */
+	nvme_map[0] = '\0';
+	for (k=0; k < nfiles; k++)
+	{
+		char	   *temp, *tok, *saveptr;
+		int			best = -1;
+
+		if (!nvme_devs[k])
+			continue;
+		for (i=0; i < ndevs; i++)
+		{
+			double	bw = direct_bw[k * ndevs + i];
+
+			if (bw >= 0.0 && (best < 0 || bw > direct_bw[k * ndevs + best]))
+				best = i;
+		}
+		if (best < 0)
+			continue;
+		temp = strdup(nvme_devs[k]);
+		for (tok = strtok_r(temp, ",", &saveptr);
+			 tok != NULL;
+			 tok = strtok_r(NULL, ",", &saveptr))
+		{
+			size_t	len = strlen(nvme_map);
+
+			snprintf(nvme_map + len, sizeof(nvme_map) - len, "%s%s:gpu%d",
+					 len > 0 ? "," : "", tok, best);
+		}
+		free(temp);
+	}
+	if (!machine_format)
+	{
+		if (nvme_map[0] != '\0')
+			printf("\n"
+				   "# Suggested NVME-GPU distance map for this system\n"
+				   "pg_strom.nvme_distance_map = '%s'\n", nvme_map);
+		else if (nfiles > 0)
+			printf("\n"
+				   "# Unable to suggest pg_strom.nvme_distance_map;"
+				   " GPUDirect is not available\n");
+	}
+	else if (nvme_map[0] != '\0')
+		printf("PLATFORM:NVME_DISTANCE_MAP=%s\n", nvme_map);
+
+	for (i=0; i < ndevs; i++)
+		cuCtxDestroy(contexts[i]);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	CUdevice	cuda_device;
+	CUcontext	cuda_context;
+	CUmodule	cuda_module;
+	CUdeviceptr	m_kparams;
+	CUdeviceptr	m_result;
+	CUdeviceptr	m_kerror;
+	char		dev_name[256];
+	int			version;
+	int			major, minor;
+	int			opt;
+	int			i, j;
+	struct timeval tv1, tv2;
+	CUresult	rc;
+
+	/*
+	 * Parse options
+	 */
+	while ((opt = getopt(argc, argv, "d:n:l:f:F:I:L:CTg:B:k:S:mh")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd':
+				device_id = atoi(optarg);
+				break;
+			case 'n':
+				num_rows = strtoul(optarg, NULL, 10);
+				if (num_rows == 0)
+					elog("number of rows must be positive");
+				break;
+			case 'l':
+				num_loops = atoi(optarg);
+				if (num_loops <= 0)
+					elog("number of loops must be positive");
+				break;
+			case 'f':
+				family_list = optarg;
+				break;
+			case 'F':
+				format_list = optarg;
+				break;
+			case 'I':
+				include_path = optarg;
+				break;
+			case 'L':
+				library_path = optarg;
+				break;
+			case 'C':
+				calibration = 1;
+				break;
+			case 'T':
+				topology = 1;
+				break;
+			case 'g':
+				direct_file = optarg;
+				break;
+			case 'B':
+				seq_page_bandwidth = atof(optarg);
+				if (seq_page_bandwidth <= 0.0)
+					elog("storage bandwidth must be positive");
+				break;
+			case 'k':
+				chunk_size = strtoul(optarg, NULL, 10) << 20;
+				if (chunk_size == 0)
+					elog("chunk size must be positive");
+				break;
+			case 'S':
+				direct_read_limit = strtoul(optarg, NULL, 10) << 20;
+				break;
+			case 'm':
+				machine_format = 1;
+				break;
+			default:
+				fprintf(stderr, "unknown option: %c\n", opt);
+			case 'h':
+				fprintf(stderr,
+						"usage: %s [options]\n"
+						"       %s -T [options] [<file> ...]\n"
+						"  -d <device>  : GPU device id (default: 0)\n"
+						"  -n <nrows>   : number of rows per chunk (default: %u)\n"
+						"  -l <loops>   : number of kernel launches (default: %d)\n"
+						"  -f <list>    : device function families to run\n"
+						"                 (fetch,primitive,numeric,textlib)\n"
+						"  -F <list>    : data-store formats to run\n"
+						"                 (row,block,arrow,column)\n"
+						"  -I <dir>     : directory of the device headers\n"
+						"  -L <dir>     : directory of the device libraries\n"
+						"                 (default: %s)\n"
+						"  -C           : calibration of the cost parameters\n"
+						"  -T           : bandwidth of all the GPUs and the volumes\n"
+						"                 of the <file>s, to suggest\n"
+						"                 pg_strom.nvme_distance_map\n"
+						"  -g <file>    : file on NVME-SSD to measure the storage\n"
+						"                 and GPUDirect bandwidth (with -C)\n"
+						"  -B <MB/s>    : storage bandwidth that seq_page_cost\n"
+						"                 stands for (default: measured by -g,\n"
+						"                 or 1000)\n"
+						"  -k <MB>      : DMA chunk size (default: 64)\n"
+						"  -S <MB>      : max size to read from the file by\n"
+						"                 GPUDirect (default: whole file)\n"
+						"  -m : machine readable format\n"
+						"  -h : shows this message\n",
+						basename(argv[0]), basename(argv[0]),
+						num_rows, num_loops,
+						library_path);
+				return 1;
+		}
+	}
+
+	/*
+	 * Init CUDA context
+	 */
+	rc = cuInit(0);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuInit: %s", cuErrorName(rc));
+	rc = cuDriverGetVersion(&version);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDriverGetVersion: %s", cuErrorName(rc));
+	if (topology)
+		return run_topology(argc - optind, argv + optind);
+	rc = cuDeviceGet(&cuda_device, device_id);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGet: %s", cuErrorName(rc));
+	rc = cuDeviceGetName(dev_name, sizeof(dev_name), cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetName: %s", cuErrorName(rc));
+	rc = cuDeviceGetAttribute(&major,
+							  CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR,
+							  cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetAttribute: %s", cuErrorName(rc));
+	rc = cuDeviceGetAttribute(&minor,
+							  CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR,
+							  cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetAttribute: %s", cuErrorName(rc));
+	gettimeofday(&tv1, NULL);
+	rc = cuCtxCreate(&cuda_context, 0, cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuCtxCreate: %s", cuErrorName(rc));
+	gettimeofday(&tv2, NULL);
+
+	if (!machine_format)
+	{
+		printf("CUDA Runtime version: %d.%d.%d\n",
+			   (version / 1000),
+			   (version % 1000) / 10,
+			   (version % 10));
+		printf("Device Name: %s (CC %d.%d)\n", dev_name, major, minor);
+		printf("Rows per chunk: %u, Loops: %d\n", num_rows, num_loops);
+	}
+	else
+	{
+		printf("PLATFORM:CUDA_RUNTIME_VERSION=%d.%d.%d\n",
+			   (version / 1000),
+			   (version % 1000) / 10,
+			   (version % 10));
+		printf("DEVICE%d:DEVICE_NAME=%s\n", device_id, dev_name);
+		printf("DEVICE%d:COMPUTE_CAPABILITY=%d.%d\n",
+			   device_id, major, minor);
+		printf("BENCH:NUM_ROWS=%u\n", num_rows);
+		printf("BENCH:NUM_LOOPS=%d\n", num_loops);
+	}
+
+	cuda_module = build_gpubench_module(cuda_device);
+	if (calibration)
+	{
+		/* NVRTC build is not a part of setup; it is cached on run-time */
+		run_calibration(cuda_module, timeval_diff_ms(&tv1, &tv2));
+		cuModuleUnload(cuda_module);
+		cuCtxDestroy(cuda_context);
+		return 0;
+	}
+
+	/* kern_parambuf with no parameters, and result buffers */
+	rc = cuMemAlloc(&m_kparams, 4096);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuMemsetD8(m_kparams, 0, 4096);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemsetD8: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_result, sizeof(unsigned long long));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuMemAlloc(&m_kerror, KERN_ERRORBUF_SIZE);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+
+	for (i=0; i < lengthof(format_catalog); i++)
+	{
+		CUdeviceptr	m_kds;
+		CUdeviceptr	m_extra;
+		size_t		length;
+
+		if (!is_listed(format_list, format_catalog[i].name))
+			continue;
+		m_kds = setup_gpubench_chunk(cuda_module,
+									 format_catalog[i].format,
+									 &m_extra, &length);
+		if (machine_format)
+			printf("BENCH:%s:CHUNK_SIZE=%zu\n",
+				   format_catalog[i].name, length);
+		for (j=0; j < lengthof(family_catalog); j++)
+		{
+			if (!is_listed(family_list, family_catalog[j].name))
+				continue;
+			run_gpubench(cuda_module,
+						 family_catalog[j].name,
+						 format_catalog[i].name,
+						 m_kds, m_extra, length,
+						 m_kparams, m_result, m_kerror);
+		}
+		cuMemFree(m_kds);
+		if (m_extra)
+			cuMemFree(m_extra);
+	}
+	cuMemFree(m_kparams);
+	cuMemFree(m_result);
+	cuMemFree(m_kerror);
+	cuModuleUnload(cuda_module);
+	cuCtxDestroy(cuda_context);
+
+	return 0;
+}
@@ -25,9 +25,11 @@
 #include <assert.h>
 #include <getopt.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <libpq-fe.h>
 #include "gstore_fdw.h"
@@ -42,7 +44,13 @@ static char	   *pgsql_tablename = NULL;
 static char	   *base_filename = NULL;
 static char	   *redo_filename = NULL;
 static int		base_fdesc = -1;
+static int		redo_fdesc = -1;
 static long		PAGE_SIZE;
+static volatile sig_atomic_t got_sigint = 0;
+static int		base_backup_done = 0;
+static int		is_worker_process = 0;
+static int		num_workers = 1;
+static int64	since_lpos = -1;
 
 #define Elog(fmt, ...)                              \
 	do {                                            \
@@ -148,21 +156,96 @@ pgsql_server_connect(const char *pgsql_hostname,
 	return conn;
 }
 
+/*
+ * fetch_base_chunk
+ *
+ * It fetches a chunk of the base file, then writes it out at the offset
+ * where the chunk is located. It returns false if no chunk exists any more.
+ */
+static int
+fetch_base_chunk(PGconn *conn, int fdesc, int index, const char *lposBuf,
+				 GpuStoreBaseFileHead *p_baseHead, uint64 *p_next_lpos)
+{
+	PGresult   *res;
+	const char *command;
+	char		countBuf[20];
+	Oid			paramTypes[3];
+	const char *paramValues[3];
+	GpuStoreReplicationChunk *chunk;
+	size_t		chunk_sz;
+	size_t		len;
+
+	command = "SELECT pgstrom.gstore_fdw_replication_base($1,$2,$3)";
+	paramTypes[0] = TEXTOID;
+	paramTypes[1] = INT4OID;
+	paramTypes[2] = INT8OID;
+	paramValues[0] = pgsql_tablename;
+	paramValues[1] = countBuf;
+	paramValues[2] = lposBuf;
+
+	sprintf(countBuf, "%d", index);
+	res = PQexecParams(conn, command, 3,
+					   paramTypes,
+					   paramValues,
+					   NULL,
+					   NULL,
+					   1);		/* result should be binary format */
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		Elog("SQL execution failed [%s] $1='%s', $2='%d': %s",
+			 command, pgsql_tablename, index,
+			 PQresultErrorMessage(res));
+	if (PQnfields(res) != 1 || PQntuples(res) != 1)
+		Elog("unexpected number of columns/rows returned for [%s]",
+			 command);
+	if (PQgetisnull(res, 0, 0))
+	{
+		PQclear(res);
+		return 0;
+	}
+	chunk = (GpuStoreReplicationChunk *)PQgetvalue(res, 0, 0);
+	chunk_sz = PQgetlength(res, 0, 0);
+	if (chunk_sz <= offsetof(GpuStoreReplicationChunk, data) ||
+		(chunk->rep_kind != 'b' && chunk->rep_kind != 'e'))
+		Elog("Bug? unexpected replication chunk");
+	len = chunk_sz - offsetof(GpuStoreReplicationChunk, data);
+	if (pwrite(fdesc, chunk->data, len, chunk->rep_offset) != len)
+		Elog("failed on pwrite('%s'): %m", base_filename);
+	/* save the header portion */
+	if (p_baseHead)
+	{
+		if (chunk->rep_kind != 'b' ||
+			chunk->rep_offset != 0 ||
+			len < sizeof(GpuStoreBaseFileHead))
+			Elog("Bug? base chunk of '%s' is incomplete", pgsql_tablename);
+		memcpy(p_baseHead, chunk->data, sizeof(GpuStoreBaseFileHead));
+	}
+	if (p_next_lpos)
+		*p_next_lpos = chunk->rep_lpos;
+	PQclear(res);
+
+	return 1;
+}
+
+/*
+ * build_base_backup
+ *
+ * The leader session acquires ShareRowExclusiveLock by the first chunk to
+ * block any writes. Then, the worker processes fetch the rest of chunks
+ * in parallel, with their own connections.
+ */
 static uint64
 build_base_backup(PGconn *conn, int fdesc)
 {
 	PGresult   *res;
-	const char *command;
 	GpuStoreBaseFileHead baseHead;
 	kern_data_extra extraHead;
-	size_t		base_sz = 0;
-	size_t		extra_sz = 0;
-	char		countBuf[20];
-	Oid			paramTypes[2];
-	const char *paramValues[2];
-	int32		count = 0;
-	char		phase = 'b';
+	char		lposBuf[40];
+	pid_t	   *workers;
+	size_t		base_sz;
+	cl_uint		nrooms;
+	cl_uint		nslots;
 	uint64		next_lpos = 0;
+	int			i, index;
 
 	/* begin transaction */
 	res = PQexec(conn, "BEGIN");
@@ -170,165 +253,192 @@ build_base_backup(PGconn *conn, int fdesc)
 		Elog("SQL execution failed: %s", PQresultErrorMessage(res));
 	PQclear(res);
 
-	/* fetch base & extra portion */
-	command = "SELECT pgstrom.gstore_fdw_replication_base($1,$2)";
-	paramTypes[0] = TEXTOID;
-	paramTypes[1] = INT4OID;
-	paramValues[0] = pgsql_tablename;
-	paramValues[1] = countBuf;
+	if (!fetch_base_chunk(conn, fdesc, 0, "-1", &baseHead, &next_lpos))
+		Elog("Bug? no base chunk of '%s'", pgsql_tablename);
+	sprintf(lposBuf, "%lu", next_lpos);
 
-	for (count=0; ; count++)
+	/* launch worker processes */
+	workers = alloca(sizeof(pid_t) * num_workers);
+	for (i=1; i < num_workers; i++)
 	{
-		GpuStoreReplicationChunk *chunk = NULL;
-		size_t		chunk_sz = 0;
-		size_t		len;
+		pid_t	pid = fork();
 
-		sprintf(countBuf, "%d", count);
-		res = PQexecParams(conn, command, 2,
-						   paramTypes,
-						   paramValues,
-						   NULL,
-						   NULL,
-						   1);		/* result should be binary format */
-		if (PQresultStatus(res) != PGRES_TUPLES_OK)
-			Elog("SQL execution failed [%s] $1='%s', $2='%d'",
-				 command, pgsql_tablename, count);
-		if (PQnfields(res) != 1 || PQntuples(res) != 1)
-			Elog("unexpected number of columns/rows returned for [%s]",
-				 command);
-	retry:
-		if (phase == 'b')
-		{
-			if (!PQgetisnull(res, 0, 0))
-			{
-				chunk = (GpuStoreReplicationChunk *)PQgetvalue(res, 0, 0);
-				chunk_sz = PQgetlength(res, 0, 0);
-				assert(chunk_sz > offsetof(GpuStoreReplicationChunk, data));
-				/* save the header portion */
-				if (base_sz < sizeof(GpuStoreBaseFileHead))
-				{
-					len = Min(chunk_sz - offsetof(GpuStoreReplicationChunk, data),
-							  sizeof(GpuStoreBaseFileHead) - base_sz);
-					memcpy(((char *)&baseHead) + base_sz, chunk->data, len);
-				}
-				next_lpos = chunk->rep_lpos;
-			}
-
-			if (chunk && chunk->rep_kind == 'b')
-			{
-				assert(chunk_sz > offsetof(GpuStoreReplicationChunk, data));
-				len = chunk_sz - offsetof(GpuStoreReplicationChunk, data);
-				if (__Write(fdesc, chunk->data, len) != len)
-					Elog("failed on __Write('%s'): %m", base_filename);
-				base_sz += len;
-			}
-			else
-			{
-				cl_uint		nrooms = baseHead.schema.nrooms;
-				cl_uint		nslots;
-				
-				/* end of the base chunk, switch to the extra chunk */
-				if (base_sz < sizeof(GpuStoreBaseFileHead))
-					Elog("Bug? base chunk of '%s' is incomplete", pgsql_tablename);
-
-				assert(baseHead.rowid_map_offset >= base_sz);
-				len = (baseHead.rowid_map_offset +
-					   MAXALIGN(offsetof(GpuStoreRowIdMapHead,
-										 rowid_chain[nrooms])));
-				len = TYPEALIGN(PAGE_SIZE, len);
-
-				if (baseHead.hash_index_offset > 0)
-				{
-					/* with primary key, thus hash-index exists */
-					if (baseHead.hash_index_offset != len)
-						Elog("Bug? location of hash-index is corrupted");
-					nslots = Min(1.2 * (double)nrooms + 1000.0, UINT_MAX);
-					len += offsetof(GpuStoreHashIndexHead,
-									slots[nslots + nrooms]);
-					len = TYPEALIGN(PAGE_SIZE, len);
-				}
-
-				if (ftruncate(fdesc, len) < 0)
-					Elog("failed on ftruncate('%s',%zu): %m", base_filename, len);
-				if (lseek(fdesc, 0, SEEK_END) < 0)
-					Elog("failed on lseek('%s', 0, SEEK_END): %m", base_filename);
-				base_sz = len;
-
-				phase = chunk->rep_kind;
-				if (chunk)
-					goto retry;
-			}
-		}
-		else if (phase == 'e')
+		if (pid < 0)
+			Elog("failed on fork(): %m");
+		if (pid == 0)
 		{
-			if (!PQgetisnull(res, 0, 0))
-			{
-				chunk = (GpuStoreReplicationChunk *)PQgetvalue(res, 0, 0);
-				chunk_sz = PQgetlength(res, 0, 0);
-				assert(chunk_sz > offsetof(GpuStoreReplicationChunk, data));
-				/* save the header portion */
-				if (extra_sz < sizeof(kern_data_extra))
-				{
-					len = Min(chunk_sz - offsetof(GpuStoreReplicationChunk, data),
-							  sizeof(kern_data_extra) - extra_sz);
-					memcpy((char *)&extraHead + extra_sz, chunk->data, len);
-				}
-				next_lpos = chunk->rep_lpos;
-			}
-
-			if (chunk && chunk->rep_kind == 'e')
-			{
-				/* sanity checks */
-				if (base_sz != (offsetof(GpuStoreBaseFileHead,
-										 schema) + baseHead.schema.extra_hoffset))
-					Elog("Bug? Location of extra buffer is corrupted");
-				assert(chunk_sz > offsetof(GpuStoreReplicationChunk, data));
-				len = chunk_sz - offsetof(GpuStoreReplicationChunk, data);
-				if (__Write(fdesc, chunk->data, len) != len)
-					Elog("failed on __Write('%s'): %m", base_filename);
-				extra_sz += len;
-			}
-			else
+			PGconn *wconn;
+
+			is_worker_process = 1;
+			wconn = pgsql_server_connect(pgsql_hostname,
+										 pgsql_port_num,
+										 pgsql_username,
+										 pgsql_password,
+										 pgsql_database);
+			for (index=i; ; index += num_workers)
 			{
-				/* end of the extra chunk, enlarge buffer to fit extra->length */
-				if (extra_sz < sizeof(kern_data_extra))
-					Elog("Bug? extra chunk of '%s' is incomplete", pgsql_tablename);
-				assert(extraHead.length >= extra_sz);
-				len = (base_sz + extraHead.length);
-				if (ftruncate(fdesc, len) < 0)
-					Elog("failed on ftruncate('%s',%zu): %m", base_filename, len);
-				if (chunk)
-					goto retry;		/* should not happen */
+				if (!fetch_base_chunk(wconn, fdesc, index, lposBuf, NULL, NULL))
+					break;
 			}
+			PQfinish(wconn);
+			exit(0);
 		}
-		else
-			Elog("Bug? wrong internal phase '%c'", phase);
-		PQclear(res);
-		if (!chunk)
+		workers[i] = pid;
+	}
+	/* the leader also fetches its own share */
+	for (index=num_workers; ; index += num_workers)
+	{
+		if (!fetch_base_chunk(conn, fdesc, index, lposBuf, NULL, NULL))
 			break;
 	}
+	for (i=1; i < num_workers; i++)
+	{
+		int		status;
+
+		if (waitpid(workers[i], &status, 0) < 0)
+			Elog("failed on waitpid(): %m");
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			Elog("worker process of base backup failed");
+	}
+
 	/* end transaction - release exclusive lock */
 	res = PQexec(conn, "COMMIT");
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		Elog("SQL execution failed: %s", PQresultErrorMessage(res));
 	PQclear(res);
-	
+
+	/*
+	 * Enlarge the base file to fit the row-id map, hash-index and extra
+	 * buffer. Row-id map and hash-index are not transferred, and shall be
+	 * rebuilt on the startup.
+	 */
+	nrooms = baseHead.schema.nrooms;
+	base_sz = (baseHead.rowid_map_offset +
+			   MAXALIGN(offsetof(GpuStoreRowIdMapHead,
+								 rowid_chain[nrooms])));
+	base_sz = TYPEALIGN(PAGE_SIZE, base_sz);
+	if (baseHead.hash_index_offset > 0)
+	{
+		/* with primary key, thus hash-index exists */
+		if (baseHead.hash_index_offset != base_sz)
+			Elog("Bug? location of hash-index is corrupted");
+		nslots = Min(1.2 * (double)nrooms + 1000.0, UINT_MAX);
+		base_sz += offsetof(GpuStoreHashIndexHead,
+							slots[nslots + nrooms]);
+		base_sz = TYPEALIGN(PAGE_SIZE, base_sz);
+	}
+	if (baseHead.schema.extra_hoffset > 0)
+	{
+		size_t	extra_pos = (offsetof(GpuStoreBaseFileHead, schema) +
+							 baseHead.schema.extra_hoffset);
+
+		if (extra_pos != base_sz)
+			Elog("Bug? Location of extra buffer is corrupted");
+		if (pread(fdesc, &extraHead, sizeof(kern_data_extra),
+				  extra_pos) != sizeof(kern_data_extra))
+			Elog("Bug? extra chunk of '%s' is incomplete", pgsql_tablename);
+		base_sz += extraHead.length;
+	}
+	if (ftruncate(fdesc, base_sz) < 0)
+		Elog("failed on ftruncate('%s',%zu): %m", base_filename, base_sz);
+	if (fsync(fdesc) != 0)
+		Elog("failed on fsync('%s'): %m", base_filename);
+
 	return next_lpos;
 }
 
+/*
+ * stream_redo_log
+ *
+ * It receives REDO logs continuously, and appends them to the redo file.
+ * gstore_fdw_replication_redo() blocks until any transaction commits on
+ * the foreign table, so we don't need to poll the server by ourselves.
+ * If 'until_tail' is true, it returns once it catches up the current tail
+ * of the REDO log (incremental backup). It returns the next logical position
+ * to continue the backup.
+ */
+static void
+sigint_handler(int signum)
+{
+	got_sigint = 1;
+}
 
+static uint64
+stream_redo_log(PGconn *conn, int fdesc, uint64 next_lpos, int until_tail)
+{
+	const char *command;
+	char		lposBuf[40];
+	Oid			paramTypes[2];
+	const char *paramValues[2];
 
+	if (until_tail)
+		command = "SELECT pgstrom.gstore_fdw_replication_redo($1,$2,0.0,0)";
+	else
+		command = "SELECT pgstrom.gstore_fdw_replication_redo($1,$2,1.0,0)";
+	paramTypes[0] = TEXTOID;
+	paramTypes[1] = INT8OID;
+	paramValues[0] = pgsql_tablename;
+	paramValues[1] = lposBuf;
 
+	signal(SIGINT, sigint_handler);
+	signal(SIGTERM, sigint_handler);
+	while (!got_sigint)
+	{
+		PGresult   *res;
+		GpuStoreReplicationChunk *chunk;
+		size_t		chunk_sz;
+		size_t		len;
+
+		sprintf(lposBuf, "%lu", next_lpos);
+		res = PQexecParams(conn, command, 2,
+						   paramTypes,
+						   paramValues,
+						   NULL,
+						   NULL,
+						   1);		/* result should be binary format */
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			Elog("SQL execution failed [%s] $1='%s', $2='%s': %s",
+				 command, pgsql_tablename, lposBuf,
+				 PQresultErrorMessage(res));
+		if (PQnfields(res) != 1 || PQntuples(res) != 1 ||
+			PQgetisnull(res, 0, 0))
+			Elog("unexpected result returned for [%s]", command);
+		chunk = (GpuStoreReplicationChunk *)PQgetvalue(res, 0, 0);
+		chunk_sz = PQgetlength(res, 0, 0);
+		if (chunk_sz < offsetof(GpuStoreReplicationChunk, data) ||
+			chunk->rep_kind != 'r')
+			Elog("Bug? unexpected replication chunk");
+		len = chunk_sz - offsetof(GpuStoreReplicationChunk, data);
+		if (len > 0)
+		{
+			if (__Write(fdesc, chunk->data, len) != len)
+				Elog("failed on __Write('%s'): %m", redo_filename);
+			if (fdatasync(fdesc) != 0)
+				Elog("failed on fdatasync('%s'): %m", redo_filename);
+		}
+		next_lpos = chunk->rep_lpos;
+		if (until_tail && chunk->rep_nitems == 0)
+			got_sigint = 1;
+		PQclear(res);
+	}
+	return next_lpos;
+}
 
 static void
 usage(int exitcode)
 {
 	fputs("gstore_backup [OPTIONS] BASE_FILE\n"
+		  "gstore_backup [OPTIONS] -r REDO_FILE -s LPOS\n"
 		  "\n"
 		  "General options:\n"
 		  "  -d, --dbname=DBNAME    database name to connect\n"
 		  "  -t, --table=TABLENAME  table name for backup\n"
-		  "  -r, --redo-log=FILENAME filename to store redo-log (optional)\n"
+		  "  -r, --redo-log=FILENAME filename to store redo-log (optional);\n"
+		  "                         it streams redo-log until SIGINT/SIGTERM\n"
+		  "  -j, --jobs=N           number of parallel jobs for base backup\n"
+		  "                         (default: 1)\n"
+		  "  -s, --since=LPOS       incremental backup; it appends redo-log\n"
+		  "                         since LPOS to the redo file, then exit\n"
 		  "\n"
 		  "Connection options:\n"
 		  "  -h, --host=HOSTNAME    database server host\n"
@@ -347,6 +457,8 @@ parse_options(int argc, char * const argv[])
 		{"dbname",      required_argument, NULL,  'd' },
 		{"table",       required_argument, NULL,  't' },
 		{"redo-log",    required_argument, NULL,  'r' },
+		{"jobs",        required_argument, NULL,  'j' },
+		{"since",       required_argument, NULL,  's' },
 		{"host",        required_argument, NULL,  'h' },
 		{"port",        required_argument, NULL,  'p' },
 		{"user",        required_argument, NULL,  'u' },
@@ -357,7 +469,7 @@ parse_options(int argc, char * const argv[])
 	int		password_prompt = 0;
 	int		c;
 
-	while ((c = getopt_long(argc, argv, "d:t:r:h:p:u:wW",
+	while ((c = getopt_long(argc, argv, "d:t:r:j:s:h:p:u:wW",
 							long_options, NULL)) >= 0)
 	{
 		switch (c)
@@ -380,6 +492,24 @@ parse_options(int argc, char * const argv[])
 				redo_filename = optarg;
 				break;
 
+			case 'j':
+				num_workers = atoi(optarg);
+				if (num_workers < 1 || num_workers > 64)
+					Elog("-j option has out of range value: %s", optarg);
+				break;
+
+			case 's':
+				{
+					char   *end;
+
+					if (since_lpos >= 0)
+						Elog("-s option was supplied twice");
+					since_lpos = strtol(optarg, &end, 10);
+					if (*end != '\0' || since_lpos < 0)
+						Elog("-s option has invalid value: %s", optarg);
+				}
+				break;
+
 			case 'h':
 				if (pgsql_hostname)
 					Elog("-h option was supplied twice");
@@ -415,12 +545,19 @@ parse_options(int argc, char * const argv[])
 		}
 	}
 
-	if (optind + 1 != argc)
-		Elog("BASEFILE was not specified");
-	base_filename = argv[optind];
-
-	if (redo_filename)
-		Elog("-r option is not implemented yet");
+	if (since_lpos >= 0)
+	{
+		if (!redo_filename)
+			Elog("-s option requires -r option");
+		if (optind != argc)
+			Elog("BASEFILE is not needed for incremental backup");
+	}
+	else
+	{
+		if (optind + 1 != argc)
+			Elog("BASEFILE was not specified");
+		base_filename = argv[optind];
+	}
 
 	if (password_prompt > 0)
 	{
@@ -433,8 +570,10 @@ parse_options(int argc, char * const argv[])
 static void
 on_exit_cleanup(int status, void *arg)
 {
-	if (status == 0)
-		return;		/* exit successfully */
+	if (status == 0 || base_backup_done || is_worker_process)
+		return;		/* exit successfully, or base backup is already valid */
+	if (!base_filename)
+		return;		/* incremental backup */
 	if (unlink(base_filename) != 0)
 		fprintf(stderr, "failed on unlink('%s'): %m", base_filename);
 }
@@ -450,6 +589,26 @@ main(int argc, char * const argv[])
 	PAGE_SIZE = sysconf(_SC_PAGESIZE);
 
 	parse_options(argc, argv);
+
+	/* incremental backup; append redo logs since the supplied position */
+	if (since_lpos >= 0)
+	{
+		conn = pgsql_server_connect(pgsql_hostname,
+									pgsql_port_num,
+									pgsql_username,
+									pgsql_password,
+									pgsql_database);
+		redo_fdesc = open(redo_filename, O_WRONLY | O_CREAT | O_APPEND, 0600);
+		if (redo_fdesc < 0)
+			Elog("failed on open('%s'): %m", redo_filename);
+		next_lpos = stream_redo_log(conn, redo_fdesc, since_lpos, 1);
+		close(redo_fdesc);
+		PQfinish(conn);
+
+		printf("next_lpos = %lu\n", next_lpos);
+		return 0;
+	}
+
 	/* open the base file */
 	base_fdesc = open(base_filename, O_RDWR | O_CREAT | O_EXCL, 0600);
 	if (base_fdesc < 0)
@@ -474,10 +633,8 @@ main(int argc, char * const argv[])
 	next_lpos = build_base_backup(conn, base_fdesc);
 
 	printf("next_lpos = %lu\n", next_lpos);
+	fflush(stdout);
 
-
-
-	PQfinish(conn);
 	/* switch file, if needed */
 	if (dest_filename)
 	{
@@ -489,5 +646,19 @@ main(int argc, char * const argv[])
 				 base_filename);
 		}
 	}
+	base_backup_done = 1;
+	/* stream redo logs until SIGINT/SIGTERM */
+	if (redo_filename)
+	{
+		redo_fdesc = open(redo_filename, O_WRONLY | O_CREAT | O_APPEND, 0600);
+		if (redo_fdesc < 0)
+			Elog("failed on open('%s'): %m", redo_filename);
+		next_lpos = stream_redo_log(conn, redo_fdesc, next_lpos, 0);
+		close(redo_fdesc);
+
+		printf("next_lpos = %lu\n", next_lpos);
+	}
+	PQfinish(conn);
+
 	return 0;
 }
@@ -1079,15 +1079,173 @@ sqldb_fetch_results(void *sqldb_state, SQLtable *table)
 	return -1;
 }
 
+/*
+ * sqldb_fetch_scalar - run a query that returns a single value
+ */
+char *
+sqldb_fetch_scalar(void *sqldb_state, const char *query)
+{
+	MYSTATE	   *mystate = (MYSTATE *)sqldb_state;
+	MYSQL	   *conn = mystate->conn;
+	MYSQL_RES  *res;
+	MYSQL_ROW	row;
+	char	   *retval = NULL;
+
+	if (mysql_query(conn, query) != 0)
+		Elog("failed on mysql_query('%s'): %s",
+			 query, mysql_error(conn));
+	res = mysql_store_result(conn);
+	if (!res)
+		Elog("failed on mysql_store_result: %s", mysql_error(conn));
+	if (mysql_num_fields(res) != 1 ||
+		mysql_num_rows(res) != 1)
+		Elog("unexpected query result for '%s'", query);
+	row = mysql_fetch_row(res);
+	if (row[0])
+		retval = pstrdup(row[0]);
+	mysql_free_result(res);
+
+	return retval;
+}
+
 void
 sqldb_close_connection(void *sqldb_state)
 {
 	MYSTATE	   *mystate = (MYSTATE *)sqldb_state;
 
-	mysql_free_result(mystate->res);
+	if (mystate->res)
+		mysql_free_result(mystate->res);
 	mysql_close(mystate->conn);
 }
 
+/*
+ * mysql_split_table_by_pkey
+ *
+ * It splits the table into 'nsplits' ranges of the primary key, for the
+ * parallel extraction by -n option. The primary key must be a single
+ * integer column, so each worker can scan its own range using the index.
+ * The first and last ranges are open-ended, so rows out of the MIN/MAX
+ * at this moment are never lost.
+ */
+char **
+mysql_split_table_by_pkey(void *sqldb_state,
+						  const char *table_name,
+						  int nsplits)
+{
+	MYSTATE	   *mystate = (MYSTATE *)sqldb_state;
+	MYSQL	   *conn = mystate->conn;
+	MYSQL_RES  *res;
+	MYSQL_ROW	row;
+	char	  **commands;
+	char	   *query;
+	char	   *nspname = NULL;
+	char	   *relname;
+	char	   *pos;
+	char	   *pkey_name;
+	const char *pkey_type;
+	int64		min_value = 0;
+	int64		max_value = 0;
+	uint64		width;
+	int			i;
+
+	/* lookup the primary key */
+	relname = pstrdup(table_name);
+	pos = strchr(relname, '.');
+	if (pos)
+	{
+		*pos++ = '\0';
+		nspname = palloc(2 * strlen(relname) + 1);
+		mysql_real_escape_string(conn, nspname, relname, strlen(relname));
+		relname = pos;
+	}
+	pos = palloc(2 * strlen(relname) + 1);
+	mysql_real_escape_string(conn, pos, relname, strlen(relname));
+	relname = pos;
+
+	query = palloc(1024 + strlen(relname) + (nspname ? strlen(nspname) : 0));
+	sprintf(query,
+			"SELECT k.COLUMN_NAME, c.DATA_TYPE"
+			"  FROM information_schema.KEY_COLUMN_USAGE k,"
+			"       information_schema.COLUMNS c"
+			" WHERE k.TABLE_SCHEMA = c.TABLE_SCHEMA"
+			"   AND k.TABLE_NAME = c.TABLE_NAME"
+			"   AND k.COLUMN_NAME = c.COLUMN_NAME"
+			"   AND k.CONSTRAINT_NAME = 'PRIMARY'"
+			"   AND k.TABLE_SCHEMA = %s%s%s"
+			"   AND k.TABLE_NAME = '%s'",
+			nspname ? "'" : "",
+			nspname ? nspname : "DATABASE()",
+			nspname ? "'" : "",
+			relname);
+	if (mysql_query(conn, query) != 0)
+		Elog("failed on mysql_query('%s'): %s",
+			 query, mysql_error(conn));
+	res = mysql_store_result(conn);
+	if (!res)
+		Elog("failed on mysql_store_result: %s", mysql_error(conn));
+	if (mysql_num_rows(res) != 1)
+		Elog("table '%s' must have a single column primary key to split the table for -n option",
+			 table_name);
+	row = mysql_fetch_row(res);
+	pkey_name = pstrdup(row[0]);
+	pkey_type = row[1];
+	if (strcasecmp(pkey_type, "tinyint") != 0 &&
+		strcasecmp(pkey_type, "smallint") != 0 &&
+		strcasecmp(pkey_type, "mediumint") != 0 &&
+		strcasecmp(pkey_type, "int") != 0 &&
+		strcasecmp(pkey_type, "bigint") != 0)
+		Elog("primary key '%s' of table '%s' is not an integer column (%s)",
+			 pkey_name, table_name, pkey_type);
+	mysql_free_result(res);
+
+	/* fetch the range of the primary key */
+	query = palloc(200 + strlen(pkey_name) + strlen(table_name));
+	sprintf(query, "SELECT MIN(`%s`), MAX(`%s`) FROM %s",
+			pkey_name, pkey_name, table_name);
+	if (mysql_query(conn, query) != 0)
+		Elog("failed on mysql_query('%s'): %s",
+			 query, mysql_error(conn));
+	res = mysql_store_result(conn);
+	if (!res)
+		Elog("failed on mysql_store_result: %s", mysql_error(conn));
+	if (mysql_num_fields(res) != 2 ||
+		mysql_num_rows(res) != 1)
+		Elog("unexpected query result for '%s'", query);
+	row = mysql_fetch_row(res);
+	if (row[0] && row[1])
+	{
+		errno = 0;
+		min_value = strtoll(row[0], NULL, 10);
+		max_value = strtoll(row[1], NULL, 10);
+		if (errno != 0)
+			Elog("primary key '%s' of table '%s' is out of range: %m",
+				 pkey_name, table_name);
+	}
+	mysql_free_result(res);
+
+	/* build SQL commands for each range */
+	width = ((uint64)max_value - (uint64)min_value) / nsplits + 1;
+	commands = palloc0(sizeof(char *) * nsplits);
+	for (i=0; i < nsplits; i++)
+	{
+		int64	lower = (int64)((uint64)min_value + width * i);
+		int64	upper = (int64)((uint64)min_value + width * (i+1));
+
+		query = palloc(200 + 2 * strlen(pkey_name) + strlen(table_name));
+		if (i == 0)
+			sprintf(query, "SELECT * FROM %s WHERE `%s` < %ld",
+					table_name, pkey_name, upper);
+		else if (i == nsplits - 1)
+			sprintf(query, "SELECT * FROM %s WHERE `%s` >= %ld",
+					table_name, pkey_name, lower);
+		else
+			sprintf(query, "SELECT * FROM %s WHERE `%s` >= %ld AND `%s` < %ld",
+					table_name, pkey_name, lower, pkey_name, upper);
+		commands[i] = query;
+	}
+	return commands;
+}
+
 /*
  * misc functions
  */
@@ -7,11 +7,13 @@
  * it under the terms of the PostgreSQL License. See the LICENSE file.
  */
 #include "sql2arrow.h"
+#include <arpa/inet.h>
 #include <limits.h>
 #include <libpq-fe.h>
 
 #define CURSOR_NAME		"curr_pg2arrow"
 static char	   *server_timezone = NULL;
+bool			pgsql_copy_mode = false;
 
 static void		pgsql_setup_composite_type(PGconn *conn,
 										   SQLtable *root,
@@ -34,6 +36,13 @@ typedef struct
 	PGresult   *res;
 	uint32		nitems;
 	uint32		index;
+	/* binary COPY mode */
+	int			copy_nfields;
+	bool		copy_header;	/* true, if header is already consumed */
+	bool		copy_pending;	/* true, if current row is not fetched yet */
+	char	   *copy_buf;		/* current CopyData message */
+	const char *copy_pos;
+	const char *copy_end;
 } PGSTATE;
 
 static inline bool
@@ -150,6 +159,80 @@ pgsql_next_result(PGSTATE *pgstate)
 	return res;
 }
 
+/*
+ * pgsql_next_copy_row
+ *
+ * It moves the current position to the next row of the binary COPY stream.
+ * PostgreSQL sends a CopyData message per row, and the file header is
+ * prepended to the first one, so rows are never split across messages.
+ */
+static bool
+pgsql_next_copy_row(PGSTATE *pgstate)
+{
+	static const char copy_signature[11] = "PGCOPY\n\377\r\n\0";
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	int16		nfields;
+	int			nbytes;
+
+	for (;;)
+	{
+		if (pgstate->copy_pos >= pgstate->copy_end)
+		{
+			if (pgstate->copy_buf)
+			{
+				PQfreemem(pgstate->copy_buf);
+				pgstate->copy_buf = NULL;
+			}
+			nbytes = PQgetCopyData(conn, &pgstate->copy_buf, 0);
+			if (nbytes == -1)
+			{
+				/* end of the COPY */
+				res = PQgetResult(conn);
+				if (PQresultStatus(res) != PGRES_COMMAND_OK)
+					Elog("SQL execution failed: %s", PQresultErrorMessage(res));
+				PQclear(res);
+				pgstate->copy_pos = pgstate->copy_end = NULL;
+				return false;
+			}
+			else if (nbytes < 0)
+				Elog("failed on PQgetCopyData: %s", PQerrorMessage(conn));
+			pgstate->copy_pos = pgstate->copy_buf;
+			pgstate->copy_end = pgstate->copy_buf + nbytes;
+		}
+
+		if (!pgstate->copy_header)
+		{
+			uint32		flags;
+			uint32		extlen;
+
+			if (pgstate->copy_pos + 19 > pgstate->copy_end ||
+				memcmp(pgstate->copy_pos, copy_signature, 11) != 0)
+				Elog("unexpected binary COPY header");
+			flags = ntohl(*((const uint32 *)(pgstate->copy_pos + 11)));
+			if ((flags & 0xffff0000U) != 0)
+				Elog("unrecognized binary COPY flags: %08x", flags);
+			extlen = ntohl(*((const uint32 *)(pgstate->copy_pos + 15)));
+			pgstate->copy_pos += 19 + extlen;
+			pgstate->copy_header = true;
+			continue;
+		}
+		if (pgstate->copy_pos + sizeof(int16) > pgstate->copy_end)
+			Elog("binary COPY stream is corrupted");
+		nfields = (int16)ntohs(*((const uint16 *)pgstate->copy_pos));
+		pgstate->copy_pos += sizeof(int16);
+		if (nfields == -1)
+		{
+			/* file trailer; wait for the end of the COPY */
+			pgstate->copy_pos = pgstate->copy_end;
+			continue;
+		}
+		if (nfields != pgstate->copy_nfields)
+			Elog("unexpected number of fields in binary COPY: %d", nfields);
+		return true;
+	}
+}
+
 /*
  * pgsql_create_dictionary
  */
@@ -621,6 +704,39 @@ sqldb_begin_query(void *sqldb_state,
 		Elog("unable to begin transaction: %s", PQresultErrorMessage(res));
 	PQclear(res);
 
+	if (pgsql_copy_mode)
+	{
+		SQLtable   *table;
+
+		/* describe the result type without execution */
+		res = PQprepare(conn, "", sqldb_command, 0, NULL);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("unable to prepare the query: %s", PQresultErrorMessage(res));
+		PQclear(res);
+		res = PQdescribePrepared(conn, "");
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("unable to describe the query: %s", PQresultErrorMessage(res));
+		table = pgsql_create_buffer(conn, res, af_info, dictionary_list);
+		pgstate->copy_nfields = PQnfields(res);
+		PQclear(res);
+
+		/* kick binary COPY */
+		query = palloc(strlen(sqldb_command) + 1024);
+		sprintf(query, "COPY (%s) TO STDOUT (FORMAT binary)",
+				sqldb_command);
+		res = PQexec(conn, query);
+		if (PQresultStatus(res) != PGRES_COPY_OUT)
+			Elog("unable to run binary COPY: %s", PQresultErrorMessage(res));
+		PQclear(res);
+
+		/* fetch the first row */
+		if (!pgsql_next_copy_row(pgstate))
+			return NULL;
+		pgstate->copy_pending = true;
+
+		return table;
+	}
+
 	/* declare cursor */
 	query = palloc(strlen(sqldb_command) + 1024);
 	sprintf(query, "DECLARE " CURSOR_NAME " BINARY CURSOR FOR %s",
@@ -639,14 +755,64 @@ sqldb_begin_query(void *sqldb_state,
 	return pgsql_create_buffer(conn, res, af_info, dictionary_list);
 }
 
+/*
+ * pgsql_fetch_copy_row
+ *
+ * Values in the binary COPY stream have identical format to the binary
+ * result set, so they are written to the column buffers directly from
+ * the CopyData message.
+ */
+static ssize_t
+pgsql_fetch_copy_row(PGSTATE *pgstate, SQLtable *table)
+{
+	const char *pos;
+	int			j;
+	size_t		usage = 0;
+
+	if (pgstate->copy_pending)
+		pgstate->copy_pending = false;
+	else if (!pgsql_next_copy_row(pgstate))
+		return -1;		/* end of the scan */
+
+	pos = pgstate->copy_pos;
+	table->nitems++;
+	for (j=0; j < table->nfields; j++)
+	{
+		SQLfield   *column = &table->columns[j];
+		int32		sz;
+
+		if (pos + sizeof(int32) > pgstate->copy_end)
+			Elog("binary COPY stream is corrupted");
+		sz = (int32)ntohl(*((const uint32 *)pos));
+		pos += sizeof(int32);
+		if (sz < 0)
+			usage += sql_field_put_value(column, NULL, 0);
+		else
+		{
+			if (pos + sz > pgstate->copy_end)
+				Elog("binary COPY stream is corrupted");
+			usage += sql_field_put_value(column, pos, sz);
+			pos += sz;
+		}
+		assert(table->nitems == column->nitems);
+	}
+	pgstate->copy_pos = pos;
+
+	return usage;
+}
+
 ssize_t
 sqldb_fetch_results(void *sqldb_state, SQLtable *table)
 {
 	PGSTATE	   *pgstate = sqldb_state;
 	PGresult   *res = pgstate->res;
-	int			j, index = pgstate->index++;
+	int			j, index;
 	size_t		usage = 0;
 
+	if (pgsql_copy_mode)
+		return pgsql_fetch_copy_row(pgstate, table);
+
+	index = pgstate->index++;
 	if (index >= pgstate->nitems)
 	{
 		res = pgsql_next_result(pgstate);
@@ -680,6 +846,28 @@ sqldb_fetch_results(void *sqldb_state, SQLtable *table)
 	return usage;
 }
 
+/*
+ * sqldb_fetch_scalar - run a query that returns a single value
+ */
+char *
+sqldb_fetch_scalar(void *sqldb_state, const char *query)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+	PGresult   *res;
+	char	   *retval = NULL;
+
+	res = PQexec(pgstate->conn, query);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		Elog("SQL execution failed: %s", PQresultErrorMessage(res));
+	if (PQnfields(res) != 1 || PQntuples(res) != 1)
+		Elog("unexpected result of the query: %s", query);
+	if (!PQgetisnull(res, 0, 0))
+		retval = pstrdup(PQgetvalue(res, 0, 0));
+	PQclear(res);
+
+	return retval;
+}
+
 void
 sqldb_close_connection(void *sqldb_state)
 {
@@ -689,12 +877,20 @@ sqldb_close_connection(void *sqldb_state)
 
 	if (pgstate->res)
 		PQclear(pgstate->res);
-	/* close the cursor */
-	res = PQexec(conn, "CLOSE " CURSOR_NAME);
-	if (PQresultStatus(res) != PGRES_COMMAND_OK)
-		Elog("failed on close cursor '%s': %s", CURSOR_NAME,
-			 PQresultErrorMessage(res));
-	PQclear(res);
+	if (pgsql_copy_mode)
+	{
+		if (pgstate->copy_buf)
+			PQfreemem(pgstate->copy_buf);
+	}
+	else
+	{
+		/* close the cursor */
+		res = PQexec(conn, "CLOSE " CURSOR_NAME);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("failed on close cursor '%s': %s", CURSOR_NAME,
+				 PQresultErrorMessage(res));
+		PQclear(res);
+	}
 	/* close the connection */
 	PQfinish(conn);
 }
@@ -15,9 +15,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <strings.h>
+#include <sys/wait.h>
 
 /* command options */
 static char	   *sqldb_command = NULL;
+static char	   *sqldb_table_name = NULL;
 static char	   *output_filename = NULL;
 static char	   *append_filename = NULL;
 static size_t	batch_segment_sz = 0;
@@ -28,7 +30,17 @@ static char	   *sqldb_password = NULL;
 static char	   *sqldb_database = NULL;
 static char	   *dump_arrow_filename = NULL;
 static int		shows_progress = 0;
+static char	   *sort_keys = NULL;
+static int		stat_enabled = 0;
+static char	   *stat_column_names = NULL;	/* NULL means all */
 static userConfigOption *sqldb_session_configs = NULL;
+static int		num_workers = 1;
+static int		worker_id = -1;		/* >=0, if parallel worker process */
+static int		split_by_pkey = 0;	/* -t with -n on mysql2arrow */
+static char	   *watermark_column = NULL;
+
+#define WORKER_ID_TOKEN			"$(WORKER_ID)"
+#define N_WORKERS_TOKEN			"$(N_WORKERS)"
 
 /*
  * loadArrowDictionaryBatches
@@ -324,6 +336,8 @@ shows_record_batch_progress(SQLtable *table, size_t nitems)
 
 		assert(index >= 0);
 		block = &table->recordBatches[index];
+		if (worker_id >= 0)
+			printf("[worker %d] ", worker_id);
 		printf("RecordBatch[%d]: "
 			   "offset=%lu length=%lu (meta=%u, body=%lu) nitems=%zu\n",
 			   index,
@@ -384,9 +398,23 @@ usage(void)
 		  "      --append=FILENAME result Apache Arrow file to be appended\n"
 		  "      (--output and --append are exclusive. If neither of them\n"
 		  "       are given, it creates a temporary file.)\n"
+		  "  -n, --num-workers=N   number of parallel workers\n"
+		  "      (each worker runs the COMMAND with " WORKER_ID_TOKEN " and\n"
+		  "       " N_WORKERS_TOKEN " replaced on its own connection, and\n"
+		  "       writes to FILENAME with worker-id suffix.)\n"
+#ifdef __MYSQL2ARROW__
+		  "      (-t splits the table by ranges of the single column\n"
+		  "       integer primary key.)\n"
+#endif
 		  "\n"
 		  "Arrow format options:\n"
 		  "  -s, --segment-size=SIZE size of record batch for each\n"
+		  "      --sort=KEYS       sort the results by the KEYS on the server\n"
+		  "      --stat[=COLUMNS]  write out min/max statistics per record batch\n"
+		  "      (all the supported columns, if COLUMNS is not given)\n"
+		  "      --watermark=COLUMN export only rows newer than the last run\n"
+		  "      (the max value of COLUMN is saved in the file, then --append\n"
+		  "       fetches rows with larger COLUMN values only)\n"
 		  "\n"
 		  "Connection options:\n"
 		  "  -h, --host=HOSTNAME  database server host\n"
@@ -404,6 +432,9 @@ usage(void)
 		  "      --dump=FILENAME  dump information of arrow file\n"
 		  "      --progress       shows progress of the job\n"
 		  "      --set=NAME:VALUE config option to set before SQL execution\n"
+#ifdef __PG2ARROW__
+		  "      --copy           fetch the results using binary COPY\n"
+#endif
 		  "      --help           shows this message\n"
 		  "\n"
 		  "Report bugs to <pgstrom@heterodb.com>.\n",
@@ -411,6 +442,25 @@ usage(void)
 	exit(1);
 }
 
+/*
+ * __apply_sort_keys
+ *
+ * Sorting by the server (on work_mem; use --set to adjust) makes the key
+ * values clustered in record batches, so min/max statistics can skip the
+ * batches efficiently.
+ */
+static char *
+__apply_sort_keys(const char *command)
+{
+	char   *temp = malloc(strlen(command) + strlen(sort_keys) + 100);
+
+	if (!temp)
+		Elog("out of memory");
+	sprintf(temp, "SELECT * FROM (%s) AS __sql2arrow ORDER BY %s",
+			command, sort_keys);
+	return temp;
+}
+
 static void
 parse_options(int argc, char * const argv[])
 {
@@ -420,6 +470,7 @@ parse_options(int argc, char * const argv[])
 		{"table",        required_argument, NULL, 't'},
 		{"output",       required_argument, NULL, 'o'},
 		{"append",       required_argument, NULL, 1000},
+		{"num-workers",  required_argument, NULL, 'n'},
 		{"segment-size", required_argument, NULL, 's'},
 		{"host",         required_argument, NULL, 'h'},
 		{"port",         required_argument, NULL, 'p'},
@@ -434,6 +485,12 @@ parse_options(int argc, char * const argv[])
 		{"dump",         required_argument, NULL, 1001},
 		{"progress",     no_argument,       NULL, 1002},
 		{"set",          required_argument, NULL, 1003},
+		{"sort",         required_argument, NULL, 1004},
+		{"stat",         optional_argument, NULL, 1005},
+		{"watermark",    required_argument, NULL, 1007},
+#ifdef __PG2ARROW__
+		{"copy",         no_argument,       NULL, 1006},
+#endif /* __PG2ARROW__ */
 		{"help",         no_argument,       NULL, 9999},
 		{NULL, 0, NULL, 0},
 	};
@@ -444,7 +501,7 @@ parse_options(int argc, char * const argv[])
 	const char *pos;
 	userConfigOption *last_user_config = NULL;
 
-	while ((c = getopt_long(argc, argv, "d:c:t:o:s:h:P:u:p:",
+	while ((c = getopt_long(argc, argv, "d:c:t:o:n:s:h:P:u:p:",
 							long_options, NULL)) >= 0)
 	{
 		switch (c)
@@ -468,10 +525,7 @@ parse_options(int argc, char * const argv[])
 					Elog("-t option was supplied twice");
 				if (meet_command)
 					Elog("-c and -t options are exclusive");
-				sqldb_command = malloc(100 + strlen(optarg));
-				if (!sqldb_command)
-					Elog("out of memory");
-				sprintf(sqldb_command, "SELECT * FROM %s", optarg);
+				sqldb_table_name = optarg;
 				break;
 
 			case 'o':
@@ -489,7 +543,15 @@ parse_options(int argc, char * const argv[])
 					Elog("-o and --append are exclusive");
 				append_filename = optarg;
 				break;
-				
+
+			case 'n':
+				if (num_workers != 1)
+					Elog("-n option was supplied twice");
+				num_workers = atoi(optarg);
+				if (num_workers < 1)
+					Elog("number of workers is not valid: %s", optarg);
+				break;
+
 			case 's':
 				if (batch_segment_sz != 0)
 					Elog("-s option was supplied twice");
@@ -583,6 +645,32 @@ parse_options(int argc, char * const argv[])
 				}
 				break;
 
+			case 1004:		/* --sort */
+				if (sort_keys)
+					Elog("--sort option was supplied twice");
+				sort_keys = optarg;
+				break;
+
+			case 1005:		/* --stat */
+				if (stat_enabled)
+					Elog("--stat option was supplied twice");
+				stat_enabled = 1;
+				stat_column_names = optarg;
+				break;
+			case 1007:		/* --watermark */
+				if (watermark_column)
+					Elog("--watermark option was supplied twice");
+				watermark_column = optarg;
+				break;
+
+#ifdef __PG2ARROW__
+			case 1006:		/* --copy */
+				if (pgsql_copy_mode)
+					Elog("--copy option was supplied twice");
+				pgsql_copy_mode = true;
+				break;
+#endif /* __PG2ARROW__ */
+
 			case 9999:		/* --help */
 			default:
 				usage();
@@ -616,16 +704,350 @@ parse_options(int argc, char * const argv[])
 	/* --dump is exclusive other options */
 	if (dump_arrow_filename)
 	{
-		if (sqldb_command || output_filename || append_filename)
+		if (sqldb_command || sqldb_table_name ||
+			output_filename || append_filename)
 			Elog("--dump option is exclusive with -c, -t, -o and --append");
 		return;
 	}
+	if (sqldb_table_name)
+	{
+		sqldb_command = malloc(200 + strlen(sqldb_table_name));
+		if (!sqldb_command)
+			Elog("out of memory");
+		if (num_workers == 1)
+			sprintf(sqldb_command, "SELECT * FROM %s", sqldb_table_name);
+		else
+		{
+#ifdef __PG2ARROW__
+			/*
+			 * Split the table by chunks of 2048 blocks (16MB), in round-robin.
+			 * Workers scan the table concurrently, so synchronized seqscan
+			 * allows to share the storage read of the server.
+			 */
+			sprintf(sqldb_command,
+					"SELECT * FROM %s WHERE "
+					"((ctid::text::point)[0]::bigint / 2048) %% "
+					N_WORKERS_TOKEN " = " WORKER_ID_TOKEN,
+					sqldb_table_name);
+#else
+			/*
+			 * The table is split by ranges of the primary key on
+			 * launch_parallel_workers(), because it needs a connection.
+			 */
+			sprintf(sqldb_command, "SELECT * FROM %s", sqldb_table_name);
+			split_by_pkey = 1;
+#endif
+		}
+	}
 	if (!sqldb_command)
 		Elog("Neither -c nor -t options are supplied");
+	/* with --watermark, sort keys are applied after the range filter */
+	if (sort_keys && !watermark_column)
+		sqldb_command = __apply_sort_keys(sqldb_command);
+	if (num_workers > 1)
+	{
+		if (append_filename)
+			Elog("-n and --append are exclusive");
+		if (watermark_column)
+			Elog("-n and --watermark are exclusive");
+		if (!split_by_pkey && !strstr(sqldb_command, WORKER_ID_TOKEN))
+			Elog("SQL command must contain %s token to split the results for -n option",
+				 WORKER_ID_TOKEN);
+	}
 	if (batch_segment_sz == 0)
 		batch_segment_sz = (1UL << 28);		/* 256MB in default */
 }
 
+/*
+ * setup_field_stats
+ */
+static bool
+__stat_column_name_matched(const char *field_name)
+{
+	char	   *temp;
+	char	   *tok, *saveptr;
+
+	if (!stat_column_names)
+		return true;
+	temp = pstrdup(stat_column_names);
+	for (tok = strtok_r(temp, ",", &saveptr);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &saveptr))
+	{
+		while (isspace(*tok))
+			tok++;
+		if (strcmp(tok, field_name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static void
+setup_field_stats(SQLtable *table, ArrowFileInfo *af_info)
+{
+	int		j;
+
+	for (j=0; j < table->nfields; j++)
+	{
+		SQLfield   *column = &table->columns[j];
+
+		if (!__stat_column_name_matched(column->field_name))
+			continue;
+		if (!sql_field_stat_supported(column))
+		{
+			if (stat_column_names)
+				Elog("--stat: column '%s' of %s is not supported",
+					 column->field_name, column->arrow_typename);
+			continue;
+		}
+		column->stat_enabled = true;
+		/* statistics of the record batches already in the file */
+		if (af_info)
+			restoreArrowFieldStat(column, &af_info->footer.schema.fields[j],
+								  af_info->footer._num_recordBatches);
+	}
+}
+
+/*
+ * __replace_worker_tokens
+ */
+static char *
+__replace_worker_tokens(const char *command)
+{
+	char	   *buf = palloc(strlen(command) * 2 + 100);
+	char	   *dst = buf;
+	const char *src = command;
+
+	while (*src != '\0')
+	{
+		if (strncmp(src, WORKER_ID_TOKEN, strlen(WORKER_ID_TOKEN)) == 0)
+		{
+			dst += sprintf(dst, "%d", worker_id);
+			src += strlen(WORKER_ID_TOKEN);
+		}
+		else if (strncmp(src, N_WORKERS_TOKEN, strlen(N_WORKERS_TOKEN)) == 0)
+		{
+			dst += sprintf(dst, "%d", num_workers);
+			src += strlen(N_WORKERS_TOKEN);
+		}
+		else
+			*dst++ = *src++;
+	}
+	*dst = '\0';
+	return buf;
+}
+
+/*
+ * __worker_output_filename
+ *
+ * "foo.arrow" becomes "foo.<worker_id>.arrow"; Arrow_Fdw can map the set of
+ * files on a foreign table by 'files' or 'dir' option.
+ */
+static char *
+__worker_output_filename(const char *filename)
+{
+	const char *pos;
+	char	   *buf;
+
+	if (!filename)
+		return NULL;
+	buf = palloc(strlen(filename) + 40);
+	pos = strrchr(filename, '.');
+	if (pos && strcmp(pos, ".arrow") == 0)
+		sprintf(buf, "%.*s.%d.arrow",
+				(int)(pos - filename), filename, worker_id);
+	else
+		sprintf(buf, "%s.%d", filename, worker_id);
+	return buf;
+}
+
+/*
+ * launch_parallel_workers
+ *
+ * It forks worker processes; each has its own connection, and writes out
+ * its portion of the results to its own file. It returns only on the worker
+ * process, and the launcher process exits after all the workers.
+ */
+static void
+launch_parallel_workers(void)
+{
+	pid_t	   *children = palloc0(sizeof(pid_t) * num_workers);
+	char	  **worker_commands = NULL;
+	int			i, status;
+	int			nfailed = 0;
+
+#ifdef __MYSQL2ARROW__
+	if (split_by_pkey)
+	{
+		void   *sqldb_state = sqldb_server_connect(sqldb_hostname,
+												   sqldb_port_num,
+												   sqldb_username,
+												   sqldb_password,
+												   sqldb_database,
+												   sqldb_session_configs);
+		worker_commands = mysql_split_table_by_pkey(sqldb_state,
+													sqldb_table_name,
+													num_workers);
+		sqldb_close_connection(sqldb_state);
+		if (sort_keys)
+		{
+			for (i=0; i < num_workers; i++)
+				worker_commands[i] = __apply_sort_keys(worker_commands[i]);
+		}
+	}
+#endif
+	fflush(stdout);
+	fflush(stderr);
+	for (i=0; i < num_workers; i++)
+	{
+		pid_t	child = fork();
+
+		if (child == 0)
+		{
+			worker_id = i;
+			if (worker_commands)
+				sqldb_command = worker_commands[i];
+			else
+				sqldb_command = __replace_worker_tokens(sqldb_command);
+			output_filename = __worker_output_filename(output_filename);
+			return;
+		}
+		else if (child < 0)
+		{
+			int		errno_saved = errno;
+
+			while (--i >= 0)
+				kill(children[i], SIGTERM);
+			errno = errno_saved;
+			Elog("failed on fork(2): %m");
+		}
+		children[i] = child;
+	}
+
+	for (i=0; i < num_workers; i++)
+	{
+		if (waitpid(children[i], &status, 0) < 0)
+			Elog("failed on waitpid(2): %m");
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		{
+			fprintf(stderr, "worker %d (pid=%d) exited abnormally\n",
+					i, (int)children[i]);
+			nfailed++;
+		}
+	}
+	exit(nfailed > 0 ? 1 : 0);
+}
+
+/*
+ * setup_watermark_command
+ *
+ * It fetches the current max value of the watermark column first, then
+ * restricts the SQL command to the rows between the watermark saved in
+ * the appended file (exclusive) and the new one (inclusive). Rows are
+ * assumed to be inserted with increasing watermark values, like event
+ * logs with serial ids or timestamps.
+ */
+static char *
+__quote_literal(const char *str)
+{
+	char   *buf = palloc(2 * strlen(str) + 3);
+	char   *pos = buf;
+
+	*pos++ = '\'';
+	for (; *str != '\0'; str++)
+	{
+		if (*str == '\'')
+			*pos++ = '\'';
+		*pos++ = *str;
+	}
+	*pos++ = '\'';
+	*pos = '\0';
+	return buf;
+}
+
+static ArrowKeyValue *
+setup_watermark_command(void *sqldb_state, ArrowFileInfo *af_info,
+						int *p_num_metadata)
+{
+	ArrowKeyValue *kv;
+	const char *old_watermark = NULL;
+	char	   *new_watermark;
+	char	   *query;
+	int			i;
+
+	/* watermark saved by the last run */
+	if (af_info)
+	{
+		ArrowSchema *schema = &af_info->footer.schema;
+		const char *column = NULL;
+
+		for (i=0; i < schema->_num_custom_metadata; i++)
+		{
+			ArrowKeyValue *curr = &schema->custom_metadata[i];
+
+			if (strcmp(curr->key, "watermark_column") == 0)
+				column = curr->value;
+			else if (strcmp(curr->key, "watermark_value") == 0)
+				old_watermark = curr->value;
+		}
+		if (column && strcmp(column, watermark_column) != 0)
+			Elog("--watermark=%s mismatch to the column '%s' of the last run",
+				 watermark_column, column);
+	}
+
+	/* fetch the new watermark */
+	query = palloc(strlen(sqldb_command) + strlen(watermark_column) + 100);
+	sprintf(query, "SELECT MAX(%s) FROM (%s) AS __sql2arrow",
+			watermark_column, sqldb_command);
+	new_watermark = sqldb_fetch_scalar(sqldb_state, query);
+	if (!new_watermark)
+		new_watermark = (char *)old_watermark;
+
+	/* build SQL command to fetch the new rows only */
+	if (new_watermark)
+	{
+		char   *temp = palloc(strlen(sqldb_command) +
+							  2 * strlen(watermark_column) +
+							  2 * strlen(new_watermark) +
+							  (old_watermark ? 2 * strlen(old_watermark) : 0) + 200);
+
+		if (old_watermark)
+			sprintf(temp, "SELECT * FROM (%s) AS __sql2arrow"
+					" WHERE %s > %s AND %s <= %s",
+					sqldb_command,
+					watermark_column, __quote_literal(old_watermark),
+					watermark_column, __quote_literal(new_watermark));
+		else
+			sprintf(temp, "SELECT * FROM (%s) AS __sql2arrow"
+					" WHERE %s <= %s",
+					sqldb_command,
+					watermark_column, __quote_literal(new_watermark));
+		sqldb_command = temp;
+	}
+	if (sort_keys)
+		sqldb_command = __apply_sort_keys(sqldb_command);
+
+	/* custom metadata to be saved */
+	kv = palloc0(sizeof(ArrowKeyValue) * 2);
+	initArrowNode(&kv[0], KeyValue);
+	kv[0].key = "watermark_column";
+	kv[0]._key_len = strlen(kv[0].key);
+	kv[0].value = watermark_column;
+	kv[0]._value_len = strlen(watermark_column);
+	if (!new_watermark)
+	{
+		*p_num_metadata = 1;
+		return kv;
+	}
+	initArrowNode(&kv[1], KeyValue);
+	kv[1].key = "watermark_value";
+	kv[1]._key_len = strlen(kv[1].key);
+	kv[1].value = new_watermark;
+	kv[1]._value_len = strlen(new_watermark);
+	*p_num_metadata = 2;
+	return kv;
+}
+
 /*
  * Entrypoint of mysql2arrow
  */
@@ -636,6 +1058,8 @@ int main(int argc, char * const argv[])
 	void		   *sqldb_state;
 	SQLtable	   *table;
 	ArrowKeyValue  *kv;
+	ArrowKeyValue  *watermark_kv = NULL;
+	int				num_watermark_kv = 0;
 	ssize_t			usage;
 	SQLdictionary  *sql_dict_list = NULL;
 	
@@ -645,6 +1069,10 @@ int main(int argc, char * const argv[])
 	if (dump_arrow_filename)
 		return dumpArrowFile(dump_arrow_filename);
 
+	/* fork worker processes, if -n N is given */
+	if (num_workers > 1)
+		launch_parallel_workers();
+
 	/* open connection */
 	sqldb_state = sqldb_server_connect(sqldb_hostname,
 									   sqldb_port_num,
@@ -661,24 +1089,41 @@ int main(int argc, char * const argv[])
 		readArrowFileDesc(append_fdesc, &af_info);
 		sql_dict_list = loadArrowDictionaryBatches(append_fdesc, &af_info);
 	}
+	/* fetch the rows newer than the last run only, if --watermark */
+	if (watermark_column)
+		watermark_kv = setup_watermark_command(sqldb_state,
+											   append_filename ? &af_info : NULL,
+											   &num_watermark_kv);
 	/* begin SQL command execution */
 	table = sqldb_begin_query(sqldb_state,
 							  sqldb_command,
 							  append_filename ? &af_info : NULL,
 							  sql_dict_list);
 	if (!table)
+	{
+		if (watermark_column && append_filename)
+		{
+			/* no new rows since the last run */
+			sqldb_close_connection(sqldb_state);
+			return 0;
+		}
 		Elog("Empty results by the query: %s", sqldb_command);
+	}
 	table->segment_sz = batch_segment_sz;
+	if (stat_enabled)
+		setup_field_stats(table, append_filename ? &af_info : NULL);
 
-	/* save the SQL command as custom metadata */
-	kv = palloc0(sizeof(ArrowKeyValue));
+	/* save the SQL command (and watermark, if any) as custom metadata */
+	kv = palloc0(sizeof(ArrowKeyValue) * (1 + num_watermark_kv));
 	initArrowNode(kv, KeyValue);
 	kv->key = "sql_command";
 	kv->_key_len = 11;
 	kv->value = sqldb_command;
 	kv->_value_len = strlen(sqldb_command);
+	if (num_watermark_kv > 0)
+		memcpy(kv + 1, watermark_kv, sizeof(ArrowKeyValue) * num_watermark_kv);
 	table->customMetadata = kv;
-	table->numCustomMetadata = 1;
+	table->numCustomMetadata = 1 + num_watermark_kv;
 	
 	/* open & setup result file */
 	if (!append_filename)
@@ -24,9 +24,19 @@ sqldb_begin_query(void *sqldb_state,
 				  SQLdictionary *dictionary_list);
 extern ssize_t
 sqldb_fetch_results(void *sqldb_state, SQLtable *table);
+extern char *
+sqldb_fetch_scalar(void *sqldb_state, const char *query);
 
 extern void
 sqldb_close_connection(void *sqldb_state);
+#ifdef __PG2ARROW__
+extern bool		pgsql_copy_mode;
+#endif
+#ifdef __MYSQL2ARROW__
+extern char	  **mysql_split_table_by_pkey(void *sqldb_state,
+										  const char *table_name,
+										  int nsplits);
+#endif
 
 /* misc functions */
 extern void	   *palloc(Size sz);